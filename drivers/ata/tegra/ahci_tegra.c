@@ -16,6 +16,9 @@
 
 #include "ahci_tegra.h"
 #include "linux/pinctrl/consumer.h"
+#include <linux/version.h>
+#include <linux/blkdev.h>
+#include <linux/ioprio.h>
 
 
 #ifdef CONFIG_DEBUG_FS
@@ -438,8 +441,274 @@ static ssize_t tegra_ahci_compliance_mode_show(struct device *dev,
 static DEVICE_ATTR(tegra_ahci_compliance_mode_testing, S_IWUSR | S_IRUGO,
 	tegra_ahci_compliance_mode_show, tegra_ahci_compliance_mode_set);
 
+/*
+ * Command completion coalescing, written as "<completions> <timeout_ms>".
+ * The HBA raises one interrupt once that many commands completed or the
+ * timeout expired since the first of them, a zero timeout turns it off.
+ */
+static int tegra_ahci_set_ccc(struct ata_host *host, u32 cc, u32 tv)
+{
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	void __iomem *mmio = hpriv->mmio;
+	unsigned long flags;
+	u32 val;
+
+	if (!(hpriv->cap & HOST_CAP_CCC))
+		return -EOPNOTSUPP;
+
+	if (cc > T_AHCI_HBA_CCC_CTL_CC_MAX || tv > T_AHCI_HBA_CCC_CTL_TV_MAX)
+		return -EINVAL;
+
+	spin_lock_irqsave(&host->lock, flags);
+
+	/* TV and CC can only be changed while coalescing is disabled */
+	val = readl(mmio + T_AHCI_HBA_CCC_CTL);
+	writel(val & ~T_AHCI_HBA_CCC_CTL_EN, mmio + T_AHCI_HBA_CCC_CTL);
+	tegra->ccc_int = T_AHCI_HBA_CCC_CTL_INT(val);
+	writel(BIT(tegra->ccc_int), mmio + HOST_IRQ_STAT);
+
+	if (tv) {
+		tegra->ccc_ports = hpriv->port_map;
+		writel(tegra->ccc_ports, mmio + T_AHCI_HBA_CCC_PORTS);
+		val = (tv << T_AHCI_HBA_CCC_CTL_TV_SHIFT) |
+			(cc << T_AHCI_HBA_CCC_CTL_CC_SHIFT);
+		writel(val, mmio + T_AHCI_HBA_CCC_CTL);
+		writel(val | T_AHCI_HBA_CCC_CTL_EN, mmio + T_AHCI_HBA_CCC_CTL);
+	} else {
+		writel(0, mmio + T_AHCI_HBA_CCC_PORTS);
+		tegra->ccc_ports = 0;
+	}
+
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return 0;
+}
+
+static ssize_t tegra_ahci_ccc_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	u32 cc, tv;
+	int ret;
+
+	if (sscanf(buf, "%u %u", &cc, &tv) != 2)
+		return -EINVAL;
+
+	pm_runtime_get_sync(dev);
+	ret = tegra_ahci_set_ccc(host, cc, tv);
+	pm_runtime_put(dev);
+
+	return ret ? ret : count;
+}
+
+static ssize_t tegra_ahci_ccc_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	u32 val;
+
+	if (!(hpriv->cap & HOST_CAP_CCC))
+		return sprintf(buf, "not supported\n");
+
+	pm_runtime_get_sync(dev);
+	val = readl(hpriv->mmio + T_AHCI_HBA_CCC_CTL);
+	pm_runtime_put(dev);
+
+	if (!(val & T_AHCI_HBA_CCC_CTL_EN))
+		return sprintf(buf, "0 0\n");
+
+	return sprintf(buf, "%u %u\n",
+		(val >> T_AHCI_HBA_CCC_CTL_CC_SHIFT) &
+		T_AHCI_HBA_CCC_CTL_CC_MAX,
+		val >> T_AHCI_HBA_CCC_CTL_TV_SHIFT);
+}
+
+static DEVICE_ATTR(tegra_ahci_ccc, S_IWUSR | S_IRUGO,
+	tegra_ahci_ccc_show, tegra_ahci_ccc_store);
+
+/* Per port completion latency, any write clears the counters */
+static ssize_t tegra_ahci_latency_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&host->lock, flags);
+	for (i = 0; tegra->port_stats && i < host->n_ports; i++) {
+		tegra->port_stats[i].count = 0;
+		tegra->port_stats[i].total_ns = 0;
+		tegra->port_stats[i].max_ns = 0;
+	}
+	spin_unlock_irqrestore(&host->lock, flags);
+
+	return count;
+}
+
+static ssize_t tegra_ahci_latency_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	struct tegra_ahci_port_stats stats;
+	unsigned long flags;
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; tegra->port_stats && i < host->n_ports; i++) {
+		spin_lock_irqsave(&host->lock, flags);
+		stats = tegra->port_stats[i];
+		spin_unlock_irqrestore(&host->lock, flags);
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+			"port%d: count %llu avg_us %llu max_us %llu\n", i,
+			stats.count,
+			stats.count ?
+			div64_u64(stats.total_ns, stats.count) / NSEC_PER_USEC :
+			0, div_u64(stats.max_ns, NSEC_PER_USEC));
+	}
+
+	return len;
+}
+
+static DEVICE_ATTR(tegra_ahci_latency, S_IWUSR | S_IRUGO,
+	tegra_ahci_latency_show, tegra_ahci_latency_store);
+
+static void tegra_ahci_port_stats_update(struct tegra_ahci_priv *tegra,
+					 struct ata_port *ap, u64 done)
+{
+	struct tegra_ahci_port_stats *stats;
+	ktime_t now;
+	u64 ns;
+	int tag;
+
+	if (!tegra->port_stats || !done)
+		return;
+
+	stats = &tegra->port_stats[ap->port_no];
+	now = ktime_get();
+	while (done) {
+		tag = __ffs64(done);
+		done &= done - 1;
+
+		ns = ktime_to_ns(ktime_sub(now, stats->issue[tag]));
+		stats->count++;
+		stats->total_ns += ns;
+		if (ns > stats->max_ns)
+			stats->max_ns = ns;
+	}
+}
+
+/*
+ * Same as ahci_single_level_irq_intr(), but also services the coalesced
+ * ports on the CCC interrupt and accounts the completed commands.
+ */
+static irqreturn_t tegra_ahci_irq_intr(int irq, void *dev_instance)
+{
+	struct ata_host *host = dev_instance;
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	void __iomem *mmio = hpriv->mmio;
+	u32 irq_stat, irq_masked;
+	unsigned int rc = 0;
+	u64 active;
+	int i;
+
+	irq_stat = readl(mmio + HOST_IRQ_STAT);
+	if (!irq_stat)
+		return IRQ_NONE;
+
+	irq_masked = irq_stat & hpriv->port_map;
+
+	spin_lock(&host->lock);
+
+	if (tegra->ccc_ports && (irq_stat & BIT(tegra->ccc_int))) {
+		irq_masked |= tegra->ccc_ports;
+		rc = 1;
+	}
+
+	for (i = 0; i < host->n_ports; i++) {
+		struct ata_port *ap = host->ports[i];
+
+		if (!(irq_masked & BIT(i)))
+			continue;
+
+		active = ap->qc_active;
+		rc |= ahci_handle_port_intr(host, BIT(i));
+		tegra_ahci_port_stats_update(tegra, ap,
+					     active & ~(u64)ap->qc_active);
+	}
+
+	writel(irq_stat, mmio + HOST_IRQ_STAT);
+
+	spin_unlock(&host->lock);
+
+	return IRQ_RETVAL(rc);
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 10, 0)
+/*
+ * libata only learnt NCQ priority in 4.10, where it is enabled per device
+ * through ncq_prio_enable. Older kernels get the same behaviour here:
+ * FPDMA commands of IOPRIO_CLASS_RT requests are sent as high priority.
+ */
+static ssize_t tegra_ahci_ncq_prio_store(struct device *dev,
+				 struct device_attribute *attr,
+				 const char *buf, size_t count)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	bool enable;
+
+	if (strtobool(buf, &enable))
+		return -EINVAL;
+
+	tegra->ncq_prio_enable = enable;
+
+	return count;
+}
+
+static ssize_t tegra_ahci_ncq_prio_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+
+	return sprintf(buf, "%d\n", tegra->ncq_prio_enable);
+}
+
+static DEVICE_ATTR(tegra_ahci_ncq_prio, S_IWUSR | S_IRUGO,
+	tegra_ahci_ncq_prio_show, tegra_ahci_ncq_prio_store);
+
+static void tegra_ahci_qc_prep(struct ata_queued_cmd *qc)
+{
+	struct ahci_host_priv *hpriv = qc->ap->host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+
+	if (tegra->ncq_prio_enable && qc->tf.protocol == ATA_PROT_NCQ &&
+	    qc->scsicmd &&
+	    (qc->dev->id[ATA_ID_SATA_CAPABILITY] & TEGRA_AHCI_ID_NCQ_PRIO) &&
+	    IOPRIO_PRIO_CLASS(req_get_ioprio(qc->scsicmd->request)) ==
+	    IOPRIO_CLASS_RT)
+		qc->tf.hob_nsect |= TEGRA_AHCI_NCQ_PRIO_HIGH;
+
+	ahci_ops.qc_prep(qc);
+}
+#endif
+
 static unsigned int tegra_ahci_qc_issue(struct ata_queued_cmd *qc)
 {
+	struct ahci_host_priv *hpriv = qc->ap->host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
 
 	if (qc->tf.command == ATA_CMD_SET_FEATURES &&
 			qc->tf.feature ==  SATA_FPDMA_OFFSET) {
@@ -463,6 +732,9 @@ static unsigned int tegra_ahci_qc_issue(struct ata_queued_cmd *qc)
 		return 0;
 	}
 
+	if (tegra->port_stats)
+		tegra->port_stats[qc->ap->port_no].issue[qc->tag] = ktime_get();
+
 	return ahci_ops.qc_issue(qc);
 }
 
@@ -693,6 +965,9 @@ static void tegra_ahci_error_handler(struct ata_port *ap)
 
 static struct ata_port_operations ahci_tegra_port_ops = {
 	.inherits	= &ahci_ops,
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 10, 0)
+	.qc_prep	= tegra_ahci_qc_prep,
+#endif
 	.qc_issue	= tegra_ahci_qc_issue,
 	.host_stop	= tegra_ahci_host_stop,
 	.port_suspend	= tegra_ahci_port_suspend,
@@ -966,25 +1241,122 @@ disable_phys:
 #endif
 
 #ifdef CONFIG_PM
+/*
+ * While every link sits in partial or slumber the UPHY keeps the link up
+ * on its own, so runtime suspend can just gate the controller clocks.
+ * Resume then only ungates them and the link wakes up without PHY
+ * retraining or a COMRESET. DEVSLP and idle ports take the full ELPG
+ * path, which powers the UPHY down.
+ */
+static bool tegra_ahci_can_clk_gate(struct ahci_host_priv *hpriv)
+{
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	u32 ipm;
+	int i;
+
+	if (!tegra->enable_fast_rtpm || tegra_ahci_is_link_in_devslp(hpriv))
+		return false;
+
+	for (i = 0; i < hpriv->nports; i++) {
+		ipm = tegra_ahci_bar5_readl(hpriv,
+				T_AHCI_PORT_PXSSTS + (0x80 * i));
+		ipm = (ipm & T_AHCI_PORT_PXSSTS_IPM_MASK) >>
+					T_AHCI_PORT_PXSSTS_IPM_SHIFT;
+		if (ipm != TEGRA_AHCI_PORT_RUNTIME_PARTIAL &&
+				ipm != TEGRA_AHCI_PORT_RUNTIME_SLUMBER)
+			return false;
+	}
+
+	return true;
+}
+
 static int tegra_ahci_runtime_suspend(struct device *dev)
 {
 	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
 	int ret = 0;
 
+	if (tegra_ahci_can_clk_gate(hpriv)) {
+		/* keep a copy in case the context does not survive */
+		tegra_ahci_pg_save_registers(host);
+		tegra->rtpm_clb = tegra_ahci_bar5_readl(hpriv,
+				T_AHCI_PORT_PXCLB);
+		tegra_ahci_disable_clks(hpriv);
+		tegra->rtpm_clk_gated = true;
+		return 0;
+	}
+
 	ret = tegra_ahci_elpg_enter(host);
 	return ret;
 }
 
+static int tegra_ahci_clk_gate_exit(struct ata_host *host)
+{
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	int ret;
+
+	ret = tegra_ahci_enable_clks(hpriv);
+	if (ret)
+		return ret;
+
+	tegra->rtpm_clk_gated = false;
+
+	if ((tegra_ahci_bar5_readl(hpriv, T_AHCI_HBA_GHC) &
+			T_AHCI_HBA_GHC_AE) &&
+			tegra_ahci_bar5_readl(hpriv, T_AHCI_PORT_PXCLB) ==
+			tegra->rtpm_clb)
+		return 0;
+
+	dev_warn(&tegra->pdev->dev, "context lost while clock gated\n");
+	tegra_ahci_pg_restore_registers(host);
+	tegra_ahci_scfg_update(hpriv, T_SATA0_CFG_POWER_GATE_SSTS_RESTORED,
+			T_SATA0_CFG_POWER_GATE_SSTS_RESTORED,
+			T_SATA0_CFG_POWER_GATE);
+
+	return 0;
+}
+
 static int tegra_ahci_runtime_resume(struct device *dev)
 {
 	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	struct tegra_ahci_rtpm_stats *stats = &tegra->rtpm_stats;
+	ktime_t start = ktime_get();
 	int ret = 0;
 
-	ret = tegra_ahci_elpg_exit(host);
+	if (tegra->rtpm_clk_gated) {
+		ret = tegra_ahci_clk_gate_exit(host);
+		stats->fast++;
+	} else {
+		ret = tegra_ahci_elpg_exit(host);
+		stats->full++;
+	}
+
+	stats->last_us = ktime_us_delta(ktime_get(), start);
+	stats->max_us = max(stats->max_us, stats->last_us);
+
 	return ret;
 }
 #endif
 
+static ssize_t tegra_ahci_rtpm_resume_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct ata_host *host = dev_get_drvdata(dev);
+	struct ahci_host_priv *hpriv = host->private_data;
+	struct tegra_ahci_priv *tegra = hpriv->plat_data;
+	struct tegra_ahci_rtpm_stats *stats = &tegra->rtpm_stats;
+
+	return sprintf(buf, "fast %llu full %llu last_us %llu max_us %llu\n",
+		stats->fast, stats->full, stats->last_us, stats->max_us);
+}
+
+static DEVICE_ATTR(tegra_ahci_rtpm_resume, S_IRUGO,
+	tegra_ahci_rtpm_resume_show, NULL);
+
 #ifdef CONFIG_PM_SLEEP
 static int tegra_ahci_suspend(struct device *dev)
 {
@@ -1002,6 +1374,16 @@ static int tegra_ahci_suspend(struct device *dev)
 		ret = tegra_ahci_elpg_enter(host);
 		if (ret)
 			return ret;
+	} else if (tegra->rtpm_clk_gated) {
+		/* Runtime suspend left the UPHY up, finish the ELPG entry */
+		ret = tegra_ahci_enable_clks(hpriv);
+		if (ret)
+			return ret;
+
+		tegra->rtpm_clk_gated = false;
+		ret = tegra_ahci_elpg_enter(host);
+		if (ret)
+			return ret;
 	}
 
 	/*
@@ -1281,8 +1663,13 @@ static void tegra_ahci_controller_deinit(struct ahci_host_priv *hpriv)
 	struct platform_device *pdev = tegra->pdev;
 	struct device *dev = &pdev->dev;
 
-	if (tegra_platform_is_silicon())
-		tegra_ahci_runtime_suspend(dev);
+	if (tegra_platform_is_silicon()) {
+		/* take the full ELPG path so that the UPHY is powered down */
+		if (tegra->rtpm_clk_gated && !tegra_ahci_enable_clks(hpriv))
+			tegra->rtpm_clk_gated = false;
+		if (!tegra->rtpm_clk_gated)
+			tegra_ahci_elpg_enter(dev_get_drvdata(dev));
+	}
 	pm_runtime_disable(dev);
 #endif
 }
@@ -1621,6 +2008,7 @@ tegra_ahci_platform_get_resources(struct tegra_ahci_priv *tegra)
 	}
 
 	hpriv->plat_data = tegra;
+	hpriv->irq_handler = tegra_ahci_irq_intr;
 
 	tegra->devslp_pin = devm_pinctrl_get(dev);
 	if (IS_ERR(tegra->devslp_pin)) {
@@ -1646,6 +2034,9 @@ tegra_ahci_platform_get_resources(struct tegra_ahci_priv *tegra)
 	tegra->devslp_gpio =
 		of_get_named_gpio(dev->of_node, "gpios", 0);
 
+	tegra->enable_fast_rtpm =
+		of_property_read_bool(dev->of_node, "nvidia,enable-fast-rtpm");
+
 	ret = tegra_ahci_platform_get_memory_resources(tegra);
 	if (ret)
 		goto err_out;
@@ -1746,6 +2137,8 @@ static int tegra_ahci_probe(struct platform_device *pdev)
 	struct ahci_host_priv *hpriv;
 	struct tegra_ahci_priv *tegra;
 	const struct of_device_id *match = NULL;
+	struct tegra_ahci_port_stats *stats;
+	struct ata_host *host;
 	int ret;
 
 	tegra = devm_kzalloc(&pdev->dev, sizeof(*tegra), GFP_KERNEL);
@@ -1785,6 +2178,15 @@ static int tegra_ahci_probe(struct platform_device *pdev)
 	if (ret)
 		goto poweroff_controller;
 
+	host = platform_get_drvdata(pdev);
+	stats = devm_kcalloc(&pdev->dev, host->n_ports, sizeof(*stats),
+			GFP_KERNEL);
+	if (stats) {
+		spin_lock_irq(&host->lock);
+		tegra->port_stats = stats;
+		spin_unlock_irq(&host->lock);
+	}
+
 	ret = tegra_ahci_set_lpm(hpriv);
 	if (ret) {
 		dev_err(&pdev->dev,
@@ -1805,6 +2207,28 @@ static int tegra_ahci_probe(struct platform_device *pdev)
 		dev_warn(&pdev->dev,
 		"Failed to create compliance mode attricute err=%d\n", ret);
 
+	ret = device_create_file(&pdev->dev, &dev_attr_tegra_ahci_ccc);
+	if (ret)
+		dev_warn(&pdev->dev,
+		"Failed to create ccc attribute err=%d\n", ret);
+
+	ret = device_create_file(&pdev->dev, &dev_attr_tegra_ahci_latency);
+	if (ret)
+		dev_warn(&pdev->dev,
+		"Failed to create latency attribute err=%d\n", ret);
+
+	ret = device_create_file(&pdev->dev, &dev_attr_tegra_ahci_rtpm_resume);
+	if (ret)
+		dev_warn(&pdev->dev,
+		"Failed to create rtpm resume attribute err=%d\n", ret);
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 10, 0)
+	ret = device_create_file(&pdev->dev, &dev_attr_tegra_ahci_ncq_prio);
+	if (ret)
+		dev_warn(&pdev->dev,
+		"Failed to create ncq prio attribute err=%d\n", ret);
+#endif
+
 #ifdef CONFIG_DEBUG_FS
 	tegra_ahci_dump_debuginit(hpriv);
 #endif
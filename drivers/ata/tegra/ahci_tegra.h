@@ -167,7 +167,19 @@
 #define T_AHCI_HBA_GHC_HR				BIT(0)
 #define T_AHCI_HBA_GHC_AE				BIT(31)
 
+#define T_AHCI_HBA_CCC_CTL				0x14
+#define T_AHCI_HBA_CCC_CTL_TV_SHIFT			16
+#define T_AHCI_HBA_CCC_CTL_TV_MAX			0xffff
+#define T_AHCI_HBA_CCC_CTL_CC_SHIFT			8
+#define T_AHCI_HBA_CCC_CTL_CC_MAX			0xff
+#define T_AHCI_HBA_CCC_CTL_INT(x)			(((x) >> 3) & 0x1f)
+#define T_AHCI_HBA_CCC_CTL_EN				BIT(0)
+
+#define T_AHCI_HBA_CCC_PORTS				0x18
+
 /* AHCI Port Registers */
+#define T_AHCI_PORT_PXCLB				0x100
+
 #define T_AHCI_PORT_PXSSTS				0x128
 #define T_AHCI_PORT_PXSSTS_IPM_MASK			(0xF00)
 #define T_AHCI_PORT_PXSSTS_IPM_SHIFT			(8)
@@ -191,6 +203,10 @@
 
 #define TEGRA_AHCI_READ_LOG_EXT_NOENTRY			0x80
 
+/* IDENTIFY word 76 and the FPDMA PRIO field, for kernels before 4.10 */
+#define TEGRA_AHCI_ID_NCQ_PRIO				BIT(12)
+#define TEGRA_AHCI_NCQ_PRIO_HIGH			(0x2 << 6)
+
 /* Badblock Management */
 #define TEGRA_BADBLK_STRING_LENGTH			100
 
@@ -228,6 +244,22 @@ struct tegra_ahci_badblk_priv {
 	spinlock_t badblk_lock;
 };
 
+/* Issue to completion latency of the commands on a port */
+struct tegra_ahci_port_stats {
+	ktime_t issue[ATA_MAX_QUEUE];
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+/* Runtime resume latency, split by the path taken */
+struct tegra_ahci_rtpm_stats {
+	u64 fast;
+	u64 full;
+	u64 last_us;
+	u64 max_us;
+};
+
 struct tegra_ahci_priv {
 	struct platform_device	   *pdev;
 	void __iomem               *base_list[TEGRA_SATA_BARS_MAX];
@@ -248,10 +280,18 @@ struct tegra_ahci_priv {
 	struct tegra_prod	   *prod_list;
 	struct work_struct	   work;
 	struct tegra_ahci_badblk_priv badblk;
+	struct tegra_ahci_port_stats *port_stats;
+	struct tegra_ahci_rtpm_stats rtpm_stats;
+	u32			   rtpm_clb;
+	u32			   ccc_ports;
+	u32			   ccc_int;
 	int			   devslp_gpio;
 	bool			   devslp_override;
 	bool			   devslp_pinmux_override;
 	bool			   skip_rtpm;
+	bool			   ncq_prio_enable;
+	bool			   enable_fast_rtpm;
+	bool			   rtpm_clk_gated;
 };
 
 struct tegra_ahci_ops {
@@ -37,6 +37,13 @@
 #include <linux/version.h>
 #include <linux/pm_qos.h>
 #include <linux/workqueue.h>
+#include <linux/cpuhotplug.h>
+#include <linux/irq_work.h>
+#include <linux/smp.h>
+#include <linux/perf_event.h>
+#include <linux/math64.h>
+#include <linux/timer.h>
+#include <linux/jiffies.h>
 #include <linux/tegra-cpufreq.h>
 
 /* cpufreq transisition latency */
@@ -48,6 +55,16 @@
 #define REF_CLK_MHZ		408 /* 408 MHz */
 #define US_DELAY		500
 #define US_DELAY_MIN		2
+#define FREQ_CACHE_MS		100
+#define FREQ_CACHE_MS_MAX	1000 /* well below coreclk counter wrap */
+
+/* EMC floor scaling by backend stall ratio */
+#define ARMV8_PMU_STALL_BACKEND	0x24
+#define EMC_STALL_PERIOD_MS	50
+#define EMC_STALL_LO_PCT	10
+#define EMC_STALL_HI_PCT	40
+#define EMC_SCALE_MIN_PCT	50
+#define EMC_SCALE_MAX_PCT	200
 #define CPUFREQ_TBL_STEP_HZ	(50 * KHZ_TO_HZ * KHZ_TO_HZ)
 
 #define LOOP_FOR_EACH_CLUSTER(cl)	for (cl = 0; \
@@ -57,8 +74,26 @@ struct cpu_emc_map {
 	uint32_t cpufreq; /* unit in KHz */
 	uint32_t emcfreq; /* unit in KHz */
 };
-static struct cpu_emc_map *cpu_emc_map_ptr;
-static uint16_t cpu_emc_map_num;
+
+enum cpu_emc_profile_id {
+	CPU_EMC_PROFILE_DEFAULT,
+	CPU_EMC_PROFILE_MEMORY,
+	CPU_EMC_PROFILE_COMPUTE,
+	MAX_CPU_EMC_PROFILES,
+};
+
+struct cpu_emc_profile {
+	const char *name;
+	const char *prop; /* DT table */
+	struct cpu_emc_map *map;
+	uint16_t num;
+};
+
+static struct cpu_emc_profile cpu_emc_profiles[MAX_CPU_EMC_PROFILES] = {
+	[CPU_EMC_PROFILE_DEFAULT] = { "default", "cpu_emc_map" },
+	[CPU_EMC_PROFILE_MEMORY] = { "memory", "cpu_emc_map_memory" },
+	[CPU_EMC_PROFILE_COMPUTE] = { "compute", "cpu_emc_map_compute" },
+};
 static uint8_t tegra_hypervisor_mode;
 
 enum cluster {
@@ -82,15 +117,43 @@ struct per_cluster_data {
 	struct cpumask cpu_mask;
 	struct cc3_params cc3;
 	uint8_t configured;
+	/* EMC floor update deferred out of fast_switch */
+	struct irq_work emc_irq_work;
+	struct work_struct emc_work;
+	uint32_t emc_req_freq; /* KHz */
+	/* cpu to EMC floor state, protected by emc_lock */
+	uint32_t emc_cpu_freq; /* KHz, last cluster freq */
+	uint32_t emc_stall; /* permille of cycles stalled on the backend */
+	uint32_t emc_scale; /* percent applied to the profile's floor */
 };
 
 struct tegra_cpufreq_data {
 	struct per_cluster_data pcluster[MAX_CLUSTERS];
 	struct mutex mlock; /* lock protecting cc3 params */
 	uint32_t freq_compute_delay; /* delay in reading clock counters */
+	uint32_t freq_cache_ms; /* feedback cache refresh period */
 	unsigned long emc_max_rate; /* Hz */
+	struct mutex emc_lock; /* lock protecting cpu to emc floor state */
+	enum cpu_emc_profile_id emc_profile;
+	bool emc_stall_scaling;
+	uint32_t emc_stall_period_ms;
+	uint32_t emc_stall_lo_pct;
+	uint32_t emc_stall_hi_pct;
+	uint32_t emc_scale_min_pct;
+	uint32_t emc_scale_max_pct;
+	struct delayed_work emc_stall_work;
+};
+
+/* Backend stall sampling, per cpu PMU events owned by emc_stall_work */
+struct tegra_cpu_stall {
+	struct perf_event *cycles;
+	struct perf_event *stalls;
+	u64 last_cycles;
+	u64 last_stalls;
 };
 
+static DEFINE_PER_CPU(struct tegra_cpu_stall, cpu_stall);
+
 static struct tegra_cpufreq_data tfreq_data;
 struct tegra_cpu_ctr {
 	uint32_t cpu;
@@ -99,6 +162,37 @@ struct tegra_cpu_ctr {
 	uint32_t refclk_cnt, last_refclk_cnt;
 };
 
+/*
+ * Per cpu frequency estimate, refreshed from the feedback counters by a
+ * deferrable timer on the cpu itself so get_speed doesn't need an IPI.
+ */
+struct tegra_cpu_freq_cache {
+	struct timer_list timer;
+	uint32_t last_coreclk_cnt;
+	uint32_t last_refclk_cnt;
+	unsigned long last_sample; /* jiffies, 0 if no baseline */
+	unsigned long stamp; /* jiffies, 0 if rate is not valid */
+	unsigned int rate; /* KHz */
+	bool rebase;
+};
+
+static DEFINE_PER_CPU(struct tegra_cpu_freq_cache, freq_cache);
+
+/*
+ * NDIV request posted by fast_switch for a remote cpu. fast_switch runs
+ * with irqs off so it can't wait for a cross call, requests are handed
+ * over asynchronously and a request still in flight picks up the latest
+ * ndiv instead of queueing another one.
+ */
+struct tegra_fast_ndiv {
+	struct call_single_data csd;
+	atomic_t pending;
+	uint64_t ndiv;
+};
+
+static DEFINE_PER_CPU(struct tegra_fast_ndiv, fast_ndiv);
+static enum cpuhp_state freq_cache_hp_state;
+
 static struct workqueue_struct *read_counters_wq;
 struct read_counters_work {
 	struct work_struct work;
@@ -228,14 +322,114 @@ err_out:
 	return (unsigned int) (rate_mhz * 1000); /* in KHz */
 }
 
-static unsigned int tegra194_get_speed(uint32_t cpu)
+static unsigned int tegra194_fast_get_speed(uint32_t cpu)
 {
-	return tegra194_get_speed_common(cpu, tfreq_data.freq_compute_delay);
+	return tegra194_get_speed_common(cpu, US_DELAY_MIN);
 }
 
-static unsigned int tegra194_fast_get_speed(uint32_t cpu)
+static void tegra_freq_cache_sample(unsigned long data)
 {
-	return tegra194_get_speed_common(cpu, US_DELAY_MIN);
+	struct tegra_cpu_freq_cache *fc;
+	uint32_t cpu = (uint32_t)data;
+	uint32_t coreclk_cnt, refclk_cnt;
+	uint32_t delta_ccnt, delta_refcnt;
+	unsigned long now = jiffies;
+	unsigned long rate_mhz;
+	uint64_t val;
+
+	/* counters are per cpu, only trust a sample taken on the owner */
+	if (cpu != smp_processor_id())
+		return;
+
+	fc = &per_cpu(freq_cache, cpu);
+	val = read_freq_feedback();
+	refclk_cnt = (uint32_t)(val & 0xffffffff);
+	coreclk_cnt = (uint32_t)(val >> 32);
+
+	/*
+	 * The window has to be shorter than the ~2s coreclk counter wrap.
+	 * A deferrable timer can sleep for much longer on an idle cpu, so
+	 * just take a new baseline then, and also after a rate change.
+	 */
+	if (fc->last_sample && !READ_ONCE(fc->rebase) &&
+	    time_before(now, fc->last_sample + HZ)) {
+		delta_ccnt = coreclk_cnt - fc->last_coreclk_cnt;
+		delta_refcnt = refclk_cnt - fc->last_refclk_cnt;
+		if (delta_ccnt && delta_refcnt) {
+			rate_mhz = ((unsigned long)delta_ccnt * REF_CLK_MHZ) /
+					delta_refcnt;
+			WRITE_ONCE(fc->rate, (unsigned int)(rate_mhz * 1000));
+			smp_wmb();
+			WRITE_ONCE(fc->stamp, now);
+		}
+	}
+	WRITE_ONCE(fc->rebase, false);
+	fc->last_coreclk_cnt = coreclk_cnt;
+	fc->last_refclk_cnt = refclk_cnt;
+	fc->last_sample = now;
+
+	mod_timer(&fc->timer, now +
+		  msecs_to_jiffies(READ_ONCE(tfreq_data.freq_cache_ms)));
+}
+
+static void tegra_freq_cache_invalidate(uint32_t cpu)
+{
+	struct tegra_cpu_freq_cache *fc = &per_cpu(freq_cache, cpu);
+
+	WRITE_ONCE(fc->stamp, 0);
+	WRITE_ONCE(fc->rebase, true);
+}
+
+static int tegra_freq_cache_online(unsigned int cpu)
+{
+	struct tegra_cpu_freq_cache *fc = &per_cpu(freq_cache, cpu);
+
+	fc->last_sample = 0;
+	fc->rebase = false;
+	WRITE_ONCE(fc->stamp, 0);
+	setup_deferrable_timer(&fc->timer, tegra_freq_cache_sample, cpu);
+	fc->timer.expires = jiffies +
+		msecs_to_jiffies(READ_ONCE(tfreq_data.freq_cache_ms));
+	add_timer_on(&fc->timer, cpu);
+
+	return 0;
+}
+
+static int tegra_freq_cache_offline(unsigned int cpu)
+{
+	struct tegra_cpu_freq_cache *fc = &per_cpu(freq_cache, cpu);
+
+	del_timer_sync(&fc->timer);
+	WRITE_ONCE(fc->stamp, 0);
+
+	return 0;
+}
+
+/**
+ * Return cpu speed for cpufreq_get() and scaling_cur_freq
+ * Served from the per cpu feedback cache while it is no older than two
+ * refresh periods, else falls back to a fresh read on the target cpu
+ * and refills the cache with it.
+ */
+static unsigned int tegra194_get_speed(uint32_t cpu)
+{
+	struct tegra_cpu_freq_cache *fc = &per_cpu(freq_cache, cpu);
+	unsigned long stamp = READ_ONCE(fc->stamp);
+	unsigned int rate;
+
+	smp_rmb();
+	if (stamp && time_before(jiffies, stamp +
+	    msecs_to_jiffies(2 * READ_ONCE(tfreq_data.freq_cache_ms))))
+		return READ_ONCE(fc->rate);
+
+	rate = tegra194_fast_get_speed(cpu);
+	if (rate && !READ_ONCE(fc->rebase)) {
+		WRITE_ONCE(fc->rate, rate);
+		smp_wmb();
+		WRITE_ONCE(fc->stamp, jiffies);
+	}
+
+	return rate;
 }
 
 /**
@@ -246,28 +440,216 @@ static unsigned int tegra194_fast_get_speed(uint32_t cpu)
  */
 static unsigned long cluster_cpu_to_emc_freq(uint32_t cpu_rate)
 {
+	struct cpu_emc_profile *p = &cpu_emc_profiles[tfreq_data.emc_profile];
 	int i;
 
-	for (i = 0; i < cpu_emc_map_num; i++) {
-		if (cpu_rate >= cpu_emc_map_ptr[i].cpufreq)
-			return cpu_emc_map_ptr[i].emcfreq;
+	for (i = 0; i < p->num; i++) {
+		if (cpu_rate >= p->map[i].cpufreq)
+			return p->map[i].emcfreq;
 	}
 	return 0;
 }
 
+/* Caller holds emc_lock, returns KHz */
+static unsigned long cluster_emc_floor(struct per_cluster_data *pcl)
+{
+	unsigned long emc_freq;
+
+	emc_freq = cluster_cpu_to_emc_freq(pcl->emc_cpu_freq);
+	if (tfreq_data.emc_stall_scaling)
+		emc_freq = min(emc_freq * pcl->emc_scale / 100,
+			       tfreq_data.emc_max_rate / KHZ_TO_HZ);
+
+	return emc_freq;
+}
+
 /* Set emc clock by referring cpu_to_emc freq mapping */
 static void set_cpufreq_to_emcfreq(enum cluster cl, uint32_t cluster_freq)
 {
+	struct per_cluster_data *pcl = &tfreq_data.pcluster[cl];
 	unsigned long emc_freq;
 
-	emc_freq = cluster_cpu_to_emc_freq(cluster_freq);
+	mutex_lock(&tfreq_data.emc_lock);
+	pcl->emc_cpu_freq = cluster_freq;
+	emc_freq = cluster_emc_floor(pcl);
 
-	tegra_bwmgr_set_emc(tfreq_data.pcluster[cl].bwmgr,
+	tegra_bwmgr_set_emc(pcl->bwmgr,
 		emc_freq * KHZ_TO_HZ, TEGRA_BWMGR_SET_EMC_FLOOR);
+	mutex_unlock(&tfreq_data.emc_lock);
 	pr_debug("cluster %d, emc freq(KHz): %lu cluster_freq(KHz): %u\n",
 		cl, emc_freq, cluster_freq);
 }
 
+/* Re-apply the EMC floor of every cluster after a mode change */
+static void refresh_cpufreq_to_emcfreq(void)
+{
+	enum cluster cl;
+
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		if (tfreq_data.pcluster[cl].bwmgr &&
+		    tfreq_data.pcluster[cl].emc_cpu_freq)
+			set_cpufreq_to_emcfreq(cl,
+				tfreq_data.pcluster[cl].emc_cpu_freq);
+	}
+}
+
+static struct perf_event *tegra_cpu_stall_event(int cpu, u32 type,
+						u64 config)
+{
+	struct perf_event_attr attr = {
+		.type = type,
+		.config = config,
+		.size = sizeof(struct perf_event_attr),
+		.pinned = 1,
+	};
+	struct perf_event *event;
+
+	event = perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+	return IS_ERR(event) ? NULL : event;
+}
+
+static void tegra_cpu_stall_release(int cpu)
+{
+	struct tegra_cpu_stall *st = &per_cpu(cpu_stall, cpu);
+
+	if (st->cycles)
+		perf_event_release_kernel(st->cycles);
+	if (st->stalls)
+		perf_event_release_kernel(st->stalls);
+	st->cycles = NULL;
+	st->stalls = NULL;
+}
+
+/*
+ * Return the share of cycles stalled on the backend since the last call,
+ * in permille. Events are created on first use and recreated once the
+ * cpu has been through hotplug, the first sample only sets a baseline.
+ */
+static uint32_t tegra_cpu_stall_sample(int cpu)
+{
+	struct tegra_cpu_stall *st = &per_cpu(cpu_stall, cpu);
+	u64 cycles, stalls, enabled, running;
+	u64 delta_cycles, delta_stalls;
+
+	if (st->cycles && (st->cycles->state < PERF_EVENT_STATE_INACTIVE ||
+	    st->stalls->state < PERF_EVENT_STATE_INACTIVE))
+		tegra_cpu_stall_release(cpu);
+
+	if (!st->cycles) {
+		st->cycles = tegra_cpu_stall_event(cpu, PERF_TYPE_HARDWARE,
+						   PERF_COUNT_HW_CPU_CYCLES);
+		st->stalls = tegra_cpu_stall_event(cpu, PERF_TYPE_RAW,
+						   ARMV8_PMU_STALL_BACKEND);
+		if (!st->cycles || !st->stalls) {
+			tegra_cpu_stall_release(cpu);
+			return 0;
+		}
+		st->last_cycles = perf_event_read_value(st->cycles,
+							&enabled, &running);
+		st->last_stalls = perf_event_read_value(st->stalls,
+							&enabled, &running);
+		return 0;
+	}
+
+	cycles = perf_event_read_value(st->cycles, &enabled, &running);
+	stalls = perf_event_read_value(st->stalls, &enabled, &running);
+	delta_cycles = cycles - st->last_cycles;
+	delta_stalls = stalls - st->last_stalls;
+	st->last_cycles = cycles;
+	st->last_stalls = stalls;
+
+	if (!delta_cycles)
+		return 0;
+
+	return (uint32_t)min_t(u64, div64_u64(delta_stalls * 1000,
+					      delta_cycles), 1000);
+}
+
+/* Map a stall ratio (permille) to a EMC floor scale (percent) */
+static uint32_t emc_stall_to_scale(uint32_t stall)
+{
+	uint32_t lo = tfreq_data.emc_stall_lo_pct * 10;
+	uint32_t hi = tfreq_data.emc_stall_hi_pct * 10;
+	uint32_t min = tfreq_data.emc_scale_min_pct;
+	uint32_t max = tfreq_data.emc_scale_max_pct;
+
+	if (hi <= lo || max < min)
+		return 100;
+	if (stall <= lo)
+		return min;
+	if (stall >= hi)
+		return max;
+
+	return min + (max - min) * (stall - lo) / (hi - lo);
+}
+
+static void tegra_emc_stall_work_fn(struct work_struct *work)
+{
+	struct per_cluster_data *pcl;
+	uint32_t stall, scale;
+	enum cluster cl;
+	int cpu;
+
+	get_online_cpus();
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		pcl = &tfreq_data.pcluster[cl];
+		if (!pcl->configured || !pcl->bwmgr)
+			continue;
+
+		/* the most memory bound core sets the cluster's need */
+		stall = 0;
+		for_each_cpu_and(cpu, &pcl->cpu_mask, cpu_online_mask)
+			stall = max(stall, tegra_cpu_stall_sample(cpu));
+		scale = emc_stall_to_scale(stall);
+
+		mutex_lock(&tfreq_data.emc_lock);
+		pcl->emc_stall = stall;
+		if (scale == pcl->emc_scale || !pcl->emc_cpu_freq) {
+			pcl->emc_scale = scale;
+			mutex_unlock(&tfreq_data.emc_lock);
+			continue;
+		}
+		pcl->emc_scale = scale;
+		tegra_bwmgr_set_emc(pcl->bwmgr,
+			cluster_emc_floor(pcl) * KHZ_TO_HZ,
+			TEGRA_BWMGR_SET_EMC_FLOOR);
+		mutex_unlock(&tfreq_data.emc_lock);
+	}
+	put_online_cpus();
+
+	queue_delayed_work(system_freezable_wq, &tfreq_data.emc_stall_work,
+			   msecs_to_jiffies(tfreq_data.emc_stall_period_ms));
+}
+
+static void tegra_emc_stall_scaling(bool enable)
+{
+	enum cluster cl;
+	int cpu;
+
+	if (enable == tfreq_data.emc_stall_scaling)
+		return;
+
+	if (!enable) {
+		cancel_delayed_work_sync(&tfreq_data.emc_stall_work);
+		for_each_possible_cpu(cpu)
+			tegra_cpu_stall_release(cpu);
+	}
+
+	mutex_lock(&tfreq_data.emc_lock);
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		tfreq_data.pcluster[cl].emc_stall = 0;
+		tfreq_data.pcluster[cl].emc_scale = 100;
+	}
+	tfreq_data.emc_stall_scaling = enable;
+	mutex_unlock(&tfreq_data.emc_lock);
+
+	if (enable)
+		queue_delayed_work(system_freezable_wq,
+				   &tfreq_data.emc_stall_work, 0);
+	else
+		refresh_cpufreq_to_emcfreq();
+}
+
 static struct cpufreq_frequency_table *get_freqtable(uint8_t cpu)
 {
 	enum cluster cur_cl = get_cpu_cluster(cpu);
@@ -283,6 +665,32 @@ static void write_ndiv_request(void *val)
 	asm volatile("msr s3_0_c15_c0_4, %0" : : "r" (regval));
 }
 
+static void tegra_fast_ndiv_fn(void *data)
+{
+	struct tegra_fast_ndiv *fn = data;
+	uint64_t val;
+
+	/* full barrier, a newer request either lands here or re-queues */
+	atomic_xchg(&fn->pending, 0);
+	val = READ_ONCE(fn->ndiv);
+	write_ndiv_request(&val);
+}
+
+static void tegra_fast_write_ndiv(uint32_t cpu, uint64_t ndiv)
+{
+	struct tegra_fast_ndiv *fn = &per_cpu(fast_ndiv, cpu);
+
+	WRITE_ONCE(fn->ndiv, ndiv);
+	if (cpu == smp_processor_id()) {
+		write_ndiv_request(&ndiv);
+		return;
+	}
+
+	if (!atomic_xchg(&fn->pending, 1) &&
+	    smp_call_function_single_async(cpu, &fn->csd))
+		atomic_set(&fn->pending, 0); /* cpu went offline */
+}
+
 #ifdef CONFIG_DEBUG_FS
 /* Read freq request in ndiv for a cpu */
 static void read_ndiv_request(void *ret)
@@ -354,8 +762,10 @@ static int tegra194_set_speed(struct cpufreq_policy *policy, unsigned int index)
 	if (tegra_hypervisor_mode)
 		t194_update_cpu_speed_hv(tgt_freq, policy->cpu);
 	else
-		for_each_cpu(cpu, policy->cpus)
+		for_each_cpu(cpu, policy->cpus) {
 			tegra_update_cpu_speed(tgt_freq, cpu);
+			tegra_freq_cache_invalidate(cpu);
+		}
 
 	if (tfreq_data.pcluster[cl].bwmgr)
 		set_cpufreq_to_emcfreq(cl, tgt_freq);
@@ -418,6 +828,70 @@ static void enable_cc3(struct device_node *dn)
 	}
 }
 
+static void tegra_emc_irq_work_fn(struct irq_work *work)
+{
+	struct per_cluster_data *pcl = container_of(work,
+					struct per_cluster_data, emc_irq_work);
+
+	schedule_work(&pcl->emc_work);
+}
+
+static void tegra_emc_work_fn(struct work_struct *work)
+{
+	struct per_cluster_data *pcl = container_of(work,
+					struct per_cluster_data, emc_work);
+
+	set_cpufreq_to_emcfreq(pcl - tfreq_data.pcluster,
+			       READ_ONCE(pcl->emc_req_freq));
+}
+
+/**
+ * tegra194_fast_switch - set policy freq from scheduler context
+ * @policy - cpufreq policy per cluster
+ * @target_freq - in kHz
+ * The local cpu's NDIV request is written directly, the other cpus of
+ * the cluster get theirs through an async cross call and the EMC floor
+ * is updated from a work item since bwmgr may sleep.
+ * Returns the freq requested, CPUFREQ_ENTRY_INVALID on failure
+ */
+static unsigned int tegra194_fast_switch(struct cpufreq_policy *policy,
+					 unsigned int target_freq)
+{
+	struct mrq_cpu_ndiv_limits_response *nltbl;
+	struct cpufreq_frequency_table *ftbl;
+	struct per_cluster_data *pcl;
+	uint32_t tgt_freq;
+	uint16_t ndiv;
+	int cpu, idx;
+
+	pcl = &tfreq_data.pcluster[get_cpu_cluster(policy->cpu)];
+	nltbl = &pcl->ndiv_limits_tbl;
+	if (!nltbl->ref_clk_hz)
+		return CPUFREQ_ENTRY_INVALID;
+
+	ftbl = get_freqtable(policy->cpu);
+	idx = cpufreq_frequency_table_target(policy, target_freq,
+					     CPUFREQ_RELATION_L);
+	if (idx < 0)
+		return CPUFREQ_ENTRY_INVALID;
+	tgt_freq = ftbl[idx].frequency;
+
+	ndiv = map_freq_to_ndiv(nltbl, tgt_freq);
+	ndiv = clamp_ndiv(nltbl, ndiv);
+
+	for_each_cpu(cpu, policy->cpus) {
+		tegra_fast_write_ndiv(cpu, ndiv);
+		tegra_freq_cache_invalidate(cpu);
+	}
+
+	if (pcl->bwmgr && tgt_freq != policy->cur) {
+		WRITE_ONCE(pcl->emc_req_freq, tgt_freq);
+		irq_work_queue(&pcl->emc_irq_work);
+	}
+
+	return tgt_freq;
+}
+
 #ifdef CONFIG_DEBUG_FS
 #define RW_MODE			(S_IWUSR | S_IRUGO)
 #define RO_MODE			(S_IRUGO)
@@ -441,13 +915,33 @@ static int set_delay(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(freq_compute_fops, get_delay, set_delay,
 	"%llu\n");
 
+static int get_cache_ms(void *data, u64 *val)
+{
+	*val = tfreq_data.freq_cache_ms;
+
+	return 0;
+}
+
+static int set_cache_ms(void *data, u64 val)
+{
+	if (!val || val > FREQ_CACHE_MS_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(tfreq_data.freq_cache_ms, (uint32_t)val);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(freq_cache_fops, get_cache_ms, set_cache_ms,
+	"%llu\n");
+
 static int freq_get(void *data, u64 *val)
 {
 	uint64_t cpu = (uint64_t)data;
 
 	get_online_cpus();
 	if (cpu_online(cpu))
-		*val = tegra194_get_speed(cpu);
+		*val = tegra194_get_speed_common(cpu,
+					tfreq_data.freq_compute_delay);
 	else
 		*val = 0LL;
 	put_online_cpus();
@@ -624,7 +1118,147 @@ static int set_cc3_ndiv(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(cc3_ndiv_ops, get_cc3_ndiv, set_cc3_ndiv,
 	"%llu\n");
 
+static int cpu_emc_profile_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	for (i = 0; i < MAX_CPU_EMC_PROFILES; i++) {
+		if (!cpu_emc_profiles[i].num)
+			continue;
+		seq_printf(s, i == tfreq_data.emc_profile ? "[%s] " : "%s ",
+			   cpu_emc_profiles[i].name);
+	}
+	seq_puts(s, "\n");
+	return 0;
+}
+
+static int cpu_emc_profile_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpu_emc_profile_show, inode->i_private);
+}
+
+static ssize_t cpu_emc_profile_write(struct file *file,
+	const char __user *user_buf, size_t count, loff_t *ppos)
+{
+	char buf[16];
+	size_t len;
+	int i;
+
+	len = min(count, sizeof(buf) - 1);
+	if (copy_from_user(buf, user_buf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+
+	for (i = 0; i < MAX_CPU_EMC_PROFILES; i++)
+		if (sysfs_streq(buf, cpu_emc_profiles[i].name))
+			break;
+	if (i == MAX_CPU_EMC_PROFILES || !cpu_emc_profiles[i].num)
+		return -EINVAL;
+
+	mutex_lock(&tfreq_data.emc_lock);
+	tfreq_data.emc_profile = i;
+	mutex_unlock(&tfreq_data.emc_lock);
+	refresh_cpufreq_to_emcfreq();
+
+	return count;
+}
+
+static const struct file_operations cpu_emc_profile_fops = {
+	.open = cpu_emc_profile_open,
+	.read = seq_read,
+	.write = cpu_emc_profile_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int get_stall_scaling(void *data, u64 *val)
+{
+	*val = tfreq_data.emc_stall_scaling;
+
+	return 0;
+}
+
+static int set_stall_scaling(void *data, u64 val)
+{
+	tegra_emc_stall_scaling(!!val);
+
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(stall_scaling_fops, get_stall_scaling,
+	set_stall_scaling, "%llu\n");
+
+static int cpu_emc_status_show(struct seq_file *s, void *data)
+{
+	struct per_cluster_data *pcl;
+	enum cluster cl;
+
+	mutex_lock(&tfreq_data.emc_lock);
+	seq_printf(s, "profile: %s, stall scaling: %s\n",
+		   cpu_emc_profiles[tfreq_data.emc_profile].name,
+		   tfreq_data.emc_stall_scaling ? "on" : "off");
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		pcl = &tfreq_data.pcluster[cl];
+		if (!pcl->configured || !pcl->bwmgr)
+			continue;
+		seq_printf(s, "cluster%d: cpu %u KHz, stall %u.%u%%, scale %u%%, emc floor %lu KHz\n",
+			   cl, pcl->emc_cpu_freq, pcl->emc_stall / 10,
+			   pcl->emc_stall % 10, pcl->emc_scale,
+			   cluster_emc_floor(pcl));
+	}
+	mutex_unlock(&tfreq_data.emc_lock);
+
+	return 0;
+}
+
+static int cpu_emc_status_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cpu_emc_status_show, inode->i_private);
+}
+
+static const struct file_operations cpu_emc_status_fops = {
+	.open = cpu_emc_status_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static struct dentry *tegra_cpufreq_debugfs_root;
+static int __init cpu_emc_debug_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("cpu_emc", tegra_cpufreq_debugfs_root);
+	if (!dir)
+		return -ENOMEM;
+
+	if (!debugfs_create_file("profile", RW_MODE, dir, NULL,
+		&cpu_emc_profile_fops))
+		return -ENOMEM;
+	if (!debugfs_create_file("stall_scaling", RW_MODE, dir, NULL,
+		&stall_scaling_fops))
+		return -ENOMEM;
+	if (!debugfs_create_file("status", RO_MODE, dir, NULL,
+		&cpu_emc_status_fops))
+		return -ENOMEM;
+	if (!debugfs_create_u32("stall_period_ms", RW_MODE, dir,
+		&tfreq_data.emc_stall_period_ms))
+		return -ENOMEM;
+	if (!debugfs_create_u32("stall_lo_pct", RW_MODE, dir,
+		&tfreq_data.emc_stall_lo_pct))
+		return -ENOMEM;
+	if (!debugfs_create_u32("stall_hi_pct", RW_MODE, dir,
+		&tfreq_data.emc_stall_hi_pct))
+		return -ENOMEM;
+	if (!debugfs_create_u32("scale_min_pct", RW_MODE, dir,
+		&tfreq_data.emc_scale_min_pct))
+		return -ENOMEM;
+	if (!debugfs_create_u32("scale_max_pct", RW_MODE, dir,
+		&tfreq_data.emc_scale_max_pct))
+		return -ENOMEM;
+
+	return 0;
+}
+
 static int __init cc3_debug_init(void)
 {
 	struct dentry *dir;
@@ -686,9 +1320,19 @@ static int __init tegra_cpufreq_debug_init(void)
 					&freq_compute_fops))
 		goto err_out;
 
+	if (!tegra_hypervisor_mode &&
+	    !debugfs_create_file("freq_cache_ms", RW_MODE,
+				 tegra_cpufreq_debugfs_root,
+					NULL,
+					&freq_cache_fops))
+		goto err_out;
+
 	if (cc3_debug_init())
 		goto err_out;
 
+	if (cpu_emc_debug_init())
+		goto err_out;
+
 	for_each_possible_cpu(cpu) {
 		snprintf(buff, sizeof(buff), "cpu%llu", cpu);
 		dir = debugfs_create_dir(buff, tegra_cpufreq_debugfs_root);
@@ -755,6 +1399,9 @@ static int tegra194_cpufreq_init(struct cpufreq_policy *policy)
 	policy->cpuinfo.transition_latency =
 	TEGRA_CPUFREQ_TRANSITION_LATENCY;
 
+	/* cpufreq server handles rate changes over IVC in hypervisor mode */
+	policy->fast_switch_possible = !tegra_hypervisor_mode;
+
 	cpumask_copy(policy->cpus, &tfreq_data.pcluster[cl].cpu_mask);
 
 	return ret;
@@ -768,9 +1415,14 @@ static int tegra194_cpufreq_exit(struct cpufreq_policy *policy)
 	ftbl = get_freqtable(policy->cpu);
 	cpufreq_frequency_table_cpuinfo(policy, ftbl);
 	cl = get_cpu_cluster(policy->cpu);
+	irq_work_sync(&tfreq_data.pcluster[cl].emc_irq_work);
+	cancel_work_sync(&tfreq_data.pcluster[cl].emc_work);
+	mutex_lock(&tfreq_data.emc_lock);
+	tfreq_data.pcluster[cl].emc_cpu_freq = 0;
 	if (tfreq_data.pcluster[cl].bwmgr)
 		tegra_bwmgr_set_emc(tfreq_data.pcluster[cl].bwmgr, 0,
 			TEGRA_BWMGR_SET_EMC_FLOOR);
+	mutex_unlock(&tfreq_data.emc_lock);
 
 	return 0;
 }
@@ -781,6 +1433,7 @@ static struct cpufreq_driver tegra_cpufreq_driver = {
 				CPUFREQ_CONST_LOOPS,
 	.verify = cpufreq_generic_frequency_table_verify,
 	.target_index = tegra194_set_speed,
+	.fast_switch = tegra194_fast_switch,
 	.get = tegra194_get_speed,
 	.init = tegra194_cpufreq_init,
 	.exit = tegra194_cpufreq_exit,
@@ -1072,19 +1725,29 @@ err_out:
 
 static void tegra_cpufreq_cpu_emc_map_init(struct device_node *dn)
 {
+	struct cpu_emc_profile *p;
 	struct property *prop;
-	int len;
+	int i, len;
 
-	prop = of_find_property(dn, "cpu_emc_map", &len);
-	if (prop) {
+	for (i = 0; i < MAX_CPU_EMC_PROFILES; i++) {
+		p = &cpu_emc_profiles[i];
+		prop = of_find_property(dn, p->prop, &len);
+		if (!prop)
+			continue;
 		len = rounddown(len, sizeof(struct cpu_emc_map));
-		cpu_emc_map_ptr = kzalloc(len, GFP_KERNEL);
-		if (cpu_emc_map_ptr) {
-			of_property_read_u32_array(dn, "cpu_emc_map",
-				(u32 *)cpu_emc_map_ptr, len / sizeof(uint32_t));
-			cpu_emc_map_num = len / sizeof(struct cpu_emc_map);
+		p->map = kzalloc(len, GFP_KERNEL);
+		if (p->map) {
+			of_property_read_u32_array(dn, p->prop,
+				(u32 *)p->map, len / sizeof(uint32_t));
+			p->num = len / sizeof(struct cpu_emc_map);
 		}
 	}
+
+	tfreq_data.emc_stall_period_ms = EMC_STALL_PERIOD_MS;
+	tfreq_data.emc_stall_lo_pct = EMC_STALL_LO_PCT;
+	tfreq_data.emc_stall_hi_pct = EMC_STALL_HI_PCT;
+	tfreq_data.emc_scale_min_pct = EMC_SCALE_MIN_PCT;
+	tfreq_data.emc_scale_max_pct = EMC_SCALE_MAX_PCT;
 }
 
 static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
@@ -1097,13 +1760,24 @@ static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
 	tegra_cpufreq_cpu_emc_map_init(dn);
 
 	mutex_init(&tfreq_data.mlock);
+	mutex_init(&tfreq_data.emc_lock);
+	INIT_DELAYED_WORK(&tfreq_data.emc_stall_work, tegra_emc_stall_work_fn);
 	tfreq_data.freq_compute_delay = US_DELAY;
+	tfreq_data.freq_cache_ms = FREQ_CACHE_MS;
 	tegra_hypervisor_mode = is_tegra_hypervisor_mode();
 
 	for_each_possible_cpu(cpu) {
 		cl = get_cpu_cluster(cpu);
 		if (!tfreq_data.pcluster[cl].configured)
 			tfreq_data.pcluster[cl].configured = 1;
+		per_cpu(fast_ndiv, cpu).csd.func = tegra_fast_ndiv_fn;
+		per_cpu(fast_ndiv, cpu).csd.info = &per_cpu(fast_ndiv, cpu);
+	}
+
+	LOOP_FOR_EACH_CLUSTER(cl) {
+		init_irq_work(&tfreq_data.pcluster[cl].emc_irq_work,
+			      tegra_emc_irq_work_fn);
+		INIT_WORK(&tfreq_data.pcluster[cl].emc_work, tegra_emc_work_fn);
 	}
 
 	set_cpu_mask();
@@ -1130,8 +1804,9 @@ static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
 	}
 
 	tfreq_data.emc_max_rate = tegra_bwmgr_get_max_emc_rate();
-	if (cpu_emc_map_ptr)
-		cpu_emc_map_ptr[0].emcfreq = tfreq_data.emc_max_rate / 1000;
+	if (cpu_emc_profiles[CPU_EMC_PROFILE_DEFAULT].map)
+		cpu_emc_profiles[CPU_EMC_PROFILE_DEFAULT].map[0].emcfreq =
+			tfreq_data.emc_max_rate / 1000;
 
 	ret = get_ndiv_limits_tbl_from_bpmp();
 	if (ret)
@@ -1151,14 +1826,33 @@ static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
 	if (ret)
 		goto err_free_res;
 
+	if (!tegra_hypervisor_mode) {
+		ret = cpuhp_setup_state(CPUHP_AP_ONLINE_DYN,
+					"tegra194_cpufreq:online",
+					tegra_freq_cache_online,
+					tegra_freq_cache_offline);
+		if (ret < 0) {
+			pr_err("tegra19x-cpufreq: fail to register cpuhp state\n");
+			goto err_free_res;
+		}
+		freq_cache_hp_state = ret;
+		ret = 0;
+	}
+
 	ret = cpufreq_register_driver(&tegra_cpufreq_driver);
-	if (ret)
+	if (ret) {
+		if (freq_cache_hp_state)
+			cpuhp_remove_state(freq_cache_hp_state);
 		goto err_free_res;
+	}
 
 	pm_qos_register_notifier();
 
 	cpufreq_register_notifier(&tegra_boundaries_cpufreq_nb,
 					CPUFREQ_POLICY_NOTIFIER);
+
+	if (of_property_read_bool(dn, "nvidia,cpu-emc-stall-scaling"))
+		tegra_emc_stall_scaling(true);
 	goto err_out;
 err_free_res:
 	free_allocated_res_init();
@@ -1176,7 +1870,10 @@ static int __exit tegra194_cpufreq_remove(struct platform_device *pdev)
 #ifdef CONFIG_DEBUG_FS
 	tegra_cpufreq_debug_exit();
 #endif
+	tegra_emc_stall_scaling(false);
 	cpufreq_unregister_driver(&tegra_cpufreq_driver);
+	if (freq_cache_hp_state)
+		cpuhp_remove_state(freq_cache_hp_state);
 	free_allocated_res_exit();
 	return 0;
 }
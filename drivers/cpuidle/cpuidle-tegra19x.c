@@ -34,12 +34,15 @@
 #include <linux/psci.h>
 #include <linux/version.h>
 #include <linux/cpuhotplug.h>
+#include <linux/seq_file.h>
+#include <linux/atomic.h>
 
 #include <linux/of_gpio.h>
 #include <asm/cpuidle.h>
 #include <asm/suspend.h>
 #include <asm/cputype.h> /* cpuid */
 #include <asm/cpu.h>
+#include <asm/smp_plat.h>
 #include <asm/arch_timer.h>
 #include "../../drivers/cpuidle/dt_idle_states.h"
 #include "../../kernel/time/tick-internal.h"
@@ -76,6 +79,52 @@ static enum cpuhp_state hp_state;
 #define T19x_NVG_CROSSOVER_CC6	TEGRA_NVG_CHANNEL_CROSSOVER_CC6_LOWER_BOUND
 #define T19x_NVG_CROSSOVER_CG7	TEGRA_NVG_CHANNEL_CROSSOVER_CG7_LOWER_BOUND
 
+/*
+ * Adaptive crossover: the MCE only picks C6/CC6/CG7 when the timer based
+ * wake time clears the crossover, which says nothing about device IRQs
+ * waking the core early. Each cpu (C6) and cluster (CC6, CG7) learns its
+ * own crossover from observed residency, net of the state's exit latency:
+ * idles going deep and waking before the static crossover paid off push
+ * it up, idles held shallow that would have paid off pull it back down.
+ * The static DT/debugfs value is the floor.
+ */
+#define T19x_MAX_CLUSTERS	4
+#define XOVER_WINDOW		64	/* samples per adjustment */
+#define XOVER_WASTED_PCT	25	/* raise above this share wasted */
+#define XOVER_MISSED_PCT	25	/* lower above this share missed */
+#define XOVER_MAX_SCALE		8	/* cap, x static crossover */
+
+enum t19x_xover {
+	XOVER_C6,
+	XOVER_CC6,
+	XOVER_CG7,
+	XOVER_MAX,
+};
+
+static const u32 xover_nvg_index[XOVER_MAX] = {
+	T19x_NVG_CROSSOVER_C6,
+	T19x_NVG_CROSSOVER_CC6,
+	T19x_NVG_CROSSOVER_CG7,
+};
+
+struct t19x_xover_win {
+	atomic_t samples;
+	atomic_t wasted;	/* went deep, woke too early */
+	atomic_t missed;	/* held shallow, slept long enough */
+	u32 learned;		/* us */
+};
+
+struct t19x_cpu_xover {
+	struct t19x_xover_win c6;
+	u32 cluster;
+	u32 programmed[XOVER_MAX]; /* us, as last sent to this core's MCE */
+};
+
+static DEFINE_PER_CPU(struct t19x_cpu_xover, cpu_xover);
+static struct t19x_xover_win cluster_xover[T19x_MAX_CLUSTERS][XOVER_MAX];
+static u32 base_xover[XOVER_MAX]; /* us, static crossover */
+static u32 adaptive_xover = 1;
+
 static bool check_mce_version(void)
 {
 	u32 mce_version_major, mce_version_minor;
@@ -100,6 +149,108 @@ static void t19x_cpu_enter_c7(u32 wake_time)
 	cpu_pm_exit();
 }
 
+static struct t19x_xover_win *t19x_xover_win(int cpu, enum t19x_xover i)
+{
+	struct t19x_cpu_xover *cx = &per_cpu(cpu_xover, cpu);
+
+	if (i == XOVER_C6)
+		return &cx->c6;
+	return &cluster_xover[cx->cluster][i];
+}
+
+static void t19x_xover_reset(void)
+{
+	struct t19x_xover_win *w;
+	int cpu, i;
+
+	for_each_possible_cpu(cpu)
+		for (i = 0; i < XOVER_MAX; i++) {
+			w = t19x_xover_win(cpu, i);
+			WRITE_ONCE(w->learned, base_xover[i]);
+			atomic_set(&w->samples, 0);
+			atomic_set(&w->wasted, 0);
+			atomic_set(&w->missed, 0);
+		}
+}
+
+/* Send the learned crossovers to the local core's MCE, if they moved */
+static void t19x_xover_sync(void)
+{
+	int cpu = smp_processor_id();
+	struct t19x_cpu_xover *cx = &per_cpu(cpu_xover, cpu);
+	u32 val;
+	int i;
+
+	for (i = 0; i < XOVER_MAX; i++) {
+		val = READ_ONCE(t19x_xover_win(cpu, i)->learned);
+		if (val == cx->programmed[i])
+			continue;
+		tegra_mce_update_crossover_time(xover_nvg_index[i],
+						val * tsc_per_usec);
+		cx->programmed[i] = val;
+	}
+}
+
+static u32 t19x_xover_adjust(enum t19x_xover i, u32 learned,
+			     u32 wasted, u32 missed)
+{
+	u32 base = base_xover[i];
+
+	if (wasted * 100 > XOVER_WASTED_PCT * XOVER_WINDOW)
+		return min(learned * 2, base * XOVER_MAX_SCALE);
+	if (missed * 100 > XOVER_MISSED_PCT * XOVER_WINDOW && missed > wasted)
+		return max(learned / 2, base);
+
+	return learned;
+}
+
+static void t19x_xover_account(int cpu, enum t19x_xover i,
+			       u32 predicted_us, u32 residency_us)
+{
+	struct t19x_xover_win *w = t19x_xover_win(cpu, i);
+	u32 learned = READ_ONCE(w->learned);
+	u32 wasted, missed;
+
+	/* nothing to learn below the static crossover */
+	if (!base_xover[i] || predicted_us < base_xover[i])
+		return;
+
+	if (predicted_us >= learned) {
+		if (residency_us < base_xover[i])
+			atomic_inc(&w->wasted);
+	} else if (residency_us >= learned) {
+		atomic_inc(&w->missed);
+	}
+
+	if (atomic_inc_return(&w->samples) != XOVER_WINDOW)
+		return;
+
+	wasted = atomic_xchg(&w->wasted, 0);
+	missed = atomic_xchg(&w->missed, 0);
+	atomic_set(&w->samples, 0);
+	WRITE_ONCE(w->learned, t19x_xover_adjust(i, learned, wasted, missed));
+}
+
+static void t19x_xover_update(int cpu, struct cpuidle_driver *drv,
+			      int index, ktime_t sleep, ktime_t entry)
+{
+	u32 predicted_us, residency_us;
+	s64 residency;
+	int i;
+
+	residency = ktime_us_delta(ktime_get(), entry) -
+			drv->states[index].exit_latency;
+	residency_us = residency > 0 ? (u32)residency : 0;
+	predicted_us = (u32)min_t(s64, ktime_to_us(sleep), U32_MAX);
+
+	/*
+	 * A core's residency bounds its cluster's, so it is a fair (if
+	 * optimistic) stand-in for the cluster states as well.
+	 */
+	for (i = 0; i < XOVER_MAX; i++)
+		t19x_xover_account(cpu, i, predicted_us, residency_us);
+}
+
 static int t19x_cpu_enter_state(
 		struct cpuidle_device *dev,
 		struct cpuidle_driver *drv,
@@ -107,15 +258,25 @@ static int t19x_cpu_enter_state(
 {
 	u32 wake_time;
 	struct timespec t;
+	ktime_t sleep, entry = ktime_set(0, 0);
+	bool adapt;
 
 	if (tegra_platform_is_vdk()) {
 		asm volatile("wfi\n");
 		return index;
 	}
 
-	t = ktime_to_timespec(tick_nohz_get_sleep_length());
+	sleep = tick_nohz_get_sleep_length();
+	t = ktime_to_timespec(sleep);
 	wake_time = t.tv_sec * tsc_per_sec + t.tv_nsec / nsec_per_tsc_tick;
 
+	adapt = !testmode && READ_ONCE(adaptive_xover) &&
+		index >= T19x_CPUIDLE_C6_STATE;
+	if (adapt) {
+		t19x_xover_sync();
+		entry = ktime_get();
+	}
+
 	if (testmode) {
 		tegra_mce_update_cstate_info(forced_cluster_idle_state,
 				0, 0, 0, 0, 0);
@@ -136,6 +297,9 @@ static int t19x_cpu_enter_state(
 	else
 		asm volatile("wfi\n");
 
+	if (adapt)
+		t19x_xover_update(dev->cpu, drv, index, sleep, entry);
+
 	return index;
 }
 
@@ -302,8 +466,14 @@ static void program_single_crossover(void *data)
 {
 	struct xover_smp_call_data *xover_data =
 		(struct xover_smp_call_data *)data;
+	struct t19x_cpu_xover *cx = this_cpu_ptr(&cpu_xover);
+	int i;
+
 	tegra_mce_update_crossover_time(xover_data->index,
 					xover_data->value * tsc_per_usec);
+	for (i = 0; i < XOVER_MAX; i++)
+		if (xover_nvg_index[i] == xover_data->index)
+			cx->programmed[i] = xover_data->value;
 }
 
 static int setup_crossover(int index, int value)
@@ -318,21 +488,81 @@ static int setup_crossover(int index, int value)
 	return 0;
 }
 
+static int set_base_crossover(enum t19x_xover i, u32 val)
+{
+	base_xover[i] = val;
+	t19x_xover_reset();
+	return setup_crossover(xover_nvg_index[i], val);
+}
+
 static int c6_xover_write(void *data, u64 val)
 {
-	return setup_crossover(T19x_NVG_CROSSOVER_C6, (u32) val);
+	return set_base_crossover(XOVER_C6, (u32) val);
 }
 
 static int cc6_xover_write(void *data, u64 val)
 {
-	return setup_crossover(T19x_NVG_CROSSOVER_CC6, (u32) val);
+	return set_base_crossover(XOVER_CC6, (u32) val);
 }
 
 static int cg7_xover_write(void *data, u64 val)
 {
-	return setup_crossover(T19x_NVG_CROSSOVER_CG7, (u32) val);
+	return set_base_crossover(XOVER_CG7, (u32) val);
+}
+
+static int adaptive_xover_set(void *data, u64 val)
+{
+	int i;
+
+	WRITE_ONCE(adaptive_xover, !!val);
+	t19x_xover_reset();
+	if (!val && !testmode)
+		for (i = 0; i < XOVER_MAX; i++)
+			setup_crossover(xover_nvg_index[i], base_xover[i]);
+	return 0;
 }
 
+static int adaptive_xover_get(void *data, u64 *val)
+{
+	*val = (u64) adaptive_xover;
+	return 0;
+}
+
+static int xover_status_show(struct seq_file *s, void *data)
+{
+	struct t19x_cpu_xover *cx;
+	int cpu;
+
+	seq_printf(s, "static (us): c6 %u cc6 %u cg7 %u\n",
+		   base_xover[XOVER_C6], base_xover[XOVER_CC6],
+		   base_xover[XOVER_CG7]);
+	seq_puts(s, "cpu cluster learned c6 cc6 cg7 / programmed (us)\n");
+	for_each_possible_cpu(cpu) {
+		cx = &per_cpu(cpu_xover, cpu);
+		seq_printf(s, "%3d %7u %5u %5u %5u / %5u %5u %5u\n",
+			   cpu, cx->cluster,
+			   READ_ONCE(t19x_xover_win(cpu, XOVER_C6)->learned),
+			   READ_ONCE(t19x_xover_win(cpu, XOVER_CC6)->learned),
+			   READ_ONCE(t19x_xover_win(cpu, XOVER_CG7)->learned),
+			   cx->programmed[XOVER_C6],
+			   cx->programmed[XOVER_CC6],
+			   cx->programmed[XOVER_CG7]);
+	}
+	return 0;
+}
+
+static int xover_status_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, xover_status_show, inode->i_private);
+}
+
+static const struct file_operations xover_status_fops = {
+	.open		= xover_status_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int set_testmode(void *data, u64 val)
 {
 	testmode = (u32)val;
@@ -392,6 +622,8 @@ DEFINE_SIMPLE_ATTRIBUTE(cc_state_fops, cc_state_get,
 DEFINE_SIMPLE_ATTRIBUTE(cg_state_fops, cg_state_get,
 						cg_state_set, "%llu\n");
 DEFINE_SIMPLE_ATTRIBUTE(testmode_fops, NULL, set_testmode, "%llu\n");
+DEFINE_SIMPLE_ATTRIBUTE(adaptive_xover_fops, adaptive_xover_get,
+						adaptive_xover_set, "%llu\n");
 
 static int cpuidle_debugfs_init(void)
 {
@@ -439,6 +671,16 @@ static int cpuidle_debugfs_init(void)
 	if (!dfs_file)
 		goto err_out;
 
+	dfs_file = debugfs_create_file("adaptive_crossover", 0644,
+		cpuidle_debugfs_node, NULL, &adaptive_xover_fops);
+	if (!dfs_file)
+		goto err_out;
+
+	dfs_file = debugfs_create_file("crossover_status", 0444,
+		cpuidle_debugfs_node, NULL, &xover_status_fops);
+	if (!dfs_file)
+		goto err_out;
+
 	dfs_file = debugfs_create_file("deepest_cc_state", 0644,
 		cpuidle_debugfs_node, NULL, &cc_state_fops);
 	if (!dfs_file)
@@ -502,6 +744,7 @@ static u32 read_cluster_info(struct device_node *of_states)
 struct xover_table {
 	char *name;
 	int index;
+	enum t19x_xover xover;
 };
 
 static void send_crossover(void *data)
@@ -511,18 +754,23 @@ static void send_crossover(void *data)
 	u32 value;
 	int i;
 
+	struct t19x_cpu_xover *cx = this_cpu_ptr(&cpu_xover);
+
 	struct xover_table table1[] = {
-		{"crossover_c1_c6", T19x_NVG_CROSSOVER_C6},
-		{"crossover_cc1_cc6", T19x_NVG_CROSSOVER_CC6},
-		{"crossover_cc1_cg7", T19x_NVG_CROSSOVER_CG7},
+		{"crossover_c1_c6", T19x_NVG_CROSSOVER_C6, XOVER_C6},
+		{"crossover_cc1_cc6", T19x_NVG_CROSSOVER_CC6, XOVER_CC6},
+		{"crossover_cc1_cg7", T19x_NVG_CROSSOVER_CG7, XOVER_CG7},
 	};
 
 	for_each_child_of_node(of_states, child)
 		for (i = 0; i < sizeof(table1)/sizeof(table1[0]); i++) {
 			if (of_property_read_u32(child,
-				table1[i].name, &value) == 0)
+				table1[i].name, &value) == 0) {
 				tegra_mce_update_crossover_time
 					(table1[i].index, value * tsc_per_usec);
+				base_xover[table1[i].xover] = value;
+				cx->programmed[table1[i].xover] = value;
+			}
 	}
 }
 
@@ -542,6 +790,8 @@ static int crossover_init(void)
 		on_each_cpu_mask(cpu_online_mask, send_crossover,
 			cpu_xover, 1);
 
+	t19x_xover_reset();
+
 	return 0;
 }
 
@@ -611,6 +861,11 @@ static int __init tegra19x_cpuidle_probe(struct platform_device *pdev)
 	nsec_per_tsc_tick = 1000000000/tsc_per_sec;
 	tsc_per_usec = tsc_per_sec / 1000000;
 
+	for_each_possible_cpu(cpu_number)
+		per_cpu(cpu_xover, cpu_number).cluster = min_t(u32,
+			MPIDR_AFFINITY_LEVEL(cpu_logical_map(cpu_number), 1),
+			T19x_MAX_CLUSTERS - 1);
+
 	cpumask = kmalloc(sizeof(struct cpumask), GFP_KERNEL);
 	cpumask_clear(cpumask);
 
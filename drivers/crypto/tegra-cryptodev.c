@@ -28,6 +28,10 @@
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
 #include <linux/crypto.h>
+#include <linux/mm.h>
+#include <linux/eventfd.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
 #include <linux/scatterlist.h>
 #include <linux/uaccess.h>
 #include <linux/nospec.h>
@@ -52,6 +56,14 @@
 #define MAX_RSA_MSG_LEN 256
 #define MAX_RSA1_MSG_LEN 512
 
+/*
+ * AES requests of at least this size run on the user pages themselves
+ * rather than being bounced through kernel pages, in chunks of up to
+ * TEGRA_CRYPTO_PIN_PAGES pages pinned at a time.
+ */
+#define TEGRA_CRYPTO_PIN_MIN_SIZE (2 * PAGE_SIZE)
+#define TEGRA_CRYPTO_PIN_PAGES 16
+
 enum tegra_se_pka1_ecc_type {
 	ECC_POINT_MUL,
 	ECC_POINT_ADD,
@@ -76,6 +88,18 @@ struct tegra_crypto_ctx {
 	u8 seed[TEGRA_CRYPTO_RNG_SEED_SIZE];
 	int use_ssk;
 	bool skip_exit;
+
+	/* asynchronous AES requests */
+	spinlock_t async_lock;
+	struct list_head async_done; /* completed, not reaped yet */
+	unsigned int async_pending; /* submitted, not reaped yet */
+	unsigned int async_inflight[TEGRA_CRYPTO_MAX]; /* still on the engine */
+	wait_queue_head_t async_wq;
+	struct eventfd_ctx *async_eventfd;
+	struct mutex async_mutex; /* serialises submission and rekeying */
+	struct crypto_skcipher *async_tfm[TEGRA_CRYPTO_MAX];
+	u8 async_key[TEGRA_CRYPTO_MAX][TEGRA_CRYPTO_MAX_KEY_SIZE];
+	unsigned int async_keylen[TEGRA_CRYPTO_MAX];
 };
 
 struct tegra_crypto_completion {
@@ -140,6 +164,373 @@ static void free_bufs(unsigned long *buf[NBUFS])
 		free_page((unsigned long)buf[i]);
 }
 
+struct tegra_crypto_async_req {
+	struct list_head node;
+	struct tegra_crypto_ctx *ctx;
+	struct skcipher_request *req;
+	struct scatterlist sg;
+	unsigned int op;
+	u64 tag;
+	u64 result;
+	unsigned int size;
+	int status;
+	u8 iv[TEGRA_CRYPTO_IV_SIZE];
+	u8 buf[];
+};
+
+static const char * const tegra_crypto_async_algo[TEGRA_CRYPTO_MAX] = {
+	"ecb(aes)", "cbc(aes)", "ofb(aes)", "ctr(aes)", "xts(aes)",
+};
+
+static bool tegra_crypto_async_op_idle(struct tegra_crypto_ctx *ctx,
+				       unsigned int op)
+{
+	unsigned long flags;
+	bool idle;
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	idle = !ctx->async_inflight[op];
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+	return idle;
+}
+
+static bool tegra_crypto_async_idle(struct tegra_crypto_ctx *ctx)
+{
+	unsigned int op;
+
+	for (op = 0; op < TEGRA_CRYPTO_MAX; op++)
+		if (!tegra_crypto_async_op_idle(ctx, op))
+			return false;
+
+	return true;
+}
+
+static bool tegra_crypto_async_ready(struct tegra_crypto_ctx *ctx)
+{
+	unsigned long flags;
+	bool ready;
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	ready = !list_empty(&ctx->async_done) || !ctx->async_pending;
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+	return ready;
+}
+
+static void tegra_crypto_async_free(struct tegra_crypto_async_req *areq)
+{
+	skcipher_request_free(areq->req);
+	kzfree(areq);
+}
+
+/* May run in interrupt context once the engine is done with the request */
+static void tegra_crypto_async_complete(struct crypto_async_request *req,
+					int err)
+{
+	struct tegra_crypto_async_req *areq = req->data;
+	struct tegra_crypto_ctx *ctx = areq->ctx;
+	unsigned long flags;
+
+	if (err == -EINPROGRESS)
+		return;
+
+	areq->status = err;
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	ctx->async_inflight[areq->op]--;
+	list_add_tail(&areq->node, &ctx->async_done);
+	if (ctx->async_eventfd)
+		eventfd_signal(ctx->async_eventfd, 1);
+	/* under the lock, release may free ctx as soon as it is dropped */
+	wake_up_all(&ctx->async_wq);
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+}
+
+/*
+ * Each mode keeps one tfm for asynchronous requests. The key is only
+ * reprogrammed when it changes, and only once the requests queued on the
+ * old key are done with it. Called with async_mutex held.
+ */
+static struct crypto_skcipher *tegra_crypto_async_get_tfm(
+		struct tegra_crypto_ctx *ctx, struct tegra_crypt_async_req *req)
+{
+	struct crypto_skcipher *tfm = ctx->async_tfm[req->op];
+	const u8 *key = NULL;
+	int ret;
+
+	if (!tfm) {
+		tfm = crypto_alloc_skcipher(tegra_crypto_async_algo[req->op],
+			CRYPTO_ALG_TYPE_ABLKCIPHER | CRYPTO_ALG_ASYNC, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("Failed to load transform for %s: %ld\n",
+				tegra_crypto_async_algo[req->op],
+				PTR_ERR(tfm));
+			return tfm;
+		}
+		ctx->async_tfm[req->op] = tfm;
+		ctx->async_keylen[req->op] = 0;
+	}
+
+	/* SSK requests always reload, the key bytes mean nothing then */
+	if (!ctx->use_ssk && ctx->async_keylen[req->op] == req->keylen &&
+	    !memcmp(ctx->async_key[req->op], req->key, req->keylen))
+		return tfm;
+
+	wait_event(ctx->async_wq, tegra_crypto_async_op_idle(ctx, req->op));
+
+	if (!ctx->use_ssk)
+		key = req->key;
+
+	crypto_skcipher_clear_flags(tfm, ~0);
+	ret = crypto_skcipher_setkey(tfm, key, req->keylen);
+	if (ret < 0) {
+		pr_err("setkey failed");
+		ctx->async_keylen[req->op] = 0;
+		return ERR_PTR(ret);
+	}
+
+	if (ctx->use_ssk) {
+		ctx->async_keylen[req->op] = 0;
+	} else {
+		memcpy(ctx->async_key[req->op], req->key, req->keylen);
+		ctx->async_keylen[req->op] = req->keylen;
+	}
+
+	return tfm;
+}
+
+static int tegra_crypto_async_submit(struct tegra_crypto_ctx *ctx,
+				     unsigned long arg)
+{
+	struct tegra_crypt_async_req req;
+	struct tegra_crypto_async_req *areq;
+	struct crypto_skcipher *tfm;
+	unsigned long flags;
+	unsigned int keylen;
+	int ret;
+
+	if (copy_from_user(&req, (void __user *)arg, sizeof(req)))
+		return -EFAULT;
+
+	if (req.op >= TEGRA_CRYPTO_MAX)
+		return -EINVAL;
+	req.op = array_index_nospec(req.op, TEGRA_CRYPTO_MAX);
+
+	keylen = req.keylen & CRYPTO_KEY_LEN_MASK;
+	if (keylen != TEGRA_CRYPTO_KEY_128_SIZE &&
+	    keylen != TEGRA_CRYPTO_KEY_192_SIZE &&
+	    keylen != TEGRA_CRYPTO_KEY_256_SIZE &&
+	    keylen != TEGRA_CRYPTO_KEY_512_SIZE) {
+		pr_err("crypt_req keylen invalid");
+		return -EINVAL;
+	}
+
+	if (!req.plaintext_sz ||
+	    req.plaintext_sz > TEGRA_CRYPTO_MAX_ASYNC_SIZE)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	if (ctx->async_pending >= TEGRA_CRYPTO_MAX_ASYNC_REQS) {
+		spin_unlock_irqrestore(&ctx->async_lock, flags);
+		return -EBUSY;
+	}
+	ctx->async_pending++;
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+	areq = kzalloc(sizeof(*areq) + req.plaintext_sz, GFP_KERNEL);
+	if (!areq) {
+		ret = -ENOMEM;
+		goto unreserve;
+	}
+
+	areq->ctx = ctx;
+	areq->op = req.op;
+	areq->tag = req.tag;
+	areq->result = req.result;
+	areq->size = req.plaintext_sz;
+	memcpy(areq->iv, req.iv, TEGRA_CRYPTO_IV_SIZE);
+
+	if (copy_from_user(areq->buf, u64_to_user_ptr(req.plaintext),
+			   areq->size)) {
+		ret = -EFAULT;
+		goto free_areq;
+	}
+
+	mutex_lock(&ctx->async_mutex);
+
+	tfm = tegra_crypto_async_get_tfm(ctx, &req);
+	if (IS_ERR(tfm)) {
+		ret = PTR_ERR(tfm);
+		goto unlock;
+	}
+
+	areq->req = skcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!areq->req) {
+		pr_err("%s: Failed to allocate request\n", __func__);
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	skcipher_request_set_callback(areq->req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypto_async_complete, areq);
+	sg_init_one(&areq->sg, areq->buf, areq->size);
+	skcipher_request_set_crypt(areq->req, &areq->sg, &areq->sg,
+		areq->size, req.skip_iv ? NULL : areq->iv);
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	ctx->async_inflight[areq->op]++;
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+	if (req.encrypt)
+		ret = crypto_skcipher_encrypt(areq->req);
+	else
+		ret = crypto_skcipher_decrypt(areq->req);
+
+	mutex_unlock(&ctx->async_mutex);
+
+	/* Finished or failed synchronously, report it like any other */
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		tegra_crypto_async_complete(&areq->req->base, ret);
+
+	return 0;
+
+unlock:
+	mutex_unlock(&ctx->async_mutex);
+free_areq:
+	skcipher_request_free(areq->req);
+	kzfree(areq);
+unreserve:
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	ctx->async_pending--;
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+	return ret;
+}
+
+static int tegra_crypto_async_reap(struct tegra_crypto_ctx *ctx,
+				   unsigned long arg)
+{
+	struct tegra_crypt_async_reap reap;
+	struct tegra_crypt_async_done done;
+	struct tegra_crypt_async_done __user *udone;
+	struct tegra_crypto_async_req *areq;
+	unsigned long flags;
+	int ret = 0;
+
+	if (copy_from_user(&reap, (void __user *)arg, sizeof(reap)))
+		return -EFAULT;
+
+	if (reap.wait && wait_event_interruptible(ctx->async_wq,
+					tegra_crypto_async_ready(ctx)))
+		return -ERESTARTSYS;
+
+	udone = u64_to_user_ptr(reap.done);
+
+	for (reap.nr_done = 0; reap.nr_done < reap.max_done; reap.nr_done++) {
+		spin_lock_irqsave(&ctx->async_lock, flags);
+		areq = list_first_entry_or_null(&ctx->async_done,
+				struct tegra_crypto_async_req, node);
+		if (areq)
+			list_del(&areq->node);
+		spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+		if (!areq)
+			break;
+
+		done.tag = areq->tag;
+		done.status = areq->status;
+		done.reserved = 0;
+		if (!done.status && copy_to_user(u64_to_user_ptr(areq->result),
+						 areq->buf, areq->size))
+			done.status = -EFAULT;
+
+		tegra_crypto_async_free(areq);
+
+		spin_lock_irqsave(&ctx->async_lock, flags);
+		ctx->async_pending--;
+		spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+		if (copy_to_user(&udone[reap.nr_done], &done, sizeof(done))) {
+			ret = -EFAULT;
+			break;
+		}
+	}
+
+	if (copy_to_user((void __user *)arg, &reap, sizeof(reap)))
+		ret = -EFAULT;
+
+	return ret;
+}
+
+static int tegra_crypto_async_set_eventfd(struct tegra_crypto_ctx *ctx,
+					  int fd)
+{
+	struct eventfd_ctx *eventfd = NULL, *old;
+	unsigned long flags;
+
+	if (fd >= 0) {
+		eventfd = eventfd_ctx_fdget(fd);
+		if (IS_ERR(eventfd))
+			return PTR_ERR(eventfd);
+	}
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	old = ctx->async_eventfd;
+	ctx->async_eventfd = eventfd;
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+	if (old)
+		eventfd_ctx_put(old);
+
+	return 0;
+}
+
+static void tegra_crypto_async_init(struct tegra_crypto_ctx *ctx)
+{
+	spin_lock_init(&ctx->async_lock);
+	INIT_LIST_HEAD(&ctx->async_done);
+	init_waitqueue_head(&ctx->async_wq);
+	mutex_init(&ctx->async_mutex);
+}
+
+/* Wait for requests still on the engine, then drop everything unreaped */
+static void tegra_crypto_async_release(struct tegra_crypto_ctx *ctx)
+{
+	struct tegra_crypto_async_req *areq, *tmp;
+	int i;
+
+	wait_event(ctx->async_wq, tegra_crypto_async_idle(ctx));
+
+	list_for_each_entry_safe(areq, tmp, &ctx->async_done, node) {
+		list_del(&areq->node);
+		tegra_crypto_async_free(areq);
+	}
+
+	for (i = 0; i < TEGRA_CRYPTO_MAX; i++)
+		if (ctx->async_tfm[i])
+			crypto_free_skcipher(ctx->async_tfm[i]);
+
+	if (ctx->async_eventfd)
+		eventfd_ctx_put(ctx->async_eventfd);
+}
+
+static unsigned int tegra_crypto_dev_poll(struct file *filp,
+					  poll_table *wait)
+{
+	struct tegra_crypto_ctx *ctx = filp->private_data;
+	unsigned long flags;
+	unsigned int mask = 0;
+
+	poll_wait(filp, &ctx->async_wq, wait);
+
+	spin_lock_irqsave(&ctx->async_lock, flags);
+	if (!list_empty(&ctx->async_done))
+		mask = POLLIN | POLLRDNORM;
+	spin_unlock_irqrestore(&ctx->async_lock, flags);
+
+	return mask;
+}
+
 static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 {
 	struct tegra_crypto_ctx *ctx;
@@ -164,6 +555,7 @@ static int tegra_crypto_dev_open(struct inode *inode, struct file *filp)
 		kfree(ctx);
 		return ret;
 	}
+	tegra_crypto_async_init(ctx);
 	filp->private_data = ctx;
 	return ret;
 }
@@ -181,6 +573,8 @@ static int tegra_crypto_dev_release(struct inode *inode, struct file *filp)
 	static struct crypto_skcipher *store_tfm[
 					TEGRA_CRYPTO_AES_TEST_KEYSLOTS];
 
+	tegra_crypto_async_release(ctx);
+
 	/* Only when skip_exit is false, the concerned tfm is freed,
 	 * else it is just saved in store_tfm that is freed later
 	 */
@@ -217,6 +611,156 @@ static void tegra_crypt_complete(struct crypto_async_request *req, int err)
 	}
 }
 
+struct tegra_crypto_user_buf {
+	struct page *pages[TEGRA_CRYPTO_PIN_PAGES + 1];
+	int nr_pages;
+	bool write;
+	struct sg_table sgt;
+};
+
+static void tegra_crypto_put_user_pages(struct tegra_crypto_user_buf *ubuf)
+{
+	int i;
+
+	for (i = 0; i < ubuf->nr_pages; i++) {
+		if (ubuf->write)
+			set_page_dirty_lock(ubuf->pages[i]);
+		put_page(ubuf->pages[i]);
+	}
+	ubuf->nr_pages = 0;
+}
+
+static int tegra_crypto_pin_user_buf(struct tegra_crypto_user_buf *ubuf,
+		unsigned long uaddr, unsigned int size, bool write)
+{
+	unsigned int offset = offset_in_page(uaddr);
+	int nr_pages = DIV_ROUND_UP(offset + size, PAGE_SIZE);
+	int ret;
+
+	ubuf->write = write;
+	ret = get_user_pages_fast(uaddr & PAGE_MASK, nr_pages, write,
+				  ubuf->pages);
+	if (ret < 0)
+		return ret;
+
+	ubuf->nr_pages = ret;
+	if (ret != nr_pages) {
+		ret = -EFAULT;
+		goto put_pages;
+	}
+
+	ret = sg_alloc_table_from_pages(&ubuf->sgt, ubuf->pages, nr_pages,
+					offset, size, GFP_KERNEL);
+	if (ret)
+		goto put_pages;
+
+	return 0;
+
+put_pages:
+	tegra_crypto_put_user_pages(ubuf);
+	return ret;
+}
+
+static void tegra_crypto_unpin_user_buf(struct tegra_crypto_user_buf *ubuf)
+{
+	sg_free_table(&ubuf->sgt);
+	tegra_crypto_put_user_pages(ubuf);
+}
+
+static int tegra_crypt_run_req(struct skcipher_request *req,
+			       struct tegra_crypt_req *crypt_req,
+			       struct scatterlist *in_sg,
+			       struct scatterlist *out_sg, unsigned int size,
+			       struct tegra_crypto_completion *tcrypt_complete)
+{
+	int ret;
+
+	if (!crypt_req->skip_iv)
+		skcipher_request_set_crypt(req, in_sg, out_sg, size,
+					   crypt_req->iv);
+	else
+		skcipher_request_set_crypt(req, in_sg, out_sg, size, NULL);
+
+	reinit_completion(&tcrypt_complete->restart);
+
+	tcrypt_complete->req_err = 0;
+
+	ret = crypt_req->encrypt ?
+		crypto_skcipher_encrypt(req) :
+		crypto_skcipher_decrypt(req);
+	if ((ret == -EINPROGRESS) || (ret == -EBUSY)) {
+		/* crypto driver is asynchronous */
+		ret = wait_for_completion_timeout(&tcrypt_complete->restart,
+					msecs_to_jiffies(5000));
+		if (ret == 0)
+			return -ETIMEDOUT;
+
+		return tcrypt_complete->req_err < 0 ?
+			tcrypt_complete->req_err : 0;
+	} else if (ret < 0) {
+		pr_debug("%scrypt failed (%d)\n",
+			crypt_req->encrypt ? "en" : "de", ret);
+		return ret;
+	}
+
+	return 0;
+}
+
+/* Run a large request directly on the pinned user buffers */
+static int process_crypt_req_pinned(struct skcipher_request *req,
+			struct tegra_crypt_req *crypt_req,
+			struct tegra_crypto_completion *tcrypt_complete)
+{
+	struct tegra_crypto_user_buf *src, *dst;
+	unsigned long total = crypt_req->plaintext_sz;
+	unsigned long in = (unsigned long)crypt_req->plaintext;
+	unsigned long out = (unsigned long)crypt_req->result;
+	unsigned int size;
+	int ret = 0;
+
+	src = kzalloc(sizeof(*src), GFP_KERNEL);
+	dst = kzalloc(sizeof(*dst), GFP_KERNEL);
+	if (!src || !dst) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	while (total > 0) {
+		/* keep both ranges within the pinned pages */
+		size = min(total, TEGRA_CRYPTO_PIN_PAGES * PAGE_SIZE -
+			   max(offset_in_page(in), offset_in_page(out)));
+		if (size < total)
+			size &= ~(AES_BLOCK_SIZE - 1);
+
+		ret = tegra_crypto_pin_user_buf(src, in, size, false);
+		if (ret)
+			break;
+
+		ret = tegra_crypto_pin_user_buf(dst, out, size, true);
+		if (ret) {
+			tegra_crypto_unpin_user_buf(src);
+			break;
+		}
+
+		ret = tegra_crypt_run_req(req, crypt_req, src->sgt.sgl,
+					  dst->sgt.sgl, size, tcrypt_complete);
+
+		tegra_crypto_unpin_user_buf(dst);
+		tegra_crypto_unpin_user_buf(src);
+		if (ret)
+			break;
+
+		total -= size;
+		in += size;
+		out += size;
+	}
+
+out:
+	kfree(dst);
+	kfree(src);
+	return ret;
+}
+
 static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 				struct tegra_crypt_req *crypt_req)
 {
@@ -289,17 +833,23 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		}
 	}
 
+	init_completion(&tcrypt_complete.restart);
+
+	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+		tegra_crypt_complete, &tcrypt_complete);
+
+	if (crypt_req->plaintext_sz >= TEGRA_CRYPTO_PIN_MIN_SIZE) {
+		ret = process_crypt_req_pinned(req, crypt_req,
+					       &tcrypt_complete);
+		goto process_req_out;
+	}
+
 	ret = alloc_bufs(xbuf);
 	if (ret < 0) {
 		pr_err("alloc_bufs failed");
 		goto process_req_out;
 	}
 
-	init_completion(&tcrypt_complete.restart);
-
-	skcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
-		tegra_crypt_complete, &tcrypt_complete);
-
 	total = crypt_req->plaintext_sz;
 	while (total > 0) {
 		size = min(total, PAGE_SIZE);
@@ -313,36 +863,10 @@ static int process_crypt_req(struct file *filp, struct tegra_crypto_ctx *ctx,
 		sg_init_one(&in_sg, xbuf[0], size);
 		sg_init_one(&out_sg, xbuf[1], size);
 
-		if (!crypt_req->skip_iv)
-			skcipher_request_set_crypt(req, &in_sg,
-				&out_sg, size, crypt_req->iv);
-		else
-			skcipher_request_set_crypt(req, &in_sg,
-				&out_sg, size, NULL);
-
-		reinit_completion(&tcrypt_complete.restart);
-
-		tcrypt_complete.req_err = 0;
-
-		ret = crypt_req->encrypt ?
-			crypto_skcipher_encrypt(req) :
-			crypto_skcipher_decrypt(req);
-		if ((ret == -EINPROGRESS) || (ret == -EBUSY)) {
-			/* crypto driver is asynchronous */
-			ret = wait_for_completion_timeout(&tcrypt_complete.restart,
-						msecs_to_jiffies(5000));
-			if (ret == 0)
-				goto process_req_buf_out;
-
-			if (tcrypt_complete.req_err < 0) {
-				ret = tcrypt_complete.req_err;
-				goto process_req_buf_out;
-			}
-		} else if (ret < 0) {
-			pr_debug("%scrypt failed (%d)\n",
-				crypt_req->encrypt ? "en" : "de", ret);
+		ret = tegra_crypt_run_req(req, crypt_req, &in_sg, &out_sg,
+					  size, &tcrypt_complete);
+		if (ret)
 			goto process_req_buf_out;
-		}
 
 		ret = copy_to_user((void __user *)crypt_req->result,
 			(const void *)xbuf[1], size);
@@ -890,11 +1414,50 @@ free_tfm:
 	return err;
 }
 
-static int tegra_crypt_pka1_ecc(struct tegra_se_pka1_ecc_request *ecc_req)
+static void tegra_crypt_pka1_ecc_free(struct tegra_se_pka1_ecc_request *req)
 {
-	struct tegra_se_pka1_ecc_request temp_ecc_req;
+	kfree(req->key);
+	kfree(req->res_pt_y);
+	kfree(req->res_pt_x);
+	kfree(req->base_pt_y);
+	kfree(req->base_pt_x);
+	kfree(req->curve_param_b);
+	kfree(req->curve_param_a);
+	kfree(req->modulus);
+	memset(req, 0, sizeof(*req));
+}
+
+static int tegra_crypt_pka1_ecc_copy_in(char *dst, char *src,
+					unsigned int size)
+{
+	if (copy_from_user(dst, (void __user *)src, size)) {
+		pr_debug("%s: copy_from_user failed\n", __func__);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+static int tegra_crypt_pka1_ecc_copy_out(char *dst, char *src,
+					 unsigned int size)
+{
+	if (copy_to_user((void __user *)dst, src, size)) {
+		pr_debug("%s: copy_to_user failed\n", __func__);
+		return -EFAULT;
+	}
+
+	return 0;
+}
+
+/* Stage the inputs of a user ECC request in kernel memory */
+static int tegra_crypt_pka1_ecc_get(struct tegra_se_pka1_ecc_request *ecc_req,
+				    struct tegra_se_pka1_ecc_request *temp_ecc_req)
+{
+	unsigned int size = ecc_req->size;
 	int ret;
 
+	memset(temp_ecc_req, 0, sizeof(*temp_ecc_req));
+
 	if ((ecc_req->op_mode < ECC_MODE_MIN_INDEX) ||
 	    (ecc_req->op_mode > ECC_MODE_MAX_INDEX)) {
 		pr_err("Invalid value of ecc opmode index %d\n",
@@ -902,169 +1465,150 @@ static int tegra_crypt_pka1_ecc(struct tegra_se_pka1_ecc_request *ecc_req)
 		return -EINVAL;
 	}
 
-	temp_ecc_req.op_mode = ecc_req->op_mode;
-	temp_ecc_req.size = ecc_req->size;
-	temp_ecc_req.type = ecc_req->type;
-
-	temp_ecc_req.modulus = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.modulus) {
-		ret = -ENOMEM;
-		goto mod_fail;
-	}
-	temp_ecc_req.curve_param_a = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.curve_param_a) {
-		ret = -ENOMEM;
-		goto param_a_fail;
-	}
-	temp_ecc_req.curve_param_b = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.curve_param_b) {
-		ret = -ENOMEM;
-		goto param_b_fail;
-	}
-	temp_ecc_req.base_pt_x = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.base_pt_x) {
-		ret =  -ENOMEM;
-		goto base_px_fail;
-	}
-	temp_ecc_req.base_pt_y = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.base_pt_y) {
-		ret = -ENOMEM;
-		goto base_py_fail;
-	}
-	temp_ecc_req.res_pt_x = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.res_pt_x) {
-		ret = -ENOMEM;
-		goto res_px_fail;
-	}
-	temp_ecc_req.res_pt_y = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.res_pt_y) {
+	temp_ecc_req->op_mode = ecc_req->op_mode;
+	temp_ecc_req->size = size;
+	temp_ecc_req->type = ecc_req->type;
+
+	temp_ecc_req->modulus = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->curve_param_a = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->curve_param_b = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->base_pt_x = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->base_pt_y = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->res_pt_x = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->res_pt_y = kzalloc(size, GFP_KERNEL);
+	temp_ecc_req->key = kzalloc(size, GFP_KERNEL);
+	if (!temp_ecc_req->modulus || !temp_ecc_req->curve_param_a ||
+	    !temp_ecc_req->curve_param_b || !temp_ecc_req->base_pt_x ||
+	    !temp_ecc_req->base_pt_y || !temp_ecc_req->res_pt_x ||
+	    !temp_ecc_req->res_pt_y || !temp_ecc_req->key) {
 		ret = -ENOMEM;
-		goto res_py_fail;
-	}
-	temp_ecc_req.key = kzalloc(ecc_req->size, GFP_KERNEL);
-	if (!temp_ecc_req.key) {
-		ret = -ENOMEM;
-		goto key_fail;
-	}
-
-	ret = copy_from_user(temp_ecc_req.modulus,
-			     (void __user *)ecc_req->modulus, ecc_req->size);
-	if (ret) {
-		ret = -EFAULT;
-		pr_debug("%s: copy_from_user failed (%d)\n", __func__, ret);
 		goto free_all;
 	}
 
-	ret = copy_from_user(temp_ecc_req.curve_param_a,
-			     (void __user *)ecc_req->curve_param_a,
-			     ecc_req->size);
-	if (ret) {
-		ret = -EFAULT;
-		pr_debug("%s: copy_from_user failed (%d)\n", __func__, ret);
-		goto free_all;
-	}
+	ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->modulus,
+					   ecc_req->modulus, size);
+	if (!ret)
+		ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->curve_param_a,
+						   ecc_req->curve_param_a,
+						   size);
+	if (!ret && ((ecc_req->type == ECC_POINT_VER) ||
+		     (ecc_req->type == ECC_SHAMIR_TRICK)))
+		ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->curve_param_b,
+						   ecc_req->curve_param_b,
+						   size);
+	if (!ret && ecc_req->type != ECC_POINT_DOUBLE) {
+		ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->base_pt_x,
+						   ecc_req->base_pt_x, size);
+		if (!ret)
+			ret = tegra_crypt_pka1_ecc_copy_in(
+					temp_ecc_req->base_pt_y,
+					ecc_req->base_pt_y, size);
+	}
+	if (!ret)
+		ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->res_pt_x,
+						   ecc_req->res_pt_x, size);
+	if (!ret)
+		ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->res_pt_y,
+						   ecc_req->res_pt_y, size);
+	if (!ret && ((ecc_req->type == ECC_POINT_MUL) ||
+		     (ecc_req->type == ECC_SHAMIR_TRICK)))
+		ret = tegra_crypt_pka1_ecc_copy_in(temp_ecc_req->key,
+						   ecc_req->key, size);
+	if (!ret)
+		return 0;
 
-	if ((ecc_req->type == ECC_POINT_VER) ||
-	    (ecc_req->type == ECC_SHAMIR_TRICK)) {
-		ret = copy_from_user(temp_ecc_req.curve_param_b,
-				     (void __user *)ecc_req->curve_param_b,
-				     ecc_req->size);
-		if (ret) {
-			ret = -EFAULT;
-			pr_debug("%s: copy_from_user failed (%d)\n",
-				 __func__, ret);
-			goto free_all;
-		}
-	}
+free_all:
+	tegra_crypt_pka1_ecc_free(temp_ecc_req);
+	return ret;
+}
 
-	if (ecc_req->type != ECC_POINT_DOUBLE) {
-		ret = copy_from_user(temp_ecc_req.base_pt_x,
-				     (void __user *)ecc_req->base_pt_x,
-				     ecc_req->size);
-		if (ret) {
-			ret = -EFAULT;
-			pr_debug("%s: copy_from_user failed (%d)\n",
-				__func__, ret);
-			goto free_all;
-		}
+/* Hand the result of a staged request back if it succeeded, then free it */
+static int tegra_crypt_pka1_ecc_put(struct tegra_se_pka1_ecc_request *ecc_req,
+				    struct tegra_se_pka1_ecc_request *temp_ecc_req,
+				    int ret)
+{
+	if (!ret)
+		ret = tegra_crypt_pka1_ecc_copy_out(ecc_req->res_pt_x,
+						    temp_ecc_req->res_pt_x,
+						    ecc_req->size);
+	if (!ret)
+		ret = tegra_crypt_pka1_ecc_copy_out(ecc_req->res_pt_y,
+						    temp_ecc_req->res_pt_y,
+						    ecc_req->size);
 
-		ret = copy_from_user(temp_ecc_req.base_pt_y,
-				     (void __user *)ecc_req->base_pt_y,
-				     ecc_req->size);
-		if (ret) {
-			ret = -EFAULT;
-			pr_debug("%s: copy_from_user failed (%d)\n",
-				__func__, ret);
-			goto free_all;
-		}
-	}
+	tegra_crypt_pka1_ecc_free(temp_ecc_req);
 
-	ret = copy_from_user(temp_ecc_req.res_pt_x,
-			     (void __user *)ecc_req->res_pt_x, ecc_req->size);
-	if (ret) {
-		ret = -EFAULT;
-		pr_debug("%s: copy_from_user failed (%d)\n", __func__, ret);
-		goto free_all;
-	}
+	return ret;
+}
 
-	ret = copy_from_user(temp_ecc_req.res_pt_y,
-			     (void __user *)ecc_req->res_pt_y, ecc_req->size);
-	if (ret) {
-		ret = -EFAULT;
-		pr_debug("%s: copy_from_user failed (%d)\n", __func__, ret);
-		goto free_all;
-	}
+static int tegra_crypt_pka1_ecc(struct tegra_se_pka1_ecc_request *ecc_req)
+{
+	struct tegra_se_pka1_ecc_request temp_ecc_req;
+	int ret;
 
-	if ((ecc_req->type == ECC_POINT_MUL) ||
-	    (ecc_req->type == ECC_SHAMIR_TRICK)) {
-		ret = copy_from_user(temp_ecc_req.key,
-				     (void __user *)ecc_req->key,
-				     ecc_req->size);
-		if (ret) {
-			ret = -EFAULT;
-			pr_debug("%s: copy_from_user failed (%d)\n",
-				 __func__, ret);
-			goto free_all;
-		}
-	}
+	ret = tegra_crypt_pka1_ecc_get(ecc_req, &temp_ecc_req);
+	if (ret)
+		return ret;
 
 	ret = tegra_se_pka1_ecc_op(&temp_ecc_req);
-	if (ret) {
+	if (ret)
 		pr_debug("\ntegra_se_pka1_ecc_op failed(%d) for ECC\n", ret);
-		goto free_all;
+
+	return tegra_crypt_pka1_ecc_put(ecc_req, &temp_ecc_req, ret);
+}
+
+/*
+ * All requests of a batch are copied in before the engine is taken, then
+ * run back to back under a single hold of PKA1, so that curve parameters
+ * stay loaded from one request to the next. Each request gets its own
+ * status; the ioctl itself only fails if the batch could not be run.
+ */
+static int tegra_crypt_pka1_ecc_batch(struct tegra_se_pka1_ecc_batch *batch)
+{
+	struct tegra_se_pka1_ecc_request *reqs, *temp;
+	unsigned int i, nr = batch->nr_reqs;
+	int *status;
+	int ret;
+
+	if (!nr || nr > TEGRA_CRYPTO_PKA1_ECC_BATCH_MAX)
+		return -EINVAL;
+
+	reqs = kcalloc(nr, sizeof(*reqs), GFP_KERNEL);
+	temp = kcalloc(nr, sizeof(*temp), GFP_KERNEL);
+	status = kcalloc(nr, sizeof(*status), GFP_KERNEL);
+	if (!reqs || !temp || !status) {
+		ret = -ENOMEM;
+		goto out;
 	}
 
-	ret = copy_to_user((void __user *)ecc_req->res_pt_x,
-			   temp_ecc_req.res_pt_x, ecc_req->size);
-	if (ret) {
+	if (copy_from_user(reqs, (void __user *)batch->reqs,
+			   nr * sizeof(*reqs))) {
 		ret = -EFAULT;
-		pr_debug("%s: copy_to_user failed (%d)\n", __func__, ret);
-		goto free_all;
+		goto out;
 	}
 
-	ret = copy_to_user((void __user *)ecc_req->res_pt_y,
-			   temp_ecc_req.res_pt_y, ecc_req->size);
-	if (ret) {
+	for (i = 0; i < nr; i++)
+		status[i] = tegra_crypt_pka1_ecc_get(&reqs[i], &temp[i]);
+
+	ret = tegra_se_pka1_batch_begin();
+	for (i = 0; i < nr; i++)
+		if (!status[i])
+			status[i] = ret ? ret : tegra_se_pka1_ecc_op(&temp[i]);
+	if (!ret)
+		tegra_se_pka1_batch_end();
+
+	for (i = 0; i < nr; i++)
+		status[i] = tegra_crypt_pka1_ecc_put(&reqs[i], &temp[i],
+						     status[i]);
+
+	ret = 0;
+	if (copy_to_user((void __user *)batch->status, status,
+			 nr * sizeof(*status)))
 		ret = -EFAULT;
-		pr_debug("%s: copy_to_user failed (%d)\n", __func__, ret);
-	}
-free_all:
-		kfree(temp_ecc_req.key);
-key_fail:
-		kfree(temp_ecc_req.res_pt_y);
-res_py_fail:
-		kfree(temp_ecc_req.res_pt_x);
-res_px_fail:
-		kfree(temp_ecc_req.base_pt_y);
-base_py_fail:
-		kfree(temp_ecc_req.base_pt_x);
-base_px_fail:
-		kfree(temp_ecc_req.curve_param_b);
-param_b_fail:
-		kfree(temp_ecc_req.curve_param_a);
-param_a_fail:
-		kfree(temp_ecc_req.modulus);
-mod_fail:
+out:
+	kfree(status);
+	kfree(temp);
+	kfree(reqs);
 	return ret;
 }
 
@@ -1427,6 +1971,7 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 	struct crypto_rng *tfm = NULL;
 	struct tegra_pka1_rsa_request pka1_rsa_req;
 	struct tegra_se_pka1_ecc_request pka1_ecc_req;
+	struct tegra_se_pka1_ecc_batch pka1_ecc_batch;
 	struct tegra_pka1_eddsa_request pka1_eddsa_req;
 	struct tegra_crypt_req crypt_req;
 	struct tegra_rng_req rng_req;
@@ -1448,6 +1993,18 @@ static long tegra_crypto_dev_ioctl(struct file *filp,
 		ctx->use_ssk = (int)arg;
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_SUBMIT_REQ:
+		ret = tegra_crypto_async_submit(ctx, arg);
+		break;
+
+	case TEGRA_CRYPTO_IOCTL_REAP_REQS:
+		ret = tegra_crypto_async_reap(ctx, arg);
+		break;
+
+	case TEGRA_CRYPTO_IOCTL_SET_EVENTFD:
+		ret = tegra_crypto_async_set_eventfd(ctx, (int)arg);
+		break;
+
 #ifdef CONFIG_COMPAT
 	case TEGRA_CRYPTO_IOCTL_PROCESS_REQ_32:
 		ret = copy_from_user(&crypt_req_32, (void __user *)arg,
@@ -1765,6 +2322,18 @@ rng_out:
 		ret = tegra_crypt_pka1_ecc(&pka1_ecc_req);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_PKA1_ECC_BATCH_REQ:
+		if (copy_from_user(&pka1_ecc_batch, (void __user *)arg,
+				   sizeof(pka1_ecc_batch))) {
+			ret = -EFAULT;
+			pr_err("%s: copy_from_user fail(%d) for pka1_ecc_batch\n",
+				__func__, ret);
+			return ret;
+		}
+
+		ret = tegra_crypt_pka1_ecc_batch(&pka1_ecc_batch);
+		break;
+
 	case TEGRA_CRYPTO_IOCTL_PKA1_EDDSA_REQ:
 		if (copy_from_user(&pka1_eddsa_req, (void __user *)arg,
 				   sizeof(pka1_eddsa_req))) {
@@ -1822,6 +2391,42 @@ rng1_out:
 		kfree(rng);
 		break;
 
+	case TEGRA_CRYPTO_IOCTL_TRNG_REQ:
+		if (copy_from_user(&rng_req, (void __user *)arg,
+			sizeof(rng_req))) {
+			pr_err("%s: copy_from_user fail(%d)\n",
+					__func__, ret);
+			return -EFAULT;
+		}
+
+		rng = kzalloc(rng_req.nbytes, GFP_KERNEL);
+		if (!rng)
+			return -ENODATA;
+
+		tfm = crypto_alloc_rng("trng_elp-tegra", CRYPTO_ALG_TYPE_RNG, 0);
+		if (IS_ERR(tfm)) {
+			pr_err("Failed to alloc trng: %ld\n", PTR_ERR(tfm));
+			ret = PTR_ERR(tfm);
+			goto trng_out;
+		}
+
+		ret = crypto_rng_get_bytes(tfm, rng, rng_req.nbytes);
+		crypto_free_rng(tfm);
+		if (ret) {
+			pr_err("trng failed");
+			ret = -ENODATA;
+			goto trng_out;
+		}
+
+		if (copy_to_user((void __user *)rng_req.rdata,
+			(const void *)rng, rng_req.nbytes)) {
+			ret = -EFAULT;
+			pr_err("%s: copy_to_user fail(%d)\n", __func__, ret);
+		}
+trng_out:
+		kzfree(rng);
+		break;
+
 	default:
 		pr_debug("invalid ioctl code(%d)", ioctl_num);
 		return -EINVAL;
@@ -1834,6 +2439,7 @@ static const struct file_operations tegra_crypto_fops = {
 	.owner = THIS_MODULE,
 	.open = tegra_crypto_dev_open,
 	.release = tegra_crypto_dev_release,
+	.poll = tegra_crypto_dev_poll,
 	.unlocked_ioctl = tegra_crypto_dev_ioctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl =  tegra_crypto_dev_ioctl,
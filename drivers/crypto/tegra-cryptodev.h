@@ -125,6 +125,21 @@ struct tegra_se_pka1_ecc_request {
 #define TEGRA_CRYPTO_IOCTL_PKA1_ECC_REQ	\
 		_IOWR(0x98, 107, struct tegra_se_pka1_ecc_request)
 
+/*
+ * Run several ECC requests, e.g. the steps of many signature checks,
+ * with one hold of the PKA1 engine. status[i] receives the result of
+ * reqs[i].
+ */
+#define TEGRA_CRYPTO_PKA1_ECC_BATCH_MAX	64
+
+struct tegra_se_pka1_ecc_batch {
+	struct tegra_se_pka1_ecc_request *reqs;
+	int *status;
+	unsigned int nr_reqs;
+};
+#define TEGRA_CRYPTO_IOCTL_PKA1_ECC_BATCH_REQ	\
+		_IOWR(0x98, 114, struct tegra_se_pka1_ecc_batch)
+
 struct tegra_pka1_rsa_request {
 	char *key;
 	char *message;
@@ -137,6 +152,8 @@ struct tegra_pka1_rsa_request {
 		_IOWR(0x98, 106, struct tegra_pka1_rsa_request)
 
 int tegra_se_pka1_ecc_op(struct tegra_se_pka1_ecc_request *req);
+int tegra_se_pka1_batch_begin(void);
+void tegra_se_pka1_batch_end(void);
 int tegra_se_rng1_op(struct tegra_se_rng1_request *req);
 
 /* a pointer to this struct needs to be passed to:
@@ -159,6 +176,53 @@ struct tegra_crypt_req {
 #define TEGRA_CRYPTO_IOCTL_PROCESS_REQ	\
 		_IOWR(0x98, 101, struct tegra_crypt_req)
 
+/*
+ * Asynchronous AES requests. TEGRA_CRYPTO_IOCTL_SUBMIT_REQ queues a request
+ * and returns straight away; TEGRA_CRYPTO_IOCTL_REAP_REQS hands back the
+ * completed ones, result data copied out. poll() on the device reports
+ * POLLIN while completions are waiting, and an eventfd registered with
+ * TEGRA_CRYPTO_IOCTL_SET_EVENTFD is signalled for each one.
+ *
+ * Pointers are carried as __u64 so 32-bit callers use the same layout.
+ */
+#define TEGRA_CRYPTO_MAX_ASYNC_REQS	64
+#define TEGRA_CRYPTO_MAX_ASYNC_SIZE	(64 * 1024)
+
+struct tegra_crypt_async_req {
+	__u64 tag; /* returned with the completion */
+	__u32 op; /* e.g. TEGRA_CRYPTO_CBC */
+	__u32 encrypt;
+	char key[TEGRA_CRYPTO_MAX_KEY_SIZE];
+	__u32 keylen;
+	__u32 skip_iv;
+	char iv[TEGRA_CRYPTO_IV_SIZE];
+	__u64 plaintext;
+	__u64 result;
+	__u32 plaintext_sz;
+	__u32 reserved;
+};
+#define TEGRA_CRYPTO_IOCTL_SUBMIT_REQ	\
+		_IOW(0x98, 111, struct tegra_crypt_async_req)
+
+struct tegra_crypt_async_done {
+	__u64 tag;
+	__s32 status; /* 0 or -errno */
+	__u32 reserved;
+};
+
+struct tegra_crypt_async_reap {
+	__u64 done; /* array of struct tegra_crypt_async_done */
+	__u32 max_done;
+	__u32 nr_done; /* filled in by the driver */
+	__u32 wait; /* block until something completes */
+	__u32 reserved;
+};
+#define TEGRA_CRYPTO_IOCTL_REAP_REQS	\
+		_IOWR(0x98, 112, struct tegra_crypt_async_reap)
+
+/* arg is the eventfd to signal on completion, or -1 to stop */
+#define TEGRA_CRYPTO_IOCTL_SET_EVENTFD	_IOW(0x98, 113, int)
+
 #ifdef CONFIG_COMPAT
 struct tegra_crypt_req_32 {
 	int op; /* e.g. TEGRA_CRYPTO_ECB */
@@ -191,6 +255,9 @@ struct tegra_rng_req {
 		_IOWR(0x98, 102, struct tegra_rng_req)
 #define TEGRA_CRYPTO_IOCTL_GET_RANDOM	\
 		_IOWR(0x98, 103, struct tegra_rng_req)
+/* Bytes from the buffered PKA1 TRNG pool, only rdata and nbytes are used */
+#define TEGRA_CRYPTO_IOCTL_TRNG_REQ	\
+		_IOWR(0x98, 115, struct tegra_rng_req)
 
 #ifdef CONFIG_COMPAT
 struct tegra_rng_req_32 {
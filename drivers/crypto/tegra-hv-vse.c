@@ -46,6 +46,7 @@
 #include <linux/completion.h>
 #include <linux/interrupt.h>
 #include <linux/kthread.h>
+#include <linux/wait.h>
 
 #define TEGRA_HV_VSE_SHA_MAX_LL_NUM 26
 #define TEGRA_HV_VSE_AES_MAX_LL_NUM 17
@@ -98,6 +99,8 @@ struct tegra_vse_priv_data {
 	int cmd;
 	int slot_num;
 	int gather_buf_sz;
+	/* request is mapped for DMA in place rather than copied to buf */
+	bool direct[TEGRA_HV_VSE_MAX_TASKS_PER_SUBMIT];
 	struct scatterlist sg;
 	void *buf;
 	dma_addr_t buf_addr;
@@ -119,6 +122,9 @@ struct tegra_virtual_se_dev {
 	int req_cnt;
 	struct ablkcipher_request *reqs[TEGRA_HV_VSE_MAX_TASKS_PER_SUBMIT];
 	atomic_t ivc_count;
+	/* AES messages allowed with the server at once */
+	u32 max_ivc_msgs;
+	wait_queue_head_t ivc_wq;
 	int gather_buf_sz;
 	/* Engine id */
 	unsigned int engine_id;
@@ -1329,6 +1335,107 @@ void tegra_hv_vse_prpare_cmd(struct tegra_virtual_se_dev *se_dev,
 	}
 }
 
+/*
+ * Requests whose scatterlists fit in the message's linked lists are handed
+ * to the server as they are; only the rest go through the gather buffer.
+ */
+static bool tegra_hv_vse_aes_sg_fits(struct scatterlist *sg, u32 nbytes)
+{
+	int nents = 0;
+	u32 len;
+
+	while (sg && nbytes) {
+		len = min_t(u32, sg->length, nbytes);
+		if (len % VIRTUAL_SE_AES_BLOCK_SIZE ||
+		    len >= TEGRA_VIRTUAL_SE_MAX_BUFFER_SIZE)
+			return false;
+		if (++nents > TEGRA_HV_VSE_AES_MAX_LL_NUM)
+			return false;
+		nbytes -= len;
+		sg = sg_next(sg);
+	}
+
+	return !nbytes;
+}
+
+static bool tegra_hv_vse_aes_can_map(struct ablkcipher_request *req)
+{
+	return tegra_hv_vse_aes_sg_fits(req->src, req->nbytes) &&
+		tegra_hv_vse_aes_sg_fits(req->dst, req->nbytes);
+}
+
+static void tegra_hv_vse_unmap_sg(struct tegra_virtual_se_dev *se_dev,
+	struct scatterlist *sg, u32 nbytes, enum dma_data_direction dir)
+{
+	u32 len;
+
+	while (sg && nbytes) {
+		len = min_t(u32, sg->length, nbytes);
+		dma_unmap_sg(se_dev->dev, sg, 1, dir);
+		nbytes -= len;
+		sg = sg_next(sg);
+	}
+}
+
+static void tegra_hv_vse_aes_unmap_req(struct tegra_virtual_se_dev *se_dev,
+	struct ablkcipher_request *req)
+{
+	if (req->src == req->dst) {
+		tegra_hv_vse_unmap_sg(se_dev, req->src, req->nbytes,
+			DMA_BIDIRECTIONAL);
+	} else {
+		tegra_hv_vse_unmap_sg(se_dev, req->src, req->nbytes,
+			DMA_TO_DEVICE);
+		tegra_hv_vse_unmap_sg(se_dev, req->dst, req->nbytes,
+			DMA_FROM_DEVICE);
+	}
+}
+
+static int tegra_hv_vse_aes_map_req(struct tegra_virtual_se_dev *se_dev,
+	struct ablkcipher_request *req,
+	struct tegra_virtual_se_ivc_tx_msg_t *ivc_tx)
+{
+	int src_num, dst_num;
+	int err;
+
+	if (req->src == req->dst) {
+		err = tegra_hv_vse_prepare_ivc_linked_list(se_dev, req->src,
+			req->nbytes, TEGRA_HV_VSE_AES_MAX_LL_NUM,
+			VIRTUAL_SE_AES_BLOCK_SIZE,
+			ivc_tx->args.aes.op.src_addr, &src_num,
+			DMA_BIDIRECTIONAL);
+		if (err)
+			return err;
+		memcpy(ivc_tx->args.aes.op.dst_addr,
+			ivc_tx->args.aes.op.src_addr,
+			src_num * sizeof(struct tegra_virtual_se_addr));
+		dst_num = src_num;
+	} else {
+		err = tegra_hv_vse_prepare_ivc_linked_list(se_dev, req->src,
+			req->nbytes, TEGRA_HV_VSE_AES_MAX_LL_NUM,
+			VIRTUAL_SE_AES_BLOCK_SIZE,
+			ivc_tx->args.aes.op.src_addr, &src_num,
+			DMA_TO_DEVICE);
+		if (err)
+			return err;
+		err = tegra_hv_vse_prepare_ivc_linked_list(se_dev, req->dst,
+			req->nbytes, TEGRA_HV_VSE_AES_MAX_LL_NUM,
+			VIRTUAL_SE_AES_BLOCK_SIZE,
+			ivc_tx->args.aes.op.dst_addr, &dst_num,
+			DMA_FROM_DEVICE);
+		if (err) {
+			tegra_hv_vse_unmap_sg(se_dev, req->src, req->nbytes,
+				DMA_TO_DEVICE);
+			return err;
+		}
+	}
+
+	ivc_tx->args.aes.op.src_ll_num = src_num;
+	ivc_tx->args.aes.op.dst_ll_num = dst_num;
+
+	return 0;
+}
+
 static void complete_call_back(void *data)
 {
 	int k;
@@ -1344,8 +1451,9 @@ static void complete_call_back(void *data)
 		return;
 	}
 
-	dma_sync_single_for_cpu(priv->se_dev->dev, priv->buf_addr,
-		priv->gather_buf_sz, DMA_BIDIRECTIONAL);
+	if (priv->gather_buf_sz)
+		dma_sync_single_for_cpu(priv->se_dev->dev, priv->buf_addr,
+			priv->gather_buf_sz, DMA_BIDIRECTIONAL);
 	buf = priv->buf;
 	for (k = 0; k < priv->req_cnt; k++) {
 		req = priv->reqs[k];
@@ -1354,6 +1462,13 @@ static void complete_call_back(void *data)
 			return;
 		}
 
+		if (priv->direct[k]) {
+			tegra_hv_vse_aes_unmap_req(priv->se_dev, req);
+			if (req->base.complete)
+				req->base.complete(&req->base, err);
+			continue;
+		}
+
 		num_sgs = tegra_hv_vse_count_sgs(req->dst, req->nbytes);
 		if (num_sgs == 1)
 			memcpy(sg_virt(req->dst), buf, req->nbytes);
@@ -1364,7 +1479,9 @@ static void complete_call_back(void *data)
 		if (req->base.complete)
 			req->base.complete(&req->base, err);
 	}
-	dma_unmap_sg(priv->se_dev->dev, &priv->sg, 1, DMA_BIDIRECTIONAL);
+	if (priv->gather_buf_sz)
+		dma_unmap_sg(priv->se_dev->dev, &priv->sg, 1,
+			DMA_BIDIRECTIONAL);
 	kfree(priv->buf);
 }
 
@@ -1376,13 +1493,25 @@ static int tegra_hv_se_setup_ablk_req(struct tegra_virtual_se_dev *se_dev,
 	int i = 0;
 	u32 num_sgs;
 
-	priv->buf = kmalloc(se_dev->gather_buf_sz, GFP_KERNEL);
+	priv->gather_buf_sz = 0;
+	for (i = 0; i < se_dev->req_cnt; i++) {
+		priv->direct[i] = tegra_hv_vse_aes_can_map(se_dev->reqs[i]);
+		if (!priv->direct[i])
+			priv->gather_buf_sz += se_dev->reqs[i]->nbytes;
+	}
+
+	if (!priv->gather_buf_sz)
+		return 0;
+
+	priv->buf = kmalloc(priv->gather_buf_sz, GFP_KERNEL);
 	if (!priv->buf)
 		return -ENOMEM;
 
 	buf = priv->buf;
 	for (i = 0; i < se_dev->req_cnt; i++) {
 		req = se_dev->reqs[i];
+		if (priv->direct[i])
+			continue;
 		num_sgs = tegra_hv_vse_count_sgs(req->src, req->nbytes);
 		if (num_sgs == 1)
 			memcpy(buf, sg_virt(req->src), req->nbytes);
@@ -1392,7 +1521,7 @@ static int tegra_hv_se_setup_ablk_req(struct tegra_virtual_se_dev *se_dev,
 		buf += req->nbytes;
 	}
 
-	sg_init_one(&priv->sg, priv->buf, se_dev->gather_buf_sz);
+	sg_init_one(&priv->sg, priv->buf, priv->gather_buf_sz);
 	dma_map_sg(se_dev->dev, &priv->sg, 1, DMA_BIDIRECTIONAL);
 	priv->buf_addr = sg_dma_address(&priv->sg);
 
@@ -1447,20 +1576,25 @@ static void tegra_hv_vse_process_new_req(struct tegra_virtual_se_dev *se_dev)
 			goto exit;
 		}
 		tegra_hv_vse_prpare_cmd(se_dev, ivc_tx, req_ctx, aes_ctx, req);
+		ivc_tx->args.aes.op.data_length = req->nbytes;
+		if (priv->direct[k]) {
+			err = tegra_hv_vse_aes_map_req(se_dev, req, ivc_tx);
+			if (err)
+				goto exit;
+			cur_map_cnt++;
+			continue;
+		}
 		ivc_tx->args.aes.op.src_ll_num = 1;
 		ivc_tx->args.aes.op.dst_ll_num = 1;
 		ivc_tx->args.aes.op.src_addr[0].lo = cur_addr;
 		ivc_tx->args.aes.op.src_addr[0].hi = req->nbytes;
 		ivc_tx->args.aes.op.dst_addr[0].lo = cur_addr;
 		ivc_tx->args.aes.op.dst_addr[0].hi = req->nbytes;
-		ivc_tx->args.aes.op.data_length = req->nbytes;
-		cur_map_cnt++;
 		cur_addr += req->nbytes;
 	}
 	ivc_req_msg->hdr.num_reqs = se_dev->req_cnt;
 
 	priv->req_cnt = se_dev->req_cnt;
-	priv->gather_buf_sz = se_dev->gather_buf_sz;
 	priv->call_back_vse = &complete_call_back;
 	priv_data_ptr = (struct tegra_vse_tag *)ivc_req_msg->hdr.tag;
 	priv_data_ptr->priv_data = (unsigned int *)priv;
@@ -1469,9 +1603,8 @@ static void tegra_hv_vse_process_new_req(struct tegra_virtual_se_dev *se_dev)
 	for (i = 0; i < se_dev->req_cnt; i++)
 		priv->reqs[i] = se_dev->reqs[i];
 
-	while (atomic_read(&se_dev->ivc_count) >=
-			TEGRA_HV_VSE_NUM_SERVER_REQ)
-		usleep_range(8, 10);
+	wait_event(se_dev->ivc_wq, atomic_read(&se_dev->ivc_count) <
+			se_dev->max_ivc_msgs);
 
 	atomic_add(1, &se_dev->ivc_count);
 	vse_thread_start = true;
@@ -1480,12 +1613,18 @@ static void tegra_hv_vse_process_new_req(struct tegra_virtual_se_dev *se_dev)
 	if (err) {
 		dev_err(se_dev->dev,
 			"\n %s send ivc failed %d\n", __func__, err);
+		atomic_sub(1, &se_dev->ivc_count);
+		wake_up(&se_dev->ivc_wq);
 		goto exit;
 	}
 	goto exit_return;
 
 exit:
-	dma_unmap_sg(se_dev->dev, &priv->sg, 1, DMA_BIDIRECTIONAL);
+	for (i = 0; i < k; i++)
+		if (priv->direct[i])
+			tegra_hv_vse_aes_unmap_req(se_dev, se_dev->reqs[i]);
+	if (priv->gather_buf_sz)
+		dma_unmap_sg(se_dev->dev, &priv->sg, 1, DMA_BIDIRECTIONAL);
 
 err_exit:
 	if (priv) {
@@ -3072,6 +3211,7 @@ static int tegra_vse_kthread(void *unused)
 			case VIRTUAL_SE_AES_CRYPTO:
 				priv->call_back_vse(priv);
 				atomic_sub(1, &se_dev->ivc_count);
+				wake_up(&se_dev->ivc_wq);
 				devm_kfree(se_dev->dev, priv);
 				break;
 			case VIRTUAL_SE_KEY_SLOT:
@@ -3113,6 +3253,7 @@ static int tegra_hv_vse_probe(struct platform_device *pdev)
 	int i;
 	unsigned int ivc_id;
 	unsigned int engine_id;
+	u32 queue_depth;
 
 	se_dev = devm_kzalloc(&pdev->dev,
 				sizeof(struct tegra_virtual_se_dev),
@@ -3184,9 +3325,28 @@ static int tegra_hv_vse_probe(struct platform_device *pdev)
 	}
 
 	if (engine_id == VIRTUAL_SE_AES1) {
+		/*
+		 * The request queue and the number of AES messages kept
+		 * in flight with the server can be sized per platform; the
+		 * latter is bounded by the frames the IVC queue holds.
+		 */
+		if (of_property_read_u32(pdev->dev.of_node, "queue-depth",
+					 &queue_depth) || !queue_depth)
+			queue_depth = TEGRA_HV_VSE_CRYPTO_QUEUE_LENGTH;
+		if (of_property_read_u32(pdev->dev.of_node, "ivc-frames",
+					 &se_dev->max_ivc_msgs) ||
+		    !se_dev->max_ivc_msgs)
+			se_dev->max_ivc_msgs = TEGRA_HV_VSE_NUM_SERVER_REQ;
+		if (g_ivck->nframes > 0 &&
+		    se_dev->max_ivc_msgs > g_ivck->nframes)
+			se_dev->max_ivc_msgs = g_ivck->nframes;
+		atomic_set(&se_dev->ivc_count, 0);
+		init_waitqueue_head(&se_dev->ivc_wq);
+		dev_info(se_dev->dev, "queue depth %u, %u IVC messages\n",
+			queue_depth, se_dev->max_ivc_msgs);
+
 		INIT_WORK(&se_dev->se_work, tegra_hv_vse_work_handler);
-		crypto_init_queue(&se_dev->queue,
-			TEGRA_HV_VSE_CRYPTO_QUEUE_LENGTH);
+		crypto_init_queue(&se_dev->queue, queue_depth);
 		spin_lock_init(&se_dev->lock);
 		se_dev->vse_work_q = alloc_workqueue("vse_work_q",
 			WQ_HIGHPRI | WQ_UNBOUND, 1);
@@ -3211,7 +3371,6 @@ static int tegra_hv_vse_probe(struct platform_device *pdev)
 				"cmac alg register failed. Err %d\n", err);
 			goto exit;
 		}
-		atomic_set(&se_dev->ivc_count, 0);
 	}
 
 	if (engine_id == VIRTUAL_SE_SHA) {
@@ -3270,8 +3429,8 @@ static void tegra_hv_vse_shutdown(struct platform_device *pdev)
 		flush_workqueue(se_dev->vse_work_q);
 
 		/* Make sure that there are no pending tasks with SE server */
-		while (atomic_read(&se_dev->ivc_count) != 0)
-			usleep_range(8, 10);
+		wait_event(se_dev->ivc_wq,
+			atomic_read(&se_dev->ivc_count) == 0);
 	}
 
 	/* Wait for  SE server to be free*/
@@ -0,0 +1,520 @@
+/*
+ * Cryptographic API.
+ * drivers/crypto/tegra-se-bench.c
+ *
+ * Throughput and latency benchmark for the Tegra Security Engine drivers.
+ *
+ * Copyright (c) 2018, NVIDIA Corporation. All Rights Reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#include <linux/module.h>
+#include <linux/init.h>
+#include <linux/errno.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/scatterlist.h>
+#include <linux/completion.h>
+#include <linux/llist.h>
+#include <linux/ktime.h>
+#include <linux/random.h>
+#include <linux/sort.h>
+#include <crypto/aes.h>
+#include <crypto/hash.h>
+#include <crypto/rng.h>
+#include <crypto/sha.h>
+#include <crypto/skcipher.h>
+
+/*
+ * Every algorithm in the table is run on each of its drivers that is
+ * registered, for every key length, request size and queue depth. The
+ * last driver of an entry is the CPU implementation the engine is
+ * compared against. Results go to the kernel log; like tcrypt, loading
+ * the module fails with -EAGAIN once the run is done.
+ */
+
+#define BENCH_MAX_DRIVERS	4
+#define BENCH_MAX_KEYLENS	3
+#define BENCH_MAX_SAMPLES	4096
+#define BENCH_MAX_DEPTH		64
+#define BENCH_MAX_SIZES		16
+
+enum tegra_se_bench_type {
+	BENCH_SKCIPHER,
+	BENCH_AHASH,
+	BENCH_RNG,
+};
+
+struct tegra_se_bench_alg {
+	const char *name;
+	enum tegra_se_bench_type type;
+	unsigned int keylens[BENCH_MAX_KEYLENS];	/* 0: unkeyed */
+	const char *drivers[BENCH_MAX_DRIVERS];
+};
+
+static const struct tegra_se_bench_alg tegra_se_bench_algs[] = {
+	{
+		.name = "cbc(aes)",
+		.type = BENCH_SKCIPHER,
+		.keylens = { 16, 24, 32 },
+		.drivers = { "cbc-aes-tegra", "cbc-aes-ce" },
+	}, {
+		.name = "ecb(aes)",
+		.type = BENCH_SKCIPHER,
+		.keylens = { 16, 24, 32 },
+		.drivers = { "ecb-aes-tegra", "ecb-aes-ce" },
+	}, {
+		.name = "ctr(aes)",
+		.type = BENCH_SKCIPHER,
+		.keylens = { 16, 24, 32 },
+		.drivers = { "ctr-aes-tegra", "ctr-aes-ce" },
+	}, {
+		.name = "xts(aes)",
+		.type = BENCH_SKCIPHER,
+		.keylens = { 32, 64 },
+		.drivers = { "xts-aes-tegra", "xts-aes-ce" },
+	}, {
+		.name = "cmac(aes)",
+		.type = BENCH_AHASH,
+		.keylens = { 16, 24, 32 },
+		.drivers = { "tegra-se-cmac(aes)", "tegra-hv-vse-cmac(aes)",
+			     "cmac(aes-ce)" },
+	}, {
+		.name = "sha1",
+		.type = BENCH_AHASH,
+		.drivers = { "tegra-se-sha1", "tegra-hv-vse-sha1", "sha1-ce" },
+	}, {
+		.name = "sha256",
+		.type = BENCH_AHASH,
+		.drivers = { "tegra-se-sha256", "tegra-hv-vse-sha256",
+			     "sha256-ce" },
+	}, {
+		.name = "sha512",
+		.type = BENCH_AHASH,
+		.drivers = { "tegra-se-sha512", "tegra-hv-vse-sha512",
+			     "sha512-generic" },
+	}, {
+		.name = "rng",
+		.type = BENCH_RNG,
+		.drivers = { "trng_elp-tegra", "rng1-elp-tegra",
+			     "rng_drbg-aes-tegra", "drbg_nopr_ctr_aes256" },
+	},
+};
+
+static char *alg;
+module_param(alg, charp, S_IRUGO);
+MODULE_PARM_DESC(alg, "Only run this algorithm, e.g. \"cbc(aes)\"");
+
+static char *driver;
+module_param(driver, charp, S_IRUGO);
+MODULE_PARM_DESC(driver, "Only run this driver, e.g. \"cbc-aes-tegra\"");
+
+static unsigned int msecs = 500;
+module_param(msecs, uint, S_IRUGO);
+MODULE_PARM_DESC(msecs, "Time spent on each data point (in ms)");
+
+static unsigned int sizes[BENCH_MAX_SIZES] = {
+	16, 64, 256, 1024, 4096, 16384, 65536,
+};
+static unsigned int nr_sizes = 7;
+module_param_array(sizes, uint, &nr_sizes, S_IRUGO);
+MODULE_PARM_DESC(sizes, "Request sizes (in bytes)");
+
+static unsigned int depths[BENCH_MAX_SIZES] = { 1, 8, 32 };
+static unsigned int nr_depths = 3;
+module_param_array(depths, uint, &nr_depths, S_IRUGO);
+MODULE_PARM_DESC(depths, "Number of requests kept in flight");
+
+struct tegra_se_bench;
+
+struct tegra_se_bench_req {
+	struct llist_node node;
+	struct tegra_se_bench *b;
+	struct skcipher_request *sk_req;
+	struct ahash_request *ah_req;
+	struct scatterlist sg;
+	u8 *buf;
+	u8 iv[AES_BLOCK_SIZE];
+	u8 digest[SHA512_DIGEST_SIZE];
+	ktime_t start;
+	u32 lat_ns;
+	int err;
+};
+
+struct tegra_se_bench {
+	const struct tegra_se_bench_alg *alg;
+	struct crypto_skcipher *sk;
+	struct crypto_ahash *ah;
+	struct crypto_rng *rng;
+	struct tegra_se_bench_req reqs[BENCH_MAX_DEPTH];
+	unsigned int size;
+	unsigned int depth;
+	struct llist_head done;
+	struct completion event;
+	u32 lat[BENCH_MAX_SAMPLES];	/* latency samples, ns */
+	u64 nr_ops;
+};
+
+static void tegra_se_bench_done(struct tegra_se_bench_req *r, int err)
+{
+	struct tegra_se_bench *b = r->b;
+
+	r->lat_ns = min_t(s64, ktime_to_ns(ktime_sub(ktime_get(), r->start)),
+			  U32_MAX);
+	r->err = err;
+	llist_add(&r->node, &b->done);
+	complete(&b->event);
+}
+
+static void tegra_se_bench_complete(struct crypto_async_request *areq,
+				    int err)
+{
+	/* a backlogged request has been queued */
+	if (err == -EINPROGRESS)
+		return;
+
+	tegra_se_bench_done(areq->data, err);
+}
+
+static void tegra_se_bench_submit(struct tegra_se_bench_req *r)
+{
+	int ret;
+
+	r->start = ktime_get();
+	if (r->b->alg->type == BENCH_SKCIPHER)
+		ret = crypto_skcipher_encrypt(r->sk_req);
+	else
+		ret = crypto_ahash_digest(r->ah_req);
+
+	if (ret != -EINPROGRESS && ret != -EBUSY)
+		tegra_se_bench_done(r, ret);
+}
+
+static void tegra_se_bench_record(struct tegra_se_bench *b, u32 lat_ns)
+{
+	b->lat[b->nr_ops % BENCH_MAX_SAMPLES] = lat_ns;
+	b->nr_ops++;
+}
+
+static void tegra_se_bench_free_reqs(struct tegra_se_bench *b)
+{
+	struct tegra_se_bench_req *r;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_MAX_DEPTH; i++) {
+		r = &b->reqs[i];
+		skcipher_request_free(r->sk_req);
+		ahash_request_free(r->ah_req);
+		kfree(r->buf);
+		memset(r, 0, sizeof(*r));
+	}
+}
+
+static int tegra_se_bench_alloc_reqs(struct tegra_se_bench *b)
+{
+	struct tegra_se_bench_req *r;
+	unsigned int i;
+
+	for (i = 0; i < b->depth; i++) {
+		r = &b->reqs[i];
+		r->b = b;
+		r->buf = kmalloc(b->size, GFP_KERNEL);
+		if (!r->buf)
+			return -ENOMEM;
+
+		get_random_bytes(r->buf, b->size);
+		get_random_bytes(r->iv, sizeof(r->iv));
+		sg_init_one(&r->sg, r->buf, b->size);
+
+		if (b->alg->type == BENCH_SKCIPHER) {
+			r->sk_req = skcipher_request_alloc(b->sk, GFP_KERNEL);
+			if (!r->sk_req)
+				return -ENOMEM;
+
+			skcipher_request_set_callback(r->sk_req,
+				CRYPTO_TFM_REQ_MAY_BACKLOG,
+				tegra_se_bench_complete, r);
+			skcipher_request_set_crypt(r->sk_req, &r->sg, &r->sg,
+						   b->size, r->iv);
+		} else {
+			r->ah_req = ahash_request_alloc(b->ah, GFP_KERNEL);
+			if (!r->ah_req)
+				return -ENOMEM;
+
+			ahash_request_set_callback(r->ah_req,
+				CRYPTO_TFM_REQ_MAY_BACKLOG,
+				tegra_se_bench_complete, r);
+			ahash_request_set_crypt(r->ah_req, &r->sg, r->digest,
+						b->size);
+		}
+	}
+
+	return 0;
+}
+
+/* Keep @depth requests in flight until the time is up, then drain them */
+static int tegra_se_bench_run_async(struct tegra_se_bench *b)
+{
+	struct tegra_se_bench_req *r, *tmp;
+	struct llist_node *list;
+	unsigned int i, inflight;
+	ktime_t end;
+	int err;
+
+	err = tegra_se_bench_alloc_reqs(b);
+	if (err)
+		return err;
+
+	init_llist_head(&b->done);
+	init_completion(&b->event);
+	end = ktime_add_ms(ktime_get(), msecs);
+
+	for (i = 0; i < b->depth; i++)
+		tegra_se_bench_submit(&b->reqs[i]);
+
+	inflight = b->depth;
+	while (inflight) {
+		wait_for_completion(&b->event);
+
+		list = llist_del_all(&b->done);
+		llist_for_each_entry_safe(r, tmp, list, node) {
+			inflight--;
+			if (r->err) {
+				err = r->err;
+				continue;
+			}
+
+			tegra_se_bench_record(b, r->lat_ns);
+			if (!err && ktime_before(ktime_get(), end)) {
+				inflight++;
+				tegra_se_bench_submit(r);
+			}
+		}
+	}
+
+	return err;
+}
+
+/* The RNGs are synchronous, so depth does not apply */
+static int tegra_se_bench_run_rng(struct tegra_se_bench *b)
+{
+	ktime_t start, end;
+	u8 *buf;
+	int err = 0;
+
+	buf = kmalloc(b->size, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	end = ktime_add_ms(ktime_get(), msecs);
+	while (ktime_before(ktime_get(), end)) {
+		start = ktime_get();
+		err = crypto_rng_get_bytes(b->rng, buf, b->size);
+		if (err)
+			break;
+
+		tegra_se_bench_record(b, min_t(s64,
+			ktime_to_ns(ktime_sub(ktime_get(), start)), U32_MAX));
+	}
+
+	kzfree(buf);
+
+	return err;
+}
+
+static int tegra_se_bench_cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static u32 tegra_se_bench_percentile(struct tegra_se_bench *b,
+				     unsigned int nr, unsigned int pct)
+{
+	return b->lat[(nr - 1) * pct / 100] / NSEC_PER_USEC;
+}
+
+static void tegra_se_bench_point(struct tegra_se_bench *b, const char *drv,
+				 unsigned int keylen)
+{
+	unsigned int nr;
+	ktime_t start;
+	u64 elapsed_ns, elapsed_us;
+	int err;
+
+	b->nr_ops = 0;
+	start = ktime_get();
+	if (b->alg->type == BENCH_RNG)
+		err = tegra_se_bench_run_rng(b);
+	else
+		err = tegra_se_bench_run_async(b);
+	elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	tegra_se_bench_free_reqs(b);
+
+	if (err) {
+		pr_err("%s: %s key %u size %u depth %u failed: %d\n",
+		       b->alg->name, drv, keylen * 8, b->size, b->depth, err);
+		return;
+	}
+
+	if (!b->nr_ops)
+		return;
+
+	nr = min_t(u64, b->nr_ops, BENCH_MAX_SAMPLES);
+	sort(b->lat, nr, sizeof(b->lat[0]), tegra_se_bench_cmp_u32, NULL);
+	elapsed_us = max_t(u64, div64_u64(elapsed_ns, NSEC_PER_USEC), 1);
+
+	/* bytes per microsecond is MB/s */
+	pr_info("%s: %s key %u size %u depth %u: %llu ops/s %llu MB/s lat(us) p50 %u p90 %u p99 %u max %u\n",
+		b->alg->name, drv, keylen * 8, b->size, b->depth,
+		div64_u64(b->nr_ops * USEC_PER_SEC, elapsed_us),
+		div64_u64(b->nr_ops * b->size, elapsed_us),
+		tegra_se_bench_percentile(b, nr, 50),
+		tegra_se_bench_percentile(b, nr, 90),
+		tegra_se_bench_percentile(b, nr, 99),
+		b->lat[nr - 1] / NSEC_PER_USEC);
+}
+
+static int tegra_se_bench_setkey(struct tegra_se_bench *b,
+				 unsigned int keylen)
+{
+	u8 key[AES_MAX_KEY_SIZE * 2];
+	int err = 0;
+
+	if (!keylen)
+		return 0;
+
+	get_random_bytes(key, keylen);
+	if (b->alg->type == BENCH_SKCIPHER)
+		err = crypto_skcipher_setkey(b->sk, key, keylen);
+	else if (b->alg->type == BENCH_AHASH)
+		err = crypto_ahash_setkey(b->ah, key, keylen);
+	memzero_explicit(key, sizeof(key));
+
+	return err;
+}
+
+static int tegra_se_bench_alloc_tfm(struct tegra_se_bench *b,
+				    const char *drv)
+{
+	switch (b->alg->type) {
+	case BENCH_SKCIPHER:
+		b->sk = crypto_alloc_skcipher(drv, 0, 0);
+		return PTR_ERR_OR_ZERO(b->sk);
+	case BENCH_AHASH:
+		b->ah = crypto_alloc_ahash(drv, 0, 0);
+		return PTR_ERR_OR_ZERO(b->ah);
+	case BENCH_RNG:
+		b->rng = crypto_alloc_rng(drv, 0, 0);
+		if (IS_ERR(b->rng))
+			return PTR_ERR(b->rng);
+		return crypto_rng_reset(b->rng, NULL, crypto_rng_seedsize(b->rng));
+	}
+
+	return -EINVAL;
+}
+
+static void tegra_se_bench_free_tfm(struct tegra_se_bench *b)
+{
+	if (!IS_ERR_OR_NULL(b->sk))
+		crypto_free_skcipher(b->sk);
+	if (!IS_ERR_OR_NULL(b->ah))
+		crypto_free_ahash(b->ah);
+	if (!IS_ERR_OR_NULL(b->rng))
+		crypto_free_rng(b->rng);
+	b->sk = NULL;
+	b->ah = NULL;
+	b->rng = NULL;
+}
+
+static void tegra_se_bench_driver(struct tegra_se_bench *b, const char *drv)
+{
+	const struct tegra_se_bench_alg *a = b->alg;
+	unsigned int k, s, d;
+	int err;
+
+	err = tegra_se_bench_alloc_tfm(b, drv);
+	if (err) {
+		if (err != -ENOENT)
+			pr_err("%s: %s not usable: %d\n", a->name, drv, err);
+		goto out;
+	}
+
+	k = 0;
+	do {
+		err = tegra_se_bench_setkey(b, a->keylens[k]);
+		if (err) {
+			pr_err("%s: %s setkey %u failed: %d\n",
+			       a->name, drv, a->keylens[k] * 8, err);
+			continue;
+		}
+
+		for (s = 0; s < nr_sizes; s++) {
+			for (d = 0; d < nr_depths; d++) {
+				b->size = sizes[s];
+				b->depth = clamp_t(unsigned int, depths[d], 1,
+						   BENCH_MAX_DEPTH);
+				if (a->type == BENCH_RNG && d)
+					break;
+
+				tegra_se_bench_point(b, drv, a->keylens[k]);
+				cond_resched();
+			}
+		}
+	} while (++k < BENCH_MAX_KEYLENS && a->keylens[k]);
+
+out:
+	tegra_se_bench_free_tfm(b);
+}
+
+static int __init tegra_se_bench_init(void)
+{
+	const struct tegra_se_bench_alg *a;
+	struct tegra_se_bench *b;
+	unsigned int i, j;
+
+	b = vzalloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(tegra_se_bench_algs); i++) {
+		a = &tegra_se_bench_algs[i];
+		if (alg && strcmp(alg, a->name))
+			continue;
+
+		b->alg = a;
+		for (j = 0; j < BENCH_MAX_DRIVERS && a->drivers[j]; j++) {
+			if (driver && strcmp(driver, a->drivers[j]))
+				continue;
+
+			tegra_se_bench_driver(b, a->drivers[j]);
+		}
+	}
+
+	vfree(b);
+
+	/* nothing to keep loaded, see the comment at the top */
+	return -EAGAIN;
+}
+
+static void __exit tegra_se_bench_exit(void)
+{
+}
+
+module_init(tegra_se_bench_init);
+module_exit(tegra_se_bench_exit);
+
+MODULE_DESCRIPTION("Tegra Security Engine throughput and latency benchmark");
+MODULE_AUTHOR("NVIDIA Corporation");
+MODULE_LICENSE("GPL");
@@ -28,6 +28,8 @@
 #include <linux/of_device.h>
 #include <linux/types.h>
 #include <linux/errno.h>
+#include <linux/hw_random.h>
+#include <linux/workqueue.h>
 #include <soc/tegra/chip-id.h>
 #include <crypto/akcipher.h>
 #include <crypto/hash.h>
@@ -67,6 +69,11 @@
 
 #define ECDSA_USE_SHAMIRS_TRICK		1
 
+#define PKA1_PRECOMP_CACHE_SIZE		8
+
+#define TRNG_POOL_SIZE			4096
+#define TRNG_POOL_LOW_WATERMARK		(TRNG_POOL_SIZE / 4)
+
 enum tegra_se_pka_mod_type {
 	MOD_MULT,
 	MOD_ADD,
@@ -132,6 +139,27 @@ struct tegra_se_elp_chipdata {
 	bool weierstrass;
 };
 
+/* Montgomery values of one modulus, see tegra_se_pka1_get_precomp() */
+struct tegra_se_pka1_precomp {
+	u32 op_mode;
+	u32 size;	/* 0 if unused */
+	u32 modulus[ECC_MAX_WORDS];
+	u32 m[ECC_MAX_WORDS];
+	u32 r2[ECC_MAX_WORDS];
+};
+
+/*
+ * TRNG output kept ready for hwrng and crypto_rng readers. The first
+ * @avail bytes of @buf are unused entropy; readers take from the end and
+ * wipe what they took.
+ */
+struct tegra_se_trng_pool {
+	struct mutex lock;
+	u8 *buf;
+	unsigned int avail;
+	struct work_struct refill;
+};
+
 struct tegra_se_elp_dev {
 	struct device *dev;
 	void __iomem *io_reg[2];
@@ -143,6 +171,13 @@ struct tegra_se_elp_dev {
 	u32 *rdata;
 	/* Mutex lock to protect HW */
 	struct mutex hw_lock;
+	/* Task holding PKA1 across operations, see tegra_se_pka1_get() */
+	struct task_struct *pka1_owner;
+	unsigned int pka1_depth;
+	/* Precomputed values of recently used moduli, under hw_lock */
+	struct tegra_se_pka1_precomp precomp[PKA1_PRECOMP_CACHE_SIZE];
+	unsigned int precomp_next;
+	struct tegra_se_trng_pool trng_pool;
 };
 
 static struct tegra_se_elp_dev *elp_dev;
@@ -573,6 +608,79 @@ static void tegra_se_release_pka1_mutex(struct tegra_se_elp_dev *se_dev)
 	} while (val & TEGRA_SE_PKA1_CTRL_SE_STATUS(SE_STATUS_BUSY));
 }
 
+/*
+ * Take the engine for PKA1 work: hw_lock, the clock and the PKA1 hardware
+ * mutex. The holder may nest further PKA1 operations, which then run
+ * back to back without giving the engine up in between; only the
+ * outermost tegra_se_pka1_put() releases it.
+ */
+static int tegra_se_pka1_get(struct tegra_se_elp_dev *se_dev)
+{
+	int ret;
+
+	if (READ_ONCE(se_dev->pka1_owner) == current) {
+		se_dev->pka1_depth++;
+		tegra_se_restart_pka1_mutex_wdt(se_dev);
+		return 0;
+	}
+
+	mutex_lock(&se_dev->hw_lock);
+	ret = clk_prepare_enable(se_dev->c);
+	if (ret) {
+		dev_err(se_dev->dev, "clk_enable failed\n");
+		goto unlock;
+	}
+
+	ret = tegra_se_acquire_pka1_mutex(se_dev);
+	if (ret) {
+		dev_err(se_dev->dev, "PKA1 Mutex acquire failed\n");
+		goto clk_dis;
+	}
+
+	se_dev->pka1_depth = 1;
+	WRITE_ONCE(se_dev->pka1_owner, current);
+
+	return 0;
+
+clk_dis:
+	clk_disable_unprepare(se_dev->c);
+unlock:
+	mutex_unlock(&se_dev->hw_lock);
+	return ret;
+}
+
+static void tegra_se_pka1_put(struct tegra_se_elp_dev *se_dev)
+{
+	if (--se_dev->pka1_depth)
+		return;
+
+	WRITE_ONCE(se_dev->pka1_owner, NULL);
+	tegra_se_release_pka1_mutex(se_dev);
+	clk_disable_unprepare(se_dev->c);
+	mutex_unlock(&se_dev->hw_lock);
+}
+
+/*
+ * Hold PKA1 across a batch of ECC operations, e.g. several signature
+ * verifications through akcipher or tegra_se_pka1_ecc_op(), so that they
+ * neither wait for the hardware mutex nor recompute curve parameters in
+ * between. Must be paired with tegra_se_pka1_batch_end() by the same task.
+ */
+int tegra_se_pka1_batch_begin(void)
+{
+	if (!elp_dev)
+		return -ENODEV;
+
+	return tegra_se_pka1_get(elp_dev);
+}
+EXPORT_SYMBOL(tegra_se_pka1_batch_begin);
+
+void tegra_se_pka1_batch_end(void)
+{
+	tegra_se_pka1_put(elp_dev);
+}
+EXPORT_SYMBOL(tegra_se_pka1_batch_end);
+
 static inline u32 pka1_bank_start(u32 bank)
 {
 	return PKA1_BANK_START_A + (bank * 0x400);
@@ -1927,24 +2035,134 @@ static int tegra_se_execute_rng1_ctrl_cmd(unsigned int cmd)
 	return 0;
 }
 
+static bool tegra_se_pka1_ecc_has_precomp(struct tegra_se_pka1_ecc_request *req)
+{
+	return !(req->op_mode == SE_ELP_OP_MODE_ECC521 ||
+		 req->type == C25519_POINT_MUL ||
+		 req->type == ED25519_POINT_MUL ||
+		 req->type == ED25519_SHAMIR_TRICK);
+}
+
+static bool tegra_se_pka1_mod_has_precomp(struct tegra_se_pka1_mod_request *req)
+{
+	return !(req->op_mode == SE_ELP_OP_MODE_ECC521 ||
+		 req->type == C25519_MOD_EXP || req->type == C25519_MOD_SQR ||
+		 req->type == MOD_SUB || req->type == BIT_SERIAL_DP_MOD_REDUCE ||
+		 req->type == NON_MOD_MULT || req->type == C25519_MOD_MULT);
+}
+
+static struct tegra_se_pka1_precomp *tegra_se_pka1_precomp_find(
+		struct tegra_se_elp_dev *se_dev, u32 op_mode, u32 size,
+		const u32 *modulus)
+{
+	struct tegra_se_pka1_precomp *p;
+	int i;
+
+	for (i = 0; i < PKA1_PRECOMP_CACHE_SIZE; i++) {
+		p = &se_dev->precomp[i];
+		if (p->size == size && p->op_mode == op_mode &&
+		    !memcmp(p->modulus, modulus, size))
+			return p;
+	}
+
+	return NULL;
+}
+
+/* Put a cached modulus and its M and R2 where precompute leaves them */
+static void tegra_se_pka1_precomp_load(struct tegra_se_elp_dev *se_dev,
+				       struct tegra_se_pka1_precomp *p)
+{
+	u32 i;
+
+	for (i = 0; i < p->size / WORD_SIZE_BYTES; i++) {
+		se_elp_writel(se_dev, PKA1, p->modulus[i], reg_bank_offset(
+			      TEGRA_SE_PKA1_MOD_BANK, TEGRA_SE_PKA1_MOD_ID,
+			      p->op_mode) + (i * 4));
+		se_elp_writel(se_dev, PKA1, p->m[i], reg_bank_offset(
+			      TEGRA_SE_PKA1_M_BANK, TEGRA_SE_PKA1_M_ID,
+			      p->op_mode) + (i * 4));
+		se_elp_writel(se_dev, PKA1, p->r2[i], reg_bank_offset(
+			      TEGRA_SE_PKA1_R2_BANK, TEGRA_SE_PKA1_R2_ID,
+			      p->op_mode) + (i * 4));
+	}
+}
+
+static void tegra_se_pka1_precomp_store(struct tegra_se_elp_dev *se_dev,
+					u32 op_mode, u32 size,
+					const u32 *modulus, const u32 *m,
+					const u32 *r2)
+{
+	struct tegra_se_pka1_precomp *p;
+
+	p = &se_dev->precomp[se_dev->precomp_next];
+	se_dev->precomp_next = (se_dev->precomp_next + 1) %
+		PKA1_PRECOMP_CACHE_SIZE;
+
+	p->op_mode = op_mode;
+	p->size = size;
+	memcpy(p->modulus, modulus, size);
+	memcpy(p->m, m, size);
+	memcpy(p->r2, r2, size);
+}
+
+/*
+ * The three precompute programs only depend on the modulus, and the
+ * operations making up an ECDSA or EdDSA verify keep coming back to the
+ * same couple of them (the curve prime and order). ECC and modular
+ * requests therefore look the modulus up in a small cache first and, on a
+ * hit, just load the saved values into the banks.
+ */
 static int tegra_se_pka1_get_precomp(struct tegra_se_pka1_rsa_context *ctx,
 				     struct tegra_se_pka1_ecc_request *ecc_req,
 				     struct tegra_se_pka1_mod_request *mod_req)
 {
 	int ret;
 	struct tegra_se_elp_dev *se_dev;
+	struct tegra_se_pka1_precomp *p;
+	bool cacheable = false;
+	u32 op_mode = 0, size = 0;
+	u32 *MOD = NULL, *M = NULL, *R2 = NULL;
 
 	if (ctx) {
 		se_dev = ctx->se_dev;
 	} else if (ecc_req) {
 		se_dev = ecc_req->se_dev;
+		if (tegra_se_pka1_ecc_has_precomp(ecc_req)) {
+			cacheable = true;
+			op_mode = ecc_req->op_mode;
+			size = ecc_req->size;
+			MOD = ecc_req->modulus;
+			M = ecc_req->m;
+			R2 = ecc_req->r2;
+		}
 	} else if (mod_req) {
 		se_dev = mod_req->se_dev;
+		if (tegra_se_pka1_mod_has_precomp(mod_req)) {
+			cacheable = true;
+			op_mode = mod_req->op_mode;
+			size = mod_req->size;
+			MOD = mod_req->modulus;
+			M = mod_req->m;
+			R2 = mod_req->r2;
+		}
 	} else {
 		pr_err("Invalid rsa context\n");
 		return -EINVAL;
 	}
 
+	if (size > ECC_MAX_WORDS * WORD_SIZE_BYTES)
+		cacheable = false;
+
+	if (cacheable) {
+		p = tegra_se_pka1_precomp_find(se_dev, op_mode, size, MOD);
+		if (p) {
+			memcpy(M, p->m, size);
+			memcpy(R2, p->r2, size);
+			tegra_se_pka1_precomp_load(se_dev, p);
+			return 0;
+		}
+	}
+
 	ret = tegra_se_pka1_precomp(ctx, ecc_req, mod_req, PRECOMP_RINV);
 	if (ret) {
 		dev_err(se_dev->dev,
@@ -1958,9 +2176,14 @@ static int tegra_se_pka1_get_precomp(struct tegra_se_pka1_rsa_context *ctx,
 		return ret;
 	}
 	ret = tegra_se_pka1_precomp(ctx, ecc_req, mod_req, PRECOMP_R2);
-	if (ret)
+	if (ret) {
 		dev_err(se_dev->dev,
 			"R2: tegra_se_pka1_precomp Failed(%d)\n", ret);
+		return ret;
+	}
+
+	if (cacheable)
+		tegra_se_pka1_precomp_store(se_dev, op_mode, size, MOD, M, R2);
 
 	return ret;
 }
@@ -2064,18 +2287,9 @@ int tegra_se_pka1_ecc_op(struct tegra_se_pka1_ecc_request *req)
 		return ret;
 
 	se_dev = req->se_dev;
-	mutex_lock(&se_dev->hw_lock);
-	ret = clk_prepare_enable(se_dev->c);
-	if (ret) {
-		dev_err(se_dev->dev, "clk_enable failed\n");
+	ret = tegra_se_pka1_get(se_dev);
+	if (ret)
 		goto ecc_exit;
-	}
-
-	ret = tegra_se_acquire_pka1_mutex(se_dev);
-	if (ret) {
-		dev_err(se_dev->dev, "PKA1 Mutex acquire failed\n");
-		goto clk_dis;
-	}
 
 	ret = tegra_se_pka1_get_precomp(NULL, req, NULL);
 	if (ret)
@@ -2083,11 +2297,8 @@ int tegra_se_pka1_ecc_op(struct tegra_se_pka1_ecc_request *req)
 
 	ret = tegra_se_pka1_ecc_do(req);
 exit:
-	tegra_se_release_pka1_mutex(se_dev);
-clk_dis:
-	clk_disable_unprepare(se_dev->c);
+	tegra_se_pka1_put(se_dev);
 ecc_exit:
-	mutex_unlock(&se_dev->hw_lock);
 	tegra_se_pka1_ecc_exit(req);
 
 	return ret;
@@ -2109,18 +2320,9 @@ static int tegra_se_pka1_mod_op(struct tegra_se_pka1_mod_request *req)
 		return ret;
 
 	se_dev = req->se_dev;
-	mutex_lock(&se_dev->hw_lock);
-	ret = clk_prepare_enable(se_dev->c);
-	if (ret) {
-		dev_err(se_dev->dev, "clk_enable failed\n");
+	ret = tegra_se_pka1_get(se_dev);
+	if (ret)
 		goto mod_exit;
-	}
-
-	ret = tegra_se_acquire_pka1_mutex(se_dev);
-	if (ret) {
-		dev_err(se_dev->dev, "PKA1 Mutex acquire failed\n");
-		goto clk_dis;
-	}
 
 	ret = tegra_se_pka1_get_precomp(NULL, NULL, req);
 	if (ret)
@@ -2128,11 +2330,8 @@ static int tegra_se_pka1_mod_op(struct tegra_se_pka1_mod_request *req)
 
 	ret = tegra_se_pka1_mod_do(req);
 exit:
-	tegra_se_release_pka1_mutex(se_dev);
-clk_dis:
-	clk_disable_unprepare(se_dev->c);
+	tegra_se_pka1_put(se_dev);
 mod_exit:
-	mutex_unlock(&se_dev->hw_lock);
 	tegra_se_pka1_mod_exit(req);
 
 	return ret;
@@ -3133,7 +3332,7 @@ free_mem:
 	return ret;
 }
 
-static int tegra_se_eddsa_verify(struct akcipher_request *req)
+static int tegra_se_eddsa_do_verify(struct akcipher_request *req)
 {
 	struct crypto_akcipher *tfm = crypto_akcipher_reqtfm(req);
 	struct tegra_se_eddsa_ctx *ctx = akcipher_tfm_ctx(tfm);
@@ -3244,6 +3443,21 @@ free_pt:
 	return ret;
 }
 
+/* All the PKA1 operations of one verify run without releasing the engine */
+static int tegra_se_eddsa_verify(struct akcipher_request *req)
+{
+	int ret;
+
+	ret = tegra_se_pka1_get(elp_dev);
+	if (ret)
+		return ret;
+
+	ret = tegra_se_eddsa_do_verify(req);
+	tegra_se_pka1_put(elp_dev);
+
+	return ret;
+}
+
 static int tegra_se_eddsa_max_size(struct crypto_akcipher *tfm)
 {
 	struct tegra_se_eddsa_ctx *ctx = akcipher_tfm_ctx(tfm);
@@ -3983,58 +4197,158 @@ static void tegra_se_elp_trng_get_data(struct tegra_se_elp_dev *se_dev,
 	}
 }
 
-static int tegra_se_elp_trng_get_random(struct crypto_rng *tfm,
-		const u8 *src, unsigned int slen,
-		u8 *rdata, unsigned int dlen)
+/* Read @dlen bytes straight from the PKA1 TRNG */
+static int tegra_se_elp_trng_read(struct tegra_se_elp_dev *se_dev,
+				  u8 *rdata, unsigned int dlen)
 {
-	struct tegra_se_elp_trng_context *trng_ctx =
-				crypto_tfm_ctx(crypto_rng_tfm(tfm));
-	struct tegra_se_elp_dev *se_dev = trng_ctx->se_dev;
-	int ret = 0, i, num_blocks, data_len = 0;
-	u32 *rand_num;
-
-	rand_num = devm_kzalloc(se_dev->dev, RAND_256, GFP_KERNEL);
-	num_blocks = (dlen / RAND_256);
-	data_len = (dlen % RAND_256);
-	if (data_len == 0)
-		num_blocks = num_blocks - 1;
-
-	mutex_lock(&se_dev->hw_lock);
-	clk_prepare_enable(se_dev->c);
+	u32 rand_num[RAND_256 / WORD_SIZE_BYTES];
+	unsigned int len;
+	int ret;
 
-	ret = tegra_se_acquire_pka1_mutex(se_dev);
-	if (ret) {
-		dev_err(se_dev->dev, "PKA1 Mutex acquire failed\n");
-		goto clk_dis;
-	}
+	ret = tegra_se_pka1_get(se_dev);
+	if (ret)
+		return ret;
 
 	tegra_se_set_pka1_op_ready(se_dev);
 
-	for (i = 0; i <= num_blocks; i++) {
+	while (dlen) {
 		se_elp_writel(se_dev, PKA1,
 			TEGRA_SE_PKA1_TRNG_CTRL_CMD(ELP_ENABLE),
 			TEGRA_SE_PKA1_TRNG_CTRL_OFFSET);
 
 		ret = tegra_se_check_pka1_op_done(se_dev);
 		if (ret)
-			goto rel_mutex;
+			break;
 
 		tegra_se_elp_trng_get_data(se_dev, rand_num);
-		if (data_len && (i == num_blocks))
-			memcpy(rdata + i*RAND_256, rand_num, data_len);
-		else
-			memcpy(rdata + i*RAND_256, rand_num, RAND_256);
+		len = min_t(unsigned int, dlen, RAND_256);
+		memcpy(rdata, rand_num, len);
+		rdata += len;
+		dlen -= len;
 	}
 
-	devm_kfree(se_dev->dev, rand_num);
-rel_mutex:
-	tegra_se_release_pka1_mutex(se_dev);
-clk_dis:
-	clk_disable_unprepare(se_dev->c);
-	mutex_unlock(&se_dev->hw_lock);
+	memzero_explicit(rand_num, sizeof(rand_num));
+	tegra_se_pka1_put(se_dev);
+
 	return ret;
 }
 
+static void tegra_se_trng_pool_refill(struct work_struct *work)
+{
+	struct tegra_se_trng_pool *pool = container_of(work,
+					struct tegra_se_trng_pool, refill);
+	struct tegra_se_elp_dev *se_dev = container_of(pool,
+					struct tegra_se_elp_dev, trng_pool);
+	unsigned int len;
+	u8 *block;
+	int ret;
+
+	mutex_lock(&pool->lock);
+	len = TRNG_POOL_SIZE - pool->avail;
+	mutex_unlock(&pool->lock);
+
+	if (!len)
+		return;
+
+	block = kmalloc(len, GFP_KERNEL);
+	if (!block)
+		return;
+
+	/* Readers keep draining the pool while the engine runs */
+	ret = tegra_se_elp_trng_read(se_dev, block, len);
+	if (ret) {
+		dev_err(se_dev->dev, "TRNG pool refill failed: %d\n", ret);
+		goto out;
+	}
+
+	mutex_lock(&pool->lock);
+	len = min_t(unsigned int, len, TRNG_POOL_SIZE - pool->avail);
+	memcpy(pool->buf + pool->avail, block, len);
+	pool->avail += len;
+	mutex_unlock(&pool->lock);
+out:
+	kzfree(block);
+}
+
+/*
+ * Serve @dlen bytes from the pool, which is topped up in the background
+ * once it drops below the low watermark. If it runs dry, the rest is read
+ * from the TRNG directly, unless !@wait. Returns the number of bytes
+ * delivered.
+ */
+static int tegra_se_trng_pool_get(struct tegra_se_elp_dev *se_dev,
+				  u8 *rdata, unsigned int dlen, bool wait)
+{
+	struct tegra_se_trng_pool *pool = &se_dev->trng_pool;
+	unsigned int len;
+	int ret;
+
+	mutex_lock(&pool->lock);
+	len = min(dlen, pool->avail);
+	pool->avail -= len;
+	memcpy(rdata, pool->buf + pool->avail, len);
+	memzero_explicit(pool->buf + pool->avail, len);
+	if (pool->avail < TRNG_POOL_LOW_WATERMARK)
+		queue_work(system_freezable_wq, &pool->refill);
+	mutex_unlock(&pool->lock);
+
+	if (len == dlen || !wait)
+		return len;
+
+	ret = tegra_se_elp_trng_read(se_dev, rdata + len, dlen - len);
+	if (ret)
+		return ret;
+
+	return dlen;
+}
+
+static int tegra_se_elp_trng_get_random(struct crypto_rng *tfm,
+		const u8 *src, unsigned int slen,
+		u8 *rdata, unsigned int dlen)
+{
+	struct tegra_se_elp_trng_context *trng_ctx =
+				crypto_tfm_ctx(crypto_rng_tfm(tfm));
+	int ret;
+
+	ret = tegra_se_trng_pool_get(trng_ctx->se_dev, rdata, dlen, true);
+
+	return ret < 0 ? ret : 0;
+}
+
+static int tegra_se_elp_hwrng_read(struct hwrng *rng, void *data,
+				   size_t max, bool wait)
+{
+	return tegra_se_trng_pool_get(elp_dev, data, max, wait);
+}
+
+static struct hwrng tegra_se_elp_hwrng = {
+	.name = "tegra-se-elp-trng",
+	.read = tegra_se_elp_hwrng_read,
+};
+
+static int tegra_se_trng_pool_init(struct tegra_se_elp_dev *se_dev)
+{
+	struct tegra_se_trng_pool *pool = &se_dev->trng_pool;
+
+	pool->buf = devm_kzalloc(se_dev->dev, TRNG_POOL_SIZE, GFP_KERNEL);
+	if (!pool->buf)
+		return -ENOMEM;
+
+	mutex_init(&pool->lock);
+	INIT_WORK(&pool->refill, tegra_se_trng_pool_refill);
+
+	return 0;
+}
+
+static void tegra_se_trng_pool_exit(struct tegra_se_elp_dev *se_dev)
+{
+	struct tegra_se_trng_pool *pool = &se_dev->trng_pool;
+
+	cancel_work_sync(&pool->refill);
+	memzero_explicit(pool->buf, TRNG_POOL_SIZE);
+	pool->avail = 0;
+}
+
 static int tegra_se_elp_trng_reset(struct crypto_rng *tfm, const u8 *seed,
 		unsigned int slen)
 {
@@ -4177,7 +4491,7 @@ static int tegra_se_ecdsa_sign(struct akcipher_request *req)
 	return ret;
 }
 
-static int tegra_se_ecdsa_verify(struct akcipher_request *req)
+static int tegra_se_ecdsa_do_verify(struct akcipher_request *req)
 {
 	struct crypto_akcipher *tfm = crypto_akcipher_reqtfm(req);
 	struct tegra_se_ecdsa_ctx *ctx = tegra_se_ecdsa_get_ctx(tfm);
@@ -4291,6 +4605,20 @@ static int tegra_se_ecdsa_verify(struct akcipher_request *req)
 	return ret;
 }
 
+static int tegra_se_ecdsa_verify(struct akcipher_request *req)
+{
+	int ret;
+
+	ret = tegra_se_pka1_get(elp_dev);
+	if (ret)
+		return ret;
+
+	ret = tegra_se_ecdsa_do_verify(req);
+	tegra_se_pka1_put(elp_dev);
+
+	return ret;
+}
+
 static int tegra_se_ecdsa_dummy_enc(struct akcipher_request *req)
 {
 	return -EINVAL;
@@ -4496,6 +4824,11 @@ static int tegra_se_elp_probe(struct platform_device *pdev)
 	}
 
 	elp_dev = se_dev;
+	mutex_init(&se_dev->hw_lock);
+
+	err = tegra_se_trng_pool_init(se_dev);
+	if (err)
+		goto clk_dis;
 
 	err = tegra_se_pka1_init_key_slot(se_dev);
 	if (err) {
@@ -4539,6 +4872,12 @@ static int tegra_se_elp_probe(struct platform_device *pdev)
 		goto trng_fail;
 	}
 
+	err = hwrng_register(&tegra_se_elp_hwrng);
+	if (err) {
+		dev_err(se_dev->dev, "hwrng_register failed\n");
+		goto hwrng_fail;
+	}
+
 	if (se_dev->chipdata->rng1_supported) {
 		err = crypto_register_rng(&rng_alg);
 		if (err) {
@@ -4546,7 +4885,6 @@ static int tegra_se_elp_probe(struct platform_device *pdev)
 			goto rng_fail;
 		}
 	}
-	mutex_init(&se_dev->hw_lock);
 
 	err = crypto_register_akcipher(&ecdsa_alg);
 	if (err) {
@@ -4564,6 +4902,8 @@ static int tegra_se_elp_probe(struct platform_device *pdev)
 
 	clk_disable_unprepare(se_dev->c);
 
+	queue_work(system_freezable_wq, &se_dev->trng_pool.refill);
+
 	dev_info(se_dev->dev, "%s: complete", __func__);
 	return 0;
 
@@ -4572,6 +4912,9 @@ eddsa_fail:
 ecdsa_fail:
 	crypto_unregister_rng(&rng_alg);
 rng_fail:
+	hwrng_unregister(&tegra_se_elp_hwrng);
+	tegra_se_trng_pool_exit(se_dev);
+hwrng_fail:
 	crypto_unregister_rng(&trng_alg);
 trng_fail:
 	crypto_unregister_akcipher(&pka1_rsa_algs[0]);
@@ -4588,7 +4931,9 @@ static int tegra_se_elp_remove(struct platform_device *pdev)
 	struct device *dev = &pdev->dev;
 	struct tegra_se_elp_dev *se_dev = dev_get_drvdata(dev);
 
+	hwrng_unregister(&tegra_se_elp_hwrng);
 	crypto_unregister_rng(&trng_alg);
+	tegra_se_trng_pool_exit(se_dev);
 	if (se_dev->chipdata->rng1_supported)
 		crypto_unregister_rng(&rng_alg);
 	crypto_unregister_akcipher(&ecdsa_alg);
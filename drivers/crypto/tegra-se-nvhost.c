@@ -32,6 +32,8 @@
 #include <linux/interrupt.h>
 #include <linux/types.h>
 #include <linux/errno.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <soc/tegra/chip-id.h>
 #include <linux/nvhost.h>
 #include <crypto/scatterwalk.h>
@@ -95,7 +97,7 @@ enum tegra_se_key_table_type {
 
 struct tegra_se_chipdata {
 	unsigned long aes_freq;
-	unsigned int cpu_freq_mhz;
+	int qos_latency_us;
 };
 
 /* Security Engine Linked List */
@@ -138,17 +140,15 @@ struct tegra_se_dev {
 	unsigned int cmdbuf_list_entry;
 	struct tegra_se_chipdata *chipdata; /* chip specific data */
 	u32 *src_ll_buf;	/* pointer to source linked list buffer */
-	dma_addr_t src_ll_buf_adr; /* Source linked list buffer dma address */
-	u32 src_ll_size;	/* Size of source linked list buffer */
 	u32 *dst_ll_buf;	/* pointer to destination linked list buffer */
-	dma_addr_t dst_ll_buf_adr; /* Destination linked list dma address */
-	u32 dst_ll_size;	/* Size of destination linked list buffer */
 	struct tegra_se_ll *src_ll;
 	struct tegra_se_ll *dst_ll;
 	struct tegra_se_ll *aes_src_ll;
 	struct tegra_se_ll *aes_dst_ll;
 	u32 *dh_buf1, *dh_buf2;
 	struct ablkcipher_request *reqs[SE_MAX_TASKS_PER_SUBMIT];
+	/* dequeued request that did not fit in the last batch */
+	struct ablkcipher_request *next_req;
 	struct ahash_request *sha_req;
 	unsigned int req_cnt;
 	u32 syncpt_id;
@@ -174,12 +174,13 @@ struct tegra_se_dev {
 	unsigned int aesbuf_entry;
 	u32 *aes_cmdbuf_cpuvaddr;
 	dma_addr_t aes_cmdbuf_iova;
-	struct pm_qos_request boost_cpufreq_req;
-	/* Lock to protect cpufreq boost status */
-	struct mutex boost_cpufreq_lock;
-	struct delayed_work restore_cpufreq_work;
-	unsigned long cpufreq_last_boosted;
-	bool cpufreq_boosted;
+	struct pm_qos_request qos_req;
+	/* Lock to protect the latency hint state */
+	struct mutex qos_lock;
+	struct work_struct qos_release_work;
+	atomic_t qos_pending;	/* AES requests queued or on the engine */
+	ktime_t qos_start;
+	bool qos_active;
 	bool ioc;
 	bool sha_last;
 	bool sha_src_mapped;
@@ -223,6 +224,8 @@ struct tegra_se_aes_context {
 	struct tegra_se_slot *slot;	/* Security Engine key slot */
 	u32 keylen;	/* key length in bits */
 	u32 op_mode;	/* AES operation mode */
+	u8 key[TEGRA_SE_KEY_512_SIZE];	/* copy to reload an evicted key */
+	bool key_cached;	/* key holds the key set by the user */
 };
 
 /* Security Engine random number generator context */
@@ -280,6 +283,8 @@ struct tegra_se_slot {
 	struct list_head node;
 	u8 slot_num;	/* Key slot number */
 	bool available; /* Tells whether key slot is free to use */
+	struct tegra_se_aes_context *owner; /* AES tfm caching its key here */
+	bool pinned;	/* used by the AES batch being built */
 };
 
 static struct tegra_se_slot ssk_slot = {
@@ -308,72 +313,120 @@ static LIST_HEAD(rsa_key_slot);
 static DEFINE_SPINLOCK(rsa_key_slot_lock);
 static DEFINE_SPINLOCK(key_slot_lock);
 
+static u64 key_slot_hits;
+static u64 key_slot_misses;
+static u64 key_slot_evictions;
+
+static DEFINE_SPINLOCK(qos_stats_lock);
+static u64 qos_activations;
+static u64 qos_active_ns;
+static u64 qos_aes_reqs;
+static u64 qos_aes_bytes;
+static struct dentry *tegra_se_debugdir;
+
 #define RNG_RESEED_INTERVAL	0x00773594
 
 /* create a work for handling the async transfers */
 static void tegra_se_work_handler(struct work_struct *work);
+static int tegra_se_aes_load_key(struct tegra_se_dev *se_dev,
+				 struct tegra_se_aes_context *ctx, bool xts);
 
 static DEFINE_DMA_ATTRS(attrs);
 static int force_reseed_count;
 
 #define GET_MSB(x)  ((x) >> (8 * sizeof(x) - 1))
-#define BOOST_PERIOD	(msecs_to_jiffies(2 * 1000)) /* 2 seconds */
 
-static unsigned int boost_cpu_freq;
-module_param(boost_cpu_freq, uint, S_IRUGO | S_IWUSR);
-MODULE_PARM_DESC(boost_cpu_freq, "CPU frequency (in MHz) to boost");
+static int latency_us = -1;
+module_param(latency_us, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(latency_us,
+	"CPU wakeup latency (in us) held while AES work is queued, negative disables (default: per chip)");
 
-static void tegra_se_restore_cpu_freq_fn(struct work_struct *work)
+/*
+ * Completion of a queued AES job is signalled by interrupt. While any are
+ * outstanding, keep the CPUs out of idle states too deep to answer it in
+ * time, instead of pinning a frequency the cpufreq governor has to fight.
+ */
+static void tegra_se_qos_get(struct tegra_se_dev *se_dev)
 {
-	struct tegra_se_dev *se_dev = container_of(
-			work, struct tegra_se_dev, restore_cpufreq_work.work);
-	unsigned long delay = BOOST_PERIOD;
+	int latency = READ_ONCE(latency_us);
 
-	mutex_lock(&se_dev->boost_cpufreq_lock);
-	if (time_is_after_jiffies(se_dev->cpufreq_last_boosted + delay)) {
-		schedule_delayed_work(&se_dev->restore_cpufreq_work, delay);
-	} else {
-		pm_qos_update_request(&se_dev->boost_cpufreq_req,
-				      PM_QOS_DEFAULT_VALUE);
-		se_dev->cpufreq_boosted = false;
+	if (atomic_inc_return(&se_dev->qos_pending) != 1)
+		return;
+
+	mutex_lock(&se_dev->qos_lock);
+	if (!se_dev->qos_active && latency >= 0) {
+		pm_qos_update_request(&se_dev->qos_req, latency);
+		se_dev->qos_start = ktime_get();
+		se_dev->qos_active = true;
+
+		spin_lock_irq(&qos_stats_lock);
+		qos_activations++;
+		spin_unlock_irq(&qos_stats_lock);
 	}
-	mutex_unlock(&se_dev->boost_cpufreq_lock);
+	mutex_unlock(&se_dev->qos_lock);
 }
 
-static void tegra_se_boost_cpu_freq(struct tegra_se_dev *se_dev)
+/* Called from the completion interrupt, the request is dropped from a work */
+static void tegra_se_qos_put(struct tegra_se_dev *se_dev)
 {
-	unsigned long delay = BOOST_PERIOD;
-	s32 cpufreq_hz = boost_cpu_freq * 1000;
+	if (atomic_dec_and_test(&se_dev->qos_pending))
+		schedule_work(&se_dev->qos_release_work);
+}
 
-	mutex_lock(&se_dev->boost_cpufreq_lock);
-	if (!se_dev->cpufreq_boosted) {
-		pm_qos_update_request(&se_dev->boost_cpufreq_req, cpufreq_hz);
-		schedule_delayed_work(&se_dev->restore_cpufreq_work, delay);
-		se_dev->cpufreq_boosted = true;
+static void tegra_se_qos_release_fn(struct work_struct *work)
+{
+	struct tegra_se_dev *se_dev = container_of(work, struct tegra_se_dev,
+						   qos_release_work);
+	s64 active_ns;
+
+	mutex_lock(&se_dev->qos_lock);
+	if (se_dev->qos_active && !atomic_read(&se_dev->qos_pending)) {
+		pm_qos_update_request(&se_dev->qos_req, PM_QOS_DEFAULT_VALUE);
+		se_dev->qos_active = false;
+		active_ns = ktime_to_ns(ktime_sub(ktime_get(),
+						  se_dev->qos_start));
+
+		spin_lock_irq(&qos_stats_lock);
+		qos_active_ns += active_ns;
+		spin_unlock_irq(&qos_stats_lock);
 	}
+	mutex_unlock(&se_dev->qos_lock);
+}
 
-	se_dev->cpufreq_last_boosted = jiffies;
-	mutex_unlock(&se_dev->boost_cpufreq_lock);
+static void tegra_se_aes_complete_req(struct tegra_se_dev *se_dev,
+				      struct ablkcipher_request *req, int err)
+{
+	unsigned long flags;
+
+	if (!err) {
+		spin_lock_irqsave(&qos_stats_lock, flags);
+		qos_aes_reqs++;
+		qos_aes_bytes += req->nbytes;
+		spin_unlock_irqrestore(&qos_stats_lock, flags);
+	}
+
+	req->base.complete(&req->base, err);
+	tegra_se_qos_put(se_dev);
 }
 
-static void tegra_se_boost_cpu_init(struct tegra_se_dev *se_dev)
+static void tegra_se_qos_init(struct tegra_se_dev *se_dev)
 {
-	boost_cpu_freq = se_dev->chipdata->cpu_freq_mhz;
+	if (latency_us < 0)
+		latency_us = se_dev->chipdata->qos_latency_us;
 
-	INIT_DELAYED_WORK(&se_dev->restore_cpufreq_work,
-			  tegra_se_restore_cpu_freq_fn);
+	mutex_init(&se_dev->qos_lock);
+	INIT_WORK(&se_dev->qos_release_work, tegra_se_qos_release_fn);
+	atomic_set(&se_dev->qos_pending, 0);
 
-	pm_qos_add_request(&se_dev->boost_cpufreq_req, PM_QOS_CPU_FREQ_MIN,
+	pm_qos_add_request(&se_dev->qos_req, PM_QOS_CPU_DMA_LATENCY,
 			   PM_QOS_DEFAULT_VALUE);
-
-	mutex_init(&se_dev->boost_cpufreq_lock);
 }
 
-static void tegra_se_boost_cpu_deinit(struct tegra_se_dev *se_dev)
+static void tegra_se_qos_deinit(struct tegra_se_dev *se_dev)
 {
-	mutex_destroy(&se_dev->boost_cpufreq_lock);
-	pm_qos_remove_request(&se_dev->boost_cpufreq_req);
-	cancel_delayed_work_sync(&se_dev->restore_cpufreq_work);
+	cancel_work_sync(&se_dev->qos_release_work);
+	pm_qos_remove_request(&se_dev->qos_req);
+	mutex_destroy(&se_dev->qos_lock);
 }
 
 static void tegra_se_leftshift_onebit(u8 *in_buf, u32 size, u8 *org_msb)
@@ -457,6 +510,69 @@ static struct tegra_se_slot *tegra_se_alloc_key_slot(void)
 	return found ? slot : NULL;
 }
 
+/*
+ * AES keys are cached in their slot for as long as the tfm lives. When
+ * every slot is taken, the least recently used cached key that is not
+ * part of the batch being built is evicted; its tfm reloads the key from
+ * its context the next time it is used. Slots are kept in LRU order in
+ * the key_slot list. Called with the AES engine mutex held.
+ */
+static struct tegra_se_slot *tegra_se_get_aes_key_slot(
+		struct tegra_se_aes_context *ctx)
+{
+	struct tegra_se_slot *slot, *free = NULL, *lru = NULL;
+
+	spin_lock(&key_slot_lock);
+	list_for_each_entry(slot, &key_slot, node) {
+		if (slot->slot_num == pre_allocated_slot.slot_num)
+			continue;
+		if (slot->available) {
+			free = slot;
+			break;
+		}
+		if (!lru && slot->owner && !slot->pinned)
+			lru = slot;
+	}
+
+	if (!free && lru) {
+		lru->owner->slot = NULL;
+		key_slot_evictions++;
+		free = lru;
+	}
+
+	if (free) {
+		free->available = false;
+		free->owner = ctx;
+		list_move_tail(&free->node, &key_slot);
+		ctx->slot = free;
+	}
+	key_slot_misses++;
+	spin_unlock(&key_slot_lock);
+
+	return free;
+}
+
+static void tegra_se_touch_aes_key_slot(struct tegra_se_aes_context *ctx)
+{
+	spin_lock(&key_slot_lock);
+	if (ctx->slot->owner == ctx) {
+		list_move_tail(&ctx->slot->node, &key_slot);
+		key_slot_hits++;
+	}
+	spin_unlock(&key_slot_lock);
+}
+
+static void tegra_se_put_aes_key_slot(struct tegra_se_aes_context *ctx)
+{
+	spin_lock(&key_slot_lock);
+	if (ctx->slot && ctx->slot->owner == ctx) {
+		ctx->slot->owner = NULL;
+		ctx->slot->available = true;
+	}
+	ctx->slot = NULL;
+	spin_unlock(&key_slot_lock);
+}
+
 static int tegra_init_key_slot(struct tegra_se_dev *se_dev)
 {
 	int i;
@@ -487,6 +603,12 @@ static int tegra_init_key_slot(struct tegra_se_dev *se_dev)
 	return 0;
 }
 
+/*
+ * The linked lists are only read back by the CPU while building the
+ * command buffer, which carries every address and length itself; the
+ * engine never fetches them. They are allocated once per engine from
+ * ordinary cached memory rather than uncached coherent memory.
+ */
 static int tegra_se_alloc_ll_buf(struct tegra_se_dev *se_dev, u32 num_src_sgs,
 				 u32 num_dst_sgs)
 {
@@ -497,24 +619,22 @@ static int tegra_se_alloc_ll_buf(struct tegra_se_dev *se_dev, u32 num_src_sgs,
 	}
 
 	if (num_src_sgs) {
-		se_dev->src_ll_size = sizeof(struct tegra_se_ll) * num_src_sgs;
-		se_dev->src_ll_buf = dma_alloc_coherent(
-					se_dev->dev, se_dev->src_ll_size,
-					&se_dev->src_ll_buf_adr, GFP_KERNEL);
+		se_dev->src_ll_buf = kcalloc(num_src_sgs,
+					     sizeof(struct tegra_se_ll),
+					     GFP_KERNEL);
 		if (!se_dev->src_ll_buf) {
 			dev_err(se_dev->dev,
-				"can not allocate src lldma buffer\n");
+				"can not allocate src ll buffer\n");
 			return -ENOMEM;
 		}
 	}
 	if (num_dst_sgs) {
-		se_dev->dst_ll_size = sizeof(struct tegra_se_ll) * num_dst_sgs;
-		se_dev->dst_ll_buf = dma_alloc_coherent(
-					se_dev->dev, se_dev->dst_ll_size,
-					&se_dev->dst_ll_buf_adr, GFP_KERNEL);
+		se_dev->dst_ll_buf = kcalloc(num_dst_sgs,
+					     sizeof(struct tegra_se_ll),
+					     GFP_KERNEL);
 		if (!se_dev->dst_ll_buf) {
 			dev_err(se_dev->dev,
-				"can not allocate dst ll dma buffer\n");
+				"can not allocate dst ll buffer\n");
 			return -ENOMEM;
 		}
 	}
@@ -524,17 +644,11 @@ static int tegra_se_alloc_ll_buf(struct tegra_se_dev *se_dev, u32 num_src_sgs,
 
 static void tegra_se_free_ll_buf(struct tegra_se_dev *se_dev)
 {
-	if (se_dev->src_ll_buf) {
-		dma_free_coherent(se_dev->dev, se_dev->src_ll_size,
-				  se_dev->src_ll_buf, se_dev->src_ll_buf_adr);
-		se_dev->src_ll_buf = NULL;
-	}
+	kfree(se_dev->src_ll_buf);
+	se_dev->src_ll_buf = NULL;
 
-	if (se_dev->dst_ll_buf) {
-		dma_free_coherent(se_dev->dev, se_dev->dst_ll_size,
-				  se_dev->dst_ll_buf, se_dev->dst_ll_buf_adr);
-		se_dev->dst_ll_buf = NULL;
-	}
+	kfree(se_dev->dst_ll_buf);
+	se_dev->dst_ll_buf = NULL;
 }
 
 static u32 tegra_se_get_config(struct tegra_se_dev *se_dev,
@@ -786,7 +900,7 @@ static void tegra_se_aes_complete_callback(void *priv, int nr_completed)
 					    req->nbytes);
 
 		buf += req->nbytes;
-		req->base.complete(&req->base, 0);
+		tegra_se_aes_complete_req(se_dev, req, 0);
 	}
 
 	if (!se_dev->ioc)
@@ -1610,15 +1724,9 @@ static void tegra_se_process_new_req(struct tegra_se_dev *se_dev)
 	unsigned int index = 0;
 	int err = 0, i = 0;
 
-	tegra_se_boost_cpu_freq(se_dev);
-
-	for (i = 0; i < se_dev->req_cnt; i++) {
-		req = se_dev->reqs[i];
-		if (req->nbytes != SE_STATIC_MEM_ALLOC_BUFSZ) {
-			se_dev->dynamic_mem = true;
-			break;
-		}
-	}
+	/* Only a single request larger than a gather buffer gets here */
+	if (se_dev->gather_buf_sz > SE_MAX_GATHER_BUF_SZ)
+		se_dev->dynamic_mem = true;
 
 	err = tegra_se_setup_ablk_req(se_dev);
 	if (err)
@@ -1655,7 +1763,7 @@ index_out:
 mem_out:
 	for (i = 0; i < se_dev->req_cnt; i++) {
 		req = se_dev->reqs[i];
-		req->base.complete(&req->base, err);
+		tegra_se_aes_complete_req(se_dev, req, err);
 	}
 	se_dev->req_cnt = 0;
 	se_dev->gather_buf_sz = 0;
@@ -1663,6 +1771,54 @@ mem_out:
 	se_dev->dynamic_mem = false;
 }
 
+/*
+ * Make sure the key of @req is in a slot before the request joins the
+ * batch being built, reloading it if it was evicted. The reload is a job
+ * of its own, so it runs ahead of the batch. The slot is pinned until the
+ * batch is submitted, so that later requests in it cannot evict it.
+ */
+static int tegra_se_aes_pin_key(struct tegra_se_dev *se_dev,
+				struct ablkcipher_request *req,
+				struct tegra_se_slot **pinned)
+{
+	struct crypto_ablkcipher *tfm = crypto_ablkcipher_reqtfm(req);
+	struct tegra_se_aes_context *ctx = crypto_ablkcipher_ctx(tfm);
+	unsigned int req_cnt = se_dev->req_cnt;
+	unsigned int gather_buf_sz = se_dev->gather_buf_sz;
+	int err;
+
+	*pinned = NULL;
+
+	if (ctx->slot) {
+		tegra_se_touch_aes_key_slot(ctx);
+		goto pin;
+	}
+
+	/* no key set, the request fails when the batch is built */
+	if (!ctx->key_cached)
+		return 0;
+
+	if (!tegra_se_get_aes_key_slot(ctx))
+		return -EBUSY;
+
+	/* the upload would otherwise take the batch built so far with it */
+	se_dev->req_cnt = 0;
+	err = tegra_se_aes_load_key(se_dev, ctx,
+			!strcmp(crypto_tfm_alg_name(&tfm->base), "xts(aes)"));
+	se_dev->req_cnt = req_cnt;
+	se_dev->gather_buf_sz = gather_buf_sz;
+	if (err) {
+		tegra_se_put_aes_key_slot(ctx);
+		return err;
+	}
+
+pin:
+	ctx->slot->pinned = true;
+	*pinned = ctx->slot;
+
+	return 0;
+}
+
 static void tegra_se_work_handler(struct work_struct *work)
 {
 	struct tegra_se_dev *se_dev = container_of(work, struct tegra_se_dev,
@@ -1670,38 +1826,79 @@ static void tegra_se_work_handler(struct work_struct *work)
 	struct crypto_async_request *async_req = NULL;
 	struct crypto_async_request *backlog = NULL;
 	struct ablkcipher_request *req;
-	bool process_requests;
+	struct tegra_se_slot *pinned[SE_MAX_TASKS_PER_SUBMIT];
+	bool process_requests, more;
+	int i, err;
 
 	mutex_lock(&se_dev->mtx);
 	do {
 		process_requests = false;
-		mutex_lock(&se_dev->lock);
 		do {
-			backlog = crypto_get_backlog(&se_dev->queue);
-			async_req = crypto_dequeue_request(&se_dev->queue);
-			if (!async_req)
-				se_dev->work_q_busy = false;
-
-			if (backlog) {
-				backlog->complete(backlog, -EINPROGRESS);
-				backlog = NULL;
-			}
+			mutex_lock(&se_dev->lock);
+			if (se_dev->next_req) {
+				req = se_dev->next_req;
+				se_dev->next_req = NULL;
+			} else {
+				backlog = crypto_get_backlog(&se_dev->queue);
+				async_req = crypto_dequeue_request(
+							&se_dev->queue);
+				if (!async_req)
+					se_dev->work_q_busy = false;
+
+				if (backlog) {
+					backlog->complete(backlog,
+							  -EINPROGRESS);
+					backlog = NULL;
+				}
+
+				if (!async_req) {
+					mutex_unlock(&se_dev->lock);
+					break;
+				}
 
-			if (async_req) {
 				req = ablkcipher_request_cast(async_req);
-				se_dev->reqs[se_dev->req_cnt] = req;
-				se_dev->gather_buf_sz += req->nbytes;
-				se_dev->req_cnt++;
-				process_requests = true;
-			} else {
+			}
+			more = se_dev->queue.qlen;
+			mutex_unlock(&se_dev->lock);
+
+			/*
+			 * Requests of any size and key slot share a job as
+			 * long as their data fits in one preallocated gather
+			 * buffer; the one that does not starts the next job.
+			 */
+			if (se_dev->req_cnt && se_dev->gather_buf_sz +
+			    req->nbytes > SE_MAX_GATHER_BUF_SZ) {
+				se_dev->next_req = req;
 				break;
 			}
-		} while (se_dev->queue.qlen &&
-			 (se_dev->req_cnt < SE_MAX_TASKS_PER_SUBMIT));
-		mutex_unlock(&se_dev->lock);
 
-		if (process_requests)
+			/* all key slots are pinned by this batch */
+			err = tegra_se_aes_pin_key(se_dev, req,
+						   &pinned[se_dev->req_cnt]);
+			if (err == -EBUSY && se_dev->req_cnt) {
+				se_dev->next_req = req;
+				break;
+			}
+			if (err) {
+				tegra_se_aes_complete_req(se_dev, req, err);
+				continue;
+			}
+
+			se_dev->reqs[se_dev->req_cnt] = req;
+			se_dev->gather_buf_sz += req->nbytes;
+			se_dev->req_cnt++;
+			process_requests = true;
+		} while (more && (se_dev->req_cnt < SE_MAX_TASKS_PER_SUBMIT));
+
+		if (process_requests) {
+			int nr_pinned = se_dev->req_cnt;
+
 			tegra_se_process_new_req(se_dev);
+
+			for (i = 0; i < nr_pinned; i++)
+				if (pinned[i])
+					pinned[i]->pinned = false;
+		}
 	} while (se_dev->work_q_busy);
 	mutex_unlock(&se_dev->mtx);
 }
@@ -1713,6 +1910,9 @@ static int tegra_se_aes_queue_req(struct tegra_se_dev *se_dev,
 
 	mutex_lock(&se_dev->lock);
 	err = ablkcipher_enqueue_request(&se_dev->queue, req);
+	if (err == -EINPROGRESS ||
+	    (req->base.flags & CRYPTO_TFM_REQ_MAY_BACKLOG))
+		tegra_se_qos_get(se_dev);
 
 	if (!se_dev->work_q_busy) {
 		se_dev->work_q_busy = true;
@@ -1860,17 +2060,57 @@ static void tegra_se_init_aesbuf(struct tegra_se_dev *se_dev)
 	}
 }
 
+/* Upload the key cached in @ctx to its slot, as a job of its own */
+static int tegra_se_aes_load_key(struct tegra_se_dev *se_dev,
+				 struct tegra_se_aes_context *ctx, bool xts)
+{
+	u8 *pdata = ctx->key;
+	u32 keylen = ctx->keylen;
+	unsigned int index = 0;
+	u32 *cpuvaddr = NULL;
+	dma_addr_t iova = 0;
+	int ret;
+
+	ret = tegra_se_get_free_cmdbuf(se_dev);
+	if (ret < 0) {
+		dev_err(se_dev->dev, "Couldn't get free cmdbuf\n");
+		return ret;
+	}
+
+	index = ret;
+
+	cpuvaddr = se_dev->cmdbuf_addr_list[index].cmdbuf_addr;
+	iova = se_dev->cmdbuf_addr_list[index].iova;
+	atomic_set(&se_dev->cmdbuf_addr_list[index].free, 0);
+	se_dev->cmdbuf_list_entry = index;
+
+	if (!xts)
+		return tegra_se_send_key_data(
+			se_dev, pdata, keylen, ctx->slot->slot_num,
+			SE_KEY_TABLE_TYPE_KEY, se_dev->opcode_addr, cpuvaddr,
+			iova, AES_CB);
+
+	keylen = keylen / 2;
+	ret = tegra_se_send_key_data(
+		se_dev, pdata, keylen, ctx->slot->slot_num,
+		SE_KEY_TABLE_TYPE_XTS_KEY1, se_dev->opcode_addr,
+		cpuvaddr, iova, AES_CB);
+	if (ret)
+		return ret;
+
+	return tegra_se_send_key_data(se_dev, pdata + keylen, keylen,
+				      ctx->slot->slot_num,
+				      SE_KEY_TABLE_TYPE_XTS_KEY2,
+				      se_dev->opcode_addr, cpuvaddr,
+				      iova, AES_CB);
+}
+
 static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 			       const u8 *key, u32 keylen)
 {
 	struct tegra_se_aes_context *ctx = crypto_ablkcipher_ctx(tfm);
 	struct tegra_se_dev *se_dev;
-	struct tegra_se_slot *pslot;
-	u8 *pdata = (u8 *)key;
 	int ret = 0;
-	unsigned int index = 0;
-	u32 *cpuvaddr = NULL;
-	dma_addr_t iova = 0;
 
 	se_dev = se_devices[SE_AES];
 
@@ -1890,19 +2130,28 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 
 	mutex_lock(&se_dev->mtx);
 	if (key) {
-		if (!ctx->slot ||
-		    (ctx->slot &&
-		     ctx->slot->slot_num == ssk_slot.slot_num)) {
-			pslot = tegra_se_alloc_key_slot();
-			if (!pslot) {
+		if (ctx->key_cached && ctx->slot && ctx->keylen == keylen &&
+		    !memcmp(ctx->key, key, keylen & SE_KEY_LEN_MASK)) {
+			/* the slot still holds this key */
+			tegra_se_touch_aes_key_slot(ctx);
+			goto out;
+		}
+
+		if (!ctx->slot || ctx->slot->owner != ctx) {
+			tegra_se_put_aes_key_slot(ctx);
+			if (!tegra_se_get_aes_key_slot(ctx)) {
 				dev_err(se_dev->dev, "no free key slot\n");
+				ctx->key_cached = false;
 				mutex_unlock(&se_dev->mtx);
 				return -ENOMEM;
 			}
-			ctx->slot = pslot;
 		}
 		ctx->keylen = keylen;
+		memcpy(ctx->key, key, keylen & SE_KEY_LEN_MASK);
+		ctx->key_cached = true;
 	} else if ((keylen >> SE_MAGIC_PATTERN_OFFSET) == SE_MAGIC_PATTERN) {
+		tegra_se_put_aes_key_slot(ctx);
+		ctx->key_cached = false;
 		ctx->slot = &pre_allocated_slot;
 		spin_lock(&key_slot_lock);
 		pre_allocated_slot.slot_num =
@@ -1911,50 +2160,19 @@ static int tegra_se_aes_setkey(struct crypto_ablkcipher *tfm,
 		ctx->keylen = (keylen & SE_KEY_LEN_MASK);
 		goto out;
 	} else {
-		tegra_se_free_key_slot(ctx->slot);
+		tegra_se_put_aes_key_slot(ctx);
+		ctx->key_cached = false;
 		ctx->slot = &ssk_slot;
 		ctx->keylen = AES_KEYSIZE_128;
 		goto out;
 	}
 
-	ret = tegra_se_get_free_cmdbuf(se_dev);
-	if (ret < 0) {
-		dev_err(se_dev->dev, "Couldn't get free cmdbuf\n");
-		goto keyslt_free;
-	}
-
-	index = ret;
-
-	cpuvaddr = se_dev->cmdbuf_addr_list[index].cmdbuf_addr;
-	iova = se_dev->cmdbuf_addr_list[index].iova;
-	atomic_set(&se_dev->cmdbuf_addr_list[index].free, 0);
-	se_dev->cmdbuf_list_entry = index;
-
-	/* load the key */
-
-	if (strcmp(crypto_tfm_alg_name(&tfm->base), "xts(aes)")) {
-		ret = tegra_se_send_key_data(
-			se_dev, pdata, keylen, ctx->slot->slot_num,
-			SE_KEY_TABLE_TYPE_KEY, se_dev->opcode_addr, cpuvaddr,
-			iova, AES_CB);
-	} else {
-		keylen = keylen / 2;
-		ret = tegra_se_send_key_data(
-			se_dev, pdata, keylen, ctx->slot->slot_num,
-			SE_KEY_TABLE_TYPE_XTS_KEY1, se_dev->opcode_addr,
-			cpuvaddr, iova, AES_CB);
-		if (ret)
-			goto keyslt_free;
-
-		ret = tegra_se_send_key_data(se_dev, pdata + keylen, keylen,
-					     ctx->slot->slot_num,
-					     SE_KEY_TABLE_TYPE_XTS_KEY2,
-					     se_dev->opcode_addr, cpuvaddr,
-					     iova, AES_CB);
+	ret = tegra_se_aes_load_key(se_dev, ctx,
+			!strcmp(crypto_tfm_alg_name(&tfm->base), "xts(aes)"));
+	if (ret) {
+		tegra_se_put_aes_key_slot(ctx);
+		ctx->key_cached = false;
 	}
-keyslt_free:
-	if (ret)
-		tegra_se_free_key_slot(ctx->slot);
 out:
 	mutex_unlock(&se_dev->mtx);
 
@@ -1972,8 +2190,9 @@ static void tegra_se_aes_cra_exit(struct crypto_tfm *tfm)
 {
 	struct tegra_se_aes_context *ctx = crypto_tfm_ctx(tfm);
 
-	tegra_se_free_key_slot(ctx->slot);
-	ctx->slot = NULL;
+	tegra_se_put_aes_key_slot(ctx);
+	memzero_explicit(ctx->key, sizeof(ctx->key));
+	ctx->key_cached = false;
 }
 
 static int tegra_se_rng_drbg_init(struct crypto_tfm *tfm)
@@ -2164,6 +2383,15 @@ static int tegra_se_sha_process_buf(struct ahash_request *req, bool is_last,
 
 		if (process_cur_req) {
 			bytes_process_in_req = req->nbytes;
+			num_sgs = tegra_se_count_sgs(src_sg,
+						     bytes_process_in_req);
+			if (num_sgs + !!sha_ctx->residual_bytes >
+			    SE_MAX_SRC_SG_COUNT) {
+				dev_err(se_dev->dev,
+					"num of SG buffers are more\n");
+				return -EDOM;
+			}
+
 			err = tegra_map_sg(se_dev->dev, src_sg, 1,
 					   DMA_TO_DEVICE, src_ll,
 					   bytes_process_in_req);
@@ -2217,6 +2445,14 @@ static int tegra_se_sha_process_buf(struct ahash_request *req, bool is_last,
 		/* Number of bytes to be processed from given request buffers */
 		bytes_process_in_req = (num_blks * sha_ctx->blk_size) -
 					sha_ctx->residual_bytes;
+
+		num_sgs = tegra_se_count_sgs(src_sg, bytes_process_in_req);
+		if (num_sgs + !!sha_ctx->residual_bytes >
+		    SE_MAX_SRC_SG_COUNT) {
+			dev_err(se_dev->dev, "num of SG buffers are more\n");
+			return -EDOM;
+		}
+
 		sha_ctx->total_count += bytes_process_in_req;
 
 		/* Fill sgs entries */
@@ -3999,7 +4235,7 @@ static int tegra_se_nvhost_prepare_poweroff(struct platform_device *pdev)
 
 static struct tegra_se_chipdata tegra18_se_chipdata = {
 	.aes_freq = 600000000,
-	.cpu_freq_mhz = 2400,
+	.qos_latency_us = 50,
 };
 
 static struct nvhost_device_data nvhost_se1_info = {
@@ -4242,6 +4478,20 @@ static int tegra_se_probe(struct platform_device *pdev)
 		}
 	}
 
+	/*
+	 * Whether the engine beats the CPU's own AES instructions depends on
+	 * the chip, its clocks and the request sizes; platforms that measured
+	 * it can move the engine above or below them (ARMv8 CE uses 300).
+	 */
+	err = of_property_read_u32(node, "xts-priority", &val);
+	if (!err)
+		aes_algs[0].cra_priority = val;
+
+	err = of_property_read_u32(node, "aes-priority", &val);
+	if (!err)
+		for (i = 1; i < ARRAY_SIZE(aes_algs); i++)
+			aes_algs[i].cra_priority = val;
+
 	if (is_algo_supported(node, "xts")) {
 		INIT_LIST_HEAD(&aes_algs[0].cra_list);
 		err = crypto_register_alg(&aes_algs[0]);
@@ -4385,7 +4635,7 @@ static int tegra_se_probe(struct platform_device *pdev)
 		}
 	}
 
-	tegra_se_boost_cpu_init(se_dev);
+	tegra_se_qos_init(se_dev);
 
 	dev_info(se_dev->dev, "%s: complete", __func__);
 
@@ -4419,7 +4669,7 @@ static int tegra_se_remove(struct platform_device *pdev)
 		return -ENODEV;
 	}
 
-	tegra_se_boost_cpu_deinit(se_dev);
+	tegra_se_qos_deinit(se_dev);
 
 	if (se_dev->aes_cmdbuf_cpuvaddr)
 		dma_free_attrs(
@@ -4479,14 +4729,102 @@ static struct platform_driver tegra_se_driver = {
 	},
 };
 
+static int tegra_se_key_slots_show(struct seq_file *s, void *unused)
+{
+	struct tegra_se_slot *slot;
+	unsigned int cached = 0;
+	u64 hits, misses;
+
+	spin_lock(&key_slot_lock);
+	list_for_each_entry(slot, &key_slot, node)
+		if (slot->owner)
+			cached++;
+	hits = key_slot_hits;
+	misses = key_slot_misses;
+	seq_printf(s, "cached:    %u\n", cached);
+	seq_printf(s, "hits:      %llu\n", hits);
+	seq_printf(s, "misses:    %llu\n", misses);
+	seq_printf(s, "evictions: %llu\n", key_slot_evictions);
+	spin_unlock(&key_slot_lock);
+
+	seq_printf(s, "hit rate:  %llu%%\n",
+		   hits + misses ? div64_u64(hits * 100, hits + misses) : 0);
+
+	return 0;
+}
+
+static int tegra_se_key_slots_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_key_slots_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_key_slots_fops = {
+	.open		= tegra_se_key_slots_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int tegra_se_latency_qos_show(struct seq_file *s, void *unused)
+{
+	u64 activations, active_ns, reqs, bytes, active_us;
+
+	spin_lock_irq(&qos_stats_lock);
+	activations = qos_activations;
+	active_ns = qos_active_ns;
+	reqs = qos_aes_reqs;
+	bytes = qos_aes_bytes;
+	spin_unlock_irq(&qos_stats_lock);
+
+	active_us = div64_u64(active_ns, NSEC_PER_USEC);
+
+	seq_printf(s, "latency:     %d us\n", READ_ONCE(latency_us));
+	seq_printf(s, "activations: %llu\n", activations);
+	seq_printf(s, "active:      %llu us\n", active_us);
+	seq_printf(s, "requests:    %llu\n", reqs);
+	seq_printf(s, "bytes:       %llu\n", bytes);
+	/* bytes per microsecond of hint is MB/s */
+	seq_printf(s, "throughput:  %llu MB/s\n",
+		   active_us ? div64_u64(bytes, active_us) : 0);
+
+	return 0;
+}
+
+static int tegra_se_latency_qos_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_se_latency_qos_show, inode->i_private);
+}
+
+static const struct file_operations tegra_se_latency_qos_fops = {
+	.open		= tegra_se_latency_qos_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init tegra_se_module_init(void)
 {
-	return  platform_driver_register(&tegra_se_driver);
+	int ret;
+
+	tegra_se_debugdir = debugfs_create_dir("tegra_se_nvhost", NULL);
+	if (!IS_ERR_OR_NULL(tegra_se_debugdir)) {
+		debugfs_create_file("key_slots", S_IRUGO, tegra_se_debugdir,
+				    NULL, &tegra_se_key_slots_fops);
+		debugfs_create_file("latency_qos", S_IRUGO, tegra_se_debugdir,
+				    NULL, &tegra_se_latency_qos_fops);
+	}
+
+	ret = platform_driver_register(&tegra_se_driver);
+	if (ret)
+		debugfs_remove_recursive(tegra_se_debugdir);
+
+	return ret;
 }
 
 static void __exit tegra_se_module_exit(void)
 {
 	platform_driver_unregister(&tegra_se_driver);
+	debugfs_remove_recursive(tegra_se_debugdir);
 }
 
 module_init(tegra_se_module_init);
@@ -271,8 +271,6 @@
 #define SE_HASH_RESULT_REG_OFFSET	0x13c
 #define SE_CMAC_RESULT_REG_OFFSET	0x4c4
 
-#define SE_STATIC_MEM_ALLOC_BUFSZ	512
-
 #define TEGRA_SE_KEY_256_SIZE		32
 #define TEGRA_SE_KEY_512_SIZE		64
 #define TEGRA_SE_KEY_192_SIZE		24
@@ -0,0 +1,797 @@
+/*
+ * DMA driver for the DesignWare eDMA embedded in Tegra PCIe controllers
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/bitops.h>
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/dmapool.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/of.h>
+#include <linux/of_dma.h>
+#include <linux/scatterlist.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/tegra-pcie-edma.h>
+
+#include "dmaengine.h"
+#include "virt-dma.h"
+
+#define EDMA_WR_CHNL_NUM		4
+#define EDMA_RD_CHNL_NUM		2
+
+/* Common registers */
+#define EDMA_WRITE_ENGINE_EN		0xC
+#define EDMA_WRITE_DOORBELL		0x10
+#define EDMA_READ_ENGINE_EN		0x2C
+#define EDMA_READ_DOORBELL		0x30
+#define EDMA_ENGINE_EN_ENABLE		BIT(0)
+#define EDMA_DOORBELL_STOP		BIT(31)
+
+#define EDMA_WRITE_INT_STATUS		0x4C
+#define EDMA_WRITE_INT_MASK		0x54
+#define EDMA_WRITE_INT_CLEAR		0x58
+#define EDMA_READ_INT_STATUS		0xA0
+#define EDMA_READ_INT_MASK		0xA8
+#define EDMA_READ_INT_CLEAR		0xAC
+#define EDMA_INT_DONE(ch)		BIT(ch)
+#define EDMA_INT_ABORT(ch)		BIT((ch) + 16)
+
+/* Remote (IMWr) interrupts, one address per direction, data per channel */
+#define EDMA_WRITE_DONE_IMWR_LOW	0x60
+#define EDMA_WRITE_DONE_IMWR_HIGH	0x64
+#define EDMA_WRITE_ABORT_IMWR_LOW	0x68
+#define EDMA_WRITE_ABORT_IMWR_HIGH	0x6C
+#define EDMA_WRITE_IMWR_DATA		0x70
+#define EDMA_READ_DONE_IMWR_LOW		0xCC
+#define EDMA_READ_DONE_IMWR_HIGH	0xD0
+#define EDMA_READ_ABORT_IMWR_LOW	0xD4
+#define EDMA_READ_ABORT_IMWR_HIGH	0xD8
+#define EDMA_READ_IMWR_DATA		0xDC
+#define EDMA_IMWR_DATA(ch)		(((ch) / 2) * 4)
+#define EDMA_IMWR_DATA_SHIFT(ch)	(((ch) % 2) * 16)
+
+/* Channel registers, the read channel block follows the write one */
+#define EDMA_CH_BASE(ch)		(0x200 * ((ch) + 1))
+#define EDMA_CH_RD_OFFSET		0x100
+#define EDMA_CH_CONTROL1		0x0
+#define EDMA_CH_CONTROL1_LLE		BIT(9)
+#define EDMA_CH_LLP_LOW			0x1C
+#define EDMA_CH_LLP_HIGH		0x20
+
+/* Linked list element control word */
+#define EDMA_LL_CB			BIT(0)
+#define EDMA_LL_TCB			BIT(1)
+#define EDMA_LL_LLP			BIT(2)
+#define EDMA_LL_LIE			BIT(3)
+#define EDMA_LL_RIE			BIT(4)
+
+/* Data elements per descriptor, plus the closing link element */
+#define EDMA_MAX_LL			64
+#define EDMA_MAX_XFER			SZ_1G
+
+struct tegra_pcie_edma_ll {
+	u32 control;
+	u32 size;
+	u32 sar_low;
+	u32 sar_high;
+	u32 dar_low;
+	u32 dar_high;
+};
+
+struct tegra_pcie_edma_desc {
+	struct virt_dma_desc		vd;
+	struct tegra_pcie_edma_ll	*ll;
+	dma_addr_t			ll_dma;
+	unsigned int			nr_ll;
+	size_t				len;
+};
+
+struct tegra_pcie_edma_chan {
+	struct virt_dma_chan		vc;
+	struct tegra_pcie_edma		*edma;
+	enum dma_transfer_direction	dir;
+	u8				id;
+	struct tegra_pcie_edma_desc	*active;
+	/* last cookie that ended in an abort, reported as DMA_ERROR */
+	dma_cookie_t			err_cookie;
+	struct dma_slave_config		config;
+	/* remote interrupt sent for DMA_PREP_INTERRUPT descriptors */
+	bool				remote_irq;
+	u64				remote_addr;
+	u16				remote_data;
+};
+
+struct tegra_pcie_edma {
+	struct dma_device		dma_dev;
+	struct device			*dev;
+	void __iomem			*regs;
+	struct dma_pool			*ll_pool;
+	struct list_head		node;
+	/* protects the common registers and online */
+	spinlock_t			lock;
+	bool				online;
+	struct tegra_pcie_edma_chan	wr[EDMA_WR_CHNL_NUM];
+	struct tegra_pcie_edma_chan	rd[EDMA_RD_CHNL_NUM];
+};
+
+static DEFINE_MUTEX(edma_list_lock);
+static LIST_HEAD(edma_list);
+
+static inline struct tegra_pcie_edma_chan *to_edma_chan(struct dma_chan *dc)
+{
+	return container_of(dc, struct tegra_pcie_edma_chan, vc.chan);
+}
+
+static inline struct tegra_pcie_edma_desc *to_edma_desc(
+		struct virt_dma_desc *vd)
+{
+	return container_of(vd, struct tegra_pcie_edma_desc, vd);
+}
+
+static inline void edma_writel(struct tegra_pcie_edma *edma, u32 val, u32 off)
+{
+	writel(val, edma->regs + off);
+}
+
+static inline u32 edma_readl(struct tegra_pcie_edma *edma, u32 off)
+{
+	return readl(edma->regs + off);
+}
+
+static inline void edma_chan_writel(struct tegra_pcie_edma_chan *chan,
+				    u32 val, u32 off)
+{
+	if (chan->dir == DMA_DEV_TO_MEM)
+		off += EDMA_CH_RD_OFFSET;
+	writel(val, chan->edma->regs + EDMA_CH_BASE(chan->id) + off);
+}
+
+static inline u32 edma_doorbell(struct tegra_pcie_edma_chan *chan)
+{
+	return chan->dir == DMA_MEM_TO_DEV ?
+		EDMA_WRITE_DOORBELL : EDMA_READ_DOORBELL;
+}
+
+static void tegra_pcie_edma_desc_free(struct virt_dma_desc *vd)
+{
+	struct tegra_pcie_edma_desc *desc = to_edma_desc(vd);
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(vd->tx.chan);
+
+	dma_pool_free(chan->edma->ll_pool, desc->ll, desc->ll_dma);
+	kfree(desc);
+}
+
+/* Must be called with the channel lock held */
+static void tegra_pcie_edma_start(struct tegra_pcie_edma_chan *chan)
+{
+	struct tegra_pcie_edma *edma = chan->edma;
+	struct virt_dma_desc *vd;
+
+	chan->active = NULL;
+	if (!edma->online)
+		return;
+
+	vd = vchan_next_desc(&chan->vc);
+	if (!vd)
+		return;
+
+	list_del(&vd->node);
+	chan->active = to_edma_desc(vd);
+
+	edma_chan_writel(chan, EDMA_CH_CONTROL1_LLE, EDMA_CH_CONTROL1);
+	edma_chan_writel(chan, lower_32_bits(chan->active->ll_dma),
+			 EDMA_CH_LLP_LOW);
+	edma_chan_writel(chan, upper_32_bits(chan->active->ll_dma),
+			 EDMA_CH_LLP_HIGH);
+
+	spin_lock(&edma->lock);
+	edma_writel(edma, chan->id, edma_doorbell(chan));
+	spin_unlock(&edma->lock);
+}
+
+/* Must be called with the channel lock held */
+static void tegra_pcie_edma_stop(struct tegra_pcie_edma_chan *chan)
+{
+	struct tegra_pcie_edma *edma = chan->edma;
+
+	spin_lock(&edma->lock);
+	if (edma->online)
+		edma_writel(edma, EDMA_DOORBELL_STOP | chan->id,
+			    edma_doorbell(chan));
+	spin_unlock(&edma->lock);
+}
+
+static void tegra_pcie_edma_chan_irq(struct tegra_pcie_edma *edma,
+				     struct tegra_pcie_edma_chan *chan,
+				     u32 status, u32 clear_off)
+{
+	struct tegra_pcie_edma_desc *desc;
+	u32 mask = EDMA_INT_DONE(chan->id) | EDMA_INT_ABORT(chan->id);
+
+	if (!(status & mask))
+		return;
+
+	edma_writel(edma, mask, clear_off);
+
+	spin_lock(&chan->vc.lock);
+	desc = chan->active;
+	if (desc) {
+		if (status & EDMA_INT_ABORT(chan->id)) {
+			dev_err(edma->dev, "%s channel %u aborted\n",
+				chan->dir == DMA_MEM_TO_DEV ? "write" : "read",
+				chan->id);
+			chan->err_cookie = desc->vd.tx.cookie;
+		}
+		vchan_cookie_complete(&desc->vd);
+	}
+	tegra_pcie_edma_start(chan);
+	spin_unlock(&chan->vc.lock);
+}
+
+void tegra_pcie_edma_irq(struct tegra_pcie_edma *edma)
+{
+	u32 status;
+	int i;
+
+	if (IS_ERR_OR_NULL(edma))
+		return;
+
+	status = edma_readl(edma, EDMA_WRITE_INT_STATUS);
+	for (i = 0; i < EDMA_WR_CHNL_NUM; i++)
+		tegra_pcie_edma_chan_irq(edma, &edma->wr[i], status,
+					 EDMA_WRITE_INT_CLEAR);
+
+	status = edma_readl(edma, EDMA_READ_INT_STATUS);
+	for (i = 0; i < EDMA_RD_CHNL_NUM; i++)
+		tegra_pcie_edma_chan_irq(edma, &edma->rd[i], status,
+					 EDMA_READ_INT_CLEAR);
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_irq);
+
+static struct tegra_pcie_edma_desc *tegra_pcie_edma_desc_alloc(
+		struct tegra_pcie_edma_chan *chan)
+{
+	struct tegra_pcie_edma_desc *desc;
+
+	desc = kzalloc(sizeof(*desc), GFP_NOWAIT);
+	if (!desc)
+		return NULL;
+
+	desc->ll = dma_pool_zalloc(chan->edma->ll_pool, GFP_NOWAIT,
+				   &desc->ll_dma);
+	if (!desc->ll) {
+		kfree(desc);
+		return NULL;
+	}
+
+	return desc;
+}
+
+static void tegra_pcie_edma_desc_discard(struct tegra_pcie_edma_chan *chan,
+					 struct tegra_pcie_edma_desc *desc)
+{
+	dma_pool_free(chan->edma->ll_pool, desc->ll, desc->ll_dma);
+	kfree(desc);
+}
+
+static bool tegra_pcie_edma_ll_add(struct tegra_pcie_edma_desc *desc,
+				   dma_addr_t sar, dma_addr_t dar, u32 size)
+{
+	struct tegra_pcie_edma_ll *ll;
+
+	if (desc->nr_ll == EDMA_MAX_LL)
+		return false;
+
+	ll = &desc->ll[desc->nr_ll++];
+	ll->size = size;
+	ll->sar_low = lower_32_bits(sar);
+	ll->sar_high = upper_32_bits(sar);
+	ll->dar_low = lower_32_bits(dar);
+	ll->dar_high = upper_32_bits(dar);
+	desc->len += size;
+
+	return true;
+}
+
+/*
+ * The channel starts with a consumer cycle state of 0 and runs every
+ * element whose cycle bit matches. The closing link element toggles the
+ * state and points back at the first element, which then no longer
+ * matches, so the channel stops after raising the done interrupt for
+ * the last data element.
+ */
+static struct dma_async_tx_descriptor *tegra_pcie_edma_desc_prep(
+		struct tegra_pcie_edma_chan *chan,
+		struct tegra_pcie_edma_desc *desc, unsigned long flags)
+{
+	struct tegra_pcie_edma_ll *link = &desc->ll[desc->nr_ll];
+
+	desc->ll[desc->nr_ll - 1].control |= EDMA_LL_LIE;
+	if (chan->remote_irq && (flags & DMA_PREP_INTERRUPT))
+		desc->ll[desc->nr_ll - 1].control |= EDMA_LL_RIE;
+	link->control = EDMA_LL_LLP | EDMA_LL_TCB;
+	link->sar_low = lower_32_bits(desc->ll_dma);
+	link->sar_high = upper_32_bits(desc->ll_dma);
+
+	/* The list must be visible to the engine before the doorbell */
+	wmb();
+
+	return vchan_tx_prep(&chan->vc, &desc->vd, flags);
+}
+
+static struct dma_async_tx_descriptor *tegra_pcie_edma_prep_slave_sg(
+		struct dma_chan *dc, struct scatterlist *sgl,
+		unsigned int sg_len, enum dma_transfer_direction direction,
+		unsigned long flags, void *context)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+	struct tegra_pcie_edma_desc *desc;
+	struct scatterlist *sg;
+	dma_addr_t remote, local;
+	unsigned int i;
+
+	if (direction != chan->dir) {
+		dev_err(chan->edma->dev, "direction not supported by channel\n");
+		return NULL;
+	}
+
+	if (!sg_len || sg_len > EDMA_MAX_LL) {
+		dev_err(chan->edma->dev, "invalid sg length %u\n", sg_len);
+		return NULL;
+	}
+
+	desc = tegra_pcie_edma_desc_alloc(chan);
+	if (!desc)
+		return NULL;
+
+	remote = direction == DMA_MEM_TO_DEV ?
+		chan->config.dst_addr : chan->config.src_addr;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		local = sg_dma_address(sg);
+		if (direction == DMA_MEM_TO_DEV)
+			tegra_pcie_edma_ll_add(desc, local, remote,
+					       sg_dma_len(sg));
+		else
+			tegra_pcie_edma_ll_add(desc, remote, local,
+					       sg_dma_len(sg));
+		remote += sg_dma_len(sg);
+	}
+
+	return tegra_pcie_edma_desc_prep(chan, desc, flags);
+}
+
+static struct dma_async_tx_descriptor *tegra_pcie_edma_prep_dma_memcpy(
+		struct dma_chan *dc, dma_addr_t dest, dma_addr_t src,
+		size_t len, unsigned long flags)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+	struct tegra_pcie_edma_desc *desc;
+	u32 size;
+
+	if (!len)
+		return NULL;
+
+	desc = tegra_pcie_edma_desc_alloc(chan);
+	if (!desc)
+		return NULL;
+
+	while (len) {
+		size = min_t(size_t, len, EDMA_MAX_XFER);
+		if (!tegra_pcie_edma_ll_add(desc, src, dest, size)) {
+			dev_err(chan->edma->dev, "memcpy too large\n");
+			tegra_pcie_edma_desc_discard(chan, desc);
+			return NULL;
+		}
+		src += size;
+		dest += size;
+		len -= size;
+	}
+
+	return tegra_pcie_edma_desc_prep(chan, desc, flags);
+}
+
+static int tegra_pcie_edma_slave_config(struct dma_chan *dc,
+					struct dma_slave_config *config)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+
+	chan->config = *config;
+
+	return 0;
+}
+
+static void tegra_pcie_edma_issue_pending(struct dma_chan *dc)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+	unsigned long flags;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (vchan_issue_pending(&chan->vc) && !chan->active)
+		tegra_pcie_edma_start(chan);
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+}
+
+static enum dma_status tegra_pcie_edma_tx_status(struct dma_chan *dc,
+		dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+	struct virt_dma_desc *vd;
+	enum dma_status status;
+	unsigned long flags;
+	size_t residue = 0;
+
+	status = dma_cookie_status(dc, cookie, txstate);
+	if (status == DMA_COMPLETE)
+		return cookie == chan->err_cookie ? DMA_ERROR : status;
+
+	if (!txstate)
+		return status;
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	vd = vchan_find_desc(&chan->vc, cookie);
+	if (vd)
+		residue = to_edma_desc(vd)->len;
+	else if (chan->active && chan->active->vd.tx.cookie == cookie)
+		residue = chan->active->len;
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	dma_set_residue(txstate, residue);
+
+	return status;
+}
+
+static int tegra_pcie_edma_terminate_all(struct dma_chan *dc)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&chan->vc.lock, flags);
+	if (chan->active) {
+		tegra_pcie_edma_stop(chan);
+		list_add_tail(&chan->active->vd.node, &head);
+		chan->active = NULL;
+	}
+	vchan_get_all_descriptors(&chan->vc, &head);
+	spin_unlock_irqrestore(&chan->vc.lock, flags);
+
+	vchan_dma_desc_free_list(&chan->vc, &head);
+
+	return 0;
+}
+
+static void tegra_pcie_edma_synchronize(struct dma_chan *dc)
+{
+	vchan_synchronize(&to_edma_chan(dc)->vc);
+}
+
+static int tegra_pcie_edma_alloc_chan_resources(struct dma_chan *dc)
+{
+	return 0;
+}
+
+static void tegra_pcie_edma_free_chan_resources(struct dma_chan *dc)
+{
+	tegra_pcie_edma_terminate_all(dc);
+	vchan_free_chan_resources(&to_edma_chan(dc)->vc);
+}
+
+static struct dma_chan *tegra_pcie_edma_get_chan(struct tegra_pcie_edma *edma,
+					enum dma_transfer_direction dir)
+{
+	struct tegra_pcie_edma_chan *chans;
+	struct dma_chan *dc;
+	int i, nr;
+
+	if (dir == DMA_MEM_TO_DEV) {
+		chans = edma->wr;
+		nr = EDMA_WR_CHNL_NUM;
+	} else if (dir == DMA_DEV_TO_MEM) {
+		chans = edma->rd;
+		nr = EDMA_RD_CHNL_NUM;
+	} else {
+		return NULL;
+	}
+
+	for (i = 0; i < nr; i++) {
+		dc = dma_get_slave_channel(&chans[i].vc.chan);
+		if (dc)
+			return dc;
+	}
+
+	return NULL;
+}
+
+/* One cell: 0 for a write channel, 1 for a read channel */
+static struct dma_chan *tegra_pcie_edma_of_xlate(
+		struct of_phandle_args *dma_spec, struct of_dma *ofdma)
+{
+	struct tegra_pcie_edma *edma = ofdma->of_dma_data;
+
+	if (dma_spec->args_count != 1)
+		return NULL;
+
+	return tegra_pcie_edma_get_chan(edma, dma_spec->args[0] ?
+					DMA_DEV_TO_MEM : DMA_MEM_TO_DEV);
+}
+
+struct dma_chan *tegra_pcie_edma_request_chan(struct device *dev,
+					enum dma_transfer_direction dir)
+{
+	struct tegra_pcie_edma *edma;
+	struct dma_chan *dc = NULL;
+
+	mutex_lock(&edma_list_lock);
+	list_for_each_entry(edma, &edma_list, node) {
+		if (edma->dev == dev) {
+			dc = tegra_pcie_edma_get_chan(edma, dir);
+			break;
+		}
+	}
+	mutex_unlock(&edma_list_lock);
+
+	return dc;
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_request_chan);
+
+/* Must be called with the common lock held and the engine online */
+static void tegra_pcie_edma_program_remote_irq(
+		struct tegra_pcie_edma_chan *chan)
+{
+	struct tegra_pcie_edma *edma = chan->edma;
+	bool wr = chan->dir == DMA_MEM_TO_DEV;
+	u32 data_off, val;
+
+	edma_writel(edma, lower_32_bits(chan->remote_addr),
+		    wr ? EDMA_WRITE_DONE_IMWR_LOW : EDMA_READ_DONE_IMWR_LOW);
+	edma_writel(edma, upper_32_bits(chan->remote_addr),
+		    wr ? EDMA_WRITE_DONE_IMWR_HIGH : EDMA_READ_DONE_IMWR_HIGH);
+	edma_writel(edma, lower_32_bits(chan->remote_addr),
+		    wr ? EDMA_WRITE_ABORT_IMWR_LOW : EDMA_READ_ABORT_IMWR_LOW);
+	edma_writel(edma, upper_32_bits(chan->remote_addr),
+		    wr ? EDMA_WRITE_ABORT_IMWR_HIGH : EDMA_READ_ABORT_IMWR_HIGH);
+
+	data_off = (wr ? EDMA_WRITE_IMWR_DATA : EDMA_READ_IMWR_DATA) +
+		   EDMA_IMWR_DATA(chan->id);
+	val = edma_readl(edma, data_off);
+	val &= ~(0xFFFF << EDMA_IMWR_DATA_SHIFT(chan->id));
+	val |= chan->remote_data << EDMA_IMWR_DATA_SHIFT(chan->id);
+	edma_writel(edma, val, data_off);
+}
+
+/*
+ * Have descriptors prepared with DMA_PREP_INTERRUPT on @dc also write
+ * @data to the PCIe address @addr once done, typically the MSI of the
+ * other side. The address is shared by all channels of one direction.
+ */
+int tegra_pcie_edma_set_remote_irq(struct dma_chan *dc, u64 addr, u16 data)
+{
+	struct tegra_pcie_edma_chan *chan = to_edma_chan(dc);
+	struct tegra_pcie_edma *edma = chan->edma;
+	unsigned long flags;
+
+	spin_lock_irqsave(&edma->lock, flags);
+	chan->remote_irq = true;
+	chan->remote_addr = addr;
+	chan->remote_data = data;
+	if (edma->online)
+		tegra_pcie_edma_program_remote_irq(chan);
+	spin_unlock_irqrestore(&edma->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_set_remote_irq);
+
+static void tegra_pcie_edma_init_chan(struct tegra_pcie_edma *edma,
+				      struct tegra_pcie_edma_chan *chan,
+				      enum dma_transfer_direction dir, u8 id)
+{
+	chan->edma = edma;
+	chan->dir = dir;
+	chan->id = id;
+	chan->vc.desc_free = tegra_pcie_edma_desc_free;
+	vchan_init(&chan->vc, &edma->dma_dev);
+}
+
+/*
+ * Called by the controller driver once its registers are accessible, and
+ * again after every power up. Queued transfers are started right away.
+ */
+void tegra_pcie_edma_online(struct tegra_pcie_edma *edma)
+{
+	struct tegra_pcie_edma_chan *chan;
+	unsigned long flags;
+	u32 val;
+	int i;
+
+	if (IS_ERR_OR_NULL(edma))
+		return;
+
+	spin_lock_irqsave(&edma->lock, flags);
+	edma_writel(edma, EDMA_ENGINE_EN_ENABLE, EDMA_WRITE_ENGINE_EN);
+	edma_writel(edma, EDMA_ENGINE_EN_ENABLE, EDMA_READ_ENGINE_EN);
+
+	val = edma_readl(edma, EDMA_WRITE_INT_MASK);
+	for (i = 0; i < EDMA_WR_CHNL_NUM; i++)
+		val &= ~(EDMA_INT_DONE(i) | EDMA_INT_ABORT(i));
+	edma_writel(edma, val, EDMA_WRITE_INT_MASK);
+
+	val = edma_readl(edma, EDMA_READ_INT_MASK);
+	for (i = 0; i < EDMA_RD_CHNL_NUM; i++)
+		val &= ~(EDMA_INT_DONE(i) | EDMA_INT_ABORT(i));
+	edma_writel(edma, val, EDMA_READ_INT_MASK);
+
+	list_for_each_entry(chan, &edma->dma_dev.channels, vc.chan.device_node)
+		if (chan->remote_irq)
+			tegra_pcie_edma_program_remote_irq(chan);
+
+	edma->online = true;
+	spin_unlock_irqrestore(&edma->lock, flags);
+
+	list_for_each_entry(chan, &edma->dma_dev.channels, vc.chan.device_node) {
+		spin_lock_irqsave(&chan->vc.lock, flags);
+		if (!chan->active)
+			tegra_pcie_edma_start(chan);
+		spin_unlock_irqrestore(&chan->vc.lock, flags);
+	}
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_online);
+
+/*
+ * Called before the controller is powered down. A transfer in flight is
+ * stopped and completed as an error, queued ones wait for the next online.
+ */
+void tegra_pcie_edma_offline(struct tegra_pcie_edma *edma)
+{
+	struct tegra_pcie_edma_chan *chan;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(edma))
+		return;
+
+	/* No channel gets started from here on */
+	spin_lock_irqsave(&edma->lock, flags);
+	edma->online = false;
+	spin_unlock_irqrestore(&edma->lock, flags);
+
+	list_for_each_entry(chan, &edma->dma_dev.channels, vc.chan.device_node) {
+		spin_lock_irqsave(&chan->vc.lock, flags);
+		if (chan->active) {
+			edma_writel(edma, EDMA_DOORBELL_STOP | chan->id,
+				    edma_doorbell(chan));
+			chan->err_cookie = chan->active->vd.tx.cookie;
+			vchan_cookie_complete(&chan->active->vd);
+			chan->active = NULL;
+		}
+		spin_unlock_irqrestore(&chan->vc.lock, flags);
+	}
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_offline);
+
+/*
+ * @regs points at the eDMA register block. The engine is left offline;
+ * the caller brings it online once the controller is powered.
+ */
+struct tegra_pcie_edma *tegra_pcie_edma_register(struct device *dev,
+						 void __iomem *regs)
+{
+	struct tegra_pcie_edma *edma;
+	struct dma_device *dma_dev;
+	int i, ret;
+
+	edma = devm_kzalloc(dev, sizeof(*edma), GFP_KERNEL);
+	if (!edma)
+		return ERR_PTR(-ENOMEM);
+
+	edma->dev = dev;
+	edma->regs = regs;
+	spin_lock_init(&edma->lock);
+
+	edma->ll_pool = dmam_pool_create(dev_name(dev), dev,
+			(EDMA_MAX_LL + 1) * sizeof(struct tegra_pcie_edma_ll),
+			sizeof(struct tegra_pcie_edma_ll), 0);
+	if (!edma->ll_pool) {
+		dev_err(dev, "failed to create eDMA linked list pool\n");
+		return ERR_PTR(-ENOMEM);
+	}
+
+	dma_dev = &edma->dma_dev;
+	dma_dev->dev = dev;
+	INIT_LIST_HEAD(&dma_dev->channels);
+	for (i = 0; i < EDMA_WR_CHNL_NUM; i++)
+		tegra_pcie_edma_init_chan(edma, &edma->wr[i],
+					  DMA_MEM_TO_DEV, i);
+	for (i = 0; i < EDMA_RD_CHNL_NUM; i++)
+		tegra_pcie_edma_init_chan(edma, &edma->rd[i],
+					  DMA_DEV_TO_MEM, i);
+
+	dma_cap_set(DMA_SLAVE, dma_dev->cap_mask);
+	dma_cap_set(DMA_PRIVATE, dma_dev->cap_mask);
+	dma_cap_set(DMA_MEMCPY, dma_dev->cap_mask);
+
+	dma_dev->directions = BIT(DMA_MEM_TO_DEV) | BIT(DMA_DEV_TO_MEM);
+	dma_dev->residue_granularity = DMA_RESIDUE_GRANULARITY_DESCRIPTOR;
+	dma_dev->device_alloc_chan_resources =
+				tegra_pcie_edma_alloc_chan_resources;
+	dma_dev->device_free_chan_resources =
+				tegra_pcie_edma_free_chan_resources;
+	dma_dev->device_prep_slave_sg = tegra_pcie_edma_prep_slave_sg;
+	dma_dev->device_prep_dma_memcpy = tegra_pcie_edma_prep_dma_memcpy;
+	dma_dev->device_config = tegra_pcie_edma_slave_config;
+	dma_dev->device_terminate_all = tegra_pcie_edma_terminate_all;
+	dma_dev->device_synchronize = tegra_pcie_edma_synchronize;
+	dma_dev->device_tx_status = tegra_pcie_edma_tx_status;
+	dma_dev->device_issue_pending = tegra_pcie_edma_issue_pending;
+
+	ret = dma_async_device_register(dma_dev);
+	if (ret < 0) {
+		dev_err(dev, "eDMA registration failed: %d\n", ret);
+		return ERR_PTR(ret);
+	}
+
+	if (dev->of_node) {
+		ret = of_dma_controller_register(dev->of_node,
+						 tegra_pcie_edma_of_xlate,
+						 edma);
+		if (ret < 0) {
+			dev_err(dev, "eDMA OF registration failed: %d\n", ret);
+			dma_async_device_unregister(dma_dev);
+			return ERR_PTR(ret);
+		}
+	}
+
+	mutex_lock(&edma_list_lock);
+	list_add_tail(&edma->node, &edma_list);
+	mutex_unlock(&edma_list_lock);
+
+	dev_info(dev, "eDMA registered with %d write and %d read channels\n",
+		 EDMA_WR_CHNL_NUM, EDMA_RD_CHNL_NUM);
+
+	return edma;
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_register);
+
+void tegra_pcie_edma_unregister(struct tegra_pcie_edma *edma)
+{
+	struct tegra_pcie_edma_chan *chan;
+
+	if (IS_ERR_OR_NULL(edma))
+		return;
+
+	mutex_lock(&edma_list_lock);
+	list_del(&edma->node);
+	mutex_unlock(&edma_list_lock);
+
+	tegra_pcie_edma_offline(edma);
+
+	if (edma->dev->of_node)
+		of_dma_controller_free(edma->dev->of_node);
+	dma_async_device_unregister(&edma->dma_dev);
+
+	list_for_each_entry(chan, &edma->dma_dev.channels, vc.chan.device_node)
+		tasklet_kill(&chan->vc.task);
+}
+EXPORT_SYMBOL_GPL(tegra_pcie_edma_unregister);
+
+MODULE_DESCRIPTION("NVIDIA Tegra PCIe eDMA driver");
+MODULE_AUTHOR("NVIDIA Corporation");
+MODULE_LICENSE("GPL v2");
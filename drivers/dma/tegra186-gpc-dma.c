@@ -17,6 +17,8 @@
  */
 
 #include <linux/bitops.h>
+#include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/dmaengine.h>
 #include <linux/dma-mapping.h>
@@ -24,6 +26,7 @@
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/of.h>
@@ -31,6 +34,8 @@
 #include <linux/of_dma.h>
 #include <linux/platform_device.h>
 #include <linux/pm.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/tegra_pm_domains.h>
 #include <linux/version.h>
@@ -164,6 +169,27 @@
 /* Channel base address offset from GPCDMA base address */
 #define TEGRA_GPCDMA_CHANNEL_BASE_ADD_OFFSET	0x10000
 
+/* Buffer size and repetitions of the debugfs memcpy/memset selftest */
+#define TEGRA_GPCDMA_BENCH_SIZE			SZ_1M
+#define TEGRA_GPCDMA_BENCH_LOOPS		64
+
+/* Completed descriptors whose callbacks are collected per lock round trip */
+#define TEGRA_GPCDMA_CB_BATCH			16
+
+/* Per channel pools used when the DT does not size them */
+#define TEGRA_GPCDMA_DEFAULT_PREALLOC_DESCS	4
+#define TEGRA_GPCDMA_DEFAULT_PREALLOC_SG	32
+
+static bool chain_sg = true;
+module_param(chain_sg, bool, 0644);
+MODULE_PARM_DESC(chain_sg,
+	"Run multi segment slave transfers back to back in continuous mode");
+
+static bool balance_chans = true;
+module_param(balance_chans, bool, 0644);
+MODULE_PARM_DESC(balance_chans,
+	"Hand out the least used free channel to DT clients, not the first");
+
 struct tegra_dma;
 
 /*
@@ -226,6 +252,7 @@ struct tegra_dma_desc {
 	struct list_head		tx_list;
 	struct list_head		cb_node;
 	int				cb_count;
+	bool				cb_coalesce;
 };
 
 struct tegra_dma_channel;
@@ -262,6 +289,12 @@ struct tegra_dma_channel {
 	int slave_id;
 	struct dma_slave_config dma_sconfig;
 	struct tegra_dma_channel_regs	channel_reg;
+
+	/* Usage statistics, protected by lock */
+	u64			stat_bytes;
+	u64			stat_xfers;
+	u64			stat_allocs;
+	int			last_slave_id;
 };
 
 /* tegra_dma: Tegra DMA specific information */
@@ -271,6 +304,8 @@ struct tegra_dma {
 	void __iomem			*base_addr;
 	const struct tegra_dma_chip_data *chip_data;
 	struct reset_control *rst;
+	struct dentry *debugfs;
+	bool threaded_irq;
 	/* Last member of the structure */
 	struct tegra_dma_channel channels[0];
 };
@@ -346,7 +381,8 @@ static struct tegra_dma_desc *tegra_dma_desc_alloc(
 
 	BUG_ON(tdc2dev(tdc) == NULL);
 
-	dma_desc = devm_kzalloc(tdc2dev(tdc), sizeof(*dma_desc), GFP_ATOMIC);
+	dma_desc = devm_kzalloc(tdc2dev(tdc), sizeof(*dma_desc),
+				prealloc ? GFP_KERNEL : GFP_ATOMIC);
 	if (!dma_desc) {
 		dev_err(tdc2dev(tdc), "dma_desc alloc failed\n");
 		return NULL;
@@ -412,7 +448,8 @@ static struct tegra_dma_sg_req *tegra_dma_sg_req_alloc(
 		bool prealloc)
 {
 	struct tegra_dma_sg_req *sg_req = NULL;
-	sg_req = devm_kzalloc(tdc2dev(tdc), sizeof(struct tegra_dma_sg_req), GFP_ATOMIC);
+	sg_req = devm_kzalloc(tdc2dev(tdc), sizeof(struct tegra_dma_sg_req),
+			      prealloc ? GFP_KERNEL : GFP_ATOMIC);
 	if (!sg_req) {
 		dev_err(tdc2dev(tdc), "sg_req alloc failed\n");
 		return NULL;
@@ -561,9 +598,24 @@ static void tegra_dma_configure_for_next(struct tegra_dma_channel *tdc,
 	nsg_req->skipped = false;
 }
 
+/*
+ * In continuous mode the channel reloads its pointers and word count when
+ * a transfer ends and carries on, so whatever is programmed by then is
+ * the next transfer: the following segment for cyclic and chained
+ * transfers.
+ */
+static inline bool tegra_dma_sg_req_continuous(struct tegra_dma_sg_req *sg_req)
+{
+	return !(sg_req->ch_regs.csr & TEGRA_GPCDMA_CSR_ONCE);
+}
+
+static void tdc_configure_next_head_desc(struct tegra_dma_channel *tdc);
+
 static void tdc_start_head_req(struct tegra_dma_channel *tdc)
 {
 	struct tegra_dma_sg_req *sg_req;
+	unsigned long status;
+	int count;
 
 	if (list_empty(&tdc->pending_sg_req))
 		return;
@@ -574,6 +626,25 @@ static void tdc_start_head_req(struct tegra_dma_channel *tdc)
 	sg_req->configured = true;
 	sg_req->skipped = false;
 	tdc->busy = true;
+
+	if (!tegra_dma_sg_req_continuous(sg_req))
+		return;
+
+	/*
+	 * Program the second transfer parameters as soon as the first
+	 * transfer is started in order for the dma controller to trigger
+	 * the second transfer with the correct parameters. Poll for the
+	 * channel busy bit and program it.
+	 */
+	count = 20;
+	do {
+		status = tdc_read(tdc, TEGRA_GPCDMA_CHAN_STATUS);
+		if (status & TEGRA_GPCDMA_STATUS_BUSY)
+			break;
+		udelay(1);
+		count--;
+	} while (count);
+	tdc_configure_next_head_desc(tdc);
 }
 
 static void tdc_configure_next_head_desc(struct tegra_dma_channel *tdc)
@@ -649,17 +720,20 @@ static bool handle_continuous_head_request(struct tegra_dma_channel *tdc,
 static void handle_once_dma_done(struct tegra_dma_channel *tdc,
 	bool to_terminate)
 {
-	struct tegra_dma_sg_req *sgreq;
+	struct tegra_dma_sg_req *sgreq, *hsgreq;
 	struct tegra_dma_desc *dma_desc;
+	bool chained;
 
-	tdc->busy = false;
 	sgreq = list_first_entry(&tdc->pending_sg_req, typeof(*sgreq), node);
+	chained = tegra_dma_sg_req_continuous(sgreq);
 	dma_desc = sgreq->dma_desc;
 	dma_desc->bytes_transferred += sgreq->req_len;
 	dma_desc->total_bytes_transferred += sgreq->req_len;
+	tdc->stat_bytes += sgreq->req_len;
 
 	list_del(&sgreq->node);
 	if (sgreq->last_sg) {
+		tdc->stat_xfers++;
 		dma_desc->dma_status = DMA_COMPLETE;
 		dma_cookie_complete(&dma_desc->txd);
 		if (!dma_desc->cb_count)
@@ -669,11 +743,27 @@ static void handle_once_dma_done(struct tegra_dma_channel *tdc,
 	}
 	tegra_dma_sg_req_put(tdc, sgreq, false);
 
-	if (to_terminate || list_empty(&tdc->pending_sg_req))
+	if (!chained || list_empty(&tdc->pending_sg_req)) {
+		tdc->busy = false;
+		if (!to_terminate)
+			tdc_start_head_req(tdc);
 		return;
+	}
 
-	tdc_start_head_req(tdc);
-	return;
+	/*
+	 * The channel has moved on to the next segment by itself. If that
+	 * segment was not programmed in time, it repeated this one instead.
+	 */
+	hsgreq = list_first_entry(&tdc->pending_sg_req, typeof(*hsgreq), node);
+	if (!hsgreq->configured || hsgreq->skipped) {
+		tegra_dma_stop(tdc);
+		dev_err(tdc2dev(tdc), "Error in chained transfer, aborting dma\n");
+		tegra_dma_abort_all(tdc);
+		return;
+	}
+
+	if (!to_terminate && tegra_dma_sg_req_continuous(hsgreq))
+		tdc_configure_next_head_desc(tdc);
 }
 
 static void handle_cont_sngl_cycle_dma_done(struct tegra_dma_channel *tdc,
@@ -687,6 +777,8 @@ static void handle_cont_sngl_cycle_dma_done(struct tegra_dma_channel *tdc,
 	dma_desc = sgreq->dma_desc;
 	dma_desc->bytes_transferred += sgreq->req_len;
 	dma_desc->total_bytes_transferred += sgreq->req_len;
+	tdc->stat_bytes += sgreq->req_len;
+	tdc->stat_xfers++;
 
 	/* Callback need to be call */
 	if (!dma_desc->cb_count)
@@ -705,32 +797,60 @@ static void handle_cont_sngl_cycle_dma_done(struct tegra_dma_channel *tdc,
 	return;
 }
 
-static void tegra_dma_tasklet(unsigned long data)
+struct tegra_dma_cb {
+	dma_async_tx_callback	callback;
+	void			*callback_param;
+	int			count;
+};
+
+/*
+ * Run the callbacks of all completed descriptors, taking the channel lock
+ * once per batch of them rather than once per descriptor.
+ */
+static void tegra_dma_process_callbacks(struct tegra_dma_channel *tdc)
 {
-	struct tegra_dma_channel *tdc = (struct tegra_dma_channel *)data;
-	dma_async_tx_callback callback = NULL;
-	void *callback_param = NULL;
+	struct tegra_dma_cb cbs[TEGRA_GPCDMA_CB_BATCH];
 	struct tegra_dma_desc *dma_desc;
 	unsigned long flags;
-	int cb_count;
+	int i, n;
 
 	raw_spin_lock_irqsave(&tdc->lock, flags);
 	while (!list_empty(&tdc->cb_desc)) {
-		dma_desc  = list_first_entry(&tdc->cb_desc,
-					typeof(*dma_desc), cb_node);
-		list_del(&dma_desc->cb_node);
-		callback = dma_desc->txd.callback;
-		callback_param = dma_desc->txd.callback_param;
-		cb_count = dma_desc->cb_count;
-		dma_desc->cb_count = 0;
+		for (n = 0; n < TEGRA_GPCDMA_CB_BATCH &&
+		     !list_empty(&tdc->cb_desc); n++) {
+			dma_desc = list_first_entry(&tdc->cb_desc,
+						typeof(*dma_desc), cb_node);
+			list_del(&dma_desc->cb_node);
+			cbs[n].callback = dma_desc->txd.callback;
+			cbs[n].callback_param = dma_desc->txd.callback_param;
+			/* one call covers all periods that elapsed since */
+			cbs[n].count = dma_desc->cb_coalesce ?
+					1 : dma_desc->cb_count;
+			dma_desc->cb_count = 0;
+		}
 		raw_spin_unlock_irqrestore(&tdc->lock, flags);
-		while (cb_count-- && callback)
-			callback(callback_param);
+
+		for (i = 0; i < n; i++)
+			while (cbs[i].count-- && cbs[i].callback)
+				cbs[i].callback(cbs[i].callback_param);
+
 		raw_spin_lock_irqsave(&tdc->lock, flags);
 	}
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 }
 
+static void tegra_dma_tasklet(unsigned long data)
+{
+	tegra_dma_process_callbacks((struct tegra_dma_channel *)data);
+}
+
+static irqreturn_t tegra_dma_isr_thread(int irq, void *dev_id)
+{
+	tegra_dma_process_callbacks(dev_id);
+
+	return IRQ_HANDLED;
+}
+
 static void tegra_dma_chan_decode_error(struct tegra_dma_channel *tdc, unsigned int err_status)
 {
 	switch(TEGRA_GPCDMA_CHAN_ERR_TYPE(err_status)) {
@@ -771,6 +891,7 @@ static irqreturn_t tegra_dma_isr(int irq, void *dev_id)
 	unsigned long status;
 	unsigned long flags;
 	unsigned int err_status;
+	irqreturn_t ret = IRQ_HANDLED;
 
 	raw_spin_lock_irqsave(&tdc->lock, flags);
 
@@ -793,9 +914,12 @@ static irqreturn_t tegra_dma_isr(int irq, void *dev_id)
 				tdc->id, status);
 			tegra_dma_dump_chan_regs(tdc);
 		}
-		tasklet_schedule(&tdc->tasklet);
+		if (tdc->tdma->threaded_irq)
+			ret = IRQ_WAKE_THREAD;
+		else
+			tasklet_schedule(&tdc->tasklet);
 		raw_spin_unlock_irqrestore(&tdc->lock, flags);
-		return IRQ_HANDLED;
+		return ret;
 	}
 
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
@@ -821,8 +945,6 @@ static void tegra_dma_issue_pending(struct dma_chan *dc)
 {
 	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
 	unsigned long flags;
-	unsigned long status;
-	int count;
 
 	raw_spin_lock_irqsave(&tdc->lock, flags);
 	if (list_empty(&tdc->pending_sg_req)) {
@@ -830,28 +952,9 @@ static void tegra_dma_issue_pending(struct dma_chan *dc)
 		goto end;
 	}
 
-	if (!tdc->busy) {
+	/* Continuous mode: the next req is configured along */
+	if (!tdc->busy)
 		tdc_start_head_req(tdc);
-		/* Continuous mode: Configure next req */
-		if (tdc->cyclic) {
-			/*
-			 * For cyclic dma transfers, program the second transfer
-			 * parameters as soon as the first dma transfer is
-			 * started inorder for the dma controller to trigger the
-			 * second transfer with the correct parameters. Poll
-			 * for the channel busy bit and start the transfer.
-			 */
-			count = 20;
-			do {
-				status = tdc_read(tdc, TEGRA_GPCDMA_CHAN_STATUS);
-				if (status & TEGRA_GPCDMA_STATUS_BUSY)
-					break;
-				udelay(1);
-				count--;
-			} while(count);
-			tdc_configure_next_head_desc(tdc);
-		}
-	}
 
 end:
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
@@ -1110,44 +1213,70 @@ static int get_transfer_param(struct tegra_dma_channel *tdc,
 	return -EINVAL;
 }
 
-static struct dma_async_tx_descriptor *tegra_dma_prep_dma_memset(
-	struct dma_chan *dc, dma_addr_t dest, int value, size_t len,
-	unsigned long flags)
+/*
+ * Let the segments of @dma_desc follow each other without the channel
+ * stopping in between: all but the last run in continuous mode and
+ * interrupt only so that the ISR can program the segment after the next
+ * one. Only the pointers and word count are reloaded between segments,
+ * so they must agree on everything else.
+ */
+static void tegra_dma_chain_sg_reqs(struct tegra_dma_desc *dma_desc)
 {
-	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
-	struct tegra_dma_desc *dma_desc;
-	struct list_head req_list;
-	struct tegra_dma_sg_req *sg_req = NULL;
-	unsigned long csr, mc_seq;
+	struct tegra_dma_sg_req *first, *sg_req;
 
-	INIT_LIST_HEAD(&req_list);
-	/* Set dma mode to fixed pattern */
-	csr = TEGRA_GPCDMA_CSR_DMA_FIXED_PAT;
+	first = list_first_entry(&dma_desc->tx_list, typeof(*first), node);
+	list_for_each_entry(sg_req, &dma_desc->tx_list, node)
+		if (sg_req->ch_regs.mmio_seq != first->ch_regs.mmio_seq ||
+		    sg_req->ch_regs.mc_seq != first->ch_regs.mc_seq)
+			return;
+
+	list_for_each_entry(sg_req, &dma_desc->tx_list, node) {
+		if (sg_req->last_sg)
+			break;
+		sg_req->ch_regs.csr &= ~TEGRA_GPCDMA_CSR_ONCE;
+		sg_req->ch_regs.csr |= TEGRA_GPCDMA_CSR_IE_EOC;
+	}
+}
+
+/* CSR and MC sequencer settings shared by the memory to memory modes */
+static void tegra_dma_mem_regs(struct tegra_dma_channel *tdc,
+		unsigned long mode, unsigned long flags,
+		unsigned long *csr, unsigned long *mc_seq)
+{
+	*csr = mode;
 	/* Enable once or continuous mode */
-	csr |= TEGRA_GPCDMA_CSR_ONCE;
+	*csr |= TEGRA_GPCDMA_CSR_ONCE;
 	/* Enable IRQ mask */
-	csr |= TEGRA_GPCDMA_CSR_IRQ_MASK;
+	*csr |= TEGRA_GPCDMA_CSR_IRQ_MASK;
 	/* Enable the dma interrupt */
 	if (flags & DMA_PREP_INTERRUPT)
-		csr |= TEGRA_GPCDMA_CSR_IE_EOC;
+		*csr |= TEGRA_GPCDMA_CSR_IE_EOC;
 	/* Configure default priority weight for the channel */
-	csr |= (1 << TEGRA_GPCDMA_CSR_WEIGHT_SHIFT);
+	*csr |= (1 << TEGRA_GPCDMA_CSR_WEIGHT_SHIFT);
 
-	mc_seq =  tdc_read(tdc, TEGRA_GPCDMA_CHAN_MCSEQ);
+	*mc_seq =  tdc_read(tdc, TEGRA_GPCDMA_CHAN_MCSEQ);
 	/* retain stream-id and clean rest */
-	mc_seq &= (TEGRA_GPCDMA_MCSEQ_STREAM_ID_MASK <<
-			TEGRA_GPCDMA_MCSEQ_STREAM_ID0_SHIFT);
+	*mc_seq &= ((TEGRA_GPCDMA_MCSEQ_STREAM_ID_MASK <<
+			TEGRA_GPCDMA_MCSEQ_STREAM_ID0_SHIFT) |
+			(TEGRA_GPCDMA_MCSEQ_STREAM_ID_MASK <<
+			TEGRA_GPCDMA_MCSEQ_STREAM_ID1_SHIFT));
 
 	/* Set the address wrapping */
-	mc_seq |= TEGRA_GPCDMA_MCSEQ_WRAP_NONE <<
+	*mc_seq |= TEGRA_GPCDMA_MCSEQ_WRAP_NONE <<
 			TEGRA_GPCDMA_MCSEQ_WRAP0_SHIFT;
-	mc_seq |= TEGRA_GPCDMA_MCSEQ_WRAP_NONE <<
+	*mc_seq |= TEGRA_GPCDMA_MCSEQ_WRAP_NONE <<
 			TEGRA_GPCDMA_MCSEQ_WRAP1_SHIFT;
 
 	/* Program outstanding MC requests */
-	mc_seq |= (1 << TEGRA_GPCDMA_MCSEQ_REQ_COUNT_SHIFT);
+	*mc_seq |= (1 << TEGRA_GPCDMA_MCSEQ_REQ_COUNT_SHIFT);
 	/* Set burst size */
-	mc_seq |= TEGRA_GPCDMA_MCSEQ_BURST_16;
+	*mc_seq |= TEGRA_GPCDMA_MCSEQ_BURST_16;
+}
+
+static struct tegra_dma_desc *tegra_dma_mem_desc_get(
+		struct tegra_dma_channel *tdc)
+{
+	struct tegra_dma_desc *dma_desc;
 
 	dma_desc = tegra_dma_desc_get(tdc);
 	if (!dma_desc) {
@@ -1157,33 +1286,37 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_dma_memset(
 	INIT_LIST_HEAD(&dma_desc->tx_list);
 	INIT_LIST_HEAD(&dma_desc->cb_node);
 	dma_desc->cb_count = 0;
+	dma_desc->cb_coalesce = false;
 	dma_desc->bytes_requested = 0;
 	dma_desc->bytes_transferred = 0;
 	dma_desc->total_bytes_transferred = 0;
 	dma_desc->dma_status = DMA_IN_PROGRESS;
 
-	if ((len & 3) || (dest & 3) ||
-		(len > tdc->tdma->chip_data->max_dma_count)) {
-		dev_err(tdc2dev(tdc),
-			"Dma length/memory address is not supported\n");
-		tegra_dma_desc_put(tdc, dma_desc);
-		return NULL;
-	}
+	return dma_desc;
+}
+
+static int tegra_dma_mem_add_req(struct tegra_dma_channel *tdc,
+		struct tegra_dma_desc *dma_desc, unsigned long csr,
+		unsigned long mc_seq, dma_addr_t src, dma_addr_t dest,
+		u32 len, u32 pattern)
+{
+	struct tegra_dma_sg_req *sg_req;
 
 	sg_req = tegra_dma_sg_req_get(tdc);
 	if (!sg_req) {
 		dev_err(tdc2dev(tdc), "Dma sg-req not available\n");
-		tegra_dma_desc_put(tdc, dma_desc);
-		return NULL;
+		return -ENOMEM;
 	}
 
 	dma_desc->bytes_requested += len;
-	sg_req->ch_regs.src_ptr = 0;
+	sg_req->ch_regs.src_ptr = src;
 	sg_req->ch_regs.dst_ptr = dest;
-	sg_req->ch_regs.high_addr_ptr = ((dest >> 32) &
-			TEGRA_GPCDMA_HIGH_ADDR_DST_PTR_MASK) <<
-			TEGRA_GPCDMA_HIGH_ADDR_DST_PTR_SHIFT;
-	sg_req->ch_regs.fixed_pattern = value;
+	sg_req->ch_regs.high_addr_ptr = (src >> 32) &
+		TEGRA_GPCDMA_HIGH_ADDR_SCR_PTR_MASK;
+	sg_req->ch_regs.high_addr_ptr |= ((dest >> 32) &
+		TEGRA_GPCDMA_HIGH_ADDR_DST_PTR_MASK) <<
+		TEGRA_GPCDMA_HIGH_ADDR_DST_PTR_SHIFT;
+	sg_req->ch_regs.fixed_pattern = pattern;
 	/* Word count reg takes value as (N +1) words */
 	sg_req->ch_regs.wcount = ((len - 4) >> 2);
 	sg_req->ch_regs.csr = csr;
@@ -1194,117 +1327,206 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_dma_memset(
 	sg_req->last_sg = false;
 	sg_req->dma_desc = dma_desc;
 	sg_req->req_len = len;
-	sg_req->last_sg = true;
 
 	list_add_tail(&sg_req->node, &dma_desc->tx_list);
 
+	return 0;
+}
+
+static struct dma_async_tx_descriptor *tegra_dma_mem_desc_done(
+		struct tegra_dma_channel *tdc, struct tegra_dma_desc *dma_desc,
+		unsigned long flags)
+{
+	struct tegra_dma_sg_req *sg_req;
+
+	sg_req = list_last_entry(&dma_desc->tx_list, typeof(*sg_req), node);
+	sg_req->last_sg = true;
+
 	if (flags & DMA_CTRL_ACK)
 		dma_desc->txd.flags = DMA_CTRL_ACK;
 
+	if (chain_sg && !list_is_singular(&dma_desc->tx_list))
+		tegra_dma_chain_sg_reqs(dma_desc);
+
 	if (!tdc->isr_handler)
 		tdc->isr_handler = handle_once_dma_done;
 
 	return &dma_desc->txd;
 }
 
-static struct dma_async_tx_descriptor *tegra_dma_prep_dma_memcpy(
-	struct dma_chan *dc, dma_addr_t dest, dma_addr_t src,	size_t len,
+/*
+ * Copies and fills longer than the controller can do in one go are split
+ * into max_dma_count segments, which are chained like slave transfers.
+ */
+static struct dma_async_tx_descriptor *tegra_dma_prep_dma_memset(
+	struct dma_chan *dc, dma_addr_t dest, int value, size_t len,
 	unsigned long flags)
 {
 	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
+	size_t max_len = tdc->tdma->chip_data->max_dma_count & ~3UL;
 	struct tegra_dma_desc *dma_desc;
-	struct list_head req_list;
-	struct tegra_dma_sg_req *sg_req = NULL;
 	unsigned long csr, mc_seq;
+	u32 pattern, seg_len;
 
-	INIT_LIST_HEAD(&req_list);
-	/* Set dma mode to memory to memory transfer */
-	csr = TEGRA_GPCDMA_CSR_DMA_MEM2MEM;
-	/* Enable once or continuous mode */
-	csr |= TEGRA_GPCDMA_CSR_ONCE;
-	/* Enable IRQ mask */
-	csr |= TEGRA_GPCDMA_CSR_IRQ_MASK;
-	/* Enable the dma interrupt */
-	if (flags & DMA_PREP_INTERRUPT)
-		csr |= TEGRA_GPCDMA_CSR_IE_EOC;
-	/* Configure default priority weight for the channel */
-	csr |= (1 << TEGRA_GPCDMA_CSR_WEIGHT_SHIFT);
+	if (!len || (len & 3) || (dest & 3)) {
+		dev_err(tdc2dev(tdc),
+			"Dma length/memory address is not supported\n");
+		return NULL;
+	}
 
-	mc_seq =  tdc_read(tdc, TEGRA_GPCDMA_CHAN_MCSEQ);
-	/* retain stream-id and clean rest */
-	mc_seq &= ((TEGRA_GPCDMA_MCSEQ_STREAM_ID_MASK <<
-			TEGRA_GPCDMA_MCSEQ_STREAM_ID0_SHIFT) |
-			(TEGRA_GPCDMA_MCSEQ_STREAM_ID_MASK <<
-			TEGRA_GPCDMA_MCSEQ_STREAM_ID1_SHIFT));
+	/* Set dma mode to fixed pattern */
+	tegra_dma_mem_regs(tdc, TEGRA_GPCDMA_CSR_DMA_FIXED_PAT, flags,
+			   &csr, &mc_seq);
 
-	/* Set the address wrapping */
-	mc_seq |= TEGRA_GPCDMA_MCSEQ_WRAP_NONE <<
-			TEGRA_GPCDMA_MCSEQ_WRAP0_SHIFT;
-	mc_seq |= TEGRA_GPCDMA_MCSEQ_WRAP_NONE <<
-			TEGRA_GPCDMA_MCSEQ_WRAP1_SHIFT;
+	dma_desc = tegra_dma_mem_desc_get(tdc);
+	if (!dma_desc)
+		return NULL;
 
-	/* Program outstanding MC requests */
-	mc_seq |= (1 << TEGRA_GPCDMA_MCSEQ_REQ_COUNT_SHIFT);
-	/* Set burst size */
-	mc_seq |= TEGRA_GPCDMA_MCSEQ_BURST_16;
+	/* value is a byte, the pattern register is a word */
+	pattern = (value & 0xFF) * 0x01010101;
 
-	dma_desc = tegra_dma_desc_get(tdc);
-	if (!dma_desc) {
-		dev_err(tdc2dev(tdc), "Dma descriptors not available\n");
-		return NULL;
+	while (len) {
+		seg_len = min(len, max_len);
+		if (tegra_dma_mem_add_req(tdc, dma_desc, csr, mc_seq, 0, dest,
+					  seg_len, pattern)) {
+			tegra_dma_desc_put(tdc, dma_desc);
+			return NULL;
+		}
+		dest += seg_len;
+		len -= seg_len;
 	}
-	INIT_LIST_HEAD(&dma_desc->tx_list);
-	INIT_LIST_HEAD(&dma_desc->cb_node);
-	dma_desc->cb_count = 0;
-	dma_desc->bytes_requested = 0;
-	dma_desc->bytes_transferred = 0;
-	dma_desc->total_bytes_transferred = 0;
-	dma_desc->dma_status = DMA_IN_PROGRESS;
 
-	if ((len & 3) || (src & 3) || (dest & 3) ||
-		(len > tdc->tdma->chip_data->max_dma_count)) {
+	return tegra_dma_mem_desc_done(tdc, dma_desc, flags);
+}
+
+static struct dma_async_tx_descriptor *tegra_dma_prep_dma_memcpy(
+	struct dma_chan *dc, dma_addr_t dest, dma_addr_t src,	size_t len,
+	unsigned long flags)
+{
+	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
+	size_t max_len = tdc->tdma->chip_data->max_dma_count & ~3UL;
+	struct tegra_dma_desc *dma_desc;
+	unsigned long csr, mc_seq;
+	u32 seg_len;
+
+	if (!len || (len & 3) || (src & 3) || (dest & 3)) {
 		dev_err(tdc2dev(tdc),
 			"Dma length/memory address is not supported\n");
-		tegra_dma_desc_put(tdc, dma_desc);
 		return NULL;
 	}
 
-	sg_req = tegra_dma_sg_req_get(tdc);
-	if (!sg_req) {
-		dev_err(tdc2dev(tdc), "Dma sg-req not available\n");
-		tegra_dma_desc_put(tdc, dma_desc);
+	/* Set dma mode to memory to memory transfer */
+	tegra_dma_mem_regs(tdc, TEGRA_GPCDMA_CSR_DMA_MEM2MEM, flags,
+			   &csr, &mc_seq);
+
+	dma_desc = tegra_dma_mem_desc_get(tdc);
+	if (!dma_desc)
 		return NULL;
+
+	while (len) {
+		seg_len = min(len, max_len);
+		if (tegra_dma_mem_add_req(tdc, dma_desc, csr, mc_seq, src, dest,
+					  seg_len, 0)) {
+			tegra_dma_desc_put(tdc, dma_desc);
+			return NULL;
+		}
+		src += seg_len;
+		dest += seg_len;
+		len -= seg_len;
 	}
 
-	dma_desc->bytes_requested += len;
-	sg_req->ch_regs.src_ptr = src;
-	sg_req->ch_regs.dst_ptr = dest;
-	sg_req->ch_regs.high_addr_ptr = (src >> 32) &
-		TEGRA_GPCDMA_HIGH_ADDR_SCR_PTR_MASK;
-	sg_req->ch_regs.high_addr_ptr |= ((dest >> 32) &
-		TEGRA_GPCDMA_HIGH_ADDR_DST_PTR_MASK) <<
-		TEGRA_GPCDMA_HIGH_ADDR_DST_PTR_SHIFT;
-	/* Word count reg takes value as (N +1) words */
-	sg_req->ch_regs.wcount = ((len - 4) >> 2);
-	sg_req->ch_regs.csr = csr;
-	sg_req->ch_regs.mmio_seq = 0;
-	sg_req->ch_regs.mc_seq = mc_seq;
-	sg_req->configured = false;
-	sg_req->skipped = false;
-	sg_req->last_sg = false;
-	sg_req->dma_desc = dma_desc;
-	sg_req->req_len = len;
-	sg_req->last_sg = true;
+	return tegra_dma_mem_desc_done(tdc, dma_desc, flags);
+}
 
-	list_add_tail(&sg_req->node, &dma_desc->tx_list);
+/*
+ * Each chunk of each frame becomes one segment, so a 2D copy costs one
+ * segment per line. Chunks that turn out to be contiguous on both sides
+ * (no gaps) are merged.
+ */
+static struct dma_async_tx_descriptor *tegra_dma_prep_interleaved_dma(
+	struct dma_chan *dc, struct dma_interleaved_template *xt,
+	unsigned long flags)
+{
+	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
+	size_t max_len = tdc->tdma->chip_data->max_dma_count & ~3UL;
+	struct tegra_dma_sg_req *sg_req;
+	struct tegra_dma_desc *dma_desc;
+	struct data_chunk *chunk;
+	unsigned long csr, mc_seq;
+	dma_addr_t src, dst, src_end = 0, dst_end = 0;
+	size_t f, c, len;
 
-	if (flags & DMA_CTRL_ACK)
-		dma_desc->txd.flags = DMA_CTRL_ACK;
+	if (xt->dir != DMA_MEM_TO_MEM || !xt->numf || !xt->frame_size ||
+	    !xt->src_inc || !xt->dst_inc) {
+		dev_err(tdc2dev(tdc), "Interleaved transfer not supported\n");
+		return NULL;
+	}
 
-	if (!tdc->isr_handler)
-		tdc->isr_handler = handle_once_dma_done;
+	tegra_dma_mem_regs(tdc, TEGRA_GPCDMA_CSR_DMA_MEM2MEM, flags,
+			   &csr, &mc_seq);
 
-	return &dma_desc->txd;
+	dma_desc = tegra_dma_mem_desc_get(tdc);
+	if (!dma_desc)
+		return NULL;
+
+	src = xt->src_start;
+	dst = xt->dst_start;
+	for (f = 0; f < xt->numf; f++) {
+		for (c = 0; c < xt->frame_size; c++) {
+			chunk = &xt->sgl[c];
+			len = chunk->size;
+
+			if ((len & 3) || (src & 3) || (dst & 3) ||
+			    len > max_len) {
+				dev_err(tdc2dev(tdc),
+					"Dma length/memory address is not supported\n");
+				goto fail;
+			}
+
+			if (!len)
+				goto next;
+
+			if (!list_empty(&dma_desc->tx_list)) {
+				sg_req = list_last_entry(&dma_desc->tx_list,
+						typeof(*sg_req), node);
+				if (src == src_end && dst == dst_end &&
+				    sg_req->req_len + len <= max_len &&
+				    upper_32_bits(src + len - 1) ==
+					upper_32_bits(sg_req->ch_regs.src_ptr) &&
+				    upper_32_bits(dst + len - 1) ==
+					upper_32_bits(sg_req->ch_regs.dst_ptr)) {
+					sg_req->req_len += len;
+					sg_req->ch_regs.wcount =
+						(sg_req->req_len - 4) >> 2;
+					dma_desc->bytes_requested += len;
+					goto advance;
+				}
+			}
+
+			if (tegra_dma_mem_add_req(tdc, dma_desc, csr, mc_seq,
+						  src, dst, len, 0))
+				goto fail;
+advance:
+			src_end = src + len;
+			dst_end = dst + len;
+next:
+			src += len;
+			dst += len;
+			if (xt->src_sgl)
+				src += dmaengine_get_src_icg(xt, chunk);
+			if (xt->dst_sgl)
+				dst += dmaengine_get_dst_icg(xt, chunk);
+		}
+	}
+
+	if (list_empty(&dma_desc->tx_list))
+		goto fail;
+
+	return tegra_dma_mem_desc_done(tdc, dma_desc, flags);
+
+fail:
+	tegra_dma_desc_put(tdc, dma_desc);
+	return NULL;
 }
 
 static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
@@ -1381,6 +1603,7 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 	INIT_LIST_HEAD(&dma_desc->tx_list);
 	INIT_LIST_HEAD(&dma_desc->cb_node);
 	dma_desc->cb_count = 0;
+	dma_desc->cb_coalesce = false;
 	dma_desc->bytes_requested = 0;
 	dma_desc->bytes_transferred = 0;
 	dma_desc->total_bytes_transferred = 0;
@@ -1445,6 +1668,9 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_slave_sg(
 	if (flags & DMA_CTRL_ACK)
 		dma_desc->txd.flags = DMA_CTRL_ACK;
 
+	if (chain_sg && sg_len > 1)
+		tegra_dma_chain_sg_reqs(dma_desc);
+
 	/*
 	 * Make sure that mode should not be conflicting with currently
 	 * configured mode.
@@ -1531,9 +1757,8 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_dma_cyclic(
 	/* Configure default priority weight for the channel*/
 	csr |= (1 << TEGRA_GPCDMA_CSR_WEIGHT_SHIFT);
 
-	/* Enable the dma interrupt */
-	if (flags & DMA_PREP_INTERRUPT)
-		csr |= TEGRA_GPCDMA_CSR_IE_EOC;
+	/* The ISR programs the following period, it always needs the irq */
+	csr |= TEGRA_GPCDMA_CSR_IE_EOC;
 
 	mmio_seq |= (1 << TEGRA_GPCDMA_MMIOSEQ_WRAP_WORD_SHIFT);
 
@@ -1563,6 +1788,12 @@ static struct dma_async_tx_descriptor *tegra_dma_prep_dma_cyclic(
 	INIT_LIST_HEAD(&dma_desc->tx_list);
 	INIT_LIST_HEAD(&dma_desc->cb_node);
 	dma_desc->cb_count = 0;
+	/*
+	 * Without DMA_PREP_INTERRUPT the client does not need to hear about
+	 * every period, so callbacks for periods that completed together
+	 * are coalesced into one.
+	 */
+	dma_desc->cb_coalesce = !(flags & DMA_PREP_INTERRUPT);
 
 	dma_desc->bytes_transferred = 0;
 	dma_desc->total_bytes_transferred = 0;
@@ -1644,41 +1875,97 @@ static int tegra_dma_alloc_chan_resources(struct dma_chan *dc)
 static void tegra_dma_free_chan_resources(struct dma_chan *dc)
 {
 	struct tegra_dma_channel *tdc = to_tegra_dma_chan(dc);
-	struct list_head dma_desc_list;
-	struct list_head sg_req_list;
+	struct tegra_dma_sg_req *sg_req;
+	struct tegra_dma_desc *dma_desc;
 	unsigned long flags;
 
-	INIT_LIST_HEAD(&dma_desc_list);
-	INIT_LIST_HEAD(&sg_req_list);
-
 	dev_dbg(tdc2dev(tdc), "Freeing channel %d\n", tdc->id);
 
 	if (tdc->busy)
 		tegra_dma_terminate_all(dc);
 	raw_spin_lock_irqsave(&tdc->lock, flags);
-	list_splice_init(&tdc->pending_sg_req, &sg_req_list);
-	list_splice_init(&tdc->free_sg_req, &sg_req_list);
-	list_splice_init(&tdc->free_dma_desc, &dma_desc_list);
+	/*
+	 * Descriptors and sg requests are device managed; keep them in the
+	 * channel pools for the next user instead of dropping them.
+	 */
+	list_for_each_entry(sg_req, &tdc->pending_sg_req, node)
+		if (sg_req->last_sg)
+			list_add_tail(&sg_req->dma_desc->node,
+				      &tdc->free_dma_desc);
+	list_splice_init(&tdc->pending_sg_req, &tdc->free_sg_req);
+	list_for_each_entry(dma_desc, &tdc->free_dma_desc, node) {
+		list_splice_init(&dma_desc->tx_list, &tdc->free_sg_req);
+		dma_desc->txd.flags = DMA_CTRL_ACK;
+	}
 	INIT_LIST_HEAD(&tdc->cb_desc);
 	tdc->config_init = false;
 	tdc->isr_handler = NULL;
+	tdc->last_slave_id = tdc->slave_id;
 	tdc->slave_id = -1;
 	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 }
 
+/*
+ * Pick a free channel for a DT client. A channel last used by the same
+ * peripheral is preferred, its pools are already sized for that client.
+ * Otherwise take the free channel that has moved the least data so far,
+ * so that busy clients do not all pile up on the lowest channels.
+ */
+static struct dma_chan *tegra_dma_pick_channel(struct tegra_dma *tdma,
+					       int slave_id)
+{
+	struct tegra_dma_channel *tdc, *best = NULL;
+	u64 best_bytes = U64_MAX;
+	unsigned long flags;
+	u64 bytes;
+	int i;
+
+	for (i = 0; i < tdma->chip_data->nr_channels; i++) {
+		tdc = &tdma->channels[i];
+		if (tdc->dma_chan.client_count)
+			continue;
+
+		raw_spin_lock_irqsave(&tdc->lock, flags);
+		bytes = tdc->stat_bytes;
+		if (tdc->last_slave_id == slave_id)
+			bytes = 0;
+		raw_spin_unlock_irqrestore(&tdc->lock, flags);
+
+		if (bytes < best_bytes) {
+			best = tdc;
+			best_bytes = bytes;
+		}
+	}
+
+	return best ? &best->dma_chan : NULL;
+}
+
 static struct dma_chan *tegra_dma_of_xlate(struct of_phandle_args *dma_spec,
 					   struct of_dma *ofdma)
 {
 	struct tegra_dma *tdma = ofdma->of_dma_data;
-	struct dma_chan *chan;
+	struct dma_chan *chan = NULL;
 	struct tegra_dma_channel *tdc;
+	unsigned long flags;
+	int retries;
 
-	chan = dma_get_any_slave_channel(&tdma->dma_dev);
+	/* The pick is unlocked, retry if someone else got the channel first */
+	for (retries = 0; balance_chans && !chan && retries < 4; retries++) {
+		chan = tegra_dma_pick_channel(tdma, dma_spec->args[0]);
+		if (!chan)
+			return NULL;
+		chan = dma_get_slave_channel(chan);
+	}
+	if (!chan)
+		chan = dma_get_any_slave_channel(&tdma->dma_dev);
 	if (!chan)
 		return NULL;
 
 	tdc = to_tegra_dma_chan(chan);
 	tdc->slave_id = dma_spec->args[0];
+	raw_spin_lock_irqsave(&tdc->lock, flags);
+	tdc->stat_allocs++;
+	raw_spin_unlock_irqrestore(&tdc->lock, flags);
 
 	return chan;
 }
@@ -1709,6 +1996,227 @@ static const struct of_device_id tegra_dma_of_match[] = {
 };
 MODULE_DEVICE_TABLE(of, tegra_dma_of_match);
 
+#ifdef CONFIG_DEBUG_FS
+static bool tegra_dma_bench_filter(struct dma_chan *chan, void *param)
+{
+	return chan->device == param;
+}
+
+static void tegra_dma_bench_done(void *param)
+{
+	complete(param);
+}
+
+/* Time TEGRA_GPCDMA_BENCH_LOOPS copies, or fills if !@src, on @chan */
+static s64 tegra_dma_bench_run(struct dma_chan *chan, dma_addr_t dst,
+			       dma_addr_t src)
+{
+	struct dma_async_tx_descriptor *tx;
+	struct completion done;
+	unsigned long flags = DMA_PREP_INTERRUPT | DMA_CTRL_ACK;
+	ktime_t start;
+	int i;
+
+	init_completion(&done);
+	start = ktime_get();
+	for (i = 0; i < TEGRA_GPCDMA_BENCH_LOOPS; i++) {
+		if (src)
+			tx = tegra_dma_prep_dma_memcpy(chan, dst, src,
+					TEGRA_GPCDMA_BENCH_SIZE, flags);
+		else
+			tx = tegra_dma_prep_dma_memset(chan, dst, 0,
+					TEGRA_GPCDMA_BENCH_SIZE, flags);
+		if (!tx)
+			return -ENOMEM;
+
+		tx->callback = tegra_dma_bench_done;
+		tx->callback_param = &done;
+		dmaengine_submit(tx);
+		dma_async_issue_pending(chan);
+
+		if (!wait_for_completion_timeout(&done,
+						 msecs_to_jiffies(1000))) {
+			dmaengine_terminate_all(chan);
+			return -ETIMEDOUT;
+		}
+		reinit_completion(&done);
+	}
+
+	return ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static void tegra_dma_bench_print(struct seq_file *s, const char *name,
+				  s64 ns)
+{
+	u64 rate;
+
+	if (ns <= 0) {
+		seq_printf(s, "%-12s failed: %lld\n", name, ns);
+		return;
+	}
+
+	/* bytes per ns is GB/s, keep two decimals */
+	rate = div64_u64((u64)TEGRA_GPCDMA_BENCH_SIZE *
+			 TEGRA_GPCDMA_BENCH_LOOPS * 100, ns);
+	seq_printf(s, "%-12s %llu.%02llu GB/s\n", name, rate / 100,
+		   rate % 100);
+}
+
+/*
+ * Compare memcpy/memset on a free channel against the CPU doing the same
+ * on the same (cached) buffers.
+ */
+static int tegra_dma_bench_show(struct seq_file *s, void *data)
+{
+	struct tegra_dma *tdma = s->private;
+	unsigned int order = get_order(TEGRA_GPCDMA_BENCH_SIZE);
+	struct page *src_page, *dst_page;
+	dma_addr_t src_dma, dst_dma;
+	struct dma_chan *chan;
+	dma_cap_mask_t mask;
+	void *src, *dst;
+	ktime_t start;
+	s64 ns;
+	int i, ret = 0;
+
+	src_page = alloc_pages(GFP_KERNEL, order);
+	dst_page = alloc_pages(GFP_KERNEL, order);
+	if (!src_page || !dst_page) {
+		ret = -ENOMEM;
+		goto free_pages;
+	}
+	src = page_address(src_page);
+	dst = page_address(dst_page);
+	memset(src, 0xa5, TEGRA_GPCDMA_BENCH_SIZE);
+
+	start = ktime_get();
+	for (i = 0; i < TEGRA_GPCDMA_BENCH_LOOPS; i++)
+		memcpy(dst, src, TEGRA_GPCDMA_BENCH_SIZE);
+	tegra_dma_bench_print(s, "cpu memcpy",
+			      ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+	start = ktime_get();
+	for (i = 0; i < TEGRA_GPCDMA_BENCH_LOOPS; i++)
+		memset(dst, 0, TEGRA_GPCDMA_BENCH_SIZE);
+	tegra_dma_bench_print(s, "cpu memset",
+			      ktime_to_ns(ktime_sub(ktime_get(), start)));
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_MEMCPY, mask);
+	chan = dma_request_channel(mask, tegra_dma_bench_filter,
+				   &tdma->dma_dev);
+	if (!chan) {
+		seq_puts(s, "no free channel\n");
+		goto free_pages;
+	}
+
+	src_dma = dma_map_page(tdma->dev, src_page, 0,
+			       TEGRA_GPCDMA_BENCH_SIZE, DMA_TO_DEVICE);
+	dst_dma = dma_map_page(tdma->dev, dst_page, 0,
+			       TEGRA_GPCDMA_BENCH_SIZE, DMA_FROM_DEVICE);
+	if (dma_mapping_error(tdma->dev, src_dma) ||
+	    dma_mapping_error(tdma->dev, dst_dma)) {
+		ret = -ENOMEM;
+		goto unmap;
+	}
+
+	ns = tegra_dma_bench_run(chan, dst_dma, src_dma);
+	tegra_dma_bench_print(s, "dma memcpy", ns);
+	dma_sync_single_for_cpu(tdma->dev, dst_dma, TEGRA_GPCDMA_BENCH_SIZE,
+				DMA_FROM_DEVICE);
+	if (ns > 0 && memcmp(dst, src, TEGRA_GPCDMA_BENCH_SIZE))
+		seq_puts(s, "dma memcpy   data mismatch\n");
+
+	ns = tegra_dma_bench_run(chan, dst_dma, 0);
+	tegra_dma_bench_print(s, "dma memset", ns);
+
+unmap:
+	if (!dma_mapping_error(tdma->dev, dst_dma))
+		dma_unmap_page(tdma->dev, dst_dma, TEGRA_GPCDMA_BENCH_SIZE,
+			       DMA_FROM_DEVICE);
+	if (!dma_mapping_error(tdma->dev, src_dma))
+		dma_unmap_page(tdma->dev, src_dma, TEGRA_GPCDMA_BENCH_SIZE,
+			       DMA_TO_DEVICE);
+	dma_release_channel(chan);
+free_pages:
+	if (dst_page)
+		__free_pages(dst_page, order);
+	if (src_page)
+		__free_pages(src_page, order);
+
+	return ret;
+}
+
+static int tegra_dma_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_dma_bench_show, inode->i_private);
+}
+
+static const struct file_operations tegra_dma_bench_fops = {
+	.open		= tegra_dma_bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int tegra_dma_stats_show(struct seq_file *s, void *data)
+{
+	struct tegra_dma *tdma = s->private;
+	struct tegra_dma_channel *tdc;
+	u64 bytes, xfers, allocs;
+	unsigned long flags;
+	int i, slave_id;
+	bool busy;
+
+	seq_puts(s, "chan  users  req  busy          xfers            bytes  allocs\n");
+	for (i = 0; i < tdma->chip_data->nr_channels; i++) {
+		tdc = &tdma->channels[i];
+
+		raw_spin_lock_irqsave(&tdc->lock, flags);
+		bytes = tdc->stat_bytes;
+		xfers = tdc->stat_xfers;
+		allocs = tdc->stat_allocs;
+		slave_id = tdc->slave_id;
+		busy = tdc->busy;
+		raw_spin_unlock_irqrestore(&tdc->lock, flags);
+
+		seq_printf(s, "%4d  %5d  %3d  %4d  %13llu  %15llu  %6llu\n",
+			   tdc->id, tdc->dma_chan.client_count, slave_id, busy,
+			   xfers, bytes, allocs);
+	}
+
+	return 0;
+}
+
+static int tegra_dma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_dma_stats_show, inode->i_private);
+}
+
+static const struct file_operations tegra_dma_stats_fops = {
+	.open		= tegra_dma_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_dma_debugfs_init(struct tegra_dma *tdma)
+{
+	tdma->debugfs = debugfs_create_dir(dev_name(tdma->dev), NULL);
+	if (IS_ERR_OR_NULL(tdma->debugfs))
+		return;
+
+	debugfs_create_file("selftest", S_IRUSR, tdma->debugfs, tdma,
+			    &tegra_dma_bench_fops);
+	debugfs_create_file("channels", S_IRUGO, tdma->debugfs, tdma,
+			    &tegra_dma_stats_fops);
+}
+#else
+static inline void tegra_dma_debugfs_init(struct tegra_dma *tdma)
+{
+}
+#endif
+
 static int tegra_dma_program_sid(struct tegra_dma_channel *tdc, int chan, int stream_id)
 {
 	unsigned int reg_val =  tdc_read(tdc, TEGRA_GPCDMA_CHAN_MCSEQ);
@@ -1733,7 +2241,8 @@ static int tegra_dma_probe(struct platform_device *pdev)
 	struct tegra_dma_chip_data *chip_data = NULL;
 	int start_chan_idx = 0;
 	int nr_chans, stream_id;
-	int preallocated_desc = 0, preallocated_sg = 0;
+	int preallocated_desc = TEGRA_GPCDMA_DEFAULT_PREALLOC_DESCS;
+	int preallocated_sg = TEGRA_GPCDMA_DEFAULT_PREALLOC_SG;
 
 	if (pdev->dev.of_node) {
 		const struct of_device_id *match;
@@ -1779,7 +2288,7 @@ static int tegra_dma_probe(struct platform_device *pdev)
 		}
 
 		/*
-		 * if these properties are unreadable, leave them zeroes
+		 * if these properties are unreadable, keep the defaults;
 		 * zeroes imply:
 		 * - NO preallocated sg requests
 		 * - NO preallocated descriptors
@@ -1803,6 +2312,9 @@ static int tegra_dma_probe(struct platform_device *pdev)
 
 	tdma->dev = &pdev->dev;
 	tdma->chip_data = cdata;
+	/* Run completion callbacks from an irq thread instead of a tasklet */
+	tdma->threaded_irq = of_property_read_bool(pdev->dev.of_node,
+						   "nvidia,threaded-irq");
 	platform_set_drvdata(pdev, tdma);
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
@@ -1851,6 +2363,7 @@ static int tegra_dma_probe(struct platform_device *pdev)
 		tdc->tdma = tdma;
 		tdc->id = i;
 		tdc->slave_id = -1;
+		tdc->last_slave_id = -1;
 
 		raw_spin_lock_init(&tdc->lock);
 		tasklet_init(&tdc->tasklet, tegra_dma_tasklet,
@@ -1881,6 +2394,7 @@ static int tegra_dma_probe(struct platform_device *pdev)
 	dma_cap_set(DMA_CYCLIC, tdma->dma_dev.cap_mask);
 	dma_cap_set(DMA_MEMCPY, tdma->dma_dev.cap_mask);
 	dma_cap_set(DMA_MEMSET, tdma->dma_dev.cap_mask);
+	dma_cap_set(DMA_INTERLEAVE, tdma->dma_dev.cap_mask);
 
 	/*
 	 * Only word aligned transfers are supported. Set the copy
@@ -1896,6 +2410,8 @@ static int tegra_dma_probe(struct platform_device *pdev)
 	tdma->dma_dev.device_prep_dma_cyclic = tegra_dma_prep_dma_cyclic;
 	tdma->dma_dev.device_prep_dma_memcpy = tegra_dma_prep_dma_memcpy;
 	tdma->dma_dev.device_prep_dma_memset = tegra_dma_prep_dma_memset;
+	tdma->dma_dev.device_prep_interleaved_dma =
+					tegra_dma_prep_interleaved_dma;
 	tdma->dma_dev.device_config = tegra_dma_slave_config;
 	tdma->dma_dev.device_terminate_all = tegra_dma_terminate_all;
 	tdma->dma_dev.device_tx_status = tegra_dma_tx_status;
@@ -1905,8 +2421,9 @@ static int tegra_dma_probe(struct platform_device *pdev)
 	for (i = 0; i < cdata->nr_channels; i++) {
 		struct tegra_dma_channel *tdc = &tdma->channels[i];
 
-		ret = devm_request_irq(&pdev->dev, tdc->irq,
-				tegra_dma_isr, 0, tdc->name, tdc);
+		ret = devm_request_threaded_irq(&pdev->dev, tdc->irq,
+				tegra_dma_isr, tdma->threaded_irq ?
+				tegra_dma_isr_thread : NULL, 0, tdc->name, tdc);
 		if (ret) {
 			dev_err(&pdev->dev,
 				"request_irq failed with err %d channel %d\n",
@@ -1930,6 +2447,8 @@ static int tegra_dma_probe(struct platform_device *pdev)
 		goto err_unregister_dma_dev;
 	}
 
+	tegra_dma_debugfs_init(tdma);
+
 	dev_info(&pdev->dev, "GPC DMA driver register %d channels\n",
 			cdata->nr_channels);
 	return 0;
@@ -1951,6 +2470,7 @@ static int tegra_dma_remove(struct platform_device *pdev)
 	int i;
 	struct tegra_dma_channel *tdc;
 
+	debugfs_remove_recursive(tdma->debugfs);
 	dma_async_device_unregister(&tdma->dma_dev);
 
 	for (i = 0; i < tdma->chip_data->nr_channels; ++i) {
@@ -27,6 +27,8 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/pm.h>
 #include <linux/irqchip/tegra.h>
+#include <linux/tegra-gpio.h>
+#include <asm/arch_timer.h>
 #include <dt-bindings/gpio/tegra186-gpio.h>
 #include <dt-bindings/gpio/tegra194-gpio.h>
 #include <linux/version.h>
@@ -668,6 +670,8 @@ struct tegra_gpio_info {
 	struct gpio_chip gc;
 	struct irq_chip ic;
 	struct tegra_gpio_saved_register *gpio_rval;
+	/* TSC of the last interrupt taken for each GPIO */
+	u64 *irq_tsc;
 };
 
 static struct lock_class_key gpio_lock_class;
@@ -802,6 +806,43 @@ static int tegra_gpio_get(struct gpio_chip *chip, unsigned offset)
 	return tegra_gpio_readl(tgi, offset, GPIO_INPUT_REG) & 0x1;
 }
 
+/*
+ * Every pin has its own register set, so there is nothing to merge per
+ * port. Instead, write all new levels back to back before touching the
+ * output control, which keeps the skew between the lines to a few bus
+ * writes instead of a full gpiolib round trip per line.
+ */
+static void tegra_gpio_set_multiple(struct gpio_chip *chip,
+				    unsigned long *mask, unsigned long *bits)
+{
+	struct tegra_gpio_info *tgi = gpiochip_get_data(chip);
+	unsigned int gpio;
+
+	for_each_set_bit(gpio, mask, chip->ngpio)
+		tegra_gpio_writel(tgi, test_bit(gpio, bits) ? 0x1 : 0x0,
+				  gpio, GPIO_OUT_VAL_REG);
+
+	for_each_set_bit(gpio, mask, chip->ngpio)
+		tegra_gpio_writel(tgi, 0, gpio, GPIO_OUT_CTRL_REG);
+}
+
+#if KERNEL_VERSION(4, 13, 0) < LINUX_VERSION_CODE
+static int tegra_gpio_get_multiple(struct gpio_chip *chip,
+				   unsigned long *mask, unsigned long *bits)
+{
+	unsigned int gpio;
+
+	for_each_set_bit(gpio, mask, chip->ngpio) {
+		if (tegra_gpio_get(chip, gpio))
+			__set_bit(gpio, bits);
+		else
+			__clear_bit(gpio, bits);
+	}
+
+	return 0;
+}
+#endif
+
 static void set_gpio_direction_mode(struct gpio_chip *chip, u32 offset,
 				    bool mode)
 {
@@ -1059,6 +1100,21 @@ static int tegra_gpio_irq_set_wake(struct irq_data *d, unsigned int enable)
 	return ret;
 }
 
+int tegra_gpio_get_irq_tsc(unsigned int irq, u64 *tsc)
+{
+	struct irq_data *d = irq_get_irq_data(irq);
+	struct tegra_gpio_controller *c;
+
+	if (!d || !d->chip || d->chip->irq_ack != tegra_gpio_irq_ack)
+		return -EINVAL;
+
+	c = irq_data_get_irq_chip_data(d);
+	*tsc = READ_ONCE(c->tgi->irq_tsc[d->hwirq]);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(tegra_gpio_get_irq_tsc);
+
 static void tegra_gpio_irq_handler_desc(struct irq_desc *desc)
 {
 	struct irq_chip *chip = irq_desc_get_chip(desc);
@@ -1070,6 +1126,7 @@ static void tegra_gpio_irq_handler_desc(struct irq_desc *desc)
 	int i;
 	unsigned long val;
 	u32 addr;
+	u64 tsc = 0;
 	int port_map[MAX_GPIO_PORTS];
 	unsigned int irq_offset, irq_index;
 
@@ -1114,9 +1171,13 @@ single_line_irq:
 		addr = tgi->soc->port[port].reg_offset;
 		val = __raw_readl(tg_cont->tgi->gpio_regs + addr +
 				GPIO_INT_STATUS_OFFSET + GPIO_STATUS_G1);
-		for_each_set_bit(pin, &val, 8)
+		if (val)
+			tsc = arch_counter_get_cntvct();
+		for_each_set_bit(pin, &val, 8) {
+			WRITE_ONCE(tgi->irq_tsc[port * 8 + pin], tsc);
 			generic_handle_irq(tegra_gpio_to_irq(&tgi->gc,
 						   port * 8 + pin));
+		}
 	}
 
 done:
@@ -1290,6 +1351,11 @@ static int tegra_gpio_probe(struct platform_device *pdev)
 	if (!tgi->gpio_rval)
 		return -ENOMEM;
 
+	tgi->irq_tsc = devm_kcalloc(&pdev->dev, tgi->soc->nports * 8,
+				    sizeof(*tgi->irq_tsc), GFP_KERNEL);
+	if (!tgi->irq_tsc)
+		return -ENOMEM;
+
 	tgi->gc.label			= tgi->soc->name;
 	tgi->gc.request			= tegra_gpio_request;
 	tgi->gc.free			= tegra_gpio_free;
@@ -1297,6 +1363,10 @@ static int tegra_gpio_probe(struct platform_device *pdev)
 	tgi->gc.get			= tegra_gpio_get;
 	tgi->gc.direction_output	= tegra_gpio_direction_output;
 	tgi->gc.set			= tegra_gpio_set;
+	tgi->gc.set_multiple		= tegra_gpio_set_multiple;
+#if KERNEL_VERSION(4, 13, 0) < LINUX_VERSION_CODE
+	tgi->gc.get_multiple		= tegra_gpio_get_multiple;
+#endif
 	tgi->gc.get_direction		= tegra_gpio_get_direction;
 	tgi->gc.suspend_configure	= tegra_gpio_suspend_configure;
 	tgi->gc.is_enabled		= tegra_gpio_is_enabled;
@@ -18,6 +18,7 @@
 #include <linux/list.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/wait.h>
 
 #include "soc/tegra/tegra-ivc-rpc.h"
 #include "soc/tegra/tegra-i2c-rtcpu.h"
@@ -54,6 +55,7 @@ struct tegra_i2c_ivc_multi_dev {
 		unsigned int reads, read_bytes;
 		unsigned int writes, write_bytes;
 		unsigned int errors;
+		unsigned int pipelined;
 	} stat;
 };
 
@@ -81,6 +83,11 @@ struct tegra_i2c_rtcpu_sensor {
 	bool in_agg; /* in the middle of aggregation */
 	unsigned int last_addr; /* is_valid if in_agg. last register address */
 	int frame_id; /* is_valid if in_agg. frame ID */
+	/* Table writes send full requests without waiting for the response */
+	bool in_table;
+	atomic_t pending; /* requests sent but not yet completed */
+	int pending_err; /* first error reported by a pending request */
+	wait_queue_head_t pending_wq;
 	/* RPC call for I2C_REQUEST_MULTI */
 	unsigned int req_len;
 	u8 *req_cur, *req_last_len;
@@ -110,6 +117,9 @@ struct tegra_i2c_rtcpu_sensor *tegra_i2c_rtcpu_register_sensor(
 	if (sensor == NULL)
 		return NULL;
 
+	atomic_set(&sensor->pending, 0);
+	init_waitqueue_head(&sensor->pending_wq);
+
 	if (config->reg_bytes <= 0 || config->reg_bytes > 2)
 		return NULL;
 
@@ -224,6 +234,53 @@ EXPORT_SYMBOL(tegra_i2c_rtcpu_register_sensor);
  * I2C transfer
  */
 
+/* Software interrupt context */
+static void tegra_i2c_ivc_multi_xfer_done(int ret,
+	const struct tegra_ivc_rpc_response_frame *rsp, void *param)
+{
+	struct tegra_i2c_rtcpu_sensor *sensor = param;
+
+	if (ret < 0) {
+		++sensor->i2c_ivc_dev->stat.errors;
+		cmpxchg(&sensor->pending_err, 0, ret);
+	}
+
+	if (atomic_dec_and_test(&sensor->pending))
+		wake_up(&sensor->pending_wq);
+}
+
+/*
+ * Wait for the pipelined requests of a table write. They are executed in
+ * order, so this normally returns right after the last synchronous
+ * request has completed.
+ */
+static int tegra_i2c_ivc_multi_wait_pending(
+	struct tegra_i2c_rtcpu_sensor *sensor)
+{
+	long timeout;
+	int ret;
+
+	timeout = wait_event_timeout(sensor->pending_wq,
+		atomic_read(&sensor->pending) == 0,
+		msecs_to_jiffies(I2C_CAMRTC_RPC_IVC_MULTI_TIMEOUT_MS));
+	if (timeout == 0) {
+		dev_err(&sensor->i2c_ivc_dev->chan->dev,
+			"pipelined I2C requests to sensor %u timed out\n",
+			sensor->sensor_id);
+		return -ETIMEDOUT;
+	}
+
+	ret = xchg(&sensor->pending_err, 0);
+	if (ret < 0) {
+		dev_err(&sensor->i2c_ivc_dev->chan->dev,
+			"pipelined I2C transaction to sensor %u failed: %d\n",
+			sensor->sensor_id, ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
 static int tegra_i2c_ivc_multi_xfer(
 	struct tegra_i2c_rtcpu_sensor *sensor)
 {
@@ -281,6 +338,70 @@ exit:
 	return ret;
 }
 
+/*
+ * Send the aggregated request without waiting for its response. The
+ * request is copied into the IVC frame, so the buffer can be refilled
+ * right away.
+ */
+static int tegra_i2c_ivc_multi_xfer_async(
+	struct tegra_i2c_rtcpu_sensor *sensor)
+{
+	struct tegra_ivc_rpc_call_param param;
+	int ret;
+
+	if (sensor->req_len == CAMRTC_I2C_MULTI_HEADER_SIZE)
+		return 0;
+
+	if (!sensor->is_registered)
+		return tegra_i2c_ivc_multi_xfer(sensor);
+
+	sensor->rpc_i2c_req_buf[1] = (sensor->frame_id > 0) ?
+		CAMRTC_I2C_REQUEST_MULTI_FLAG_FRAMEID : 0;
+	sensor->rpc_i2c_req_buf[2] = (sensor->frame_id >> 0) & 0xff;
+	sensor->rpc_i2c_req_buf[3] = (sensor->frame_id >> 8) & 0xff;
+
+	param = sensor->rpc_i2c_req;
+	param.request_len = sensor->req_len;
+	param.response_len = 0;
+	param.response = NULL;
+	param.callback = tegra_i2c_ivc_multi_xfer_done;
+	param.callback_param = sensor;
+
+	atomic_inc(&sensor->pending);
+	ret = tegra_ivc_rpc_call(sensor->i2c_ivc_dev->chan, &param);
+	if (ret < 0)
+		atomic_dec(&sensor->pending);
+	else
+		++sensor->i2c_ivc_dev->stat.pipelined;
+
+	/* reset request buffer pointers */
+	sensor->last_addr = (unsigned int) -1;
+	sensor->req_len = CAMRTC_I2C_MULTI_HEADER_SIZE;
+	sensor->req_cur = sensor->rpc_i2c_req_buf +
+		CAMRTC_I2C_MULTI_HEADER_SIZE;
+	sensor->req_last_len = NULL;
+
+	if (ret < 0) {
+		++sensor->i2c_ivc_dev->stat.errors;
+		dev_err(&sensor->i2c_ivc_dev->chan->dev,
+			"I2C transaction to sensor %u failed: %d\n",
+			sensor->sensor_id, ret);
+		return -EIO;
+	}
+
+	return 0;
+}
+
+/* Make room in the request buffer */
+static int tegra_i2c_ivc_multi_flush(
+	struct tegra_i2c_rtcpu_sensor *sensor)
+{
+	if (sensor->in_table)
+		return tegra_i2c_ivc_multi_xfer_async(sensor);
+
+	return tegra_i2c_ivc_multi_xfer(sensor);
+}
+
 /*
  * I2C APIs
  */
@@ -380,7 +501,7 @@ int tegra_i2c_rtcpu_write_reg8(
 
 	/* If there is no room, flush current transfer */
 	if (sensor->req_len + this_len > CAMRTC_I2C_REQUEST_MAX_LEN) {
-		ret = tegra_i2c_ivc_multi_xfer(sensor);
+		ret = tegra_i2c_ivc_multi_flush(sensor);
 		if (ret != 0)
 			return ret;
 	}
@@ -441,7 +562,15 @@ int tegra_i2c_rtcpu_write_table_8(
 	int num_override_regs, u16 wait_ms_addr, u16 end_addr)
 {
 	const struct reg_8 *next;
-	int i;
+	int i, ret = 0, err;
+
+	/*
+	 * Requests filled up in the middle of the table go out without
+	 * waiting for their response, only the last one before a delay or
+	 * the end of the table is waited for.
+	 */
+	tegra_ivc_channel_runtime_get(sensor->i2c_ivc_dev->chan);
+	sensor->in_table = true;
 
 	tegra_i2c_rtcpu_aggregate(sensor, true);
 
@@ -451,7 +580,12 @@ int tegra_i2c_rtcpu_write_table_8(
 		if (next->addr == end_addr)
 			break;
 		if (next->addr == wait_ms_addr) {
-			tegra_i2c_rtcpu_aggregate(sensor, false);
+			ret = tegra_i2c_rtcpu_aggregate(sensor, false);
+			err = tegra_i2c_ivc_multi_wait_pending(sensor);
+			if (ret == 0)
+				ret = err;
+			if (ret != 0)
+				goto exit;
 			msleep_range(next->val);
 			tegra_i2c_rtcpu_aggregate(sensor, true);
 			continue;
@@ -468,11 +602,24 @@ int tegra_i2c_rtcpu_write_table_8(
 			}
 		}
 
-		tegra_i2c_rtcpu_write_reg8(sensor,
+		ret = tegra_i2c_rtcpu_write_reg8(sensor,
 			next->addr, &val, 1);
+		if (ret != 0)
+			break;
 	}
 
-	return tegra_i2c_rtcpu_aggregate(sensor, false);
+	err = tegra_i2c_rtcpu_aggregate(sensor, false);
+	if (ret == 0)
+		ret = err;
+	err = tegra_i2c_ivc_multi_wait_pending(sensor);
+	if (ret == 0)
+		ret = err;
+
+exit:
+	sensor->in_table = false;
+	tegra_ivc_channel_runtime_put(sensor->i2c_ivc_dev->chan);
+
+	return ret;
 }
 EXPORT_SYMBOL(tegra_i2c_rtcpu_write_table_8);
 
@@ -506,6 +653,8 @@ static int tegra_i2c_ivc_multi_stat_show(
 	seq_printf(file, "Write requests: %u\n", i2c_ivc_dev->stat.writes);
 	seq_printf(file, "Write bytes: %u\n", i2c_ivc_dev->stat.write_bytes);
 	seq_printf(file, "Errors: %u\n", i2c_ivc_dev->stat.errors);
+	seq_printf(file, "Pipelined requests: %u\n",
+		i2c_ivc_dev->stat.pipelined);
 
 	return 0;
 }
@@ -265,6 +265,7 @@ struct tegra_i2c_hw_feature {
  * @msg_buf: pointer to current message data
  * @msg_buf_remaining: size of unsent data in the message buffer
  * @msg_read: identifies read transfers
+ * @is_batch_xfer: several messages are in flight as one packet stream
  * @bus_clk_rate: current i2c bus clock rate
  * @is_suspended: prevents i2c controller accesses after suspend is called
  */
@@ -315,6 +316,7 @@ struct tegra_i2c_dev {
 	dma_addr_t tx_dma_phys;
 	unsigned dma_buf_size;
 	bool is_curr_dma_xfer;
+	bool is_batch_xfer;
 	struct completion rx_dma_complete;
 	struct completion tx_dma_complete;
 	int curr_direction;
@@ -1206,10 +1208,12 @@ err:
 		dvc_writel(i2c_dev, DVC_STATUS_I2C_DONE_INTR, DVC_STATUS);
 
 	if (i2c_dev->is_curr_dma_xfer) {
-		if (i2c_dev->curr_direction == DATA_DMA_DIR_TX) {
+		if (i2c_dev->curr_direction == DATA_DMA_DIR_TX ||
+		    i2c_dev->is_batch_xfer) {
 			dmaengine_terminate_all(i2c_dev->tx_dma_chan);
 			complete(&i2c_dev->tx_dma_complete);
-		} else {
+		}
+		if (i2c_dev->curr_direction == DATA_DMA_DIR_RX) {
 			dmaengine_terminate_all(i2c_dev->rx_dma_chan);
 			complete(&i2c_dev->rx_dma_complete);
 		}
@@ -1478,6 +1482,7 @@ static void tegra_i2c_pre_xfer_config(struct tegra_i2c_dev *i2c_dev,
 	tegra_i2c_flush_fifos(i2c_dev);
 
 	i2c_dev->is_curr_dma_xfer = false;
+	i2c_dev->is_batch_xfer = false;
 	i2c_dev->msg_buf = msg->buf;
 	i2c_dev->msg_buf_remaining = msg->len;
 	i2c_dev->msg_err = I2C_ERR_NONE;
@@ -1558,6 +1563,23 @@ static void tegra_i2c_reg_dump(struct tegra_i2c_dev *i2c_dev,
 			i2c_dev->msg_buf_remaining);
 }
 
+static int tegra_i2c_request_dma(struct tegra_i2c_dev *i2c_dev)
+{
+	int ret;
+
+	if (i2c_dev->tx_dma_chan && i2c_dev->rx_dma_chan)
+		return 0;
+
+	ret = tegra_i2c_init_dma_param(i2c_dev, true);
+	if (ret && (ret != -EPROBE_DEFER) && (ret != -ENODEV))
+		return ret;
+	ret = tegra_i2c_init_dma_param(i2c_dev, false);
+	if (ret && (ret != -EPROBE_DEFER) && (ret != -ENODEV))
+		return ret;
+
+	return 0;
+}
+
 static int tegra_i2c_xfer_msg(struct tegra_i2c_dev *i2c_dev,
 	struct i2c_msg *msg, enum msg_end_type end_state)
 {
@@ -1568,13 +1590,9 @@ static int tegra_i2c_xfer_msg(struct tegra_i2c_dev *i2c_dev,
 	if (msg->len == 0)
 		return -EINVAL;
 
-	if (i2c_dev->enable_dma_mode && (msg->len > I2C_PIO_MODE_MAX_LEN)
-			&& !(i2c_dev->tx_dma_chan && i2c_dev->rx_dma_chan)) {
-		ret = tegra_i2c_init_dma_param(i2c_dev, true);
-		if (ret && (ret != -EPROBE_DEFER) && (ret != -ENODEV))
-			return ret;
-		ret = tegra_i2c_init_dma_param(i2c_dev, false);
-		if (ret && (ret != -EPROBE_DEFER) && (ret != -ENODEV))
+	if (i2c_dev->enable_dma_mode && (msg->len > I2C_PIO_MODE_MAX_LEN)) {
+		ret = tegra_i2c_request_dma(i2c_dev);
+		if (ret)
 			return ret;
 	}
 
@@ -1682,11 +1700,171 @@ static int tegra_i2c_split_i2c_msg_xfer(struct tegra_i2c_dev *i2c_dev,
 	return ret;
 }
 
+static enum msg_end_type tegra_i2c_msg_end_type(struct i2c_msg msgs[],
+	int i, int num)
+{
+	if (i == num - 1)
+		return MSG_END_STOP;
+	if (msgs[i + 1].flags & I2C_M_NOSTART)
+		return MSG_END_CONTINUE;
+	return MSG_END_REPEAT_START;
+}
+
+/*
+ * A run of writes, optionally ended by one read, such as a register table
+ * or an EEPROM address write + data read, can go out as a single packet
+ * stream: one TX DMA carrying every packet, with only the last packet
+ * requesting the completion interrupt.
+ */
+static int tegra_i2c_batch_tx_len(struct tegra_i2c_dev *i2c_dev,
+	struct i2c_msg msgs[], int num)
+{
+	int i, words = 0;
+
+	if (num < 2 || !i2c_dev->enable_dma_mode ||
+	    !i2c_dev->hw->has_per_pkt_xfer_complete_irq)
+		return 0;
+
+	for (i = 0; i < num; i++) {
+		if (!msgs[i].len || msgs[i].len > I2C_MAX_TRANSFER_LEN)
+			return 0;
+		words += I2C_PACKET_HEADER_SIZE;
+		if (!(msgs[i].flags & I2C_M_RD))
+			words += DIV_ROUND_UP(msgs[i].len, 4);
+		else if (i != num - 1)
+			return 0;
+	}
+
+	if (words * 4 > i2c_dev->dma_buf_size)
+		return 0;
+
+	return words * 4;
+}
+
+static int tegra_i2c_xfer_batch(struct tegra_i2c_dev *i2c_dev,
+	struct i2c_msg msgs[], int num, int tx_len)
+{
+	struct i2c_msg *last = &msgs[num - 1];
+	u32 *tx_buf = i2c_dev->tx_dma_buf;
+	u32 packet_header[3];
+	u32 rx_len = 0, int_mask;
+	unsigned long time_left, flags;
+	int i, ret;
+
+	tegra_i2c_pre_xfer_config(i2c_dev, last);
+	i2c_dev->msg_buf_remaining = 0;
+	i2c_dev->msg_add = last->addr;
+	i2c_dev->is_curr_dma_xfer = true;
+	i2c_dev->is_batch_xfer = true;
+
+	dma_sync_single_for_cpu(i2c_dev->dev, i2c_dev->tx_dma_phys,
+			i2c_dev->dma_buf_size, DMA_TO_DEVICE);
+	for (i = 0; i < num; i++) {
+		tegra_i2c_fill_packet_header(i2c_dev, &msgs[i],
+			tegra_i2c_msg_end_type(msgs, i, num), packet_header);
+		if (i != num - 1)
+			packet_header[2] &= ~I2C_HEADER_IE_ENABLE;
+		memcpy(tx_buf, packet_header, sizeof(packet_header));
+		tx_buf += I2C_PACKET_HEADER_SIZE;
+		if (!(msgs[i].flags & I2C_M_RD)) {
+			memcpy(tx_buf, msgs[i].buf, msgs[i].len);
+			tx_buf += DIV_ROUND_UP(msgs[i].len, 4);
+		}
+	}
+	dma_sync_single_for_device(i2c_dev->dev, i2c_dev->tx_dma_phys,
+			i2c_dev->dma_buf_size, DMA_TO_DEVICE);
+
+	if (last->flags & I2C_M_RD)
+		rx_len = DIV_ROUND_UP(last->len, 4) * 4;
+
+	/* one trigger level that suits both directions */
+	i2c_dev->curr_direction = DATA_DMA_DIR_TX;
+	tegra_i2c_config_fifo_trig(i2c_dev, tx_len | rx_len);
+	if (rx_len) {
+		i2c_dev->curr_direction = DATA_DMA_DIR_RX;
+		tegra_i2c_config_fifo_trig(i2c_dev, tx_len | rx_len);
+		ret = tegra_i2c_start_rx_dma(i2c_dev, rx_len);
+		if (ret < 0) {
+			dev_err(i2c_dev->dev,
+				"Starting rx dma failed, err %d\n", ret);
+			return ret;
+		}
+	}
+
+	int_mask = I2C_INT_NO_ACK | I2C_INT_ARBITRATION_LOST
+		| I2C_INT_TX_FIFO_OVERFLOW;
+	tegra_i2c_unmask_irq(i2c_dev, int_mask);
+
+	spin_lock_irqsave(&i2c_dev->xfer_lock, flags);
+	ret = tegra_i2c_start_tx_dma(i2c_dev, tx_len);
+	if (ret < 0) {
+		spin_unlock_irqrestore(&i2c_dev->xfer_lock, flags);
+		dev_err(i2c_dev->dev, "Starting tx dma failed, err %d\n", ret);
+		if (rx_len)
+			dmaengine_terminate_all(i2c_dev->rx_dma_chan);
+		return ret;
+	}
+	tegra_i2c_unmask_irq(i2c_dev, int_mask | I2C_INT_PACKET_XFER_COMPLETE);
+	spin_unlock_irqrestore(&i2c_dev->xfer_lock, flags);
+
+	time_left = wait_for_completion_timeout(&i2c_dev->tx_dma_complete,
+						TEGRA_I2C_TIMEOUT);
+	if (time_left == 0) {
+		dev_err(i2c_dev->dev, "tx dma timeout\n");
+		dmaengine_terminate_all(i2c_dev->tx_dma_chan);
+		if (rx_len)
+			dmaengine_terminate_all(i2c_dev->rx_dma_chan);
+		goto end_xfer;
+	}
+
+	if (rx_len) {
+		time_left = wait_for_completion_timeout(
+				&i2c_dev->rx_dma_complete, TEGRA_I2C_TIMEOUT);
+		if (time_left == 0) {
+			dev_err(i2c_dev->dev, "rx dma timeout\n");
+			dmaengine_terminate_all(i2c_dev->rx_dma_chan);
+			goto end_xfer;
+		}
+	}
+
+	time_left = wait_for_completion_timeout(&i2c_dev->msg_complete,
+						TEGRA_I2C_TIMEOUT);
+	if (time_left == 0) {
+		tegra_i2c_reg_dump(i2c_dev, last);
+		dmaengine_terminate_all(i2c_dev->tx_dma_chan);
+		if (rx_len)
+			dmaengine_terminate_all(i2c_dev->rx_dma_chan);
+	}
+
+end_xfer:
+	int_mask = i2c_readl(i2c_dev, I2C_INT_MASK);
+	tegra_i2c_mask_irq(i2c_dev, int_mask);
+	i2c_dev->is_batch_xfer = false;
+
+	if (time_left == 0) {
+		dev_err(i2c_dev->dev,
+			"i2c batch of %d timed out, addr 0x%04x\n",
+			num, last->addr);
+
+		ret = tegra_i2c_init(i2c_dev);
+		if (!ret)
+			ret = -ETIMEDOUT;
+		else
+			WARN_ON(1);
+		return ret;
+	}
+
+	if (likely(i2c_dev->msg_err == I2C_ERR_NONE))
+		return 0;
+
+	return tegra_i2c_handle_xfer_error(i2c_dev);
+}
+
 static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 	int num)
 {
 	struct tegra_i2c_dev *i2c_dev = i2c_get_adapdata(adap);
-	int i;
+	int i, tx_len;
 	int ret = 0;
 
 	if (i2c_dev->is_suspended)
@@ -1717,15 +1895,19 @@ static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 			return ret;
 	}
 
+	tx_len = tegra_i2c_batch_tx_len(i2c_dev, msgs, num);
+	if (tx_len && !tegra_i2c_request_dma(i2c_dev) &&
+	    i2c_dev->tx_dma_chan && i2c_dev->rx_dma_chan) {
+		ret = tegra_i2c_xfer_batch(i2c_dev, msgs, num, tx_len);
+		i = num;
+		goto out;
+	}
+
 	for (i = 0; i < num; i++) {
-		enum msg_end_type end_type = MSG_END_STOP;
+		enum msg_end_type end_type;
+
+		end_type = tegra_i2c_msg_end_type(msgs, i, num);
 
-		if (i < (num - 1)) {
-			if (msgs[i + 1].flags & I2C_M_NOSTART)
-				end_type = MSG_END_CONTINUE;
-			else
-				end_type = MSG_END_REPEAT_START;
-		}
 		if (msgs[i].len > I2C_MAX_TRANSFER_LEN)
 			ret = tegra_i2c_split_i2c_msg_xfer(i2c_dev, &msgs[i],
 							   end_type);
@@ -1734,6 +1916,7 @@ static int tegra_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[],
 		if (ret)
 			break;
 	}
+out:
 	tegra_i2c_clock_disable(i2c_dev);
 	tegra_i2c_power_disable(i2c_dev);
 	pm_runtime_put(&adap->dev);
@@ -1404,6 +1404,11 @@ static int nvi_timeout(struct nvi_state *st)
 		}
 	}
 
+	/* without the DMP the batch timeout sets the FIFO watermark */
+	if (disabled)
+		st->fifo_wm_us = 0;
+	else
+		st->fifo_wm_us = timeout_us;
 	disabled = true; /* batch mode is currently disabled */
 	if (disabled)
 		timeout_us = 0; /* batch mode disabled */
@@ -2966,6 +2971,108 @@ static int nvi_fifo_devs(struct nvi_state *st, s64 ts, unsigned int n)
 	return ret;
 }
 
+/* The MPU/ICM FIFO has no watermark interrupt so data ready keeps firing
+ * for every sample.  Samples are left in the FIFO until the batch latency
+ * worth of them is there and then read in a single burst.
+ */
+static bool nvi_fifo_wm(struct nvi_state *st, int src, unsigned int fifo_n)
+{
+	unsigned int wm_n;
+
+	if (!st->fifo_wm_us || st->fifo_wm_dis || !st->src[src].period_us_src)
+		return false;
+
+	wm_n = st->fifo_wm_us / st->src[src].period_us_src;
+	wm_n *= st->src[src].fifo_data_n;
+	if (wm_n > NVI_FIFO_WM_MAX)
+		wm_n = NVI_FIFO_WM_MAX;
+	return fifo_n < wm_n;
+}
+
+static s64 nvi_dmp_ts(struct nvi_state *st, int src, s64 ts_now,
+		      bool sync, unsigned int ts_n, s64 ts_period)
+{
+	s64 ts_end;
+
+	if (st->src[src].ts_reset) {
+		st->src[src].ts_reset = false;
+		ts_end = st->src[src].ts_period * (ts_n - 1);
+		if (sync) {
+			st->src[src].ts_1st = ts_now - ts_end;
+			st->src[src].ts_end = st->src[src].ts_1st;
+		}
+	} else {
+		ts_end = st->src[src].ts_period * ts_n;
+	}
+	ts_end += st->src[src].ts_end;
+	/* ts_now will be sent to nvi_ts_dev where the timestamp is
+	 * prevented from going into the future which allows some
+	 * tolerance here for ts_end being a little more than ts_now.
+	 * The more tolerance we have the less recalculating the period
+	 * to avoid swing around the true period.  Plus, the clamp on
+	 * ts_now in nvi_ts_dev has the benefit of "syncing" with the
+	 * current calculations per device.
+	 */
+	if (ts_end > (ts_now + (ts_period >> 3)) || (sync && (ts_end <
+					       (ts_now - (ts_period >> 1))))) {
+		if (st->sts & (NVI_DBG_SPEW_FIFO | NVI_DBG_SPEW_TS)) {
+			dev_info(&st->i2c->dev,
+				 "sync=%x now=%lld end=%lld ts_n=%u\n",
+				 sync, ts_now, ts_end, ts_n);
+			dev_info(&st->i2c->dev,
+				 "src=%d old period=%lld end=%lld\n",
+				 src, st->src[src].ts_period,
+				 st->src[src].ts_end);
+		}
+		/* st->src[src].ts_period needs to be adjusted */
+		ts_period = ts_now - st->src[src].ts_end;
+		do_div(ts_period, ts_n);
+		st->src[src].ts_period = ts_period;
+		ts_end = ts_period * ts_n;
+		ts_end += st->src[src].ts_end;
+		if (st->sts & (NVI_DBG_SPEW_FIFO | NVI_DBG_SPEW_TS))
+			dev_info(&st->i2c->dev,
+				 "src=%d new period=%lld end=%lld\n",
+				 src, ts_period, ts_end);
+	}
+	return ts_end;
+}
+
+/* FIFO timing is fitted to the IRQ time and sample count of each batch
+ * which tracks the drift of the sensor clock instead of restarting the
+ * period whenever it's out of tolerance.  nvi_ts_dev then spaces each
+ * device's samples in the batch with the fitted ts_period.
+ */
+static s64 nvi_fifo_ts(struct nvi_state *st, int src, s64 ts_now,
+		       bool sync, unsigned int ts_n)
+{
+	struct nvs_ts *fit = &st->src[src].ts_fit;
+	s64 ts_ref = 0;
+
+	if (st->src[src].ts_reset) {
+		st->src[src].ts_reset = false;
+		nvs_ts_reset(fit, st->src[src].ts_period);
+		ts_ref = ts_now;
+		nvs_ts_fit(fit, ts_ref, ts_n);
+		if (sync)
+			st->src[src].ts_1st = nvs_ts_next(fit);
+	} else {
+		if (sync || (fit->end + fit->period * ts_n) > ts_now)
+			/* samples can't be newer than now when the read was
+			 * late, otherwise extrapolate from the fitted period
+			 */
+			ts_ref = ts_now;
+		nvs_ts_fit(fit, ts_ref, ts_n);
+	}
+	st->src[src].ts_period = fit->step;
+	if (st->sts & (NVI_DBG_SPEW_FIFO | NVI_DBG_SPEW_TS))
+		dev_info(&st->i2c->dev,
+			 "src=%d period=%lld step=%lld end=%lld drift=%dppm\n",
+			 src, fit->period, fit->step, fit->end,
+			 nvs_ts_drift_ppm(fit));
+	return fit->end;
+}
+
 /* fifo_n_max can be used if we want to round-robin FIFOs */
 static int nvi_fifo_rd(struct nvi_state *st, int src, unsigned int fifo_n_max,
 		       int (*fn)(struct nvi_state *st, s64 ts, unsigned int n))
@@ -3018,6 +3125,10 @@ static int nvi_fifo_rd(struct nvi_state *st, int src, unsigned int fifo_n_max,
 		if ((fifo_n % st->src[src].fifo_data_n) || !ts_n)
 			/* reset FIFO if doesn't divide cleanly */
 			return -1;
+
+		if (nvi_fifo_wm(st, src, fifo_n))
+			/* below watermark - leave the samples in the FIFO */
+			return 0;
 	}
 
 	if (ts_n) {
@@ -3027,47 +3138,11 @@ static int nvi_fifo_rd(struct nvi_state *st, int src, unsigned int fifo_n_max,
 					  ts_end > (ts_now - (ts_period >> 2)))
 			/* ts_irq is within the rate so sync to IRQ */
 			ts_now = ts_end;
-		if (st->src[src].ts_reset) {
-			st->src[src].ts_reset = false;
-			ts_end = st->src[src].ts_period * (ts_n - 1);
-			if (sync) {
-				st->src[src].ts_1st = ts_now - ts_end;
-				st->src[src].ts_end = st->src[src].ts_1st;
-			}
-		} else {
-			ts_end = st->src[src].ts_period * ts_n;
-		}
-		ts_end += st->src[src].ts_end;
-		/* ts_now will be sent to nvi_ts_dev where the timestamp is
-		 * prevented from going into the future which allows some
-		 * tolerance here for ts_end being a little more than ts_now.
-		 * The more tolerance we have the less recalculating the period
-		 * to avoid swing around the true period.  Plus, the clamp on
-		 * ts_now in nvi_ts_dev has the benefit of "syncing" with the
-		 * current calculations per device.
-		 */
-		if (ts_end > (ts_now + (ts_period >> 3)) || (sync && (ts_end <
-					       (ts_now - (ts_period >> 1))))) {
-			if (st->sts & (NVI_DBG_SPEW_FIFO | NVI_DBG_SPEW_TS)) {
-				dev_info(&st->i2c->dev,
-					 "sync=%x now=%lld end=%lld ts_n=%u\n",
-					 sync, ts_now, ts_end, ts_n);
-				dev_info(&st->i2c->dev,
-					 "src=%d old period=%lld end=%lld\n",
-					 src, st->src[src].ts_period,
-					 st->src[src].ts_end);
-			}
-			/* st->src[src].ts_period needs to be adjusted */
-			ts_period = ts_now - st->src[src].ts_end;
-			do_div(ts_period, ts_n);
-			st->src[src].ts_period = ts_period;
-			ts_end = ts_period * ts_n;
-			ts_end += st->src[src].ts_end;
-			if (st->sts & (NVI_DBG_SPEW_FIFO | NVI_DBG_SPEW_TS))
-				dev_info(&st->i2c->dev,
-					 "src=%d new period=%lld end=%lld\n",
-					 src, ts_period, ts_end);
-		}
+		if (src == SRC_DMP)
+			ts_end = nvi_dmp_ts(st, src, ts_now, sync, ts_n,
+					    ts_period);
+		else
+			ts_end = nvi_fifo_ts(st, src, ts_now, sync, ts_n);
 		if (fifo_n_max) {
 			/* would only apply to FIFO timing (non-DMP) */
 			if (fifo_n_max < fifo_n) {
@@ -3085,6 +3160,8 @@ static int nvi_fifo_rd(struct nvi_state *st, int src, unsigned int fifo_n_max,
 
 	while (fifo_n) {
 		buf_n = sizeof(st->buf) - st->buf_i;
+		if (buf_n > st->fifo_rd_max)
+			buf_n = st->fifo_rd_max;
 		if (buf_n > fifo_n)
 			buf_n = fifo_n;
 		ret = nvi_i2c_r(st, st->hal->reg->fifo_rw.bank,
@@ -3204,7 +3281,10 @@ static int nvi_read(struct nvi_state *st, bool flush)
 		nvi_enable_irq(st);
 		nvi_en(st);
 	} else if (!(st->sts & (NVS_STS_SUSPEND | NVS_STS_SHUTDOWN))) {
+		/* a flush empties the FIFO regardless of the watermark */
+		st->fifo_wm_dis = flush;
 		ret = nvi_rd(st);
+		st->fifo_wm_dis = false;
 		if (ret < 0)
 			nvi_en(st); /* a little harder reset for ICM DMP */
 		else if (flush)
@@ -3652,6 +3732,10 @@ static int nvi_nvs_read(void *client, int snsr_id, char *buf)
 		t += snprintf(buf + t, PAGE_SIZE - t, "pm=%d\n", st->pm);
 		t += snprintf(buf + t, PAGE_SIZE - t, "bm_timeout_us=%u\n",
 			      st->bm_timeout_us);
+		t += snprintf(buf + t, PAGE_SIZE - t, "fifo_wm_us=%u\n",
+			      st->fifo_wm_us);
+		t += snprintf(buf + t, PAGE_SIZE - t, "fifo_rd_max=%u\n",
+			      st->fifo_rd_max);
 		t += snprintf(buf + t, PAGE_SIZE - t, "fifo_src=%d\n",
 			      st->fifo_src);
 		for (i = 0; i < DEV_N_AUX; i++) {
@@ -4336,6 +4420,25 @@ static int nvi_init(struct nvi_state *st,
 		}
 	}
 
+	/* Read the FIFO in bursts as large as the I2C adapter allows so that
+	 * the bus driver can DMA them.  The remainder of a partial sample is
+	 * carried over at the start of the buffer.
+	 */
+	st->fifo_rd_max = NVI_FIFO_BURST_MAX;
+	if (st->i2c->adapter->quirks &&
+			st->i2c->adapter->quirks->max_read_len &&
+			st->i2c->adapter->quirks->max_read_len <
+			st->fifo_rd_max)
+		st->fifo_rd_max = st->i2c->adapter->quirks->max_read_len;
+	/* advertise batching for the sensors using the HW FIFO */
+	for (i = 0; i < DEV_N_AUX; i++) {
+		if (st->hal->dev[i] && st->hal->dev[i]->fifo_en_msk &&
+				st->hal->dev[i]->fifo_data_n &&
+				!st->snsr[i].cfg.fifo_max_evnt_cnt)
+			st->snsr[i].cfg.fifo_max_evnt_cnt = NVI_FIFO_WM_MAX /
+						st->hal->dev[i]->fifo_data_n;
+	}
+
 	if (st->en_msk & (1 << FW_LOADED))
 		ret = 0;
 	else
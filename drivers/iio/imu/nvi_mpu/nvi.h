@@ -32,6 +32,8 @@
 #define NVI_IRQ_STORM_MIN_NS		(1000000) /* storm if irq faster 1ms */
 #define NVI_IRQ_STORM_MAX_N		(100) /* max storm irqs b4 dis irq */
 #define NVI_FIFO_SAMPLE_SIZE_MAX	(38)
+#define NVI_FIFO_BURST_MAX		(1024) /* max FIFO bytes per read */
+#define NVI_FIFO_WM_MAX			(512) /* half of a 1K HW FIFO */
 #define KBUF_SZ				(64)
 #define SRC_MPU				(0)
 #define SRC_GYR				(0)
@@ -185,6 +187,7 @@ struct nvi_src {
 	s64 ts_1st;
 	s64 ts_end;
 	s64 ts_period;
+	struct nvs_ts ts_fit;		/* FIFO timing model (non-DMP) */
 	unsigned int period_us_src;
 	unsigned int period_us_req;
 	unsigned int period_us_min;
@@ -494,6 +497,9 @@ struct nvi_state {
 	unsigned int dmp_en_msk;
 	unsigned int dmp_dev_msk;
 	unsigned int bm_timeout_us;
+	unsigned int fifo_wm_us;
+	unsigned int fifo_rd_max;
+	bool fifo_wm_dis;
 	struct nvi_snsr snsr[DEV_N_AUX];
 	struct nvi_src src[SRC_N];
 	int fifo_src;
@@ -519,7 +525,8 @@ struct nvi_state {
 	unsigned int bypass_timeout_ms;
 	unsigned int irq_storm_n;
 	unsigned int buf_i;
-	u8 buf[NVI_FIFO_SAMPLE_SIZE_MAX * 2]; /* (* 2)=FIFO OVERFLOW OFFSET */
+	/* (* 2)=FIFO OVERFLOW OFFSET */
+	u8 buf[NVI_FIFO_BURST_MAX + NVI_FIFO_SAMPLE_SIZE_MAX * 2];
 };
 
 int nvi_i2c_wr(struct nvi_state *st, const struct nvi_br *br,
@@ -20,6 +20,10 @@
  *    rate and polled at that rate using the register map.
  * 2. An interrupt defined allows the driver to use the FIFO and its
  *    features, e.g. support for independent ODRs.
+ *    When all the enabled sensors have a batch timeout, the FIFO watermark
+ *    interrupt replaces the data ready interrupt and the FIFO is read in a
+ *    single transfer.  The frames of the batch are then timestamped with
+ *    the NVS timestamp model fitted to the batch read times.
  */
 
 
@@ -38,7 +42,7 @@
 
 #define BMI_NAME			"bmi160"
 #define BMI_VENDOR			"Bosch"
-#define BMI_DRIVER_VERSION		(7)
+#define BMI_DRIVER_VERSION		(8)
 #define BMI_ACC_VERSION			(1)
 #define BMI_GYR_VERSION			(1)
 #define BMI_HW_DELAY_POR_MS		(10)
@@ -81,6 +85,7 @@
 #define BMI_REG_TEMPERATURE_0		(0x20)
 #define BMI_REG_TEMPERATURE_1		(0x21)
 #define BMI_REG_FIFO_LENGTH_0		(0x22)
+#define BMI_REG_FIFO_LENGTH_MSK		(0x07FF)
 #define BMI_REG_FIFO_LENGTH_1		(0x23)
 #define BMI_REG_FIFO_DATA		(0x24)
 #define BMI_REG_ACC_CONF		(0x40)
@@ -99,6 +104,8 @@
 #define BMI_REG_MAG_IF_4		(0x4F)
 #define BMI_REG_INT_EN_0		(0x50)
 #define BMI_REG_INT_EN_1		(0x51)
+#define BMI_REG_INT_EN_1_DRDY		(0x10)
+#define BMI_REG_INT_EN_1_FWM		(0x40)
 #define BMI_REG_INT_EN_2		(0x52)
 #define BMI_REG_INT_OUT_CTRL		(0x53)
 #define BMI_REG_INT_LATCH		(0x54)
@@ -164,6 +171,11 @@
 #define BMI_HW_ACC			(0)
 #define BMI_HW_GYR			(1)
 #define BMI_HW_N			(2)
+#define BMI_FIFO_SIZE			(1024)
+/* leave room in the FIFO for the IRQ latency */
+#define BMI_FIFO_WM_MAX			(BMI_FIFO_SIZE * 3 / 4)
+#define BMI_FIFO_WM_UNIT		(4)
+#define BMI_FIFO_FRAME_SZ(n)		(1 + (n) * 6)
 
 enum BMI_INF {
 	BMI_INF_VER = 0,
@@ -492,6 +504,7 @@ struct bmi_state {
 	unsigned int snsr_t;		/* HW sensor time */
 	unsigned int frame_n;		/* sensor time frame count */
 	unsigned int lost_frame_n;	/* frames lost to FIFO overflow */
+	unsigned int fifo_wm;		/* FIFO watermark (bytes) 0=DRDY */
 	unsigned int hw_n;		/* sensor count */
 	unsigned int hw2ids[BMI_HW_N];	/* sensor id */
 	bool pm_en;			/* pm enable status */
@@ -505,6 +518,7 @@ struct bmi_state {
 	s64 ts_hi;			/* timestamp threshold high */
 	s64 ts_odr;			/* timestamp ODR */
 	s64 period_ns;			/* global period in ns */
+	struct nvs_ts ts_fit;		/* FIFO watermark batch timing */
 	u8 int_out_ctrl;		/* user interrupt cfg */
 	u8 int_latch;			/* " */
 	u8 int_map_0;			/* " */
@@ -514,7 +528,7 @@ struct bmi_state {
 	u8 gyr_conf;			/* user cfg */
 	u16 i2c_addr;			/* I2C address */
 	u16 buf_i;			/* buffer index */
-	u8 buf[256];			/* data buffer */
+	u8 buf[BMI_FIFO_SIZE + 32];	/* data buffer (FIFO + sensortime) */
 };
 
 
@@ -800,8 +814,10 @@ static int bmi_ts_init(struct bmi_state *st)
 
 	ret = bmi_sensortime_rd(st, &st->snsr_t);
 	ret |= bmi_cmd_wr(st, &bmi_cmd_fifo_clr);
-	if (!ret)
+	if (!ret) {
 		st->ts = 0;
+		nvs_ts_reset(&st->ts_fit, st->period_ns);
+	}
 	return ret;
 }
 
@@ -825,7 +841,8 @@ static int bmi_pm(struct bmi_state *st, bool en)
 		ret |= bmi_cmd_wr(st, &bmi_cmd_rst_int);
 		ret |= bmi_i2c_wr(st, BMI_REG_INT_OUT_CTRL, st->int_out_ctrl);
 		ret |= bmi_i2c_wr(st, BMI_REG_INT_LATCH, st->int_latch);
-		ret |= bmi_i2c_wr(st, BMI_REG_INT_EN_1, 0x10);
+		ret |= bmi_i2c_wr(st, BMI_REG_INT_EN_1, BMI_REG_INT_EN_1_DRDY);
+		st->fifo_wm = 0;
 	} else {
 		st->ts = 0;
 		ret = nvs_vregs_sts(st->vreg, ARRAY_SIZE(bmi_vregs));
@@ -892,7 +909,8 @@ static void bmi_work(struct work_struct *ws)
 		if (st->sts & NVS_STS_SPEW_IRQ)
 			dev_info(&st->i2c->dev, "%s ts=%lld\n", __func__, ts1);
 		bmi_mutex_lock(st);
-		ret = bmi_i2c_rd(st, BMI_REG_DATA_0, sizeof(st->buf), st->buf);
+		ret = bmi_i2c_rd(st, BMI_REG_DATA_0,
+				 BMI_REG_DATA_19 - BMI_REG_DATA_0 + 1, st->buf);
 		if (!ret) {
 			for (i = 0; i < st->hw_n; i++) {
 				if (st->enabled & (1 << i)) {
@@ -983,7 +1001,10 @@ static int bmi_frame_regular(struct bmi_state *st, u16 buf_n)
 	unsigned int n;
 
 	st->frame_n++;
-	if (st->ts_hi) {
+	if (st->fifo_wm) {
+		/* batch timing fitted in bmi_read */
+		st->ts = nvs_ts_next(&st->ts_fit);
+	} else if (st->ts_hi) {
 		if (st->ts > st->ts_hi) {
 			/* missed this TS sync - calculate new thresholds */
 			ts_irq = atomic64_read(&st->ts_irq);
@@ -1033,6 +1054,9 @@ static int bmi_frame_regular(struct bmi_state *st, u16 buf_n)
 		}
 	}
 
+	if (st->fifo_wm)
+		return 0;
+
 	if (st->ts_odr)
 		st->ts += st->ts_odr;
 	else
@@ -1078,6 +1102,11 @@ static int bmi_frame_control(struct bmi_state *st, u16 buf_n)
 			dev_info(&st->i2c->dev,
 				 "SKIP FRAME: n=%u odr=%lld TS: %lld->%lld\n",
 				 n, st->ts_odr, st->ts, ns);
+		if (st->fifo_wm) {
+			/* the lost frames are part of the batch's timing */
+			for (i = 0; i < n; i++)
+				ns = nvs_ts_next(&st->ts_fit);
+		}
 		st->ts = ns;
 		st->buf_i++;
 		return 0;
@@ -1171,11 +1200,56 @@ static int bmi_frame_control(struct bmi_state *st, u16 buf_n)
 	return -1;
 }
 
+/* number of sample periods in the FIFO data read into st->buf */
+static unsigned int bmi_fifo_frame_n(struct bmi_state *st, u16 buf_n)
+{
+	unsigned int frame_n = 0;
+	unsigned int i = 0;
+	unsigned int n;
+	u8 hdr;
+
+	while (i < buf_n) {
+		hdr = st->buf[i];
+		if (hdr == 0x80)
+			break;
+
+		if (hdr & 0x80) {
+			n = 1;
+			if (hdr & bmi_hws[BMI_HW_ACC].fifo_hdr_mask)
+				n += bmi_hws[BMI_HW_ACC].fifo_push_n;
+			if (hdr & bmi_hws[BMI_HW_GYR].fifo_hdr_mask)
+				n += bmi_hws[BMI_HW_GYR].fifo_push_n;
+			if (i + n > buf_n)
+				break;
+
+			frame_n++;
+		} else if ((hdr & 0x40) && !((hdr >> 2) & 0x07)) {
+			/* skip frame */
+			n = 2;
+			if (i + n > buf_n)
+				break;
+
+			frame_n += st->buf[i + 1];
+		} else if ((hdr & 0x40) && ((hdr >> 2) & 0x07) == 2) {
+			/* config frame */
+			n = 2;
+		} else {
+			/* sensortime ends the data */
+			break;
+		}
+		i += n;
+	}
+
+	return frame_n;
+}
+
 static int bmi_read(struct bmi_state *st)
 {
 	u8 hdr;
 	u16 buf_n;
 	u16 fifo_n;
+	s64 ts_rd;
+	unsigned int frame_n;
 	int ret;
 
 	ret = bmi_i2c_rd(st, BMI_REG_FIFO_LENGTH_0,
@@ -1183,9 +1257,11 @@ static int bmi_read(struct bmi_state *st)
 	if (ret)
 		return ret;
 
+	/* the last frame in the FIFO is no newer than this */
+	ts_rd = nvs_timestamp();
 	if (st->sts & BMI_STS_SPEW_FIFO)
 		dev_info(&st->i2c->dev, "%s fifo_n=%u\n", __func__, fifo_n);
-	fifo_n &= 0x07FF;
+	fifo_n &= BMI_REG_FIFO_LENGTH_MSK;
 	/* to get the sensor time apparently we have to +25... HW bug? */
 	fifo_n += 25;
 	while (fifo_n) {
@@ -1197,6 +1273,15 @@ static int bmi_read(struct bmi_state *st)
 		if (ret)
 			return ret;
 
+		if (st->fifo_wm) {
+			frame_n = bmi_fifo_frame_n(st, buf_n);
+			nvs_ts_fit(&st->ts_fit, ts_rd, frame_n);
+			if (st->sts & BMI_STS_SPEW_TS)
+				dev_info(&st->i2c->dev,
+					 "%s frame_n=%u step=%lld end=%lld\n",
+					 __func__, frame_n, st->ts_fit.step,
+					 st->ts_fit.end);
+		}
 		st->buf_i = 0;
 		while (st->buf_i < buf_n) {
 			hdr = st->buf[st->buf_i];
@@ -1265,6 +1350,68 @@ static irqreturn_t bmi_irq_handler(int irq, void *dev_id)
 	return IRQ_WAKE_THREAD;
 }
 
+/* The watermark is the data of the shortest batch timeout of the enabled
+ * sensors.  A sensor without a timeout needs each sample as it comes so
+ * the data ready interrupt is used then.
+ */
+static int bmi_fifo_wm(struct bmi_state *st, unsigned int msk_en)
+{
+	unsigned int timeout_us = ~0U;
+	unsigned int wm = 0;
+	unsigned int n = 0;
+	unsigned int i;
+	int ret;
+	u8 val;
+
+	for (i = 0; i < st->hw_n; i++) {
+		if (!(msk_en & (1 << i)))
+			continue;
+
+		n++;
+		if (st->snsrs[i].timeout_us < timeout_us)
+			timeout_us = st->snsrs[i].timeout_us;
+	}
+	if (n && timeout_us && st->period_us) {
+		wm = timeout_us / st->period_us;
+		if (wm > 1) {
+			wm *= BMI_FIFO_FRAME_SZ(n);
+			if (wm > BMI_FIFO_WM_MAX)
+				wm = BMI_FIFO_WM_MAX;
+			wm /= BMI_FIFO_WM_UNIT;
+			wm *= BMI_FIFO_WM_UNIT;
+		} else {
+			wm = 0;
+		}
+	}
+	if (wm)
+		st->timeout_us = (wm / BMI_FIFO_FRAME_SZ(n)) * st->period_us;
+	else
+		st->timeout_us = 0;
+	if (!st->pm_en)
+		return 0;
+
+	if (wm) {
+		ret = bmi_i2c_wr(st, BMI_REG_FIFO_CONFIG_0,
+				 wm / BMI_FIFO_WM_UNIT);
+		val = BMI_REG_INT_EN_1_FWM;
+	} else {
+		ret = 0;
+		val = BMI_REG_INT_EN_1_DRDY;
+	}
+	ret |= bmi_i2c_wr(st, BMI_REG_INT_EN_1, val);
+	if (ret)
+		return ret;
+
+	if (wm && (wm != st->fifo_wm || st->ts_fit.period_nom !=
+		   st->period_ns))
+		nvs_ts_reset(&st->ts_fit, st->period_ns);
+	if (st->sts & (NVS_STS_SPEW_MSG | BMI_STS_SPEW_FIFO))
+		dev_info(&st->i2c->dev, "%s fifo_wm: %u->%u timeout_us=%u\n",
+			 __func__, st->fifo_wm, wm, st->timeout_us);
+	st->fifo_wm = wm;
+	return 0;
+}
+
 static int bmi_period(struct bmi_state *st, unsigned int msk_en, int snsr_id)
 {
 	unsigned int us;
@@ -1311,6 +1458,8 @@ static int bmi_period(struct bmi_state *st, unsigned int msk_en, int snsr_id)
 			 __func__, msk_en, st->period_us, us);
 	st->period_us = us;
 	st->period_ns = (s64)us * 1000; /* us=> ns */
+	if (st->i2c->irq > 0)
+		ret |= bmi_fifo_wm(st, msk_en);
 	return ret;
 }
 
@@ -1652,6 +1801,15 @@ static int bmi_nvs_read(void *client, int snsr_id, char *buf)
 			t += snprintf(buf + t, PAGE_SIZE - t,
 				      "lost_frame_n=%u\n", st->lost_frame_n);
 			st->lost_frame_n = 0;
+			t += snprintf(buf + t, PAGE_SIZE - t,
+				      "fifo_wm=%u\n", st->fifo_wm);
+			t += snprintf(buf + t, PAGE_SIZE - t,
+				      "timeout_us=%u\n", st->timeout_us);
+			t += snprintf(buf + t, PAGE_SIZE - t,
+				      "ts_fit: period=%lld drift=%dppm resync_n=%u\n",
+				      st->ts_fit.period,
+				      nvs_ts_drift_ppm(&st->ts_fit),
+				      st->ts_fit.resync_n);
 		}
 		t += snprintf(buf + t, PAGE_SIZE - t,
 			      "period_us_max=%u\n", st->period_us_max);
@@ -1938,6 +2096,10 @@ static int bmi_init(struct bmi_state *st, const struct i2c_device_id *id)
 		st->snsrs[n].hw = &bmi_hws[i];
 		memcpy(&st->snsrs[n].cfg, &bmi_sensor_cfgs[i],
 		       sizeof(st->snsrs[n].cfg));
+		if (st->i2c->irq > 0)
+			/* frames of this sensor alone at the watermark */
+			st->snsrs[n].cfg.fifo_max_evnt_cnt = BMI_FIFO_WM_MAX /
+							BMI_FIFO_FRAME_SZ(1);
 		nvs_of_dt(st->i2c->dev.of_node, &st->snsrs[n].cfg, NULL);
 		if (st->i2c->irq <= 0 && (st->snsrs[n].cfg.flags &
 					  SENSOR_FLAG_WAKE_UP)) {
@@ -0,0 +1,567 @@
+/*
+ * perf PMU for the performance monitor of the T19x ARM SMMUs.
+ *
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#include <linux/bitmap.h>
+#include <linux/cpumask.h>
+#include <linux/device.h>
+#include <linux/hrtimer.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/perf_event.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/arm-smmu-pmu.h>
+#include "arm-smmu-regs-t19x.h"
+
+/*
+ * The performance monitor lives in the fourth page of each SMMU. Every
+ * counter belongs to a counter group and the group decides which
+ * transactions its counters see: all of them, or only those whose
+ * stream ID matches the group's PMCGSMR. Events asking for different
+ * filters therefore have to land in different groups.
+ *
+ * The counters have no interrupt wired up, so they are folded into the
+ * 64 bit perf count from a timer often enough that they cannot wrap.
+ */
+#define SMMU_PMEVCNTR(n)		(0x000 + ((n) << 2))
+#define SMMU_PMEVTYPER(n)		(0x400 + ((n) << 2))
+#define SMMU_PMCGCR(n)			(0x800 + ((n) << 2))
+#define SMMU_PMCGSMR(n)			(0xa00 + ((n) << 2))
+#define SMMU_PMCNTENSET(n)		(0xc00 + ((n) << 2))
+#define SMMU_PMCNTENCLR(n)		(0xc20 + ((n) << 2))
+#define SMMU_PMINTENCLR(n)		(0xc60 + ((n) << 2))
+#define SMMU_PMOVSCLR(n)		(0xc80 + ((n) << 2))
+#define SMMU_PMCFGR			0xe00
+#define SMMU_PMCR			0xe04
+#define SMMU_PMCEID0			0xe20
+
+#define PMEVTYPER_EVENT_MASK		0xffff
+
+#define PMCGCR_CGNC_SHIFT		24
+#define PMCGCR_CGNC_MASK		0xf
+#define PMCGCR_E			(1 << 11)
+#define PMCGCR_TCEFCFG_SHIFT		8
+#define PMCGCR_TCEFCFG_MASK		0x3
+#define PMCGCR_TCEFCFG_SMR		0x2
+
+#define PMCFGR_NCG_SHIFT		24
+#define PMCFGR_NCG_MASK			0xff
+#define PMCFGR_SIZE_SHIFT		8
+#define PMCFGR_SIZE_MASK		0x3f
+#define PMCFGR_N_MASK			0xff
+
+#define PMCR_E				(1 << 0)
+#define PMCR_P				(1 << 1)
+
+#define ARM_SMMU_PMU_MAX_COUNTERS	256
+#define ARM_SMMU_PMU_MAX_GROUPS		128
+#define ARM_SMMU_PMU_MAX_SMMUS		4
+
+/* Architected events, the implementation defined ones go in raw */
+#define SMMU_EVENT_CYCLES		0x00
+#define SMMU_EVENT_CYCLES_DIV64		0x01
+#define SMMU_EVENT_TLB_ALLOC		0x08
+#define SMMU_EVENT_TLB_ALLOC_RD		0x09
+#define SMMU_EVENT_TLB_ALLOC_WR		0x0a
+#define SMMU_EVENT_ACCESS		0x10
+#define SMMU_EVENT_ACCESS_RD		0x11
+#define SMMU_EVENT_ACCESS_WR		0x12
+
+/* perf_event_attr layout */
+#define ARM_SMMU_PMU_EVENT(ev)	((ev)->attr.config & PMEVTYPER_EVENT_MASK)
+#define ARM_SMMU_PMU_SID(ev)	((ev)->attr.config1 & SMR_ID_MASK)
+#define ARM_SMMU_PMU_SID_MASK(ev) (((ev)->attr.config1 >> 16) & SMR_MASK_MASK)
+#define ARM_SMMU_PMU_FILTER(ev)	(((ev)->attr.config1 >> 32) & 1)
+
+static unsigned int poll_ms = 1000;
+module_param(poll_ms, uint, 0644);
+MODULE_PARM_DESC(poll_ms, "SMMU PMU counter fold period in ms");
+
+struct arm_smmu_pmcg {
+	int users;
+	bool filter;
+	u32 smr;
+};
+
+struct arm_smmu_pmu {
+	struct pmu pmu;
+	struct device *dev;
+	void __iomem *base;
+	unsigned int on_cpu;
+
+	u32 num_counters;
+	u32 num_groups;
+	u64 counter_mask;
+	u32 ceid;
+	u8 group_of[ARM_SMMU_PMU_MAX_COUNTERS];
+
+	spinlock_t lock;
+	DECLARE_BITMAP(used, ARM_SMMU_PMU_MAX_COUNTERS);
+	struct perf_event *events[ARM_SMMU_PMU_MAX_COUNTERS];
+	struct arm_smmu_pmcg groups[ARM_SMMU_PMU_MAX_GROUPS];
+	int active;
+	struct hrtimer timer;
+};
+
+#define to_arm_smmu_pmu(p)	container_of(p, struct arm_smmu_pmu, pmu)
+
+static struct arm_smmu_pmu *arm_smmu_pmus[ARM_SMMU_PMU_MAX_SMMUS];
+static int arm_smmu_num_pmus;
+
+static ktime_t arm_smmu_pmu_period(void)
+{
+	return ms_to_ktime(max(poll_ms, 1U));
+}
+
+static u32 arm_smmu_pmu_event_smr(struct perf_event *event)
+{
+	return ARM_SMMU_PMU_SID(event) << SMR_ID_SHIFT |
+		ARM_SMMU_PMU_SID_MASK(event) << SMR_MASK_SHIFT;
+}
+
+static void arm_smmu_pmu_event_update(struct perf_event *event)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	u64 prev, now;
+
+	do {
+		prev = local64_read(&hwc->prev_count);
+		now = readl_relaxed(smmu_pmu->base + SMMU_PMEVCNTR(hwc->idx));
+	} while (local64_cmpxchg(&hwc->prev_count, prev, now) != prev);
+
+	local64_add((now - prev) & smmu_pmu->counter_mask, &event->count);
+}
+
+static enum hrtimer_restart arm_smmu_pmu_poll(struct hrtimer *timer)
+{
+	struct arm_smmu_pmu *smmu_pmu = container_of(timer,
+					struct arm_smmu_pmu, timer);
+	unsigned long flags;
+	int idx;
+
+	spin_lock_irqsave(&smmu_pmu->lock, flags);
+	for_each_set_bit(idx, smmu_pmu->used, smmu_pmu->num_counters) {
+		struct perf_event *event = smmu_pmu->events[idx];
+
+		if (!(event->hw.state & PERF_HES_STOPPED))
+			arm_smmu_pmu_event_update(event);
+	}
+	spin_unlock_irqrestore(&smmu_pmu->lock, flags);
+
+	hrtimer_forward_now(timer, arm_smmu_pmu_period());
+	return HRTIMER_RESTART;
+}
+
+static int arm_smmu_pmu_event_init(struct perf_event *event)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(event->pmu);
+	struct perf_event *sibling;
+
+	if (event->attr.type != event->pmu->type)
+		return -ENOENT;
+
+	/* Uncore counters, no sampling and no per task counting */
+	if (is_sampling_event(event) || event->attach_state & PERF_ATTACH_TASK)
+		return -EOPNOTSUPP;
+
+	if (event->cpu < 0)
+		return -EINVAL;
+
+	if (event->attr.config & ~(u64)PMEVTYPER_EVENT_MASK)
+		return -EINVAL;
+
+	if (event->group_leader->pmu != event->pmu &&
+	    !is_software_event(event->group_leader))
+		return -EINVAL;
+
+	list_for_each_entry(sibling, &event->group_leader->sibling_list,
+			    group_entry) {
+		if (sibling->pmu != event->pmu && !is_software_event(sibling))
+			return -EINVAL;
+	}
+
+	event->cpu = smmu_pmu->on_cpu;
+	event->hw.idx = -1;
+	return 0;
+}
+
+static void arm_smmu_pmu_event_start(struct perf_event *event, int flags)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	int idx = hwc->idx;
+
+	local64_set(&hwc->prev_count,
+		    readl_relaxed(smmu_pmu->base + SMMU_PMEVCNTR(idx)));
+	hwc->state = 0;
+	writel_relaxed(BIT(idx % 32),
+		       smmu_pmu->base + SMMU_PMCNTENSET(idx / 32));
+}
+
+static void arm_smmu_pmu_event_stop(struct perf_event *event, int flags)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	int idx = hwc->idx;
+
+	if (hwc->state & PERF_HES_STOPPED)
+		return;
+
+	writel_relaxed(BIT(idx % 32),
+		       smmu_pmu->base + SMMU_PMCNTENCLR(idx / 32));
+	hwc->state |= PERF_HES_STOPPED;
+
+	if (flags & PERF_EF_UPDATE) {
+		arm_smmu_pmu_event_update(event);
+		hwc->state |= PERF_HES_UPTODATE;
+	}
+}
+
+/* A free counter whose group is idle or already filters the same way */
+static int arm_smmu_pmu_get_counter(struct arm_smmu_pmu *smmu_pmu,
+				    bool filter, u32 smr)
+{
+	struct arm_smmu_pmcg *pmcg;
+	int idx;
+
+	for (idx = 0; idx < smmu_pmu->num_counters; idx++) {
+		if (test_bit(idx, smmu_pmu->used))
+			continue;
+
+		pmcg = &smmu_pmu->groups[smmu_pmu->group_of[idx]];
+		if (!pmcg->users ||
+		    (pmcg->filter == filter && (!filter || pmcg->smr == smr)))
+			return idx;
+	}
+
+	return -EAGAIN;
+}
+
+static int arm_smmu_pmu_event_add(struct perf_event *event, int flags)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	bool filter = ARM_SMMU_PMU_FILTER(event);
+	u32 smr = arm_smmu_pmu_event_smr(event);
+	struct arm_smmu_pmcg *pmcg;
+	unsigned long irqflags;
+	int idx, cg;
+
+	spin_lock_irqsave(&smmu_pmu->lock, irqflags);
+	idx = arm_smmu_pmu_get_counter(smmu_pmu, filter, smr);
+	if (idx < 0) {
+		spin_unlock_irqrestore(&smmu_pmu->lock, irqflags);
+		return idx;
+	}
+
+	cg = smmu_pmu->group_of[idx];
+	pmcg = &smmu_pmu->groups[cg];
+	if (!pmcg->users++) {
+		u32 val = readl_relaxed(smmu_pmu->base + SMMU_PMCGCR(cg));
+
+		val &= ~(PMCGCR_TCEFCFG_MASK << PMCGCR_TCEFCFG_SHIFT);
+		if (filter) {
+			writel_relaxed(smr, smmu_pmu->base + SMMU_PMCGSMR(cg));
+			val |= PMCGCR_TCEFCFG_SMR << PMCGCR_TCEFCFG_SHIFT;
+		}
+		writel_relaxed(val | PMCGCR_E, smmu_pmu->base + SMMU_PMCGCR(cg));
+		pmcg->filter = filter;
+		pmcg->smr = smr;
+	}
+
+	writel_relaxed(ARM_SMMU_PMU_EVENT(event),
+		       smmu_pmu->base + SMMU_PMEVTYPER(idx));
+	set_bit(idx, smmu_pmu->used);
+	smmu_pmu->events[idx] = event;
+	hwc->idx = idx;
+	hwc->state = PERF_HES_STOPPED | PERF_HES_UPTODATE;
+
+	if (flags & PERF_EF_START)
+		arm_smmu_pmu_event_start(event, flags);
+
+	if (!smmu_pmu->active++)
+		hrtimer_start(&smmu_pmu->timer, arm_smmu_pmu_period(),
+			      HRTIMER_MODE_REL_PINNED);
+	spin_unlock_irqrestore(&smmu_pmu->lock, irqflags);
+
+	perf_event_update_userpage(event);
+	return 0;
+}
+
+static void arm_smmu_pmu_event_del(struct perf_event *event, int flags)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(event->pmu);
+	struct hw_perf_event *hwc = &event->hw;
+	int idx = hwc->idx, cg = smmu_pmu->group_of[idx];
+	unsigned long irqflags;
+	bool last;
+
+	spin_lock_irqsave(&smmu_pmu->lock, irqflags);
+	arm_smmu_pmu_event_stop(event, PERF_EF_UPDATE);
+
+	if (!--smmu_pmu->groups[cg].users) {
+		u32 val = readl_relaxed(smmu_pmu->base + SMMU_PMCGCR(cg));
+
+		writel_relaxed(val & ~PMCGCR_E,
+			       smmu_pmu->base + SMMU_PMCGCR(cg));
+	}
+
+	smmu_pmu->events[idx] = NULL;
+	clear_bit(idx, smmu_pmu->used);
+	hwc->idx = -1;
+	last = !--smmu_pmu->active;
+	spin_unlock_irqrestore(&smmu_pmu->lock, irqflags);
+
+	/* The timer is pinned to this CPU, it cannot be running now */
+	if (last)
+		hrtimer_cancel(&smmu_pmu->timer);
+
+	perf_event_update_userpage(event);
+}
+
+static void arm_smmu_pmu_event_read(struct perf_event *event)
+{
+	arm_smmu_pmu_event_update(event);
+}
+
+static void arm_smmu_pmu_enable(struct pmu *pmu)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(pmu);
+	u32 val = readl_relaxed(smmu_pmu->base + SMMU_PMCR);
+
+	writel(val | PMCR_E, smmu_pmu->base + SMMU_PMCR);
+}
+
+static void arm_smmu_pmu_disable(struct pmu *pmu)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(pmu);
+	u32 val = readl_relaxed(smmu_pmu->base + SMMU_PMCR);
+
+	writel(val & ~PMCR_E, smmu_pmu->base + SMMU_PMCR);
+}
+
+static ssize_t arm_smmu_pmu_cpumask_show(struct device *dev,
+					 struct device_attribute *attr,
+					 char *buf)
+{
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(dev_get_drvdata(dev));
+
+	return cpumap_print_to_pagebuf(true, buf,
+				       cpumask_of(smmu_pmu->on_cpu));
+}
+
+static struct device_attribute arm_smmu_pmu_cpumask_attr =
+	__ATTR(cpumask, S_IRUGO, arm_smmu_pmu_cpumask_show, NULL);
+
+static struct attribute *arm_smmu_pmu_cpumask_attrs[] = {
+	&arm_smmu_pmu_cpumask_attr.attr,
+	NULL,
+};
+
+static struct attribute_group arm_smmu_pmu_cpumask_group = {
+	.attrs = arm_smmu_pmu_cpumask_attrs,
+};
+
+PMU_FORMAT_ATTR(event, "config:0-15");
+PMU_FORMAT_ATTR(sid, "config1:0-15");
+PMU_FORMAT_ATTR(sid_mask, "config1:16-31");
+PMU_FORMAT_ATTR(filter, "config1:32");
+
+static struct attribute *arm_smmu_pmu_format_attrs[] = {
+	&format_attr_event.attr,
+	&format_attr_sid.attr,
+	&format_attr_sid_mask.attr,
+	&format_attr_filter.attr,
+	NULL,
+};
+
+static struct attribute_group arm_smmu_pmu_format_group = {
+	.name = "format",
+	.attrs = arm_smmu_pmu_format_attrs,
+};
+
+static ssize_t arm_smmu_pmu_event_show(struct device *dev,
+				       struct device_attribute *attr,
+				       char *buf)
+{
+	struct perf_pmu_events_attr *pmu_attr =
+		container_of(attr, struct perf_pmu_events_attr, attr);
+
+	return sprintf(buf, "event=0x%02llx\n", pmu_attr->id);
+}
+
+#define ARM_SMMU_EVENT_ATTR(_name, _id)					\
+	(&((struct perf_pmu_events_attr[]) {				\
+		{ .attr = __ATTR(_name, S_IRUGO,			\
+				 arm_smmu_pmu_event_show, NULL),	\
+		  .id = _id, }						\
+	})[0].attr.attr)
+
+static struct attribute *arm_smmu_pmu_event_attrs[] = {
+	ARM_SMMU_EVENT_ATTR(cycles, SMMU_EVENT_CYCLES),
+	ARM_SMMU_EVENT_ATTR(cycles_div64, SMMU_EVENT_CYCLES_DIV64),
+	ARM_SMMU_EVENT_ATTR(tlb_alloc, SMMU_EVENT_TLB_ALLOC),
+	ARM_SMMU_EVENT_ATTR(tlb_alloc_rd, SMMU_EVENT_TLB_ALLOC_RD),
+	ARM_SMMU_EVENT_ATTR(tlb_alloc_wr, SMMU_EVENT_TLB_ALLOC_WR),
+	ARM_SMMU_EVENT_ATTR(access, SMMU_EVENT_ACCESS),
+	ARM_SMMU_EVENT_ATTR(access_rd, SMMU_EVENT_ACCESS_RD),
+	ARM_SMMU_EVENT_ATTR(access_wr, SMMU_EVENT_ACCESS_WR),
+	NULL,
+};
+
+/* Only list what PMCEID0 says this SMMU implements */
+static umode_t arm_smmu_pmu_event_is_visible(struct kobject *kobj,
+					     struct attribute *attr, int unused)
+{
+	struct device *dev = kobj_to_dev(kobj);
+	struct arm_smmu_pmu *smmu_pmu = to_arm_smmu_pmu(dev_get_drvdata(dev));
+	struct perf_pmu_events_attr *pmu_attr =
+		container_of(attr, struct perf_pmu_events_attr, attr.attr);
+
+	if (smmu_pmu->ceid & BIT(pmu_attr->id))
+		return attr->mode;
+
+	return 0;
+}
+
+static struct attribute_group arm_smmu_pmu_events_group = {
+	.name = "events",
+	.attrs = arm_smmu_pmu_event_attrs,
+	.is_visible = arm_smmu_pmu_event_is_visible,
+};
+
+static const struct attribute_group *arm_smmu_pmu_attr_groups[] = {
+	&arm_smmu_pmu_cpumask_group,
+	&arm_smmu_pmu_format_group,
+	&arm_smmu_pmu_events_group,
+	NULL,
+};
+
+static void arm_smmu_pmu_reset(struct arm_smmu_pmu *smmu_pmu)
+{
+	int i;
+
+	writel_relaxed(PMCR_P, smmu_pmu->base + SMMU_PMCR);
+	for (i = 0; i < DIV_ROUND_UP(smmu_pmu->num_counters, 32); i++) {
+		writel_relaxed(~0, smmu_pmu->base + SMMU_PMCNTENCLR(i));
+		writel_relaxed(~0, smmu_pmu->base + SMMU_PMINTENCLR(i));
+		writel_relaxed(~0, smmu_pmu->base + SMMU_PMOVSCLR(i));
+	}
+
+	for (i = 0; i < smmu_pmu->num_groups; i++) {
+		u32 val = readl_relaxed(smmu_pmu->base + SMMU_PMCGCR(i));
+
+		val &= ~(PMCGCR_E |
+			 PMCGCR_TCEFCFG_MASK << PMCGCR_TCEFCFG_SHIFT);
+		writel_relaxed(val, smmu_pmu->base + SMMU_PMCGCR(i));
+	}
+	wmb();
+}
+
+static int arm_smmu_pmu_probe_one(struct device *dev, void __iomem *base,
+				  unsigned long pgshift, int id)
+{
+	struct arm_smmu_pmu *smmu_pmu;
+	u32 cfgr, idx = 0;
+	char *name;
+	int cg, err;
+
+	smmu_pmu = devm_kzalloc(dev, sizeof(*smmu_pmu), GFP_KERNEL);
+	if (!smmu_pmu)
+		return -ENOMEM;
+
+	smmu_pmu->dev = dev;
+	smmu_pmu->base = base + (3 << pgshift);
+	spin_lock_init(&smmu_pmu->lock);
+
+	cfgr = readl_relaxed(smmu_pmu->base + SMMU_PMCFGR);
+	smmu_pmu->num_counters = min_t(u32, (cfgr & PMCFGR_N_MASK) + 1,
+				       ARM_SMMU_PMU_MAX_COUNTERS);
+	smmu_pmu->num_groups = min_t(u32,
+			((cfgr >> PMCFGR_NCG_SHIFT) & PMCFGR_NCG_MASK) + 1,
+			ARM_SMMU_PMU_MAX_GROUPS);
+	smmu_pmu->counter_mask = GENMASK_ULL(
+			(cfgr >> PMCFGR_SIZE_SHIFT) & PMCFGR_SIZE_MASK, 0);
+	smmu_pmu->ceid = readl_relaxed(smmu_pmu->base + SMMU_PMCEID0);
+
+	/* Counters are handed out to the groups in order */
+	for (cg = 0; cg < smmu_pmu->num_groups; cg++) {
+		u32 cgnc = (readl_relaxed(smmu_pmu->base + SMMU_PMCGCR(cg)) >>
+			    PMCGCR_CGNC_SHIFT) & PMCGCR_CGNC_MASK;
+
+		while (cgnc-- && idx < smmu_pmu->num_counters)
+			smmu_pmu->group_of[idx++] = cg;
+	}
+	smmu_pmu->num_counters = idx;
+	if (!smmu_pmu->num_counters)
+		return -ENODEV;
+
+	arm_smmu_pmu_reset(smmu_pmu);
+
+	hrtimer_init(&smmu_pmu->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	smmu_pmu->timer.function = arm_smmu_pmu_poll;
+
+	/* The counters are not per CPU, every event is counted on one */
+	smmu_pmu->on_cpu = cpumask_first(cpu_online_mask);
+
+	smmu_pmu->pmu = (struct pmu) {
+		.task_ctx_nr	= perf_invalid_context,
+		.pmu_enable	= arm_smmu_pmu_enable,
+		.pmu_disable	= arm_smmu_pmu_disable,
+		.event_init	= arm_smmu_pmu_event_init,
+		.add		= arm_smmu_pmu_event_add,
+		.del		= arm_smmu_pmu_event_del,
+		.start		= arm_smmu_pmu_event_start,
+		.stop		= arm_smmu_pmu_event_stop,
+		.read		= arm_smmu_pmu_event_read,
+		.attr_groups	= arm_smmu_pmu_attr_groups,
+	};
+
+	name = devm_kasprintf(dev, GFP_KERNEL, "smmu_t19x_%d", id);
+	if (!name)
+		return -ENOMEM;
+
+	err = perf_pmu_register(&smmu_pmu->pmu, name, -1);
+	if (err) {
+		dev_err(dev, "failed to register PMU %s: %d\n", name, err);
+		return err;
+	}
+
+	dev_info(dev, "%s: %u counters in %u groups\n", name,
+		 smmu_pmu->num_counters, smmu_pmu->num_groups);
+	arm_smmu_pmus[arm_smmu_num_pmus++] = smmu_pmu;
+	return 0;
+}
+
+int arm_smmu_pmu_init(struct device *dev, void __iomem **smmu_base,
+		      int num_smmus, unsigned long smmu_pgshift)
+{
+	int i, err;
+
+	for (i = 0; i < num_smmus && i < ARM_SMMU_PMU_MAX_SMMUS; i++) {
+		err = arm_smmu_pmu_probe_one(dev, smmu_base[i],
+					     smmu_pgshift, i);
+		if (err) {
+			arm_smmu_pmu_exit();
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+void arm_smmu_pmu_exit(void)
+{
+	while (arm_smmu_num_pmus)
+		perf_pmu_unregister(&arm_smmu_pmus[--arm_smmu_num_pmus]->pmu);
+}
@@ -45,6 +45,7 @@
 #include <linux/of_platform.h>
 #include <linux/pci.h>
 #include <linux/platform_device.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/debugfs.h>
@@ -59,6 +60,7 @@
 #include <linux/version.h>
 
 #include <linux/arm-smmu-suspend.h>
+#include <linux/arm-smmu-pmu.h>
 
 #include <asm/pgalloc.h>
 #include <asm/dma-iommu.h>
@@ -192,6 +194,10 @@ struct arm_smmu_domain {
 	dma_addr_t			inquired_iova;
 	phys_addr_t			inquired_phys;
 
+	/* unmapped IOVA range still waiting for TLB invalidation */
+	unsigned long			tlb_gather_start;
+	unsigned long			tlb_gather_end;
+
 	struct iommu_domain             domain;
 };
 
@@ -205,6 +211,8 @@ static bool arm_smmu_skip_mapping; /* For debug */
 static bool arm_smmu_gr0_tlbiallnsnh; /* Insert TLBIALLNSNH at all */
 static bool arm_smmu_tlb_inv_by_addr = 1; /* debugfs: tlb inv context by default */
 static bool arm_smmu_tlb_inv_at_map;	/* debugfs: tlb inv at map additionally */
+static u32 arm_smmu_tlb_inv_ctx_thresh = SZ_2M; /* debugfs: inv context above */
+static bool arm_smmu_block_mapping = 1; /* debugfs: PMD blocks for aligned runs */
 
 static void get_pte_info(struct arm_smmu_cfg *cfg, ulong iova,
 	pgdval_t *pgdval, pudval_t *pudval, pmdval_t *pmdval, pteval_t *pteval);
@@ -786,6 +794,47 @@ static void arm_smmu_tlb_inv_range(struct arm_smmu_domain *smmu_domain,
 			iova_orig, size);
 }
 
+/* Called with smmu_domain->lock held */
+static void arm_smmu_tlb_gather_add(struct arm_smmu_domain *smmu_domain,
+				    unsigned long iova, size_t size)
+{
+	if (smmu_domain->tlb_gather_start == smmu_domain->tlb_gather_end) {
+		smmu_domain->tlb_gather_start = iova;
+		smmu_domain->tlb_gather_end = iova + size;
+		return;
+	}
+
+	smmu_domain->tlb_gather_start = min(smmu_domain->tlb_gather_start,
+					    iova);
+	smmu_domain->tlb_gather_end = max(smmu_domain->tlb_gather_end,
+					  iova + size);
+}
+
+/*
+ * Invalidate everything gathered since the last flush with a single sync.
+ * Past the threshold one TLBIASID/TLBIVMID is far cheaper than walking the
+ * range a page at a time, even counting the refills it causes.
+ *
+ * Called with smmu_domain->lock held, so a concurrent flush can't return
+ * before the invalidation of a range it took over has completed.
+ */
+static void arm_smmu_tlb_gather_flush(struct arm_smmu_domain *smmu_domain)
+{
+	unsigned long start = smmu_domain->tlb_gather_start;
+	size_t size = smmu_domain->tlb_gather_end - start;
+
+	if (!size)
+		return;
+
+	if (arm_smmu_tlb_inv_by_addr && size <= arm_smmu_tlb_inv_ctx_thresh)
+		arm_smmu_tlb_inv_range(smmu_domain, start, size);
+	else
+		arm_smmu_tlb_inv_context(smmu_domain);
+
+	smmu_domain->tlb_gather_start = 0;
+	smmu_domain->tlb_gather_end = 0;
+}
+
 static irqreturn_t __arm_smmu_context_fault(int irq, void *dev,
 				void __iomem *cb_base, void __iomem *gr1_base,
 				int smmu_id)
@@ -1313,6 +1362,11 @@ out_free_domain:
 	return NULL;
 }
 
+static inline bool arm_smmu_pmd_is_block(pmd_t pmd)
+{
+	return (pmd_val(pmd) & PMD_TYPE_MASK) == PMD_TYPE_SECT;
+}
+
 static void arm_smmu_free_ptes(pmd_t *pmd)
 {
 	pgtable_t table = pmd_pgtable(*pmd);
@@ -1326,12 +1380,11 @@ static void arm_smmu_free_pmds(pud_t *pud)
 	pmd_t *pmd, *pmd_base = pmd_offset(pud, 0);
 
 	pmd = pmd_base;
-	for (i = 0; i < PTRS_PER_PMD; ++i) {
-		if (pmd_none(*pmd))
+	for (i = 0; i < PTRS_PER_PMD; ++i, ++pmd) {
+		if (pmd_none(*pmd) || arm_smmu_pmd_is_block(*pmd))
 			continue;
 
 		arm_smmu_free_ptes(pmd);
-		pmd++;
 	}
 
 	pmd_free(NULL, pmd_base);
@@ -1545,6 +1598,16 @@ static int smmu_ptdump_show(struct seq_file *s, void *unused)
 				++k, pmd++, addr += PMD_SIZE) {
 				if (pmd_none(*pmd))
 					continue;
+				if (arm_smmu_pmd_is_block(*pmd)) {
+					phys_addr_t pa;
+
+					pa = __pfn_to_phys(pmd_pfn(*pmd));
+					seq_printf(s,
+						   "va=0x%016lx pa=%pap *pmd=%pad\n",
+						   addr, &pa, &(*pmd));
+					mapped += PMD_SIZE;
+					continue;
+				}
 				pte = pmd_page_vaddr(*pmd) + pte_index(addr);
 				for (l = 0; l < PTRS_PER_PTE;
 					++l, pte++, addr += PAGE_SIZE) {
@@ -1964,22 +2027,10 @@ unlock_ret:
 	return ret;
 }
 
-static int arm_smmu_alloc_init_pte(struct arm_smmu_domain *domain, pmd_t *pmd,
-				   unsigned long addr, unsigned long end,
-				   unsigned long pfn, int prot, int stage)
+static pteval_t arm_smmu_pteval(int prot, int stage)
 {
-	pte_t *pte, *start;
-	struct arm_smmu_device *smmu = domain->smmu;
 	pteval_t pteval = ARM_SMMU_PTE_PAGE | ARM_SMMU_PTE_AF | ARM_SMMU_PTE_XN;
 
-	if (pmd_none(*pmd)) {
-		/* Allocate a new set of tables */
-		pgtable_t table = (pgtable_t) arm_smmu_alloc_pgtable_page(
-							domain, 2, pmd, addr);
-		if (!table)
-			return -ENOMEM;
-	}
-
 	if (stage == 1) {
 		pteval |= ARM_SMMU_PTE_AP_UNPRIV | ARM_SMMU_PTE_nG;
 		if (!(prot & IOMMU_WRITE) && (prot & IOMMU_READ))
@@ -2008,6 +2059,26 @@ static int arm_smmu_alloc_init_pte(struct arm_smmu_domain *domain, pmd_t *pmd,
 		pteval &= ~ARM_SMMU_PTE_PAGE;
 
 	pteval |= ARM_SMMU_PTE_SH_IS;
+
+	return pteval;
+}
+
+static int arm_smmu_alloc_init_pte(struct arm_smmu_domain *domain, pmd_t *pmd,
+				   unsigned long addr, unsigned long end,
+				   unsigned long pfn, int prot, int stage)
+{
+	pte_t *pte, *start;
+	struct arm_smmu_device *smmu = domain->smmu;
+	pteval_t pteval = arm_smmu_pteval(prot, stage);
+
+	if (pmd_none(*pmd)) {
+		/* Allocate a new set of tables */
+		pgtable_t table = (pgtable_t) arm_smmu_alloc_pgtable_page(
+							domain, 2, pmd, addr);
+		if (!table)
+			return -ENOMEM;
+	}
+
 	start = pmd_page_vaddr(*pmd) + pte_index(addr);
 	pte = start;
 
@@ -2077,6 +2148,119 @@ static int arm_smmu_alloc_init_pte(struct arm_smmu_domain *domain, pmd_t *pmd,
 	return 0;
 }
 
+static bool arm_smmu_pmd_is_block_range(unsigned long addr,
+					unsigned long end, phys_addr_t phys)
+{
+	return !(addr & ~PMD_MASK) && (end - addr == PMD_SIZE) &&
+		!(phys & ~PMD_MASK);
+}
+
+/*
+ * A last-level table whose entries have all been unmapped again. Tables
+ * are never freed on unmap, so without this an IOVA range that once held
+ * 4K pages could never take a block again. The walk caches may still
+ * hold the table, so invalidate before handing the page back.
+ */
+static bool arm_smmu_pmd_reclaim(struct arm_smmu_domain *domain, pmd_t *pmd,
+				 unsigned long addr)
+{
+	pgtable_t table;
+	pte_t *pte;
+	int i;
+
+	if (pmd_none(*pmd))
+		return true;
+
+	pte = pmd_page_vaddr(*pmd);
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		if (!pte_none(pte[i]))
+			return false;
+
+	table = pmd_pgtable(*pmd);
+	*pmd = __pmd(0);
+	arm_smmu_flush_pgtable(domain->smmu, pmd, sizeof(*pmd));
+	arm_smmu_tlb_inv_range(domain, addr, PMD_SIZE);
+	__free_page(table);
+
+	return true;
+}
+
+static void arm_smmu_set_block(struct arm_smmu_domain *domain, pmd_t *pmd,
+			       unsigned long pfn, int prot, int stage)
+{
+	pmdval_t pmdval = arm_smmu_pteval(prot, stage);
+
+	pmdval &= ~PMD_TYPE_MASK;
+	pmdval |= PMD_TYPE_SECT;
+
+	if (prot & DMA_FOR_NVLINK)
+		pfn |= 1 << (NVLINK_PHY_BIT - PAGE_SHIFT);
+
+	*pmd = __pmd(__pfn_to_phys(pfn) | pmdval);
+	arm_smmu_flush_pgtable(domain->smmu, pmd, sizeof(*pmd));
+}
+
+/*
+ * Turn a block back into a table of contiguous-hinted pages mapping the
+ * same output with the same attributes, for a partial unmap or remap.
+ * As in io-pgtable, the table replaces the block without a break; the
+ * unmap that follows invalidates the TLB entry of the block.
+ */
+static int arm_smmu_split_block(struct arm_smmu_domain *domain, pmd_t *pmd)
+{
+	unsigned long pfn = pmd_pfn(*pmd);
+	pteval_t attrs;
+	pgtable_t table;
+	pte_t *pte;
+	int i;
+
+	attrs = pmd_val(*pmd) & ~(PMD_TYPE_MASK | (PHYS_MASK & PAGE_MASK));
+
+	table = alloc_page(GFP_ATOMIC | __GFP_ZERO);
+	if (!table)
+		return -ENOMEM;
+
+	pte = page_address(table);
+	for (i = 0; i < PTRS_PER_PTE; i++)
+		pte[i] = pfn_pte(pfn + i, __pgprot(attrs | ARM_SMMU_PTE_PAGE |
+						   ARM_SMMU_PTE_CONT));
+	arm_smmu_flush_pgtable(domain->smmu, pte, PAGE_SIZE);
+
+	pmd_populate(NULL, pmd, table);
+	arm_smmu_flush_pgtable(domain->smmu, pmd, sizeof(*pmd));
+
+	return 0;
+}
+
+static int arm_smmu_map_pmd(struct arm_smmu_domain *domain, pmd_t *pmd,
+			    unsigned long addr, unsigned long end,
+			    unsigned long pfn, int prot, int stage)
+{
+	int ret;
+
+	if (arm_smmu_pmd_is_block(*pmd)) {
+		if (!pfn && end - addr == PMD_SIZE) {
+			*pmd = __pmd(0);
+			arm_smmu_flush_pgtable(domain->smmu, pmd,
+					       sizeof(*pmd));
+			return 0;
+		}
+
+		ret = arm_smmu_split_block(domain, pmd);
+		if (ret)
+			return ret;
+	} else if (pfn && arm_smmu_block_mapping &&
+		   (prot & (IOMMU_READ | IOMMU_WRITE)) &&
+		   arm_smmu_pmd_is_block_range(addr, end, __pfn_to_phys(pfn)) &&
+		   arm_smmu_pmd_reclaim(domain, pmd, addr)) {
+		arm_smmu_set_block(domain, pmd, pfn, prot, stage);
+		return 0;
+	}
+
+	return arm_smmu_alloc_init_pte(domain, pmd, addr, end, pfn, prot,
+				       stage);
+}
+
 static int arm_smmu_alloc_init_pmd(struct arm_smmu_domain *domain, pud_t *pud,
 				   unsigned long addr, unsigned long end,
 				   phys_addr_t phys, int prot, int stage)
@@ -2098,8 +2282,8 @@ static int arm_smmu_alloc_init_pmd(struct arm_smmu_domain *domain, pud_t *pud,
 
 	do {
 		next = pmd_addr_end(addr, end);
-		ret = arm_smmu_alloc_init_pte(domain, pmd, addr, next, pfn,
-					      prot, stage);
+		ret = arm_smmu_map_pmd(domain, pmd, addr, next, pfn, prot,
+				       stage);
 		if (phys)
 			phys += next - addr;
 		pfn = __phys_to_pfn(phys);
@@ -2160,7 +2344,7 @@ static void get_pte_info(struct arm_smmu_cfg *cfg, ulong iova,
 
 	pmd = pmd_offset(pud, iova);
 	*pmdval = pmd_val(*pmd);
-	if (pmd_none(*pmd))
+	if (pmd_none(*pmd) || arm_smmu_pmd_is_block(*pmd))
 		return;
 
 	pte = pmd_page_vaddr(*pmd) + pte_index(iova);
@@ -2279,6 +2463,58 @@ static size_t arm_smmu_map_sg(struct iommu_domain *domain, unsigned long iova,
 }
 #endif
 
+#if LINUX_VERSION_CODE > KERNEL_VERSION(4, 9, 0)
+/*
+ * As default_iommu_map_sg(), but physically contiguous neighbours are
+ * mapped in one go so the page table code sees whole runs and can use
+ * contiguous PTEs and blocks for them.
+ */
+static size_t arm_smmu_map_sg_runs(struct iommu_domain *domain,
+				   unsigned long iova, struct scatterlist *sgl,
+				   unsigned int nents, int prot)
+{
+	struct arm_smmu_domain *smmu_domain = to_smmu_domain(domain);
+	struct scatterlist *sg;
+	phys_addr_t run_pa = 0;
+	size_t run_len = 0, mapped = 0;
+	unsigned int i;
+
+	for_each_sg(sgl, sg, nents, i) {
+		phys_addr_t pa = sg_phys(sg);
+
+		if (!IS_ALIGNED(pa | sg->length, PAGE_SIZE))
+			goto out_err;
+
+		if (run_len && run_pa + run_len == pa) {
+			run_len += sg->length;
+			continue;
+		}
+
+		if (run_len) {
+			if (arm_smmu_handle_mapping(smmu_domain, iova + mapped,
+						    run_pa, run_len, prot))
+				goto out_err;
+			mapped += run_len;
+		}
+		run_pa = pa;
+		run_len = sg->length;
+	}
+
+	if (run_len) {
+		if (arm_smmu_handle_mapping(smmu_domain, iova + mapped, run_pa,
+					    run_len, prot))
+			goto out_err;
+		mapped += run_len;
+	}
+
+	return mapped;
+
+out_err:
+	iommu_unmap(domain, iova, mapped);
+	return 0;
+}
+#endif
+
 static int arm_smmu_map(struct iommu_domain *domain, unsigned long iova,
 			phys_addr_t paddr, size_t size, unsigned long prot)
 {
@@ -2295,6 +2531,7 @@ static size_t arm_smmu_unmap(struct iommu_domain *domain, unsigned long iova,
 {
 	int ret;
 	u64 time_before = 0;
+	unsigned long flags;
 
 	struct arm_smmu_domain *smmu_domain = to_smmu_domain(domain);
 #ifdef CONFIG_TRACEPOINTS
@@ -2308,10 +2545,13 @@ static size_t arm_smmu_unmap(struct iommu_domain *domain, unsigned long iova,
 
 	ret = arm_smmu_handle_mapping(smmu_domain, iova, 0, size, 0);
 	if (!arm_smmu_tlb_inv_at_map) {
-		if (arm_smmu_tlb_inv_by_addr)
-			arm_smmu_tlb_inv_range(smmu_domain, iova, size);
-		else
-			arm_smmu_tlb_inv_context(smmu_domain);
+		spin_lock_irqsave(&smmu_domain->lock, flags);
+		arm_smmu_tlb_gather_add(smmu_domain, iova, size);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 14, 0)
+		/* No iotlb_sync from the core, flush at each unmap */
+		arm_smmu_tlb_gather_flush(smmu_domain);
+#endif
+		spin_unlock_irqrestore(&smmu_domain->lock, flags);
 	}
 	if (time_before)
 		trace_arm_smmu_unmap(time_before, iova, size);
@@ -2319,6 +2559,48 @@ static size_t arm_smmu_unmap(struct iommu_domain *domain, unsigned long iova,
 	return ret ? 0 : size;
 }
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
+/*
+ * iommu_unmap() syncs once after all of its chunks, iommu_unmap_fast()
+ * callers batch as many unmaps as they like before iommu_tlb_sync().
+ */
+static void arm_smmu_iotlb_range_add(struct iommu_domain *domain,
+				     unsigned long iova, size_t size)
+{
+	struct arm_smmu_domain *smmu_domain = to_smmu_domain(domain);
+	unsigned long flags;
+
+	if (arm_smmu_tlb_inv_at_map)
+		return;
+
+	spin_lock_irqsave(&smmu_domain->lock, flags);
+	arm_smmu_tlb_gather_add(smmu_domain, iova, size);
+	spin_unlock_irqrestore(&smmu_domain->lock, flags);
+}
+
+static void arm_smmu_iotlb_sync(struct iommu_domain *domain)
+{
+	struct arm_smmu_domain *smmu_domain = to_smmu_domain(domain);
+	unsigned long flags;
+
+	spin_lock_irqsave(&smmu_domain->lock, flags);
+	arm_smmu_tlb_gather_flush(smmu_domain);
+	spin_unlock_irqrestore(&smmu_domain->lock, flags);
+}
+
+static void arm_smmu_flush_iotlb_all(struct iommu_domain *domain)
+{
+	struct arm_smmu_domain *smmu_domain = to_smmu_domain(domain);
+	unsigned long flags;
+
+	spin_lock_irqsave(&smmu_domain->lock, flags);
+	smmu_domain->tlb_gather_start = 0;
+	smmu_domain->tlb_gather_end = 0;
+	arm_smmu_tlb_inv_context(smmu_domain);
+	spin_unlock_irqrestore(&smmu_domain->lock, flags);
+}
+#endif
+
 static phys_addr_t arm_smmu_iova_to_phys(struct iommu_domain *domain,
 					 dma_addr_t iova)
 {
@@ -2345,6 +2627,9 @@ static phys_addr_t arm_smmu_iova_to_phys(struct iommu_domain *domain,
 	if (pmd_none(pmd))
 		return 0;
 
+	if (arm_smmu_pmd_is_block(pmd))
+		return __pfn_to_phys(pmd_pfn(pmd)) | (iova & ~PMD_MASK);
+
 	pte = *(pmd_page_vaddr(pmd) + pte_index(iova));
 	if (pte_none(pte))
 		return 0;
@@ -2487,12 +2772,17 @@ static const struct iommu_ops arm_smmu_ops = {
 	.detach_dev	= arm_smmu_detach_dev,
 	.get_hwid	= arm_smmu_get_hwid,
 #if LINUX_VERSION_CODE  > KERNEL_VERSION(4, 9, 0)
-	.map_sg		= default_iommu_map_sg,
+	.map_sg		= arm_smmu_map_sg_runs,
 #else
 	.map_sg		= arm_smmu_map_sg,
 #endif
 	.map		= arm_smmu_map,
 	.unmap		= arm_smmu_unmap,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
+	.iotlb_range_add = arm_smmu_iotlb_range_add,
+	.iotlb_sync	= arm_smmu_iotlb_sync,
+	.flush_iotlb_all = arm_smmu_flush_iotlb_all,
+#endif
 	.iova_to_phys	= arm_smmu_iova_to_phys,
 	.add_device	= arm_smmu_add_device,
 	.remove_device	= arm_smmu_remove_device,
@@ -3131,6 +3421,10 @@ static void arm_smmu_debugfs_create(struct arm_smmu_device *smmu)
 			smmu->debugfs_root, &arm_smmu_tlb_inv_by_addr);
 	debugfs_create_bool("tlb_inv_at_map",  S_IRUGO | S_IWUSR,
 			smmu->debugfs_root, &arm_smmu_tlb_inv_at_map);
+	debugfs_create_u32("tlb_inv_ctx_thresh",  S_IRUGO | S_IWUSR,
+			smmu->debugfs_root, &arm_smmu_tlb_inv_ctx_thresh);
+	debugfs_create_bool("block_mapping",  S_IRUGO | S_IWUSR,
+			smmu->debugfs_root, &arm_smmu_block_mapping);
 	return;
 
 err_out:
@@ -3297,6 +3591,9 @@ static int arm_smmu_device_dt_probe(struct platform_device *pdev)
 
 	arm_smmu_device_reset(smmu);
 	arm_smmu_debugfs_create(smmu);
+
+	if (arm_smmu_pmu_init(dev, smmu->base, smmu->num_smmus, smmu->pgshift))
+		dev_warn(dev, "SMMU performance monitor not available\n");
 	return 0;
 
 out_free_irqs:
@@ -3326,6 +3623,7 @@ static int arm_smmu_device_remove(struct platform_device *pdev)
 	if (!smmu)
 		return -ENODEV;
 
+	arm_smmu_pmu_exit();
 	arm_smmu_debugfs_delete(smmu);
 
 	for (node = rb_first(&smmu->masters); node; node = rb_next(node)) {
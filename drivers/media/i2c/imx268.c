@@ -572,11 +572,8 @@ static int imx268_s_stream(struct v4l2_subdev *sd, int enable)
 		return 0;
 	}
 
-	err = imx268_write_table(priv, mode_table[IMX268_MODE_COMMON]);
-	if (err)
-		goto exit;
-
-	err = imx268_write_table(priv, mode_table[s_data->mode]);
+	err = camera_common_write_mode_table_8(s_data, mode_table,
+		IMX268_MODE_COMMON, IMX268_TABLE_WAIT_MS, IMX268_TABLE_END);
 	if (err)
 		goto exit;
 
@@ -601,10 +601,8 @@ static int imx318_s_stream(struct v4l2_subdev *sd, int enable)
 		return 0;
 	}
 
-	err = imx318_write_table(priv, mode_table[IMX318_MODE_COMMON]);
-	if (err)
-		goto exit;
-	err = imx318_write_table(priv, mode_table[s_data->mode]);
+	err = camera_common_write_mode_table_8(s_data, mode_table,
+		IMX318_MODE_COMMON, IMX318_TABLE_WAIT_MS, IMX318_TABLE_END);
 	if (err)
 		goto exit;
 
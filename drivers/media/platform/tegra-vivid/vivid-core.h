@@ -103,6 +103,7 @@ struct vivid_buffer {
 	/* common v4l buffer stuff -- must be first */
 	struct vb2_v4l2_buffer vb;
 	struct list_head	list;
+	u64			queue_ns;
 };
 
 enum vivid_input {
@@ -245,6 +246,8 @@ struct vivid_dev {
 	struct v4l2_ctrl		*ctrl_has_crop_cap;
 	struct v4l2_ctrl		*ctrl_has_compose_cap;
 	struct v4l2_ctrl		*ctrl_has_scaler_cap;
+	struct v4l2_ctrl		*ctrl_bench_cap;
+	struct v4l2_ctrl		*ctrl_bench_fps;
 	struct v4l2_ctrl		*ctrl_has_crop_out;
 	struct v4l2_ctrl		*ctrl_has_compose_out;
 	struct v4l2_ctrl		*ctrl_has_scaler_out;
@@ -408,6 +411,20 @@ struct vivid_dev {
 	u32				vbi_cap_seq_count;
 	bool				vbi_cap_streaming;
 	bool				stream_sliced_vbi_cap;
+
+	/*
+	 * capture benchmark: buffers are rendered once and then handed back
+	 * as they are, at bench_fps frames per second
+	 */
+	bool				bench_cap;
+	unsigned			bench_fps;
+	bool				bench_rendered[VIDEO_MAX_FRAME];
+	u32				bench_late;
+	u64				bench_start_ns;
+	u64				bench_frames;
+	u64				bench_lat_total_ns;
+	u64				bench_lat_min_ns;
+	u64				bench_lat_max_ns;
 	u32				embedded_data_height;
 	u32				fmt_out_metadata_height;
 
@@ -78,6 +78,8 @@
 #define VIVID_CID_TIME_WRAP		(VIVID_CID_VIVID_BASE + 39)
 #define VIVID_CID_MAX_EDID_BLOCKS	(VIVID_CID_VIVID_BASE + 40)
 #define VIVID_CID_PERCENTAGE_FILL	(VIVID_CID_VIVID_BASE + 41)
+#define VIVID_CID_BENCHMARK		(VIVID_CID_VIVID_BASE + 42)
+#define VIVID_CID_BENCHMARK_FPS		(VIVID_CID_VIVID_BASE + 43)
 
 #define VIVID_CID_STD_SIGNAL_MODE	(VIVID_CID_VIVID_BASE + 60)
 #define VIVID_CID_STANDARD		(VIVID_CID_VIVID_BASE + 61)
@@ -421,6 +423,12 @@ static int vivid_vid_cap_s_ctrl(struct v4l2_ctrl *ctrl)
 	case VIVID_CID_OSD_TEXT_MODE:
 		dev->osd_mode = ctrl->val;
 		break;
+	case VIVID_CID_BENCHMARK:
+		dev->bench_cap = ctrl->val;
+		break;
+	case VIVID_CID_BENCHMARK_FPS:
+		dev->bench_fps = ctrl->val;
+		break;
 	case VIVID_CID_PERCENTAGE_FILL:
 		tpg_s_perc_fill(&dev->tpg, ctrl->val);
 		for (i = 0; i < VIDEO_MAX_FRAME; i++)
@@ -761,6 +769,26 @@ static const struct v4l2_ctrl_config vivid_ctrl_perc_fill = {
 	.step = 1,
 };
 
+static const struct v4l2_ctrl_config vivid_ctrl_bench_cap = {
+	.ops = &vivid_vid_cap_ctrl_ops,
+	.id = VIVID_CID_BENCHMARK,
+	.name = "Benchmark Mode",
+	.type = V4L2_CTRL_TYPE_BOOLEAN,
+	.max = 1,
+	.step = 1,
+};
+
+static const struct v4l2_ctrl_config vivid_ctrl_bench_fps = {
+	.ops = &vivid_vid_cap_ctrl_ops,
+	.id = VIVID_CID_BENCHMARK_FPS,
+	.name = "Benchmark Frame Rate",
+	.type = V4L2_CTRL_TYPE_INTEGER,
+	.min = 1,
+	.max = 10000,
+	.def = 1000,
+	.step = 1,
+};
+
 static const struct v4l2_ctrl_config vivid_ctrl_insert_sav = {
 	.ops = &vivid_vid_cap_ctrl_ops,
 	.id = VIVID_CID_INSERT_SAV,
@@ -1610,6 +1638,10 @@ int vivid_create_controls(struct vivid_dev *dev, bool show_ccs_cap,
 		v4l2_ctrl_new_custom(hdl_vid_cap, &vivid_ctrl_vflip, NULL);
 		v4l2_ctrl_new_custom(hdl_vid_cap, &vivid_ctrl_insert_sav, NULL);
 		v4l2_ctrl_new_custom(hdl_vid_cap, &vivid_ctrl_insert_eav, NULL);
+		dev->ctrl_bench_cap = v4l2_ctrl_new_custom(hdl_vid_cap,
+			&vivid_ctrl_bench_cap, NULL);
+		dev->ctrl_bench_fps = v4l2_ctrl_new_custom(hdl_vid_cap,
+			&vivid_ctrl_bench_fps, NULL);
 		if (show_ccs_cap) {
 			dev->ctrl_has_crop_cap = v4l2_ctrl_new_custom(hdl_vid_cap,
 				&vivid_ctrl_has_crop_cap, NULL);
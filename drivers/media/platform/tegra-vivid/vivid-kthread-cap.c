@@ -28,6 +28,7 @@
 #include <linux/videodev2.h>
 #include <linux/kthread.h>
 #include <linux/freezer.h>
+#include <linux/hrtimer.h>
 #include <linux/random.h>
 #include <linux/v4l2-dv-timings.h>
 #include <asm/div64.h>
@@ -484,6 +485,19 @@ static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf)
 	} else {
 		buf->vb.field = dev->field_cap;
 	}
+
+	/*
+	 * In benchmark mode an MMAP buffer keeps the image it was given the
+	 * first time around, so only the metadata has to be refreshed.
+	 */
+	if (dev->bench_cap && !is_loop &&
+	    dev->field_cap != V4L2_FIELD_ALTERNATE &&
+	    buf->vb.vb2_buf.memory == VB2_MEMORY_MMAP) {
+		if (dev->bench_rendered[buf->vb.vb2_buf.index])
+			goto timestamp;
+		dev->bench_rendered[buf->vb.vb2_buf.index] = true;
+	}
+
 	tpg_s_field(tpg, buf->vb.field,
 		    dev->field_cap == V4L2_FIELD_ALTERNATE);
 	tpg_s_perc_fill_blank(tpg, dev->must_blank[buf->vb.vb2_buf.index]);
@@ -593,6 +607,7 @@ static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf)
 		}
 	}
 
+timestamp:
 	/*
 	 * If "End of Frame" is specified at the timestamp source, then take
 	 * the timestamp now.
@@ -896,11 +911,70 @@ static int vivid_thread_vid_cap(void *data)
 	return 0;
 }
 
+/*
+ * Benchmark variant of the capture thread: frames are paced with an
+ * hrtimer at bench_fps instead of following timeperframe in jiffies.
+ */
+static int vivid_thread_vid_cap_bench(void *data)
+{
+	struct vivid_dev *dev = data;
+	ktime_t next;
+	u64 period_ns;
+	bool is_loop;
+
+	dprintk(dev, 1, "Video Capture Benchmark Thread Start\n");
+
+	set_freezable();
+
+	mutex_lock(&dev->mutex);
+	dev->cap_seq_offset = 0;
+	dev->jiffies_vid_cap = jiffies;
+	dev->cap_seq_count = 0;
+	dev->cap_seq_resync = false;
+	dev->next_jiffies_vid_cap = dev->jiffies_vid_cap;
+	dev->cap_thread_active = true;
+	period_ns = div_u64(NSEC_PER_SEC, dev->bench_fps);
+	mutex_unlock(&dev->mutex);
+
+	next = ktime_get();
+	for (;;) {
+		try_to_freeze();
+		if (kthread_should_stop())
+			break;
+
+		mutex_lock(&dev->mutex);
+		is_loop = dev->loop_video && dev->can_loop_video &&
+			(vivid_is_svid_cap(dev) || vivid_is_hdmi_cap(dev));
+		dev->vid_cap_seq_count = dev->cap_seq_count - dev->vid_cap_seq_start;
+		dev->vbi_cap_seq_count = dev->cap_seq_count - dev->vbi_cap_seq_start;
+		vivid_thread_vid_cap_tick(dev, 1);
+		if (is_loop && dev->out_thread_active)
+			vivid_thread_vid_out_tick(dev);
+		dev->cap_seq_count++;
+		mutex_unlock(&dev->mutex);
+
+		next = ktime_add_ns(next, period_ns);
+		if (ktime_before(next, ktime_get())) {
+			/* Missed the slot, restart the cadence from now */
+			dev->bench_late++;
+			next = ktime_get();
+			cond_resched();
+			continue;
+		}
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule_hrtimeout(&next, HRTIMER_MODE_ABS);
+	}
+	dprintk(dev, 1, "Video Capture Benchmark Thread End\n");
+	return 0;
+}
+
 static void vivid_grab_controls(struct vivid_dev *dev, bool grab)
 {
 	v4l2_ctrl_grab(dev->ctrl_has_crop_cap, grab);
 	v4l2_ctrl_grab(dev->ctrl_has_compose_cap, grab);
 	v4l2_ctrl_grab(dev->ctrl_has_scaler_cap, grab);
+	v4l2_ctrl_grab(dev->ctrl_bench_cap, grab);
+	v4l2_ctrl_grab(dev->ctrl_bench_fps, grab);
 }
 
 int vivid_start_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming)
@@ -924,7 +998,9 @@ int vivid_start_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming)
 	dev->vid_cap_seq_start = dev->seq_wrap * 128;
 	dev->vbi_cap_seq_start = dev->seq_wrap * 128;
 
-	dev->kthread_vid_cap = kthread_run(vivid_thread_vid_cap, dev,
+	dev->bench_late = 0;
+	dev->kthread_vid_cap = kthread_run(dev->bench_cap ?
+			vivid_thread_vid_cap_bench : vivid_thread_vid_cap, dev,
 			"%s-vid-cap", dev->v4l2_dev.name);
 
 	if (IS_ERR(dev->kthread_vid_cap)) {
@@ -330,6 +330,21 @@ static void vid_cap_buf_finish(struct vb2_buffer *vb)
 	vivid_trace_single_msg(dev->v4l2_dev.name,
 		"buf_dequeue_capture", vb->index);
 
+	/* queue to dequeue latency, as seen by the application */
+	if (dev->bench_cap && vb2_is_streaming(vb->vb2_queue) &&
+	    vb->state == VB2_BUF_STATE_DONE) {
+		struct vivid_buffer *buf =
+			container_of(vbuf, struct vivid_buffer, vb);
+		u64 lat = ktime_get_ns() - buf->queue_ns;
+
+		dev->bench_frames++;
+		dev->bench_lat_total_ns += lat;
+		if (lat < dev->bench_lat_min_ns)
+			dev->bench_lat_min_ns = lat;
+		if (lat > dev->bench_lat_max_ns)
+			dev->bench_lat_max_ns = lat;
+	}
+
 	if (!vivid_is_sdtv_cap(dev))
 		return;
 
@@ -356,6 +371,7 @@ static void vid_cap_buf_queue(struct vb2_buffer *vb)
 
 	dprintk(dev, 1, "%s\n", __func__);
 
+	buf->queue_ns = ktime_get_ns();
 	spin_lock(&dev->slock);
 	list_add_tail(&buf->list, &dev->vid_cap_active);
 	spin_unlock(&dev->slock);
@@ -372,6 +388,13 @@ static int vid_cap_start_streaming(struct vb2_queue *vq, unsigned count)
 	if (vb2_is_streaming(&dev->vb_vid_out_q))
 		dev->can_loop_video = vivid_vid_can_loop(dev);
 
+	memset(dev->bench_rendered, 0, sizeof(dev->bench_rendered));
+	dev->bench_start_ns = ktime_get_ns();
+	dev->bench_frames = 0;
+	dev->bench_lat_total_ns = 0;
+	dev->bench_lat_min_ns = U64_MAX;
+	dev->bench_lat_max_ns = 0;
+
 	if (dev->kthread_vid_cap)
 		return 0;
 
@@ -405,6 +428,7 @@ static void vid_cap_stop_streaming(struct vb2_queue *vq)
 	dprintk(dev, 1, "%s\n", __func__);
 	vivid_stop_generating_vid_cap(dev, &dev->vid_cap_streaming);
 	dev->can_loop_video = false;
+	vivid_bench_cap_log_status(dev);
 }
 
 const struct vb2_ops vivid_vid_cap_qops = {
@@ -418,6 +442,29 @@ const struct vb2_ops vivid_vid_cap_qops = {
 	.wait_finish		= vb2_ops_wait_finish,
 };
 
+void vivid_bench_cap_log_status(struct vivid_dev *dev)
+{
+	u64 elapsed_us, fps_x100;
+
+	if (!dev->bench_cap || !dev->bench_frames)
+		return;
+
+	elapsed_us = div_u64(ktime_get_ns() - dev->bench_start_ns,
+			     NSEC_PER_USEC);
+	fps_x100 = div64_u64(dev->bench_frames * 100 * USEC_PER_SEC,
+			     elapsed_us ? elapsed_us : 1);
+	v4l2_info(&dev->v4l2_dev,
+		  "benchmark: %llu frames in %llu ms, %llu.%02llu fps, %u late\n",
+		  dev->bench_frames, div_u64(elapsed_us, USEC_PER_MSEC),
+		  div_u64(fps_x100, 100), fps_x100 % 100, dev->bench_late);
+	v4l2_info(&dev->v4l2_dev,
+		  "benchmark: qbuf to dqbuf latency min/avg/max %llu/%llu/%llu us\n",
+		  div_u64(dev->bench_lat_min_ns, NSEC_PER_USEC),
+		  div64_u64(dev->bench_lat_total_ns,
+			    dev->bench_frames * NSEC_PER_USEC),
+		  div_u64(dev->bench_lat_max_ns, NSEC_PER_USEC));
+}
+
 /*
  * Determine the 'picture' quality based on the current TV frequency: either
  * COLOR for a good 'signal', GRAY (grayscale picture) for a slightly off
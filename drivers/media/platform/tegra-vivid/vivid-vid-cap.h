@@ -23,6 +23,7 @@
 void vivid_update_quality(struct vivid_dev *dev);
 void vivid_update_format_cap(struct vivid_dev *dev, bool keep_controls);
 enum tpg_video_aspect vivid_get_video_aspect(const struct vivid_dev *dev);
+void vivid_bench_cap_log_status(struct vivid_dev *dev);
 
 extern const v4l2_std_id vivid_standard[];
 extern const char * const vivid_ctrl_standard_strings[];
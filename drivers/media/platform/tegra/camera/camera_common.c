@@ -820,6 +820,7 @@ int camera_common_s_power(struct v4l2_subdev *sd, int on)
 		}
 	} else {
 		call_s_op(s_data, power_off);
+		s_data->programmed_mode_idx = -1;
 		if (tegra_platform_is_silicon()) {
 			camera_common_dpd_enable(s_data);
 			camera_common_mclk_disable(s_data);
@@ -882,6 +883,8 @@ int camera_common_initialize(struct camera_common_data *s_data,
 	if (s_data->dev == NULL)
 		return -EINVAL;
 
+	s_data->programmed_mode_idx = -1;
+
 	err = camera_common_parse_ports(s_data->dev, s_data);
 	if (err) {
 		dev_err(s_data->dev, "Failed to find port info.\n");
@@ -918,6 +921,79 @@ void camera_common_cleanup(struct camera_common_data *s_data)
 }
 EXPORT_SYMBOL_GPL(camera_common_cleanup);
 
+/*
+ * Modes parsed from DT at probe time that run the sensor with the same
+ * clocks and CSI lanes, such as the HDR and linear variants of a
+ * resolution, can be switched between without starting over.
+ */
+bool camera_common_mode_switch_is_delta(struct camera_common_data *s_data,
+		int from_idx, int to_idx)
+{
+	const struct sensor_properties *props = &s_data->sensor_props;
+	const struct sensor_signal_properties *from, *to;
+
+	if (from_idx < 0 || to_idx < 0 ||
+		from_idx >= props->num_modes || to_idx >= props->num_modes)
+		return false;
+
+	from = &props->sensor_modes[from_idx].signal_properties;
+	to = &props->sensor_modes[to_idx].signal_properties;
+
+	return from->num_lanes == to->num_lanes &&
+		from->mclk_freq == to->mclk_freq &&
+		from->pixel_clock.val == to->pixel_clock.val &&
+		from->cil_settletime == to->cil_settletime &&
+		from->discontinuous_clk == to->discontinuous_clk &&
+		from->phy_mode == to->phy_mode;
+}
+EXPORT_SYMBOL_GPL(camera_common_mode_switch_is_delta);
+
+/*
+ * Program the mode selected by the last set format. If the sensor still
+ * holds a mode it can switch from in place, only the registers that
+ * differ between the two mode tables are written. Otherwise the common
+ * table and the whole mode table are written as for a fresh stream.
+ */
+int camera_common_write_mode_table_8(struct camera_common_data *s_data,
+		struct reg_8 *const mode_table[], int common_mode,
+		u16 wait_ms_addr, u16 end_addr)
+{
+	int prev_idx = s_data->programmed_mode_idx;
+	int idx = s_data->mode_prop_idx;
+	int err;
+
+	s_data->programmed_mode_idx = -1;
+
+	if (prev_idx == idx) {
+		s_data->programmed_mode_idx = idx;
+		return 0;
+	}
+
+	if (camera_common_mode_switch_is_delta(s_data, prev_idx, idx)) {
+		dev_dbg(s_data->dev, "%s: delta switch from mode %d to %d\n",
+			__func__, prev_idx, idx);
+		err = regmap_util_write_table_8_delta(s_data->regmap,
+				mode_table[s_data->frmfmt[prev_idx].mode],
+				mode_table[s_data->mode],
+				wait_ms_addr, end_addr);
+	} else {
+		err = regmap_util_write_table_8(s_data->regmap,
+				mode_table[common_mode], NULL, 0,
+				wait_ms_addr, end_addr);
+		if (err)
+			return err;
+		err = regmap_util_write_table_8(s_data->regmap,
+				mode_table[s_data->mode], NULL, 0,
+				wait_ms_addr, end_addr);
+	}
+
+	if (err == 0)
+		s_data->programmed_mode_idx = idx;
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(camera_common_write_mode_table_8);
+
 int camera_common_focuser_init(struct camera_common_focuser_data *s_data)
 {
 	int err = 0;
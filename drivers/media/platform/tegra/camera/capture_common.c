@@ -14,6 +14,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/nvhost.h>
 #include <linux/slab.h>
+#include <linux/uaccess.h>
 #include <media/capture_common.h>
 #include <media/mc_common.h>
 
@@ -173,7 +174,19 @@ int capture_common_request_pin_and_reloc(struct capture_common_pin_req *req)
 		dev_dbg(req->dev, "%s: hmem:0x%x offset:0x%x\n", __func__,
 				mem, target_offset);
 
-		if (mem == req->requests_mem) {
+		if (mem & CAPTURE_BUFFER_POOL_SLOT) {
+			uint32_t slot = mem & ~CAPTURE_BUFFER_POOL_SLOT;
+
+			if (req->pool == NULL || slot >= req->pool->num_slots) {
+				dev_err(req->dev,
+					"%s: invalid buffer pool slot %u\n",
+					__func__, slot);
+				err = -EINVAL;
+				goto pin_fail;
+			}
+			target_phys_addr = req->pool->slots[slot].iova +
+					target_offset;
+		} else if (mem == req->requests_mem) {
 			target_phys_addr = req->requests_dev->iova +
 					req->request_offset + target_offset;
 		} else {
@@ -235,3 +248,74 @@ reloc_fail:
 
 	return err;
 }
+
+int capture_common_buf_pool_setup(struct device *dev,
+		struct capture_common_buf_pool *pool,
+		const struct capture_buffer_pool_req *req)
+{
+	struct capture_common_buf *slots;
+	uint32_t *mems;
+	int i;
+	int err = 0;
+
+	if (pool->num_slots) {
+		dev_err(dev, "%s: buffer pool already set up\n", __func__);
+		return -EEXIST;
+	}
+
+	if (req->num_buffers == 0 ||
+			req->num_buffers > CAPTURE_BUFFER_POOL_MAX_SLOTS)
+		return -EINVAL;
+
+	mems = kcalloc(req->num_buffers, sizeof(*mems), GFP_KERNEL);
+	slots = kcalloc(req->num_buffers, sizeof(*slots), GFP_KERNEL);
+	if (unlikely(mems == NULL || slots == NULL)) {
+		err = -ENOMEM;
+		goto fail;
+	}
+
+	if (copy_from_user(mems, (void __user *)(uintptr_t)req->mems,
+			req->num_buffers * sizeof(*mems))) {
+		err = -EFAULT;
+		goto fail;
+	}
+
+	for (i = 0; i < req->num_buffers; i++) {
+		err = capture_common_pin_memory(dev, mems[i], &slots[i]);
+		if (err < 0) {
+			dev_err(dev, "%s: pin of pool slot %d failed\n",
+				__func__, i);
+			goto unpin;
+		}
+	}
+
+	kfree(mems);
+	pool->slots = slots;
+	pool->num_slots = req->num_buffers;
+
+	dev_dbg(dev, "%s: pinned %u pool buffers\n", __func__,
+			pool->num_slots);
+
+	return 0;
+
+unpin:
+	while (--i >= 0)
+		capture_common_unpin_memory(&slots[i]);
+fail:
+	kfree(slots);
+	kfree(mems);
+	return err;
+}
+
+/* no request referring to the pool may be in flight */
+void capture_common_buf_pool_release(struct capture_common_buf_pool *pool)
+{
+	int i;
+
+	for (i = 0; i < pool->num_slots; i++)
+		capture_common_unpin_memory(&pool->slots[i]);
+
+	kfree(pool->slots);
+	pool->slots = NULL;
+	pool->num_slots = 0;
+}
@@ -70,6 +70,9 @@ struct isp_capture {
 
 	struct mutex control_msg_lock;
 	struct CAPTURE_CONTROL_MSG control_resp_msg;
+
+	/* buffers pinned for the lifetime of the channel */
+	struct capture_common_buf_pool buffer_pool;
 };
 
 static void isp_capture_ivc_control_callback(const void *ivc_resp,
@@ -215,6 +218,8 @@ void isp_capture_shutdown(struct tegra_isp_channel *chan)
 	if (capture->channel_id != CAPTURE_CHANNEL_ISP_INVALID_ID)
 		isp_capture_release(chan, 0);
 
+	capture_common_buf_pool_release(&capture->buffer_pool);
+
 	kfree(capture);
 	chan->capture_data = NULL;
 }
@@ -990,6 +995,8 @@ int isp_capture_program_request(struct tegra_isp_channel *chan,
 	cap_common_req.reloc_user = (uint32_t __user *)
 			(uintptr_t)req->isp_program_relocs.reloc_relatives;
 
+	cap_common_req.pool = &capture->buffer_pool;
+
 	err = capture_common_request_pin_and_reloc(&cap_common_req);
 	if (err < 0) {
 		dev_err(chan->isp_dev, "request pin and reloc failed\n");
@@ -1117,6 +1124,8 @@ int isp_capture_request(struct tegra_isp_channel *chan,
 	cap_common_req.reloc_user = (uint32_t __user *)
 			(uintptr_t)req->isp_relocs.reloc_relatives;
 
+	cap_common_req.pool = &capture->buffer_pool;
+
 	err = capture_common_request_pin_and_reloc(&cap_common_req);
 	if (err < 0) {
 		dev_err(chan->isp_dev, "request pin and reloc failed\n");
@@ -1214,3 +1223,29 @@ int isp_capture_request_ex(struct tegra_isp_channel *chan,
 
 	return ret;
 }
+
+int isp_capture_set_buffer_pool(struct tegra_isp_channel *chan,
+		struct capture_buffer_pool_req *req)
+{
+	struct isp_capture *capture = chan->capture_data;
+
+	if (capture == NULL) {
+		dev_err(chan->isp_dev,
+			"%s: isp capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	if (capture->channel_id != CAPTURE_CHANNEL_ISP_INVALID_ID) {
+		dev_err(chan->isp_dev,
+			"%s: already setup, release first\n", __func__);
+		return -EBUSY;
+	}
+
+	if (req->num_buffers == 0) {
+		capture_common_buf_pool_release(&capture->buffer_pool);
+		return 0;
+	}
+
+	return capture_common_buf_pool_setup(chan->isp_dev,
+			&capture->buffer_pool, req);
+}
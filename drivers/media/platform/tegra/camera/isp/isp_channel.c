@@ -30,6 +30,7 @@
 #include <linux/stddef.h>
 #include <linux/uaccess.h>
 
+#include <media/capture_common.h>
 #include <media/capture_isp.h>
 #include <media/isp_channel.h>
 
@@ -55,6 +56,8 @@
 		_IOW('I', 8, __u32)
 #define ISP_CAPTURE_REQUEST_EX \
 		_IOW('I', 9, struct isp_capture_req_ex)
+#define ISP_CAPTURE_SET_BUFFER_POOL \
+		_IOW('I', 10, struct capture_buffer_pool_req)
 
 
 struct isp_channel_drv {
@@ -168,6 +171,18 @@ static long isp_channel_ioctl(struct file *file, unsigned int cmd,
 		break;
 	}
 
+	case _IOC_NR(ISP_CAPTURE_SET_BUFFER_POOL): {
+		struct capture_buffer_pool_req pool;
+
+		if (copy_from_user(&pool, ptr, sizeof(pool)))
+			break;
+		err = isp_capture_set_buffer_pool(chan, &pool);
+		if (err)
+			dev_err(chan->isp_dev,
+				"isp capture buffer pool setup failed\n");
+		break;
+	}
+
 	default: {
 		dev_err(chan->isp_dev, "%s:Unknown ioctl\n", __func__);
 		return -ENOIOCTLCMD;
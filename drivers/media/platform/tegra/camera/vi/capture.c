@@ -27,6 +27,22 @@
 #define NVCSI_STREAM_INVALID_ID 0xFFFF
 #define NVCSI_TPG_INVALID_ID 0xFFFF
 
+/*
+ * Channels set up with the same gang id share one progress syncpoint, so
+ * that a set of frames captured by the whole gang can be waited for with a
+ * single fence. The first member to be set up allocates the syncpoint and
+ * the last one to be released frees it.
+ */
+struct vi_capture_gang {
+	struct list_head list;
+	uint32_t id;
+	unsigned int members;
+	struct syncpoint_info progress_sp;
+};
+
+static LIST_HEAD(vi_capture_gangs);
+static DEFINE_MUTEX(vi_capture_gangs_lock);
+
 static void vi_capture_ivc_control_callback(const void *ivc_resp,
 		const void *pcontext)
 {
@@ -82,6 +98,7 @@ static void vi_capture_ivc_status_callback(const void *ivc_resp,
 	struct CAPTURE_MSG *status_msg = (struct CAPTURE_MSG *)ivc_resp;
 	struct vi_capture *capture = (struct vi_capture *)pcontext;
 	struct tegra_vi_channel *chan = capture->vi_channel;
+	void (*notify)(void *data, uint32_t buffer_index);
 	uint32_t buffer_index;
 
 	if (unlikely(capture == NULL)) {
@@ -104,6 +121,10 @@ static void vi_capture_ivc_status_callback(const void *ivc_resp,
 			buffer_index * capture->request_size,
 			capture->request_size, DMA_FROM_DEVICE);
 		complete(&capture->capture_resp);
+		notify = READ_ONCE(capture->status_notify);
+		if (notify)
+			notify(READ_ONCE(capture->status_notify_data),
+				buffer_index);
 		dev_dbg(chan->dev, "%s: status chan_id %u msg_id %u\n",
 				__func__, status_msg->header.channel_id,
 				status_msg->header.msg_id);
@@ -175,6 +196,8 @@ void vi_capture_shutdown(struct tegra_vi_channel *chan)
 	if (capture->stream_id != NVCSI_STREAM_INVALID_ID)
 		csi_stream_release(chan);
 
+	capture_common_buf_pool_release(&capture->buffer_pool);
+
 	kfree(capture);
 	chan->capture_data = NULL;
 }
@@ -230,6 +253,10 @@ fail:
 static int vi_capture_setup_syncpts(struct tegra_vi_channel *chan,
 				uint32_t flags);
 static void vi_capture_release_syncpts(struct tegra_vi_channel *chan);
+static int vi_capture_read_syncpt(struct tegra_vi_channel *chan,
+		struct syncpoint_info *sp, uint32_t *val);
+static void vi_capture_release_syncpt(struct tegra_vi_channel *chan,
+				struct syncpoint_info *sp);
 
 static int vi_capture_setup_syncpt(struct tegra_vi_channel *chan,
 				const char *name, bool enable,
@@ -270,6 +297,83 @@ cleanup:
 	return err;
 }
 
+static int vi_capture_setup_progress_syncpt(struct tegra_vi_channel *chan)
+{
+	struct vi_capture *capture = chan->capture_data;
+	struct vi_capture_gang *gang;
+	int err = 0;
+
+	if (capture->gang_id == 0)
+		return vi_capture_setup_syncpt(chan, "progress", true,
+				&capture->progress_sp);
+
+	mutex_lock(&vi_capture_gangs_lock);
+
+	list_for_each_entry(gang, &vi_capture_gangs, list) {
+		if (gang->id == capture->gang_id) {
+			capture->progress_sp = gang->progress_sp;
+			err = nvhost_syncpt_read_ext_check(chan->ndev,
+					gang->progress_sp.id,
+					&capture->progress_sp.threshold);
+			if (err) {
+				memset(&capture->progress_sp, 0,
+					sizeof(capture->progress_sp));
+				goto unlock;
+			}
+			goto join;
+		}
+	}
+
+	gang = kzalloc(sizeof(*gang), GFP_KERNEL);
+	if (gang == NULL) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	err = vi_capture_setup_syncpt(chan, "progress", true,
+			&gang->progress_sp);
+	if (err) {
+		kfree(gang);
+		goto unlock;
+	}
+
+	gang->id = capture->gang_id;
+	list_add_tail(&gang->list, &vi_capture_gangs);
+	capture->progress_sp = gang->progress_sp;
+
+join:
+	gang->members++;
+	capture->gang = gang;
+	dev_dbg(chan->dev, "gang %u: %u members on syncpt %u\n",
+			gang->id, gang->members, gang->progress_sp.id);
+unlock:
+	mutex_unlock(&vi_capture_gangs_lock);
+
+	return err;
+}
+
+static void vi_capture_release_progress_syncpt(struct tegra_vi_channel *chan)
+{
+	struct vi_capture *capture = chan->capture_data;
+	struct vi_capture_gang *gang = capture->gang;
+
+	if (gang == NULL) {
+		vi_capture_release_syncpt(chan, &capture->progress_sp);
+		return;
+	}
+
+	mutex_lock(&vi_capture_gangs_lock);
+	if (--gang->members == 0) {
+		list_del(&gang->list);
+		vi_capture_release_syncpt(chan, &gang->progress_sp);
+		kfree(gang);
+	}
+	mutex_unlock(&vi_capture_gangs_lock);
+
+	capture->gang = NULL;
+	memset(&capture->progress_sp, 0, sizeof(capture->progress_sp));
+}
+
 static int vi_capture_setup_syncpts(struct tegra_vi_channel *chan,
 				uint32_t flags)
 {
@@ -280,8 +384,7 @@ static int vi_capture_setup_syncpts(struct tegra_vi_channel *chan,
 				&capture->num_gos_tables,
 				&capture->gos_tables);
 
-	err = vi_capture_setup_syncpt(chan, "progress", true,
-			&capture->progress_sp);
+	err = vi_capture_setup_progress_syncpt(chan);
 	if (err < 0)
 		goto fail;
 
@@ -317,7 +420,7 @@ static void vi_capture_release_syncpts(struct tegra_vi_channel *chan)
 {
 	struct vi_capture *capture = chan->capture_data;
 
-	vi_capture_release_syncpt(chan, &capture->progress_sp);
+	vi_capture_release_progress_syncpt(chan);
 	vi_capture_release_syncpt(chan, &capture->embdata_sp);
 	vi_capture_release_syncpt(chan, &capture->linetimer_sp);
 }
@@ -490,12 +593,105 @@ int vi_capture_reset(struct tegra_vi_channel *chan,
 		err = -EINVAL;
 	}
 
-	return 0;
-
 submit_fail:
 	return err;
 }
 
+/*
+ * Recover from a single failed capture, e.g. a corrupt frame or a CSI
+ * error reported in the capture status, without resetting the channel.
+ * The camera processor is already done with the request slot, so only
+ * the progress syncpoint threshold needs to catch up with the hardware.
+ * Buffers stay pinned and the channel stays set up.
+ */
+int vi_capture_recover(struct tegra_vi_channel *chan,
+		uint32_t buffer_index)
+{
+	struct vi_capture *capture = chan->capture_data;
+	uint32_t val;
+	int err;
+
+	if (capture == NULL) {
+		dev_err(chan->dev,
+			 "%s: vi capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	if (capture->channel_id == CAPTURE_CHANNEL_INVALID_ID) {
+		dev_err(chan->dev,
+			"%s: setup channel first\n", __func__);
+		return -ENODEV;
+	}
+
+	if (buffer_index >= capture->queue_depth) {
+		dev_err(chan->dev,
+			"%s: invalid buffer index %u\n", __func__,
+			buffer_index);
+		return -EINVAL;
+	}
+
+	if (capture->progress_sp.id == 0)
+		return 0;
+
+	err = vi_capture_read_syncpt(chan, &capture->progress_sp, &val);
+	if (err < 0)
+		return err;
+
+	capture->progress_sp.threshold = val;
+
+	dev_dbg(chan->dev, "%s: slot %u, progress syncpt %u at %u\n",
+		__func__, buffer_index, capture->progress_sp.id, val);
+
+	return 0;
+}
+
+int vi_capture_set_buffer_pool(struct tegra_vi_channel *chan,
+		struct capture_buffer_pool_req *req)
+{
+	struct vi_capture *capture = chan->capture_data;
+
+	if (capture == NULL) {
+		dev_err(chan->dev,
+			 "%s: vi capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	if (capture->channel_id != CAPTURE_CHANNEL_INVALID_ID) {
+		dev_err(chan->dev,
+			"%s: already setup, release first\n", __func__);
+		return -EBUSY;
+	}
+
+	if (req->num_buffers == 0) {
+		capture_common_buf_pool_release(&capture->buffer_pool);
+		return 0;
+	}
+
+	return capture_common_buf_pool_setup(chan->dev, &capture->buffer_pool,
+			req);
+}
+
+int vi_capture_set_gang(struct tegra_vi_channel *chan, uint32_t gang_id)
+{
+	struct vi_capture *capture = chan->capture_data;
+
+	if (capture == NULL) {
+		dev_err(chan->dev,
+			 "%s: vi capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	if (capture->channel_id != CAPTURE_CHANNEL_INVALID_ID) {
+		dev_err(chan->dev,
+			"%s: already setup, release first\n", __func__);
+		return -EBUSY;
+	}
+
+	capture->gang_id = gang_id;
+
+	return 0;
+}
+
 int vi_capture_set_compand(struct tegra_vi_channel *chan,
 		struct vi_capture_compand *compand)
 {
@@ -936,6 +1132,11 @@ int vi_capture_status(struct tegra_vi_channel *chan,
 		return -ENODEV;
 	}
 
+	/* zero timeout only picks up a status that has already arrived */
+	if (timeout_ms == 0)
+		return try_wait_for_completion(&capture->capture_resp) ?
+			0 : -EAGAIN;
+
 	dev_dbg(chan->dev, "%s: waiting for status, timeout:%d ms\n",
 		__func__, timeout_ms);
 
@@ -961,3 +1162,16 @@ int vi_capture_status(struct tegra_vi_channel *chan,
 
 	return 0;
 }
+
+void vi_capture_set_status_notify(struct tegra_vi_channel *chan,
+		void (*notify)(void *data, uint32_t buffer_index), void *data)
+{
+	struct vi_capture *capture = chan->capture_data;
+
+	if (capture == NULL)
+		return;
+
+	/* only changed while no captures are in flight */
+	WRITE_ONCE(capture->status_notify_data, data);
+	WRITE_ONCE(capture->status_notify, notify);
+}
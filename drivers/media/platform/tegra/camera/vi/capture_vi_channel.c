@@ -44,6 +44,9 @@
 #define VI_CAPTURE_REQUEST	_IOW('I', 6, struct vi_capture_req)
 #define VI_CAPTURE_STATUS	_IOW('I', 7, __u32)
 #define VI_CAPTURE_SET_COMPAND	_IOW('I', 8, struct vi_capture_compand)
+#define VI_CAPTURE_SET_GANG	_IOW('I', 9, __u32)
+#define VI_CAPTURE_SET_BUFFER_POOL	\
+		_IOW('I', 10, struct capture_buffer_pool_req)
 
 struct vi_channel_drv {
 	struct device *dev;
@@ -199,6 +202,7 @@ static long vi_channel_ioctl(struct file *file, unsigned int cmd,
 		cap_common_req.num_relocs = req.num_relocs;
 		cap_common_req.reloc_user = (uint32_t __user *)
 				(uintptr_t)req.reloc_relatives;
+		cap_common_req.pool = &capture->buffer_pool;
 
 		err = capture_common_request_pin_and_reloc(&cap_common_req);
 		if (err < 0) {
@@ -245,6 +249,30 @@ static long vi_channel_ioctl(struct file *file, unsigned int cmd,
 		break;
 	}
 
+	case _IOC_NR(VI_CAPTURE_SET_GANG): {
+		uint32_t gang_id;
+
+		if (copy_from_user(&gang_id, ptr, sizeof(gang_id)))
+			break;
+		err = vi_capture_set_gang(chan, gang_id);
+		if (err < 0)
+			dev_err(chan->dev,
+				"setting capture gang failed\n");
+		break;
+	}
+
+	case _IOC_NR(VI_CAPTURE_SET_BUFFER_POOL): {
+		struct capture_buffer_pool_req pool;
+
+		if (copy_from_user(&pool, ptr, sizeof(pool)))
+			break;
+		err = vi_capture_set_buffer_pool(chan, &pool);
+		if (err < 0)
+			dev_err(chan->dev,
+				"setting capture buffer pool failed\n");
+		break;
+	}
+
 	default: {
 		dev_err(chan->dev, "%s:Unknown ioctl\n", __func__);
 		return -ENOIOCTLCMD;
@@ -13,6 +13,7 @@
 #include <linux/atomic.h>
 #include <linux/bitmap.h>
 #include <linux/clk.h>
+#include <linux/debugfs.h>
 #include <linux/delay.h>
 #include <linux/nvhost.h>
 #include <linux/lcm.h>
@@ -23,6 +24,7 @@
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/semaphore.h>
+#include <linux/seq_file.h>
 
 #include <media/v4l2-ctrls.h>
 #include <media/v4l2-event.h>
@@ -38,6 +40,7 @@
 #include <media/vi.h>
 
 #include <linux/clk/tegra.h>
+#include <linux/platform/tegra/ptp-notifier.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/camera_common.h>
 
@@ -332,6 +335,137 @@ void set_timestamp(struct tegra_channel_buffer *buf,
 #endif
 }
 
+/*
+ * Put the PTP time of a TSC timestamp in the buffer timecode. The four
+ * frames..hours bytes carry the low and the userbits the high 32 bits of
+ * the PTP time in ns, least significant byte first.
+ */
+void set_ptp_timestamp(struct tegra_channel_buffer *buf, u64 tsc_ns)
+{
+	struct v4l2_timecode *tc = &buf->buf.timecode;
+	u64 ptp_ns;
+	int i;
+
+	if (get_ptp_hwtime_from_tsc(tsc_ns, &ptp_ns))
+		return;
+
+	tc->type = 0;
+	tc->flags = V4L2_TC_USERBITS_USERDEFINED;
+	tc->frames = ptp_ns;
+	tc->seconds = ptp_ns >> 8;
+	tc->minutes = ptp_ns >> 16;
+	tc->hours = ptp_ns >> 24;
+	for (i = 0; i < ARRAY_SIZE(tc->userbits); i++)
+		tc->userbits[i] = ptp_ns >> (32 + 8 * i);
+
+	buf->buf.flags |= V4L2_BUF_FLAG_TIMECODE;
+}
+
+/*
+ * Account one frame in the latency histogram of a capture stage. Each
+ * stage has a single writer, the thread completing the channel's
+ * captures, so no locking is needed; readers may see a torn update.
+ */
+void tegra_channel_latency_record(struct tegra_channel *chan,
+			enum tegra_channel_latency_stage stage,
+			u64 start_ns, u64 end_ns)
+{
+	struct tegra_channel_latency *lat = &chan->latency[stage];
+	u64 delta;
+	int bucket;
+
+	if (!start_ns || end_ns < start_ns)
+		return;
+
+	delta = end_ns - start_ns;
+	bucket = min_t(int, fls64(div_u64(delta, NSEC_PER_USEC)),
+			TEGRA_CHANNEL_LATENCY_BUCKETS - 1);
+
+	lat->buckets[bucket]++;
+	lat->count++;
+	lat->total_ns += delta;
+	if (delta > lat->max_ns)
+		lat->max_ns = delta;
+}
+
+static const char * const tegra_channel_latency_names[] = {
+	[TEGRA_CHANNEL_LATENCY_SOF_EOF] = "sof-eof",
+	[TEGRA_CHANNEL_LATENCY_EOF_STATUS] = "eof-status",
+	[TEGRA_CHANNEL_LATENCY_STATUS_DONE] = "status-done",
+};
+
+static int tegra_channel_latency_show(struct seq_file *s, void *unused)
+{
+	struct tegra_channel *chan = s->private;
+	int stage, i;
+
+	for (stage = 0; stage < TEGRA_CHANNEL_LATENCY_STAGES; stage++) {
+		struct tegra_channel_latency *lat = &chan->latency[stage];
+		u64 count = READ_ONCE(lat->count);
+
+		seq_printf(s, "%s: count %llu avg %llu us max %llu us\n",
+			tegra_channel_latency_names[stage], count,
+			count ? div64_u64(READ_ONCE(lat->total_ns), count) /
+				NSEC_PER_USEC : 0,
+			div_u64(READ_ONCE(lat->max_ns), NSEC_PER_USEC));
+
+		for (i = 0; i < TEGRA_CHANNEL_LATENCY_BUCKETS; i++) {
+			u32 n = READ_ONCE(lat->buckets[i]);
+
+			if (!n)
+				continue;
+			if (i == TEGRA_CHANNEL_LATENCY_BUCKETS - 1)
+				seq_printf(s, "  >= %u us: %u\n",
+					1U << (i - 1), n);
+			else
+				seq_printf(s, "  < %u us: %u\n", 1U << i, n);
+		}
+	}
+
+	return 0;
+}
+
+static int tegra_channel_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_channel_latency_show, inode->i_private);
+}
+
+/* Any write clears the histograms */
+static ssize_t tegra_channel_latency_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *offp)
+{
+	struct seq_file *s = file->private_data;
+	struct tegra_channel *chan = s->private;
+
+	memset(chan->latency, 0, sizeof(chan->latency));
+
+	return count;
+}
+
+static const struct file_operations tegra_channel_latency_fops = {
+	.open		= tegra_channel_latency_open,
+	.read		= seq_read,
+	.write		= tegra_channel_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void tegra_channel_create_debugfs(struct tegra_channel *chan)
+{
+	chan->debugdir = debugfs_create_dir(chan->video.name, NULL);
+	if (IS_ERR_OR_NULL(chan->debugdir)) {
+		chan->debugdir = NULL;
+		return;
+	}
+
+	if (!debugfs_create_file("latency", S_IWUSR | S_IRUGO,
+			chan->debugdir, chan, &tegra_channel_latency_fops)) {
+		dev_err(chan->vi->dev, "couldn't create debugfs\n");
+		debugfs_remove_recursive(chan->debugdir);
+		chan->debugdir = NULL;
+	}
+}
+
 void release_buffer(struct tegra_channel *chan,
 			struct tegra_channel_buffer *buf)
 {
@@ -666,6 +800,9 @@ static void tegra_channel_buffer_queue(struct vb2_buffer *vb)
 
 	/* Wake up kthread for capture */
 	wake_up_interruptible(&chan->start_wait);
+
+	if (chan->vi->fops->vi_buffer_queued)
+		chan->vi->fops->vi_buffer_queued(chan);
 }
 
 
@@ -1137,6 +1274,9 @@ int tegra_channel_s_ctrl(struct v4l2_ctrl *ctrl)
 	case TEGRA_CAMERA_CID_LOW_LATENCY:
 		chan->low_latency = ctrl->val;
 		break;
+	case TEGRA_CAMERA_CID_PTP_TIMESTAMP:
+		chan->ptp_timestamp = ctrl->val;
+		break;
 	default:
 		dev_err(&chan->video.dev, "%s: Invalid ctrl %u\n",
 			__func__, ctrl->id);
@@ -1271,6 +1411,16 @@ static const struct v4l2_ctrl_config common_custom_ctrls[] = {
 		.max = 1,
 		.step = 1,
 	},
+	{
+		.ops = &channel_ctrl_ops,
+		.id = TEGRA_CAMERA_CID_PTP_TIMESTAMP,
+		.name = "PTP Timestamp",
+		.type = V4L2_CTRL_TYPE_BOOLEAN,
+		.def = 0,
+		.min = 0,
+		.max = 1,
+		.step = 1,
+	},
 };
 
 #define GET_TEGRA_CAMERA_CTRL(id, c)					\
@@ -2103,6 +2253,7 @@ int tegra_channel_init(struct tegra_channel *chan)
 	INIT_LIST_HEAD(&chan->dequeue);
 	init_waitqueue_head(&chan->dequeue_wait);
 	spin_lock_init(&chan->dequeue_lock);
+	INIT_LIST_HEAD(&chan->capture_engine_entry);
 	sema_init(&chan->capture_slots, CAPTURE_QUEUE_DEPTH);
 	mutex_init(&chan->stop_kthread_lock);
 	atomic_set(&chan->is_streaming, DISABLE);
@@ -2183,6 +2334,8 @@ int tegra_channel_init(struct tegra_channel *chan)
 		goto deskew_ctx_err;
 	}
 
+	tegra_channel_create_debugfs(chan);
+
 	chan->init_done = true;
 
 	return 0;
@@ -2222,6 +2375,9 @@ int tegra_channel_cleanup(struct tegra_channel *chan)
 
 	tegra_camera_device_unregister(chan);
 
+	debugfs_remove_recursive(chan->debugdir);
+	chan->debugdir = NULL;
+
 	media_entity_cleanup(&chan->video.entity);
 
 	return 0;
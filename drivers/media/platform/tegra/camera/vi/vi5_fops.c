@@ -9,11 +9,11 @@
  * it under the terms of the GNU General Public License version 2 as
  * published by the Free Software Foundation.
  */
-#include <linux/freezer.h>
-#include <linux/kthread.h>
+#include <asm/arch_timer.h>
 #include <linux/nvhost.h>
 #include <linux/tegra-powergate.h>
 #include <linux/semaphore.h>
+#include <linux/workqueue.h>
 #include <media/tegra_camera_platform.h>
 #include <media/mc_common.h>
 #include <media/capture_vi_channel.h>
@@ -30,8 +30,7 @@
 #define VI_CSI_CLK_SCALE	110
 #define PG_BITRATE		32
 #define	STREAM		0U
-
-static void tegra_channel_stop_kthreads(struct tegra_channel *chan);
+#define CAPTURE_STATUS_TIMEOUT_MS	2500
 
 static const struct vi_capture_setup default_setup = {
 	.channel_flags = 0
@@ -222,15 +221,13 @@ static int tegra_channel_capture_enqueue(struct tegra_channel *chan,
 
 	if (!chan->bfirst_fstart) {
 		err = tegra_channel_set_stream(chan, true);
-		if (err < 0)
+		if (err < 0) {
+			up(&chan->capture_slots);
 			return err;
+		}
 		chan->bfirst_fstart = true;
 	}
 
-	err = down_interruptible(&chan->capture_slots);
-	if (err)
-		return err;
-
 	/* Set up buffer and enqueue capture request for a frame */
 	for (i = 0; i < chan->valid_ports; i++)
 		tegra_channel_surface_setup(chan, buf, i,
@@ -264,33 +261,68 @@ static int tegra_channel_capture_enqueue(struct tegra_channel *chan,
 done:
 	/* Move buffer into dequeue queue */
 	spin_lock(&chan->dequeue_lock);
+	if (list_empty(&chan->dequeue))
+		chan->capture_deadline = jiffies +
+			msecs_to_jiffies(CAPTURE_STATUS_TIMEOUT_MS);
 	list_add_tail(&buf->queue, &chan->dequeue);
 	spin_unlock(&chan->dequeue_lock);
 
-	/* Wake up kthread for capture dequeue */
-	wake_up_interruptible(&chan->dequeue_wait);
-
 	return 0;
 }
 
+/*
+ * The camera processor completed the capture but flagged the frame, e.g.
+ * for a CSI error or a short frame. It is done with the request slot, so
+ * drop just this frame and carry on streaming rather than resetting the
+ * ring and restarting the source.
+ */
+static void tegra_channel_capture_recover(struct tegra_channel *chan,
+	struct tegra_channel_buffer *buf, u32 status)
+{
+	ktime_t start = ktime_get();
+	unsigned long flags;
+	int err;
+
+	dev_dbg(chan->vi->dev, "vi capture status %u, dropping frame\n",
+		status);
+
+	buf->vb2_state = VB2_BUF_STATE_ERROR;
+
+	err = vi_capture_recover(chan->tegra_vi_channel,
+			buf->capture_descr_index);
+	if (err) {
+		dev_err(chan->vi->dev, "vi capture recovery failed\n");
+
+		spin_lock_irqsave(&chan->capture_state_lock, flags);
+		chan->capture_state = CAPTURE_ERROR;
+		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
+		return;
+	}
+
+	trace_tegra_channel_capture_recover(buf->capture_descr_index, status,
+		ktime_to_ns(ktime_sub(ktime_get(), start)));
+}
+
 static void tegra_channel_capture_dequeue(struct tegra_channel *chan,
-	struct tegra_channel_buffer *buf)
+	struct tegra_channel_buffer *buf, int err)
 {
-	int err = 0;
 	unsigned long flags;
 	struct vb2_v4l2_buffer *vb = &buf->buf;
 	struct timespec ts;
 	struct capture_descriptor *descr =
 		&chan->request[buf->capture_descr_index];
+	u64 status_ts;
 
 	if (buf->vb2_state != VB2_BUF_STATE_ACTIVE)
 		goto done;
 
-	/* Dequeue a frame and check its capture status */
-	err = vi_capture_status(chan->tegra_vi_channel, 2500);
+	if (!err && descr->status.status != CAPTURE_STATUS_SUCCESS) {
+		tegra_channel_capture_recover(chan, buf, descr->status.status);
+		goto done;
+	}
 
-	/* Mark frame as in error and discard */
-	if (err || (descr->status.status != CAPTURE_STATUS_SUCCESS)) {
+	/* No status from the camera processor, discard and reset */
+	if (err) {
 		dev_err(chan->vi->dev, "vi capture dequeue status failed\n");
 
 		buf->vb2_state = VB2_BUF_STATE_ERROR;
@@ -321,84 +353,226 @@ static void tegra_channel_capture_dequeue(struct tegra_channel *chan,
 	vb->timecode.seconds = ts.tv_sec;
 #endif
 
+	if (chan->ptp_timestamp)
+		set_ptp_timestamp(buf, descr->status.sof_timestamp);
+
+	/*
+	 * The status time is stamped just after the completion we consumed,
+	 * so it may still be missing here; the frame is left out then.
+	 */
+	status_ts = READ_ONCE(
+		chan->capture_status_ts[buf->capture_descr_index]);
+	chan->capture_status_ts[buf->capture_descr_index] = 0;
+
+	tegra_channel_latency_record(chan, TEGRA_CHANNEL_LATENCY_SOF_EOF,
+		descr->status.sof_timestamp, descr->status.eof_timestamp);
+	tegra_channel_latency_record(chan, TEGRA_CHANNEL_LATENCY_EOF_STATUS,
+		descr->status.eof_timestamp, status_ts);
+	tegra_channel_latency_record(chan, TEGRA_CHANNEL_LATENCY_STATUS_DONE,
+		status_ts, vi5_tsc_ns());
+
 done:
 	up(&chan->capture_slots);
 	chan->buffer_state[chan->free_index] = buf->vb2_state;
 	free_ring_buffers(chan, 1);
 }
 
-static int tegra_channel_kthread_capture_enqueue(void *data)
+/*
+ * All streaming channels share one capture engine. A single work item
+ * reaps the captures the camera processor has reported on and submits
+ * newly queued buffers for every channel in turn. It is kicked when a
+ * buffer is queued and when a capture status arrives, so nothing sleeps
+ * per frame and a multi-camera rig does not need a pair of threads for
+ * each of its channels.
+ */
+struct vi5_capture_engine {
+	struct mutex lock;		/* protects channels, one pass at a time */
+	struct list_head channels;	/* streaming channels */
+	struct workqueue_struct *wq;
+	struct delayed_work work;
+};
+
+static void vi5_capture_engine_work(struct work_struct *work);
+
+static struct vi5_capture_engine capture_engine = {
+	.lock = __MUTEX_INITIALIZER(capture_engine.lock),
+	.channels = LIST_HEAD_INIT(capture_engine.channels),
+};
+
+static void vi5_capture_engine_kick(void)
+{
+	mod_delayed_work(capture_engine.wq, &capture_engine.work, 0);
+}
+
+/* Time in ns on the TSC, the clock the camera processor stamps frames with */
+static u64 vi5_tsc_ns(void)
+{
+	return arch_counter_get_cntvct() *
+		(NSEC_PER_SEC / arch_timer_get_cntfrq());
+}
+
+static void vi5_capture_status_notify(void *data, uint32_t buffer_index)
 {
 	struct tegra_channel *chan = data;
-	struct tegra_channel_buffer *buf;
-	int err = 0;
 
-	set_freezable();
+	if (buffer_index < CAPTURE_QUEUE_DEPTH)
+		WRITE_ONCE(chan->capture_status_ts[buffer_index],
+			vi5_tsc_ns());
 
-	while (1) {
-		try_to_freeze();
+	vi5_capture_engine_kick();
+}
 
-		wait_event_interruptible(chan->start_wait,
-			(!list_empty(&chan->capture) || kthread_should_stop()));
+static void vi5_buffer_queued(struct tegra_channel *chan)
+{
+	if (!list_empty(&chan->capture_engine_entry))
+		vi5_capture_engine_kick();
+}
 
-		if (kthread_should_stop())
-			break;
+/* Complete every buffer at the head of the channel that is done */
+static void tegra_channel_capture_reap(struct tegra_channel *chan)
+{
+	struct tegra_channel_buffer *buf;
+	int err;
 
-		/* source is not streaming if error is non-zero */
-		/* wait till kthread stop and dont DeQ buffers */
-		if (err)
-			continue;
-		buf = dequeue_buffer(chan);
+	for (;;) {
+		spin_lock(&chan->dequeue_lock);
+		buf = list_first_entry_or_null(&chan->dequeue,
+				struct tegra_channel_buffer, queue);
+		spin_unlock(&chan->dequeue_lock);
 		if (!buf)
-			continue;
-		buf->vb2_state = VB2_BUF_STATE_ACTIVE;
+			break;
+
+		err = 0;
+		if (buf->vb2_state == VB2_BUF_STATE_ACTIVE) {
+			err = vi_capture_status(chan->tegra_vi_channel, 0);
+			if (err == -EAGAIN) {
+				if (time_before(jiffies, chan->capture_deadline))
+					break;
+				dev_err(chan->vi->dev,
+					"no reply from camera processor\n");
+				err = -ETIMEDOUT;
+			}
+		}
 
-		err = tegra_channel_capture_enqueue(chan, buf);
+		/* only the engine removes buffers, the head is still buf */
+		dequeue_dequeue_buffer(chan);
+		chan->capture_deadline = jiffies +
+			msecs_to_jiffies(CAPTURE_STATUS_TIMEOUT_MS);
+		tegra_channel_capture_dequeue(chan, buf, err);
 	}
 
-	return 0;
+	if (list_empty(&chan->dequeue))
+		wake_up(&chan->dequeue_wait);
 }
 
-static int tegra_channel_kthread_capture_dequeue(void *data)
+/* Submit queued buffers for as long as the channel has free slots */
+static void tegra_channel_capture_submit(struct tegra_channel *chan)
 {
-	struct tegra_channel *chan = data;
 	struct tegra_channel_buffer *buf;
 
-	set_freezable();
+	/* source is not streaming if an enqueue failed, wait for stop */
+	if (chan->capture_err || READ_ONCE(chan->capture_stopping))
+		return;
 
-	while (1) {
-		try_to_freeze();
-
-		wait_event_interruptible(chan->dequeue_wait,
-			(!list_empty(&chan->dequeue) || kthread_should_stop()));
+	while (!down_trylock(&chan->capture_slots)) {
+		buf = dequeue_buffer(chan);
+		if (!buf) {
+			up(&chan->capture_slots);
+			break;
+		}
+		buf->vb2_state = VB2_BUF_STATE_ACTIVE;
 
-		if (kthread_should_stop() && list_empty(&chan->dequeue))
+		chan->capture_err = tegra_channel_capture_enqueue(chan, buf);
+		if (chan->capture_err)
 			break;
+	}
+}
+
+static void vi5_capture_engine_work(struct work_struct *work)
+{
+	struct tegra_channel *chan;
+	unsigned long deadline = 0;
+	bool in_flight = false;
 
-		do {
-			buf = dequeue_dequeue_buffer(chan);
-			if (!buf)
-				break;
+	mutex_lock(&capture_engine.lock);
+
+	list_for_each_entry(chan, &capture_engine.channels,
+			    capture_engine_entry) {
+		tegra_channel_capture_reap(chan);
+		tegra_channel_capture_submit(chan);
+
+		if (list_empty(&chan->dequeue))
+			continue;
 
-			tegra_channel_capture_dequeue(chan, buf);
-		} while (!list_empty(&chan->dequeue));
+		if (!in_flight || time_before(chan->capture_deadline, deadline))
+			deadline = chan->capture_deadline;
+		in_flight = true;
 	}
 
+	mutex_unlock(&capture_engine.lock);
+
+	/* come back to time out captures the camera processor dropped */
+	if (in_flight)
+		queue_delayed_work(capture_engine.wq, &capture_engine.work,
+			time_after(deadline, jiffies) ? deadline - jiffies : 0);
+}
+
+static int vi5_capture_engine_init(void)
+{
+	int err = 0;
+
+	mutex_lock(&capture_engine.lock);
+	if (!capture_engine.wq) {
+		capture_engine.wq = alloc_workqueue("vi5-capture",
+				WQ_HIGHPRI | WQ_UNBOUND | WQ_FREEZABLE, 1);
+		if (capture_engine.wq)
+			INIT_DELAYED_WORK(&capture_engine.work,
+					  vi5_capture_engine_work);
+		else
+			err = -ENOMEM;
+	}
+	mutex_unlock(&capture_engine.lock);
+
+	return err;
+}
+
+static int tegra_channel_capture_start(struct tegra_channel *chan)
+{
+	int err;
+
+	err = vi5_capture_engine_init();
+	if (err)
+		return err;
+
+	chan->capture_err = 0;
+	WRITE_ONCE(chan->capture_stopping, false);
+	vi_capture_set_status_notify(chan->tegra_vi_channel,
+			vi5_capture_status_notify, chan);
+
+	mutex_lock(&capture_engine.lock);
+	list_add_tail(&chan->capture_engine_entry, &capture_engine.channels);
+	mutex_unlock(&capture_engine.lock);
+
+	vi5_capture_engine_kick();
+
 	return 0;
 }
 
-static void tegra_channel_stop_kthreads(struct tegra_channel *chan)
+static void tegra_channel_capture_stop(struct tegra_channel *chan)
 {
 	mutex_lock(&chan->stop_kthread_lock);
-	/* Stop the kthread for capture enqueue */
-	if (chan->kthread_capture_start) {
-		kthread_stop(chan->kthread_capture_start);
-		chan->kthread_capture_start = NULL;
-	}
-	/* Stop the kthread for capture dequeue */
-	if (chan->kthread_capture_dequeue) {
-		kthread_stop(chan->kthread_capture_dequeue);
-		chan->kthread_capture_dequeue = NULL;
+	if (!list_empty(&chan->capture_engine_entry)) {
+		/* no new captures, let those in flight complete or time out */
+		WRITE_ONCE(chan->capture_stopping, true);
+		vi5_capture_engine_kick();
+		wait_event(chan->dequeue_wait, list_empty(&chan->dequeue));
+
+		mutex_lock(&capture_engine.lock);
+		list_del_init(&chan->capture_engine_entry);
+		mutex_unlock(&capture_engine.lock);
+
+		vi_capture_set_status_notify(chan->tegra_vi_channel,
+				NULL, NULL);
 	}
 	mutex_unlock(&chan->stop_kthread_lock);
 }
@@ -510,23 +684,9 @@ static int vi5_channel_start_streaming(struct vb2_queue *vq, u32 count)
 	chan->sequence = 0;
 	tegra_channel_init_ring_buffer(chan);
 
-	/* Start kthread to enqueue captures to RCE */
-	chan->kthread_capture_start = kthread_run(
-		tegra_channel_kthread_capture_enqueue, chan, chan->video.name);
-	if (IS_ERR(chan->kthread_capture_start)) {
-		dev_err(&chan->video.dev,
-			"failed to run kthread for capture enqueue\n");
-		ret = PTR_ERR(chan->kthread_capture_start);
-		goto error_capture_setup;
-	}
-
-	/* Start kthread to dequeue captures to buffer */
-	chan->kthread_capture_dequeue = kthread_run(
-		tegra_channel_kthread_capture_dequeue, chan, chan->video.name);
-	if (IS_ERR(chan->kthread_capture_dequeue)) {
-		dev_err(&chan->video.dev,
-			"failed to run kthread for capture dequeue\n");
-		ret = PTR_ERR(chan->kthread_capture_dequeue);
+	ret = tegra_channel_capture_start(chan);
+	if (ret < 0) {
+		dev_err(&chan->video.dev, "failed to start capture engine\n");
 		goto error_capture_setup;
 	}
 
@@ -558,7 +718,7 @@ static int vi5_channel_stop_streaming(struct vb2_queue *vq)
 	}
 
 	if (!chan->bypass) {
-		tegra_channel_stop_kthreads(chan);
+		tegra_channel_capture_stop(chan);
 		/* free all the ring buffers */
 		free_ring_buffers(chan, chan->num_buffers);
 		/* dequeue buffers back to app which are in capture queue */
@@ -665,4 +825,5 @@ struct tegra_vi_fops vi5_fops = {
 	.vi_stop_streaming = vi5_channel_stop_streaming,
 	.vi_add_ctrls = vi5_add_ctrls,
 	.vi_init_video_formats = vi5_init_video_formats,
+	.vi_buffer_queued = vi5_buffer_queued,
 };
@@ -100,6 +100,63 @@ regmap_util_write_table_8(struct regmap *regmap,
 
 EXPORT_SYMBOL_GPL(regmap_util_write_table_8);
 
+static const struct reg_8 *
+regmap_util_table_8_find(const struct reg_8 table[], u16 addr,
+			 u16 end_addr, int *count)
+{
+	const struct reg_8 *next, *last = NULL;
+
+	*count = 0;
+	for (next = table; next->addr != end_addr; next++) {
+		if (next->addr == addr) {
+			last = next;
+			(*count)++;
+		}
+	}
+
+	return last;
+}
+
+/*
+ * Switch the sensor from the registers of table @cur to those of table
+ * @next, writing only what differs. A register written once by @next is
+ * skipped when @cur left it with the same value, registers written more
+ * than once are written in full as their order may matter. Delays are
+ * skipped: this is only meant for tables that leave clocks alone.
+ */
+int
+regmap_util_write_table_8_delta(struct regmap *regmap,
+				const struct reg_8 cur[],
+				const struct reg_8 next[],
+				u16 wait_ms_addr, u16 end_addr)
+{
+	const struct reg_8 *entry, *prev;
+	int count, prev_count;
+	int err;
+
+	for (entry = next; entry->addr != end_addr; entry++) {
+		if (entry->addr == wait_ms_addr)
+			continue;
+
+		regmap_util_table_8_find(next, entry->addr, end_addr, &count);
+		prev = regmap_util_table_8_find(cur, entry->addr, end_addr,
+						&prev_count);
+		if (count == 1 && prev && prev->val == entry->val)
+			continue;
+
+		err = regmap_write(regmap, entry->addr, entry->val);
+		if (err) {
+			pr_err("%s:regmap_util_write_table:%d",
+			       __func__, err);
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+EXPORT_SYMBOL_GPL(regmap_util_write_table_8_delta);
+
 int
 regmap_util_write_table_16_as_8(struct regmap *regmap,
 				const struct reg_16 table[],
@@ -24,10 +24,15 @@
 #include <linux/mm.h>
 #include <linux/fs.h>
 #include <linux/crc32.h>
+#include <linux/rculist.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/jump_label.h>
 
 #include <linux/keventlib.h>
 
 #include "eventlib.h"
+#include "eventlib_init.h"
 
 #define KEVENTLIB_VERSION		"0.2"
 
@@ -35,17 +40,22 @@
 #define EVENTLIB_SYSFS_TEST_FILE_NAME	"test"
 #define EVENTLIB_SYSFS_EVENTS_FILE_NAME	"events"
 #define EVENTLIB_SYSFS_SCHEMA_FILE_NAME	"schema"
+#define EVENTLIB_SYSFS_FILTER_FILE_NAME	"filter"
 
 #define EVENTLIB_TEST_SHM_SIZE		(PAGE_SIZE)
 
 #define EVENTLIB_MAX_PROVIDERS		256
 #define EVENTLIB_TEST_DATA_SIZE		0x10
 
+/* Smallest trace sub-buffer worth splitting a provider's area for */
+#define EVENTLIB_MIN_TBUF_SIZE		(16 * 1024)
+
 struct eventlib_provider_info {
 	struct kobject *kobj;
 
 	struct bin_attribute attr;
 	struct bin_attribute attr_schema;
+	struct kobj_attribute attr_filter;
 
 	void *data;
 	size_t data_size;
@@ -60,6 +70,18 @@ struct eventlib_provider_info {
 
 	char *schema;
 	size_t schema_size;
+
+	/*
+	 * Each CPU writes to trace buffer (cpu % nr_tbufs). Only when there
+	 * are fewer buffers than CPUs do writers have to take the buffer's
+	 * lock, otherwise disabling interrupts is enough.
+	 */
+	uint32_t nr_tbufs;
+	bool tbufs_shared;
+	raw_spinlock_t tbuf_lock[EVENTLIB_TBUFS_MAX];
+
+	/* some event types are disabled, protected by filter_mutex */
+	bool filtered;
 };
 
 static struct eventlib_module {
@@ -87,9 +109,101 @@ struct eventlib_test_sample {
 
 static int is_initialized;
 
-static int keventlib_init(struct eventlib_provider_info *info)
+/*
+ * Enabled event types per provider id, bit N for type N. The static key is
+ * on while at least one provider has some type disabled.
+ */
+static uint64_t type_masks[EVENTLIB_MAX_PROVIDERS];
+static DEFINE_MUTEX(filter_mutex);
+
+DEFINE_STATIC_KEY_FALSE(keventlib_filtering);
+EXPORT_SYMBOL(keventlib_filtering);
+
+bool __keventlib_type_enabled(int id, uint32_t type)
+{
+	if (id < 0 || id >= EVENTLIB_MAX_PROVIDERS ||
+	    type >= KEVENTLIB_MAX_FILTER_TYPES)
+		return true;
+
+	return !!(READ_ONCE(type_masks[id]) & BIT_ULL(type));
+}
+EXPORT_SYMBOL(__keventlib_type_enabled);
+
+static int
+set_type_mask(struct eventlib_provider_info *info, uint64_t mask)
+{
+	int id;
+	bool filtered = mask != ~0ULL;
+
+	mutex_lock(&filter_mutex);
+
+	/* the id may already be released and reused by another provider */
+	spin_lock(&ctx.lock);
+	id = info->id;
+	if (id >= 0)
+		WRITE_ONCE(type_masks[id], mask);
+	spin_unlock(&ctx.lock);
+
+	if (id >= 0 && filtered != info->filtered) {
+		if (filtered)
+			static_branch_inc(&keventlib_filtering);
+		else
+			static_branch_dec(&keventlib_filtering);
+
+		info->filtered = filtered;
+	}
+
+	mutex_unlock(&filter_mutex);
+
+	return id >= 0 ? 0 : -ENODEV;
+}
+
+static ssize_t
+sysfs_filter_show(struct kobject *kobj, struct kobj_attribute *attr,
+		  char *buf)
+{
+	int id;
+	struct eventlib_provider_info *info =
+		container_of(attr, struct eventlib_provider_info, attr_filter);
+
+	id = READ_ONCE(info->id);
+	if (id < 0)
+		return -ENODEV;
+
+	return sprintf(buf, "%#llx\n",
+		       (unsigned long long)READ_ONCE(type_masks[id]));
+}
+
+static ssize_t
+sysfs_filter_store(struct kobject *kobj, struct kobj_attribute *attr,
+		   const char *buf, size_t count)
 {
 	int ret;
+	unsigned long long mask;
+	struct eventlib_provider_info *info =
+		container_of(attr, struct eventlib_provider_info, attr_filter);
+
+	ret = kstrtoull(buf, 0, &mask);
+	if (ret)
+		return ret;
+
+	ret = set_type_mask(info, mask);
+
+	return ret ? ret : count;
+}
+
+static uint32_t keventlib_nr_tbufs(size_t size)
+{
+	size_t nr = min_t(size_t, nr_cpu_ids, EVENTLIB_TBUFS_MAX);
+
+	nr = min_t(size_t, nr, size / EVENTLIB_MIN_TBUF_SIZE);
+
+	return max_t(uint32_t, nr, 1);
+}
+
+static int keventlib_init(struct eventlib_provider_info *info)
+{
+	int ret, i;
 	struct eventlib_ctx *el_ctx = &info->el_ctx;
 
 	info->w2r = info->data;
@@ -106,10 +220,20 @@ static int keventlib_init(struct eventlib_provider_info *info)
 	el_ctx->r2w_shm_size = 0;
 	el_ctx->flags = 0;
 
+	info->nr_tbufs = keventlib_nr_tbufs(info->w2r_size);
+	info->tbufs_shared = nr_cpu_ids > info->nr_tbufs;
+	el_ctx->num_buffers = info->nr_tbufs;
+
+	for (i = 0; i < EVENTLIB_TBUFS_MAX; i++)
+		raw_spin_lock_init(&info->tbuf_lock[i]);
+
 	ret = eventlib_init(el_ctx);
 	if (ret)
 		return ret;
 
+	pr_debug("trace buffers: %u, shared: %d\n",
+		 info->nr_tbufs, info->tbufs_shared);
+
 	return 0;
 }
 
@@ -192,6 +316,21 @@ create_sysfs_entry(struct eventlib_provider_info *info,
 		return ret;
 	}
 
+	sysfs_attr_init(&info->attr_filter.attr);
+
+	info->attr_filter.attr.name = EVENTLIB_SYSFS_FILTER_FILE_NAME;
+	info->attr_filter.attr.mode = 0644;
+	info->attr_filter.show = sysfs_filter_show;
+	info->attr_filter.store = sysfs_filter_store;
+
+	ret = sysfs_create_file(info->kobj, &info->attr_filter.attr);
+	if (ret) {
+		pr_err("Unable to create sysfs file: %s\n",
+		       info->attr_filter.attr.name);
+		kobject_put(info->kobj);
+		return ret;
+	}
+
 	if (info->schema) {
 		struct bin_attribute *attr_schema = &info->attr_schema;
 
@@ -219,6 +358,7 @@ create_sysfs_entry(struct eventlib_provider_info *info,
 static void remove_sysfs_entry(struct eventlib_provider_info *info)
 {
 	sysfs_remove_bin_file(info->kobj, &info->attr);
+	sysfs_remove_file(info->kobj, &info->attr_filter.attr);
 	if (info->schema)
 		sysfs_remove_bin_file(info->kobj, &info->attr_schema);
 
@@ -257,6 +397,9 @@ provider_init(struct eventlib_provider_info *info,
 {
 	int ret = 0, id;
 
+	info->id = -1;
+	info->filtered = false;
+
 	info->data = NULL;
 	info->data_size = 0;
 
@@ -306,8 +449,9 @@ provider_init(struct eventlib_provider_info *info,
 	}
 
 	info->id = id;
+	type_masks[id] = ~0ULL;
 
-	list_add_tail(&info->list, &ctx.providers);
+	list_add_tail_rcu(&info->list, &ctx.providers);
 	atomic_inc(&ctx.nr_providers);
 
 	spin_unlock(&ctx.lock);
@@ -332,12 +476,13 @@ err_free:
 	return ret;
 }
 
+/* Called under ctx.lock or rcu_read_lock() */
 static struct eventlib_provider_info *
 find_provider_info(int id)
 {
 	struct eventlib_provider_info *info;
 
-	list_for_each_entry(info, &ctx.providers, list) {
+	list_for_each_entry_rcu(info, &ctx.providers, list) {
 		if (id == info->id)
 			return info;
 	}
@@ -353,8 +498,21 @@ __free_provider(struct work_struct *work)
 
 	struct eventlib_provider_info *info = wd->provider;
 
+	/* wait for keventlib_write() callers still using the provider */
+	synchronize_rcu();
+
+	eventlib_close(&info->el_ctx);
+
+	free_pages((unsigned long)info->data,
+		   get_order(info->data_size));
+
 	remove_sysfs_entry(info);
 
+	mutex_lock(&filter_mutex);
+	if (info->filtered)
+		static_branch_dec(&keventlib_filtering);
+	mutex_unlock(&filter_mutex);
+
 	if (info->schema)
 		kfree(info->schema);
 
@@ -369,12 +527,8 @@ static void free_provider(struct eventlib_provider_info *info)
 {
 	struct eventlib_work_data *wd;
 
-	eventlib_close(&info->el_ctx);
-
-	free_pages((unsigned long)info->data,
-		   get_order(info->data_size));
-
-	list_del(&info->list);
+	list_del_rcu(&info->list);
+	info->id = -1;
 
 	wd = kmalloc(sizeof(*wd), GFP_ATOMIC);
 	if (!wd)
@@ -398,11 +552,16 @@ static void unregister_all_providers(void)
 int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 {
 	int err = 0;
+	uint32_t idx;
+	unsigned long flags;
 	struct eventlib_provider_info *info;
 
+	if (!keventlib_type_enabled(id, type))
+		return 0;
+
 	pr_debug("%s: size: %#zx\n", __func__, size);
 
-	spin_lock(&ctx.lock);
+	rcu_read_lock();
 
 	info = find_provider_info(id);
 	if (!info) {
@@ -415,10 +574,22 @@ int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 		goto err_out;
 	}
 
-	eventlib_write(&info->el_ctx, 0, type, ts, data, size);
+	local_irq_save(flags);
+
+	idx = smp_processor_id() % info->nr_tbufs;
+
+	if (info->tbufs_shared)
+		raw_spin_lock(&info->tbuf_lock[idx]);
+
+	eventlib_write(&info->el_ctx, idx, type, ts, data, size);
+
+	if (info->tbufs_shared)
+		raw_spin_unlock(&info->tbuf_lock[idx]);
+
+	local_irq_restore(flags);
 
 err_out:
-	spin_unlock(&ctx.lock);
+	rcu_read_unlock();
 	return err;
 }
 EXPORT_SYMBOL(keventlib_write);
@@ -20,6 +20,8 @@
 #include "mods_internal.h"
 
 #include <linux/pagemap.h>
+#include <linux/sizes.h>
+#include <linux/workqueue.h>
 
 #ifdef CONFIG_BIGPHYS_AREA
 #include <linux/bigphysarea.h>
@@ -403,10 +405,86 @@ static int mods_get_max_order_needed(u32 num_pages)
 	return order;
 }
 
+/* Allocations at least this large are post-processed by several workers */
+#define MODS_PARALLEL_POST_ALLOC_PAGES	(SZ_64M >> PAGE_SHIFT)
+#define MODS_MAX_POST_ALLOC_WORKERS	8
+
+struct mods_post_alloc_work {
+	struct work_struct     work;
+	struct MODS_MEM_INFO  *p_mem_info;
+	u32		       first;
+	u32		       stride;
+	u32		       num_chunks;
+	int		       ret;
+};
+
+static void mods_post_alloc_worker(struct work_struct *work)
+{
+	struct mods_post_alloc_work *w =
+		container_of(work, struct mods_post_alloc_work, work);
+	u32 i;
+
+	for (i = w->first; i < w->num_chunks; i += w->stride) {
+		struct MODS_PHYS_CHUNK *pt = &w->p_mem_info->pages[i];
+
+		if (mods_post_alloc(pt, page_to_phys(pt->p_page),
+				    w->p_mem_info)) {
+			w->ret = -EINVAL;
+			return;
+		}
+	}
+}
+
+/*
+ * Setting the cache attributes of freshly allocated chunks touches every
+ * page and dominates the time spent on big allocations, so spread the
+ * chunks over several workers.
+ */
+static int mods_post_alloc_chunks(struct MODS_MEM_INFO *p_mem_info,
+				  u32 num_chunks)
+{
+	struct mods_post_alloc_work works[MODS_MAX_POST_ALLOC_WORKERS];
+	u32 nr_workers = 1;
+	u32 i;
+	int ret = 0;
+
+	if (p_mem_info->num_pages >= MODS_PARALLEL_POST_ALLOC_PAGES)
+		nr_workers = min3(num_online_cpus(),
+				  (u32)MODS_MAX_POST_ALLOC_WORKERS,
+				  num_chunks);
+
+	for (i = 0; i < nr_workers; i++) {
+		works[i].p_mem_info = p_mem_info;
+		works[i].first	    = i;
+		works[i].stride	    = nr_workers;
+		works[i].num_chunks = num_chunks;
+		works[i].ret	    = 0;
+		INIT_WORK_ONSTACK(&works[i].work, mods_post_alloc_worker);
+	}
+
+	if (nr_workers == 1) {
+		mods_post_alloc_worker(&works[0].work);
+	} else {
+		for (i = 0; i < nr_workers; i++)
+			queue_work(system_unbound_wq, &works[i].work);
+		for (i = 0; i < nr_workers; i++)
+			flush_work(&works[i].work);
+	}
+
+	for (i = 0; i < nr_workers; i++) {
+		if (works[i].ret)
+			ret = works[i].ret;
+		destroy_work_on_stack(&works[i].work);
+	}
+
+	return ret;
+}
+
 static int mods_alloc_noncontig_sys_pages(struct MODS_MEM_INFO *p_mem_info)
 {
 	u32 pages_left = p_mem_info->num_pages;
 	u32 num_chunks = 0;
+	int max_order  = mods_get_max_order_needed(pages_left);
 
 	LOG_ENT();
 
@@ -416,9 +494,15 @@ static int mods_alloc_noncontig_sys_pages(struct MODS_MEM_INFO *p_mem_info)
 	/* alloc pages */
 	while (pages_left > 0) {
 		u64 phys_addr = 0;
-		int order     = mods_get_max_order_needed(pages_left);
+		int order     = min(max_order,
+				    mods_get_max_order_needed(pages_left));
 		struct MODS_PHYS_CHUNK *pt = &p_mem_info->pages[num_chunks];
 
+		if (num_chunks == p_mem_info->max_chunks) {
+			mods_error_printk("too many chunks\n");
+			goto failed;
+		}
+
 		for ( ; order >= 0; --order) {
 			pt->p_page = alloc_pages_node(
 					p_mem_info->numa_node,
@@ -434,6 +518,9 @@ static int mods_alloc_noncontig_sys_pages(struct MODS_MEM_INFO *p_mem_info)
 		}
 		pt->allocated = 1;
 
+		/* Higher orders just failed, don't retry them on each chunk */
+		max_order = order;
+
 		pages_left -= 1U << order;
 		pt->order = (u32)order;
 
@@ -452,11 +539,11 @@ static int mods_alloc_noncontig_sys_pages(struct MODS_MEM_INFO *p_mem_info)
 		    (unsigned long long)pt->dma_addr);
 
 		++num_chunks;
-
-		if (mods_post_alloc(pt, phys_addr, p_mem_info))
-			goto failed;
 	}
 
+	if (mods_post_alloc_chunks(p_mem_info, num_chunks))
+		goto failed;
+
 	return 0;
 
 failed:
@@ -1450,6 +1537,21 @@ static int mods_post_alloc(struct MODS_PHYS_CHUNK *pt,
 	u32 num_pages = 1U << pt->order;
 	u32 i;
 
+#if defined(MODS_TEGRA) && !defined(CONFIG_CPA)
+	/* Lowmem chunks are linearly mapped, flush them in one go */
+	if (pt->p_page && !PageHighMem(pt->p_page)) {
+		u64 virt = (u64)(size_t)page_address(pt->p_page);
+		u64 size = (u64)num_pages << PAGE_SHIFT;
+		u64 offs;
+
+		for (offs = 0; offs < size; offs += SZ_1G)
+			clear_contiguous_cache(virt + offs, phys_addr + offs,
+					       (u32)min_t(u64, size - offs,
+							  SZ_1G));
+		return 0;
+	}
+#endif
+
 	for (i = 0; i < num_pages; i++) {
 		u64 ptr = 0;
 		int ret = 0;
@@ -24,6 +24,12 @@
 				offsetof(struct aon_shub_response, \
 					 data.cfg_ids.ids)) / \
 				sizeof(int8_t)
+#define AON_SHUB_MAX_BATCH_SAMPLES	(AON_SHUB_MAX_DATA_SIZE - \
+				offsetof(struct aon_shub_response, \
+					 data.payload_batch.data)) / \
+				sizeof(struct aon_shub_batch_sample)
+/* the sample timestamps in a batch are 32 bit ns offsets */
+#define AON_SHUB_BATCH_LATENCY_MAX_US	(1000000)
 
 /* All the enums and the fields inside the structs described in this header
  * file supports only [u/s]X type, where X can be 8,16,32. For inter CPU
@@ -48,7 +54,8 @@ enum aon_shub_request_type {
 	AON_SHUB_REQUEST_BATCH_RD = 11,
 	AON_SHUB_REQUEST_THRESH_LO = 12,
 	AON_SHUB_REQUEST_THRESH_HI = 13,
-	AON_SHUB_REQUEST_MAX = 13,
+	AON_SHUB_REQUEST_PAYLOAD_BATCH = 14,
+	AON_SHUB_REQUEST_MAX = 14,
 };
 
 /* This enum represents the types of init requests to sensor hub associated
@@ -67,6 +74,7 @@ enum aon_shub_sys_request_type {
 	AON_SHUB_SYS_REQUEST_DBG = 1,
 	AON_SHUB_SYS_REQUEST_PM = 2,
 	AON_SHUB_SYS_REQUEST_SNSR_CNT = 3,
+	AON_SHUB_SYS_REQUEST_BATCH_CFG = 4,
 };
 
 /* This enum represents the types of PM requests to AON sensor hub system
@@ -227,6 +235,19 @@ struct aon_shub_pm_request {
 	u32 chip_id_msk;
 };
 
+/* This struct is used to represent data required for a batch config request
+ * to the SHUB.  The SHUB then queues the samples of all the sensors and
+ * sends them in AON_SHUB_REQUEST_PAYLOAD_BATCH messages instead of one
+ * AON_SHUB_REQUEST_PAYLOAD message each.
+ * Fields:
+ * latency_us:	Max time a sample is held back. 0 disables batching.
+ * max_samples:	Samples per message, at most AON_SHUB_MAX_BATCH_SAMPLES.
+ */
+struct aon_shub_batch_cfg_request {
+	u32 latency_us;
+	u32 max_samples;
+};
+
 /* This struct is used to represent data required for an i2c controller init
  * request.
  *
@@ -304,6 +325,7 @@ struct aon_shub_sys_request {
 	union {
 		struct aon_shub_dbg_request dbg;
 		struct aon_shub_pm_request pm;
+		struct aon_shub_batch_cfg_request batch_cfg;
 	} data;
 };
 
@@ -455,6 +477,40 @@ struct aon_shub_payload_response {
 	struct sensor_payload_t data[4];
 };
 
+/* This struct is used to represent a sample in a batch payload.
+ *
+ * Fields:
+ * snsr_id:	Sensor handle to identify the sensor
+ * ts_off:	Time stamp of the sample in ns after the batch's ts_base
+ * x:		X-axis value
+ * y:		Y-axis value
+ * z:		Z-axis value
+ */
+struct aon_shub_batch_sample {
+	u8 snsr_id;
+	u8 reserved;
+	u16 x;
+	u16 y;
+	u16 z;
+	u32 ts_off;
+} __packed;
+
+/* This struct is used to represent the samples of several sensors sent in
+ * a single message.
+ *
+ * Fields:
+ * count:	Number of samples
+ * dropped:	Samples the SHUB dropped since the last batch
+ * ts_base:	Time stamp the sample offsets are relative to
+ * data:	Sensor payloads
+ */
+struct aon_shub_payload_batch_response {
+	u32 count;
+	u32 dropped;
+	u64 ts_base;
+	struct aon_shub_batch_sample data[];
+};
+
 /* This structure indicates the contents of the response from the remote CPU
  * i.e SPE for the previously requested transaction via CCPLEX proxy driver.
  *
@@ -511,6 +567,7 @@ struct aon_shub_response {
 		struct aon_shub_batch_rd_response batch_rd;
 		struct aon_shub_range_response range;
 		struct aon_shub_payload_response payload;
+		struct aon_shub_payload_batch_response payload_batch;
 		struct aon_shub_thresh_response thresh;
 	} data;
 };
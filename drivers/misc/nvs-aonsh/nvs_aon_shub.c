@@ -45,6 +45,11 @@
  * 6. Upon building the local sensor config table, the driver calls
  *    nvs_probe which sets up all the nvs iio attributes for each sensor
  *    config and creates the iio sysfs nodes for the NVS HAL to communicate.
+ * 7. If a batch latency is set (DT batch_latency_us or the sysfs node of
+ *    the same name) the sensor hub is asked to queue the samples of all
+ *    the sensors for up to that long and send them in batch payloads.
+ *    Sensor hub firmware that doesn't support it keeps sending a payload
+ *    per sample.
  */
 
 #include <linux/module.h>
@@ -125,6 +130,7 @@ struct tegra_aon_shub {
 	u32			 adjust_ts_counter;
 	u64			 ts_res_ns;
 	s64			 ts_adjustment;
+	u32			 batch_latency_us;
 	bool			 last_tx_done;
 };
 
@@ -181,6 +187,47 @@ static inline s64 get_ts_adjustment(u64 tsc_res)
 	return delta;
 }
 
+static void tegra_aon_shub_rcv_batch(struct tegra_aon_shub *shub,
+				     struct aon_shub_payload_batch_response *b)
+{
+	struct aon_shub_batch_sample *sample;
+	struct aon_shub_sensor *snsr;
+	u32 i;
+	s64 ts;
+	int cookie;
+
+	if (b->count > AON_SHUB_MAX_BATCH_SAMPLES) {
+		dev_err(shub->dev, "Invalid batch count %u\n", b->count);
+		return;
+	}
+
+	if (b->dropped)
+		dev_warn_ratelimited(shub->dev, "SHUB dropped %u samples\n",
+				     b->dropped);
+	if (shub->adjust_ts_counter >= READJUST_TS_SAMPLES) {
+		shub->ts_adjustment = get_ts_adjustment(shub->ts_res_ns);
+		shub->adjust_ts_counter = 0;
+	}
+	shub->adjust_ts_counter++;
+	/* samples are queued oldest first */
+	for (i = 0; i < b->count; i++) {
+		sample = &b->data[i];
+		if (sample->snsr_id >= shub->snsr_cnt)
+			continue;
+
+		snsr = shub->snsrs[sample->snsr_id];
+		if (!snsr || !snsr->nvs_st)
+			continue;
+
+		ts = (s64)(b->ts_base + sample->ts_off);
+		ts += shub->ts_adjustment;
+		cookie = COOKIE(snsr->type, ts);
+		trace_async_atrace_begin(__func__, TRACE_SENSOR_ID, cookie);
+		shub->nvs->handler(snsr->nvs_st, &sample->x, ts);
+		trace_async_atrace_end(__func__, TRACE_SENSOR_ID, cookie);
+	}
+}
+
 static void tegra_aon_shub_mbox_rcv_msg(struct mbox_client *cl, void *rx_msg)
 {
 	struct tegra_aon_mbox_msg *msg = rx_msg;
@@ -217,6 +264,8 @@ static void tegra_aon_shub_mbox_rcv_msg(struct mbox_client *cl, void *rx_msg)
 				shub_resp->data.payload.data[i].ts);
 			trace_async_atrace_end(__func__, TRACE_SENSOR_ID, cookie);
 		}
+	} else if (shub_resp->resp_type == AON_SHUB_REQUEST_PAYLOAD_BATCH) {
+		tegra_aon_shub_rcv_batch(shub, &shub_resp->data.payload_batch);
 	} else {
 		memcpy(shub->shub_resp, msg->data, sizeof(*shub->shub_resp));
 		complete(shub->wait_on);
@@ -934,6 +983,61 @@ static int tegra_aon_shub_get_snsr_cnt(struct tegra_aon_shub *shub)
 	return ret;
 }
 
+static int tegra_aon_shub_batch_cfg(struct tegra_aon_shub *shub,
+				    u32 latency_us)
+{
+	struct aon_shub_batch_cfg_request *batch_cfg;
+	int ret;
+
+	mutex_lock(&shub->shub_mutex);
+	shub->shub_req->req_type = AON_SHUB_REQUEST_SYS;
+	shub->shub_req->data.sys.req = AON_SHUB_SYS_REQUEST_BATCH_CFG;
+	batch_cfg = &shub->shub_req->data.sys.data.batch_cfg;
+	batch_cfg->latency_us = latency_us;
+	batch_cfg->max_samples = AON_SHUB_MAX_BATCH_SAMPLES;
+	ret = tegra_aon_shub_ivc_msg_send(shub,
+					  sizeof(struct aon_shub_request),
+					  IVC_TIMEOUT);
+	mutex_unlock(&shub->shub_mutex);
+	if (ret) {
+		dev_info(shub->dev, "batch latency %u us not supported: %d\n",
+			 latency_us, ret);
+		return ret > 0 ? -EOPNOTSUPP : ret;
+	}
+
+	shub->batch_latency_us = latency_us;
+	return 0;
+}
+
+static ssize_t batch_latency_us_show(struct device *dev,
+				     struct device_attribute *attr, char *buf)
+{
+	struct tegra_aon_shub *shub = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", shub->batch_latency_us);
+}
+
+static ssize_t batch_latency_us_store(struct device *dev,
+				      struct device_attribute *attr,
+				      const char *buf, size_t count)
+{
+	struct tegra_aon_shub *shub = dev_get_drvdata(dev);
+	unsigned int latency_us;
+	int ret;
+
+	ret = kstrtouint(buf, 10, &latency_us);
+	if (ret)
+		return ret;
+
+	if (latency_us > AON_SHUB_BATCH_LATENCY_MAX_US)
+		return -EINVAL;
+
+	ret = tegra_aon_shub_batch_cfg(shub, latency_us);
+	return ret ? ret : count;
+}
+
+static DEVICE_ATTR_RW(batch_latency_us);
+
 static int tegra_aon_shub_preinit(struct tegra_aon_shub *shub)
 {
 	int ret = 0;
@@ -1132,6 +1236,7 @@ static int tegra_aon_shub_probe(struct platform_device *pdev)
 	struct device_node *np = pdev->dev.of_node;
 	int ret = 0;
 	int num_sensors;
+	u32 latency_us;
 
 	dev_dbg(dev, "AON SHUB driver probe()\n");
 
@@ -1216,6 +1321,15 @@ static int tegra_aon_shub_probe(struct platform_device *pdev)
 	#undef _PICO_SECS
 	shub->ts_adjustment = get_ts_adjustment(shub->ts_res_ns);
 
+	if (!of_property_read_u32(np, "batch_latency_us", &latency_us) &&
+	    latency_us) {
+		if (latency_us > AON_SHUB_BATCH_LATENCY_MAX_US)
+			latency_us = AON_SHUB_BATCH_LATENCY_MAX_US;
+		tegra_aon_shub_batch_cfg(shub, latency_us);
+	}
+	if (device_create_file(dev, &dev_attr_batch_latency_us))
+		dev_warn(dev, "can't create batch_latency_us\n");
+
 	dev_info(&pdev->dev, "tegra_aon_shub_driver_probe() OK\n");
 
 	return 0;
@@ -1232,6 +1346,7 @@ static int tegra_aon_shub_remove(struct platform_device *pdev)
 	struct tegra_aon_shub *shub;
 
 	shub  = dev_get_drvdata(&pdev->dev);
+	device_remove_file(&pdev->dev, &dev_attr_batch_latency_us);
 	mbox_free_channel(shub->mbox);
 
 	return 0;
@@ -1291,6 +1406,10 @@ static int tegra_aon_shub_resume(struct device *dev)
 		dev_err(shub->dev, "AON SHUB Resume ERR: %d\n", ret);
 	mutex_unlock(&shub->shub_mutex);
 
+	/* the SHUB may have lost the batch config across suspend */
+	if (!ret && shub->batch_latency_us)
+		tegra_aon_shub_batch_cfg(shub, shub->batch_latency_us);
+
 	return 0;
 }
 
@@ -63,6 +63,12 @@
 /* This module automatically handles one-shot sensors by disabling the sensor
  * after an event.
  */
+/* Each device also has an nvs_ring sysfs file that can be mmap'ed instead of
+ * reading the IIO buffer (see struct nvs_ring_hdr).  The first mmap sizes
+ * and allocates the ring, from then on every scan pushed to the IIO kfifo
+ * is also queued in the ring.  This saves a read() syscall and copy per
+ * batch for readers of many high rate channels.
+ */
 
 #include <linux/init.h>
 #include <linux/module.h>
@@ -75,6 +81,10 @@
 #include <linux/slab.h>
 #include <linux/of.h>
 #include <linux/string.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/kernfs.h>
+#include <linux/log2.h>
 #include <linux/iio/iio.h>
 #include <linux/iio/sysfs.h>
 #include <linux/iio/buffer.h>
@@ -86,7 +96,7 @@
 #include <linux/iio/buffer_impl.h>
 #endif
 
-#define NVS_IIO_DRIVER_VERSION		(223)
+#define NVS_IIO_DRIVER_VERSION		(224)
 
 enum NVS_ATTR {
 	NVS_ATTR_ENABLE,
@@ -206,6 +216,13 @@ struct nvs_state {
 	s64 ts_diff;
 	s64 ts;
 	u8 *buf;
+	unsigned int buf_sz;
+	struct nvs_ring_hdr *ring;
+	struct kernfs_node *ring_kn;
+	unsigned int ring_sz;
+	unsigned int ring_elem_sz;
+	unsigned int ring_elem_n;
+	u32 ring_head;
 };
 
 struct nvs_iio_ch {
@@ -620,9 +637,40 @@ static int nvs_buf_i(struct iio_dev *indio_dev, unsigned int ch)
 	return buf_i;
 }
 
+static int nvs_ring_push(struct nvs_state *st, struct nvs_ring_hdr *hdr,
+			 unsigned int scan_sz, s64 ts)
+{
+	u32 fill;
+	u32 wm;
+
+	/* the reader owns tail and may free the slot we're about to fill */
+	fill = st->ring_head - READ_ONCE(hdr->tail);
+	smp_mb();
+	if (fill >= st->ring_elem_n) {
+		hdr->overruns++;
+		return -EBUSY;
+	}
+
+	memcpy((u8 *)hdr + PAGE_SIZE +
+	       (st->ring_head & (st->ring_elem_n - 1)) * st->ring_elem_sz,
+	       st->buf, scan_sz);
+	hdr->scan_sz = scan_sz;
+	/* publish the scan before the head that covers it */
+	smp_wmb();
+	st->ring_head++;
+	WRITE_ONCE(hdr->head, st->ring_head);
+	wm = READ_ONCE(hdr->wm);
+	if (!wm)
+		wm = 1;
+	if (fill + 1 == wm || !ts)
+		kernfs_notify(st->ring_kn);
+	return 0;
+}
+
 static int nvs_buf_push(struct iio_dev *indio_dev, unsigned char *data, s64 ts)
 {
 	struct nvs_state *st = iio_priv(indio_dev);
+	struct nvs_ring_hdr *ring;
 	bool push = true;
 	bool buf_data = false;
 	char char_buf[128];
@@ -692,7 +740,12 @@ static int nvs_buf_push(struct iio_dev *indio_dev, unsigned char *data, s64 ts)
 		memcpy(&st->buf[st->ch[data_chan_n].i], &ts,
 		       st->ch[data_chan_n].n);
 	if (push && iio_buffer_enabled(indio_dev)) {
+		ring = READ_ONCE(st->ring);
 		ret = iio_push_to_buffers(indio_dev, st->buf);
+		if (ring)
+			/* the kfifo may be left unread, the ring decides */
+			ret = nvs_ring_push(st, ring, st->ch[data_chan_n].i +
+					    st->ch[data_chan_n].n, ts);
 		if (!ret) {
 			if (ts) {
 				st->first_push = false;
@@ -1655,6 +1708,8 @@ static int nvs_chan(struct iio_dev *indio_dev)
 		if (st->buf == NULL)
 			return -ENOMEM;
 
+		st->buf_sz = buf_sz;
+
 		return nvs_ch_init(st, indio_dev);
 	}
 
@@ -1763,11 +1818,78 @@ static int nvs_chan(struct iio_dev *indio_dev)
 	if (st->buf == NULL)
 		return -ENOMEM;
 
+	st->buf_sz = buf_sz;
+
 	indio_dev->channels = st->chs;
 	indio_dev->num_channels = i;
 	return nvs_ch_init(st, indio_dev);
 }
 
+static int nvs_ring_alloc(struct nvs_state *st, unsigned long sz)
+{
+	struct nvs_ring_hdr *hdr;
+	unsigned int elem_n;
+
+	if (sz > NVS_RING_SZ_MAX)
+		sz = NVS_RING_SZ_MAX;
+	st->ring_elem_sz = ALIGN(st->buf_sz, sizeof(s64));
+	if (sz <= PAGE_SIZE || (sz - PAGE_SIZE) < st->ring_elem_sz)
+		return -EINVAL;
+
+	elem_n = rounddown_pow_of_two((sz - PAGE_SIZE) / st->ring_elem_sz);
+	st->ring_sz = PAGE_ALIGN(PAGE_SIZE + elem_n * st->ring_elem_sz);
+	hdr = vmalloc_user(st->ring_sz);
+	if (hdr == NULL)
+		return -ENOMEM;
+
+	hdr->magic = NVS_RING_MAGIC;
+	hdr->version = NVS_RING_VERSION;
+	hdr->data_off = PAGE_SIZE;
+	hdr->elem_sz = st->ring_elem_sz;
+	hdr->elem_n = elem_n;
+	st->ring_elem_n = elem_n;
+	st->ring_head = 0;
+	/* nvs_buf_push doesn't take mlock so publish the ring last */
+	smp_store_release(&st->ring, hdr);
+	return 0;
+}
+
+static int nvs_ring_mmap(struct file *filp, struct kobject *kobj,
+			 struct bin_attribute *attr,
+			 struct vm_area_struct *vma)
+{
+	struct iio_dev *indio_dev = dev_to_iio_dev(kobj_to_dev(kobj));
+	struct nvs_state *st = iio_priv(indio_dev);
+	unsigned long sz = vma->vm_end - vma->vm_start;
+	int ret = 0;
+
+	if (vma->vm_pgoff)
+		return -EINVAL;
+
+	mutex_lock(&indio_dev->mlock);
+	/* the first mmap sizes the ring */
+	if (st->ring == NULL)
+		ret = nvs_ring_alloc(st, sz);
+	if (!ret && sz > st->ring_sz)
+		ret = -EINVAL;
+	if (!ret)
+		ret = remap_vmalloc_range(vma, st->ring, 0);
+	mutex_unlock(&indio_dev->mlock);
+	if (*st->fn_dev->sts & NVS_STS_SPEW_MSG)
+		dev_info(st->dev, "%s %s sz=%lu elem_n=%u ret=%d\n",
+			 __func__, st->cfg->name, sz, st->ring_elem_n, ret);
+	return ret;
+}
+
+static struct bin_attribute bin_attr_nvs_ring = {
+	.attr				= {
+		.name			= "nvs_ring",
+		.mode			= S_IRUSR | S_IWUSR |
+					  S_IRGRP | S_IWGRP,
+	},
+	.mmap				= nvs_ring_mmap,
+};
+
 static const struct iio_trigger_ops nvs_trigger_ops = {
 	.owner = THIS_MODULE,
 };
@@ -1846,6 +1968,12 @@ static int nvs_remove(void *handle)
 		return 0;
 
 	st = iio_priv(indio_dev);
+	if (st->ring_kn) {
+		sysfs_put(st->ring_kn);
+		sysfs_remove_bin_file(&indio_dev->dev.kobj,
+				      &bin_attr_nvs_ring);
+		st->ring_kn = NULL;
+	}
 	if (st->init)
 		iio_device_unregister(indio_dev);
 	if (st->trig != NULL) {
@@ -1865,6 +1993,7 @@ static int nvs_remove(void *handle)
 	if (st->init && st->cfg->flags & SENSOR_FLAG_DYNAMIC_SENSOR)
 		nvs_dsm_iio(indio_dev->id, false, st->snsr_type,
 			    st->cfg->uuid);
+	vfree(st->ring);
 	iio_device_free(indio_dev);
 	return 0;
 }
@@ -1933,6 +2062,18 @@ static int nvs_init(struct iio_dev *indio_dev, struct nvs_state *st)
 		return ret;
 	}
 
+	/* the ring is optional so failing it doesn't fail the device */
+	ret = sysfs_create_bin_file(&indio_dev->dev.kobj, &bin_attr_nvs_ring);
+	if (!ret) {
+		st->ring_kn = sysfs_get_dirent(indio_dev->dev.kobj.sd,
+					       bin_attr_nvs_ring.attr.name);
+		if (st->ring_kn == NULL)
+			sysfs_remove_bin_file(&indio_dev->dev.kobj,
+					      &bin_attr_nvs_ring);
+	} else {
+		dev_err(st->dev, "%s nvs_ring ERR=%d\n", __func__, ret);
+	}
+
 	return 0;
 }
 
@@ -1,4 +1,4 @@
-/* Copyright (c) 2015-2017, NVIDIA CORPORATION.  All rights reserved.
+/* Copyright (c) 2015-2018, NVIDIA CORPORATION.  All rights reserved.
  *
  * This software is licensed under the terms of the GNU General Public
  * License version 2, as published by the Free Software Foundation, and
@@ -15,6 +15,8 @@
 #include <linux/time.h>
 #include <linux/ktime.h>
 #include <linux/timekeeping.h>
+#include <linux/math64.h>
+#include <linux/nvs.h>
 
 
 s64 nvs_timestamp(void)
@@ -26,6 +28,136 @@ s64 nvs_timestamp(void)
 }
 EXPORT_SYMBOL_GPL(nvs_timestamp);
 
+/**
+ * nvs_ts_reset - restart the timestamp model
+ * @ts: timestamp model
+ * @period_ns: nominal sample period
+ *
+ * The next nvs_ts_fit starts over from its reference time.
+ */
+void nvs_ts_reset(struct nvs_ts *ts, s64 period_ns)
+{
+	ts->period_nom = period_ns;
+	ts->period = period_ns;
+	ts->step = period_ns;
+	ts->end = 0;
+	ts->next = 0;
+	if (!ts->shift)
+		ts->shift = NVS_TS_SHIFT_DEF;
+	ts->reset = true;
+}
+EXPORT_SYMBOL_GPL(nvs_ts_reset);
+
+static void nvs_ts_sync(struct nvs_ts *ts, s64 ts_ref, unsigned int n)
+{
+	ts->step = ts->period;
+	ts->end = ts_ref;
+	ts->next = ts_ref - ts->step * (n - 1);
+}
+
+/**
+ * nvs_ts_fit - fit the timestamp model to a batch
+ * @ts: timestamp model
+ * @ts_ref: time the last sample of the batch was taken or 0 if unknown
+ * @n: number of samples in the batch
+ *
+ * Returns the timestamp of the last sample in the batch.  The samples
+ * are then timed with nvs_ts_next.  Without a reference the batch is
+ * extrapolated from the current period.
+ */
+s64 nvs_ts_fit(struct nvs_ts *ts, s64 ts_ref, unsigned int n)
+{
+	s64 span;
+	s64 err;
+	s64 end;
+
+	if (!n)
+		return ts->end;
+
+	if (ts->reset) {
+		if (ts_ref <= 0)
+			return 0;
+
+		ts->reset = false;
+		nvs_ts_sync(ts, ts_ref, n);
+		return ts->end;
+	}
+
+	if (ts_ref <= 0) {
+		ts->step = ts->period;
+		ts->next = ts->end + ts->step;
+		ts->end += ts->step * n;
+		return ts->end;
+	}
+
+	span = ts_ref - ts->end;
+	if (span <= 0 || span > ts->period * n * 4) {
+		/* lost the sensor (FIFO overflow, missed IRQ, ...) */
+		ts->resync_n++;
+		nvs_ts_sync(ts, ts_ref, n);
+		return ts->end;
+	}
+
+	/* the reference only runs late (IRQ latency) so limit what a single
+	 * batch can do to the period to a quarter of it either way
+	 */
+	err = div_s64(span, n) - ts->period;
+	if (abs(err) < (ts->period >> 2))
+		ts->period += div_s64(err, 1 << ts->shift);
+	/* pull the phase in at the same rate but never past the reference */
+	end = ts->end + ts->period * n;
+	end += div_s64(ts_ref - end, 1 << ts->shift);
+	if (end > ts_ref)
+		end = ts_ref;
+	ts->step = div_s64(end - ts->end, n);
+	if (ts->step <= 0) {
+		ts->resync_n++;
+		nvs_ts_sync(ts, ts_ref, n);
+		return ts->end;
+	}
+
+	ts->next = ts->end + ts->step;
+	ts->end += ts->step * n;
+	return ts->end;
+}
+EXPORT_SYMBOL_GPL(nvs_ts_fit);
+
+/**
+ * nvs_ts_next - timestamp of the next sample in the batch
+ * @ts: timestamp model
+ *
+ * Returns 0 if the model hasn't been fitted yet.
+ */
+s64 nvs_ts_next(struct nvs_ts *ts)
+{
+	s64 t;
+
+	if (ts->reset)
+		return 0;
+
+	t = ts->next;
+	if (t > ts->end)
+		t = ts->end;
+	else
+		ts->next += ts->step;
+	return t;
+}
+EXPORT_SYMBOL_GPL(nvs_ts_next);
+
+/**
+ * nvs_ts_drift_ppm - drift of the fitted period from the nominal period
+ * @ts: timestamp model
+ */
+int nvs_ts_drift_ppm(struct nvs_ts *ts)
+{
+	if (ts->period_nom <= 0)
+		return 0;
+
+	return (int)div64_s64((ts->period - ts->period_nom) * 1000000,
+			      ts->period_nom);
+}
+EXPORT_SYMBOL_GPL(nvs_ts_drift_ppm);
+
 MODULE_LICENSE("GPL v2");
 MODULE_DESCRIPTION("NVidia Sensor timestamp module");
 MODULE_AUTHOR("NVIDIA Corporation");
@@ -52,6 +52,11 @@
 #define ACTIVE_SOURCE 0x82
 
 static bool previous_reboot_reason_is_recovery, text_view_on_sent;
+
+/* Frame retransmissions done by the driver with the RETRY bit set */
+static unsigned int hw_tx_retries;
+module_param(hw_tx_retries, uint, 0644);
+MODULE_PARM_DESC(hw_tx_retries, "retransmissions on NAK or lost arbitration");
 static u8 text_view_on_command[] = {
 	LOGICAL_ADDRESS_RESERVED2 << 4 | LOGICAL_ADDRESS_TV,
 	TEXT_VIEW_ON
@@ -76,6 +81,11 @@ static ssize_t cec_logical_addr_show(struct device *dev,
 static DEVICE_ATTR(cec_logical_addr_config, S_IWUSR | S_IRUGO,
 		cec_logical_addr_show, cec_logical_addr_store);
 
+static ssize_t cec_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf);
+
+static DEVICE_ATTR(cec_stats, S_IRUGO, cec_stats_show, NULL);
+
 static int tegra_cec_open(struct inode *inode, struct file *file)
 {
 	struct miscdevice *miscdev = file->private_data;
@@ -135,6 +145,9 @@ int tegra_cec_native_write_l(struct tegra_cec *cec, const u8 *buf, size_t cnt)
 	cec->tx_error = 0;
 	cec->tx_buf_cur = 0;
 	cec->tx_buf_cnt = cnt;
+	cec->tx_retries_left = min_t(unsigned int, hw_tx_retries,
+				     TEGRA_CEC_TX_MAX_RETRIES);
+	cec->tx_start = ktime_get();
 
 	for (i = 0; i < cnt; i++) {
 		start = i == 0 ? (1 << TEGRA_CEC_TX_REG_START_BIT_SHIFT) : 0;
@@ -183,35 +196,96 @@ static ssize_t tegra_cec_write(struct file *file, const char __user *buf,
 	}
 }
 
+static int tegra_cec_tx_batch(struct tegra_cec *cec, void __user *arg)
+{
+	struct tegra_cec_tx_batch batch;
+	struct tegra_cec_frame *frames;
+	u32 i;
+	int ret;
+
+	if (copy_from_user(&batch, arg, sizeof(batch)))
+		return -EFAULT;
+
+	if (!batch.nr_frames || batch.nr_frames > TEGRA_CEC_TX_BATCH_MAX)
+		return -EINVAL;
+
+	frames = kcalloc(batch.nr_frames, sizeof(*frames), GFP_KERNEL);
+	if (!frames)
+		return -ENOMEM;
+
+	if (copy_from_user(frames, (void __user *)(uintptr_t)batch.frames,
+			   batch.nr_frames * sizeof(*frames))) {
+		ret = -EFAULT;
+		goto out;
+	}
+
+	for (i = 0; i < batch.nr_frames; i++) {
+		if (!frames[i].len ||
+		    frames[i].len > TEGRA_CEC_FRAME_MAX_LENGTH) {
+			ret = -EMSGSIZE;
+			goto out;
+		}
+	}
+
+	ret = wait_event_interruptible(cec->init_waitq,
+	    atomic_read(&cec->init_done) == 1);
+	if (ret)
+		goto out;
+
+	/* hold the bus for the whole batch */
+	mutex_lock(&cec->tx_lock);
+	for (i = 0; i < batch.nr_frames; i++) {
+		ret = tegra_cec_native_write_l(cec, frames[i].data,
+					       frames[i].len);
+		if (ret)
+			break;
+	}
+	mutex_unlock(&cec->tx_lock);
+
+	batch.nr_sent = i;
+	if (copy_to_user(arg, &batch, sizeof(batch)) && !ret)
+		ret = -EFAULT;
+out:
+	kfree(frames);
+	return ret;
+}
+
+/*
+ * Each u16 read back is one received block: the data byte plus the EOM and
+ * ACK bits. Everything queued that fits in the user buffer is returned, at
+ * least one block.
+ */
 static ssize_t tegra_cec_read(struct file *file, char  __user *buffer,
 	size_t count, loff_t *ppos)
 {
 	struct tegra_cec *cec = file->private_data;
+	unsigned int copied;
 	ssize_t ret;
 
-	count = sizeof(cec->rx_buffer);
+	count = max(rounddown(count, sizeof(u16)), sizeof(u16));
 
 	ret = wait_event_interruptible(cec->init_waitq,
 	    atomic_read(&cec->init_done) == 1);
 	if (ret)
 		return ret;
 
-	if (cec->rx_wake == 0)
+	if (kfifo_is_empty(&cec->rx_fifo))
 		if (file->f_flags & O_NONBLOCK)
 			return -EAGAIN;
 
-	ret = wait_event_interruptible(cec->rx_waitq, cec->rx_wake == 1);
+	ret = wait_event_interruptible(cec->rx_waitq,
+				       !kfifo_is_empty(&cec->rx_fifo));
 	if (ret)
 		return ret;
 
-	if (copy_to_user(buffer, &(cec->rx_buffer), count))
-		return -EFAULT;
+	mutex_lock(&cec->rx_lock);
+	ret = kfifo_to_user(&cec->rx_fifo, buffer, count, &copied);
+	mutex_unlock(&cec->rx_lock);
+	if (ret)
+		return ret;
 
-	dev_dbg(cec->dev, "%s: %*phC", __func__, (int)count,
-		&(cec->rx_buffer));
-	cec->rx_buffer = 0x0;
-	cec->rx_wake = 0;
-	return count;
+	dev_dbg(cec->dev, "%s: %u bytes", __func__, copied);
+	return copied;
 }
 
 static inline void tegra_cec_error_recovery(struct tegra_cec *cec)
@@ -224,6 +298,40 @@ static inline void tegra_cec_error_recovery(struct tegra_cec *cec)
 	writel(hw_ctrl, cec->cec_base + TEGRA_CEC_HW_CONTROL);
 }
 
+static void tegra_cec_tx_done(struct tegra_cec *cec, long error)
+{
+	u32 lat = ktime_us_delta(ktime_get(), cec->tx_start);
+
+	cec->tx_error = error;
+	cec->tx_frames++;
+	if (error)
+		cec->tx_failed++;
+	cec->tx_lat_total_us += lat;
+	if (lat > cec->tx_lat_max_us)
+		cec->tx_lat_max_us = lat;
+
+	cec->tx_wake = 1;
+	wake_up_interruptible(&cec->tx_waitq);
+}
+
+/*
+ * Resend the current frame with the RETRY bit set, which makes the
+ * controller wait the shorter retransmission bus idle time.
+ */
+static bool tegra_cec_tx_retry(struct tegra_cec *cec, u32 mask)
+{
+	if (!cec->tx_retries_left)
+		return false;
+
+	cec->tx_retries_left--;
+	cec->tx_retried++;
+	cec->tx_buf[0] |= 1 << TEGRA_CEC_TX_REG_RETRY_BIT_SHIFT;
+	cec->tx_buf_cur = 0;
+	writel(mask | TEGRA_CEC_INT_MASK_TX_REGISTER_EMPTY,
+		cec->cec_base + TEGRA_CEC_INT_MASK);
+	return true;
+}
+
 static irqreturn_t tegra_cec_irq_handler(int irq, void *data)
 {
 	struct device *dev = data;
@@ -245,22 +353,18 @@ static irqreturn_t tegra_cec_irq_handler(int irq, void *data)
 		writel(mask & ~TEGRA_CEC_INT_MASK_TX_REGISTER_EMPTY,
 			cec->cec_base + TEGRA_CEC_INT_MASK);
 
-		cec->tx_error = -EIO;
-		cec->tx_wake = 1;
-
-		wake_up_interruptible(&cec->tx_waitq);
+		tegra_cec_tx_done(cec, -EIO);
 
 		goto out;
 	} else if ((status & TEGRA_CEC_INT_STAT_TX_ARBITRATION_FAILED) ||
 		   (status & TEGRA_CEC_INT_STAT_TX_BUS_ANOMALY_DETECTED)) {
 		tegra_cec_error_recovery(cec);
-		writel(mask & ~TEGRA_CEC_INT_MASK_TX_REGISTER_EMPTY,
-			cec->cec_base + TEGRA_CEC_INT_MASK);
-
-		cec->tx_error = -ECOMM;
-		cec->tx_wake = 1;
+		mask &= ~TEGRA_CEC_INT_MASK_TX_REGISTER_EMPTY;
+		writel(mask, cec->cec_base + TEGRA_CEC_INT_MASK);
 
-		wake_up_interruptible(&cec->tx_waitq);
+		if (!(status & TEGRA_CEC_INT_STAT_TX_ARBITRATION_FAILED) ||
+		    !tegra_cec_tx_retry(cec, mask))
+			tegra_cec_tx_done(cec, -ECOMM);
 
 		goto out;
 	} else if (status & TEGRA_CEC_INT_STAT_TX_FRAME_TRANSMITTED) {
@@ -270,12 +374,14 @@ static irqreturn_t tegra_cec_irq_handler(int irq, void *data)
 		if (status & TEGRA_CEC_INT_STAT_TX_FRAME_OR_BLOCK_NAKD) {
 			tegra_cec_error_recovery(cec);
 
-			cec->tx_error = TEGRA_CEC_LADDR_MODE(cec->tx_buf[0]) ?
-					-ECONNRESET : -EHOSTUNREACH;
+			/* a NAKed broadcast is a rejection, do not resend it */
+			if (TEGRA_CEC_LADDR_MODE(cec->tx_buf[0]))
+				tegra_cec_tx_done(cec, -ECONNRESET);
+			else if (!tegra_cec_tx_retry(cec, mask))
+				tegra_cec_tx_done(cec, -EHOSTUNREACH);
+		} else {
+			tegra_cec_tx_done(cec, 0);
 		}
-		cec->tx_wake = 1;
-
-		wake_up_interruptible(&cec->tx_waitq);
 
 		goto out;
 	} else if (status & TEGRA_CEC_INT_STAT_TX_FRAME_OR_BLOCK_NAKD)
@@ -302,8 +408,12 @@ static irqreturn_t tegra_cec_irq_handler(int irq, void *data)
 	} else if (status & TEGRA_CEC_INT_STAT_RX_REGISTER_FULL) {
 		writel(TEGRA_CEC_INT_STAT_RX_REGISTER_FULL,
 			cec->cec_base + TEGRA_CEC_INT_STAT);
-		cec->rx_buffer = readw(cec->cec_base + TEGRA_CEC_RX_REGISTER);
-		cec->rx_wake = 1;
+		/* queued so a slow reader does not lose blocks */
+		if (kfifo_put(&cec->rx_fifo,
+			      readw(cec->cec_base + TEGRA_CEC_RX_REGISTER)))
+			cec->rx_blocks++;
+		else
+			cec->rx_dropped++;
 		wake_up_interruptible(&cec->rx_waitq);
 	}
 
@@ -325,6 +435,8 @@ static long tegra_cec_ioctl(struct file *file, unsigned int cmd,
 		tegra_cec_error_recovery(cec);
 		mutex_unlock(&cec->recovery_lock);
 		break;
+	case TEGRA_CEC_IOCTL_TX_BATCH:
+		return tegra_cec_tx_batch(cec, (void __user *)arg);
 	default:
 		dev_err(cec->dev, "unsupported ioctl\n");
 		return -EINVAL;
@@ -381,7 +493,6 @@ static int tegra_cec_send_one_touch_play(struct tegra_cec *cec)
 
 static void tegra_cec_init(struct tegra_cec *cec)
 {
-	cec->rx_wake = 0;
 	cec->tx_wake = 1;
 	cec->tx_buf_cnt = 0;
 	cec->tx_buf_cur = 0;
@@ -393,6 +504,10 @@ static void tegra_cec_init(struct tegra_cec *cec)
 	writel(0x00, cec->cec_base + TEGRA_CEC_INT_MASK);
 	writel(0xffffffff, cec->cec_base + TEGRA_CEC_INT_STAT);
 
+	mutex_lock(&cec->rx_lock);
+	kfifo_reset(&cec->rx_fifo);
+	mutex_unlock(&cec->rx_lock);
+
 #ifdef CONFIG_PM
 	if (wait_event_interruptible_timeout(cec->suspend_waitq,
 				atomic_xchg(&cec->init_cancel, 0) == 1,
@@ -510,6 +625,21 @@ static ssize_t cec_logical_addr_store(struct device *dev,
 	return count;
 }
 
+static ssize_t cec_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct tegra_cec *cec = dev_get_drvdata(dev);
+	u32 frames = cec->tx_frames;
+
+	return sprintf(buf,
+		"tx_frames %u\ntx_failed %u\ntx_retried %u\n"
+		"tx_latency_avg_us %llu\ntx_latency_max_us %u\n"
+		"rx_blocks %u\nrx_dropped %u\n",
+		frames, cec->tx_failed, cec->tx_retried,
+		frames ? div_u64(cec->tx_lat_total_us, frames) : 0,
+		cec->tx_lat_max_us, cec->rx_blocks, cec->rx_dropped);
+}
+
 static int tegra_cec_probe(struct platform_device *pdev)
 {
 	struct tegra_cec *cec;
@@ -564,7 +694,9 @@ static int tegra_cec_probe(struct platform_device *pdev)
 
 	atomic_set(&cec->init_done, 0);
 	mutex_init(&cec->tx_lock);
+	mutex_init(&cec->rx_lock);
 	mutex_init(&cec->recovery_lock);
+	INIT_KFIFO(cec->rx_fifo);
 
 #if defined(CONFIG_TEGRA_POWERGATE)
 	if (tegra_dc_is_nvdisplay()) {
@@ -652,6 +784,10 @@ static int tegra_cec_probe(struct platform_device *pdev)
 		goto cec_error;
 	}
 
+	ret = sysfs_create_file(&pdev->dev.kobj, &dev_attr_cec_stats.attr);
+	if (ret)
+		dev_warn(&pdev->dev, "Failed to add stats sysfs: %d\n", ret);
+
 	dev_notice(&pdev->dev, "probed\n");
 
 	return 0;
@@ -20,9 +20,13 @@
 #define TEGRA_CEC_H
 
 #include <linux/pm.h>
+#include <linux/kfifo.h>
 #include <asm/atomic.h>
 
 #define TEGRA_CEC_FRAME_MAX_LENGTH  16
+#define TEGRA_CEC_RX_FIFO_SIZE      64
+#define TEGRA_CEC_TX_MAX_RETRIES    5
+#define TEGRA_CEC_TX_BATCH_MAX      16
 
 struct tegra_cec_soc;
 
@@ -45,13 +49,24 @@ struct tegra_cec {
 	u16			logical_addr;
 	struct work_struct	work;
 	const struct tegra_cec_soc *soc;
-	unsigned int		rx_wake;
 	unsigned int		tx_wake;
-	u16			rx_buffer;
+	struct mutex		rx_lock;
+	DECLARE_KFIFO(rx_fifo, u16, TEGRA_CEC_RX_FIFO_SIZE);
 	long			tx_error;
 	u32			tx_buf[TEGRA_CEC_FRAME_MAX_LENGTH];
 	u8			tx_buf_cur;
 	u8			tx_buf_cnt;
+	u8			tx_retries_left;
+	ktime_t			tx_start;
+
+	/* statistics, reported through cec_stats */
+	u32			tx_frames;
+	u32			tx_failed;
+	u32			tx_retried;
+	u32			tx_lat_max_us;
+	u64			tx_lat_total_us;
+	u32			rx_blocks;
+	u32			rx_dropped;
 };
 static int tegra_cec_remove(struct platform_device *pdev);
 
@@ -166,6 +181,24 @@ static int tegra_cec_remove(struct platform_device *pdev);
 
 #define TEGRA_CEC_IOC_MAGIC 'C'
 
+struct tegra_cec_frame {
+	__u8 len;
+	__u8 data[TEGRA_CEC_FRAME_MAX_LENGTH];
+};
+
+/*
+ * Send up to TEGRA_CEC_TX_BATCH_MAX frames (a struct tegra_cec_frame array
+ * at frames) back to back. Stops at the first failing frame, nr_sent says
+ * how many went out.
+ */
+struct tegra_cec_tx_batch {
+	__u32 nr_frames;
+	__u32 nr_sent;
+	__u64 frames;
+};
+
 #define TEGRA_CEC_IOCTL_ERROR_RECOVERY	_IO(TEGRA_CEC_IOC_MAGIC, 1)
+#define TEGRA_CEC_IOCTL_TX_BATCH	\
+	_IOWR(TEGRA_CEC_IOC_MAGIC, 2, struct tegra_cec_tx_batch)
 
 #endif /* TEGRA_CEC_H */
@@ -20,6 +20,10 @@
 #include <linux/interrupt.h>
 #include <linux/device.h>
 #include <linux/random.h>
+#include <linux/kthread.h>
+#include <linux/sizes.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
 
 #define MODULENAME "tegra_ep_mem"
 
@@ -90,6 +94,12 @@
 #define DMA_LLP_LOW_OFF_RDCH		(0x1C + 0x100)
 #define DMA_LLP_HIGH_OFF_RDCH		(0x20 + 0x100)
 
+/* benchmark: both buffers start with an area for the linked lists */
+#define BENCH_LL_AREA			SZ_64K
+#define BENCH_MMIO_AREA			SZ_64K
+#define BENCH_MAX_ITERS			1024
+#define BENCH_MAX_LL			64
+
 static unsigned long alloc_size = 0xA00000;
 
 module_param(alloc_size, ulong, 0660);
@@ -116,6 +126,25 @@ struct ep_pvt {
 	ktime_t rd_end_time;
 	unsigned long wr_busy;
 	unsigned long rd_busy;
+	ktime_t wr_done[DMA_WR_CHNL_NUM];
+	ktime_t rd_done[DMA_RD_CHNL_NUM];
+
+	struct {
+		struct mutex lock;
+		struct dentry *debugfs;
+		u64 ep_addr;	/* EP local address of the memory behind BAR0 */
+		u32 ep_size;
+		u32 min_size;
+		u32 max_size;
+		u32 iters;
+		u8 wr_chans;
+		u8 rd_chans;
+		u32 max_ll;
+		bool mmio;
+		void __iomem *bar;
+		u64 *lat;
+		atomic64_t mmio_bytes;
+	} bench;
 };
 
 struct dma_tx {
@@ -189,12 +218,13 @@ static irqreturn_t ep_isr(int irq, struct ep_pvt *ep)
 	for_each_set_bit(bit, &ep->wr_busy, DMA_WR_CHNL_NUM) {
 		dev_dbg(&ep->pdev->dev, "bit = %u\n", bit);
 		if (BIT(bit) & val) {
+			ep->wr_done[bit] = ktime_get();
 			dma_common_wr(ep->mmio_addr, BIT(bit),
 				      DMA_WRITE_INT_CLEAR_OFF);
+			/* clear status */
+			clear_bit(bit, &ep->wr_busy);
 			/* send completion for appropriate channel */
 			complete(&ep->wr_cpl[bit]);
-			/* clear status */
-			ep->wr_busy &= ~(BIT(bit));
 		}
 	}
 
@@ -203,12 +233,13 @@ static irqreturn_t ep_isr(int irq, struct ep_pvt *ep)
 	for_each_set_bit(bit, &ep->rd_busy, DMA_RD_CHNL_NUM) {
 		dev_dbg(&ep->pdev->dev, "bit = %u\n", bit);
 		if (BIT(bit) & val) {
+			ep->rd_done[bit] = ktime_get();
 			dma_common_wr(ep->mmio_addr, BIT(bit),
 				      DMA_READ_INT_CLEAR_OFF);
+			/* clear status */
+			clear_bit(bit, &ep->rd_busy);
 			/* send completion for appropriate channel */
 			complete(&ep->rd_cpl[bit]);
-			/* clear status */
-			ep->rd_busy &= ~(BIT(bit));
 		}
 	}
 
@@ -706,6 +737,390 @@ err_remap:
 	return ret;
 }
 
+/*
+ * Benchmark: sweeps direction, channel count, transfer size and linked
+ * list depth (0 being register mode), and prints one CSV line per point
+ * when bench/run is read. The EP buffer is the memory behind BAR0, whose
+ * EP local address has to be written to bench/ep_addr first; the host
+ * buffer is the coherent allocation made at probe. Each channel works on
+ * its own slice of both buffers, all of them started back to back.
+ */
+struct ep_bench_dir {
+	const char *name;
+	bool write;
+	u8 max_chans;
+	u32 ch_off;
+	u32 engine_en;
+	u32 doorbell;
+	u32 stop;
+	u32 int_mask;
+	u32 done_imwr;
+	u32 abort_imwr;
+	u32 imwr_data;
+};
+
+static const struct ep_bench_dir ep_bench_dirs[] = {
+	{
+		.name = "write",
+		.write = true,
+		.max_chans = DMA_WR_CHNL_NUM,
+		.ch_off = 0,
+		.engine_en = DMA_WRITE_ENGINE_EN_OFF,
+		.doorbell = DMA_WRITE_DOORBELL_OFF,
+		.stop = DMA_WRITE_DOORBELL_OFF_WR_STOP,
+		.int_mask = DMA_WRITE_INT_MASK_OFF,
+		.done_imwr = DMA_WRITE_DONE_IMWR_LOW_OFF,
+		.abort_imwr = DMA_WRITE_ABORT_IMWR_LOW_OFF,
+		.imwr_data = DMA_WRITE_IMWR_DATA_OFF_BASE,
+	}, {
+		.name = "read",
+		.write = false,
+		.max_chans = DMA_RD_CHNL_NUM,
+		.ch_off = DMA_CH_CONTROL1_OFF_RDCH - DMA_CH_CONTROL1_OFF_WRCH,
+		.engine_en = DMA_READ_ENGINE_EN_OFF,
+		.doorbell = DMA_READ_DOORBELL_OFF,
+		.stop = DMA_READ_DOORBELL_OFF_RD_STOP,
+		.int_mask = DMA_READ_INT_MASK_OFF,
+		.done_imwr = DMA_READ_DONE_IMWR_LOW_OFF,
+		.abort_imwr = DMA_READ_ABORT_IMWR_LOW_OFF,
+		.imwr_data = DMA_READ_IMWR_DATA_OFF_BASE,
+	},
+};
+
+static void ep_bench_setup(struct ep_pvt *ep, const struct ep_bench_dir *d,
+			   u8 nchans)
+{
+	u32 val, addr_lo, addr_hi;
+	u16 data;
+	u8 ch;
+
+	dma_common_wr(ep->mmio_addr, DMA_WRITE_ENGINE_EN_OFF_ENABLE,
+		      d->engine_en);
+
+	pci_read_config_dword(ep->pdev, ep->pdev->msi_cap + PCI_MSI_ADDRESS_LO,
+			      &addr_lo);
+	pci_read_config_dword(ep->pdev, ep->pdev->msi_cap + PCI_MSI_ADDRESS_HI,
+			      &addr_hi);
+	pci_read_config_word(ep->pdev, ep->pdev->msi_cap + PCI_MSI_DATA_64,
+			     &data);
+
+	dma_common_wr(ep->mmio_addr, addr_lo, d->done_imwr);
+	dma_common_wr(ep->mmio_addr, addr_lo, d->abort_imwr);
+	dma_common_wr(ep->mmio_addr, addr_hi, d->done_imwr + 4);
+	dma_common_wr(ep->mmio_addr, addr_hi, d->abort_imwr + 4);
+
+	/* same as the single shot tests: local interrupts masked, IMWr on */
+	val = dma_common_rd(ep->mmio_addr, d->int_mask);
+	for (ch = 0; ch < nchans; ch++) {
+		val |= BIT(ch) | BIT(ch + 16);
+		dma_common_wr16(ep->mmio_addr, data, d->imwr_data + 2 * ch);
+	}
+	dma_common_wr(ep->mmio_addr, val, d->int_mask);
+}
+
+static void ep_bench_start(struct ep_pvt *ep, const struct ep_bench_dir *d,
+			   u8 ch, u64 sar, u64 dar, u32 size, u64 llp)
+{
+	void __iomem *p = ep->mmio_addr;
+
+	if (llp) {
+		dma_channel_wr(p, ch, DMA_CH_CONTROL1_OFF_WRCH_LLE,
+			       d->ch_off + DMA_CH_CONTROL1_OFF_WRCH);
+		dma_channel_wr(p, ch, lower_32_bits(llp),
+			       d->ch_off + DMA_LLP_LOW_OFF_WRCH);
+		dma_channel_wr(p, ch, upper_32_bits(llp),
+			       d->ch_off + DMA_LLP_HIGH_OFF_WRCH);
+	} else {
+		dma_channel_wr(p, ch, DMA_CH_CONTROL1_OFF_WRCH_RIE |
+			       DMA_CH_CONTROL1_OFF_WRCH_LIE,
+			       d->ch_off + DMA_CH_CONTROL1_OFF_WRCH);
+		dma_channel_wr(p, ch, size,
+			       d->ch_off + DMA_TRANSFER_SIZE_OFF_WRCH);
+		dma_channel_wr(p, ch, lower_32_bits(sar),
+			       d->ch_off + DMA_SAR_LOW_OFF_WRCH);
+		dma_channel_wr(p, ch, upper_32_bits(sar),
+			       d->ch_off + DMA_SAR_HIGH_OFF_WRCH);
+		dma_channel_wr(p, ch, lower_32_bits(dar),
+			       d->ch_off + DMA_DAR_LOW_OFF_WRCH);
+		dma_channel_wr(p, ch, upper_32_bits(dar),
+			       d->ch_off + DMA_DAR_HIGH_OFF_WRCH);
+	}
+
+	if (d->write) {
+		reinit_completion(&ep->wr_cpl[ch]);
+		set_bit(ch, &ep->wr_busy);
+	} else {
+		reinit_completion(&ep->rd_cpl[ch]);
+		set_bit(ch, &ep->rd_busy);
+	}
+
+	dma_common_wr(p, ch, d->doorbell);
+}
+
+/* Returns the completion time as seen by the ISR */
+static int ep_bench_wait(struct ep_pvt *ep, const struct ep_bench_dir *d,
+			 u8 ch, ktime_t *done)
+{
+	struct completion *cpl = d->write ? &ep->wr_cpl[ch] : &ep->rd_cpl[ch];
+
+	if (!wait_for_completion_timeout(cpl, msecs_to_jiffies(5000))) {
+		dma_common_wr(ep->mmio_addr, d->stop | ch, d->doorbell);
+		clear_bit(ch, d->write ? &ep->wr_busy : &ep->rd_busy);
+		return -ETIMEDOUT;
+	}
+
+	*done = d->write ? ep->wr_done[ch] : ep->rd_done[ch];
+
+	return 0;
+}
+
+static void ep_bench_lock(struct ep_pvt *ep)
+{
+	int i;
+
+	for (i = 0; i < DMA_WR_CHNL_NUM; i++)
+		mutex_lock_nested(&ep->wr_lock[i], i);
+	for (i = 0; i < DMA_RD_CHNL_NUM; i++)
+		mutex_lock_nested(&ep->rd_lock[i], DMA_WR_CHNL_NUM + i);
+}
+
+static void ep_bench_unlock(struct ep_pvt *ep)
+{
+	int i;
+
+	for (i = DMA_RD_CHNL_NUM - 1; i >= 0; i--)
+		mutex_unlock(&ep->rd_lock[i]);
+	for (i = DMA_WR_CHNL_NUM - 1; i >= 0; i--)
+		mutex_unlock(&ep->wr_lock[i]);
+}
+
+static u64 ep_bench_ll_off(const struct ep_bench_dir *d, u8 ch)
+{
+	return ((d->write ? 0 : DMA_WR_CHNL_NUM) + ch) *
+	       (BENCH_MAX_LL + 1) * sizeof(struct dma_ll);
+}
+
+/*
+ * Build the lists of all channels in the host buffer and pull them into
+ * the EP with read channel 0, the engine only walks lists in EP memory.
+ */
+static int ep_bench_stage_ll(struct ep_pvt *ep, const struct ep_bench_dir *d,
+			     u8 nchans, u32 size, u32 depth, u64 slice)
+{
+	const struct ep_bench_dir *rd = &ep_bench_dirs[1];
+	u32 chunk = size / depth;
+	struct dma_ll *ll;
+	u64 ep_buf, host_buf, sar, dar;
+	u32 i, len = 0;
+	ktime_t done;
+	u8 ch;
+	int ret;
+
+	for (ch = 0; ch < nchans; ch++) {
+		ll = (struct dma_ll *)((u8 *)p_cpu_addr +
+				       ep_bench_ll_off(d, ch));
+		memset(ll, 0, (depth + 1) * sizeof(*ll));
+		ep_buf = ep->bench.ep_addr + BENCH_LL_AREA + ch * slice;
+		host_buf = dma_addr + BENCH_LL_AREA + ch * slice;
+
+		for (i = 0; i < depth; i++) {
+			sar = (d->write ? ep_buf : host_buf) + i * chunk;
+			dar = (d->write ? host_buf : ep_buf) + i * chunk;
+			ll[i].size = chunk;
+			ll[i].sar_low = lower_32_bits(sar);
+			ll[i].sar_high = upper_32_bits(sar);
+			ll[i].dar_low = lower_32_bits(dar);
+			ll[i].dar_high = upper_32_bits(dar);
+		}
+		ll[depth - 1].ele_1.lie = 1;
+		ll[depth - 1].ele_1.rie = 1;
+		ll[depth].ele_1.llp = 1;
+		ll[depth].ele_1.tcb = 1;
+		len = ep_bench_ll_off(d, ch) + (depth + 1) * sizeof(*ll);
+	}
+
+	ep_bench_setup(ep, rd, 1);
+	ep_bench_start(ep, rd, 0, dma_addr, ep->bench.ep_addr, len, 0);
+	ret = ep_bench_wait(ep, rd, 0, &done);
+	if (ret < 0)
+		dev_err(&ep->pdev->dev, "bench: staging linked lists failed\n");
+
+	return ret;
+}
+
+static int ep_bench_mmio_thread(void *data)
+{
+	struct ep_pvt *ep = data;
+	void __iomem *p = ep->bench.bar + ep->bench.ep_size - BENCH_MMIO_AREA;
+	u32 off;
+
+	while (!kthread_should_stop()) {
+		for (off = 0; off < BENCH_MMIO_AREA; off += 4)
+			writel(off, p + off);
+		/* a read flushes the posted writes out of the host */
+		readl(p);
+		atomic64_add(BENCH_MMIO_AREA, &ep->bench.mmio_bytes);
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int ep_bench_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int ep_bench_point(struct seq_file *s, struct ep_pvt *ep,
+			  const struct ep_bench_dir *d, u8 nchans, u32 size,
+			  u32 depth, u64 slice)
+{
+	u64 ep_buf, host_buf, llp = 0, bytes, ns = 0, mmio_ns, mmio = 0;
+	struct task_struct *mmio_task = NULL;
+	u32 iters = ep->bench.iters, n = 0, it;
+	ktime_t start[DMA_WR_CHNL_NUM], done, end, t0, t1;
+	int ret = 0;
+	u8 ch;
+
+	if (depth) {
+		ret = ep_bench_stage_ll(ep, d, nchans, size, depth, slice);
+		if (ret < 0)
+			return ret;
+	}
+	ep_bench_setup(ep, d, nchans);
+
+	if (ep->bench.mmio) {
+		atomic64_set(&ep->bench.mmio_bytes, 0);
+		mmio_task = kthread_run(ep_bench_mmio_thread, ep,
+					"tegra_ep_bench_mmio");
+		if (IS_ERR(mmio_task))
+			mmio_task = NULL;
+	}
+
+	t0 = ktime_get();
+	for (it = 0; it < iters && !ret; it++) {
+		for (ch = 0; ch < nchans; ch++) {
+			ep_buf = ep->bench.ep_addr + BENCH_LL_AREA + ch * slice;
+			host_buf = dma_addr + BENCH_LL_AREA + ch * slice;
+			if (depth)
+				llp = ep->bench.ep_addr +
+				      ep_bench_ll_off(d, ch);
+			start[ch] = ktime_get();
+			ep_bench_start(ep, d, ch,
+				       d->write ? ep_buf : host_buf,
+				       d->write ? host_buf : ep_buf,
+				       size, llp);
+		}
+
+		end = start[0];
+		for (ch = 0; ch < nchans; ch++) {
+			ret = ep_bench_wait(ep, d, ch, &done);
+			if (ret < 0)
+				break;
+			ep->bench.lat[n++] = ktime_to_ns(ktime_sub(done,
+								   start[ch]));
+			if (ktime_after(done, end))
+				end = done;
+		}
+		/* the channels overlap, a round lasts until the last one */
+		ns += ktime_to_ns(ktime_sub(end, start[0]));
+	}
+	t1 = ktime_get();
+
+	if (mmio_task) {
+		kthread_stop(mmio_task);
+		mmio_ns = ktime_to_ns(ktime_sub(t1, t0));
+		mmio = div64_u64(atomic64_read(&ep->bench.mmio_bytes) * 1000,
+				 mmio_ns ? mmio_ns : 1);
+	}
+
+	if (ret < 0) {
+		seq_printf(s, "%s,%u,%u,%u,%u,,,,,,,timeout\n", d->name,
+			   nchans, size, depth, it);
+		return ret;
+	}
+
+	sort(ep->bench.lat, n, sizeof(u64), ep_bench_cmp_u64, NULL);
+	bytes = (u64)size * nchans * iters;
+	seq_printf(s, "%s,%u,%u,%u,%u,%llu,%llu,%llu,%llu,%llu,%llu,ok\n",
+		   d->name, nchans, size, depth, iters,
+		   div64_u64(bytes * 1000, ns ? ns : 1),
+		   ep->bench.lat[n / 2], ep->bench.lat[n * 9 / 10],
+		   ep->bench.lat[n * 99 / 100], ep->bench.lat[n - 1], mmio);
+
+	return 0;
+}
+
+static int bench_run(struct seq_file *s, void *data)
+{
+	struct ep_pvt *ep = (struct ep_pvt *)(s->private);
+	const struct ep_bench_dir *d;
+	u64 ep_payload, host_payload, slice;
+	u32 size, depth, di;
+	u8 nchans, max_chans;
+	int ret = 0;
+
+	if (!ep->bench.ep_addr) {
+		dev_err(&ep->pdev->dev,
+			"bench: set ep_addr to the EP address of BAR0 first\n");
+		return -EINVAL;
+	}
+	if (!ep->bench.bar) {
+		dev_err(&ep->pdev->dev, "bench: BAR0 is not mapped\n");
+		return -ENOMEM;
+	}
+	if (!ep->bench.iters || ep->bench.iters > BENCH_MAX_ITERS ||
+	    !ep->bench.min_size || ep->bench.min_size > ep->bench.max_size ||
+	    ep->bench.max_ll > BENCH_MAX_LL ||
+	    ep->bench.ep_size > pci_resource_len(ep->pdev, 0) ||
+	    ep->bench.ep_size < BENCH_LL_AREA + BENCH_MMIO_AREA + SZ_4K) {
+		dev_err(&ep->pdev->dev, "bench: invalid parameters\n");
+		return -EINVAL;
+	}
+
+	mutex_lock(&ep->bench.lock);
+	ep_bench_lock(ep);
+
+	ep_payload = ep->bench.ep_size - BENCH_LL_AREA -
+		     (ep->bench.mmio ? BENCH_MMIO_AREA : 0);
+	host_payload = alloc_size - BENCH_LL_AREA;
+
+	seq_puts(s, "dir,chans,size,ll,iters,MBps,lat_p50_ns,lat_p90_ns,lat_p99_ns,lat_max_ns,mmio_MBps,status\n");
+
+	for (di = 0; di < ARRAY_SIZE(ep_bench_dirs) && !ret; di++) {
+		d = &ep_bench_dirs[di];
+		max_chans = min_t(u8, d->write ? ep->bench.wr_chans :
+				  ep->bench.rd_chans, d->max_chans);
+
+		for (nchans = 1; nchans <= max_chans && !ret; nchans++) {
+			slice = min(ep_payload, host_payload) / nchans;
+			slice = round_down(slice, SZ_4K);
+
+			for (size = ep->bench.min_size;
+			     size && size <= ep->bench.max_size && size <= slice
+			     && !ret; size <<= 1) {
+				depth = 0;
+				do {
+					if (size / (depth ? depth : 1) >= 4)
+						ret = ep_bench_point(s, ep, d,
+								     nchans,
+								     size,
+								     depth,
+								     slice);
+					depth = depth ? depth << 1 : 1;
+				} while (depth <= ep->bench.max_ll && !ret);
+			}
+		}
+	}
+
+	ep_bench_unlock(ep);
+	mutex_unlock(&ep->bench.lock);
+
+	return 0;
+}
+
 #define DEFINE_ENTRY(__name)	\
 static int __name ## _open(struct inode *inode, struct file *file)	\
 {									\
@@ -724,6 +1139,19 @@ DEFINE_ENTRY(write_ll);
 DEFINE_ENTRY(read);
 DEFINE_ENTRY(read_ll);
 
+/* Sized for a full default sweep, seq_read would rerun it on overflow */
+static int bench_run_open(struct inode *inode, struct file *file)
+{
+	return single_open_size(file, bench_run, inode->i_private, SZ_128K);
+}
+
+static const struct file_operations bench_run_fops = {
+	.open		= bench_run_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int init_debugfs(struct ep_pvt *ep)
 {
 	struct dentry *d;
@@ -767,6 +1195,34 @@ static int init_debugfs(struct ep_pvt *ep)
 				&read_ll_fops);
 	if (!d)
 		pr_err("debugfs for read failed\n");
+
+	ep->bench.debugfs = debugfs_create_dir("bench", ep->debugfs);
+	if (!ep->bench.debugfs) {
+		pr_err("debugfs for bench failed\n");
+		return 0;
+	}
+	debugfs_create_x64("ep_addr", 0644, ep->bench.debugfs,
+			   &ep->bench.ep_addr);
+	debugfs_create_x32("ep_size", 0644, ep->bench.debugfs,
+			   &ep->bench.ep_size);
+	debugfs_create_u32("min_size", 0644, ep->bench.debugfs,
+			   &ep->bench.min_size);
+	debugfs_create_u32("max_size", 0644, ep->bench.debugfs,
+			   &ep->bench.max_size);
+	debugfs_create_u32("iters", 0644, ep->bench.debugfs,
+			   &ep->bench.iters);
+	debugfs_create_u8("wr_chans", 0644, ep->bench.debugfs,
+			  &ep->bench.wr_chans);
+	debugfs_create_u8("rd_chans", 0644, ep->bench.debugfs,
+			  &ep->bench.rd_chans);
+	debugfs_create_u32("max_ll", 0644, ep->bench.debugfs,
+			   &ep->bench.max_ll);
+	debugfs_create_bool("mmio", 0644, ep->bench.debugfs, &ep->bench.mmio);
+	d = debugfs_create_file("run", 0444, ep->bench.debugfs, (void *)ep,
+				&bench_run_fops);
+	if (!d)
+		pr_err("debugfs for bench run failed\n");
+
 	return 0;
 }
 
@@ -853,6 +1309,22 @@ static int ep_test_dma_probe(struct pci_dev *pdev,
 	if (!(val16 & PCI_MSI_FLAGS_ENABLE))
 		dev_warn(&pdev->dev, "MSI interrupts are not enabled\n");
 
+	mutex_init(&ep->bench.lock);
+	ep->bench.ep_size = pci_resource_len(pdev, 0);
+	ep->bench.min_size = SZ_4K;
+	ep->bench.max_size = SZ_1M;
+	ep->bench.iters = 64;
+	ep->bench.wr_chans = DMA_WR_CHNL_NUM;
+	ep->bench.rd_chans = DMA_RD_CHNL_NUM;
+	ep->bench.max_ll = 16;
+	ep->bench.lat = devm_kcalloc(&pdev->dev,
+				     BENCH_MAX_ITERS * DMA_WR_CHNL_NUM,
+				     sizeof(*ep->bench.lat), GFP_KERNEL);
+	if (ep->bench.lat)
+		ep->bench.bar = pci_ioremap_bar(pdev, 0);
+	if (!ep->bench.bar)
+		dev_warn(&pdev->dev, "benchmark is not available\n");
+
 	ep->debugfs = debugfs_create_dir("tegra_pcie_ep", NULL);
 	if (!ep->debugfs)
 		dev_err(&pdev->dev, "debugfs creation failed\n");
@@ -881,6 +1353,8 @@ static void ep_test_dma_remove(struct pci_dev *pdev)
 	struct ep_pvt *ep = pci_get_drvdata(pdev);
 
 	debugfs_remove_recursive(ep->debugfs);
+	if (ep->bench.bar)
+		iounmap(ep->bench.bar);
 	free_irq(pdev->irq, ep);
 	pci_disable_msi(pdev);
 	dma_free_coherent(&pdev->dev, alloc_size, p_cpu_addr, dma_addr);
@@ -0,0 +1,327 @@
+/*
+ * drivers/misc/tegra-profiler/aggr.c
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/jhash.h>
+#include <linux/smp.h>
+#include <linux/string.h>
+#include <linux/rcupdate.h>
+
+#include <linux/tegra_profiler.h>
+
+#include "aggr.h"
+#include "quadd.h"
+#include "hrt.h"
+#include "comm.h"
+#include "backtrace.h"
+
+/*
+ * In aggregation mode identical samples, i.e. the same thread, ip and
+ * callchain, are counted in a per-CPU hash table instead of being
+ * streamed one by one. The table is emitted into the CPU's own ring as
+ * QUADD_RECORD_TYPE_AGGR_SAMPLE records at the end of every interval and
+ * whenever it runs out of room.
+ */
+
+#define AGGR_MAX_PROBES		8
+
+struct aggr_entry {
+	u32 hash;
+	u32 count;
+
+	u32 pid;
+	u32 tgid;
+	u64 ip;
+
+	u8 nr;
+	u8 used:1,
+	   user_mode:1,
+	   thumb_mode:1,
+	   is_ip64:1;
+
+	u64 ips[QUADD_MAX_STACK_DEPTH];
+};
+
+struct aggr_table {
+	u64 start_time;
+	unsigned int nr_used;
+
+	struct aggr_entry entries[QUADD_AGGR_TABLE_SIZE];
+};
+
+struct quadd_aggr_ctx {
+	atomic_t active;
+	u64 interval;	/* ns */
+};
+
+static struct quadd_aggr_ctx aggr_ctx;
+static DEFINE_PER_CPU(struct aggr_table *, aggr_tables);
+
+static inline u64 cc_ip(struct quadd_callchain *cc, int i)
+{
+	return cc->cs_64 ? cc->ip_64[i] : cc->ip_32[i];
+}
+
+static u32 sample_hash(struct quadd_sample_data *s,
+		       struct quadd_callchain *cc, int nr)
+{
+	int i;
+	u32 hash;
+
+	hash = jhash_3words(s->pid, (u32)s->ip, (u32)(s->ip >> 32), nr);
+
+	for (i = 0; i < nr; i++)
+		hash = jhash_2words((u32)cc_ip(cc, i),
+				    (u32)(cc_ip(cc, i) >> 32), hash);
+
+	return hash;
+}
+
+static int entry_match(struct aggr_entry *e, u32 hash,
+		       struct quadd_sample_data *s,
+		       struct quadd_callchain *cc, int nr)
+{
+	int i;
+
+	if (e->hash != hash || e->pid != s->pid || e->ip != s->ip ||
+	    e->nr != nr || e->is_ip64 != !!cc->cs_64 ||
+	    e->user_mode != s->user_mode)
+		return 0;
+
+	for (i = 0; i < nr; i++) {
+		if (e->ips[i] != cc_ip(cc, i))
+			return 0;
+	}
+
+	return 1;
+}
+
+static void put_entry(struct aggr_entry *e, u64 time, int cpu)
+{
+	int i;
+	u32 ips_32[QUADD_MAX_STACK_DEPTH];
+	struct quadd_iovec vec;
+	struct quadd_record_data record;
+	struct quadd_aggr_sample_data *as = &record.aggr_sample;
+
+	record.record_type = QUADD_RECORD_TYPE_AGGR_SAMPLE;
+
+	as->ip = e->ip;
+	as->pid = e->pid;
+	as->tgid = e->tgid;
+	as->time = time;
+	as->count = e->count;
+
+	as->cpu = cpu;
+	as->user_mode = e->user_mode;
+	as->thumb_mode = e->thumb_mode;
+	as->is_ip64 = e->is_ip64;
+	as->reserved = 0;
+
+	as->callchain_nr = e->nr;
+
+	if (e->is_ip64) {
+		vec.base = e->ips;
+		vec.len = e->nr * sizeof(e->ips[0]);
+	} else {
+		for (i = 0; i < e->nr; i++)
+			ips_32[i] = (u32)e->ips[i];
+
+		vec.base = ips_32;
+		vec.len = e->nr * sizeof(ips_32[0]);
+	}
+
+	quadd_put_sample_this_cpu(&record, &vec, 1);
+}
+
+/* Called with local interrupts disabled */
+static void flush_table(struct aggr_table *t, u64 now)
+{
+	int i, cpu = smp_processor_id();
+	struct aggr_entry *e;
+
+	for (i = 0; i < QUADD_AGGR_TABLE_SIZE && t->nr_used; i++) {
+		e = &t->entries[i];
+		if (!e->used)
+			continue;
+
+		put_entry(e, now, cpu);
+
+		e->used = 0;
+		t->nr_used--;
+	}
+
+	t->start_time = now;
+}
+
+static struct aggr_entry *
+find_entry(struct aggr_table *t, u32 hash,
+	   struct quadd_sample_data *s,
+	   struct quadd_callchain *cc, int nr)
+{
+	int i;
+	unsigned int idx;
+	struct aggr_entry *e;
+
+	for (i = 0; i < AGGR_MAX_PROBES; i++) {
+		idx = (hash + i) & (QUADD_AGGR_TABLE_SIZE - 1);
+		e = &t->entries[idx];
+
+		if (!e->used || entry_match(e, hash, s, cc, nr))
+			return e;
+	}
+
+	return NULL;
+}
+
+int quadd_aggr_add(struct quadd_sample_data *s,
+		   struct quadd_callchain *cc, int nr)
+{
+	int i;
+	u32 hash;
+	unsigned long flags;
+	struct aggr_table *t;
+	struct aggr_entry *e;
+
+	if (!atomic_read(&aggr_ctx.active))
+		return -ENODEV;
+
+	nr = clamp_t(int, nr, 0, QUADD_MAX_STACK_DEPTH);
+	hash = sample_hash(s, cc, nr);
+
+	local_irq_save(flags);
+
+	t = __this_cpu_read(aggr_tables);
+	if (!t) {
+		local_irq_restore(flags);
+		return -ENODEV;
+	}
+
+	if (s->time - t->start_time >= aggr_ctx.interval)
+		flush_table(t, s->time);
+
+	e = find_entry(t, hash, s, cc, nr);
+	if (!e) {
+		flush_table(t, s->time);
+		e = find_entry(t, hash, s, cc, nr);
+	}
+
+	if (!e->used) {
+		e->used = 1;
+		e->hash = hash;
+		e->count = 0;
+
+		e->pid = s->pid;
+		e->tgid = s->tgid;
+		e->ip = s->ip;
+
+		e->user_mode = s->user_mode;
+		e->thumb_mode = s->thumb_mode;
+		e->is_ip64 = cc->cs_64 ? 1 : 0;
+
+		e->nr = nr;
+		for (i = 0; i < nr; i++)
+			e->ips[i] = cc_ip(cc, i);
+
+		t->nr_used++;
+	}
+
+	e->count++;
+
+	local_irq_restore(flags);
+
+	return 0;
+}
+
+int quadd_aggr_is_active(void)
+{
+	return atomic_read(&aggr_ctx.active);
+}
+
+static void free_tables(void)
+{
+	int cpu_id;
+
+	for_each_possible_cpu(cpu_id) {
+		vfree(per_cpu(aggr_tables, cpu_id));
+		per_cpu(aggr_tables, cpu_id) = NULL;
+	}
+}
+
+int quadd_aggr_start(struct quadd_ctx *ctx)
+{
+	int cpu_id;
+	u64 now;
+	unsigned int interval;
+	struct aggr_table *t;
+	struct quadd_parameters *param = &ctx->param;
+	unsigned int extra = param->reserved[QUADD_PARAM_IDX_EXTRA];
+
+	atomic_set(&aggr_ctx.active, 0);
+
+	if (!(extra & QUADD_PARAM_EXTRA_AGGREGATION))
+		return 0;
+
+	interval = param->reserved[QUADD_PARAM_IDX_AGGR_INTERVAL];
+	if (interval == 0)
+		interval = QUADD_AGGR_DEF_INTERVAL_MS;
+
+	aggr_ctx.interval = (u64)interval * NSEC_PER_MSEC;
+
+	now = quadd_get_time();
+
+	for_each_possible_cpu(cpu_id) {
+		t = vzalloc_node(sizeof(*t), cpu_to_node(cpu_id));
+		if (!t) {
+			free_tables();
+			return -ENOMEM;
+		}
+
+		t->start_time = now;
+		per_cpu(aggr_tables, cpu_id) = t;
+	}
+
+	atomic_set(&aggr_ctx.active, 1);
+
+	pr_info("aggregation: interval: %u ms\n", interval);
+
+	return 0;
+}
+
+static void flush_this_cpu(void *info)
+{
+	struct aggr_table *t = __this_cpu_read(aggr_tables);
+
+	if (t)
+		flush_table(t, quadd_get_time());
+}
+
+void quadd_aggr_stop(void)
+{
+	if (!atomic_cmpxchg(&aggr_ctx.active, 1, 0))
+		return;
+
+	/* let the samplers which saw the table active finish with it */
+	synchronize_sched();
+
+	/* partial tables of offline CPUs are dropped */
+	on_each_cpu(flush_this_cpu, NULL, 1);
+
+	free_tables();
+}
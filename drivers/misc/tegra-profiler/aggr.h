@@ -0,0 +1,35 @@
+/*
+ * drivers/misc/tegra-profiler/aggr.h
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ */
+
+#ifndef __QUADD_AGGR_H
+#define __QUADD_AGGR_H
+
+#define QUADD_AGGR_DEF_INTERVAL_MS	1000
+#define QUADD_AGGR_TABLE_SIZE		256
+
+struct quadd_ctx;
+struct quadd_sample_data;
+struct quadd_callchain;
+
+int quadd_aggr_start(struct quadd_ctx *ctx);
+void quadd_aggr_stop(void);
+
+int quadd_aggr_is_active(void);
+
+int quadd_aggr_add(struct quadd_sample_data *s,
+		   struct quadd_callchain *cc, int nr);
+
+#endif	/* __QUADD_AGGR_H */
@@ -26,6 +26,7 @@
 #include <linux/mm.h>
 #include <linux/circ_buf.h>
 #include <linux/uaccess.h>
+#include <linux/smp.h>
 
 #include <linux/tegra_profiler.h>
 
@@ -35,14 +36,25 @@
 
 struct quadd_ring_buffer {
 	struct quadd_ring_buffer_hdr *rb_hdr;
-	char *buf;
 
 	size_t max_fill_count;
 	size_t nr_skipped_samples;
 
 	struct quadd_mmap_area *mmap;
+};
 
-	raw_spinlock_t lock;
+/*
+ * Each ring has a single producer, the CPU that owns it. Writers run with
+ * local interrupts disabled and never take a lock; rb_hdr is published
+ * with release semantics once the ring is set up, and mmap_close() waits
+ * for a scheduler grace period before the buffer is freed.
+ */
+struct rb_remote_sample {
+	struct quadd_ring_buffer *rb;
+	struct quadd_record_data *data;
+	struct quadd_iovec *vec;
+	int vec_count;
+	ssize_t err;
 };
 
 struct quadd_comm_ctx {
@@ -102,12 +114,17 @@ write_sample(struct quadd_ring_buffer *rb,
 	     const struct quadd_iovec *vec, int vec_count)
 {
 	int i;
+	char *buf;
 	size_t len = 0, c;
-	struct quadd_ring_buffer_hdr hdr, *rb_hdr = rb->rb_hdr;
+	struct quadd_ring_buffer_hdr hdr, *rb_hdr;
 
+	rb_hdr = smp_load_acquire(&rb->rb_hdr);
 	if (!rb_hdr)
 		return -EIO;
 
+	/* data starts at the page following the headers, see init_mmap_hdr */
+	buf = PTR_ALIGN((char *)rb_hdr, PAGE_SIZE);
+
 	if (vec) {
 		for (i = 0; i < vec_count; i++)
 			len += vec[i].len;
@@ -127,11 +144,11 @@ write_sample(struct quadd_ring_buffer *rb,
 		return -ENOSPC;
 	}
 
-	rb_write(&hdr, rb->buf, sample, sizeof(*sample));
+	rb_write(&hdr, buf, sample, sizeof(*sample));
 
 	if (vec) {
 		for (i = 0; i < vec_count; i++)
-			rb_write(&hdr, rb->buf, vec[i].base, vec[i].len);
+			rb_write(&hdr, buf, vec[i].base, vec[i].len);
 	}
 
 	c = CIRC_CNT(hdr.pos_write, hdr.pos_read, hdr.size);
@@ -151,7 +168,6 @@ write_sample(struct quadd_ring_buffer *rb,
 static size_t get_data_size(void)
 {
 	int cpu_id;
-	unsigned long flags;
 	size_t size = 0, tail;
 	struct comm_cpu_context *cc;
 	struct quadd_ring_buffer *rb;
@@ -162,55 +178,98 @@ static size_t get_data_size(void)
 
 		rb = &cc->rb;
 
-		rb_hdr = rb->rb_hdr;
+		rb_hdr = smp_load_acquire(&rb->rb_hdr);
 		if (!rb_hdr)
 			continue;
 
-		raw_spin_lock_irqsave(&rb->lock, flags);
-
 		tail = READ_ONCE(rb_hdr->pos_read);
-		size += CIRC_CNT(rb_hdr->pos_write, tail, rb_hdr->size);
-
-		raw_spin_unlock_irqrestore(&rb->lock, flags);
+		size += CIRC_CNT(READ_ONCE(rb_hdr->pos_write), tail,
+				 rb_hdr->size);
 	}
 
 	return size;
 }
 
+/* Called on the CPU owning rb with local interrupts disabled */
+static ssize_t
+put_sample_local(struct quadd_ring_buffer *rb,
+		 struct quadd_record_data *data,
+		 struct quadd_iovec *vec, int vec_count)
+{
+	ssize_t err;
+	struct quadd_ring_buffer_hdr *rb_hdr;
+
+	err = write_sample(rb, data, vec, vec_count);
+	if (err < 0) {
+		pr_err_once("%s: error: write sample\n", __func__);
+		rb->nr_skipped_samples++;
+
+		rb_hdr = READ_ONCE(rb->rb_hdr);
+		if (rb_hdr)
+			rb_hdr->skipped_samples++;
+	}
+
+	return err;
+}
+
+static void put_sample_remote(void *info)
+{
+	struct rb_remote_sample *s = info;
+
+	s->err = put_sample_local(s->rb, s->data, s->vec, s->vec_count);
+}
+
 static ssize_t
 put_sample(struct quadd_record_data *data,
 	   struct quadd_iovec *vec,
 	   int vec_count, int cpu_id)
 {
-	ssize_t err = 0;
+	int this_cpu;
+	ssize_t err;
 	unsigned long flags;
-	struct comm_cpu_context *cc;
-	struct quadd_ring_buffer *rb;
-	struct quadd_ring_buffer_hdr *rb_hdr;
+	struct rb_remote_sample s;
 
 	if (!atomic_read(&comm_ctx.active))
 		return -EIO;
 
-	cc = cpu_id < 0 ? this_cpu_ptr(&cpu_ctx) :
-		&per_cpu(cpu_ctx, cpu_id);
-
-	rb = &cc->rb;
+	this_cpu = get_cpu();
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
+	if (cpu_id < 0 || cpu_id == this_cpu) {
+		local_irq_save(flags);
+		err = put_sample_local(&this_cpu_ptr(&cpu_ctx)->rb,
+				       data, vec, vec_count);
+		local_irq_restore(flags);
+		put_cpu();
+		return err;
+	}
 
-	err = write_sample(rb, data, vec, vec_count);
-	if (err < 0) {
-		pr_err_once("%s: error: write sample\n", __func__);
-		rb->nr_skipped_samples++;
+	put_cpu();
 
-		rb_hdr = rb->rb_hdr;
-		if (rb_hdr)
-			rb_hdr->skipped_samples++;
+	/*
+	 * Samples for another CPU (per-CPU headers at start) are written by
+	 * that CPU so the ring keeps a single producer. An offline CPU has
+	 * no producer and its ring is written directly.
+	 */
+	s.rb = &per_cpu(cpu_ctx, cpu_id).rb;
+	s.data = data;
+	s.vec = vec;
+	s.vec_count = vec_count;
+	s.err = -EIO;
+
+	if (cpu_online(cpu_id) && !irqs_disabled()) {
+		if (smp_call_function_single(cpu_id, put_sample_remote,
+					     &s, 1) == 0)
+			return s.err;
 	}
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
+	if (cpu_online(cpu_id))
+		return -EBUSY;
 
-	return err;
+	local_irq_save(flags);
+	put_sample_remote(&s);
+	local_irq_restore(flags);
+
+	return s.err;
 }
 
 static void comm_reset(void)
@@ -274,7 +333,6 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 {
 	unsigned int cpu_id;
 	size_t size;
-	unsigned long flags;
 	struct vm_area_struct *vma;
 	struct quadd_ring_buffer *rb;
 	struct quadd_ring_buffer_hdr *rb_hdr;
@@ -299,14 +357,14 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	if (size <= PAGE_SIZE || !is_power_of_2(size - PAGE_SIZE))
 		return -EINVAL;
 
-	size -= PAGE_SIZE;
+	if (READ_ONCE(rb->rb_hdr))
+		return -EBUSY;
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
+	size -= PAGE_SIZE;
 
 	mmap->rb = rb;
 
 	rb->mmap = mmap;
-	rb->buf = (char *)mmap->data + PAGE_SIZE;
 
 	rb->max_fill_count = 0;
 	rb->nr_skipped_samples = 0;
@@ -319,7 +377,6 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	mmap_hdr->samples_version = QUADD_SAMPLES_VERSION;
 
 	rb_hdr = (struct quadd_ring_buffer_hdr *)(mmap_hdr + 1);
-	rb->rb_hdr = rb_hdr;
 
 	rb_hdr->size = size;
 	rb_hdr->pos_read = 0;
@@ -330,7 +387,8 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 
 	rb_hdr->state = QUADD_RB_STATE_ACTIVE;
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
+	/* Pairs with smp_load_acquire() in write_sample() */
+	smp_store_release(&rb->rb_hdr, rb_hdr);
 
 	pr_debug("[cpu: %d] init_mmap_hdr: vma: %#lx - %#lx, data: %p - %p\n",
 		 cpu_id,
@@ -363,20 +421,14 @@ static void rb_stop(void)
 	}
 }
 
+/* The caller must wait for a grace period before freeing the buffer */
 static void rb_reset(struct quadd_ring_buffer *rb)
 {
-	unsigned long flags;
-
 	if (!rb)
 		return;
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
-
+	WRITE_ONCE(rb->rb_hdr, NULL);
 	rb->mmap = NULL;
-	rb->buf = NULL;
-	rb->rb_hdr = NULL;
-
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
 }
 
 static int
@@ -778,6 +830,10 @@ out:
 	raw_spin_unlock(&comm_ctx.mmaps_lock);
 
 	if (mmap) {
+		/* writers run with irqs off, wait for them to drop the ring */
+		if (mmap->type == QUADD_MMAP_TYPE_RB)
+			synchronize_sched();
+
 		vfree(mmap->data);
 		kfree(mmap);
 	}
@@ -918,13 +974,10 @@ static int comm_init(void)
 		struct quadd_ring_buffer *rb = &cc->rb;
 
 		rb->mmap = NULL;
-		rb->buf = NULL;
 		rb->rb_hdr = NULL;
 
 		rb->max_fill_count = 0;
 		rb->nr_skipped_samples = 0;
-
-		raw_spin_lock_init(&rb->lock);
 	}
 
 	reset_params_ok_flag();
@@ -21,6 +21,8 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/err.h>
+#include <linux/hash.h>
+#include <linux/log2.h>
 
 #include <asm/unaligned.h>
 
@@ -124,12 +126,19 @@ struct stackframe {
 	int is_sched;
 };
 
+#define DW_FDE_CACHE_SIZE	32
+
+struct dw_fde_cache_entry;
+
 struct dwarf_cpu_context {
 	struct regs_state rs_stack[DW_MAX_RS_STACK_DEPTH];
 	int depth;
 
 	struct stackframe sf;
 	int dw_ptr_size;
+
+	struct dw_fde_cache_entry *fde_cache;
+	unsigned int fde_cache_gen;
 };
 
 struct quadd_dwarf_context {
@@ -181,6 +190,19 @@ struct eh_sec_data {
 	unsigned char *data;
 };
 
+/*
+ * Decoded FDE/CIE pairs, keyed by the FDE address in the mmap area. The
+ * entries are only valid for the regions generation they were decoded in.
+ */
+struct dw_fde_cache_entry {
+	unsigned char *fde_p;
+	unsigned int gen;
+	int is_eh;
+
+	struct dw_cie cie;
+	struct dw_fde fde;
+};
+
 static struct quadd_dwarf_context ctx;
 
 static inline int regnum_sp(int mode)
@@ -1600,6 +1622,44 @@ dwarf_decode_fde_cie(struct ex_region_info *ri,
 	return 0;
 }
 
+static long
+dwarf_decode_fde_cie_cached(struct ex_region_info *ri,
+			    unsigned char *fde_p,
+			    struct dw_cie *cie,
+			    struct dw_fde *fde,
+			    int is_eh)
+{
+	long err;
+	struct dw_fde_cache_entry *ce;
+	struct dwarf_cpu_context *cpu_ctx = this_cpu_ptr(ctx.cpu_ctx);
+
+	if (!cpu_ctx->fde_cache)
+		return dwarf_decode_fde_cie(ri, fde_p, cie, fde, is_eh);
+
+	ce = &cpu_ctx->fde_cache[hash_ptr(fde_p, ilog2(DW_FDE_CACHE_SIZE))];
+
+	if (ce->fde_p == fde_p && ce->is_eh == is_eh &&
+	    ce->gen == cpu_ctx->fde_cache_gen) {
+		*cie = ce->cie;
+		*fde = ce->fde;
+		fde->cie = cie;
+		return 0;
+	}
+
+	err = dwarf_decode_fde_cie(ri, fde_p, cie, fde, is_eh);
+	if (err < 0)
+		return err;
+
+	ce->fde_p = fde_p;
+	ce->gen = cpu_ctx->fde_cache_gen;
+	ce->is_eh = is_eh;
+	ce->cie = *cie;
+	ce->fde = *fde;
+	ce->fde.cie = NULL;
+
+	return 0;
+}
+
 static void *
 dwarf_find_fde(struct ex_region_info *ri,
 	       struct stackframe *sf,
@@ -1761,7 +1821,7 @@ dwarf_decode(struct ex_region_info *ri,
 	if (!fde_p)
 		return -QUADD_URC_IDX_NOT_FOUND;
 
-	err = dwarf_decode_fde_cie(ri, fde_p, cie, fde, is_eh);
+	err = dwarf_decode_fde_cie_cached(ri, fde_p, cie, fde, is_eh);
 	if (err < 0)
 		return err;
 
@@ -2176,6 +2236,9 @@ quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 		return 0;
 	}
 
+	/* read after the region is pinned, see dw_fde_cache_entry */
+	cpu_ctx->fde_cache_gen = quadd_unwind_get_gen();
+
 	unwind_backtrace(cc, &ri, sf, vma_sp, task);
 	quadd_put_dw_frames(&ri);
 
@@ -2186,14 +2249,39 @@ quadd_get_user_cc_dwarf(struct quadd_event_context *event_ctx,
 	return cc->nr;
 }
 
+static void free_fde_cache(void)
+{
+	int cpu_id;
+	struct dwarf_cpu_context *cpu_ctx;
+
+	for_each_possible_cpu(cpu_id) {
+		cpu_ctx = per_cpu_ptr(ctx.cpu_ctx, cpu_id);
+
+		kfree(cpu_ctx->fde_cache);
+		cpu_ctx->fde_cache = NULL;
+	}
+}
+
 int quadd_dwarf_unwind_start(void)
 {
+	int cpu_id;
+	struct dwarf_cpu_context *cpu_ctx;
+
 	if (!atomic_cmpxchg(&ctx.started, 0, 1)) {
 		ctx.cpu_ctx = alloc_percpu(struct dwarf_cpu_context);
 		if (!ctx.cpu_ctx) {
 			atomic_set(&ctx.started, 0);
 			return -ENOMEM;
 		}
+
+		/* the cache is optional, unwinding works without it */
+		for_each_possible_cpu(cpu_id) {
+			cpu_ctx = per_cpu_ptr(ctx.cpu_ctx, cpu_id);
+			cpu_ctx->fde_cache =
+				kcalloc_node(DW_FDE_CACHE_SIZE,
+					     sizeof(*cpu_ctx->fde_cache),
+					     GFP_KERNEL, cpu_to_node(cpu_id));
+		}
 	}
 
 	return 0;
@@ -2201,8 +2289,10 @@ int quadd_dwarf_unwind_start(void)
 
 void quadd_dwarf_unwind_stop(void)
 {
-	if (atomic_cmpxchg(&ctx.started, 1, 0))
+	if (atomic_cmpxchg(&ctx.started, 1, 0)) {
+		free_fde_cache();
 		free_percpu(ctx.cpu_ctx);
+	}
 }
 
 int quadd_dwarf_unwind_init(void)
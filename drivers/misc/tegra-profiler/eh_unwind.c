@@ -62,6 +62,9 @@ struct quadd_unwind_ctx {
 	pid_t pid;
 	unsigned long ex_tables_size;
 	raw_spinlock_t lock;
+
+	/* bumped on every change of the mapped regions */
+	atomic_t gen;
 };
 
 struct unwind_idx {
@@ -578,6 +581,7 @@ int quadd_unwind_set_extab(struct quadd_sections *extabs,
 	list_add_tail(&ex_entry->list, &mmap->ex_entries);
 
 	rcu_assign_pointer(ctx.rd, rd_new);
+	atomic_inc(&ctx.gen);
 
 	if (rd)
 		call_rcu(&rd->rcu, rd_free_rcu);
@@ -701,6 +705,7 @@ __quadd_unwind_delete_mmap(struct quadd_mmap_area *mmap)
 	rd_new->curr_nr -= nr_removed;
 
 	rcu_assign_pointer(ctx.rd, rd_new);
+	atomic_inc(&ctx.gen);
 	call_rcu(&rd->rcu, rd_free_rcu);
 
 error_out:
@@ -729,6 +734,11 @@ void quadd_unwind_delete_mmap(struct quadd_mmap_area *mmap)
 	__quadd_unwind_delete_mmap(mmap);
 }
 
+unsigned int quadd_unwind_get_gen(void)
+{
+	return atomic_read(&ctx.gen);
+}
+
 static const struct unwind_idx *
 unwind_find_idx(struct ex_region_info *ri, u32 addr, unsigned long *lowaddr)
 {
@@ -1424,6 +1434,7 @@ int quadd_unwind_start(struct task_struct *task)
 		pr_warn("%s: warning: rd_old\n", __func__);
 
 	rcu_assign_pointer(ctx.rd, rd);
+	atomic_inc(&ctx.gen);
 
 	if (rd_old)
 		call_rcu(&rd_old->rcu, rd_free_rcu);
@@ -1460,6 +1471,7 @@ void quadd_unwind_stop(void)
 	}
 
 	rcu_assign_pointer(ctx.rd, NULL);
+	atomic_inc(&ctx.gen);
 	call_rcu(&rd->rcu, rd_free_rcu);
 
 out:
@@ -1478,6 +1490,7 @@ int quadd_unwind_init(void)
 	raw_spin_lock_init(&ctx.lock);
 	rcu_assign_pointer(ctx.rd, NULL);
 	ctx.pid = 0;
+	atomic_set(&ctx.gen, 0);
 
 	return 0;
 }
@@ -75,4 +75,6 @@ long
 quadd_get_dw_frames(unsigned long key, struct ex_region_info *ri);
 void quadd_put_dw_frames(struct ex_region_info *ri);
 
+unsigned int quadd_unwind_get_gen(void);
+
 #endif	/* __QUADD_EH_UNWIND_H__ */
@@ -40,6 +40,7 @@
 #include "power_clk.h"
 #include "tegra.h"
 #include "debug.h"
+#include "aggr.h"
 
 static struct quadd_hrt_ctx hrt;
 
@@ -90,9 +91,37 @@ __put_sample(struct quadd_record_data *data,
 
 	err = comm->put_sample(data, vec, vec_count, cpu_id);
 	if (err < 0)
-		atomic64_inc(&hrt.skipped_samples);
+		this_cpu_inc(hrt.cpu_ctx->nr_skipped_samples);
 
-	atomic64_inc(&hrt.counter_samples);
+	this_cpu_inc(hrt.cpu_ctx->nr_samples);
+}
+
+static void reset_samples_stat(void)
+{
+	int cpu_id;
+	struct quadd_cpu_context *cpu_ctx;
+
+	for_each_possible_cpu(cpu_id) {
+		cpu_ctx = per_cpu_ptr(hrt.cpu_ctx, cpu_id);
+
+		cpu_ctx->nr_samples = 0;
+		cpu_ctx->nr_skipped_samples = 0;
+	}
+}
+
+static void get_samples_stat(u64 *all, u64 *skipped)
+{
+	int cpu_id;
+	struct quadd_cpu_context *cpu_ctx;
+
+	*all = *skipped = 0;
+
+	for_each_possible_cpu(cpu_id) {
+		cpu_ctx = per_cpu_ptr(hrt.cpu_ctx, cpu_id);
+
+		*all += READ_ONCE(cpu_ctx->nr_samples);
+		*skipped += READ_ONCE(cpu_ctx->nr_skipped_samples);
+	}
 }
 
 void
@@ -102,11 +131,15 @@ quadd_put_sample_this_cpu(struct quadd_record_data *data,
 	__put_sample(data, vec, vec_count, -1);
 }
 
+/*
+ * Not tied to a particular CPU: the sample goes to the ring of the CPU we
+ * are running on, user space merges the rings by timestamp.
+ */
 void
 quadd_put_sample(struct quadd_record_data *data,
 		 struct quadd_iovec *vec, int vec_count)
 {
-	__put_sample(data, vec, vec_count, 0);
+	__put_sample(data, vec, vec_count, -1);
 }
 
 static void put_header(int cpuid)
@@ -178,6 +211,8 @@ static void put_header(int cpuid)
 		hdr->reserved |= QUADD_HDR_MODE_SAMPLE_TREE;
 	if (quadd_mode_is_trace_tree(ctx))
 		hdr->reserved |= QUADD_HDR_MODE_TRACE_TREE;
+	if (extra & QUADD_PARAM_EXTRA_AGGREGATION)
+		hdr->reserved |= QUADD_HDR_AGGREGATION;
 
 	if (pmu)
 		nr_events += pmu->get_current_events(cpuid, events + nr_events,
@@ -469,6 +504,9 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, int is_sched)
 	if (nr_positive_events == 0)
 		return;
 
+	if (quadd_aggr_is_active() && !quadd_aggr_add(s, cc, bt_size))
+		return;
+
 	vec[vec_idx].base = events_extra;
 	vec[vec_idx].len = nr_positive_events * sizeof(events_extra[0]);
 	vec_idx++;
@@ -752,7 +790,7 @@ static void reset_cpu_ctx(void)
 
 int quadd_hrt_start(void)
 {
-	int cpuid;
+	int cpuid, err;
 	u64 period;
 	long freq;
 	unsigned int extra;
@@ -769,9 +807,7 @@ int quadd_hrt_start(void)
 	else
 		hrt.ma_period = 0;
 
-	atomic64_set(&hrt.counter_samples, 0);
-	atomic64_set(&hrt.skipped_samples, 0);
-
+	reset_samples_stat();
 	reset_cpu_ctx();
 
 	extra = param->reserved[QUADD_PARAM_IDX_EXTRA];
@@ -800,6 +836,12 @@ int quadd_hrt_start(void)
 	hrt.get_stack_offset =
 		(extra & QUADD_PARAM_EXTRA_STACK_OFFSET) ? 1 : 0;
 
+	err = quadd_aggr_start(ctx);
+	if (err) {
+		pr_err("error: aggregation start\n");
+		return err;
+	}
+
 	for_each_possible_cpu(cpuid) {
 		if (ctx->pmu->get_arch(cpuid))
 			put_header(cpuid);
@@ -833,11 +875,12 @@ int quadd_hrt_start(void)
 
 void quadd_hrt_stop(void)
 {
+	u64 all, skipped;
 	struct quadd_ctx *ctx = hrt.quadd_ctx;
 
-	pr_info("Stop hrt, samples all/skipped: %lld/%lld\n",
-		(long long)atomic64_read(&hrt.counter_samples),
-		(long long)atomic64_read(&hrt.skipped_samples));
+	get_samples_stat(&all, &skipped);
+	pr_info("Stop hrt, samples all/skipped: %llu/%llu\n",
+		(unsigned long long)all, (unsigned long long)skipped);
 
 	if (ctx->pl310)
 		ctx->pl310->stop();
@@ -847,8 +890,9 @@ void quadd_hrt_stop(void)
 	atomic_set(&hrt.active, 0);
 	atomic_set(&hrt.mmap_active, 0);
 
-	atomic64_set(&hrt.counter_samples, 0);
-	atomic64_set(&hrt.skipped_samples, 0);
+	quadd_aggr_stop();
+
+	reset_samples_stat();
 
 	/* reset_cpu_ctx(); */
 }
@@ -863,8 +907,12 @@ void quadd_hrt_deinit(void)
 
 void quadd_hrt_get_state(struct quadd_module_state *state)
 {
-	state->nr_all_samples = atomic64_read(&hrt.counter_samples);
-	state->nr_skipped_samples = atomic64_read(&hrt.skipped_samples);
+	u64 all, skipped;
+
+	get_samples_stat(&all, &skipped);
+
+	state->nr_all_samples = all;
+	state->nr_skipped_samples = skipped;
 }
 
 static void init_arch_timer(void)
@@ -908,7 +956,6 @@ struct quadd_hrt_ctx *quadd_hrt_init(struct quadd_ctx *ctx)
 	else
 		hrt.ma_period = 0;
 
-	atomic64_set(&hrt.counter_samples, 0);
 	init_arch_timer();
 
 	hrt.cpu_ctx = alloc_percpu(struct quadd_cpu_context);
@@ -37,6 +37,10 @@ struct quadd_cpu_context {
 
 	struct quadd_thread_data active_thread;
 	atomic_t nr_active;
+
+	/* only updated by the owning CPU */
+	u64 nr_samples;
+	u64 nr_skipped_samples;
 };
 
 struct timecounter;
@@ -53,9 +57,6 @@ struct quadd_hrt_ctx {
 	atomic_t mmap_active;
 	atomic_t nr_active_all_core;
 
-	atomic64_t counter_samples;
-	atomic64_t skipped_samples;
-
 	struct timer_list ma_timer;
 	unsigned int ma_period;
 
@@ -33,9 +33,35 @@
 #include <linux/hwmon-sysfs.h>
 #include <linux/suspend.h>
 #include <linux/version.h>
+#include <linux/math64.h>
+#include <linux/iio/consumer.h>
 
 #define	DEFAULT_TSKIN			25000 /* default tskin in mC */
 
+#define PREDICT_MAX_POWER		4
+#define PREDICT_STEADY_MC		100 /* per period, ambient tracking */
+#define PREDICT_AMBIENT_SHIFT		3
+
+/*
+ * Lookahead of the estimate, exposed as sensor 1 so a passive trip with
+ * soft governor gains can cap early instead of throttling hard later.
+ * First order model: the temperature heads for ambient + rth * power
+ * with time constant tau, power comes from the ina3221 rails.
+ */
+struct therm_est_predict {
+	struct thermal_zone_device *thz;
+	struct iio_channel *power[PREDICT_MAX_POWER];
+	int num_power;
+	int lookahead_ms;
+	int tau_ms;
+	int rth; /* mC per W */
+	int gain; /* permille, 1 - e^(-lookahead / tau) */
+	long ambient; /* mC, tracked while steady */
+	long power_mw;
+	long last_temp;
+	long temp;
+};
+
 struct therm_estimator {
 	struct thermal_zone_device *thz;
 
@@ -53,6 +79,7 @@ struct therm_estimator {
 	bool *tripped_info;
 
 	int use_activator;
+	struct therm_est_predict predict;
 #ifdef CONFIG_PM
 	struct notifier_block pm_nb;
 #endif
@@ -119,6 +146,60 @@ static void therm_est_update_limits(struct therm_estimator *est)
 	est->high_limit = high_temp;
 }
 
+static void therm_est_predict_gain(struct therm_est_predict *pr)
+{
+	u64 val = 1000000;
+	int i;
+
+	if (pr->tau_ms <= 0 || pr->lookahead_ms >= 8 * pr->tau_ms) {
+		pr->gain = 1000;
+		return;
+	}
+
+	/* e^-x ~ (1 - x/64)^64 */
+	val -= div_u64(val * pr->lookahead_ms, 64 * pr->tau_ms);
+	for (i = 0; i < 6; i++)
+		val = div_u64(val * val, 1000000);
+	pr->gain = 1000 - (int)div_u64(val, 1000);
+}
+
+static void therm_est_predict_update(struct therm_estimator *est)
+{
+	struct therm_est_predict *pr = &est->predict;
+	long temp = est->cur_temp, target, rise;
+	int i, val;
+
+	if (!pr->thz)
+		return;
+
+	if (!pr->num_power) {
+		/* no power input, extrapolate the trend */
+		pr->temp = temp + (temp - pr->last_temp) * pr->lookahead_ms /
+				max_t(long, est->polling_period, 1);
+		goto out;
+	}
+
+	pr->power_mw = 0;
+	for (i = 0; i < pr->num_power; i++)
+		if (iio_read_channel_processed(pr->power[i], &val) >= 0)
+			pr->power_mw += val;
+
+	rise = (long)pr->rth * pr->power_mw / 1000;
+	if (abs(temp - pr->last_temp) < PREDICT_STEADY_MC) {
+		target = clamp_val(temp - rise, 0, temp);
+		pr->ambient += (target - pr->ambient) >> PREDICT_AMBIENT_SHIFT;
+	}
+
+	pr->temp = temp + (pr->ambient + rise - temp) * pr->gain / 1000;
+out:
+	pr->last_temp = temp;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 9, 0)
+	thermal_zone_device_update(pr->thz, THERMAL_EVENT_UNSPECIFIED);
+#else
+	thermal_zone_device_update(pr->thz);
+#endif
+}
+
 static void therm_est_work_func(struct work_struct *work)
 {
 	struct delayed_work *dwork = container_of(work,
@@ -153,6 +234,7 @@ static void therm_est_work_func(struct work_struct *work)
 	}
 
 	est->cur_temp = sum / 100 + coeffs_set->toffset;
+	therm_est_predict_update(est);
 
 	if (est->thz && ((est->cur_temp < est->low_limit) ||
 			(est->cur_temp >= est->high_limit))) {
@@ -178,6 +260,14 @@ static int therm_est_get_temp(void *of_data, int *temp)
 	return 0;
 }
 
+static int therm_est_predict_get_temp(void *of_data, int *temp)
+{
+	struct therm_estimator *est = (struct therm_estimator *)of_data;
+
+	*temp = est->predict.temp;
+	return 0;
+}
+
 static int therm_est_get_trend(void *of_data, int trip,
 			       enum thermal_trend *trend)
 {
@@ -506,6 +596,50 @@ static ssize_t set_tc2(struct device *dev,
 	return count;
 }
 
+static ssize_t show_predict(struct device *dev,
+			struct device_attribute *da,
+			char *buf)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	struct therm_est_predict *pr = &est->predict;
+
+	return snprintf(buf, PAGE_SIZE,
+			"temp %ld ambient %ld power %ld gain %d%s\n",
+			pr->temp, pr->ambient, pr->power_mw, pr->gain,
+			pr->thz ? "" : " (disabled)");
+}
+
+static ssize_t show_predict_param(struct device *dev,
+			struct device_attribute *da,
+			char *buf)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
+	int *param[] = { &est->predict.lookahead_ms, &est->predict.tau_ms,
+			 &est->predict.rth };
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", *param[attr->index]);
+}
+
+static ssize_t set_predict_param(struct device *dev,
+			struct device_attribute *da,
+			const char *buf, size_t count)
+{
+	struct therm_estimator *est = dev_get_drvdata(dev);
+	struct sensor_device_attribute *attr = to_sensor_dev_attr(da);
+	int *param[] = { &est->predict.lookahead_ms, &est->predict.tau_ms,
+			 &est->predict.rth };
+	int val;
+
+	if (kstrtoint(buf, 0, &val) || val < 0)
+		return -EINVAL;
+
+	*param[attr->index] = val;
+	therm_est_predict_gain(&est->predict);
+
+	return count;
+}
+
 static struct sensor_device_attribute therm_est_nodes[] = {
 	SENSOR_ATTR(coeff, S_IRUGO | S_IWUSR, show_coeff, set_coeff, 0),
 	SENSOR_ATTR(offset, S_IRUGO | S_IWUSR, show_offset, set_offset, 0),
@@ -514,6 +648,13 @@ static struct sensor_device_attribute therm_est_nodes[] = {
 	SENSOR_ATTR(tc1, S_IRUGO | S_IWUSR, show_tc1, set_tc1, 0),
 	SENSOR_ATTR(tc2, S_IRUGO | S_IWUSR, show_tc2, set_tc2, 0),
 	SENSOR_ATTR(temps, S_IRUGO, show_temps, 0, 0),
+	SENSOR_ATTR(predict, S_IRUGO, show_predict, 0, 0),
+	SENSOR_ATTR(predict_lookahead_ms, S_IRUGO | S_IWUSR,
+			show_predict_param, set_predict_param, 0),
+	SENSOR_ATTR(predict_tau_ms, S_IRUGO | S_IWUSR,
+			show_predict_param, set_predict_param, 1),
+	SENSOR_ATTR(predict_rth, S_IRUGO | S_IWUSR,
+			show_predict_param, set_predict_param, 2),
 };
 
 #ifdef CONFIG_PM
@@ -726,6 +867,75 @@ static struct thermal_zone_of_device_ops sops = {
 	.trip_update = therm_est_trip_update,
 };
 
+static struct thermal_zone_of_device_ops predict_sops = {
+	.get_temp = therm_est_predict_get_temp,
+};
+
+static void therm_est_predict_release(struct therm_estimator *est)
+{
+	struct therm_est_predict *pr = &est->predict;
+	int i;
+
+	for (i = 0; i < pr->num_power; i++)
+		iio_channel_release(pr->power[i]);
+	pr->num_power = 0;
+}
+
+static void therm_est_predict_init(struct platform_device *pdev,
+				   struct therm_estimator *est)
+{
+	struct therm_est_predict *pr = &est->predict;
+	struct device_node *np;
+	struct thermal_zone_device *thz;
+	struct iio_channel *chan;
+	const char *name;
+	u32 val;
+	int i, n;
+
+	np = of_get_child_by_name(pdev->dev.of_node, "predict");
+	if (!np)
+		return;
+
+	pr->lookahead_ms = 3000;
+	pr->tau_ms = 30000;
+	pr->ambient = DEFAULT_TSKIN;
+	if (!of_property_read_u32(np, "lookahead-ms", &val))
+		pr->lookahead_ms = val;
+	if (!of_property_read_u32(np, "tau-ms", &val))
+		pr->tau_ms = val;
+	if (!of_property_read_u32(np, "rth", &val))
+		pr->rth = val;
+	if (!of_property_read_u32(np, "ambient", &val))
+		pr->ambient = val;
+	therm_est_predict_gain(pr);
+
+	n = of_property_count_strings(np, "power-channels");
+	for (i = 0; i < n && pr->num_power < PREDICT_MAX_POWER; i++) {
+		if (of_property_read_string_index(np, "power-channels", i,
+						  &name))
+			continue;
+		chan = iio_channel_get(&pdev->dev, name);
+		if (IS_ERR_OR_NULL(chan)) {
+			dev_warn(&pdev->dev, "no power channel %s\n", name);
+			continue;
+		}
+		pr->power[pr->num_power++] = chan;
+	}
+	of_node_put(np);
+
+	pr->last_temp = est->cur_temp;
+	pr->temp = est->cur_temp;
+	thz = thermal_zone_of_sensor_register(&pdev->dev, 1, est,
+					      &predict_sops);
+	if (IS_ERR(thz)) {
+		dev_info(&pdev->dev, "prediction disabled, no zone: %ld\n",
+			 PTR_ERR(thz));
+		therm_est_predict_release(est);
+		return;
+	}
+	pr->thz = thz;
+}
+
 static int therm_est_probe(struct platform_device *pdev)
 {
 	int i, ret;
@@ -779,6 +989,8 @@ static int therm_est_probe(struct platform_device *pdev)
 	if (IS_ERR_OR_NULL(est->thz))
 		goto err;
 
+	therm_est_predict_init(pdev, est);
+
 	for (i = 0; i < ARRAY_SIZE(therm_est_nodes); i++)
 		device_create_file(&pdev->dev, &therm_est_nodes[i].dev_attr);
 
@@ -813,6 +1025,9 @@ static int therm_est_remove(struct platform_device *pdev)
 	for (i = 0; i < ARRAY_SIZE(therm_est_nodes); i++)
 		device_remove_file(&pdev->dev, &therm_est_nodes[i].dev_attr);
 	thermal_cooling_device_unregister(est->cdev);
+	if (est->predict.thz)
+		thermal_zone_of_sensor_unregister(&pdev->dev, est->predict.thz);
+	therm_est_predict_release(est);
 	kfree(est->thz);
 	destroy_workqueue(est->workqueue);
 	kfree(est);
@@ -452,6 +452,22 @@ void ttcan_tx_trigger_msg_transmit(struct ttcan_controller *ttcan, u8 index)
 	ttcan_write32(ttcan, ADR_MTTCAN_TXBAR, (1 << index));
 }
 
+/* Defer the add request of a written buffer to ttcan_tx_trigger_pending() */
+void ttcan_tx_batch_msg(struct ttcan_controller *ttcan, u8 index)
+{
+	ttcan->tx_pending |= 1U << index;
+}
+
+/* Issue one TXBAR write for all buffers batched so far */
+void ttcan_tx_trigger_pending(struct ttcan_controller *ttcan)
+{
+	if (!ttcan->tx_pending)
+		return;
+
+	ttcan_write32(ttcan, ADR_MTTCAN_TXBAR, ttcan->tx_pending);
+	ttcan->tx_pending = 0;
+}
+
 int ttcan_tx_msg_buffer_write(struct ttcan_controller *ttcan,
 			      struct ttcanfd_frame *ttcanfd)
 {
@@ -511,6 +527,8 @@ int ttcan_set_tx_buffer_addr(struct ttcan_controller *ttcan)
 		return ret;
 	}
 
+	ttcan->tx_pending = 0;
+
 	tx_intr_en = (1 << (ttcan->tx_config.ded_buff_num
 			+ ttcan->tx_config.fifo_q_num)) - 1;
 	/* Enable TC interrupt for tx buffers + queue */
@@ -529,8 +547,13 @@ int ttcan_set_tx_buffer_addr(struct ttcan_controller *ttcan)
 int ttcan_tx_fifo_queue_msg(struct ttcan_controller *ttcan,
 			    struct ttcanfd_frame *ttcanfd)
 {
+	u32 ded = ttcan->tx_config.ded_buff_num;
+	u32 fifo_mask = ((1 << (ded + ttcan->tx_config.fifo_q_num)) - 1) &
+			~((1 << ded) - 1);
 	u32 txfqs_reg;
 	u32 put_idx;
+	u32 pending;
+	u32 free;
 
 	txfqs_reg = ttcan_read32(ttcan, ADR_MTTCAN_TXFQS);
 
@@ -538,8 +561,30 @@ int ttcan_tx_fifo_queue_msg(struct ttcan_controller *ttcan,
 	if (txfqs_reg & MTT_TXFQS_TFQF_MASK)
 		return -ENOMEM;
 
-	/* Test if Tx index is previously reserved in SW */
+	/* Elements written ahead of the batched add request are not free */
+	pending = hweight32(ttcan->tx_pending & fifo_mask);
+	free = (txfqs_reg & MTT_TXFQS_TFFL_MASK) >> MTT_TXFQS_TFFL_SHIFT;
+	if (pending >= free)
+		return -ENOMEM;
+
 	put_idx = (txfqs_reg & MTT_TXFQS_TFQPI_MASK) >> MTT_TXFQS_TFQPI_SHIFT;
+	if (pending) {
+		if (ttcan->tx_config.flags & 0x1) {
+			/* Queue mode takes its buffers in any order */
+			u32 busy = ttcan_read32(ttcan, ADR_MTTCAN_TXBRP) |
+				   ttcan->tx_object | ttcan->tx_pending;
+
+			if (!(~busy & fifo_mask))
+				return -ENOMEM;
+			put_idx = ffs(~busy & fifo_mask) - 1;
+		} else {
+			/* FIFO mode, the add request moves the put index on */
+			put_idx = ded + (put_idx - ded + pending) %
+				  ttcan->tx_config.fifo_q_num;
+		}
+	}
+
+	/* Test if Tx index is previously reserved in SW */
 	if (ttcan->tx_object & (1 << put_idx))
 		return -ENOMEM;
 
@@ -653,45 +698,49 @@ unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 	u32 rxf0s_reg;
 	struct ttcanfd_frame ttcanfd;
 	u32 read_addr;
-	int q_read = 0;
+	u32 fill, get_idx, q_size;
+	int ack_idx = -1;
 	unsigned int msgs_read = 0;
 
 	rxf0s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF0S);
 
-	if (!(rxf0s_reg & MTT_RXF0S_F0FL_MASK)) {
+	fill = (rxf0s_reg & MTT_RXF0S_F0FL_MASK) >> MTT_RXF0S_F0FL_SHIFT;
+	if (!fill)
 		return msgs_read;
-	}
 
-	/* Read at max queue size in one attempt */
-	q_read = ttcan->mram_cfg[MRAM_RXF0].num;
+	get_idx = (rxf0s_reg & MTT_RXF0S_F0GI_MASK) >> MTT_RXF0S_F0GI_SHIFT;
+	q_size = ttcan->mram_cfg[MRAM_RXF0].num;
 
-	while ((rxf0s_reg & MTT_RXF0S_F0FL_MASK) && q_read--) {
-		u32 get_idx = (rxf0s_reg & MTT_RXF0S_F0GI_MASK) >>
-		    MTT_RXF0S_F0GI_SHIFT;
-		if (ttcan->rx_config.rxq0_bmsk & (1 << get_idx)) {
+	/* Drain the whole fill level and release it with a single
+	 * acknowledge of the last element read.
+	 */
+	while (fill--) {
+		if (ttcan->rx_config.rxq0_bmsk & (1ULL << get_idx)) {
 			/* All ready process on High priority */
-			ttcan_write32(ttcan, ADR_MTTCAN_RXF0A, get_idx);
-			ttcan->rx_config.rxq0_bmsk &= ~(1U << get_idx);
-			rxf0s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF0S);
-			continue;
+			ttcan->rx_config.rxq0_bmsk &= ~(1ULL << get_idx);
+		} else {
+			read_addr = ttcan->mram_cfg[MRAM_RXF0].off +
+			    (get_idx * ttcan->e_size.rx_fifo0);
+
+			pr_debug("%s:fifo0: read_addr %x FOGI %x\n", __func__,
+				 read_addr, get_idx);
+
+			ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
+			if (add_msg_controller_list(ttcan, &ttcanfd,
+				&ttcan->rx_q0, FIFO_0) < 0) {
+				pr_err("%s: failed to add to list\n", __func__);
+				break;
+			}
+			msgs_read++;
 		}
+		ack_idx = get_idx;
+		if (++get_idx == q_size)
+			get_idx = 0;
+	}
 
-		read_addr = ttcan->mram_cfg[MRAM_RXF0].off +
-		    (get_idx * ttcan->e_size.rx_fifo0);
-
-		pr_debug("%s:fifo0: read_addr %x FOGI %x\n", __func__,
-			 read_addr, get_idx);
+	if (ack_idx >= 0)
+		ttcan_write32(ttcan, ADR_MTTCAN_RXF0A, ack_idx);
 
-		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
-		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q0, FIFO_0) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
-			return msgs_read;
-		}
-		ttcan_write32(ttcan, ADR_MTTCAN_RXF0A, get_idx);
-		rxf0s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF0S);
-		msgs_read++;
-	}
 	return msgs_read;
 }
 
@@ -700,44 +749,49 @@ unsigned int ttcan_read_rx_fifo1(struct ttcan_controller *ttcan)
 	u32 rxf1s_reg;
 	struct ttcanfd_frame ttcanfd;
 	u32 read_addr;
-	int q_read = 0;
+	u32 fill, get_idx, q_size;
+	int ack_idx = -1;
 	int msgs_read = 0;
 
 	rxf1s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF1S);
 
-	if (!(rxf1s_reg & MTT_RXF1S_F1FL_MASK)) {
+	fill = (rxf1s_reg & MTT_RXF1S_F1FL_MASK) >> MTT_RXF1S_F1FL_SHIFT;
+	if (!fill)
 		return msgs_read;
-	}
 
-	/* Read at max queue size in one attempt */
-	q_read = ttcan->mram_cfg[MRAM_RXF1].num;
+	get_idx = (rxf1s_reg & MTT_RXF1S_F1GI_MASK) >> MTT_RXF1S_F1GI_SHIFT;
+	q_size = ttcan->mram_cfg[MRAM_RXF1].num;
 
-	while ((rxf1s_reg & MTT_RXF1S_F1FL_MASK) && q_read--) {
-		u32 get_idx = (rxf1s_reg & MTT_RXF1S_F1GI_MASK) >>
-		    MTT_RXF1S_F1GI_SHIFT;
-		if (ttcan->rx_config.rxq1_bmsk & (1 << get_idx)) {
+	/* Drain the whole fill level and release it with a single
+	 * acknowledge of the last element read.
+	 */
+	while (fill--) {
+		if (ttcan->rx_config.rxq1_bmsk & (1ULL << get_idx)) {
 			/* All ready process on High priority */
-			ttcan_write32(ttcan, ADR_MTTCAN_RXF1A, get_idx);
-			ttcan->rx_config.rxq1_bmsk &= ~(1U << get_idx);
-			rxf1s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF1S);
-			continue;
+			ttcan->rx_config.rxq1_bmsk &= ~(1ULL << get_idx);
+		} else {
+			read_addr = ttcan->mram_cfg[MRAM_RXF1].off +
+			    (get_idx * ttcan->e_size.rx_fifo1);
+
+			pr_debug("%s:fifo1: read_addr %x FOGI %x\n", __func__,
+				 read_addr, get_idx);
+
+			ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
+			if (add_msg_controller_list(ttcan, &ttcanfd,
+				&ttcan->rx_q1, FIFO_1) < 0) {
+				pr_err("%s: failed to add to list\n", __func__);
+				break;
+			}
+			msgs_read++;
 		}
-		read_addr = ttcan->mram_cfg[MRAM_RXF1].off +
-		    (get_idx * ttcan->e_size.rx_fifo1);
+		ack_idx = get_idx;
+		if (++get_idx == q_size)
+			get_idx = 0;
+	}
 
-		pr_debug("%s:fifo1: read_addr %x FOGI %x\n", __func__,
-			 read_addr, get_idx);
+	if (ack_idx >= 0)
+		ttcan_write32(ttcan, ADR_MTTCAN_RXF1A, ack_idx);
 
-		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
-		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q1, FIFO_1) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
-			return msgs_read;
-		}
-		ttcan_write32(ttcan, ADR_MTTCAN_RXF1A, get_idx);
-		rxf1s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF1S);
-		msgs_read++;
-	}
 	return msgs_read;
 }
 
@@ -814,6 +868,8 @@ void ttcan_set_rx_buffers_elements(struct ttcan_controller *ttcan)
 
 	u32 rxq0 = ttcan->mram_cfg[MRAM_RXF0].num;
 	u32 rxq1 = ttcan->mram_cfg[MRAM_RXF1].num;
+	u32 rxq0_wm = ttcan->rx_config.rxq0_wm ? : rxq0 / 2;
+	u32 tocc_reg = DEF_MTTCAN_TOCC;
 
 	/* Set Rx Buffer Address */
 	rel_phy_addr = ttcan->mram_cfg[MRAM_RXB].off >> 2;
@@ -823,7 +879,7 @@ void ttcan_set_rx_buffers_elements(struct ttcan_controller *ttcan)
 
 	/* Set RXFIFO 0 */
 	rel_phy_addr = ttcan->mram_cfg[MRAM_RXF0].off >> 2;
-	rxf0c_reg = ((rxq0 / 2) << MTT_RXF0C_F0WM_SHIFT) & MTT_RXF0C_F0WM_MASK;
+	rxf0c_reg = (rxq0_wm << MTT_RXF0C_F0WM_SHIFT) & MTT_RXF0C_F0WM_MASK;
 	rxf0c_reg |= (rxq0 << MTT_RXF0C_F0S_SHIFT) & MTT_RXF0C_F0S_MASK;
 	rxf0c_reg |= (rel_phy_addr << MTT_RXF0C_F0SA_SHIFT) &
 	    MTT_RXF0C_F0SA_MASK;
@@ -839,6 +895,15 @@ void ttcan_set_rx_buffers_elements(struct ttcan_controller *ttcan)
 
 	ttcan_write32(ttcan, ADR_MTTCAN_RXF1C, rxf1c_reg);
 
+	/* Timeout counter flushes Rx FIFO 0 when it stays below watermark */
+	if (ttcan->rx_config.rxq0_wm) {
+		tocc_reg = (ttcan->rx_config.rxq0_tmo << MTT_TOCC_TOP_SHIFT) &
+		    MTT_TOCC_TOP_MASK;
+		tocc_reg |= (TOS_RX_FIFO0 << MTT_TOCC_TOS_SHIFT) &
+		    MTT_TOCC_TOS_MASK;
+		tocc_reg |= MTT_TOCC_ETOC_MASK;
+	}
+	ttcan_write32(ttcan, ADR_MTTCAN_TOCC, tocc_reg);
 
 	/* Set Rx element datasize */
 	rxbuf_dfs = get_dfs(ttcan->rx_config.rxb_dsize);
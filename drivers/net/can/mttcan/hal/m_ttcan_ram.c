@@ -41,9 +41,13 @@ int ttcan_read_rx_msg_ram(struct ttcan_controller *ttcan, u64 read_addrs,
 
 	ttcanfd->flags |= CAN_DIR_RX;
 
+	/* The element is read back to back without a barrier per word,
+	 * message RAM accesses are ordered against the following
+	 * acknowledge register write anyway.
+	 */
 	while (bytes_to_read) {
 		msg_data =
-		    readl(addr_in_msg_ram + (i * CAN_WORD_IN_BYTES));
+		    readl_relaxed(addr_in_msg_ram + (i * CAN_WORD_IN_BYTES));
 
 		switch (i) {
 		case 0:
@@ -134,6 +134,13 @@ enum ttcan_timestamp_source {
 	TS_DISABLE2 = 3
 };
 
+enum ttcan_timeout_select {
+	TOS_CONTINUOUS = 0,
+	TOS_TXEVT_FIFO = 1,
+	TOS_RX_FIFO0 = 2,
+	TOS_RX_FIFO1 = 3
+};
+
 enum ttcan_rx_type {
 	BUFFER = 1,
 	FIFO_0 = 2,
@@ -259,6 +266,8 @@ struct ttcan_rxbuff_config {
 	u32 rxq0_dsize;
 	u32 rxq1_dsize;
 	u32 rxb_dsize;
+	u32 rxq0_wm;	/* 0: interrupt on every new message */
+	u32 rxq0_tmo;	/* timeout counter flushing below watermark */
 	u64 rxq0_bmsk;
 	u64 rxq1_bmsk;
 	u64 rxb_bmsk;
@@ -304,6 +313,7 @@ struct ttcan_controller {
 	u32 tt_mem_elements;
 	unsigned long tx_object;
 	unsigned long tx_obj_cancelled;
+	u32 tx_pending;		/* written, add request not issued yet */
 	int rxq0_mem;
 	int rxq1_mem;
 	int rxb_mem;
@@ -452,6 +462,8 @@ void ttcan_tx_ded_msg_write(struct ttcan_controller *ttcan,
 			    struct ttcanfd_frame *ttcanfd,
 			    u8 index);
 void ttcan_tx_trigger_msg_transmit(struct ttcan_controller *ttcan, u8 index);
+void ttcan_tx_batch_msg(struct ttcan_controller *ttcan, u8 index);
+void ttcan_tx_trigger_pending(struct ttcan_controller *ttcan);
 int ttcan_tx_msg_buffer_write(struct ttcan_controller *ttcan,
 				struct ttcanfd_frame *ttcanfd);
 
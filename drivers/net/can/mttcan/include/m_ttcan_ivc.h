@@ -26,7 +26,30 @@ enum m_ttcan_ivc_msgid {
 	MTTCAN_MSG_RX_LOST_FRAME = 6,
 	MTTCAN_MSG_TXEVT = 7,
 	MTTCAN_CMD_CAN_ENABLE = 8,
+	MTTCAN_MSG_TX_BATCH = 9,
+	MTTCAN_MSG_RX_BATCH = 10,
 	MTTCAN_MSG_LAST
 };
 
+/* MTTCAN_CMD_CAN_ENABLE ext_cmdid: peer may send MTTCAN_MSG_RX_BATCH */
+#define MTTCAN_IVC_EN_BATCH	(1 << 1)
+
+/*
+ * Batched messages carry the number of frames in ext_cmdid, packed
+ * right after cmdid/ext_cmdid:
+ * MTTCAN_MSG_RX_BATCH: Rx message RAM elements, R0 and R1 followed by
+ *	the data words of the DLC.
+ * MTTCAN_MSG_TX_BATCH: struct ivc_ttcan_tx_entry followed by len bytes
+ *	of data padded to a word.
+ */
+#define MTTCAN_IVC_HDR_LEN	4
+
+struct __attribute__((__packed__)) ivc_ttcan_tx_entry {
+	u32 can_id;
+	u8 len;
+	u8 flags;
+	u8 msg_no;
+	u8 resv;
+};
+
 #endif
@@ -40,7 +40,13 @@
 #include <linux/pm_runtime.h>
 #include <linux/net_tstamp.h>
 #include <linux/spinlock.h>
+#include <linux/version.h>
 #include <linux/clocksource.h>
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 11, 0)
+#include <linux/sched/clock.h>
+#else
+#include <linux/sched.h>
+#endif
 #include <linux/platform/tegra/ptp-notifier.h>
 #include <linux/mailbox_client.h>
 #ifdef CONFIG_CLK_SRC_TEGRA18_US_TIMER
@@ -66,6 +72,8 @@
 #define MTT_MAX_RX_CONF		3
 
 #define MTTCAN_POLL_TIME	50
+/* Rx FIFO 0 timeout in timestamp counter ticks */
+#define MTTCAN_RXQ0_TMO_DEF	100
 #define MTTCAN_HWTS_ROLLOVER	250
 /* block period in ms */
 #define TX_BLOCK_PERIOD		200
@@ -122,11 +130,34 @@ struct mttcan_priv {
 	u32 mram_param[MTT_CAN_MAX_MRAM_ELEMS];
 	u32 tx_conf[MTT_MAX_TX_CONF]; /*<txb, txq, txq_mode, txb_dsize>*/
 	u32 rx_conf[MTT_MAX_RX_CONF]; /*<rxb_dsize, rxq0_dsize, rxq1_dsize>*/
+	u32 rxq0_wm;
+	u32 rxq0_tmo;
+	u32 rx_busy_poll_us;
+	u64 busy_poll_end;
+	void *ivc_tx_buf; /* pending MTTCAN_MSG_TX_BATCH frame */
+	u32 ivc_frame_size;
+	u32 ivc_tx_len;
+	u32 ivc_tx_cnt;
+	u32 ivc_tx_mask;
+	bool ivc_batch;
 	bool poll;
 	bool hwts_rx_en;
 	u32 resp;
 };
 
+/* The stack has more frames queued right behind this one */
+static inline bool mttcan_xmit_more(struct sk_buff *skb,
+				    struct net_device *dev)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+	return netdev_xmit_more() &&
+		!netif_xmit_stopped(netdev_get_tx_queue(dev, 0));
+#else
+	return skb->xmit_more &&
+		!netif_xmit_stopped(netdev_get_tx_queue(dev, 0));
+#endif
+}
+
 int mttcan_create_sys_files(struct device *dev);
 void mttcan_delete_sys_files(struct device *dev);
 #endif
@@ -297,6 +297,13 @@
 #define MTT_TSCC_TCP_SHIFT 16
 #define MTT_TSCC_TCP_MASK (((1<<4)-1) << MTT_TSCC_TCP_SHIFT)
 
+#define MTT_TOCC_ETOC_SHIFT 0
+#define MTT_TOCC_ETOC_MASK (((1<<1)-1) << MTT_TOCC_ETOC_SHIFT)
+#define MTT_TOCC_TOS_SHIFT 1
+#define MTT_TOCC_TOS_MASK (((1<<2)-1) << MTT_TOCC_TOS_SHIFT)
+#define MTT_TOCC_TOP_SHIFT 16
+#define MTT_TOCC_TOP_MASK (((1<<16)-1) << MTT_TOCC_TOP_SHIFT)
+
 #define MTT_ECR_TEC_SHIFT 0
 #define MTT_ECR_TEC_MASK (((1<<8)-1) << MTT_ECR_TEC_SHIFT)
 #define MTT_ECR_REC_SHIFT 8
@@ -181,6 +181,43 @@ static int mttcan_state_change(struct net_device *dev,
 	return 1;
 }
 
+/* Send the pending Tx batch, called with tx_lock held */
+static int mttcan_ivc_flush_tx(struct mttcan_priv *priv)
+{
+	int status;
+	u32 msg_no;
+	struct ttcan_ivc_msg msg;
+	struct ivc_ttcanfd_frame *fr = priv->ivc_tx_buf;
+	struct net_device_stats *stats = &priv->dev->stats;
+
+	if (!priv->ivc_tx_cnt)
+		return 0;
+
+	fr->cmdid = MTTCAN_MSG_TX_BATCH;
+	fr->ext_cmdid = priv->ivc_tx_cnt;
+	msg.length = priv->ivc_tx_len;
+	msg.data = priv->ivc_tx_buf;
+
+	status = mbox_send_message(priv->mbox, (void *)&msg);
+	if (status < 0) {
+		dev_err(priv->device, "mbox_send_message failed %d\n", status);
+		/* release the slots, the peer never saw these frames */
+		while (priv->ivc_tx_mask) {
+			msg_no = ffs(priv->ivc_tx_mask) - 1;
+			can_free_echo_skb(priv->dev, msg_no);
+			clear_bit(msg_no, &priv->ttcan->tx_object);
+			priv->ivc_tx_mask &= ~(1U << msg_no);
+			stats->tx_dropped++;
+		}
+	}
+
+	priv->ivc_tx_cnt = 0;
+	priv->ivc_tx_mask = 0;
+	priv->ivc_tx_len = MTTCAN_IVC_HDR_LEN;
+
+	return status < 0 ? -EBUSY : 0;
+}
+
 static void mttcan_tx_complete(struct net_device *dev, u32 completed_tx)
 {
 	u32 msg_no;
@@ -202,6 +239,15 @@ static void mttcan_tx_complete(struct net_device *dev, u32 completed_tx)
 		completed_tx &= ~(1U << msg_no);
 	}
 
+	/* Frames held back while the peer was busy go out now */
+	if (priv->ivc_batch) {
+		unsigned long flags;
+
+		spin_lock_irqsave(&priv->tx_lock, flags);
+		mttcan_ivc_flush_tx(priv);
+		spin_unlock_irqrestore(&priv->tx_lock, flags);
+	}
+
 	if (netif_queue_stopped(dev))
 		netif_wake_queue(dev);
 }
@@ -253,6 +299,8 @@ static int mttcan_ivc_enable(struct mttcan_priv *priv, bool flag)
 
 	fr.cmdid = MTTCAN_CMD_CAN_ENABLE;
 	fr.ext_cmdid = flag;
+	if (flag && priv->ivc_batch)
+		fr.ext_cmdid |= MTTCAN_IVC_EN_BATCH;
 	msg.length = sizeof(struct ivc_ttcanfd_frame);
 	msg.data = (void *)&fr;
 
@@ -352,6 +400,37 @@ static int process_rx_mesg_ivc(struct ttcan_controller *ttcan, u32 *addr)
 	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b, BUFFER);
 }
 
+static void mttcan_ivc_rx_batch(struct net_device *dev,
+				struct ttcan_ivc_msg *msg, u16 count)
+{
+	struct mttcan_priv *priv = netdev_priv(dev);
+	struct net_device_stats *stats = &dev->stats;
+	u32 *elem = (u32 *)((u8 *)msg->data + MTTCAN_IVC_HDR_LEN);
+	u32 *end = (u32 *)((u8 *)msg->data + msg->length);
+	u32 words;
+
+	for (; count; count--) {
+		if (elem + 2 > end)
+			break;
+		words = 2 + DIV_ROUND_UP(ttcan_dlc2len((elem[1] &
+			RX_BUF_DLC_MASK) >> RX_BUF_DLC_SHIFT),
+			CAN_WORD_IN_BYTES);
+		if (elem + words > end)
+			break;
+		if (process_rx_mesg_ivc(priv->ttcan, elem))
+			stats->rx_dropped++;
+		elem += words;
+	}
+
+	if (count) {
+		stats->rx_dropped += count;
+		netdev_err(dev, "Truncated Rx batch, %u dropped\n", count);
+	}
+
+	/* whole batch goes up the stack at once */
+	mttcan_read_rcv_list(dev, &priv->ttcan->rx_b);
+}
+
 static void mttcan_ivc_rcv_msg(struct mbox_client *cl, void *mssg)
 {
 	struct net_device *dev = (struct net_device *)dev_get_drvdata(cl->dev);
@@ -372,6 +451,11 @@ static void mttcan_ivc_rcv_msg(struct mbox_client *cl, void *mssg)
 		}
 		break;
 
+	case MTTCAN_MSG_RX_BATCH:
+		mttcan_ivc_rx_batch(dev, msg, fr->ext_cmdid);
+		memcpy(&priv->resp, msg->data, sizeof(priv->resp));
+		break;
+
 	case MTTCAN_MSG_TX_COMPL:
 		mttcan_tx_complete(dev, fr->payload.data[0]);
 		break;
@@ -428,6 +512,44 @@ static int mttcan_ivc_send_req(struct mttcan_priv *priv,
 	return msg_no;
 }
 
+/*
+ * Pack the frame into the pending MTTCAN_MSG_TX_BATCH. The batch is
+ * sent when it is full, or when the stack has nothing more and the
+ * peer is idle. While the peer still has frames of ours in flight its
+ * next Tx completion flushes the batch, which saves the notification.
+ * A batch that fails to go out drops its frames, including this one.
+ */
+static void mttcan_ivc_batch_req(struct mttcan_priv *priv,
+				 struct canfd_frame *frame,
+				 int msg_no, bool more)
+{
+	unsigned long flags;
+	struct ivc_ttcan_tx_entry *entry;
+	u32 len = sizeof(*entry) + ALIGN(frame->len, CAN_WORD_IN_BYTES);
+
+	spin_lock_irqsave(&priv->tx_lock, flags);
+	if (priv->ivc_tx_len + len > priv->ivc_frame_size)
+		mttcan_ivc_flush_tx(priv);
+
+	entry = priv->ivc_tx_buf + priv->ivc_tx_len;
+	entry->can_id = frame->can_id;
+	entry->len = frame->len;
+	entry->flags = frame->flags;
+	entry->msg_no = msg_no;
+	entry->resv = 0;
+	memset(entry + 1, 0, len - sizeof(*entry));
+	memcpy(entry + 1, frame->data, frame->len);
+
+	priv->ivc_tx_len += len;
+	priv->ivc_tx_cnt++;
+	priv->ivc_tx_mask |= 1U << msg_no;
+	priv->ttcan->tx_buf_dlc[msg_no] = frame->len;
+
+	if (!more && !(priv->ttcan->tx_object & ~priv->ivc_tx_mask))
+		mttcan_ivc_flush_tx(priv);
+	spin_unlock_irqrestore(&priv->tx_lock, flags);
+}
+
 static int mttcan_open(struct net_device *dev)
 {
 	int err;
@@ -465,6 +587,7 @@ static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 	int err;
 	struct mttcan_priv *priv = netdev_priv(dev);
 	struct canfd_frame *frame = (struct canfd_frame *)skb->data;
+	bool more = mttcan_xmit_more(skb, dev);
 
 	if (can_dropped_invalid_skb(dev, skb))
 		return NETDEV_TX_OK;
@@ -475,6 +598,13 @@ static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 	msg_no = ffs(~priv->ttcan->tx_object) - 1;
 	if (msg_no < 0) {
 		netdev_warn(dev, "No Tx space left\n");
+		if (priv->ivc_batch) {
+			unsigned long flags;
+
+			spin_lock_irqsave(&priv->tx_lock, flags);
+			mttcan_ivc_flush_tx(priv);
+			spin_unlock_irqrestore(&priv->tx_lock, flags);
+		}
 		netif_stop_queue(dev);
 		smp_mb();
 		return NETDEV_TX_BUSY;
@@ -487,6 +617,11 @@ static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 		netdev_err(dev, "Writing to occupied echo_skb buffer\n");
 	clear_bit(msg_no, &priv->ttcan->tx_obj_cancelled);
 
+	if (priv->ivc_batch) {
+		mttcan_ivc_batch_req(priv, frame, msg_no, more);
+		return NETDEV_TX_OK;
+	}
+
 	err = mttcan_ivc_send_req(priv, frame, msg_no);
 	if (err < 0) {
 		netdev_warn(dev, "Tx IVC failed\n");
@@ -575,6 +710,27 @@ static int mttcan_probe(struct platform_device *pdev)
 	memset(priv->ttcan, 0, sizeof(struct ttcan_controller));
 	priv->ttcan->id = priv->instance;
 	INIT_LIST_HEAD(&priv->ttcan->rx_b);
+	spin_lock_init(&priv->tx_lock);
+
+	/* Peer firmware understands batched messages */
+	priv->ivc_batch = of_property_read_bool(np, "ivc-batch");
+	if (priv->ivc_batch) {
+		priv->ivc_frame_size = sizeof(struct ivc_ttcanfd_frame);
+		of_property_read_u32(np, "ivc-frame-size",
+				     &priv->ivc_frame_size);
+		if (priv->ivc_frame_size < sizeof(struct ivc_ttcanfd_frame)) {
+			dev_err(priv->device, "ivc-frame-size too small\n");
+			ret = -EINVAL;
+			goto exit_free_device;
+		}
+		priv->ivc_tx_buf = devm_kzalloc(priv->device,
+			priv->ivc_frame_size, GFP_KERNEL);
+		if (!priv->ivc_tx_buf) {
+			ret = -ENOMEM;
+			goto exit_free_device;
+		}
+		priv->ivc_tx_len = MTTCAN_IVC_HDR_LEN;
+	}
 
 	platform_set_drvdata(pdev, dev);
 	SET_NETDEV_DEV(dev, &pdev->dev);
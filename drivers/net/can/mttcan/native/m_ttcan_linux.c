@@ -45,6 +45,15 @@ static __init int mttcan_hw_init(struct mttcan_priv *priv)
 	if (err)
 		return err;
 
+	/* Coalesce Rx FIFO 0: interrupt on watermark, full or timeout */
+	if (priv->rxq0_wm && ttcan->mram_cfg[MRAM_RXF0].num) {
+		ttcan->rx_config.rxq0_wm = min(priv->rxq0_wm,
+			ttcan->mram_cfg[MRAM_RXF0].num);
+		ttcan->rx_config.rxq0_tmo = min_t(u32, priv->rxq0_tmo,
+			MTT_TOCC_TOP_MASK >> MTT_TOCC_TOP_SHIFT);
+		ttcan->intr_enable_reg &= ~MTT_IE_RF0NE_MASK;
+	}
+
 	err = ttcan_set_config_change_enable(ttcan);
 	if (err)
 		return err;
@@ -286,18 +295,14 @@ static int mttcan_do_receive(struct net_device *dev,
 	return 1;
 }
 
-static void mttcan_rx_hwtstamp(struct mttcan_priv *priv,
-			       struct sk_buff *skb, struct ttcanfd_frame msg)
+/* tc is a snapshot of the timecounter taken once per batch */
+static void mttcan_rx_hwtstamp(const struct timecounter *tc,
+			       struct sk_buff *skb, u32 tstamp)
 {
-	u64 ns;
-	unsigned long flags;
 	struct skb_shared_hwtstamps *hwtstamps = skb_hwtstamps(skb);
 
-	raw_spin_lock_irqsave(&priv->tc_lock, flags);
-	ns = timecounter_cyc2time(&priv->tc, msg.tstamp);
-	raw_spin_unlock_irqrestore(&priv->tc_lock, flags);
 	memset(hwtstamps, 0, sizeof(struct skb_shared_hwtstamps));
-	hwtstamps->hwtstamp = ns_to_ktime(ns);
+	hwtstamps->hwtstamp = ns_to_ktime(timecounter_cyc2time(tc, tstamp));
 }
 
 static int mttcan_read_rcv_list(struct net_device *dev,
@@ -311,10 +316,18 @@ static int mttcan_read_rcv_list(struct net_device *dev,
 	struct ttcan_rx_msg_list *rx;
 	struct net_device_stats *stats = &dev->stats;
 	struct list_head *cur, *next, rx_q;
+	struct timecounter tc;
+	bool hwts = priv->hwts_rx_en;
 
 	if (list_empty(rcv))
 		return 0;
 
+	if (hwts) {
+		raw_spin_lock_irqsave(&priv->tc_lock, flags);
+		tc = priv->tc;
+		raw_spin_unlock_irqrestore(&priv->tc_lock, flags);
+	}
+
 	INIT_LIST_HEAD(&rx_q);
 
 	spin_lock_irqsave(&priv->ttcan->lock, flags);
@@ -366,8 +379,8 @@ static int mttcan_read_rcv_list(struct net_device *dev,
 			stats->rx_bytes += frame->can_dlc;
 		}
 
-		if (priv->hwts_rx_en)
-			mttcan_rx_hwtstamp(priv, skb, rx->msg);
+		if (hwts)
+			mttcan_rx_hwtstamp(&tc, skb, rx->msg.tstamp);
 		kfree(rx);
 		netif_receive_skb(skb);
 		stats->rx_packets++;
@@ -567,15 +580,21 @@ static void mttcan_tx_complete(struct net_device *dev)
 	/* apply mask to consider only active CAN Tx transactions */
 	completed_tx &= ttcan->tx_object;
 
+	if (!completed_tx) {
+		spin_unlock(&priv->tx_lock);
+		return;
+	}
+
+	/* Release the whole batch before waking the queue once */
+	ttcan->tx_object &= ~completed_tx;
 	while (completed_tx) {
 		msg_no = ffs(completed_tx) - 1;
 		can_get_echo_skb(dev, msg_no);
-		can_led_event(dev, CAN_LED_EVENT_TX);
-		clear_bit(msg_no, &ttcan->tx_object);
 		stats->tx_packets++;
 		stats->tx_bytes += ttcan->tx_buf_dlc[msg_no];
 		completed_tx &= ~(1U << msg_no);
 	}
+	can_led_event(dev, CAN_LED_EVENT_TX);
 
 	if (netif_queue_stopped(dev))
 		netif_wake_queue(dev);
@@ -696,7 +715,11 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 		if (ir & MTT_IR_TOO_MASK) {
 			ack = MTT_IR_TOO_MASK;
 			ttcan_ir_write(priv->ttcan, ack);
-			netdev_warn(dev, "Rx timeout not handled\n");
+			/* Rx FIFO 0 stayed below watermark, drain it */
+			if (priv->ttcan->rx_config.rxq0_wm)
+				ir |= MTT_IR_RF0N_MASK;
+			else
+				netdev_warn(dev, "Rx timeout not handled\n");
 		}
 
 		/* High Priority Message */
@@ -877,6 +900,23 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 		ttcan_ttir_write(priv->ttcan, ttack);
 	}
 end:
+	/* Busy poll: keep interrupts off and poll again while traffic
+	 * arrived within the last rx_busy_poll_us.
+	 */
+	if (work_done < quota && priv->rx_busy_poll_us &&
+	    priv->can.state != CAN_STATE_BUS_OFF) {
+		u64 now = local_clock();
+
+		if (work_done)
+			priv->busy_poll_end = now +
+				(u64)priv->rx_busy_poll_us * NSEC_PER_USEC;
+		if (now < priv->busy_poll_end) {
+			priv->irqstatus = ttcan_read_ir(priv->ttcan);
+			priv->tt_irqstatus = ttcan_read_ttir(priv->ttcan);
+			return quota;
+		}
+	}
+
 	if (work_done < quota) {
 		napi_complete(napi);
 
@@ -1273,9 +1313,15 @@ static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 	int msg_no = -1;
 	struct mttcan_priv *priv = netdev_priv(dev);
 	struct canfd_frame *frame = (struct canfd_frame *)skb->data;
+	bool more = mttcan_xmit_more(skb, dev);
 
-	if (can_dropped_invalid_skb(dev, skb))
+	if (can_dropped_invalid_skb(dev, skb)) {
+		/* this may have been the frame meant to flush the batch */
+		spin_lock_bh(&priv->tx_lock);
+		ttcan_tx_trigger_pending(priv->ttcan);
+		spin_unlock_bh(&priv->tx_lock);
 		return NETDEV_TX_OK;
+	}
 
 	if (can_is_canfd_skb(skb))
 		frame->flags |= CAN_FD_FLAG;
@@ -1290,15 +1336,19 @@ static netdev_tx_t mttcan_start_xmit(struct sk_buff *skb,
 				(struct ttcanfd_frame *)frame);
 
 	if (msg_no < 0) {
+		ttcan_tx_trigger_pending(priv->ttcan);
 		netif_stop_queue(dev);
 		spin_unlock_bh(&priv->tx_lock);
 		return NETDEV_TX_BUSY;
 	}
 	can_put_echo_skb(skb, dev, msg_no);
 
-	/* Set go bit for non-TTCAN messages */
-	if (!priv->tt_param[0])
-		ttcan_tx_trigger_msg_transmit(priv->ttcan, msg_no);
+	/* Set go bit for non-TTCAN messages, one add request per burst */
+	if (!priv->tt_param[0]) {
+		ttcan_tx_batch_msg(priv->ttcan, msg_no);
+		if (!more)
+			ttcan_tx_trigger_pending(priv->ttcan);
+	}
 
 	/* State management for Tx complete/cancel processing */
 	if (test_and_set_bit(msg_no, &priv->ttcan->tx_object) &&
@@ -1696,6 +1746,9 @@ static int mttcan_probe(struct platform_device *pdev)
 	priv->gpio_can_stb.active_low = flags & OF_GPIO_ACTIVE_LOW;
 	priv->instance = of_alias_get_id(np, "mttcan");
 	priv->poll = of_property_read_bool(np, "use-polling");
+	of_property_read_u32(np, "rx-fifo0-watermark", &priv->rxq0_wm);
+	priv->rxq0_tmo = MTTCAN_RXQ0_TMO_DEF;
+	of_property_read_u32(np, "rx-fifo0-timeout", &priv->rxq0_tmo);
 	of_property_read_u32_array(np, "tt-param", priv->tt_param, 2);
 	if (of_property_read_u32_array(np, "tx-config",
 		priv->tx_conf, TX_CONF_MAX)) {
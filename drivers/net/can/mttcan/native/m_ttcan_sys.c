@@ -546,6 +546,32 @@ static ssize_t store_trigger_mem(struct device *dev,
 	return count;
 }
 
+static ssize_t show_rx_busy_poll(struct device *dev,
+	struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+
+	return sprintf(buf, "%u\n", priv->rx_busy_poll_us);
+}
+
+static ssize_t store_rx_busy_poll(struct device *dev,
+	struct device_attribute *devattr,
+	const char *buf, size_t count)
+{
+	unsigned int usecs;
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+
+	/* usage: echo USECS > rx_busy_poll_us, 0 disables */
+	if (kstrtouint(buf, 0, &usecs) || usecs > USEC_PER_SEC) {
+		dev_err(dev, "Invalid busy poll time\n");
+		return -EINVAL;
+	}
+
+	priv->rx_busy_poll_us = usecs;
+
+	return count;
+}
+
 static DEVICE_ATTR(std_filter, S_IRUGO | S_IWUSR, show_std_fltr,
 	store_std_fltr);
 static DEVICE_ATTR(xtd_filter, S_IRUGO | S_IWUSR, show_xtd_fltr,
@@ -564,6 +590,8 @@ static DEVICE_ATTR(cccr_init_txbar, S_IRUGO | S_IWUSR, show_cccr_txbar,
 	store_cccr_txbar);
 static DEVICE_ATTR(trigger_mem, S_IRUGO | S_IWUSR, show_trigger_mem,
 		store_trigger_mem);
+static DEVICE_ATTR(rx_busy_poll_us, S_IRUGO | S_IWUSR, show_rx_busy_poll,
+		store_rx_busy_poll);
 
 static struct attribute *mttcan_attr[] = {
 	&dev_attr_std_filter.attr,
@@ -578,6 +606,7 @@ static struct attribute *mttcan_attr[] = {
 	&dev_attr_txbar.attr,
 	&dev_attr_cccr_init_txbar.attr,
 	&dev_attr_trigger_mem.attr,
+	&dev_attr_rx_busy_poll_us.attr,
 	NULL
 };
 
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEGRA_VNET_H__
+#define __TEGRA_VNET_H__
+
+#include <linux/if_ether.h>
+#include <linux/types.h>
+
+/*
+ * Virtual Ethernet between a PCIe host and a Tegra endpoint.
+ *
+ * The endpoint exposes struct tvnet_bar at the start of BAR0. All packet
+ * buffers live in host memory and all payload moves are done by the
+ * endpoint's eDMA, so neither side copies data with the CPU:
+ *
+ * - Endpoint to host: the host posts empty receive buffers in rx[] and
+ *   bumps rx_head. The endpoint DMAs a packet into the next one, then
+ *   DMAs its length into the host completion ring at host_cmpl_addr and
+ *   raises the host's MSI from the eDMA.
+ * - Host to endpoint: the host posts packets in tx[] and bumps tx_head.
+ *   The endpoint polls tx_head, pulls the packets in with the eDMA and
+ *   advances tx_tail once each one has landed.
+ *
+ * Indices are free running, the slot is the index modulo the ring size.
+ *
+ * The host bumps host_gen every time it sets the rings up and then moves
+ * host_state to ready. The endpoint starts from zero on every new
+ * generation and acknowledges it in ep_gen before moving ep_state to
+ * ready. Either side dropping back to reset ends the generation.
+ */
+
+#define TVNET_MAGIC			0x544e5654	/* "TVNT" */
+#define TVNET_VERSION			1
+
+#define TVNET_RING_SIZE			256
+#define TVNET_RING_MASK			(TVNET_RING_SIZE - 1)
+
+#define TVNET_MTU			9000
+#define TVNET_BUF_SIZE			(TVNET_MTU + ETH_HLEN)
+
+/* Advertised by the endpoint through nvidia,device-id */
+#define TVNET_PCI_VENDOR_ID		0x10DE
+#define TVNET_PCI_DEVICE_ID		0x229A
+
+enum tvnet_state {
+	TVNET_STATE_RESET = 0,
+	TVNET_STATE_READY,
+};
+
+/* A buffer in host memory */
+struct tvnet_desc {
+	__le64 addr;
+	__le32 len;
+	__le32 reserved;
+};
+
+/* Written by the endpoint into host memory, len 0 means not yet done */
+struct tvnet_cmpl {
+	__le32 len;
+	__le32 reserved;
+};
+
+struct tvnet_bar {
+	__le32 magic;
+	__le32 version;
+	__le32 ep_state;
+	__le32 host_state;
+	__le32 host_gen;
+	__le32 ep_gen;
+
+	/* host memory holding TVNET_RING_SIZE struct tvnet_cmpl */
+	__le64 host_cmpl_addr;
+
+	__le32 rx_head;		/* host: receive buffers posted */
+	__le32 tx_head;		/* host: packets posted */
+	__le32 tx_tail;		/* endpoint: packets pulled in */
+	__le32 reserved;
+
+	struct tvnet_desc rx[TVNET_RING_SIZE];
+	struct tvnet_desc tx[TVNET_RING_SIZE];
+};
+
+#endif
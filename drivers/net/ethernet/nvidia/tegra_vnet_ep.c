@@ -0,0 +1,628 @@
+/*
+ * Virtual Ethernet over PCIe, Tegra endpoint side
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/dma-mapping.h>
+#include <linux/dmaengine.h>
+#include <linux/etherdevice.h>
+#include <linux/hrtimer.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/pci_regs.h>
+#include <linux/scatterlist.h>
+#include <linux/skbuff.h>
+#include <linux/spinlock.h>
+#include <linux/tegra-pcie-edma.h>
+#include <linux/tegra-vnet.h>
+#include <linux/workqueue.h>
+
+#include "tegra_vnet.h"
+
+/*
+ * Host writes to the BAR raise nothing on the endpoint, so the rings and
+ * the host state are polled from a timer driven NAPI context.
+ */
+static unsigned int poll_us = 50;
+module_param(poll_us, uint, 0644);
+MODULE_PARM_DESC(poll_us, "BAR polling interval in microseconds");
+
+/* A packet moving from the endpoint to a host receive buffer */
+struct tvnet_ep_tx {
+	struct sk_buff *skb;
+	struct scatterlist sg[MAX_SKB_FRAGS + 1];
+	int nents;
+};
+
+/* A packet moving from a host transmit buffer to the endpoint */
+struct tvnet_ep_rx {
+	struct tegra_vnet_ep *vep;
+	struct sk_buff *skb;
+	dma_addr_t dma;
+	u32 len;
+	bool done;
+};
+
+struct tegra_vnet_ep {
+	struct device *dev;
+	struct net_device *ndev;
+	struct tvnet_bar *bar;
+	void __iomem *dbi_base;
+
+	struct dma_chan *wr_chan;
+	struct dma_chan *rd_chan;
+
+	struct napi_struct napi;
+	struct hrtimer poll_timer;
+	struct work_struct link_work;
+	bool open;
+	bool ready;
+	u32 host_gen;
+	u64 host_cmpl_addr;
+
+	/* endpoint to host, indexed by the host rx ring */
+	struct tvnet_ep_tx tx[TVNET_RING_SIZE];
+	struct tvnet_cmpl *cmpl;
+	dma_addr_t cmpl_dma;
+	u32 tx_next;
+	u32 tx_done;
+
+	/* host to endpoint, indexed by the host tx ring */
+	struct tvnet_ep_rx rx[TVNET_RING_SIZE];
+	spinlock_t rx_lock;
+	u32 rx_next;
+	u32 rx_done;
+};
+
+static int tvnet_ep_read_msi(struct tegra_vnet_ep *vep, u64 *addr, u16 *data)
+{
+	void __iomem *dbi = vep->dbi_base;
+	u32 val, hi = 0;
+	u16 flags;
+	u8 pos;
+	int ttl = 48;
+
+	pos = readl(dbi + PCI_CAPABILITY_LIST) & 0xfc;
+	while (pos && ttl--) {
+		val = readl(dbi + pos);
+		if ((val & 0xff) == PCI_CAP_ID_MSI)
+			break;
+		pos = (val >> 8) & 0xfc;
+	}
+	if (!pos || ttl < 0)
+		return -ENODEV;
+
+	flags = val >> 16;
+	if (!(flags & PCI_MSI_FLAGS_ENABLE))
+		return -EAGAIN;
+
+	val = readl(dbi + pos + PCI_MSI_ADDRESS_LO);
+	if (flags & PCI_MSI_FLAGS_64BIT) {
+		hi = readl(dbi + pos + PCI_MSI_ADDRESS_HI);
+		*data = readl(dbi + pos + PCI_MSI_DATA_64) & 0xffff;
+	} else {
+		*data = readl(dbi + pos + PCI_MSI_DATA_32) & 0xffff;
+	}
+	*addr = ((u64)hi << 32) | val;
+
+	return 0;
+}
+
+static void tvnet_ep_tx_unmap(struct tegra_vnet_ep *vep, struct tvnet_ep_tx *t)
+{
+	dma_unmap_sg(vep->dev, t->sg, t->nents, DMA_TO_DEVICE);
+}
+
+static void tvnet_ep_tx_complete(void *param)
+{
+	struct tegra_vnet_ep *vep = param;
+	struct tvnet_ep_tx *t = &vep->tx[vep->tx_done & TVNET_RING_MASK];
+	struct net_device *ndev = vep->ndev;
+
+	/* Descriptors on a channel complete in order */
+	tvnet_ep_tx_unmap(vep, t);
+	ndev->stats.tx_packets++;
+	ndev->stats.tx_bytes += t->skb->len;
+	dev_consume_skb_any(t->skb);
+	t->skb = NULL;
+
+	smp_store_release(&vep->tx_done, vep->tx_done + 1);
+	if (netif_queue_stopped(ndev) && vep->ready)
+		napi_schedule(&vep->napi);
+}
+
+static bool tvnet_ep_tx_room(struct tegra_vnet_ep *vep)
+{
+	u32 head = le32_to_cpu(READ_ONCE(vep->bar->rx_head));
+
+	return vep->tx_next != head &&
+	       vep->tx_next - smp_load_acquire(&vep->tx_done) < TVNET_RING_SIZE;
+}
+
+static netdev_tx_t tvnet_ep_start_xmit(struct sk_buff *skb,
+				       struct net_device *ndev)
+{
+	struct tegra_vnet_ep *vep = netdev_priv(ndev);
+	struct dma_async_tx_descriptor *data, *cmpl;
+	struct dma_slave_config cfg = { };
+	unsigned int slot = vep->tx_next & TVNET_RING_MASK;
+	struct tvnet_ep_tx *t = &vep->tx[slot];
+	struct tvnet_desc *desc = &vep->bar->rx[slot];
+	int nents;
+
+	if (!vep->ready)
+		goto drop;
+
+	if (!tvnet_ep_tx_room(vep)) {
+		netif_stop_queue(ndev);
+		return NETDEV_TX_BUSY;
+	}
+
+	/* Pairs with the host's write barrier before bumping rx_head */
+	dma_rmb();
+	if (skb->len > le32_to_cpu(desc->len))
+		goto drop;
+
+	sg_init_table(t->sg, ARRAY_SIZE(t->sg));
+	t->nents = skb_to_sgvec(skb, t->sg, 0, skb->len);
+	if (t->nents <= 0)
+		goto drop;
+	nents = dma_map_sg(vep->dev, t->sg, t->nents, DMA_TO_DEVICE);
+	if (!nents)
+		goto drop;
+
+	cfg.direction = DMA_MEM_TO_DEV;
+	cfg.dst_addr = le64_to_cpu(desc->addr);
+	dmaengine_slave_config(vep->wr_chan, &cfg);
+	data = dmaengine_prep_slave_sg(vep->wr_chan, t->sg, nents,
+				       DMA_MEM_TO_DEV, 0);
+	if (!data)
+		goto unmap;
+
+	/* The completion lands after the payload and carries the MSI */
+	vep->cmpl[slot].len = cpu_to_le32(skb->len);
+	cmpl = dmaengine_prep_dma_memcpy(vep->wr_chan,
+			vep->host_cmpl_addr + slot * sizeof(struct tvnet_cmpl),
+			vep->cmpl_dma + slot * sizeof(struct tvnet_cmpl),
+			sizeof(struct tvnet_cmpl), DMA_PREP_INTERRUPT);
+	/* an unsubmitted payload descriptor goes with the next terminate */
+	if (!cmpl)
+		goto unmap;
+	cmpl->callback = tvnet_ep_tx_complete;
+	cmpl->callback_param = vep;
+
+	t->skb = skb;
+	dmaengine_submit(data);
+	dmaengine_submit(cmpl);
+	vep->tx_next++;
+
+	if (!tvnet_ep_tx_room(vep))
+		netif_stop_queue(ndev);
+	if (!skb->xmit_more || netif_queue_stopped(ndev))
+		dma_async_issue_pending(vep->wr_chan);
+
+	return NETDEV_TX_OK;
+
+unmap:
+	tvnet_ep_tx_unmap(vep, t);
+drop:
+	ndev->stats.tx_dropped++;
+	dev_kfree_skb_any(skb);
+	return NETDEV_TX_OK;
+}
+
+/* Hand landed packets to the stack and release their slots in order */
+static void tvnet_ep_rx_deliver(struct tegra_vnet_ep *vep)
+{
+	struct net_device *ndev = vep->ndev;
+	struct tvnet_ep_rx *r;
+	u32 done;
+
+	spin_lock_bh(&vep->rx_lock);
+	done = vep->rx_done;
+	while (done != vep->rx_next) {
+		r = &vep->rx[done & TVNET_RING_MASK];
+		if (!r->done)
+			break;
+
+		if (r->skb) {
+			dma_unmap_single(vep->dev, r->dma, r->len,
+					 DMA_FROM_DEVICE);
+			skb_put(r->skb, r->len);
+			r->skb->protocol = eth_type_trans(r->skb, ndev);
+			ndev->stats.rx_packets++;
+			ndev->stats.rx_bytes += r->len;
+			netif_rx(r->skb);
+			r->skb = NULL;
+		}
+		r->done = false;
+		done++;
+	}
+	if (done != vep->rx_done) {
+		vep->rx_done = done;
+		WRITE_ONCE(vep->bar->tx_tail, cpu_to_le32(done));
+	}
+	spin_unlock_bh(&vep->rx_lock);
+}
+
+static void tvnet_ep_rx_complete(void *param)
+{
+	struct tvnet_ep_rx *r = param;
+
+	WRITE_ONCE(r->done, true);
+	tvnet_ep_rx_deliver(r->vep);
+}
+
+static int tvnet_ep_rx_pull(struct tegra_vnet_ep *vep, int budget)
+{
+	struct net_device *ndev = vep->ndev;
+	struct dma_async_tx_descriptor *txd;
+	struct tvnet_desc *desc;
+	struct tvnet_ep_rx *r;
+	u32 head, len;
+	int work = 0;
+
+	head = le32_to_cpu(READ_ONCE(vep->bar->tx_head));
+	dma_rmb();
+
+	spin_lock_bh(&vep->rx_lock);
+	while (work < budget && vep->rx_next != head &&
+	       vep->rx_next - vep->rx_done < TVNET_RING_SIZE) {
+		r = &vep->rx[vep->rx_next & TVNET_RING_MASK];
+		desc = &vep->bar->tx[vep->rx_next & TVNET_RING_MASK];
+		len = le32_to_cpu(desc->len);
+		work++;
+
+		r->skb = NULL;
+		if (len < ETH_HLEN || len > TVNET_BUF_SIZE) {
+			ndev->stats.rx_length_errors++;
+			goto skip;
+		}
+
+		r->skb = netdev_alloc_skb(ndev, len);
+		if (!r->skb) {
+			ndev->stats.rx_dropped++;
+			goto skip;
+		}
+
+		r->len = len;
+		r->dma = dma_map_single(vep->dev, r->skb->data, len,
+					DMA_FROM_DEVICE);
+		if (dma_mapping_error(vep->dev, r->dma))
+			goto free;
+
+		txd = dmaengine_prep_dma_memcpy(vep->rd_chan, r->dma,
+						le64_to_cpu(desc->addr), len,
+						DMA_PREP_INTERRUPT);
+		if (!txd) {
+			dma_unmap_single(vep->dev, r->dma, len,
+					 DMA_FROM_DEVICE);
+			goto free;
+		}
+		txd->callback = tvnet_ep_rx_complete;
+		txd->callback_param = r;
+
+		dmaengine_submit(txd);
+		vep->rx_next++;
+		continue;
+
+free:
+		ndev->stats.rx_dropped++;
+		dev_kfree_skb_any(r->skb);
+		r->skb = NULL;
+skip:
+		/* still released in order, behind anything in flight */
+		r->done = true;
+		vep->rx_next++;
+	}
+	spin_unlock_bh(&vep->rx_lock);
+
+	if (work) {
+		dma_async_issue_pending(vep->rd_chan);
+		tvnet_ep_rx_deliver(vep);
+	}
+
+	return work;
+}
+
+static int tvnet_ep_poll(struct napi_struct *napi, int budget)
+{
+	struct tegra_vnet_ep *vep = container_of(napi, struct tegra_vnet_ep,
+						 napi);
+	struct tvnet_bar *bar = vep->bar;
+	bool host_ready;
+	int work = 0;
+	u32 gen;
+
+	host_ready = le32_to_cpu(READ_ONCE(bar->host_state)) ==
+		     TVNET_STATE_READY;
+	gen = le32_to_cpu(READ_ONCE(bar->host_gen));
+
+	if (vep->ready ? !host_ready || gen != vep->host_gen :
+			 host_ready && gen != vep->host_gen) {
+		schedule_work(&vep->link_work);
+	} else if (vep->ready) {
+		work = tvnet_ep_rx_pull(vep, budget);
+		if (netif_queue_stopped(vep->ndev) && tvnet_ep_tx_room(vep))
+			netif_wake_queue(vep->ndev);
+	}
+
+	if (work < budget) {
+		napi_complete_done(napi, work);
+		hrtimer_start(&vep->poll_timer, ns_to_ktime(poll_us * 1000ULL),
+			      HRTIMER_MODE_REL);
+	}
+
+	return work;
+}
+
+static enum hrtimer_restart tvnet_ep_poll_timer(struct hrtimer *timer)
+{
+	struct tegra_vnet_ep *vep = container_of(timer, struct tegra_vnet_ep,
+						 poll_timer);
+
+	napi_schedule(&vep->napi);
+
+	return HRTIMER_NORESTART;
+}
+
+/* Drop everything in flight, the channels must be idle */
+static void tvnet_ep_link_reset(struct tegra_vnet_ep *vep)
+{
+	struct net_device *ndev = vep->ndev;
+	struct tvnet_ep_rx *r;
+	struct tvnet_ep_tx *t;
+
+	vep->ready = false;
+	netif_carrier_off(ndev);
+	netif_tx_disable(ndev);
+
+	dmaengine_terminate_sync(vep->wr_chan);
+	dmaengine_terminate_sync(vep->rd_chan);
+
+	for (; vep->tx_done != vep->tx_next; vep->tx_done++) {
+		t = &vep->tx[vep->tx_done & TVNET_RING_MASK];
+		tvnet_ep_tx_unmap(vep, t);
+		dev_kfree_skb_any(t->skb);
+		t->skb = NULL;
+		ndev->stats.tx_dropped++;
+	}
+
+	for (; vep->rx_done != vep->rx_next; vep->rx_done++) {
+		r = &vep->rx[vep->rx_done & TVNET_RING_MASK];
+		if (r->skb) {
+			dma_unmap_single(vep->dev, r->dma, r->len,
+					 DMA_FROM_DEVICE);
+			dev_kfree_skb_any(r->skb);
+			r->skb = NULL;
+		}
+		r->done = false;
+	}
+
+	WRITE_ONCE(vep->bar->ep_state, cpu_to_le32(TVNET_STATE_RESET));
+	netdev_info(ndev, "link down\n");
+}
+
+static int tvnet_ep_link_up(struct tegra_vnet_ep *vep, u32 gen)
+{
+	struct tvnet_bar *bar = vep->bar;
+	u16 data;
+	u64 addr;
+	int ret;
+
+	ret = tvnet_ep_read_msi(vep, &addr, &data);
+	if (ret < 0)
+		return ret;
+
+	ret = tegra_pcie_edma_set_remote_irq(vep->wr_chan, addr, data);
+	if (ret < 0)
+		return ret;
+
+	vep->host_cmpl_addr = le64_to_cpu(READ_ONCE(bar->host_cmpl_addr));
+	vep->tx_next = vep->tx_done = 0;
+	vep->rx_next = vep->rx_done = 0;
+	vep->host_gen = gen;
+
+	WRITE_ONCE(bar->tx_tail, 0);
+	WRITE_ONCE(bar->ep_gen, cpu_to_le32(gen));
+	wmb();
+	WRITE_ONCE(bar->ep_state, cpu_to_le32(TVNET_STATE_READY));
+
+	vep->ready = true;
+	netif_carrier_on(vep->ndev);
+	netif_wake_queue(vep->ndev);
+	netdev_info(vep->ndev, "link up, generation %u\n", gen);
+
+	return 0;
+}
+
+static void tvnet_ep_link_work(struct work_struct *work)
+{
+	struct tegra_vnet_ep *vep = container_of(work, struct tegra_vnet_ep,
+						 link_work);
+	struct tvnet_bar *bar = vep->bar;
+	bool host_ready;
+	u32 gen;
+
+	rtnl_lock();
+	if (!vep->open)
+		goto unlock;
+
+	host_ready = le32_to_cpu(READ_ONCE(bar->host_state)) ==
+		     TVNET_STATE_READY;
+	gen = le32_to_cpu(READ_ONCE(bar->host_gen));
+
+	napi_disable(&vep->napi);
+	if (vep->ready && (!host_ready || gen != vep->host_gen))
+		tvnet_ep_link_reset(vep);
+	/* A generation is only ever joined once, from its start */
+	if (!vep->ready && host_ready && gen != vep->host_gen)
+		tvnet_ep_link_up(vep, gen);
+	napi_enable(&vep->napi);
+	napi_schedule(&vep->napi);
+
+unlock:
+	rtnl_unlock();
+}
+
+static int tvnet_ep_open(struct net_device *ndev)
+{
+	struct tegra_vnet_ep *vep = netdev_priv(ndev);
+
+	netif_carrier_off(ndev);
+	vep->open = true;
+	napi_enable(&vep->napi);
+	napi_schedule(&vep->napi);
+
+	return 0;
+}
+
+static int tvnet_ep_stop(struct net_device *ndev)
+{
+	struct tegra_vnet_ep *vep = netdev_priv(ndev);
+
+	vep->open = false;
+	napi_disable(&vep->napi);
+	hrtimer_cancel(&vep->poll_timer);
+	/* link_work takes rtnl and bails out once it sees !open */
+
+	if (vep->ready)
+		tvnet_ep_link_reset(vep);
+
+	return 0;
+}
+
+static int tvnet_ep_change_mtu(struct net_device *ndev, int mtu)
+{
+	if (mtu < ETH_MIN_MTU || mtu > TVNET_MTU)
+		return -EINVAL;
+
+	ndev->mtu = mtu;
+
+	return 0;
+}
+
+static const struct net_device_ops tvnet_ep_netdev_ops = {
+	.ndo_open = tvnet_ep_open,
+	.ndo_stop = tvnet_ep_stop,
+	.ndo_start_xmit = tvnet_ep_start_xmit,
+	.ndo_change_mtu = tvnet_ep_change_mtu,
+	.ndo_set_mac_address = eth_mac_addr,
+	.ndo_validate_addr = eth_validate_addr,
+};
+
+struct tegra_vnet_ep *tegra_vnet_ep_register(
+		const struct tegra_vnet_ep_info *info)
+{
+	struct tegra_vnet_ep *vep;
+	struct net_device *ndev;
+	struct tvnet_bar *bar;
+	int i, ret;
+
+	if (info->bar_size < sizeof(*bar)) {
+		dev_err(info->dev, "BAR0 too small for vnet: %zu\n",
+			info->bar_size);
+		return ERR_PTR(-EINVAL);
+	}
+
+	ndev = alloc_etherdev(sizeof(*vep));
+	if (!ndev)
+		return ERR_PTR(-ENOMEM);
+
+	SET_NETDEV_DEV(ndev, info->dev);
+	vep = netdev_priv(ndev);
+	vep->ndev = ndev;
+	vep->dev = info->dev;
+	vep->bar = info->bar_virt;
+	vep->dbi_base = info->dbi_base;
+	vep->host_gen = 0;
+	spin_lock_init(&vep->rx_lock);
+	for (i = 0; i < TVNET_RING_SIZE; i++)
+		vep->rx[i].vep = vep;
+	INIT_WORK(&vep->link_work, tvnet_ep_link_work);
+	hrtimer_init(&vep->poll_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	vep->poll_timer.function = tvnet_ep_poll_timer;
+
+	vep->cmpl = dma_alloc_coherent(vep->dev, TVNET_RING_SIZE *
+				       sizeof(*vep->cmpl), &vep->cmpl_dma,
+				       GFP_KERNEL);
+	if (!vep->cmpl) {
+		ret = -ENOMEM;
+		goto fail_ndev;
+	}
+
+	vep->wr_chan = tegra_pcie_edma_request_chan(vep->dev, DMA_MEM_TO_DEV);
+	vep->rd_chan = tegra_pcie_edma_request_chan(vep->dev, DMA_DEV_TO_MEM);
+	if (!vep->wr_chan || !vep->rd_chan) {
+		dev_err(vep->dev, "no eDMA channels for vnet\n");
+		ret = -ENODEV;
+		goto fail_chan;
+	}
+
+	bar = vep->bar;
+	memset(bar, 0, sizeof(*bar));
+	bar->magic = cpu_to_le32(TVNET_MAGIC);
+	bar->version = cpu_to_le32(TVNET_VERSION);
+	bar->ep_state = cpu_to_le32(TVNET_STATE_RESET);
+
+	ndev->netdev_ops = &tvnet_ep_netdev_ops;
+	ndev->features = NETIF_F_HIGHDMA;
+	ndev->hw_features = ndev->features;
+	ndev->mtu = TVNET_MTU;
+	eth_hw_addr_random(ndev);
+	netif_napi_add(ndev, &vep->napi, tvnet_ep_poll, NAPI_POLL_WEIGHT);
+
+	ret = register_netdev(ndev);
+	if (ret < 0) {
+		dev_err(vep->dev, "vnet registration failed: %d\n", ret);
+		goto fail_napi;
+	}
+
+	return vep;
+
+fail_napi:
+	netif_napi_del(&vep->napi);
+fail_chan:
+	if (vep->wr_chan)
+		dma_release_channel(vep->wr_chan);
+	if (vep->rd_chan)
+		dma_release_channel(vep->rd_chan);
+	dma_free_coherent(vep->dev, TVNET_RING_SIZE * sizeof(*vep->cmpl),
+			  vep->cmpl, vep->cmpl_dma);
+fail_ndev:
+	free_netdev(ndev);
+	return ERR_PTR(ret);
+}
+EXPORT_SYMBOL_GPL(tegra_vnet_ep_register);
+
+void tegra_vnet_ep_unregister(struct tegra_vnet_ep *vep)
+{
+	struct net_device *ndev = vep->ndev;
+
+	unregister_netdev(ndev);
+	cancel_work_sync(&vep->link_work);
+	netif_napi_del(&vep->napi);
+	vep->bar->magic = 0;
+
+	dma_release_channel(vep->wr_chan);
+	dma_release_channel(vep->rd_chan);
+	dma_free_coherent(vep->dev, TVNET_RING_SIZE * sizeof(*vep->cmpl),
+			  vep->cmpl, vep->cmpl_dma);
+	free_netdev(ndev);
+}
+EXPORT_SYMBOL_GPL(tegra_vnet_ep_unregister);
@@ -0,0 +1,552 @@
+/*
+ * Virtual Ethernet over PCIe, host side of a Tegra endpoint
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/etherdevice.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/pci.h>
+#include <linux/skbuff.h>
+#include <linux/timer.h>
+#include <linux/workqueue.h>
+
+#include "tegra_vnet.h"
+
+#define TVNET_HOST_LINK_POLL		(HZ / 10)
+#define TVNET_HOST_STOP_TIMEOUT_MS	100
+
+#define tvnet_bar_off(member)		offsetof(struct tvnet_bar, member)
+
+struct tvnet_host_buf {
+	struct sk_buff *skb;
+	dma_addr_t dma;
+	u32 len;
+};
+
+struct tvnet_host {
+	struct pci_dev *pdev;
+	struct net_device *ndev;
+	void __iomem *bar;
+
+	struct napi_struct napi;
+	struct timer_list timer;
+	struct work_struct link_work;
+	u32 gen;
+
+	/* endpoint to host */
+	struct tvnet_cmpl *cmpl;
+	dma_addr_t cmpl_dma;
+	struct tvnet_host_buf rx[TVNET_RING_SIZE];
+	u32 rx_head;
+	u32 rx_tail;
+
+	/* host to endpoint */
+	struct tvnet_host_buf tx[TVNET_RING_SIZE];
+	u32 tx_head;
+	u32 tx_tail;
+};
+
+static inline void tvnet_host_writel(struct tvnet_host *host, u32 val,
+				     unsigned long off)
+{
+	iowrite32(val, host->bar + off);
+}
+
+static inline u32 tvnet_host_readl(struct tvnet_host *host, unsigned long off)
+{
+	return ioread32(host->bar + off);
+}
+
+static void tvnet_host_write_desc(struct tvnet_host *host, unsigned long off,
+				  dma_addr_t addr, u32 len)
+{
+	tvnet_host_writel(host, lower_32_bits(addr),
+			  off + offsetof(struct tvnet_desc, addr));
+	tvnet_host_writel(host, upper_32_bits(addr),
+			  off + offsetof(struct tvnet_desc, addr) + 4);
+	tvnet_host_writel(host, len, off + offsetof(struct tvnet_desc, len));
+}
+
+static bool tvnet_host_rx_post(struct tvnet_host *host)
+{
+	struct device *dev = &host->pdev->dev;
+	unsigned int slot = host->rx_head & TVNET_RING_MASK;
+	struct tvnet_host_buf *b = &host->rx[slot];
+
+	b->skb = netdev_alloc_skb(host->ndev, TVNET_BUF_SIZE);
+	if (!b->skb)
+		return false;
+
+	b->len = TVNET_BUF_SIZE;
+	b->dma = dma_map_single(dev, b->skb->data, b->len, DMA_FROM_DEVICE);
+	if (dma_mapping_error(dev, b->dma)) {
+		dev_kfree_skb_any(b->skb);
+		b->skb = NULL;
+		return false;
+	}
+
+	tvnet_host_write_desc(host, tvnet_bar_off(rx[slot]), b->dma, b->len);
+	host->rx_head++;
+
+	return true;
+}
+
+static void tvnet_host_rx_refill(struct tvnet_host *host)
+{
+	u32 head = host->rx_head;
+
+	while (host->rx_head - host->rx_tail < TVNET_RING_SIZE)
+		if (!tvnet_host_rx_post(host))
+			break;
+
+	if (head != host->rx_head) {
+		/* descriptors before the index */
+		wmb();
+		tvnet_host_writel(host, host->rx_head, tvnet_bar_off(rx_head));
+	}
+}
+
+static int tvnet_host_rx(struct tvnet_host *host, int budget)
+{
+	struct device *dev = &host->pdev->dev;
+	struct net_device *ndev = host->ndev;
+	struct tvnet_host_buf *b;
+	struct tvnet_cmpl *c;
+	int work = 0;
+	u32 len;
+
+	while (work < budget && host->rx_tail != host->rx_head) {
+		c = &host->cmpl[host->rx_tail & TVNET_RING_MASK];
+		len = le32_to_cpu(READ_ONCE(c->len));
+		if (!len)
+			break;
+		/* the endpoint wrote the payload before the completion */
+		dma_rmb();
+
+		b = &host->rx[host->rx_tail & TVNET_RING_MASK];
+		dma_unmap_single(dev, b->dma, b->len, DMA_FROM_DEVICE);
+		if (len < ETH_HLEN || len > b->len) {
+			ndev->stats.rx_length_errors++;
+			dev_kfree_skb_any(b->skb);
+		} else {
+			skb_put(b->skb, len);
+			b->skb->protocol = eth_type_trans(b->skb, ndev);
+			ndev->stats.rx_packets++;
+			ndev->stats.rx_bytes += len;
+			napi_gro_receive(&host->napi, b->skb);
+		}
+		b->skb = NULL;
+		c->len = 0;
+		host->rx_tail++;
+		work++;
+	}
+
+	tvnet_host_rx_refill(host);
+
+	return work;
+}
+
+static void tvnet_host_tx_reclaim(struct tvnet_host *host)
+{
+	struct device *dev = &host->pdev->dev;
+	struct net_device *ndev = host->ndev;
+	struct tvnet_host_buf *b;
+	u32 tail;
+
+	/* one MMIO read covers every packet the endpoint pulled in */
+	tail = tvnet_host_readl(host, tvnet_bar_off(tx_tail));
+	if (tail - host->tx_tail > host->tx_head - host->tx_tail)
+		return;
+
+	while (host->tx_tail != tail) {
+		b = &host->tx[host->tx_tail & TVNET_RING_MASK];
+		dma_unmap_single(dev, b->dma, b->len, DMA_TO_DEVICE);
+		ndev->stats.tx_packets++;
+		ndev->stats.tx_bytes += b->len;
+		napi_consume_skb(b->skb, 1);
+		b->skb = NULL;
+		host->tx_tail++;
+	}
+
+	if (netif_queue_stopped(ndev) &&
+	    host->tx_head - host->tx_tail < TVNET_RING_SIZE)
+		netif_wake_queue(ndev);
+}
+
+static int tvnet_host_poll(struct napi_struct *napi, int budget)
+{
+	struct tvnet_host *host = container_of(napi, struct tvnet_host, napi);
+	int work;
+
+	__netif_tx_lock(netdev_get_tx_queue(host->ndev, 0), smp_processor_id());
+	tvnet_host_tx_reclaim(host);
+	__netif_tx_unlock(netdev_get_tx_queue(host->ndev, 0));
+
+	work = tvnet_host_rx(host, budget);
+	if (work < budget)
+		napi_complete_done(napi, work);
+
+	return work;
+}
+
+static irqreturn_t tvnet_host_irq(int irq, void *arg)
+{
+	struct tvnet_host *host = arg;
+
+	napi_schedule(&host->napi);
+
+	return IRQ_HANDLED;
+}
+
+static netdev_tx_t tvnet_host_start_xmit(struct sk_buff *skb,
+					 struct net_device *ndev)
+{
+	struct tvnet_host *host = netdev_priv(ndev);
+	struct device *dev = &host->pdev->dev;
+	unsigned int slot = host->tx_head & TVNET_RING_MASK;
+	struct tvnet_host_buf *b = &host->tx[slot];
+
+	if (!netif_carrier_ok(ndev) || skb->len > TVNET_BUF_SIZE)
+		goto drop;
+
+	if (host->tx_head - host->tx_tail >= TVNET_RING_SIZE) {
+		netif_stop_queue(ndev);
+		return NETDEV_TX_BUSY;
+	}
+
+	b->len = skb_headlen(skb);
+	b->dma = dma_map_single(dev, skb->data, b->len, DMA_TO_DEVICE);
+	if (dma_mapping_error(dev, b->dma))
+		goto drop;
+	b->skb = skb;
+
+	tvnet_host_write_desc(host, tvnet_bar_off(tx[slot]), b->dma, b->len);
+	host->tx_head++;
+	wmb();
+	tvnet_host_writel(host, host->tx_head, tvnet_bar_off(tx_head));
+
+	/* reclaim runs under the tx lock, so this cannot race with it */
+	if (host->tx_head - host->tx_tail >= TVNET_RING_SIZE) {
+		netif_stop_queue(ndev);
+		mod_timer(&host->timer, jiffies + 1);
+	}
+
+	return NETDEV_TX_OK;
+
+drop:
+	ndev->stats.tx_dropped++;
+	dev_kfree_skb_any(skb);
+	return NETDEV_TX_OK;
+}
+
+/* The endpoint has stopped touching both rings */
+static void tvnet_host_free_rings(struct tvnet_host *host)
+{
+	struct device *dev = &host->pdev->dev;
+	struct tvnet_host_buf *b;
+
+	for (; host->tx_tail != host->tx_head; host->tx_tail++) {
+		b = &host->tx[host->tx_tail & TVNET_RING_MASK];
+		dma_unmap_single(dev, b->dma, b->len, DMA_TO_DEVICE);
+		dev_kfree_skb_any(b->skb);
+		b->skb = NULL;
+	}
+
+	for (; host->rx_tail != host->rx_head; host->rx_tail++) {
+		b = &host->rx[host->rx_tail & TVNET_RING_MASK];
+		dma_unmap_single(dev, b->dma, b->len, DMA_FROM_DEVICE);
+		dev_kfree_skb_any(b->skb);
+		b->skb = NULL;
+	}
+}
+
+static void tvnet_host_start_rings(struct tvnet_host *host)
+{
+	host->tx_head = host->tx_tail = 0;
+	host->rx_head = host->rx_tail = 0;
+	memset(host->cmpl, 0, TVNET_RING_SIZE * sizeof(*host->cmpl));
+
+	tvnet_host_writel(host, 0, tvnet_bar_off(tx_head));
+	tvnet_host_writel(host, lower_32_bits(host->cmpl_dma),
+			  tvnet_bar_off(host_cmpl_addr));
+	tvnet_host_writel(host, upper_32_bits(host->cmpl_dma),
+			  tvnet_bar_off(host_cmpl_addr) + 4);
+	tvnet_host_rx_refill(host);
+
+	tvnet_host_writel(host, ++host->gen, tvnet_bar_off(host_gen));
+	wmb();
+	tvnet_host_writel(host, TVNET_STATE_READY, tvnet_bar_off(host_state));
+}
+
+/* Move the endpoint off the rings, waiting for it to acknowledge */
+static void tvnet_host_stop_rings(struct tvnet_host *host)
+{
+	int timeout = TVNET_HOST_STOP_TIMEOUT_MS;
+
+	tvnet_host_writel(host, TVNET_STATE_RESET, tvnet_bar_off(host_state));
+	while (tvnet_host_readl(host, tvnet_bar_off(ep_state)) ==
+	       TVNET_STATE_READY) {
+		if (!timeout--) {
+			netdev_warn(host->ndev, "endpoint did not stop\n");
+			break;
+		}
+		msleep(1);
+	}
+
+	tvnet_host_free_rings(host);
+}
+
+static void tvnet_host_link_work(struct work_struct *work)
+{
+	struct tvnet_host *host = container_of(work, struct tvnet_host,
+					       link_work);
+	struct net_device *ndev = host->ndev;
+
+	rtnl_lock();
+	if (!netif_running(ndev))
+		goto unlock;
+
+	netdev_info(ndev, "endpoint reset, restarting\n");
+	netif_carrier_off(ndev);
+	netif_tx_disable(ndev);
+	napi_disable(&host->napi);
+	tvnet_host_stop_rings(host);
+	tvnet_host_start_rings(host);
+	napi_enable(&host->napi);
+	mod_timer(&host->timer, jiffies + 1);
+
+unlock:
+	rtnl_unlock();
+}
+
+static void tvnet_host_timer(unsigned long data)
+{
+	struct tvnet_host *host = (struct tvnet_host *)data;
+	struct net_device *ndev = host->ndev;
+	bool ep_ready;
+	u32 ep_gen;
+
+	ep_ready = tvnet_host_readl(host, tvnet_bar_off(ep_state)) ==
+		   TVNET_STATE_READY;
+	ep_gen = tvnet_host_readl(host, tvnet_bar_off(ep_gen));
+
+	if (netif_carrier_ok(ndev)) {
+		if (!ep_ready || ep_gen != host->gen) {
+			schedule_work(&host->link_work);
+			return;
+		}
+	} else if (ep_gen == host->gen) {
+		if (ep_ready) {
+			netif_carrier_on(ndev);
+			netif_wake_queue(ndev);
+		} else {
+			/* joined and left before we noticed */
+			schedule_work(&host->link_work);
+			return;
+		}
+	}
+
+	if (netif_queue_stopped(ndev)) {
+		napi_schedule(&host->napi);
+		mod_timer(&host->timer, jiffies + 1);
+	} else {
+		mod_timer(&host->timer, jiffies + TVNET_HOST_LINK_POLL);
+	}
+}
+
+static int tvnet_host_open(struct net_device *ndev)
+{
+	struct tvnet_host *host = netdev_priv(ndev);
+
+	netif_carrier_off(ndev);
+	tvnet_host_start_rings(host);
+	napi_enable(&host->napi);
+	mod_timer(&host->timer, jiffies + 1);
+
+	return 0;
+}
+
+static int tvnet_host_stop(struct net_device *ndev)
+{
+	struct tvnet_host *host = netdev_priv(ndev);
+
+	netif_carrier_off(ndev);
+	netif_tx_disable(ndev);
+	del_timer_sync(&host->timer);
+	/* link_work takes rtnl and bails out on a stopped device */
+	napi_disable(&host->napi);
+	tvnet_host_stop_rings(host);
+
+	return 0;
+}
+
+static int tvnet_host_change_mtu(struct net_device *ndev, int mtu)
+{
+	if (mtu < ETH_MIN_MTU || mtu > TVNET_MTU)
+		return -EINVAL;
+
+	ndev->mtu = mtu;
+
+	return 0;
+}
+
+static const struct net_device_ops tvnet_host_netdev_ops = {
+	.ndo_open = tvnet_host_open,
+	.ndo_stop = tvnet_host_stop,
+	.ndo_start_xmit = tvnet_host_start_xmit,
+	.ndo_change_mtu = tvnet_host_change_mtu,
+	.ndo_set_mac_address = eth_mac_addr,
+	.ndo_validate_addr = eth_validate_addr,
+};
+
+static int tvnet_host_probe(struct pci_dev *pdev,
+			    const struct pci_device_id *id)
+{
+	struct device *dev = &pdev->dev;
+	struct tvnet_host *host;
+	struct net_device *ndev;
+	u32 magic, version;
+	int ret;
+
+	ret = pcim_enable_device(pdev);
+	if (ret < 0) {
+		dev_err(dev, "failed to enable device: %d\n", ret);
+		return ret;
+	}
+
+	ret = pcim_iomap_regions(pdev, BIT(0), KBUILD_MODNAME);
+	if (ret < 0) {
+		dev_err(dev, "failed to map BAR0: %d\n", ret);
+		return ret;
+	}
+
+	if (pci_resource_len(pdev, 0) < sizeof(struct tvnet_bar)) {
+		dev_err(dev, "BAR0 too small\n");
+		return -ENODEV;
+	}
+
+	ret = dma_set_mask_and_coherent(dev, DMA_BIT_MASK(64));
+	if (ret < 0) {
+		dev_err(dev, "no usable DMA mask: %d\n", ret);
+		return ret;
+	}
+
+	pci_set_master(pdev);
+
+	ndev = alloc_etherdev(sizeof(*host));
+	if (!ndev)
+		return -ENOMEM;
+
+	SET_NETDEV_DEV(ndev, dev);
+	host = netdev_priv(ndev);
+	host->pdev = pdev;
+	host->ndev = ndev;
+	host->bar = pcim_iomap_table(pdev)[0];
+	INIT_WORK(&host->link_work, tvnet_host_link_work);
+	setup_timer(&host->timer, tvnet_host_timer, (unsigned long)host);
+	pci_set_drvdata(pdev, host);
+
+	magic = tvnet_host_readl(host, tvnet_bar_off(magic));
+	version = tvnet_host_readl(host, tvnet_bar_off(version));
+	if (magic != TVNET_MAGIC || version != TVNET_VERSION) {
+		dev_err(dev, "no vnet endpoint: magic %#x version %u\n",
+			magic, version);
+		ret = -ENODEV;
+		goto fail_ndev;
+	}
+	tvnet_host_writel(host, TVNET_STATE_RESET, tvnet_bar_off(host_state));
+	host->gen = tvnet_host_readl(host, tvnet_bar_off(host_gen));
+
+	host->cmpl = dmam_alloc_coherent(dev, TVNET_RING_SIZE *
+					 sizeof(*host->cmpl), &host->cmpl_dma,
+					 GFP_KERNEL);
+	if (!host->cmpl) {
+		ret = -ENOMEM;
+		goto fail_ndev;
+	}
+
+	ret = pci_enable_msi(pdev);
+	if (ret < 0) {
+		dev_err(dev, "failed to enable MSI: %d\n", ret);
+		goto fail_ndev;
+	}
+
+	ret = devm_request_irq(dev, pdev->irq, tvnet_host_irq, 0,
+			       KBUILD_MODNAME, host);
+	if (ret < 0) {
+		dev_err(dev, "failed to request irq: %d\n", ret);
+		goto fail_msi;
+	}
+
+	ndev->netdev_ops = &tvnet_host_netdev_ops;
+	ndev->features = NETIF_F_HIGHDMA;
+	ndev->mtu = TVNET_MTU;
+	eth_hw_addr_random(ndev);
+	netif_napi_add(ndev, &host->napi, tvnet_host_poll, NAPI_POLL_WEIGHT);
+
+	ret = register_netdev(ndev);
+	if (ret < 0) {
+		dev_err(dev, "failed to register netdev: %d\n", ret);
+		goto fail_napi;
+	}
+
+	return 0;
+
+fail_napi:
+	netif_napi_del(&host->napi);
+	devm_free_irq(dev, pdev->irq, host);
+fail_msi:
+	pci_disable_msi(pdev);
+fail_ndev:
+	free_netdev(ndev);
+	return ret;
+}
+
+static void tvnet_host_remove(struct pci_dev *pdev)
+{
+	struct tvnet_host *host = pci_get_drvdata(pdev);
+
+	unregister_netdev(host->ndev);
+	cancel_work_sync(&host->link_work);
+	netif_napi_del(&host->napi);
+	devm_free_irq(&pdev->dev, pdev->irq, host);
+	pci_disable_msi(pdev);
+	free_netdev(host->ndev);
+}
+
+static const struct pci_device_id tvnet_host_pci_tbl[] = {
+	{ PCI_DEVICE(TVNET_PCI_VENDOR_ID, TVNET_PCI_DEVICE_ID) },
+	{ },
+};
+MODULE_DEVICE_TABLE(pci, tvnet_host_pci_tbl);
+
+static struct pci_driver tvnet_host_driver = {
+	.name = "tegra_vnet",
+	.id_table = tvnet_host_pci_tbl,
+	.probe = tvnet_host_probe,
+	.remove = tvnet_host_remove,
+};
+module_pci_driver(tvnet_host_driver);
+
+MODULE_DESCRIPTION("Virtual Ethernet to a Tegra PCIe endpoint");
+MODULE_AUTHOR("NVIDIA Corporation");
+MODULE_LICENSE("GPL v2");
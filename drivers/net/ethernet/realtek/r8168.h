@@ -149,6 +149,21 @@ do { \
 #define ENABLE_R8168_PROCFS
 #endif
 
+/* page recycled rx needs build_skb() and dma_*_attrs() skipping cpu sync */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,10,0)
+#define ENABLE_RX_PAGE_RECYCLE
+#endif
+
+/* native XDP runs on the page recycled rx ring, from NAPI context only */
+#if defined(ENABLE_RX_PAGE_RECYCLE) && defined(CONFIG_R8168_NAPI) && \
+    LINUX_VERSION_CODE >= KERNEL_VERSION(4,14,0) && \
+    LINUX_VERSION_CODE < KERNEL_VERSION(5,8,0)
+#define ENABLE_R8168_XDP
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+#include <net/xdp.h>
+#endif
+#endif
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3,10,0)
 #define NETIF_F_HW_VLAN_RX	NETIF_F_HW_VLAN_CTAG_RX
 #define NETIF_F_HW_VLAN_TX	NETIF_F_HW_VLAN_CTAG_TX
@@ -376,11 +391,26 @@ This is free software, and you are welcome to redistribute it under certain cond
 #define NUM_RX_DESC 1024    /* Number of Rx descriptor registers */
 
 #define RX_BUF_SIZE 0x05F3  /* 0x05F3 = 1522bye + 1 */
+
+/*
+ * Each rx page is split in two buffers that are handed out in turn. The
+ * headroom leaves XDP programs room to push headers, it is below
+ * XDP_PACKET_HEADROOM so that two full size frames still fit a 4K page.
+ */
+#define RTL8168_RX_PAGE_HALF     (PAGE_SIZE / 2)
+#define RTL8168_RX_PAGE_HEADROOM 192
+#define RTL8168_RX_PAGE_BUF_LEN  (RTL8168_RX_PAGE_HALF - \
+                                  RTL8168_RX_PAGE_HEADROOM - \
+                                  SKB_DATA_ALIGN(sizeof(struct skb_shared_info)))
 #define R8168_TX_RING_BYTES (NUM_TX_DESC * sizeof(struct TxDesc))
 #define R8168_RX_RING_BYTES (NUM_RX_DESC * sizeof(struct RxDesc))
 
 #define NODE_ADDRESS_SIZE 6
 
+/* TCTR and TimeInt0 count at 125MHz */
+#define RTL8168_TIMER_TICKS_PER_USEC 125
+#define RTL8168_COALESCE_USECS_MAX   1000
+
 #define SHORT_PACKET_PADDING_BUF_SIZE 256
 
 /* write/read MMIO register */
@@ -1373,10 +1403,25 @@ struct RxDesc {
 
 struct ring_info {
         struct sk_buff  *skb;
+        struct page     *page;  /* XDP_TX buffer, skb is NULL then */
         u32     len;
         u8      __pad[sizeof(void *) - sizeof(u32)];
 };
 
+struct rtl8168_rx_page {
+        struct page *page;
+        dma_addr_t dma;         /* whole page, kept mapped while we own it */
+        unsigned int offset;    /* half currently given to the asic */
+};
+
+/* adaptive interrupt moderation state, sampled from the netdev counters */
+struct rtl8168_dim {
+        ktime_t stamp;
+        u64 pkts;
+        u64 bytes;
+        u8 level;
+};
+
 struct pci_resource {
         u8  cmd;
         u8  cls;
@@ -1428,6 +1473,22 @@ struct rtl8168_private {
         struct sk_buff *Rx_skbuff[NUM_RX_DESC]; /* Rx data buffers */
         struct ring_info tx_skb[NUM_TX_DESC];   /* Tx data buffers */
         unsigned rx_buf_sz;
+        struct rtl8168_rx_page rx_page[NUM_RX_DESC]; /* Rx page buffers */
+        u8 rx_page_mode;
+        u64 rx_page_recycle;
+        u64 rx_page_busy;
+        u64 rx_page_alloc;
+        u64 rx_page_alloc_fail;
+        u64 rx_xdp_drop;
+        u64 rx_xdp_tx;
+        u64 rx_xdp_redirect;
+#ifdef ENABLE_R8168_XDP
+        struct bpf_prog *xdp_prog;
+        u8 xdp_pending;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+        struct xdp_rxq_info xdp_rxq;
+#endif
+#endif //ENABLE_R8168_XDP
         struct timer_list esd_timer;
         struct timer_list link_timer;
         struct pci_resource pci_cfg_space;
@@ -1480,6 +1541,11 @@ struct rtl8168_private {
         u8 org_pci_offset_80;
         u8 org_pci_offset_81;
         u8 use_timer_interrrupt;
+        u32 timer_count;        /* TimeInt0 in use, 0 for plain interrupts */
+        u32 coalesce_timer;     /* fixed TimeInt0 when not adaptive */
+        u8 dim_rx;
+        u8 dim_tx;
+        struct rtl8168_dim dim;
 
         u32 keep_intr_cnt;
 
@@ -63,6 +63,7 @@
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,4,37)
 #include <linux/prefetch.h>
 #endif
+#include <linux/math64.h>
 
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2,6,0)
 #define dev_printk(A,B,fmt,args...) printk(A fmt,##args)
@@ -88,6 +89,12 @@
 #include <linux/seq_file.h>
 #endif
 
+#ifdef ENABLE_R8168_XDP
+#include <linux/bpf.h>
+#include <linux/bpf_trace.h>
+#include <linux/filter.h>
+#endif
+
 /* Maximum number of multicast addresses to filter (vs. Rx-all-multicast).
    The RTL chips use a 64 element hash table based on the Ethernet CRC. */
 static const int multicast_filter_limit = 32;
@@ -316,6 +323,7 @@ static struct pci_device_id rtl8168_pci_tbl[] = {
 MODULE_DEVICE_TABLE(pci, rtl8168_pci_tbl);
 
 static int rx_copybreak = 0;
+static int rx_page_recycle = 1;
 static int use_dac = 1;
 static int timer_count = 0x2600;
 
@@ -381,6 +389,9 @@ MODULE_PARM_DESC(s5_keep_curr_mac, "Enable Shutdown Keep Current MAC Address.");
 module_param(rx_copybreak, int, 0);
 MODULE_PARM_DESC(rx_copybreak, "Copy breakpoint for copy-only-tiny-frames");
 
+module_param(rx_page_recycle, int, 0);
+MODULE_PARM_DESC(rx_page_recycle, "Receive into recycled DMA-mapped pages when the frame fits half a page.");
+
 module_param(use_dac, int, 0);
 MODULE_PARM_DESC(use_dac, "Enable PCI DAC. Unsafe on 32 bit PCI slot.");
 
@@ -3044,9 +3055,9 @@ rtl8168_switch_to_hw_interrupt(struct rtl8168_private *tp, void __iomem *ioaddr)
 static inline void
 rtl8168_switch_to_timer_interrupt(struct rtl8168_private *tp, void __iomem *ioaddr)
 {
-        if (tp->use_timer_interrrupt) {
-                RTL_W32(TCTR, timer_count);
-                RTL_W32(TimeInt0, timer_count);
+        if (tp->use_timer_interrrupt && tp->timer_count) {
+                RTL_W32(TCTR, tp->timer_count);
+                RTL_W32(TimeInt0, tp->timer_count);
                 RTL_W16(IntrMask, tp->timer_intr_mask);
 
 #ifdef ENABLE_DASH_SUPPORT
@@ -3058,6 +3069,100 @@ rtl8168_switch_to_timer_interrupt(struct rtl8168_private *tp, void __iomem *ioad
         }
 }
 
+/*
+ * Adaptive moderation ladder. The packet rate has to go above the next
+ * step's up_pkts (per ms) to climb and below half of the current one to
+ * come down, level 0 is plain per packet interrupts.
+ */
+static const struct {
+        u16 usecs;
+        u16 up_pkts;
+} rtl8168_dim_profile[] = {
+        {   0,   0 },
+        {  16,  16 },
+        {  32,  48 },
+        {  64,  96 },
+        { 128, 192 },
+};
+
+#define RTL8168_DIM_WINDOW_US      1000
+/* small average frames are request/response traffic, keep latency low */
+#define RTL8168_DIM_SMALL_PKT      256
+#define RTL8168_DIM_SMALL_MAX_LVL  1
+
+static void
+rtl8168_dim_sample(struct rtl8168_private *tp,
+                   u64 *pkts,
+                   u64 *bytes)
+{
+        struct net_device *dev = tp->dev;
+
+        *pkts = 0;
+        *bytes = 0;
+        if (tp->dim_rx) {
+                *pkts += RTLDEV->stats.rx_packets;
+                *bytes += RTLDEV->stats.rx_bytes;
+        }
+        if (tp->dim_tx) {
+                *pkts += RTLDEV->stats.tx_packets;
+                *bytes += RTLDEV->stats.tx_bytes;
+        }
+}
+
+static void
+rtl8168_dim_reset(struct rtl8168_private *tp)
+{
+        struct rtl8168_dim *dim = &tp->dim;
+
+        rtl8168_dim_sample(tp, &dim->pkts, &dim->bytes);
+        dim->stamp = ktime_get();
+        dim->level = 0;
+
+        tp->timer_count = (tp->dim_rx || tp->dim_tx) ? 0 : tp->coalesce_timer;
+}
+
+static void
+rtl8168_dim_update(struct rtl8168_private *tp)
+{
+        struct rtl8168_dim *dim = &tp->dim;
+        ktime_t now = ktime_get();
+        u64 pkts, bytes, delta;
+        unsigned int level, max_level;
+        u32 rate, avg;
+        s64 us;
+
+        us = ktime_us_delta(now, dim->stamp);
+        if (us < RTL8168_DIM_WINDOW_US)
+                return;
+
+        rtl8168_dim_sample(tp, &pkts, &bytes);
+        delta = pkts - dim->pkts;
+        rate = div64_u64(delta * USEC_PER_MSEC, us);
+        avg = delta ? div64_u64(bytes - dim->bytes, delta) : 0;
+
+        dim->pkts = pkts;
+        dim->bytes = bytes;
+        dim->stamp = now;
+
+        level = dim->level;
+        if (level + 1 < ARRAY_SIZE(rtl8168_dim_profile) &&
+            rate > rtl8168_dim_profile[level + 1].up_pkts)
+                level++;
+        else if (level && rate < rtl8168_dim_profile[level].up_pkts / 2)
+                level--;
+
+        max_level = ARRAY_SIZE(rtl8168_dim_profile) - 1;
+        if (avg < RTL8168_DIM_SMALL_PKT)
+                max_level = RTL8168_DIM_SMALL_MAX_LVL;
+        level = min(level, max_level);
+
+        if (level != dim->level) {
+                dim->level = level;
+                tp->timer_count = rtl8168_dim_profile[level].usecs *
+                                  RTL8168_TIMER_TICKS_PER_USEC;
+        }
+}
+
 static void
 rtl8168_irq_mask_and_ack(struct rtl8168_private *tp, void __iomem *ioaddr)
 {
@@ -3233,11 +3338,11 @@ static void rtl8168_mac_loopback_test(struct rtl8168_private *tp)
 {
         void __iomem *ioaddr = tp->mmio_addr;
         struct net_device *dev = tp->dev;
-        struct sk_buff *skb, *rx_skb;
+        struct sk_buff *skb;
         dma_addr_t mapping;
         struct TxDesc *txd;
         struct RxDesc *rxd;
-        void *tmpAddr;
+        void *tmpAddr, *rx_data;
         u32 len, rx_len, rx_cmd;
         u16 type;
         u8 pattern;
@@ -3251,7 +3356,13 @@ static void rtl8168_mac_loopback_test(struct rtl8168_private *tp)
         type = htons(ETH_P_IP);
         txd = tp->TxDescArray;
         rxd = tp->RxDescArray;
-        rx_skb = tp->Rx_skbuff[0];
+#ifdef ENABLE_RX_PAGE_RECYCLE
+        if (tp->rx_page_mode)
+                rx_data = page_address(tp->rx_page[0].page) +
+                          tp->rx_page[0].offset + RTL8168_RX_PAGE_HEADROOM;
+        else
+#endif //ENABLE_RX_PAGE_RECYCLE
+                rx_data = tp->Rx_skbuff[0]->data;
         RTL_W32(TxConfig, (RTL_R32(TxConfig) & ~0x00060000) | 0x00020000);
 
         do {
@@ -3300,7 +3411,7 @@ static void rtl8168_mac_loopback_test(struct rtl8168_private *tp)
 
                 if (rx_len == len) {
                         pci_dma_sync_single_for_cpu(tp->pci_dev, le64_to_cpu(rxd->addr), tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
-                        i = memcmp(skb->data, rx_skb->data, rx_len);
+                        i = memcmp(skb->data, rx_data, rx_len);
                         pci_dma_sync_single_for_device(tp->pci_dev, le64_to_cpu(rxd->addr), tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
                         if (i == 0) {
 //              dev_printk(KERN_INFO, &tp->pci_dev->dev, "loopback test finished\n",rx_len,len);
@@ -5102,6 +5213,13 @@ static const char rtl8168_gstrings[][ETH_GSTRING_LEN] = {
         "multicast",
         "tx_aborted",
         "tx_underrun",
+        "rx_page_recycle",
+        "rx_page_busy",
+        "rx_page_alloc",
+        "rx_page_alloc_fail",
+        "rx_xdp_drop",
+        "rx_xdp_tx",
+        "rx_xdp_redirect",
 };
 #endif //#LINUX_VERSION_CODE > KERNEL_VERSION(2,4,22)
 
@@ -5174,6 +5292,13 @@ rtl8168_get_ethtool_stats(struct net_device *dev,
         data[10] = le32_to_cpu(counters->rx_multicast);
         data[11] = le16_to_cpu(counters->tx_aborted);
         data[12] = le16_to_cpu(counters->tx_underun);
+        data[13] = tp->rx_page_recycle;
+        data[14] = tp->rx_page_busy;
+        data[15] = tp->rx_page_alloc;
+        data[16] = tp->rx_page_alloc_fail;
+        data[17] = tp->rx_xdp_drop;
+        data[18] = tp->rx_xdp_tx;
+        data[19] = tp->rx_xdp_redirect;
 }
 
 static void
@@ -5438,7 +5563,58 @@ static int rtl_nway_reset(struct net_device *dev)
 }
 
 #if LINUX_VERSION_CODE > KERNEL_VERSION(2,4,22)
+static int
+rtl8168_get_coalesce(struct net_device *dev,
+                     struct ethtool_coalesce *ec)
+{
+        struct rtl8168_private *tp = netdev_priv(dev);
+
+        if (!tp->use_timer_interrrupt)
+                return -EOPNOTSUPP;
+
+        /* one timer moderates both directions */
+        ec->rx_coalesce_usecs = tp->timer_count / RTL8168_TIMER_TICKS_PER_USEC;
+        ec->tx_coalesce_usecs = ec->rx_coalesce_usecs;
+        ec->use_adaptive_rx_coalesce = tp->dim_rx;
+        ec->use_adaptive_tx_coalesce = tp->dim_tx;
+
+        return 0;
+}
+
+static int
+rtl8168_set_coalesce(struct net_device *dev,
+                     struct ethtool_coalesce *ec)
+{
+        struct rtl8168_private *tp = netdev_priv(dev);
+        u32 usecs, cur;
+        unsigned long flags;
+
+        if (!tp->use_timer_interrrupt)
+                return -EOPNOTSUPP;
+
+        /* whichever of rx/tx-usecs was changed sets the shared timer */
+        cur = tp->timer_count / RTL8168_TIMER_TICKS_PER_USEC;
+        usecs = ec->rx_coalesce_usecs != cur ? ec->rx_coalesce_usecs :
+                ec->tx_coalesce_usecs;
+        if (usecs > RTL8168_COALESCE_USECS_MAX)
+                return -EINVAL;
+
+        spin_lock_irqsave(&tp->lock, flags);
+        if (usecs != cur)
+                tp->coalesce_timer = usecs * RTL8168_TIMER_TICKS_PER_USEC;
+        tp->dim_rx = !!ec->use_adaptive_rx_coalesce;
+        tp->dim_tx = !!ec->use_adaptive_tx_coalesce;
+        rtl8168_dim_reset(tp);
+        spin_unlock_irqrestore(&tp->lock, flags);
+
+        return 0;
+}
+
 static const struct ethtool_ops rtl8168_ethtool_ops = {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,7,0)
+        .supported_coalesce_params = ETHTOOL_COALESCE_USECS |
+                                     ETHTOOL_COALESCE_USE_ADAPTIVE,
+#endif
         .get_drvinfo        = rtl8168_get_drvinfo,
         .get_regs_len       = rtl8168_get_regs_len,
         .get_link       = ethtool_op_get_link,
@@ -5488,6 +5664,8 @@ static const struct ethtool_ops rtl8168_ethtool_ops = {
         .set_eee = rtl_ethtool_set_eee,
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(3,6,0) */
         .nway_reset = rtl_nway_reset,
+        .get_coalesce       = rtl8168_get_coalesce,
+        .set_coalesce       = rtl8168_set_coalesce,
 };
 #endif //LINUX_VERSION_CODE > KERNEL_VERSION(2,4,22)
 
@@ -23367,6 +23545,9 @@ rtl8168_init_software_variable(struct net_device *dev)
         if (timer_count == 0 || tp->mcfg == CFG_METHOD_DEFAULT)
                 tp->use_timer_interrrupt = FALSE;
 
+        tp->coalesce_timer = timer_count;
+        rtl8168_dim_reset(tp);
+
         switch (tp->mcfg) {
         case CFG_METHOD_1:
         case CFG_METHOD_2:
@@ -24967,6 +25148,54 @@ static void rtl8168_disable_msi(struct pci_dev *pdev, struct rtl8168_private *tp
         }
 }
 
+#ifdef ENABLE_R8168_XDP
+static int
+rtl8168_xdp_setup(struct net_device *dev,
+                  struct bpf_prog *prog)
+{
+        struct rtl8168_private *tp = netdev_priv(dev);
+        struct bpf_prog *old_prog;
+
+        /* the programs only ever see frames from the page rx ring */
+        if (prog && (!rx_page_recycle || dev->mtu > ETH_DATA_LEN ||
+                     RX_BUF_SIZE > RTL8168_RX_PAGE_BUF_LEN)) {
+                netif_warn(tp, drv, dev,
+                           "XDP needs rx_page_recycle and a %d byte MTU\n",
+                           ETH_DATA_LEN);
+                return -EOPNOTSUPP;
+        }
+
+        /* the buffer layout is the same either way, no ring restart */
+        old_prog = xchg(&tp->xdp_prog, prog);
+        if (old_prog)
+                bpf_prog_put(old_prog);
+
+        return 0;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)
+static int rtl8168_xdp(struct net_device *dev, struct netdev_bpf *xdp)
+#else
+static int rtl8168_xdp(struct net_device *dev, struct netdev_xdp *xdp)
+#endif
+{
+        struct rtl8168_private *tp = netdev_priv(dev);
+
+        switch (xdp->command) {
+        case XDP_SETUP_PROG:
+                return rtl8168_xdp_setup(dev, xdp->prog);
+        case XDP_QUERY_PROG:
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4,19,0)
+                xdp->prog_attached = !!tp->xdp_prog;
+#endif
+                xdp->prog_id = tp->xdp_prog ? tp->xdp_prog->aux->id : 0;
+                return 0;
+        default:
+                return -EINVAL;
+        }
+}
+#endif //ENABLE_R8168_XDP
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2,6,29)
 static const struct net_device_ops rtl8168_netdev_ops = {
         .ndo_open       = rtl8168_open,
@@ -24993,6 +25222,13 @@ static const struct net_device_ops rtl8168_netdev_ops = {
 #ifdef CONFIG_NET_POLL_CONTROLLER
         .ndo_poll_controller    = rtl8168_netpoll,
 #endif
+#ifdef ENABLE_R8168_XDP
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)
+        .ndo_bpf            = rtl8168_xdp,
+#else
+        .ndo_xdp            = rtl8168_xdp,
+#endif
+#endif //ENABLE_R8168_XDP
 };
 #endif
 
@@ -25143,6 +25379,12 @@ rtl8168_init_one(struct pci_dev *pdev, const struct pci_device_id *ent)
 
         rtl8168_tally_counter_clear(tp);
 
+#if defined(ENABLE_R8168_XDP) && LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+        rc = xdp_rxq_info_reg(&tp->xdp_rxq, dev, 0);
+        if (rc < 0)
+                goto err_out;
+#endif
+
         pci_set_drvdata(pdev, dev);
 
         rc = register_netdev(dev);
@@ -25171,6 +25413,10 @@ err_out:
 
                 tp->tally_vaddr = NULL;
         }
+#if defined(ENABLE_R8168_XDP) && LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+        if (xdp_rxq_info_is_reg(&tp->xdp_rxq))
+                xdp_rxq_info_unreg(&tp->xdp_rxq);
+#endif
 #ifdef  CONFIG_R8168_NAPI
         RTL_NAPI_DEL(tp);
 #endif
@@ -25200,6 +25446,13 @@ void __devexit rtl8168_remove_one(struct pci_dev *pdev)
 #ifdef ENABLE_R8168_PROCFS
         rtl8168_proc_remove(dev);
 #endif
+#ifdef ENABLE_R8168_XDP
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+        xdp_rxq_info_unreg(&tp->xdp_rxq);
+#endif
+        if (tp->xdp_prog)
+                bpf_prog_put(tp->xdp_prog);
+#endif //ENABLE_R8168_XDP
         if (tp->tally_vaddr != NULL) {
                 pci_free_consistent(pdev, sizeof(*tp->tally_vaddr), tp->tally_vaddr, tp->tally_paddr);
                 tp->tally_vaddr = NULL;
@@ -26549,6 +26802,12 @@ rtl8168_change_mtu(struct net_device *dev,
                 new_mtu = tp->max_jumbo_frame_size;
 #endif //LINUX_VERSION_CODE < KERNEL_VERSION(4,10,0)
 
+#ifdef ENABLE_R8168_XDP
+        /* jumbo frames would fall back to the skb rx ring */
+        if (tp->xdp_prog && new_mtu > ETH_DATA_LEN)
+                return -EINVAL;
+#endif //ENABLE_R8168_XDP
+
         spin_lock_irqsave(&tp->lock, flags);
         dev->mtu = new_mtu;
         spin_unlock_irqrestore(&tp->lock, flags);
@@ -26675,6 +26934,78 @@ err_out:
         goto out;
 }
 
+#ifdef ENABLE_RX_PAGE_RECYCLE
+/*
+ * Page mode keeps every rx page DMA-mapped for as long as the driver holds
+ * it. A frame is handed to the stack with build_skb() on the half page it
+ * landed in and the slot flips to the other half, so the page is only
+ * replaced when the stack still holds that other half.
+ */
+static inline void *
+rtl8168_rx_page_va(struct rtl8168_rx_page *rxp)
+{
+        return page_address(rxp->page) + rxp->offset +
+               RTL8168_RX_PAGE_HEADROOM;
+}
+
+static inline dma_addr_t
+rtl8168_rx_page_dma(struct rtl8168_rx_page *rxp)
+{
+        return rxp->dma + rxp->offset + RTL8168_RX_PAGE_HEADROOM;
+}
+
+static void
+rtl8168_free_rx_page(struct rtl8168_private *tp,
+                     struct rtl8168_rx_page *rxp,
+                     struct RxDesc *desc)
+{
+        dma_unmap_page_attrs(&tp->pci_dev->dev, rxp->dma, PAGE_SIZE,
+                             DMA_FROM_DEVICE, DMA_ATTR_SKIP_CPU_SYNC);
+        put_page(rxp->page);
+        rxp->page = NULL;
+        rtl8168_make_unusable_by_asic(desc);
+}
+
+static int
+rtl8168_alloc_rx_page(struct rtl8168_private *tp,
+                      struct rtl8168_rx_page *rxp,
+                      struct RxDesc *desc,
+                      u8 in_intr)
+{
+        struct device *d = &tp->pci_dev->dev;
+        struct page *page;
+        dma_addr_t mapping;
+
+        page = __dev_alloc_page(in_intr ? GFP_ATOMIC : GFP_KERNEL);
+        if (unlikely(!page))
+                goto err_out;
+
+        mapping = dma_map_page_attrs(d, page, 0, PAGE_SIZE, DMA_FROM_DEVICE,
+                                     DMA_ATTR_SKIP_CPU_SYNC);
+        if (unlikely(dma_mapping_error(d, mapping))) {
+                if (unlikely(net_ratelimit()))
+                        netif_err(tp, drv, tp->dev, "Failed to map RX DMA!\n");
+                __free_page(page);
+                goto err_out;
+        }
+
+        rxp->page = page;
+        rxp->dma = mapping;
+        rxp->offset = 0;
+        tp->rx_page_alloc++;
+
+        dma_sync_single_range_for_device(d, mapping, RTL8168_RX_PAGE_HEADROOM,
+                                         tp->rx_buf_sz, DMA_FROM_DEVICE);
+        rtl8168_map_to_asic(desc, rtl8168_rx_page_dma(rxp), tp->rx_buf_sz);
+        return 0;
+
+err_out:
+        tp->rx_page_alloc_fail++;
+        rtl8168_make_unusable_by_asic(desc);
+        return -ENOMEM;
+}
+#endif //ENABLE_RX_PAGE_RECYCLE
+
 static void
 rtl8168_rx_clear(struct rtl8168_private *tp)
 {
@@ -26684,6 +27015,11 @@ rtl8168_rx_clear(struct rtl8168_private *tp)
                 if (tp->Rx_skbuff[i])
                         rtl8168_free_rx_skb(tp, tp->Rx_skbuff + i,
                                             tp->RxDescArray + i);
+#ifdef ENABLE_RX_PAGE_RECYCLE
+                if (tp->rx_page[i].page)
+                        rtl8168_free_rx_page(tp, tp->rx_page + i,
+                                             tp->RxDescArray + i);
+#endif //ENABLE_RX_PAGE_RECYCLE
         }
 }
 
@@ -26699,6 +27035,20 @@ rtl8168_rx_fill(struct rtl8168_private *tp,
         for (cur = start; end - cur > 0; cur++) {
                 int ret, i = cur % NUM_RX_DESC;
 
+#ifdef ENABLE_RX_PAGE_RECYCLE
+                if (tp->rx_page_mode) {
+                        if (tp->rx_page[i].page)
+                                continue;
+
+                        ret = rtl8168_alloc_rx_page(tp, tp->rx_page + i,
+                                                    tp->RxDescArray + i,
+                                                    in_intr);
+                        if (ret < 0)
+                                break;
+                        continue;
+                }
+#endif //ENABLE_RX_PAGE_RECYCLE
+
                 if (tp->Rx_skbuff[i])
                         continue;
 
@@ -26777,6 +27127,11 @@ rtl8168_init_ring(struct net_device *dev)
 
         memset(tp->tx_skb, 0x0, NUM_TX_DESC * sizeof(struct ring_info));
         memset(tp->Rx_skbuff, 0x0, NUM_RX_DESC * sizeof(struct sk_buff *));
+#ifdef ENABLE_RX_PAGE_RECYCLE
+        memset(tp->rx_page, 0x0, sizeof(tp->rx_page));
+        tp->rx_page_mode = rx_page_recycle &&
+                           tp->rx_buf_sz <= RTL8168_RX_PAGE_BUF_LEN;
+#endif //ENABLE_RX_PAGE_RECYCLE
 
         rtl8168_tx_desc_init(tp);
         rtl8168_rx_desc_init(tp);
@@ -26830,6 +27185,11 @@ static void rtl8168_tx_clear_range(struct rtl8168_private *tp, u32 start,
                                 dev_kfree_skb_any(skb);
                                 tx_skb->skb = NULL;
                         }
+                        if (tx_skb->page) {
+                                RTLDEV->stats.tx_dropped++;
+                                put_page(tx_skb->page);
+                                tx_skb->page = NULL;
+                        }
                 }
         }
 }
@@ -27211,6 +27571,11 @@ static void r8168_csum_workaround(struct rtl8168_private *tp,
                         nskb = segs;
                         segs = segs->next;
                         nskb->next = NULL;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3,18,0) && \
+    LINUX_VERSION_CODE < KERNEL_VERSION(5,2,0)
+                        /* ring the doorbell once for the whole burst */
+                        nskb->xmit_more = segs != NULL;
+#endif
                         rtl8168_start_xmit(nskb, tp->dev);
                 } while (segs);
 
@@ -27254,6 +27619,25 @@ static int msdn_giant_send_check(struct sk_buff *skb)
 }
 #endif
 
+/*
+ * Batch the TxPoll doorbell while the stack says more frames follow. It
+ * must still be rung once the queue gets stopped, nobody would flush it.
+ */
+static inline bool
+rtl8168_xmit_more(struct sk_buff *skb,
+                  struct net_device *dev)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,2,0)
+        return netdev_xmit_more() &&
+               !netif_xmit_stopped(netdev_get_tx_queue(dev, 0));
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(3,18,0)
+        return skb->xmit_more &&
+               !netif_xmit_stopped(netdev_get_tx_queue(dev, 0));
+#else
+        return false;
+#endif
+}
+
 static int
 rtl8168_start_xmit(struct sk_buff *skb,
                    struct net_device *dev)
@@ -27269,6 +27653,7 @@ rtl8168_start_xmit(struct sk_buff *skb,
         int ret = NETDEV_TX_OK;
         unsigned long flags, large_send;
         int frags;
+        bool stop;
 
         spin_lock_irqsave(&tp->lock, flags);
 
@@ -27399,10 +27784,14 @@ rtl8168_start_xmit(struct sk_buff *skb,
 
         wmb();
 
-        RTL_W8(TxPoll, NPQ);    /* set polling bit */
-
-        if (TX_BUFFS_AVAIL(tp) < MAX_SKB_FRAGS) {
+        stop = TX_BUFFS_AVAIL(tp) < MAX_SKB_FRAGS;
+        if (stop)
                 netif_stop_queue(dev);
+
+        if (!rtl8168_xmit_more(skb, dev))
+                RTL_W8(TxPoll, NPQ);    /* set polling bit */
+
+        if (stop) {
                 smp_rmb();
                 if (TX_BUFFS_AVAIL(tp) >= MAX_SKB_FRAGS)
                         netif_wake_queue(dev);
@@ -27416,6 +27805,9 @@ err_dma_1:
         rtl8168_tx_clear_range(tp, tp->cur_tx + 1, frags);
 err_dma_0:
         RTLDEV->stats.tx_dropped++;
+        /* flush whatever an earlier xmit_more left pending */
+        if (tp->cur_tx != tp->dirty_tx)
+                RTL_W8(TxPoll, NPQ);
         spin_unlock_irqrestore(&tp->lock, flags);
         dev_kfree_skb_any(skb);
         ret = NETDEV_TX_OK;
@@ -27424,6 +27816,8 @@ err_stop:
         netif_stop_queue(dev);
         ret = NETDEV_TX_BUSY;
         RTLDEV->stats.tx_dropped++;
+        if (tp->cur_tx != tp->dirty_tx)
+                RTL_W8(TxPoll, NPQ);
 
         spin_unlock_irqrestore(&tp->lock, flags);
         goto out;
@@ -27470,6 +27864,10 @@ rtl8168_tx_interrupt(struct net_device *dev,
 #endif
                         tx_skb->skb = NULL;
                 }
+                if (tx_skb->page) {
+                        put_page(tx_skb->page);
+                        tx_skb->page = NULL;
+                }
                 dirty_tx++;
                 tx_left--;
         }
@@ -27557,6 +27955,251 @@ rtl8168_try_rx_copy(struct rtl8168_private *tp,
         return ret;
 }
 
+#ifdef ENABLE_RX_PAGE_RECYCLE
+static inline bool
+rtl8168_can_reuse_rx_page(struct rtl8168_private *tp,
+                          struct rtl8168_rx_page *rxp)
+{
+        struct page *page = rxp->page;
+
+        if (unlikely(page_is_pfmemalloc(page)) ||
+            unlikely(page_to_nid(page) != numa_mem_id()))
+                goto busy;
+
+        /* the stack still holds the other half */
+        if (page_ref_count(page) != 1)
+                goto busy;
+
+        /* one reference for the half handed out, ours stays with the slot */
+        page_ref_inc(page);
+        rxp->offset ^= RTL8168_RX_PAGE_HALF;
+        tp->rx_page_recycle++;
+
+        return true;
+
+busy:
+        tp->rx_page_busy++;
+        return false;
+}
+
+#ifdef ENABLE_R8168_XDP
+enum rtl8168_xdp_verdict {
+        RTL8168_XDP_PASS = 0,
+        RTL8168_XDP_DROP,
+        RTL8168_XDP_CONSUMED,   /* the buffer went out with the frame */
+};
+
+#define RTL8168_XDP_TX_PENDING       BIT_0
+#define RTL8168_XDP_REDIRECT_PENDING BIT_1
+
+static int
+rtl8168_xdp_xmit_page(struct rtl8168_private *tp,
+                      struct page *page,
+                      void *data,
+                      u32 len)
+{
+        struct device *d = &tp->pci_dev->dev;
+        unsigned int entry;
+        struct TxDesc *txd;
+        dma_addr_t mapping;
+        unsigned long flags;
+        u32 opts1;
+        int ret = -EBUSY;
+
+        spin_lock_irqsave(&tp->lock, flags);
+
+        /* keep room for a full skb, start_xmit relies on it while awake */
+        if (unlikely(TX_BUFFS_AVAIL(tp) <= MAX_SKB_FRAGS))
+                goto out;
+
+        entry = tp->cur_tx % NUM_TX_DESC;
+        txd = tp->TxDescArray + entry;
+        if (unlikely(le32_to_cpu(txd->opts1) & DescOwn))
+                goto out;
+
+        if (tp->UseSwPaddingShortPkt && len < ETH_ZLEN) {
+                memset(data + len, 0, ETH_ZLEN - len);
+                len = ETH_ZLEN;
+        }
+
+        mapping = dma_map_single(d, data, len, DMA_TO_DEVICE);
+        if (unlikely(dma_mapping_error(d, mapping))) {
+                ret = -ENOMEM;
+                goto out;
+        }
+
+        tp->tx_skb[entry].skb = NULL;
+        tp->tx_skb[entry].page = page;
+        tp->tx_skb[entry].len = len;
+
+        opts1 = DescOwn | FirstFrag | LastFrag | len |
+                (RingEnd * !((entry + 1) % NUM_TX_DESC));
+        txd->addr = cpu_to_le64(mapping);
+        txd->opts2 = 0;
+        wmb();
+        txd->opts1 = cpu_to_le32(opts1);
+
+        tp->cur_tx++;
+        ret = 0;
+out:
+        spin_unlock_irqrestore(&tp->lock, flags);
+        return ret;
+}
+
+static int
+rtl8168_run_xdp(struct rtl8168_private *tp,
+                struct bpf_prog *xdp_prog,
+                struct rtl8168_rx_page *rxp,
+                void **va,
+                int *pkt_size)
+{
+        struct net_device *dev = tp->dev;
+        struct xdp_buff xdp;
+        u32 act;
+
+        xdp.data_hard_start = page_address(rxp->page) + rxp->offset;
+        xdp.data = *va;
+        xdp.data_end = xdp.data + *pkt_size;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0)
+        xdp_set_data_meta_invalid(&xdp);
+#endif
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4,16,0)
+        xdp.rxq = &tp->xdp_rxq;
+#endif
+
+        act = bpf_prog_run_xdp(xdp_prog, &xdp);
+
+        /* the program may have moved either end of the frame */
+        *va = xdp.data;
+        *pkt_size = xdp.data_end - xdp.data;
+
+        switch (act) {
+        case XDP_PASS:
+                return RTL8168_XDP_PASS;
+        case XDP_TX:
+                if (rtl8168_xdp_xmit_page(tp, rxp->page, xdp.data,
+                                          *pkt_size) < 0)
+                        goto out_failure;
+                tp->xdp_pending |= RTL8168_XDP_TX_PENDING;
+                tp->rx_xdp_tx++;
+                return RTL8168_XDP_CONSUMED;
+        case XDP_REDIRECT:
+                if (xdp_do_redirect(dev, &xdp, xdp_prog) < 0)
+                        goto out_failure;
+                tp->xdp_pending |= RTL8168_XDP_REDIRECT_PENDING;
+                tp->rx_xdp_redirect++;
+                return RTL8168_XDP_CONSUMED;
+        default:
+                bpf_warn_invalid_xdp_action(act);
+                /* fall through */
+        case XDP_ABORTED:
+out_failure:
+                trace_xdp_exception(dev, xdp_prog, act);
+                /* fall through */
+        case XDP_DROP:
+                tp->rx_xdp_drop++;
+                return RTL8168_XDP_DROP;
+        }
+}
+
+static void
+rtl8168_xdp_flush(struct rtl8168_private *tp)
+{
+        void __iomem *ioaddr = tp->mmio_addr;
+
+        if (tp->xdp_pending & RTL8168_XDP_REDIRECT_PENDING)
+                xdp_do_flush_map();
+
+        if (tp->xdp_pending & RTL8168_XDP_TX_PENDING) {
+                wmb();
+                RTL_W8(TxPoll, NPQ);    /* set polling bit */
+        }
+
+        tp->xdp_pending = 0;
+}
+#endif //ENABLE_R8168_XDP
+
+static struct sk_buff *
+rtl8168_rx_page_skb(struct rtl8168_private *tp,
+                    struct rtl8168_rx_page *rxp,
+                    struct RxDesc *desc,
+                    int pkt_size)
+{
+        struct net_device *dev = tp->dev;
+        struct device *d = &tp->pci_dev->dev;
+        struct sk_buff *skb = NULL;
+        void *va = rtl8168_rx_page_va(rxp);
+        bool keep = true;
+#ifdef ENABLE_R8168_XDP
+        struct bpf_prog *xdp_prog;
+#endif
+
+        dma_sync_single_range_for_cpu(d, rxp->dma,
+                                      rxp->offset + RTL8168_RX_PAGE_HEADROOM,
+                                      pkt_size, DMA_FROM_DEVICE);
+        prefetch(va);
+
+#ifdef ENABLE_R8168_XDP
+        xdp_prog = READ_ONCE(tp->xdp_prog);
+        if (xdp_prog) {
+                switch (rtl8168_run_xdp(tp, xdp_prog, rxp, &va, &pkt_size)) {
+                case RTL8168_XDP_PASS:
+                        break;
+                case RTL8168_XDP_CONSUMED:
+                        keep = rtl8168_can_reuse_rx_page(tp, rxp);
+                        goto xdp_done;
+                default:
+                        goto xdp_done;
+                }
+        }
+#endif //ENABLE_R8168_XDP
+
+        if (pkt_size < rx_copybreak) {
+                /* tiny frame, copy it and give the same buffer back */
+                skb = RTL_ALLOC_SKB_INTR(tp, pkt_size + RTK_RX_ALIGN);
+                if (skb) {
+                        skb_reserve(skb, RTK_RX_ALIGN);
+                        memcpy(skb_put(skb, pkt_size), va, pkt_size);
+                }
+        } else {
+                void *head = page_address(rxp->page) + rxp->offset;
+
+                skb = build_skb(head, RTL8168_RX_PAGE_HALF);
+                if (skb) {
+                        skb_reserve(skb, va - head);
+                        skb_put(skb, pkt_size);
+                        keep = rtl8168_can_reuse_rx_page(tp, rxp);
+                }
+        }
+
+        if (unlikely(!skb))
+                RTLDEV->stats.rx_dropped++;
+        else if (tp->cp_cmd & RxChkSum)
+                /* read the status before the descriptor is handed back */
+                rtl8168_rx_csum(tp, skb, desc);
+
+#ifdef ENABLE_R8168_XDP
+xdp_done:
+#endif //ENABLE_R8168_XDP
+        if (unlikely(!keep)) {
+                /* our reference went with the frame, rx_fill replaces it */
+                dma_unmap_page_attrs(d, rxp->dma, PAGE_SIZE, DMA_FROM_DEVICE,
+                                     DMA_ATTR_SKIP_CPU_SYNC);
+                rxp->page = NULL;
+                rtl8168_make_unusable_by_asic(desc);
+                return skb;
+        }
+
+        /* dropped frames leave the buffer to be reused as it is */
+        dma_sync_single_range_for_device(d, rxp->dma,
+                                         rxp->offset + RTL8168_RX_PAGE_HEADROOM,
+                                         tp->rx_buf_sz, DMA_FROM_DEVICE);
+        rtl8168_map_to_asic(desc, rtl8168_rx_page_dma(rxp), tp->rx_buf_sz);
+
+        return skb;
+}
+#endif //ENABLE_RX_PAGE_RECYCLE
+
 static inline void
 rtl8168_rx_skb(struct rtl8168_private *tp,
                struct sk_buff *skb)
@@ -27644,6 +28287,17 @@ process_pkt:
                                 continue;
                         }
 
+#ifdef ENABLE_RX_PAGE_RECYCLE
+                        if (tp->rx_page_mode) {
+                                skb = rtl8168_rx_page_skb(tp,
+                                                          tp->rx_page + entry,
+                                                          desc, pkt_size);
+                                if (!skb)
+                                        goto rx_next;
+                                goto rx_deliver;
+                        }
+#endif //ENABLE_RX_PAGE_RECYCLE
+
                         skb = tp->Rx_skbuff[entry];
                         if (tp->cp_cmd & RxChkSum)
                                 rtl8168_rx_csum(tp, skb, desc);
@@ -27662,8 +28316,11 @@ process_pkt:
                         pci_action(tp->pci_dev, le64_to_cpu(desc->addr),
                                    tp->rx_buf_sz, PCI_DMA_FROMDEVICE);
 
-                        skb->dev = dev;
                         skb_put(skb, pkt_size);
+#ifdef ENABLE_RX_PAGE_RECYCLE
+rx_deliver:
+#endif //ENABLE_RX_PAGE_RECYCLE
+                        skb->dev = dev;
                         skb->protocol = eth_type_trans(skb, dev);
 
                         if (skb->pkt_type == PACKET_MULTICAST)
@@ -27678,6 +28335,9 @@ process_pkt:
                         RTLDEV->stats.rx_packets++;
                 }
 
+#ifdef ENABLE_RX_PAGE_RECYCLE
+rx_next:
+#endif //ENABLE_RX_PAGE_RECYCLE
                 cur_rx++;
                 entry = cur_rx % NUM_RX_DESC;
                 desc = tp->RxDescArray + entry;
@@ -27689,6 +28349,11 @@ process_pkt:
         count = cur_rx - tp->cur_rx;
         tp->cur_rx = cur_rx;
 
+#ifdef ENABLE_R8168_XDP
+        if (tp->xdp_pending)
+                rtl8168_xdp_flush(tp);
+#endif //ENABLE_R8168_XDP
+
         delta = rtl8168_rx_fill(tp, dev, tp->dirty_rx, tp->cur_rx, 1);
         if (!delta && count && netif_msg_intr(tp))
                 printk(KERN_INFO "%s: no Rx buffer allocated\n", dev->name);
@@ -27911,6 +28576,9 @@ static int rtl8168_poll(napi_ptr napi, napi_budget budget)
                  */
                 smp_wmb();
 
+                if (tp->dim_rx || tp->dim_tx)
+                        rtl8168_dim_update(tp);
+
                 rtl8168_switch_to_timer_interrupt(tp, ioaddr);
         }
 
@@ -20,6 +20,8 @@
 #include "t19x-nvlink-endpt.h"
 #include "nvlink-hw.h"
 #include <linux/uaccess.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 
 static int nvlink_refclk_rate_file_open(struct inode *inode, struct file *file)
 {
@@ -209,6 +211,191 @@ static const struct file_operations nvlink_shutdown_fops = {
 	.owner	= THIS_MODULE,
 };
 
+static u64 nvlink_read_tp_cntr(struct tnvlink_dev *tdev, u32 lo, u32 hi)
+{
+	u64 reg_hi = nvlw_nvltlc_readl(tdev, hi);
+	u64 reg_lo = nvlw_nvltlc_readl(tdev, lo);
+
+	/* The rollover flag shares the HI register, keep the count only */
+	reg_hi &= ~BIT(NVLTLC_TX_DEBUG_TP_CNTR0_HI_ROLLOVER);
+
+	return (reg_hi << 32) | reg_lo;
+}
+
+static void nvlink_tp_sample_work(struct work_struct *work)
+{
+	struct tnvlink_tp_sampler *s = container_of(to_delayed_work(work),
+					struct tnvlink_tp_sampler, work);
+	struct tnvlink_dev *tdev = s->tdev;
+	struct tnvlink_tp_sample *smp;
+	enum init_state state = NVLINK_DEV_OFF;
+	u32 reg_val;
+
+	mutex_lock(&s->lock);
+	if (!s->period_ms)
+		goto out;
+
+	/* The TL is unclocked until the link is initialized */
+	if (nvlink_get_init_state(tdev->ndev, &state) < 0 ||
+	    state < NVLINK_LINK_EARLY_INIT_DONE)
+		goto resched;
+
+	smp = &s->samples[s->head % TNVLINK_TP_SAMPLES];
+	smp->time = ktime_get();
+	smp->tx0 = nvlink_read_tp_cntr(tdev, NVLTLC_TX_DEBUG_TP_CNTR0_LO,
+				       NVLTLC_TX_DEBUG_TP_CNTR0_HI);
+	smp->tx1 = nvlink_read_tp_cntr(tdev, NVLTLC_TX_DEBUG_TP_CNTR1_LO,
+				       NVLTLC_TX_DEBUG_TP_CNTR1_HI);
+	smp->rx0 = nvlink_read_tp_cntr(tdev, NVLTLC_RX_DEBUG_TP_CNTR0_LO,
+				       NVLTLC_RX_DEBUG_TP_CNTR0_HI);
+	smp->rx1 = nvlink_read_tp_cntr(tdev, NVLTLC_RX_DEBUG_TP_CNTR1_LO,
+				       NVLTLC_RX_DEBUG_TP_CNTR1_HI);
+	reg_val = nvlw_nvl_readl(tdev, NVL_SL0_ERROR_COUNT4);
+	smp->replays = NVL_SL0_ERROR_COUNT4_REPLAY_EVENTS_V(reg_val);
+	s->head++;
+
+resched:
+	schedule_delayed_work(&s->work, msecs_to_jiffies(s->period_ms));
+out:
+	mutex_unlock(&s->lock);
+}
+
+static u64 nvlink_tp_rate(u64 cur, u64 prev, s64 dt_us)
+{
+	/* A counter that went backwards was cleared in between */
+	if (cur < prev || dt_us <= 0)
+		return 0;
+
+	return div64_u64((cur - prev) * USEC_PER_SEC, dt_us);
+}
+
+/*
+ * One line per sample: time since the oldest sample in the buffer and
+ * per second rates of the TL throughput counters and DL replays.
+ */
+static int nvlink_throughput_show(struct seq_file *m, void *unused)
+{
+	struct tnvlink_dev *tdev = m->private;
+	struct tnvlink_tp_sampler *s = tdev->tp_sampler;
+	struct tnvlink_tp_sample *cur, *prev, *first;
+	u32 i, n;
+	s64 dt;
+
+	mutex_lock(&s->lock);
+	n = min_t(u32, s->head, TNVLINK_TP_SAMPLES);
+	seq_puts(m, "time_us tx0/s tx1/s rx0/s rx1/s replays/s\n");
+	if (n < 2)
+		goto out;
+
+	first = &s->samples[(s->head - n) % TNVLINK_TP_SAMPLES];
+	for (i = s->head - n + 1; i != s->head; i++) {
+		prev = &s->samples[(i - 1) % TNVLINK_TP_SAMPLES];
+		cur = &s->samples[i % TNVLINK_TP_SAMPLES];
+		dt = ktime_us_delta(cur->time, prev->time);
+
+		seq_printf(m, "%lld %llu %llu %llu %llu %llu\n",
+			   ktime_us_delta(cur->time, first->time),
+			   nvlink_tp_rate(cur->tx0, prev->tx0, dt),
+			   nvlink_tp_rate(cur->tx1, prev->tx1, dt),
+			   nvlink_tp_rate(cur->rx0, prev->rx0, dt),
+			   nvlink_tp_rate(cur->rx1, prev->rx1, dt),
+			   nvlink_tp_rate(cur->replays, prev->replays, dt));
+	}
+out:
+	mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+static int nvlink_throughput_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvlink_throughput_show, inode->i_private);
+}
+
+static const struct file_operations nvlink_throughput_fops = {
+	.open		= nvlink_throughput_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+	.owner		= THIS_MODULE,
+};
+
+static int nvlink_tp_period_get(void *data, u64 *val)
+{
+	struct tnvlink_tp_sampler *s = data;
+
+	*val = s->period_ms;
+	return 0;
+}
+
+/* Writing a period in ms starts sampling, 0 stops it */
+static int nvlink_tp_period_set(void *data, u64 val)
+{
+	struct tnvlink_tp_sampler *s = data;
+
+	if (val > MSEC_PER_SEC * 60)
+		return -EINVAL;
+
+	cancel_delayed_work_sync(&s->work);
+
+	mutex_lock(&s->lock);
+	s->period_ms = val;
+	s->head = 0;
+	if (s->period_ms)
+		schedule_delayed_work(&s->work, 0);
+	mutex_unlock(&s->lock);
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(nvlink_tp_period_fops, nvlink_tp_period_get,
+			nvlink_tp_period_set, "%llu\n");
+
+static int nvlink_throughput_debugfs_init(struct tnvlink_dev *tdev)
+{
+	struct tnvlink_tp_sampler *s;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	s->tdev = tdev;
+	mutex_init(&s->lock);
+	INIT_DELAYED_WORK(&s->work, nvlink_tp_sample_work);
+	tdev->tp_sampler = s;
+
+	if (!debugfs_create_file("throughput_period_ms", (S_IWUSR | S_IRUGO),
+				 tdev->tegra_debugfs, s,
+				 &nvlink_tp_period_fops)) {
+		nvlink_err("Unable to create debugfs node for throughput period");
+		return -1;
+	}
+
+	if (!debugfs_create_file("throughput", S_IRUGO, tdev->tegra_debugfs,
+				 tdev, &nvlink_throughput_fops)) {
+		nvlink_err("Unable to create debugfs node for throughput");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void nvlink_throughput_debugfs_deinit(struct tnvlink_dev *tdev)
+{
+	struct tnvlink_tp_sampler *s = tdev->tp_sampler;
+
+	if (!s)
+		return;
+
+	mutex_lock(&s->lock);
+	s->period_ms = 0;
+	mutex_unlock(&s->lock);
+	cancel_delayed_work_sync(&s->work);
+
+	kfree(s);
+	tdev->tp_sampler = NULL;
+}
+
 static int nvlink_single_lane_debugfs_init(struct tnvlink_dev *tdev)
 {
 	struct dentry *tegra_sl_debugfs;
@@ -338,6 +525,9 @@ void t19x_nvlink_endpt_debugfs_init(struct tnvlink_dev *tdev)
 	if (nvlink_single_lane_debugfs_init(tdev) < 0)
 		goto fail;
 
+	if (nvlink_throughput_debugfs_init(tdev) < 0)
+		goto fail;
+
 	if (!debugfs_create_bool("is_nea", (S_IWUSR | S_IRUGO),
 					tdev->tegra_debugfs,
 					&tdev->is_nea)) {
@@ -351,10 +541,12 @@ fail:
 	nvlink_err("Failed to create debugfs nodes");
 	debugfs_remove_recursive(tdev->tegra_debugfs);
 	tdev->tegra_debugfs = NULL;
+	nvlink_throughput_debugfs_deinit(tdev);
 }
 
 void t19x_nvlink_endpt_debugfs_deinit(struct tnvlink_dev *tdev)
 {
 	debugfs_remove_recursive(tdev->tegra_debugfs);
 	tdev->tegra_debugfs = NULL;
+	nvlink_throughput_debugfs_deinit(tdev);
 }
@@ -173,6 +173,11 @@ int minion_send_cmd(struct tnvlink_dev *tdev,
 		return -1;
 	}
 
+	if (cmd == MINION_NVLINK_DL_CMD_COMMAND_CONFIGEOM) {
+		tdev->tlink.eom_params = scratch0_val;
+		tdev->tlink.eom_params_valid = true;
+	}
+
 	nvlink_dbg("MINION command (cmd = %d) completed successfully!", cmd);
 	return 0;
 }
@@ -948,6 +953,19 @@ int init_nvhs_phy(struct tnvlink_dev *tdev)
 		goto undo_clk;
 	}
 
+	/*
+	 * The MINION forgets the EOM setup across power cycles. Restore the
+	 * last one that worked so a resumed link comes back as it was
+	 * instead of waiting for the client to redo it; if the MINION now
+	 * rejects it, drop it and keep the default.
+	 */
+	if (tdev->tlink.eom_params_valid &&
+	    minion_send_cmd(tdev, MINION_NVLINK_DL_CMD_COMMAND_CONFIGEOM,
+			    tdev->tlink.eom_params) < 0) {
+		nvlink_err("Cached EOM setup rejected, using the default");
+		tdev->tlink.eom_params_valid = false;
+	}
+
 	nvlink_dbg("NVHS PHY init succeeded!");
 	goto success;
 
@@ -162,6 +162,9 @@ struct tnvlink_link {
 	u32 tlc_rx_err_status1;
 	/* Successful error recoveries */
 	u32 error_recoveries;
+	/* Last EOM setup accepted by the MINION, replayed after PHY init */
+	u32 eom_params;
+	bool eom_params_valid;
 	/* Parameters which describe the selected Single-Lane policy */
 	struct single_lane_params sl_params;
 	/* Pointer to parent struct tnvlink_dev */
@@ -170,6 +173,30 @@ struct tnvlink_link {
 	struct nvlink_link *nlink;
 };
 
+#ifdef CONFIG_DEBUG_FS
+/* Periodic TL throughput counter samples, exposed through debugfs */
+#define TNVLINK_TP_SAMPLES	256
+
+struct tnvlink_tp_sample {
+	ktime_t time;
+	u64 tx0;
+	u64 tx1;
+	u64 rx0;
+	u64 rx1;
+	u32 replays;
+};
+
+struct tnvlink_tp_sampler {
+	struct tnvlink_dev *tdev;
+	struct delayed_work work;
+	struct mutex lock;
+	u32 period_ms;
+	/* free running, the slot is head % TNVLINK_TP_SAMPLES */
+	u32 head;
+	struct tnvlink_tp_sample samples[TNVLINK_TP_SAMPLES];
+};
+#endif /* CONFIG_DEBUG_FS  */
+
 /* Tegra endpoint driver's private device struct */
 struct tnvlink_dev {
 	/* Are we using the RM shim driver? */
@@ -194,6 +221,7 @@ struct tnvlink_dev {
 	/* This is the debugfs directory for the Tegra endpoint driver */
 	struct dentry *tegra_debugfs;
 	struct dentry *tegra_debugfs_file;
+	struct tnvlink_tp_sampler *tp_sampler;
 #endif /* CONFIG_DEBUG_FS  */
 	/* clocks */
 	struct clk *clk_nvhs_pll0_mgmt;
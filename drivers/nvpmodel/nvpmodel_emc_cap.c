@@ -25,6 +25,12 @@
 #include <linux/string.h>
 #include <linux/clk.h>
 #include <linux/of.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/topology.h>
+#include <linux/mutex.h>
+#include <linux/ktime.h>
 #include <linux/platform/tegra/emc_bwmgr.h>
 #include <linux/platform/tegra/bwmgr_mc.h>
 
@@ -53,6 +59,26 @@ struct nvpmodel_clk {
 static struct nvpmodel_clk *clks;
 static int num_clocks;
 
+#define NVPMODEL_MAX_CLUSTERS	4
+
+/*
+ * A power profile from DT, parsed once so a switch only has to apply it.
+ * Zero EMC/clock caps leave that cap alone, zero cpu caps lift the cap.
+ */
+struct nvpmodel_profile {
+	const char *name;
+	unsigned long emc_iso_cap; /* Hz */
+	u64 *clk_caps; /* Hz, indexed like clks */
+	unsigned int cpu_caps[NVPMODEL_MAX_CLUSTERS]; /* kHz */
+};
+
+static struct nvpmodel_profile *profiles;
+static int num_profiles;
+static struct nvpmodel_profile *cur_profile;
+static DEFINE_MUTEX(profile_lock);
+static s64 profile_transition_us;
+static bool cpufreq_nb_registered;
+
 static ssize_t emc_iso_cap_show(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
 {
@@ -116,10 +142,279 @@ static ssize_t clk_cap_store(struct kobject *kobj,
 	return count;
 }
 
+static int nvpmodel_cpufreq_notifier(struct notifier_block *nb,
+				     unsigned long event, void *data)
+{
+	struct cpufreq_policy *policy = data;
+	struct nvpmodel_profile *profile = READ_ONCE(cur_profile);
+	int cluster;
+
+	if (event != CPUFREQ_ADJUST || !profile)
+		return NOTIFY_OK;
+
+	cluster = topology_physical_package_id(policy->cpu);
+	if (cluster < 0 || cluster >= NVPMODEL_MAX_CLUSTERS ||
+	    !profile->cpu_caps[cluster])
+		return NOTIFY_OK;
+
+	cpufreq_verify_within_limits(policy, 0, profile->cpu_caps[cluster]);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block nvpmodel_cpufreq_nb = {
+	.notifier_call = nvpmodel_cpufreq_notifier,
+};
+
+static void nvpmodel_apply_cpu_caps(void)
+{
+	struct cpufreq_policy *policy;
+	struct cpumask updated;
+	int cpu;
+
+	if (!cpufreq_nb_registered)
+		return;
+
+	cpumask_clear(&updated);
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		if (cpumask_test_cpu(cpu, &updated))
+			continue;
+		policy = cpufreq_cpu_get(cpu);
+		if (!policy)
+			continue;
+		cpumask_or(&updated, &updated, policy->related_cpus);
+		cpufreq_cpu_put(policy);
+		cpufreq_update_policy(cpu);
+	}
+	put_online_cpus();
+}
+
+static int nvpmodel_apply_clk_caps(struct nvpmodel_profile *profile)
+{
+	int i, ret;
+
+	if (profile->emc_iso_cap) {
+		ret = tegra_bwmgr_set_emc(bwmgr_handle, profile->emc_iso_cap,
+					TEGRA_BWMGR_SET_EMC_ISO_CAP);
+		if (ret) {
+			pr_warn("Nvpmodel failed to set EMC hz=%lu errno=%d\n",
+				profile->emc_iso_cap, ret);
+			return ret;
+		}
+		emc_iso_cap = profile->emc_iso_cap;
+	}
+
+	for (i = 0; i < num_clocks; i++) {
+		if (!clks[i].clk || !profile->clk_caps[i])
+			continue;
+		ret = clk_set_max_rate(clks[i].clk, profile->clk_caps[i]);
+		if (ret) {
+			pr_err("setting %s cap failed: %d\n",
+				clks[i].attr.attr.name, ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Switch to a profile in one pass. When the EMC cap goes down the CPU
+ * caps go first so cores never run ahead of the memory they will get,
+ * when it goes up EMC and the other clocks are raised first.
+ */
+static int nvpmodel_set_profile(struct nvpmodel_profile *profile)
+{
+	struct nvpmodel_profile *prev;
+	bool emc_up;
+	ktime_t start;
+	int ret;
+
+	mutex_lock(&profile_lock);
+	start = ktime_get();
+	prev = cur_profile;
+	emc_up = profile->emc_iso_cap &&
+		(!emc_iso_cap || profile->emc_iso_cap > emc_iso_cap);
+
+	if (emc_up) {
+		ret = nvpmodel_apply_clk_caps(profile);
+		if (ret)
+			goto out;
+		WRITE_ONCE(cur_profile, profile);
+		nvpmodel_apply_cpu_caps();
+	} else {
+		WRITE_ONCE(cur_profile, profile);
+		nvpmodel_apply_cpu_caps();
+		ret = nvpmodel_apply_clk_caps(profile);
+	}
+
+	profile_transition_us = ktime_us_delta(ktime_get(), start);
+	pr_info("nvpmodel: %s -> %s in %lld us%s\n",
+		prev ? prev->name : "none", profile->name,
+		profile_transition_us, ret ? " (incomplete)" : "");
+out:
+	mutex_unlock(&profile_lock);
+	return ret;
+}
+
+static ssize_t profile_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	struct nvpmodel_profile *profile = READ_ONCE(cur_profile);
+
+	return sprintf(buf, "%s\n", profile ? profile->name : "none");
+}
+
+static ssize_t profile_store(struct kobject *kobj,
+			     struct kobj_attribute *attr, const char *buf,
+			     size_t count)
+{
+	int i, ret;
+
+	for (i = 0; i < num_profiles; i++)
+		if (sysfs_streq(buf, profiles[i].name))
+			break;
+	if (i == num_profiles)
+		return -EINVAL;
+
+	ret = nvpmodel_set_profile(&profiles[i]);
+
+	return ret ? ret : count;
+}
+
+static ssize_t profiles_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	for (i = 0; i < num_profiles; i++)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s%s",
+				 i ? " " : "", profiles[i].name);
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+
+static ssize_t profile_transition_us_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lld\n", profile_transition_us);
+}
+
+static struct kobj_attribute profile_attribute =
+	__ATTR(profile, 0660, profile_show, profile_store);
+static struct kobj_attribute profiles_attribute =
+	__ATTR(profiles, 0440, profiles_show, NULL);
+static struct kobj_attribute profile_transition_us_attribute =
+	__ATTR(profile_transition_us, 0440, profile_transition_us_show, NULL);
+
+static struct attribute *profile_attrs[] = {
+	&profile_attribute.attr,
+	&profiles_attribute.attr,
+	&profile_transition_us_attribute.attr,
+	NULL,
+};
+
+static const struct attribute_group profile_attr_group = {
+	.attrs = profile_attrs,
+};
+
+static int nvpmodel_parse_profile(struct device_node *np,
+				  struct nvpmodel_profile *profile)
+{
+	u64 emc;
+	int n;
+
+	if (of_property_read_string(np, "nvidia,profile-name", &profile->name))
+		profile->name = np->name;
+
+	if (!of_property_read_u64(np, "nvidia,emc-iso-cap", &emc))
+		profile->emc_iso_cap = emc;
+
+	if (num_clocks) {
+		profile->clk_caps = kcalloc(num_clocks,
+				sizeof(*profile->clk_caps), GFP_KERNEL);
+		if (!profile->clk_caps)
+			return -ENOMEM;
+		n = of_property_count_u64_elems(np, "nvidia,clock-caps");
+		if (n > 0)
+			of_property_read_u64_array(np, "nvidia,clock-caps",
+				profile->clk_caps, min(n, num_clocks));
+	}
+
+	n = of_property_count_u32_elems(np, "nvidia,cpu-cluster-caps");
+	if (n > 0)
+		of_property_read_u32_array(np, "nvidia,cpu-cluster-caps",
+			profile->cpu_caps, min(n, NVPMODEL_MAX_CLUSTERS));
+
+	return 0;
+}
+
+static int nvpmodel_profiles_init(struct device_node *dn)
+{
+	struct device_node *np;
+	bool cpu_caps = false;
+	int i = 0, j, ret;
+
+	for_each_child_of_node(dn, np)
+		if (of_node_cmp(np->name, "profile") == 0)
+			num_profiles++;
+	if (!num_profiles)
+		return 0;
+
+	profiles = kcalloc(num_profiles, sizeof(*profiles), GFP_KERNEL);
+	if (!profiles) {
+		num_profiles = 0;
+		return -ENOMEM;
+	}
+
+	for_each_child_of_node(dn, np) {
+		if (of_node_cmp(np->name, "profile"))
+			continue;
+		ret = nvpmodel_parse_profile(np, &profiles[i]);
+		if (ret) {
+			of_node_put(np);
+			return ret;
+		}
+		for (j = 0; j < NVPMODEL_MAX_CLUSTERS; j++)
+			cpu_caps |= !!profiles[i].cpu_caps[j];
+		i++;
+	}
+
+	if (cpu_caps) {
+		ret = cpufreq_register_notifier(&nvpmodel_cpufreq_nb,
+						CPUFREQ_POLICY_NOTIFIER);
+		if (ret) {
+			pr_err("nvpmodel: cpufreq notifier failed: %d\n", ret);
+			return ret;
+		}
+		cpufreq_nb_registered = true;
+	}
+
+	return sysfs_create_group(clk_cap_kobject, &profile_attr_group);
+}
+
 static void free_resources(void)
 {
 	int i;
 
+	if (cpufreq_nb_registered) {
+		cpufreq_unregister_notifier(&nvpmodel_cpufreq_nb,
+					    CPUFREQ_POLICY_NOTIFIER);
+		cur_profile = NULL;
+		nvpmodel_apply_cpu_caps(); /* drop the caps */
+		cpufreq_nb_registered = false;
+	}
+	if (profiles) {
+		for (i = 0; i < num_profiles; i++)
+			kfree(profiles[i].clk_caps);
+		kfree(profiles);
+		profiles = NULL;
+		num_profiles = 0;
+	}
+
 	if (clks) {
 		for (i = 0; i < num_clocks; i++) {
 			if (clks[i].attr.attr.name)
@@ -179,7 +474,7 @@ static int __init nvpmodel_clk_cap_init(void)
 	num_clocks = of_property_count_strings(dn, "clock-names");
 	if (num_clocks <= 0) {
 		num_clocks = 0;
-		goto exit;
+		goto profiles;
 	}
 
 	clks = kzalloc(sizeof(*clks) * num_clocks, GFP_KERNEL);
@@ -222,6 +517,10 @@ static int __init nvpmodel_clk_cap_init(void)
 			continue;
 		}
 	}
+profiles:
+	error = nvpmodel_profiles_init(dn);
+	if (error)
+		pr_err("nvpmodel: failed to set up profiles: %d\n", error);
 exit:
 	if (error) {
 		free_resources();
@@ -35,6 +35,8 @@
 #include <soc/tegra/tegra_bpmp.h>
 #include <linux/pci.h>
 #include <linux/kfifo.h>
+#include <linux/tegra-pcie-edma.h>
+#include <linux/tegra-vnet.h>
 
 #define CTRL_0	(0)
 #define CTRL_1	(1)
@@ -58,6 +60,7 @@
 #define APPL_INTR_EN_L0_0_SYS_INTR_EN		BIT(30)
 #define APPL_INTR_EN_L0_0_PEX_RST_INT_EN		BIT(16)
 #define APPL_INTR_EN_L0_0_PCI_CMD_EN_INT_EN	BIT(15)
+#define APPL_INTR_EN_L0_0_INT_INT_EN		BIT(8)
 #define APPL_INTR_EN_L0_0_ERROR_INT_EN		BIT(1)
 #define APPL_INTR_EN_L0_0_LINK_STATE_INT_EN	BIT(0)
 
@@ -65,6 +68,7 @@
 #define APPL_INTR_STATUS_L0_PEX_RST_INT_SHIFT	16
 #define APPL_INTR_STATUS_L0_PEX_RST_INT		BIT(16)
 #define APPL_INTR_STATUS_L0_PCI_CMD_EN_INT	BIT(15)
+#define APPL_INTR_STATUS_L0_INT_INT		BIT(8)
 #define APPL_INTR_STATUS_L0_LINK_STATE_INT	BIT(0)
 
 #define APPL_INTR_EN_L1_0			0x1C
@@ -80,7 +84,10 @@
 #define APPL_INTR_STATUS_L1_3			0x34
 #define APPL_INTR_STATUS_L1_6			0x3C
 #define APPL_INTR_STATUS_L1_7			0x40
+#define APPL_INTR_EN_L1_8			0x44
+#define APPL_INTR_EN_L1_8_EDMA_INT_EN		BIT(6)
 #define APPL_INTR_STATUS_L1_8			0x4C
+#define APPL_INTR_STATUS_L1_8_EDMA_INT_MASK	0xFC0
 #define APPL_INTR_STATUS_L1_9			0x54
 #define APPL_INTR_STATUS_L1_10			0x58
 #define APPL_INTR_STATUS_L1_11			0x64
@@ -129,6 +136,9 @@
 
 #define CFG_LINK_STATUS_CONTROL	0x80
 
+/* eDMA registers within the iATU_DMA space */
+#define EDMA_REGS_OFFSET		0x20000
+
 #define CAP_SPCIE_CAP_OFF	0x154
 #define CAP_SPCIE_CAP_OFF_DSP_TX_PRESET0_MASK	GENMASK(3, 0)
 
@@ -324,6 +334,8 @@ struct tegra_pcie_dw_ep {
 	struct dentry *debugfs;
 
 	struct tegra_bwmgr_client *emc_bw;
+	struct tegra_pcie_edma *edma;
+	struct tegra_vnet_ep *vnet;
 	u32 dvfs_tbl[4][4]; /* for x1/x2/x3/x4 and Gen-1/2/3/4 */
 
 	u32 num_lanes;
@@ -418,6 +430,10 @@ static irqreturn_t tegra_pcie_irq_handler(int irq, void *arg)
 			}
 			wake_up(&pcie->wq);
 		}
+	} else if (val & APPL_INTR_STATUS_L0_INT_INT) {
+		val = readl(pcie->appl_base + APPL_INTR_STATUS_L1_8);
+		if (val & APPL_INTR_STATUS_L1_8_EDMA_INT_MASK)
+			tegra_pcie_edma_irq(pcie->edma);
 	} else {
 		dev_info(pcie->dev, "Random interrupt (STATUS = 0x%08X)\n",
 			 val);
@@ -646,6 +662,16 @@ static void pex_ep_event_pex_rst_deassert(struct tegra_pcie_dw_ep *pcie)
 	val |= APPL_INTR_EN_L1_0_HOT_RESET_DONE_INT_EN;
 	writel(val, pcie->appl_base + APPL_INTR_EN_L1_0);
 
+	if (pcie->edma) {
+		val = readl(pcie->appl_base + APPL_INTR_EN_L0_0);
+		val |= APPL_INTR_EN_L0_0_INT_INT_EN;
+		writel(val, pcie->appl_base + APPL_INTR_EN_L0_0);
+
+		val = readl(pcie->appl_base + APPL_INTR_EN_L1_8);
+		val |= APPL_INTR_EN_L1_8_EDMA_INT_EN;
+		writel(val, pcie->appl_base + APPL_INTR_EN_L1_8);
+	}
+
 	reset_control_assert(pcie->core_rst);
 	reset_control_deassert(pcie->core_rst);
 
@@ -763,6 +789,8 @@ static void pex_ep_event_pex_rst_deassert(struct tegra_pcie_dw_ep *pcie)
 	val = readl(pcie->appl_base + APPL_CTRL);
 	val |= APPL_CTRL_LTSSM_EN;
 	writel(val, pcie->appl_base + APPL_CTRL);
+
+	tegra_pcie_edma_online(pcie->edma);
 }
 
 static void pex_ep_event_hot_rst_done(struct tegra_pcie_dw_ep *pcie)
@@ -1553,12 +1581,34 @@ static int tegra_pcie_dw_ep_probe(struct platform_device *pdev)
 		goto fail_alloc;
 	}
 
+	/* Brought online once the host releases PERST */
+	pcie->edma = tegra_pcie_edma_register(pcie->dev, pcie->atu_dma_base +
+					      EDMA_REGS_OFFSET);
+	if (IS_ERR(pcie->edma))
+		pcie->edma = NULL;
+
+	if (pcie->edma && of_property_read_bool(np, "nvidia,vnet")) {
+		struct tegra_vnet_ep_info info = {
+			.dev = pcie->dev,
+			.bar_virt = pcie->cpu_virt,
+			.bar_size = pcie->bar0_size,
+			.dbi_base = pcie->dbi_base,
+		};
+
+		pcie->vnet = tegra_vnet_ep_register(&info);
+		if (IS_ERR(pcie->vnet)) {
+			dev_err(pcie->dev, "vnet registration failed: %ld\n",
+				PTR_ERR(pcie->vnet));
+			pcie->vnet = NULL;
+		}
+	}
+
 	pcie->pcie_ep_task = kthread_run(pcie_ep_work_thread, (void *)pcie,
 					 "pcie_ep_work");
 	if (IS_ERR(pcie->pcie_ep_task)) {
 		dev_err(pcie->dev, "failed to create pcie_ep_work thread\n");
 		ret = PTR_ERR(pcie->pcie_ep_task);
-		goto fail_bwmgr;
+		goto fail_edma;
 	}
 
 	pcie->core_rst = devm_reset_control_get(pcie->dev, "core_rst");
@@ -1628,7 +1678,10 @@ static int tegra_pcie_dw_ep_probe(struct platform_device *pdev)
 
 fail_thread:
 	kthread_stop(pcie->pcie_ep_task);
-fail_bwmgr:
+fail_edma:
+	if (pcie->vnet)
+		tegra_vnet_ep_unregister(pcie->vnet);
+	tegra_pcie_edma_unregister(pcie->edma);
 	tegra_bwmgr_unregister(pcie->emc_bw);
 fail_alloc:
 	dma_free_coherent(pcie->dev, pcie->bar0_size, pcie->cpu_virt,
@@ -1654,6 +1707,10 @@ static int tegra_pcie_dw_ep_remove(struct platform_device *pdev)
 		dev_err(pcie->dev, "EVENT: fifo is full\n");
 	kthread_stop(pcie->pcie_ep_task);
 
+	if (pcie->vnet)
+		tegra_vnet_ep_unregister(pcie->vnet);
+	tegra_pcie_edma_unregister(pcie->edma);
+
 	tegra_bwmgr_unregister(pcie->emc_bw);
 
 	dma_free_coherent(pcie->dev, pcie->bar0_size, pcie->cpu_virt,
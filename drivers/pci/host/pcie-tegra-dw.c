@@ -35,6 +35,7 @@
 #include <soc/tegra/bpmp_abi.h>
 #include <soc/tegra/tegra_bpmp.h>
 #include <linux/random.h>
+#include <linux/tegra-pcie-edma.h>
 
 #include "pcie-designware.h"
 
@@ -126,6 +127,7 @@
 #define APPL_DEBUG_LTSSM_STATE_MASK		GENMASK(8, 3)
 #define APPL_DEBUG_LTSSM_STATE_SHIFT		3
 #define LTSSM_STATE_PRE_DETECT			5
+#define LTSSM_STATE_L1_IDLE			0x14
 
 #define APPL_RADM_STATUS			0xE4
 #define APPL_PM_XMT_TURNOFF_STATE		BIT(0)
@@ -214,6 +216,8 @@
 #define EVENT_COUNTER_ALL_CLEAR		0x3
 #define EVENT_COUNTER_ENABLE_ALL	0x7
 #define EVENT_COUNTER_ENABLE_SHIFT	2
+#define EVENT_COUNTER_LANE_SEL_MASK	0xF
+#define EVENT_COUNTER_LANE_SEL_SHIFT	8
 #define EVENT_COUNTER_EVENT_SEL_MASK	0xFF
 #define EVENT_COUNTER_EVENT_SEL_SHIFT	16
 #define EVENT_COUNTER_EVENT_Tx_L0S	0x2
@@ -221,11 +225,24 @@
 #define EVENT_COUNTER_EVENT_L1		0x5
 #define EVENT_COUNTER_EVENT_L1_1	0x7
 #define EVENT_COUNTER_EVENT_L1_2	0x8
+#define EVENT_COUNTER_GROUP_SEL_MASK	0xF
 #define EVENT_COUNTER_GROUP_SEL_SHIFT	24
+#define EVENT_COUNTER_GROUP_1		0x1
+#define EVENT_COUNTER_GROUP_2		0x2
+#define EVENT_COUNTER_GROUP_3		0x3
 #define EVENT_COUNTER_GROUP_5		0x5
+#define EVENT_COUNTER_GROUP_6		0x6
+#define EVENT_COUNTER_GROUP_7		0x7
 
 #define EVENT_COUNTER_DATA_REG		0x16C
 
+#define PCIE_L1SS_CTL1			0x08
+#define PCIE_L1SS_CTL1_ASPM_L12		BIT(2)
+#define PCIE_L1SS_CTL2			0x0C
+#define PCIE_L1SS_CTL2_T_PWR_ON_SCALE	GENMASK(1, 0)
+#define PCIE_L1SS_CTL2_T_PWR_ON_VALUE	GENMASK(7, 3)
+#define PCIE_L1SS_CTL2_T_PWR_ON_SHIFT	3
+
 #define MARGIN_PORT_CAP_STATUS_REG_MARGINING_READY     BIT(16)
 #define MARGIN_PORT_CAP_STATUS_REG_MARGINING_SW_READY  BIT(17)
 
@@ -257,6 +274,8 @@
 #define PORT_LOGIC_GEN2_CTRL_FAST_TRAINING_SEQ_VAL	52
 
 #define PORT_LOGIC_MSI_CTRL_INT_0_EN	0x828
+#define PORT_LOGIC_MSI_CTRL_INT_0_STATUS	0x830
+#define PORT_LOGIC_MSI_CTRL_INT_STRIDE	0xC
 
 #define GEN3_EQ_CONTROL_OFF	0x8a8
 #define GEN3_EQ_CONTROL_OFF_PSET_REQ_VEC_SHIFT	8
@@ -313,6 +332,9 @@
 #define DMA_RD_CHNL_NUM			2
 #define DMA_WR_CHNL_NUM			4
 
+/* eDMA registers within the iATU_DMA space */
+#define EDMA_REGS_OFFSET		0x20000
+
 #define LINK_RETRAIN_TIMEOUT HZ
 
 /* DMA Common Registers */
@@ -433,6 +455,120 @@ struct margin_cmd {
 	int rxm_cmd_check;
 };
 
+/*
+ * Traffic driven link power policy. The controller has no utilisation
+ * counter, so the L1 entry rate and the LTSSM state sampled once per window
+ * stand in for one: a link entering L1 thousands of times a second is busy
+ * and pays the exit latency on every burst, a link found in L1 window after
+ * window is idle.
+ */
+enum tegra_pcie_lp_level {
+	LP_LEVEL_PERF,		/* ASPM L1 off */
+	LP_LEVEL_L1,		/* L1 as configured, L1.2 off */
+	LP_LEVEL_NOMINAL,	/* ASPM as configured */
+	LP_LEVEL_POWERSAVE,	/* ASPM as configured, link at Gen-1 */
+	LP_LEVEL_MAX,
+};
+
+struct tegra_pcie_lp {
+	/* serialises link reconfiguration */
+	struct mutex lock;
+	struct delayed_work work;
+	struct pci_dev *dev[2];		/* root port, then endpoint */
+	int l1ss[2];			/* L1SS capability offsets */
+	u16 lnkctl[2];			/* ASPM as configured */
+	u32 l1ss_ctl1[2];
+	u32 l1_exit[2];			/* LnkCap L1 exit latency encoding */
+	u32 t_power_on;			/* us */
+
+	bool enable;
+	u32 period_ms;
+	u32 busy_rate;			/* L1 entries/s */
+	u32 idle_rate;
+	u32 idle_windows;
+	u32 hold_windows;
+
+	enum tegra_pcie_lp_level level;
+	u32 nominal_speed;
+	u32 windows;
+	u32 last_l1;
+	u32 l1_rate;
+	unsigned long sampled;
+	unsigned long since;
+	u32 transitions[LP_LEVEL_MAX];
+	u64 level_ms[LP_LEVEL_MAX];
+	u32 retrain_us;
+	u32 retrain_fail;
+};
+
+/* RAS DES event counters sampled continuously into 64-bit totals */
+struct tegra_pcie_cntr_desc {
+	const char *name;
+	u8 group;
+	u8 event;
+};
+
+static const struct tegra_pcie_cntr_desc tegra_pcie_cntrs[] = {
+	/* LTSSM */
+	{ "l0_to_recovery",	EVENT_COUNTER_GROUP_5, 0x00 },
+	{ "l1_to_recovery",	EVENT_COUNTER_GROUP_5, 0x01 },
+	{ "speed_change",	EVENT_COUNTER_GROUP_5, 0x0C },
+	{ "width_change",	EVENT_COUNTER_GROUP_5, 0x0D },
+	/* physical layer, summed over the lanes */
+	{ "receiver_err",	EVENT_COUNTER_GROUP_1, 0x06 },
+	{ "rx_recovery_req",	EVENT_COUNTER_GROUP_1, 0x07 },
+	/* data link layer */
+	{ "bad_tlp",		EVENT_COUNTER_GROUP_2, 0x00 },
+	{ "lcrc_err",		EVENT_COUNTER_GROUP_2, 0x01 },
+	{ "bad_dllp",		EVENT_COUNTER_GROUP_2, 0x02 },
+	{ "replay_num_rollover", EVENT_COUNTER_GROUP_2, 0x03 },
+	{ "replay_timeout",	EVENT_COUNTER_GROUP_2, 0x04 },
+	{ "rx_nak_dllp",	EVENT_COUNTER_GROUP_2, 0x05 },
+	{ "tx_nak_dllp",	EVENT_COUNTER_GROUP_2, 0x06 },
+	{ "retry_tlp",		EVENT_COUNTER_GROUP_2, 0x07 },
+	/* transaction layer errors */
+	{ "fc_timeout",		EVENT_COUNTER_GROUP_3, 0x00 },
+	{ "poisoned_tlp",	EVENT_COUNTER_GROUP_3, 0x01 },
+	{ "ecrc_err",		EVENT_COUNTER_GROUP_3, 0x02 },
+	{ "unsupported_req",	EVENT_COUNTER_GROUP_3, 0x03 },
+	{ "completer_abort",	EVENT_COUNTER_GROUP_3, 0x04 },
+	{ "completion_timeout",	EVENT_COUNTER_GROUP_3, 0x05 },
+	/* flow control and acknowledgement DLLPs */
+	{ "tx_ack_dllp",	EVENT_COUNTER_GROUP_6, 0x00 },
+	{ "tx_update_fc_dllp",	EVENT_COUNTER_GROUP_6, 0x01 },
+	{ "rx_ack_dllp",	EVENT_COUNTER_GROUP_6, 0x02 },
+	{ "rx_update_fc_dllp",	EVENT_COUNTER_GROUP_6, 0x03 },
+	{ "rx_nullified_tlp",	EVENT_COUNTER_GROUP_6, 0x04 },
+	{ "tx_nullified_tlp",	EVENT_COUNTER_GROUP_6, 0x05 },
+	{ "rx_duplicate_tlp",	EVENT_COUNTER_GROUP_6, 0x06 },
+	/* TLP traffic */
+	{ "tx_mem_wr",		EVENT_COUNTER_GROUP_7, 0x00 },
+	{ "tx_mem_rd",		EVENT_COUNTER_GROUP_7, 0x01 },
+	{ "tx_cpl",		EVENT_COUNTER_GROUP_7, 0x06 },
+	{ "tx_cpl_data",	EVENT_COUNTER_GROUP_7, 0x07 },
+	{ "tx_msg",		EVENT_COUNTER_GROUP_7, 0x08 },
+	{ "rx_mem_wr",		EVENT_COUNTER_GROUP_7, 0x0B },
+	{ "rx_mem_rd",		EVENT_COUNTER_GROUP_7, 0x0C },
+	{ "rx_cpl",		EVENT_COUNTER_GROUP_7, 0x11 },
+	{ "rx_cpl_data",	EVENT_COUNTER_GROUP_7, 0x12 },
+	{ "rx_msg",		EVENT_COUNTER_GROUP_7, 0x13 },
+};
+
+#define TEGRA_PCIE_CNTR_NUM	ARRAY_SIZE(tegra_pcie_cntrs)
+#define TEGRA_PCIE_MAX_LANES	16
+
+struct tegra_pcie_cntr {
+	/* totals and hardware baselines */
+	struct mutex lock;
+	struct delayed_work work;
+	bool running;
+	u32 period_ms;
+	unsigned long sampled;
+	u32 last[TEGRA_PCIE_CNTR_NUM][TEGRA_PCIE_MAX_LANES];
+	u64 total[TEGRA_PCIE_CNTR_NUM];
+	u32 rate[TEGRA_PCIE_CNTR_NUM];
+};
+
 struct tegra_pcie_dw {
 	struct device *dev;
 	struct resource	*dbi_res;
@@ -459,6 +595,7 @@ struct tegra_pcie_dw {
 	u8 init_link_width;
 
 	struct tegra_bwmgr_client *emc_bw;
+	struct tegra_pcie_edma *edma;
 
 #ifdef CONFIG_PCIE_TEGRA_DW_DMA_TEST
 	/* DMA operation */
@@ -487,6 +624,9 @@ struct tegra_pcie_dw {
 	u32 cap_pl16g_cap_off;
 	u32 event_cntr_ctrl;
 	u32 event_cntr_data;
+	/* event counter select and data are accessed as a pair */
+	spinlock_t event_cntr_lock;
+	struct tegra_pcie_cntr cntr;
 	u32 dl_feature_cap;
 	u32 margin_port_cap;
 	u32 margin_lane_cntrl;
@@ -496,7 +636,10 @@ struct tegra_pcie_dw {
 	u32 init_speed;
 	bool cdm_check;
 	u32 cid;
-	u32 msi_ctrl_int;
+	u32 msi_ctrl_int[MAX_MSI_CTRLS];
+	/* MSI groups of 32 vectors with a parent interrupt of their own */
+	int msi_grp_irq[MAX_MSI_CTRLS];
+	unsigned long msi_grp_own;
 	int pex_wake;
 	u32 tsa_config_addr;
 	bool link_state;
@@ -507,6 +650,7 @@ struct tegra_pcie_dw {
 	struct regulator *pex_ctl_reg;
 	struct margin_cmd mcmd;
 	u32 dvfs_tbl[4][4]; /* for x1/x2/x3/x4 and Gen-1/2/3/4 */
+	struct tegra_pcie_lp lp;
 };
 
 struct dma_tx {
@@ -691,6 +835,8 @@ static irqreturn_t tegra_pcie_irq_handler(int irq, void *arg)
 			}
 		}
 #endif
+		if (val & APPL_INTR_STATUS_L1_8_0_EDMA_INT_MASK)
+			tegra_pcie_edma_irq(pcie->edma);
 		if (val & APPL_INTR_STATUS_L1_8_0_AUTO_BW_INT_STS) {
 			writel(APPL_INTR_STATUS_L1_8_0_AUTO_BW_INT_STS,
 			       pcie->appl_base + APPL_INTR_STATUS_L1_8_0);
@@ -779,11 +925,103 @@ static int uphy_bpmp_pcie_controller_state_set(int controller, int enable)
 	return bpmp_send_uphy_message(&req, sizeof(req), &resp, sizeof(resp));
 }
 
+static irqreturn_t tegra_pcie_msi_grp_demux(struct pcie_port *pp,
+					    unsigned int grp)
+{
+	void __iomem *status = pp->dbi_base +
+			       PORT_LOGIC_MSI_CTRL_INT_0_STATUS +
+			       grp * PORT_LOGIC_MSI_CTRL_INT_STRIDE;
+	unsigned long val;
+	u32 pending;
+	int pos;
+
+	dw_pcie_cfg_read(status, 4, &pending);
+	if (!pending)
+		return IRQ_NONE;
+
+	val = pending;
+	for_each_set_bit(pos, &val, 32) {
+		dw_pcie_cfg_write(status, 4, BIT(pos));
+		generic_handle_irq(irq_find_mapping(pp->irq_domain,
+						    grp * 32 + pos));
+	}
+
+	return IRQ_HANDLED;
+}
+
 static irqreturn_t tegra_pcie_msi_irq_handler(int irq, void *arg)
 {
 	struct pcie_port *pp = arg;
+	struct tegra_pcie_dw *pcie = to_tegra_pcie(pp);
+	irqreturn_t ret = IRQ_NONE;
+	unsigned int grp;
 
-	return dw_handle_msi_irq(pp);
+	if (!pcie->msi_grp_own)
+		return dw_handle_msi_irq(pp);
+
+	for (grp = 0; grp < MAX_MSI_CTRLS; grp++)
+		if (!test_bit(grp, &pcie->msi_grp_own))
+			ret |= tegra_pcie_msi_grp_demux(pp, grp);
+
+	return ret;
+}
+
+static irqreturn_t tegra_pcie_msi_grp_irq_handler(int irq, void *arg)
+{
+	struct tegra_pcie_dw *pcie = arg;
+	unsigned int grp;
+
+	for (grp = 1; grp < MAX_MSI_CTRLS; grp++)
+		if (pcie->msi_grp_irq[grp] == irq)
+			return tegra_pcie_msi_grp_demux(&pcie->pp, grp);
+
+	return IRQ_NONE;
+}
+
+/*
+ * Groups 1 and up may be wired to interrupts of their own, "msi1" and so
+ * on; anything without one stays on "msi". Each group line starts on a
+ * different CPU and can be moved through /proc/irq like any other.
+ */
+static void tegra_pcie_request_msi_groups(struct tegra_pcie_dw *pcie,
+					  struct platform_device *pdev)
+{
+	unsigned int grp, cpu;
+	char *name;
+	int irq, ret;
+
+	for (grp = 1; grp < MAX_MSI_CTRLS; grp++) {
+		name = devm_kasprintf(pcie->dev, GFP_KERNEL, "msi%u", grp);
+		if (!name)
+			return;
+
+		irq = platform_get_irq_byname(pdev, name);
+		if (irq <= 0)
+			continue;
+
+		ret = devm_request_irq(pcie->dev, irq,
+				       tegra_pcie_msi_grp_irq_handler,
+				       IRQF_NO_THREAD, name, pcie);
+		if (ret) {
+			dev_err(pcie->dev, "failed to request \"%s\" irq\n",
+				name);
+			continue;
+		}
+
+		pcie->msi_grp_irq[grp] = irq;
+		set_bit(grp, &pcie->msi_grp_own);
+
+		cpu = cpumask_local_spread(grp, dev_to_node(pcie->dev));
+		irq_set_affinity_hint(irq, cpumask_of(cpu));
+	}
+}
+
+static void tegra_pcie_free_msi_groups(struct tegra_pcie_dw *pcie)
+{
+	unsigned int grp;
+
+	for_each_set_bit(grp, &pcie->msi_grp_own, MAX_MSI_CTRLS)
+		irq_set_affinity_hint(pcie->msi_grp_irq[grp], NULL);
 }
 
 static inline void prog_atu(struct pcie_port *pp, int i, u32 val, u32 reg)
@@ -1344,25 +1582,36 @@ static void config_plat_gpio(struct tegra_pcie_dw *pcie, bool flag)
 		gpiod_set_value(gpio_to_desc(pcie->gpios[count]), flag);
 }
 
-static int apply_speed_change(struct seq_file *s, void *data)
+/* Make EMC FLOOR and core clock requests based on link width and speed */
+static void tegra_pcie_dw_set_clocks(struct tegra_pcie_dw *pcie, u32 speed)
 {
-	struct tegra_pcie_dw *pcie = (struct tegra_pcie_dw *)(s->private);
-	unsigned long start_jiffies;
-	u32 val = 0;
+	u32 width, data;
+	unsigned long freq;
 
-	if (pcie->target_speed > (PCI_EXP_LNKSTA_CLS_8_0GB + 1)) {
-		seq_puts(s, "Invalid target speed. Should be 1 ~ 4\n");
-		return 0;
-	}
+	data = readl(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL);
+	width = ((data >> 16) & PCI_EXP_LNKSTA_NLW) >> 4;
+	width = find_first_bit((const unsigned long *)&width,
+			       sizeof(width));
+	freq = pcie->dvfs_tbl[width][speed - 1];
+	dev_dbg(pcie->dev, "EMC Freq requested = %lu\n", freq);
 
-	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL, 4,
-			 &val);
-	if (((val >> 16) & PCI_EXP_LNKSTA_CLS) == pcie->target_speed) {
-		seq_puts(s, "Link speed is already the target speed...!\n");
-		return 0;
-	}
+	if (tegra_bwmgr_set_emc(pcie->emc_bw, freq, TEGRA_BWMGR_SET_EMC_FLOOR))
+		dev_err(pcie->dev, "can't set emc clock[%lu]\n", freq);
+
+	clk_set_rate(pcie->core_clk, pcie_gen_freq[speed - 1]);
+}
 
-	if (!tegra_platform_is_fpga() && (pcie->target_speed == 4)) {
+/*
+ * Retrain the link to target @speed. Returns the speed the link settled
+ * at, -EAGAIN if Gen-4 equalization isn't done yet or -ETIMEDOUT if the
+ * previous link training never completed.
+ */
+static int tegra_pcie_dw_set_link_speed(struct tegra_pcie_dw *pcie, u32 speed)
+{
+	unsigned long start_jiffies;
+	u32 val = 0;
+
+	if (!tegra_platform_is_fpga() && (speed == 4)) {
 		u32 temp1 = 0, temp2 = 0;
 
 		dw_pcie_cfg_read(pcie->pp.dbi_base + pcie->cap_pl16g_status,
@@ -1375,16 +1624,14 @@ static int apply_speed_change(struct seq_file *s, void *data)
 		if (!((val & CAP_PL16G_STATUS_REG_EQ_16G_CPL) ||
 		      (((temp1 & (PCI_EXP_LNKSTA_CLS << 16)) ==
 			 (PCI_EXP_LNKSTA_CLS_8_0GB << 16)) &&
-			 temp2 & CFG_LINK_STATUS_CONTROL_2_PCIE_CAP_EQ_CPL))) {
-			seq_puts(s, "Gen-3/4 Equalization is not complete\n");
-			return 0;
-		}
+			 temp2 & CFG_LINK_STATUS_CONTROL_2_PCIE_CAP_EQ_CPL)))
+			return -EAGAIN;
 	}
 
 	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL_2, 4,
 			 &val);
 	val &= ~PCI_EXP_LNKSTA_CLS;
-	val |= pcie->target_speed;
+	val |= speed;
 	dw_pcie_cfg_write(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL_2, 4,
 			  val);
 
@@ -1397,15 +1644,13 @@ static int apply_speed_change(struct seq_file *s, void *data)
 			break;
 		if (time_after(jiffies, start_jiffies +
 		    msecs_to_jiffies(1000))) {
-			seq_puts(s, "Link Retrain Timeout\n");
+			dev_err(pcie->dev, "Link Retrain Timeout\n");
 			break;
 		}
 		usleep_range(1000, 1100);
 	}
-	if (val & CFG_LINK_STATUS_LT) {
-		seq_puts(s, "Previous link training didn't complete\n");
-		return 0;
-	}
+	if (val & CFG_LINK_STATUS_LT)
+		return -ETIMEDOUT;
 
 	/* Clear BW Management Status */
 	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL,
@@ -1429,7 +1674,8 @@ static int apply_speed_change(struct seq_file *s, void *data)
 			break;
 		if (time_after(jiffies, start_jiffies +
 		     msecs_to_jiffies(1000))) {
-			seq_puts(s, "Bandwidth Management Status Timeout\n");
+			dev_warn(pcie->dev,
+				 "Bandwidth Management Status Timeout\n");
 			break;
 		}
 		usleep_range(1000, 1100);
@@ -1440,12 +1686,40 @@ static int apply_speed_change(struct seq_file *s, void *data)
 
 	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL,
 			 4, &val);
+	return (val >> 16) & PCI_EXP_LNKSTA_CLS;
+}
+
+static int apply_speed_change(struct seq_file *s, void *data)
+{
+	struct tegra_pcie_dw *pcie = (struct tegra_pcie_dw *)(s->private);
+	u32 val = 0;
+	int ret;
+
+	if (pcie->target_speed > (PCI_EXP_LNKSTA_CLS_8_0GB + 1)) {
+		seq_puts(s, "Invalid target speed. Should be 1 ~ 4\n");
+		return 0;
+	}
+
+	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL, 4,
+			 &val);
 	if (((val >> 16) & PCI_EXP_LNKSTA_CLS) == pcie->target_speed) {
+		seq_puts(s, "Link speed is already the target speed...!\n");
+		return 0;
+	}
+
+	mutex_lock(&pcie->lp.lock);
+	ret = tegra_pcie_dw_set_link_speed(pcie, pcie->target_speed);
+	mutex_unlock(&pcie->lp.lock);
+
+	if (ret == -EAGAIN) {
+		seq_puts(s, "Gen-3/4 Equalization is not complete\n");
+	} else if (ret == -ETIMEDOUT) {
+		seq_puts(s, "Previous link training didn't complete\n");
+	} else if (ret == pcie->target_speed) {
 		seq_puts(s, "Link speed is successful...!\n");
 	} else {
 		seq_puts(s, "Link speed change failed...");
-		seq_printf(s, "Settled for Gen-%u\n", (val >> 16) &
-			   PCI_EXP_LNKSTA_CLS);
+		seq_printf(s, "Settled for Gen-%d\n", ret);
 	}
 
 	return 0;
@@ -1483,24 +1757,174 @@ static int apply_sbr(struct seq_file *s, void *data)
 	return 0;
 }
 
-static inline u32 event_counter_prog(struct tegra_pcie_dw *pcie, u32 event)
+static u32 event_counter_read(struct tegra_pcie_dw *pcie, u32 group,
+			      u32 event, u32 lane)
 {
 	u32 val = 0;
 
+	spin_lock(&pcie->event_cntr_lock);
 	dw_pcie_cfg_read(pcie->pp.dbi_base + pcie->event_cntr_ctrl, 4, &val);
 	val &= ~(EVENT_COUNTER_EVENT_SEL_MASK << EVENT_COUNTER_EVENT_SEL_SHIFT);
-	val |= EVENT_COUNTER_GROUP_5 << EVENT_COUNTER_GROUP_SEL_SHIFT;
+	val &= ~(EVENT_COUNTER_GROUP_SEL_MASK << EVENT_COUNTER_GROUP_SEL_SHIFT);
+	val &= ~(EVENT_COUNTER_LANE_SEL_MASK << EVENT_COUNTER_LANE_SEL_SHIFT);
+	val |= group << EVENT_COUNTER_GROUP_SEL_SHIFT;
 	val |= event << EVENT_COUNTER_EVENT_SEL_SHIFT;
+	val |= lane << EVENT_COUNTER_LANE_SEL_SHIFT;
 	val |= EVENT_COUNTER_ENABLE_ALL << EVENT_COUNTER_ENABLE_SHIFT;
 	dw_pcie_cfg_write(pcie->pp.dbi_base + pcie->event_cntr_ctrl, 4, val);
 	dw_pcie_cfg_read(pcie->pp.dbi_base + pcie->event_cntr_data, 4, &val);
+	spin_unlock(&pcie->event_cntr_lock);
+
 	return val;
 }
 
+static inline u32 event_counter_prog(struct tegra_pcie_dw *pcie, u32 event)
+{
+	return event_counter_read(pcie, EVENT_COUNTER_GROUP_5, event, 0);
+}
+
+static inline u32 tegra_pcie_cntr_lanes(struct tegra_pcie_dw *pcie,
+					const struct tegra_pcie_cntr_desc *d)
+{
+	if (d->group > EVENT_COUNTER_GROUP_1)
+		return 1;
+	return clamp_t(u32, pcie->num_lanes, 1, TEGRA_PCIE_MAX_LANES);
+}
+
+/*
+ * Fold what the hardware counted since the last sample into the totals.
+ * The counters are 32 bits wide, so the period has to be short enough for
+ * none of them to wrap twice in between. Called with cntr->lock held.
+ */
+static void tegra_pcie_cntr_sample(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_cntr *c = &pcie->cntr;
+	unsigned long now = jiffies;
+	u32 ms, lane, val, delta;
+	int i;
+
+	ms = max(jiffies_to_msecs(now - c->sampled), 1U);
+	for (i = 0; i < TEGRA_PCIE_CNTR_NUM; i++) {
+		const struct tegra_pcie_cntr_desc *d = &tegra_pcie_cntrs[i];
+
+		delta = 0;
+		for (lane = 0; lane < tegra_pcie_cntr_lanes(pcie, d); lane++) {
+			val = event_counter_read(pcie, d->group, d->event,
+						 lane);
+			delta += val - c->last[i][lane];
+			c->last[i][lane] = val;
+		}
+		c->total[i] += delta;
+		c->rate[i] = div_u64((u64)delta * 1000, ms);
+	}
+	c->sampled = now;
+}
+
+/* Take the current hardware values as the new baseline */
+static void tegra_pcie_cntr_rebase(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_cntr *c = &pcie->cntr;
+	u32 lane;
+	int i;
+
+	for (i = 0; i < TEGRA_PCIE_CNTR_NUM; i++) {
+		const struct tegra_pcie_cntr_desc *d = &tegra_pcie_cntrs[i];
+
+		for (lane = 0; lane < tegra_pcie_cntr_lanes(pcie, d); lane++)
+			c->last[i][lane] = event_counter_read(pcie, d->group,
+							      d->event, lane);
+	}
+	c->sampled = jiffies;
+}
+
+static void tegra_pcie_cntr_work(struct work_struct *work)
+{
+	struct tegra_pcie_cntr *c = container_of(to_delayed_work(work),
+						 struct tegra_pcie_cntr, work);
+	struct tegra_pcie_dw *pcie = container_of(c, struct tegra_pcie_dw,
+						  cntr);
+
+	mutex_lock(&c->lock);
+	tegra_pcie_cntr_sample(pcie);
+	mutex_unlock(&c->lock);
+
+	schedule_delayed_work(&c->work,
+			      msecs_to_jiffies(max(c->period_ms, 10U)));
+}
+
+static void tegra_pcie_cntr_start(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_cntr *c = &pcie->cntr;
+
+	mutex_lock(&c->lock);
+	if (!c->running) {
+		/* counters start over from zero after a controller reset */
+		tegra_pcie_cntr_rebase(pcie);
+		c->running = true;
+		schedule_delayed_work(&c->work,
+				      msecs_to_jiffies(max(c->period_ms, 10U)));
+	}
+	mutex_unlock(&c->lock);
+}
+
+static void tegra_pcie_cntr_stop(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_cntr *c = &pcie->cntr;
+
+	cancel_delayed_work_sync(&c->work);
+
+	mutex_lock(&c->lock);
+	if (c->running) {
+		tegra_pcie_cntr_sample(pcie);
+		c->running = false;
+	}
+	mutex_unlock(&c->lock);
+}
+
+static void tegra_pcie_cntr_clear_hw(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_cntr *c = &pcie->cntr;
+	u32 val;
+
+	mutex_lock(&c->lock);
+	if (c->running)
+		tegra_pcie_cntr_sample(pcie);
+
+	spin_lock(&pcie->event_cntr_lock);
+	/* Clear all counters */
+	dw_pcie_cfg_write(pcie->pp.dbi_base + pcie->event_cntr_ctrl, 4,
+			  EVENT_COUNTER_ALL_CLEAR);
+
+	/* Re-enable counting */
+	val = EVENT_COUNTER_ENABLE_ALL << EVENT_COUNTER_ENABLE_SHIFT;
+	val |= EVENT_COUNTER_GROUP_5 << EVENT_COUNTER_GROUP_SEL_SHIFT;
+	dw_pcie_cfg_write(pcie->pp.dbi_base + pcie->event_cntr_ctrl, 4, val);
+	spin_unlock(&pcie->event_cntr_lock);
+
+	memset(c->last, 0, sizeof(c->last));
+	mutex_unlock(&c->lock);
+}
+
+static int link_counters(struct seq_file *s, void *data)
+{
+	struct tegra_pcie_dw *pcie = (struct tegra_pcie_dw *)(s->private);
+	struct tegra_pcie_cntr *c = &pcie->cntr;
+	int i;
+
+	mutex_lock(&c->lock);
+	if (!c->running)
+		seq_puts(s, "Link is down, totals as of the last sample\n");
+	for (i = 0; i < TEGRA_PCIE_CNTR_NUM; i++)
+		seq_printf(s, "%-20s %20llu %12u/s\n", tegra_pcie_cntrs[i].name,
+			   c->total[i], c->rate[i]);
+	mutex_unlock(&c->lock);
+
+	return 0;
+}
+
 static int aspm_state_cnt(struct seq_file *s, void *data)
 {
 	struct tegra_pcie_dw *pcie = (struct tegra_pcie_dw *)(s->private);
-	u32 val = 0;
 
 	seq_printf(s, "Tx L0s entry count : %u\n",
 		   event_counter_prog(pcie, EVENT_COUNTER_EVENT_Tx_L0S));
@@ -1517,14 +1941,303 @@ static int aspm_state_cnt(struct seq_file *s, void *data)
 	seq_printf(s, "Link L1.2 entry count : %u\n",
 		   event_counter_prog(pcie, EVENT_COUNTER_EVENT_L1_2));
 
-	/* Clear all counters */
-	dw_pcie_cfg_write(pcie->pp.dbi_base + pcie->event_cntr_ctrl, 4,
-			  EVENT_COUNTER_ALL_CLEAR);
+	tegra_pcie_cntr_clear_hw(pcie);
 
-	/* Re-enable counting */
-	val = EVENT_COUNTER_ENABLE_ALL << EVENT_COUNTER_ENABLE_SHIFT;
-	val |= EVENT_COUNTER_GROUP_5 << EVENT_COUNTER_GROUP_SEL_SHIFT;
-	dw_pcie_cfg_write(pcie->pp.dbi_base + pcie->event_cntr_ctrl, 4, val);
+	return 0;
+}
+
+static const char * const tegra_pcie_lp_names[LP_LEVEL_MAX] = {
+	"perf", "l1", "nominal", "powersave",
+};
+
+static const char * const tegra_pcie_l1_exit[] = {
+	"<1us", "1-2us", "2-4us", "4-8us", "8-16us", "16-32us", "32-64us",
+	">64us",
+};
+
+static void tegra_pcie_lp_account(struct tegra_pcie_lp *lp)
+{
+	unsigned long now = jiffies;
+
+	lp->level_ms[lp->level] += jiffies_to_msecs(now - lp->since);
+	lp->since = now;
+}
+
+static void tegra_pcie_lp_save_aspm(struct tegra_pcie_lp *lp)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		pcie_capability_read_word(lp->dev[i], PCI_EXP_LNKCTL,
+					  &lp->lnkctl[i]);
+		if (lp->l1ss[i])
+			pci_read_config_dword(lp->dev[i],
+					      lp->l1ss[i] + PCIE_L1SS_CTL1,
+					      &lp->l1ss_ctl1[i]);
+	}
+}
+
+static void tegra_pcie_lp_set_l12(struct tegra_pcie_lp *lp, int i, bool on)
+{
+	u32 val;
+
+	if (!lp->l1ss[i])
+		return;
+	pci_read_config_dword(lp->dev[i], lp->l1ss[i] + PCIE_L1SS_CTL1, &val);
+	val &= ~PCIE_L1SS_CTL1_ASPM_L12;
+	if (on)
+		val |= lp->l1ss_ctl1[i] & PCIE_L1SS_CTL1_ASPM_L12;
+	pci_write_config_dword(lp->dev[i], lp->l1ss[i] + PCIE_L1SS_CTL1, val);
+}
+
+/*
+ * Only ever hand back what the ASPM core and the endpoint driver had
+ * enabled. L1 has to be off on both ends while the L1.2 enables change,
+ * and it is turned off downstream first and back on upstream first.
+ */
+static void tegra_pcie_lp_apply_aspm(struct tegra_pcie_lp *lp, bool l1,
+				     bool l12)
+{
+	int i;
+
+	for (i = 1; i >= 0; i--)
+		pcie_capability_clear_word(lp->dev[i], PCI_EXP_LNKCTL,
+					   PCI_EXP_LNKCTL_ASPM_L1);
+
+	if (l12) {
+		for (i = 0; i < 2; i++)
+			tegra_pcie_lp_set_l12(lp, i, true);
+	} else {
+		for (i = 1; i >= 0; i--)
+			tegra_pcie_lp_set_l12(lp, i, false);
+	}
+
+	if (!l1)
+		return;
+	for (i = 0; i < 2; i++)
+		pcie_capability_set_word(lp->dev[i], PCI_EXP_LNKCTL,
+					 lp->lnkctl[i] &
+					 PCI_EXP_LNKCTL_ASPM_L1);
+}
+
+static void tegra_pcie_lp_set_speed(struct tegra_pcie_dw *pcie, u32 speed)
+{
+	struct tegra_pcie_lp *lp = &pcie->lp;
+	ktime_t start;
+	u32 val = 0;
+	int ret;
+
+	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL, 4,
+			 &val);
+	val = (val >> 16) & PCI_EXP_LNKSTA_CLS;
+	if (val == speed)
+		return;
+
+	/* Core clock has to keep up with the link before it goes faster */
+	if (speed > val)
+		tegra_pcie_dw_set_clocks(pcie, speed);
+
+	start = ktime_get();
+	ret = tegra_pcie_dw_set_link_speed(pcie, speed);
+	lp->retrain_us = ktime_us_delta(ktime_get(), start);
+	if (ret != speed) {
+		lp->retrain_fail++;
+		dev_dbg(pcie->dev, "link policy: retrain to Gen-%u failed: %d\n",
+			speed, ret);
+	}
+
+	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL, 4,
+			 &val);
+	tegra_pcie_dw_set_clocks(pcie, (val >> 16) & PCI_EXP_LNKSTA_CLS);
+}
+
+static void tegra_pcie_lp_set_level(struct tegra_pcie_dw *pcie,
+				    enum tegra_pcie_lp_level level)
+{
+	struct tegra_pcie_lp *lp = &pcie->lp;
+	enum tegra_pcie_lp_level old = lp->level;
+
+	dev_dbg(pcie->dev, "link policy: %s -> %s, %u L1 entries/s\n",
+		tegra_pcie_lp_names[old], tegra_pcie_lp_names[level],
+		lp->l1_rate);
+
+	/* Endpoint drivers may have changed ASPM since the last look */
+	if (old >= LP_LEVEL_NOMINAL && level < LP_LEVEL_NOMINAL)
+		tegra_pcie_lp_save_aspm(lp);
+	if (min_t(int, old, LP_LEVEL_NOMINAL) !=
+	    min_t(int, level, LP_LEVEL_NOMINAL))
+		tegra_pcie_lp_apply_aspm(lp, level >= LP_LEVEL_L1,
+					 level >= LP_LEVEL_NOMINAL);
+
+	if (level == LP_LEVEL_POWERSAVE)
+		tegra_pcie_lp_set_speed(pcie, 1);
+	else if (old == LP_LEVEL_POWERSAVE)
+		tegra_pcie_lp_set_speed(pcie, lp->nominal_speed);
+
+	tegra_pcie_lp_account(lp);
+	lp->level = level;
+	lp->windows = 0;
+	lp->transitions[level]++;
+}
+
+static void tegra_pcie_lp_work(struct work_struct *work)
+{
+	struct tegra_pcie_lp *lp = container_of(to_delayed_work(work),
+						struct tegra_pcie_lp, work);
+	struct tegra_pcie_dw *pcie = container_of(lp, struct tegra_pcie_dw,
+						  lp);
+	enum tegra_pcie_lp_level level;
+	unsigned long now = jiffies;
+	u32 cnt, val, ms;
+	bool idle;
+
+	mutex_lock(&lp->lock);
+
+	/* aspm_state_cnt clears the event counters behind our back */
+	cnt = event_counter_prog(pcie, EVENT_COUNTER_EVENT_L1);
+	ms = max(jiffies_to_msecs(now - lp->sampled), 1U);
+	lp->l1_rate = div_u64((u64)(cnt >= lp->last_l1 ?
+				    cnt - lp->last_l1 : cnt) * 1000, ms);
+	lp->last_l1 = cnt;
+	lp->sampled = now;
+
+	val = readl(pcie->appl_base + APPL_DEBUG);
+	val = (val & APPL_DEBUG_LTSSM_STATE_MASK) >>
+	      APPL_DEBUG_LTSSM_STATE_SHIFT;
+	idle = (val == LTSSM_STATE_L1_IDLE) && (lp->l1_rate <= lp->idle_rate);
+
+	/* Step up at once on traffic, step down only after idle_windows */
+	level = lp->level;
+	if (!lp->enable) {
+		level = LP_LEVEL_NOMINAL;
+	} else if (lp->l1_rate >= lp->busy_rate) {
+		if (level > LP_LEVEL_PERF)
+			level--;
+	} else if (level == LP_LEVEL_POWERSAVE && !idle) {
+		level = LP_LEVEL_NOMINAL;
+	} else if (level == LP_LEVEL_PERF) {
+		/* With L1 off there is no idleness to see, so re-probe */
+		if (++lp->windows >= lp->hold_windows)
+			level = LP_LEVEL_L1;
+	} else if (idle) {
+		if (++lp->windows >= lp->idle_windows &&
+		    level < LP_LEVEL_POWERSAVE)
+			level++;
+	} else {
+		lp->windows = 0;
+	}
+
+	if (level != lp->level)
+		tegra_pcie_lp_set_level(pcie, level);
+
+	mutex_unlock(&lp->lock);
+
+	schedule_delayed_work(&lp->work,
+			      msecs_to_jiffies(max(lp->period_ms, 10U)));
+}
+
+static void tegra_pcie_lp_attach(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_lp *lp = &pcie->lp;
+	u32 val = 0;
+	int i;
+
+	if (lp->dev[0])
+		return;
+
+	lp->dev[0] = pci_get_slot(pcie->pp.bus, PCI_DEVFN(0, 0));
+	if (!lp->dev[0])
+		return;
+	if (lp->dev[0]->subordinate)
+		lp->dev[1] = pci_get_slot(lp->dev[0]->subordinate,
+					  PCI_DEVFN(0, 0));
+	if (!lp->dev[1]) {
+		pci_dev_put(lp->dev[0]);
+		lp->dev[0] = NULL;
+		return;
+	}
+
+	for (i = 0; i < 2; i++) {
+		pcie_capability_read_dword(lp->dev[i], PCI_EXP_LNKCAP, &val);
+		lp->l1_exit[i] = (val & PCI_EXP_LNKCAP_L1EL) >> 15;
+		lp->l1ss[i] = pci_find_ext_capability(lp->dev[i],
+						      PCI_EXT_CAP_ID_L1SS);
+	}
+
+	lp->t_power_on = 0;
+	if (lp->l1ss[1]) {
+		static const u32 scale[] = { 2, 10, 100, 0 };
+
+		pci_read_config_dword(lp->dev[1], lp->l1ss[1] + PCIE_L1SS_CTL2,
+				      &val);
+		lp->t_power_on = scale[val & PCIE_L1SS_CTL2_T_PWR_ON_SCALE] *
+				 ((val & PCIE_L1SS_CTL2_T_PWR_ON_VALUE) >>
+				  PCIE_L1SS_CTL2_T_PWR_ON_SHIFT);
+	}
+
+	dw_pcie_cfg_read(pcie->pp.dbi_base + CFG_LINK_STATUS_CONTROL, 4,
+			 &val);
+	lp->nominal_speed = (val >> 16) & PCI_EXP_LNKSTA_CLS;
+	lp->level = LP_LEVEL_NOMINAL;
+	lp->windows = 0;
+	lp->last_l1 = event_counter_prog(pcie, EVENT_COUNTER_EVENT_L1);
+	lp->sampled = jiffies;
+	lp->since = jiffies;
+
+	schedule_delayed_work(&lp->work,
+			      msecs_to_jiffies(max(lp->period_ms, 10U)));
+}
+
+/* Put the link back the way it was found before it goes away */
+static void tegra_pcie_lp_detach(struct tegra_pcie_dw *pcie)
+{
+	struct tegra_pcie_lp *lp = &pcie->lp;
+	int i;
+
+	cancel_delayed_work_sync(&lp->work);
+
+	mutex_lock(&lp->lock);
+	if (lp->dev[0]) {
+		if (lp->level != LP_LEVEL_NOMINAL)
+			tegra_pcie_lp_set_level(pcie, LP_LEVEL_NOMINAL);
+		tegra_pcie_lp_account(lp);
+		for (i = 0; i < 2; i++) {
+			pci_dev_put(lp->dev[i]);
+			lp->dev[i] = NULL;
+		}
+	}
+	mutex_unlock(&lp->lock);
+}
+
+static int link_policy_status(struct seq_file *s, void *data)
+{
+	struct tegra_pcie_dw *pcie = (struct tegra_pcie_dw *)(s->private);
+	struct tegra_pcie_lp *lp = &pcie->lp;
+	int i;
+
+	mutex_lock(&lp->lock);
+	if (!lp->dev[0]) {
+		seq_puts(s, "No endpoint\n");
+		goto out;
+	}
+
+	tegra_pcie_lp_account(lp);
+	seq_printf(s, "Level : %s%s\n", tegra_pcie_lp_names[lp->level],
+		   lp->enable ? "" : " (policy disabled)");
+	seq_printf(s, "L1 entries/s : %u\n", lp->l1_rate);
+	seq_printf(s, "Nominal speed : Gen-%u\n", lp->nominal_speed);
+	seq_printf(s, "Last retrain : %u us\n", lp->retrain_us);
+	seq_printf(s, "Failed retrains : %u\n", lp->retrain_fail);
+	seq_printf(s, "L1 exit latency : RP %s, EP %s\n",
+		   tegra_pcie_l1_exit[lp->l1_exit[0]],
+		   tegra_pcie_l1_exit[lp->l1_exit[1]]);
+	seq_printf(s, "L1.2 T_POWER_ON : %u us\n", lp->t_power_on);
+	for (i = 0; i < LP_LEVEL_MAX; i++)
+		seq_printf(s, "%-9s : %u entries, %llu ms\n",
+			   tegra_pcie_lp_names[i], lp->transitions[i],
+			   lp->level_ms[i]);
+out:
+	mutex_unlock(&lp->lock);
 
 	return 0;
 }
@@ -1787,6 +2500,8 @@ DEFINE_ENTRY(apply_speed_change);
 DEFINE_ENTRY(apply_pme_turnoff);
 DEFINE_ENTRY(apply_sbr);
 DEFINE_ENTRY(aspm_state_cnt);
+DEFINE_ENTRY(link_policy_status);
+DEFINE_ENTRY(link_counters);
 DEFINE_ENTRY(verify_timing_margin);
 DEFINE_ENTRY(verify_voltage_margin);
 
@@ -1916,6 +2631,32 @@ static int init_debugfs(struct tegra_pcie_dw *pcie)
 	if (!d)
 		dev_err(pcie->dev, "debugfs for verify_voltage_margin failed\n");
 
+	d = debugfs_create_dir("link_counters", pcie->debugfs);
+	if (!d) {
+		dev_err(pcie->dev, "debugfs for link_counters failed\n");
+	} else {
+		debugfs_create_u32("period_ms", 0644, d,
+				   &pcie->cntr.period_ms);
+		debugfs_create_file("stats", 0444, d, (void *)pcie,
+				    &link_counters_fops);
+	}
+
+	d = debugfs_create_dir("link_policy", pcie->debugfs);
+	if (!d) {
+		dev_err(pcie->dev, "debugfs for link_policy failed\n");
+	} else {
+		debugfs_create_bool("enable", 0644, d, &pcie->lp.enable);
+		debugfs_create_u32("period_ms", 0644, d, &pcie->lp.period_ms);
+		debugfs_create_u32("busy_rate", 0644, d, &pcie->lp.busy_rate);
+		debugfs_create_u32("idle_rate", 0644, d, &pcie->lp.idle_rate);
+		debugfs_create_u32("idle_windows", 0644, d,
+				   &pcie->lp.idle_windows);
+		debugfs_create_u32("hold_windows", 0644, d,
+				   &pcie->lp.hold_windows);
+		debugfs_create_file("status", 0444, d, (void *)pcie,
+				    &link_policy_status_fops);
+	}
+
 	init_dma_test_debugfs(pcie);
 
 	return 0;
@@ -2020,6 +2761,12 @@ static void tegra_pcie_enable_legacy_interrupts(struct pcie_port *pp)
 		writel(val, pcie->appl_base + APPL_INTR_EN_L1_8_0);
 	}
 #endif
+
+	if (IS_ENABLED(CONFIG_TEGRA_PCIE_EDMA)) {
+		val = readl(pcie->appl_base + APPL_INTR_EN_L1_8_0);
+		val |= APPL_INTR_EN_L1_8_EDMA_INT_EN;
+		writel(val, pcie->appl_base + APPL_INTR_EN_L1_8_0);
+	}
 }
 
 static void tegra_pcie_enable_msi_interrupts(struct pcie_port *pp)
@@ -2422,27 +3169,15 @@ static void tegra_pcie_dw_scan_bus(struct pcie_port *pp)
 	struct tegra_pcie_dw *pcie = to_tegra_pcie(pp);
 	struct resource_entry *win;
 	struct pci_dev *pdev = NULL, *ppdev = NULL;
-	u32 width = 0, speed = 0, data = 0, pos = 0;
+	u32 speed = 0, data = 0, pos = 0;
 	struct pci_bus *child;
-	unsigned long freq;
 
 	if (!tegra_pcie_dw_link_up(pp))
 		return;
 
-	/* Make EMC FLOOR freq request based on link width and speed */
 	data = readl(pp->dbi_base + CFG_LINK_STATUS_CONTROL);
-	width = ((data >> 16) & PCI_EXP_LNKSTA_NLW) >> 4;
-	width = find_first_bit((const unsigned long *)&width,
-			       sizeof(width));
 	speed = ((data >> 16) & PCI_EXP_LNKSTA_CLS);
-	freq = pcie->dvfs_tbl[width][speed - 1];
-	dev_dbg(pp->dev, "EMC Freq requested = %lu\n", freq);
-
-	if (tegra_bwmgr_set_emc(pcie->emc_bw, freq, TEGRA_BWMGR_SET_EMC_FLOOR))
-		dev_err(pp->dev, "can't set emc clock[%lu]\n", freq);
-
-	speed = ((data >> 16) & PCI_EXP_LNKSTA_CLS);
-	clk_set_rate(pcie->core_clk, pcie_gen_freq[speed - 1]);
+	tegra_pcie_dw_set_clocks(pcie, speed);
 
 	if (pcie->is_safety_platform)
 		if (clk_prepare_enable(pcie->core_clk_m))
@@ -2499,6 +3234,9 @@ static void tegra_pcie_dw_scan_bus(struct pcie_port *pp)
 			enable_ltr(pdev);	/* Enable LTR in child (EP) */
 		}
 	}
+
+	tegra_pcie_cntr_start(pcie);
+	tegra_pcie_lp_attach(pcie);
 }
 
 static struct pcie_host_ops tegra_pcie_dw_host_ops = {
@@ -2656,6 +3394,7 @@ static int tegra_pcie_dw_parse_dt(struct tegra_pcie_dw *pcie)
 	pcie->disable_clock_request = of_property_read_bool(pcie->dev->of_node,
 		"nvidia,disable-clock-request");
 	pcie->cdm_check = of_property_read_bool(np, "nvidia,cdm_check");
+	pcie->lp.enable = of_property_read_bool(np, "nvidia,dynamic-link-pm");
 
 	pcie->phy_count = of_property_count_strings(np, "phy-names");
 	if (pcie->phy_count < 0) {
@@ -2908,6 +3647,8 @@ static int tegra_pcie_dw_probe(struct platform_device *pdev)
 			dev_err(pp->dev, "failed to request \"msi\" irq\n");
 			return ret;
 		}
+
+		tegra_pcie_request_msi_groups(pcie, pdev);
 	}
 
 	pcie->emc_bw = tegra_bwmgr_register(pcie_emc_client_id[pcie->cid]);
@@ -2917,6 +3658,19 @@ static int tegra_pcie_dw_probe(struct platform_device *pdev)
 		return ret;
 	}
 
+	mutex_init(&pcie->lp.lock);
+	INIT_DELAYED_WORK(&pcie->lp.work, tegra_pcie_lp_work);
+	pcie->lp.period_ms = 100;
+	pcie->lp.busy_rate = 2000;
+	pcie->lp.idle_rate = 10;
+	pcie->lp.idle_windows = 20;
+	pcie->lp.hold_windows = 50;
+
+	spin_lock_init(&pcie->event_cntr_lock);
+	mutex_init(&pcie->cntr.lock);
+	INIT_DELAYED_WORK(&pcie->cntr.work, tegra_pcie_cntr_work);
+	pcie->cntr.period_ms = 1000;
+
 	platform_set_drvdata(pdev, pcie);
 	pm_runtime_enable(pcie->dev);
 	ret = pm_runtime_get_sync(pcie->dev);
@@ -2945,6 +3699,13 @@ static int tegra_pcie_dw_probe(struct platform_device *pdev)
 		init_debugfs(pcie);
 	kfree(name);
 
+	pcie->edma = tegra_pcie_edma_register(pcie->dev, pcie->atu_dma_base +
+					      EDMA_REGS_OFFSET);
+	if (IS_ERR(pcie->edma))
+		pcie->edma = NULL;
+	else
+		tegra_pcie_edma_online(pcie->edma);
+
 	return 0;
 
 fail_host_init:
@@ -3030,9 +3791,13 @@ static int tegra_pcie_dw_remove(struct platform_device *pdev)
 {
 	struct tegra_pcie_dw *pcie = platform_get_drvdata(pdev);
 
+	tegra_pcie_free_msi_groups(pcie);
+
 	if (!pcie->link_state && pcie->power_down_en)
 		return 0;
 
+	tegra_pcie_edma_unregister(pcie->edma);
+	pcie->edma = NULL;
 	destroy_dma_test_debugfs(pcie);
 	debugfs_remove_recursive(pcie->debugfs);
 	pm_runtime_put_sync(pcie->dev);
@@ -3046,6 +3811,11 @@ static int tegra_pcie_dw_runtime_suspend(struct device *dev)
 {
 	struct tegra_pcie_dw *pcie = dev_get_drvdata(dev);
 
+	tegra_pcie_lp_detach(pcie);
+	tegra_pcie_cntr_stop(pcie);
+
+	tegra_pcie_edma_offline(pcie->edma);
+
 	tegra_pcie_downstream_dev_to_D0(pcie);
 
 	dw_pcie_host_deinit(&pcie->pp);
@@ -3152,6 +3922,8 @@ static int tegra_pcie_dw_runtime_resume(struct device *dev)
 		goto fail_host_init;
 	}
 
+	tegra_pcie_edma_online(pcie->edma);
+
 	return 0;
 
 fail_host_init:
@@ -3170,17 +3942,37 @@ fail_reg_en:
 	return ret;
 }
 
+/*
+ * Endpoint config space is saved in the noirq phase, so the link policy has
+ * to hand back the configured ASPM state before that. scan_bus() restarts
+ * it on resume.
+ */
+static int tegra_pcie_dw_suspend(struct device *dev)
+{
+	struct tegra_pcie_dw *pcie = dev_get_drvdata(dev);
+
+	tegra_pcie_lp_detach(pcie);
+	tegra_pcie_cntr_stop(pcie);
+
+	return 0;
+}
+
 static int tegra_pcie_dw_suspend_noirq(struct device *dev)
 {
 	struct tegra_pcie_dw *pcie = dev_get_drvdata(dev);
-	int ret = 0;
+	int ret = 0, i;
 
 	if (!pcie->link_state)
 		return 0;
 
+	tegra_pcie_edma_offline(pcie->edma);
+
 	/* save MSI interrutp vector*/
-	dw_pcie_cfg_read(pcie->pp.dbi_base + PORT_LOGIC_MSI_CTRL_INT_0_EN,
-			 4, &pcie->msi_ctrl_int);
+	for (i = 0; i < MAX_MSI_CTRLS; i++)
+		dw_pcie_cfg_read(pcie->pp.dbi_base +
+				 PORT_LOGIC_MSI_CTRL_INT_0_EN +
+				 i * PORT_LOGIC_MSI_CTRL_INT_STRIDE,
+				 4, &pcie->msi_ctrl_int[i]);
 	if (pcie->is_safety_platform)
 		clk_disable_unprepare(pcie->core_clk_m);
 	tegra_pcie_downstream_dev_to_D0(pcie);
@@ -3211,7 +4003,7 @@ static int tegra_pcie_dw_suspend_noirq(struct device *dev)
 static int tegra_pcie_dw_resume_noirq(struct device *dev)
 {
 	struct tegra_pcie_dw *pcie = dev_get_drvdata(dev);
-	int ret;
+	int ret, i;
 	u32 val;
 
 	if (!pcie->link_state)
@@ -3297,11 +4089,16 @@ static int tegra_pcie_dw_resume_noirq(struct device *dev)
 	tegra_pcie_dw_host_init(&pcie->pp);
 
 	/* restore MSI interrutp vector*/
-	dw_pcie_cfg_write(pcie->pp.dbi_base + PORT_LOGIC_MSI_CTRL_INT_0_EN,
-			  4, pcie->msi_ctrl_int);
+	for (i = 0; i < MAX_MSI_CTRLS; i++)
+		dw_pcie_cfg_write(pcie->pp.dbi_base +
+				  PORT_LOGIC_MSI_CTRL_INT_0_EN +
+				  i * PORT_LOGIC_MSI_CTRL_INT_STRIDE,
+				  4, pcie->msi_ctrl_int[i]);
 
 	tegra_pcie_dw_scan_bus(&pcie->pp);
 
+	tegra_pcie_edma_online(pcie->edma);
+
 	return 0;
 fail_phy:
 	reset_control_assert(pcie->core_apb_rst);
@@ -3319,6 +4116,8 @@ static void tegra_pcie_dw_shutdown(struct platform_device *pdev)
 	if (!pcie->link_state && pcie->power_down_en)
 		return;
 
+	tegra_pcie_edma_unregister(pcie->edma);
+	pcie->edma = NULL;
 	destroy_dma_test_debugfs(pcie);
 	debugfs_remove_recursive(pcie->debugfs);
 	tegra_pcie_dw_runtime_suspend(pcie->dev);
@@ -3332,6 +4131,7 @@ static const struct of_device_id tegra_pcie_dw_of_match[] = {
 MODULE_DEVICE_TABLE(of, tegra_pcie_dw_of_match);
 
 static const struct dev_pm_ops tegra_pcie_dw_pm_ops = {
+	.suspend = tegra_pcie_dw_suspend,
 	.suspend_noirq = tegra_pcie_dw_suspend_noirq,
 	.resume_noirq = tegra_pcie_dw_resume_noirq,
 	.runtime_suspend = tegra_pcie_dw_runtime_suspend,
@@ -265,6 +265,14 @@ static void actmon_dev_set_rate(struct actmon_dev *adev,
 		TEGRA_BWMGR_SET_EMC_FLOOR);
 }
 
+static unsigned long actmon_dev_get_floor(struct actmon_dev *adev)
+{
+	struct tegra_bwmgr_client *bwclnt = (struct tegra_bwmgr_client *)
+			adev->clnt;
+
+	return tegra_bwmgr_get_floor_rate(bwclnt) / 1000;
+}
+
 static int cactmon_bwmgr_register_t19x(
 	struct actmon_dev *adev, struct platform_device *pdev)
 {
@@ -321,6 +329,7 @@ static int actmon_dev_platform_init_t19x(struct actmon_dev *adev,
 	actmon_dev_reg_ops_init(adev);
 	adev->actmon_dev_set_rate = actmon_dev_set_rate;
 	adev->actmon_dev_get_rate = actmon_dev_get_rate;
+	adev->actmon_dev_get_floor = actmon_dev_get_floor;
 	if (adev->rate_change_nb.notifier_call) {
 		ret = tegra_bwmgr_notifier_register(&adev->rate_change_nb);
 		if (ret) {
@@ -26,9 +26,17 @@
 #include <linux/kobject.h>
 #include <linux/sysfs.h>
 #include <linux/version.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 #include <linux/platform/tegra/actmon_common.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/actmon.h>
+
 /* Global definitions */
 static struct actmon_drv_data *actmon;
 static struct device *mon_dev;
@@ -69,19 +77,159 @@ end:
 	return ret;
 }
 
-static unsigned long actmon_dev_avg_freq_get(
-	struct actmon_dev *dev)
+static unsigned long actmon_dev_count_to_freq(
+	struct actmon_dev *dev, u32 count)
 {
 	u64 val;
 
 	if (dev->type == ACTMON_FREQ_SAMPLER)
-		return dev->avg_count / actmon->sample_period;
+		return count / actmon->sample_period;
 
-	val = (u64)dev->avg_count * dev->cur_freq;
+	val = (u64)count * dev->cur_freq;
 	do_div(val, actmon->freq * actmon->sample_period);
 	return (u32)val;
 }
 
+static unsigned long actmon_dev_avg_freq_get(
+	struct actmon_dev *dev)
+{
+	return actmon_dev_count_to_freq(dev, dev->avg_count);
+}
+
+/*
+ * Predictive governor.
+ *
+ * Instead of waiting for a watermark to be crossed, the average activity
+ * is sampled every period_ms. A least squares fit over the last samples
+ * gives the trend, which is extrapolated lookahead_ms ahead. The target
+ * then moves towards that prediction with separate up and down response
+ * times (0 means follow at once). Whatever other clients already hold the
+ * clock at is not worth ramping to: going up starts from that floor, and
+ * a decay that reaches it is finished right away.
+ *
+ * This only uses the state passed in, so the replay below runs the exact
+ * same code on a captured trace.
+ */
+static unsigned long actmon_predict_step(struct actmon_dev *dev,
+	struct actmon_predict_state *st, unsigned long avg,
+	unsigned long floor)
+{
+	struct actmon_predict *p = &dev->predict;
+	u32 period = max_t(u32, p->period_ms, 1);
+	unsigned long prev = st->target, from, demand;
+	s64 sx = 0, sy = 0, sxy = 0, sxx = 0, slope = 0, pred, y;
+	unsigned int n, i;
+
+	memmove(st->hist, st->hist + 1,
+		sizeof(st->hist) - sizeof(st->hist[0]));
+	st->hist[ACTMON_PREDICT_HIST - 1] = avg;
+	if (st->nr_hist < ACTMON_PREDICT_HIST)
+		st->nr_hist++;
+
+	n = st->nr_hist;
+	if (n > 1) {
+		for (i = 0; i < n; i++) {
+			y = st->hist[ACTMON_PREDICT_HIST - n + i];
+			sx += i;
+			sy += y;
+			sxy += i * y;
+			sxx += i * i;
+		}
+		/* kHz per sample */
+		slope = div64_s64(n * sxy - sx * sy, n * sxx - sx * sx);
+	}
+
+	pred = avg + div_s64(slope * p->lookahead_ms, period);
+	pred = clamp_t(s64, pred, 0, dev->max_freq);
+	st->predicted = pred;
+
+	demand = do_percent(st->predicted, dev->avg_sustain_coef) +
+		dev->boost_freq;
+	demand = min(demand, dev->max_freq);
+
+	if (demand >= prev) {
+		from = max(prev, min(floor, demand));
+		st->target = from + div_u64((u64)(demand - from) * period,
+			period + p->up_response_ms);
+	} else {
+		st->target = prev - div_u64((u64)(prev - demand) * period,
+			period + p->down_response_ms);
+		if (st->target <= floor)
+			st->target = demand;
+	}
+
+	return st->target;
+}
+
+static void actmon_predict_reset(struct actmon_dev *dev)
+{
+	struct actmon_predict_state *st = &dev->predict.state;
+
+	memset(st, 0, sizeof(*st));
+	st->target = dev->target_freq;
+}
+
+static void actmon_predict_work_fn(struct work_struct *work)
+{
+	struct actmon_dev *dev = container_of(to_delayed_work(work),
+		struct actmon_dev, predict.work);
+	unsigned long flags, avg, floor = 0, target;
+	struct actmon_predict *p = &dev->predict;
+
+	if (!p->enable)
+		return;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->state != ACTMON_ON || !dev->ops.get_avg_cnt) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		goto resched;
+	}
+	avg = actmon_dev_count_to_freq(dev,
+		dev->ops.get_avg_cnt(offs(dev->reg_offs)));
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	/* may sleep, e.g. on the bwmgr lock */
+	if (dev->actmon_dev_get_floor)
+		floor = dev->actmon_dev_get_floor(dev);
+
+	spin_lock_irqsave(&dev->lock, flags);
+	target = actmon_predict_step(dev, &p->state, avg, floor);
+	dev->target_freq = target;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+#ifdef CONFIG_TRACEPOINTS
+	trace_tegra_actmon_predict(dev->dev_name, avg, floor,
+		p->state.predicted, target);
+#endif /* CONFIG_TRACEPOINTS */
+
+	dev->actmon_dev_set_rate(dev, target);
+resched:
+	schedule_delayed_work(&p->work,
+		msecs_to_jiffies(max_t(u32, p->period_ms, 1)));
+}
+
+static void actmon_predict_set(struct actmon_dev *dev, bool enable)
+{
+	struct actmon_predict *p = &dev->predict;
+	unsigned long flags;
+
+	if (enable == p->enable)
+		return;
+
+	if (!enable) {
+		p->enable = false;
+		cancel_delayed_work_sync(&p->work);
+		return;
+	}
+
+	spin_lock_irqsave(&dev->lock, flags);
+	actmon_predict_reset(dev);
+	p->enable = true;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	schedule_delayed_work(&p->work, 0);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static void actmon_dev_disable(struct actmon_dev *dev)
 {
@@ -436,6 +584,128 @@ static int down_wmark_set(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(down_wmark_fops,
 	down_wmark_get, down_wmark_set, "%llu\n");
 
+static int predict_get(void *data, u64 *val)
+{
+	struct actmon_dev *dev = data;
+
+	*val = dev->predict.enable;
+	return 0;
+}
+static int predict_set(void *data, u64 val)
+{
+	struct actmon_dev *dev = data;
+
+	actmon_predict_set(dev, !!val);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(predict_fops, predict_get, predict_set,
+	"%llu\n");
+
+/*
+ * Replay: write a captured trace as whitespace separated samples, each
+ * "avg" or "avg:floor" in kHz (the avg and floor fields of the
+ * tegra_actmon_predict event), and read back what the predictor would
+ * have requested with the current tunables. The device is not touched.
+ */
+#define ACTMON_REPLAY_MAX_IN	(16 * 1024)
+#define ACTMON_REPLAY_LINE	64
+
+static DEFINE_MUTEX(actmon_replay_lock);
+
+static ssize_t predict_replay_write(struct file *file,
+	const char __user *ubuf, size_t count, loff_t *ppos)
+{
+	struct actmon_dev *dev = file->private_data;
+	struct actmon_predict_state *st = NULL;
+	unsigned long avg, floor, target, flags;
+	char *in, *cur, *tok, *sep, *out = NULL;
+	size_t len = 0, size;
+	int ret;
+
+	if (count > ACTMON_REPLAY_MAX_IN)
+		return -E2BIG;
+
+	in = memdup_user_nul(ubuf, count);
+	if (IS_ERR(in))
+		return PTR_ERR(in);
+
+	/* at most one sample per two input bytes, plus the header */
+	size = (count / 2 + 2) * ACTMON_REPLAY_LINE;
+	out = vmalloc(size);
+	st = kzalloc(sizeof(*st), GFP_KERNEL);
+	if (!out || !st) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	spin_lock_irqsave(&dev->lock, flags);
+	st->target = dev->target_freq;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	len = scnprintf(out, size, "%10s %10s %10s %10s\n",
+		"avg", "floor", "predicted", "target");
+
+	cur = in;
+	while ((tok = strsep(&cur, " \t\n,")) != NULL) {
+		if (!*tok)
+			continue;
+
+		floor = 0;
+		sep = strchr(tok, ':');
+		if (sep) {
+			*sep++ = '\0';
+			ret = kstrtoul(sep, 10, &floor);
+			if (ret)
+				goto err;
+		}
+		ret = kstrtoul(tok, 10, &avg);
+		if (ret)
+			goto err;
+
+		target = actmon_predict_step(dev, st, avg, floor);
+		len += scnprintf(out + len, size - len,
+			"%10lu %10lu %10lu %10lu\n",
+			avg, floor, st->predicted, target);
+	}
+
+	mutex_lock(&actmon_replay_lock);
+	vfree(dev->predict.replay_out);
+	dev->predict.replay_out = out;
+	dev->predict.replay_len = len;
+	mutex_unlock(&actmon_replay_lock);
+
+	kfree(st);
+	kfree(in);
+	return count;
+err:
+	vfree(out);
+	kfree(st);
+	kfree(in);
+	return ret;
+}
+
+static ssize_t predict_replay_read(struct file *file, char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	struct actmon_dev *dev = file->private_data;
+	ssize_t ret = 0;
+
+	mutex_lock(&actmon_replay_lock);
+	if (dev->predict.replay_out)
+		ret = simple_read_from_buffer(ubuf, count, ppos,
+			dev->predict.replay_out, dev->predict.replay_len);
+	mutex_unlock(&actmon_replay_lock);
+
+	return ret;
+}
+
+static const struct file_operations predict_replay_fops = {
+	.open		= simple_open,
+	.read		= predict_replay_read,
+	.write		= predict_replay_write,
+	.llseek		= default_llseek,
+};
+
 static int actmon_debugfs_create_dev(struct actmon_dev *dev)
 {
 	struct dentry *dir, *d;
@@ -499,6 +769,39 @@ static int actmon_debugfs_create_dev(struct actmon_dev *dev)
 	if (!d)
 		return -ENOMEM;
 
+	d = debugfs_create_file(
+		"predict", RW_MODE, dir, dev, &predict_fops);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_u32(
+		"predict_period_ms", RW_MODE, dir, &dev->predict.period_ms);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_u32(
+		"predict_lookahead_ms", RW_MODE, dir,
+		&dev->predict.lookahead_ms);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_u32(
+		"predict_up_response_ms", RW_MODE, dir,
+		&dev->predict.up_response_ms);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_u32(
+		"predict_down_response_ms", RW_MODE, dir,
+		&dev->predict.down_response_ms);
+	if (!d)
+		return -ENOMEM;
+
+	d = debugfs_create_file(
+		"predict_replay", RW_MODE, dir, dev, &predict_replay_fops);
+	if (!d)
+		return -ENOMEM;
+
 	return 0;
 }
 
@@ -641,6 +944,14 @@ static irqreturn_t actmon_dev_fn(int irq, void *dev_id)
 
 	freq = actmon_dev_avg_freq_get(dev);
 	dev->avg_actv_freq = freq;
+
+	/* a crossed watermark just makes the predictor sample early */
+	if (dev->predict.enable) {
+		spin_unlock_irqrestore(&dev->lock, flags);
+		mod_delayed_work(system_wq, &dev->predict.work, 0);
+		return IRQ_HANDLED;
+	}
+
 	freq = do_percent(freq, dev->avg_sustain_coef);
 	freq += dev->boost_freq;
 
@@ -861,6 +1172,22 @@ static int actmon_dev_parse_dt(struct actmon_dev *dev,
 		dev->count_weight *= (u32)(max_dram_channels / ch_num);
 #endif
 
+	dev->predict.enable = of_property_read_bool(dev->dn,
+			"nvidia,predictive");
+	if (of_property_read_u32(dev->dn, "nvidia,predict_period_ms",
+			&dev->predict.period_ms))
+		dev->predict.period_ms = DEFAULT_PREDICT_PERIOD_MS;
+	if (of_property_read_u32(dev->dn, "nvidia,predict_lookahead_ms",
+			&dev->predict.lookahead_ms))
+		dev->predict.lookahead_ms = DEFAULT_PREDICT_LOOKAHEAD_MS;
+	if (of_property_read_u32(dev->dn, "nvidia,predict_up_response_ms",
+			&dev->predict.up_response_ms))
+		dev->predict.up_response_ms = DEFAULT_PREDICT_UP_RESPONSE_MS;
+	if (of_property_read_u32(dev->dn, "nvidia,predict_down_response_ms",
+			&dev->predict.down_response_ms))
+		dev->predict.down_response_ms =
+			DEFAULT_PREDICT_DOWN_RESPONSE_MS;
+
 	ret = of_property_read_u32(dev->dn, "nvidia,type",
 			&dev->type);
 	if (ret) {
@@ -881,6 +1208,7 @@ static int actmon_dev_init(struct actmon_dev *dev,
 	int ret = 0;
 
 	spin_lock_init(&dev->lock);
+	INIT_DELAYED_WORK(&dev->predict.work, actmon_predict_work_fn);
 
 	ret = actmon_dev_parse_dt(dev, pdev);
 	if (ret) {
@@ -923,6 +1251,11 @@ static int actmon_dev_init(struct actmon_dev *dev,
 	disable_irq(actmon->virq);
 	dev->state = ACTMON_OFF;
 	actmon_dev_enable(dev);
+
+	if (dev->predict.enable) {
+		dev->predict.enable = false;
+		actmon_predict_set(dev, true);
+	}
 	return 0;
 
 err_out:
@@ -1105,9 +1438,13 @@ int tegra_actmon_remove(struct platform_device *pdev)
 #endif
 
 	for (i = 0; i < MAX_DEVICES; i++) {
-		if (actmon->devices[i].dn)
+		if (actmon->devices[i].dn) {
+			actmon_predict_set(&actmon->devices[i], false);
+			vfree(actmon->devices[i].predict.replay_out);
+			actmon->devices[i].predict.replay_out = NULL;
 			sysfs_remove_file(actmon->actmon_kobj,
 				&actmon->devices[i].avgact_attr.attr);
+		}
 		actmon->dev_free_resource(&actmon->devices[i], pdev);
 	}
 
@@ -1118,3 +1455,34 @@ int tegra_actmon_remove(struct platform_device *pdev)
 }
 EXPORT_SYMBOL_GPL(tegra_actmon_remove);
 
+/*
+ * Last average activity and current clock rate (both in kHz) of a monitored
+ * device, for drivers that want to react to the measured load.
+ */
+int tegra_actmon_get_load(enum actmon_devices index,
+		unsigned long *avg_khz, unsigned long *cur_khz)
+{
+	struct actmon_dev *dev;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!actmon || index >= MAX_DEVICES)
+		return -ENODEV;
+
+	dev = &actmon->devices[index];
+	if (!dev->dn)
+		return -ENODEV;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->state != ACTMON_ON || !dev->cur_freq) {
+		ret = -EAGAIN;
+	} else {
+		*avg_khz = dev->avg_actv_freq;
+		*cur_khz = dev->cur_freq;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(tegra_actmon_get_load);
+
@@ -29,6 +29,8 @@
 #include <linux/pm_runtime.h>
 #include <linux/delay.h>
 #include <linux/debugfs.h>
+#include <linux/dma-mapping.h>
+#include <linux/genalloc.h>
 #include <linux/seq_file.h>
 #include <linux/of_device.h>
 #include <linux/of_address.h>
@@ -36,6 +38,7 @@
 #include <linux/platform_device.h>
 #include <linux/nvmap_t19x.h>
 #include <soc/tegra/chip-id.h>
+#include <linux/cvnas.h>
 
 static int cvnas_debug;
 module_param(cvnas_debug, int, 0644);
@@ -70,6 +73,34 @@ module_param(cvnas_debug, int, 0644);
 #define HSM_CVSRAM_ECC_DED_MASK_0	0x80000000
 #define HSM_CVSRAM_ECC_DED_MASK_1	0x00000007
 
+/* heat added per use, halved for every second a buffer sits unused */
+#define CVSRAM_SCRATCH_HEAT_STEP	1024
+#define CVSRAM_SCRATCH_HEAT_MAX		(1 << 24)
+
+struct nvcvnas_scratch {
+	struct list_head node;
+	struct device *dev;
+	size_t size;
+	u32 prio;
+	int pin_count;
+	bool in_sram;
+	dma_addr_t dma_addr;
+	void *cpu_addr;
+	u32 heat;
+	unsigned long last_use;
+	u64 uses;
+};
+
+struct cvsram_scratch_stats {
+	u64 allocs;
+	u64 sram_allocs;
+	u64 dram_allocs;
+	u64 evictions;
+	u64 promotions;
+	u64 uses;
+	u64 hits;
+};
+
 struct cvnas_device {
 	struct dentry *debugfs_root;
 
@@ -84,6 +115,13 @@ struct cvnas_device {
 	phys_addr_t cvsram_base;
 	size_t cvsram_size;
 
+	/* kernel managed scratch pool at the top of CV SRAM */
+	struct gen_pool *scratch_pool;
+	size_t scratch_size;
+	struct mutex scratch_lock;
+	struct list_head scratch_list;
+	struct cvsram_scratch_stats scratch_stats;
+
 	struct clk *clk;
 
 	struct reset_control *rst;
@@ -220,6 +258,43 @@ static const struct file_operations cvsram_ecc_err_fops = {
 	.release = single_release,
 };
 
+static int cvsram_scratch_show(struct seq_file *s, void *data)
+{
+	struct cvnas_device *dev = s->private;
+	struct cvsram_scratch_stats *st = &dev->scratch_stats;
+	struct nvcvnas_scratch *buf;
+
+	mutex_lock(&dev->scratch_lock);
+	seq_printf(s, "pool: %zu bytes, %zu free\n", dev->scratch_size,
+		dev->scratch_pool ? gen_pool_avail(dev->scratch_pool) : 0);
+	seq_printf(s, "allocs: %llu (sram %llu, dram %llu)\n",
+		st->allocs, st->sram_allocs, st->dram_allocs);
+	seq_printf(s, "evictions: %llu\npromotions: %llu\n",
+		st->evictions, st->promotions);
+	seq_printf(s, "uses: %llu\nsram hits: %llu\n", st->uses, st->hits);
+
+	list_for_each_entry(buf, &dev->scratch_list, node)
+		seq_printf(s, "%s: %zu bytes prio %u uses %llu heat %u %s%s\n",
+			dev_name(buf->dev), buf->size, buf->prio, buf->uses,
+			buf->heat, buf->in_sram ? "sram" : "dram",
+			buf->pin_count ? " busy" : "");
+	mutex_unlock(&dev->scratch_lock);
+
+	return 0;
+}
+
+static int cvsram_scratch_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cvsram_scratch_show, inode->i_private);
+}
+
+static const struct file_operations cvsram_scratch_fops = {
+	.open = cvsram_scratch_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int nvcvnas_debugfs_init(struct cvnas_device *dev)
 {
 	struct dentry *root;
@@ -232,6 +307,7 @@ static int nvcvnas_debugfs_init(struct cvnas_device *dev)
 	debugfs_create_size_t("cvsram_size", S_IRUGO, root, &dev->cvsram_size);
 	debugfs_create_file("cvsram_perf_counters", S_IRUGO, root, dev, &cvsram_perf_fops);
 	debugfs_create_file("inject_cvsram_ecc_error", S_IRUGO, root, dev, &cvsram_ecc_err_fops);
+	debugfs_create_file("cvsram_scratch", S_IRUGO, root, dev, &cvsram_scratch_fops);
 	dev->debugfs_root = root;
 	return 0;
 }
@@ -406,6 +482,251 @@ size_t nvcvnas_get_cvsram_size(void)
 }
 EXPORT_SYMBOL(nvcvnas_get_cvsram_size);
 
+static u32 cvsram_scratch_heat(struct nvcvnas_scratch *buf)
+{
+	unsigned long idle = (jiffies - buf->last_use) / HZ;
+
+	return idle >= 32 ? 0 : buf->heat >> idle;
+}
+
+/* Queue priority first, then how hot the buffer has been lately */
+static u64 cvsram_scratch_score(struct nvcvnas_scratch *buf)
+{
+	return ((u64)buf->prio << 32) | cvsram_scratch_heat(buf);
+}
+
+/* Called with scratch_lock held */
+static int cvsram_scratch_to_dram(struct cvnas_device *dev,
+				  struct nvcvnas_scratch *buf)
+{
+	dma_addr_t dma_addr;
+	void *cpu_addr;
+
+	cpu_addr = dma_alloc_coherent(buf->dev, buf->size, &dma_addr,
+				      GFP_KERNEL);
+	if (!cpu_addr)
+		return -ENOMEM;
+
+	if (buf->in_sram) {
+		gen_pool_free(dev->scratch_pool, buf->dma_addr, buf->size);
+		nvcvnas_idle();
+	}
+
+	buf->cpu_addr = cpu_addr;
+	buf->dma_addr = dma_addr;
+	buf->in_sram = false;
+	return 0;
+}
+
+/*
+ * Move buf into CV SRAM, pushing idle residents with a lower score out to
+ * DRAM if that is what it takes. Called with scratch_lock held.
+ */
+static bool cvsram_scratch_to_sram(struct cvnas_device *dev,
+				   struct nvcvnas_scratch *buf)
+{
+	u64 score = cvsram_scratch_score(buf);
+	struct nvcvnas_scratch *victim, *it;
+	unsigned long addr;
+
+	for (;;) {
+		addr = gen_pool_alloc(dev->scratch_pool, buf->size);
+		if (addr)
+			break;
+
+		victim = NULL;
+		list_for_each_entry(it, &dev->scratch_list, node) {
+			if (it == buf || !it->in_sram || it->pin_count)
+				continue;
+			if (!victim || cvsram_scratch_score(it) <
+					cvsram_scratch_score(victim))
+				victim = it;
+		}
+		if (!victim || cvsram_scratch_score(victim) >= score)
+			return false;
+		if (cvsram_scratch_to_dram(dev, victim))
+			return false;
+		dev->scratch_stats.evictions++;
+	}
+
+	if (nvcvnas_busy() < 0) {
+		nvcvnas_idle();
+		gen_pool_free(dev->scratch_pool, addr, buf->size);
+		return false;
+	}
+
+	if (buf->cpu_addr)
+		dma_free_coherent(buf->dev, buf->size, buf->cpu_addr,
+				  buf->dma_addr);
+	buf->cpu_addr = NULL;
+	buf->dma_addr = addr;
+	buf->in_sram = true;
+	return true;
+}
+
+/*
+ * Allocate a scratch buffer for an engine (DLA, PVA) task queue. It lives
+ * in CV SRAM when there is room, or when it outranks an idle resident,
+ * and in DRAM otherwise. Contents are not preserved when a buffer moves,
+ * so this is meant for per-task scratch memory only.
+ */
+struct nvcvnas_scratch *nvcvnas_scratch_alloc(struct device *dev,
+					      size_t size, u32 prio)
+{
+	struct cvnas_device *cvnas_dev;
+	struct nvcvnas_scratch *buf;
+	int err;
+
+	if (!cvnas_plat_dev || !dev_get_drvdata(&cvnas_plat_dev->dev))
+		return ERR_PTR(-ENODEV);
+	cvnas_dev = dev_get_drvdata(&cvnas_plat_dev->dev);
+
+	size = PAGE_ALIGN(size);
+	if (!size)
+		return ERR_PTR(-EINVAL);
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return ERR_PTR(-ENOMEM);
+
+	buf->dev = dev;
+	buf->size = size;
+	buf->prio = prio;
+	buf->last_use = jiffies;
+
+	mutex_lock(&cvnas_dev->scratch_lock);
+	if (cvnas_dev->scratch_pool && cvsram_scratch_to_sram(cvnas_dev, buf)) {
+		cvnas_dev->scratch_stats.sram_allocs++;
+	} else {
+		err = cvsram_scratch_to_dram(cvnas_dev, buf);
+		if (err) {
+			mutex_unlock(&cvnas_dev->scratch_lock);
+			kfree(buf);
+			return ERR_PTR(err);
+		}
+		cvnas_dev->scratch_stats.dram_allocs++;
+	}
+	cvnas_dev->scratch_stats.allocs++;
+	list_add_tail(&buf->node, &cvnas_dev->scratch_list);
+	mutex_unlock(&cvnas_dev->scratch_lock);
+
+	return buf;
+}
+EXPORT_SYMBOL(nvcvnas_scratch_alloc);
+
+void nvcvnas_scratch_free(struct nvcvnas_scratch *buf)
+{
+	struct cvnas_device *cvnas_dev;
+
+	if (IS_ERR_OR_NULL(buf))
+		return;
+	cvnas_dev = dev_get_drvdata(&cvnas_plat_dev->dev);
+
+	mutex_lock(&cvnas_dev->scratch_lock);
+	WARN_ON(buf->pin_count);
+	list_del(&buf->node);
+	if (buf->in_sram) {
+		gen_pool_free(cvnas_dev->scratch_pool, buf->dma_addr,
+			      buf->size);
+		nvcvnas_idle();
+	} else {
+		dma_free_coherent(buf->dev, buf->size, buf->cpu_addr,
+				  buf->dma_addr);
+	}
+	mutex_unlock(&cvnas_dev->scratch_lock);
+
+	kfree(buf);
+}
+EXPORT_SYMBOL(nvcvnas_scratch_free);
+
+/*
+ * Pin the buffer for one task and return its address. A DRAM buffer that
+ * has become hot enough is moved into CV SRAM first. The address stays
+ * valid until the matching nvcvnas_scratch_put().
+ */
+int nvcvnas_scratch_get(struct nvcvnas_scratch *buf, dma_addr_t *addr,
+			bool *in_sram)
+{
+	struct cvnas_device *cvnas_dev;
+
+	if (IS_ERR_OR_NULL(buf))
+		return -EINVAL;
+	cvnas_dev = dev_get_drvdata(&cvnas_plat_dev->dev);
+
+	mutex_lock(&cvnas_dev->scratch_lock);
+	buf->heat = min_t(u32, cvsram_scratch_heat(buf) +
+			  CVSRAM_SCRATCH_HEAT_STEP, CVSRAM_SCRATCH_HEAT_MAX);
+	buf->last_use = jiffies;
+	buf->uses++;
+	cvnas_dev->scratch_stats.uses++;
+
+	if (buf->in_sram)
+		cvnas_dev->scratch_stats.hits++;
+	else if (!buf->pin_count && cvnas_dev->scratch_pool &&
+		 cvsram_scratch_to_sram(cvnas_dev, buf))
+		cvnas_dev->scratch_stats.promotions++;
+
+	buf->pin_count++;
+	*addr = buf->dma_addr;
+	if (in_sram)
+		*in_sram = buf->in_sram;
+	mutex_unlock(&cvnas_dev->scratch_lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(nvcvnas_scratch_get);
+
+void nvcvnas_scratch_put(struct nvcvnas_scratch *buf)
+{
+	struct cvnas_device *cvnas_dev;
+
+	if (IS_ERR_OR_NULL(buf))
+		return;
+	cvnas_dev = dev_get_drvdata(&cvnas_plat_dev->dev);
+
+	mutex_lock(&cvnas_dev->scratch_lock);
+	WARN_ON(!buf->pin_count);
+	if (buf->pin_count)
+		buf->pin_count--;
+	mutex_unlock(&cvnas_dev->scratch_lock);
+}
+EXPORT_SYMBOL(nvcvnas_scratch_put);
+
+static int nvcvnas_scratch_init(struct platform_device *pdev,
+				struct cvnas_device *cvnas_dev)
+{
+	u32 size;
+	int ret;
+
+	mutex_init(&cvnas_dev->scratch_lock);
+	INIT_LIST_HEAD(&cvnas_dev->scratch_list);
+
+	if (of_property_read_u32(pdev->dev.of_node,
+			"nvidia,cvsram-scratch-size", &size) || !size)
+		return 0;
+
+	if (size != PAGE_ALIGN(size) || size >= cvnas_dev->cvsram_size) {
+		dev_err(&pdev->dev, "invalid cvsram scratch size 0x%x\n", size);
+		return -EINVAL;
+	}
+
+	cvnas_dev->scratch_pool = gen_pool_create(PAGE_SHIFT, -1);
+	if (!cvnas_dev->scratch_pool)
+		return -ENOMEM;
+
+	ret = gen_pool_add(cvnas_dev->scratch_pool,
+			cvnas_dev->cvsram_base + cvnas_dev->cvsram_size - size,
+			size, -1);
+	if (ret) {
+		gen_pool_destroy(cvnas_dev->scratch_pool);
+		cvnas_dev->scratch_pool = NULL;
+		return ret;
+	}
+	cvnas_dev->scratch_size = size;
+
+	return 0;
+}
+
 int is_nvcvnas_probed(void)
 {
 	if (cvnas_plat_dev && dev_get_drvdata(&cvnas_plat_dev->dev))
@@ -501,6 +822,10 @@ static int nvcvnas_probe(struct platform_device *pdev)
 		goto err_get_reset_fcm;
 	}
 
+	ret = nvcvnas_scratch_init(pdev, cvnas_dev);
+	if (ret)
+		goto err_scratch_init;
+
 	pm_runtime_enable(&pdev->dev);
 
 	ret = nvcvnas_debugfs_init(cvnas_dev);
@@ -512,8 +837,10 @@ static int nvcvnas_probe(struct platform_device *pdev)
 	cvnas_dev->pmops_busy = nvcvnas_busy;
 	cvnas_dev->pmops_idle = nvcvnas_idle;
 
+	/* nvmap gets whatever the scratch pool leaves */
 	ret = nvmap_register_cvsram_carveout(&cvnas_dev->dma_dev,
-			cvnas_dev->cvsram_base, cvnas_dev->cvsram_size,
+			cvnas_dev->cvsram_base,
+			cvnas_dev->cvsram_size - cvnas_dev->scratch_size,
 			cvnas_dev->pmops_busy, cvnas_dev->pmops_idle);
 	if (ret) {
 		dev_err(&pdev->dev,
@@ -529,6 +856,9 @@ static int nvcvnas_probe(struct platform_device *pdev)
 err_cvsram_nvmap_heap_register:
 	debugfs_remove(cvnas_dev->debugfs_root);
 err_cvnas_debugfs_init:
+	if (cvnas_dev->scratch_pool)
+		gen_pool_destroy(cvnas_dev->scratch_pool);
+err_scratch_init:
 err_get_reset_fcm:
 err_get_reset:
 err_get_clk:
@@ -553,6 +883,8 @@ static int nvcvnas_remove(struct platform_device *pdev)
 		return -ENODEV;
 
 	debugfs_remove(cvnas_dev->debugfs_root);
+	if (cvnas_dev->scratch_pool)
+		gen_pool_destroy(cvnas_dev->scratch_pool);
 	of_reserved_mem_device_release(&pdev->dev);
 	iounmap(cvnas_dev->cvsram_iobase);
 	iounmap(cvnas_dev->cvreg_iobase);
@@ -21,6 +21,8 @@
 #include <linux/debugfs.h>
 #include <linux/thermal.h>
 #include <linux/version.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 #include <soc/tegra/chip-id.h>
 
 #define CREATE_TRACE_POINTS
@@ -72,6 +74,89 @@ static struct dram_refresh_alrt {
 
 static bool clk_update_disabled;
 
+/*
+ * EMC rate change policy. Raises needed by a floor or an ISO client and
+ * drops forced by a cap are applied at once. Everything else is what
+ * chatty clients generate, so:
+ * - drops smaller than down_hyst_pct of the current rate are ignored,
+ * - no drop happens before the rate has been held for dwell_ms,
+ * - drops and raises smaller than up_hyst_pct wait coalesce_ms, and the
+ *   requests landing in that window end up in a single clock change.
+ */
+enum bwmgr_dvfs_reason {
+	BWMGR_DVFS_INIT,
+	BWMGR_DVFS_NEED,
+	BWMGR_DVFS_CAP,
+	BWMGR_DVFS_REQUEST,
+	BWMGR_DVFS_DEFERRED,
+	BWMGR_DVFS_REASON_COUNT,
+};
+
+static const char * const bwmgr_dvfs_reason_names[] = {
+	"init",
+	"floor/iso",
+	"cap",
+	"request",
+	"deferred",
+};
+
+static struct {
+	u32 up_hyst_pct;
+	u32 down_hyst_pct;
+	u32 dwell_ms;
+	u32 coalesce_ms;
+
+	unsigned long cur_rate;
+	ktime_t last_change;
+	struct delayed_work work;
+
+	u64 updates;
+	u64 changes[BWMGR_DVFS_REASON_COUNT];
+	u64 raises;
+	u64 drops;
+	u64 deferred;
+	u64 coalesced;
+	u64 suppressed;
+	u64 failed;
+} bwmgr_dvfs = {
+	.up_hyst_pct = 0,
+	.down_hyst_pct = 10,
+	.dwell_ms = 10,
+	.coalesce_ms = 4,
+};
+
+/*
+ * Per client accounting. A client's demand is the larger of its floor
+ * and its bw + iso_bw. Over time we integrate the demand and the EMC
+ * rate it was served with, and note how long it had the largest demand
+ * and how long the rate stayed below it. The rate changes a client
+ * causes are charged to it, including those it left to the deferred
+ * work.
+ */
+struct bwmgr_client_stats {
+	u64 requests;
+	u64 rate_changes;
+	u64 active_us;
+	u64 dominant_us;
+	u64 starved_us;
+	u64 demand_khz_us;
+	u64 rate_khz_us;
+	unsigned long peak_demand;
+};
+
+static struct {
+	ktime_t last;
+	int dominant;
+	int cause;
+	int pending_cause;
+	u64 other_changes;
+	struct bwmgr_client_stats client[TEGRA_BWMGR_CLIENT_COUNT];
+} bwmgr_stats = {
+	.dominant = -1,
+	.cause = -1,
+	.pending_cause = -1,
+};
+
 static struct {
 	unsigned long bw;
 	unsigned long iso_bw;
@@ -199,6 +284,52 @@ static void purge_client(struct tegra_bwmgr_client *handle)
 	handle->refcount = 0;
 }
 
+static unsigned long bwmgr_client_demand(struct tegra_bwmgr_client *handle)
+{
+	return max(handle->floor, handle->bw + handle->iso_bw);
+}
+
+/* call with bwmgr lock held, before any request or the rate changes */
+static void bwmgr_stats_account(void)
+{
+	ktime_t now = ktime_get();
+	u64 delta = ktime_us_delta(now, bwmgr_stats.last);
+	unsigned long rate = bwmgr_dvfs.cur_rate;
+	unsigned long demand, top = 0;
+	int i, dominant = -1;
+
+	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
+		struct bwmgr_client_stats *st = &bwmgr_stats.client[i];
+
+		demand = bwmgr_client_demand(bwmgr.bwmgr_client + i);
+		if (!demand)
+			continue;
+
+		st->active_us += delta;
+		st->demand_khz_us += (u64)(demand / 1000) * delta;
+		st->rate_khz_us += (u64)(rate / 1000) * delta;
+		if (rate < demand)
+			st->starved_us += delta;
+		if (demand > top) {
+			top = demand;
+			dominant = i;
+		}
+	}
+
+	if (dominant >= 0)
+		bwmgr_stats.client[dominant].dominant_us += delta;
+
+#ifdef CONFIG_TRACEPOINTS
+	if (dominant != bwmgr_stats.dominant)
+		trace_tegra_bwmgr_dominant(dominant >= 0 ?
+				tegra_bwmgr_client_names[dominant] : "none",
+				top, rate);
+#endif /* CONFIG_TRACEPOINTS */
+
+	bwmgr_stats.dominant = dominant;
+	bwmgr_stats.last = now;
+}
+
 static unsigned long tegra_bwmgr_apply_efficiency(
 		unsigned long total_bw, unsigned long iso_bw,
 		unsigned long max_rate, u64 usage_flags,
@@ -211,7 +342,113 @@ static unsigned long tegra_bwmgr_apply_efficiency(
 }
 
 /* call with bwmgr lock held */
-static int bwmgr_update_clk(void)
+static int bwmgr_set_rate(unsigned long rate, enum bwmgr_dvfs_reason reason)
+{
+	unsigned long prev = bwmgr_dvfs.cur_rate;
+	int cause = bwmgr_stats.cause;
+	int ret;
+
+	bwmgr_stats_account();
+	ret = clk_set_rate(bwmgr.emc_clk, rate);
+	if (ret) {
+		pr_err
+		("bwmgr: clk_set_rate failed for freq %lu Hz with errno %d\n",
+				rate, ret);
+		bwmgr_dvfs.failed++;
+		return ret;
+	}
+
+#ifdef CONFIG_TRACEPOINTS
+	trace_tegra_bwmgr_update_clk(rate, prev,
+			bwmgr_dvfs_reason_names[reason],
+			cause >= 0 ? tegra_bwmgr_client_names[cause] : "none");
+#endif /* CONFIG_TRACEPOINTS */
+
+	if (cause >= 0)
+		bwmgr_stats.client[cause].rate_changes++;
+	else
+		bwmgr_stats.other_changes++;
+
+	if (rate > prev)
+		bwmgr_dvfs.raises++;
+	else
+		bwmgr_dvfs.drops++;
+	bwmgr_dvfs.changes[reason]++;
+	bwmgr_dvfs.cur_rate = rate;
+	bwmgr_dvfs.last_change = ktime_get();
+
+	return 0;
+}
+
+/* call with bwmgr lock held */
+static void bwmgr_defer_rate(unsigned int delay_ms)
+{
+	bwmgr_dvfs.deferred++;
+	bwmgr_stats.pending_cause = bwmgr_stats.cause;
+	if (delayed_work_pending(&bwmgr_dvfs.work))
+		bwmgr_dvfs.coalesced++;
+	else
+		schedule_delayed_work(&bwmgr_dvfs.work,
+				msecs_to_jiffies(delay_ms));
+}
+
+/*
+ * call with bwmgr lock held
+ * @need is the lowest rate the floors and ISO clients can live with,
+ * @limit the highest one the caps allow.
+ */
+static int bwmgr_apply_rate(unsigned long rate, unsigned long need,
+		unsigned long limit, bool deferred)
+{
+	unsigned long cur = bwmgr_dvfs.cur_rate;
+	u32 up = 100 + bwmgr_dvfs.up_hyst_pct;
+	u32 down = 100 - min(bwmgr_dvfs.down_hyst_pct, 100U);
+	s64 held_ms;
+
+	bwmgr_dvfs.updates++;
+
+	if (!cur)
+		return bwmgr_set_rate(rate, BWMGR_DVFS_INIT);
+
+	if (rate == cur)
+		return 0;
+
+	if (rate > cur) {
+		if (need > cur)
+			return bwmgr_set_rate(rate, BWMGR_DVFS_NEED);
+
+		if (!deferred && bwmgr_dvfs.coalesce_ms &&
+				rate * 100 < cur * up) {
+			bwmgr_defer_rate(bwmgr_dvfs.coalesce_ms);
+			return 0;
+		}
+	} else {
+		if (cur > limit)
+			return bwmgr_set_rate(rate, BWMGR_DVFS_CAP);
+
+		if (rate * 100 > cur * down) {
+			bwmgr_dvfs.suppressed++;
+			return 0;
+		}
+
+		held_ms = ktime_ms_delta(ktime_get(), bwmgr_dvfs.last_change);
+		if (held_ms < bwmgr_dvfs.dwell_ms) {
+			bwmgr_defer_rate(bwmgr_dvfs.dwell_ms - held_ms);
+			return 0;
+		}
+
+		if (!deferred && bwmgr_dvfs.coalesce_ms) {
+			bwmgr_defer_rate(bwmgr_dvfs.coalesce_ms);
+			return 0;
+		}
+	}
+
+	return bwmgr_set_rate(rate, deferred ?
+			BWMGR_DVFS_DEFERRED : BWMGR_DVFS_REQUEST);
+}
+
+/* call with bwmgr lock held */
+static int __bwmgr_update_clk(bool deferred)
 {
 	int i;
 	unsigned long bw = 0;
@@ -223,8 +460,8 @@ static int bwmgr_update_clk(void)
 	unsigned long iso_cap = bwmgr.emc_max_rate;
 	unsigned long floor = 0;
 	unsigned long iso_bw_min;
+	unsigned long need, limit;
 	u64 iso_client_flags = 0;
-	int ret = 0;
 
 	/* sizeof(iso_client_flags) */
 	BUILD_BUG_ON(TEGRA_BWMGR_CLIENT_COUNT > 64);
@@ -281,18 +518,38 @@ static int bwmgr_update_clk(void)
 	iso_bw_min = clk_round_rate(bwmgr.emc_clk, iso_bw_min);
 	floor = min(floor, bwmgr.emc_max_rate);
 	bw = max(bw, floor);
-	bw = min(bw, min(iso_cap, max(non_iso_cap, iso_bw_min)));
+	limit = min(iso_cap, max(non_iso_cap, iso_bw_min));
+	need = min(max(floor, iso_bw_min), limit);
+	bw = min(bw, limit);
 	debug_info.calc_freq = bw;
 	bw = clk_round_rate(bwmgr.emc_clk, bw);
 	debug_info.req_freq = bw;
 
-	ret = clk_set_rate(bwmgr.emc_clk, bw);
-	if (ret)
-		pr_err
-		("bwmgr: clk_set_rate failed for freq %lu Hz with errno %d\n",
-				bw, ret);
+	return bwmgr_apply_rate(bw, clk_round_rate(bwmgr.emc_clk, need),
+			clk_round_rate(bwmgr.emc_clk, limit), deferred);
+}
 
-	return ret;
+/* call with bwmgr lock held */
+static int bwmgr_update_clk(void)
+{
+	return __bwmgr_update_clk(false);
+}
+
+static void bwmgr_update_clk_work(struct work_struct *work)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return;
+	}
+
+	if (!clk_update_disabled) {
+		bwmgr_stats.cause = bwmgr_stats.pending_cause;
+		__bwmgr_update_clk(true);
+		bwmgr_stats.cause = -1;
+	}
+
+	if (!bwmgr_unlock())
+		pr_err("bwmgr: %s failed\n", __func__);
 }
 
 struct tegra_bwmgr_client *tegra_bwmgr_register(
@@ -344,6 +601,7 @@ void tegra_bwmgr_unregister(struct tegra_bwmgr_client *handle)
 	handle->refcount--;
 
 	if (handle->refcount <= 0) {
+		bwmgr_stats_account();
 		if (handle->refcount < 0) {
 			pr_err("bwmgr: Mismatched unregister call, client %ld\n",
 				handle - bwmgr.bwmgr_client);
@@ -444,6 +702,9 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 			val, bwmgr_req_to_name(req));
 #endif /* CONFIG_TRACEPOINTS */
 
+	bwmgr_stats_account();
+	bwmgr_stats.client[handle - bwmgr.bwmgr_client].requests++;
+
 	switch (req) {
 	case TEGRA_BWMGR_SET_EMC_FLOOR:
 		if (handle->floor != val) {
@@ -497,8 +758,15 @@ int tegra_bwmgr_set_emc(struct tegra_bwmgr_client *handle, unsigned long val,
 		return -EINVAL;
 	}
 
-	if (update_clk && !clk_update_disabled)
+	bwmgr_stats.client[handle - bwmgr.bwmgr_client].peak_demand = max(
+		bwmgr_stats.client[handle - bwmgr.bwmgr_client].peak_demand,
+		bwmgr_client_demand(handle));
+
+	if (update_clk && !clk_update_disabled) {
+		bwmgr_stats.cause = handle - bwmgr.bwmgr_client;
 		ret = bwmgr_update_clk();
+		bwmgr_stats.cause = -1;
+	}
 
 	if (!bwmgr_unlock()) {
 		pr_err("bwmgr: %s failed for client %s\n",
@@ -624,6 +892,63 @@ unsigned long tegra_bwmgr_get_emc_rate(void)
 }
 EXPORT_SYMBOL_GPL(tegra_bwmgr_get_emc_rate);
 
+unsigned long tegra_bwmgr_get_client_demand(enum tegra_bwmgr_client_id id)
+{
+	unsigned long demand;
+
+	if (!bwmgr.status || id >= TEGRA_BWMGR_CLIENT_COUNT)
+		return 0;
+
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed for client %s\n",
+			__func__, tegra_bwmgr_client_names[id]);
+		return 0;
+	}
+
+	demand = bwmgr_client_demand(bwmgr.bwmgr_client + id);
+
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed for client %s\n",
+			__func__, tegra_bwmgr_client_names[id]);
+		return 0;
+	}
+
+	return bwmgr.ops->freq_to_bw(demand / 1000000);
+}
+EXPORT_SYMBOL_GPL(tegra_bwmgr_get_client_demand);
+
+unsigned long tegra_bwmgr_get_floor_rate(struct tegra_bwmgr_client *handle)
+{
+	unsigned long floor = 0;
+	int i;
+
+	if (!bwmgr.status || !IS_HANDLE_VALID(handle))
+		return 0;
+
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed for client %s\n",
+			__func__,
+			tegra_bwmgr_client_names[handle - bwmgr.bwmgr_client]);
+		return 0;
+	}
+
+	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
+		if (bwmgr.bwmgr_client + i != handle)
+			floor = max(floor, bwmgr.bwmgr_client[i].floor);
+	floor = max(floor, debug_info.iso_bw_aftr_eff);
+	floor = min(floor, bwmgr.emc_max_rate);
+
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed for client %s\n",
+			__func__,
+			tegra_bwmgr_client_names[handle - bwmgr.bwmgr_client]);
+		return 0;
+	}
+
+	return floor;
+}
+EXPORT_SYMBOL_GPL(tegra_bwmgr_get_floor_rate);
+
 /* bwmgr_get_lowest_iso_emc_freq
  * bwmgr_apply_efficiency function will use this api to calculate
  * the lowest emc frequency that satisfies the requests of ISO clients.
@@ -775,6 +1100,8 @@ int __init bwmgr_init(void)
 	struct clk *emc_master_clk;
 
 	mutex_init(&bwmgr.lock);
+	INIT_DELAYED_WORK(&bwmgr_dvfs.work, bwmgr_update_clk_work);
+	bwmgr_stats.last = ktime_get();
 
 	if (tegra_get_chip_id() == TEGRA210)
 		bwmgr.ops = bwmgr_eff_init_t21x();
@@ -853,6 +1180,8 @@ void __exit bwmgr_exit(void)
 {
 	int i;
 
+	cancel_delayed_work_sync(&bwmgr_dvfs.work);
+
 	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++)
 		purge_client(bwmgr.bwmgr_client + i);
 
@@ -934,6 +1263,8 @@ static struct dentry *debugfs_node_emc_max;
 static struct dentry *debugfs_node_core_emc_rate;
 static struct dentry *debugfs_node_clients_info;
 static struct dentry *debugfs_node_dram_channels;
+static struct dentry *debugfs_node_dvfs_stats;
+static struct dentry *debugfs_node_clients_stats;
 
 static int bwmgr_debugfs_emc_rate_set(void *data, u64 val)
 {
@@ -1108,6 +1439,119 @@ static const struct file_operations fops_bwmgr_clients_info = {
 	.release = single_release,
 };
 
+static int bwmgr_dvfs_stats_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	seq_printf(s, "updates    : %llu\n", bwmgr_dvfs.updates);
+	seq_printf(s, "raises     : %llu\n", bwmgr_dvfs.raises);
+	seq_printf(s, "drops      : %llu\n", bwmgr_dvfs.drops);
+	seq_printf(s, "deferred   : %llu\n", bwmgr_dvfs.deferred);
+	seq_printf(s, "coalesced  : %llu\n", bwmgr_dvfs.coalesced);
+	seq_printf(s, "suppressed : %llu\n", bwmgr_dvfs.suppressed);
+	seq_printf(s, "failed     : %llu\n", bwmgr_dvfs.failed);
+	seq_puts(s, "changes by reason:\n");
+	for (i = 0; i < BWMGR_DVFS_REASON_COUNT; i++)
+		seq_printf(s, "  %-10s: %llu\n", bwmgr_dvfs_reason_names[i],
+				bwmgr_dvfs.changes[i]);
+	seq_printf(s, "current rate: %lu (Khz), held %lld ms\n",
+			bwmgr_dvfs.cur_rate / 1000,
+			ktime_ms_delta(ktime_get(), bwmgr_dvfs.last_change));
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int bwmgr_dvfs_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bwmgr_dvfs_stats_show, inode->i_private);
+}
+
+static const struct file_operations fops_bwmgr_dvfs_stats = {
+	.open = bwmgr_dvfs_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int bwmgr_clients_stats_show(struct seq_file *s, void *data)
+{
+	struct bwmgr_client_stats *st;
+	int i;
+
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	bwmgr_stats_account();
+	seq_printf(s, "%15s%12s%12s%12s%12s%12s%12s%12s%12s\n", "Client",
+			"Requests", "RateChgs", "ActiveMs", "DominantMs",
+			"StarvedMs", "AvgReq", "AvgRate", "PeakReq");
+	for (i = 0; i < TEGRA_BWMGR_CLIENT_COUNT; i++) {
+		st = &bwmgr_stats.client[i];
+		if (!st->requests && !st->active_us)
+			continue;
+
+		seq_printf(s, "%14s%s%12llu%12llu%12llu%12llu%12llu%12llu%12llu%12lu\n",
+				tegra_bwmgr_client_names[i],
+				bwmgr_stats.dominant == i ? "*" : " ",
+				st->requests, st->rate_changes,
+				div_u64(st->active_us, 1000),
+				div_u64(st->dominant_us, 1000),
+				div_u64(st->starved_us, 1000),
+				st->active_us ?
+				div64_u64(st->demand_khz_us, st->active_us) : 0,
+				st->active_us ?
+				div64_u64(st->rate_khz_us, st->active_us) : 0,
+				st->peak_demand / 1000);
+	}
+	seq_printf(s, "Rate changes not caused by a client: %llu\n",
+			bwmgr_stats.other_changes);
+	seq_puts(s, "(AvgReq, AvgRate and PeakReq in Khz, * is dominant now)\n");
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int bwmgr_clients_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bwmgr_clients_stats_show, inode->i_private);
+}
+
+static ssize_t bwmgr_clients_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	if (!bwmgr_lock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	memset(bwmgr_stats.client, 0, sizeof(bwmgr_stats.client));
+	bwmgr_stats.other_changes = 0;
+	bwmgr_stats.last = ktime_get();
+	if (!bwmgr_unlock()) {
+		pr_err("bwmgr: %s failed\n", __func__);
+		return -EINVAL;
+	}
+	return count;
+}
+
+/* any write resets the accounting */
+static const struct file_operations fops_bwmgr_clients_stats = {
+	.open = bwmgr_clients_stats_open,
+	.read = seq_read,
+	.write = bwmgr_clients_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void bwmgr_debugfs_init(void)
 {
 	bwmgr_debugfs_client_handle =
@@ -1157,6 +1601,20 @@ static void bwmgr_debugfs_init(void)
 		debugfs_node_dram_channels = debugfs_create_file(
 			"num_dram_channels", S_IRUSR, debugfs_dir, NULL,
 			 &fops_debugfs_dram_channels);
+		debugfs_create_u32("emc_up_hyst_pct", S_IRUSR | S_IWUSR,
+			debugfs_dir, &bwmgr_dvfs.up_hyst_pct);
+		debugfs_create_u32("emc_down_hyst_pct", S_IRUSR | S_IWUSR,
+			debugfs_dir, &bwmgr_dvfs.down_hyst_pct);
+		debugfs_create_u32("emc_dwell_ms", S_IRUSR | S_IWUSR,
+			debugfs_dir, &bwmgr_dvfs.dwell_ms);
+		debugfs_create_u32("emc_coalesce_ms", S_IRUSR | S_IWUSR,
+			debugfs_dir, &bwmgr_dvfs.coalesce_ms);
+		debugfs_node_dvfs_stats = debugfs_create_file
+			("emc_dvfs_stats", S_IRUGO, debugfs_dir, NULL,
+			 &fops_bwmgr_dvfs_stats);
+		debugfs_node_clients_stats = debugfs_create_file
+			("bwmgr_clients_stats", S_IRUGO | S_IWUSR, debugfs_dir,
+			 NULL, &fops_bwmgr_clients_stats);
 	} else
 		pr_err("bwmgr: error creating bwmgr debugfs dir.\n");
 
@@ -112,8 +112,6 @@ static bool is_isomgr_request_possible(bool reserve, u32 register_bw,
 	unsigned long iso_bw_nvdis = 0; //Hz
 	unsigned long iso_bw_vi = 0; //Hz
 	unsigned long ret = 0;
-	int i;
-	enum tegra_iso_client curr_res_cli = resclient;
 	u32 cur_req_bw = 0;
 	enum tegra_iso_client cur_iso_client;
 
@@ -139,39 +137,24 @@ static bool is_isomgr_request_possible(bool reserve, u32 register_bw,
 		iso_bw_other = min_freq * 1000;
 
 	if (reserve) {
-		//bw requests reserved and realized by other ISO clients
-		for (i = 0; i < isoclients; i++) {
-			if (isoclient_info[i].name) {
-				resclient = isoclient_info[i].client;
-
-				/* bw req of client calling is considered,
-				 * skip rest of loop.
-				 */
-				if (curr_res_cli == resclient)
-					continue;
-
-				if ((resclient == TEGRA_ISO_CLIENT_DISP_0) ||
-				   (resclient == TEGRA_ISO_CLIENT_DISP_1) ||
-				   (resclient == TEGRA_ISO_CLIENT_DISP_2))
-					iso_bw_nvdis +=
-					(max(isomgr_clients[resclient].rsvd_mf,
-					isomgr_clients[resclient].real_mf)
-					* 1000);
-
-				else if ((resclient ==
-					TEGRA_ISO_CLIENT_TEGRA_CAMERA))
-					iso_bw_vi +=
-					(max(isomgr_clients[resclient].rsvd_mf,
-					isomgr_clients[resclient].real_mf)
-					* 1000);
-
-				else
-					iso_bw_other +=
-					(max(isomgr_clients[resclient].rsvd_mf,
-					isomgr_clients[resclient].real_mf)
-					* 1000);
-			}
-		}
+		/* bw requests reserved and realized by other ISO clients,
+		 * isomgr keeps the sums with the caller's share included.
+		 */
+		u32 own = isomgr_clients[resclient].acct_mf;
+		enum isomgr_mf_class class = isomgr_mf_class(resclient);
+
+		iso_bw_nvdis += (unsigned long)isomgr.mf_sum[ISOMGR_MF_NVDIS]
+				* 1000;
+		iso_bw_vi += (unsigned long)isomgr.mf_sum[ISOMGR_MF_VI] * 1000;
+		iso_bw_other += (unsigned long)isomgr.mf_sum[ISOMGR_MF_OTHER]
+				* 1000;
+
+		if (class == ISOMGR_MF_NVDIS)
+			iso_bw_nvdis -= (unsigned long)own * 1000;
+		else if (class == ISOMGR_MF_VI)
+			iso_bw_vi -= (unsigned long)own * 1000;
+		else
+			iso_bw_other -= (unsigned long)own * 1000;
 	}
 
 	iso_bw_total = iso_bw_nvdis + iso_bw_vi + iso_bw_other;
@@ -163,6 +163,21 @@ static inline bool isomgr_unlock(void)
 	return true;
 }
 
+/*
+ * call with isomgr_lock held, whenever rsvd_mf or real_mf of the client
+ * may have changed. Keeps isomgr.mf_sum up to date so that the platform
+ * reserve checks don't have to walk all the clients.
+ */
+static void isomgr_account_mf(struct isomgr_client *cp)
+{
+	enum isomgr_mf_class class =
+		isomgr_mf_class(cp - &isomgr_clients[0]);
+	s32 mf = max(cp->rsvd_mf, cp->real_mf);
+
+	isomgr.mf_sum[class] += mf - cp->acct_mf;
+	cp->acct_mf = mf;
+}
+
 /* call with isomgr_lock held. */
 static void update_mc_clock(void)
 {
@@ -203,19 +218,17 @@ static void update_mc_clock(void)
 	for (i = 0; i < TEGRA_ISO_CLIENT_COUNT; i++) {
 
 		/*max emc floor req when camera is active for t194 */
-		if (i == TEGRA_ISO_CLIENT_TEGRA_CAMERA) {
-			if (isomgr_camera_max_floor_req) {
-				if (isomgr_clients[i].real_mf)
-					tegra_bwmgr_set_emc(
-						isomgr_clients[i].bwmgr_handle,
-						emc_max_rate,
-						TEGRA_BWMGR_SET_EMC_FLOOR);
-				else
-					tegra_bwmgr_set_emc(
-						isomgr_clients[i].bwmgr_handle,
-						0,
-						TEGRA_BWMGR_SET_EMC_FLOOR);
-			}
+		if (i == TEGRA_ISO_CLIENT_TEGRA_CAMERA &&
+				isomgr_camera_max_floor_req &&
+				isomgr.camera_floor_rq !=
+				!!isomgr_clients[i].real_mf) {
+			if (!tegra_bwmgr_set_emc(
+					isomgr_clients[i].bwmgr_handle,
+					isomgr_clients[i].real_mf ?
+					emc_max_rate : 0,
+					TEGRA_BWMGR_SET_EMC_FLOOR))
+				isomgr.camera_floor_rq =
+					!!isomgr_clients[i].real_mf;
 		}
 
 		if (isomgr_clients[i].real_mf != isomgr_clients[i].real_mf_rq) {
@@ -306,6 +319,7 @@ static void unregister_iso_client(struct kref *kref)
 
 	isomgr.dedi_bw -= cp->dedi_bw;
 	purge_isomgr_client(cp);
+	isomgr_account_mf(cp);
 	update_mc_clock();
 
 	trace_tegra_isomgr_unregister_iso_client(cname[client], "exit");
@@ -503,13 +517,17 @@ static u32 __tegra_isomgr_reserve(tegra_isomgr_handle handle,
 
 	/* Look up MC's min freq that could satisfy requested BW and LT */
 	mf = mc_min_freq(ubw, ult);
-	/* Look up MC's dvfs latency at min freq */
-	dvfs_latency = mc_dvfs_latency(mf);
+	/* Look up MC's dvfs latency at min freq, unless it's the last one */
+	if (mf == cp->rsvd_mf && cp->lto)
+		dvfs_latency = cp->lto;
+	else
+		dvfs_latency = mc_dvfs_latency(mf);
 
 	cp->lti = ult;		/* remember client spec'd LT (usec) */
 	cp->lto = dvfs_latency;	/* remember MC calculated LT (usec) */
 	cp->rsvd_mf = mf;	/* remember associated min freq */
 	cp->rsvd_bw = bw;
+	isomgr_account_mf(cp);
 out:
 	kref_put(&cp->kref, unregister_iso_client);
 	if (!isomgr_unlock()) {
@@ -584,6 +602,7 @@ static u32 __tegra_isomgr_realize(tegra_isomgr_handle handle)
 
 	if (isomgr.ops->isomgr_plat_realize) {
 		ret = isomgr.ops->isomgr_plat_realize(cp);
+		isomgr_account_mf(cp);
 		if (!ret)
 			goto out;
 	}
@@ -433,7 +433,7 @@ static void log_mcerr_fault(unsigned int irq)
 	}
 
 	if (!faults_handled)
-		pr_err("unknown mcerr fault, int_status=0x%08x, "
+		mcerr_pr("unknown mcerr fault, int_status=0x%08x, "
 			"ch_int_status=0x%08x, hubc_int_status=0x%08x\n",
 			int_status, ch_int_status, hubc_int_status);
 }
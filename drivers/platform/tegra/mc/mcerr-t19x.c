@@ -615,7 +615,7 @@ static void log_mcerr_fault(unsigned int irq)
 	LOG_FAULT(sbs, U32_MAX, _MSS_SBS_);
 
 	if (!faults_handled)
-		pr_err("unknown mcerr fault, int_status=0x%08x, "
+		mcerr_pr("unknown mcerr fault, int_status=0x%08x, "
 			"ch_int_status=0x%08x, hubc_int_status=0x%08x "
 			"sbs_int_status=0x%08x, hub_int_status=0x%08x\n",
 			slice_int_status, ch_int_status, hubc_int_status,
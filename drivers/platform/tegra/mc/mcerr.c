@@ -35,6 +35,10 @@
 #include <linux/platform_device.h>
 #include <linux/of_irq.h>
 #include <linux/atomic.h>
+#include <linux/jiffies.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <linux/platform/tegra/mc.h>
 #include <linux/platform/tegra/mcerr.h>
@@ -47,17 +51,221 @@ extern struct of_device_id __mcerr_of_table;
 
 static bool mcerr_throttle_enabled = true;
 u32  mcerr_silenced;
-static atomic_t error_count;
 
-static void unthrottle_prints(struct work_struct *work);
-static DECLARE_DELAYED_WORK(unthrottle_prints_work, unthrottle_prints);
 static struct dentry *mcerr_debugfs_dir;
 u32 mc_int_mask;
 static struct mcerr_ops *mcerr_ops;
 
-static void unthrottle_prints(struct work_struct *work)
+/*
+ * Deferred error reporting.
+ *
+ * The interrupt thread only updates the per client counters and collects
+ * whatever the chip code prints into a report. The reports are printed from
+ * a worker, at most MAX_PRINTS per mcerr_ratelimit_ms, and anything beyond
+ * that is folded into a periodic summary built from the counters. When the
+ * queue is full the report text is not even formatted, only counted. The
+ * first mcerr_keep_reports reports are kept for debugfs.
+ */
+#define MCERR_REPORT_LEN	512
+#define MCERR_QUEUE_LEN		16
+#define MCERR_MAX_KEPT		32
+
+struct mcerr_report {
+	u64 time;
+	unsigned int len;
+	char buf[MCERR_REPORT_LEN];
+};
+
+static struct mcerr_report mcerr_queue[MCERR_QUEUE_LEN];
+static unsigned int mcerr_queue_head;
+static unsigned int mcerr_queue_tail;
+static DEFINE_SPINLOCK(mcerr_queue_lock);
+
+/* Only touched by the interrupt thread */
+static struct task_struct *mcerr_capture_task;
+static struct mcerr_report *mcerr_cur_report;
+
+static struct mcerr_report mcerr_kept[MCERR_MAX_KEPT];
+static unsigned int mcerr_nr_kept;
+static u32 mcerr_keep_reports = 8;
+static DEFINE_MUTEX(mcerr_kept_lock);
+
+static u32 mcerr_ratelimit_ms = 500;
+static unsigned long mcerr_window_start;
+static unsigned int mcerr_window_prints;
+
+static atomic_t mcerr_nr_errors;
+static atomic_t mcerr_nr_dropped;
+static unsigned int mcerr_nr_printed;
+static unsigned int mcerr_nr_suppressed;
+static atomic_t mcerr_summary_suppressed;
+static unsigned int *mcerr_summary_counts;
+
+static void mcerr_report_fn(struct work_struct *work);
+static void mcerr_summary_fn(struct work_struct *work);
+static DECLARE_WORK(mcerr_report_work, mcerr_report_fn);
+static DECLARE_DELAYED_WORK(mcerr_summary_work, mcerr_summary_fn);
+
+bool mcerr_report(const char *fmt, ...)
 {
-	atomic_set(&error_count, 0);
+	struct mcerr_report *rep = mcerr_cur_report;
+	va_list args;
+
+	if (!mcerr_capture_task || mcerr_capture_task != current)
+		return false;
+
+	if (rep && rep->len < MCERR_REPORT_LEN - 1) {
+		va_start(args, fmt);
+		rep->len += vscnprintf(rep->buf + rep->len,
+				       MCERR_REPORT_LEN - rep->len, fmt, args);
+		va_end(args);
+	}
+
+	return true;
+}
+
+static void mcerr_report_begin(void)
+{
+	unsigned long flags;
+
+	atomic_inc(&mcerr_nr_errors);
+
+	spin_lock_irqsave(&mcerr_queue_lock, flags);
+	if (mcerr_queue_head - mcerr_queue_tail < MCERR_QUEUE_LEN) {
+		mcerr_cur_report =
+			&mcerr_queue[mcerr_queue_head % MCERR_QUEUE_LEN];
+		mcerr_cur_report->time = local_clock();
+		mcerr_cur_report->len = 0;
+	} else {
+		mcerr_cur_report = NULL;
+		atomic_inc(&mcerr_nr_dropped);
+	}
+	spin_unlock_irqrestore(&mcerr_queue_lock, flags);
+
+	mcerr_capture_task = current;
+}
+
+static void mcerr_report_end(void)
+{
+	unsigned long flags;
+
+	mcerr_capture_task = NULL;
+
+	spin_lock_irqsave(&mcerr_queue_lock, flags);
+	if (mcerr_cur_report && mcerr_cur_report->len)
+		mcerr_queue_head++;
+	mcerr_cur_report = NULL;
+	spin_unlock_irqrestore(&mcerr_queue_lock, flags);
+
+	schedule_work(&mcerr_report_work);
+}
+
+static bool mcerr_print_allowed(void)
+{
+	unsigned long window = msecs_to_jiffies(mcerr_ratelimit_ms);
+
+	if (!mcerr_throttle_enabled)
+		return true;
+
+	if (time_after(jiffies, mcerr_window_start + window)) {
+		mcerr_window_start = jiffies;
+		mcerr_window_prints = 0;
+	}
+
+	if (mcerr_window_prints == MAX_PRINTS)
+		pr_err("Too many MC errors; throttling prints\n");
+
+	return mcerr_window_prints++ < MAX_PRINTS;
+}
+
+static void mcerr_print_report(const struct mcerr_report *rep)
+{
+	const char *p = rep->buf, *end = rep->buf + rep->len, *nl;
+
+	while (p < end) {
+		nl = memchr(p, '\n', end - p);
+		if (!nl)
+			nl = end;
+		pr_err("%.*s\n", (int)(nl - p), p);
+		p = nl + 1;
+	}
+}
+
+static void mcerr_report_fn(struct work_struct *work)
+{
+	struct mcerr_report *rep;
+	unsigned long flags;
+
+	for (;;) {
+		spin_lock_irqsave(&mcerr_queue_lock, flags);
+		if (mcerr_queue_tail == mcerr_queue_head) {
+			spin_unlock_irqrestore(&mcerr_queue_lock, flags);
+			break;
+		}
+		/* the slot is not reused until the tail moves past it */
+		rep = &mcerr_queue[mcerr_queue_tail % MCERR_QUEUE_LEN];
+		spin_unlock_irqrestore(&mcerr_queue_lock, flags);
+
+		mutex_lock(&mcerr_kept_lock);
+		if (mcerr_nr_kept < min_t(u32, mcerr_keep_reports,
+					  MCERR_MAX_KEPT))
+			mcerr_kept[mcerr_nr_kept++] = *rep;
+		mutex_unlock(&mcerr_kept_lock);
+
+		if (mcerr_print_allowed()) {
+			mcerr_print_report(rep);
+			mcerr_nr_printed++;
+		} else {
+			mcerr_nr_suppressed++;
+			atomic_inc(&mcerr_summary_suppressed);
+		}
+
+		spin_lock_irqsave(&mcerr_queue_lock, flags);
+		mcerr_queue_tail++;
+		spin_unlock_irqrestore(&mcerr_queue_lock, flags);
+	}
+
+	if (atomic_read(&mcerr_summary_suppressed) ||
+	    atomic_read(&mcerr_nr_dropped))
+		schedule_delayed_work(&mcerr_summary_work,
+				msecs_to_jiffies(max_t(u32, mcerr_ratelimit_ms,
+						       100)));
+}
+
+/*
+ * Print what the reports did not show: the per client, per type counts
+ * accumulated since the last summary.
+ */
+static void mcerr_summary_fn(struct work_struct *work)
+{
+	unsigned int dropped = atomic_xchg(&mcerr_nr_dropped, 0);
+	unsigned int suppressed = atomic_xchg(&mcerr_summary_suppressed, 0);
+	struct mc_client *c;
+	unsigned int *last, delta;
+	int i, j;
+
+	if (!suppressed && !dropped)
+		return;
+
+	pr_err("%u MC error reports suppressed, %u dropped, since last summary:\n",
+	       suppressed, dropped);
+
+	if (!mcerr_summary_counts)
+		return;
+
+	for (i = 0; i < mcerr_ops->nr_clients; i++) {
+		c = &mcerr_ops->mc_clients[i];
+		last = &mcerr_summary_counts[i * MC_MAX_INTR_COUNT];
+		for (j = 0; j < MC_MAX_INTR_COUNT; j++) {
+			delta = c->intr_counts[j] - last[j];
+			if (!delta)
+				continue;
+			last[j] += delta;
+			if (mcerr_ops->intr_descriptions[j])
+				pr_err("  %-18s %-12s %u\n", c->name,
+				       mcerr_ops->intr_descriptions[j], delta);
+		}
+	}
 }
 
 static void disable_interrupt(unsigned int irq)
@@ -72,21 +280,14 @@ static void enable_interrupt(unsigned int irq)
 
 static irqreturn_t tegra_mcerr_thread(int irq, void *data)
 {
-	unsigned long count;
-
-	cancel_delayed_work(&unthrottle_prints_work);
-	count = atomic_inc_return(&error_count);
-
-	if (mcerr_throttle_enabled && count >= MAX_PRINTS) {
-		schedule_delayed_work(&unthrottle_prints_work, HZ/2);
-		if (count == MAX_PRINTS)
-			mcerr_pr("Too many MC errors; throttling prints\n");
-		mcerr_ops->clear_interrupt(irq);
-		goto exit;
-	}
-
+	/*
+	 * Always decode the fault so the per client counters stay exact,
+	 * printing is left to mcerr_report_fn().
+	 */
+	mcerr_report_begin();
 	mcerr_ops->log_mcerr_fault(irq);
-exit:
+	mcerr_report_end();
+
 	mcerr_ops->enable_interrupt(irq);
 
 	return IRQ_HANDLED;
@@ -176,7 +377,7 @@ static int __get_throttle(void *data, u64 *val)
 
 static int __set_throttle(void *data, u64 val)
 {
-	atomic_set(&error_count, 0);
+	mcerr_window_prints = 0;
 
 	mcerr_throttle_enabled = (bool) val;
 	return 0;
@@ -184,6 +385,55 @@ static int __set_throttle(void *data, u64 val)
 DEFINE_SIMPLE_ATTRIBUTE(mcerr_throttle_debugfs_fops, __get_throttle,
 			__set_throttle, "%llu\n");
 
+/*
+ * Show the kept reports. Writing anything clears them so that the next
+ * mcerr_keep_reports errors are kept.
+ */
+static int mcerr_reports_show(struct seq_file *s, void *v)
+{
+	const struct mcerr_report *rep;
+	unsigned int i;
+
+	seq_printf(s, "errors: %u printed: %u suppressed: %u dropped: %u\n",
+		   atomic_read(&mcerr_nr_errors), mcerr_nr_printed,
+		   mcerr_nr_suppressed, atomic_read(&mcerr_nr_dropped));
+
+	mutex_lock(&mcerr_kept_lock);
+	for (i = 0; i < mcerr_nr_kept; i++) {
+		rep = &mcerr_kept[i];
+		seq_printf(s, "\n[%llu.%06llu]\n%.*s",
+			   div_u64(rep->time, NSEC_PER_SEC),
+			   div_u64(rep->time % NSEC_PER_SEC, NSEC_PER_USEC),
+			   rep->len, rep->buf);
+	}
+	mutex_unlock(&mcerr_kept_lock);
+
+	return 0;
+}
+
+static int mcerr_reports_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mcerr_reports_show, NULL);
+}
+
+static ssize_t mcerr_reports_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *pos)
+{
+	mutex_lock(&mcerr_kept_lock);
+	mcerr_nr_kept = 0;
+	mutex_unlock(&mcerr_kept_lock);
+
+	return count;
+}
+
+static const struct file_operations mcerr_reports_debugfs_fops = {
+	.open           = mcerr_reports_open,
+	.read           = seq_read,
+	.write          = mcerr_reports_write,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 int tegra_mcerr_init(struct dentry *mc_parent, struct platform_device *pdev)
 {
 	int irq;
@@ -241,6 +491,13 @@ int tegra_mcerr_init(struct dentry *mc_parent, struct platform_device *pdev)
 		goto done;
 	}
 
+	mcerr_summary_counts = kcalloc(mcerr_ops->nr_clients *
+				       MC_MAX_INTR_COUNT,
+				       sizeof(*mcerr_summary_counts),
+				       GFP_KERNEL);
+	if (!mcerr_summary_counts)
+		pr_warn("no memory for error summaries\n");
+
 	mc_int_mask = be32_to_cpup(prop);
 	/* clear any mc-err's that occured before. */
 	mcerr_ops->clear_interrupt(irq);
@@ -269,6 +526,12 @@ int tegra_mcerr_init(struct dentry *mc_parent, struct platform_device *pdev)
 			    mcerr_debugfs_dir, NULL,
 			    &mcerr_throttle_debugfs_fops);
 	debugfs_create_u32("quiet", 0644, mcerr_debugfs_dir, &mcerr_silenced);
+	debugfs_create_file("mcerr_reports", 0644, mcerr_debugfs_dir, NULL,
+			    &mcerr_reports_debugfs_fops);
+	debugfs_create_u32("mcerr_keep_reports", 0644, mcerr_debugfs_dir,
+			   &mcerr_keep_reports);
+	debugfs_create_u32("mcerr_ratelimit_ms", 0644, mcerr_debugfs_dir,
+			   &mcerr_ratelimit_ms);
 done:
 	return 0;
 fail:
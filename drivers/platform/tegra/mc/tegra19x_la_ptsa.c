@@ -16,9 +16,19 @@
 #include <linux/printk.h>
 #include <linux/io.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/tegra-mce.h>
 #include "tegra19x_la_ptsa.h"
 #include <linux/platform/tegra/mc.h>
+#include <linux/platform/tegra/emc_bwmgr.h>
+#include <linux/platform/tegra/actmon_common.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/la_ptsa.h>
 
 #define FIX_PT(x, y, err) fixed_point_init(x, y, 32, 32, err)
 
@@ -358,6 +368,306 @@ static void save_ptsa(void)
 }
 #undef T19X_SAVE_PTSA_MIN_MAX_RATE
 
+/*
+ * Non-ISO PTSA rebalancing.
+ *
+ * While central actmon reports the MC as busy, the PTSA rates of the non-ISO
+ * CPU and DLA DDAs are shifted towards whichever group asks for the most
+ * bandwidth. CPU and GPU demand comes from their bwmgr requests, DLA demand
+ * from the dynamic LA/PTSA requests of its DDAs. GPU has no DDA on T19x, its
+ * demand only shrinks the share of the others. The rebalanced rates never add
+ * up to more than the baseline programmed at init or by the last explicit
+ * request, and ISO DDAs are never touched, so ISO guarantees stay intact.
+ */
+enum t19x_niso_group {
+	T19X_NISO_CPU,
+	T19X_NISO_GPU,
+	T19X_NISO_DLA,
+	T19X_NISO_GROUPS,
+};
+
+static const enum tegra_dda_id t19x_niso_cpu_ddas[] = {
+	TEGRA_DDA_MLL_MPCORER_ID,
+};
+
+static const enum tegra_dda_id t19x_niso_dla_ddas[] = {
+	TEGRA_DDA_DLA0FALPC_ID,
+	TEGRA_DDA_DLA0XA_ID,
+	TEGRA_DDA_DLA0XA2_ID,
+	TEGRA_DDA_DLA0XA3_ID,
+	TEGRA_DDA_DLA1FALPC_ID,
+	TEGRA_DDA_DLA1XA_ID,
+	TEGRA_DDA_DLA1XA2_ID,
+	TEGRA_DDA_DLA1XA3_ID,
+};
+
+static const enum tegra_bwmgr_client_id t19x_niso_cpu_clients[] = {
+	TEGRA_BWMGR_CLIENT_CPU_CLUSTER_0,
+	TEGRA_BWMGR_CLIENT_CPU_CLUSTER_1,
+	TEGRA_BWMGR_CLIENT_CPU_CLUSTER_2,
+	TEGRA_BWMGR_CLIENT_CPU_CLUSTER_3,
+};
+
+static const enum tegra_bwmgr_client_id t19x_niso_gpu_clients[] = {
+	TEGRA_BWMGR_CLIENT_GPU,
+};
+
+struct t19x_niso_group_info {
+	const char *name;
+	const enum tegra_dda_id *ddas;
+	int num_ddas;
+	/* no clients: demand is the sum of the DDA requests */
+	const enum tegra_bwmgr_client_id *clients;
+	int num_clients;
+	unsigned long demand_mbps;
+	unsigned int scale_pct;
+};
+
+static struct t19x_niso_group_info t19x_niso_groups[T19X_NISO_GROUPS] = {
+	[T19X_NISO_CPU] = {
+		.name = "cpu",
+		.ddas = t19x_niso_cpu_ddas,
+		.num_ddas = ARRAY_SIZE(t19x_niso_cpu_ddas),
+		.clients = t19x_niso_cpu_clients,
+		.num_clients = ARRAY_SIZE(t19x_niso_cpu_clients),
+		.scale_pct = 100,
+	},
+	[T19X_NISO_GPU] = {
+		.name = "gpu",
+		.clients = t19x_niso_gpu_clients,
+		.num_clients = ARRAY_SIZE(t19x_niso_gpu_clients),
+		.scale_pct = 100,
+	},
+	[T19X_NISO_DLA] = {
+		.name = "dla",
+		.ddas = t19x_niso_dla_ddas,
+		.num_ddas = ARRAY_SIZE(t19x_niso_dla_ddas),
+		.scale_pct = 100,
+	},
+};
+
+struct t19x_niso_bal {
+	bool ready;
+	bool active;
+	u32 period_ms;
+	u32 busy_pct;
+	u32 min_pct;
+	u32 max_pct;
+	unsigned int load_pct;
+	unsigned long changes;
+	unsigned int req_mbps[TEGRA_DDA_MAX_ID];
+	unsigned int base_rate[TEGRA_DDA_MAX_ID];
+	unsigned int cur_rate[TEGRA_DDA_MAX_ID];
+	enum t19x_niso_group group[TEGRA_DDA_MAX_ID];
+	spinlock_t lock;
+	struct mutex enable_lock;
+	struct delayed_work work;
+};
+
+static struct t19x_niso_bal niso_bal = {
+	.period_ms = 100,
+	.busy_pct = 80,
+	.min_pct = 50,
+	.max_pct = 200,
+	.lock = __SPIN_LOCK_UNLOCKED(niso_bal.lock),
+	.enable_lock = __MUTEX_INITIALIZER(niso_bal.enable_lock),
+};
+
+static unsigned long t19x_niso_period(void)
+{
+	return msecs_to_jiffies(max_t(u32, niso_bal.period_ms, 10));
+}
+
+/* Caller holds niso_bal.lock */
+static void t19x_niso_write_rate(enum tegra_dda_id id, unsigned int scale_pct)
+{
+	struct dda_info *dda = &dda_info_array[id];
+	u64 rate;
+
+	if (!niso_bal.base_rate[id])
+		return;
+
+	rate = div_u64((u64)niso_bal.base_rate[id] * scale_pct, 100);
+	rate = clamp_t(u64, rate, 1, dda->mask);
+	if (rate == niso_bal.cur_rate[id])
+		return;
+
+#ifdef CONFIG_TRACEPOINTS
+	trace_tegra_la_niso_ptsa(dda->name,
+			t19x_niso_groups[niso_bal.group[id]].name,
+			niso_bal.base_rate[id], niso_bal.cur_rate[id],
+			(unsigned int)rate, niso_bal.load_pct);
+#endif /* CONFIG_TRACEPOINTS */
+
+	niso_bal.cur_rate[id] = rate;
+	niso_bal.changes++;
+	mc_writel(rate & dda->mask, dda->rate_reg_addr);
+}
+
+/* Caller holds niso_bal.lock */
+static void t19x_niso_program(void)
+{
+	struct t19x_niso_group_info *grp;
+	int g, i;
+
+	for (g = 0; g < T19X_NISO_GROUPS; g++) {
+		grp = &t19x_niso_groups[g];
+		for (i = 0; i < grp->num_ddas; i++)
+			t19x_niso_write_rate(grp->ddas[i], grp->scale_pct);
+	}
+}
+
+static void t19x_niso_start(void)
+{
+	struct t19x_niso_group_info *grp;
+	enum tegra_dda_id id;
+	unsigned long flags;
+	int g, i;
+
+	spin_lock_irqsave(&niso_bal.lock, flags);
+	for (g = 0; g < T19X_NISO_GROUPS; g++) {
+		grp = &t19x_niso_groups[g];
+		grp->scale_pct = 100;
+		for (i = 0; i < grp->num_ddas; i++) {
+			id = grp->ddas[i];
+			niso_bal.group[id] = g;
+			niso_bal.base_rate[id] = 0;
+			if (dda_info_array[id].iso_type != TEGRA_NISO)
+				continue;
+			niso_bal.base_rate[id] =
+				mc_readl(dda_info_array[id].rate_reg_addr) &
+				dda_info_array[id].mask;
+			niso_bal.cur_rate[id] = niso_bal.base_rate[id];
+		}
+	}
+	niso_bal.active = true;
+	spin_unlock_irqrestore(&niso_bal.lock, flags);
+
+	schedule_delayed_work(&niso_bal.work, t19x_niso_period());
+}
+
+static void t19x_niso_stop(void)
+{
+	unsigned long flags;
+	int g;
+
+	cancel_delayed_work_sync(&niso_bal.work);
+
+	spin_lock_irqsave(&niso_bal.lock, flags);
+	for (g = 0; g < T19X_NISO_GROUPS; g++)
+		t19x_niso_groups[g].scale_pct = 100;
+	t19x_niso_program();
+	niso_bal.active = false;
+	spin_unlock_irqrestore(&niso_bal.lock, flags);
+}
+
+/*
+ * A new explicit request for a balanced DDA becomes its baseline. Re-apply
+ * the current scale right away so the rates never exceed the budget.
+ */
+static void t19x_niso_update_base(enum tegra_dda_id id, unsigned int bw_mbps)
+{
+	unsigned long flags;
+
+	if (dda_info_array[id].iso_type != TEGRA_NISO)
+		return;
+
+	spin_lock_irqsave(&niso_bal.lock, flags);
+	niso_bal.req_mbps[id] = bw_mbps;
+	if (niso_bal.active && niso_bal.base_rate[id]) {
+		niso_bal.base_rate[id] = dda_info_array[id].rate &
+			dda_info_array[id].mask;
+		niso_bal.cur_rate[id] = niso_bal.base_rate[id];
+		t19x_niso_write_rate(id,
+			t19x_niso_groups[niso_bal.group[id]].scale_pct);
+	}
+	spin_unlock_irqrestore(&niso_bal.lock, flags);
+}
+
+static void t19x_niso_rebalance(struct work_struct *work)
+{
+	unsigned long bwmgr_demand[T19X_NISO_GROUPS] = { 0 };
+	unsigned long avg_khz, cur_khz, total = 0;
+	u64 gbase, budget = 0, scaled = 0;
+	struct t19x_niso_group_info *grp;
+	unsigned int load = 0;
+	unsigned long flags;
+	int active = 0;
+	bool busy;
+	int g, i;
+
+	busy = !tegra_actmon_get_load(MC_ALL, &avg_khz, &cur_khz);
+	if (busy) {
+		load = min_t(unsigned long, avg_khz * 100 / cur_khz, 100);
+		busy = load >= niso_bal.busy_pct;
+	}
+
+	/* bwmgr takes a mutex, so ask it before taking the spinlock */
+	for (g = 0; g < T19X_NISO_GROUPS; g++) {
+		grp = &t19x_niso_groups[g];
+		for (i = 0; i < grp->num_clients; i++)
+			bwmgr_demand[g] +=
+				tegra_bwmgr_get_client_demand(grp->clients[i]);
+	}
+
+	spin_lock_irqsave(&niso_bal.lock, flags);
+	if (!niso_bal.active) {
+		spin_unlock_irqrestore(&niso_bal.lock, flags);
+		return;
+	}
+
+	niso_bal.load_pct = load;
+	for (g = 0; g < T19X_NISO_GROUPS; g++) {
+		grp = &t19x_niso_groups[g];
+		grp->demand_mbps = bwmgr_demand[g];
+		if (!grp->num_clients)
+			for (i = 0; i < grp->num_ddas; i++)
+				grp->demand_mbps +=
+					niso_bal.req_mbps[grp->ddas[i]];
+		if (grp->demand_mbps) {
+			total += grp->demand_mbps;
+			active++;
+		}
+	}
+
+	/*
+	 * Each group that reports demand gets its fair share scaled by how
+	 * far above or below it that demand is. Groups without demand keep
+	 * their baseline, and the others are cut back to fit what is left of
+	 * the baseline budget.
+	 */
+	for (g = 0; g < T19X_NISO_GROUPS; g++) {
+		grp = &t19x_niso_groups[g];
+		gbase = 0;
+		for (i = 0; i < grp->num_ddas; i++)
+			gbase += niso_bal.base_rate[grp->ddas[i]];
+
+		grp->scale_pct = 100;
+		if (busy && active > 1 && grp->demand_mbps) {
+			grp->scale_pct = clamp_t(u64,
+				div64_u64((u64)grp->demand_mbps * 100 * active,
+					total),
+				niso_bal.min_pct, niso_bal.max_pct);
+			budget += gbase * 100;
+			scaled += gbase * grp->scale_pct;
+		}
+	}
+
+	if (scaled > budget) {
+		for (g = 0; g < T19X_NISO_GROUPS; g++) {
+			grp = &t19x_niso_groups[g];
+			if (busy && active > 1 && grp->demand_mbps)
+				grp->scale_pct = div64_u64(
+					(u64)grp->scale_pct * budget, scaled);
+		}
+	}
+
+	t19x_niso_program();
+	spin_unlock_irqrestore(&niso_bal.lock, flags);
+
+	schedule_delayed_work(&niso_bal.work, t19x_niso_period());
+}
+
 static void t19x_init_ptsa(void)
 {
 	unsigned int error = 0;
@@ -387,6 +697,7 @@ static void t19x_init_ptsa(void)
 	dda_info_array[TEGRA_DDA_MLL_MPCORER_ID].max = 6;
 
 	program_kern_init_ptsa();
+	niso_bal.ready = true;
 }
 
 static void t19x_set_dynamic_ptsa(
@@ -430,6 +741,8 @@ static void t19x_set_dynamic_ptsa(
 	mc_writel(dda_info_array[id].rate &
 		dda_info_array[id].mask,
 		dda_info_array[id].rate_reg_addr);
+
+	t19x_niso_update_base(id, bw_mbps);
 }
 
 static int t19x_handle_display_la_ptsa(
@@ -974,3 +1287,100 @@ void tegra_la_get_t19x_specific(struct la_chip_specific *cs_la)
 
 	tegra_la_init();
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int t19x_niso_enable_get(void *data, u64 *val)
+{
+	*val = niso_bal.active;
+	return 0;
+}
+
+static int t19x_niso_enable_set(void *data, u64 val)
+{
+	mutex_lock(&niso_bal.enable_lock);
+	if (val && !niso_bal.active)
+		t19x_niso_start();
+	else if (!val && niso_bal.active)
+		t19x_niso_stop();
+	mutex_unlock(&niso_bal.enable_lock);
+
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(t19x_niso_enable_fops,
+	t19x_niso_enable_get, t19x_niso_enable_set, "%llu\n");
+
+static int t19x_niso_status_show(struct seq_file *s, void *unused)
+{
+	struct t19x_niso_group_info *grp;
+	enum tegra_dda_id id;
+	unsigned long flags;
+	int g, i;
+
+	spin_lock_irqsave(&niso_bal.lock, flags);
+	seq_printf(s, "active: %d, mc load: %u%%, changes: %lu\n",
+		niso_bal.active, niso_bal.load_pct, niso_bal.changes);
+	for (g = 0; g < T19X_NISO_GROUPS; g++) {
+		grp = &t19x_niso_groups[g];
+		seq_printf(s, "%-4s demand: %6lu MB/s, scale: %3u%%\n",
+			grp->name, grp->demand_mbps, grp->scale_pct);
+		for (i = 0; i < grp->num_ddas; i++) {
+			id = grp->ddas[i];
+			seq_printf(s, "  %-16s base: 0x%04x, rate: 0x%04x\n",
+				dda_info_array[id].name,
+				niso_bal.base_rate[id], niso_bal.cur_rate[id]);
+		}
+	}
+	spin_unlock_irqrestore(&niso_bal.lock, flags);
+
+	return 0;
+}
+
+static int t19x_niso_status_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, t19x_niso_status_show, inode->i_private);
+}
+
+static const struct file_operations t19x_niso_status_fops = {
+	.open = t19x_niso_status_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void t19x_niso_debugfs_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("tegra_la_niso_ptsa", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("enable", S_IRUGO | S_IWUSR, dir, NULL,
+		&t19x_niso_enable_fops);
+	debugfs_create_u32("period_ms", S_IRUGO | S_IWUSR, dir,
+		&niso_bal.period_ms);
+	debugfs_create_u32("busy_pct", S_IRUGO | S_IWUSR, dir,
+		&niso_bal.busy_pct);
+	debugfs_create_u32("min_pct", S_IRUGO | S_IWUSR, dir,
+		&niso_bal.min_pct);
+	debugfs_create_u32("max_pct", S_IRUGO | S_IWUSR, dir,
+		&niso_bal.max_pct);
+	debugfs_create_file("status", S_IRUGO, dir, NULL,
+		&t19x_niso_status_fops);
+}
+#else
+static inline void t19x_niso_debugfs_init(void) {}
+#endif /* CONFIG_DEBUG_FS */
+
+static int __init t19x_niso_bal_init(void)
+{
+	if (!niso_bal.ready)
+		return 0;
+
+	INIT_DELAYED_WORK(&niso_bal.work, t19x_niso_rebalance);
+	t19x_niso_debugfs_init();
+
+	return 0;
+}
+late_initcall(t19x_niso_bal_init);
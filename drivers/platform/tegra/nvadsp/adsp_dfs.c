@@ -28,6 +28,8 @@
 #include <linux/sched/cputime.h>
 #endif
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 #include "dev.h"
 #include "ape_actmon.h"
@@ -134,6 +136,48 @@ static struct device *device;
 
 static DEFINE_MUTEX(policy_mutex);
 
+enum adsp_dfs_reason {
+	DFS_REASON_ACTMON,
+	DFS_REASON_BUDGET,
+	DFS_REASON_FILL,
+	DFS_REASON_UNDERRUN,
+};
+
+static const char * const adsp_dfs_reason_name[] = {
+	"actmon",
+	"budget",
+	"fill",
+	"underrun",
+};
+
+/*
+ * The governor takes the highest of the actmon estimate and the sum of
+ * the cycle budgets declared by running apps, and steps one level above
+ * that when a client reports a buffer running low or an underrun.
+ */
+struct adsp_dfs_governor {
+	unsigned long actmon;	/* last actmon request in kHz */
+	unsigned long budget;	/* sum of app cycle budgets in kHz */
+	unsigned int fill;	/* lowest fill reported since last decision */
+	unsigned int low_fill;	/* fill % under which the rate steps up */
+	bool underrun;		/* underrun seen since last decision */
+	spinlock_t lock;	/* protects fill and underrun */
+	struct work_struct work;
+
+	/* stats */
+	u64 underruns;
+	u64 decisions;
+	u64 reasons[ARRAY_SIZE(adsp_dfs_reason_name)];
+	enum adsp_dfs_reason last_reason;
+	unsigned long last_target;
+};
+
+static struct adsp_dfs_governor gov = {
+	.fill = 100,
+	.low_fill = 25,
+	.lock = __SPIN_LOCK_UNLOCKED(gov.lock),
+};
+
 static bool is_os_running(struct device *dev)
 {
 	struct platform_device *pdev;
@@ -413,6 +457,134 @@ err_out:
 	return tfreq_hz / 1000;
 }
 
+/* Next rate in the table above freq_khz, in kHz */
+static unsigned long adsp_dfs_step_up(unsigned long freq_khz)
+{
+	unsigned long freq;
+	int index;
+
+	freq = adsp_get_target_freq(freq_khz * 1000, &index);
+	if (freq / 1000 <= freq_khz && index < adsp_cpu_freq_table_size - 1)
+		freq = adsp_cpu_freq_table[index + 1];
+
+	return freq / 1000;
+}
+
+/* Pick the target rate in kHz. Called with policy_mutex held. */
+static unsigned long adsp_dfs_governor_target(void)
+{
+	enum adsp_dfs_reason reason = DFS_REASON_ACTMON;
+	unsigned long target = gov.actmon;
+	unsigned long flags;
+	unsigned int fill;
+	bool underrun;
+
+	spin_lock_irqsave(&gov.lock, flags);
+	fill = gov.fill;
+	underrun = gov.underrun;
+	gov.fill = 100;
+	gov.underrun = false;
+	spin_unlock_irqrestore(&gov.lock, flags);
+
+	if (gov.budget > target) {
+		target = gov.budget;
+		reason = DFS_REASON_BUDGET;
+	}
+
+	if (underrun || fill < gov.low_fill) {
+		target = adsp_dfs_step_up(max(target, policy->cur));
+		reason = underrun ? DFS_REASON_UNDERRUN : DFS_REASON_FILL;
+	}
+
+	if (target < policy->min)
+		target = policy->min;
+	else if (target > policy->max)
+		target = policy->max;
+
+	gov.decisions++;
+	gov.reasons[reason]++;
+	gov.last_reason = reason;
+	gov.last_target = target;
+
+	return target;
+}
+
+/* Re-run the governor with the last actmon estimate */
+static void adsp_dfs_governor_update(void)
+{
+	struct nvadsp_drv_data *drv;
+	unsigned long freq;
+
+	if (!policy || !policy->enable || !is_os_running(device))
+		return;
+
+	drv = dev_get_drvdata(device);
+	if (!drv->dfs_initialized)
+		return;
+
+	freq = update_freq(adsp_dfs_governor_target());
+	if (freq)
+		policy->cur = freq;
+}
+
+static void adsp_dfs_governor_work(struct work_struct *work)
+{
+	mutex_lock(&policy_mutex);
+	adsp_dfs_governor_update();
+	mutex_unlock(&policy_mutex);
+}
+
+/*
+ * Account for an app cycle budget changing from old_khz to new_khz. A
+ * higher budget is applied right away, a lower one on the next actmon
+ * sample.
+ */
+void adsp_dfs_set_budget(unsigned long old_khz, unsigned long new_khz)
+{
+	mutex_lock(&policy_mutex);
+	gov.budget -= min(gov.budget, old_khz);
+	gov.budget += new_khz;
+	if (policy && gov.budget > policy->cur)
+		adsp_dfs_governor_update();
+	mutex_unlock(&policy_mutex);
+}
+EXPORT_SYMBOL(adsp_dfs_set_budget);
+
+/*
+ * Report how full, in percent, a buffer the ADSP must keep from draining
+ * is. The lowest level seen between two decisions is used.
+ */
+void adsp_dfs_report_fill(unsigned int fill_pct)
+{
+	unsigned long flags;
+	bool low;
+
+	spin_lock_irqsave(&gov.lock, flags);
+	if (fill_pct < gov.fill)
+		gov.fill = fill_pct;
+	low = gov.fill < gov.low_fill;
+	spin_unlock_irqrestore(&gov.lock, flags);
+
+	if (low && policy)
+		schedule_work(&gov.work);
+}
+EXPORT_SYMBOL(adsp_dfs_report_fill);
+
+/* Report a missed deadline, the rate steps up without waiting on actmon */
+void adsp_dfs_report_underrun(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&gov.lock, flags);
+	gov.underrun = true;
+	gov.underruns++;
+	spin_unlock_irqrestore(&gov.lock, flags);
+
+	if (policy)
+		schedule_work(&gov.work);
+}
+EXPORT_SYMBOL(adsp_dfs_report_underrun);
+
 /* Set adsp dfs policy min freq(Khz) */
 static int policy_min_set(void *data, u64 val)
 {
@@ -617,6 +789,38 @@ static void dump_stats_table(struct seq_file *s, struct adsp_freq_stats *fstats)
 	mutex_unlock(&policy_mutex);
 }
 
+static int governor_show(struct seq_file *s, void *data)
+{
+	int i;
+
+	mutex_lock(&policy_mutex);
+	seq_printf(s, "actmon(kHz): %lu\n", gov.actmon);
+	seq_printf(s, "budget(kHz): %lu\n", gov.budget);
+	seq_printf(s, "fill(%%): %u\n", gov.fill);
+	seq_printf(s, "underruns: %llu\n", gov.underruns);
+	seq_printf(s, "decisions: %llu\n", gov.decisions);
+	for (i = 0; i < ARRAY_SIZE(adsp_dfs_reason_name); i++)
+		seq_printf(s, "  %s: %llu\n", adsp_dfs_reason_name[i],
+			   gov.reasons[i]);
+	seq_printf(s, "last: %s %lu kHz\n",
+		   adsp_dfs_reason_name[gov.last_reason], gov.last_target);
+	mutex_unlock(&policy_mutex);
+
+	return 0;
+}
+
+static int governor_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, governor_show, inode->i_private);
+}
+
+static const struct file_operations governor_fops = {
+	.open = governor_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int show_time_in_state(struct seq_file *s, void *data)
 {
 	struct adsp_freq_stats *fstats =
@@ -679,6 +883,15 @@ static int adsp_dfs_debugfs_init(struct platform_device *pdev)
 	if (!d)
 		goto err_out;
 
+	d = debugfs_create_file("governor", RO_MODE, root, NULL,
+		&governor_fops);
+	if (!d)
+		goto err_out;
+
+	d = debugfs_create_u32("low_fill_pct", RW_MODE, root, &gov.low_fill);
+	if (!d)
+		goto err_out;
+
 	return 0;
 
 err_out:
@@ -699,17 +912,13 @@ void adsp_cpu_set_rate(unsigned long freq)
 {
 	mutex_lock(&policy_mutex);
 
+	gov.actmon = freq;
 	if (!policy->enable) {
 		dev_dbg(device, "adsp dfs policy is not enabled\n");
 		goto exit_out;
 	}
 
-	if (freq < policy->min)
-		freq = policy->min;
-	else if (freq > policy->max)
-		freq = policy->max;
-
-	freq = update_freq(freq);
+	freq = update_freq(adsp_dfs_governor_target());
 	if (freq)
 		policy->cur = freq;
 exit_out:
@@ -810,6 +1019,7 @@ int adsp_dfs_core_init(struct platform_device *pdev)
 		return 0;
 
 	device = &pdev->dev;
+	INIT_WORK(&gov.work, adsp_dfs_governor_work);
 	policy = &dfs_policy;
 
 	/* Set up adsp cpu freq table as per chip */
@@ -870,6 +1080,8 @@ int adsp_dfs_core_exit(struct platform_device *pdev)
 	if (!drv->dfs_initialized)
 		return -ENODEV;
 
+	cancel_work_sync(&gov.work);
+
 	ret = nvadsp_mbox_close(&policy->mbox);
 	if (ret)
 		dev_info(&pdev->dev,
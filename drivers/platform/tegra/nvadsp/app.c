@@ -797,6 +797,9 @@ static void delete_app_instance(nvadsp_app_info_t *app)
 	list_del(&app->node);
 	mutex_unlock(&ser->lock);
 
+	if (app->cycle_budget)
+		adsp_dfs_set_budget(app->cycle_budget, 0);
+
 	/* free instance memory */
 	free_instance_memory(app, ser->mem_size);
 	kfree(app->priv);
@@ -832,6 +835,30 @@ int nvadsp_app_deinit(nvadsp_app_info_t *app)
 }
 EXPORT_SYMBOL(nvadsp_app_deinit);
 
+/*
+ * Declare the ADSP cycles, in KHz, the app instance needs to meet its
+ * deadlines. The DFS governor keeps the ADSP at or above the sum of the
+ * budgets of all instances until they are changed or the app exits.
+ */
+int nvadsp_app_set_cycle_budget(nvadsp_app_info_t *app, uint32_t khz)
+{
+	struct nvadsp_app_service *ser;
+
+	if (IS_ERR_OR_NULL(app))
+		return -EINVAL;
+
+	ser = (struct nvadsp_app_service *)app->handle;
+	mutex_lock(&ser->lock);
+	if (app->cycle_budget != khz) {
+		adsp_dfs_set_budget(app->cycle_budget, khz);
+		app->cycle_budget = khz;
+	}
+	mutex_unlock(&ser->lock);
+
+	return 0;
+}
+EXPORT_SYMBOL(nvadsp_app_set_cycle_budget);
+
 int nvadsp_app_stop(nvadsp_app_info_t *app)
 {
 	return -ENOENT;
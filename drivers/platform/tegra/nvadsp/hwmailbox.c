@@ -158,6 +158,40 @@ status_t nvadsp_hwmbox_send_data(uint16_t mid, uint32_t data, uint32_t flags)
 	return ret;
 }
 
+/*
+ * Send as many of the count words as fit in the send queue, taking the
+ * lock once. Returns the number of words accepted.
+ */
+int nvadsp_hwmbox_send_vec(uint16_t mid, const uint32_t *data,
+			   unsigned int count, uint32_t flags)
+{
+	struct hwmbox_queue *queue = &nvadsp_drv_data->hwmbox_send_queue;
+	unsigned long lockflags;
+	unsigned int i;
+	uint32_t msg;
+
+	spin_lock_irqsave(&queue->lock, lockflags);
+
+	for (i = 0; i < count; i++) {
+		msg = data[i];
+		if (flags & NVADSP_MBOX_SMSG)
+			msg = PREPARE_HWMBOX_SMSG(mid, msg);
+
+		if (!is_hwmbox_busy) {
+			is_hwmbox_busy = true;
+#ifdef CONFIG_MBOX_ACK_HANDLER
+			hwmbox_last_msg = msg;
+#endif
+			hwmbox_writel(msg, send_hwmbox());
+		} else if (hwmboxq_enqueue(queue, msg)) {
+			break;
+		}
+	}
+
+	spin_unlock_irqrestore(&queue->lock, lockflags);
+	return i;
+}
+
 /* Must be called with queue lock held in non-interrupt context */
 static status_t hwmboxq_dequeue(struct hwmbox_queue *queue,
 					    uint32_t *data)
@@ -108,6 +108,7 @@ u32 hwmbox_readl(u32 reg);
 void hwmbox_writel(u32 val, u32 reg);
 int nvadsp_hwmbox_init(struct platform_device *);
 status_t nvadsp_hwmbox_send_data(uint16_t, uint32_t, uint32_t);
+int nvadsp_hwmbox_send_vec(uint16_t, const uint32_t *, unsigned int, uint32_t);
 void dump_mailbox_regs(void);
 
 int nvadsp_setup_hwmbox_interrupts(struct platform_device *pdev);
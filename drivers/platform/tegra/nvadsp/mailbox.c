@@ -25,23 +25,26 @@ static struct nvadsp_mbox *nvadsp_mboxes[NVADSP_MAILBOX_MAX];
 static DECLARE_BITMAP(nvadsp_mbox_ids, NVADSP_MAILBOX_MAX);
 static struct nvadsp_drv_data *nvadsp_drv_data;
 
+static inline uint16_t mboxq_count(struct nvadsp_mbox_queue *queue)
+{
+	return (uint16_t)(READ_ONCE(queue->tail) - READ_ONCE(queue->head));
+}
+
 static inline bool is_mboxq_empty(struct nvadsp_mbox_queue *queue)
 {
-	return (queue->count == 0);
+	return (mboxq_count(queue) == 0);
 }
 
 static inline bool is_mboxq_full(struct nvadsp_mbox_queue *queue)
 {
-	return (queue->count == NVADSP_MBOX_QUEUE_SIZE);
+	return (mboxq_count(queue) == NVADSP_MBOX_QUEUE_SIZE);
 }
 
 static void mboxq_init(struct nvadsp_mbox_queue *queue)
 {
 	queue->head = 0;
 	queue->tail = 0;
-	queue->count = 0;
-	init_completion(&queue->comp);
-	spin_lock_init(&queue->lock);
+	init_waitqueue_head(&queue->wait);
 }
 
 static void mboxq_destroy(struct nvadsp_mbox_queue *queue)
@@ -51,29 +54,23 @@ static void mboxq_destroy(struct nvadsp_mbox_queue *queue)
 
 	queue->head = 0;
 	queue->tail = 0;
-	queue->count = 0;
 }
 
+/* Producer side, only called from the mailbox receive interrupt */
 static status_t mboxq_enqueue(struct nvadsp_mbox_queue *queue,
 				   uint32_t data)
 {
-	unsigned long flags;
-	int ret = 0;
+	uint16_t tail = queue->tail;
 
-	if (is_mboxq_full(queue)) {
-		ret = -EINVAL;
-		goto out;
-	}
-	spin_lock_irqsave(&queue->lock, flags);
-	if (is_mboxq_empty(queue))
-		complete_all(&queue->comp);
-
-	queue->array[queue->tail] = data;
-	queue->tail = (queue->tail + 1) & NVADSP_MBOX_QUEUE_SIZE_MASK;
-	queue->count++;
-	spin_unlock_irqrestore(&queue->lock, flags);
- out:
-	return ret;
+	if (is_mboxq_full(queue))
+		return -EINVAL;
+
+	queue->array[tail & NVADSP_MBOX_QUEUE_SIZE_MASK] = data;
+	/* publish the slot before the new tail */
+	smp_store_release(&queue->tail, tail + 1);
+	wake_up(&queue->wait);
+
+	return 0;
 }
 
 status_t nvadsp_mboxq_enqueue(struct nvadsp_mbox_queue *queue,
@@ -82,55 +79,47 @@ status_t nvadsp_mboxq_enqueue(struct nvadsp_mbox_queue *queue,
 	return mboxq_enqueue(queue, data);
 }
 
-static status_t mboxq_dequeue(struct nvadsp_mbox_queue *queue,
-					  uint32_t *data)
+/* Consumer side, takes up to count words, returns how many it got */
+static unsigned int mboxq_dequeue_vec(struct nvadsp_mbox_queue *queue,
+				      uint32_t *data, unsigned int count)
 {
-	unsigned long flags;
-	int ret = 0;
+	uint16_t head = queue->head;
+	uint16_t tail = smp_load_acquire(&queue->tail);
+	unsigned int n = 0;
 
-	spin_lock_irqsave(&queue->lock, flags);
-	if (is_mboxq_empty(queue)) {
-		ret = -EBUSY;
-		goto comp;
+	while (n < count && head != tail) {
+		data[n++] = queue->array[head & NVADSP_MBOX_QUEUE_SIZE_MASK];
+		head++;
 	}
+	/* the slots are free again only once they have been read */
+	smp_store_release(&queue->head, head);
 
-	*data = queue->array[queue->head];
-	queue->head = (queue->head + 1) & NVADSP_MBOX_QUEUE_SIZE_MASK;
-	queue->count--;
+	return n;
+}
 
-	if (is_mboxq_empty(queue))
-		goto comp;
-	else
-		goto out;
- comp:
-	reinit_completion(&queue->comp);
- out:
-	spin_unlock_irqrestore(&queue->lock, flags);
-	return ret;
+static status_t mboxq_dequeue(struct nvadsp_mbox_queue *queue,
+					  uint32_t *data)
+{
+	return mboxq_dequeue_vec(queue, data, 1) ? 0 : -EBUSY;
 }
 
 static void mboxq_dump(struct nvadsp_mbox_queue *queue)
 {
-	unsigned long flags;
 	uint16_t head, count;
 	uint32_t data;
 
-	spin_lock_irqsave(&queue->lock, flags);
-
-	count = queue->count;
+	count = mboxq_count(queue);
 	pr_info("nvadsp: queue %p count:%d\n", queue, count);
 
 	pr_info("nvadsp: queue data: ");
 	head = queue->head;
 	while (count) {
-		data = queue->array[head];
-		head = (head + 1) & NVADSP_MBOX_QUEUE_SIZE_MASK;
+		data = queue->array[head & NVADSP_MBOX_QUEUE_SIZE_MASK];
+		head++;
 		count--;
 		pr_info("0x%x ", data);
 	}
 	pr_info(" dumped\n");
-
-	spin_unlock_irqrestore(&queue->lock, flags);
 }
 
 static uint16_t nvadsp_mbox_alloc_mboxid(void)
@@ -280,8 +269,8 @@ status_t nvadsp_mbox_recv(struct nvadsp_mbox *mbox, uint32_t *data, bool block,
 
 	if (ret == -EBUSY) {
 		if (block) {
-			ret = wait_for_completion_timeout(
-					  &mbox->recv_queue.comp,
+			ret = wait_event_timeout(mbox->recv_queue.wait,
+					  !is_mboxq_empty(&mbox->recv_queue),
 					  msecs_to_jiffies(timeout));
 			if (ret) {
 				block = false;
@@ -302,6 +291,78 @@ status_t nvadsp_mbox_recv(struct nvadsp_mbox *mbox, uint32_t *data, bool block,
 }
 EXPORT_SYMBOL(nvadsp_mbox_recv);
 
+/*
+ * Queue several words for the ADSP under one lock. The hardware mailbox
+ * still carries one word per empty interrupt, but the caller no longer
+ * pays a lock and possibly a sleep for every word.
+ */
+int nvadsp_mbox_send_vec(struct nvadsp_mbox *mbox, const uint32_t *data,
+			 unsigned int count, uint32_t flags, bool block,
+			 unsigned int timeout)
+{
+	unsigned int sent = 0;
+	int ret;
+
+	if (!nvadsp_drv_data)
+		return -ENOSYS;
+
+	if (!mbox || !data)
+		return -EINVAL;
+
+	while (sent < count) {
+		ret = nvadsp_hwmbox_send_vec(mbox->id, data + sent,
+					     count - sent, flags);
+		if (ret < 0)
+			return sent ? sent : ret;
+
+		sent += ret;
+		if (sent == count)
+			break;
+		if (!block)
+			return sent ? sent : -EBUSY;
+
+		/* send queue is full, wait for the interrupt to drain it */
+		ret = wait_for_completion_timeout(
+			 &nvadsp_drv_data->hwmbox_send_queue.comp,
+			 msecs_to_jiffies(timeout));
+		if (!ret)
+			return sent ? sent : -ETIME;
+	}
+
+	return sent;
+}
+EXPORT_SYMBOL(nvadsp_mbox_send_vec);
+
+/*
+ * Drain up to count words in one call, waiting only for the first one
+ * when block is set. Only one reader per mailbox is supported.
+ */
+int nvadsp_mbox_recv_vec(struct nvadsp_mbox *mbox, uint32_t *data,
+			 unsigned int count, bool block, unsigned int timeout)
+{
+	unsigned int n;
+	long ret;
+
+	if (!nvadsp_drv_data)
+		return -ENOSYS;
+
+	if (!mbox || !data || !count)
+		return -EINVAL;
+
+	n = mboxq_dequeue_vec(&mbox->recv_queue, data, count);
+	if (n || !block)
+		return n ? n : -EBUSY;
+
+	ret = wait_event_timeout(mbox->recv_queue.wait,
+				 !is_mboxq_empty(&mbox->recv_queue),
+				 msecs_to_jiffies(timeout));
+	if (!ret)
+		return -ETIME;
+
+	return mboxq_dequeue_vec(&mbox->recv_queue, data, count);
+}
+EXPORT_SYMBOL(nvadsp_mbox_recv_vec);
+
 status_t nvadsp_mbox_close(struct nvadsp_mbox *mbox)
 {
 	unsigned long flags;
@@ -397,6 +397,23 @@ void nvadsp_free_coherent(size_t size, void *va, dma_addr_t da)
 }
 EXPORT_SYMBOL(nvadsp_free_coherent);
 
+/*
+ * Map memory from nvadsp_alloc_coherent() into user space, so clients can
+ * share a buffer with ADSP apps without staging copies. The mapping has to
+ * go through the ADSP device since that is where the IOVA lives.
+ */
+int nvadsp_mmap_coherent(struct vm_area_struct *vma, void *va,
+			 dma_addr_t da, size_t size)
+{
+	if (!priv.pdev) {
+		pr_err("ADSP Driver is not initialized\n");
+		return -ENODEV;
+	}
+
+	return dma_mmap_coherent(&priv.pdev->dev, vma, va, da, size);
+}
+EXPORT_SYMBOL(nvadsp_mmap_coherent);
+
 struct elf32_shdr *
 nvadsp_get_section(const struct firmware *fw, char *sec_name)
 {
@@ -20,8 +20,10 @@
 #include <linux/module.h>
 #include <linux/of_device.h>
 #include <linux/platform_device.h>
+#include <linux/printk.h>
 #include <linux/reboot.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
 #include <linux/uaccess.h>
 #include "nvdumper.h"
 #include "nvdumper-footprint.h"
@@ -50,6 +52,54 @@ static const struct nvdumper_soc *nvdumper_soc;
 static char nvdumper_set_str[NVDUMPER_SET_STR_LEN];
 static struct kobject *nvdumper_kobj;
 
+static struct nvdumper_manifest nvdumper_manifest = {
+	.magic = NVDUMPER_MANIFEST_MAGIC,
+	.version = NVDUMPER_MANIFEST_VERSION,
+};
+static DEFINE_SPINLOCK(nvdumper_manifest_lock);
+
+static void nvdumper_manifest_flush(void)
+{
+	if (!nvdumper_ptr)
+		return;
+
+	memcpy_toio(nvdumper_ptr + NVDUMPER_MANIFEST_OFFSET,
+		    &nvdumper_manifest, sizeof(nvdumper_manifest));
+}
+
+/*
+ * Regions may be added before nvdumper probes, they are kept here and
+ * written out to the reserved page once it is mapped.
+ */
+int nvdumper_manifest_add(const char *name, phys_addr_t addr, u64 size,
+			  u32 flags)
+{
+	struct nvdumper_manifest_entry *e;
+	unsigned long irq_flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&nvdumper_manifest_lock, irq_flags);
+	if (nvdumper_manifest.nr_entries >= NVDUMPER_MANIFEST_ENTRIES) {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	e = &nvdumper_manifest.entries[nvdumper_manifest.nr_entries++];
+	strlcpy(e->name, name, sizeof(e->name));
+	e->addr = addr;
+	e->size = size;
+	e->flags = flags;
+
+	nvdumper_manifest_flush();
+out:
+	spin_unlock_irqrestore(&nvdumper_manifest_lock, irq_flags);
+
+	if (ret)
+		pr_err("nvdumper: no manifest slot for %s\n", name);
+	return ret;
+}
+EXPORT_SYMBOL(nvdumper_manifest_add);
+
 static int __init tegra_nvdumper_arg(char *options)
 {
 	char *p = options;
@@ -239,6 +289,12 @@ static int nvdumper_probe(struct platform_device *pdev)
 
 	nvdumper_dbg_footprint_init();
 
+	nvdumper_manifest_add("dmesg", virt_to_phys(log_buf_addr_get()),
+			      log_buf_len_get(), NVDUMPER_REGION_COMP_NONE);
+	spin_lock_irq(&nvdumper_manifest_lock);
+	nvdumper_manifest_flush();
+	spin_unlock_irq(&nvdumper_manifest_lock);
+
 	nvdumper_last_reboot = get_dirty_state();
 	switch (nvdumper_last_reboot) {
 	case NVDUMPER_CLEAN:
@@ -17,6 +17,55 @@
 #ifndef __PLATFORM_TEGRA_NVDUMPER_H
 #define __PLATFORM_TEGRA_NVDUMPER_H
 
+#include <linux/types.h>
+
+/*
+ * Manifest of the memory regions worth pulling out of a RAM dump. It
+ * lives in the upper half of the nvdumper reserved page so the dump tool
+ * can fetch these regions alone instead of the whole DRAM image.
+ */
+#define NVDUMPER_MANIFEST_OFFSET	2048
+#define NVDUMPER_MANIFEST_MAGIC		0x464e4d4eU	/* "NMNF" */
+#define NVDUMPER_MANIFEST_VERSION	1
+#define NVDUMPER_MANIFEST_ENTRIES	16
+#define NVDUMPER_MANIFEST_NAME_LEN	16
+
+/* Region content is already compressed, the method is in the low bits */
+#define NVDUMPER_REGION_COMP_MASK	0xfU
+#define NVDUMPER_REGION_COMP_NONE	0
+#define NVDUMPER_REGION_COMP_ZLIB	1
+#define NVDUMPER_REGION_COMP_LZO	2
+#define NVDUMPER_REGION_COMP_LZ4	3
+
+struct nvdumper_manifest_entry {
+	char name[NVDUMPER_MANIFEST_NAME_LEN];
+	u64 addr;
+	u64 size;
+	u32 flags;
+	u32 reserved;
+};
+
+struct nvdumper_manifest {
+	u32 magic;
+	u32 version;
+	u32 nr_entries;
+	u32 reserved;
+	struct nvdumper_manifest_entry entries[NVDUMPER_MANIFEST_ENTRIES];
+};
+
+#ifdef CONFIG_TEGRA_NVDUMPER
+int nvdumper_manifest_add(const char *name, phys_addr_t addr, u64 size,
+			  u32 flags);
+#else
+static inline int nvdumper_manifest_add(const char *name, phys_addr_t addr,
+					u64 size, u32 flags)
+{
+	return 0;
+}
+#endif
+
+struct pt_regs;
+
 extern struct notifier_block nvdumper_panic_notifier;
 extern struct notifier_block nvdumper_die_notifier;
 
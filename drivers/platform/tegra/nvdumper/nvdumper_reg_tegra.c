@@ -316,6 +316,10 @@ int nvdumper_regdump_init(void)
 		goto clean;
 	}
 
+	nvdumper_manifest_add("regdump", nvdumper_p,
+			      sizeof(struct nvdumper_cpu_data_t) * max_cpus,
+			      NVDUMPER_REGION_COMP_NONE);
+
 	ret = register_die_notifier(&nvdumper_die_notifier);
 	if (ret != 0) {
 		pr_err("%s: registering die notifier failed with err=%d\n",
@@ -17,9 +17,19 @@
  */
 
 #include <linux/notifier.h>
+#include <linux/time64.h>
+#include <asm/arch_timer.h>
+
+/* How long a TSC to PTP correlation is trusted before sampling it again */
+#define PTP_TSC_CORRELATION_NS	(100 * NSEC_PER_MSEC)
 
 static u64 (*get_systime)(void *);
 static void *param;
+
+/* PTP time minus TSC time, and the TSC time it was sampled at */
+static s64 ptp_tsc_offset;
+static u64 ptp_tsc_sampled;
+static bool ptp_tsc_valid;
 static DEFINE_RAW_SPINLOCK(ptp_notifier_lock);
 static ATOMIC_NOTIFIER_HEAD(tegra_hwtime_chain_head);
 
@@ -52,6 +62,7 @@ void tegra_register_hwtime_source(u64 (*func)(void *), void *data)
 	raw_spin_lock_irqsave(&ptp_notifier_lock, flags);
 	get_systime = func;
 	param = data;
+	ptp_tsc_valid = false;
 	raw_spin_unlock_irqrestore(&ptp_notifier_lock, flags);
 
 	/* Notify HW time stamp update to registered clients.
@@ -69,6 +80,7 @@ void tegra_unregister_hwtime_source(void)
 	raw_spin_lock_irqsave(&ptp_notifier_lock, flags);
 	get_systime = NULL;
 	param = NULL;
+	ptp_tsc_valid = false;
 	raw_spin_unlock_irqrestore(&ptp_notifier_lock, flags);
 }
 EXPORT_SYMBOL(tegra_unregister_hwtime_source);
@@ -88,3 +100,46 @@ int get_ptp_hwtime(u64 *ns)
 	return ret;
 }
 EXPORT_SYMBOL(get_ptp_hwtime);
+
+static u64 ptp_tsc_ns(u64 ticks)
+{
+	return ticks * (NSEC_PER_SEC / arch_timer_get_cntfrq());
+}
+
+/*
+ * Sample the TSC on both sides of the PTP read and take the midpoint, so
+ * that the correlation error is half the time the PTP read takes.
+ */
+static void ptp_tsc_correlate_locked(void)
+{
+	u64 before, after, ptp;
+
+	before = arch_counter_get_cntvct();
+	ptp = get_systime(param);
+	after = arch_counter_get_cntvct();
+
+	ptp_tsc_sampled = ptp_tsc_ns(before + (after - before) / 2);
+	ptp_tsc_offset = (s64)(ptp - ptp_tsc_sampled);
+	ptp_tsc_valid = true;
+}
+
+int get_ptp_hwtime_from_tsc(u64 tsc_ns, u64 *ns)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	raw_spin_lock_irqsave(&ptp_notifier_lock, flags);
+	if (get_systime) {
+		u64 now = ptp_tsc_ns(arch_counter_get_cntvct());
+
+		if (!ptp_tsc_valid ||
+		    now - ptp_tsc_sampled > PTP_TSC_CORRELATION_NS)
+			ptp_tsc_correlate_locked();
+		*ns = (u64)((s64)tsc_ns + ptp_tsc_offset);
+	} else
+		ret = -EINVAL;
+	raw_spin_unlock_irqrestore(&ptp_notifier_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL(get_ptp_hwtime_from_tsc);
@@ -18,7 +18,10 @@
 
 #include <linux/tegra-capture-ivc.h>
 
+#include <linux/bitmap.h>
 #include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/kfifo.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/of.h>
@@ -26,6 +29,8 @@
 #include <linux/tegra-ivc.h>
 #include <linux/tegra-ivc-bus.h>
 #include <linux/nospec.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <asm/barrier.h>
 
@@ -38,10 +43,27 @@
 #define TOTAL_CHANNELS (NUM_CAPTURE_CHANNELS + NUM_CAPTURE_TRANSACTION_IDS)
 #define TRANS_ID_START_IDX NUM_CAPTURE_CHANNELS
 
+/*
+ * The IVC worker looks up callbacks without taking cb_ctx_lock, which only
+ * serializes the registration paths. A context is published by writing
+ * priv_context before cb_func, and cb_func is cleared first on teardown.
+ */
+/* A received frame handed to a channel, still in place in the IVC */
+struct tegra_capture_ivc_frame {
+	const void *msg;
+	uint32_t slot;
+};
+
 struct tegra_capture_ivc_cb_ctx {
 	struct list_head node;
 	tegra_capture_ivc_cb_func cb_func;
 	const void *priv_context;
+
+	/* Per-channel dispatch of capture status, see tegra_capture_ivc_queue */
+	struct tegra_capture_ivc *civc;
+	struct work_struct work;
+	DECLARE_KFIFO_PTR(frames, struct tegra_capture_ivc_frame);
+	int cpu;
 };
 
 struct tegra_capture_ivc {
@@ -53,6 +75,12 @@ struct tegra_capture_ivc {
 	struct tegra_capture_ivc_cb_ctx cb_ctx[TOTAL_CHANNELS];
 	spinlock_t avl_ctx_list_lock;
 	struct list_head avl_ctx_list;
+	struct workqueue_struct *dispatch_wq;	/* NULL to dispatch inline */
+
+	/* Frames read but not yet released, see tegra_capture_ivc_release */
+	unsigned long *rx_done;
+	uint32_t rx_head;
+	uint32_t rx_pending;
 };
 
 /*
@@ -180,8 +208,9 @@ int tegra_capture_ivc_register_control_cb(
 	}
 
 	*trans_id = (uint32_t)ctx_id;
-	cb_ctx->cb_func = control_resp_cb;
 	cb_ctx->priv_context = priv_context;
+	smp_wmb();
+	WRITE_ONCE(cb_ctx->cb_func, control_resp_cb);
 
 	mutex_unlock(&civc->cb_ctx_lock);
 
@@ -227,12 +256,14 @@ int tegra_capture_ivc_notify_chan_id(uint32_t chan_id, uint32_t trans_id)
 	}
 
 	/* Update cb_ctx index */
-	civc->cb_ctx[chan_id].cb_func = civc->cb_ctx[trans_id].cb_func;
 	civc->cb_ctx[chan_id].priv_context =
 			civc->cb_ctx[trans_id].priv_context;
+	smp_wmb();
+	WRITE_ONCE(civc->cb_ctx[chan_id].cb_func,
+			civc->cb_ctx[trans_id].cb_func);
 
 	/* Reset trans_id cb_ctx fields */
-	civc->cb_ctx[trans_id].cb_func = NULL;
+	WRITE_ONCE(civc->cb_ctx[trans_id].cb_func, NULL);
 	civc->cb_ctx[trans_id].priv_context = NULL;
 
 	mutex_unlock(&civc->cb_ctx_lock);
@@ -277,8 +308,9 @@ int tegra_capture_ivc_register_capture_cb(
 		goto fail;
 	}
 
-	civc->cb_ctx[chan_id].cb_func = capture_status_ind_cb;
 	civc->cb_ctx[chan_id].priv_context = priv_context;
+	smp_wmb();
+	WRITE_ONCE(civc->cb_ctx[chan_id].cb_func, capture_status_ind_cb);
 	mutex_unlock(&civc->cb_ctx_lock);
 
 	return 0;
@@ -312,7 +344,7 @@ int tegra_capture_ivc_unregister_control_cb(uint32_t id)
 		return -EBADF;
 	}
 
-	civc->cb_ctx[id].cb_func = NULL;
+	WRITE_ONCE(civc->cb_ctx[id].cb_func, NULL);
 	civc->cb_ctx[id].priv_context = NULL;
 
 	mutex_unlock(&civc->cb_ctx_lock);
@@ -356,8 +388,14 @@ int tegra_capture_ivc_unregister_capture_cb(uint32_t chan_id)
 		return -EBADF;
 	}
 
-	civc->cb_ctx[chan_id].cb_func = NULL;
+	WRITE_ONCE(civc->cb_ctx[chan_id].cb_func, NULL);
+
+	/* Let a status being delivered finish before the context goes */
+	if (civc->dispatch_wq)
+		flush_work(&civc->cb_ctx[chan_id].work);
+
 	civc->cb_ctx[chan_id].priv_context = NULL;
+	civc->cb_ctx[chan_id].cpu = WORK_CPU_UNBOUND;
 
 	mutex_unlock(&civc->cb_ctx_lock);
 
@@ -367,6 +405,123 @@ int tegra_capture_ivc_unregister_capture_cb(uint32_t chan_id)
 }
 EXPORT_SYMBOL(tegra_capture_ivc_unregister_capture_cb);
 
+int tegra_capture_ivc_capture_set_cpu(uint32_t chan_id, int cpu)
+{
+	struct tegra_capture_ivc *civc;
+
+	if (chan_id >= NUM_CAPTURE_CHANNELS)
+		return -EINVAL;
+
+	if (cpu >= 0 && (cpu >= nr_cpu_ids || !cpu_online(cpu)))
+		return -EINVAL;
+
+	if (!__scivc_capture)
+		return -ENODEV;
+
+	chan_id = array_index_nospec(chan_id, NUM_CAPTURE_CHANNELS);
+
+	civc = __scivc_capture;
+
+	WRITE_ONCE(civc->cb_ctx[chan_id].cpu, cpu < 0 ? WORK_CPU_UNBOUND : cpu);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_capture_ivc_capture_set_cpu);
+
+static void tegra_capture_ivc_invoke(struct tegra_capture_ivc_cb_ctx *cb_ctx,
+				     const void *msg)
+{
+	tegra_capture_ivc_cb_func cb_func = READ_ONCE(cb_ctx->cb_func);
+
+	if (unlikely(!cb_func))
+		return;
+
+	smp_rmb();
+	cb_func(msg, READ_ONCE(cb_ctx->priv_context));
+}
+
+/*
+ * Frames are consumed in place. Once a frame has been handed to its
+ * callback its slot is marked done, and the worker gives back the done
+ * frames at the head of the ring in one go. Frames are only ever returned
+ * to the IVC in order, so one slow channel holding a frame keeps the
+ * frames behind it, but not their delivery, from being released.
+ */
+static void tegra_capture_ivc_release(struct tegra_capture_ivc *civc)
+{
+	struct ivc *ivc = &civc->chan->ivc;
+	uint32_t n = 0;
+
+	while (civc->rx_pending &&
+	       test_and_clear_bit(civc->rx_head, civc->rx_done)) {
+		civc->rx_head = (civc->rx_head + 1) % ivc->nframes;
+		civc->rx_pending--;
+		n++;
+	}
+
+	if (n && tegra_ivc_read_advance_by(ivc, n)) {
+		/* channel was reset under us, start over */
+		civc->rx_head = 0;
+		civc->rx_pending = 0;
+		bitmap_zero(civc->rx_done, ivc->nframes);
+	}
+}
+
+static void tegra_capture_ivc_frame_done(struct tegra_capture_ivc *civc,
+					 uint32_t slot)
+{
+	/* The callback is done with the frame before it can be reused */
+	smp_mb__before_atomic();
+	set_bit(slot, civc->rx_done);
+}
+
+/*
+ * Deliver the capture status queued for one channel. Work items never
+ * run concurrently with themselves, so each fifo has a single reader and
+ * the IVC worker as its single writer, and needs no lock.
+ */
+static void tegra_capture_ivc_dispatch(struct work_struct *work)
+{
+	struct tegra_capture_ivc_cb_ctx *cb_ctx = container_of(work,
+					struct tegra_capture_ivc_cb_ctx, work);
+	struct tegra_capture_ivc *civc = cb_ctx->civc;
+	struct tegra_capture_ivc_frame frame;
+	bool done = false;
+
+	while (kfifo_get(&cb_ctx->frames, &frame)) {
+		tegra_capture_ivc_invoke(cb_ctx, frame.msg);
+		tegra_capture_ivc_frame_done(civc, frame.slot);
+		done = true;
+	}
+
+	/* let the worker give the frames back */
+	if (done)
+		schedule_work(&civc->work);
+}
+
+/*
+ * Hand a capture status to the channel it belongs to, so that a slow
+ * callback only holds up its own channel. Each fifo has room for every
+ * frame of the IVC, so it cannot overflow.
+ */
+static void tegra_capture_ivc_queue(struct tegra_capture_ivc *civc,
+				    struct tegra_capture_ivc_cb_ctx *cb_ctx,
+				    const void *msg, uint32_t slot)
+{
+	struct tegra_capture_ivc_frame frame = {
+		.msg = msg,
+		.slot = slot,
+	};
+
+	if (WARN_ON(!kfifo_put(&cb_ctx->frames, frame))) {
+		tegra_capture_ivc_invoke(cb_ctx, msg);
+		tegra_capture_ivc_frame_done(civc, slot);
+		return;
+	}
+
+	queue_work_on(READ_ONCE(cb_ctx->cpu), civc->dispatch_wq, &cb_ctx->work);
+}
+
 static void tegra_capture_ivc_worker(struct work_struct *work)
 {
 	struct tegra_capture_ivc *civc = container_of(work,
@@ -375,29 +530,88 @@ static void tegra_capture_ivc_worker(struct work_struct *work)
 
 	WARN_ON(!chan->is_ready);
 
-	while (tegra_ivc_can_read(&chan->ivc)) {
+	tegra_capture_ivc_release(civc);
+
+	for (;;) {
 		const struct tegra_capture_ivc_resp *msg =
-			tegra_ivc_read_get_next_frame(&chan->ivc);
-		uint32_t id = msg->header.channel_id;
+			tegra_ivc_read_get_frame(&chan->ivc, civc->rx_pending);
+		uint32_t slot, id;
+
+		if (IS_ERR(msg))
+			break;
+
+		slot = (civc->rx_head + civc->rx_pending) % chan->ivc.nframes;
+		civc->rx_pending++;
+
+		id = msg->header.channel_id;
 
 		/* Check if message is valid */
 		if (WARN(id >= TOTAL_CHANNELS, "Invalid rtcpu response id %u", id))
-			goto skip;
+			goto done;
 
 		id = array_index_nospec(id, TOTAL_CHANNELS);
 
 		/* Check if callback function available */
-		if (unlikely(!civc->cb_ctx[id].cb_func)) {
+		if (unlikely(!READ_ONCE(civc->cb_ctx[id].cb_func))) {
 			dev_info(&chan->dev, "No callback for id %u\n", id);
-			goto skip;
+			goto done;
+		}
+
+		if (civc->dispatch_wq && id < NUM_CAPTURE_CHANNELS) {
+			tegra_capture_ivc_queue(civc, &civc->cb_ctx[id],
+						msg, slot);
+			continue;
 		}
 
 		/* Invoke client callback.*/
-		civc->cb_ctx[id].cb_func(msg, civc->cb_ctx[id].priv_context);
+		tegra_capture_ivc_invoke(&civc->cb_ctx[id], msg);
 
-skip:
-		tegra_ivc_read_advance(&chan->ivc);
+done:
+		tegra_capture_ivc_frame_done(civc, slot);
 	}
+
+	tegra_capture_ivc_release(civc);
+}
+
+static void tegra_capture_ivc_dispatch_deinit(struct tegra_capture_ivc *civc)
+{
+	uint32_t i;
+
+	if (civc->dispatch_wq)
+		destroy_workqueue(civc->dispatch_wq);
+	civc->dispatch_wq = NULL;
+
+	for (i = 0; i < NUM_CAPTURE_CHANNELS; i++)
+		kfifo_free(&civc->cb_ctx[i].frames);
+}
+
+/* Capture status is delivered per channel, control responses stay inline */
+static int tegra_capture_ivc_dispatch_init(struct tegra_capture_ivc *civc)
+{
+	uint32_t i;
+
+	civc->dispatch_wq = alloc_workqueue("capture-ivc-status",
+					    WQ_HIGHPRI, 0);
+	if (!civc->dispatch_wq)
+		return -ENOMEM;
+
+	for (i = 0; i < NUM_CAPTURE_CHANNELS; i++) {
+		struct tegra_capture_ivc_cb_ctx *cb_ctx = &civc->cb_ctx[i];
+
+		cb_ctx->civc = civc;
+		cb_ctx->cpu = WORK_CPU_UNBOUND;
+		INIT_WORK(&cb_ctx->work, tegra_capture_ivc_dispatch);
+
+		if (kfifo_alloc(&cb_ctx->frames, civc->chan->ivc.nframes,
+				GFP_KERNEL))
+			goto fail;
+	}
+
+	return 0;
+
+fail:
+	tegra_capture_ivc_dispatch_deinit(civc);
+	return -ENOMEM;
 }
 
 static void tegra_capture_ivc_notify(struct tegra_ivc_channel *chan)
@@ -432,6 +646,11 @@ static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
 
 	civc->chan = chan;
 
+	civc->rx_done = devm_kcalloc(dev, BITS_TO_LONGS(chan->ivc.nframes),
+				     sizeof(*civc->rx_done), GFP_KERNEL);
+	if (unlikely(civc->rx_done == NULL))
+		return -ENOMEM;
+
 	mutex_init(&civc->cb_ctx_lock);
 	mutex_init(&civc->ivc_wr_lock);
 
@@ -458,6 +677,9 @@ static int tegra_capture_ivc_probe(struct tegra_ivc_channel *chan)
 	} else if (!strcmp("capture", service)) {
 		if (WARN_ON(__scivc_capture != NULL))
 			return -EEXIST;
+		ret = tegra_capture_ivc_dispatch_init(civc);
+		if (ret)
+			return ret;
 		__scivc_capture = civc;
 	} else {
 		dev_err(dev, "Unknown ivc channel %s\n", service);
@@ -473,9 +695,11 @@ static void tegra_capture_ivc_remove(struct tegra_ivc_channel *chan)
 
 	if (__scivc_control == civc)
 		__scivc_control = NULL;
-	else if (__scivc_capture == civc)
+	else if (__scivc_capture == civc) {
 		__scivc_capture = NULL;
-	else
+		cancel_work_sync(&civc->work);
+		tegra_capture_ivc_dispatch_deinit(civc);
+	} else
 		dev_WARN(&chan->dev, "Unknown ivc channel\n");
 }
 
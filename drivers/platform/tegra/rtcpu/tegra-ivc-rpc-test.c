@@ -17,6 +17,8 @@
 #include <linux/module.h>
 #include <linux/debugfs.h>
 #include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/math64.h>
 
 /*
  * RPC Self test
@@ -299,9 +301,63 @@ static void tegra_ivc_rpc_perf_test(struct tegra_ivc_channel *chan,
 
 	seq_printf(file, "  Average: %llu us\n"
 		"  Minimum: %llu us\n"
-		"  Maximum: %llu us\n",
+		"  Maximum: %llu us\n"
+		"  Throughput: %llu calls/s\n",
 		(time_all / perf_loop) / 1000,
-		time_min / 1000, time_max / 1000);
+		time_min / 1000, time_max / 1000,
+		div64_u64((u64) perf_loop * NSEC_PER_SEC, time_all ?: 1));
+}
+
+static void tegra_ivc_rpc_perf_test_batch(struct tegra_ivc_channel *chan,
+	struct seq_file *file)
+{
+	const unsigned int perf_loop = 128;
+
+	struct tegra_ivc_rpc_call_param *params;
+	uint32_t *ret_data;
+	u64 tstamp_req, diff;
+	unsigned int i;
+	int ret;
+
+	seq_puts(file, "Batched RPC calls\n");
+
+	params = kcalloc(perf_loop, sizeof(*params), GFP_KERNEL);
+	ret_data = kcalloc(perf_loop, sizeof(*ret_data), GFP_KERNEL);
+	if (params == NULL || ret_data == NULL) {
+		seq_puts(file, "  Out of memory\n");
+		goto done;
+	}
+
+	for (i = 0; i < perf_loop; ++i) {
+		params[i].request_id = TEGRA_IVC_RPC_REQ_TEST_NODATA_ACK;
+		params[i].response_id = TEGRA_IVC_RPC_RSP_RET_CODE;
+		params[i].response_len = sizeof(ret_data[i]);
+		params[i].response = &ret_data[i];
+	}
+
+	tstamp_req = sched_clock();
+	ret = tegra_ivc_rpc_call_batch(chan, params, NULL, perf_loop);
+	diff = sched_clock() - tstamp_req;
+
+	for (i = 0; ret == 0 && i < perf_loop; ++i)
+		if (ret_data[i] != TEGRA_IVC_RPC_REQ_SIGN)
+			ret = TEGRA_IVC_RPC_ERR_WRONG_RSP;
+
+	if (ret < 0) {
+		seq_printf(file, "  Test failed: %d\n", ret);
+		goto done;
+	}
+
+	seq_printf(file, "  Calls: %u\n"
+		"  Total: %llu us\n"
+		"  Average: %llu us\n"
+		"  Throughput: %llu calls/s\n",
+		perf_loop, diff / 1000, (diff / perf_loop) / 1000,
+		div64_u64((u64) perf_loop * NSEC_PER_SEC, diff ?: 1));
+
+done:
+	kfree(ret_data);
+	kfree(params);
 }
 
 /*
@@ -340,6 +396,7 @@ static int tegra_ivc_rpc_debugfs_perftest_read(
 
 	tegra_ivc_rpc_perf_test(chan, file, false);
 	tegra_ivc_rpc_perf_test(chan, file, true);
+	tegra_ivc_rpc_perf_test_batch(chan, file);
 
 	return 0;
 }
@@ -44,6 +44,14 @@
  * tegra_ivc_rpc_rx_tasklet()
  *   Instead of calling complete(), calls the callback function.
  *   Frees the tx descriptor.
+ *
+ * Batched mode.
+ *
+ * tegra_ivc_rpc_call_batch()
+ *   Sends every request of the batch asynchronously, so the peer works
+ *   on them back to back, then sleeps until the last callback or timer
+ *   has fired. Responses are matched by sequence number and may come
+ *   back in any order.
  */
 
 #include <linux/module.h>
@@ -513,6 +521,89 @@ exit:
 }
 EXPORT_SYMBOL(tegra_ivc_rpc_call);
 
+struct tegra_ivc_rpc_batch {
+	atomic_t pending;
+	struct completion done;
+};
+
+struct tegra_ivc_rpc_batch_call {
+	struct tegra_ivc_rpc_batch *batch;
+	int ret;
+};
+
+/* Software interrupt context */
+static void tegra_ivc_rpc_batch_callback(
+	int ret,
+	const struct tegra_ivc_rpc_response_frame *rsp,
+	void *param)
+{
+	struct tegra_ivc_rpc_batch_call *call = param;
+	struct tegra_ivc_rpc_batch *batch = call->batch;
+
+	/* Response payload was already copied out by the RX tasklet */
+	call->ret = ret;
+
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+int tegra_ivc_rpc_call_batch(
+	struct tegra_ivc_channel *chan,
+	const struct tegra_ivc_rpc_call_param *params,
+	int *rets, unsigned int count)
+{
+	struct tegra_ivc_rpc_batch batch;
+	struct tegra_ivc_rpc_batch_call *calls;
+	unsigned int i;
+	int ret = 0;
+
+	if (chan->rpc_priv == NULL || params == NULL || count == 0)
+		return TEGRA_IVC_RPC_ERR_PARAM;
+
+	for (i = 0; i < count; ++i)
+		if (params[i].callback != NULL)
+			return TEGRA_IVC_RPC_ERR_PARAM;
+
+	calls = kcalloc(count, sizeof(*calls), GFP_KERNEL);
+	if (calls == NULL)
+		return TEGRA_IVC_RPC_ERR_MEMORY;
+
+	/* One extra reference so that the batch cannot complete while
+	 * requests are still being sent.
+	 */
+	atomic_set(&batch.pending, 1);
+	init_completion(&batch.done);
+
+	for (i = 0; i < count; ++i) {
+		struct tegra_ivc_rpc_call_param param = params[i];
+
+		calls[i].batch = &batch;
+		param.callback = tegra_ivc_rpc_batch_callback;
+		param.callback_param = &calls[i];
+
+		atomic_inc(&batch.pending);
+		calls[i].ret = tegra_ivc_rpc_call(chan, &param);
+		if (calls[i].ret < 0)
+			atomic_dec(&batch.pending);
+	}
+
+	/* Every request sent has either its response or its timer pending */
+	if (!atomic_dec_and_test(&batch.pending))
+		wait_for_completion(&batch.done);
+
+	for (i = 0; i < count; ++i) {
+		if (rets != NULL)
+			rets[i] = calls[i].ret;
+		if (ret == 0 && calls[i].ret < 0)
+			ret = calls[i].ret;
+	}
+
+	kfree(calls);
+
+	return ret;
+}
+EXPORT_SYMBOL(tegra_ivc_rpc_call_batch);
+
 /*
  * Debugfs
  */
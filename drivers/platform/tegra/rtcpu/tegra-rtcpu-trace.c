@@ -27,11 +27,14 @@
 #include <linux/of.h>
 #include <linux/of_address.h>
 #include <linux/of_reserved_mem.h>
+#include <linux/poll.h>
 #include <linux/printk.h>
 #include <linux/seq_buf.h>
 #include <linux/slab.h>
 #include <linux/tegra-camera-rtcpu.h>
 #include <linux/tegra-rtcpu-trace.h>
+#include <linux/uaccess.h>
+#include <linux/wait.h>
 #include <linux/workqueue.h>
 #include <linux/platform_device.h>
 #include <linux/nvhost.h>
@@ -99,6 +102,10 @@ struct tegra_rtcpu_trace {
 	/* debugfs */
 	struct dentry *debugfs_root;
 
+	/* raw trace readers, see rtcpu_trace_debugfs_raw */
+	wait_queue_head_t raw_wait;
+	bool decode;
+
 	/* eventlib */
 	struct platform_device *vi_platform_device;
 	struct platform_device *isp_platform_device;
@@ -991,7 +998,8 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 	while (old_next != new_next) {
 		event = &tracer->events[old_next];
 		last_event = event;
-		rtcpu_trace_event(tracer, event);
+		if (READ_ONCE(tracer->decode))
+			rtcpu_trace_event(tracer, event);
 		tracer->n_events++;
 
 		if (++old_next == tracer->event_entries)
@@ -1000,6 +1008,8 @@ static inline void rtcpu_trace_events(struct tegra_rtcpu_trace *tracer)
 
 	tracer->event_last_idx = new_next;
 	tracer->copy_last_event = *last_event;
+
+	wake_up_interruptible(&tracer->raw_wait);
 }
 
 void tegra_rtcpu_trace_flush(struct tegra_rtcpu_trace *tracer)
@@ -1122,6 +1132,156 @@ static int rtcpu_trace_debugfs_last_event_read(
 DEFINE_SEQ_FOPS(rtcpu_trace_debugfs_last_event,
 	rtcpu_trace_debugfs_last_event_read);
 
+/*
+ * Raw trace memory for decoding in user space at full rate.
+ *
+ * mmap() maps the whole trace memory read-only: the memory header, the
+ * exception area and the event ring, at the offsets given in the header.
+ * The producer index is event_next_idx in the header.
+ *
+ * Each open file also has a consumer cursor, counted in events since
+ * boot. read() of two u64 returns the number of events produced so far
+ * and the number of events this reader has lost to the ring wrapping,
+ * blocking until there is something past the cursor unless O_NONBLOCK is
+ * set. write() of one u64 moves the cursor, and poll() reports POLLIN
+ * while the cursor is behind. Event n is at ring index n % event_entries.
+ */
+struct rtcpu_trace_raw_reader {
+	struct tegra_rtcpu_trace *tracer;
+	u64 consumed;
+};
+
+static u64 rtcpu_trace_raw_produced(struct tegra_rtcpu_trace *tracer)
+{
+	u64 produced;
+
+	mutex_lock(&tracer->lock);
+	produced = tracer->n_events;
+	mutex_unlock(&tracer->lock);
+
+	return produced;
+}
+
+static int rtcpu_trace_debugfs_raw_open(struct inode *inode,
+	struct file *file)
+{
+	struct rtcpu_trace_raw_reader *reader;
+
+	reader = kzalloc(sizeof(*reader), GFP_KERNEL);
+	if (reader == NULL)
+		return -ENOMEM;
+
+	reader->tracer = inode->i_private;
+	reader->consumed = rtcpu_trace_raw_produced(reader->tracer);
+	file->private_data = reader;
+
+	return nonseekable_open(inode, file);
+}
+
+static int rtcpu_trace_debugfs_raw_release(struct inode *inode,
+	struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t rtcpu_trace_debugfs_raw_read(struct file *file,
+	char __user *buf, size_t count, loff_t *ppos)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	struct tegra_rtcpu_trace *tracer = reader->tracer;
+	u64 cursor[2];
+	int ret;
+
+	if (count < sizeof(cursor))
+		return -EINVAL;
+
+	if (file->f_flags & O_NONBLOCK) {
+		if (rtcpu_trace_raw_produced(tracer) == reader->consumed)
+			return -EAGAIN;
+	} else {
+		ret = wait_event_interruptible(tracer->raw_wait,
+			rtcpu_trace_raw_produced(tracer) != reader->consumed);
+		if (ret)
+			return ret;
+	}
+
+	cursor[0] = rtcpu_trace_raw_produced(tracer);
+	cursor[1] = 0;
+	if (cursor[0] - reader->consumed > tracer->event_entries)
+		cursor[1] = cursor[0] - reader->consumed -
+			tracer->event_entries;
+
+	if (copy_to_user(buf, cursor, sizeof(cursor)))
+		return -EFAULT;
+
+	return sizeof(cursor);
+}
+
+static ssize_t rtcpu_trace_debugfs_raw_write(struct file *file,
+	const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	u64 consumed;
+
+	if (count != sizeof(consumed))
+		return -EINVAL;
+
+	if (copy_from_user(&consumed, buf, sizeof(consumed)))
+		return -EFAULT;
+
+	if (consumed > rtcpu_trace_raw_produced(reader->tracer))
+		return -EINVAL;
+
+	reader->consumed = consumed;
+
+	return count;
+}
+
+static unsigned int rtcpu_trace_debugfs_raw_poll(struct file *file,
+	poll_table *wait)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	struct tegra_rtcpu_trace *tracer = reader->tracer;
+
+	poll_wait(file, &tracer->raw_wait, wait);
+
+	if (rtcpu_trace_raw_produced(tracer) != reader->consumed)
+		return POLLIN | POLLRDNORM;
+
+	return 0;
+}
+
+static int rtcpu_trace_debugfs_raw_mmap(struct file *file,
+	struct vm_area_struct *vma)
+{
+	struct rtcpu_trace_raw_reader *reader = file->private_data;
+	struct tegra_rtcpu_trace *tracer = reader->tracer;
+	size_t size = vma->vm_end - vma->vm_start;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	if (vma->vm_pgoff != 0 ||
+	    size > PAGE_ALIGN(tracer->trace_memory_size))
+		return -EINVAL;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return dma_mmap_coherent(tracer->dev, vma, tracer->trace_memory,
+			tracer->dma_handle, size);
+}
+
+static const struct file_operations rtcpu_trace_debugfs_raw = {
+	.open = rtcpu_trace_debugfs_raw_open,
+	.release = rtcpu_trace_debugfs_raw_release,
+	.read = rtcpu_trace_debugfs_raw_read,
+	.write = rtcpu_trace_debugfs_raw_write,
+	.poll = rtcpu_trace_debugfs_raw_poll,
+	.mmap = rtcpu_trace_debugfs_raw_mmap,
+	.llseek = no_llseek,
+};
+
 static void rtcpu_trace_debugfs_deinit(struct tegra_rtcpu_trace *tracer)
 {
 	debugfs_remove_recursive(tracer->debugfs_root);
@@ -1150,6 +1310,16 @@ static void rtcpu_trace_debugfs_init(struct tegra_rtcpu_trace *tracer)
 	if (IS_ERR_OR_NULL(entry))
 		goto failed_create;
 
+	entry = debugfs_create_file("raw", S_IRUSR | S_IWUSR,
+	    tracer->debugfs_root, tracer, &rtcpu_trace_debugfs_raw);
+	if (IS_ERR_OR_NULL(entry))
+		goto failed_create;
+
+	entry = debugfs_create_bool("decode", S_IRUGO | S_IWUSR,
+	    tracer->debugfs_root, &tracer->decode);
+	if (IS_ERR_OR_NULL(entry))
+		goto failed_create;
+
 	return;
 
 failed_create:
@@ -1173,6 +1343,7 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 
 	tracer->dev = dev;
 	mutex_init(&tracer->lock);
+	init_waitqueue_head(&tracer->raw_wait);
 
 	/* Get the trace memory */
 	ret = rtcpu_trace_setup_memory(tracer);
@@ -1207,6 +1378,10 @@ struct tegra_rtcpu_trace *tegra_rtcpu_trace_create(struct device *dev,
 	tracer->enable_printk = of_property_read_bool(tracer->of_node,
 						NV(enable-printk));
 
+	/* events are decoded to ftrace unless left to raw readers */
+	tracer->decode = !of_property_read_bool(tracer->of_node,
+						NV(raw-only));
+
 	tracer->log_prefix = "[RTCPU]";
 	of_property_read_string(tracer->of_node, NV(log-prefix),
 				&tracer->log_prefix);
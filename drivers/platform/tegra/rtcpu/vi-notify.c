@@ -19,7 +19,9 @@
 #include <linux/tegra-camera-rtcpu.h>
 
 #include <linux/completion.h>
+#include <linux/debugfs.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/of.h>
 #include <linux/of_device.h>
@@ -43,6 +45,10 @@
 
 #define ADJUST_TS_FREQUENCY (100)
 
+/* Messages handled per worker run before yielding to other work */
+#define VI_NOTIFY_POLL_BUDGET (64)
+#define VI_NOTIFY_MAX_POLL_US (1000)
+
 struct vi_notify_req {
 	union {
 		struct {
@@ -94,6 +100,24 @@ struct tegra_ivc_vi_notify {
 	u32 adjust_ts_counter;
 	u64 ts_res_ns;
 	s64 ts_adjustment;
+
+	/*
+	 * Coalescing: once the worker runs, it keeps reading messages for up
+	 * to poll_us after the IVC has been drained, and interrupts arriving
+	 * meanwhile do not queue it again.
+	 */
+	bool polling;
+	u32 poll_budget;
+	u32 poll_us;
+	struct dentry *debugfs;
+	struct {
+		u64 irqs;
+		u64 irqs_coalesced;
+		u64 runs;
+		u64 messages;
+		u64 polled;
+		u64 budget_exhausted;
+	} stats;
 };
 
 static int tegra_ivc_vi_notify_status(struct tegra_ivc_channel *chan,
@@ -168,18 +192,58 @@ static void tegra_ivc_vi_notify_recv(struct tegra_ivc_channel *chan,
 
 static void tegra_ivc_channel_vi_notify_worker(struct work_struct *work)
 {
-	struct tegra_ivc_channel *chan;
-
-	chan = container_of(work,
-			struct tegra_ivc_vi_notify, notify_work)->chan;
+	struct tegra_ivc_vi_notify *ivn = container_of(work,
+			struct tegra_ivc_vi_notify, notify_work);
+	struct tegra_ivc_channel *chan = ivn->chan;
+	u32 budget = READ_ONCE(ivn->poll_budget);
+	u32 poll_us = min_t(u32, READ_ONCE(ivn->poll_us),
+				VI_NOTIFY_MAX_POLL_US);
+	ktime_t deadline = ktime_add_us(ktime_get(), poll_us);
+	bool drained = false;
+	u32 done = 0;
+
+	WRITE_ONCE(ivn->polling, true);
+	ivn->stats.runs++;
+
+	for (;;) {
+		while (tegra_ivc_can_read(&chan->ivc)) {
+			const void *data;
+
+			if (budget != 0 && done >= budget) {
+				ivn->stats.budget_exhausted++;
+				goto out;
+			}
+
+			data = tegra_ivc_read_get_next_frame(&chan->ivc);
+			tegra_ivc_vi_notify_recv(chan, data,
+					chan->ivc.frame_size);
+			tegra_ivc_read_advance(&chan->ivc);
+
+			if (drained)
+				ivn->stats.polled++;
+			done++;
+		}
 
-	while (tegra_ivc_can_read(&chan->ivc)) {
-		const void *data = tegra_ivc_read_get_next_frame(&chan->ivc);
-		size_t length = chan->ivc.frame_size;
+		if (poll_us == 0 || ktime_after(ktime_get(), deadline))
+			break;
 
-		tegra_ivc_vi_notify_recv(chan, data, length);
-		tegra_ivc_read_advance(&chan->ivc);
+		drained = true;
+		cpu_relax();
 	}
+
+out:
+	ivn->stats.messages += done;
+	WRITE_ONCE(ivn->polling, false);
+
+	/* Pairs with the barrier in the notify callback */
+	smp_mb();
+
+	/*
+	 * Either the budget ran out or a message came in after the last
+	 * check, with its interrupt coalesced: run again.
+	 */
+	if (tegra_ivc_can_read(&chan->ivc))
+		schedule_work(&ivn->notify_work);
 }
 
 /* Called from interrupt handler */
@@ -190,6 +254,17 @@ static void tegra_ivc_channel_vi_notify_process(struct tegra_ivc_channel *chan)
 	WARN_ON(!chan->is_ready);
 
 	wake_up(&ivn->write_q);
+
+	ivn->stats.irqs++;
+
+	/* Pairs with the barrier in the worker */
+	smp_mb();
+
+	if (READ_ONCE(ivn->polling)) {
+		ivn->stats.irqs_coalesced++;
+		return;
+	}
+
 	schedule_work(&ivn->notify_work);
 }
 
@@ -529,6 +604,33 @@ static void tegra_ivc_channel_vi_notify_ready(struct tegra_ivc_channel *chan,
 }
 
 
+static void tegra_ivc_vi_notify_debugfs_init(struct tegra_ivc_vi_notify *ivn)
+{
+	struct dentry *dir;
+
+	ivn->debugfs = dir = debugfs_create_dir("vi-notify", NULL);
+	if (IS_ERR_OR_NULL(dir)) {
+		ivn->debugfs = NULL;
+		return;
+	}
+
+	debugfs_create_u32("poll_budget", 0644, dir, &ivn->poll_budget);
+	debugfs_create_u32("poll_us", 0644, dir, &ivn->poll_us);
+
+	dir = debugfs_create_dir("stats", dir);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_u64("irqs", 0444, dir, &ivn->stats.irqs);
+	debugfs_create_u64("irqs_coalesced", 0444, dir,
+			&ivn->stats.irqs_coalesced);
+	debugfs_create_u64("runs", 0444, dir, &ivn->stats.runs);
+	debugfs_create_u64("messages", 0444, dir, &ivn->stats.messages);
+	debugfs_create_u64("polled", 0444, dir, &ivn->stats.polled);
+	debugfs_create_u64("budget_exhausted", 0444, dir,
+			&ivn->stats.budget_exhausted);
+}
+
 static int tegra_ivc_channel_vi_notify_probe(struct tegra_ivc_channel *chan)
 {
 	struct tegra_ivc_vi_notify *ivn = tegra_ivc_channel_get_drvdata(chan);
@@ -563,13 +665,17 @@ static int tegra_ivc_channel_vi_notify_probe(struct tegra_ivc_channel *chan)
 	init_waitqueue_head(&ivn->write_q);
 	init_completion(&ivn->ack);
 	INIT_WORK(&ivn->notify_work, tegra_ivc_channel_vi_notify_worker);
+	ivn->poll_budget = VI_NOTIFY_POLL_BUDGET;
 
 	tegra_ivc_channel_set_drvdata(chan, ivn);
+	tegra_ivc_vi_notify_debugfs_init(ivn);
 
 	err = vi_notify_register(&tegra_ivc_vi_notify_driver,
 		 &chan->dev, VI_NOTIFY_MAX_VI_CHANS);
-	if (err)
+	if (err) {
+		debugfs_remove_recursive(ivn->debugfs);
 		platform_device_put(ivn->vi);
+	}
 	return err;
 }
 
@@ -578,6 +684,9 @@ static void tegra_ivc_channel_vi_notify_remove(struct tegra_ivc_channel *chan)
 	struct tegra_ivc_vi_notify *ivn = tegra_ivc_channel_get_drvdata(chan);
 	struct device *dev = tegra_ivc_channel_to_camrtc_dev(chan);
 
+	debugfs_remove_recursive(ivn->debugfs);
+	cancel_work_sync(&ivn->notify_work);
+
 	if (likely(ivn->status_mem != NULL))
 		dma_free_coherent(dev,
 			ivn->status_mem_size,
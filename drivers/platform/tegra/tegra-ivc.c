@@ -200,6 +200,22 @@ static inline void ivc_advance_rx(struct ivc *ivc)
 		ivc->r_pos++;
 }
 
+static inline void ivc_advance_tx_by(struct ivc *ivc, uint32_t n)
+{
+	ACCESS_ONCE(ivc->tx_channel->w_count) =
+		ACCESS_ONCE(ivc->tx_channel->w_count) + n;
+
+	ivc->w_pos = (ivc->w_pos + n) % ivc->nframes;
+}
+
+static inline void ivc_advance_rx_by(struct ivc *ivc, uint32_t n)
+{
+	ACCESS_ONCE(ivc->rx_channel->r_count) =
+		ACCESS_ONCE(ivc->rx_channel->r_count) + n;
+
+	ivc->r_pos = (ivc->r_pos + n) % ivc->nframes;
+}
+
 static inline int ivc_check_read(struct ivc *ivc)
 {
 	/*
@@ -462,6 +478,85 @@ int tegra_ivc_read_advance(struct ivc *ivc)
 }
 EXPORT_SYMBOL(tegra_ivc_read_advance);
 
+/*
+ * Zero-copy consumers parse frames in place and release them later:
+ *
+ *	msg = tegra_ivc_read_get_frame(ivc, i);	 i-th unread frame, 0 is next
+ *	... parse or hand msg off ...
+ *	tegra_ivc_read_advance_by(ivc, n);	 release the n oldest frames
+ *
+ * A frame stays valid, and occupies its slot, until it is released, so a
+ * consumer can look ahead at several frames and release them in one go
+ * once it is done with all of them. Frames are always released in order.
+ */
+void *tegra_ivc_read_get_frame(struct ivc *ivc, uint32_t index)
+{
+	int result;
+
+	if (index >= ivc->nframes)
+		return ERR_PTR(-EINVAL);
+
+	result = ivc_check_read(ivc);
+	if (result)
+		return ERR_PTR(result);
+
+	if (ivc_channel_avail_count(ivc, ivc->rx_channel) <= index) {
+		ivc_invalidate_counter(ivc, ivc->rx_handle +
+				offsetof(struct ivc_channel_header, w_count));
+		if (ivc_channel_avail_count(ivc, ivc->rx_channel) <= index)
+			return ERR_PTR(-ENOMEM);
+	}
+
+	/*
+	 * Order observation of w_pos potentially indicating new data before
+	 * data read.
+	 */
+	ivc_rmb();
+
+	index = (ivc->r_pos + index) % ivc->nframes;
+	ivc_invalidate_frame(ivc, ivc->rx_handle, index, 0, ivc->frame_size);
+	return ivc_frame_pointer(ivc, ivc->rx_channel, index);
+}
+EXPORT_SYMBOL(tegra_ivc_read_get_frame);
+
+int tegra_ivc_read_advance_by(struct ivc *ivc, uint32_t n)
+{
+	int result;
+
+	if (!n)
+		return 0;
+
+	/*
+	 * The caller has already observed these frames through
+	 * tegra_ivc_read_get_frame(), this only catches programming errors.
+	 */
+	result = ivc_check_read(ivc);
+	if (result)
+		return result;
+
+	if (n > ivc_channel_avail_count(ivc, ivc->rx_channel))
+		return -EINVAL;
+
+	ivc_advance_rx_by(ivc, n);
+	ivc_flush_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+
+	/*
+	 * Ensure our write to r_pos occurs before our read from w_pos.
+	 */
+	ivc_mb();
+
+	/* Notify if the channel was full before, as in tegra_ivc_read_batch */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+		offsetof(struct ivc_channel_header, w_count));
+
+	if (ivc_channel_avail_count(ivc, ivc->rx_channel) + n >= ivc->nframes)
+		ivc->notify(ivc);
+
+	return 0;
+}
+EXPORT_SYMBOL(tegra_ivc_read_advance_by);
+
 static int ivc_write_frame(struct ivc *ivc, const void *buf,
 		const void __user *user_buf, size_t size)
 {
@@ -608,6 +703,140 @@ int tegra_ivc_write_advance(struct ivc *ivc)
 }
 EXPORT_SYMBOL(tegra_ivc_write_advance);
 
+/*
+ * Batched transfers move up to @nr_frames frames of @frame_len bytes each
+ * between the channel and @buf, where the frames are packed back to back.
+ * The counter is updated, flushed and (if needed) notified once for the
+ * whole batch rather than once per frame. Return the number of frames
+ * moved, or a negative error if none could be.
+ */
+int tegra_ivc_read_batch(struct ivc *ivc, void *buf, size_t frame_len,
+		unsigned int nr_frames)
+{
+	uint32_t avail, i;
+	int result;
+
+	if (frame_len > ivc->frame_size)
+		return -E2BIG;
+
+	if (!nr_frames)
+		return 0;
+
+	/* pick up everything the peer has written so far */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, w_count));
+
+	result = ivc_check_read(ivc);
+	if (result)
+		return result;
+
+	/* ivc_check_read() has ruled out an over-full channel */
+	avail = min_t(uint32_t, ivc_channel_avail_count(ivc, ivc->rx_channel),
+			ivc->nframes);
+	nr_frames = min_t(uint32_t, avail, nr_frames);
+
+	/*
+	 * Order observation of w_pos potentially indicating new data before
+	 * data read.
+	 */
+	ivc_rmb();
+
+	for (i = 0; i < nr_frames; i++) {
+		uint32_t frame = (ivc->r_pos + i) % ivc->nframes;
+
+		ivc_invalidate_frame(ivc, ivc->rx_handle, frame, 0, frame_len);
+		memcpy(buf + i * frame_len,
+			ivc_frame_pointer(ivc, ivc->rx_channel, frame),
+			frame_len);
+	}
+
+	ivc_advance_rx_by(ivc, nr_frames);
+	ivc_flush_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+
+	/*
+	 * Ensure our write to r_pos occurs before our read from w_pos.
+	 */
+	ivc_mb();
+
+	/*
+	 * Notify only if the channel was full before this batch. The available
+	 * count can only asynchronously increase, so the worst possible
+	 * side-effect will be a spurious notification.
+	 */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+		offsetof(struct ivc_channel_header, w_count));
+
+	if (ivc_channel_avail_count(ivc, ivc->rx_channel) + nr_frames >=
+			ivc->nframes)
+		ivc->notify(ivc);
+
+	return (int)nr_frames;
+}
+EXPORT_SYMBOL(tegra_ivc_read_batch);
+
+int tegra_ivc_write_batch(struct ivc *ivc, const void *buf, size_t frame_len,
+		unsigned int nr_frames)
+{
+	uint32_t space, i;
+	int result;
+
+	if (frame_len > ivc->frame_size)
+		return -E2BIG;
+
+	if (!nr_frames)
+		return 0;
+
+	/* pick up everything the peer has consumed so far */
+	ivc_invalidate_counter(ivc, ivc->tx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+
+	result = ivc_check_write(ivc);
+	if (result)
+		return result;
+
+	space = ivc->nframes - ivc_channel_avail_count(ivc, ivc->tx_channel);
+	nr_frames = min_t(uint32_t, space, nr_frames);
+
+	for (i = 0; i < nr_frames; i++) {
+		uint32_t frame = (ivc->w_pos + i) % ivc->nframes;
+		void *p = ivc_frame_pointer(ivc, ivc->tx_channel, frame);
+
+		memcpy(p, buf + i * frame_len, frame_len);
+		memset(p + frame_len, 0, ivc->frame_size - frame_len);
+		ivc_flush_frame(ivc, ivc->tx_handle, frame, 0, frame_len);
+	}
+
+	/*
+	 * Ensure that updated data is visible before the w_pos counter
+	 * indicates that it is ready.
+	 */
+	ivc_wmb();
+
+	ivc_advance_tx_by(ivc, nr_frames);
+	ivc_flush_counter(ivc, ivc->tx_handle +
+			offsetof(struct ivc_channel_header, w_count));
+
+	/*
+	 * Ensure our write to w_pos occurs before our read from r_pos.
+	 */
+	ivc_mb();
+
+	/*
+	 * Notify only if the channel was empty before this batch. The
+	 * available count can only asynchronously decrease, so the worst
+	 * possible side-effect will be a spurious notification.
+	 */
+	ivc_invalidate_counter(ivc, ivc->tx_handle +
+		offsetof(struct ivc_channel_header, r_count));
+
+	if (ivc_channel_avail_count(ivc, ivc->tx_channel) <= nr_frames)
+		ivc->notify(ivc);
+
+	return (int)nr_frames;
+}
+EXPORT_SYMBOL(tegra_ivc_write_batch);
+
 void tegra_ivc_channel_reset(struct ivc *ivc)
 {
 	ivc->tx_channel->state = ivc_state_sync;
@@ -19,7 +19,9 @@
 #include <linux/of.h>
 #include <linux/of_platform.h>
 #include <linux/interrupt.h>
+#include <linux/kfifo.h>
 #include <linux/module.h>
+#include <linux/mutex.h>
 #include <linux/reset.h>
 #include <linux/slab.h>
 #include <linux/platform_device.h>
@@ -71,6 +73,13 @@ struct tegra_hsp_sm_pair {
 #define TEGRA_HSP_SM_IE_FULL		0x4u
 #define TEGRA_HSP_SM_IE_EMPTY		0x8u
 
+/* Multiplexed mailbox message: bits 30:24 hold the channel tag */
+#define TEGRA_HSP_MUX_TAG_SHIFT		24
+#define TEGRA_HSP_MUX_TAG_MASK		0x7fu
+#define TEGRA_HSP_MUX_NR_CHANS		(TEGRA_HSP_MUX_TAG_MASK + 1)
+#define TEGRA_HSP_MUX_DATA_MASK		0xffffffu
+#define TEGRA_HSP_MUX_CHAN_DEPTH	16
+
 static void __iomem *tegra_hsp_reg(struct device *dev, u32 offset)
 {
 	struct tegra_hsp *hsp = dev_get_drvdata(dev);
@@ -517,6 +526,283 @@ bool tegra_hsp_sm_pair_is_empty(const struct tegra_hsp_sm_pair *pair)
 }
 EXPORT_SYMBOL(tegra_hsp_sm_pair_is_empty);
 
+/*
+ * Shared mailbox multiplexing: several logical channels share one SM
+ * pair. Each message carries a 7-bit channel tag and 24 bits of data.
+ * Outgoing messages are queued per channel and sent in round-robin order
+ * straight from the empty interrupt, so a busy channel cannot starve the
+ * others and a burst goes out without the caller waiting on each slot.
+ */
+struct tegra_hsp_sm_mux {
+	struct list_head node;
+	struct device *hsp_dev;
+	u32 index;
+	unsigned int refcount;
+	struct tegra_hsp_sm_pair *pair;
+	spinlock_t lock;
+	struct list_head tx_ready;
+	bool tx_busy;
+	struct tegra_hsp_sm_chan *chans[TEGRA_HSP_MUX_NR_CHANS];
+};
+
+struct tegra_hsp_sm_chan {
+	struct tegra_hsp_sm_mux *mux;
+	u8 tag;
+	tegra_hsp_sm_chan_fn notify;
+	void *data;
+	struct list_head node;
+	DECLARE_KFIFO(txq, u32, TEGRA_HSP_MUX_CHAN_DEPTH);
+};
+
+static LIST_HEAD(tegra_hsp_muxes);
+static DEFINE_MUTEX(tegra_hsp_mux_lock);
+
+/* Called with mux->lock held */
+static void tegra_hsp_sm_mux_kick(struct tegra_hsp_sm_mux *mux)
+{
+	struct tegra_hsp_sm_pair *pair;
+	struct tegra_hsp_sm_chan *chan;
+	struct device *dev;
+	u32 value;
+
+	while (!list_empty(&mux->tx_ready)) {
+		chan = list_first_entry(&mux->tx_ready,
+					struct tegra_hsp_sm_chan, node);
+		list_del_init(&chan->node);
+
+		if (!kfifo_get(&chan->txq, &value))
+			continue;
+		if (!kfifo_is_empty(&chan->txq))
+			list_add_tail(&chan->node, &mux->tx_ready);
+
+		pair = mux->pair;
+		dev = pair->dev.parent;
+		mux->tx_busy = true;
+		writel(TEGRA_HSP_SM_FULL |
+		       ((u32)chan->tag << TEGRA_HSP_MUX_TAG_SHIFT) | value,
+		       tegra_hsp_sm_reg(dev, pair->empty.index));
+		tegra_hsp_enable_per_sm_irq(dev, &pair->empty, pair->empty.irq);
+		return;
+	}
+
+	mux->tx_busy = false;
+}
+
+static u32 tegra_hsp_sm_mux_full(void *data, u32 value)
+{
+	struct tegra_hsp_sm_mux *mux = data;
+	u8 tag = (value >> TEGRA_HSP_MUX_TAG_SHIFT) & TEGRA_HSP_MUX_TAG_MASK;
+	struct tegra_hsp_sm_chan *chan = READ_ONCE(mux->chans[tag]);
+
+	if (chan == NULL) {
+		dev_warn_ratelimited(mux->hsp_dev,
+				     "sm%u: message for unknown channel %u\n",
+				     mux->index, tag);
+		return 0;
+	}
+
+	chan->notify(chan->data, value & TEGRA_HSP_MUX_DATA_MASK);
+	return 0;
+}
+
+static void tegra_hsp_sm_mux_empty(void *data, u32 value)
+{
+	struct tegra_hsp_sm_mux *mux = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&mux->lock, flags);
+	tegra_hsp_sm_mux_kick(mux);
+	spin_unlock_irqrestore(&mux->lock, flags);
+}
+
+static struct tegra_hsp_sm_mux *tegra_hsp_sm_mux_get(struct device *dev,
+						     u32 index)
+{
+	struct tegra_hsp_sm_mux *mux;
+	struct tegra_hsp_sm_pair *pair;
+
+	list_for_each_entry(mux, &tegra_hsp_muxes, node) {
+		if (mux->hsp_dev == dev && mux->index == index) {
+			mux->refcount++;
+			return mux;
+		}
+	}
+
+	mux = kzalloc(sizeof(*mux), GFP_KERNEL);
+	if (unlikely(mux == NULL))
+		return ERR_PTR(-ENOMEM);
+
+	mux->hsp_dev = dev;
+	mux->index = index;
+	mux->refcount = 1;
+	spin_lock_init(&mux->lock);
+	INIT_LIST_HEAD(&mux->tx_ready);
+	/* The empty interrupt is armed on request, let it clear this */
+	mux->tx_busy = true;
+
+	pair = tegra_hsp_sm_pair_request(dev, index, tegra_hsp_sm_mux_full,
+					 tegra_hsp_sm_mux_empty, mux);
+	if (IS_ERR(pair)) {
+		kfree(mux);
+		return ERR_CAST(pair);
+	}
+
+	mux->pair = pair;
+	list_add(&mux->node, &tegra_hsp_muxes);
+	return mux;
+}
+
+static void tegra_hsp_sm_mux_put(struct tegra_hsp_sm_mux *mux)
+{
+	if (--mux->refcount)
+		return;
+
+	list_del(&mux->node);
+	tegra_hsp_sm_pair_free(mux->pair);
+	kfree(mux);
+}
+
+/**
+ * of_tegra_hsp_sm_chan_by_name - request a channel on a multiplexed
+ * Tegra HSP shared mailbox pair from DT.
+ *
+ * @np: device node
+ * @name: mailbox pair entry name, as for of_tegra_hsp_sm_pair_by_name()
+ * @tag: channel tag agreed with the remote side
+ * @notify: called with the 24-bit payload of each message for this tag
+ * @data: passed to @notify
+ *
+ * All channels naming the same mailbox share one SM pair. The pair must
+ * not be requested directly with of_tegra_hsp_sm_pair_request().
+ */
+struct tegra_hsp_sm_chan *of_tegra_hsp_sm_chan_by_name(
+	struct device_node *np, char const *name, u8 tag,
+	tegra_hsp_sm_chan_fn notify, void *data)
+{
+	struct platform_device *pdev;
+	struct of_phandle_args smspec;
+	struct tegra_hsp_sm_mux *mux;
+	struct tegra_hsp_sm_chan *chan;
+	unsigned long flags;
+	int index, err;
+
+	if (tag > TEGRA_HSP_MUX_TAG_MASK || notify == NULL)
+		return ERR_PTR(-EINVAL);
+
+	index = of_property_match_string(np, NV(hsp-shared-mailbox-names),
+					 name);
+	err = of_parse_phandle_with_fixed_args(np, NV(hsp-shared-mailbox), 1,
+						index, &smspec);
+	if (err)
+		return ERR_PTR(err);
+
+	pdev = of_find_device_by_node(smspec.np);
+	of_node_put(smspec.np);
+	if (pdev == NULL)
+		return ERR_PTR(-EPROBE_DEFER);
+
+	chan = kzalloc(sizeof(*chan), GFP_KERNEL);
+	if (unlikely(chan == NULL)) {
+		chan = ERR_PTR(-ENOMEM);
+		goto out;
+	}
+
+	chan->tag = tag;
+	chan->notify = notify;
+	chan->data = data;
+	INIT_LIST_HEAD(&chan->node);
+	INIT_KFIFO(chan->txq);
+
+	mutex_lock(&tegra_hsp_mux_lock);
+	mux = tegra_hsp_sm_mux_get(&pdev->dev, smspec.args[0]);
+	if (IS_ERR(mux)) {
+		kfree(chan);
+		chan = ERR_CAST(mux);
+		goto out_unlock;
+	}
+
+	spin_lock_irqsave(&mux->lock, flags);
+	if (mux->chans[tag] != NULL) {
+		spin_unlock_irqrestore(&mux->lock, flags);
+		tegra_hsp_sm_mux_put(mux);
+		kfree(chan);
+		chan = ERR_PTR(-EBUSY);
+		goto out_unlock;
+	}
+	chan->mux = mux;
+	WRITE_ONCE(mux->chans[tag], chan);
+	spin_unlock_irqrestore(&mux->lock, flags);
+
+out_unlock:
+	mutex_unlock(&tegra_hsp_mux_lock);
+out:
+	platform_device_put(pdev);
+	return chan;
+}
+EXPORT_SYMBOL(of_tegra_hsp_sm_chan_by_name);
+
+/**
+ * tegra_hsp_sm_chan_free - free a multiplexed shared mailbox channel.
+ *
+ * Once this returns, @notify is not running and will not be called again.
+ * Messages still queued for transmission are dropped.
+ */
+void tegra_hsp_sm_chan_free(struct tegra_hsp_sm_chan *chan)
+{
+	struct tegra_hsp_sm_mux *mux;
+	unsigned long flags;
+
+	if (IS_ERR_OR_NULL(chan))
+		return;
+
+	mux = chan->mux;
+
+	spin_lock_irqsave(&mux->lock, flags);
+	list_del_init(&chan->node);
+	WRITE_ONCE(mux->chans[chan->tag], NULL);
+	spin_unlock_irqrestore(&mux->lock, flags);
+
+	synchronize_irq(mux->pair->full.irq);
+
+	mutex_lock(&tegra_hsp_mux_lock);
+	tegra_hsp_sm_mux_put(mux);
+	mutex_unlock(&tegra_hsp_mux_lock);
+
+	kfree(chan);
+}
+EXPORT_SYMBOL(tegra_hsp_sm_chan_free);
+
+/**
+ * tegra_hsp_sm_chan_write - queue a message on a multiplexed channel
+ *
+ * @chan: shared mailbox channel
+ * @value: payload, only the 24 low order bits are used
+ *
+ * May be called from atomic context. Returns -EAGAIN when the channel
+ * already has TEGRA_HSP_MUX_CHAN_DEPTH messages in flight.
+ */
+int tegra_hsp_sm_chan_write(struct tegra_hsp_sm_chan *chan, u32 value)
+{
+	struct tegra_hsp_sm_mux *mux = chan->mux;
+	unsigned long flags;
+	int ret = 0;
+
+	spin_lock_irqsave(&mux->lock, flags);
+	if (!kfifo_put(&chan->txq, value & TEGRA_HSP_MUX_DATA_MASK)) {
+		ret = -EAGAIN;
+		goto out;
+	}
+
+	if (list_empty(&chan->node))
+		list_add_tail(&chan->node, &mux->tx_ready);
+	if (!mux->tx_busy)
+		tegra_hsp_sm_mux_kick(mux);
+out:
+	spin_unlock_irqrestore(&mux->lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(tegra_hsp_sm_chan_write);
+
 static int tegra_hsp_suspend(struct device *dev)
 {
 	struct tegra_hsp *hsp = dev_get_drvdata(dev);
@@ -103,6 +103,7 @@ enum denver_uncore_perf_types {
 #define ARMV8_INCLUDE_EL2	(1 << 27)
 
 static struct dmce_perfmon_cnt_info denver_uncore_event[DENVER_MAX_UNCORE_CNTS];
+static DEFINE_RAW_SPINLOCK(denver_uncore_lock);
 
 static u32 mce_perfmon_rw(uint8_t command, uint8_t group, uint8_t unit,
 		   uint8_t reg, uint8_t counter, u32 *data)
@@ -138,41 +139,58 @@ static u32 mce_perfmon_rw(uint8_t command, uint8_t group, uint8_t unit,
 
 static inline int get_ctr_info(u32 idx, struct dmce_perfmon_cnt_info *info)
 {
-	int i;
+	unsigned long flags;
+	int i, ret = -1;
 
+	raw_spin_lock_irqsave(&denver_uncore_lock, flags);
 	for (i = 0; i < DENVER_MAX_UNCORE_CNTS; i++) {
 		if (denver_uncore_event[i].index == idx &&
 			denver_uncore_event[i].valid == 1) {
 			*info = denver_uncore_event[i];
-			return 0;
+			ret = 0;
+			break;
 		}
 	}
+	raw_spin_unlock_irqrestore(&denver_uncore_lock, flags);
 
-	return -1;
+	return ret;
 }
 
+/*
+ * Bind a virtual index to a physical counter. When perf multiplexes,
+ * an index freed by one event is handed to the next one, so an entry
+ * that is still bound is reprogrammed rather than kept as is.
+ */
 static inline int alloc_denver_ctr(u32 idx, u32 group, u32 event)
 {
+	struct dmce_perfmon_cnt_info *e = NULL;
+	unsigned long flags;
 	int i;
-	struct dmce_perfmon_cnt_info info;
 
-	if (get_ctr_info(idx, &info) < 0) {
-		for (i = 0; i < DENVER_MAX_UNCORE_CNTS; i++) {
-			if (denver_uncore_event[i].valid == 0) {
-				denver_uncore_event[i].counter = event;
-				denver_uncore_event[i].group = group;
-				denver_uncore_event[i].unit = 0;
-				denver_uncore_event[i].index = idx;
-				denver_uncore_event[i].idx = i;
-				denver_uncore_event[i].valid = 1;
-				break;
-			}
+	raw_spin_lock_irqsave(&denver_uncore_lock, flags);
+	for (i = 0; i < DENVER_MAX_UNCORE_CNTS; i++) {
+		if (denver_uncore_event[i].valid == 1 &&
+		    denver_uncore_event[i].index == idx) {
+			e = &denver_uncore_event[i];
+			break;
 		}
+		if (!e && denver_uncore_event[i].valid == 0)
+			e = &denver_uncore_event[i];
+	}
 
-		if (i == DENVER_MAX_UNCORE_CNTS) {
-			pr_err("Failed to allocate D15 uncore ctr\n");
-			return -1;
-		}
+	if (e) {
+		e->counter = event;
+		e->group = group;
+		e->unit = 0;
+		e->index = idx;
+		e->idx = e - denver_uncore_event;
+		e->valid = 1;
+	}
+	raw_spin_unlock_irqrestore(&denver_uncore_lock, flags);
+
+	if (!e) {
+		pr_err("Failed to allocate D15 uncore ctr\n");
+		return -1;
 	}
 
 	return 0;
@@ -180,14 +198,17 @@ static inline int alloc_denver_ctr(u32 idx, u32 group, u32 event)
 
 static inline int clear_denver_ctr(u32 idx)
 {
+	unsigned long flags;
 	int i;
 
+	raw_spin_lock_irqsave(&denver_uncore_lock, flags);
 	for (i = 0; i < DENVER_MAX_UNCORE_CNTS; i++) {
 		if (denver_uncore_event[i].index == idx) {
 			denver_uncore_event[i].valid = 0;
 			break;
 		}
 	}
+	raw_spin_unlock_irqrestore(&denver_uncore_lock, flags);
 
 	return 0;
 }
@@ -543,23 +564,46 @@ static int denver15pmu_get_event_idx(struct pmu_hw_events *cpuc,
 	int idx;
 	int group;
 	struct arm_pmu *uncore_pmu = to_arm_pmu(event->pmu);
+	u32 id = event->attr.config & DENVER_EVTYPE_EVENT_ID;
+
+	group = get_uncore_group(id);
+	if (group < 0)
+		return -EINVAL;
 
 	/*
 	 * For anything other than a cycle counter, try and use
 	 * the events counters
 	 */
 	for (idx = ARMV8_IDX_COUNTER0; idx < uncore_pmu->num_events; ++idx) {
-		if (!test_and_set_bit(idx, cpuc->used_mask)) {
-			group = get_uncore_group(event->attr.config & DENVER_EVTYPE_EVENT_ID);
-                        alloc_denver_ctr(idx, group, event->attr.config & DENVER_EVTYPE_EVENT_ID);
-			return idx;
+		if (test_and_set_bit(idx, cpuc->used_mask))
+			continue;
+
+		/*
+		 * Group validation runs against a scratch pmu_hw_events,
+		 * leave the live counter bindings alone in that case.
+		 */
+		if (cpuc == this_cpu_ptr(uncore_pmu->hw_events) &&
+		    alloc_denver_ctr(idx, group, id) < 0) {
+			clear_bit(idx, cpuc->used_mask);
+			return -EAGAIN;
 		}
+
+		return idx;
 	}
 
-	/* The counters are all in use. */
+	/*
+	 * The counters are all in use, perf core rotates the events and
+	 * scales their counts by the time they were actually counting.
+	 */
 	return -EAGAIN;
 }
 
+static void denver15pmu_clear_event_idx(struct pmu_hw_events *cpuc,
+					struct perf_event *event)
+{
+	clear_denver_ctr(event->hw.idx);
+}
+
 /*
  * Add an event filter to a given event. This will only work for PMUv2 PMUs.
  */
@@ -612,12 +656,15 @@ static int denver_pmu_map_event(struct perf_event *event)
 
 static int denver15_uncore_pmu_init(struct arm_pmu *uncore_pmu)
 {
+	int cpu;
+
 	uncore_pmu->handle_irq		= denver15pmu_handle_irq,
 	uncore_pmu->enable		= denver15pmu_enable_event,
 	uncore_pmu->disable		= denver15pmu_disable_event,
 	uncore_pmu->read_counter	= denver15pmu_read_counter,
 	uncore_pmu->write_counter	= denver15pmu_write_counter,
 	uncore_pmu->get_event_idx	= denver15pmu_get_event_idx,
+	uncore_pmu->clear_event_idx	= denver15pmu_clear_event_idx,
 	uncore_pmu->start		= denver15pmu_start,
 	uncore_pmu->stop		= denver15pmu_stop,
 	uncore_pmu->reset		= denver15pmu_reset,
@@ -626,6 +673,18 @@ static int denver15_uncore_pmu_init(struct arm_pmu *uncore_pmu)
 	uncore_pmu->name		= "denver15_uncore_pmu";
 	uncore_pmu->map_event		= denver_pmu_map_event;
 	uncore_pmu->num_events		= DENVER_MAX_UNCORE_CNTS + 1;
+
+	/*
+	 * The counters are only reachable from Denver cores, keep perf
+	 * from scheduling CPU-bound or cgroup events anywhere else.
+	 */
+	for_each_possible_cpu(cpu)
+		if (!tegra18_is_cpu_denver(cpu))
+			cpumask_clear_cpu(cpu, &uncore_pmu->supported_cpus);
+
+	if (cpumask_empty(&uncore_pmu->supported_cpus))
+		return -ENODEV;
+
 	return 0;
 }
 
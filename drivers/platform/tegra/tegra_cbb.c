@@ -16,6 +16,13 @@
  * It then prints debug information about failed transaction using ErrLog
  * registers of error logger which has ErrVld set. Currently, SLV, DEC,
  * TMO, SEC, UNS are the only codes which are supported by CBB.
+ *
+ * Errors from masters other than CCPLEX arrive as interrupts. The ISR only
+ * snapshots and clears the error logger and bumps per initiator/target
+ * counters; the records are decoded and printed later by a worker that
+ * handles a few of them at a time, so a burst of errors cannot keep the
+ * CPU in interrupt context. SErrors from CCPLEX are still decoded right
+ * away since nothing may run after them.
  */
 
 #include <asm/traps.h>
@@ -31,12 +38,49 @@
 #include <linux/of_address.h>
 #include <linux/interrupt.h>
 #include <linux/ioport.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 #include <soc/tegra/chip-id.h>
 #include <linux/platform/tegra/tegra19x_cbb.h>
 
 static LIST_HEAD(cbb_noc_list);
 static DEFINE_RAW_SPINLOCK(cbb_noc_lock);
 
+#define CBB_ERR_QUEUE_SIZE	64
+#define CBB_ERR_DECODE_BATCH	4
+#define CBB_ERR_DECODE_DELAY	msecs_to_jiffies(100)
+#define CBB_ERR_MAX_APB_BRIDGES	16
+#define CBB_ERR_STATS_SIZE	64
+
+/* Error logger snapshot taken by the ISR */
+struct tegra_cbb_err_rec {
+	struct tegra_cbb_errlog_record *errlog;
+	int cpu;
+	int irq;
+	int logger;
+	u32 errlog0, errlog1, errlog2, errlog3, errlog4, errlog5;
+	int apb_bridge_cnt;
+	u32 apb_status[CBB_ERR_MAX_APB_BRIDGES];
+};
+
+struct tegra_cbb_err_stat {
+	struct tegra_cbb_errlog_record *errlog;
+	u8 initflow;
+	u8 targflow;
+	u8 mstr_id;
+	u32 count;
+};
+
+/* All of the below are protected by cbb_noc_lock */
+static struct tegra_cbb_err_rec cbb_err_queue[CBB_ERR_QUEUE_SIZE];
+static unsigned int cbb_err_head, cbb_err_tail;
+static struct tegra_cbb_err_stat cbb_err_stats[CBB_ERR_STATS_SIZE];
+static u32 cbb_err_total, cbb_err_dropped, cbb_err_untracked;
+
+static void cbb_err_decode_work_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(cbb_err_decode_work, cbb_err_decode_work_fn);
+
 static struct tegra_noc_errors noc_errors[] = {
 	{.errcode = "SLV",
 	.src = "Target",
@@ -437,7 +481,10 @@ static void print_errlog0(struct seq_file *file,
 		 */
 
 		for (i = 0; i < errlog->apb_bridge_cnt; i++) {
-			bus_status = tegra_axi2apb_errstatus(
+			if (errlog->apb_status)
+				bus_status = errlog->apb_status[i];
+			else
+				bus_status = tegra_axi2apb_errstatus(
 				(void __iomem *)errlog->axi2abp_bases[i]);
 
 			if (bus_status) {
@@ -461,17 +508,10 @@ static void print_errlog0(struct seq_file *file,
 }
 
 
-/*
- * Print debug information about failed transaction using
- * ErrLog registers of error loggger having ErrVld set
- */
-static void print_errloggerX_info(
-			struct seq_file *file,
-			struct tegra_cbb_errlog_record *errlog, int errloggerX)
+/* Latch the ErrLog registers of error logger X into errlog */
+static void cbb_errlogger_read(struct tegra_cbb_errlog_record *errlog,
+			       int errloggerX)
 {
-	struct tegra_lookup_noc_aperture noc_trans_info = {0,};
-
-	print_cbb_err(file, "\tError Logger\t\t: %d\n", errloggerX);
 	if (errloggerX == 0) {
 		errlog->errlog0 = readl(errlog->vaddr+OFF_ERRLOGGER_0_ERRLOG0_0);
 		errlog->errlog1 = readl(errlog->vaddr+OFF_ERRLOGGER_0_ERRLOG1_0);
@@ -494,6 +534,13 @@ static void print_errloggerX_info(
 		errlog->errlog4 = readl(errlog->vaddr+OFF_ERRLOGGER_2_ERRLOG4_0);
 		errlog->errlog5 = readl(errlog->vaddr+OFF_ERRLOGGER_2_ERRLOG5_0);
 	}
+}
+
+/* Decode the ErrLog values latched in errlog */
+static void print_errlogger_regs(struct seq_file *file,
+				 struct tegra_cbb_errlog_record *errlog)
+{
+	struct tegra_lookup_noc_aperture noc_trans_info = {0,};
 
 	print_cbb_err(file, "\tErrLog0\t\t\t: 0x%x\n", errlog->errlog0);
 	print_errlog0(file, errlog);
@@ -512,17 +559,37 @@ static void print_errloggerX_info(
 	print_errlog5(file, errlog);
 }
 
+/*
+ * Print debug information about failed transaction using
+ * ErrLog registers of error loggger having ErrVld set
+ */
+static void print_errloggerX_info(
+			struct seq_file *file,
+			struct tegra_cbb_errlog_record *errlog, int errloggerX)
+{
+	print_cbb_err(file, "\tError Logger\t\t: %d\n", errloggerX);
+	cbb_errlogger_read(errlog, errloggerX);
+	print_errlogger_regs(file, errlog);
+}
 
-static void print_errlog(struct seq_file *file,
-			struct tegra_cbb_errlog_record *errlog,
-			int errvld_status)
+
+static void print_errlog_banner(struct tegra_cbb_errlog_record *errlog,
+				int cpu)
 {
 	pr_crit("**************************************\n");
 	pr_crit("* For more Internal Decode Help\n");
 	pr_crit("*     http://nv/cbberr\n");
 	pr_crit("* NVIDIA userID is required to access\n");
 	pr_crit("**************************************\n");
-	pr_crit("CPU:%d, Error:%s\n", smp_processor_id(), errlog->name);
+	pr_crit("CPU:%d, Error:%s\n", cpu, errlog->name);
+}
+
+
+static void print_errlog(struct seq_file *file,
+			struct tegra_cbb_errlog_record *errlog,
+			int errvld_status)
+{
+	print_errlog_banner(errlog, smp_processor_id());
 
 	if (errvld_status & 0x1)
 		print_errloggerX_info(file, errlog, 0);
@@ -712,6 +779,60 @@ static const struct file_operations cbb_err_fops = {
 };
 
 
+static int cbb_err_stats_show(struct seq_file *file, void *data)
+{
+	struct tegra_cbb_err_stat *stats;
+	unsigned long flags;
+	u32 total, dropped, untracked, pending;
+	int i;
+
+	stats = kmalloc(sizeof(cbb_err_stats), GFP_KERNEL);
+	if (!stats)
+		return -ENOMEM;
+
+	raw_spin_lock_irqsave(&cbb_noc_lock, flags);
+	memcpy(stats, cbb_err_stats, sizeof(cbb_err_stats));
+	total = cbb_err_total;
+	dropped = cbb_err_dropped;
+	untracked = cbb_err_untracked;
+	pending = cbb_err_head - cbb_err_tail;
+	raw_spin_unlock_irqrestore(&cbb_noc_lock, flags);
+
+	seq_printf(file, "total: %u\npending: %u\nnot decoded: %u\n",
+		   total, pending, dropped);
+	if (untracked)
+		seq_printf(file, "not aggregated: %u\n", untracked);
+
+	for (i = 0; i < CBB_ERR_STATS_SIZE && stats[i].errlog; i++) {
+		struct tegra_cbb_errlog_record *errlog = stats[i].errlog;
+
+		seq_printf(file, "%s: initiator %s, target %s, master %s: %u\n",
+			errlog->name,
+			errlog->tegra_noc_routeid_initflow[stats[i].initflow],
+			errlog->tegra_noc_routeid_targflow[stats[i].targflow],
+			errlog->tegra_cbb_master_id[stats[i].mstr_id],
+			stats[i].count);
+	}
+
+	kfree(stats);
+	return 0;
+}
+
+
+static int cbb_err_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cbb_err_stats_show, inode->i_private);
+}
+
+
+static const struct file_operations cbb_err_stats_fops = {
+	.open = cbb_err_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release
+};
+
+
 static int cbb_noc_dbgfs_init(void)
 {
 	struct dentry *d;
@@ -723,6 +844,8 @@ static int cbb_noc_dbgfs_init(void)
 					__func__);
 			return PTR_ERR(d);
 		}
+		debugfs_create_file("tegra_cbb_err_stats", S_IRUGO, NULL,
+				NULL, &cbb_err_stats_fops);
 		created_root = true;
 	}
 	return 0;
@@ -732,6 +855,129 @@ static int cbb_noc_dbgfs_init(void)
 static int cbb_noc_dbgfs_init(void) { return 0; }
 #endif
 
+/* Called with cbb_noc_lock held */
+static void cbb_err_count(struct tegra_cbb_errlog_record *errlog,
+			  struct tegra_cbb_err_rec *rec)
+{
+	struct tegra_lookup_noc_aperture noc_trans_info = {0,};
+	struct tegra_cbb_err_stat *stat;
+	u64 routeid;
+	u8 mstr_id;
+	int i;
+
+	routeid = ((u64)rec->errlog2 << 32) | rec->errlog1;
+	errlog->tegra_noc_parse_routeid(&noc_trans_info, routeid);
+	mstr_id = get_cbb_errlog5_mstr_id(rec->errlog5) - 1;
+
+	cbb_err_total++;
+	for (i = 0; i < CBB_ERR_STATS_SIZE; i++) {
+		stat = &cbb_err_stats[i];
+		if (!stat->errlog) {
+			stat->errlog = errlog;
+			stat->initflow = noc_trans_info.initflow;
+			stat->targflow = noc_trans_info.targflow;
+			stat->mstr_id = mstr_id;
+		} else if (stat->errlog != errlog ||
+			   stat->initflow != noc_trans_info.initflow ||
+			   stat->targflow != noc_trans_info.targflow ||
+			   stat->mstr_id != mstr_id) {
+			continue;
+		}
+		stat->count++;
+		return;
+	}
+	cbb_err_untracked++;
+}
+
+/* Snapshot and clear the error logger, called with cbb_noc_lock held */
+static void cbb_err_queue_rec(struct tegra_cbb_errlog_record *errlog,
+			      unsigned int errvld_status, int irq)
+{
+	struct tegra_cbb_err_rec tmp, *rec;
+	int i;
+
+	if (cbb_err_head - cbb_err_tail < CBB_ERR_QUEUE_SIZE)
+		rec = &cbb_err_queue[cbb_err_head % CBB_ERR_QUEUE_SIZE];
+	else
+		rec = &tmp;
+
+	rec->errlog = errlog;
+	rec->cpu = smp_processor_id();
+	rec->irq = irq;
+	rec->logger = __ffs(errvld_status);
+	cbb_errlogger_read(errlog, rec->logger);
+	rec->errlog0 = errlog->errlog0;
+	rec->errlog1 = errlog->errlog1;
+	rec->errlog2 = errlog->errlog2;
+	rec->errlog3 = errlog->errlog3;
+	rec->errlog4 = errlog->errlog4;
+	rec->errlog5 = errlog->errlog5;
+
+	/* the bridge status is clear-on-read, grab it now for SLV errors */
+	rec->apb_bridge_cnt = 0;
+	if (errlog->is_ax2apb_bridge_connected &&
+	    !strcmp(noc_errors[get_cbb_errlog0_code(rec->errlog0)].errcode,
+		    "SLV")) {
+		rec->apb_bridge_cnt = min(errlog->apb_bridge_cnt,
+					  CBB_ERR_MAX_APB_BRIDGES);
+		for (i = 0; i < rec->apb_bridge_cnt; i++)
+			rec->apb_status[i] = tegra_axi2apb_errstatus(
+				(void __iomem *)errlog->axi2abp_bases[i]);
+	}
+
+	errlog->errclr(errlog->vaddr);
+	cbb_err_count(errlog, rec);
+
+	if (rec == &tmp)
+		cbb_err_dropped++;
+	else
+		cbb_err_head++;
+}
+
+static void cbb_err_decode_work_fn(struct work_struct *work)
+{
+	struct tegra_cbb_err_rec rec;
+	struct tegra_cbb_errlog_record errlog;
+	unsigned long flags;
+	int n;
+
+	for (n = 0; n < CBB_ERR_DECODE_BATCH; n++) {
+		raw_spin_lock_irqsave(&cbb_noc_lock, flags);
+		if (cbb_err_tail == cbb_err_head) {
+			raw_spin_unlock_irqrestore(&cbb_noc_lock, flags);
+			return;
+		}
+		rec = cbb_err_queue[cbb_err_tail % CBB_ERR_QUEUE_SIZE];
+		cbb_err_tail++;
+		if (!rec.errlog) {
+			/* logger removed since the error was queued */
+			raw_spin_unlock_irqrestore(&cbb_noc_lock, flags);
+			continue;
+		}
+		errlog = *rec.errlog;
+		raw_spin_unlock_irqrestore(&cbb_noc_lock, flags);
+
+		errlog.errlog0 = rec.errlog0;
+		errlog.errlog1 = rec.errlog1;
+		errlog.errlog2 = rec.errlog2;
+		errlog.errlog3 = rec.errlog3;
+		errlog.errlog4 = rec.errlog4;
+		errlog.errlog5 = rec.errlog5;
+		errlog.apb_bridge_cnt = rec.apb_bridge_cnt;
+		errlog.apb_status = rec.apb_status;
+
+		print_cbb_err(NULL, "CPU:%d, Error:%s@0x%llx, irq=%d\n",
+			rec.cpu, errlog.name, errlog.start, rec.irq);
+		print_errlog_banner(&errlog, rec.cpu);
+		print_cbb_err(NULL, "\tError Logger\t\t: %d\n", rec.logger);
+		print_errlogger_regs(NULL, &errlog);
+		print_cbb_err(NULL, "\t**************************************\n");
+	}
+
+	/* More left: come back later rather than flood the console */
+	schedule_delayed_work(&cbb_err_decode_work, CBB_ERR_DECODE_DELAY);
+}
+
 /*
  * Handler for CBB errors from masters other than CCPLEX
  */
@@ -740,6 +986,7 @@ static irqreturn_t tegra_cbb_error_isr(int irq, void *dev_id)
 	struct tegra_cbb_errlog_record *errlog;
 	unsigned int errvld_status = 0;
 	unsigned long flags;
+	bool queued = false;
 
 	raw_spin_lock_irqsave(&cbb_noc_lock, flags);
 
@@ -748,14 +995,15 @@ static irqreturn_t tegra_cbb_error_isr(int irq, void *dev_id)
 
 		if (errvld_status && ((irq == errlog->noc_secure_irq)
 				|| (irq == errlog->noc_nonsecure_irq))) {
-			print_cbb_err(NULL, "CPU:%d, Error:%s@0x%llx, irq=%d\n",
-			smp_processor_id(), errlog->name, errlog->start, irq);
-
-			print_errlog(NULL, errlog, errvld_status);
+			cbb_err_queue_rec(errlog, errvld_status, irq);
+			queued = true;
 		}
 	}
 	raw_spin_unlock_irqrestore(&cbb_noc_lock, flags);
 
+	if (queued)
+		schedule_delayed_work(&cbb_err_decode_work, 0);
+
 	return IRQ_HANDLED;
 }
 
@@ -943,8 +1191,22 @@ static int tegra_cbb_remove(struct platform_device *pdev)
 	raw_spin_lock_irqsave(&cbb_noc_lock, flags);
 	list_for_each_entry(errlog, &cbb_noc_list, node) {
 		if (errlog->start == res_base->start) {
+			unsigned int i, j;
+
 			unregister_serr_hook(errlog->callback);
 			list_del(&errlog->node);
+
+			/* the record memory goes away with the device */
+			for (i = 0, j = 0; i < CBB_ERR_STATS_SIZE; i++)
+				if (cbb_err_stats[i].errlog != errlog)
+					cbb_err_stats[j++] = cbb_err_stats[i];
+			memset(&cbb_err_stats[j], 0,
+			       (i - j) * sizeof(cbb_err_stats[0]));
+			for (i = cbb_err_tail; i != cbb_err_head; i++)
+				if (cbb_err_queue[i % CBB_ERR_QUEUE_SIZE].errlog
+				    == errlog)
+					cbb_err_queue[i % CBB_ERR_QUEUE_SIZE]
+						.errlog = NULL;
 			break;
 		}
 	}
@@ -17,6 +17,7 @@
 #include <linux/of_reserved_mem.h>
 #include <linux/platform_device.h>
 #include <linux/pstore_ram.h>
+#include "nvdumper/nvdumper.h"
 
 static __init int display_tegra_dt_info(void)
 {
@@ -53,6 +54,17 @@ arch_initcall(display_tegra_dt_info);
 #define FTRACE_MEM_SIZE SZ_512K
 #define PMSG_MEM_SIZE SZ_256K
 
+/* pstore compresses dmesg records before they reach ramoops */
+#if defined(CONFIG_PSTORE_LZ4_COMPRESS)
+#define RAMOOPS_COMP NVDUMPER_REGION_COMP_LZ4
+#elif defined(CONFIG_PSTORE_LZO_COMPRESS)
+#define RAMOOPS_COMP NVDUMPER_REGION_COMP_LZO
+#elif defined(CONFIG_PSTORE_ZLIB_COMPRESS)
+#define RAMOOPS_COMP NVDUMPER_REGION_COMP_ZLIB
+#else
+#define RAMOOPS_COMP NVDUMPER_REGION_COMP_NONE
+#endif
+
 static struct ramoops_platform_data ramoops_data;
 
 static struct platform_device ramoops_dev = {
@@ -87,8 +99,14 @@ static int __init tegra_register_ramoops_device(void)
 	int ret;
 
 	ret = platform_device_register(&ramoops_dev);
-	if (ret)
+	if (ret) {
 		pr_err("Unable to register ramoops platform device\n");
-	return ret;
+		return ret;
+	}
+
+	if (ramoops_data.mem_size)
+		nvdumper_manifest_add("ramoops", ramoops_data.mem_address,
+				      ramoops_data.mem_size, RAMOOPS_COMP);
+	return 0;
 }
 core_initcall(tegra_register_ramoops_device);
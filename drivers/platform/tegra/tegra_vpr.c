@@ -17,6 +17,9 @@
 #include <linux/dma-mapping.h>
 #include <linux/ote_protocol.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
 
 extern phys_addr_t tegra_vpr_start;
 extern phys_addr_t tegra_vpr_size;
@@ -51,12 +54,46 @@ static struct vpr_user_module_info {
 } vpr_user_module[NUM_MODULES_IDLE_VPR_RESIZE];
 static int _tegra_set_vpr_params(void *vpr_base, size_t vpr_size);
 
+/* Last window programmed in MC, valid once the first SMC succeeded */
+static bool vpr_cfg_valid;
+static phys_addr_t vpr_cfg_base;
+static size_t vpr_cfg_size;
+
+/* Resize latency, protected by vpr_lock */
+static struct {
+	u32 resizes;
+	u32 skipped;
+	u32 failed;
+	u32 retries;
+	s64 last_idle_us;
+	s64 last_us;
+	s64 max_us;
+	s64 total_us;
+} vpr_stats;
+
 static int tegra_update_resize_cfg(phys_addr_t base , size_t size)
 {
 	int i = 0, err = 0;
 #define MAX_RETRIES 6
 	int retries = MAX_RETRIES;
+	ktime_t start, idled;
+	s64 us;
+
 	mutex_lock(&vpr_lock);
+
+	/*
+	 * The resizable carveout grows and shrinks one chunk at a time and
+	 * may report a window that MC already has. Don't stall every VPR
+	 * user just to program the same bounds again.
+	 */
+	if (vpr_cfg_valid && vpr_cfg_base == base && vpr_cfg_size == size) {
+		vpr_stats.skipped++;
+		mutex_unlock(&vpr_lock);
+		return 0;
+	}
+
+	start = ktime_get();
+	idled = start;
 retry:
 	for (; i < NUM_MODULES_IDLE_VPR_RESIZE; i++) {
 		if (vpr_user_module[i].do_idle) {
@@ -71,6 +108,8 @@ retry:
 		}
 	}
 	if (!err) {
+		if (ktime_equal(idled, start))
+			idled = ktime_get();
 		/* Config VPR_BOM/_SIZE in MC */
 		err = _tegra_set_vpr_params((void *)(uintptr_t)base, size);
 		if (err)
@@ -82,9 +121,12 @@ retry:
 	if (retries--) {
 		pr_err("%s:%d: fail retry=%d",
 			__func__, __LINE__, MAX_RETRIES - retries);
+		vpr_stats.retries++;
 		msleep(1);
 		goto retry;
 	}
+	if (err)
+		vpr_stats.failed++;
 	while (--i >= 0) {
 		if (!vpr_user_module[i].do_unidle)
 			continue;
@@ -99,6 +141,15 @@ retry:
 		/* vpr resize is success, so return 0 on unidle failure */
 		err = 0;
 	}
+
+	us = ktime_us_delta(ktime_get(), start);
+	vpr_stats.resizes++;
+	vpr_stats.last_idle_us = ktime_us_delta(idled, start);
+	vpr_stats.last_us = us;
+	vpr_stats.total_us += us;
+	if (us > vpr_stats.max_us)
+		vpr_stats.max_us = us;
+
 	mutex_unlock(&vpr_lock);
 	return err;
 }
@@ -123,8 +174,13 @@ static int _tegra_set_vpr_params(void *vpr_base, size_t vpr_size)
 	if (retval != 0) {
 		pr_err("%s: smc failed, base 0x%p size %zx, err (0x%x)\n",
 			__func__, vpr_base, vpr_size, retval);
+		vpr_cfg_valid = false;
 		return -EINVAL;
 	}
+
+	vpr_cfg_base = (phys_addr_t)(uintptr_t)vpr_base;
+	vpr_cfg_size = vpr_size;
+	vpr_cfg_valid = true;
 	return 0;
 }
 
@@ -188,3 +244,47 @@ void tegra_unregister_idle_unidle(int (*do_idle)(void *))
 	mutex_unlock(&vpr_lock);
 }
 EXPORT_SYMBOL(tegra_unregister_idle_unidle);
+
+#ifdef CONFIG_DEBUG_FS
+static int tegra_vpr_resize_stats_show(struct seq_file *s, void *data)
+{
+	mutex_lock(&vpr_lock);
+	seq_printf(s, "base: %pa\n", &vpr_cfg_base);
+	seq_printf(s, "size: 0x%zx\n", vpr_cfg_size);
+	seq_printf(s, "resizes: %u\n", vpr_stats.resizes);
+	seq_printf(s, "skipped: %u\n", vpr_stats.skipped);
+	seq_printf(s, "failed: %u\n", vpr_stats.failed);
+	seq_printf(s, "retries: %u\n", vpr_stats.retries);
+	seq_printf(s, "last_idle_us: %lld\n", vpr_stats.last_idle_us);
+	seq_printf(s, "last_us: %lld\n", vpr_stats.last_us);
+	seq_printf(s, "max_us: %lld\n", vpr_stats.max_us);
+	seq_printf(s, "avg_us: %lld\n", vpr_stats.resizes ?
+		div_s64(vpr_stats.total_us, vpr_stats.resizes) : 0);
+	mutex_unlock(&vpr_lock);
+
+	return 0;
+}
+
+static int tegra_vpr_resize_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tegra_vpr_resize_stats_show, NULL);
+}
+
+static const struct file_operations tegra_vpr_resize_stats_fops = {
+	.open		= tegra_vpr_resize_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init tegra_vpr_debugfs_init(void)
+{
+	if (!tegra_vpr_resize)
+		return 0;
+
+	debugfs_create_file("tegra_vpr_resize", S_IRUGO, NULL, NULL,
+			    &tegra_vpr_resize_stats_fops);
+	return 0;
+}
+late_initcall(tegra_vpr_debugfs_init);
+#endif
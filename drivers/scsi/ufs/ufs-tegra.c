@@ -80,6 +80,11 @@ static int ufs_tegra_show_configuration(struct seq_file *s, void *data)
 	seq_puts(s, "UTP Task Management Request Slots:\n");
 	seq_printf(s, "NUTMRS: %u\n", hba->nutmrs);
 
+	seq_puts(s, "\n");
+	seq_puts(s, "Inline Crypto Engine:\n");
+	seq_printf(s, "%s\n", (hba->capabilities & UFS_TEGRA_CAP_CRYPTO) ?
+		"supported" : "not supported");
+
 	seq_puts(s, "\n");
 	seq_puts(s, "UTP Power Info:\n");
 	if (configured_params->hs_rate) {
@@ -99,6 +104,45 @@ static int ufs_tegra_show_configuration(struct seq_file *s, void *data)
 	return 0;
 }
 
+static int ufs_tegra_show_gear_scaling(struct seq_file *s, void *data)
+{
+	struct ufs_hba *hba = s->private;
+	struct ufs_tegra_host *ufs_tegra = hba->priv;
+	struct ufs_tegra_scaling *scaling = &ufs_tegra->scaling;
+	u32 switches = scaling->up_count + scaling->down_count;
+
+	if (!scaling->nr_levels) {
+		seq_puts(s, "Gear scaling disabled\n");
+		return 0;
+	}
+
+	seq_printf(s, "Current: gear_%u %s\n",
+		scaling->levels[scaling->cur].gear,
+		scaling->levels[scaling->cur].hs_rate == PA_HS_MODE_B ?
+			"RATE_B" : "RATE_A");
+	seq_printf(s, "Scale up: %u\n", scaling->up_count);
+	seq_printf(s, "Scale down: %u\n", scaling->down_count);
+	seq_printf(s, "Last latency: %u us\n", scaling->last_lat_us);
+	seq_printf(s, "Max latency: %u us\n", scaling->max_lat_us);
+	seq_printf(s, "Avg latency: %llu us\n", switches ?
+		div_u64(scaling->total_lat_us, switches) : 0);
+
+	return 0;
+}
+
+static int ufs_tegra_open_gear_scaling(struct inode *inode, struct file *file)
+{
+	return single_open(file, ufs_tegra_show_gear_scaling,
+			inode->i_private);
+}
+
+static const struct file_operations ufs_tegra_gear_scaling_ops = {
+	.open           = ufs_tegra_open_gear_scaling,
+	.read           = seq_read,
+	.llseek         = seq_lseek,
+	.release        = single_release,
+};
+
 static int ufs_tegra_open_configuration(struct inode *inode, struct file *file)
 {
 	return single_open(file, ufs_tegra_show_configuration, inode->i_private);
@@ -119,6 +163,9 @@ void ufs_tegra_init_debugfs(struct ufs_hba *hba)
 	device_root = debugfs_create_dir(dev_name(hba->dev), NULL);
 	debugfs_create_file("configuration", S_IFREG | S_IRUGO,
 			device_root, hba, &ufs_tegra_debugfs_ops);
+	if (ufs_tegra->enable_gear_scaling)
+		debugfs_create_file("gear_scaling", S_IFREG | S_IRUGO,
+				device_root, hba, &ufs_tegra_gear_scaling_ops);
 	if (ufs_tegra->enable_ufs_provisioning)
 		debugfs_provision_init(hba, device_root);
 }
@@ -404,10 +451,18 @@ static int ufs_tegra_enable_ufs_uphy_pll3(struct ufs_tegra_host *ufs_tegra,
 	if (!ufs_tegra->configure_uphy_pll3)
 		return 0;
 
-	err = ufs_tegra_host_clk_enable(dev, "uphy_pll3",
-		ufs_tegra->ufs_uphy_pll3);
-	if (err)
-		return err;
+	/* Keep the PLL locked when the rate series doesn't change */
+	if (ufs_tegra->uphy_pll3_enabled &&
+			ufs_tegra->uphy_pll3_rate_b == is_rate_b)
+		return 0;
+
+	if (!ufs_tegra->uphy_pll3_enabled) {
+		err = ufs_tegra_host_clk_enable(dev, "uphy_pll3",
+			ufs_tegra->ufs_uphy_pll3);
+		if (err)
+			return err;
+		ufs_tegra->uphy_pll3_enabled = true;
+	}
 
 	if (is_rate_b) {
 		if (ufs_tegra->ufs_uphy_pll3)
@@ -421,6 +476,8 @@ static int ufs_tegra_enable_ufs_uphy_pll3(struct ufs_tegra_host *ufs_tegra,
 	if (err)
 		dev_err(dev, "%s: failed to set ufs_uphy_pll3 freq err %d",
 				__func__, err);
+	else
+		ufs_tegra->uphy_pll3_rate_b = is_rate_b;
 	return err;
 }
 
@@ -917,6 +974,7 @@ static int ufs_tegra_suspend(struct ufs_hba *hba, enum ufs_pm_op pm_op)
 	if (pm_op != UFS_SYSTEM_PM)
 		return 0;
 
+	ufs_tegra_scaling_suspend(ufs_tegra, true);
 	ufs_tegra->ufshc_state = UFSHC_SUSPEND;
 	/*
 	 * Enable DPD for UFS
@@ -1031,6 +1089,7 @@ static int ufs_tegra_resume(struct ufs_hba *hba, enum ufs_pm_op pm_op)
 	pm_runtime_disable(dev);
 	pm_runtime_set_active(dev);
 	pm_runtime_enable(dev);
+	ufs_tegra_scaling_suspend(ufs_tegra, false);
 
 	return ret;
 
@@ -1091,6 +1150,250 @@ static void ufs_tegra_print_power_mode_config(struct ufs_hba *hba,
 	}
 }
 
+#ifdef CONFIG_PM_DEVFREQ
+static void ufs_tegra_setup_xfer_req(struct ufs_hba *hba, int tag,
+		bool is_scsi_cmd)
+{
+	struct ufs_tegra_host *ufs_tegra = hba->priv;
+	struct ufs_tegra_scaling *scaling = &ufs_tegra->scaling;
+	struct scsi_cmnd *cmd = hba->lrb[tag].cmd;
+
+	if (!scaling->devfreq)
+		return;
+
+	/* Called under host_lock, the new request isn't outstanding yet */
+	scaling->window_reqs++;
+	scaling->window_qd += hweight_long(hba->outstanding_reqs) + 1;
+	if (is_scsi_cmd && cmd)
+		scaling->window_bytes += scsi_bufflen(cmd);
+}
+
+static int ufs_tegra_wait_for_idle(struct ufs_hba *hba)
+{
+	unsigned long timeout;
+
+	timeout = jiffies + msecs_to_jiffies(UFS_TEGRA_SCALE_IDLE_TIMEOUT_MS);
+	while (hba->outstanding_reqs || hba->outstanding_tasks) {
+		if (time_after(jiffies, timeout))
+			return -ETIMEDOUT;
+		usleep_range(50, 100);
+	}
+	return 0;
+}
+
+static int ufs_tegra_scale_gear(struct ufs_hba *hba, int level)
+{
+	struct ufs_tegra_host *ufs_tegra = hba->priv;
+	struct ufs_tegra_scaling *scaling = &ufs_tegra->scaling;
+	struct ufs_pa_layer_attr pwr_info;
+	ktime_t start;
+	u32 lat_us;
+	int ret;
+
+	memcpy(&pwr_info, &hba->pwr_info, sizeof(pwr_info));
+	pwr_info.gear_rx = scaling->levels[level].gear;
+	pwr_info.gear_tx = scaling->levels[level].gear;
+	pwr_info.hs_rate = scaling->levels[level].hs_rate;
+
+	start = ktime_get();
+	ufshcd_hold(hba, false);
+	scsi_block_requests(hba->host);
+	ret = ufs_tegra_wait_for_idle(hba);
+	if (!ret) {
+		scaling->in_progress = true;
+		ret = ufshcd_config_pwr_mode(hba, &pwr_info);
+		scaling->in_progress = false;
+	}
+	scsi_unblock_requests(hba->host);
+	ufshcd_release(hba);
+
+	if (ret) {
+		dev_err(hba->dev, "%s: gear %u switch failed %d\n", __func__,
+			pwr_info.gear_rx, ret);
+		return ret;
+	}
+
+	lat_us = ktime_us_delta(ktime_get(), start);
+	if (level > scaling->cur)
+		scaling->up_count++;
+	else
+		scaling->down_count++;
+	scaling->last_lat_us = lat_us;
+	scaling->max_lat_us = max(scaling->max_lat_us, lat_us);
+	scaling->total_lat_us += lat_us;
+	scaling->cur = level;
+	scaling->last_switch = jiffies;
+
+	return 0;
+}
+
+static int ufs_tegra_devfreq_target(struct device *dev, unsigned long *freq,
+		u32 flags)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_tegra_host *ufs_tegra = hba->priv;
+	struct ufs_tegra_scaling *scaling = &ufs_tegra->scaling;
+	int level;
+	int ret = 0;
+
+	if (flags & DEVFREQ_FLAG_LEAST_UPPER_BOUND) {
+		for (level = 0; level < scaling->nr_levels - 1; level++)
+			if (scaling->freq_table[level] >= *freq)
+				break;
+	} else {
+		for (level = scaling->nr_levels - 1; level > 0; level--)
+			if (scaling->freq_table[level] <= *freq)
+				break;
+	}
+
+	/* Hysteresis, a raised gear is held for a while */
+	if (level < scaling->cur && time_before(jiffies,
+			scaling->last_switch +
+			msecs_to_jiffies(UFS_TEGRA_SCALE_DOWN_HOLD_MS)))
+		level = scaling->cur;
+
+	/* Never wake the link up just to change its gear */
+	if (level != scaling->cur && pm_runtime_get_if_in_use(dev) > 0) {
+		ret = ufs_tegra_scale_gear(hba, level);
+		pm_runtime_put(dev);
+	}
+
+	*freq = scaling->freq_table[scaling->cur];
+	return ret;
+}
+
+static int ufs_tegra_devfreq_get_dev_status(struct device *dev,
+		struct devfreq_dev_status *stat)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_tegra_host *ufs_tegra = hba->priv;
+	struct ufs_tegra_scaling *scaling = &ufs_tegra->scaling;
+	unsigned long flags;
+	ktime_t now;
+	s64 window_us;
+	u64 bytes, capacity;
+	u32 reqs, qd, load = 0;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	now = ktime_get();
+	window_us = ktime_us_delta(now, scaling->window_start);
+	bytes = scaling->window_bytes;
+	reqs = scaling->window_reqs;
+	qd = scaling->window_qd;
+	scaling->window_start = now;
+	scaling->window_bytes = 0;
+	scaling->window_reqs = 0;
+	scaling->window_qd = 0;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	/* Bytes the link could have moved in the window at this level */
+	capacity = div_u64((u64)scaling->freq_table[scaling->cur] *
+		(ufs_tegra->x2config ? 2 : 1) * max_t(s64, window_us, 1),
+		8000);
+	if (capacity)
+		load = div64_u64(bytes * 100, capacity);
+	/* Deep queues mean the link is the bottleneck */
+	if (reqs)
+		load = max(load, qd * 100 / (reqs * UFS_TEGRA_SCALE_QD_BUSY));
+
+	stat->busy_time = min_t(u32, load, 100);
+	stat->total_time = 100;
+	stat->current_frequency = scaling->freq_table[scaling->cur];
+
+	return 0;
+}
+
+static void ufs_tegra_scaling_link_up(struct ufs_hba *hba,
+		struct ufs_pa_layer_attr *pwr_info)
+{
+	struct ufs_tegra_host *ufs_tegra = hba->priv;
+	struct ufs_tegra_scaling *scaling = &ufs_tegra->scaling;
+	u32 top = min(pwr_info->gear_rx, pwr_info->gear_tx);
+	u32 gear;
+	int n = 0;
+
+	/* Link was (re)negotiated at its maximum */
+	if (scaling->devfreq) {
+		scaling->cur = scaling->nr_levels - 1;
+		scaling->last_switch = jiffies;
+		return;
+	}
+
+	for (gear = UFS_HS_G1; gear <= top &&
+			n < UFS_TEGRA_MAX_SCALE_LEVELS - 1; gear++) {
+		scaling->levels[n].gear = gear;
+		scaling->levels[n].hs_rate = PA_HS_MODE_A;
+		scaling->freq_table[n] =
+			UFS_TEGRA_HS_G1_RATEA_KBPS << (gear - 1);
+		n++;
+	}
+	if (pwr_info->hs_rate == PA_HS_MODE_B) {
+		scaling->levels[n].gear = scaling->levels[n - 1].gear;
+		scaling->levels[n].hs_rate = PA_HS_MODE_B;
+		scaling->freq_table[n] = UFS_TEGRA_HS_G1_RATEB_KBPS <<
+			(scaling->levels[n].gear - 1);
+		n++;
+	}
+	if (n < 2)
+		return;
+
+	scaling->nr_levels = n;
+	scaling->cur = n - 1;
+	scaling->last_switch = jiffies;
+	scaling->window_start = ktime_get();
+
+	scaling->profile.polling_ms = UFS_TEGRA_SCALE_POLL_MS;
+	scaling->profile.initial_freq = scaling->freq_table[n - 1];
+	scaling->profile.target = ufs_tegra_devfreq_target;
+	scaling->profile.get_dev_status = ufs_tegra_devfreq_get_dev_status;
+	scaling->profile.freq_table = scaling->freq_table;
+	scaling->profile.max_state = n;
+	scaling->ondemand.upthreshold = UFS_TEGRA_SCALE_UP_THRESHOLD;
+	scaling->ondemand.downdifferential = UFS_TEGRA_SCALE_DOWN_DIFF;
+
+	scaling->devfreq = devfreq_add_device(hba->dev, &scaling->profile,
+			"simple_ondemand", &scaling->ondemand);
+	if (IS_ERR(scaling->devfreq)) {
+		dev_err(hba->dev, "gear scaling devfreq failed %ld\n",
+			PTR_ERR(scaling->devfreq));
+		scaling->devfreq = NULL;
+	}
+}
+
+static void ufs_tegra_scaling_exit(struct ufs_tegra_host *ufs_tegra)
+{
+	if (ufs_tegra->scaling.devfreq)
+		devfreq_remove_device(ufs_tegra->scaling.devfreq);
+	ufs_tegra->scaling.devfreq = NULL;
+}
+
+static void ufs_tegra_scaling_suspend(struct ufs_tegra_host *ufs_tegra,
+		bool suspend)
+{
+	if (!ufs_tegra->scaling.devfreq)
+		return;
+
+	if (suspend)
+		devfreq_suspend_device(ufs_tegra->scaling.devfreq);
+	else
+		devfreq_resume_device(ufs_tegra->scaling.devfreq);
+}
+#else
+static inline void ufs_tegra_scaling_link_up(struct ufs_hba *hba,
+		struct ufs_pa_layer_attr *pwr_info)
+{
+}
+
+static inline void ufs_tegra_scaling_exit(struct ufs_tegra_host *ufs_tegra)
+{
+}
+
+static inline void ufs_tegra_scaling_suspend(struct ufs_tegra_host *ufs_tegra,
+		bool suspend)
+{
+}
+#endif
+
 static int ufs_tegra_pwr_change_notify(struct ufs_hba *hba,
 		enum ufs_notify_change_status status,
 		struct ufs_pa_layer_attr *dev_max_params,
@@ -1108,6 +1411,15 @@ static int ufs_tegra_pwr_change_notify(struct ufs_hba *hba,
 
 	switch (status) {
 	case PRE_CHANGE:
+		/* Gear scaling only changes the gear, everything else stays */
+		if (ufs_tegra->scaling.in_progress) {
+			memcpy(dev_req_params, dev_max_params,
+				sizeof(struct ufs_pa_layer_attr));
+			ret = ufs_tegra_enable_ufs_uphy_pll3(ufs_tegra,
+				dev_req_params->hs_rate == PA_HS_MODE_B);
+			break;
+		}
+
 		/* Update VS_DebugSaveConfigTime Tref */
 		ufshcd_dme_get(hba, UIC_ARG_MIB(VS_DEBUGSAVECONFIGTIME),
 			&vs_save_config);
@@ -1148,7 +1460,9 @@ static int ufs_tegra_pwr_change_notify(struct ufs_hba *hba,
 				ufs_tegra_enable_ufs_uphy_pll3(ufs_tegra,
 								false);
 			} else {
-				ufs_tegra_enable_ufs_uphy_pll3(ufs_tegra, true);
+				ufs_tegra_enable_ufs_uphy_pll3(ufs_tegra,
+					dev_req_params->hs_rate ==
+					PA_HS_MODE_B);
 			}
 		} else {
 			if (ufs_tegra->max_pwm_gear) {
@@ -1178,7 +1492,11 @@ static int ufs_tegra_pwr_change_notify(struct ufs_hba *hba,
 			sizeof(struct ufs_pa_layer_attr));
 		break;
 	case POST_CHANGE:
+		if (ufs_tegra->scaling.in_progress)
+			break;
 		ufs_tegra_print_power_mode_config(hba, dev_req_params);
+		if (ufs_tegra->enable_gear_scaling && dev_req_params->hs_rate)
+			ufs_tegra_scaling_link_up(hba, dev_req_params);
 		break;
 	default:
 		break;
@@ -1352,6 +1670,10 @@ static void ufs_tegra_config_soc_data(struct ufs_tegra_host *ufs_tegra)
 		of_property_read_bool(np, "nvidia,enable-ufs-provisioning");
 	ufs_tegra->configure_uphy_pll3 =
 		of_property_read_bool(np, "nvidia,configure-uphy-pll3");
+	ufs_tegra->enable_gear_scaling =
+		of_property_read_bool(np, "nvidia,enable-gear-scaling");
+	ufs_tegra->enable_inline_crypto =
+		of_property_read_bool(np, "nvidia,enable-inline-crypto");
 
 
 	of_property_read_u32(np, "nvidia,max-hs-gear", &ufs_tegra->max_hs_gear);
@@ -1397,6 +1719,19 @@ static int ufs_tegra_init(struct ufs_hba *hba)
 	hba->rpm_lvl = UFS_PM_LVL_1;
 	hba->caps |= UFSHCD_CAP_INTR_AGGR;
 
+	/*
+	 * Inline encryption goes through the core ufshcd-crypto support,
+	 * which checks the controller capability, sets up the keyslot
+	 * manager and programs the per request crypto config.
+	 */
+	if (ufs_tegra->enable_inline_crypto) {
+#ifdef CONFIG_SCSI_UFS_CRYPTO
+		hba->caps |= UFSHCD_CAP_CRYPTO;
+#else
+		dev_warn(dev, "inline crypto needs CONFIG_SCSI_UFS_CRYPTO\n");
+#endif
+	}
+
 	ufs_tegra->ufs_pinctrl = devm_pinctrl_get(dev);
 	if (IS_ERR_OR_NULL(ufs_tegra->ufs_pinctrl)) {
 		err = PTR_ERR(ufs_tegra->ufs_pinctrl);
@@ -1543,6 +1878,7 @@ static void ufs_tegra_exit(struct ufs_hba *hba)
 {
 	struct ufs_tegra_host *ufs_tegra = hba->priv;
 
+	ufs_tegra_scaling_exit(ufs_tegra);
 	if (tegra_platform_is_silicon())
 		ufs_tegra_disable_mphylane_clks(ufs_tegra);
 #ifdef CONFIG_DEBUG_FS
@@ -1569,6 +1905,9 @@ struct ufs_hba_variant_ops ufs_hba_tegra_vops = {
 	.pwr_change_notify      = ufs_tegra_pwr_change_notify,
 	.hibern8_entry_notify   = ufs_tegra_hibern8_entry_notify,
 	.set_ufs_mphy_clocks	= ufs_tegra_set_ufs_mphy_clocks,
+#ifdef CONFIG_PM_DEVFREQ
+	.setup_xfer_req		= ufs_tegra_setup_xfer_req,
+#endif
 };
 
 static int ufs_tegra_probe(struct platform_device *pdev)
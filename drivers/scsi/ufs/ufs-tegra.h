@@ -22,6 +22,9 @@
 
 #include <linux/io.h>
 #include <linux/padctrl/padctrl.h>
+#ifdef CONFIG_PM_DEVFREQ
+#include <linux/devfreq.h>
+#endif
 
 #define NV_ADDRESS_MAP_MPHY_L0_BASE	0x02470000
 #define NV_ADDRESS_MAP_MPHY_L1_BASE	0x02480000
@@ -88,6 +91,9 @@
 #define UFS_AUX_ADDR_RANGE	0x18
 
 /*UFS Clock Defines*/
+/* UFSHCI 2.1 CAP.CS, controller has an inline crypto engine */
+#define UFS_TEGRA_CAP_CRYPTO	(1 << 28)
+
 #define UFSHC_CLK_FREQ		204000000
 #define UFSDEV_CLK_FREQ		19200000
 
@@ -95,6 +101,22 @@
 #define UFS_CLK_UPHY_PLL3_RATEA 4992000000
 #define UFS_CLK_UPHY_PLL3_RATEB 5840000000
 
+/*
+ * HS gear scaling. Levels are reported to devfreq as the lane rate in
+ * kbit/s, G1..max gear in rate A and the max gear again in rate B.
+ */
+#define UFS_TEGRA_HS_G1_RATEA_KBPS	1248000
+#define UFS_TEGRA_HS_G1_RATEB_KBPS	1457600
+#define UFS_TEGRA_MAX_SCALE_LEVELS	(UFS_HS_G3 + 1)
+#define UFS_TEGRA_SCALE_POLL_MS		50
+#define UFS_TEGRA_SCALE_UP_THRESHOLD	70
+#define UFS_TEGRA_SCALE_DOWN_DIFF	20
+/* don't drop a gear within this long of the last switch */
+#define UFS_TEGRA_SCALE_DOWN_HOLD_MS	200
+/* average queue depth counted as a fully busy link */
+#define UFS_TEGRA_SCALE_QD_BUSY		4
+#define UFS_TEGRA_SCALE_IDLE_TIMEOUT_MS	100
+
 enum ufs_state {
 	UFSHC_INIT,
 	UFSHC_SUSPEND,
@@ -243,6 +265,36 @@ static u16  __attribute__ ((unused)) mphy_tx_apb[] = {
 0x17c  /* MPHY_TX_APB_TX_PAD_OVR_CTRL1_0    */
 };
 
+struct ufs_tegra_scale_level {
+	u32 gear;
+	u32 hs_rate;
+};
+
+struct ufs_tegra_scaling {
+#ifdef CONFIG_PM_DEVFREQ
+	struct devfreq *devfreq;
+	struct devfreq_dev_profile profile;
+	struct devfreq_simple_ondemand_data ondemand;
+#endif
+	struct ufs_tegra_scale_level levels[UFS_TEGRA_MAX_SCALE_LEVELS];
+	unsigned long freq_table[UFS_TEGRA_MAX_SCALE_LEVELS];
+	int nr_levels;
+	int cur;
+	bool in_progress;
+	unsigned long last_switch;
+	/* load of the current window, updated under host_lock */
+	ktime_t window_start;
+	u64 window_bytes;
+	u32 window_reqs;
+	u32 window_qd;
+	/* transition statistics */
+	u32 up_count;
+	u32 down_count;
+	u32 last_lat_us;
+	u32 max_lat_us;
+	u64 total_lat_us;
+};
+
 struct ufs_tegra_host {
 	struct ufs_hba *hba;
 	bool is_lane_clks_enabled;
@@ -254,6 +306,11 @@ struct ufs_tegra_host {
 	bool mask_fast_auto_mode;
 	bool mask_hs_mode_b;
 	bool configure_uphy_pll3;
+	bool uphy_pll3_enabled;
+	bool uphy_pll3_rate_b;
+	bool enable_gear_scaling;
+	bool enable_inline_crypto;
+	struct ufs_tegra_scaling scaling;
 	u32 max_pwm_gear;
 	enum ufs_state ufshc_state;
 	void *mphy_context;
@@ -315,6 +372,8 @@ struct ufs_tegra_host {
 
 extern struct ufs_hba_variant_ops ufs_hba_tegra_vops;
 extern int ufshcd_rescan(struct ufs_hba *hb);
+extern int ufshcd_config_pwr_mode(struct ufs_hba *hba,
+		struct ufs_pa_layer_attr *desired_pwr_mode);
 void ufs_rescan(struct work_struct *work);
 
 static inline u32 mphy_readl(void __iomem *mphy_base, u32 offset)
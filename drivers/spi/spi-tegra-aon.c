@@ -54,6 +54,8 @@ struct tegra_spi_data {
 	struct tegra_spi_device_controller_data cdata[MAX_CHIP_SELECT];
 	struct aon_spi_response			*spi_resp;
 	struct aon_spi_request			*spi_req;
+	/* bytes of the pending response that are of any use */
+	size_t					resp_len;
 };
 
 
@@ -96,15 +98,23 @@ static void tegra_aon_spi_mbox_rcv_msg(struct mbox_client *cl, void *mssg)
 	struct spi_master *master = dev_get_drvdata(cl->dev);
 	struct tegra_spi_data *tspi = spi_master_get_devdata(master);
 
-	memcpy(tspi->spi_resp, msg->data, sizeof(*tspi->spi_resp));
+	/* Don't copy a whole frame back just to read a short response */
+	memcpy(tspi->spi_resp, msg->data,
+	       min_t(size_t, tspi->resp_len, sizeof(*tspi->spi_resp)));
 	complete(tspi->xfer_completion);
 }
 
-static int ivc_aon_spi_send_req(struct tegra_spi_data *tspi, int len)
+#define AON_SPI_RESP_STATUS_LEN	sizeof(u32)
+#define AON_SPI_RESP_XFER_LEN(len) \
+	(offsetof(struct aon_spi_response, data.xfer.data) + (len))
+
+static int ivc_aon_spi_send_req(struct tegra_spi_data *tspi, int len,
+				size_t resp_len)
 {
 	int status;
 	struct tegra_aon_mbox_msg msg;
 
+	tspi->resp_len = resp_len;
 	msg.length = len;
 	msg.data = (void *)tspi->spi_req;
 	status = mbox_send_message(tspi->mbox, (void *)&msg);
@@ -131,7 +141,7 @@ static int do_ivc_aon_spi_init(struct tegra_spi_data *tspi)
 
 	tspi->spi_req->req_type = AON_SPI_REQUEST_TYPE_INIT;
 	len = sizeof(tspi->spi_req->req_type);
-	status = ivc_aon_spi_send_req(tspi, len);
+	status = ivc_aon_spi_send_req(tspi, len, AON_SPI_RESP_STATUS_LEN);
 	if (status)
 		return -EIO;
 
@@ -160,7 +170,7 @@ static int do_ivc_aon_spi_setup(struct spi_device *spi,
 	/* TODO: No-Dma support to be added for core driver */
 	req->data.setup.spi_no_dma = false;
 	len = (sizeof(req->req_type) + sizeof(struct aon_spi_setup_request));
-	status = ivc_aon_spi_send_req(tspi, len);
+	status = ivc_aon_spi_send_req(tspi, len, AON_SPI_RESP_STATUS_LEN);
 	if (status)
 		return -EIO;
 
@@ -183,54 +193,115 @@ static void tegra_spi_dump_buf(u8 *buffer, int len, const char *name)
 }
 #endif
 
+/*
+ * Every exchange with the AON firmware is a full IVC round trip, so run
+ * adjacent transfers of a message as one full-duplex transfer when the
+ * firmware could not tell the difference: same clocking, single wire
+ * lanes and no chip select toggle or delay in between. Write-only parts
+ * see their MISO data dropped and read-only parts clock out zeros, which
+ * is what a typical command + read register access already expects.
+ */
+static bool tegra_aon_spi_can_merge(struct spi_transfer *prev,
+				    struct spi_transfer *next,
+				    unsigned int len)
+{
+	return !prev->cs_change && !prev->delay_usecs &&
+		prev->speed_hz == next->speed_hz &&
+		prev->bits_per_word == next->bits_per_word &&
+		prev->tx_nbits <= SPI_NBITS_SINGLE &&
+		prev->rx_nbits <= SPI_NBITS_SINGLE &&
+		next->tx_nbits <= SPI_NBITS_SINGLE &&
+		next->rx_nbits <= SPI_NBITS_SINGLE &&
+		len + next->len <= AON_SPI_MAX_DATA_SIZE;
+}
+
+/* Run the transfers first..last, which have length bytes in total */
 static int do_aon_ivc_spi_xfer(struct spi_device *spi,
-					struct spi_transfer *spi_xfer,
+					struct spi_transfer *first,
+					struct spi_transfer *last,
+					unsigned int length,
 					struct tegra_spi_data *tspi,
 					enum aon_spi_xfer_flag xfer_type)
 {
-	int length = 0, status = 0;
+	int status = 0;
 	struct aon_spi_request *req = tspi->spi_req;
 	struct aon_spi_response *resp = tspi->spi_resp;
+	struct spi_transfer *spi_xfer;
+	bool tx = false, rx = false;
+	unsigned int off;
+
+	if (length > AON_SPI_MAX_DATA_SIZE) {
+		dev_err(tspi->dev, "length %u greater than max length\n",
+			length);
+		return -E2BIG;
+	}
+
+	for (spi_xfer = first; ; spi_xfer = list_next_entry(spi_xfer,
+							     transfer_list)) {
+		tx |= !!spi_xfer->tx_buf;
+		rx |= !!spi_xfer->rx_buf;
+		if (spi_xfer == last)
+			break;
+	}
 
 	req->req_type = AON_SPI_REQUEST_TYPE_XFER;
 
 	req->data.xfer.xfers.flags = xfer_type;
-	if (spi_xfer->tx_buf)
+	if (tx)
 		req->data.xfer.xfers.flags |= AON_SPI_XFER_FLAG_WRITE;
-	if (spi_xfer->rx_buf)
+	if (rx)
 		req->data.xfer.xfers.flags |= AON_SPI_XFER_FLAG_READ;
 
-	req->data.xfer.xfers.length = spi_xfer->len;
+	req->data.xfer.xfers.length = length;
 	req->data.xfer.xfers.rx_buf_offset = 0;
 	req->data.xfer.xfers.tx_buf_offset = 0;
 	req->data.xfer.xfers.chip_select = spi->chip_select;
-	req->data.xfer.xfers.tx_nbits = spi_xfer->tx_nbits;
-	req->data.xfer.xfers.rx_nbits = spi_xfer->rx_nbits;
-	req->data.xfer.xfers.bits_per_word = spi_xfer->bits_per_word;
+	req->data.xfer.xfers.tx_nbits = first->tx_nbits;
+	req->data.xfer.xfers.rx_nbits = first->rx_nbits;
+	req->data.xfer.xfers.bits_per_word = first->bits_per_word;
 	req->data.xfer.xfers.mode = spi->mode;
-	req->data.xfer.xfers.spi_clk_rate = spi_xfer->speed_hz;
+	req->data.xfer.xfers.spi_clk_rate = first->speed_hz;
 	/* per-word bits-on-wire */
 
-	if (spi_xfer->tx_buf) {
-		memcpy(req->data.xfer.data, spi_xfer->tx_buf, spi_xfer->len);
-		tegra_spi_dump_buf(req->data.xfer.data, spi_xfer->len,
-				   "reqdata");
+	if (tx) {
+		off = 0;
+		for (spi_xfer = first; ; spi_xfer = list_next_entry(spi_xfer,
+							     transfer_list)) {
+			if (spi_xfer->tx_buf)
+				memcpy(req->data.xfer.data + off,
+				       spi_xfer->tx_buf, spi_xfer->len);
+			else
+				memset(req->data.xfer.data + off, 0,
+				       spi_xfer->len);
+			off += spi_xfer->len;
+			if (spi_xfer == last)
+				break;
+		}
+		tegra_spi_dump_buf(req->data.xfer.data, length, "reqdata");
 	}
 	/* alignmemt + data */
-	length = (TEGRA_IVC_ALIGN + spi_xfer->len + 1);
-	if (spi_xfer->len > AON_SPI_MAX_DATA_SIZE) {
-		dev_err(tspi->dev, "length %d greater than max length\n",
-			spi_xfer->len);
-		return -E2BIG;
-	}
-	status = ivc_aon_spi_send_req(tspi, length);
+	status = ivc_aon_spi_send_req(tspi, TEGRA_IVC_ALIGN + length + 1,
+			rx ? AON_SPI_RESP_XFER_LEN(length) :
+			AON_SPI_RESP_STATUS_LEN);
 	if (status) {
 		dev_err(tspi->dev, "Error in transfer\n");
 		return -EIO;
 	}
-	if (spi_xfer->rx_buf) {
-		memcpy(spi_xfer->rx_buf, resp->data.xfer.data, spi_xfer->len);
-		tegra_spi_dump_buf(spi_xfer->rx_buf, spi_xfer->len, "rxdata");
+	if (rx) {
+		off = 0;
+		for (spi_xfer = first; ; spi_xfer = list_next_entry(spi_xfer,
+							     transfer_list)) {
+			if (spi_xfer->rx_buf) {
+				memcpy(spi_xfer->rx_buf,
+				       resp->data.xfer.data + off,
+				       spi_xfer->len);
+				tegra_spi_dump_buf(spi_xfer->rx_buf,
+						   spi_xfer->len, "rxdata");
+			}
+			off += spi_xfer->len;
+			if (spi_xfer == last)
+				break;
+		}
 	}
 
 	return 0;
@@ -240,25 +311,40 @@ static int tegra_spi_transfer_one_message(struct spi_master *master,
 			struct spi_message *msg)
 {
 	struct tegra_spi_data *tspi = spi_master_get_devdata(master);
-	struct spi_transfer *xfer;
+	struct spi_transfer *first, *last, *next;
+	unsigned int len;
 	int ret = -1;
-	int count = 0;
-	u16 flags = 0;
+	u16 flags;
 
 	msg->status = 0;
 	msg->actual_length = 0;
 
-	list_for_each_entry(xfer, &msg->transfers, transfer_list) {
-		flags |= AON_SPI_XFER_HANDLE_CACHE;
-		if (count == 0)
+	first = list_first_entry(&msg->transfers, struct spi_transfer,
+				 transfer_list);
+	while (&first->transfer_list != &msg->transfers) {
+		last = first;
+		len = first->len;
+		while (!list_is_last(&last->transfer_list, &msg->transfers)) {
+			next = list_next_entry(last, transfer_list);
+			if (!tegra_aon_spi_can_merge(last, next, len))
+				break;
+			len += next->len;
+			last = next;
+		}
+
+		flags = AON_SPI_XFER_HANDLE_CACHE;
+		if (first->transfer_list.prev == &msg->transfers)
 			flags |= AON_SPI_XFER_FIRST_MSG;
-		if (list_is_last(&xfer->transfer_list, &msg->transfers))
+		if (list_is_last(&last->transfer_list, &msg->transfers))
 			flags |= AON_SPI_XFER_LAST_MSG;
 
-		ret = do_aon_ivc_spi_xfer(msg->spi, xfer, tspi, flags);
-		if (!ret)
-			msg->actual_length += xfer->len;
-		count++;
+		ret = do_aon_ivc_spi_xfer(msg->spi, first, last, len, tspi,
+					  flags);
+		if (ret)
+			break;
+		msg->actual_length += len;
+
+		first = list_next_entry(last, transfer_list);
 	}
 
 	msg->status = ret;
@@ -447,7 +533,7 @@ static int tegra_aon_spi_suspend(struct device *dev)
 
 	tspi->spi_req->req_type = AON_SPI_REQUEST_TYPE_SUSPEND;
 	len = sizeof(tspi->spi_req->req_type);
-	status = ivc_aon_spi_send_req(tspi, len);
+	status = ivc_aon_spi_send_req(tspi, len, AON_SPI_RESP_STATUS_LEN);
 	if (status)
 		return -EBUSY;
 
@@ -462,7 +548,7 @@ static int tegra_aon_spi_resume(struct device *dev)
 
 	tspi->spi_req->req_type = AON_SPI_REQUEST_TYPE_RESUME;
 	len = sizeof(tspi->spi_req->req_type);
-	ret = ivc_aon_spi_send_req(tspi, len);
+	ret = ivc_aon_spi_send_req(tspi, len, AON_SPI_RESP_STATUS_LEN);
 	if (ret)
 		return -EIO;
 
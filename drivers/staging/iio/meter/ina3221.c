@@ -25,6 +25,7 @@
 #include <linux/device.h>
 #include <linux/err.h>
 #include <linux/i2c.h>
+#include <linux/ktime.h>
 #include <linux/iio/iio.h>
 #include <linux/iio/sysfs.h>
 #include <linux/init.h>
@@ -85,6 +86,9 @@
 
 #define INA3221_MAX_CONVERSION_TRIALS 10
 
+#define INA3221_STREAM_RING_SIZE	512
+#define INA3221_STREAM_WINDOW_MS	1000
+
 #define PACK_MODE_CHAN(mode, chan)	((mode) | ((chan) << 8))
 #define UNPACK_MODE(address)		((address) & 0xFF)
 #define UNPACK_CHAN(address)		(((address) >> 8) & 0xFF)
@@ -100,6 +104,9 @@ enum {
 	POLL_DELAY,
 	INPUT_CURRENT_SUM,
 	CRIT_CURRENT_SUM_LIMIT,
+	STREAM_PERIOD,
+	STREAM_WINDOW,
+	STREAM_STATS,
 };
 
 enum mode {
@@ -131,6 +138,25 @@ struct poll_worker_data {
 	u32 poll_delay;
 };
 
+/* one sample of all rails taken by the stream worker */
+struct ina3221_stream_sample {
+	s64 ts_ns;
+	s32 voltage_mv[INA3221_NUMBER_OF_RAILS];
+	s32 current_ma[INA3221_NUMBER_OF_RAILS];
+};
+
+struct ina3221_stream {
+	struct delayed_work work;
+	struct ina3221_stream_sample *ring;
+	unsigned int head;
+	unsigned int count;
+	u32 period_ms;
+	u32 window_ms;
+	int saved_mode;
+	s64 ts_last_ns;
+	s64 energy_nj[INA3221_NUMBER_OF_RAILS];
+};
+
 struct ina3221_chan_pdata {
 	const char *rail_name;
 	u32 crit_power_limits;
@@ -148,6 +174,7 @@ struct ina3221_platform_data {
 	bool enable_channel_sum;
 	u32 crit_current_limit_sum;
 	u32 channel_sum_shunt_resistor;
+	u32 stream_period_ms;
 	struct ina3221_chan_pdata cpdata[INA3221_NUMBER_OF_RAILS];
 };
 
@@ -162,6 +189,7 @@ struct ina3221_chip {
 	int alert_enabled;
 	struct notifier_block nb_hot;
 	struct notifier_block nb_cpufreq;
+	struct ina3221_stream stream;
 };
 
 static int __locked_ina3221_switch_mode(struct ina3221_chip *chip,
@@ -1072,6 +1100,206 @@ static void ina_channel_poll_work_func(struct work_struct *work)
 			 .poll_worker.poll_queue), poll_data->poll_delay);
 }
 
+static int __locked_read_all_rails(struct ina3221_chip *chip,
+		struct ina3221_stream_sample *s)
+{
+	struct ina3221_chan_pdata *cpdata;
+	int ret, ch;
+
+	ret = __locked_start_conversion(chip);
+	if (ret < 0)
+		return ret;
+
+	for (ch = 0; ch < INA3221_NUMBER_OF_RAILS; ch++) {
+		cpdata = &chip->pdata->cpdata[ch];
+		if (!cpdata->rail_name || !cpdata->shunt_resistor) {
+			s->voltage_mv[ch] = 0;
+			s->current_ma[ch] = 0;
+			continue;
+		}
+
+		ret = i2c_smbus_read_word_data(chip->client,
+					       INA3221_SHUNT_VOL(ch));
+		if (ret < 0)
+			return ret;
+		s->current_ma[ch] = shuntv_register_to_ma(be16_to_cpu(ret),
+				cpdata->shunt_resistor, cpdata->shuntv_offset);
+
+		ret = i2c_smbus_read_word_data(chip->client,
+					       INA3221_BUS_VOL(ch));
+		if (ret < 0)
+			return ret;
+		s->voltage_mv[ch] = busv_register_to_mv(be16_to_cpu(ret));
+	}
+
+	return __locked_end_conversion(chip);
+}
+
+static void ina3221_stream_work_func(struct work_struct *work)
+{
+	struct ina3221_chip *chip = container_of(work, struct ina3221_chip,
+						 stream.work.work);
+	struct ina3221_stream *stream = &chip->stream;
+	struct ina3221_stream_sample *s;
+	s64 dt_us;
+	int ret, ch;
+
+	mutex_lock(&chip->mutex);
+	if (!stream->period_ms || chip->is_suspended ||
+	    chip->shutdown_complete) {
+		mutex_unlock(&chip->mutex);
+		return;
+	}
+
+	s = &stream->ring[stream->head];
+	ret = __locked_read_all_rails(chip, s);
+	if (ret < 0) {
+		dev_err(chip->dev, "Stream read failed: %d\n", ret);
+		goto exit;
+	}
+
+	s->ts_ns = ktime_to_ns(ktime_get());
+	if (stream->ts_last_ns) {
+		/* energy integrates the power over the time since last */
+		dt_us = div_s64(s->ts_ns - stream->ts_last_ns, NSEC_PER_USEC);
+		for (ch = 0; ch < INA3221_NUMBER_OF_RAILS; ch++)
+			stream->energy_nj[ch] += div_s64(dt_us *
+					s->voltage_mv[ch] * s->current_ma[ch],
+					1000);
+	}
+	stream->ts_last_ns = s->ts_ns;
+	stream->head = (stream->head + 1) % INA3221_STREAM_RING_SIZE;
+	if (stream->count < INA3221_STREAM_RING_SIZE)
+		stream->count++;
+exit:
+	mod_delayed_work(system_freezable_wq, &stream->work,
+			 msecs_to_jiffies(stream->period_ms));
+	mutex_unlock(&chip->mutex);
+}
+
+static int ina3221_stream_start(struct ina3221_chip *chip, u32 period_ms)
+{
+	struct ina3221_stream *stream = &chip->stream;
+	int mode;
+	int ret = 0;
+
+	if (!stream->ring) {
+		stream->ring = devm_kcalloc(chip->dev, INA3221_STREAM_RING_SIZE,
+					    sizeof(*stream->ring), GFP_KERNEL);
+		if (!stream->ring)
+			return -ENOMEM;
+	}
+
+	mutex_lock(&chip->mutex);
+	mode = chip->mode;
+	if (!stream->period_ms)
+		stream->saved_mode = mode;
+	mutex_unlock(&chip->mutex);
+
+	/* leave the device converting instead of triggering every read */
+	if (mode != FORCED_CONTINUOUS)
+		ret = ina3221_set_mode_val(chip, 1);
+	if (ret < 0)
+		return ret;
+
+	mutex_lock(&chip->mutex);
+	if (!stream->period_ms) {
+		stream->head = 0;
+		stream->count = 0;
+		stream->ts_last_ns = 0;
+	}
+	stream->period_ms = period_ms;
+	mod_delayed_work(system_freezable_wq, &stream->work, 0);
+	mutex_unlock(&chip->mutex);
+	return 0;
+}
+
+static int ina3221_stream_stop(struct ina3221_chip *chip)
+{
+	struct ina3221_stream *stream = &chip->stream;
+	int mode;
+
+	mutex_lock(&chip->mutex);
+	if (!stream->period_ms) {
+		mutex_unlock(&chip->mutex);
+		return 0;
+	}
+
+	stream->period_ms = 0;
+	mode = stream->saved_mode;
+	mutex_unlock(&chip->mutex);
+	cancel_delayed_work_sync(&stream->work);
+
+	if (mode == FORCED_CONTINUOUS)
+		return 0;
+
+	return ina3221_set_mode_val(chip, mode == FORCED_TRIGGERED ? 0 : -1);
+}
+
+static ssize_t ina3221_stream_stats(struct ina3221_chip *chip, char *buf)
+{
+	struct ina3221_stream *stream = &chip->stream;
+	struct ina3221_stream_sample *s;
+	s64 sum_mv[INA3221_NUMBER_OF_RAILS] = { 0 };
+	s64 sum_ma[INA3221_NUMBER_OF_RAILS] = { 0 };
+	s64 sum_mw[INA3221_NUMBER_OF_RAILS] = { 0 };
+	s32 peak_mw[INA3221_NUMBER_OF_RAILS] = { 0 };
+	s64 energy_nj[INA3221_NUMBER_OF_RAILS];
+	s64 ts_start;
+	unsigned int i, idx, n = 0;
+	ssize_t len = 0;
+	s32 mw;
+	int ch;
+
+	mutex_lock(&chip->mutex);
+	if (chip->shutdown_complete) {
+		mutex_unlock(&chip->mutex);
+		return -EIO;
+	}
+
+	ts_start = stream->ts_last_ns - (s64)stream->window_ms * NSEC_PER_MSEC;
+	/* newest to oldest until the window is covered */
+	for (i = 0; i < stream->count; i++) {
+		idx = (stream->head + INA3221_STREAM_RING_SIZE - 1 - i) %
+			INA3221_STREAM_RING_SIZE;
+		s = &stream->ring[idx];
+		if (s->ts_ns < ts_start)
+			break;
+
+		for (ch = 0; ch < INA3221_NUMBER_OF_RAILS; ch++) {
+			mw = (s->voltage_mv[ch] * s->current_ma[ch]) / 1000;
+			sum_mv[ch] += s->voltage_mv[ch];
+			sum_ma[ch] += s->current_ma[ch];
+			sum_mw[ch] += mw;
+			if (!n || mw > peak_mw[ch])
+				peak_mw[ch] = mw;
+		}
+		n++;
+	}
+	memcpy(energy_nj, stream->energy_nj, sizeof(energy_nj));
+	len = snprintf(buf, PAGE_SIZE, "samples %u window %u ms\n",
+		       n, stream->window_ms);
+	mutex_unlock(&chip->mutex);
+
+	for (ch = 0; ch < INA3221_NUMBER_OF_RAILS; ch++) {
+		if (!chip->pdata->cpdata[ch].rail_name)
+			continue;
+
+		if (n) {
+			sum_mv[ch] = div_s64(sum_mv[ch], n);
+			sum_ma[ch] = div_s64(sum_ma[ch], n);
+			sum_mw[ch] = div_s64(sum_mw[ch], n);
+		}
+		len += snprintf(buf + len, PAGE_SIZE - len,
+				"%s: %lld mv %lld ma %lld mw peak %d mw %lld uj\n",
+				chip->pdata->cpdata[ch].rail_name, sum_mv[ch],
+				sum_ma[ch], sum_mw[ch], peak_mw[ch],
+				div_s64(energy_nj[ch], 1000));
+	}
+
+	return len;
+}
+
 static ssize_t ina3221_show_channel(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -1144,6 +1372,17 @@ static ssize_t ina3221_show_channel(struct device *dev,
 					.poll_worker.poll_delay);
 		return snprintf(buf, PAGE_SIZE, "%d ms\n", ret);
 
+	case STREAM_PERIOD:
+		return snprintf(buf, PAGE_SIZE, "%u ms\n",
+				chip->stream.period_ms);
+
+	case STREAM_WINDOW:
+		return snprintf(buf, PAGE_SIZE, "%u ms\n",
+				chip->stream.window_ms);
+
+	case STREAM_STATS:
+		return ina3221_stream_stats(chip, buf);
+
 	default:
 		break;
 	}
@@ -1231,6 +1470,33 @@ static ssize_t ina3221_set_channel(struct device *dev,
 					      .poll_worker.poll_queue));
 		}
 		return len;
+
+	case STREAM_PERIOD:
+		if (kstrtol(buf, 10, &val) < 0 || val < 0)
+			return -EINVAL;
+
+		if (val)
+			ret = ina3221_stream_start(chip, (u32)val);
+		else
+			ret = ina3221_stream_stop(chip);
+		return ret < 0 ? ret : len;
+
+	case STREAM_WINDOW:
+		if (kstrtol(buf, 10, &val) < 0 || val <= 0)
+			return -EINVAL;
+
+		mutex_lock(&chip->mutex);
+		chip->stream.window_ms = (u32)val;
+		mutex_unlock(&chip->mutex);
+		return len;
+
+	case STREAM_STATS:
+		/* any write restarts the energy integration */
+		mutex_lock(&chip->mutex);
+		memset(chip->stream.energy_nj, 0,
+		       sizeof(chip->stream.energy_nj));
+		mutex_unlock(&chip->mutex);
+		return len;
 	}
 	return -EINVAL;
 }
@@ -1306,6 +1572,16 @@ static IIO_DEVICE_ATTR(crit_current_limit_sum, S_IRUGO | S_IWUSR,
 		ina3221_show_channel, ina3221_set_channel,
 		PACK_MODE_CHAN(CRIT_CURRENT_SUM_LIMIT, 0));
 
+static IIO_DEVICE_ATTR(stream_period_ms, S_IRUGO | S_IWUSR,
+		ina3221_show_channel, ina3221_set_channel,
+		PACK_MODE_CHAN(STREAM_PERIOD, 0));
+static IIO_DEVICE_ATTR(stream_window_ms, S_IRUGO | S_IWUSR,
+		ina3221_show_channel, ina3221_set_channel,
+		PACK_MODE_CHAN(STREAM_WINDOW, 0));
+static IIO_DEVICE_ATTR(stream_stats, S_IRUGO | S_IWUSR,
+		ina3221_show_channel, ina3221_set_channel,
+		PACK_MODE_CHAN(STREAM_STATS, 0));
+
 static struct attribute *ina3221_attributes[] = {
 	&iio_dev_attr_rail_name_0.dev_attr.attr,
 	&iio_dev_attr_rail_name_1.dev_attr.attr,
@@ -1328,6 +1604,9 @@ static struct attribute *ina3221_attributes[] = {
 	&iio_dev_attr_polling_delay_2.dev_attr.attr,
 	&iio_dev_attr_in_current_sum_input.dev_attr.attr,
 	&iio_dev_attr_crit_current_limit_sum.dev_attr.attr,
+	&iio_dev_attr_stream_period_ms.dev_attr.attr,
+	&iio_dev_attr_stream_window_ms.dev_attr.attr,
+	&iio_dev_attr_stream_stats.dev_attr.attr,
 	NULL,
 };
 
@@ -1478,6 +1757,10 @@ static struct ina3221_platform_data *ina3221_get_platform_data_dt(
 	else
 		pdata->crit_current_limit_sum = U32_MINUS_1;
 
+	ret = of_property_read_u32(np, "ti,stream-period-ms", &pval);
+	if (!ret)
+		pdata->stream_period_ms = pval;
+
 	for_each_child_of_node(np, child) {
 		ret = of_property_read_u32(child, "reg", &reg);
 		if (ret || reg >= 3) {
@@ -1568,6 +1851,8 @@ static int ina3221_probe(struct i2c_client *client,
 		chip->mode = TRIGGERED;
 	chip->shutdown_complete = 0;
 	chip->is_suspended = 0;
+	chip->stream.window_ms = INA3221_STREAM_WINDOW_MS;
+	INIT_DELAYED_WORK(&chip->stream.work, ina3221_stream_work_func);
 
 	indio_dev->info = &ina3221_info;
 	indio_dev->channels = ina3221_channels_spec;
@@ -1674,6 +1959,13 @@ static int ina3221_probe(struct i2c_client *client,
 				  .poll_worker.poll_queue,
 				  ina_channel_poll_work_func);
 	}
+
+	if (pdata->stream_period_ms) {
+		ret = ina3221_stream_start(chip, pdata->stream_period_ms);
+		if (ret < 0)
+			dev_err(&client->dev, "INA stream start failed: %d\n",
+				ret);
+	}
 	return 0;
 exit_pd:
 	unregister_hotcpu_notifier(&(chip->nb_hot));
@@ -1687,6 +1979,11 @@ static int ina3221_remove(struct i2c_client *client)
 	struct iio_dev *indio_dev = i2c_get_clientdata(client);
 	struct ina3221_chip *chip = iio_priv(indio_dev);
 
+	mutex_lock(&chip->mutex);
+	chip->stream.period_ms = 0;
+	mutex_unlock(&chip->mutex);
+	cancel_delayed_work_sync(&chip->stream.work);
+
 	mutex_lock(&chip->mutex);
 	__locked_power_down_ina3221(chip);
 	mutex_unlock(&chip->mutex);
@@ -1701,6 +1998,11 @@ static void ina3221_shutdown(struct i2c_client *client)
 	struct iio_dev *indio_dev = i2c_get_clientdata(client);
 	struct ina3221_chip *chip = iio_priv(indio_dev);
 
+	mutex_lock(&chip->mutex);
+	chip->stream.period_ms = 0;
+	mutex_unlock(&chip->mutex);
+	cancel_delayed_work_sync(&chip->stream.work);
+
 	mutex_lock(&chip->mutex);
 	__locked_power_down_ina3221(chip);
 	chip->shutdown_complete = 1;
@@ -1713,8 +2015,10 @@ static int ina3221_suspend(struct device *dev)
 	struct ina3221_chip *chip = to_ina3221_chip(dev);
 	int ret = 0;
 
+	cancel_delayed_work_sync(&chip->stream.work);
 	mutex_lock(&chip->mutex);
-	if (chip->mode != FORCED_CONTINUOUS) {
+	if (chip->mode != FORCED_CONTINUOUS || (chip->stream.period_ms &&
+			chip->stream.saved_mode != FORCED_CONTINUOUS)) {
 		ret = __locked_power_down_ina3221(chip);
 		if (ret < 0) {
 			dev_err(dev, "INA can't be turned off: 0x%x\n", ret);
@@ -1747,6 +2051,11 @@ static int ina3221_resume(struct device *dev)
 	if (ret < 0)
 		dev_err(dev, "INA can't be turned off/on: 0x%x\n", ret);
 	chip->is_suspended = 0;
+	if (chip->stream.period_ms) {
+		/* the sleep isn't part of the energy */
+		chip->stream.ts_last_ns = 0;
+		mod_delayed_work(system_freezable_wq, &chip->stream.work, 0);
+	}
 	mutex_unlock(&chip->mutex);
 	return ret;
 }
@@ -42,10 +42,6 @@ static struct uart_port tegra_combined_uart_port;
 static struct console tegra_combined_uart_console;
 static struct uart_driver tegra_combined_uart_driver;
 
-static void tegra_combined_uart_console_write(struct console *co,
-						const char *s,
-						unsigned int count);
-
 static DEFINE_SPINLOCK(tx_lock);
 
 /*
@@ -103,25 +99,6 @@ static int uart_shutdown(struct uart_port *port)
 	return 0;
 }
 
-static void tegra_combined_uart_start_tx(struct uart_port *port)
-{
-	unsigned long tail;
-	unsigned long count;
-	struct circ_buf *xmit = &port->state->xmit;
-
-	while (true) {
-		tail = (unsigned long)&xmit->buf[xmit->tail];
-		count = CIRC_CNT_TO_END(xmit->head, xmit->tail, UART_XMIT_SIZE);
-
-		if (!count)
-			break;
-
-		tegra_combined_uart_console_write(NULL, (char *)tail, count);
-		xmit->tail = (xmit->tail + count) & (UART_XMIT_SIZE - 1);
-	}
-	uart_write_wakeup(port);
-}
-
 /*
  * Handles an RX message from the combined UART server.
  */
@@ -161,6 +138,58 @@ static u32 update_and_send_mbox(u32 mbox_val, char c)
 	return mbox_val;
 }
 
+static u32 pack_and_send_chars(u32 mbox_val, const char *s,
+			       unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (s[i] == '\n')
+			mbox_val = update_and_send_mbox(mbox_val, '\r');
+		mbox_val = update_and_send_mbox(mbox_val, s[i]);
+	}
+
+	return mbox_val;
+}
+
+static void send_partial_mbox(u32 mbox_val)
+{
+	if (!((mbox_val >> NUM_BYTES_FIELD_BIT) & 0x3))
+		return;
+
+	while (readl(spe_mbox_reg) & BIT(INTR_TRIGGER_BIT))
+		cpu_relax();
+	writel(mbox_val, spe_mbox_reg);
+}
+
+/*
+ * Drain the whole xmit ring in one pass, so the bytes on both sides of
+ * the wrap share packets and only the last packet may go out short.
+ */
+static void tegra_combined_uart_start_tx(struct uart_port *port)
+{
+	struct circ_buf *xmit = &port->state->xmit;
+	u32 mbox_val = BIT(INTR_TRIGGER_BIT);
+	unsigned long flags;
+	unsigned int count;
+
+	spin_lock_irqsave(&tx_lock, flags);
+	while (true) {
+		count = CIRC_CNT_TO_END(xmit->head, xmit->tail, UART_XMIT_SIZE);
+		if (!count)
+			break;
+
+		mbox_val = pack_and_send_chars(mbox_val,
+					       &xmit->buf[xmit->tail], count);
+		xmit->tail = (xmit->tail + count) & (UART_XMIT_SIZE - 1);
+		port->icount.tx += count;
+	}
+	send_partial_mbox(mbox_val);
+	spin_unlock_irqrestore(&tx_lock, flags);
+
+	uart_write_wakeup(port);
+}
+
 /*
  * This function splits the string to be printed (const char *s) into multiple
  * packets. Each packet contains a max of 3 characters. Packets are sent to the
@@ -173,23 +202,10 @@ static void tegra_combined_uart_console_write(struct console *co,
 {
 	u32 mbox_val = BIT(INTR_TRIGGER_BIT);
 	unsigned long flags;
-	unsigned int i;
 
 	spin_lock_irqsave(&tx_lock, flags);
-
-	/* Loop for processing each 3 char packet */
-	for (i = 0; i < count; i++) {
-		if (s[i] == '\n')
-			mbox_val = update_and_send_mbox(mbox_val, '\r');
-		mbox_val = update_and_send_mbox(mbox_val, s[i]);
-	}
-
-	if ((mbox_val >> NUM_BYTES_FIELD_BIT) & 0x3) {
-		while (readl(spe_mbox_reg) & BIT(INTR_TRIGGER_BIT))
-			cpu_relax();
-		writel(mbox_val, spe_mbox_reg);
-	}
-
+	mbox_val = pack_and_send_chars(mbox_val, s, count);
+	send_partial_mbox(mbox_val);
 	spin_unlock_irqrestore(&tx_lock, flags);
 }
 
@@ -40,6 +40,15 @@ static int use_dynamic_emc = 1;
 
 module_param_named(use_dynamic_emc, use_dynamic_emc, int, 0644);
 
+/*
+ * Bandwidth decreases smaller than this percentage of the current request
+ * are not passed on, to avoid EMC DVFS churn from small window changes.
+ * Increases are always applied.
+ */
+static unsigned int bw_hysteresis_pct = 5;
+
+module_param_named(bw_hysteresis_pct, bw_hysteresis_pct, uint, 0644);
+
 DEFINE_MUTEX(tegra_dcs_total_bw_lock);
 
 /* windows A, B, C for first and second display */
@@ -668,8 +677,48 @@ static inline int tegra_dc_is_yuv420(int fmt)
  * return:
  * bandwidth in kBps
  */
+static void tegra_dc_win_bw_key_fill(struct tegra_dc *dc,
+	struct tegra_dc_win *w, struct tegra_dc_win_bw_key *key)
+{
+	memset(key, 0, sizeof(*key));
+	key->fmt = w->fmt;
+	key->flags = w->flags;
+	key->w = w->w;
+	key->h = w->h;
+	key->out_w = w->out_w;
+	key->out_h = w->out_h;
+	key->pclk = dc->mode.pclk;
+}
+
+static unsigned long _tegra_dc_calc_win_bandwidth(struct tegra_dc *dc,
+	struct tegra_dc_win *w);
+
+/*
+ * Only recompute the bandwidth of windows whose size, format, scaling or
+ * mode changed since the last time.
+ */
 static unsigned long tegra_dc_calc_win_bandwidth(struct tegra_dc *dc,
 	struct tegra_dc_win *w)
+{
+	struct tegra_dc_win_bw_cache *cache;
+	struct tegra_dc_win_bw_key key;
+
+	if (!dc || w->idx >= DC_N_WINDOWS)
+		return _tegra_dc_calc_win_bandwidth(dc, w);
+
+	cache = &dc->win_bw[w->idx];
+	tegra_dc_win_bw_key_fill(dc, w, &key);
+	if (!cache->valid || memcmp(&cache->key, &key, sizeof(key))) {
+		cache->key = key;
+		cache->bandwidth = _tegra_dc_calc_win_bandwidth(dc, w);
+		cache->valid = true;
+	}
+
+	return cache->bandwidth;
+}
+
+static unsigned long _tegra_dc_calc_win_bandwidth(struct tegra_dc *dc,
+	struct tegra_dc_win *w)
 {
 	u64 ret;
 	int tiled_windows_bw_multiplier;
@@ -747,6 +796,51 @@ unsigned long tegra_dc_get_bandwidth(
 }
 EXPORT_SYMBOL(tegra_dc_get_bandwidth);
 
+static void tegra_dc_invalidate_la(struct tegra_dc *dc)
+{
+	int i;
+
+	for (i = 0; i < DC_N_WINDOWS; i++)
+		dc->win_bw[i].la_valid = false;
+}
+
+/*
+ * Whether moving the current request to @bw is worth it: always when it
+ * grows, only past the hysteresis threshold when it shrinks.
+ */
+static bool tegra_dc_bw_needs_update(long programmed, long bw)
+{
+	if (!programmed || bw > programmed)
+		return true;
+
+	return (u64)(programmed - bw) * 100 >
+		(u64)programmed * READ_ONCE(bw_hysteresis_pct);
+}
+
+/*
+ * The latency allowance of a window depends on its own state and bandwidth
+ * and on which other windows are active. Skip reprogramming it when none of
+ * those changed.
+ */
+static bool tegra_dc_la_needs_update(struct tegra_dc *dc,
+	struct tegra_dc_win *w, unsigned long active_wins)
+{
+	struct tegra_dc_win_bw_cache *cache = &dc->win_bw[w->idx];
+	struct tegra_dc_win_bw_key key;
+	unsigned long bw = max(w->bandwidth, w->new_bandwidth);
+
+	tegra_dc_win_bw_key_fill(dc, w, &key);
+	if (cache->la_valid && cache->la_bw == bw &&
+		active_wins == dc->la_active_wins &&
+		!memcmp(&cache->la_key, &key, sizeof(key)))
+		return false;
+
+	cache->la_key = key;
+	cache->la_bw = bw;
+	cache->la_valid = true;
+	return true;
+}
+
 #ifdef CONFIG_TEGRA_ISOMGR
 /* to save power, call when display memory clients would be idle */
 void tegra_dc_clear_bandwidth(struct tegra_dc *dc)
@@ -757,6 +851,7 @@ void tegra_dc_clear_bandwidth(struct tegra_dc *dc)
 		return;
 
 	trace_clear_bandwidth(dc);
+	tegra_dc_invalidate_la(dc);
 	latency = tegra_isomgr_reserve(dc->isomgr_handle, 0, 1000);
 	if (latency) {
 		dc->reserved_bw = 0;
@@ -776,9 +871,11 @@ void tegra_dc_clear_bandwidth(struct tegra_dc *dc)
 		return;
 
 	trace_clear_bandwidth(dc);
+	tegra_dc_invalidate_la(dc);
 	if (tegra_dc_is_clk_enabled(dc->emc_clk))
 		tegra_disp_clk_disable_unprepare(dc->emc_clk);
 	dc->bw_kbps = 0;
+	dc->programmed_bw_kbps = 0;
 }
 
 /* bw in kByte/second. returns Hz for EMC frequency */
@@ -807,6 +904,7 @@ static inline unsigned long tegra_dc_kbps_to_emc(unsigned long bw)
  */
 void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new)
 {
+	unsigned long active_wins = 0;
 	unsigned i;
 
 	if (tegra_dc_is_nvdisplay())
@@ -829,6 +927,11 @@ void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new)
 
 		/* reserve atleast the minimum bandwidth. */
 		bw = max(bw, tegra_calc_min_bandwidth(dc));
+		if (!tegra_dc_bw_needs_update(dc->reserved_bw, bw)) {
+			dc->bw_kbps = dc->new_bw_kbps;
+			goto program_la;
+		}
+
 		latency = tegra_isomgr_reserve(dc->isomgr_handle, bw, 1000);
 		if (latency) {
 			dc->reserved_bw = bw;
@@ -847,8 +950,15 @@ void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new)
 			!tegra_dc_is_clk_enabled(dc->emc_clk))
 			tegra_disp_clk_prepare_enable(dc->emc_clk);
 
+		if (dc->bw_kbps && dc->new_bw_kbps &&
+			!tegra_dc_bw_needs_update(dc->programmed_bw_kbps, bw)) {
+			dc->bw_kbps = dc->new_bw_kbps;
+			goto program_la;
+		}
+
 		emc_freq = tegra_dc_kbps_to_emc(bw);
 		clk_set_rate(dc->emc_clk, emc_freq);
+		dc->programmed_bw_kbps = bw;
 
 		/* going from non-zero to 0 */
 		if (dc->bw_kbps && !dc->new_bw_kbps &&
@@ -858,16 +968,28 @@ void tegra_dc_program_bandwidth(struct tegra_dc *dc, bool use_new)
 		dc->bw_kbps = dc->new_bw_kbps;
 	}
 
+program_la:
+	for_each_set_bit(i, &dc->valid_windows,
+			tegra_dc_get_numof_dispwindows()) {
+		struct tegra_dc_win *w = tegra_dc_get_window(dc, i);
+
+		if (WIN_IS_ENABLED(w))
+			active_wins |= BIT(i);
+	}
+
 	for_each_set_bit(i, &dc->valid_windows,
 			tegra_dc_get_numof_dispwindows()) {
 		struct tegra_dc_win *w = tegra_dc_get_window(dc, i);
 
 		if ((use_new || w->bandwidth != w->new_bandwidth) &&
-			w->new_bandwidth != 0)
-			tegra_dc_set_latency_allowance(dc, w);
+			w->new_bandwidth != 0 &&
+			tegra_dc_la_needs_update(dc, w, active_wins) &&
+			tegra_dc_set_latency_allowance(dc, w))
+			dc->win_bw[i].la_valid = false;
 		trace_program_bandwidth(dc);
 		w->bandwidth = w->new_bandwidth;
 	}
+	dc->la_active_wins = active_wins;
 }
 
 int tegra_dc_set_dynamic_emc(struct tegra_dc *dc)
@@ -16,6 +16,7 @@
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/jiffies.h>
+#include <linux/log2.h>
 #include <linux/atomic.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
@@ -97,6 +98,77 @@ void tegra_dc_ring_buf_add(struct tegra_dc_ring_buf *buf, void *src,
 	buf->size++;
 }
 
+/* The CRC buffer is filled by the frame end handler only, and read by the
+ * CRC IOCTLs without taking a lock. Items are appended by filling the slot for
+ * item @seq and then publishing it by incrementing @seq; the oldest item is
+ * overwritten once the buffer is full. Readers copy an item out and then check
+ * that its slot has not been reused in the meantime. The slot of the oldest
+ * item may be rewritten at any time, so it is never handed out.
+ */
+static void tegra_dc_crc_buf_add(struct tegra_dc_ring_buf *buf,
+				 struct tegra_dc_crc_buf_ele *src)
+{
+	struct tegra_dc_crc_buf_ele *dst;
+	u32 seq = buf->seq;
+
+	dst = (struct tegra_dc_crc_buf_ele *)buf->data +
+		(seq & (buf->capacity - 1));
+
+	/* Order the publication of the previous item before reusing a slot */
+	smp_wmb();
+	memcpy(dst, src, sizeof(*dst));
+	smp_store_release(&buf->seq, seq + 1);
+}
+
+/* Index of the oldest item that may be read, given a snapshot of @seq */
+static inline u32 tegra_dc_crc_buf_first(struct tegra_dc_ring_buf *buf,
+					 u32 seq)
+{
+	return seq < buf->capacity ? 0 : seq - buf->capacity + 1;
+}
+
+/* Copy out item @idx
+ * Returns -EAGAIN if it has not been added yet, and -ENODATA if it has been
+ * or is being overwritten
+ */
+static int tegra_dc_crc_buf_read(struct tegra_dc_ring_buf *buf, u32 idx,
+				 struct tegra_dc_crc_buf_ele *dst)
+{
+	struct tegra_dc_crc_buf_ele *src;
+	u32 seq = smp_load_acquire(&buf->seq);
+
+	if ((s32)(seq - idx) <= 0)
+		return -EAGAIN;
+
+	if (seq - idx >= buf->capacity)
+		return -ENODATA;
+
+	src = (struct tegra_dc_crc_buf_ele *)buf->data +
+		(idx & (buf->capacity - 1));
+	memcpy(dst, src, sizeof(*dst));
+
+	smp_rmb();
+	if (READ_ONCE(buf->seq) - idx >= buf->capacity)
+		return -ENODATA;
+
+	return 0;
+}
+
+/* The most recent flip matched with a CRC element, 0 if none */
+static u64 _crc_ele_last_flip(struct tegra_dc_crc_buf_ele *crc_ele)
+{
+	u64 id = 0;
+	int iter;
+
+	for (iter = 0; iter < DC_N_WINDOWS; iter++) {
+		if (!crc_ele->matching_flips[iter].valid)
+			break;
+		id = crc_ele->matching_flips[iter].id;
+	}
+
+	return id;
+}
+
 /* Called when enabling the DC head.
  * Avoid calling it when disabling the DC head so as to avoid any issues caused
  * by an impending or a missing flush of values to the registers
@@ -193,9 +265,7 @@ void tegra_dc_crc_deinit(struct tegra_dc *dc)
 	dc->flip_buf.size = 0;
 	dc->flip_buf.head = 0;
 	dc->flip_buf.tail = 0;
-	dc->crc_buf.size = 0;
-	dc->crc_buf.head = 0;
-	dc->crc_buf.tail = 0;
+	dc->crc_buf.seq = 0;
 
 	atomic_set(&dc->crc_ref_cnt.global, 0);
 	atomic_set(&dc->crc_ref_cnt.rg, 0);
@@ -209,13 +279,14 @@ void tegra_dc_crc_deinit(struct tegra_dc *dc)
 	dc->crc_ref_cnt.legacy = false;
 
 	mutex_destroy(&dc->flip_buf.lock);
-	mutex_destroy(&dc->crc_buf.lock);
 
 	dc->crc_initialized = false;
 }
 
 static long tegra_dc_crc_init(struct tegra_dc *dc)
 {
+	BUILD_BUG_ON(!is_power_of_2(TEGRA_DC_CRC_BUF_CAPACITY));
+
 	dc->flip_buf.capacity = TEGRA_DC_FLIP_BUF_CAPACITY;
 	dc->crc_buf.capacity = TEGRA_DC_CRC_BUF_CAPACITY;
 
@@ -235,7 +306,7 @@ static long tegra_dc_crc_init(struct tegra_dc *dc)
 		return -ENOMEM;
 
 	mutex_init(&dc->flip_buf.lock);
-	mutex_init(&dc->crc_buf.lock);
+	dc->crc_buf.seq = 0;
 
 	dc->crc_initialized = true;
 
@@ -455,35 +526,33 @@ long tegra_dc_crc_disable(struct tegra_dc *dc,
 static int _find_lrm(struct tegra_dc *dc, u64 *flip_id)
 {
 	u64 lrm = 0x0; /* Default value when no flips are matched */
-	int ret = 0;
-	struct tegra_dc_crc_buf_ele *crc_ele = NULL;
+	int ret;
+	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	struct tegra_dc_crc_buf_ele crc_ele;
 
-	ret = tegra_dc_ring_buf_peek(&dc->crc_buf, dc->crc_buf.tail,
-				     (char **)&crc_ele);
-	if (ret)
-		goto done;
+	/* The tail may be overwritten while we look at it, retry from the new
+	 * tail in that case
+	 */
+	do {
+		u32 seq = smp_load_acquire(&buf->seq);
 
-	if (crc_ele->matching_flips[0].valid)
-		lrm = crc_ele->matching_flips[0].id;
+		ret = tegra_dc_crc_buf_read(buf,
+				tegra_dc_crc_buf_first(buf, seq), &crc_ele);
+	} while (ret == -ENODATA);
+
+	if (!ret && crc_ele.matching_flips[0].valid)
+		lrm = crc_ele.matching_flips[0].id;
 
-done:
 	*flip_id = lrm;
 	return ret;
 }
 
-static inline u16 prev_idx(struct tegra_dc_ring_buf *buf, u16 idx)
-{
-	return idx ? idx - 1 : buf->capacity - 1;
-}
-
 static bool _is_flip_out_of_bounds(struct tegra_dc *dc, u64 flip_id)
 {
 	u64 lrm; /* Least recently matched flip */
 	u64 mrq; /* Most recently queued flip */
 
-	mutex_lock(&dc->crc_buf.lock);
 	_find_lrm(dc, &lrm);
-	mutex_unlock(&dc->crc_buf.lock);
 
 	mrq = atomic64_read(&dc->flip_stats.flips_queued);
 
@@ -503,33 +572,34 @@ static bool _is_flip_out_of_bounds(struct tegra_dc *dc, u64 flip_id)
 	return false;
 }
 
-/* Scan the CRC buffer from @start_idx (inclusive) to @end_idx (exclusive)
- * to find the element matched with @flip_id
+/* Scan the CRC buffer from the item before @end_idx back to @start_idx
+ * (inclusive) to find the element matched with @flip_id. The scan stops early
+ * at the first element matched only with older flips.
  */
-static int _scan_crc_buf(struct tegra_dc *dc, u16 start_idx, u16 end_idx,
+static int _scan_crc_buf(struct tegra_dc *dc, u32 start_idx, u32 end_idx,
 			 u64 flip_id, struct tegra_dc_crc_buf_ele *crc_ele)
 {
-	u16 peek_idx = start_idx;
+	u32 peek_idx = end_idx;
 	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
-	struct tegra_dc_crc_buf_ele *crc_iter = NULL;
 	int iter, ret;
 
-	while (peek_idx != end_idx) {
-		ret = tegra_dc_ring_buf_peek(buf, peek_idx, (char **)&crc_iter);
+	while (peek_idx != start_idx) {
+		peek_idx--;
+
+		ret = tegra_dc_crc_buf_read(buf, peek_idx, crc_ele);
 		if (ret)
 			return ret;
 
 		for (iter = 0; iter < DC_N_WINDOWS; iter++) {
-			if (!crc_iter->matching_flips[iter].valid)
+			if (!crc_ele->matching_flips[iter].valid)
 				break;
 
-			if (crc_iter->matching_flips[iter].id == flip_id) {
-				memcpy(crc_ele, crc_iter, sizeof(*crc_iter));
+			if (crc_ele->matching_flips[iter].id == flip_id)
 				return 0;
-			}
 		}
 
-		peek_idx = prev_idx(buf, peek_idx);
+		if (_crc_ele_last_flip(crc_ele) < flip_id)
+			break;
 	}
 
 	return -EAGAIN;
@@ -558,8 +628,8 @@ static int tegra_dc_crc_wait_till_frame_end(struct tegra_dc *dc)
 static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 			    struct tegra_dc_crc_buf_ele *crc_ele)
 {
-	int ret = 0, ret_loop = -EAGAIN;
-	u16 start_idx, end_idx;
+	int ret;
+	u32 start_idx, end_idx;
 	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
 
 	if (flip_id == U64_MAX) {
@@ -574,42 +644,30 @@ static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 	if (_is_flip_out_of_bounds(dc, flip_id))
 		return -ENODATA;
 
-	mutex_lock(&buf->lock);
-
 	/* At this point, we are committed to return a CRC value to the user,
 	 * even if one is yet to be generated in the imminent future
 	 */
-	end_idx = prev_idx(buf, buf->tail);
-	start_idx = prev_idx(buf, buf->head);
-
-	while (ret_loop == -EAGAIN) {
-		ret_loop = _scan_crc_buf(dc, start_idx, end_idx, flip_id,
-					 crc_ele);
-		if (!ret_loop || ret_loop != -EAGAIN) {
-			ret = ret_loop;
-			goto done;
-		}
+	reinit_completion(&dc->crc_complete);
+	end_idx = smp_load_acquire(&buf->seq);
+	start_idx = tegra_dc_crc_buf_first(buf, end_idx);
+
+	for (;;) {
+		ret = _scan_crc_buf(dc, start_idx, end_idx, flip_id, crc_ele);
+		if (ret != -EAGAIN)
+			return ret;
 
 		/* Control reaching here implies the flip being requested is yet
 		 * to be matched at a certain frame end interrupt, hence wait on
-		 * the event
+		 * the event. Only the elements added since need scanning then
 		 */
-		mutex_unlock(&buf->lock);
-		reinit_completion(&dc->crc_complete);
-
 		ret = tegra_dc_crc_wait_till_frame_end(dc); /* Blocking call */
 		if (ret)
 			return ret;
 
-		mutex_lock(&buf->lock);
-
-		end_idx = prev_idx(buf, start_idx);
-		start_idx = prev_idx(buf, buf->head);
+		reinit_completion(&dc->crc_complete);
+		start_idx = end_idx;
+		end_idx = smp_load_acquire(&buf->seq);
 	}
-
-done:
-	mutex_unlock(&buf->lock);
-	return ret;
 }
 
 static int tegra_dc_crc_t21x_collect(struct tegra_dc *dc,
@@ -703,6 +761,83 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 	return ret;
 }
 
+static void _crc_ele_to_frame(struct tegra_dc_crc_buf_ele *crc_ele,
+			      struct tegra_dc_ext_crc_frame *frame)
+{
+	u8 id;
+
+	memset(frame, 0, sizeof(*frame));
+	frame->flip_id = _crc_ele_last_flip(crc_ele);
+	frame->rg.valid = crc_ele->rg.valid;
+	frame->rg.val = crc_ele->rg.crc;
+	frame->comp.valid = crc_ele->comp.valid;
+	frame->comp.val = crc_ele->comp.crc;
+	frame->out.valid = crc_ele->sor.valid;
+	frame->out.val = crc_ele->sor.crc;
+	for (id = 0; id < TEGRA_DC_MAX_CRC_REGIONS; id++) {
+		frame->regional[id].valid = crc_ele->regional[id].valid;
+		frame->regional[id].val = crc_ele->regional[id].crc;
+	}
+}
+
+/* Collect the CRCs of all frames matched with @flip_id or later flips that
+ * are in the buffer right now, oldest first. Never blocks.
+ */
+long tegra_dc_crc_get_bulk(struct tegra_dc *dc, u64 flip_id,
+			   struct tegra_dc_ext_crc_frame *frames,
+			   u32 max_frames, u32 *num_frames)
+{
+	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	struct tegra_dc_crc_buf_ele crc_ele;
+	u32 seq, first, idx;
+	u32 num = 0;
+	int ret;
+
+	*num_frames = 0;
+
+	if (!dc->enabled)
+		return -ENODEV;
+
+	if (!dc->crc_initialized)
+		return -EPERM;
+
+	WARN_ON(dc->crc_ref_cnt.legacy);
+
+	seq = smp_load_acquire(&buf->seq);
+	first = tegra_dc_crc_buf_first(buf, seq);
+
+	/* Walk back to the oldest element matched with a requested flip */
+	for (idx = seq; idx != first; idx--) {
+		ret = tegra_dc_crc_buf_read(buf, idx - 1, &crc_ele);
+		if (ret)
+			return ret;
+
+		if (_crc_ele_last_flip(&crc_ele) < flip_id)
+			break;
+	}
+
+	/* Walked off the tail with elements already dropped before it */
+	if (idx == first && first && idx != seq) {
+		ret = tegra_dc_crc_buf_read(buf, idx, &crc_ele);
+		if (ret)
+			return ret;
+		if (crc_ele.matching_flips[0].id > flip_id)
+			return -ENODATA;
+	}
+
+	for (; idx != seq && num < max_frames; idx++) {
+		ret = tegra_dc_crc_buf_read(buf, idx, &crc_ele);
+		if (ret)
+			return ret;
+
+		_crc_ele_to_frame(&crc_ele, &frames[num++]);
+	}
+
+	*num_frames = num;
+
+	return 0;
+}
+
 int tegra_dc_crc_process(struct tegra_dc *dc)
 {
 	int ret = 0, matched = 0;
@@ -748,11 +883,8 @@ int tegra_dc_crc_process(struct tegra_dc *dc)
 	}
 
 	/* Enqueue CRC element in the CRC ring buffer */
-	if (matched) {
-		mutex_lock(&dc->crc_buf.lock);
-		tegra_dc_ring_buf_add(&dc->crc_buf, &crc_ele, NULL);
-		mutex_unlock(&dc->crc_buf.lock);
-	}
+	if (matched)
+		tegra_dc_crc_buf_add(&dc->crc_buf, &crc_ele);
 
 	mutex_unlock(&dc->flip_buf.lock);
 	return ret;
@@ -36,6 +36,7 @@
 #include <linux/ktime.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/sort.h>
 #include <linux/backlight.h>
 #include <linux/gpio.h>
 #include <linux/nvhost.h>
@@ -95,8 +96,6 @@ EXPORT_TRACEPOINT_SYMBOL(display_readl);
 #define DC_COM_PIN_OUTPUT_POLARITY1_INIT_VAL	0x01000000
 #define DC_COM_PIN_OUTPUT_POLARITY3_INIT_VAL	0x0
 
-#define MAX_VRR_V_FRONT_PORCH			0x1000
-
 static struct tegra_dc_hw_data *hw_data;
 static struct tegra_dc_hw_data t21x_hw_data;
 static struct tegra_dc_hw_data t18x_hw_data;
@@ -2846,6 +2845,88 @@ static const struct file_operations dbg_flip_stats_ops = {
 	.release = single_release,
 };
 
+static const char * const flip_latency_names[] = {
+	[TEGRA_DC_FLIP_LATENCY_FENCE] = "fence",
+	[TEGRA_DC_FLIP_LATENCY_PROGRAM] = "program",
+	[TEGRA_DC_FLIP_LATENCY_LATCH] = "latch",
+	[TEGRA_DC_FLIP_LATENCY_SYNCPT] = "syncpt",
+	[TEGRA_DC_FLIP_LATENCY_TOTAL] = "total",
+};
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int dbg_flip_latency_show(struct seq_file *m, void *unused)
+{
+	struct tegra_dc *dc = m->private;
+	struct tegra_dc_flip_latency *lat = &dc->flip_latency;
+	unsigned long flags;
+	u32 *sorted;
+	int stage, i, n;
+
+	sorted = kmalloc_array(TEGRA_DC_FLIP_LATENCY_SAMPLES,
+			sizeof(*sorted), GFP_KERNEL);
+	if (!sorted)
+		return -ENOMEM;
+
+	seq_puts(m, "stage    count    p50 us    p90 us    p99 us    max us\n");
+	for (stage = 0; stage < TEGRA_DC_FLIP_LATENCY_STAGES; stage++) {
+		spin_lock_irqsave(&lat->lock, flags);
+		n = lat->count;
+		for (i = 0; i < n; i++)
+			sorted[i] = lat->samples[i][stage];
+		spin_unlock_irqrestore(&lat->lock, flags);
+
+		if (!n) {
+			seq_printf(m, "%-8s %5d\n", flip_latency_names[stage], 0);
+			continue;
+		}
+
+		sort(sorted, n, sizeof(*sorted), cmp_u32, NULL);
+		seq_printf(m, "%-8s %5d %9u %9u %9u %9u\n",
+			flip_latency_names[stage], n,
+			sorted[(n - 1) * 50 / 100], sorted[(n - 1) * 90 / 100],
+			sorted[(n - 1) * 99 / 100], sorted[n - 1]);
+	}
+
+	kfree(sorted);
+
+	return 0;
+}
+
+static int dbg_flip_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_flip_latency_show, inode->i_private);
+}
+
+/* Any write clears the samples */
+static ssize_t dbg_flip_latency_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct tegra_dc *dc = m->private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dc->flip_latency.lock, flags);
+	dc->flip_latency.head = 0;
+	dc->flip_latency.count = 0;
+	spin_unlock_irqrestore(&dc->flip_latency.lock, flags);
+
+	return count;
+}
+
+static const struct file_operations dbg_flip_latency_ops = {
+	.open = dbg_flip_latency_open,
+	.read = seq_read,
+	.write = dbg_flip_latency_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int dbg_measure_latency_show(struct seq_file *m, void *unused)
 {
 	struct tegra_dc *dc = m->private;
@@ -3031,6 +3112,11 @@ static void tegra_dc_create_debugfs(struct tegra_dc *dc)
 	if (!retval)
 		goto remove_out;
 
+	retval = debugfs_create_file("flip_latency", 0644, dc->debugdir,
+				dc, &dbg_flip_latency_ops);
+	if (!retval)
+		goto remove_out;
+
 	if (dc->out_ops->get_connector_instance) {
 		char sor_path[CHAR_BUF_SIZE_MAX];
 		int ctrl_num = -1;
@@ -3746,6 +3832,39 @@ void tegra_dc_incr_syncpt_min(struct tegra_dc *dc, int i, u32 val)
 	mutex_unlock(&dc->lock);
 }
 
+static u32 flip_latency_us(ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+
+	return us > 0 ? min_t(s64, us, U32_MAX) : 0;
+}
+
+/*
+ * Stamps are taken by the flip worker at each stage and recorded once the
+ * post-syncpoint is incremented; debugfs flip_latency has the percentiles.
+ */
+void tegra_dc_flip_latency_record(struct tegra_dc *dc, ktime_t queued,
+	ktime_t fenced, ktime_t programmed, ktime_t latched, ktime_t done)
+{
+	struct tegra_dc_flip_latency *lat = &dc->flip_latency;
+	unsigned long flags;
+	u32 *sample;
+
+	spin_lock_irqsave(&lat->lock, flags);
+	sample = lat->samples[lat->head];
+	sample[TEGRA_DC_FLIP_LATENCY_FENCE] = flip_latency_us(queued, fenced);
+	sample[TEGRA_DC_FLIP_LATENCY_PROGRAM] =
+		flip_latency_us(fenced, programmed);
+	sample[TEGRA_DC_FLIP_LATENCY_LATCH] =
+		flip_latency_us(programmed, latched);
+	sample[TEGRA_DC_FLIP_LATENCY_SYNCPT] = flip_latency_us(latched, done);
+	sample[TEGRA_DC_FLIP_LATENCY_TOTAL] = flip_latency_us(queued, done);
+	lat->head = (lat->head + 1) % TEGRA_DC_FLIP_LATENCY_SAMPLES;
+	if (lat->count < TEGRA_DC_FLIP_LATENCY_SAMPLES)
+		lat->count++;
+	spin_unlock_irqrestore(&lat->lock, flags);
+}
+
 struct sync_fence *tegra_dc_create_fence(struct tegra_dc *dc, int i, u32 val)
 {
 	struct nvhost_ctrl_sync_fence_info syncpt;
@@ -4457,6 +4576,31 @@ static void tegra_dc_vrr_extend_vfp(struct tegra_dc *dc)
 	tegra_dc_set_act_vfp(dc, MAX_VRR_V_FRONT_PORCH);
 }
 
+/* Account the interval of the frame that just ended to the pacing stats */
+static void tegra_dc_vrr_pacing_frame_end(struct tegra_dc *dc)
+{
+	struct tegra_vrr *vrr  = dc->out->vrr;
+	s64 now_us;
+	s32 interval_us;
+
+	if (!vrr || !vrr->capability || !vrr->enable || !vrr->pacing)
+		return;
+
+	now_us = ktime_to_us(ktime_get());
+	if (vrr->pacing_frame_us) {
+		interval_us = (s32)(now_us - vrr->pacing_frame_us);
+
+		if (!vrr->pacing_frames || interval_us < vrr->pacing_min_us)
+			vrr->pacing_min_us = interval_us;
+		if (interval_us > vrr->pacing_max_us)
+			vrr->pacing_max_us = interval_us;
+		vrr->pacing_frames++;
+		vrr->pacing_sum_us += interval_us;
+		vrr->pacing_sum_sq_us += (u64)interval_us * interval_us;
+	}
+	vrr->pacing_frame_us = now_us;
+}
+
 int tegra_dc_get_v_count(struct tegra_dc *dc)
 {
 	u32     value;
@@ -4838,6 +4982,9 @@ static void tegra_dc_continuous_irq(struct tegra_dc *dc, unsigned long status)
 		dc->frame_end_timestamp = timespec_to_ns(&tm);
 		wake_up(&dc->timestamp_wq);
 
+		if (dc->out->type != TEGRA_DC_OUT_DSI)
+			tegra_dc_vrr_pacing_frame_end(dc);
+
 		if (!tegra_dc_windows_are_dirty(dc, WIN_ALL_ACT_REQ)) {
 			if (dc->out->type == TEGRA_DC_OUT_DSI) {
 				tegra_dc_vrr_get_ts(dc);
@@ -5423,6 +5570,9 @@ static int tegra_dc_init(struct tegra_dc *dc)
 	int int_enable;
 	u32 val;
 
+	/* registers are back at reset values, reprogram windows in full */
+	dc->win_regs_valid = 0;
+
 	tegra_dc_io_start(dc);
 	tegra_dc_writel(dc, 0x00000100, DC_CMD_GENERAL_INCR_SYNCPT_CNTRL);
 	tegra_dc_writel(dc, 0x00000100 | dc->vblank_syncpt,
@@ -6635,6 +6785,7 @@ static int tegra_dc_probe(struct platform_device *ndev)
 	atomic64_set(&dc->flip_stats.flips_queued, 0);
 	atomic64_set(&dc->flip_stats.flips_skipped, 0);
 	atomic64_set(&dc->flip_stats.flips_cmpltd, 0);
+	spin_lock_init(&dc->flip_latency.lock);
 
 	tegra_dc_create_debugfs(dc);
 
@@ -609,6 +609,18 @@ struct tegra_vrr {
 	s32	vfp;
 	s32	insert_frame;
 
+	/* Predictive frame pacing (HDMI), see tegra_dc_vrr_pace_flip() */
+	s32	pacing;
+	s32	pacing_interval_us;	/* predicted flip interval */
+	s64	pacing_flip_us;		/* time of the last flip */
+	s64	pacing_frame_us;	/* time of the last frame end */
+	/* achieved frame intervals while pacing */
+	u32	pacing_frames;
+	s32	pacing_min_us;
+	s32	pacing_max_us;
+	u64	pacing_sum_us;
+	u64	pacing_sum_sq_us;
+
 	/* Used with TLK */
 	s32	vrr_session_id;
 	/* Used with Trusty */
@@ -1182,5 +1194,8 @@ long tegra_dc_crc_enable(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_disable(struct tegra_dc *dc,
 			  struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
+long tegra_dc_crc_get_bulk(struct tegra_dc *dc, u64 flip_id,
+			   struct tegra_dc_ext_crc_frame *frames,
+			   u32 max_frames, u32 *num_frames);
 
 #endif
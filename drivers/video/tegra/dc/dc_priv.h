@@ -220,6 +220,8 @@ int tegra_panel_get_panel_id(const char *comp_str, struct device_node *dnode,
 int tegra_panel_regulator_get_dt(struct device *dev,
 				struct tegra_panel_reg *panel_reg);
 
+#define MAX_VRR_V_FRONT_PORCH			0x1000
+
 /* defined in dc.c, used in dc.c and dev.c */
 void tegra_dc_set_act_vfp(struct tegra_dc *dc, int vfp);
 
@@ -251,6 +253,10 @@ int tegra_dc_slgc_disp0(struct notifier_block *nb, unsigned long unused0,
 /* defined in dc.c, used in dc_sysfs.c and ext/dev.c */
 int tegra_dc_update_winmask(struct tegra_dc *dc, unsigned long winmask);
 
+/* defined in dc.c, used by ext to time each completed flip */
+void tegra_dc_flip_latency_record(struct tegra_dc *dc, ktime_t queued,
+	ktime_t fenced, ktime_t programmed, ktime_t latched, ktime_t done);
+
 /* common display clock calls */
 struct clk *tegra_disp_clk_get(struct device *dev, const char *id);
 void tegra_disp_clk_put(struct device *dev, struct clk *clk);
@@ -381,6 +387,7 @@ void tegra_nvdisp_crc_reset(struct tegra_dc *dc);
 
 void tegra_nvdisp_set_output_lut(struct tegra_dc *dc,
 	struct tegra_dc_ext_nvdisp_cmu *user_nvdisp_cmu, bool new_cmu_values);
+void tegra_nvdisp_set_output_lut_buf(struct tegra_dc *dc, dma_addr_t addr);
 void tegra_nvdisp_set_output_colorspace(struct tegra_dc *dc, u16 colorspace);
 void tegra_nvdisp_set_output_range(struct tegra_dc *dc, u8 lim_range_enable);
 void tegra_nvdisp_set_csc2(struct tegra_dc *dc);
@@ -197,6 +197,9 @@ struct tegra_nvdisp_imp_settings {
 	u64 session_id;
 	u8 owner_ctrl_num;
 
+	/* identical to the settings already programmed, nothing to do */
+	bool unchanged;
+
 	struct list_head imp_node;
 };
 
@@ -254,6 +257,27 @@ struct tegra_dc_flip_stats {
 	atomic64_t flips_cmpltd;
 };
 
+#define TEGRA_DC_FLIP_LATENCY_SAMPLES	256
+
+/* Stages of a flip, each timed from the end of the previous one */
+enum tegra_dc_flip_latency_stage {
+	TEGRA_DC_FLIP_LATENCY_FENCE,	/* ioctl to pre-fences signalled */
+	TEGRA_DC_FLIP_LATENCY_PROGRAM,	/* to window registers programmed */
+	TEGRA_DC_FLIP_LATENCY_LATCH,	/* to update latched at vblank */
+	TEGRA_DC_FLIP_LATENCY_SYNCPT,	/* to post-syncpoint incremented */
+	TEGRA_DC_FLIP_LATENCY_TOTAL,	/* ioctl to post-syncpoint */
+	TEGRA_DC_FLIP_LATENCY_STAGES,
+};
+
+/* Ring of the stage latencies, in usec, of the last completed flips */
+struct tegra_dc_flip_latency {
+	spinlock_t lock;
+	u32 head;
+	u32 count;
+	u32 samples[TEGRA_DC_FLIP_LATENCY_SAMPLES]
+		[TEGRA_DC_FLIP_LATENCY_STAGES];
+};
+
 /*
  * struct tegra_dc_client_data - stores all per client specific data for
  * required for notifying when the requested events occur.
@@ -355,6 +379,9 @@ enum tegra_dc_ring_buf_type {
  * @lock     - Mutex to serialize accesses across various contexts, namely the
  *             flip IOCTL, flip worker thread and frame end interrupt service
  *             routine
+ * @seq      - Number of items ever added. Only used by the CRC buffer, which
+ *             has a single producer and lock-free readers, in place of
+ *             @head, @tail, @size and @lock. @capacity must be a power of 2
  */
 struct tegra_dc_ring_buf {
 	enum tegra_dc_ring_buf_type type;
@@ -364,6 +391,7 @@ struct tegra_dc_ring_buf {
 	u16 capacity;
 	char *data;
 	struct mutex lock;
+	u32 seq;
 };
 
 /*
@@ -443,6 +471,28 @@ struct tegra_dc_win_detach_state {
 	u32 win_options_reg;
 };
 
+/* Inputs of the T21x per-window bandwidth and latency allowance calculation */
+struct tegra_dc_win_bw_key {
+	u32				fmt;
+	u32				flags;
+	fixed20_12			w;
+	fixed20_12			h;
+	unsigned			out_w;
+	unsigned			out_h;
+	int				pclk;
+};
+
+struct tegra_dc_win_bw_cache {
+	/* bandwidth last computed for key */
+	struct tegra_dc_win_bw_key	key;
+	unsigned long			bandwidth;
+	bool				valid;
+	/* window state and bandwidth the latency allowance was set for */
+	struct tegra_dc_win_bw_key	la_key;
+	unsigned long			la_bw;
+	bool				la_valid;
+};
+
 struct tegra_dc {
 	struct platform_device		*ndev;
 	struct tegra_dc_platform_data	*pdata;
@@ -469,6 +519,11 @@ struct tegra_dc {
 	struct tegra_bwmgr_client	*emc_la_handle;
 	long				bw_kbps; /* bandwidth in KBps */
 	long				new_bw_kbps;
+	/* EMC request last made without Isomgr, 0 if none */
+	long				programmed_bw_kbps;
+	struct tegra_dc_win_bw_cache	win_bw[DC_N_WINDOWS];
+	/* enabled windows when the latency allowance was last set */
+	unsigned long			la_active_wins;
 	struct tegra_dc_shift_clk_div	shift_clk_div;
 
 	u32				powergate_id;
@@ -502,6 +557,8 @@ struct tegra_dc {
 	struct tegra_dc_win		windows[DC_N_WINDOWS];
 
 	struct tegra_dc_win		shadow_windows[DC_N_WINDOWS];
+	/* windows whose registers match shadow_windows, used only on T21x */
+	unsigned long			win_regs_valid;
 
 	struct tegra_dc_blend		blend;
 	int				n_windows;
@@ -518,6 +575,8 @@ struct tegra_dc {
 
 	struct tegra_dc_cmu		cmu;
 	struct tegra_dc_nvdisp_lut	nvdisp_postcomp_lut;
+	/* userspace output LUT buffer replacing nvdisp_postcomp_lut, or 0 */
+	dma_addr_t			output_lut_buf_addr;
 
 	/* either unity or panel specific */
 	struct tegra_dc_nvdisp_win_csc	default_csc;
@@ -654,6 +713,7 @@ struct tegra_dc {
 	unsigned long act_req_mask;
 	struct tegra_dc_clients_info clients_info;
 	struct tegra_dc_flip_stats flip_stats;
+	struct tegra_dc_flip_latency flip_latency;
 
 	struct tegra_dc_ring_buf flip_buf; /* Buffer to save flip requests */
 	struct tegra_dc_ring_buf crc_buf; /* Buffer to save HW generated CRCs */
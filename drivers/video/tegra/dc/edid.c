@@ -17,6 +17,7 @@
  *
  */
 
+#include <linux/crc32.h>
 #include <linux/debugfs.h>
 #include <linux/fb.h>
 #include <linux/i2c.h>
@@ -98,6 +99,11 @@ static const char default_720p_edid[256] = {
 #ifdef DEBUG
 static char tegra_edid_dump_buff[16 * 1024];
 
+/* Reuse the parsed EDID of a sink whose base block is unchanged */
+static bool edid_cache = true;
+module_param(edid_cache, bool, 0644);
+MODULE_PARM_DESC(edid_cache, "Reuse parsed EDIDs of known sinks on hotplug");
+
 static void tegra_edid_dump(struct tegra_edid *edid)
 {
 	struct seq_file s;
@@ -532,6 +538,97 @@ static void data_release(struct kref *ref)
 	vfree(data);
 }
 
+static int tegra_edid_copy_specs(struct fb_monspecs *dst,
+				const struct fb_monspecs *src)
+{
+	*dst = *src;
+	dst->modedb = kmemdup(src->modedb,
+			src->modedb_len * sizeof(*src->modedb), GFP_KERNEL);
+
+	return dst->modedb ? 0 : -ENOMEM;
+}
+
+static void tegra_edid_cache_drop(struct tegra_edid_cache_entry *entry)
+{
+	if (!entry->data)
+		return;
+
+	kref_put(&entry->data->refcnt, data_release);
+	kfree(entry->specs.modedb);
+	memset(entry, 0, sizeof(*entry));
+}
+
+/*
+ * Look up a sink by its base block. On a hit, @specs gets a copy of the
+ * cached mode list and the cached parse becomes the current EDID data.
+ * Called with edid->lock held.
+ */
+static bool tegra_edid_cache_lookup(struct tegra_edid *edid, const u8 *base,
+				struct fb_monspecs *specs)
+{
+	u32 hash = crc32_le(~0, base, EDID_BYTES_PER_BLOCK);
+	struct tegra_edid_pvt *old_data;
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++) {
+		struct tegra_edid_cache_entry *entry = &edid->cache[i];
+
+		if (!entry->data || entry->hash != hash ||
+			memcmp(entry->data->dc_edid.buf, base,
+					EDID_BYTES_PER_BLOCK))
+			continue;
+
+		if (tegra_edid_copy_specs(specs, &entry->specs))
+			return false;
+
+		entry->last_used = jiffies;
+		kref_get(&entry->data->refcnt);
+		old_data = edid->data;
+		edid->data = entry->data;
+		if (old_data)
+			kref_put(&old_data->refcnt, data_release);
+
+		return true;
+	}
+
+	return false;
+}
+
+/* Remember a freshly parsed EDID, replacing the least recently used one */
+static void tegra_edid_cache_insert(struct tegra_edid *edid,
+				struct tegra_edid_pvt *data,
+				const struct fb_monspecs *specs)
+{
+	struct tegra_edid_cache_entry *entry = &edid->cache[0];
+	u32 hash = crc32_le(~0, data->dc_edid.buf, EDID_BYTES_PER_BLOCK);
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++) {
+		struct tegra_edid_cache_entry *e = &edid->cache[i];
+
+		/* same sink with a changed EDID replaces its old entry */
+		if (!e->data || (e->hash == hash &&
+			!memcmp(e->data->dc_edid.buf, data->dc_edid.buf,
+					EDID_BYTES_PER_BLOCK))) {
+			entry = e;
+			break;
+		}
+
+		if (time_before(e->last_used, entry->last_used))
+			entry = e;
+	}
+
+	tegra_edid_cache_drop(entry);
+
+	if (tegra_edid_copy_specs(&entry->specs, specs))
+		return;
+
+	kref_get(&data->refcnt);
+	entry->data = data;
+	entry->hash = hash;
+	entry->last_used = jiffies;
+}
+
 u16 tegra_edid_get_cd_flag(struct tegra_edid *edid)
 {
 	if (!edid || !edid->data) {
@@ -767,6 +864,20 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 		ret = tegra_edid_read_block(edid, 0, data);
 		if (ret)
 			goto fail;
+
+		if (edid_cache && !edid->errors) {
+			bool hit;
+
+			mutex_lock(&edid->lock);
+			hit = tegra_edid_cache_lookup(edid, data, specs);
+			mutex_unlock(&edid->lock);
+
+			if (hit) {
+				vfree(new_data);
+				tegra_edid_dump(edid);
+				return 0;
+			}
+		}
 	}
 
 	memset(specs, 0x0, sizeof(struct fb_monspecs));
@@ -909,6 +1020,8 @@ int tegra_edid_get_monspecs(struct tegra_edid *edid, struct fb_monspecs *specs)
 	mutex_lock(&edid->lock);
 	old_data = edid->data;
 	edid->data = new_data;
+	if (edid_cache && !edid->dc->vedid && !edid->errors)
+		tegra_edid_cache_insert(edid, new_data, specs);
 	mutex_unlock(&edid->lock);
 
 	if (old_data)
@@ -977,6 +1090,11 @@ struct tegra_edid *tegra_edid_create(struct tegra_dc *dc,
 
 void tegra_edid_destroy(struct tegra_edid *edid)
 {
+	int i;
+
+	for (i = 0; i < TEGRA_EDID_CACHE_SIZE; i++)
+		tegra_edid_cache_drop(&edid->cache[i]);
+
 	if (edid->data)
 		kref_put(&edid->data->refcnt, data_release);
 	kfree(edid);
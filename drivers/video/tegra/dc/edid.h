@@ -135,8 +135,24 @@ enum {
 /* TV doesn't support YUV420, but declares support */
 #define TEGRA_EDID_QUIRK_NO_YUV (1 << 0)
 
+/* Number of parsed EDIDs remembered per connector */
+#define TEGRA_EDID_CACHE_SIZE		4
+
+/*
+ * A parsed EDID and the mode list built from it, looked up by the base block
+ * on the next hotplug so that a known sink doesn't need a full read and
+ * parse again.
+ */
+struct tegra_edid_cache_entry {
+	u32			hash;		/* crc32 of the base block */
+	struct tegra_edid_pvt	*data;		/* holds a reference */
+	struct fb_monspecs	specs;		/* owns specs.modedb */
+	unsigned long		last_used;	/* jiffies */
+};
+
 struct tegra_edid {
 	struct tegra_edid_pvt	*data;
+	struct tegra_edid_cache_entry cache[TEGRA_EDID_CACHE_SIZE];
 
 	struct mutex		lock;
 	struct tegra_dc_i2c_ops i2c_ops;
@@ -391,6 +391,39 @@ static long tegra_dc_ext_control_ioctl(struct file *filp, unsigned int cmd,
 
 		return 0;
 	}
+	case TEGRA_DC_EXT_CONTROL_FLIP_MULTI:
+	{
+		struct tegra_dc_ext_control_flip_multi args;
+		struct tegra_dc_ext_control_flip_head *heads;
+		int ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		if (!args.nr_heads ||
+		    args.nr_heads > tegra_dc_get_numof_reg_disps())
+			return -EINVAL;
+
+		heads = kcalloc(args.nr_heads, sizeof(*heads), GFP_KERNEL);
+		if (!heads)
+			return -ENOMEM;
+
+		if (copy_from_user(heads,
+				(void __user *)(uintptr_t)args.heads,
+				sizeof(*heads) * args.nr_heads)) {
+			kfree(heads);
+			return -EFAULT;
+		}
+
+		ret = tegra_dc_ext_flip_multi(heads, args.nr_heads,
+					      &args.failed_head);
+		kfree(heads);
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return ret;
+	}
 	case TEGRA_DC_EXT_CONTROL_GET_CAP_INFO:
 	{
 		int ret = 0;
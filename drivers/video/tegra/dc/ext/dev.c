@@ -26,6 +26,7 @@
 #include <linux/export.h>
 #include <linux/delay.h>
 #include <linux/fb.h>
+#include <linux/ktime.h>
 #include <linux/version.h>
 #include <linux/string.h>
 #include <linux/nospec.h>
@@ -37,6 +38,7 @@
 #include "../dc_priv.h"
 #include "../dc_priv_defs.h"
 #include "../dc_config.h"
+#include "../dc_common.h"
 #include <video/tegra_dc_ext.h>
 /* XXX ew 3 */
 #include "tegra_dc_ext_priv.h"
@@ -111,6 +113,10 @@ struct tegra_dc_ext_flip_win {
 #endif
 	bool					user_nvdisp_win_csc;
 	struct tegra_dc_ext_nvdisp_win_csc		nvdisp_win_csc;
+	/* input LUT buffer to switch to, NULL for the driver LUT */
+	bool					lut_update;
+	struct tegra_dc_dmabuf			*lut_handle;
+	dma_addr_t				lut_addr;
 };
 
 struct tegra_dc_ext_flip_data {
@@ -118,6 +124,14 @@ struct tegra_dc_ext_flip_data {
 	struct kthread_work		work;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
 	struct list_head		timestamp_node;
+	/* scheduling, see tegra_dc_ext_flip_sched_queue() */
+	struct list_head		sched_node;
+	atomic_t			refs;
+	int				fences_pending;
+	int				work_index;
+	unsigned long			win_mask;
+	bool				has_timestamp;
+	bool				superseded;
 	int act_window_num;
 	u16 dirty_rect[4];
 	bool dirty_rect_valid;
@@ -136,6 +150,15 @@ struct tegra_dc_ext_flip_data {
 	struct tegra_dc_flip_buf_ele *flip_buf_ele;
 	bool background_color_update_needed;
 	u32 background_color;
+	/* output LUT buffer to switch to, NULL for the driver LUT */
+	bool output_lut_update;
+	struct tegra_dc_dmabuf *output_lut_handle;
+	dma_addr_t output_lut_addr;
+	/* flip_latency stamps: ioctl, fences done, programmed, latched */
+	ktime_t ts_queued;
+	ktime_t ts_fenced;
+	ktime_t ts_programmed;
+	ktime_t ts_latched;
 };
 
 struct tegra_dc_ext_scanline_data {
@@ -147,6 +170,8 @@ struct tegra_dc_ext_scanline_data {
 
 static int tegra_dc_ext_set_vblank(struct tegra_dc_ext *ext, bool enable);
 static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win);
+static void tegra_dc_ext_flip_put(struct tegra_dc_ext_flip_data *data);
+static void tegra_dc_ext_flip_sched_flush(struct tegra_dc_ext *ext);
 static void tegra_dc_flip_trace(struct tegra_dc_ext_flip_data *data,
 				display_syncpt_notifier trace_fn);
 
@@ -232,6 +257,7 @@ static int tegra_dc_ext_put_window(struct tegra_dc_ext_user *user,
 	mutex_lock(&win->lock);
 
 	if (win->user == user) {
+		tegra_dc_ext_flip_sched_flush(ext);
 		kthread_flush_worker(&win->flip_worker);
 		win->user = NULL;
 		win->enabled = false;
@@ -323,6 +349,7 @@ int tegra_dc_ext_disable(struct tegra_dc_ext *ext)
 	 * Flush the flip queue -- note that this must be called with dc->lock
 	 * unlocked or else it will hang.
 	 */
+	tegra_dc_ext_flip_sched_flush(ext);
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
 
@@ -527,6 +554,7 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 
 	memcpy(ext_win->cur_handle, flip_win->handle,
 	       sizeof(ext_win->cur_handle));
+	ext_win->cur_syncpt_max = flip_win->syncpt_max;
 
 	/* XXX verify that this won't read outside of the surface */
 	win->phys_addr = flip_win->phys_addr + flip_win->attr.offset;
@@ -941,6 +969,9 @@ static void tegra_dc_update_postcomp(struct tegra_dc *dc,
 		tegra_nvdisp_set_output_lut(dc, &data->user_nvdisp_cmu,
 					    data->new_cmu_values);
 
+	if (data->output_lut_update)
+		tegra_nvdisp_set_output_lut_buf(dc, data->output_lut_addr);
+
 	if (data->output_colorspace_update_needed)
 		tegra_nvdisp_set_output_colorspace(dc, data->output_colorspace);
 
@@ -1018,8 +1049,9 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	struct tegra_dc_ext *ext = data->ext;
 	struct tegra_dc_win *wins[DC_N_WINDOWS];
 	struct tegra_dc_win *blank_win;
+	/* window planes and input LUTs, plus the output LUT */
 	struct tegra_dc_dmabuf *unpin_handles[DC_N_WINDOWS *
-					       TEGRA_DC_NUM_PLANES];
+					       (TEGRA_DC_NUM_PLANES + 1) + 1];
 	struct tegra_dc_dmabuf *old_handle;
 	struct tegra_dc *dc = ext->dc;
 	int i, nr_unpin = 0, nr_win = 0;
@@ -1063,6 +1095,9 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 			(flip_win->attr.flags & TEGRA_DC_EXT_FLIP_FLAG_CURSOR))
 			win_skip_flip = true;
 
+		if (data->superseded)
+			win_skip_flip = true;
+
 		mutex_lock(&ext_win->queue_lock);
 		list_for_each_entry(temp, &ext_win->timestamp_queue,
 				timestamp_node) {
@@ -1095,6 +1130,13 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		if (win_skip_flip) {
 			if (flip_ele)
 				flip_ele->state = TEGRA_DC_FLIP_STATE_SKIPPED;
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+			/* normally put once waited for in set_windowattr */
+			if (flip_win->pre_syncpt_fence) {
+				sync_fence_put(flip_win->pre_syncpt_fence);
+				flip_win->pre_syncpt_fence = NULL;
+			}
+#endif
 			old_handle = flip_win->handle[TEGRA_DC_Y];
 		} else {
 			old_handle = ext_win->cur_handle[TEGRA_DC_Y];
@@ -1196,6 +1238,21 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		if (!win_skip_flip)
 			tegra_dc_ext_set_windowattr(ext, win, &data->win[i]);
 
+		if (flip_win->lut_update) {
+			if (win_skip_flip) {
+				if (flip_win->lut_handle)
+					unpin_handles[nr_unpin++] =
+						flip_win->lut_handle;
+			} else {
+				if (ext_win->cur_lut)
+					unpin_handles[nr_unpin++] =
+						ext_win->cur_lut;
+				ext_win->cur_lut = flip_win->lut_handle;
+				win->lut_buf_addr = flip_win->lut_handle ?
+						flip_win->lut_addr : 0;
+			}
+		}
+
 		if (dc->yuv_bypass) {
 			reg_val = tegra_dc_readl(dc,
 				DC_DISP_DISP_COLOR_CONTROL);
@@ -1229,6 +1286,7 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 
 	if (trace_sync_wt_ovr_syncpt_upd_enabled())
 		tegra_dc_flip_trace(data, trace_sync_wt_ovr_syncpt_upd);
+	data->ts_fenced = ktime_get();
 
 	if (dc->enabled && !skip_flip) {
 		tegra_dc_set_hdr(dc, &data->hdr_data, data->hdr_cache_dirty);
@@ -1265,8 +1323,10 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		tegra_dc_update_windows(wins, nr_win,
 			data->dirty_rect_valid ? data->dirty_rect : NULL,
 			wait_for_vblank, lock_flip);
+		data->ts_programmed = ktime_get();
 		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
+		data->ts_latched = ktime_get();
 
 		if (flip_ele)
 			flip_ele->state = TEGRA_DC_FLIP_STATE_FLIPPED;
@@ -1293,6 +1353,17 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		trace_dc_flip_dropped(dc->enabled, skip_flip);
 	}
 
+	if (data->output_lut_update) {
+		if (dc->enabled && !skip_flip) {
+			if (ext->cur_output_lut)
+				unpin_handles[nr_unpin++] =
+					ext->cur_output_lut;
+			ext->cur_output_lut = data->output_lut_handle;
+		} else if (data->output_lut_handle) {
+			unpin_handles[nr_unpin++] = data->output_lut_handle;
+		}
+	}
+
 	if (data->imp_dirty)
 		tegra_dc_release_common_channel(dc);
 
@@ -1311,6 +1382,11 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 					flip_win->syncpt_max);
 		}
 		atomic64_inc(&dc->flip_stats.flips_cmpltd);
+		/* not programmed if the head got disabled meanwhile */
+		if (ktime_to_ns(data->ts_latched))
+			tegra_dc_flip_latency_record(dc, data->ts_queued,
+				data->ts_fenced, data->ts_programmed,
+				data->ts_latched, ktime_get());
 	} else {
 		atomic64_inc(&dc->flip_stats.flips_skipped);
 	}
@@ -1321,10 +1397,175 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	/* now DC has submitted buffer for display, try to release fbmem */
 	tegra_fb_release_fbmem(ext->dc->fb);
 #endif
-	kfree(data);
+	tegra_dc_ext_flip_put(data);
 	kfree(blank_win);
 }
 
+/*
+ * Flips are handed to the window flip workers only once all their
+ * pre-fences have signalled, so that one late fence does not hold up
+ * flips queued after it on other windows. A flip still waits behind an
+ * older pending flip that shares a window with it, to keep flips in
+ * order per window. In mailbox mode, an older flip whose windows are
+ * all covered by a newer one that is ready is superseded and no longer
+ * holds anything up; it is dropped once its fences signal.
+ *
+ * Fences that can not be waited for asynchronously, such as those not
+ * backed by a syncpoint, are left to the blocking wait in the worker.
+ */
+static void tegra_dc_ext_flip_sched_dispatch_locked(struct tegra_dc_ext *ext)
+{
+	struct tegra_dc_ext_flip_data *data, *tmp;
+	unsigned long blocked = 0;
+
+	list_for_each_entry_safe(data, tmp, &ext->flip_sched.pending,
+				 sched_node) {
+		if (!data->fences_pending && !(data->win_mask & blocked)) {
+			list_del(&data->sched_node);
+			kthread_queue_work(
+				&ext->win[data->work_index].flip_worker,
+				&data->work);
+			continue;
+		}
+
+		if (!data->superseded)
+			blocked |= data->win_mask;
+	}
+
+	if (list_empty(&ext->flip_sched.pending))
+		wake_up_all(&ext->flip_sched.idle_wq);
+}
+
+static void tegra_dc_ext_flip_supersede_locked(struct tegra_dc_ext *ext,
+		struct tegra_dc_ext_flip_data *newer)
+{
+	struct tegra_dc_ext_flip_data *data;
+
+	if (!(newer->flags & TEGRA_DC_EXT_FLIP_HEAD_FLAG_MAILBOX) ||
+	    newer->has_timestamp)
+		return;
+
+	list_for_each_entry(data, &ext->flip_sched.pending, sched_node) {
+		if (data == newer)
+			break;
+
+		if ((data->flags & TEGRA_DC_EXT_FLIP_HEAD_FLAG_MAILBOX) &&
+		    !data->has_timestamp && !data->imp_dirty &&
+		    !(data->win_mask & ~newer->win_mask))
+			data->superseded = true;
+	}
+}
+
+static void tegra_dc_ext_flip_put(struct tegra_dc_ext_flip_data *data)
+{
+	if (atomic_dec_and_test(&data->refs))
+		kfree(data);
+}
+
+static void tegra_dc_ext_flip_fence_signaled(void *priv, int nr_completed)
+{
+	struct tegra_dc_ext_flip_data *data = priv;
+	struct tegra_dc_ext *ext = data->ext;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ext->flip_sched.lock, flags);
+	if (data->fences_pending && !--data->fences_pending) {
+		tegra_dc_ext_flip_supersede_locked(ext, data);
+		tegra_dc_ext_flip_sched_dispatch_locked(ext);
+	}
+	spin_unlock_irqrestore(&ext->flip_sched.lock, flags);
+
+	tegra_dc_ext_flip_put(data);
+}
+
+static void tegra_dc_ext_flip_wait_async(struct tegra_dc_ext_flip_data *data,
+		u32 id, u32 thresh)
+{
+	struct platform_device *ndev = data->ext->dc->ndev;
+	unsigned long flags;
+
+	if (!nvhost_syncpt_is_valid_pt_ext(ndev, id) ||
+	    nvhost_syncpt_is_expired_ext(ndev, id, thresh))
+		return;
+
+	spin_lock_irqsave(&data->ext->flip_sched.lock, flags);
+	data->fences_pending++;
+	spin_unlock_irqrestore(&data->ext->flip_sched.lock, flags);
+	atomic_inc(&data->refs);
+
+	if (nvhost_intr_register_notifier(ndev, id, thresh,
+			tegra_dc_ext_flip_fence_signaled, data))
+		/* the worker waits for it instead */
+		tegra_dc_ext_flip_fence_signaled(data, 0);
+}
+
+static void tegra_dc_ext_flip_sched_queue(struct tegra_dc_ext *ext,
+		struct tegra_dc_ext_flip_data *data, int work_index)
+{
+	unsigned long flags;
+	int i;
+
+	data->work_index = work_index;
+	/* held on behalf of the fences until they are all registered */
+	data->fences_pending = 1;
+	atomic_set(&data->refs, 2);
+
+	spin_lock_irqsave(&ext->flip_sched.lock, flags);
+	list_add_tail(&data->sched_node, &ext->flip_sched.pending);
+	spin_unlock_irqrestore(&ext->flip_sched.lock, flags);
+
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+#ifdef CONFIG_TEGRA_GRHOST_SYNC
+		struct sync_fence *fence = flip_win->pre_syncpt_fence;
+
+		if (fence) {
+			int j;
+
+			for (j = 0; j < fence->num_fences; j++) {
+				struct sync_pt *pt = sync_pt_from_fence(
+						fence->cbs[j].sync_pt);
+
+				tegra_dc_ext_flip_wait_async(data,
+					nvhost_sync_pt_id(pt),
+					nvhost_sync_pt_thresh(pt));
+			}
+			continue;
+		}
+#endif
+		if ((s32)flip_win->attr.pre_syncpt_id >= 0)
+			tegra_dc_ext_flip_wait_async(data,
+				flip_win->attr.pre_syncpt_id,
+				flip_win->attr.pre_syncpt_val);
+	}
+
+	tegra_dc_ext_flip_fence_signaled(data, 0);
+}
+
+/*
+ * Wait for flips still waiting on their fences to reach the flip workers.
+ * Fences get 5 seconds, as in the worker; flips whose fences have not
+ * signalled by then are dispatched anyway.
+ */
+static void tegra_dc_ext_flip_sched_flush(struct tegra_dc_ext *ext)
+{
+	struct tegra_dc_ext_flip_data *data;
+	unsigned long flags;
+
+	if (wait_event_timeout(ext->flip_sched.idle_wq,
+			list_empty(&ext->flip_sched.pending),
+			msecs_to_jiffies(5000)))
+		return;
+
+	dev_warn(&ext->dc->ndev->dev, "flip pre-fence timeout\n");
+
+	spin_lock_irqsave(&ext->flip_sched.lock, flags);
+	list_for_each_entry(data, &ext->flip_sched.pending, sched_node)
+		data->fences_pending = 0;
+	tegra_dc_ext_flip_sched_dispatch_locked(ext);
+	spin_unlock_irqrestore(&ext->flip_sched.lock, flags);
+}
+
 static int lock_windows_for_flip(struct tegra_dc_ext_user *user,
 			struct tegra_dc_ext_flip_windowattr_v2 *win_attr,
 			int win_num)
@@ -1603,9 +1844,11 @@ static int tegra_dc_ext_pin_windows(struct tegra_dc_ext_user *user,
 
 static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win)
 {
-	struct tegra_dc_dmabuf *unpin_handles[TEGRA_DC_NUM_PLANES];
+	struct tegra_dc_dmabuf *unpin_handles[TEGRA_DC_NUM_PLANES + 1];
 	int nr_unpin = 0;
 
+	/* screen capture may be exporting cur_handle */
+	tegra_dc_scrncapt_disp_pause_lock(win->ext->dc);
 	if (win->cur_handle[TEGRA_DC_Y]) {
 		int j;
 		for (j = 0; j < TEGRA_DC_NUM_PLANES; j++) {
@@ -1614,6 +1857,17 @@ static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win)
 		}
 		memset(win->cur_handle, 0, sizeof(win->cur_handle));
 	}
+	if (win->cur_lut) {
+		struct tegra_dc_win *dc_win;
+
+		/* the window is blanked, nothing reads the LUT any more */
+		dc_win = tegra_dc_get_window(win->ext->dc, win->idx);
+		if (dc_win)
+			dc_win->lut_buf_addr = 0;
+		unpin_handles[nr_unpin++] = win->cur_lut;
+		win->cur_lut = NULL;
+	}
+	tegra_dc_scrncapt_disp_pause_unlock(win->ext->dc);
 
 	tegra_dc_ext_unpin_handles(unpin_handles, nr_unpin);
 }
@@ -1779,7 +2033,77 @@ static int tegra_dc_ext_configure_background_color_user_data(
 	return 0;
 }
 
-static int tegra_dc_ext_read_user_data(struct tegra_dc_ext_flip_data *data,
+static int tegra_dc_ext_configure_lut_buf_user_data(
+	struct tegra_dc_ext_user *user,
+	struct tegra_dc_ext_flip_data *flip_kdata,
+	struct tegra_dc_ext_flip_user_data *flip_udata)
+{
+	struct tegra_dc_ext_udata_lut_buf *lut_buf = &flip_udata->lut_buf;
+	struct device *dev = &flip_kdata->ext->dc->ndev->dev;
+	struct tegra_dc_dmabuf **handle;
+	dma_addr_t *addr;
+	size_t size;
+	bool *update;
+	int j, ret;
+
+	if (!tegra_dc_is_nvdisplay())
+		return -EINVAL;
+
+	if (lut_buf->win_index == TEGRA_DC_EXT_LUT_BUF_OUTPUT) {
+		update = &flip_kdata->output_lut_update;
+		handle = &flip_kdata->output_lut_handle;
+		addr = &flip_kdata->output_lut_addr;
+		size = (TEGRA_DC_EXT_LUT_SIZE_1025 + 1) * sizeof(u64);
+	} else {
+		for (j = 0; j < flip_kdata->act_window_num; j++) {
+			if (lut_buf->win_index ==
+				flip_kdata->win[j].attr.index)
+				break;
+		}
+
+		if (j >= flip_kdata->act_window_num) {
+			dev_err(dev, "win%d for lut_buf not in flip wins\n",
+				lut_buf->win_index);
+			return -EINVAL;
+		}
+
+		update = &flip_kdata->win[j].lut_update;
+		handle = &flip_kdata->win[j].lut_handle;
+		addr = &flip_kdata->win[j].lut_addr;
+		size = (TEGRA_DC_EXT_LUT_SIZE_257 + 1) * sizeof(u64);
+	}
+
+	if (*update) {
+		dev_err(dev, "only one lut_buf/win%d allowed\n",
+			lut_buf->win_index);
+		return -EINVAL;
+	}
+
+	if (lut_buf->offset & (sizeof(u64) - 1))
+		return -EINVAL;
+
+	ret = tegra_dc_ext_pin_window(user, lut_buf->buff_id, handle, addr);
+	if (ret)
+		return ret;
+
+	/* from here on the flip owns the (possibly NULL) handle */
+	*update = true;
+
+	if (*handle) {
+		if (lut_buf->offset > (*handle)->buf->size ||
+			(*handle)->buf->size - lut_buf->offset < size) {
+			dev_err(dev, "lut_buf too small for win%d\n",
+				lut_buf->win_index);
+			return -EINVAL;
+		}
+		*addr += lut_buf->offset;
+	}
+
+	return 0;
+}
+
+static int tegra_dc_ext_read_user_data(struct tegra_dc_ext_user *user,
+			struct tegra_dc_ext_flip_data *data,
 			struct tegra_dc_ext_flip_user_data *flip_user_data,
 			int nr_user_data)
 {
@@ -1874,6 +2198,12 @@ static int tegra_dc_ext_read_user_data(struct tegra_dc_ext_flip_data *data,
 			if (ret)
 				return ret;
 			break;
+		case TEGRA_DC_EXT_FLIP_USER_DATA_LUT_BUF:
+			ret = tegra_dc_ext_configure_lut_buf_user_data(user,
+				data, &flip_user_data[i]);
+			if (ret)
+				return ret;
+			break;
 		default:
 			dev_err(&data->ext->dc->ndev->dev,
 				"Invalid FLIP_USER_DATA_TYPE\n");
@@ -1910,6 +2240,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (!data)
 		return -ENOMEM;
 
+	data->ts_queued = ktime_get();
 	kthread_init_work(&data->work, &tegra_dc_ext_flip_worker);
 	data->ext = ext;
 	data->act_window_num = win_num;
@@ -1927,7 +2258,8 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (ret)
 		goto fail_pin;
 
-	ret = tegra_dc_ext_read_user_data(data, flip_user_data, nr_user_data);
+	ret = tegra_dc_ext_read_user_data(user, data, flip_user_data,
+					  nr_user_data);
 	if (ret)
 		goto fail_pin;
 
@@ -1989,6 +2321,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		post_sync_id = tegra_dc_get_syncpt_id(ext->dc, index);
 
 		work_index = index;
+		data->win_mask |= BIT(index);
 
 		atomic_inc(&ext->win[work_index].nr_pending_flips);
 	}
@@ -2028,6 +2361,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 
 	/* Avoid queueing timestamps on Android, to disable skipping flips */
 #ifndef CONFIG_ANDROID
+	data->has_timestamp = has_timestamp;
 	if (has_timestamp) {
 		mutex_lock(&ext->win[work_index].queue_lock);
 		list_add_tail(&data->timestamp_node, &ext->win[work_index].timestamp_queue);
@@ -2057,7 +2391,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		data->flip_buf_ele = in_q_ptr;
 	}
 
-	kthread_queue_work(&ext->win[work_index].flip_worker, &data->work);
+	tegra_dc_ext_flip_sched_queue(ext, data, work_index);
 
 	unlock_windows_for_flip(user, win, win_num);
 
@@ -2081,7 +2415,11 @@ fail_pin:
 			dma_buf_put(data->win[i].handle[j]->buf);
 			kfree(data->win[i].handle[j]);
 		}
+		if (data->win[i].lut_handle)
+			tegra_dc_ext_unpin_handles(&data->win[i].lut_handle, 1);
 	}
+	if (data->output_lut_handle)
+		tegra_dc_ext_unpin_handles(&data->output_lut_handle, 1);
 
 	/* Release the COMMON channel in case of failure. */
 	if (data->imp_dirty)
@@ -2788,6 +3126,122 @@ static int tegra_dc_copy_flip_id_to_user(struct tegra_dc_ext_flip_4 *args,
 	return 0;
 }
 
+static int tegra_dc_ext_flip4_ioctl(struct tegra_dc_ext_user *user,
+				    void __user *user_arg)
+{
+	int ret;
+	int win_num;
+	int nr_user_data;
+	struct tegra_dc_ext_flip_4 args;
+	struct tegra_dc_ext_flip_windowattr_v2 *win;
+	struct tegra_dc_ext_flip_user_data *flip_user_data;
+	bool bypass;
+	u32 *syncpt_id = NULL, *syncpt_val = NULL;
+	int *syncpt_fd = NULL;
+	int syncpt_idx = -1;
+	u64 flip_id;
+
+	u32 usr_win_size = sizeof(struct tegra_dc_ext_flip_windowattr);
+
+	if (copy_from_user(&args, user_arg, sizeof(args)))
+		return -EFAULT;
+
+	bypass = !!(args.flags & TEGRA_DC_EXT_FLIP_HEAD_FLAG_YUVBYPASS);
+
+	if (tegra_dc_is_t21x()) {
+		if (!!(user->ext->dc->mode.vmode & FB_VMODE_YUV_MASK) !=
+				bypass)
+			return -EINVAL;
+	}
+
+	if (bypass != user->ext->dc->yuv_bypass)
+		user->ext->dc->yuv_bypass_dirty = true;
+	user->ext->dc->yuv_bypass = bypass;
+	win_num = args.win_num;
+	win = kzalloc(sizeof(*win) * win_num, GFP_KERNEL);
+
+	if (args.flags &
+			TEGRA_DC_EXT_FLIP_HEAD_FLAG_V2_ATTR)
+		usr_win_size =
+			sizeof(struct tegra_dc_ext_flip_windowattr_v2);
+
+	if (dev_cpy_from_usr(win, (void *)args.win,
+				usr_win_size, win_num)) {
+		kfree(win);
+		return -EFAULT;
+	}
+
+	nr_user_data = args.nr_elements;
+	flip_user_data = kzalloc(sizeof(*flip_user_data)
+				* nr_user_data, GFP_KERNEL);
+	if (nr_user_data > 0) {
+		if (copy_from_user(flip_user_data,
+			(void __user *) (uintptr_t)args.data,
+			sizeof(*flip_user_data) * nr_user_data)) {
+			kfree(flip_user_data);
+			kfree(win);
+			return -EFAULT;
+		}
+	}
+
+	/*
+	 * Check if the client is explicitly requesting syncpts via flip
+	 * user data. If so, populate the syncpt variables accordingly.
+	 * Else, default to sync fds and use the original post_syncpt_fd
+	 * fence.
+	 */
+	ret = tegra_dc_copy_syncpts_from_user(user->ext->dc,
+		flip_user_data, nr_user_data, &syncpt_id, &syncpt_val,
+		&syncpt_fd, &syncpt_idx);
+	if (ret) {
+		kfree(flip_user_data);
+		kfree(win);
+		return ret;
+	}
+
+	if (syncpt_idx == -1)
+		syncpt_fd = &args.post_syncpt_fd;
+
+	ret = tegra_dc_ext_flip(user, win, win_num,
+		syncpt_id, syncpt_val, syncpt_fd, args.dirty_rect,
+		args.flags, flip_user_data, nr_user_data, &flip_id);
+	if (ret) {
+		kfree(flip_user_data);
+		kfree(win);
+		return ret;
+	}
+
+	/*
+	 * If the client requested post syncpt values via user data,
+	 * copy them back.
+	 */
+	if (syncpt_idx > -1) {
+		args.post_syncpt_fd = -1;
+		ret = tegra_dc_copy_syncpts_to_user(flip_user_data,
+				syncpt_idx, (u8 *)(void *)args.data);
+		if (ret) {
+			kfree(flip_user_data);
+			kfree(win);
+			return ret;
+		}
+	}
+
+	if (dev_cpy_to_usr((void *)args.win, usr_win_size,
+				win, win_num) ||
+		copy_to_user(user_arg, &args, sizeof(args))) {
+		kfree(flip_user_data);
+		kfree(win);
+		return -EFAULT;
+	}
+
+	ret = tegra_dc_copy_flip_id_to_user(&args, flip_user_data,
+					    nr_user_data, flip_id);
+
+	kfree(flip_user_data);
+	kfree(win);
+	return ret;
+}
+
 static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 			   unsigned long arg)
 {
@@ -2818,119 +3272,7 @@ static long tegra_dc_ioctl(struct file *filp, unsigned int cmd,
 		return tegra_dc_ext_set_winmask(user, arg);
 
 	case TEGRA_DC_EXT_FLIP4:
-	{
-		int ret;
-		int win_num;
-		int nr_user_data;
-		struct tegra_dc_ext_flip_4 args;
-		struct tegra_dc_ext_flip_windowattr_v2 *win;
-		struct tegra_dc_ext_flip_user_data *flip_user_data;
-		bool bypass;
-		u32 *syncpt_id = NULL, *syncpt_val = NULL;
-		int *syncpt_fd = NULL;
-		int syncpt_idx = -1;
-		u64 flip_id;
-
-		u32 usr_win_size = sizeof(struct tegra_dc_ext_flip_windowattr);
-
-		if (copy_from_user(&args, user_arg, sizeof(args)))
-			return -EFAULT;
-
-		bypass = !!(args.flags & TEGRA_DC_EXT_FLIP_HEAD_FLAG_YUVBYPASS);
-
-		if (tegra_dc_is_t21x()) {
-			if (!!(user->ext->dc->mode.vmode & FB_VMODE_YUV_MASK) !=
-					bypass)
-				return -EINVAL;
-		}
-
-		if (bypass != user->ext->dc->yuv_bypass)
-			user->ext->dc->yuv_bypass_dirty = true;
-		user->ext->dc->yuv_bypass = bypass;
-		win_num = args.win_num;
-		win = kzalloc(sizeof(*win) * win_num, GFP_KERNEL);
-
-		if (args.flags &
-				TEGRA_DC_EXT_FLIP_HEAD_FLAG_V2_ATTR)
-			usr_win_size =
-				sizeof(struct tegra_dc_ext_flip_windowattr_v2);
-
-		if (dev_cpy_from_usr(win, (void *)args.win,
-					usr_win_size, win_num)) {
-			kfree(win);
-			return -EFAULT;
-		}
-
-		nr_user_data = args.nr_elements;
-		flip_user_data = kzalloc(sizeof(*flip_user_data)
-					* nr_user_data, GFP_KERNEL);
-		if (nr_user_data > 0) {
-			if (copy_from_user(flip_user_data,
-				(void __user *) (uintptr_t)args.data,
-				sizeof(*flip_user_data) * nr_user_data)) {
-				kfree(flip_user_data);
-				kfree(win);
-				return -EFAULT;
-			}
-		}
-
-		/*
-		 * Check if the client is explicitly requesting syncpts via flip
-		 * user data. If so, populate the syncpt variables accordingly.
-		 * Else, default to sync fds and use the original post_syncpt_fd
-		 * fence.
-		 */
-		ret = tegra_dc_copy_syncpts_from_user(user->ext->dc,
-			flip_user_data, nr_user_data, &syncpt_id, &syncpt_val,
-			&syncpt_fd, &syncpt_idx);
-		if (ret) {
-			kfree(flip_user_data);
-			kfree(win);
-			return ret;
-		}
-
-		if (syncpt_idx == -1)
-			syncpt_fd = &args.post_syncpt_fd;
-
-		ret = tegra_dc_ext_flip(user, win, win_num,
-			syncpt_id, syncpt_val, syncpt_fd, args.dirty_rect,
-			args.flags, flip_user_data, nr_user_data, &flip_id);
-		if (ret) {
-			kfree(flip_user_data);
-			kfree(win);
-			return ret;
-		}
-
-		/*
-		 * If the client requested post syncpt values via user data,
-		 * copy them back.
-		 */
-		if (syncpt_idx > -1) {
-			args.post_syncpt_fd = -1;
-			ret = tegra_dc_copy_syncpts_to_user(flip_user_data,
-					syncpt_idx, (u8 *)(void *)args.data);
-			if (ret) {
-				kfree(flip_user_data);
-				kfree(win);
-				return ret;
-			}
-		}
-
-		if (dev_cpy_to_usr((void *)args.win, usr_win_size,
-					win, win_num) ||
-			copy_to_user(user_arg, &args, sizeof(args))) {
-			kfree(flip_user_data);
-			kfree(win);
-			return -EFAULT;
-		}
-
-		ret = tegra_dc_copy_flip_id_to_user(&args, flip_user_data,
-						    nr_user_data, flip_id);
-
-		kfree(flip_user_data);
-		kfree(win);
-		return ret;
-	}
+		return tegra_dc_ext_flip4_ioctl(user, user_arg);
 
 	case TEGRA_DC_EXT_GET_IMP_USER_INFO:
 	{
@@ -3451,6 +3793,23 @@ free_and_ret:
 #endif
 	}
 
+	case TEGRA_DC_EXT_SCRNCAPT_EXPORT_FBUF:
+	{
+#ifdef CONFIG_TEGRA_DC_SCREEN_CAPTURE
+		struct tegra_dc_ext_scrncapt_export_fbuf  args;
+		int  ret;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+		ret = tegra_dc_scrncapt_export_fbuf(user, &args);
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+		return ret;
+#else
+		return -EINVAL;
+#endif
+	}
+
 	case TEGRA_DC_EXT_GET_SCANLINE:
 	{
 		u32 scanln;
@@ -3564,6 +3923,50 @@ free_and_ret:
 		kfree((struct tegra_dc_ext_crc_conf *)args.conf);
 		return ret;
 	}
+	case TEGRA_DC_EXT_CRC_GET_BULK:
+	{
+		struct tegra_dc_ext_crc_bulk_arg args;
+		struct tegra_dc_ext_crc_frame *frames;
+		struct tegra_dc *dc = user->ext->dc;
+		u32 max_frames;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		if (memcmp(args.magic, "TCRC", 4))
+			return -EINVAL;
+
+		if (args.version >= TEGRA_DC_CRC_ARG_VERSION_MAX)
+			return -ENOTSUPP;
+
+		max_frames = min_t(u32, args.max_frames,
+				   TEGRA_DC_EXT_CRC_BULK_MAX_FRAMES);
+		args.num_frames = 0;
+
+		if (max_frames) {
+			frames = kcalloc(max_frames, sizeof(*frames),
+					 GFP_KERNEL);
+			if (!frames)
+				return -ENOMEM;
+
+			ret = tegra_dc_crc_get_bulk(dc, args.flip_id, frames,
+						    max_frames,
+						    &args.num_frames);
+			if (!ret && copy_to_user(
+					(void __user *)args.frames, frames,
+					args.num_frames * sizeof(*frames)))
+				ret = -EFAULT;
+
+			kfree(frames);
+			if (ret)
+				return ret;
+		}
+
+		if (copy_to_user(user_arg, &args, sizeof(args)))
+			return -EFAULT;
+
+		return 0;
+	}
 
 	default:
 		return -EINVAL;
@@ -3597,6 +4000,23 @@ static int tegra_dc_open(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/*
+ * Switch the output back to the driver LUT once nobody is left to manage the
+ * userspace one, and release the buffer after the switch has latched.
+ */
+static void tegra_dc_ext_put_output_lut(struct tegra_dc_ext *ext)
+{
+	struct tegra_dc_dmabuf *handle = ext->cur_output_lut;
+
+	if (!handle)
+		return;
+
+	tegra_nvdisp_update_cmu(ext->dc, &ext->dc->nvdisp_postcomp_lut);
+	ext->dc->output_lut_buf_addr = 0;
+	ext->cur_output_lut = NULL;
+	tegra_dc_ext_unpin_handles(&handle, 1);
+}
+
 static int tegra_dc_release(struct inode *inode, struct file *filp)
 {
 	struct tegra_dc_ext_user *user = filp->private_data;
@@ -3638,6 +4058,7 @@ static int tegra_dc_release(struct inode *inode, struct file *filp)
 
 	if (!atomic_dec_return(&ext->users_count)) {
 		tegra_dc_crc_drop_ref_cnts(ext->dc);
+		tegra_dc_ext_put_output_lut(ext);
 		if (tegra_fb_is_console_enabled(ext->dc->pdata)) {
 			i = tegra_fb_redisplay_console(ext->dc->fb);
 			if (i && i != -ENODEV) {
@@ -3700,6 +4121,85 @@ static const struct file_operations tegra_dc_devops = {
 #endif
 };
 
+/*
+ * Queue the flips of all frame-locked heads from one call. Each head goes
+ * through the normal FLIP4 path; the flip workers then meet in
+ * tegra_dc_common_sync_flips(), which latches every head with one host1x
+ * gather. The set of heads has to match the frame-lock heads exactly,
+ * otherwise the workers would wait there for a head that never flips.
+ */
+int tegra_dc_ext_flip_multi(const struct tegra_dc_ext_control_flip_head *heads,
+			    u32 nr_heads, u32 *failed_head)
+{
+	struct tegra_dc_ext_control_frm_lck_params params;
+	struct fd *files;
+	u64 head_mask = 0;
+	u32 i, nr_files = 0;
+	int ret;
+
+	*failed_head = 0;
+
+	if (!nr_heads || nr_heads > tegra_dc_get_numof_reg_disps())
+		return -EINVAL;
+
+	ret = tegra_dc_common_get_frm_lock_params(&params);
+	if (ret)
+		return ret;
+
+	if (!params.frame_lock_status)
+		return -EINVAL;
+
+	files = kcalloc(nr_heads, sizeof(*files), GFP_KERNEL);
+	if (!files)
+		return -ENOMEM;
+
+	/* Resolve and validate every head before queueing anything */
+	for (i = 0; i < nr_heads; i++, nr_files++) {
+		struct tegra_dc_ext_user *user;
+		int ctrl_num;
+
+		*failed_head = i;
+		files[i] = fdget(heads[i].fd);
+		if (!files[i].file) {
+			ret = -EBADF;
+			goto out;
+		}
+
+		if (files[i].file->f_op != &tegra_dc_devops) {
+			ret = -EINVAL;
+			goto out;
+		}
+
+		user = files[i].file->private_data;
+		ctrl_num = user->ext->dc->ctrl_num;
+		if (head_mask & BIT_ULL(ctrl_num)) {
+			ret = -EINVAL;
+			goto out;
+		}
+		head_mask |= BIT_ULL(ctrl_num);
+	}
+
+	if (head_mask != params.valid_heads) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < nr_heads; i++) {
+		*failed_head = i;
+		ret = tegra_dc_ext_flip4_ioctl(files[i].file->private_data,
+				(void __user *)(uintptr_t)heads[i].flip);
+		if (ret)
+			goto out;
+	}
+
+out:
+	while (nr_files--)
+		fdput(files[nr_files]);
+	kfree(files);
+
+	return ret;
+}
+
 struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 					   struct tegra_dc *dc)
 {
@@ -3738,6 +4238,10 @@ struct tegra_dc_ext *tegra_dc_ext_register(struct platform_device *ndev,
 
 	ext->dc = dc;
 
+	spin_lock_init(&ext->flip_sched.lock);
+	INIT_LIST_HEAD(&ext->flip_sched.pending);
+	init_waitqueue_head(&ext->flip_sched.idle_wq);
+
 	ret = tegra_dc_ext_setup_windows(ext);
 	if (ret)
 		goto cleanup_device;
@@ -3776,6 +4280,7 @@ void tegra_dc_ext_unregister(struct tegra_dc_ext *ext)
 {
 	int i;
 
+	tegra_dc_ext_flip_sched_flush(ext);
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
 
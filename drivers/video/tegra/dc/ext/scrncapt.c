@@ -16,10 +16,14 @@
  * more details.
  */
 
+#include <linux/capability.h>
+#include <linux/dma-buf.h>
 #include <linux/file.h>
 #include <linux/fs.h>
+#include <linux/nvhost.h>
 #include <linux/uaccess.h>
 #include <linux/slab.h>
+#include <linux/syscalls.h>
 #include <linux/workqueue.h>
 #include <linux/export.h>
 #include <linux/delay.h>
@@ -563,6 +567,166 @@ int tegra_dc_scrncapt_dup_fbuf(struct tegra_dc_ext_user *user,
 }
 
 
+/* hand out a new dma-buf fd referencing a scanout buffer */
+static int  scrncapt_export_dcbuf(struct tegra_dc_dmabuf *dcbuf)
+{
+	int  fd;
+
+	get_dma_buf(dcbuf->buf);
+	fd = dma_buf_fd(dcbuf->buf, O_CLOEXEC);
+	if (fd < 0)
+		dma_buf_put(dcbuf->buf);
+
+	return fd;
+}
+
+
+static void  scrncapt_export_close_fds(
+		struct tegra_dc_ext_scrncapt_export_fbuf *args)
+{
+	int  p;
+
+	for (p = 0; p < TEGRA_DC_SCRNCAPT_DUP_FBUF_IDX_NUM; p++) {
+		if (args->plane_fds[p] >= 0)
+			sys_close(args->plane_fds[p]);
+		args->plane_fds[p] = -1;
+	}
+}
+
+
+static int  scrncapt_export_win(struct tegra_dc *dc, int winidx,
+		struct tegra_dc_ext_scrncapt_export_fbuf *args, u32 *syncpt_max)
+{
+	struct tegra_dc_ext_win  *extwin = &dc->ext->win[winidx];
+	struct tegra_dc_win      *win = tegra_dc_get_window(dc, winidx);
+	dma_addr_t  plane_addr[TEGRA_DC_NUM_PLANES];
+	int  p;
+
+	if (!extwin->cur_handle[TEGRA_DC_Y])
+		return -ENODATA;
+
+	scrncapt_get_info_win(dc, winidx, &args->attr);
+	*syncpt_max = extwin->cur_syncpt_max;
+
+	plane_addr[TEGRA_DC_Y] = win->phys_addr;
+	plane_addr[TEGRA_DC_U] = win->phys_addr_u;
+	plane_addr[TEGRA_DC_V] = win->phys_addr_v;
+	plane_addr[TEGRA_DC_CDE] = win->cde.cde_addr;
+	for (p = 0; p < TEGRA_DC_NUM_PLANES; p++) {
+		struct tegra_dc_dmabuf  *buf = extwin->cur_handle[p];
+
+		if (!buf)
+			continue;
+
+		args->plane_fds[p] = scrncapt_export_dcbuf(buf);
+		if (args->plane_fds[p] < 0) {
+			int  err = args->plane_fds[p];
+
+			args->plane_fds[p] = -1;
+			scrncapt_export_close_fds(args);
+			return err;
+		}
+		if (plane_addr[p] >= sg_dma_address(buf->sgt->sgl))
+			args->plane_offsets[p] = plane_addr[p] -
+				sg_dma_address(buf->sgt->sgl);
+	}
+
+	return 0;
+}
+
+
+static int  scrncapt_export_cursor(struct tegra_dc *dc,
+		struct tegra_dc_ext_scrncapt_export_fbuf *args)
+{
+	struct tegra_dc_dmabuf  *buf = dc->ext->cursor.cur_handle;
+	int  fd;
+
+	if (!buf)
+		return -ENODATA;
+
+	fd = scrncapt_export_dcbuf(buf);
+	if (fd < 0)
+		return fd;
+
+	args->plane_fds[TEGRA_DC_Y] = fd;
+	args->attr.index = -1;
+	args->attr.buff_id = scrncapt_get_dcbuf_len(buf);
+	args->attr.out_x = dc->cursor.x;
+	args->attr.out_y = dc->cursor.y;
+	args->attr.out_w = 32 << dc->cursor.size;
+	args->attr.out_h = 32 << dc->cursor.size;
+
+	return 0;
+}
+
+
+/*
+ * Export the buffers currently on display instead of copying them.
+ * Flips and cursor updates replace the current handles while holding
+ * the pause lock for read and only unpin the old ones afterwards, so
+ * taking it for write here keeps the handles alive long enough to take
+ * our own references. That only holds off a flip for the time it takes
+ * to install the fds.
+ */
+int tegra_dc_scrncapt_export_fbuf(struct tegra_dc_ext_user *user,
+		struct tegra_dc_ext_scrncapt_export_fbuf *args)
+{
+	int  err = 0;
+	int  p;
+	struct tegra_dc_ext *ext = user->ext;
+	struct tegra_dc     *dc  = ext->dc;
+	bool  cursor = args->win == TEGRA_DC_EXT_SCRNCAPT_EXPORT_CURSOR;
+	u32  syncpt_max = 0;
+
+	if (TEGRA_DC_EXT_SCRNCAPT_VER_V(args->ver) != 2)
+		return -EFAULT;
+	if (!capable(CAP_SYS_ADMIN))
+		return -EPERM;
+	if (args->flags)
+		return -EINVAL;
+	if ((tegra_dc_get_numof_dispheads() <= (unsigned)args->head) ||
+		(!cursor &&
+		 tegra_dc_get_numof_dispwindows() <= (unsigned)args->win))
+		return -EINVAL;
+	if (!cursor && !(dc->valid_windows & (1 << args->win)))
+		return -EBUSY;
+
+	for (p = 0; p < TEGRA_DC_SCRNCAPT_DUP_FBUF_IDX_NUM; p++) {
+		args->plane_fds[p] = -1;
+		args->plane_offsets[p] = 0;
+	}
+	args->release_fence_fd = -1;
+	memset(&args->attr, 0, sizeof(args->attr));
+
+	down_write(&scrncapt.rwsema_head[dc->ctrl_num]);
+	if (cursor)
+		err = scrncapt_export_cursor(dc, args);
+	else
+		err = scrncapt_export_win(dc, args->win, args, &syncpt_max);
+	up_write(&scrncapt.rwsema_head[dc->ctrl_num]);
+	if (err)
+		goto done;
+
+	/* the buffers leave the screen once the next flip completes */
+	if (!cursor) {
+		err = nvhost_syncpt_create_fence_single_ext(dc->ndev,
+				tegra_dc_get_syncpt_id(dc, args->win),
+				syncpt_max + 1, "scrncapt-fence",
+				&args->release_fence_fd);
+		if (err) {
+			pr_err("scrncapt: failed creating fence err:%d\n", err);
+			args->release_fence_fd = -1;
+			scrncapt_export_close_fds(args);
+		}
+	}
+
+done:
+	args->ver = TEGRA_DC_EXT_SCRNCAPT_VER_2(args->ver);
+
+	return err;
+}
+
+
 int  tegra_dc_scrncapt_pause(struct tegra_dc_ext_control_user *ctlusr,
 		struct tegra_dc_ext_control_scrncapt_pause *args)
 {
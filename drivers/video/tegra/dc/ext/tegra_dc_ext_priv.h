@@ -25,6 +25,8 @@
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 #include <video/tegra_dc_ext.h>
 
 #include "../dc.h"
@@ -60,6 +62,10 @@ struct tegra_dc_ext_win {
 
 	/* Current dmabuf (if any) for Y, U, V planes */
 	struct tegra_dc_dmabuf	*cur_handle[TEGRA_DC_NUM_PLANES];
+	/* syncpt value of the flip that put cur_handle on display */
+	u32			cur_syncpt_max;
+	/* Current input LUT buffer (if any) set through a flip */
+	struct tegra_dc_dmabuf	*cur_lut;
 
 	struct task_struct	*flip_kthread;
 	struct kthread_worker	flip_worker;
@@ -87,6 +93,9 @@ struct tegra_dc_ext {
 		struct mutex			lock;
 	} cursor;
 
+	/* Current output LUT buffer (if any) set through a flip */
+	struct tegra_dc_dmabuf		*cur_output_lut;
+
 	bool				enabled;
 	bool				vblank_enabled;
 
@@ -98,6 +107,13 @@ struct tegra_dc_ext {
 	/* scanline work */
 	struct kthread_worker	scanline_worker;
 	struct task_struct	*scanline_task;
+
+	/* flips waiting for their pre-fences, oldest first */
+	struct {
+		spinlock_t		lock;
+		struct list_head	pending;
+		wait_queue_head_t	idle_wq;
+	} flip_sched;
 };
 
 #define TEGRA_DC_EXT_EVENT_MASK_ALL		\
@@ -179,6 +195,10 @@ extern unsigned int tegra_dc_ext_event_poll(struct file *, poll_table *);
 
 extern int tegra_dc_ext_get_num_outputs(void);
 
+extern int tegra_dc_ext_flip_multi(
+			const struct tegra_dc_ext_control_flip_head *heads,
+			u32 nr_heads, u32 *failed_head);
+
 #ifdef CONFIG_TEGRA_DC_SCREEN_CAPTURE
 extern int  tegra_dc_scrncapt_init(void);
 extern int  tegra_dc_scrncapt_exit(void);
@@ -196,6 +216,9 @@ extern int  tegra_dc_scrncapt_get_info(
 extern int  tegra_dc_scrncapt_dup_fbuf(
 		struct tegra_dc_ext_user *user,
 		struct tegra_dc_ext_scrncapt_dup_fbuf *args);
+extern int  tegra_dc_scrncapt_export_fbuf(
+		struct tegra_dc_ext_user *user,
+		struct tegra_dc_ext_scrncapt_export_fbuf *args);
 #else /* !CONFIG_TEGRA_DC_SCREEN_CAPTURE */
 static inline int  tegra_dc_scrncapt_init(void)
 {
@@ -696,6 +696,9 @@ int _tegra_dc_set_mode(struct tegra_dc *dc,
 	struct tegra_dc_mode new_mode = *mode;
 	bool yuv_bypass_vmode = false;
 
+	/* window size and field 2 programming depend on the mode */
+	dc->win_regs_valid = 0;
+
 	yuv_bypass_vmode = (new_mode.vmode & FB_VMODE_YUV_MASK) &&
 				(new_mode.vmode & FB_VMODE_BYPASS);
 
@@ -57,6 +57,9 @@ static bool nvdisp_common_init_done;
 static struct reset_control *nvdisp_common_rst[DC_N_WINDOWS+1];
 
 static int tegra_nvdisp_set_color_control(struct tegra_dc *dc);
+static void tegra_nvdisp_imp_clear_applied(void);
+static struct tegra_nvdisp_imp_settings *cpy_imp_entries(
+				struct tegra_nvdisp_imp_settings *src_settings);
 
 /*
  * As per nvdisplay programming guidelines, only hubclk,dispclk,dscclk,
@@ -751,18 +754,24 @@ static inline bool tegra_nvdisp_is_dc_active(struct tegra_dc *dc)
 	return (ctrl_mode != nvdisp_display_command_control_mode_stop_f());
 }
 
-static int tegra_nvdisp_program_output_lut(struct tegra_dc *dc,
-					struct tegra_dc_nvdisp_lut *nvdisp_lut)
+static void tegra_nvdisp_program_output_lut_addr(struct tegra_dc *dc,
+						dma_addr_t addr)
 {
-	tegra_dc_writel(dc,
-			tegra_dc_reg_l32(nvdisp_lut->phy_addr),
+	tegra_dc_writel(dc, tegra_dc_reg_l32(addr),
 			nvdisp_output_lut_base_r());
-	tegra_dc_writel(dc,
-			tegra_dc_reg_h32(nvdisp_lut->phy_addr),
+	tegra_dc_writel(dc, tegra_dc_reg_h32(addr),
 			nvdisp_output_lut_base_hi_r());
 	tegra_dc_writel(dc, nvdisp_output_lut_ctl_size_1025_f() |
 			    nvdisp_output_lut_ctl_mode_f(0x1), /* interpolate */
 			nvdisp_output_lut_ctl_r());
+}
+
+static int tegra_nvdisp_program_output_lut(struct tegra_dc *dc,
+					struct tegra_dc_nvdisp_lut *nvdisp_lut)
+{
+	/* Explicitly programming the driver LUT drops any userspace buffer */
+	dc->output_lut_buf_addr = 0;
+	tegra_nvdisp_program_output_lut_addr(dc, nvdisp_lut->phy_addr);
 
 	return 0;
 }
@@ -1851,7 +1860,11 @@ static int tegra_nvdisp_postcomp_init(struct tegra_dc *dc)
 	 */
 	nvdisp_lut = &dc->nvdisp_postcomp_lut;
 	if (dc->cmu_enabled) {
-		tegra_nvdisp_program_output_lut(dc, nvdisp_lut);
+		if (dc->output_lut_buf_addr)
+			tegra_nvdisp_program_output_lut_addr(dc,
+						dc->output_lut_buf_addr);
+		else
+			tegra_nvdisp_program_output_lut(dc, nvdisp_lut);
 		tegra_nvdisp_set_color_control(dc);
 
 		act_req_mask |=
@@ -2036,6 +2049,7 @@ int tegra_nvdisp_head_disable(struct tegra_dc *dc)
 	/* Set comp clock to different pclk since dc->clk will be disabled */
 	mutex_lock(&tegra_nvdisp_lock);
 	dc->comp_clk_inuse = false;
+	tegra_nvdisp_imp_clear_applied();
 	mutex_unlock(&tegra_nvdisp_lock);
 	tegra_nvdisp_set_compclk(dc);
 
@@ -2083,6 +2097,7 @@ int tegra_nvdisp_head_enable(struct tegra_dc *dc)
 	/* set clock status to inuse */
 	mutex_lock(&tegra_nvdisp_lock);
 	dc->comp_clk_inuse = true;
+	tegra_nvdisp_imp_clear_applied();
 
 	/* turn on hub clock and init bw */
 	if (!hubclk_already_on) {
@@ -2615,6 +2630,7 @@ void tegra_dc_cache_nvdisp_cmu(struct tegra_dc *dc,
 static void _tegra_nvdisp_update_cmu(struct tegra_dc *dc,
 					struct tegra_dc_nvdisp_lut *cmu)
 {
+	dc->output_lut_buf_addr = 0;
 	dc->cmu_enabled = dc->pdata->cmu_enable;
 	if (!dc->cmu_enabled)
 		return;
@@ -3872,6 +3888,127 @@ static void tegra_nvdisp_program_other_mempool(struct tegra_dc *dc,
 	}
 }
 
+static bool imp_settings_equal(struct tegra_nvdisp_imp_settings *a,
+				struct tegra_nvdisp_imp_settings *b)
+{
+	int i;
+
+	if (a->num_heads != b->num_heads ||
+		memcmp(&a->global_entries, &b->global_entries,
+					sizeof(a->global_entries)))
+		return false;
+
+	for (i = 0; i < a->num_heads; i++) {
+		struct tegra_nvdisp_imp_head_settings *head_a, *head_b;
+
+		head_a = &a->head_settings[i];
+		head_b = &b->head_settings[i];
+		if (head_a->num_wins != head_b->num_wins ||
+			memcmp(&head_a->entries, &head_b->entries,
+						sizeof(head_a->entries)) ||
+			memcmp(head_a->win_entries, head_b->win_entries,
+				sizeof(*head_a->win_entries) * head_a->num_wins))
+			return false;
+	}
+
+	return true;
+}
+
+static bool imp_mode_equal(const struct tegra_dc_mode *a,
+			const struct tegra_dc_mode *b)
+{
+	return a->pclk == b->pclk &&
+		a->h_active == b->h_active && a->v_active == b->v_active &&
+		a->h_sync_width == b->h_sync_width &&
+		a->v_sync_width == b->v_sync_width &&
+		a->h_back_porch == b->h_back_porch &&
+		a->v_back_porch == b->v_back_porch &&
+		a->h_front_porch == b->h_front_porch &&
+		a->v_front_porch == b->v_front_porch &&
+		a->vmode == b->vmode;
+}
+
+/* Called with tegra_nvdisp_lock held */
+static void tegra_nvdisp_imp_clear_applied(void)
+{
+	dealloc_imp_settings(g_imp.applied_settings);
+	kfree(g_imp.applied_modes);
+	g_imp.applied_settings = NULL;
+	g_imp.applied_modes = NULL;
+}
+
+/*
+ * Remember @imp_settings as the ones currently programmed, together with the
+ * mode of their heads. Called with tegra_nvdisp_lock held.
+ */
+static void tegra_nvdisp_imp_save_applied(
+				struct tegra_nvdisp_imp_settings *imp_settings)
+{
+	struct tegra_nvdisp_imp_settings *copy;
+	struct tegra_dc_mode *modes;
+	int i;
+
+	tegra_nvdisp_imp_clear_applied();
+
+	modes = kcalloc(max_t(u8, imp_settings->num_heads, 1), sizeof(*modes),
+			GFP_KERNEL);
+	if (!modes)
+		return;
+
+	copy = cpy_imp_entries(imp_settings);
+	if (!copy) {
+		kfree(modes);
+		return;
+	}
+
+	for (i = 0; i < imp_settings->num_heads; i++) {
+		struct tegra_dc *other_dc;
+
+		other_dc = find_dc_by_ctrl_num(
+			imp_settings->head_settings[i].entries.ctrl_num);
+		if (!other_dc || !other_dc->enabled) {
+			/* the head has to be reprogrammed once enabled */
+			dealloc_imp_settings(copy);
+			kfree(modes);
+			return;
+		}
+
+		modes[i] = other_dc->mode;
+	}
+
+	g_imp.applied_settings = copy;
+	g_imp.applied_modes = modes;
+}
+
+/*
+ * Check whether @imp_settings are the ones already programmed, for the same
+ * head modes. Userspace commonly re-proposes the same IMP results when it
+ * switches back and forth between compositions that share them, and those
+ * flips don't need to go through the IMP sequence at all. Called with
+ * tegra_nvdisp_lock held.
+ */
+static bool tegra_nvdisp_imp_is_applied(
+				struct tegra_nvdisp_imp_settings *imp_settings)
+{
+	int i;
+
+	if (!g_imp.applied_settings ||
+		!imp_settings_equal(g_imp.applied_settings, imp_settings))
+		return false;
+
+	for (i = 0; i < imp_settings->num_heads; i++) {
+		struct tegra_dc *other_dc;
+
+		other_dc = find_dc_by_ctrl_num(
+			imp_settings->head_settings[i].entries.ctrl_num);
+		if (!other_dc || !other_dc->enabled ||
+			!imp_mode_equal(&other_dc->mode, &g_imp.applied_modes[i]))
+			return false;
+	}
+
+	return true;
+}
+
 void tegra_dc_adjust_imp(struct tegra_dc *dc, bool before_win_update)
 {
 	struct tegra_nvdisp_imp_settings *imp_settings;
@@ -3898,6 +4035,20 @@ void tegra_dc_adjust_imp(struct tegra_dc *dc, bool before_win_update)
 		return;
 	}
 
+	if (before_win_update)
+		imp_settings->unchanged =
+			tegra_nvdisp_imp_is_applied(imp_settings);
+
+	if (imp_settings->unchanged) {
+		if (!before_win_update) {
+			list_del(&imp_settings->imp_node);
+			dealloc_imp_settings(imp_settings);
+		}
+
+		mutex_unlock(&tegra_nvdisp_lock);
+		return;
+	}
+
 	/*
 	 * - The cursor and wgrp latency registers take effect immediately.
 	 *   As such, disable latency events for now and re-enable them after
@@ -3952,6 +4103,7 @@ void tegra_dc_adjust_imp(struct tegra_dc *dc, bool before_win_update)
 		 * the global queue and free the associated memory.
 		 */
 		list_del(&imp_settings->imp_node);
+		tegra_nvdisp_imp_save_applied(imp_settings);
 		dealloc_imp_settings(imp_settings);
 
 		mutex_unlock(&tegra_nvdisp_lock);
@@ -4105,7 +4257,7 @@ void tegra_nvdisp_program_imp_settings(struct tegra_dc *dc)
 		return;
 
 	imp_settings = tegra_nvdisp_get_current_imp_settings();
-	if (!imp_settings)
+	if (!imp_settings || imp_settings->unchanged)
 		return;
 
 	for (i = 0; i < imp_settings->num_heads; i++) {
@@ -4413,6 +4565,9 @@ void tegra_nvdisp_set_output_lut(struct tegra_dc *dc,
 			nvdisp_copy_output_lut(nvdisp_lut->rgb,
 				(unsigned int *)&user_nvdisp_cmu->rgb,
 				NVDISP_OUTPUT_LUT_SIZE);
+			if (dc->output_lut_buf_addr)
+				tegra_nvdisp_program_output_lut(dc,
+								nvdisp_lut);
 		}
 	} else {
 		reg_val &= ~nvdisp_color_ctl_cmu_enable_f();
@@ -4421,6 +4576,31 @@ void tegra_nvdisp_set_output_lut(struct tegra_dc *dc,
 	tegra_dc_writel(dc, reg_val, nvdisp_color_ctl_r());
 }
 
+/*
+ * Point the output LUT at a userspace buffer, or back at the driver LUT if
+ * @addr is 0. Takes effect with the next general channel activation, so a
+ * flip can switch between LUT buffers without any copy or wait here.
+ */
+void tegra_nvdisp_set_output_lut_buf(struct tegra_dc *dc, dma_addr_t addr)
+{
+	u32 reg_val;
+
+	if (!addr) {
+		if (dc->output_lut_buf_addr)
+			tegra_nvdisp_program_output_lut(dc,
+						&dc->nvdisp_postcomp_lut);
+		return;
+	}
+
+	dc->output_lut_buf_addr = addr;
+	tegra_nvdisp_program_output_lut_addr(dc, addr);
+
+	dc->cmu_enabled = true;
+	reg_val = tegra_dc_readl(dc, nvdisp_color_ctl_r());
+	tegra_dc_writel(dc, reg_val | nvdisp_color_ctl_cmu_enable_f(),
+			nvdisp_color_ctl_r());
+}
+
 void tegra_nvdisp_set_output_colorspace(struct tegra_dc *dc,
 					u16 output_colorspace)
 {
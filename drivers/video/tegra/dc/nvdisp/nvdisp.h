@@ -52,6 +52,14 @@ struct nvdisp_common_imp_data {
 	 * - dispclk
 	 */
 	bool lock_mode_enabled;
+
+	/*
+	 * Copy of the IMP settings last programmed by an IMP flip, and the
+	 * mode of each of their heads at that time. Cleared whenever a head is
+	 * enabled or disabled.
+	 */
+	struct tegra_nvdisp_imp_settings *applied_settings;
+	struct tegra_dc_mode *applied_modes;
 };
 
 int tegra_nvdisp_assign_win(struct tegra_dc *dc, unsigned idx);
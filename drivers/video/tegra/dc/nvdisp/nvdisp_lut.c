@@ -80,9 +80,18 @@ void tegra_dc_set_nvdisp_lut(struct tegra_dc *dc, struct tegra_dc_win *win)
 {
 	unsigned long val = nvdisp_win_read(win, win_options_r());
 
-	tegra_nvdisp_loop_lut(dc, win, tegra_nvdisp_set_lut_setreg_lambda);
+	if (win->lut_buf_addr) {
+		/* LUT buffer provided by userspace through a flip */
+		nvdisp_win_write(win, tegra_dc_reg_l32(win->lut_buf_addr),
+				win_input_lut_base_r());
+		nvdisp_win_write(win, tegra_dc_reg_h32(win->lut_buf_addr),
+				win_input_lut_base_hi_r());
+	} else {
+		tegra_nvdisp_loop_lut(dc, win,
+				tegra_nvdisp_set_lut_setreg_lambda);
+	}
 
-	if (win->ppflags & TEGRA_WIN_PPFLAG_CP_ENABLE)
+	if ((win->ppflags & TEGRA_WIN_PPFLAG_CP_ENABLE) || win->lut_buf_addr)
 		val |= win_options_cp_enable_enable_f();
 	else
 		val &= ~win_options_cp_enable_enable_f();
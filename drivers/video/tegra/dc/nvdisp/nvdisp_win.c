@@ -738,7 +738,7 @@ static int tegra_nvdisp_win_attribute(struct tegra_dc_win *win,
 	if ((!dc->yuv_bypass) && win->color_expand_enable)
 			win_options |= win_options_color_expand_enable_f();
 
-	if (win->ppflags & TEGRA_WIN_PPFLAG_CP_ENABLE)
+	if ((win->ppflags & TEGRA_WIN_PPFLAG_CP_ENABLE) || win->lut_buf_addr)
 		win_options |= win_options_cp_enable_enable_f();
 
 	if (dc->yuv_bypass) {
@@ -45,6 +45,8 @@ VRR_ATTR(max_adj_pct);
 VRR_ATTR(max_flip_pct);
 VRR_ATTR(max_dcb);
 VRR_ATTR(max_inc_pct);
+VRR_ATTR(pacing);
+VRR_ATTR(pacing_stats);
 
 static struct attribute *vrr_attrs[] = {
 	VRR_ATTRS_ENTRY(capability),
@@ -54,6 +56,8 @@ static struct attribute *vrr_attrs[] = {
 	VRR_ATTRS_ENTRY(max_flip_pct),
 	VRR_ATTRS_ENTRY(max_dcb),
 	VRR_ATTRS_ENTRY(max_inc_pct),
+	VRR_ATTRS_ENTRY(pacing),
+	VRR_ATTRS_ENTRY(pacing_stats),
 	NULL,
 };
 
@@ -63,6 +67,37 @@ static struct attribute_group vrr_attr_group = {
 
 static struct kobject *vrr_kobj;
 
+static ssize_t vrr_pacing_stats_show(struct tegra_vrr *vrr, char *buf)
+{
+	u32 frames = vrr->pacing_frames;
+	u64 avg = 0, var = 0;
+
+	if (frames) {
+		avg = div_u64(vrr->pacing_sum_us, frames);
+		var = div_u64(vrr->pacing_sum_sq_us, frames);
+		var = var > avg * avg ? var - avg * avg : 0;
+	}
+
+	return snprintf(buf, PAGE_SIZE,
+		"frames: %u\navg_us: %llu\nmin_us: %d\nmax_us: %d\n"
+		"stddev_us: %lu\npredicted_us: %d\n",
+		frames, avg, frames ? vrr->pacing_min_us : 0,
+		vrr->pacing_max_us, int_sqrt((unsigned long)var),
+		vrr->pacing_interval_us);
+}
+
+static void vrr_pacing_reset(struct tegra_vrr *vrr)
+{
+	vrr->pacing_interval_us = 0;
+	vrr->pacing_flip_us = 0;
+	vrr->pacing_frame_us = 0;
+	vrr->pacing_frames = 0;
+	vrr->pacing_min_us = 0;
+	vrr->pacing_max_us = 0;
+	vrr->pacing_sum_us = 0;
+	vrr->pacing_sum_sq_us = 0;
+}
+
 /* Sysfs accessors */
 static ssize_t vrr_settings_show(struct kobject *kobj,
 	struct kobj_attribute *attr, char *buf)
@@ -90,7 +125,13 @@ static ssize_t vrr_settings_show(struct kobject *kobj,
 		res = snprintf(buf, PAGE_SIZE, "%d\n", vrr->max_dcb);
 	else if (IS_VRR_ATTR(max_inc_pct))
 		res = snprintf(buf, PAGE_SIZE, "%d\n", vrr->max_inc_pct);
-	else
+	else if (IS_VRR_ATTR(pacing))
+		res = snprintf(buf, PAGE_SIZE, "%d\n", vrr->pacing);
+	else if (IS_VRR_ATTR(pacing_stats)) {
+		mutex_lock(&dc->lock);
+		res = vrr_pacing_stats_show(vrr, buf);
+		mutex_unlock(&dc->lock);
+	} else
 		res = -EINVAL;
 
 	return res;
@@ -149,7 +190,11 @@ static ssize_t vrr_settings_store(struct kobject *kobj,
 		vrr_check_and_update(0, 50000, max_dcb)
 	else if (IS_VRR_ATTR(max_inc_pct))
 		vrr_check_and_update(0, 100, max_inc_pct)
-	else
+	else if (IS_VRR_ATTR(pacing)) {
+		/* writing either value also clears the statistics */
+		vrr_check_and_update(0, 1, pacing)
+		vrr_pacing_reset(vrr);
+	} else
 		res = -EINVAL;
 
 	mutex_unlock(&dc->lock);
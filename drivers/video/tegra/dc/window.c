@@ -33,6 +33,65 @@
 
 int no_vsync;
 
+/*
+ * Groups of window registers that only need writing when the fields of
+ * struct tegra_dc_win they are computed from change. The window header,
+ * options and CSC are written on every update.
+ */
+#define WIN_DIRTY_FMT		BIT(0)	/* color depth, byte swap */
+#define WIN_DIRTY_POSITION	BIT(1)	/* position, size */
+#define WIN_DIRTY_SCALING	BIT(2)	/* prescaled size, DDA */
+#define WIN_DIRTY_ADDR		BIT(3)	/* surface addresses, offsets, stride */
+#define WIN_DIRTY_SURFACE	BIT(4)	/* tiling, surface kind */
+#define WIN_DIRTY_CDE		BIT(5)	/* compression */
+#define WIN_DIRTY_ALPHA		BIT(6)	/* gen1 global alpha */
+#define WIN_DIRTY_ALL		(BIT(7) - 1)
+
+static u32 tegra_dc_win_dirty_fields(struct tegra_dc *dc,
+	const struct tegra_dc_win *old, const struct tegra_dc_win *win)
+{
+	bool src = (old->x.full != win->x.full) ||
+		(old->y.full != win->y.full) ||
+		(old->w.full != win->w.full) ||
+		(old->h.full != win->h.full);
+	u32 dirty = 0;
+
+	if (!test_bit(win->idx, &dc->win_regs_valid))
+		return WIN_DIRTY_ALL;
+
+	/* bytes per pixel and flags feed into almost everything */
+	if ((old->fmt != win->fmt) || (old->flags != win->flags))
+		return WIN_DIRTY_ALL;
+
+	if ((old->out_x != win->out_x) || (old->out_y != win->out_y) ||
+	    (old->out_w != win->out_w) || (old->out_h != win->out_h))
+		dirty |= WIN_DIRTY_POSITION | WIN_DIRTY_SCALING;
+
+	if (src)
+		dirty |= WIN_DIRTY_SCALING | WIN_DIRTY_ADDR;
+
+	if ((old->phys_addr != win->phys_addr) ||
+	    (old->phys_addr_u != win->phys_addr_u) ||
+	    (old->phys_addr_v != win->phys_addr_v) ||
+	    (old->phys_addr2 != win->phys_addr2) ||
+	    (old->phys_addr_u2 != win->phys_addr_u2) ||
+	    (old->phys_addr_v2 != win->phys_addr_v2) ||
+	    (old->stride != win->stride) ||
+	    (old->stride_uv != win->stride_uv))
+		dirty |= WIN_DIRTY_ADDR;
+
+	if (old->block_height_log2 != win->block_height_log2)
+		dirty |= WIN_DIRTY_SURFACE;
+
+	if (memcmp(&old->cde, &win->cde, sizeof(win->cde)))
+		dirty |= WIN_DIRTY_CDE;
+
+	if (old->global_alpha != win->global_alpha)
+		dirty |= WIN_DIRTY_ALPHA;
+
+	return dirty;
+}
+
 module_param_named(no_vsync, no_vsync, int, 0644);
 
 static bool tegra_dc_windows_are_clean(struct tegra_dc_win *windows[],
@@ -521,6 +580,59 @@ static void tegra_dc_vrr_flip_time(struct tegra_dc *dc)
 	}
 }
 
+/*
+ * Predictive pacing: instead of ending the extended frame as soon as a flip
+ * arrives, end it once the predicted flip interval has passed since the
+ * frame started. Flips that come in early are held back to the usual
+ * cadence while late ones are still shown right away, which evens out the
+ * frame times of content with uneven render times. Returns the VFP to
+ * program, or the nominal one when there is no usable prediction.
+ */
+static int tegra_dc_vrr_pace_flip(struct tegra_dc *dc)
+{
+	struct tegra_vrr *vrr  = dc->out->vrr;
+	struct tegra_dc_mode *m = &dc->mode;
+	s64 now_us = ktime_to_us(ktime_get());
+	s32 min_us = (s32)div_s64(dc->frametime_ns, NSEC_PER_USEC);
+	s32 line_width, lines, interval_us;
+	s32 max_us;
+	int vfp;
+
+	line_width = m->h_sync_width + m->h_back_porch +
+			m->h_active + m->h_front_porch;
+	lines = m->v_sync_width + m->v_back_porch + m->v_active;
+	if (!line_width || !m->pclk)
+		return m->v_front_porch;
+
+	max_us = (s32)div_s64((s64)line_width *
+			(lines + MAX_VRR_V_FRONT_PORCH) * USEC_PER_SEC,
+			m->pclk);
+
+	interval_us = vrr->pacing_flip_us ?
+			(s32)(now_us - vrr->pacing_flip_us) : 0;
+	vrr->pacing_flip_us = now_us;
+
+	/* Content paused or just started, start predicting over */
+	if (interval_us <= 0 || interval_us > max_us) {
+		vrr->pacing_interval_us = 0;
+		return m->v_front_porch;
+	}
+
+	if (!vrr->pacing_interval_us)
+		vrr->pacing_interval_us = interval_us;
+	else
+		vrr->pacing_interval_us += (interval_us -
+					vrr->pacing_interval_us) / 8;
+	vrr->pacing_interval_us = clamp(vrr->pacing_interval_us,
+					min_us, max_us);
+
+	/* Frame length of the predicted interval, from the frame start */
+	vfp = (int)div_s64((s64)vrr->pacing_interval_us * m->pclk,
+			(s64)line_width * USEC_PER_SEC) - lines;
+
+	return clamp(vfp, m->v_front_porch, MAX_VRR_V_FRONT_PORCH);
+}
+
 static void tegra_dc_vrr_cancel_vfp(struct tegra_dc *dc)
 {
 	struct tegra_vrr *vrr  = dc->out->vrr;
@@ -531,6 +643,8 @@ static void tegra_dc_vrr_cancel_vfp(struct tegra_dc *dc)
 	if (vrr->enable) {
 		if (dc->out->type == TEGRA_DC_OUT_DSI)
 			tegra_dc_set_act_vfp(dc, vrr->vfp_shrink);
+		else if (vrr->pacing)
+			tegra_dc_set_act_vfp(dc, tegra_dc_vrr_pace_flip(dc));
 		else
 			tegra_dc_set_act_vfp(dc, dc->mode.v_front_porch);
 	} else {
@@ -552,6 +666,130 @@ static void tegra_dc_vrr_cancel_vfp(struct tegra_dc *dc)
 	}
 }
 
+static void tegra_dc_win_program_addr(struct tegra_dc *dc,
+	struct tegra_dc_win *win, unsigned Bpp, bool invert_h, bool invert_v)
+{
+	bool yuvp = tegra_dc_is_yuv_planar(win->fmt);
+	bool yuvsp = tegra_dc_is_yuv_semi_planar(win->fmt);
+	fixed20_12 h_offset, v_offset;
+
+	tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr),
+		DC_WINBUF_START_ADDR);
+	tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr),
+		DC_WINBUF_START_ADDR_HI);
+	if (!yuvp && !yuvsp) {
+		tegra_dc_writel(dc, win->stride, DC_WIN_LINE_STRIDE);
+	} else if (yuvp) {
+		tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u),
+			DC_WINBUF_START_ADDR_U);
+		tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u),
+			DC_WINBUF_START_ADDR_HI_U);
+		tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_v),
+			DC_WINBUF_START_ADDR_V);
+		tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_v),
+			DC_WINBUF_START_ADDR_HI_V);
+		tegra_dc_writel(dc,
+			LINE_STRIDE(win->stride) |
+			UV_LINE_STRIDE(win->stride_uv),
+			DC_WIN_LINE_STRIDE);
+	} else {
+		tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u),
+			DC_WINBUF_START_ADDR_U);
+		tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u),
+			DC_WINBUF_START_ADDR_HI_U);
+		tegra_dc_writel(dc,
+			LINE_STRIDE(win->stride) |
+			UV_LINE_STRIDE(win->stride_uv),
+			DC_WIN_LINE_STRIDE);
+	}
+
+	if (invert_h) {
+		h_offset.full = win->x.full + win->w.full;
+		h_offset.full = dfixed_floor(h_offset) * Bpp;
+		h_offset.full -= dfixed_const(1);
+	} else {
+		h_offset.full = dfixed_floor(win->x) * Bpp;
+	}
+
+	v_offset = win->y;
+	if (invert_v)
+		v_offset.full += win->h.full - dfixed_const(1);
+
+	tegra_dc_writel(dc, dfixed_trunc(h_offset),
+			DC_WINBUF_ADDR_H_OFFSET);
+	tegra_dc_writel(dc, dfixed_trunc(v_offset),
+			DC_WINBUF_ADDR_V_OFFSET);
+
+	if ((tegra_dc_feature_has_interlace(dc, win->idx)) &&
+	    (dc->mode.vmode == FB_VMODE_INTERLACED)) {
+		tegra_dc_writel(dc, win->phys_addr2,
+				DC_WINBUF_START_ADDR_FIELD2);
+		if (yuvp) {
+			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u2),
+				DC_WINBUF_START_ADDR_FIELD2_U);
+			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u2),
+				DC_WINBUF_START_ADDR_FIELD2_HI_U);
+
+			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_v2),
+				DC_WINBUF_START_ADDR_FIELD2_V);
+			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_v2),
+				DC_WINBUF_START_ADDR_FIELD2_HI_V);
+		} else if (yuvsp) {
+			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u2),
+				DC_WINBUF_START_ADDR_FIELD2_U);
+			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u2),
+				DC_WINBUF_START_ADDR_FIELD2_HI_U);
+		}
+		tegra_dc_writel(dc, dfixed_trunc(h_offset),
+			DC_WINBUF_ADDR_H_OFFSET_FIELD2);
+
+		if (WIN_IS_INTERLACE(win)) {
+			tegra_dc_writel(dc, dfixed_trunc(v_offset),
+					DC_WINBUF_ADDR_V_OFFSET_FIELD2);
+		} else {
+			v_offset.full += dfixed_const(1);
+			tegra_dc_writel(dc, dfixed_trunc(v_offset),
+					DC_WINBUF_ADDR_V_OFFSET_FIELD2);
+		}
+	}
+}
+
+static void tegra_dc_win_program_surface(struct tegra_dc *dc,
+	struct tegra_dc_win *win)
+{
+	if (tegra_dc_feature_has_tiling(dc, win->idx)) {
+		if (WIN_IS_TILED(win))
+			tegra_dc_writel(dc,
+				DC_WIN_BUFFER_ADDR_MODE_TILE |
+				DC_WIN_BUFFER_ADDR_MODE_TILE_UV,
+				DC_WIN_BUFFER_ADDR_MODE);
+		else
+			tegra_dc_writel(dc,
+				DC_WIN_BUFFER_ADDR_MODE_LINEAR |
+				DC_WIN_BUFFER_ADDR_MODE_LINEAR_UV,
+				DC_WIN_BUFFER_ADDR_MODE);
+	}
+
+	if (tegra_dc_feature_has_blocklinear(dc, win->idx) ||
+		tegra_dc_feature_has_tiling(dc, win->idx)) {
+		if (WIN_IS_BLOCKLINEAR(win)) {
+			tegra_dc_writel(dc,
+				DC_WIN_BUFFER_SURFACE_BL_16B2 |
+				(win->block_height_log2
+					<< BLOCK_HEIGHT_SHIFT),
+				DC_WIN_BUFFER_SURFACE_KIND);
+		} else if (WIN_IS_TILED(win)) {
+			tegra_dc_writel(dc,
+				DC_WIN_BUFFER_SURFACE_TILED,
+				DC_WIN_BUFFER_SURFACE_KIND);
+		} else {
+			tegra_dc_writel(dc,
+				DC_WIN_BUFFER_SURFACE_PITCH,
+				DC_WIN_BUFFER_SURFACE_KIND);
+		}
+	}
+}
+
 /* Program registers for each window. struct tegra_dc_win --> Assembly registers
  */
 static int _tegra_dc_program_windows(struct tegra_dc *dc,
@@ -570,6 +808,7 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 	unsigned int width;
 	unsigned int height;
 	enum tegra_revision rev;
+	u32 win_dirty[DC_N_WINDOWS];
 
 	if (dirty_rect) {
 		xoff = dirty_rect[0];
@@ -584,6 +823,9 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 				DC_DISP_DISP_ACTIVE);
 
 			dc->disp_active_dirty = true;
+
+			/* windows are cropped to the dirty rectangle */
+			dc->win_regs_valid = 0;
 		}
 	}
 
@@ -598,6 +840,9 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 					  win)) || do_partial_update)
 			wait_for_vblank = 1;
 
+		win_dirty[win->idx] = tegra_dc_win_dirty_fields(dc,
+				&dc->shadow_windows[win->idx], win);
+
 		memcpy(&dc->shadow_windows[win->idx], win,
 		       sizeof(struct tegra_dc_win));
 	}
@@ -606,7 +851,6 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 		struct tegra_dc_win *win = windows[i];
 		struct tegra_dc_win *dc_win = tegra_dc_get_window(dc, win->idx);
 		bool scan_column = 0;
-		fixed20_12 h_offset, v_offset;
 		bool invert_h = (win->flags & TEGRA_WIN_FLAG_INVERT_H) != 0;
 		bool invert_v = (win->flags & TEGRA_WIN_FLAG_INVERT_V) != 0;
 		bool yuv = tegra_dc_is_yuv(win->fmt);
@@ -618,6 +862,7 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 		bool filter_h;
 		bool filter_v;
 		u32 color = DISP_BLEND_BACKGROUND_COLOR_DEFAULT;
+		u32 dirty = win_dirty[win->idx];
 
 		scan_column = (win->flags & TEGRA_WIN_FLAG_SCAN_COLUMN);
 
@@ -642,6 +887,7 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 					color = RGB_TO_YUV444_8BPC_BLACK_PIX;
 				tegra_dc_set_background_color(dc, color);
 			}
+			clear_bit(win->idx, &dc->win_regs_valid);
 			continue;
 
 		}
@@ -672,7 +918,9 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 		else
 			act_control |= WIN_ACT_CNTR_SEL_HCOUNTER(win->idx);
 
-		if (win->cde.cde_addr) {
+		if (!(dirty & WIN_DIRTY_CDE)) {
+			/* unchanged */
+		} else if (win->cde.cde_addr) {
 			tegra_dc_writel(dc, ENABLESURFACE0,
 				DC_WINBUF_CDE_CONTROL);
 			tegra_dc_writel(dc, tegra_dc_reg_l32(win->cde.cde_addr),
@@ -704,27 +952,32 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 				DC_WINBUF_CDE_CG_SW_OVR);
 		}
 
-		tegra_dc_writel(dc, tegra_dc_fmt(win->fmt),
-			DC_WIN_COLOR_DEPTH);
-		tegra_dc_writel(dc, tegra_dc_fmt_byteorder(win->fmt),
-			DC_WIN_BYTE_SWAP);
+		if (dirty & WIN_DIRTY_FMT) {
+			tegra_dc_writel(dc, tegra_dc_fmt(win->fmt),
+				DC_WIN_COLOR_DEPTH);
+			tegra_dc_writel(dc, tegra_dc_fmt_byteorder(win->fmt),
+				DC_WIN_BYTE_SWAP);
+		}
 
 
 		if (do_partial_update)
 			tegra_dc_win_partial_update(dc, win, xoff, yoff,
 				width, height);
 
-		tegra_dc_writel(dc,
-			V_POSITION(win->out_y) | H_POSITION(win->out_x),
-			DC_WIN_POSITION);
-
-		if (tegra_dc_feature_has_interlace(dc, win->idx) &&
+		if (!(dirty & WIN_DIRTY_POSITION)) {
+			/* unchanged */
+		} else if (tegra_dc_feature_has_interlace(dc, win->idx) &&
 			(dc->mode.vmode == FB_VMODE_INTERLACED)) {
-				tegra_dc_writel(dc,
-					V_SIZE((win->out_h) >> 1) |
-					H_SIZE(win->out_w),
-					DC_WIN_SIZE);
+			tegra_dc_writel(dc,
+				V_POSITION(win->out_y) | H_POSITION(win->out_x),
+				DC_WIN_POSITION);
+			tegra_dc_writel(dc,
+				V_SIZE((win->out_h) >> 1) | H_SIZE(win->out_w),
+				DC_WIN_SIZE);
 		} else {
+			tegra_dc_writel(dc,
+				V_POSITION(win->out_y) | H_POSITION(win->out_x),
+				DC_WIN_POSITION);
 			tegra_dc_writel(dc,
 				V_SIZE(win->out_h) | H_SIZE(win->out_w),
 				DC_WIN_SIZE);
@@ -738,126 +991,22 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 		win_options |= V_FILTER_ENABLE(filter_v);
 
 		/* Update scaling registers if window supports scaling. */
-		if (likely(tegra_dc_feature_has_scaling(dc, win->idx)))
+		if (likely(tegra_dc_feature_has_scaling(dc, win->idx)) &&
+		    (dirty & WIN_DIRTY_SCALING))
 			tegra_dc_update_scaling(dc, win, Bpp, Bpp_bw,
 								scan_column);
 
-		tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr),
-			DC_WINBUF_START_ADDR);
-		tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr),
-			DC_WINBUF_START_ADDR_HI);
-		if (!yuvp && !yuvsp) {
-			tegra_dc_writel(dc, win->stride, DC_WIN_LINE_STRIDE);
-		} else if (yuvp) {
-			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u),
-				DC_WINBUF_START_ADDR_U);
-			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u),
-				DC_WINBUF_START_ADDR_HI_U);
-			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_v),
-				DC_WINBUF_START_ADDR_V);
-			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_v),
-				DC_WINBUF_START_ADDR_HI_V);
-			tegra_dc_writel(dc,
-				LINE_STRIDE(win->stride) |
-				UV_LINE_STRIDE(win->stride_uv),
-				DC_WIN_LINE_STRIDE);
-		} else {
-			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u),
-				DC_WINBUF_START_ADDR_U);
-			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u),
-				DC_WINBUF_START_ADDR_HI_U);
-			tegra_dc_writel(dc,
-					LINE_STRIDE(win->stride) |
-					UV_LINE_STRIDE(win->stride_uv),
-					DC_WIN_LINE_STRIDE);
-		}
-
-		if (invert_h) {
-			h_offset.full = win->x.full + win->w.full;
-			h_offset.full = dfixed_floor(h_offset) * Bpp;
-			h_offset.full -= dfixed_const(1);
-		} else {
-			h_offset.full = dfixed_floor(win->x) * Bpp;
-		}
-
-		v_offset = win->y;
-		if (invert_v)
-			v_offset.full += win->h.full - dfixed_const(1);
-
-		tegra_dc_writel(dc, dfixed_trunc(h_offset),
-				DC_WINBUF_ADDR_H_OFFSET);
-		tegra_dc_writel(dc, dfixed_trunc(v_offset),
-				DC_WINBUF_ADDR_V_OFFSET);
-
-	if ((dc->mode.vmode == FB_VMODE_INTERLACED) && WIN_IS_FB(win)) {
-		if (!WIN_IS_INTERLACE(win))
-			win->phys_addr2 = win->phys_addr;
-	}
-
-	if ((tegra_dc_feature_has_interlace(dc, win->idx)) &&
-	    (dc->mode.vmode == FB_VMODE_INTERLACED)) {
-		tegra_dc_writel(dc, win->phys_addr2,
-				DC_WINBUF_START_ADDR_FIELD2);
-		if (yuvp) {
-			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u2),
-				DC_WINBUF_START_ADDR_FIELD2_U);
-			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u2),
-				DC_WINBUF_START_ADDR_FIELD2_HI_U);
-
-			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_v2),
-				DC_WINBUF_START_ADDR_FIELD2_V);
-			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_v2),
-				DC_WINBUF_START_ADDR_FIELD2_HI_V);
-		} else if (yuvsp) {
-			tegra_dc_writel(dc, tegra_dc_reg_l32(win->phys_addr_u2),
-				DC_WINBUF_START_ADDR_FIELD2_U);
-			tegra_dc_writel(dc, tegra_dc_reg_h32(win->phys_addr_u2),
-				DC_WINBUF_START_ADDR_FIELD2_HI_U);
-		}
-		tegra_dc_writel(dc, dfixed_trunc(h_offset),
-			DC_WINBUF_ADDR_H_OFFSET_FIELD2);
-
-		if (WIN_IS_INTERLACE(win)) {
-			tegra_dc_writel(dc, dfixed_trunc(v_offset),
-					DC_WINBUF_ADDR_V_OFFSET_FIELD2);
-		} else {
-			v_offset.full += dfixed_const(1);
-			tegra_dc_writel(dc, dfixed_trunc(v_offset),
-					DC_WINBUF_ADDR_V_OFFSET_FIELD2);
+		if ((dc->mode.vmode == FB_VMODE_INTERLACED) && WIN_IS_FB(win)) {
+			if (!WIN_IS_INTERLACE(win))
+				win->phys_addr2 = win->phys_addr;
 		}
-	}
 
-		if (tegra_dc_feature_has_tiling(dc, win->idx)) {
-			if (WIN_IS_TILED(win))
-				tegra_dc_writel(dc,
-					DC_WIN_BUFFER_ADDR_MODE_TILE |
-					DC_WIN_BUFFER_ADDR_MODE_TILE_UV,
-					DC_WIN_BUFFER_ADDR_MODE);
-			else
-				tegra_dc_writel(dc,
-					DC_WIN_BUFFER_ADDR_MODE_LINEAR |
-					DC_WIN_BUFFER_ADDR_MODE_LINEAR_UV,
-					DC_WIN_BUFFER_ADDR_MODE);
-		}
+		if (dirty & WIN_DIRTY_ADDR)
+			tegra_dc_win_program_addr(dc, win, Bpp, invert_h,
+				invert_v);
 
-		if (tegra_dc_feature_has_blocklinear(dc, win->idx) ||
-			tegra_dc_feature_has_tiling(dc, win->idx)) {
-				if (WIN_IS_BLOCKLINEAR(win)) {
-					tegra_dc_writel(dc,
-						DC_WIN_BUFFER_SURFACE_BL_16B2 |
-						(win->block_height_log2
-							<< BLOCK_HEIGHT_SHIFT),
-						DC_WIN_BUFFER_SURFACE_KIND);
-				} else if (WIN_IS_TILED(win)) {
-					tegra_dc_writel(dc,
-						DC_WIN_BUFFER_SURFACE_TILED,
-						DC_WIN_BUFFER_SURFACE_KIND);
-				} else {
-					tegra_dc_writel(dc,
-						DC_WIN_BUFFER_SURFACE_PITCH,
-						DC_WIN_BUFFER_SURFACE_KIND);
-				}
-		}
+		if (dirty & WIN_DIRTY_SURFACE)
+			tegra_dc_win_program_surface(dc, win);
 
 		if (yuv)
 			win_options |= CSC_ENABLE;
@@ -878,10 +1027,14 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 		if (!tegra_dc_feature_is_gen2_blender(dc, win->idx)) {
 			/* Update global alpha if blender is gen1. */
 			if (win->global_alpha == 255) {
-				tegra_dc_writel(dc, 0, DC_WIN_GLOBAL_ALPHA);
+				if (dirty & WIN_DIRTY_ALPHA)
+					tegra_dc_writel(dc, 0,
+						DC_WIN_GLOBAL_ALPHA);
 			} else {
-				tegra_dc_writel(dc, GLOBAL_ALPHA_ENABLE |
-					win->global_alpha, DC_WIN_GLOBAL_ALPHA);
+				if (dirty & WIN_DIRTY_ALPHA)
+					tegra_dc_writel(dc, GLOBAL_ALPHA_ENABLE |
+						win->global_alpha,
+						DC_WIN_GLOBAL_ALPHA);
 				win_options |= CP_ENABLE;
 			}
 		}
@@ -905,6 +1058,9 @@ static int _tegra_dc_program_windows(struct tegra_dc *dc,
 
 		tegra_dc_writel(dc, win_options, DC_WIN_WIN_OPTIONS);
 
+		if (!do_partial_update)
+			set_bit(win->idx, &dc->win_regs_valid);
+
 		dc_win->dirty = 1;
 
 		trace_window_update(dc, win);
@@ -31,6 +31,9 @@
 #include <soc/tegra/chip-id.h>
 #include <linux/anon_inodes.h>
 #include <linux/crc32.h>
+#include <linux/completion.h>
+#include <linux/moduleparam.h>
+#include <linux/seq_file.h>
 
 #include <trace/events/nvhost.h>
 #include <uapi/linux/nvhost_events.h>
@@ -242,6 +245,7 @@ struct nvhost_channel_userctx {
 	u32 timeout;
 	int clientid;
 	bool timeout_debug_dump;
+	u32 priority;
 	struct platform_device *pdev;
 	u32 syncpts[NVHOST_MODULE_MAX_SYNCPTS];
 	u32 client_managed_syncpt;
@@ -255,6 +259,9 @@ struct nvhost_channel_userctx {
 
 	/* used for attaching to ctx list in device pdata */
 	struct list_head node;
+
+	/* engine time used by this client */
+	struct nvhost_client_usage *usage;
 };
 
 static int nvhost_channelrelease(struct inode *inode, struct file *filp)
@@ -314,6 +321,7 @@ static int nvhost_channelrelease(struct inode *inode, struct file *filp)
 	if (pdata->keepalive)
 		nvhost_module_idle(priv->pdev);
 
+	nvhost_client_usage_put(priv->usage);
 	kfree(priv);
 	return 0;
 }
@@ -410,12 +418,19 @@ static int __nvhost_channelopen(struct inode *inode,
 	/* Initialize private structure */
 	priv->timeout = host1x_pdata->nvhost_timeout_default;
 	priv->timeout_debug_dump = true;
+	priv->priority = NVHOST_PRIORITY_MEDIUM;
 	mutex_init(&priv->ioctl_lock);
 	priv->pdev = pdev;
 
 	if (!tegra_platform_is_silicon())
 		priv->timeout = 0;
 
+	priv->usage = nvhost_client_usage_alloc(pdev, priv->clientid);
+	if (!priv->usage) {
+		ret = -ENOMEM;
+		goto fail_alloc_usage;
+	}
+
 	/* if we run in map-at-submit mode but device has override
 	 * flag set, respect the override flag */
 	if (pdata->resource_policy == RESOURCE_PER_DEVICE) {
@@ -438,6 +453,8 @@ static int __nvhost_channelopen(struct inode *inode,
 	return 0;
 
 fail_get_channel:
+	nvhost_client_usage_put(priv->usage);
+fail_alloc_usage:
 fail_virt_clientid:
 	if (pdata->keepalive)
 		nvhost_module_idle(pdev);
@@ -781,14 +798,19 @@ static int submit_deliver_fences(struct nvhost_submit_args *args,
 	return 0;
 }
 
-static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
-		struct nvhost_submit_args *args)
+/*
+ * Build and pin a job from one set of submit arguments. The caller must hold
+ * the module busy. On failure the job is released.
+ */
+static int submit_prepare_job(struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_args *args, struct nvhost_job **out)
 {
 	struct nvhost_job *job;
 	struct nvhost_waitchk __user *waitchks =
 		(struct nvhost_waitchk __user *)(uintptr_t)args->waitchks;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
 
+	u64 submit_ts = arch_counter_get_cntvct();
 	int err;
 
 	if ((args->num_syncpt_incrs < 1) || (args->num_syncpt_incrs >
@@ -827,6 +849,8 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 	err = submit_copy_relocs(args, job);
 	if (err)
 		goto put_job;
+	job->relocs_unchanged =
+		!!(args->flags & BIT(NVHOST_SUBMIT_FLAG_RELOCS_UNCHANGED));
 
 	job->num_waitchk = args->num_waitchks;
 	err = copy_from_user(job->waitchk,
@@ -848,47 +872,224 @@ static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
 		job->sp[0].id,
 		job->sp[0].incrs);
 
-	err = nvhost_module_busy(ctx->pdev);
-	if (err)
-		goto put_job;
-
 	err = nvhost_job_pin(job, &nvhost_get_host(ctx->pdev)->syncpt);
-	nvhost_module_idle(ctx->pdev);
 	if (err)
 		goto put_job;
 
+	job->stage_ts.submit = submit_ts;
+	job->stage_ts.pinned = arch_counter_get_cntvct();
+
 	if (args->timeout)
 		job->timeout = min(ctx->timeout, args->timeout);
 	else
 		job->timeout = ctx->timeout;
 	job->timeout_debug_dump = ctx->timeout_debug_dump;
+	job->priority = ctx->priority;
+	job->usage = ctx->usage;
+	nvhost_client_usage_get(job->usage);
+
+	*out = job;
+
+	return 0;
+
+put_job:
+	nvhost_job_put(job);
+
+	return err;
+}
+
+/*
+ * Hand a pinned job to the channel and deliver its fences. The job
+ * reference is consumed.
+ */
+static int submit_commit_job(struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_args *args, struct nvhost_job *job)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
+	int err;
 
 	err = nvhost_channel_submit(job);
-	if (err)
-		goto unpin_job;
+	if (err) {
+		nvhost_job_unpin(job);
+		goto put_job;
+	}
 
 	nvhost_eventlib_log_submit(ctx->pdev, job->sp[0].id,
 			pdata->push_work_done ? (job->sp[0].fence - 1) :
 			job->sp[0].fence, arch_counter_get_cntvct());
 
 	err = submit_deliver_fences(args, job, ctx);
-	if (err)
-		goto put_job;
 
+put_job:
 	nvhost_job_put(job);
 
-	return 0;
+	return err;
+}
 
-unpin_job:
-	nvhost_job_unpin(job);
-put_job:
-	nvhost_job_put(job);
+static int nvhost_ioctl_channel_submit(struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_args *args)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
+	struct nvhost_job *job;
+	int err;
 
+	err = nvhost_module_busy(ctx->pdev);
+	if (err)
+		goto fail;
+
+	err = submit_prepare_job(ctx, args, &job);
+	nvhost_module_idle(ctx->pdev);
+	if (err)
+		goto fail;
+
+	err = submit_commit_job(ctx, args, job);
+	if (err)
+		goto fail;
+
+	return 0;
+
+fail:
 	nvhost_err(&pdata->pdev->dev, "failed with err %d", err);
 
 	return err;
 }
 
+/*
+ * Create one sync fence covering a whole batch. Jobs on a channel may use
+ * different syncpoints; nvhost_sync_create_fence() keeps the last threshold
+ * of each.
+ */
+static int submit_batch_fence(struct nvhost_channel_userctx *ctx,
+		struct nvhost_job **jobs, u32 num_jobs, u32 *fence_fd)
+{
+	struct nvhost_ctrl_sync_fence_info *pts;
+	u32 num_pts = 0, i, j;
+	int err;
+
+	pts = kcalloc(num_jobs * NVHOST_SUBMIT_MAX_NUM_SYNCPT_INCRS,
+		      sizeof(*pts), GFP_KERNEL);
+	if (!pts)
+		return -ENOMEM;
+
+	for (i = 0; i < num_jobs; i++) {
+		for (j = 0; j < jobs[i]->num_syncpts; j++) {
+			pts[num_pts].id = jobs[i]->sp[j].id;
+			pts[num_pts++].thresh = get_job_fence(jobs[i], j);
+		}
+	}
+
+	err = nvhost_sync_create_fence_fd(ctx->pdev, pts, num_pts,
+					  "fence", fence_fd);
+	kfree(pts);
+
+	return err;
+}
+
+/*
+ * Submit a batch of jobs. All jobs are built and pinned up front under one
+ * module busy reference, and only handed to the channel once the whole
+ * batch is ready, so they reach the submit ring back to back.
+ */
+static int nvhost_ioctl_channel_submit_batch(
+		struct nvhost_channel_userctx *ctx,
+		struct nvhost_submit_batch_args *batch)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(ctx->pdev);
+	struct nvhost_submit_args __user *user_args =
+		(struct nvhost_submit_args __user *)(uintptr_t)batch->submits;
+	struct nvhost_submit_args *args;
+	struct nvhost_job **jobs;
+	u32 num = batch->num_submits, prepared = 0, i;
+	int err;
+
+	batch->num_submitted = 0;
+
+	if (!num || num > NVHOST_SUBMIT_BATCH_MAX) {
+		nvhost_err(&pdata->pdev->dev,
+			   "invalid num_submits=%u", num);
+		return -EINVAL;
+	}
+
+	args = kcalloc(num, sizeof(*args), GFP_KERNEL);
+	jobs = kcalloc(num, sizeof(*jobs), GFP_KERNEL);
+	if (!args || !jobs) {
+		err = -ENOMEM;
+		goto free;
+	}
+
+	if (copy_from_user(args, user_args, num * sizeof(*args))) {
+		nvhost_err(&pdata->pdev->dev,
+			   "failed to copy user input: submits=%px num_submits=%u",
+			   user_args, num);
+		err = -EFAULT;
+		goto free;
+	}
+
+	err = nvhost_module_busy(ctx->pdev);
+	if (err)
+		goto free;
+
+	for (prepared = 0; prepared < num; prepared++) {
+		err = submit_prepare_job(ctx, &args[prepared],
+					 &jobs[prepared]);
+		if (err)
+			break;
+	}
+	nvhost_module_idle(ctx->pdev);
+	if (err)
+		goto release;
+
+	for (i = 0; i < num; i++) {
+		err = nvhost_channel_submit(jobs[i]);
+		if (err)
+			break;
+
+		nvhost_eventlib_log_submit(ctx->pdev, jobs[i]->sp[0].id,
+				get_job_fence(jobs[i], 0),
+				arch_counter_get_cntvct());
+		batch->num_submitted++;
+	}
+
+	/* jobs that never reached the channel are released unsubmitted */
+	for (prepared = i; prepared < num; prepared++) {
+		nvhost_job_unpin(jobs[prepared]);
+		nvhost_job_put(jobs[prepared]);
+	}
+
+	for (i = 0; i < batch->num_submitted; i++) {
+		int ret = submit_deliver_fences(&args[i], jobs[i], ctx);
+
+		if (ret && !err)
+			err = ret;
+	}
+
+	if (!err && (batch->flags & BIT(NVHOST_SUBMIT_BATCH_FLAG_SYNC_FENCE_FD)))
+		err = submit_batch_fence(ctx, jobs, batch->num_submitted,
+					 &batch->fence);
+
+	if (copy_to_user(user_args, args,
+			 batch->num_submitted * sizeof(*args)) && !err)
+		err = -EFAULT;
+
+	for (i = 0; i < batch->num_submitted; i++)
+		nvhost_job_put(jobs[i]);
+	goto free;
+
+release:
+	for (i = 0; i < prepared; i++) {
+		nvhost_job_unpin(jobs[i]);
+		nvhost_job_put(jobs[i]);
+	}
+free:
+	kfree(jobs);
+	kfree(args);
+
+	if (err)
+		nvhost_err(&pdata->pdev->dev, "failed with err %d", err);
+
+	return err;
+}
+
 static int moduleid_to_index(struct platform_device *dev, u32 moduleid)
 {
 	int i;
@@ -1409,9 +1610,35 @@ static long nvhost_channelctl(struct file *filp,
 		((struct nvhost_get_param_args *)buf)->value = false;
 		break;
 	case NVHOST_IOCTL_CHANNEL_SET_PRIORITY:
-		nvhost_err(dev, "SET_PRIORITY not supported");
-		err = -EINVAL;
+	{
+		u32 priority =
+			((struct nvhost_set_priority_args *)buf)->priority;
+
+		if (priority != NVHOST_PRIORITY_LOW &&
+		    priority != NVHOST_PRIORITY_MEDIUM &&
+		    priority != NVHOST_PRIORITY_HIGH) {
+			nvhost_err(dev, "invalid priority %u", priority);
+			err = -EINVAL;
+			break;
+		}
+
+		priv->priority = priority;
+		break;
+	}
+	case NVHOST_IOCTL_CHANNEL_GET_CLIENT_USAGE:
+	{
+		struct nvhost_client_usage_args *args =
+			(struct nvhost_client_usage_args *)buf;
+		struct nvhost_device_data *pdata =
+			platform_get_drvdata(priv->pdev);
+
+		spin_lock(&pdata->client_usage_lock);
+		args->busy_ns = priv->usage->busy_ns;
+		args->num_jobs = priv->usage->num_jobs;
+		args->device_busy_ns = pdata->busy_ns;
+		spin_unlock(&pdata->client_usage_lock);
 		break;
+	}
 	case NVHOST32_IOCTL_CHANNEL_MODULE_REGRDWR:
 	{
 		struct nvhost32_ctrl_module_regrdwr_args *args32 =
@@ -1461,7 +1688,8 @@ static long nvhost_channelctl(struct file *filp,
 		args.fences = args32->fences;
 
 		/* first, get a channel */
-		err = nvhost_channel_map(pdata, &priv->ch, identifier);
+		err = nvhost_channel_map_with_prio(pdata, &priv->ch,
+						     identifier, priv->priority);
 		if (err)
 			break;
 
@@ -1508,7 +1736,8 @@ static long nvhost_channelctl(struct file *filp,
 			identifier = (void *)priv;
 
 		/* first, get a channel */
-		err = nvhost_channel_map(pdata, &priv->ch, identifier);
+		err = nvhost_channel_map_with_prio(pdata, &priv->ch,
+						     identifier, priv->priority);
 		if (err)
 			break;
 
@@ -1540,6 +1769,37 @@ static long nvhost_channelctl(struct file *filp,
 
 		break;
 	}
+	case NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH:
+	{
+		struct nvhost_device_data *pdata =
+			platform_get_drvdata(priv->pdev);
+		void *identifier;
+
+		if (pdata->resource_policy == RESOURCE_PER_DEVICE &&
+		    !pdata->exclusive)
+			identifier = (void *)pdata;
+		else
+			identifier = (void *)priv;
+
+		err = nvhost_channel_map_with_prio(pdata, &priv->ch,
+						     identifier, priv->priority);
+		if (err)
+			break;
+
+		/* see NVHOST_IOCTL_CHANNEL_SUBMIT */
+		if (pdata->resource_policy == RESOURCE_PER_CHANNEL_INSTANCE) {
+			memcpy(priv->ch->syncpts, priv->syncpts,
+			       sizeof(priv->syncpts));
+			priv->ch->client_managed_syncpt =
+				priv->client_managed_syncpt;
+		}
+
+		err = nvhost_ioctl_channel_submit_batch(priv, (void *)buf);
+
+		nvhost_putchannel(priv->ch, 1);
+
+		break;
+	}
 	case NVHOST_IOCTL_CHANNEL_SET_ERROR_NOTIFIER:
 		err = nvhost_init_error_notifier(priv,
 			(struct nvhost_set_error_notifier *)buf);
@@ -1734,6 +1994,163 @@ static void nvhost_client_user_deinit(struct platform_device *dev)
 	unregister_chrdev_region(pdata->cdev_region, NVHOST_NUM_CDEV);
 }
 
+/*
+ * Falcon and PVA ucode is otherwise first read when the engine is powered
+ * up for its first job. Engines that know their image name at probe time
+ * start fetching it right away; the images load concurrently on the
+ * system workqueue and the first nvhost_client_request_firmware() for the
+ * same image takes over the preloaded copy instead of reading it again.
+ */
+static bool fw_preload = true;
+module_param(fw_preload, bool, 0444);
+
+struct nvhost_fw_preload {
+	struct list_head list;
+	struct device *dev;
+	char *name;
+	const struct firmware *fw;
+	struct completion done;
+	ktime_t start;
+	s64 load_us;
+	bool loaded;
+	bool claimed;
+};
+
+static LIST_HEAD(nvhost_fw_preload_list);
+static DEFINE_MUTEX(nvhost_fw_preload_lock);
+
+/* Apply the SOC relative path prefix, caller frees the result */
+static char *nvhost_client_fw_path(const char *fw_name)
+{
+	struct nvhost_chip_support *op = nvhost_get_chip_ops();
+
+	if (op->soc_name)
+		return kasprintf(GFP_KERNEL, "%s/%s", op->soc_name, fw_name);
+
+	return kstrdup(fw_name, GFP_KERNEL);
+}
+
+static void nvhost_client_fw_preload_done(const struct firmware *fw,
+					  void *context)
+{
+	struct nvhost_fw_preload *p = context;
+
+	p->fw = fw;
+	p->loaded = fw != NULL;
+	p->load_us = ktime_us_delta(ktime_get(), p->start);
+	complete_all(&p->done);
+}
+
+static void nvhost_client_preload_firmware(struct platform_device *dev,
+					   const char *fw_name)
+{
+	struct nvhost_fw_preload *p;
+	int err;
+
+	if (!fw_preload || !fw_name)
+		return;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	if (!p)
+		return;
+
+	p->name = nvhost_client_fw_path(fw_name);
+	if (!p->name) {
+		kfree(p);
+		return;
+	}
+
+	p->dev = &dev->dev;
+	init_completion(&p->done);
+	p->start = ktime_get();
+
+	mutex_lock(&nvhost_fw_preload_lock);
+	list_add_tail(&p->list, &nvhost_fw_preload_list);
+	mutex_unlock(&nvhost_fw_preload_lock);
+
+	err = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG, p->name,
+				      p->dev, GFP_KERNEL, p,
+				      nvhost_client_fw_preload_done);
+	if (err) {
+		nvhost_warn(&dev->dev, "failed to preload %s (err=%d)",
+			    p->name, err);
+		complete_all(&p->done);
+	}
+}
+
+/* Hand over a preloaded image, waiting for it if it is still in flight */
+static const struct firmware *
+nvhost_client_claim_preloaded_firmware(struct platform_device *dev,
+				       const char *fw_path)
+{
+	struct nvhost_fw_preload *p, *found = NULL;
+	const struct firmware *fw;
+
+	mutex_lock(&nvhost_fw_preload_lock);
+	list_for_each_entry(p, &nvhost_fw_preload_list, list) {
+		if (p->dev == &dev->dev && !p->claimed &&
+		    !strcmp(p->name, fw_path)) {
+			p->claimed = true;
+			found = p;
+			break;
+		}
+	}
+	mutex_unlock(&nvhost_fw_preload_lock);
+
+	if (!found)
+		return NULL;
+
+	wait_for_completion(&found->done);
+	fw = found->fw;
+	found->fw = NULL;
+
+	return fw;
+}
+
+/* Drop whatever is left for a device that is going away */
+static void
+nvhost_client_release_preloaded_firmware(struct platform_device *dev)
+{
+	struct nvhost_fw_preload *p, *tmp;
+	LIST_HEAD(dead);
+
+	mutex_lock(&nvhost_fw_preload_lock);
+	list_for_each_entry_safe(p, tmp, &nvhost_fw_preload_list, list) {
+		if (p->dev == &dev->dev)
+			list_move(&p->list, &dead);
+	}
+	mutex_unlock(&nvhost_fw_preload_lock);
+
+	list_for_each_entry_safe(p, tmp, &dead, list) {
+		wait_for_completion(&p->done);
+		release_firmware(p->fw);
+		kfree(p->name);
+		kfree(p);
+	}
+}
+
+int nvhost_client_fw_preload_debug_show(struct seq_file *s, void *unused)
+{
+	struct nvhost_fw_preload *p;
+
+	seq_printf(s, "%-20s %-40s %-8s %10s %s\n",
+		   "device", "image", "status", "load(us)", "claimed");
+
+	mutex_lock(&nvhost_fw_preload_lock);
+	list_for_each_entry(p, &nvhost_fw_preload_list, list) {
+		bool done = completion_done(&p->done);
+
+		seq_printf(s, "%-20s %-40s %-8s %10lld %s\n",
+			   dev_name(p->dev), p->name,
+			   !done ? "loading" : p->loaded ? "ok" : "failed",
+			   done ? p->load_us : 0LL,
+			   p->claimed ? "yes" : "no");
+	}
+	mutex_unlock(&nvhost_fw_preload_lock);
+
+	return 0;
+}
+
 int nvhost_client_device_init(struct platform_device *dev)
 {
 	int err;
@@ -1742,6 +2159,10 @@ int nvhost_client_device_init(struct platform_device *dev)
 
 	mutex_init(&pdata->userctx_list_lock);
 	INIT_LIST_HEAD(&pdata->userctx_list);
+	atomic_set(&pdata->high_prio_jobs, 0);
+	init_waitqueue_head(&pdata->high_prio_wq);
+	spin_lock_init(&pdata->client_usage_lock);
+	INIT_LIST_HEAD(&pdata->client_usage_list);
 
 	nvhost_client_devfs_name_init(dev);
 
@@ -1759,6 +2180,8 @@ int nvhost_client_device_init(struct platform_device *dev)
 	if (pdata->scaling_init)
 		pdata->scaling_init(dev);
 
+	nvhost_client_preload_firmware(dev, pdata->firmware_name);
+
 #ifdef CONFIG_EVENTLIB
 	pdata->eventlib_id = keventlib_register(4 * PAGE_SIZE,
 						dev_name(&dev->dev),
@@ -1827,6 +2250,8 @@ int nvhost_client_device_release(struct platform_device *dev)
 	/* Remove debugFS */
 	nvhost_device_debug_deinit(dev);
 
+	nvhost_client_release_preloaded_firmware(dev);
+
 	return 0;
 }
 EXPORT_SYMBOL(nvhost_client_device_release);
@@ -1876,10 +2301,9 @@ EXPORT_SYMBOL(nvhost_client_device_get_resources);
 const struct firmware *
 nvhost_client_request_firmware(struct platform_device *dev, const char *fw_name)
 {
-	struct nvhost_chip_support *op = nvhost_get_chip_ops();
 	const struct firmware *fw;
-	char *fw_path = NULL;
-	int path_len, err;
+	char *fw_path;
+	int err;
 
 	/* This field is NULL when calling from SYS_EXIT.
 	   Add a check here to prevent crash in request_firmware */
@@ -1891,20 +2315,17 @@ nvhost_client_request_firmware(struct platform_device *dev, const char *fw_name)
 	if (!fw_name)
 		return NULL;
 
-	if (op->soc_name) {
-		path_len = strlen(fw_name) + strlen(op->soc_name);
-		path_len += 2; /* for the path separator and zero terminator*/
-
-		fw_path = kzalloc(sizeof(*fw_path) * path_len,
-				     GFP_KERNEL);
-		if (!fw_path)
-			return NULL;
+	fw_path = nvhost_client_fw_path(fw_name);
+	if (!fw_path)
+		return NULL;
 
-		snprintf(fw_path, sizeof(*fw_path) * path_len, "%s/%s", op->soc_name, fw_name);
-		fw_name = fw_path;
+	fw = nvhost_client_claim_preloaded_firmware(dev, fw_path);
+	if (fw) {
+		kfree(fw_path);
+		return fw;
 	}
 
-	err = request_firmware(&fw, fw_name, &dev->dev);
+	err = request_firmware(&fw, fw_path, &dev->dev);
 	kfree(fw_path);
 	if (err) {
 		dev_err(&dev->dev, "failed to get firmware\n");
@@ -2003,6 +2424,38 @@ void nvhost_eventlib_log_submit(struct platform_device *pdev,
 			NVHOST_TASK_SUBMIT,
 			timestamp);
 }
+
+void nvhost_eventlib_log_job(struct nvhost_job *job)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+	struct nvhost_master *host = nvhost_get_host(job->ch->dev);
+	struct nvhost_job_stages stages;
+
+	/* only jobs from the submit ioctl carry stage timestamps */
+	if (!pdata->eventlib_id || !job->stage_ts.submit)
+		return;
+
+	if (!keventlib_type_enabled(pdata->eventlib_id, NVHOST_JOB_STAGES))
+		return;
+
+	stages.class_id = pdata->class;
+	stages.syncpt_id = job->sp[0].id;
+	stages.syncpt_thresh = pdata->push_work_done ?
+		(job->sp[0].fence - 1) : job->sp[0].fence;
+	stages.submit = job->stage_ts.submit;
+	stages.pinned = job->stage_ts.pinned;
+	stages.pushed = job->stage_ts.pushed;
+	stages.hw_start = job->engine_timestamps.ptr ?
+		job->engine_timestamps.ptr[0] >> 5 : 0;
+	stages.syncpt_done =
+		READ_ONCE(host->intr.syncpt[job->sp[0].id].thresh_ts);
+
+	keventlib_write(pdata->eventlib_id,
+			&stages,
+			sizeof(stages),
+			NVHOST_JOB_STAGES,
+			stages.syncpt_done);
+}
 #else
 void nvhost_eventlib_log_task(struct platform_device *pdev,
 			      u32 syncpt_id,
@@ -2018,6 +2471,10 @@ void nvhost_eventlib_log_submit(struct platform_device *pdev,
 				u64 timestamp)
 {
 }
+
+void nvhost_eventlib_log_job(struct nvhost_job *job)
+{
+}
 #endif
 EXPORT_SYMBOL(nvhost_eventlib_log_submit);
 EXPORT_SYMBOL(nvhost_eventlib_log_task);
@@ -25,6 +25,8 @@
 
 struct firmware;
 struct platform_device;
+struct nvhost_job;
+struct seq_file;
 
 int nvhost_read_module_regs(struct platform_device *ndev,
 			u32 offset, int count, u32 *values);
@@ -45,4 +47,9 @@ struct nvhost_channel *nvhost_find_chan_by_clientid(
 int validate_max_size(struct platform_device *ndev, u32 size);
 
 const char *get_device_name_for_dev(struct platform_device *dev);
+
+/* Log the submit stage timestamps of a retired job */
+void nvhost_eventlib_log_job(struct nvhost_job *job);
+
+int nvhost_client_fw_preload_debug_show(struct seq_file *s, void *unused);
 #endif
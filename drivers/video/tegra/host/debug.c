@@ -26,8 +26,13 @@
 
 #include "dev.h"
 #include "debug.h"
+#include "bus_client.h"
 #include "nvhost_acm.h"
 #include "nvhost_channel.h"
+#include "nvhost_pin_cache.h"
+#ifdef CONFIG_TEGRA_T19X_GRHOST
+#include "nvhost_buffer.h"
+#endif
 #include "chip_support.h"
 
 unsigned int nvhost_debug_trace_cmdbuf;
@@ -218,6 +223,73 @@ static const struct file_operations nvhost_debug_fops = {
 	.release	= single_release,
 };
 
+static int nvhost_debug_pin_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_pin_cache_debug_show, inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_pin_cache_fops = {
+	.open		= nvhost_debug_pin_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int nvhost_debug_acm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_module_debug_stats_show,
+			   inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_acm_stats_fops = {
+	.open		= nvhost_debug_acm_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int nvhost_debug_client_usage_open(struct inode *inode,
+					  struct file *file)
+{
+	return single_open(file, nvhost_client_usage_debug_show,
+			   inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_client_usage_fops = {
+	.open		= nvhost_debug_client_usage_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int nvhost_debug_fw_preload_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvhost_client_fw_preload_debug_show,
+			   inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_fw_preload_fops = {
+	.open		= nvhost_debug_fw_preload_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#ifdef CONFIG_TEGRA_T19X_GRHOST
+static int nvhost_debug_buffer_lookup_open(struct inode *inode,
+					   struct file *file)
+{
+	return single_open(file, nvhost_buffer_debug_show, inode->i_private);
+}
+
+static const struct file_operations nvhost_debug_buffer_lookup_fops = {
+	.open		= nvhost_debug_buffer_lookup_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 void nvhost_device_debug_init(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
@@ -226,6 +298,17 @@ void nvhost_device_debug_init(struct platform_device *dev)
 	debugfs_name = pdata->devfs_name ? pdata->devfs_name : dev->name;
 
 	pdata->debugfs = debugfs_create_dir(debugfs_name, pdata->debugfs);
+	if (IS_ERR_OR_NULL(pdata->debugfs))
+		return;
+
+	debugfs_create_u32("syncpt_spin_us", S_IRUGO|S_IWUSR, pdata->debugfs,
+			&pdata->syncpt_spin_us);
+	debugfs_create_bool("autosuspend_adaptive", S_IRUGO|S_IWUSR,
+			pdata->debugfs, &pdata->autosuspend_adaptive);
+	debugfs_create_file("acm_stats", S_IRUGO, pdata->debugfs, dev,
+			&nvhost_debug_acm_stats_fops);
+	debugfs_create_file("client_usage", S_IRUGO, pdata->debugfs, dev,
+			&nvhost_debug_client_usage_fops);
 }
 
 void nvhost_device_debug_deinit(struct platform_device *dev)
@@ -274,6 +357,21 @@ void nvhost_debug_init(struct nvhost_master *master)
 			&pdata->nvhost_timeout_default);
 	debugfs_create_u32("trace_actmon", S_IRUGO|S_IWUSR, de,
 			&nvhost_debug_trace_actmon);
+
+	debugfs_create_file("pin_cache", S_IRUGO, de,
+			NULL, &nvhost_debug_pin_cache_fops);
+	debugfs_create_u32("pin_cache_max", S_IRUGO|S_IWUSR, de,
+			&nvhost_pin_cache_max);
+	debugfs_create_u32("syncpt_spin_us", S_IRUGO|S_IWUSR, de,
+			&nvhost_syncpt_spin_us);
+	debugfs_create_u32("high_prio_channels", S_IRUGO|S_IWUSR, de,
+			&master->high_prio_channels);
+	debugfs_create_file("firmware_preload", S_IRUGO, de,
+			NULL, &nvhost_debug_fw_preload_fops);
+#ifdef CONFIG_TEGRA_T19X_GRHOST
+	debugfs_create_file("buffer_lookup", S_IRUGO, de,
+			NULL, &nvhost_debug_buffer_lookup_fops);
+#endif
 }
 
 void nvhost_register_dump_device(
@@ -788,10 +788,18 @@ static long nvhost_ctrlctl(struct file *filp,
 	return err;
 }
 
+static int nvhost_ctrlmmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct nvhost_ctrl_userctx *priv = filp->private_data;
+
+	return nvhost_syncpt_mmap_shadow(&priv->dev->syncpt, vma);
+}
+
 static const struct file_operations nvhost_ctrlops = {
 	.owner = THIS_MODULE,
 	.release = nvhost_ctrlrelease,
 	.open = nvhost_ctrlopen,
+	.mmap = nvhost_ctrlmmap,
 	.unlocked_ioctl = nvhost_ctrlctl,
 #ifdef CONFIG_COMPAT
 	.compat_ioctl = nvhost_ctrlctl,
@@ -1157,6 +1165,9 @@ int nvhost_update_characteristics(struct platform_device *dev)
 
 	host->nvhost_char.flags |= NVHOST_CHARACTERISTICS_SUPPORT_PREFENCES;
 
+	if (host->syncpt.shadow)
+		host->nvhost_char.flags |= NVHOST_CHARACTERISTICS_SYNCPT_SHADOW;
+
 	host->nvhost_char.num_mlocks = host->info.nb_mlocks;
 	host->nvhost_char.num_syncpts = host->info.nb_pts;
 	host->nvhost_char.syncpts_base = host->info.pts_base;
@@ -1565,12 +1576,17 @@ static int __init nvhost_mod_init(void)
 	if (ret)
 		return ret;
 
+	/* plain allocations are used if the caches are not available */
+	if (nvhost_job_init_caches())
+		pr_warn("%s: failed to create job caches\n", __func__);
+
 	return platform_driver_register(&platform_driver);
 }
 
 static void __exit nvhost_mod_exit(void)
 {
 	platform_driver_unregister(&platform_driver);
+	nvhost_job_deinit_caches();
 }
 
 /* host1x master device needs nvmap to be instantiated first.
@@ -125,8 +125,9 @@ struct nvhost_master {
 	struct nvhost_channel **chlist;	/* channel list */
 	struct mutex chlist_mutex;	/* mutex for channel list */
 	struct mutex ch_alloc_mutex;	/* mutex for channel allocation */
-	struct semaphore free_channels; /* Semaphore tracking free channels */
+	wait_queue_head_t free_channels_wq; /* Waiters for a free channel */
 	unsigned long allocated_channels[2];
+	u32 high_prio_channels;		/* Channels kept for high priority */
 
 	/* nvhost vm specific structures */
 	struct nvhost_vm_firmware_area firmware_area;
@@ -34,18 +34,28 @@
 
 #define NVHOST_CHANNEL_LOW_PRIO_MAX_WAIT 50
 
+/* Value syncpoint i reaches once the job's gathers are done, that is the
+ * fence without the work done increment. */
+static u32 job_gathers_done_fence(struct nvhost_job *job, int i)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+
+	if (i == 0 && pdata->push_work_done)
+		return job->sp[0].fence - 1;
+	return job->sp[i].fence;
+}
+
 static void submit_work_done_increment(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
-	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
 
 	if (!pdata->push_work_done)
 		return;
 
 	/* make the last increment at job boundary. this will ensure
-	 * that the user command buffer is no longer in use */
-	job->sp[0].fence = nvhost_syncpt_incr_max(sp, job->sp[0].id, 1);
+	 * that the user command buffer is no longer in use. Its fence
+	 * was handed out with the others. */
 	nvhost_cdma_push(&ch->cdma, nvhost_opcode_imm_incr_syncpt(0,
 			job->sp[0].id), NVHOST_OPCODE_NOOP);
 }
@@ -106,7 +116,6 @@ static void push_wait(struct nvhost_cdma *cdma, unsigned int id,
 static void serialize(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
-	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
 	int i;
 
@@ -115,7 +124,7 @@ static void serialize(struct nvhost_job *job)
 
 	for (i = 0; i < job->num_syncpts; ++i)
 		push_wait(&ch->cdma, job->sp[i].id,
-			  nvhost_syncpt_read_max(sp, job->sp[i].id));
+			  job_gathers_done_fence(job, i));
 }
 
 #ifdef CONFIG_TEGRA_GRHOST_SYNC
@@ -282,6 +291,77 @@ static void submit_work(struct nvhost_job *job)
 		lock_device(job, false);
 }
 
+/*
+ * Hand out fences for every syncpoint of the job. Called under the submit
+ * ring lock, so the fences are in the order the jobs are committed.
+ */
+static void host1x_channel_assign_fences(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
+	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
+	int i;
+
+	for (i = 0; i < job->num_syncpts; ++i) {
+		u32 incrs = job->sp[i].incrs;
+
+		/* create a valid max for client managed syncpoints */
+		if (nvhost_syncpt_client_managed(sp, job->sp[i].id)) {
+			u32 min = nvhost_syncpt_read(sp, job->sp[i].id);
+			if (min)
+				dev_warn(&job->ch->dev->dev,
+					"converting an active unmanaged syncpoint %d to managed\n",
+					job->sp[i].id);
+			nvhost_syncpt_set_max(sp, job->sp[i].id, min);
+			nvhost_syncpt_set_manager(sp, job->sp[i].id, false);
+		}
+
+		job->sp[i].fence =
+			nvhost_syncpt_incr_max(sp, job->sp[i].id, incrs);
+
+		nvhost_syncpt_get_ref(sp, job->sp[i].id);
+	}
+
+	/* the work done increment lands after all the gathers */
+	if (pdata->push_work_done)
+		job->sp[0].fence = nvhost_syncpt_incr_max(sp, job->sp[0].id, 1);
+}
+
+/*
+ * Push a queued job to hardware. Called by the submit ring committer with
+ * the channel submitlock held, in fence order.
+ */
+static void host1x_channel_commit(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
+	int err, i;
+
+	/* begin a CDMA submit */
+	err = nvhost_cdma_begin(&ch->cdma, job);
+	if (WARN(err, "%s: cdma begin failed %d\n", __func__, err)) {
+		/* fences are already out, retire them from the CPU */
+		for (i = 0; i < job->num_syncpts; ++i)
+			nvhost_cdma_finalize_job_incrs(sp, job->sp + i);
+		return;
+	}
+
+	/* mark syncpoints used by this channel */
+	for (i = 0; i < job->num_syncpts; ++i)
+		nvhost_syncpt_mark_used(sp, ch->chid, job->sp[i].id);
+
+	/* mark also client managed syncpoint used by this channel */
+	if (job->client_managed_syncpt)
+		nvhost_syncpt_mark_used(sp, ch->chid,
+					job->client_managed_syncpt);
+
+	/* push work to hardware */
+	submit_work(job);
+
+	/* end CDMA submit & stash pinned hMems into sync queue */
+	nvhost_cdma_end(&ch->cdma, job);
+}
+
 static int host1x_channel_submit(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
@@ -307,22 +387,11 @@ static int host1x_channel_submit(struct nvhost_job *job)
 	/* before error checks, return current max */
 	prev_max = job->sp->fence = nvhost_syncpt_read_max(sp, job->sp->id);
 
-	/* get submit lock */
-	err = mutex_lock_interruptible(&ch->submitlock);
-	if (err) {
-		nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-		nvhost_putchannel(ch, job->num_syncpts);
-		goto error;
-	}
-
 	for (i = 0; i < job->num_syncpts; ++i) {
 		completed_waiters[i] = nvhost_intr_alloc_waiter();
 		if (!completed_waiters[i]) {
-			nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-			nvhost_putchannel(ch, job->num_syncpts);
-			mutex_unlock(&ch->submitlock);
 			err = -ENOMEM;
-			goto error;
+			goto fail;
 		}
 		if (nvhost_intr_has_pending_jobs(
 			&nvhost_get_host(ch->dev)->intr, job->sp[i].id, ch))
@@ -331,48 +400,15 @@ static int host1x_channel_submit(struct nvhost_job *job)
 				__func__, job->sp[i].id);
 	}
 
-	/* begin a CDMA submit */
-	err = nvhost_cdma_begin(&ch->cdma, job);
-	if (err) {
-		nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-		nvhost_putchannel(ch, job->num_syncpts);
-		mutex_unlock(&ch->submitlock);
-		goto error;
-	}
-
-	/* determine fences for all syncpoints */
-	for (i = 0; i < job->num_syncpts; ++i) {
-		u32 incrs = job->sp[i].incrs;
-
-		/* create a valid max for client managed syncpoints */
-		if (nvhost_syncpt_client_managed(sp, job->sp[i].id)) {
-			u32 min = nvhost_syncpt_read(sp, job->sp[i].id);
-			if (min)
-				dev_warn(&job->ch->dev->dev,
-					"converting an active unmanaged syncpoint %d to managed\n",
-					job->sp[i].id);
-			nvhost_syncpt_set_max(sp, job->sp[i].id, min);
-			nvhost_syncpt_set_manager(sp, job->sp[i].id, false);
-		}
-
-		job->sp[i].fence =
-			nvhost_syncpt_incr_max(sp, job->sp[i].id, incrs);
-
-		/* mark syncpoint used by this channel */
-		nvhost_syncpt_get_ref(sp, job->sp[i].id);
-		nvhost_syncpt_mark_used(sp, ch->chid, job->sp[i].id);
-	}
-
-	/* mark also client managed syncpoint used by this channel */
-	if (job->client_managed_syncpt)
-		nvhost_syncpt_mark_used(sp, ch->chid,
-					job->client_managed_syncpt);
-
-	/* push work to hardware */
-	submit_work(job);
+	/* nothing may fail once the job has its fences */
+	err = nvhost_cdma_timeout_prepare(&ch->cdma, job);
+	if (err)
+		goto fail;
 
-	/* end CDMA submit & stash pinned hMems into sync queue */
-	nvhost_cdma_end(&ch->cdma, job);
+	/* determine fences for all syncpoints and queue the job */
+	nvhost_cdma_ring_lock(&ch->cdma);
+	host1x_channel_assign_fences(job);
+	nvhost_cdma_ring_queue_unlock(&ch->cdma, job);
 
 	trace_nvhost_channel_submitted(ch->dev->name, prev_max,
 		job->sp->fence);
@@ -387,11 +423,15 @@ static int host1x_channel_submit(struct nvhost_job *job)
 		WARN(err, "Failed to set submit complete interrupt");
 	}
 
-	mutex_unlock(&ch->submitlock);
+	/* push our job, and whatever got queued behind it, unless some
+	 * other submitter is already doing so */
+	nvhost_cdma_ring_commit(&ch->cdma, host1x_channel_commit);
 
 	return 0;
 
-error:
+fail:
+	nvhost_module_idle_mult(ch->dev, job->num_syncpts);
+	nvhost_putchannel(ch, job->num_syncpts);
 	for (i = 0; i < job->num_syncpts; ++i)
 		kfree(completed_waiters[i]);
 	return err;
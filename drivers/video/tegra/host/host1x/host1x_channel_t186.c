@@ -40,18 +40,28 @@
 
 #define MLOCK_TIMEOUT_MS (16)
 
+/* Value syncpoint i reaches once the job's gathers are done, that is the
+ * fence without the work done increment. */
+static u32 job_gathers_done_fence(struct nvhost_job *job, int i)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+
+	if (i == 0 && pdata->push_work_done)
+		return job->sp[0].fence - 1;
+	return job->sp[i].fence;
+}
+
 static void submit_work_done_increment(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
-	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
 
 	if (!pdata->push_work_done)
 		return;
 
 	/* make the last increment at job boundary. this will ensure
-	 * that the user command buffer is no longer in use */
-	job->sp[0].fence = nvhost_syncpt_incr_max(sp, job->sp[0].id, 1);
+	 * that the user command buffer is no longer in use. Its fence
+	 * was handed out with the others. */
 	nvhost_cdma_push(&ch->cdma,
 			 nvhost_opcode_setclass(NV_HOST1X_CLASS_ID, 0, 1),
 			 job->sp[0].id);
@@ -60,7 +70,6 @@ static void submit_work_done_increment(struct nvhost_job *job)
 static void serialize(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
-	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
 	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
 	int i;
 
@@ -78,7 +87,7 @@ static void serialize(struct nvhost_job *job)
 
 	for (i = 0; i < job->num_syncpts; ++i) {
 		u32 id = job->sp[i].id;
-		u32 max = nvhost_syncpt_read_max(sp, id);
+		u32 max = job_gathers_done_fence(job, i);
 
 		nvhost_cdma_push(&ch->cdma,
 			nvhost_opcode_setclass(NV_HOST1X_CLASS_ID,
@@ -358,56 +367,53 @@ static void set_mlock_timeout(struct nvhost_channel *ch)
 	}
 }
 
-static int host1x_channel_submit(struct nvhost_job *job)
+/*
+ * Hand out fences for every syncpoint of the job. Called under the submit
+ * ring lock, so the fences are in the order the jobs are committed.
+ */
+static void host1x_channel_assign_fences(struct nvhost_job *job)
 {
 	struct nvhost_channel *ch = job->ch;
-	struct platform_device *host_dev = nvhost_get_host(job->ch->dev)->dev;
-	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
-	u32 prev_max = 0;
-	int err, i;
-	void *completed_waiters[NVHOST_SUBMIT_MAX_NUM_SYNCPT_INCRS];
-	int streamid;
-
-	memset(completed_waiters, 0, sizeof(void *) * job->num_syncpts);
+	struct nvhost_syncpt *sp = &nvhost_get_host(ch->dev)->syncpt;
+	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
+	int i;
 
-	/* Turn on the client module and host1x */
 	for (i = 0; i < job->num_syncpts; ++i) {
-		err = nvhost_module_busy(ch->dev);
-		if (err) {
-			nvhost_module_idle_mult(ch->dev, i);
-			nvhost_putchannel(ch, i);
-			return err;
-		}
+		u32 incrs = job->sp[i].incrs;
 
-		nvhost_getchannel(ch);
-	}
+		/* create a valid max for client managed syncpoints */
+		if (nvhost_syncpt_client_managed(sp, job->sp[i].id)) {
+			u32 min = nvhost_syncpt_read(sp, job->sp[i].id);
+			if (min)
+				dev_warn(&job->ch->dev->dev,
+					"converting an active unmanaged syncpoint %d to managed\n",
+					job->sp[i].id);
+			nvhost_syncpt_set_max(sp, job->sp[i].id, min);
+			nvhost_syncpt_set_manager(sp, job->sp[i].id, false);
+		}
 
-	/* before error checks, return current max */
-	prev_max = job->sp->fence = nvhost_syncpt_read_max(sp, job->sp->id);
+		job->sp[i].fence =
+			nvhost_syncpt_incr_max(sp, job->sp[i].id, incrs);
 
-	/* get submit lock */
-	err = mutex_lock_interruptible(&ch->submitlock);
-	if (err) {
-		nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-		nvhost_putchannel(ch, job->num_syncpts);
-		goto error;
+		nvhost_syncpt_get_ref(sp, job->sp[i].id);
 	}
 
-	for (i = 0; i < job->num_syncpts; ++i) {
-		completed_waiters[i] = nvhost_intr_alloc_waiter();
-		if (!completed_waiters[i]) {
-			nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-			nvhost_putchannel(ch, job->num_syncpts);
-			mutex_unlock(&ch->submitlock);
-			err = -ENOMEM;
-			goto error;
-		}
-		if (nvhost_intr_has_pending_jobs(
-			&nvhost_get_host(ch->dev)->intr, job->sp[i].id, ch))
-			dev_warn(&ch->dev->dev,
-				"%s: cross-channel dependencies on syncpt %d\n",
-				__func__, job->sp[i].id);
-	}
+	/* the work done increment lands after all the gathers */
+	if (pdata->push_work_done)
+		job->sp[0].fence = nvhost_syncpt_incr_max(sp, job->sp[0].id, 1);
+}
+
+/*
+ * Push a queued job to hardware. Called by the submit ring committer with
+ * the channel submitlock held, in fence order.
+ */
+static void host1x_channel_commit(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	struct platform_device *host_dev = nvhost_get_host(job->ch->dev)->dev;
+	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
+	int streamid;
+	int err, i;
 
 	/* get host1x streamid */
 	if (host_dev->dev.archdata.iommu) {
@@ -427,35 +433,16 @@ static int host1x_channel_submit(struct nvhost_job *job)
 
 	/* begin a CDMA submit */
 	err = nvhost_cdma_begin(&ch->cdma, job);
-	if (err) {
-		nvhost_module_idle_mult(ch->dev, job->num_syncpts);
-		nvhost_putchannel(ch, job->num_syncpts);
-		mutex_unlock(&ch->submitlock);
-		goto error;
+	if (WARN(err, "%s: cdma begin failed %d\n", __func__, err)) {
+		/* fences are already out, retire them from the CPU */
+		for (i = 0; i < job->num_syncpts; ++i)
+			nvhost_cdma_finalize_job_incrs(sp, job->sp + i);
+		return;
 	}
 
-	/* determine fences for all syncpoints */
-	for (i = 0; i < job->num_syncpts; ++i) {
-		u32 incrs = job->sp[i].incrs;
-
-		/* create a valid max for client managed syncpoints */
-		if (nvhost_syncpt_client_managed(sp, job->sp[i].id)) {
-			u32 min = nvhost_syncpt_read(sp, job->sp[i].id);
-			if (min)
-				dev_warn(&job->ch->dev->dev,
-					"converting an active unmanaged syncpoint %d to managed\n",
-					job->sp[i].id);
-			nvhost_syncpt_set_max(sp, job->sp[i].id, min);
-			nvhost_syncpt_set_manager(sp, job->sp[i].id, false);
-		}
-
-		job->sp[i].fence =
-			nvhost_syncpt_incr_max(sp, job->sp[i].id, incrs);
-
-		/* mark syncpoint used by this channel */
-		nvhost_syncpt_get_ref(sp, job->sp[i].id);
+	/* mark syncpoints used by this channel */
+	for (i = 0; i < job->num_syncpts; ++i)
 		nvhost_syncpt_mark_used(sp, ch->chid, job->sp[i].id);
-	}
 
 	/* mark also client managed syncpoint used by this channel */
 	if (job->client_managed_syncpt)
@@ -467,6 +454,55 @@ static int host1x_channel_submit(struct nvhost_job *job)
 
 	/* end CDMA submit & stash pinned hMems into sync queue */
 	nvhost_cdma_end(&ch->cdma, job);
+}
+
+static int host1x_channel_submit(struct nvhost_job *job)
+{
+	struct nvhost_channel *ch = job->ch;
+	struct nvhost_syncpt *sp = &nvhost_get_host(job->ch->dev)->syncpt;
+	u32 prev_max = 0;
+	int err, i;
+	void *completed_waiters[NVHOST_SUBMIT_MAX_NUM_SYNCPT_INCRS];
+
+	memset(completed_waiters, 0, sizeof(void *) * job->num_syncpts);
+
+	/* Turn on the client module and host1x */
+	for (i = 0; i < job->num_syncpts; ++i) {
+		err = nvhost_module_busy(ch->dev);
+		if (err) {
+			nvhost_module_idle_mult(ch->dev, i);
+			nvhost_putchannel(ch, i);
+			return err;
+		}
+
+		nvhost_getchannel(ch);
+	}
+
+	/* before error checks, return current max */
+	prev_max = job->sp->fence = nvhost_syncpt_read_max(sp, job->sp->id);
+
+	for (i = 0; i < job->num_syncpts; ++i) {
+		completed_waiters[i] = nvhost_intr_alloc_waiter();
+		if (!completed_waiters[i]) {
+			err = -ENOMEM;
+			goto fail;
+		}
+		if (nvhost_intr_has_pending_jobs(
+			&nvhost_get_host(ch->dev)->intr, job->sp[i].id, ch))
+			dev_warn(&ch->dev->dev,
+				"%s: cross-channel dependencies on syncpt %d\n",
+				__func__, job->sp[i].id);
+	}
+
+	/* nothing may fail once the job has its fences */
+	err = nvhost_cdma_timeout_prepare(&ch->cdma, job);
+	if (err)
+		goto fail;
+
+	/* determine fences for all syncpoints and queue the job */
+	nvhost_cdma_ring_lock(&ch->cdma);
+	host1x_channel_assign_fences(job);
+	nvhost_cdma_ring_queue_unlock(&ch->cdma, job);
 
 	trace_nvhost_channel_submitted(ch->dev->name, prev_max,
 		job->sp->fence);
@@ -481,11 +517,15 @@ static int host1x_channel_submit(struct nvhost_job *job)
 		WARN(err, "Failed to set submit complete interrupt");
 	}
 
-	mutex_unlock(&ch->submitlock);
+	/* push our job, and whatever got queued behind it, unless some
+	 * other submitter is already doing so */
+	nvhost_cdma_ring_commit(&ch->cdma, host1x_channel_commit);
 
 	return 0;
 
-error:
+fail:
+	nvhost_module_idle_mult(ch->dev, job->num_syncpts);
+	nvhost_putchannel(ch, job->num_syncpts);
 	for (i = 0; i < job->num_syncpts; ++i)
 		kfree(completed_waiters[i]);
 	return err;
@@ -30,21 +30,16 @@
 static int host1x_vm_init(struct nvhost_vm *vm, void *identifier)
 {
 	struct platform_device *pdev;
-	unsigned int i = 0;
 
 	/* wait until we have a context device */
-	do {
-		pdev = iommu_context_dev_allocate(identifier);
-		if (!pdev) {
-			++i;
-			mdelay(1);
-			if (i > NVHOST_VM_WAIT_TIMEOUT) {
-				nvhost_err(&vm->pdev->dev,
-					   "host1x_vm_init active waiting for %u ms\n", i);
-				return -ETIMEDOUT;
-			}
-		}
-	} while (!pdev);
+	pdev = iommu_context_dev_allocate_wait(identifier,
+					       NVHOST_VM_WAIT_TIMEOUT);
+	if (!pdev) {
+		nvhost_err(&vm->pdev->dev,
+			   "host1x_vm_init no context device after %u ms\n",
+			   NVHOST_VM_WAIT_TIMEOUT);
+		return -ETIMEDOUT;
+	}
 
 	vm->pdev = pdev;
 
@@ -28,6 +28,8 @@
 #include <linux/version.h>
 #include <linux/dma-buf.h>
 #include <linux/nvhost.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
 
 #include <iommu_context_dev.h>
 
@@ -51,12 +53,68 @@ struct iommu_ctx {
 	struct list_head list;
 	struct device_dma_parameters dma_parms;
 	bool allocated;
+	bool scrubbing;
 	void *prev_identifier;
 };
 
+/*
+ * Free context devices keep the stash of their last user so that the same
+ * process gets its mappings back for free. A context handed to a new
+ * process has to drop that stash first, which is what makes process start
+ * slow, so a few free contexts are kept scrubbed in the background.
+ */
+static unsigned int min_clean_contexts = 1;
+module_param(min_clean_contexts, uint, 0644);
+MODULE_PARM_DESC(min_clean_contexts,
+		 "Free context devices kept without stashed mappings");
+
+/* least recently released first */
 static LIST_HEAD(iommu_ctx_list);
 static LIST_HEAD(iommu_static_mappings_list);
 static DEFINE_MUTEX(iommu_ctx_list_mutex);
+static DECLARE_WAIT_QUEUE_HEAD(iommu_ctx_wq);
+static unsigned int iommu_ctx_release_seq;
+
+static void iommu_context_dev_scrub(struct work_struct *work);
+static DECLARE_WORK(iommu_ctx_scrub_work, iommu_context_dev_scrub);
+
+/* Called with iommu_ctx_list_mutex held */
+static struct iommu_ctx *iommu_context_dev_scrub_candidate(void)
+{
+	struct iommu_ctx *ctx, *dirty = NULL;
+	unsigned int clean = 0;
+
+	list_for_each_entry(ctx, &iommu_ctx_list, list) {
+		if (ctx->allocated || ctx->scrubbing)
+			continue;
+		if (!ctx->prev_identifier)
+			clean++;
+		else if (!dirty)
+			dirty = ctx;
+	}
+
+	return clean < min_clean_contexts ? dirty : NULL;
+}
+
+static void iommu_context_dev_scrub(struct work_struct *work)
+{
+	struct iommu_ctx *ctx;
+
+	mutex_lock(&iommu_ctx_list_mutex);
+	while ((ctx = iommu_context_dev_scrub_candidate())) {
+		ctx->scrubbing = true;
+		mutex_unlock(&iommu_ctx_list_mutex);
+
+		dma_buf_release_stash(&ctx->pdev->dev);
+
+		mutex_lock(&iommu_ctx_list_mutex);
+		ctx->prev_identifier = NULL;
+		ctx->scrubbing = false;
+		iommu_ctx_release_seq++;
+		wake_up_all(&iommu_ctx_wq);
+	}
+	mutex_unlock(&iommu_ctx_list_mutex);
+}
 
 struct platform_device *iommu_context_dev_allocate(void *identifier)
 {
@@ -71,7 +129,8 @@ struct platform_device *iommu_context_dev_allocate(void *identifier)
 	 * the mappings stashed too
 	 */
 	list_for_each_entry(ctx, &iommu_ctx_list, list) {
-		if (!ctx->allocated && identifier == ctx->prev_identifier) {
+		if (!ctx->allocated && !ctx->scrubbing &&
+		    identifier == ctx->prev_identifier) {
 			ctx->allocated = true;
 			mutex_unlock(&iommu_ctx_list_mutex);
 			return ctx->pdev;
@@ -80,15 +139,18 @@ struct platform_device *iommu_context_dev_allocate(void *identifier)
 
 	/*
 	 * Otherwise, find a device which does not have any identifier stashed
-	 * If there is no device left without identifier stashed, use any of
-	 * the free device and explicitly remove all the stashings from it
+	 * If there is no device left without identifier stashed, use the
+	 * least recently released free device and explicitly remove all the
+	 * stashings from it
 	 */
 	list_for_each_entry(ctx, &iommu_ctx_list, list) {
-		if (!ctx->allocated && !ctx_new) {
+		if (ctx->allocated || ctx->scrubbing)
+			continue;
+		if (!ctx_new) {
 			ctx_new = ctx;
 			dirty = true;
 		}
-		if (!ctx->allocated && !ctx->prev_identifier) {
+		if (!ctx->prev_identifier) {
 			ctx_new = ctx;
 			dirty = false;
 			break;
@@ -96,17 +158,22 @@ struct platform_device *iommu_context_dev_allocate(void *identifier)
 	}
 
 	if (ctx_new) {
-		if (dirty) {
-			/*
-			 * Ensure that all stashed mappings are removed from this context device
-			 * before this context device gets reassigned to some other process
-			 */
-			dma_buf_release_stash(&ctx_new->pdev->dev);
-		}
-
 		ctx_new->prev_identifier = identifier;
 		ctx_new->allocated = true;
 		mutex_unlock(&iommu_ctx_list_mutex);
+
+		/*
+		 * Ensure that all stashed mappings are removed from this
+		 * context device before it gets reassigned to some other
+		 * process. The device is ours now, so don't hold up other
+		 * allocations meanwhile.
+		 */
+		if (dirty)
+			dma_buf_release_stash(&ctx_new->pdev->dev);
+
+		/* top the clean pool up again for the next one */
+		schedule_work(&iommu_ctx_scrub_work);
+
 		return ctx_new->pdev;
 	}
 
@@ -115,13 +182,41 @@ struct platform_device *iommu_context_dev_allocate(void *identifier)
 	return NULL;
 }
 
+/*
+ * Wait up to timeout_ms for a context device, sleeping until one is
+ * released or scrubbed instead of polling.
+ */
+struct platform_device *iommu_context_dev_allocate_wait(void *identifier,
+							unsigned int timeout_ms)
+{
+	unsigned long timeout = msecs_to_jiffies(timeout_ms);
+	struct platform_device *pdev;
+	unsigned int seq;
+
+	for (;;) {
+		seq = READ_ONCE(iommu_ctx_release_seq);
+		pdev = iommu_context_dev_allocate(identifier);
+		if (pdev || !timeout)
+			return pdev;
+
+		timeout = wait_event_timeout(iommu_ctx_wq,
+				READ_ONCE(iommu_ctx_release_seq) != seq,
+				timeout);
+	}
+}
+
 void iommu_context_dev_release(struct platform_device *pdev)
 {
 	struct iommu_ctx *ctx = platform_get_drvdata(pdev);
 
 	mutex_lock(&iommu_ctx_list_mutex);
 	ctx->allocated = false;
+	list_move_tail(&ctx->list, &iommu_ctx_list);
+	iommu_ctx_release_seq++;
 	mutex_unlock(&iommu_ctx_list_mutex);
+
+	wake_up_all(&iommu_ctx_wq);
+	schedule_work(&iommu_ctx_scrub_work);
 }
 
 static int __iommu_context_dev_map_static(struct platform_device *pdev,
@@ -267,6 +362,8 @@ static int __exit iommu_context_dev_remove(struct platform_device *pdev)
 {
 	struct iommu_ctx *ctx = platform_get_drvdata(pdev);
 
+	cancel_work_sync(&iommu_ctx_scrub_work);
+
 	mutex_lock(&iommu_ctx_list_mutex);
 	list_del(&ctx->list);
 	mutex_unlock(&iommu_ctx_list_mutex);
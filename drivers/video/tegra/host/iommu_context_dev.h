@@ -20,6 +20,8 @@
 #define IOMMU_CONTEXT_DEV_H
 
 struct platform_device *iommu_context_dev_allocate(void *identifier);
+struct platform_device *iommu_context_dev_allocate_wait(void *identifier,
+							unsigned int timeout_ms);
 void iommu_context_dev_release(struct platform_device *pdev);
 int iommu_context_dev_get_streamid(struct platform_device *pdev);
 int iommu_context_dev_map_static(void *vaddr, dma_addr_t paddr, size_t size);
@@ -107,6 +107,18 @@
 #define DLA_CMD_QUEUE_SUSPEND		12
 #define DLA_CMD_QUEUE_RESUME		13
 #define DLA_CMD_QUEUE_FLUSH		14
+#define DLA_CMD_SET_QUEUE_PRIORITY	15
+
+/*
+ * DLA_CMD_SET_QUEUE_PRIORITY method data: queue id in the low byte,
+ * priority above it. The firmware switches to a ready task of a higher
+ * priority queue at the next layer boundary of the running task.
+ */
+#define DLA_QUEUE_ID_MASK		0xff
+#define DLA_QUEUE_PRIORITY_SHIFT	8
+#define DLA_QUEUE_PRIORITY_LOW		0
+#define DLA_QUEUE_PRIORITY_NORMAL	1
+#define DLA_QUEUE_PRIORITY_HIGH		2
 
 #define DLA_ERR_NONE			0
 #define DLA_ERR_INVALID_METHOD		1
@@ -254,6 +266,7 @@ enum dla_regions_e {
 	DLA_REGION_GOS = 2,
 	DLA_REGION_TRACE = 3,
 	DLA_REGION_GCOV = 4,
+	DLA_REGION_PREEMPT = 5,
 };
 
 /**
@@ -288,6 +301,26 @@ struct dla_region_gos {
 	uint64_t address[MAX_NUM_GRIDS];
 } __attribute__ ((packed, aligned(8)));
 
+/**
+ * DLA_REGION_PREEMPT
+ *
+ * Preemption statistics kept up to date by firmware, configured with
+ * struct dla_region_printf. Latencies are in DLA timestamp units and are
+ * measured from a higher priority task becoming ready to it starting.
+ *
+ * @num_preemptions: number of times a running task was preempted
+ * @last_latency: latency of the most recent preemption
+ * @max_latency: worst case latency seen
+ * @max_latency_queue: queue that was running during the worst case
+ */
+struct dla_preempt_stats {
+	uint64_t num_preemptions;
+	uint64_t last_latency;
+	uint64_t max_latency;
+	uint32_t max_latency_queue;
+	uint32_t reserved;
+} __attribute__ ((packed, aligned(8)));
+
 /**
  * Debug Setting to be configured from host
  */
@@ -446,6 +446,60 @@ fail_alloc_trace_dma:
 	return err;
 }
 
+static int nvdla_alloc_preempt_region(struct platform_device *pdev)
+{
+	int err = 0;
+	struct nvdla_cmd_mem_info preempt_cmd_mem_info;
+	struct nvdla_cmd_data cmd_data;
+	struct dla_region_printf *preempt_region = NULL;
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvdla_device *nvdla_dev = pdata->private_data;
+
+	if (!pdata->flcn_isr)
+		return 0;
+
+	/* statistics survive firmware reboots, allocate them once */
+	if (!nvdla_dev->preempt_stats_va) {
+		nvdla_dev->preempt_stats_va = dma_alloc_attrs(&pdev->dev,
+				sizeof(struct dla_preempt_stats),
+				&nvdla_dev->preempt_stats_pa,
+				GFP_KERNEL, __DMA_ATTR(attrs));
+		if (!nvdla_dev->preempt_stats_va) {
+			nvdla_dbg_err(pdev,
+				"dma preempt memory allocation failed");
+			return -ENOMEM;
+		}
+		memset(nvdla_dev->preempt_stats_va, 0,
+			sizeof(struct dla_preempt_stats));
+	}
+
+	err = nvdla_get_cmd_memory(pdev, &preempt_cmd_mem_info);
+	if (err) {
+		nvdla_dbg_err(pdev,
+			"dma allocation failed for preempt command.");
+		return err;
+	}
+
+	preempt_region = (struct dla_region_printf *)
+				(preempt_cmd_mem_info.va);
+	preempt_region->region = DLA_REGION_PREEMPT;
+	preempt_region->address = nvdla_dev->preempt_stats_pa;
+	preempt_region->size = sizeof(struct dla_preempt_stats);
+
+	cmd_data.method_id = DLA_CMD_SET_REGIONS;
+	cmd_data.method_data = ALIGNED_DMA(preempt_cmd_mem_info.pa);
+	cmd_data.wait = true;
+
+	err = nvdla_send_cmd(pdev, &cmd_data);
+
+	nvdla_put_cmd_memory(pdev, preempt_cmd_mem_info.index);
+
+	if (err != 0)
+		nvdla_dbg_err(pdev, "failed to send preempt command");
+
+	return err;
+}
+
 static int nvdla_alloc_dump_region(struct platform_device *pdev)
 {
 	int err = 0;
@@ -506,6 +560,15 @@ static int nvdla_alloc_dump_region(struct platform_device *pdev)
 
 region_send_cmd_failed:
 set_region_failed:
+	if (nvdla_dev->preempt_stats_pa) {
+		dma_free_attrs(&pdev->dev, sizeof(struct dla_preempt_stats),
+			       nvdla_dev->preempt_stats_va,
+			       nvdla_dev->preempt_stats_pa,
+			       __DMA_ATTR(attrs));
+		nvdla_dev->preempt_stats_va = NULL;
+		nvdla_dev->preempt_stats_pa = 0;
+	}
+
 	if (nvdla_dev->debug_dump_pa) {
 		dma_free_attrs(&pdev->dev, DEBUG_BUFFER_SIZE,
 			nvdla_dev->debug_dump_va, nvdla_dev->debug_dump_pa,
@@ -654,6 +717,12 @@ int nvhost_nvdla_finalize_poweron(struct platform_device *pdev)
 		/* ignore send gos region failure */
 	}
 
+	/* older firmware has no preemption support, it is optional */
+	if (nvdla_alloc_preempt_region(pdev))
+		nvdla_dbg_info(pdev, "preemption statistics not available");
+
+	nvdla_restore_queue_attrs(pdev);
+
 	if (nvdla_dev->quirks & NVDLA_QUIRK_T194_A01_WAR) {
 		host1x_writel(pdev,
 			NVDLA_MCIF_CFG_OUTSTANDING_CNT_0_OFFSET, 0xff);
@@ -813,6 +882,15 @@ static int __exit nvdla_remove(struct platform_device *pdev)
 		nvdla_dev->trace_dump_pa = 0;
 	}
 
+	if (nvdla_dev->preempt_stats_pa) {
+		dma_free_attrs(&pdev->dev, sizeof(struct dla_preempt_stats),
+			       nvdla_dev->preempt_stats_va,
+			       nvdla_dev->preempt_stats_pa,
+			       __DMA_ATTR(attrs));
+		nvdla_dev->preempt_stats_va = NULL;
+		nvdla_dev->preempt_stats_pa = 0;
+	}
+
 	if (nvdla_dev->debug_dump_pa) {
 		dma_free_attrs(&pdev->dev, DEBUG_BUFFER_SIZE,
 			       nvdla_dev->debug_dump_va,
@@ -180,9 +180,12 @@ enum nvdla_submit_mode {
  * @debug_dump_va	virtual address of print buffer
  * @trace_dump_pa	physical address of trace buffer
  * @trace_dump_va	virtual address of trace buffer
+ * @trace_overflows	times a trace stream reader fell behind firmware
  * @en_fw_gcov		flag to enable firmware gcov
  * @gcov_dump_pa	physical address of fw gcov buffer
  * @gcov_dump_va	virtual address of fw gcovbuffer
+ * @preempt_stats_pa	physical address of fw preemption statistics
+ * @preempt_stats_va	virtual address of fw preemption statistics
  * @quirks		Tegra/DLA Hardware version specific settings
  */
 struct nvdla_device {
@@ -205,13 +208,28 @@ struct nvdla_device {
 	u32 *debug_dump_va;
 	dma_addr_t trace_dump_pa;
 	u32 *trace_dump_va;
+	u32 trace_overflows;
 	u32 en_fw_gcov;
 	dma_addr_t gcov_dump_pa;
 	u32 *gcov_dump_va;
+	dma_addr_t preempt_stats_pa;
+	struct dla_preempt_stats *preempt_stats_va;
 	u32 quirks;
 	struct work_struct reset_work;
 };
 
+/**
+ * struct nvdla_queue_attr:	queue attributes, restored on firmware boot
+ *
+ * @priority		DLA_QUEUE_PRIORITY_* of the queue
+ * @poll_us		completion polling budget, 0 for interrupt completion
+ *
+ */
+struct nvdla_queue_attr {
+	u32 priority;
+	u32 poll_us;
+};
+
 /**
  * struct nvdla_emu_task:	structure for emulator task info
  *
@@ -241,6 +259,7 @@ struct nvdla_emu_task {
  * @prefences		pointer to prefences
  * @postfences		pointer to post fences
  * @fence		fence tracking for current task
+ * @num_pinned_addresses	number of address list buffers pinned
  * @ref			Reference count for task
  * @list		List entry
  * @task_desc		DLA task desc VA
@@ -248,6 +267,9 @@ struct nvdla_emu_task {
  * @buf_size		Total size of task dma alloc
  * @timeout		max timeout to wait for task completion
  * @op_handle		pointer to handle list of operation descriptor
+ * @address_list	address list to pin, either memory_handles or the
+ *			list in the descriptor buffer. Only valid in submit.
+ * @registered_addresses	address list entries that are registered buffers
  *
  */
 struct nvdla_task {
@@ -259,11 +281,13 @@ struct nvdla_task {
 	struct nvdla_status_notify in_task_status[MAX_NUM_NVDLA_IN_TASK_STATUS];
 	struct nvdla_status_notify out_task_status[MAX_NUM_NVDLA_OUT_TASK_STATUS];
 	struct nvdla_mem_handle memory_handles[NVDLA_MAX_BUFFERS_PER_TASK];
+	const struct nvdla_mem_handle *address_list;
 	u32 num_prefences;
 	u32 num_postfences;
 	u32 num_in_task_status;
 	u32 num_out_task_status;
 	u32 num_addresses;
+	u32 num_pinned_addresses;
 	u32 fence;
 	u32 fence_counter;
 	struct kref ref;
@@ -275,6 +299,7 @@ struct nvdla_task {
 	int pool_index;
 
 	struct dma_buf *memory_dmabuf[NVDLA_MAX_BUFFERS_PER_TASK];
+	DECLARE_BITMAP(registered_addresses, NVDLA_MAX_BUFFERS_PER_TASK);
 	struct dma_buf *prefences_sem_dmabuf[MAX_NUM_NVDLA_PREFENCES];
 	struct dma_buf *in_task_status_dmabuf[MAX_NUM_NVDLA_IN_TASK_STATUS];
 	struct dma_buf *postfences_sem_dmabuf[MAX_NUM_NVDLA_POSTFENCES];
@@ -402,5 +427,6 @@ int nvdla_emulator_submit(struct nvhost_queue *queue,
 void task_free(struct kref *ref);
 int nvdla_get_postfences(struct nvhost_queue *queue, void *in_task);
 int nvdla_send_gos_region(struct platform_device *pdev);
+void nvdla_restore_queue_attrs(struct platform_device *pdev);
 
 #endif /* End of __NVHOST_NVDLA_H__ */
@@ -24,6 +24,11 @@
 #include "flcn/hw_flcn.h"
 #include "dla_os_interface.h"
 #include <linux/uaccess.h>
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/dma-attrs.h>
+#include <linux/slab.h>
+#include <linux/mm.h>
 #include <soc/tegra/fuse.h>
 #include <soc/tegra/chip-id.h>
 
@@ -36,6 +41,15 @@
  */
 #define TRACE_DATA_OFFSET	(2 * sizeof(uint32_t))
 
+/* Size of the ring that follows the header */
+#define TRACE_DATA_SIZE		(TRACE_BUFFER_SIZE - TRACE_DATA_OFFSET)
+
+/* Firmware trace categories, one bit each, see events/help */
+#define TRACE_EVENT_MASK_ALL	0x3f
+
+/* How often a blocked stream reader looks for new trace data */
+#define TRACE_STREAM_POLL_MS	10
+
 #define dla_set_trace_enable(pdev, trace_enable)		\
 	debug_set_trace_event_config(pdev, trace_enable,	\
 			DLA_SET_TRACE_ENABLE);			\
@@ -137,6 +151,139 @@ static int debug_dla_tracedump_show(struct seq_file *s, void *data)
 	return 0;
 }
 
+/*
+ * Trace stream: a reader gets the firmware trace as it is written rather
+ * than a snapshot of the ring, and the ring can be mmapped read-only for
+ * tools that parse it in place. The firmware does not count what it has
+ * written, so a reader that falls behind by more than the ring is only
+ * noticed as one overflow; it then continues from the oldest data.
+ */
+struct nvdla_trace_stream {
+	struct nvdla_device *nvdla_dev;
+	u32 pos;	/* next byte to read, offset in trace buffer */
+	u32 last_end;	/* firmware write offset at the previous read */
+};
+
+static inline u32 trace_ring_dist(u32 from, u32 to)
+{
+	return (to + TRACE_DATA_SIZE - from) % TRACE_DATA_SIZE;
+}
+
+static inline bool trace_ring_valid(u32 offset)
+{
+	return offset >= TRACE_DATA_OFFSET && offset < TRACE_BUFFER_SIZE;
+}
+
+static void trace_header_read(struct nvdla_device *nvdla_dev,
+			      u32 *start, u32 *end)
+{
+	*start = READ_ONCE(nvdla_dev->trace_dump_va[0]);
+	*end = READ_ONCE(nvdla_dev->trace_dump_va[1]);
+	/* read the data only after the offsets that cover it */
+	rmb();
+}
+
+static int debug_dla_trace_stream_open(struct inode *inode, struct file *file)
+{
+	struct nvdla_device *nvdla_dev = inode->i_private;
+	struct nvdla_trace_stream *stream;
+	u32 start, end;
+
+	if (!nvdla_dev->trace_dump_va)
+		return -ENODEV;
+
+	stream = kzalloc(sizeof(*stream), GFP_KERNEL);
+	if (!stream)
+		return -ENOMEM;
+
+	/* start with what the ring still holds */
+	trace_header_read(nvdla_dev, &start, &end);
+	stream->nvdla_dev = nvdla_dev;
+	stream->pos = trace_ring_valid(start) ? start : TRACE_DATA_OFFSET;
+	stream->last_end = trace_ring_valid(end) ? end : stream->pos;
+
+	file->private_data = stream;
+
+	return nonseekable_open(inode, file);
+}
+
+static int debug_dla_trace_stream_release(struct inode *inode,
+					  struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static ssize_t debug_dla_trace_stream_read(struct file *file,
+	char __user *buffer, size_t count, loff_t *off)
+{
+	struct nvdla_trace_stream *stream = file->private_data;
+	struct nvdla_device *nvdla_dev = stream->nvdla_dev;
+	char *bufptr = (char *)nvdla_dev->trace_dump_va;
+	u32 start, end, avail, chunk;
+	size_t copied = 0;
+
+	for (;;) {
+		trace_header_read(nvdla_dev, &start, &end);
+		if (trace_ring_valid(start) && trace_ring_valid(end)) {
+			/* unread data plus new data no longer fit the ring */
+			if (trace_ring_dist(stream->pos, stream->last_end) +
+			    trace_ring_dist(stream->last_end, end) >=
+			    TRACE_DATA_SIZE) {
+				nvdla_dev->trace_overflows++;
+				stream->pos = start;
+			}
+			stream->last_end = end;
+
+			avail = trace_ring_dist(stream->pos, end);
+			if (avail)
+				break;
+		}
+
+		if (file->f_flags & O_NONBLOCK)
+			return -EAGAIN;
+		if (msleep_interruptible(TRACE_STREAM_POLL_MS))
+			return -ERESTARTSYS;
+	}
+
+	count = min_t(size_t, count, avail);
+	while (copied < count) {
+		chunk = min_t(u32, count - copied,
+			      TRACE_BUFFER_SIZE - stream->pos);
+		if (copy_to_user(buffer + copied, bufptr + stream->pos, chunk))
+			return copied ? copied : -EFAULT;
+
+		copied += chunk;
+		stream->pos += chunk;
+		if (stream->pos == TRACE_BUFFER_SIZE)
+			stream->pos = TRACE_DATA_OFFSET;
+	}
+
+	return copied;
+}
+
+static int debug_dla_trace_stream_mmap(struct file *file,
+				       struct vm_area_struct *vma)
+{
+	struct nvdla_trace_stream *stream = file->private_data;
+	struct nvdla_device *nvdla_dev = stream->nvdla_dev;
+	size_t size = vma->vm_end - vma->vm_start;
+	DEFINE_DMA_ATTRS(attrs);
+
+	if (vma->vm_pgoff || size > TRACE_BUFFER_SIZE)
+		return -EINVAL;
+
+	/* the ring belongs to firmware, user space may only look */
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return dma_mmap_attrs(&nvdla_dev->pdev->dev, vma,
+			      nvdla_dev->trace_dump_va,
+			      nvdla_dev->trace_dump_pa, size,
+			      __DMA_ATTR(attrs));
+}
+
 static int debug_dla_enable_trace_show(struct seq_file *s, void *data)
 {
 	struct nvdla_device *nvdla_dev = (struct nvdla_device *)s->private;
@@ -161,10 +308,11 @@ static int debug_dla_eventmask_help_show(struct seq_file *s, void *data)
 			      "  BIT(1) -  Falcon\n"
 			      "  BIT(2) -  Events\n"
 			      "  BIT(3) -  Scheduler Queue\n"
-			      "  BIT(4) -  Operation Cache\n");
+			      "  BIT(4) -  Operation Cache\n"
+			      "  BIT(5) -  Layer start/end timestamps\n");
 	seq_printf(s, "%s\n", "To enable all type of tracing events,"
-			      "set all bits ( 0 - 4 ): ");
-	seq_printf(s, "%s\n\n", "  echo 31 > events_mask");
+			      "set all bits ( 0 - 5 ): ");
+	seq_printf(s, "%s\n\n", "  echo 63 > events_mask");
 	return 0;
 }
 
@@ -291,6 +439,48 @@ static int debug_dla_fw_gcov_gcda_show(struct seq_file *s, void *data)
 	return 0;
 }
 
+static int debug_dla_preempt_show(struct seq_file *s, void *data)
+{
+	struct dla_preempt_stats *stats;
+	struct nvdla_device *nvdla_dev;
+
+	if (!s)
+		return -EFAULT;
+
+	nvdla_dev = (struct nvdla_device *)s->private;
+	if (!nvdla_dev)
+		return -EFAULT;
+
+	stats = nvdla_dev->preempt_stats_va;
+	if (!stats) {
+		seq_puts(s, "not supported\n");
+		return 0;
+	}
+
+	seq_printf(s, "preemptions:       %llu\n",
+		   READ_ONCE(stats->num_preemptions));
+	seq_printf(s, "last_latency:      %llu\n",
+		   READ_ONCE(stats->last_latency));
+	seq_printf(s, "max_latency:       %llu\n",
+		   READ_ONCE(stats->max_latency));
+	seq_printf(s, "max_latency_queue: %u\n",
+		   READ_ONCE(stats->max_latency_queue));
+
+	return 0;
+}
+
+static int debug_dla_preempt_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, debug_dla_preempt_show, inode->i_private);
+}
+
+static const struct file_operations debug_dla_preempt_fops = {
+	.open		= debug_dla_preempt_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int debug_dla_enable_trace_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, debug_dla_enable_trace_show, inode->i_private);
@@ -399,7 +589,7 @@ static ssize_t debug_dla_eventmask_set(struct file *file,
 	/* get value entered by user in variable val */
 	ret = sscanf(str, "%u", &val);
 	/* Check valid values for event_mask */
-	if (ret == 1 && val <= 31)
+	if (ret == 1 && val <= TRACE_EVENT_MASK_ALL)
 		nvdla_dev->events_mask = val;
 	mutex_unlock(&p->lock);
 
@@ -409,11 +599,11 @@ static ssize_t debug_dla_eventmask_set(struct file *file,
 	}
 
 	/*
-	 * Currently only five trace categories are added,
-	 * and hence only five bits are being used to enable/disable
+	 * Currently only six trace categories are added,
+	 * and hence only six bits are being used to enable/disable
 	 * the trace categories.
 	 */
-	if (val > 31) {
+	if (val > TRACE_EVENT_MASK_ALL) {
 		nvdla_dbg_err(pdev,
 			"invalid input, please"
 			" check /d/nvdla*/firmware/trace/events/help");
@@ -658,6 +848,14 @@ static const struct file_operations debug_dla_event_trace_fops = {
 		.release	= single_release,
 };
 
+static const struct file_operations debug_dla_trace_stream_fops = {
+		.open		= debug_dla_trace_stream_open,
+		.read		= debug_dla_trace_stream_read,
+		.mmap		= debug_dla_trace_stream_mmap,
+		.llseek		= no_llseek,
+		.release	= debug_dla_trace_stream_release,
+};
+
 static const struct file_operations debug_dla_bin_event_trace_fops = {
 		.open		= debug_dla_bintrace_open,
 		.read		= seq_read,
@@ -742,6 +940,14 @@ static void dla_fw_debugfs_init(struct platform_device *pdev)
 			nvdla_dev, &debug_dla_bin_event_trace_fops))
 		goto trace_failed;
 
+	if (!debugfs_create_file("stream", S_IRUSR, fw_trace,
+			nvdla_dev, &debug_dla_trace_stream_fops))
+		goto trace_failed;
+
+	if (!debugfs_create_u32("overflows", S_IRUGO, fw_trace,
+			&nvdla_dev->trace_overflows))
+		goto trace_failed;
+
 	events = debugfs_create_dir("events", fw_trace);
 	if (!events)
 		goto event_failed;
@@ -798,6 +1004,9 @@ void nvdla_debug_init(struct platform_device *pdev)
 	debugfs_create_u32("submit_mode", S_IRUGO | S_IWUSR, de,
 			&nvdla_dev->submit_mode);
 
+	debugfs_create_file("preemption", S_IRUGO, de, nvdla_dev,
+			&debug_dla_preempt_fops);
+
 	/* Check if isolate context enabled if submit mode is CHANNEL */
 	nvdla_dev->submit_mode = nvdla_dev->submit_mode &&
 				pdata->isolate_contexts;
@@ -21,6 +21,9 @@
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
 #include <linux/uaccess.h>
+#include <linux/dma-buf.h>
+#include <linux/mutex.h>
+#include <linux/capability.h>
 
 #include "dev.h"
 #include "bus_client.h"
@@ -37,17 +40,34 @@
 #include <linux/nvhost_nvdla_ioctl.h>
 #include "dla_os_interface.h"
 
+/**
+ * struct nvdla_desc_buffer task descriptors shared with user space
+ * @dmabuf		registered buffer
+ * @va			kernel mapping of the buffer
+ * @size		size of the buffer
+ */
+struct nvdla_desc_buffer {
+	struct dma_buf *dmabuf;
+	void *va;
+	size_t size;
+};
+
 /**
  * struct nvdla_private per unique FD private data
  * @pdev		pointer to platform device
  * @queue		pointer to nvhost_queue
  * @buffers		pointer to nvhost_buffer
+ * @desc_lock		protects desc against submits in progress
+ * @desc		registered task descriptor buffer
  */
 
 struct nvdla_private {
 	struct platform_device *pdev;
 	struct nvhost_queue *queue;
 	struct nvhost_buffers *buffers;
+
+	struct mutex desc_lock;
+	struct nvdla_desc_buffer desc;
 };
 
 static int nvdla_get_fw_ver(struct nvdla_private *priv,
@@ -122,6 +142,81 @@ inval_cmd:
 	return err;
 }
 
+static int nvdla_set_queue_priority(struct nvdla_private *priv, u32 value)
+{
+	struct platform_device *pdev = priv->pdev;
+	struct nvhost_queue *queue = priv->queue;
+	struct nvdla_queue_attr *attr;
+	struct nvdla_queue_attr new_attr;
+	int err;
+
+	if (value > NVDLA_QUEUE_PRIORITY_MAX) {
+		nvdla_dbg_err(pdev, "invalid queue priority[%u]", value);
+		return -EINVAL;
+	}
+
+	if (value > NVDLA_QUEUE_PRIORITY_NORMAL && !capable(CAP_SYS_NICE))
+		return -EPERM;
+
+	err = nvhost_module_busy(pdev);
+	if (err) {
+		nvdla_dbg_err(pdev, "failed to poweron, err: %d", err);
+		return err;
+	}
+
+	mutex_lock(&queue->attr_lock);
+	attr = queue->attr;
+	new_attr = *attr;
+	/* queue priorities map directly to firmware priorities */
+	new_attr.priority = value;
+	err = nvhost_queue_set_attr(queue, &new_attr);
+	if (!err)
+		*attr = new_attr;
+	mutex_unlock(&queue->attr_lock);
+
+	nvhost_module_idle(pdev);
+
+	return err;
+}
+
+/* host side only, firmware does not know how completions are waited on */
+static int nvdla_set_queue_poll(struct nvdla_private *priv, u32 value)
+{
+	struct platform_device *pdev = priv->pdev;
+	struct nvhost_queue *queue = priv->queue;
+	int err;
+
+	mutex_lock(&queue->attr_lock);
+	err = nvhost_syncpt_set_poll_us(pdev, queue->syncpt_id, value);
+	if (!err)
+		((struct nvdla_queue_attr *)queue->attr)->poll_us = value;
+	mutex_unlock(&queue->attr_lock);
+
+	if (err)
+		nvdla_dbg_err(pdev, "invalid poll budget[%u]", value);
+
+	return err;
+}
+
+static int nvdla_set_queue_attr(struct nvdla_private *priv, void *args)
+{
+	struct nvdla_queue_attr_args *attr_arg =
+			(struct nvdla_queue_attr_args *)args;
+	struct platform_device *pdev = priv->pdev;
+
+	nvdla_dbg_fn(pdev, "");
+
+	switch (attr_arg->id) {
+	case NVDLA_QUEUE_ATTR_PRIORITY:
+		return nvdla_set_queue_priority(priv, attr_arg->value);
+	case NVDLA_QUEUE_ATTR_POLL_US:
+		return nvdla_set_queue_poll(priv, attr_arg->value);
+	default:
+		nvdla_dbg_err(pdev, "invalid queue attr[%u]", attr_arg->id);
+		return -EINVAL;
+	}
+}
+
 static int nvdla_get_q_status(struct nvdla_private *priv, void *args)
 {
 	struct nvdla_get_q_status_args *queue_arg =
@@ -269,6 +364,39 @@ fail_to_get_val_arg:
 	return err;
 }
 
+static int nvdla_register_buffer(struct nvdla_private *priv, void *arg)
+{
+	struct nvdla_buffer_args *args = (struct nvdla_buffer_args *)arg;
+	struct platform_device *pdev = priv->pdev;
+	struct dma_buf *dmabuf;
+	int err;
+
+	nvdla_dbg_fn(pdev, "");
+
+	dmabuf = dma_buf_get(args->handle);
+	if (IS_ERR_OR_NULL(dmabuf)) {
+		nvdla_dbg_err(pdev, "invalid buffer handle %u", args->handle);
+		return -EFAULT;
+	}
+
+	err = nvhost_buffer_register(priv->buffers, dmabuf, &args->id);
+	if (err)
+		nvdla_dbg_err(pdev, "failed to register buffer %d", err);
+
+	dma_buf_put(dmabuf);
+
+	return err;
+}
+
+static int nvdla_unregister_buffer(struct nvdla_private *priv, void *arg)
+{
+	struct nvdla_buffer_args *args = (struct nvdla_buffer_args *)arg;
+
+	nvdla_dbg_fn(priv->pdev, "id[%u]", args->id);
+
+	return nvhost_buffer_unregister(priv->buffers, args->id);
+}
+
 static int nvdla_ping(struct platform_device *pdev,
 			   struct nvdla_ping_args *args)
 {
@@ -335,9 +463,60 @@ fail_to_get_val_arg:
 	return err;
 }
 
+/* check that [offset, offset + size) is inside the descriptor buffer */
+static void *nvdla_desc_ptr(const struct nvdla_desc_buffer *desc,
+			    u64 offset, size_t size)
+{
+	if (offset > desc->size || size > desc->size - offset)
+		return NULL;
+
+	return desc->va + offset;
+}
+
+/*
+ * Copy task data in from user memory, or from the descriptor buffer if
+ * @desc is given, in which case @src is an offset into it.
+ */
+static int nvdla_copy_task_data(const struct nvdla_desc_buffer *desc,
+				void *dst, u64 src, size_t size)
+{
+	void *ptr;
+
+	if (!desc)
+		return copy_from_user(dst, (void __user *)(uintptr_t)src,
+				      size) ? -EFAULT : 0;
+
+	ptr = nvdla_desc_ptr(desc, src, size);
+	if (!ptr)
+		return -EINVAL;
+
+	memcpy(dst, ptr, size);
+
+	return 0;
+}
+
+static int nvdla_copy_task_data_out(const struct nvdla_desc_buffer *desc,
+				    u64 dst, const void *src, size_t size)
+{
+	void *ptr;
+
+	if (!desc)
+		return copy_to_user((void __user *)(uintptr_t)dst, src,
+				    size) ? -EFAULT : 0;
+
+	ptr = nvdla_desc_ptr(desc, dst, size);
+	if (!ptr)
+		return -EINVAL;
+
+	memcpy(ptr, src, size);
+
+	return 0;
+}
+
 /* task management API's */
 static int nvdla_get_actions(struct nvdla_ioctl_submit_task *user_task,
-			struct nvdla_task *task)
+			struct nvdla_task *task,
+			const struct nvdla_desc_buffer *desc)
 {
 	int err = 0;
 	struct platform_device *pdev = task->queue->pool->pdev;
@@ -345,39 +524,39 @@ static int nvdla_get_actions(struct nvdla_ioctl_submit_task *user_task,
 	nvdla_dbg_fn(pdev, "copying actions");
 
 	/* get pre fences */
-	if (copy_from_user(task->prefences,
-		(void __user *)user_task->prefences,
-		(task->num_prefences * sizeof(struct nvdla_fence)))) {
-		err = -EFAULT;
+	err = nvdla_copy_task_data(desc, task->prefences,
+		user_task->prefences,
+		(task->num_prefences * sizeof(struct nvdla_fence)));
+	if (err) {
 		nvdla_dbg_err(pdev, "failed to copy prefences");
 		goto fail;
 	}
 
 	/* get input task status */
-	if (copy_from_user(task->in_task_status,
-		(void __user *)user_task->input_task_status,
+	err = nvdla_copy_task_data(desc, task->in_task_status,
+		user_task->input_task_status,
 		(task->num_in_task_status *
-			sizeof(struct nvdla_status_notify)))) {
-		err = -EFAULT;
+			sizeof(struct nvdla_status_notify)));
+	if (err) {
 		nvdla_dbg_err(pdev, "failed to copy input task status");
 		goto fail;
 	}
 
 	/* get post fences */
-	if (copy_from_user(task->postfences,
-		(void __user *)user_task->postfences,
-		(task->num_postfences * sizeof(struct nvdla_fence)))) {
-		err = -EFAULT;
+	err = nvdla_copy_task_data(desc, task->postfences,
+		user_task->postfences,
+		(task->num_postfences * sizeof(struct nvdla_fence)));
+	if (err) {
 		nvdla_dbg_err(pdev, "failed to copy postfences");
 		goto fail;
 	}
 
 	/* get output task status */
-	if (copy_from_user(task->out_task_status,
-		(void __user *)user_task->output_task_status,
+	err = nvdla_copy_task_data(desc, task->out_task_status,
+		user_task->output_task_status,
 		(task->num_out_task_status *
-			sizeof(struct nvdla_status_notify)))) {
-		err = -EFAULT;
+			sizeof(struct nvdla_status_notify)));
+	if (err) {
 		nvdla_dbg_err(pdev, "failed to copy output task status");
 		goto fail;
 	}
@@ -444,14 +623,13 @@ fail:
 }
 
 static int nvdla_update_postfences(struct nvdla_task *task,
-			struct nvdla_ioctl_submit_task *user_task)
+			struct nvdla_ioctl_submit_task *user_task,
+			const struct nvdla_desc_buffer *desc)
 {
 	int err = 0, i;
 	struct platform_device *dla_pdev = task->queue->pool->pdev;
 	struct platform_device *host_pdev =
 				to_platform_device(dla_pdev->dev.parent);
-	struct nvdla_fence __user *postfences =
-		(struct nvdla_fence __user *)(uintptr_t)user_task->postfences;
 	char fence_name[32];
 
 	nvdla_dbg_fn(dla_pdev, "copy post fences for user");
@@ -486,9 +664,10 @@ static int nvdla_update_postfences(struct nvdla_task *task,
 
 	nvdla_dbg_fn(dla_pdev, "copy postfences to user");
 	/* copy post fences */
-	if (copy_to_user(postfences, task->postfences,
-		(task->num_postfences * sizeof(struct nvdla_fence)))) {
-		err = -EFAULT;
+	err = nvdla_copy_task_data_out(desc, user_task->postfences,
+		task->postfences,
+		(task->num_postfences * sizeof(struct nvdla_fence)));
+	if (err) {
 		nvdla_dbg_err(dla_pdev, "failed to copy postfences");
 		goto fail;
 	}
@@ -545,7 +724,8 @@ static int nvdla_val_task_submit_input(struct nvdla_ioctl_submit_task *in_task)
 static int nvdla_fill_task(struct nvhost_queue *queue,
 				struct nvhost_buffers *buffers,
 				struct nvdla_ioctl_submit_task *local_task,
-				struct nvdla_task *task)
+				struct nvdla_task *task,
+				const struct nvdla_desc_buffer *desc)
 {
 	void *mem;
 	int err = 0;
@@ -558,6 +738,7 @@ static int nvdla_fill_task(struct nvhost_queue *queue,
 	task->queue = queue;
 	task->buffers = buffers;
 	task->sp = &nvhost_get_host(pdev)->syncpt;
+	task->num_pinned_addresses = 0;
 
 	err = nvdla_val_task_submit_input(local_task);
 	if (err) {
@@ -577,20 +758,39 @@ static int nvdla_fill_task(struct nvhost_queue *queue,
 	mem += sizeof(struct nvdla_task);
 
 	/* update local fences into task */
-	err = nvdla_get_actions(local_task, task);
+	err = nvdla_get_actions(local_task, task, desc);
 	if (err) {
 		nvdla_dbg_err(pdev, "failed to get actions");
 		goto fail_to_get_actions;
 	}
 
-	/* get user addresses list */
-	if (copy_from_user(task->memory_handles,
-		(void __user *)local_task->address_list,
-		(task->num_addresses *
-			sizeof(struct nvdla_mem_handle)))) {
-		err = -EFAULT;
-		nvdla_dbg_err(pdev, "failed to copy address list");
-		goto fail_to_get_addr_list;
+	/*
+	 * The address list is the bulk of the task. In the descriptor
+	 * buffer it is used in place; each entry is read once when pinned.
+	 */
+	if (desc) {
+		task->address_list = nvdla_desc_ptr(desc,
+			local_task->address_list,
+			(task->num_addresses *
+				sizeof(struct nvdla_mem_handle)));
+		if (!task->address_list ||
+		    !IS_ALIGNED(local_task->address_list,
+				__alignof__(struct nvdla_mem_handle))) {
+			err = -EINVAL;
+			nvdla_dbg_err(pdev, "invalid address list offset");
+			goto fail_to_get_addr_list;
+		}
+	} else {
+		/* get user addresses list */
+		if (copy_from_user(task->memory_handles,
+			(void __user *)local_task->address_list,
+			(task->num_addresses *
+				sizeof(struct nvdla_mem_handle)))) {
+			err = -EFAULT;
+			nvdla_dbg_err(pdev, "failed to copy address list");
+			goto fail_to_get_addr_list;
+		}
+		task->address_list = task->memory_handles;
 	}
 
 	nvdla_dbg_info(pdev, "local task %p param filled with args", task);
@@ -661,8 +861,8 @@ static void nvdla_dump_task(struct nvdla_task *task)
 	for (i = 0; i < task->num_addresses; i++) {
 		nvdla_dbg_info(pdev, "Memory Handles[%d]:"
 				"handle[%u] offset[%u]",
-				i, task->memory_handles[i].handle,
-				task->memory_handles[i].offset);
+				i, task->address_list[i].handle,
+				task->address_list[i].offset);
 	}
 }
 
@@ -746,11 +946,14 @@ exit:
 	return 0;
 }
 
-static int nvdla_submit(struct nvdla_private *priv, void *arg)
+/*
+ * Submit the tasks described by @args. With @desc the tasks are read from
+ * the descriptor buffer, which the caller keeps registered meanwhile.
+ */
+static int nvdla_submit_tasks(struct nvdla_private *priv,
+			      struct nvdla_submit_args *args,
+			      const struct nvdla_desc_buffer *desc)
 {
-	struct nvdla_submit_args *args =
-			(struct nvdla_submit_args *)arg;
-	struct nvdla_ioctl_submit_task __user *user_tasks;
 	struct nvdla_ioctl_submit_task local_tasks[MAX_TASKS_PER_SUBMIT];
 	struct platform_device *pdev;
 	struct nvhost_queue *queue;
@@ -759,9 +962,6 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 	struct nvdla_task *task;
 	int err = 0, i = 0;
 
-	if (!args || !priv)
-		return -EINVAL;
-
 	pdev = priv->pdev;
 	queue = priv->queue;
 	buffers = priv->buffers;
@@ -770,9 +970,7 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 
 	nvdla_dbg_fn(pdev, "inside task submit");
 
-	user_tasks = (struct nvdla_ioctl_submit_task __user *)
-			(uintptr_t)args->tasks;
-	if (!user_tasks)
+	if (!desc && !args->tasks)
 		return -EINVAL;
 
 	num_tasks = args->num_tasks;
@@ -782,11 +980,10 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 	nvdla_dbg_info(pdev, "num of tasks [%d]", num_tasks);
 
 	/* IOCTL copy descriptors*/
-	if (copy_from_user(local_tasks, (void __user *)user_tasks,
-			(num_tasks * sizeof(*user_tasks)))) {
-		err = -EFAULT;
+	err = nvdla_copy_task_data(desc, local_tasks, args->tasks,
+			(num_tasks * sizeof(*local_tasks)));
+	if (err)
 		goto fail_to_copy_task;
-	}
 	nvdla_dbg_info(pdev, "copy of user tasks done");
 
 	for (i = 0; i < num_tasks; i++) {
@@ -801,7 +998,8 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 		nvdla_dbg_info(pdev, "task[%d] mem allocate done", i + 1);
 
 		/* fill local task param from user args */
-		err = nvdla_fill_task(queue, buffers, local_tasks + i, task);
+		err = nvdla_fill_task(queue, buffers, local_tasks + i, task,
+				      desc);
 		if (err) {
 			nvdla_dbg_err(pdev, "failed to fill task[%d]", i + 1);
 			kref_put(&task->ref, task_free);
@@ -830,7 +1028,7 @@ static int nvdla_submit(struct nvdla_private *priv, void *arg)
 		nvdla_dbg_info(pdev, "task[%d] got fences", i + 1);
 
 		/* update fences to user */
-		err = nvdla_update_postfences(task, local_tasks + i);
+		err = nvdla_update_postfences(task, local_tasks + i, desc);
 		if (err) {
 			nvdla_dbg_err(pdev, "fail update postfence%d", i + 1);
 			goto fail_to_update_postfences;
@@ -861,6 +1059,75 @@ fail_to_copy_task:
 	return err;
 }
 
+static int nvdla_submit(struct nvdla_private *priv, void *arg)
+{
+	struct nvdla_submit_args *args =
+			(struct nvdla_submit_args *)arg;
+	int err;
+
+	if (!args || !priv)
+		return -EINVAL;
+
+	if (!(args->flags & NVDLA_SUBMIT_FLAGS_DESC_BUFFER))
+		return nvdla_submit_tasks(priv, args, NULL);
+
+	/* keep the descriptor buffer mapped until the tasks are queued */
+	mutex_lock(&priv->desc_lock);
+	if (priv->desc.va)
+		err = nvdla_submit_tasks(priv, args, &priv->desc);
+	else
+		err = -EINVAL;
+	mutex_unlock(&priv->desc_lock);
+
+	return err;
+}
+
+static void nvdla_put_desc_buffer(struct nvdla_desc_buffer *desc)
+{
+	if (!desc->dmabuf)
+		return;
+
+	dma_buf_vunmap(desc->dmabuf, desc->va);
+	dma_buf_put(desc->dmabuf);
+	desc->dmabuf = NULL;
+	desc->va = NULL;
+	desc->size = 0;
+}
+
+static int nvdla_set_desc_buffer(struct nvdla_private *priv, void *arg)
+{
+	struct nvdla_desc_buffer_args *args =
+			(struct nvdla_desc_buffer_args *)arg;
+	struct platform_device *pdev = priv->pdev;
+	struct nvdla_desc_buffer desc = { };
+
+	if (args->reserved)
+		return -EINVAL;
+
+	if (args->handle) {
+		desc.dmabuf = dma_buf_get(args->handle);
+		if (IS_ERR_OR_NULL(desc.dmabuf)) {
+			nvdla_dbg_err(pdev, "invalid desc buffer handle");
+			return -EINVAL;
+		}
+
+		desc.va = dma_buf_vmap(desc.dmabuf);
+		if (!desc.va) {
+			nvdla_dbg_err(pdev, "failed to map desc buffer");
+			dma_buf_put(desc.dmabuf);
+			return -ENOMEM;
+		}
+		desc.size = desc.dmabuf->size;
+	}
+
+	mutex_lock(&priv->desc_lock);
+	nvdla_put_desc_buffer(&priv->desc);
+	priv->desc = desc;
+	mutex_unlock(&priv->desc_lock);
+
+	return 0;
+}
+
 static long nvdla_ioctl(struct file *file, unsigned int cmd,
 			unsigned long arg)
 {
@@ -913,6 +1180,18 @@ static long nvdla_ioctl(struct file *file, unsigned int cmd,
 	case NVDLA_IOCTL_EMU_TASK_SUBMIT:
 		err = nvdla_emu_task_submit(priv, (void *)buf);
 		break;
+	case NVDLA_IOCTL_SET_DESC_BUFFER:
+		err = nvdla_set_desc_buffer(priv, (void *)buf);
+		break;
+	case NVDLA_IOCTL_SET_QUEUE_ATTR:
+		err = nvdla_set_queue_attr(priv, (void *)buf);
+		break;
+	case NVDLA_IOCTL_REGISTER_BUFFER:
+		err = nvdla_register_buffer(priv, (void *)buf);
+		break;
+	case NVDLA_IOCTL_UNREGISTER_BUFFER:
+		err = nvdla_unregister_buffer(priv, (void *)buf);
+		break;
 	default:
 		nvdla_dbg_err(pdev, "invalid IOCTL CMD");
 		err = -ENOIOCTLCMD;
@@ -933,6 +1212,7 @@ static int nvdla_open(struct inode *inode, struct file *file)
 	struct platform_device *pdev = pdata->pdev;
 	struct nvdla_device *nvdla_dev = pdata->private_data;
 	struct nvdla_private *priv;
+	struct nvdla_queue_attr *attr;
 	int err = 0;
 
 	priv = kmalloc(sizeof(*priv), GFP_KERNEL);
@@ -943,6 +1223,8 @@ static int nvdla_open(struct inode *inode, struct file *file)
 
 	file->private_data = priv;
 	priv->pdev = pdev;
+	mutex_init(&priv->desc_lock);
+	memset(&priv->desc, 0, sizeof(priv->desc));
 
 	nvdla_dbg_fn(pdev, "priv:%p", priv);
 
@@ -965,10 +1247,23 @@ static int nvdla_open(struct inode *inode, struct file *file)
 		goto err_alloc_buffer;
 	}
 
+	attr = kzalloc(sizeof(*attr), GFP_KERNEL);
+	if (!attr) {
+		err = -ENOMEM;
+		goto err_alloc_attr;
+	}
+	attr->priority = DLA_QUEUE_PRIORITY_NORMAL;
+
+	mutex_lock(&priv->queue->attr_lock);
+	priv->queue->attr = attr;
+	mutex_unlock(&priv->queue->attr_lock);
+
 	return nonseekable_open(inode, file);
 
+err_alloc_attr:
+	nvhost_buffer_release(priv->buffers);
 err_alloc_buffer:
-	kfree(priv->buffers);
+	nvhost_queue_put(priv->queue);
 err_alloc_queue:
 	nvhost_module_remove_client(pdev, priv);
 err_add_client:
@@ -977,6 +1272,31 @@ err_alloc_priv:
 	return err;
 }
 
+/* put the queue back at normal priority and interrupt completion */
+static void nvdla_release_queue_attr(struct nvdla_private *priv)
+{
+	struct platform_device *pdev = priv->pdev;
+	struct nvhost_queue *queue = priv->queue;
+	struct nvdla_queue_attr *attr;
+
+	mutex_lock(&queue->attr_lock);
+	attr = queue->attr;
+	queue->attr = NULL;
+	mutex_unlock(&queue->attr_lock);
+
+	if (attr->poll_us)
+		nvhost_syncpt_set_poll_us(pdev, queue->syncpt_id, 0);
+
+	if (attr->priority != DLA_QUEUE_PRIORITY_NORMAL &&
+	    !nvhost_module_busy(pdev)) {
+		attr->priority = DLA_QUEUE_PRIORITY_NORMAL;
+		nvhost_queue_set_attr(queue, attr);
+		nvhost_module_idle(pdev);
+	}
+
+	kfree(attr);
+}
+
 static int nvdla_release(struct inode *inode, struct file *file)
 {
 	struct nvdla_private *priv = file->private_data;
@@ -985,7 +1305,9 @@ static int nvdla_release(struct inode *inode, struct file *file)
 	nvdla_dbg_fn(pdev, "priv:%p", priv);
 
 	nvhost_queue_abort(priv->queue);
+	nvdla_release_queue_attr(priv);
 	nvhost_queue_put(priv->queue);
+	nvdla_put_desc_buffer(&priv->desc);
 	nvhost_buffer_release(priv->buffers);
 	nvhost_module_remove_client(pdev, priv);
 
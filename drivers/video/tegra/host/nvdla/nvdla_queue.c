@@ -42,6 +42,9 @@
 #define NVDLA_QUEUE_ABORT_TIMEOUT	10000	/* 10 sec */
 #define NVDLA_QUEUE_ABORT_RETRY_PERIOD	500	/* 500 ms */
 
+/* address list buffers resolved per nvhost_buffer_submit_pin() call */
+#define NVDLA_ADDRESS_PIN_BATCH		32
+
 /* task management API's */
 static void nvdla_queue_dump(struct nvhost_queue *queue, struct seq_file *s)
 {
@@ -157,6 +160,43 @@ void nvdla_task_get(struct nvdla_task *task)
 	kref_get(&task->ref);
 }
 
+static void nvdla_unpin_address_batch(struct nvdla_task *task,
+				      struct dma_buf **dmabufs, u32 count)
+{
+	u32 ii;
+
+	nvhost_buffer_submit_unpin(task->buffers, dmabufs, count);
+	for (ii = 0; ii < count; ii++)
+		dma_buf_put(dmabufs[ii]);
+}
+
+static void nvdla_unpin_address_list(struct nvdla_task *task)
+{
+	struct dma_buf *batch[NVDLA_ADDRESS_PIN_BATCH];
+	u32 ii, count = 0;
+
+	for (ii = 0; ii < task->num_pinned_addresses; ii++) {
+		struct dma_buf *dmabuf = task->memory_dmabuf[ii];
+
+		if (test_and_clear_bit(ii, task->registered_addresses)) {
+			nvhost_buffer_submit_unpin_registered(task->buffers,
+							      dmabuf);
+			continue;
+		}
+
+		batch[count++] = dmabuf;
+		if (count == NVDLA_ADDRESS_PIN_BATCH) {
+			nvdla_unpin_address_batch(task, batch, count);
+			count = 0;
+		}
+	}
+
+	if (count)
+		nvdla_unpin_address_batch(task, batch, count);
+
+	task->num_pinned_addresses = 0;
+}
+
 static int nvdla_unmap_task_memory(struct nvdla_task *task)
 {
 	int ii;
@@ -166,13 +206,7 @@ static int nvdla_unmap_task_memory(struct nvdla_task *task)
 	nvdla_dbg_fn(pdev, "task:[%p]", task);
 
 	/* unpin address list */
-	for (ii = 0; ii < task->num_addresses; ii++) {
-		if (task->memory_handles[ii].handle) {
-			nvhost_buffer_submit_unpin(task->buffers,
-				&task->memory_dmabuf[ii], 1);
-			dma_buf_put(task->memory_dmabuf[ii]);
-		}
-	}
+	nvdla_unpin_address_list(task);
 	nvdla_dbg_fn(pdev, "all mem handles unmaped");
 
 	/* unpin prefences memory */
@@ -430,12 +464,103 @@ static u8 *add_gos_action(u8 *mem, uint8_t op, uint8_t index, uint16_t offset,
 	return mem + sizeof(struct dla_action_gos);
 }
 
+/*
+ * Get and pin a batch of address list buffers with a single lookup pass.
+ * Registered buffers are resolved from the registry directly and need no
+ * lookup. On failure nothing from the batch is left pinned or referenced.
+ */
+static int nvdla_pin_address_batch(struct nvdla_task *task, u32 first,
+				   u32 count, u8 **next)
+{
+	struct platform_device *pdev = task->queue->pool->pdev;
+	const struct nvdla_mem_handle *handles = &task->address_list[first];
+	struct dma_buf **dmabufs = &task->memory_dmabuf[first];
+	struct dla_mem_addr *addrs = (struct dla_mem_addr *)*next;
+	struct dma_buf *pin_bufs[NVDLA_ADDRESS_PIN_BATCH];
+	dma_addr_t pin_addr[NVDLA_ADDRESS_PIN_BATCH];
+	u32 pin_offsets[NVDLA_ADDRESS_PIN_BATCH];
+	u8 pin_index[NVDLA_ADDRESS_PIN_BATCH];
+	struct nvdla_mem_handle handle;
+	dma_addr_t dma_addr;
+	u32 ii, num_pin = 0;
+	int err;
+
+	for (ii = 0; ii < count; ii++) {
+		/* the list may be shared with user space, read it once */
+		handle.handle = READ_ONCE(handles[ii].handle);
+		handle.offset = READ_ONCE(handles[ii].offset);
+
+		nvdla_dbg_info(pdev, "count[%u] handle[%u] offset[%u]",
+				first + ii,
+				handle.handle,
+				handle.offset);
+
+		if (!handle.handle) {
+			err = -EFAULT;
+			goto fail_to_get_buf;
+		}
+
+		if (handle.handle & NVDLA_REGISTERED_HANDLE_FLAG) {
+			err = nvhost_buffer_submit_pin_registered(task->buffers,
+				handle.handle & ~NVDLA_REGISTERED_HANDLE_FLAG,
+				&dmabufs[ii], &dma_addr, NULL, NULL);
+			if (err) {
+				nvdla_dbg_err(pdev, "invalid buffer id[%u]",
+					handle.handle &
+					~NVDLA_REGISTERED_HANDLE_FLAG);
+				goto fail_to_get_buf;
+			}
+			set_bit(first + ii, task->registered_addresses);
+			addrs[ii].val = dma_addr + handle.offset;
+			continue;
+		}
+
+		dmabufs[ii] = dma_buf_get(handle.handle);
+		if (IS_ERR_OR_NULL(dmabufs[ii])) {
+			dmabufs[ii] = NULL;
+			err = -EFAULT;
+			nvdla_dbg_err(pdev, "fail to get buf");
+			goto fail_to_get_buf;
+		}
+
+		pin_bufs[num_pin] = dmabufs[ii];
+		pin_offsets[num_pin] = handle.offset;
+		pin_index[num_pin] = ii;
+		num_pin++;
+	}
+
+	if (num_pin) {
+		err = nvhost_buffer_submit_pin(task->buffers, pin_bufs,
+					       num_pin, pin_addr, NULL, NULL);
+		if (err) {
+			nvdla_dbg_err(pdev, "fail to pin address list");
+			goto fail_to_get_buf;
+		}
+	}
+
+	for (ii = 0; ii < num_pin; ii++)
+		addrs[pin_index[ii]].val = pin_addr[ii] + pin_offsets[ii];
+
+	*next += count * sizeof(struct dla_mem_addr);
+
+	return 0;
+
+fail_to_get_buf:
+	while (ii--) {
+		if (test_and_clear_bit(first + ii, task->registered_addresses))
+			nvhost_buffer_submit_unpin_registered(task->buffers,
+							      dmabufs[ii]);
+		else
+			dma_buf_put(dmabufs[ii]);
+	}
+	return err;
+}
+
 static int nvdla_map_task_memory(struct nvdla_task *task)
 {
-	int jj;
+	u32 jj, count;
 	int err = 0;
 	size_t offset;
-	struct nvhost_buffers *buffers = task->buffers;
 	struct platform_device *pdev = task->queue->pool->pdev;
 	struct dla_task_descriptor *task_desc = task->task_desc;
 	u8 *next;
@@ -457,37 +582,15 @@ static int nvdla_map_task_memory(struct nvdla_task *task)
 	task_desc->num_addresses = task->num_addresses;
 
 	/* update address list with all dma */
-	for (jj = 0; jj < task->num_addresses; jj++) {
-		dma_addr_t dma_addr;
-		size_t dma_size;
-		err = -EFAULT;
-
-		nvdla_dbg_info(pdev, "count[%d] handle[%u] offset[%u]",
-				jj,
-				task->memory_handles[jj].handle,
-				task->memory_handles[jj].offset);
+	for (jj = 0; jj < task->num_addresses; jj += count) {
+		count = min_t(u32, NVDLA_ADDRESS_PIN_BATCH,
+				task->num_addresses - jj);
 
-		if (!task->memory_handles[jj].handle)
+		err = nvdla_pin_address_batch(task, jj, count, &next);
+		if (err)
 			goto fail_to_pin_mem;
 
-		task->memory_dmabuf[jj] =
-			dma_buf_get(task->memory_handles[jj].handle);
-		if (IS_ERR_OR_NULL(task->memory_dmabuf[jj])) {
-			task->memory_dmabuf[jj] = NULL;
-			err = -EFAULT;
-			nvdla_dbg_err(pdev, "fail to get buf");
-			goto fail_to_pin_mem;
-		}
-
-		err = nvhost_buffer_submit_pin(buffers,
-				&task->memory_dmabuf[jj],
-				1, &dma_addr, &dma_size, NULL);
-		if (err) {
-			nvdla_dbg_err(pdev, "fail to pin address list");
-			goto fail_to_pin_mem;
-		}
-		next = add_address(next,
-			dma_addr + task->memory_handles[jj].offset);
+		task->num_pinned_addresses += count;
 	}
 
 fail_to_pin_mem:
@@ -774,6 +877,9 @@ static int nvdla_fill_preactions(struct nvdla_task *task)
 					break;
 				}
 
+				if (nvhost_syncpt_is_expired(sp, id, thresh))
+					continue;
+
 				/* check if GoS backing available */
 				if (!nvdla_get_gos(pdev, id, &gos_id,
 						&gos_offset)) {
@@ -799,6 +905,7 @@ static int nvdla_fill_preactions(struct nvdla_task *task)
 			break;
 		}
 		case NVDLA_FENCE_TYPE_SYNCPT: {
+			u32 id = task->prefences[i].syncpoint_index;
 			u32 gos_id, gos_offset;
 
 			nvdla_dbg_info(pdev, "i[%d] id[%d] val[%d]",
@@ -806,9 +913,19 @@ static int nvdla_fill_preactions(struct nvdla_task *task)
 					task->prefences[i].syncpoint_index,
 					task->prefences[i].syncpoint_value);
 
-			if (!nvdla_get_gos(pdev,
-				task->prefences[i].syncpoint_index, &gos_id,
-						&gos_offset)) {
+			/* the fence may come from any engine, e.g. PVA */
+			if (!nvhost_syncpt_is_valid_hw_pt_nospec(sp, &id)) {
+				nvdla_dbg_err(pdev, "Invalid syncpt[%u]",
+					task->prefences[i].syncpoint_index);
+				return -EINVAL;
+			}
+
+			/* already signalled, don't make firmware poll it */
+			if (nvhost_syncpt_is_expired(sp, id,
+					task->prefences[i].syncpoint_value))
+				break;
+
+			if (!nvdla_get_gos(pdev, id, &gos_id, &gos_offset)) {
 				nvdla_dbg_info(pdev, "pre i:%d syncpt:[%u] gos_id[%u] gos_offset[%u] val[%u]",
 					i, task->prefences[i].syncpoint_index,
 					gos_id, gos_offset,
@@ -822,8 +939,7 @@ static int nvdla_fill_preactions(struct nvdla_task *task)
 				nvdla_dbg_info(pdev, "pre i:%d GoS missing", i);
 
 				syncpt_addr = nvhost_syncpt_address(
-					queue->vm_pdev,
-					task->prefences[i].syncpoint_index);
+					queue->vm_pdev, id);
 				nvdla_dbg_info(pdev, "pre i:%d syncpt:[%u] dma_addr[%pad]",
 					i,
 					task->prefences[i].syncpoint_index,
@@ -963,7 +1079,11 @@ int nvdla_fill_task_desc(struct nvdla_task *task)
 					sizeof(struct dla_action_list);
 
 	/* fill pre actions */
-	nvdla_fill_preactions(task);
+	err = nvdla_fill_preactions(task);
+	if (err) {
+		nvdla_dbg_err(pdev, "fail to fill preactions");
+		goto fail_to_fill_preactions;
+	}
 
 	/* fill post actions */
 	nvdla_fill_postactions(task);
@@ -980,6 +1100,7 @@ int nvdla_fill_task_desc(struct nvdla_task *task)
 	return 0;
 
 fail_to_map_mem:
+fail_to_fill_preactions:
 	return err;
 }
 
@@ -1301,6 +1422,59 @@ fail_to_poweron:
 	return err;
 }
 
+/*
+ * Send the attributes in @arg (struct nvdla_queue_attr) to firmware. The
+ * caller keeps the device powered on and updates queue->attr, which is
+ * what gets restored when the firmware boots again.
+ */
+static int nvdla_queue_set_attribute(struct nvhost_queue *queue, void *arg)
+{
+	struct platform_device *pdev = queue->pool->pdev;
+	struct nvdla_queue_attr *attr = arg;
+	struct nvdla_cmd_data cmd_data;
+	int err;
+
+	nvdla_dbg_fn(pdev, "queue[%u] priority[%u]", queue->id,
+			attr->priority);
+
+	cmd_data.method_id = DLA_CMD_SET_QUEUE_PRIORITY;
+	cmd_data.method_data = (queue->id & DLA_QUEUE_ID_MASK) |
+			(attr->priority << DLA_QUEUE_PRIORITY_SHIFT);
+	cmd_data.wait = true;
+
+	err = nvdla_send_cmd(pdev, &cmd_data);
+	if (err)
+		nvdla_dbg_err(pdev, "failed to set queue[%u] priority %d",
+				queue->id, err);
+
+	return err;
+}
+
+void nvdla_restore_queue_attrs(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvdla_device *nvdla_dev = pdata->private_data;
+	struct nvhost_queue_pool *pool = nvdla_dev->pool;
+	struct nvdla_queue_attr *attr;
+	unsigned int i = 0;
+
+	if (!pool)
+		return;
+
+	mutex_lock(&pool->queue_lock);
+	for_each_set_bit_from(i, &pool->alloc_table, pool->max_queue_cnt) {
+		struct nvhost_queue *queue = &pool->queues[i];
+
+		/* firmware boots with every queue at normal priority */
+		mutex_lock(&queue->attr_lock);
+		attr = queue->attr;
+		if (attr && attr->priority != DLA_QUEUE_PRIORITY_NORMAL)
+			nvhost_queue_set_attr(queue, attr);
+		mutex_unlock(&queue->attr_lock);
+	}
+	mutex_unlock(&pool->queue_lock);
+}
+
 static int nvdla_queue_abort(struct nvhost_queue *queue)
 {
 	int err = 0, fence;
@@ -1370,6 +1544,7 @@ list_empty:
 struct nvhost_queue_ops nvdla_queue_ops = {
 	.abort = nvdla_queue_abort,
 	.submit = nvdla_queue_submit,
+	.set_attribute = nvdla_queue_set_attribute,
 	.get_task_size =  nvdla_get_task_desc_memsize,
 	.dump = nvdla_queue_dump,
 };
@@ -30,6 +30,9 @@
 #include <linux/pm.h>
 #include <linux/pm_runtime.h>
 #include <linux/reset.h>
+#include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/ktime.h>
 #include <soc/tegra/chip-id.h>
 #include <trace/events/nvhost.h>
 #include <linux/tegra_pm_domains.h>
@@ -57,6 +60,12 @@
 #define POWERGATE_DELAY 			10
 #define MAX_DEVID_LENGTH			32
 
+/* Adaptive autosuspend delay defaults, in ms */
+#define ADAPTIVE_DELAY_MIN			5
+#define ADAPTIVE_DELAY_MAX			500
+#define ADAPTIVE_DELAY_MIN_SAMPLES		8
+#define ADAPTIVE_DELAY_PERCENTILE		90
+
 static void nvhost_module_load_regs(struct platform_device *pdev, bool prod);
 static int nvhost_module_toggle_slcg(struct notifier_block *nb,
 				     unsigned long action, void *data);
@@ -148,6 +157,87 @@ void nvhost_module_reset(struct platform_device *dev, bool reboot)
 }
 EXPORT_SYMBOL(nvhost_module_reset);
 
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Pick a delay that keeps the engine powered across most of the recent idle
+ * gaps, i.e. a high percentile of them. Gaps longer than the upper bound are
+ * not worth waiting for; if they are the common case, gate as soon as
+ * allowed instead.
+ */
+static int nvhost_module_adapt_delay(struct nvhost_device_data *pdata,
+				     u32 *gaps, u32 num_gaps)
+{
+	int min = pdata->autosuspend_delay_min ?: ADAPTIVE_DELAY_MIN;
+	int max = pdata->autosuspend_delay_max ?: ADAPTIVE_DELAY_MAX;
+	int i;
+
+	sort(gaps, num_gaps, sizeof(*gaps), cmp_u32, NULL);
+
+	for (i = (num_gaps * ADAPTIVE_DELAY_PERCENTILE - 1) / 100;
+	     i >= (int)num_gaps / 2; i--) {
+		/* a little slack so that the gap is still covered */
+		u32 delay = gaps[i] + gaps[i] / 8 + 1;
+
+		if (delay <= max)
+			return max_t(int, delay, min);
+	}
+
+	return min;
+}
+
+/* Account the gap since the device last went idle, called on busy */
+static void nvhost_module_record_gap(struct platform_device *dev,
+				     bool was_active)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	u32 gaps[NVHOST_MODULE_IDLE_GAPS];
+	unsigned long flags;
+	u32 num_gaps = 0;
+	int delay;
+
+	spin_lock_irqsave(&pdata->idle_lock, flags);
+
+	if (!ktime_to_ns(pdata->idle_start)) {
+		spin_unlock_irqrestore(&pdata->idle_lock, flags);
+		return;
+	}
+
+	pdata->idle_gaps[pdata->num_idle_gaps++ % NVHOST_MODULE_IDLE_GAPS] =
+		(u32)min_t(s64, ktime_ms_delta(ktime_get(), pdata->idle_start),
+			   U32_MAX);
+	pdata->idle_start = ktime_set(0, 0);
+	if (was_active)
+		pdata->acm_stats.gaps_bridged++;
+
+	if (pdata->autosuspend_adaptive && pdata->autosuspend_delay &&
+	    pdata->num_idle_gaps >= ADAPTIVE_DELAY_MIN_SAMPLES) {
+		num_gaps = min_t(u32, pdata->num_idle_gaps,
+				 NVHOST_MODULE_IDLE_GAPS);
+		memcpy(gaps, pdata->idle_gaps, num_gaps * sizeof(*gaps));
+	}
+
+	spin_unlock_irqrestore(&pdata->idle_lock, flags);
+
+	if (num_gaps)
+		delay = nvhost_module_adapt_delay(pdata, gaps, num_gaps);
+	else if (!pdata->autosuspend_adaptive)
+		delay = pdata->autosuspend_delay;	/* back to the fixed delay */
+	else
+		return;
+
+	if (delay != READ_ONCE(pdata->autosuspend_delay_cur)) {
+		WRITE_ONCE(pdata->autosuspend_delay_cur, delay);
+		pdata->acm_stats.delay_updates++;
+		pm_runtime_set_autosuspend_delay(&dev->dev, delay);
+	}
+}
+
 void nvhost_module_busy_noresume(struct platform_device *dev)
 {
 	if (dev->dev.parent && (dev->dev.parent != &platform_bus))
@@ -159,6 +249,7 @@ void nvhost_module_busy_noresume(struct platform_device *dev)
 int nvhost_module_busy(struct platform_device *dev)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	bool was_active;
 	int ret = 0;
 
 	/* Explicitly turn on the host1x clocks
@@ -182,6 +273,7 @@ int nvhost_module_busy(struct platform_device *dev)
 
 	down_read(&pdata->busy_lock);
 
+	was_active = pm_runtime_active(&dev->dev);
 	ret = pm_runtime_get_sync(&dev->dev);
 	if (ret < 0) {
 		pm_runtime_put_noidle(&dev->dev);
@@ -192,6 +284,8 @@ int nvhost_module_busy(struct platform_device *dev)
 		return ret;
 	}
 
+	nvhost_module_record_gap(dev, was_active);
+
 	if (pdata->busy)
 		pdata->busy(dev);
 
@@ -211,12 +305,17 @@ void nvhost_module_idle_mult(struct platform_device *dev, int refs)
 {
 	int original_refs = refs;
 	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	unsigned long flags;
 
 	/* call idle callback only if the device is turned on. */
 	if (atomic_read(&dev->dev.power.usage_count) == refs &&
 	    pm_runtime_active(&dev->dev)) {
 		if (pdata->idle)
 			pdata->idle(dev);
+
+		spin_lock_irqsave(&pdata->idle_lock, flags);
+		pdata->idle_start = ktime_get();
+		spin_unlock_irqrestore(&pdata->idle_lock, flags);
 	}
 
 	while (refs--) {
@@ -559,6 +658,7 @@ static ssize_t autosuspend_delay_store(struct kobject *kobj,
 	if (ret == 1 && autosuspend_delay >= 0) {
 		mutex_lock(&pdata->lock);
 		pdata->autosuspend_delay = autosuspend_delay;
+		pdata->autosuspend_delay_cur = autosuspend_delay;
 		mutex_unlock(&pdata->lock);
 
 		pm_runtime_set_autosuspend_delay(&dev->dev,
@@ -587,6 +687,34 @@ static ssize_t autosuspend_delay_show(struct kobject *kobj,
 	return ret;
 }
 
+int nvhost_module_debug_stats_show(struct seq_file *s, void *unused)
+{
+	struct platform_device *dev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(dev);
+	struct nvhost_acm_stats *stats = &pdata->acm_stats;
+	u64 avg_us = 0;
+
+	if (stats->unpowergates)
+		avg_us = div64_u64(stats->unpowergate_us_total,
+				   stats->unpowergates);
+
+	seq_printf(s, "autosuspend_delay:     %d\n", pdata->autosuspend_delay);
+	seq_printf(s, "current_delay:         %d\n",
+		   READ_ONCE(pdata->autosuspend_delay_cur));
+	seq_printf(s, "adaptive:              %d\n",
+		   pdata->autosuspend_adaptive);
+	seq_printf(s, "delay_updates:         %llu\n", stats->delay_updates);
+	seq_printf(s, "idle_gaps:             %u\n", pdata->num_idle_gaps);
+	seq_printf(s, "gaps_bridged:          %llu\n", stats->gaps_bridged);
+	seq_printf(s, "powergates:            %llu\n", stats->powergates);
+	seq_printf(s, "unpowergates:          %llu\n", stats->unpowergates);
+	seq_printf(s, "unpowergate_us_avg:    %llu\n", avg_us);
+	seq_printf(s, "unpowergate_us_max:    %llu\n",
+		   stats->unpowergate_us_max);
+
+	return 0;
+}
+
 int nvhost_clk_get(struct platform_device *dev, char *name, struct clk **clk)
 {
 	int i;
@@ -732,6 +860,9 @@ int nvhost_module_init(struct platform_device *dev)
 		nvhost_pd_slcg_install_workaround(pdata, gpd);
 	}
 
+	spin_lock_init(&pdata->idle_lock);
+	pdata->autosuspend_delay_cur = pdata->autosuspend_delay;
+
 	/* set pm runtime delays */
 	if (pdata->autosuspend_delay) {
 		pm_runtime_set_autosuspend_delay(&dev->dev,
@@ -960,6 +1091,7 @@ static void nvhost_module_load_regs(struct platform_device *pdev, bool prod)
 
 static int nvhost_module_runtime_suspend(struct device *dev)
 {
+	struct nvhost_device_data *pdata = dev_get_drvdata(dev);
 	int err;
 
 	dev_dbg(dev, "runtime suspending");
@@ -972,11 +1104,17 @@ static int nvhost_module_runtime_suspend(struct device *dev)
 	if (err)
 		return err;
 
+	pdata->acm_stats.powergates++;
+
 	return 0;
 }
 
 static int nvhost_module_runtime_resume(struct device *dev)
 {
+	struct nvhost_device_data *pdata = dev_get_drvdata(dev);
+	struct nvhost_acm_stats *stats = &pdata->acm_stats;
+	ktime_t start = ktime_get();
+	u64 us;
 	int err;
 
 	dev_dbg(dev, "runtime resuming");
@@ -991,6 +1129,12 @@ static int nvhost_module_runtime_resume(struct device *dev)
 		return err;
 	}
 
+	us = ktime_us_delta(ktime_get(), start);
+	stats->unpowergates++;
+	stats->unpowergate_us_total += us;
+	if (us > stats->unpowergate_us_max)
+		stats->unpowergate_us_max = us;
+
 	return 0;
 }
 
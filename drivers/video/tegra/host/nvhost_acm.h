@@ -47,6 +47,9 @@ int nvhost_module_get_rate(struct platform_device *dev,
 int nvhost_module_set_rate(struct platform_device *dev, void *priv,
 		unsigned long constraint, int index, unsigned long attr);
 
+struct seq_file;
+int nvhost_module_debug_stats_show(struct seq_file *s, void *unused);
+
 int nvhost_module_do_idle(struct device *dev);
 int nvhost_module_do_unidle(struct device *dev);
 
@@ -22,6 +22,10 @@
 #include <linux/slab.h>
 #include <linux/dma-buf.h>
 #include <linux/cvnas.h>
+#include <linux/percpu.h>
+#include <linux/rcupdate.h>
+#include <linux/seq_file.h>
+#include <linux/nospec.h>
 
 #include "dev.h"
 #include "nvhost_buffer.h"
@@ -35,9 +39,13 @@
  * @addr:		Physical address of the buffer
  * @size:		Size of the buffer
  * @user_map_count:	Buffer reference count from user space
- * @submit_map_count:	Buffer reference count from task submit
- * @rb_node:		pinned buffer node
+ * @refs:		One reference while user space has the buffer pinned
+ *			plus one per task submit pin. The mapping goes away
+ *			when this drops to zero.
+ * @registered_id:	Id of the buffer if it is registered, 0 otherwise
+ * @hash_node:		pinned buffer node
  * @list_head:		List entry
+ * @rcu:		Used to free the buffer after RCU lookups are done
  *
  */
 struct nvhost_vm_buffer {
@@ -50,32 +58,37 @@ struct nvhost_vm_buffer {
 	enum nvhost_buffers_heap heap;
 
 	s32 user_map_count;
-	s32 submit_map_count;
+	atomic_t refs;
+	u32 registered_id;
 
-	struct rb_node rb_node;
+	struct hlist_node hash_node;
 	struct list_head list_head;
+	struct rcu_head rcu;
 };
 
+static DEFINE_PER_CPU(u64, nvhost_buffer_lookup_hits);
+static DEFINE_PER_CPU(u64, nvhost_buffer_lookup_misses);
+
+/*
+ * Called either with the buffer mutex held or under rcu_read_lock(). In
+ * the latter case the buffer may be going away and the caller must take
+ * a reference with atomic_inc_not_zero() before using it.
+ */
 static struct nvhost_vm_buffer *nvhost_find_map_buffer(
 		struct nvhost_buffers *nvhost_buffers, struct dma_buf *dmabuf)
 {
-	struct rb_root *root = &nvhost_buffers->rb_root;
-	struct rb_node *node = root->rb_node;
 	struct nvhost_vm_buffer *vm;
 
-	/* check in a sorted tree */
-	while (node) {
-		vm = rb_entry(node, struct nvhost_vm_buffer,
-						rb_node);
-
-		if (vm->dmabuf > dmabuf)
-			node = node->rb_left;
-		else if (vm->dmabuf != dmabuf)
-			node = node->rb_right;
-		else
+	hash_for_each_possible_rcu(nvhost_buffers->hash, vm, hash_node,
+				   (unsigned long)dmabuf) {
+		if (vm->dmabuf == dmabuf) {
+			this_cpu_inc(nvhost_buffer_lookup_hits);
 			return vm;
+		}
 	}
 
+	this_cpu_inc(nvhost_buffer_lookup_misses);
+
 	return NULL;
 }
 
@@ -83,25 +96,8 @@ static void nvhost_buffer_insert_map_buffer(
 				struct nvhost_buffers *nvhost_buffers,
 				struct nvhost_vm_buffer *new_vm)
 {
-	struct rb_node **new_node = &(nvhost_buffers->rb_root.rb_node);
-	struct rb_node *parent = NULL;
-
-	/* Figure out where to put the new node */
-	while (*new_node) {
-		struct nvhost_vm_buffer *vm =
-			rb_entry(*new_node, struct nvhost_vm_buffer,
-						rb_node);
-		parent = *new_node;
-
-		if (vm->dmabuf > new_vm->dmabuf)
-			new_node = &((*new_node)->rb_left);
-		else
-			new_node = &((*new_node)->rb_right);
-	}
-
-	/* Add new node and rebalance tree */
-	rb_link_node(&new_vm->rb_node, parent, new_node);
-	rb_insert_color(&new_vm->rb_node, &nvhost_buffers->rb_root);
+	hash_add_rcu(nvhost_buffers->hash, &new_vm->hash_node,
+		     (unsigned long)new_vm->dmabuf);
 
 	/* Add the node into a list  */
 	list_add_tail(&new_vm->list_head, &nvhost_buffers->list_head);
@@ -113,15 +109,15 @@ int nvhost_get_iova_addr(struct nvhost_buffers *nvhost_buffers,
 	struct nvhost_vm_buffer *vm;
 	int err = -EINVAL;
 
-	mutex_lock(&nvhost_buffers->mutex);
+	rcu_read_lock();
 
 	vm = nvhost_find_map_buffer(nvhost_buffers, dmabuf);
-	if (vm) {
+	if (vm && atomic_read(&vm->refs)) {
 		*addr = vm->addr;
 		err = 0;
 	}
 
-	mutex_unlock(&nvhost_buffers->mutex);
+	rcu_read_unlock();
 
 	return err;
 }
@@ -177,6 +173,7 @@ static int nvhost_buffer_map(struct platform_device *pdev,
 	vm->size = dmabuf->size;
 	vm->addr = dma_addr;
 	vm->user_map_count = 1;
+	atomic_set(&vm->refs, 1);
 
 	return err;
 
@@ -195,22 +192,64 @@ static void nvhost_free_buffers(struct kref *kref)
 	kfree(nvhost_buffers);
 }
 
+/*
+ * Forget the registration of a buffer, called with the buffer mutex held.
+ * Submits already holding a pin keep the mapping alive.
+ */
+static void nvhost_buffer_clear_registered(
+				struct nvhost_buffers *nvhost_buffers,
+				struct nvhost_vm_buffer *vm)
+{
+	if (!vm->registered_id)
+		return;
+
+	RCU_INIT_POINTER(nvhost_buffers->registered[vm->registered_id - 1],
+			 NULL);
+	vm->registered_id = 0;
+}
+
+/* Called with the buffer mutex held once the last reference is gone */
 static void nvhost_buffer_unmap(struct nvhost_buffers *nvhost_buffers,
 				struct nvhost_vm_buffer *vm)
 {
 	nvhost_dbg_fn("");
 
-	if ((vm->user_map_count != 0) || (vm->submit_map_count != 0))
-		return;
+	hash_del_rcu(&vm->hash_node);
+	list_del(&vm->list_head);
+
+	nvhost_buffer_clear_registered(nvhost_buffers, vm);
 
 	dma_buf_unmap_attachment(vm->attach, vm->sgt, DMA_BIDIRECTIONAL);
 	dma_buf_detach(vm->dmabuf, vm->attach);
 	dma_buf_put(vm->dmabuf);
 
-	rb_erase(&vm->rb_node, &nvhost_buffers->rb_root);
-	list_del(&vm->list_head);
+	/* Lockless lookups may still be looking at the node */
+	kfree_rcu(vm, rcu);
+}
 
-	kfree(vm);
+/*
+ * Drop a submit reference, called with the buffer mutex held. Returns true
+ * if this was the last reference to the buffer. A buffer still pinned by
+ * user space never loses its user reference here, even if the submit
+ * references are unbalanced.
+ */
+static bool nvhost_buffer_put_submit_ref(struct nvhost_vm_buffer *vm)
+{
+	if (vm->user_map_count) {
+		atomic_add_unless(&vm->refs, -1, 1);
+		return false;
+	}
+
+	return atomic_dec_and_test(&vm->refs);
+}
+
+/* Drop a user reference, called with the buffer mutex held */
+static bool nvhost_buffer_put_user_ref(struct nvhost_vm_buffer *vm)
+{
+	if (vm->user_map_count <= 0 || --vm->user_map_count)
+		return false;
+
+	return atomic_dec_and_test(&vm->refs);
 }
 
 struct nvhost_buffers *nvhost_buffer_init(struct platform_device *pdev)
@@ -226,7 +265,7 @@ struct nvhost_buffers *nvhost_buffer_init(struct platform_device *pdev)
 
 	nvhost_buffers->pdev = pdev;
 	mutex_init(&nvhost_buffers->mutex);
-	nvhost_buffers->rb_root = RB_ROOT;
+	hash_init(nvhost_buffers->hash);
 	INIT_LIST_HEAD(&nvhost_buffers->list_head);
 	kref_init(&nvhost_buffers->kref);
 
@@ -246,27 +285,32 @@ int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
 
 	kref_get(&nvhost_buffers->kref);
 
-	mutex_lock(&nvhost_buffers->mutex);
+	/*
+	 * Only user pin and unpin change the set of buffers, so resolve the
+	 * whole list without the mutex. A buffer whose last reference is
+	 * being dropped is treated as not pinned.
+	 */
+	rcu_read_lock();
 
 	for (i = 0; i < count; i++) {
 		vm = nvhost_find_map_buffer(nvhost_buffers, dmabufs[i]);
-		if (vm == NULL)
+		if (vm == NULL || !atomic_inc_not_zero(&vm->refs))
 			goto submit_err;
 
-		vm->submit_map_count++;
 		paddr[i] = vm->addr;
-		psize[i] = vm->size;
 
-		/* Return heap only if requested */
+		/* Return size and heap only if requested */
+		if (psize != NULL)
+			psize[i] = vm->size;
 		if (heap != NULL)
 			heap[i] = vm->heap;
 	}
 
-	mutex_unlock(&nvhost_buffers->mutex);
+	rcu_read_unlock();
 	return 0;
 
 submit_err:
-	mutex_unlock(&nvhost_buffers->mutex);
+	rcu_read_unlock();
 
 	count = i;
 
@@ -288,7 +332,9 @@ int nvhost_buffer_pin(struct nvhost_buffers *nvhost_buffers,
 	for (i = 0; i < count; i++) {
 		vm = nvhost_find_map_buffer(nvhost_buffers, dmabufs[i]);
 		if (vm) {
-			vm->user_map_count++;
+			/* Task submits may still hold the buffer */
+			if (vm->user_map_count++ == 0)
+				atomic_inc(&vm->refs);
 			continue;
 		}
 
@@ -334,9 +380,8 @@ void nvhost_buffer_submit_unpin(struct nvhost_buffers *nvhost_buffers,
 		if (vm == NULL)
 			continue;
 
-		if (vm->submit_map_count-- < 0)
-			vm->submit_map_count = 0;
-		nvhost_buffer_unmap(nvhost_buffers, vm);
+		if (nvhost_buffer_put_submit_ref(vm))
+			nvhost_buffer_unmap(nvhost_buffers, vm);
 	}
 
 	mutex_unlock(&nvhost_buffers->mutex);
@@ -358,12 +403,144 @@ void nvhost_buffer_unpin(struct nvhost_buffers *nvhost_buffers,
 		if (vm == NULL)
 			continue;
 
-		if (vm->user_map_count-- < 0)
-			vm->user_map_count = 0;
+		if (nvhost_buffer_put_user_ref(vm))
+			nvhost_buffer_unmap(nvhost_buffers, vm);
+		else if (vm->user_map_count == 0)
+			nvhost_buffer_clear_registered(nvhost_buffers, vm);
+	}
+
+	mutex_unlock(&nvhost_buffers->mutex);
+}
+
+int nvhost_buffer_register(struct nvhost_buffers *nvhost_buffers,
+			   struct dma_buf *dmabuf, u32 *id)
+{
+	struct nvhost_vm_buffer *vm;
+	int err;
+	u32 i;
+
+	err = nvhost_buffer_pin(nvhost_buffers, &dmabuf, 1);
+	if (err < 0)
+		return err;
+
+	mutex_lock(&nvhost_buffers->mutex);
+
+	vm = nvhost_find_map_buffer(nvhost_buffers, dmabuf);
+	if (WARN_ON(!vm)) {
+		err = -EINVAL;
+		goto unlock;
+	}
+
+	if (vm->registered_id) {
+		err = -EEXIST;
+		goto unpin;
+	}
+
+	for (i = 0; i < NVHOST_BUFFERS_MAX_REGISTERED; i++)
+		if (!rcu_access_pointer(nvhost_buffers->registered[i]))
+			break;
+
+	if (i == NVHOST_BUFFERS_MAX_REGISTERED) {
+		err = -ENOSPC;
+		goto unpin;
+	}
+
+	vm->registered_id = i + 1;
+	rcu_assign_pointer(nvhost_buffers->registered[i], vm);
+	*id = vm->registered_id;
+
+	mutex_unlock(&nvhost_buffers->mutex);
+
+	return 0;
+
+unpin:
+	if (nvhost_buffer_put_user_ref(vm))
 		nvhost_buffer_unmap(nvhost_buffers, vm);
+unlock:
+	mutex_unlock(&nvhost_buffers->mutex);
+	return err;
+}
+
+int nvhost_buffer_unregister(struct nvhost_buffers *nvhost_buffers, u32 id)
+{
+	struct nvhost_vm_buffer *vm;
+	int err = 0;
+
+	if (id == 0 || id > NVHOST_BUFFERS_MAX_REGISTERED)
+		return -EINVAL;
+
+	mutex_lock(&nvhost_buffers->mutex);
+
+	vm = rcu_dereference_protected(nvhost_buffers->registered[id - 1],
+			lockdep_is_held(&nvhost_buffers->mutex));
+	if (!vm) {
+		err = -EINVAL;
+		goto unlock;
 	}
 
+	nvhost_buffer_clear_registered(nvhost_buffers, vm);
+
+	if (nvhost_buffer_put_user_ref(vm))
+		nvhost_buffer_unmap(nvhost_buffers, vm);
+
+unlock:
 	mutex_unlock(&nvhost_buffers->mutex);
+	return err;
+}
+
+int nvhost_buffer_submit_pin_registered(struct nvhost_buffers *nvhost_buffers,
+					u32 id, struct dma_buf **dmabuf,
+					dma_addr_t *paddr, size_t *psize,
+					enum nvhost_buffers_heap *heap)
+{
+	struct nvhost_vm_buffer *vm;
+
+	if (id == 0 || id > NVHOST_BUFFERS_MAX_REGISTERED)
+		return -EINVAL;
+
+	id = array_index_nospec(id - 1, NVHOST_BUFFERS_MAX_REGISTERED);
+
+	rcu_read_lock();
+
+	vm = rcu_dereference(nvhost_buffers->registered[id]);
+	if (vm == NULL || !atomic_inc_not_zero(&vm->refs)) {
+		rcu_read_unlock();
+		return -EINVAL;
+	}
+
+	*dmabuf = vm->dmabuf;
+	*paddr = vm->addr;
+	if (psize != NULL)
+		*psize = vm->size;
+	if (heap != NULL)
+		*heap = vm->heap;
+
+	rcu_read_unlock();
+
+	kref_get(&nvhost_buffers->kref);
+
+	return 0;
+}
+
+void nvhost_buffer_submit_unpin_registered(
+		struct nvhost_buffers *nvhost_buffers, struct dma_buf *dmabuf)
+{
+	struct nvhost_vm_buffer *vm;
+	bool dropped;
+
+	/*
+	 * The pin keeps the buffer mapped, so unless this may be the last
+	 * reference it can be dropped without the mutex.
+	 */
+	rcu_read_lock();
+	vm = nvhost_find_map_buffer(nvhost_buffers, dmabuf);
+	dropped = vm && atomic_add_unless(&vm->refs, -1, 1);
+	rcu_read_unlock();
+
+	if (dropped)
+		kref_put(&nvhost_buffers->kref, nvhost_free_buffers);
+	else
+		nvhost_buffer_submit_unpin(nvhost_buffers, &dmabuf, 1);
 }
 
 void nvhost_buffer_release(struct nvhost_buffers *nvhost_buffers)
@@ -374,10 +551,31 @@ void nvhost_buffer_release(struct nvhost_buffers *nvhost_buffers)
 	mutex_lock(&nvhost_buffers->mutex);
 	list_for_each_entry_safe(vm, n, &nvhost_buffers->list_head,
 				 list_head) {
+		if (vm->user_map_count == 0)
+			continue;
+
 		vm->user_map_count = 0;
-		nvhost_buffer_unmap(nvhost_buffers, vm);
+		nvhost_buffer_clear_registered(nvhost_buffers, vm);
+		if (atomic_dec_and_test(&vm->refs))
+			nvhost_buffer_unmap(nvhost_buffers, vm);
 	}
 	mutex_unlock(&nvhost_buffers->mutex);
 
 	kref_put(&nvhost_buffers->kref, nvhost_free_buffers);
 }
+
+int nvhost_buffer_debug_show(struct seq_file *s, void *unused)
+{
+	u64 hits = 0, misses = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		hits += per_cpu(nvhost_buffer_lookup_hits, cpu);
+		misses += per_cpu(nvhost_buffer_lookup_misses, cpu);
+	}
+
+	seq_printf(s, "hits:   %llu\n", hits);
+	seq_printf(s, "misses: %llu\n", misses);
+
+	return 0;
+}
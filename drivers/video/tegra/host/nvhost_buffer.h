@@ -20,19 +20,30 @@
 #define __NVHOST_NVHOST_BUFFER_H__
 
 #include <linux/dma-buf.h>
+#include <linux/hashtable.h>
+
+struct seq_file;
+struct nvhost_vm_buffer;
 
 enum nvhost_buffers_heap {
 	NVHOST_BUFFERS_HEAP_DRAM = 0,
 	NVHOST_BUFFERS_HEAP_CVNAS
 };
 
+#define NVHOST_BUFFERS_HASH_BITS	8
+#define NVHOST_BUFFERS_MAX_REGISTERED	64
+
 /**
  * @brief		Information needed for buffers
  *
  * pdev			Pointer to NVHOST device
- * rb_root		RB tree root for of all the buffers used by a file pointer
+ * hash			Hash of all the buffers used by a file pointer,
+ *			keyed by dma_buf. Lookups are done under RCU.
  * list			List for traversing through all the buffers
- * mutex		Mutex for the buffer tree and the buffer list
+ * mutex		Mutex for updating the buffer hash and the buffer list
+ * registered		Buffers registered for the life of the file pointer,
+ *			indexed by id - 1. Updated under the mutex, read
+ *			under RCU.
  * kref			Reference count for the bufferlist
  *
  */
@@ -40,9 +51,11 @@ struct nvhost_buffers {
 	struct platform_device *pdev;
 
 	struct list_head list_head;
-	struct rb_root rb_root;
+	DECLARE_HASHTABLE(hash, NVHOST_BUFFERS_HASH_BITS);
 	struct mutex mutex;
 
+	struct nvhost_vm_buffer __rcu *registered[NVHOST_BUFFERS_MAX_REGISTERED];
+
 	struct kref kref;
 };
 
@@ -92,13 +105,17 @@ void nvhost_buffer_unpin(struct nvhost_buffers *nvhost_buffers,
  * @brief			Pin the mapped buffer for a task submit
  *
  * This function increased the reference count for a mapped buffer during
- * task submission.
+ * task submission. The buffers are looked up without taking the buffer
+ * mutex, so callers should pass all the buffers of a task they can gather
+ * in one call rather than one at a time. Either all the buffers get pinned
+ * or none of them.
  *
  * @param nvhost_buffers	Pointer to nvhost_buffer struct
  * @param dmabufs		Pointer to dmabuffer list
  * @param count			Number of memhandles in the list
  * @param paddr			Pointer to IOVA list
- * @param psize			Pointer to size of buffer to return
+ * @param psize			Pointer to a list of buffer sizes. This is
+ *				filled only if not NULL.
  * @param heap			Pointer to a list of heaps. This is
  *				filled by the routine.
  *
@@ -125,6 +142,66 @@ int nvhost_buffer_submit_pin(struct nvhost_buffers *nvhost_buffers,
 void nvhost_buffer_submit_unpin(struct nvhost_buffers *nvhost_buffers,
 					struct dma_buf **dmabufs, u32 count);
 
+/**
+ * @brief			Register a buffer for the life of the file
+ *
+ * The buffer is pinned with a user reference like nvhost_buffer_pin()
+ * and gets a small id. Task submits can pin it by id without looking up
+ * the memory handle, and drop the pin without taking the buffer mutex.
+ * The IOVA stays the same until the buffer is unregistered, unpinned or
+ * the buffer structure released.
+ *
+ * @param nvhost_buffers	Pointer to nvhost_buffer struct
+ * @param dmabuf		Buffer to register
+ * @param id			Returns the id of the buffer, starting at 1
+ * @return			0 on success or negative on error
+ *
+ */
+int nvhost_buffer_register(struct nvhost_buffers *nvhost_buffers,
+			   struct dma_buf *dmabuf, u32 *id);
+
+/**
+ * @brief			Unregister a buffer
+ *
+ * Drops the user reference of the registration. Tasks still holding
+ * submit pins keep the mapping until they complete.
+ *
+ * @param nvhost_buffers	Pointer to nvhost_buffer struct
+ * @param id			Id returned by nvhost_buffer_register()
+ * @return			0 on success or negative on error
+ *
+ */
+int nvhost_buffer_unregister(struct nvhost_buffers *nvhost_buffers, u32 id);
+
+/**
+ * @brief			Pin a registered buffer for a task submit
+ *
+ * @param nvhost_buffers	Pointer to nvhost_buffer struct
+ * @param id			Id returned by nvhost_buffer_register()
+ * @param dmabuf		Returns the buffer, no reference is taken
+ * @param paddr			Returns the IOVA
+ * @param psize			Returns the size if not NULL
+ * @param heap			Returns the heap if not NULL
+ * @return			0 on success or negative on error
+ *
+ */
+int nvhost_buffer_submit_pin_registered(struct nvhost_buffers *nvhost_buffers,
+					u32 id, struct dma_buf **dmabuf,
+					dma_addr_t *paddr, size_t *psize,
+					enum nvhost_buffers_heap *heap);
+
+/**
+ * @brief			Drop a pin taken by
+ *				nvhost_buffer_submit_pin_registered()
+ *
+ * @param nvhost_buffers	Pointer to nvhost_buffer struct
+ * @param dmabuf		Buffer returned by the pin
+ * @return			None
+ *
+ */
+void nvhost_buffer_submit_unpin_registered(
+		struct nvhost_buffers *nvhost_buffers, struct dma_buf *dmabuf);
+
 /**
  * @brief			Drop a user reference to buffer structure
  *
@@ -146,4 +223,14 @@ void nvhost_buffer_release(struct nvhost_buffers *nvhost_buffers);
 int nvhost_get_iova_addr(struct nvhost_buffers *nvhost_buffers,
 			struct dma_buf *dmabuf, dma_addr_t *addr);
 
+/**
+ * @brief		Show buffer lookup hit and miss counts
+ *
+ * @param s		seq_file to print to
+ * @param unused	Unused
+ * @return		0
+ *
+ */
+int nvhost_buffer_debug_show(struct seq_file *s, void *unused);
+
 #endif /*__NVHOST_NVHOST_BUFFER_H__ */
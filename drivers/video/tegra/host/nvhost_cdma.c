@@ -24,6 +24,9 @@
 #include "dev.h"
 #include "debug.h"
 #include "chip_support.h"
+#include "nvhost_scale.h"
+#include "bus_client.h"
+#include <asm/arch_timer.h>
 #include <asm/cacheflush.h>
 #include <nvhost_vm.h>
 
@@ -356,6 +359,10 @@ static void update_cdma_locked(struct nvhost_cdma *cdma)
 		/* Cancel timeout, when a buffer completes */
 		stop_cdma_timer_locked(cdma);
 
+		nvhost_scale_job_done(job->ch->dev, job->queue_ktime);
+		nvhost_channel_job_done(job);
+		nvhost_eventlib_log_job(job);
+
 		/* Drop syncpoint references from this job */
 		for (i = 0; i < job->num_syncpts; ++i)
 			nvhost_syncpt_put_ref(sp, job->sp[i].id);
@@ -523,6 +530,11 @@ int nvhost_cdma_init(struct platform_device *pdev,
 
 	INIT_LIST_HEAD(&cdma->sync_queue);
 
+	spin_lock_init(&cdma->ring.lock);
+	init_waitqueue_head(&cdma->ring.space);
+	cdma->ring.head = 0;
+	cdma->ring.tail = 0;
+
 	cdma->event = CDMA_EVENT_NONE;
 	cdma->running = false;
 	cdma->torndown = false;
@@ -574,6 +586,122 @@ int nvhost_cdma_begin(struct nvhost_cdma *cdma, struct nvhost_job *job)
 	return 0;
 }
 
+/**
+ * Set up timeout handling before the first job with a timeout is queued
+ * Lets the committer's nvhost_cdma_begin() run without failing once the job
+ * has been handed its fences.
+ */
+int nvhost_cdma_timeout_prepare(struct nvhost_cdma *cdma,
+		struct nvhost_job *job)
+{
+	int err = 0;
+
+	if (!job->timeout || cdma->timeout.initialized)
+		return 0;
+
+	down_read(&cdma->lock);
+	mutex_lock(&cdma->timeout_lock);
+	if (!cdma->timeout.initialized)
+		err = cdma_op().timeout_init(cdma, job->sp->id);
+	mutex_unlock(&cdma->timeout_lock);
+	up_read(&cdma->lock);
+
+	return err;
+}
+
+static bool nvhost_cdma_ring_full(struct nvhost_submit_ring *ring)
+{
+	return READ_ONCE(ring->head) - READ_ONCE(ring->tail) >=
+		NVHOST_SUBMIT_RING_SIZE;
+}
+
+/**
+ * Reserve a slot in the submit ring
+ * Returns with the ring lock held. Sleeps only while the ring is full, which
+ * happens when the committer is itself waiting for push buffer space.
+ */
+void nvhost_cdma_ring_lock(struct nvhost_cdma *cdma)
+	__acquires(&cdma->ring.lock)
+{
+	struct nvhost_submit_ring *ring = &cdma->ring;
+
+	spin_lock(&ring->lock);
+	while (nvhost_cdma_ring_full(ring)) {
+		spin_unlock(&ring->lock);
+		wait_event(ring->space, !nvhost_cdma_ring_full(ring));
+		spin_lock(&ring->lock);
+	}
+}
+
+/**
+ * Queue a job into the slot reserved by nvhost_cdma_ring_lock()
+ * The ring holds a job reference until the job has been committed.
+ */
+void nvhost_cdma_ring_queue_unlock(struct nvhost_cdma *cdma,
+		struct nvhost_job *job)
+	__releases(&cdma->ring.lock)
+{
+	struct nvhost_submit_ring *ring = &cdma->ring;
+
+	nvhost_job_get(job);
+	ring->jobs[ring->head & (NVHOST_SUBMIT_RING_SIZE - 1)] = job;
+	ring->head++;
+	spin_unlock(&ring->lock);
+}
+
+static struct nvhost_job *nvhost_cdma_ring_pop(struct nvhost_submit_ring *ring)
+{
+	struct nvhost_job *job = NULL;
+
+	spin_lock(&ring->lock);
+	if (ring->tail != ring->head) {
+		job = ring->jobs[ring->tail & (NVHOST_SUBMIT_RING_SIZE - 1)];
+		ring->tail++;
+	}
+	spin_unlock(&ring->lock);
+
+	return job;
+}
+
+static bool nvhost_cdma_ring_pending(struct nvhost_submit_ring *ring)
+{
+	bool pending;
+
+	spin_lock(&ring->lock);
+	pending = ring->tail != ring->head;
+	spin_unlock(&ring->lock);
+
+	return pending;
+}
+
+/**
+ * Drain the submit ring into the push buffer
+ * Only one caller at a time gets to be the committer; the others return
+ * straight away and leave their jobs to it. The committer rechecks the ring
+ * after dropping the submitlock so that a job queued while it was finishing
+ * up is not left behind.
+ */
+void nvhost_cdma_ring_commit(struct nvhost_cdma *cdma,
+		void (*commit)(struct nvhost_job *job))
+{
+	struct nvhost_channel *ch = cdma_to_channel(cdma);
+	struct nvhost_submit_ring *ring = &cdma->ring;
+	struct nvhost_job *job;
+
+	do {
+		if (!mutex_trylock(&ch->submitlock))
+			return;
+
+		while ((job = nvhost_cdma_ring_pop(ring))) {
+			wake_up(&ring->space);
+			commit(job);
+			nvhost_job_put(job);
+		}
+
+		mutex_unlock(&ch->submitlock);
+	} while (nvhost_cdma_ring_pending(ring));
+}
+
 static void trace_write_gather(struct nvhost_cdma *cdma,
 		u32 *cpuva, dma_addr_t iova,
 		u32 offset, u32 words)
@@ -648,6 +776,12 @@ void nvhost_cdma_end(struct nvhost_cdma *cdma,
 	was_idle = list_empty(&cdma->sync_queue);
 	mutex_unlock(&cdma->sync_queue_lock);
 
+	/* account the job before it can possibly be retired */
+	job->queue_ktime = ktime_get();
+	job->stage_ts.pushed = arch_counter_get_cntvct();
+	nvhost_scale_job_queued(job->ch->dev);
+	nvhost_channel_job_queued(job);
+
 	add_to_sync_queue(cdma,
 			job,
 			cdma->slots_used,
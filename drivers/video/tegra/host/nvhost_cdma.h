@@ -23,6 +23,8 @@
 
 #include <linux/sched.h>
 #include <linux/semaphore.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
 
 #include <linux/nvhost.h>
 #include <linux/list.h>
@@ -40,6 +42,10 @@ struct mem_handle;
   /* 8 bytes per slot. (This number does not include the final RESTART.) */
 #define PUSH_BUFFER_SIZE (NVHOST_GATHER_QUEUE_SIZE * 8)
 
+/* Number of jobs that may be queued for the channel committer. Must be a
+ * power of two. */
+#define NVHOST_SUBMIT_RING_SIZE 64
+
    /* 4K page containing GATHERed methods to increment channel syncpts
      * and replaces the original timed out contexts GATHER slots */
 #define SYNCPT_INCR_BUFFER_SIZE_WORDS   (4096 / sizeof(u32))
@@ -78,6 +84,20 @@ struct buffer_timeout {
 	bool allow_dependency;
 };
 
+/*
+ * Jobs get their syncpoint fences and a slot in the submit ring under the
+ * ring spinlock, so ring order is fence order. Whoever holds the channel
+ * submitlock drains the ring into the push buffer; everybody else returns
+ * as soon as their job is queued.
+ */
+struct nvhost_submit_ring {
+	spinlock_t lock;		/* orders producers */
+	struct nvhost_job *jobs[NVHOST_SUBMIT_RING_SIZE];
+	unsigned int head;		/* next slot to fill */
+	unsigned int tail;		/* next slot to commit */
+	wait_queue_head_t space;	/* signalled when a slot frees up */
+};
+
 enum cdma_event {
 	CDMA_EVENT_NONE,		/* not waiting for any event */
 	CDMA_EVENT_SYNC_QUEUE_EMPTY,	/* wait for empty sync queue */
@@ -126,9 +146,15 @@ enum cdma_event {
  * 5) nvhost_channel->submitlock
  * type : mutex
  *
- * We use this lock to serialize all submits on a channel/CDMA
- * This lock also protects interleaving of CDMA commands in case a channel is
- * shared between multiple users
+ * Held by the single committer draining nvhost_cdma->ring into the push
+ * buffer. Producers only trylock it, so this also protects interleaving of
+ * CDMA commands in case a channel is shared between multiple users
+ *
+ * 6) nvhost_cdma->ring.lock
+ * type : spinlock
+ *
+ * We use this lock to hand out syncpoint fences and ring slots in the same
+ * order. Nothing that sleeps may be called under it
  */
 
 struct nvhost_cdma {
@@ -145,6 +171,8 @@ struct nvhost_cdma {
 	struct push_buffer push_buffer;	/* channel's push buffer */
 	struct list_head sync_queue;	/* job queue */
 	struct buffer_timeout timeout;	/* channel's timeout state/wq */
+	struct nvhost_submit_ring ring;	/* jobs waiting for the committer */
+	struct work_struct virt_submit_work; /* sends jobs to vhost server */
 	struct platform_device *pdev;	/* pointer to host1x device */
 	bool running;
 	bool torndown;
@@ -165,6 +193,13 @@ int	nvhost_cdma_init(struct platform_device *pdev,
 void	nvhost_cdma_deinit(struct nvhost_cdma *cdma);
 void	nvhost_cdma_stop(struct nvhost_cdma *cdma);
 int	nvhost_cdma_begin(struct nvhost_cdma *cdma, struct nvhost_job *job);
+int	nvhost_cdma_timeout_prepare(struct nvhost_cdma *cdma,
+		struct nvhost_job *job);
+void	nvhost_cdma_ring_lock(struct nvhost_cdma *cdma);
+void	nvhost_cdma_ring_queue_unlock(struct nvhost_cdma *cdma,
+		struct nvhost_job *job);
+void	nvhost_cdma_ring_commit(struct nvhost_cdma *cdma,
+		void (*commit)(struct nvhost_job *job));
 void	nvhost_cdma_push(struct nvhost_cdma *cdma, u32 op1, u32 op2);
 void	nvhost_cdma_push_gather(struct nvhost_cdma *cdma,
 		u32 *cpuva, dma_addr_t iova,
@@ -31,6 +31,8 @@
 #include <linux/delay.h>
 #include <linux/nvhost.h>
 #include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
 #include <linux/version.h>
 #if LINUX_VERSION_CODE > KERNEL_VERSION(4, 13, 0)
 #include <linux/refcount.h>
@@ -55,7 +57,7 @@ int nvhost_alloc_channels(struct nvhost_master *host)
 	mutex_init(&host->ch_alloc_mutex);
 	max_channels = nvhost_channel_nb_channels(host);
 
-	sema_init(&host->free_channels, max_channels);
+	init_waitqueue_head(&host->free_channels_wq);
 
 	for (index = 0; index < max_channels; index++) {
 		ch = kzalloc(sizeof(*ch), GFP_KERNEL);
@@ -95,23 +97,38 @@ int nvhost_alloc_channels(struct nvhost_master *host)
 	return 0;
 }
 
+/*
+ * Check if a client of the given priority may allocate a channel. Clients
+ * below high priority have to leave host->high_prio_channels channels free,
+ * but always get at least one channel.
+ */
+static bool nvhost_channel_available(struct nvhost_master *host, u32 priority)
+{
+	int max_channels = nvhost_channel_nb_channels(host);
+	int reserved = 0;
+
+	if (priority < NVHOST_PRIORITY_HIGH)
+		reserved = min_t(int, READ_ONCE(host->high_prio_channels),
+				 max_channels - 1);
+
+	return bitmap_weight(host->allocated_channels, max_channels) <
+		max_channels - reserved;
+}
+
 /*
  * Must be called with the chlist_mutex held.
  *
- * Returns the allocated channel. If no channel could be allocated within a
- * reasonable time, returns ERR_PTR(-EBUSY). In an internal error situation,
- * returns NULL. Under normal conditions, this call will block till an existing
- * channel is freed.
+ * Returns the allocated channel. If no channel is available for the given
+ * priority, returns ERR_PTR(-EAGAIN). In an internal error situation,
+ * returns NULL.
  */
-static struct nvhost_channel* nvhost_channel_alloc(struct nvhost_master *host)
+static struct nvhost_channel *nvhost_channel_alloc(struct nvhost_master *host,
+						   u32 priority)
 {
-	int index, max_channels, err;
+	int index, max_channels;
 
-	mutex_unlock(&host->chlist_mutex);
-	err = down_timeout(&host->free_channels, msecs_to_jiffies(5000));
-	mutex_lock(&host->chlist_mutex);
-	if (err)
-		return ERR_PTR(-EBUSY);
+	if (!nvhost_channel_available(host, priority))
+		return ERR_PTR(-EAGAIN);
 
 	max_channels = nvhost_channel_nb_channels(host);
 	index = find_first_zero_bit(host->allocated_channels, max_channels);
@@ -140,7 +157,7 @@ static void nvhost_channel_free(struct nvhost_master *host,
 		WARN_ON(1);
 		return;
 	}
-	up(&host->free_channels);
+	wake_up_all(&host->free_channels_wq);
 }
 
 int nvhost_channel_remove_identifier(struct nvhost_device_data *pdata,
@@ -246,12 +263,17 @@ err_module_busy:
 	ch->identifier = NULL;
 }
 
-/* Maps free channel with device */
-int nvhost_channel_map_with_vm(struct nvhost_device_data *pdata,
+/*
+ * Maps free channel with device. Under normal conditions, this call will
+ * block till an existing channel is freed.
+ */
+static int nvhost_channel_map_prio(struct nvhost_device_data *pdata,
 			struct nvhost_channel **channel,
 			void *identifier,
-			void *vm_identifier)
+			void *vm_identifier,
+			u32 priority)
 {
+	unsigned long deadline = jiffies + msecs_to_jiffies(5000);
 	struct nvhost_master *host = NULL;
 	struct nvhost_channel *ch = NULL;
 	int max_channels = 0;
@@ -268,6 +290,7 @@ int nvhost_channel_map_with_vm(struct nvhost_device_data *pdata,
 
 	host = nvhost_get_host(pdata->pdev);
 
+retry:
 	mutex_lock(&host->ch_alloc_mutex);
 	mutex_lock(&host->chlist_mutex);
 	max_channels = nvhost_channel_nb_channels(host);
@@ -289,12 +312,29 @@ int nvhost_channel_map_with_vm(struct nvhost_device_data *pdata,
 		}
 	}
 
-	ch = nvhost_channel_alloc(host);
-	if (PTR_ERR(ch) == -EBUSY) {
-		pr_err("%s: Timeout while allocating channel\n", __func__);
+	ch = nvhost_channel_alloc(host, priority);
+	if (PTR_ERR(ch) == -EAGAIN) {
+		long remaining = (long)(deadline - jiffies);
+
 		mutex_unlock(&host->chlist_mutex);
 		mutex_unlock(&host->ch_alloc_mutex);
-		return -EBUSY;
+
+		/*
+		 * Wait without holding the allocation mutex, so that a
+		 * higher priority client is not stuck behind us. Another
+		 * thread may map the identifier meanwhile, hence retry from
+		 * the start.
+		 */
+		if (remaining <= 0 ||
+		    !wait_event_timeout(host->free_channels_wq,
+				nvhost_channel_available(host, priority),
+				remaining)) {
+			pr_err("%s: Timeout while allocating channel\n",
+			       __func__);
+			return -EBUSY;
+		}
+
+		goto retry;
 	}
 	if (!ch) {
 		pr_err("%s: Couldn't find a free channel. Sema out of sync\n",
@@ -343,6 +383,24 @@ err_alloc_vm:
 	return -ENOMEM;
 }
 
+int nvhost_channel_map_with_vm(struct nvhost_device_data *pdata,
+			struct nvhost_channel **channel,
+			void *identifier,
+			void *vm_identifier)
+{
+	return nvhost_channel_map_prio(pdata, channel, identifier,
+				       vm_identifier, NVHOST_PRIORITY_MEDIUM);
+}
+
+int nvhost_channel_map_with_prio(struct nvhost_device_data *pdata,
+			struct nvhost_channel **channel,
+			void *identifier,
+			u32 priority)
+{
+	return nvhost_channel_map_prio(pdata, channel, identifier, NULL,
+				       priority);
+}
+
 int nvhost_channel_map(struct nvhost_device_data *pdata,
 			struct nvhost_channel **channel,
 			void *identifier)
@@ -436,12 +494,145 @@ void nvhost_channel_init_gather_filter(struct platform_device *pdev,
 		channel_op(ch).init_gather_filter(pdev, ch);
 }
 
+/*
+ * Low priority jobs are held back for a bounded time while high priority
+ * jobs are queued on the same engine, so that background work does not
+ * queue up in front of the latency critical work in the engine.
+ */
 int nvhost_channel_submit(struct nvhost_job *job)
 {
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+
+	if (job->priority < NVHOST_PRIORITY_MEDIUM &&
+	    atomic_read(&pdata->high_prio_jobs))
+		wait_event_timeout(pdata->high_prio_wq,
+			!atomic_read(&pdata->high_prio_jobs),
+			msecs_to_jiffies(NVHOST_CHANNEL_LOW_PRIO_MAX_WAIT));
+
 	return channel_op(job->ch).submit(job);
 }
 EXPORT_SYMBOL(nvhost_channel_submit);
 
+void nvhost_channel_job_queued(struct nvhost_job *job)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+
+	if (job->priority >= NVHOST_PRIORITY_HIGH)
+		atomic_inc(&pdata->high_prio_jobs);
+}
+
+/*
+ * Charge a completed job to its client. Jobs of a device run on the engine
+ * one after another, so a job queued behind another one only starts once
+ * that one is done.
+ */
+static void nvhost_channel_account_job(struct nvhost_device_data *pdata,
+				       struct nvhost_job *job)
+{
+	struct nvhost_client_usage *usage = job->usage;
+	ktime_t now = ktime_get();
+	ktime_t start = job->queue_ktime;
+	s64 busy_ns;
+
+	spin_lock(&pdata->client_usage_lock);
+
+	if (ktime_after(pdata->last_job_done, start))
+		start = pdata->last_job_done;
+	pdata->last_job_done = now;
+
+	busy_ns = max_t(s64, ktime_to_ns(ktime_sub(now, start)), 0);
+	pdata->busy_ns += busy_ns;
+	if (usage) {
+		usage->busy_ns += busy_ns;
+		usage->num_jobs++;
+	}
+
+	spin_unlock(&pdata->client_usage_lock);
+}
+
+void nvhost_channel_job_done(struct nvhost_job *job)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+
+	if (job->priority >= NVHOST_PRIORITY_HIGH &&
+	    atomic_dec_and_test(&pdata->high_prio_jobs))
+		wake_up_all(&pdata->high_prio_wq);
+
+	nvhost_channel_account_job(pdata, job);
+}
+
+struct nvhost_client_usage *nvhost_client_usage_alloc(
+			struct platform_device *pdev, int clientid)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_client_usage *usage;
+
+	usage = kzalloc(sizeof(*usage), GFP_KERNEL);
+	if (!usage)
+		return NULL;
+
+	kref_init(&usage->ref);
+	usage->pdev = pdev;
+	usage->pid = task_tgid_nr(current);
+	usage->clientid = clientid;
+
+	spin_lock(&pdata->client_usage_lock);
+	list_add_tail(&usage->node, &pdata->client_usage_list);
+	spin_unlock(&pdata->client_usage_lock);
+
+	return usage;
+}
+
+void nvhost_client_usage_get(struct nvhost_client_usage *usage)
+{
+	kref_get(&usage->ref);
+}
+
+static void nvhost_client_usage_release(struct kref *ref)
+{
+	struct nvhost_client_usage *usage =
+		container_of(ref, struct nvhost_client_usage, ref);
+	struct nvhost_device_data *pdata = platform_get_drvdata(usage->pdev);
+
+	spin_lock(&pdata->client_usage_lock);
+	list_del(&usage->node);
+	spin_unlock(&pdata->client_usage_lock);
+
+	kfree(usage);
+}
+
+void nvhost_client_usage_put(struct nvhost_client_usage *usage)
+{
+	kref_put(&usage->ref, nvhost_client_usage_release);
+}
+
+int nvhost_client_usage_debug_show(struct seq_file *s, void *unused)
+{
+	struct platform_device *pdev = s->private;
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_client_usage *usage;
+	u64 total;
+
+	seq_printf(s, "%8s %8s %16s %10s %6s\n",
+		   "pid", "client", "busy_us", "jobs", "share");
+
+	spin_lock(&pdata->client_usage_lock);
+
+	total = pdata->busy_ns;
+	list_for_each_entry(usage, &pdata->client_usage_list, node)
+		seq_printf(s, "%8d %8d %16llu %10llu %5llu%%\n",
+			   usage->pid, usage->clientid,
+			   div_u64(usage->busy_ns, NSEC_PER_USEC),
+			   usage->num_jobs,
+			   total ? div64_u64(usage->busy_ns * 100, total) : 0);
+
+	seq_printf(s, "total busy_us: %llu\n", div_u64(total, NSEC_PER_USEC));
+
+	spin_unlock(&pdata->client_usage_lock);
+
+	return 0;
+}
+
 void nvhost_getchannel(struct nvhost_channel *ch)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(ch->dev);
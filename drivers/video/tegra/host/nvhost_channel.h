@@ -33,6 +33,7 @@
 struct nvhost_master;
 struct platform_device;
 struct nvhost_channel;
+struct seq_file;
 
 struct nvhost_channel_ops {
 	const char *soc_name;
@@ -66,6 +67,21 @@ struct nvhost_channel {
 	void *identifier;
 };
 
+/*
+ * Engine time used by the jobs of one client (channel fd). Held by the
+ * client and by each of its jobs, so that jobs finishing after the fd is
+ * closed are still accounted.
+ */
+struct nvhost_client_usage {
+	struct kref ref;
+	struct list_head node;		/* entry in pdata->client_usage_list */
+	struct platform_device *pdev;
+	pid_t pid;
+	int clientid;
+	u64 busy_ns;
+	u64 num_jobs;
+};
+
 #define channel_op(ch)		(ch->ops)
 
 int nvhost_alloc_channels(struct nvhost_master *host);
@@ -100,6 +116,26 @@ int nvhost_channel_map_with_vm(struct nvhost_device_data *pdata,
 			void *identifier,
 			void *vm_identifier);
 
+/*
+ * Map a channel for a client of the given NVHOST_PRIORITY_* level. Only
+ * high priority clients may take the last host->high_prio_channels free
+ * channels.
+ */
+int nvhost_channel_map_with_prio(struct nvhost_device_data *pdata,
+			struct nvhost_channel **channel,
+			void *identifier,
+			u32 priority);
+
+/* Track high priority jobs from the time they are queued to completion */
+void nvhost_channel_job_queued(struct nvhost_job *job);
+void nvhost_channel_job_done(struct nvhost_job *job);
+
+struct nvhost_client_usage *nvhost_client_usage_alloc(
+			struct platform_device *pdev, int clientid);
+void nvhost_client_usage_get(struct nvhost_client_usage *usage);
+void nvhost_client_usage_put(struct nvhost_client_usage *usage);
+int nvhost_client_usage_debug_show(struct seq_file *s, void *unused);
+
 int nvhost_channel_nb_channels(struct nvhost_master *host);
 int nvhost_channel_ch_base(struct nvhost_master *host);
 int nvhost_channel_ch_limit(struct nvhost_master *host);
@@ -28,6 +28,7 @@
 
 #include <linux/interrupt.h>
 #include <linux/slab.h>
+#include <asm/arch_timer.h>
 #include <linux/irq.h>
 #include <trace/events/nvhost.h>
 
@@ -79,42 +80,76 @@ int nvhost_intr_release_time(void *ref, struct nvhost_timespec *ts)
 }
 
 /**
- * add a waiter to a waiter queue, sorted by threshold
- * returns true if it was added at the head of the queue
+ * add a waiter to the syncpt wait tree, ordered by threshold. Waiters with
+ * equal thresholds are kept in the order they were added.
+ * returns true if it became the first waiter
  */
 static bool add_waiter_to_queue(struct nvhost_waitlist *waiter,
-				struct list_head *queue)
+				struct nvhost_intr_syncpt *syncpt)
 {
-	struct nvhost_waitlist *pos;
+	struct rb_node **p = &syncpt->wait_tree.rb_node;
+	struct rb_node *parent = NULL;
 	u32 thresh = waiter->thresh;
-
-	list_for_each_entry_reverse(pos, queue, list)
-		if ((s32)(pos->thresh - thresh) <= 0) {
-			list_add(&waiter->list, &pos->list);
-			return false;
+	bool first = true;
+
+	while (*p) {
+		struct nvhost_waitlist *pos;
+
+		parent = *p;
+		pos = rb_entry(parent, struct nvhost_waitlist, node);
+		if ((s32)(thresh - pos->thresh) < 0) {
+			p = &parent->rb_left;
+		} else {
+			p = &parent->rb_right;
+			first = false;
 		}
+	}
+
+	rb_link_node(&waiter->node, parent, p);
+	rb_insert_color(&waiter->node, &syncpt->wait_tree);
+
+	if (first)
+		syncpt->wait_first = &waiter->node;
+
+	return first;
+}
+
+static void remove_waiter_from_queue(struct nvhost_waitlist *waiter,
+				     struct nvhost_intr_syncpt *syncpt)
+{
+	if (syncpt->wait_first == &waiter->node)
+		syncpt->wait_first = rb_next(&waiter->node);
+
+	rb_erase(&waiter->node, &syncpt->wait_tree);
+	RB_CLEAR_NODE(&waiter->node);
+}
 
-	list_add(&waiter->list, queue);
-	return true;
+static inline bool wait_queue_empty(struct nvhost_intr_syncpt *syncpt)
+{
+	return RB_EMPTY_ROOT(&syncpt->wait_tree);
 }
 
 /**
- * run through a waiter queue for a single sync point ID
- * and gather all completed waiters into lists by actions
+ * remove all completed waiters from the head of the syncpt wait tree in
+ * one pass and gather them into lists by actions
  */
-static void remove_completed_waiters(struct list_head *head, u32 sync,
-			struct nvhost_timespec isr_recv,
+static void remove_completed_waiters(struct nvhost_intr_syncpt *syncpt,
+			u32 sync, struct nvhost_timespec isr_recv,
 			struct list_head *completed[NVHOST_INTR_ACTION_COUNT])
 {
 	struct list_head *dest;
-	struct nvhost_waitlist *waiter, *next, *prev;
+	struct nvhost_waitlist *waiter, *prev;
 
-	list_for_each_entry_safe(waiter, next, head, list) {
+	while (syncpt->wait_first) {
 		bool removed = false;
 
+		waiter = rb_entry(syncpt->wait_first,
+				  struct nvhost_waitlist, node);
 		if ((s32)(waiter->thresh - sync) > 0)
 			break;
 
+		remove_waiter_from_queue(waiter, syncpt);
+
 		waiter->isr_recv = isr_recv;
 		dest = *(completed + waiter->action);
 
@@ -137,18 +172,18 @@ static void remove_completed_waiters(struct list_head *head, u32 sync,
 		if ((atomic_inc_return(&waiter->state) == WLS_HANDLED)
 								|| removed) {
 			atomic_set(&waiter->state, WLS_CLEANUP);
-			list_move(&waiter->list, dest);
+			list_add(&waiter->list, dest);
 		} else
-			list_move_tail(&waiter->list, dest);
+			list_add_tail(&waiter->list, dest);
 	}
 }
 
 static void reset_threshold_interrupt(struct nvhost_intr *intr,
-			       struct list_head *head,
+			       struct nvhost_intr_syncpt *syncpt,
 			       unsigned int id)
 {
-	u32 thresh = list_first_entry(head,
-				struct nvhost_waitlist, list)->thresh;
+	u32 thresh = rb_entry(syncpt->wait_first,
+				struct nvhost_waitlist, node)->thresh;
 
 	intr_op().set_syncpt_threshold(intr, id, thresh);
 	intr_op().enable_syncpt_intr(intr, id);
@@ -288,18 +323,17 @@ static int process_wait_list(struct nvhost_intr *intr,
 		completed[i] = syncpt->low_prio_handlers + j;
 
 	/* this functions fills completed data */
-	remove_completed_waiters(&syncpt->wait_head, threshold,
+	remove_completed_waiters(syncpt, threshold,
 		syncpt->isr_recv, completed);
 
 	/* check if there are still waiters left */
-	empty = list_empty(&syncpt->wait_head);
+	empty = wait_queue_empty(syncpt);
 
 	/* if not, disable interrupt. If yes, update the inetrrupt */
 	if (empty)
 		intr_op().disable_syncpt_intr(intr, syncpt->id);
 	else
-		reset_threshold_interrupt(intr, &syncpt->wait_head,
-					  syncpt->id);
+		reset_threshold_interrupt(intr, syncpt, syncpt->id);
 
 	/* remove low priority handlers from this list */
 	for (i = NVHOST_INTR_HIGH_PRIO_COUNT;
@@ -361,6 +395,8 @@ void nvhost_syncpt_thresh_fn(void *dev_id)
 	struct nvhost_master *dev = intr_to_dev(intr);
 	int err;
 
+	syncpt->thresh_ts = arch_counter_get_cntvct();
+
 	/* make sure host1x is powered */
 	err = nvhost_module_busy(dev->dev);
 	if (err) {
@@ -368,10 +404,12 @@ void nvhost_syncpt_thresh_fn(void *dev_id)
 		return;
 	}
 
-	if (nvhost_dev_is_virtual(dev->dev))
-		(void)process_wait_list(intr, syncpt,
-				nvhost_syncpt_read_min(&dev->syncpt, id));
-	else
+	if (nvhost_dev_is_virtual(dev->dev)) {
+		u32 val = nvhost_syncpt_read_min(&dev->syncpt, id);
+
+		nvhost_syncpt_update_shadow(&dev->syncpt, id, val);
+		(void)process_wait_list(intr, syncpt, val);
+	} else
 		(void)process_wait_list(intr, syncpt,
 				nvhost_syncpt_update_min(&dev->syncpt, id));
 
@@ -389,17 +427,20 @@ bool nvhost_intr_has_pending_jobs(struct nvhost_intr *intr, u32 id,
 {
 	struct nvhost_intr_syncpt *syncpt;
 	struct nvhost_waitlist *waiter;
+	struct rb_node *node;
 	bool res = false;
 
 	syncpt = intr->syncpt + id;
 	spin_lock(&syncpt->lock);
-	list_for_each_entry(waiter, &syncpt->wait_head, list)
+	for (node = syncpt->wait_first; node; node = rb_next(node)) {
+		waiter = rb_entry(node, struct nvhost_waitlist, node);
 		if (((waiter->action ==
 			NVHOST_INTR_ACTION_SUBMIT_COMPLETE) &&
 			(waiter->data != exclude_data))) {
 			res = true;
 			break;
 		}
+	}
 
 	spin_unlock(&syncpt->lock);
 
@@ -427,6 +468,7 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 		return err;
 
 	/* initialize a new waiter */
+	RB_CLEAR_NODE(&waiter->node);
 	INIT_LIST_HEAD(&waiter->list);
 	init_waitqueue_head(&waiter->wq);
 	kref_init(&waiter->refcount);
@@ -443,9 +485,9 @@ int nvhost_intr_add_action(struct nvhost_intr *intr, u32 id, u32 thresh,
 
 	spin_lock(&syncpt->lock);
 
-	queue_was_empty = list_empty(&syncpt->wait_head);
+	queue_was_empty = wait_queue_empty(syncpt);
 
-	if (add_waiter_to_queue(waiter, &syncpt->wait_head)) {
+	if (add_waiter_to_queue(waiter, syncpt)) {
 		/* added at head of list - new threshold value */
 		intr_op().set_syncpt_threshold(intr, id, thresh);
 
@@ -586,7 +628,8 @@ int nvhost_intr_init(struct nvhost_intr *intr, u32 irq_gen, u32 irq_sync)
 		syncpt->intr = &host->intr;
 		syncpt->id = id;
 		spin_lock_init(&syncpt->lock);
-		INIT_LIST_HEAD(&syncpt->wait_head);
+		syncpt->wait_tree = RB_ROOT;
+		syncpt->wait_first = NULL;
 		snprintf(syncpt->thresh_irq_name,
 			sizeof(syncpt->thresh_irq_name),
 			"host_sp_%02d", id);
@@ -636,19 +679,22 @@ int nvhost_intr_stop(struct nvhost_intr *intr)
 	for (id = 0, syncpt = intr->syncpt;
 	     id < nb_pts;
 	     ++id, ++syncpt) {
-		struct nvhost_waitlist *waiter, *next;
+		struct nvhost_waitlist *waiter;
+		struct rb_node *node, *next;
 
 		intr_op().disable_syncpt_intr(intr, id);
 
-		list_for_each_entry_safe(waiter, next, &syncpt->wait_head, list) {
+		for (node = syncpt->wait_first; node; node = next) {
+			next = rb_next(node);
+			waiter = rb_entry(node, struct nvhost_waitlist, node);
 			if (atomic_cmpxchg(&waiter->state, WLS_CANCELLED, WLS_HANDLED)
 				== WLS_CANCELLED) {
-				list_del(&waiter->list);
+				remove_waiter_from_queue(waiter, syncpt);
 				kref_put(&waiter->refcount, waiter_release);
 			}
 		}
 
-		if (!list_empty(&syncpt->wait_head)) {  /* output diagnostics */
+		if (!wait_queue_empty(syncpt)) {  /* output diagnostics */
 			intr_op().enable_syncpt_intr(intr, id);
 			mutex_unlock(&intr->mutex);
 			return -EBUSY;
@@ -25,6 +25,7 @@
 #include <linux/sort.h>
 #include <linux/scatterlist.h>
 #include <trace/events/nvhost.h>
+#include <linux/nvhost_ioctl.h>
 #include "nvhost_channel.h"
 #include "nvhost_vm.h"
 #include "nvhost_job.h"
@@ -35,6 +36,81 @@
 /* Magic to use to fill freed handle slots */
 #define BAD_MAGIC 0xdeadbeef
 
+/*
+ * Jobs are allocated from size classed caches, larger ones fall back to
+ * vzalloc. Most submits have a handful of gathers and relocs and fit in
+ * the smaller classes.
+ */
+#define NVHOST_JOB_MIN_CACHE_SHIFT	10
+#define NVHOST_JOB_NUM_CACHES		5
+
+static struct kmem_cache *job_caches[NVHOST_JOB_NUM_CACHES];
+
+static int job_size_class(size_t size)
+{
+	int i;
+
+	for (i = 0; i < NVHOST_JOB_NUM_CACHES; i++)
+		if (size <= (1UL << (NVHOST_JOB_MIN_CACHE_SHIFT + i)))
+			return i;
+
+	return -1;
+}
+
+int nvhost_job_init_caches(void)
+{
+	int i;
+
+	for (i = 0; i < NVHOST_JOB_NUM_CACHES; i++) {
+		size_t size = 1UL << (NVHOST_JOB_MIN_CACHE_SHIFT + i);
+		char name[24];
+
+		snprintf(name, sizeof(name), "nvhost_job_%zuk", size >> 10);
+		job_caches[i] = kmem_cache_create(name, size, 8,
+						  SLAB_HWCACHE_ALIGN, NULL);
+		if (!job_caches[i]) {
+			nvhost_job_deinit_caches();
+			return -ENOMEM;
+		}
+	}
+
+	return 0;
+}
+
+void nvhost_job_deinit_caches(void)
+{
+	int i;
+
+	for (i = 0; i < NVHOST_JOB_NUM_CACHES; i++) {
+		kmem_cache_destroy(job_caches[i]);
+		job_caches[i] = NULL;
+	}
+}
+
+static void *job_mem_alloc(size_t size)
+{
+	int class = job_size_class(size);
+
+	if (class >= 0 && job_caches[class])
+		return kmem_cache_zalloc(job_caches[class], GFP_KERNEL);
+	if (size <= PAGE_SIZE)
+		return kzalloc(size, GFP_KERNEL);
+
+	return vzalloc(size);
+}
+
+static void job_mem_free(void *mem, size_t size)
+{
+	int class = job_size_class(size);
+
+	if (class >= 0 && job_caches[class])
+		kmem_cache_free(job_caches[class], mem);
+	else if (size <= PAGE_SIZE)
+		kfree(mem);
+	else
+		vfree(mem);
+}
+
 static size_t job_size(u32 num_cmdbufs, u32 num_relocs, u32 num_waitchks,
 			u32 num_syncpts)
 {
@@ -109,10 +185,7 @@ struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 		nvhost_err(&pdata->pdev->dev, "empty job requested");
 		return NULL;
 	}
-	if(size <= PAGE_SIZE)
-		job = kzalloc(size, GFP_KERNEL);
-	else
-		job = vzalloc(size);
+	job = job_mem_alloc(size);
 	if (!job) {
 		nvhost_err(&pdata->pdev->dev, "failed to allocate job");
 		return NULL;
@@ -121,6 +194,7 @@ struct nvhost_job *nvhost_job_alloc(struct nvhost_channel *ch,
 	kref_init(&job->ref);
 	job->ch = ch;
 	job->size = size;
+	job->priority = NVHOST_PRIORITY_MEDIUM;
 
 	init_fields(job, num_cmdbufs, num_relocs, num_waitchks, num_syncpts);
 
@@ -166,10 +240,9 @@ static void job_free(struct kref *ref)
 
 	if (job->error_notifier_ref)
 		dma_buf_put(job->error_notifier_ref);
-	if (job->size <= PAGE_SIZE)
-		kfree(job);
-	else
-		vfree(job);
+	if (job->usage)
+		nvhost_client_usage_put(job->usage);
+	job_mem_free(job, job->size);
 }
 
 void nvhost_job_put(struct nvhost_job *job)
@@ -339,15 +412,15 @@ static int id_cmp(const void *_id1, const void *_id2)
 }
 
 static int pin_array_ids(struct platform_device *dev,
+		struct nvhost_pin_cache *cache,
 		struct nvhost_pinid *ids,
 		dma_addr_t *phys_addr,
 		u32 count,
 		struct nvhost_job_unpin *unpin_data)
 {
 	int i, pin_count = 0;
-	struct sg_table *sgt;
+	struct nvhost_pin_cache_entry *entry;
 	struct dma_buf *buf;
-	struct dma_buf_attachment *attach;
 	u32 prev_id = 0;
 	dma_addr_t prev_addr = 0;
 	int err = 0;
@@ -370,55 +443,26 @@ static int pin_array_ids(struct platform_device *dev,
 			goto clean_up;
 		}
 
-		attach = dma_buf_attach(buf, &dev->dev);
-		if (IS_ERR(attach)) {
-			err = PTR_ERR(attach);
-			nvhost_err(&dev->dev, "could not attach buf err=%d",
-				   err);
-			goto clean_up_attach;
-		}
-
-		sgt = dma_buf_map_attachment(attach, ids[i].direction);
-		if (IS_ERR(sgt)) {
-			err = PTR_ERR(sgt);
-			nvhost_err(&dev->dev, "could not map attachment err=%d",
-				err);
-			goto clean_up_map;
-		}
-
-		if (!device_is_iommuable(&dev->dev) && sgt->nents > 1) {
-			dev_err(&dev->dev, "Cannot use non-contiguous buffer w/ IOMMU disabled\n");
-			err = -EINVAL;
-			goto clean_up_iommu;
+		/* reuses the mapping from an earlier job where possible */
+		entry = nvhost_pin_cache_get(cache, &dev->dev, buf,
+					     ids[i].direction);
+		if (IS_ERR(entry)) {
+			err = PTR_ERR(entry);
+			dma_buf_put(buf);
+			goto clean_up;
 		}
 
-		if (!sg_dma_address(sgt->sgl))
-			sg_dma_address(sgt->sgl) = sg_phys(sgt->sgl);
-
-		phys_addr[ids[i].index] = sg_dma_address(sgt->sgl);
-		unpin_data[pin_count].buf = buf;
-		unpin_data[pin_count].attach = attach;
-		unpin_data[pin_count].direction = ids[i].direction;
-		unpin_data[pin_count++].sgt = sgt;
+		phys_addr[ids[i].index] = entry->addr;
+		unpin_data[pin_count++].entry = entry;
 
 		prev_id = ids[i].id;
 		prev_addr = phys_addr[ids[i].index];
 	}
 	return pin_count;
 
-clean_up_iommu:
-	dma_buf_unmap_attachment(attach, sgt, ids[i].direction);
-clean_up_map:
-	dma_buf_detach(buf, attach);
-clean_up_attach:
-	dma_buf_put(buf);
 clean_up:
-	for (i = 0; i < pin_count; i++) {
-		dma_buf_unmap_attachment(unpin_data[i].attach,
-			unpin_data[i].sgt, unpin_data[i].direction);
-		dma_buf_detach(unpin_data[i].buf, unpin_data[i].attach);
-		dma_buf_put(unpin_data[i].buf);
-	}
+	for (i = 0; i < pin_count; i++)
+		nvhost_pin_cache_put(unpin_data[i].entry);
 
 	return err;
 }
@@ -445,6 +489,7 @@ static int pin_job_mem(struct nvhost_job *job)
 
 	/* validate array and pin unique ids, get refs for reloc unpinning */
 	result = pin_array_ids(job->ch->vm->pdev,
+		&job->ch->vm->pin_cache,
 		job->pin_ids, job->addr_phys,
 		job->num_relocs,
 		job->unpins);
@@ -463,6 +508,7 @@ static int pin_job_mem(struct nvhost_job *job)
 
 	/* validate array and pin unique ids, get refs for gather unpinning */
 	result = pin_array_ids(nvhost_get_host(job->ch->dev)->dev,
+		&job->ch->vm->pin_cache,
 		&job->pin_ids[job->num_relocs],
 		&job->addr_phys[job->num_relocs],
 		job->num_gathers,
@@ -477,112 +523,178 @@ static int pin_job_mem(struct nvhost_job *job)
 	return result;
 }
 
-static int do_relocs(struct nvhost_job *job,
-		u32 cmdbuf_mem, struct dma_buf *buf)
+/* Relocs of a job in the order they are patched: by command buffer, then
+ * by offset, so that each command buffer page is mapped only once. */
+struct nvhost_reloc_order {
+	u32 mem;
+	u32 offset;
+	u32 index;
+};
+
+static int reloc_order_cmp(const void *_a, const void *_b)
+{
+	const struct nvhost_reloc_order *a = _a, *b = _b;
+
+	if (a->mem != b->mem)
+		return a->mem < b->mem ? -1 : 1;
+	if (a->offset != b->offset)
+		return a->offset < b->offset ? -1 : 1;
+
+	return 0;
+}
+
+static struct nvhost_reloc_order *sort_relocs(struct nvhost_job *job)
+{
+	struct nvhost_reloc_order *order;
+	int i;
+
+	order = kmalloc_array(job->num_relocs, sizeof(*order), GFP_KERNEL);
+	if (!order)
+		return NULL;
+
+	for (i = 0; i < job->num_relocs; i++) {
+		order[i].mem = job->relocarray[i].cmdbuf_mem;
+		order[i].offset = job->relocarray[i].cmdbuf_offset;
+		order[i].index = i;
+	}
+
+	sort(order, job->num_relocs, sizeof(*order), reloc_order_cmp, NULL);
+
+	return order;
+}
+
+static struct nvhost_pin_cache_entry *job_pin_entry(struct nvhost_job *job,
+		struct dma_buf *buf)
+{
+	int i;
+
+	for (i = 0; i < job->num_unpins; i++)
+		if (job->unpins[i].entry->buf == buf)
+			return job->unpins[i].entry;
+
+	return NULL;
+}
+
+static int patch_reloc_page(struct nvhost_job *job, struct dma_buf *buf,
+		unsigned long page, const u64 *relocs, int count)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
+	void *cmdbuf_page_addr;
+	int err, i;
+
+	cmdbuf_page_addr = dma_buf_kmap(buf, page);
+	if (unlikely(!cmdbuf_page_addr)) {
+		pr_err("Couldn't map cmdbuf for relocation\n");
+		return -ENOMEM;
+	}
+
+	err = dma_buf_begin_cpu_access(buf, page << PAGE_SHIFT,
+			PAGE_SIZE, DMA_TO_DEVICE);
+	if (err) {
+		nvhost_err(&pdata->pdev->dev,
+			"begin_cpu_access() failed for patching reloc %d",
+			err);
+		dma_buf_kunmap(buf, page, cmdbuf_page_addr);
+		return err;
+	}
+
+	for (i = 0; i < count; i++)
+		__raw_writel((u32)relocs[i],
+			(void __iomem *)(cmdbuf_page_addr +
+				((relocs[i] >> 32) & ~PAGE_MASK)));
+
+	dma_buf_kunmap(buf, page, cmdbuf_page_addr);
+	dma_buf_end_cpu_access(buf, page << PAGE_SHIFT,
+			PAGE_SIZE, DMA_TO_DEVICE);
+
+	return 0;
+}
+
+/*
+ * Patch the relocs of one command buffer, @order being the part of the
+ * sorted reloc list that targets it.
+ */
+static int do_relocs(struct nvhost_job *job, struct dma_buf *buf,
+		const struct nvhost_reloc_order *order, int num_relocs)
 {
 	struct nvhost_device_data *pdata = platform_get_drvdata(job->ch->dev);
-	int i = 0;
-	int last_page = -1;
-	size_t last_offset;
-	void *cmdbuf_page_addr = NULL;
+	struct nvhost_pin_cache_entry *entry;
 	dma_addr_t phys_addr;
+	u64 *relocs;
+	int i, first;
 	int err;
 
-	/* pin & patch the relocs for one gather */
-	while (i < job->num_relocs) {
-		struct nvhost_reloc *reloc = &job->relocarray[i];
-		struct nvhost_reloc_shift *shift = &job->relocshiftarray[i];
-		struct nvhost_reloc_type *type = &job->reloctypearray[i];
+	if (!num_relocs)
+		return 0;
 
-		/* skip all other gathers */
-		if (cmdbuf_mem != reloc->cmdbuf_mem) {
-			i++;
-			continue;
-		}
+	relocs = kmalloc_array(num_relocs, sizeof(*relocs), GFP_KERNEL);
+	if (!relocs)
+		return -ENOMEM;
+
+	for (i = 0; i < num_relocs; i++) {
+		u32 index = order[i].index;
+		struct nvhost_reloc *reloc = &job->relocarray[index];
+		struct nvhost_reloc_shift *shift = &job->relocshiftarray[index];
+		struct nvhost_reloc_type *type = &job->reloctypearray[index];
 
 		if (reloc->cmdbuf_offset & 3 ||
 		    reloc->cmdbuf_offset >= buf->size) {
 			nvhost_err(&pdata->pdev->dev,
 				   "invalid cmdbuf_offset=0x%x",
 				   reloc->cmdbuf_offset);
-			return -EINVAL;
-		}
-
-		if (last_page != reloc->cmdbuf_offset >> PAGE_SHIFT) {
-			if (cmdbuf_page_addr) {
-				dma_buf_kunmap(buf, last_page,
-						cmdbuf_page_addr);
-				dma_buf_end_cpu_access(buf, last_offset,
-					PAGE_SIZE, DMA_TO_DEVICE);
-			}
-
-			cmdbuf_page_addr = dma_buf_kmap(buf,
-					reloc->cmdbuf_offset >> PAGE_SHIFT);
-			last_page = reloc->cmdbuf_offset >> PAGE_SHIFT;
-			last_offset = reloc->cmdbuf_offset & PAGE_MASK;
-
-			if (unlikely(!cmdbuf_page_addr)) {
-				pr_err("Couldn't map cmdbuf for relocation\n");
-				return -ENOMEM;
-			}
-
-			err = dma_buf_begin_cpu_access(buf, last_offset,
-					PAGE_SIZE, DMA_TO_DEVICE);
-			if (err) {
-				nvhost_err(&pdata->pdev->dev,
-					"begin_cpu_access() failed for patching reloc %d",
-					err);
-				return err;
-			}
+			err = -EINVAL;
+			goto fail;
 		}
 
 		if (pdata->get_reloc_phys_addr)
 			phys_addr = pdata->get_reloc_phys_addr(
-						job->reloc_addr_phys[i],
+						job->reloc_addr_phys[index],
 						type->reloc_type);
 		else
-			phys_addr = job->reloc_addr_phys[i];
+			phys_addr = job->reloc_addr_phys[index];
 
-		__raw_writel(
-			(phys_addr +
-				reloc->target_offset) >> shift->shift,
-			(void __iomem *)(cmdbuf_page_addr +
-				(reloc->cmdbuf_offset & ~PAGE_MASK)));
-
-		/* remove completed reloc from the job */
-		if (i != job->num_relocs - 1) {
-			struct nvhost_reloc *reloc_last =
-				&job->relocarray[job->num_relocs - 1];
-			struct nvhost_reloc_shift *shift_last =
-				&job->relocshiftarray[job->num_relocs - 1];
-			struct nvhost_reloc_type *type_last =
-				&job->reloctypearray[job->num_relocs - 1];
-			reloc->cmdbuf_mem	= reloc_last->cmdbuf_mem;
-			reloc->cmdbuf_offset	= reloc_last->cmdbuf_offset;
-			reloc->target		= reloc_last->target;
-			reloc->target_offset	= reloc_last->target_offset;
-			shift->shift		= shift_last->shift;
-			type->reloc_type	= type_last->reloc_type;
-			job->reloc_addr_phys[i] =
-				job->reloc_addr_phys[job->num_relocs - 1];
-			job->num_relocs--;
-		} else {
-			break;
-		}
+		relocs[i] = (u64)reloc->cmdbuf_offset << 32 |
+			(u32)((phys_addr + reloc->target_offset) >>
+			      shift->shift);
+	}
+
+	/* userspace left the buffer alone, skip if the addresses match too */
+	entry = job_pin_entry(job, buf);
+	if (job->relocs_unchanged && entry &&
+	    nvhost_pin_cache_relocs_match(entry, relocs, num_relocs)) {
+		kfree(relocs);
+		return 0;
 	}
 
-	if (cmdbuf_page_addr) {
-		dma_buf_kunmap(buf, last_page, cmdbuf_page_addr);
-		dma_buf_end_cpu_access(buf, last_offset,
-				PAGE_SIZE, DMA_TO_DEVICE);
+	for (first = 0, i = 1; i <= num_relocs; i++) {
+		if (i < num_relocs &&
+		    order[i].offset >> PAGE_SHIFT ==
+		    order[first].offset >> PAGE_SHIFT)
+			continue;
+
+		err = patch_reloc_page(job, buf,
+				order[first].offset >> PAGE_SHIFT,
+				&relocs[first], i - first);
+		if (err)
+			goto fail;
+		first = i;
 	}
 
+	if (entry)
+		nvhost_pin_cache_set_relocs(entry, relocs, num_relocs);
+	else
+		kfree(relocs);
+
 	return 0;
-}
 
+fail:
+	kfree(relocs);
+	return err;
+}
 
 int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 {
+	struct nvhost_reloc_order *order = NULL;
 	int err = 0, i = 0, j = 0;
 	int nb_hw_pts = nvhost_syncpt_nb_hw_pts(sp);
 	DECLARE_BITMAP(waitchk_mask, nb_hw_pts);
@@ -603,6 +715,14 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 	if (err <= 0)
 		goto fail;
 
+	if (job->num_relocs) {
+		order = sort_relocs(job);
+		if (!order) {
+			err = -ENOMEM;
+			goto fail;
+		}
+	}
+
 	/* patch gathers */
 	for (i = 0; i < job->num_gathers; i++) {
 		struct nvhost_job_gather *g = &job->gathers[i];
@@ -610,6 +730,7 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 		/* process each gather mem only once */
 		if (!g->buf) {
 			u64 end_offset;
+			int first, count;
 
 			g->buf = dma_buf_get(g->mem_id);
 			if (IS_ERR(g->buf)) {
@@ -636,7 +757,15 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 					tmp->mem_base = g->mem_base;
 				}
 			}
-			err = do_relocs(job, g->mem_id,  g->buf);
+
+			for (first = 0; first < job->num_relocs &&
+			     order[first].mem < g->mem_id; first++)
+				;
+			for (count = 0; first + count < job->num_relocs &&
+			     order[first + count].mem == g->mem_id; count++)
+				;
+
+			err = do_relocs(job, g->buf, &order[first], count);
 			if (!err)
 				err = do_waitchks(job, sp,
 						g->mem_id, g->buf);
@@ -645,6 +774,8 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp)
 				break;
 		}
 	}
+
+	kfree(order);
 fail:
 	return err;
 }
@@ -656,10 +787,8 @@ void nvhost_job_unpin(struct nvhost_job *job)
 	for (i = 0; i < job->num_unpins; i++) {
 		struct nvhost_job_unpin *unpin = &job->unpins[i];
 
-		dma_buf_unmap_attachment(unpin->attach, unpin->sgt,
-					 unpin->direction);
-		dma_buf_detach(unpin->buf, unpin->attach);
-		dma_buf_put(unpin->buf);
+		nvhost_pin_cache_put(unpin->entry);
+		unpin->entry = NULL;
 	}
 	job->num_unpins = 0;
 }
@@ -24,10 +24,12 @@
 #include <linux/nvhost_ioctl.h>
 #include <linux/kref.h>
 #include <linux/dma-buf.h>
+#include <linux/ktime.h>
 
 struct nvhost_channel;
 struct nvhost_waitchk;
 struct nvhost_syncpt;
+struct nvhost_pin_cache_entry;
 struct sg_table;
 
 struct nvhost_job_gather {
@@ -54,10 +56,7 @@ struct nvhost_pinid {
 };
 
 struct nvhost_job_unpin {
-	struct sg_table *sgt;
-	struct dma_buf *buf;
-	struct dma_buf_attachment *attach;
-	enum dma_data_direction direction;
+	struct nvhost_pin_cache_entry *entry;
 };
 
 /*
@@ -111,10 +110,33 @@ struct nvhost_job {
 	/* Do debug dump after timeout */
 	bool timeout_debug_dump;
 
+	/* Userspace did not rewrite the reloc words since the last submit */
+	bool relocs_unchanged;
+
+	/* Time the job was handed to the hardware */
+	ktime_t queue_ktime;
+
+	/* Scheduling priority, one of NVHOST_PRIORITY_* */
+	u32 priority;
+
+	/* Engine time accounting of the submitting client, may be NULL */
+	struct nvhost_client_usage *usage;
+
+	/* Time the job reached each submit stage, in eventlib timestamps */
+	struct {
+		u64 submit;
+		u64 pinned;
+		u64 pushed;
+	} stage_ts;
+
 	/* Index and number of slots used in the push buffer */
 	int first_get;
 	int num_slots;
 
+	/* Sent to the vhost server, in the message with the given job id */
+	bool virt_submitted;
+	u32 virt_submit_id;
+
 	/* Set to true to force an added wait-for-idle before the job */
 	int serialize;
 
@@ -155,6 +177,12 @@ int nvhost_job_pin(struct nvhost_job *job, struct nvhost_syncpt *sp);
  */
 void nvhost_job_unpin(struct nvhost_job *job);
 
+/*
+ * Create and destroy the caches that jobs are allocated from.
+ */
+int nvhost_job_init_caches(void);
+void nvhost_job_deinit_caches(void);
+
 /*
  * Dump contents of job to debug output.
  */
@@ -0,0 +1,344 @@
+/*
+ * Tegra Graphics Host Cross-Job Pin Cache
+ *
+ * Copyright (c) 2018, NVIDIA Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <linux/dma-buf.h>
+#include <linux/dma-mapping.h>
+#include <linux/fs.h>
+#include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/slab.h>
+
+#include "nvhost_pin_cache.h"
+#include "dev.h"
+
+/*
+ * Jobs are pinned against the same handful of buffers frame after frame.
+ * Rather than attaching and mapping each of them again for every job, keep
+ * the attachment around once the last job using it is done, and hand it
+ * straight back on the next pin. Idle entries are dropped when the cache
+ * is over its limit, when userspace has released the buffer (the cache
+ * holds the only reference left) or when the system asks for memory back.
+ */
+
+u32 nvhost_pin_cache_max = 64;
+
+static DEFINE_MUTEX(pin_caches_lock);
+static LIST_HEAD(pin_caches);
+static bool pin_cache_shrinker_registered;
+
+static u64 pin_cache_hits;
+static u64 pin_cache_misses;
+static u64 pin_cache_evictions;
+
+static struct shrinker pin_cache_shrinker;
+
+static inline unsigned long pin_cache_key(struct dma_buf *buf)
+{
+	return (unsigned long)buf;
+}
+
+static void pin_cache_evict_locked(struct nvhost_pin_cache_entry *entry)
+{
+	struct nvhost_pin_cache *cache = entry->cache;
+
+	WARN_ON(entry->users);
+
+	hash_del(&entry->node);
+	list_del(&entry->lru);
+	cache->nr_entries--;
+	cache->nr_idle--;
+	pin_cache_evictions++;
+
+	dma_buf_unmap_attachment(entry->attach, entry->sgt, entry->dir);
+	dma_buf_detach(entry->buf, entry->attach);
+	dma_buf_put(entry->buf);
+	kfree(entry->relocs);
+	kfree(entry);
+}
+
+/* Only the cache reference is left, i.e. userspace has let go of it */
+static bool pin_cache_entry_released(struct nvhost_pin_cache_entry *entry)
+{
+	return file_count(entry->buf->file) == 1;
+}
+
+/*
+ * Drop released buffers and bring the idle list back under @max entries,
+ * oldest first.
+ */
+static unsigned long pin_cache_trim_locked(struct nvhost_pin_cache *cache,
+					   unsigned int max)
+{
+	struct nvhost_pin_cache_entry *entry, *tmp;
+	unsigned long freed = 0;
+
+	list_for_each_entry_safe(entry, tmp, &cache->lru, lru) {
+		if (cache->nr_idle > max || pin_cache_entry_released(entry)) {
+			pin_cache_evict_locked(entry);
+			freed++;
+		}
+	}
+
+	return freed;
+}
+
+static struct nvhost_pin_cache_entry *pin_cache_lookup_locked(
+		struct nvhost_pin_cache *cache, struct device *dev,
+		struct dma_buf *buf, enum dma_data_direction dir)
+{
+	struct nvhost_pin_cache_entry *entry;
+
+	hash_for_each_possible(cache->entries, entry, node,
+			       pin_cache_key(buf))
+		if (entry->buf == buf && entry->dev == dev &&
+		    entry->dir == dir)
+			return entry;
+
+	return NULL;
+}
+
+static struct nvhost_pin_cache_entry *pin_cache_map(struct device *dev,
+		struct dma_buf *buf, enum dma_data_direction dir)
+{
+	struct nvhost_pin_cache_entry *entry;
+	int err;
+
+	entry = kzalloc(sizeof(*entry), GFP_KERNEL);
+	if (!entry)
+		return ERR_PTR(-ENOMEM);
+
+	entry->attach = dma_buf_attach(buf, dev);
+	if (IS_ERR(entry->attach)) {
+		err = PTR_ERR(entry->attach);
+		nvhost_err(dev, "could not attach buf err=%d", err);
+		goto free_entry;
+	}
+
+	entry->sgt = dma_buf_map_attachment(entry->attach, dir);
+	if (IS_ERR(entry->sgt)) {
+		err = PTR_ERR(entry->sgt);
+		nvhost_err(dev, "could not map attachment err=%d", err);
+		goto detach;
+	}
+
+	if (!device_is_iommuable(dev) && entry->sgt->nents > 1) {
+		dev_err(dev, "Cannot use non-contiguous buffer w/ IOMMU disabled\n");
+		err = -EINVAL;
+		goto unmap;
+	}
+
+	if (!sg_dma_address(entry->sgt->sgl))
+		sg_dma_address(entry->sgt->sgl) = sg_phys(entry->sgt->sgl);
+
+	entry->buf = buf;
+	entry->dev = dev;
+	entry->dir = dir;
+	entry->addr = sg_dma_address(entry->sgt->sgl);
+	INIT_LIST_HEAD(&entry->lru);
+
+	return entry;
+
+unmap:
+	dma_buf_unmap_attachment(entry->attach, entry->sgt, dir);
+detach:
+	dma_buf_detach(buf, entry->attach);
+free_entry:
+	kfree(entry);
+	return ERR_PTR(err);
+}
+
+struct nvhost_pin_cache_entry *nvhost_pin_cache_get(
+		struct nvhost_pin_cache *cache, struct device *dev,
+		struct dma_buf *buf, enum dma_data_direction dir)
+{
+	struct nvhost_pin_cache_entry *entry;
+
+	mutex_lock(&cache->lock);
+
+	entry = pin_cache_lookup_locked(cache, dev, buf, dir);
+	if (entry) {
+		if (!entry->users++) {
+			list_del_init(&entry->lru);
+			cache->nr_idle--;
+		}
+		pin_cache_hits++;
+		mutex_unlock(&cache->lock);
+
+		/* the cache already holds a reference */
+		dma_buf_put(buf);
+		return entry;
+	}
+
+	pin_cache_misses++;
+	entry = pin_cache_map(dev, buf, dir);
+	if (!IS_ERR(entry)) {
+		entry->cache = cache;
+		entry->users = 1;
+		hash_add(cache->entries, &entry->node, pin_cache_key(buf));
+		cache->nr_entries++;
+	}
+
+	mutex_unlock(&cache->lock);
+
+	return entry;
+}
+
+void nvhost_pin_cache_put(struct nvhost_pin_cache_entry *entry)
+{
+	struct nvhost_pin_cache *cache = entry->cache;
+
+	mutex_lock(&cache->lock);
+
+	if (!--entry->users) {
+		list_add_tail(&entry->lru, &cache->lru);
+		cache->nr_idle++;
+		pin_cache_trim_locked(cache, READ_ONCE(nvhost_pin_cache_max));
+	}
+
+	mutex_unlock(&cache->lock);
+}
+
+bool nvhost_pin_cache_relocs_match(struct nvhost_pin_cache_entry *entry,
+		const u64 *relocs, unsigned int num_relocs)
+{
+	struct nvhost_pin_cache *cache = entry->cache;
+	bool match;
+
+	mutex_lock(&cache->lock);
+	match = entry->relocs && entry->num_relocs == num_relocs &&
+		!memcmp(entry->relocs, relocs, num_relocs * sizeof(*relocs));
+	mutex_unlock(&cache->lock);
+
+	return match;
+}
+
+void nvhost_pin_cache_set_relocs(struct nvhost_pin_cache_entry *entry,
+		u64 *relocs, unsigned int num_relocs)
+{
+	struct nvhost_pin_cache *cache = entry->cache;
+	u64 *old;
+
+	mutex_lock(&cache->lock);
+	old = entry->relocs;
+	entry->relocs = relocs;
+	entry->num_relocs = num_relocs;
+	mutex_unlock(&cache->lock);
+
+	kfree(old);
+}
+
+static unsigned long pin_cache_shrink_count(struct shrinker *shrinker,
+					    struct shrink_control *sc)
+{
+	struct nvhost_pin_cache *cache;
+	unsigned long count = 0;
+
+	mutex_lock(&pin_caches_lock);
+	list_for_each_entry(cache, &pin_caches, cache_list)
+		count += READ_ONCE(cache->nr_idle);
+	mutex_unlock(&pin_caches_lock);
+
+	return count;
+}
+
+static unsigned long pin_cache_shrink_scan(struct shrinker *shrinker,
+					   struct shrink_control *sc)
+{
+	struct nvhost_pin_cache *cache;
+	unsigned long freed = 0;
+
+	if (!mutex_trylock(&pin_caches_lock))
+		return SHRINK_STOP;
+
+	list_for_each_entry(cache, &pin_caches, cache_list) {
+		if (freed >= sc->nr_to_scan)
+			break;
+
+		if (!mutex_trylock(&cache->lock))
+			continue;
+		freed += pin_cache_trim_locked(cache, 0);
+		mutex_unlock(&cache->lock);
+	}
+
+	mutex_unlock(&pin_caches_lock);
+
+	return freed;
+}
+
+static struct shrinker pin_cache_shrinker = {
+	.count_objects = pin_cache_shrink_count,
+	.scan_objects = pin_cache_shrink_scan,
+	.seeks = DEFAULT_SEEKS,
+};
+
+void nvhost_pin_cache_init(struct nvhost_pin_cache *cache)
+{
+	mutex_init(&cache->lock);
+	hash_init(cache->entries);
+	INIT_LIST_HEAD(&cache->lru);
+	cache->nr_entries = 0;
+	cache->nr_idle = 0;
+
+	mutex_lock(&pin_caches_lock);
+	if (!pin_cache_shrinker_registered &&
+	    !register_shrinker(&pin_cache_shrinker))
+		pin_cache_shrinker_registered = true;
+	list_add_tail(&cache->cache_list, &pin_caches);
+	mutex_unlock(&pin_caches_lock);
+}
+
+/*
+ * Release every idle entry and unlink the cache. All jobs using the cache
+ * must be done by now.
+ */
+void nvhost_pin_cache_flush(struct nvhost_pin_cache *cache)
+{
+	mutex_lock(&pin_caches_lock);
+	list_del(&cache->cache_list);
+	mutex_unlock(&pin_caches_lock);
+
+	mutex_lock(&cache->lock);
+	pin_cache_trim_locked(cache, 0);
+	WARN(cache->nr_entries, "%u pinned buffers leaked\n",
+	     cache->nr_entries);
+	mutex_unlock(&cache->lock);
+}
+
+int nvhost_pin_cache_debug_show(struct seq_file *s, void *unused)
+{
+	struct nvhost_pin_cache *cache;
+	unsigned int nr_caches = 0, nr_entries = 0, nr_idle = 0;
+
+	mutex_lock(&pin_caches_lock);
+	list_for_each_entry(cache, &pin_caches, cache_list) {
+		nr_caches++;
+		nr_entries += READ_ONCE(cache->nr_entries);
+		nr_idle += READ_ONCE(cache->nr_idle);
+	}
+	mutex_unlock(&pin_caches_lock);
+
+	seq_printf(s, "caches:    %u\n", nr_caches);
+	seq_printf(s, "entries:   %u\n", nr_entries);
+	seq_printf(s, "idle:      %u\n", nr_idle);
+	seq_printf(s, "hits:      %llu\n", pin_cache_hits);
+	seq_printf(s, "misses:    %llu\n", pin_cache_misses);
+	seq_printf(s, "evictions: %llu\n", pin_cache_evictions);
+
+	return 0;
+}
@@ -0,0 +1,96 @@
+/*
+ * Tegra Graphics Host Cross-Job Pin Cache
+ *
+ * Copyright (c) 2018, NVIDIA Corporation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NVHOST_PIN_CACHE_H
+#define NVHOST_PIN_CACHE_H
+
+#include <linux/dma-direction.h>
+#include <linux/hashtable.h>
+#include <linux/list.h>
+#include <linux/mutex.h>
+#include <linux/types.h>
+
+struct device;
+struct dma_buf;
+struct dma_buf_attachment;
+struct sg_table;
+struct seq_file;
+
+#define NVHOST_PIN_CACHE_HASH_BITS	6
+
+/*
+ * One attachment and mapping of a dma-buf for a device, kept alive for as
+ * long as the buffer is in use or the cache has room for it.
+ */
+struct nvhost_pin_cache_entry {
+	struct hlist_node node;		/* entry in cache hash */
+	struct list_head lru;		/* entry in idle list when unused */
+	struct nvhost_pin_cache *cache;
+
+	struct dma_buf *buf;		/* cache holds one buffer reference */
+	struct device *dev;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	enum dma_data_direction dir;
+	dma_addr_t addr;
+
+	unsigned int users;		/* jobs currently holding the pin */
+
+	/* relocs last patched into this command buffer, offset << 32 | word */
+	u64 *relocs;
+	unsigned int num_relocs;
+};
+
+struct nvhost_pin_cache {
+	struct mutex lock;
+	DECLARE_HASHTABLE(entries, NVHOST_PIN_CACHE_HASH_BITS);
+	struct list_head lru;		/* idle entries, oldest first */
+	unsigned int nr_entries;
+	unsigned int nr_idle;
+	struct list_head cache_list;	/* entry in list of all caches */
+};
+
+/* Maximum number of idle entries kept per cache, 0 disables caching */
+extern u32 nvhost_pin_cache_max;
+
+void nvhost_pin_cache_init(struct nvhost_pin_cache *cache);
+void nvhost_pin_cache_flush(struct nvhost_pin_cache *cache);
+
+/*
+ * Pin @buf for @dev, reusing a cached mapping if there is one. On success
+ * the caller's buffer reference is consumed and the returned entry must be
+ * released with nvhost_pin_cache_put().
+ */
+struct nvhost_pin_cache_entry *nvhost_pin_cache_get(
+		struct nvhost_pin_cache *cache, struct device *dev,
+		struct dma_buf *buf, enum dma_data_direction dir);
+void nvhost_pin_cache_put(struct nvhost_pin_cache_entry *entry);
+
+/*
+ * Remember the relocs patched into a command buffer, so that a later submit
+ * can tell whether patching it again would change anything. The cache takes
+ * ownership of @relocs.
+ */
+bool nvhost_pin_cache_relocs_match(struct nvhost_pin_cache_entry *entry,
+		const u64 *relocs, unsigned int num_relocs);
+void nvhost_pin_cache_set_relocs(struct nvhost_pin_cache_entry *entry,
+		u64 *relocs, unsigned int num_relocs);
+
+int nvhost_pin_cache_debug_show(struct seq_file *s, void *unused);
+
+#endif
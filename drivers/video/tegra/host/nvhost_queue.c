@@ -23,6 +23,7 @@
 #include <linux/dma-mapping.h>
 #include <linux/debugfs.h>
 #include <linux/dma-attrs.h>
+#include <linux/wait.h>
 
 #include <linux/nvhost.h>
 
@@ -34,75 +35,134 @@
 
 #define CMDBUF_SIZE	4096
 
+/* time to wait for a task slot to be freed once the pool is at its cap */
+#define NVHOST_QUEUE_TASK_WAIT_MS	200
+
 /**
- * @brief Describe a task pool struct
- *
- * Array of fixed task memory is allocated during queue_alloc call.
- * The memory will be shared for various task based on availability
+ * @brief Describe a chunk of task memory
  *
- * dma_addr		Physical address of task memory pool
- * va			Virtual address of the task memory pool
- * kmem_addr		Kernel memory for task struct
- * lock			Mutex lock for the array access.
+ * dma_addr		Physical address of the chunk
+ * va			Virtual address of the chunk
+ * kmem_addr		Kernel memory for task structs in the chunk
  * alloc_table		Keep track of the index being assigned
  *			and freed for a task
- * max_task_cnt		Maximum task count that can be supported.
  *
  */
-struct nvhost_queue_task_pool {
+struct nvhost_queue_task_chunk {
 	dma_addr_t dma_addr;
 	void *va;
 	void *kmem_addr;
+	unsigned long alloc_table;
+};
+
+/**
+ * @brief Describe a task pool struct
+ *
+ * Task memory is allocated in chunks. The first chunk is allocated during
+ * queue_alloc call, further chunks are added when all tasks are in use,
+ * up to the max_task_chunks limit of the queue pool. The memory will be
+ * shared for various task based on availability.
+ *
+ * chunks		Chunks of task memory
+ * num_chunks		Number of chunks allocated
+ * chunk_task_cnt	Number of tasks in each chunk
+ * lock			Mutex lock for the array access.
+ * wq			Wait queue for task slots being freed
+ * num_used		Number of tasks currently assigned
+ * max_task_cnt		Maximum task count that can currently be supported.
+ *
+ */
+struct nvhost_queue_task_pool {
+	struct nvhost_queue_task_chunk chunks[NVHOST_QUEUE_MAX_TASK_CHUNKS];
+	unsigned int num_chunks;
+	unsigned int chunk_task_cnt;
 	struct mutex lock;
+	wait_queue_head_t wq;
 
-	unsigned long alloc_table;
+	unsigned long num_used;
 	unsigned long max_task_cnt;
 };
 
 static DEFINE_DMA_ATTRS(task_dma_attrs);
 
-static int nvhost_queue_task_pool_alloc(struct platform_device *pdev,
-					struct nvhost_queue *queue,
-					unsigned int num_tasks)
+static int nvhost_queue_task_chunk_alloc(struct platform_device *pdev,
+					 struct nvhost_queue *queue,
+					 struct nvhost_queue_task_chunk *chunk,
+					 unsigned int num_tasks)
 {
-	int err = 0;
-	struct nvhost_queue_task_pool *task_pool;
-
-	task_pool = queue->task_pool;
-
 	/* Allocate the kernel memory needed for the task */
 	if (queue->task_kmem_size) {
-		task_pool->kmem_addr = kcalloc(num_tasks,
+		chunk->kmem_addr = kcalloc(num_tasks,
 					queue->task_kmem_size, GFP_KERNEL);
-		if (!task_pool->kmem_addr) {
+		if (!chunk->kmem_addr) {
 			nvhost_err(&pdev->dev,
 				   "failed to allocate task_pool->kmem_addr");
-			err = -ENOMEM;
-			goto err_alloc_task_kmem;
+			return -ENOMEM;
 		}
 	}
 
 	/* Allocate memory for the task itself */
-	task_pool->va = dma_alloc_attrs(&pdev->dev,
+	chunk->va = dma_alloc_attrs(&pdev->dev,
 				queue->task_dma_size * num_tasks,
-				&task_pool->dma_addr, GFP_KERNEL,
+				&chunk->dma_addr, GFP_KERNEL,
 				__DMA_ATTR(task_dma_attrs));
 
-	if (task_pool->va == NULL) {
+	if (chunk->va == NULL) {
 		nvhost_err(&pdev->dev, "failed to allocate task_pool->va");
-		err = -ENOMEM;
-		goto err_alloc_task_pool;
+		kfree(chunk->kmem_addr);
+		chunk->kmem_addr = NULL;
+		return -ENOMEM;
+	}
+
+	chunk->alloc_table = 0;
+
+	return 0;
+}
+
+static void nvhost_queue_task_chunk_free(struct nvhost_queue *queue,
+					 struct nvhost_queue_task_chunk *chunk,
+					 unsigned int num_tasks)
+{
+	dma_free_attrs(&queue->vm_pdev->dev,
+			queue->task_dma_size * num_tasks,
+			chunk->va, chunk->dma_addr,
+			__DMA_ATTR(task_dma_attrs));
+
+	kfree(chunk->kmem_addr);
+	chunk->kmem_addr = NULL;
+	chunk->va = NULL;
+	chunk->alloc_table = 0;
+}
+
+static int nvhost_queue_task_pool_alloc(struct platform_device *pdev,
+					struct nvhost_queue *queue,
+					unsigned int num_tasks)
+{
+	int err = 0;
+	struct nvhost_queue_task_pool *task_pool;
+
+	task_pool = queue->task_pool;
+
+	if (num_tasks > BITS_PER_LONG) {
+		nvhost_err(&pdev->dev, "too many tasks per queue %u",
+			   num_tasks);
+		return -EINVAL;
 	}
+
+	err = nvhost_queue_task_chunk_alloc(pdev, queue,
+					    &task_pool->chunks[0], num_tasks);
+	if (err)
+		return err;
+
+	task_pool->num_chunks = 1;
+	task_pool->chunk_task_cnt = num_tasks;
+	task_pool->num_used = 0;
 	task_pool->max_task_cnt = num_tasks;
 
 	mutex_init(&task_pool->lock);
+	init_waitqueue_head(&task_pool->wq);
 
 	return err;
-
-err_alloc_task_pool:
-	kfree(task_pool->kmem_addr);
-err_alloc_task_kmem:
-	return err;
 }
 
 static void nvhost_queue_task_free_pool(struct platform_device *pdev,
@@ -110,15 +170,14 @@ static void nvhost_queue_task_free_pool(struct platform_device *pdev,
 {
 	struct nvhost_queue_task_pool *task_pool =
 		(struct nvhost_queue_task_pool *)queue->task_pool;
+	unsigned int i;
 
-	dma_free_attrs(&queue->vm_pdev->dev,
-			queue->task_dma_size * task_pool->max_task_cnt,
-			task_pool->va, task_pool->dma_addr,
-			__DMA_ATTR(task_dma_attrs));
+	for (i = 0; i < task_pool->num_chunks; i++)
+		nvhost_queue_task_chunk_free(queue, &task_pool->chunks[i],
+					     task_pool->chunk_task_cnt);
 
-	kfree(task_pool->kmem_addr);
+	task_pool->num_chunks = 0;
 	task_pool->max_task_cnt = 0;
-	task_pool->alloc_table = 0;
 }
 
 static int nvhost_queue_dump(struct nvhost_queue_pool *pool,
@@ -199,11 +258,14 @@ struct nvhost_queue_pool *nvhost_queue_init(struct platform_device *pdev,
 	pool->alloc_table = 0;
 	pool->max_queue_cnt = num_queues;
 	pool->queue_task_pool = task_pool;
+	pool->max_task_chunks = NVHOST_QUEUE_DEFAULT_TASK_CHUNKS;
 	mutex_init(&pool->queue_lock);
 
 	debugfs_create_file("queues", S_IRUGO,
 			pdata->debugfs, pool,
 			&queue_expose_operations);
+	debugfs_create_u32("queue_max_task_chunks", S_IRUGO | S_IWUSR,
+			pdata->debugfs, &pool->max_task_chunks);
 
 
 	for (i = 0; i < num_queues; i++) {
@@ -541,40 +603,91 @@ int nvhost_queue_get_task_size(struct nvhost_queue *queue)
 	return 0;
 }
 
+/*
+ * Find a free task slot, adding a chunk to the pool when all are in use
+ * and the pool is still below its cap. Returns -EAGAIN if the pool is
+ * exhausted. Called with the task pool lock held.
+ */
+static int nvhost_queue_get_task_slot(struct nvhost_queue *queue,
+				      struct nvhost_queue_task_pool *task_pool)
+{
+	unsigned int max_chunks = min_t(unsigned int,
+					READ_ONCE(queue->pool->max_task_chunks),
+					NVHOST_QUEUE_MAX_TASK_CHUNKS);
+	struct nvhost_queue_task_chunk *chunk;
+	unsigned int i;
+	int index, err;
+
+	for (i = 0; i < task_pool->num_chunks; i++) {
+		chunk = &task_pool->chunks[i];
+		index = find_first_zero_bit(&chunk->alloc_table,
+					    task_pool->chunk_task_cnt);
+		if (index < task_pool->chunk_task_cnt)
+			goto found;
+	}
+
+	if (task_pool->num_chunks >= max(max_chunks, 1U))
+		return -EAGAIN;
+
+	chunk = &task_pool->chunks[task_pool->num_chunks];
+	err = nvhost_queue_task_chunk_alloc(queue->vm_pdev, queue, chunk,
+					    task_pool->chunk_task_cnt);
+	if (err)
+		return -EAGAIN;
+
+	task_pool->num_chunks++;
+	task_pool->max_task_cnt += task_pool->chunk_task_cnt;
+	index = 0;
+
+found:
+	set_bit(index, &chunk->alloc_table);
+	return i * task_pool->chunk_task_cnt + index;
+}
+
 int nvhost_queue_alloc_task_memory(
 			struct nvhost_queue *queue,
 			struct nvhost_queue_task_mem_info *task_mem_info)
 {
 	int err = 0;
-	int index, hw_offset, sw_offset;
+	int index, slot, hw_offset, sw_offset;
 	struct platform_device *pdev = queue->pool->pdev;
 	struct nvhost_queue_task_pool *task_pool =
 		(struct nvhost_queue_task_pool *)queue->task_pool;
+	struct nvhost_queue_task_chunk *chunk;
+	long timeout = msecs_to_jiffies(NVHOST_QUEUE_TASK_WAIT_MS);
 
 	mutex_lock(&task_pool->lock);
 
-	index = find_first_zero_bit(&task_pool->alloc_table,
-				    task_pool->max_task_cnt);
-
-	/* quit if pre-allocated task array is not free */
-	if (index >= task_pool->max_task_cnt) {
-		dev_err(&pdev->dev,
+	/* a full pool makes the submitter wait for the hardware to drain */
+	while ((index = nvhost_queue_get_task_slot(queue, task_pool)) < 0) {
+		mutex_unlock(&task_pool->lock);
+
+		timeout = wait_event_interruptible_timeout(task_pool->wq,
+				READ_ONCE(task_pool->num_used) <
+				READ_ONCE(task_pool->max_task_cnt), timeout);
+		if (timeout < 0)
+			return timeout;
+		if (timeout == 0) {
+			dev_err(&pdev->dev,
 				"failed to get Task Pool Memory\n");
-		err = -EAGAIN;
-		goto err_alloc_task_mem;
+			return -EAGAIN;
+		}
+
+		mutex_lock(&task_pool->lock);
 	}
 
 	/* assign the task array */
-	set_bit(index, &task_pool->alloc_table);
-	hw_offset = index * queue->task_dma_size;
-	sw_offset = index * queue->task_kmem_size;
+	chunk = &task_pool->chunks[index / task_pool->chunk_task_cnt];
+	slot = index % task_pool->chunk_task_cnt;
+	task_pool->num_used++;
+	hw_offset = slot * queue->task_dma_size;
+	sw_offset = slot * queue->task_kmem_size;
 	task_mem_info->kmem_addr =
-			(void *)((u8 *)task_pool->kmem_addr + sw_offset);
-	task_mem_info->va = (void *)((u8 *)task_pool->va + hw_offset);
-	task_mem_info->dma_addr = task_pool->dma_addr + hw_offset;
+			(void *)((u8 *)chunk->kmem_addr + sw_offset);
+	task_mem_info->va = (void *)((u8 *)chunk->va + hw_offset);
+	task_mem_info->dma_addr = chunk->dma_addr + hw_offset;
 	task_mem_info->pool_index = index;
 
-err_alloc_task_mem:
 	mutex_unlock(&task_pool->lock);
 
 	return err;
@@ -582,21 +695,28 @@ err_alloc_task_mem:
 
 void nvhost_queue_free_task_memory(struct nvhost_queue *queue, int index)
 {
-	int hw_offset, sw_offset;
+	int slot, hw_offset, sw_offset;
 	u8 *task_kmem, *task_dma_va;
 	struct nvhost_queue_task_pool *task_pool =
 			(struct nvhost_queue_task_pool *)queue->task_pool;
+	struct nvhost_queue_task_chunk *chunk;
+
+	chunk = &task_pool->chunks[index / task_pool->chunk_task_cnt];
+	slot = index % task_pool->chunk_task_cnt;
 
 	/* clear task kernel and dma virtual memory contents*/
-	hw_offset = index * queue->task_dma_size;
-	sw_offset = index * queue->task_kmem_size;
-	task_kmem = (u8 *)task_pool->kmem_addr + sw_offset;
-	task_dma_va = (u8 *)task_pool->va + hw_offset;
+	hw_offset = slot * queue->task_dma_size;
+	sw_offset = slot * queue->task_kmem_size;
+	task_kmem = (u8 *)chunk->kmem_addr + sw_offset;
+	task_dma_va = (u8 *)chunk->va + hw_offset;
 
 	memset(task_kmem, 0, queue->task_kmem_size);
 	memset(task_dma_va, 0, queue->task_dma_size);
 
 	mutex_lock(&task_pool->lock);
-	clear_bit(index, &task_pool->alloc_table);
+	clear_bit(slot, &chunk->alloc_table);
+	task_pool->num_used--;
 	mutex_unlock(&task_pool->lock);
+
+	wake_up_interruptible(&task_pool->wq);
 }
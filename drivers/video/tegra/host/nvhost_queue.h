@@ -98,6 +98,10 @@ struct nvhost_queue_ops {
 	int (*set_attribute)(struct nvhost_queue *queue, void *arg);
 };
 
+/* Queue task pools grow by their initial size up to this many times */
+#define NVHOST_QUEUE_DEFAULT_TASK_CHUNKS	4
+#define NVHOST_QUEUE_MAX_TASK_CHUNKS		8
+
 /**
  * @brief	Queue pool data structure to hold queue table
  *
@@ -108,6 +112,8 @@ struct nvhost_queue_ops {
  * alloc_table		Bitmap of allocated queues
  * max_queue_cnt	Max number queues available for client
  * queue_task_pool	Pointer to the task memory pool for queues.
+ * max_task_chunks	Number of times a queue task pool may grow to its
+ *			initial size
  *
  */
 struct nvhost_queue_pool {
@@ -118,6 +124,7 @@ struct nvhost_queue_pool {
 	unsigned long alloc_table;
 	unsigned int max_queue_cnt;
 	void *queue_task_pool;
+	u32 max_task_chunks;
 };
 
 /**
@@ -235,13 +242,15 @@ int nvhost_queue_get_task_size(struct nvhost_queue *queue);
  * @brief	Allocate a memory from task memory pool
  *
  * This function helps to assign a task memory from
- * the preallocated task memory pool. This memory is shared memory between
- * kernel and firmware
+ * the task memory pool. This memory is shared memory between kernel and
+ * firmware. The pool grows when all task memory is in use. Once it has
+ * reached its limit, the call waits for task memory to be freed.
  *
  * @queue		Pointer to an allocated queue
  * @task_mem_info	Pointer to nvhost_queue_task_mem_info struct
  *
- * @return	0 on success, otherwise a negative error code is returned
+ * @return	0 on success, -EAGAIN if no task memory was freed in time,
+ *		otherwise a negative error code is returned
  *
  */
 int nvhost_queue_alloc_task_memory(
@@ -260,6 +260,96 @@ void nvhost_scale_notify_busy(struct platform_device *pdev)
 	nvhost_scale_notify(pdev, true);
 }
 
+/*
+ * Time the hardware is expected to need for the jobs already queued to it,
+ * based on how long recent jobs took.
+ */
+
+static u64 nvhost_scale_backlog_us(struct nvhost_device_profile *profile)
+{
+	return (u64)max(atomic_read(&profile->pending_jobs), 0) *
+		READ_ONCE(profile->avg_job_us);
+}
+
+static void nvhost_scale_boost_work(struct work_struct *work)
+{
+	struct nvhost_device_profile *profile = container_of(work,
+			struct nvhost_device_profile, boost_work);
+	struct nvhost_device_data *pdata = platform_get_drvdata(profile->pdev);
+	struct devfreq *devfreq = pdata->power_manager;
+
+	if (!devfreq)
+		return;
+
+	mutex_lock(&devfreq->lock);
+#if defined(CONFIG_PM_DEVFREQ)
+	update_devfreq(devfreq);
+#endif
+	mutex_unlock(&devfreq->lock);
+}
+
+/*
+ * nvhost_scale_job_queued(pdev)
+ *
+ * Called when a job has been handed to the hardware. When the queued work
+ * crosses the boost threshold, re-evaluate the frequency at once instead of
+ * waiting for actmon to notice the load.
+ */
+
+void nvhost_scale_job_queued(struct platform_device *pdev)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+	u32 boost_us, avg_us;
+	int pending;
+
+	if (!profile)
+		return;
+
+	pending = atomic_inc_return(&profile->pending_jobs);
+
+	boost_us = READ_ONCE(profile->boost_us);
+	avg_us = READ_ONCE(profile->avg_job_us);
+	if (!boost_us || !pdata->power_manager)
+		return;
+
+	if ((u64)(pending - 1) * avg_us < boost_us &&
+	    (u64)pending * avg_us >= boost_us)
+		schedule_work(&profile->boost_work);
+}
+
+/*
+ * nvhost_scale_job_done(pdev, queued)
+ *
+ * Called when a job queued at the given time has completed. Jobs queued
+ * behind each other only start once the previous one is done, so their
+ * runtime is counted from the later of the two.
+ */
+
+void nvhost_scale_job_done(struct platform_device *pdev, ktime_t queued)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_device_profile *profile = pdata->power_profile;
+	ktime_t now = ktime_get();
+	s64 runtime;
+	u32 avg;
+
+	if (!profile)
+		return;
+
+	atomic_dec_if_positive(&profile->pending_jobs);
+
+	spin_lock(&profile->job_lock);
+	if (ktime_after(profile->last_job_done, queued))
+		queued = profile->last_job_done;
+	profile->last_job_done = now;
+
+	runtime = clamp_t(s64, ktime_us_delta(now, queued), 0, U32_MAX);
+	avg = profile->avg_job_us;
+	WRITE_ONCE(profile->avg_job_us, avg - avg / 8 + (u32)runtime / 8);
+	spin_unlock(&profile->job_lock);
+}
+
 /*
  * nvhost_scale_get_dev_status(dev, *stat)
  *
@@ -278,6 +368,12 @@ static int nvhost_scale_get_dev_status(struct device *dev,
 	if (profile->actmon[ENGINE_ACTMON])
 		update_load_estimate_actmon(profile);
 
+	/* report queued work as load so that a burst is met at high clock */
+	profile->dev_stat.busy_time = max_t(unsigned long,
+		profile->dev_stat.busy_time,
+		min_t(u64, nvhost_scale_backlog_us(profile),
+		      profile->dev_stat.total_time));
+
 	/* Copy the contents of the current device status */
 	*stat = profile->dev_stat;
 
@@ -348,6 +444,10 @@ void nvhost_scale_init(struct platform_device *pdev)
 	profile->clk = pdata->clk[0];
 	profile->dev_stat.busy = false;
 	profile->num_actmons = nvhost_get_host(pdev)->info.nb_actmons;
+	spin_lock_init(&profile->job_lock);
+	atomic_set(&profile->pending_jobs, 0);
+	profile->boost_us = 1000;
+	INIT_WORK(&profile->boost_work, nvhost_scale_boost_work);
 
 	/* Create frequency table */
 	err = nvhost_scale_make_freq_table(profile);
@@ -408,6 +508,9 @@ void nvhost_scale_init(struct platform_device *pdev)
 		}
 	}
 
+	debugfs_create_u32("scale_boost_us", S_IRUGO|S_IWUSR, pdata->debugfs,
+			   &profile->boost_us);
+
 	/* initialize devfreq if governor is set and actmon enabled */
 	if (pdata->actmon_enabled && pdata->devfreq_governor) {
 		struct devfreq *devfreq;
@@ -466,6 +569,8 @@ void nvhost_scale_deinit(struct platform_device *pdev)
 	if (!profile)
 		return;
 
+	cancel_work_sync(&profile->boost_work);
+
 	/* Remove devfreq from acm client list */
 	nvhost_module_remove_client(pdev, pdata->power_manager);
 
@@ -23,6 +23,9 @@
 
 #include <linux/nvhost.h>
 #include <linux/devfreq.h>
+#include <linux/ktime.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 struct platform_device;
 struct host1x_actmon;
@@ -48,6 +51,14 @@ struct nvhost_device_profile {
 	void				*private_data;
 	struct notifier_block		qos_notify_block;
 	int				num_actmons;
+
+	/* queued work, used to predict load ahead of actmon */
+	spinlock_t			job_lock;
+	atomic_t			pending_jobs;
+	u32				avg_job_us;	/* average job runtime */
+	ktime_t				last_job_done;
+	u32				boost_us;	/* backlog to boost at */
+	struct work_struct		boost_work;
 };
 
 #if defined(CONFIG_TEGRA_GRHOST_SCALE)
@@ -62,6 +73,13 @@ void nvhost_scale_deinit(struct platform_device *);
 void nvhost_scale_notify_busy(struct platform_device *);
 void nvhost_scale_notify_idle(struct platform_device *);
 
+/*
+ * call when a job is handed to the hardware and when it has completed, to
+ * let scaling account for work that is queued but not yet running
+ */
+void nvhost_scale_job_queued(struct platform_device *);
+void nvhost_scale_job_done(struct platform_device *, ktime_t queued);
+
 int nvhost_scale_hw_init(struct platform_device *);
 void nvhost_scale_hw_deinit(struct platform_device *);
 
@@ -72,6 +90,9 @@ static inline void nvhost_scale_init(struct platform_device *d) { }
 static inline void nvhost_scale_deinit(struct platform_device *d) { }
 static inline void nvhost_scale_notify_busy(struct platform_device *d) { }
 static inline void nvhost_scale_notify_idle(struct platform_device *d) { }
+static inline void nvhost_scale_job_queued(struct platform_device *d) { }
+static inline void nvhost_scale_job_done(struct platform_device *d,
+					 ktime_t queued) { }
 static inline int nvhost_scale_hw_init(struct platform_device *d)
 {
 	return 0;
@@ -475,6 +475,32 @@ int nvhost_sync_create_fence_fd(struct platform_device *pdev,
 }
 EXPORT_SYMBOL(nvhost_sync_create_fence_fd);
 
+/*
+ * Collapse points on the same syncpoint into the one that triggers last, so
+ * that the fence, and everyone waiting on it, only carries one point per
+ * syncpoint. Returns the number of points left at the start of @pts.
+ */
+static u32 nvhost_sync_merge_pts(struct nvhost_syncpt *sp,
+		struct nvhost_ctrl_sync_fence_info *pts, u32 num_pts)
+{
+	u32 i, j, num_merged = 0;
+
+	for (i = 0; i < num_pts; i++) {
+		for (j = 0; j < num_merged; j++)
+			if (pts[j].id == pts[i].id)
+				break;
+
+		if (j == num_merged)
+			pts[num_merged++] = pts[i];
+		else if (nvhost_syncpt_compare(sp, pts[i].id,
+					       pts[i].thresh,
+					       pts[j].thresh) > 0)
+			pts[j].thresh = pts[i].thresh;
+	}
+
+	return num_merged;
+}
+
 struct sync_fence *nvhost_sync_create_fence(struct platform_device *pdev,
 		struct nvhost_ctrl_sync_fence_info *pts,
 		u32 num_pts, const char *name)
@@ -497,6 +523,8 @@ struct sync_fence *nvhost_sync_create_fence(struct platform_device *pdev,
 
 	}
 
+	num_pts = nvhost_sync_merge_pts(sp, pts, num_pts);
+
 	for (i = 0; i < num_pts; i++) {
 		struct nvhost_sync_timeline *obj;
 		struct sync_pt *pt;
@@ -22,6 +22,7 @@
 #include <linux/nvhost_ioctl.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
 #include <linux/stat.h>
 #include <linux/export.h>
 #include <linux/delay.h>
@@ -118,11 +119,39 @@ u32 nvhost_syncpt_update_min(struct nvhost_syncpt *sp, u32 id)
 	u32 val;
 
 	val = syncpt_op().update_min(sp, id);
+	nvhost_syncpt_update_shadow(sp, id, val);
 	trace_nvhost_syncpt_update_min(id, val);
 
 	return val;
 }
 
+/**
+ * Map the shadow page of syncpoint min values read-only into userspace.
+ * The page is refreshed from the threshold interrupt and whenever the
+ * kernel reads a syncpoint, so pollers can avoid the ioctl and MMIO read.
+ */
+int nvhost_syncpt_mmap_shadow(struct nvhost_syncpt *sp,
+			      struct vm_area_struct *vma)
+{
+	unsigned long size = vma->vm_end - vma->vm_start;
+
+	if (!sp->shadow)
+		return -ENODEV;
+
+	if (vma->vm_pgoff || size > sp->shadow_size)
+		return -EINVAL;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	vma->vm_flags |= VM_DONTEXPAND | VM_DONTDUMP;
+
+	return remap_pfn_range(vma, vma->vm_start,
+			       virt_to_phys(sp->shadow) >> PAGE_SHIFT,
+			       size, vma->vm_page_prot);
+}
+
 /**
  * Tries to set last value read from hardware based on cached value.
  * Otherwise, retrieves and stores actual value from hardware.
@@ -213,6 +242,72 @@ static bool syncpt_update_min_is_expired(
 	return nvhost_syncpt_is_expired(sp, id, thresh);
 }
 
+u32 nvhost_syncpt_spin_us = 20;
+
+/*
+ * Spin budget for waits on a syncpoint. Waits are expected to take about
+ * as long as they did recently, so poll for a bit longer than that before
+ * arming the interrupt. If they usually take longer than the client is
+ * willing to spin, go to sleep straight away.
+ *
+ * A queue in polling completion mode has asked for its waits to poll for
+ * a fixed budget regardless of history; the interrupt is only the fallback
+ * once that runs out.
+ */
+static s64 syncpt_spin_budget_ns(struct nvhost_syncpt *sp, u32 id)
+{
+	s64 poll = READ_ONCE(sp->poll_us[id]);
+	s64 limit = READ_ONCE(sp->spin_us[id]);
+	s64 lat = atomic_read(&sp->wait_lat_ns[id]);
+	s64 budget = lat + lat / 2;
+
+	if (poll)
+		return poll * NSEC_PER_USEC;
+
+	if (!limit)
+		limit = READ_ONCE(nvhost_syncpt_spin_us);
+
+	return budget <= limit * NSEC_PER_USEC ? budget : 0;
+}
+
+static void syncpt_record_wait(struct nvhost_syncpt *sp, u32 id,
+			       struct nvhost_timespec *start,
+			       struct nvhost_timespec *done)
+{
+	s64 lat, avg;
+
+	if (start->clock != done->clock)
+		return;
+
+	lat = max_t(s64, timespec_to_ns(&done->ts) -
+			 timespec_to_ns(&start->ts), 0);
+	lat = min_t(s64, lat, INT_MAX);
+
+	/* races between concurrent waiters only perturb the average */
+	avg = atomic_read(&sp->wait_lat_ns[id]);
+	atomic_set(&sp->wait_lat_ns[id], (int)(avg - avg / 8 + lat / 8));
+}
+
+static bool syncpt_spin_is_expired(struct nvhost_syncpt *sp, u32 id,
+				   u32 thresh, struct nvhost_timespec *start)
+{
+	s64 budget = syncpt_spin_budget_ns(sp, id);
+	s64 start_ns = timespec_to_ns(&start->ts);
+	struct nvhost_timespec now;
+
+	if (!budget)
+		return false;
+
+	do {
+		if (syncpt_update_min_is_expired(sp, id, thresh))
+			return true;
+		cpu_relax();
+		nvhost_ktime_get_ts(&now);
+	} while (timespec_to_ns(&now.ts) - start_ns < budget);
+
+	return false;
+}
+
 /**
  * Main entrypoint for syncpoint value waits.
  */
@@ -225,6 +320,7 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 	int err = 0, check_count = 0, low_timeout = 0;
 	u32 val, old_val, new_val;
 	struct nvhost_master *host;
+	struct nvhost_timespec start, end;
 	bool syncpt_poll = false;
 	bool (*syncpt_is_expired)(struct nvhost_syncpt *sp,
 			u32 id,
@@ -282,6 +378,19 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 	}
 
 	old_val = val;
+	nvhost_ktime_get_ts(&start);
+
+	/* short waits are cheaper to spin on than to sleep on */
+	if (!syncpt_poll && !nvhost_dev_is_virtual(host->dev) &&
+	    syncpt_spin_is_expired(sp, id, thresh, &start)) {
+		nvhost_ktime_get_ts(&end);
+		syncpt_record_wait(sp, id, &start, &end);
+		if (value)
+			*value = nvhost_syncpt_read_min(sp, id);
+		if (ts)
+			*ts = end;
+		goto done;
+	}
 
 	/* Set up a threshold interrupt waiter */
 	if (!syncpt_poll) {
@@ -352,15 +461,11 @@ int nvhost_syncpt_wait_timeout(struct nvhost_syncpt *sp, u32 id,
 			syncpt_update_min_is_expired(sp, id, thresh)) {
 			if (value)
 				*value = nvhost_syncpt_read_min(sp, id);
-			if (ts) {
-				if (ref) {
-					err = nvhost_intr_release_time(ref, ts);
-					if (err)
-						nvhost_ktime_get_ts(ts);
-				} else {
-					nvhost_ktime_get_ts(ts);
-				}
-			}
+			if (!ref || nvhost_intr_release_time(ref, &end))
+				nvhost_ktime_get_ts(&end);
+			if (ts)
+				*ts = end;
+			syncpt_record_wait(sp, id, &start, &end);
 
 			err = 0;
 			break;
@@ -874,6 +979,7 @@ static u32 nvhost_get_syncpt(struct platform_device *pdev,
 	int ret = 0;
 	struct nvhost_master *host = nvhost_get_host(pdev);
 	struct nvhost_syncpt *sp = &host->syncpt;
+	struct nvhost_device_data *pdata;
 	struct device *d = &host->dev->dev;
 	unsigned long timeout = jiffies + NVHOST_SYNCPT_FREE_WAIT_TIMEOUT;
 
@@ -923,6 +1029,11 @@ static u32 nvhost_get_syncpt(struct platform_device *pdev,
 	if (syncpt_op().alloc)
 		syncpt_op().alloc(pdev, id);
 
+	pdata = platform_get_drvdata(pdev);
+	sp->spin_us[id] = pdata ? pdata->syncpt_spin_us : 0;
+	sp->poll_us[id] = 0;
+	atomic_set(&sp->wait_lat_ns[id], 0);
+
 	mutex_unlock(&sp->syncpt_mutex);
 
 	return id;
@@ -1023,6 +1134,8 @@ static void nvhost_free_syncpt(struct nvhost_syncpt *sp, u32 id)
 	nvhost_syncpt_set_min_eq_max(sp, id);
 	sp->assigned[id] = false;
 	sp->client_managed[id] = false;
+	sp->spin_us[id] = 0;
+	sp->poll_us[id] = 0;
 	kfree(sp->syncpt_names[id]);
 	sp->syncpt_names[id] = NULL;
 
@@ -1130,6 +1243,9 @@ int nvhost_syncpt_init(struct platform_device *dev,
 		kzalloc(sizeof(atomic_t) * nvhost_syncpt_nb_mlocks(sp),
 			GFP_KERNEL);
 	sp->ref = kzalloc(sizeof(atomic_t) * nb_pts, GFP_KERNEL);
+	sp->wait_lat_ns = kzalloc(sizeof(atomic_t) * nb_pts, GFP_KERNEL);
+	sp->spin_us = kzalloc(sizeof(u32) * nb_pts, GFP_KERNEL);
+	sp->poll_us = kzalloc(sizeof(u32) * nb_pts, GFP_KERNEL);
 #ifdef CONFIG_TEGRA_GRHOST_SYNC
 	sp->timeline = kzalloc(sizeof(struct nvhost_sync_timeline *) *
 			nb_pts, GFP_KERNEL);
@@ -1152,13 +1268,21 @@ int nvhost_syncpt_init(struct platform_device *dev,
 	}
 
 	if (!(sp->assigned && sp->client_managed && sp->min_val && sp->max_val
-		     && sp->lock_counts && sp->in_use && sp->ref)) {
+		     && sp->lock_counts && sp->in_use && sp->ref
+		     && sp->wait_lat_ns && sp->spin_us && sp->poll_us)) {
 		nvhost_err(&dev->dev, "syncpt in a wrong state");
 		/* frees happen in the deinit */
 		err = -ENOMEM;
 		goto fail;
 	}
 
+	/* shadow page is an optimisation, carry on without it */
+	sp->shadow_size = PAGE_ALIGN(nb_pts * sizeof(u32));
+	sp->shadow = alloc_pages_exact(sp->shadow_size,
+				       GFP_KERNEL | __GFP_ZERO);
+	if (!sp->shadow)
+		nvhost_warn(&dev->dev, "failed to allocate syncpt shadow");
+
 	sp->kobj = kobject_create_and_add("syncpt", &dev->dev.kobj);
 	if (!sp->kobj) {
 		nvhost_err(&dev->dev, "failed to create syncpt kobj");
@@ -1286,6 +1410,19 @@ void nvhost_syncpt_deinit(struct nvhost_syncpt *sp)
 	kfree(sp->ref);
 	sp->ref = NULL;
 
+	kfree(sp->wait_lat_ns);
+	sp->wait_lat_ns = NULL;
+
+	kfree(sp->spin_us);
+	sp->spin_us = NULL;
+
+	kfree(sp->poll_us);
+	sp->poll_us = NULL;
+
+	if (sp->shadow)
+		free_pages_exact(sp->shadow, sp->shadow_size);
+	sp->shadow = NULL;
+
 	kfree(sp->lock_counts);
 	sp->lock_counts = NULL;
 
@@ -1508,6 +1645,7 @@ void nvhost_syncpt_set_min_eq_max(struct nvhost_syncpt *sp, u32 id)
 {
 	sp = nvhost_get_syncpt_owner_struct(id, sp);
 	atomic_set(&sp->min_val[id], atomic_read(&sp->max_val[id]));
+	nvhost_syncpt_update_shadow(sp, id, nvhost_syncpt_read_min(sp, id));
 	syncpt_op().reset(sp, id);
 }
 
@@ -1565,3 +1703,25 @@ void nvhost_syncpt_set_maxval(struct platform_device *dev, u32 id, u32 val)
 	smp_wmb();
 }
 EXPORT_SYMBOL(nvhost_syncpt_set_maxval);
+
+/*
+ * Make waits on @id poll the syncpoint for up to @poll_us before falling
+ * back to the interrupt. Passing 0 returns to the adaptive spin.
+ */
+int nvhost_syncpt_set_poll_us(struct platform_device *dev, u32 id,
+			      u32 poll_us)
+{
+	struct nvhost_master *master = nvhost_get_host(dev);
+	struct nvhost_syncpt *sp = &master->syncpt;
+
+	if (!nvhost_syncpt_is_valid_hw_pt(sp, id))
+		return -EINVAL;
+
+	if (poll_us > NVHOST_SYNCPT_MAX_POLL_US)
+		return -EINVAL;
+
+	WRITE_ONCE(sp->poll_us[id], poll_us);
+
+	return 0;
+}
+EXPORT_SYMBOL(nvhost_syncpt_set_poll_us);
@@ -36,6 +36,7 @@
 #define NVHOST_SYNCPT_FREE_WAIT_TIMEOUT (1 * HZ)
 
 struct nvhost_syncpt;
+struct vm_area_struct;
 
 /* Attribute struct for sysfs min and max attributes */
 struct nvhost_syncpt_attr {
@@ -54,6 +55,11 @@ struct nvhost_syncpt {
 	atomic_t *max_val;
 	atomic_t *lock_counts;
 	atomic_t *ref;
+	atomic_t *wait_lat_ns;	/* average completion latency of waits */
+	u32 *spin_us;		/* spin limit of the owning client */
+	u32 *poll_us;		/* polling budget requested by a queue */
+	u32 *shadow;		/* min values, mapped read-only to userspace */
+	size_t shadow_size;
 	struct mutex cpu_increment_mutex;
 	const char **syncpt_names;
 	const char **last_used_by;
@@ -77,6 +83,12 @@ void nvhost_syncpt_deinit(struct nvhost_syncpt *);
 #define SYNCPT_POLL_PERIOD 1 /* msecs */
 #define MAX_STUCK_CHECK_COUNT 15
 
+/* default upper bound for spinning on a syncpt before sleeping, in usecs */
+extern u32 nvhost_syncpt_spin_us;
+
+/* upper bound for the polling budget a queue can ask for, in usecs */
+#define NVHOST_SYNCPT_MAX_POLL_US	2000
+
 /**
  * Updates the value sent to hardware.
  */
@@ -109,6 +121,19 @@ static inline u32 nvhost_syncpt_read_min(struct nvhost_syncpt *sp, u32 id)
 	return (u32)atomic_read(&sp->min_val[id]);
 }
 
+/**
+ * Publish a min value to the userspace shadow page
+ */
+static inline void nvhost_syncpt_update_shadow(struct nvhost_syncpt *sp,
+					       u32 id, u32 val)
+{
+	if (sp->shadow)
+		WRITE_ONCE(sp->shadow[id], val);
+}
+
+int nvhost_syncpt_mmap_shadow(struct nvhost_syncpt *sp,
+			      struct vm_area_struct *vma);
+
 void nvhost_syncpt_patch_check(struct nvhost_syncpt *sp);
 void nvhost_syncpt_set_min_eq_max(struct nvhost_syncpt *sp, u32 id);
 int nvhost_syncpt_client_managed(struct nvhost_syncpt *sp, u32 id);
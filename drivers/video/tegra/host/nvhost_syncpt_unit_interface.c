@@ -433,6 +433,33 @@ dma_addr_t nvhost_syncpt_address(struct platform_device *engine_pdev, u32 id)
 	return syncpt_unit_interface->start + SYNCPT_SIZE * id;
 }
 
+/**
+ * nvhost_syncpt_wait_address() - Get address to poll for a syncpoint wait
+ *
+ * @engine_pdev:	Pointer to the waiting host1x engine
+ * @vm_pdev:		Device the syncpoint aperture is mapped for
+ * @syncpt_id:		Syncpoint id, possibly owned by another engine
+ *
+ * Return:		IOVA address to compare the threshold against
+ *
+ * Engines that increment a syncpoint with a GoS backing also write the
+ * backing, so a waiter can poll GoS instead of the MSS syncpoint shim.
+ * This lets one engine wait on a fence of another one without the CPU.
+ * Syncpoints without a backing are polled through the shim.
+ */
+dma_addr_t nvhost_syncpt_wait_address(struct platform_device *engine_pdev,
+				      struct platform_device *vm_pdev,
+				      u32 syncpt_id)
+{
+	dma_addr_t addr;
+
+	addr = nvhost_syncpt_gos_address(engine_pdev, syncpt_id);
+	if (!addr)
+		addr = nvhost_syncpt_address(vm_pdev, syncpt_id);
+
+	return addr;
+}
+
 /**
  * nvhost_syncpt_unit_interface() - Initialize engine-side synchronization
  *
@@ -40,6 +40,9 @@ int nvhost_syncpt_release_gos_backing(struct nvhost_syncpt *sp,
 				      u32 syncpt_id);
 
 dma_addr_t nvhost_syncpt_address(struct platform_device *engine_pdev, u32 id);
+dma_addr_t nvhost_syncpt_wait_address(struct platform_device *engine_pdev,
+				      struct platform_device *vm_pdev,
+				      u32 syncpt_id);
 
 int nvhost_syncpt_unit_interface_init(struct platform_device *engine_pdev);
 
@@ -160,6 +160,8 @@ static void nvhost_vm_deinit(struct kref *kref)
 	list_del(&vm->vm_list);
 	mutex_unlock(&host->vm_mutex);
 
+	nvhost_pin_cache_flush(&vm->pin_cache);
+
 	if (vm_op().deinit && vm->enable_hw)
 		vm_op().deinit(vm);
 
@@ -235,6 +237,7 @@ struct nvhost_vm *nvhost_vm_allocate(struct platform_device *pdev,
 	vm->pdev = pdev;
 	vm->enable_hw = pdata->isolate_contexts;
 	vm->identifier = identifier;
+	nvhost_pin_cache_init(&vm->pin_cache);
 
 	/* add this vm into list of vms */
 	list_add_tail(&vm->vm_list, &host->vm_list);
@@ -261,6 +264,7 @@ err_init:
 	mutex_lock(&host->vm_mutex);
 	list_del(&vm->vm_list);
 	mutex_unlock(&host->vm_mutex);
+	nvhost_pin_cache_flush(&vm->pin_cache);
 	kfree(vm);
 err_alloc_vm:
 	mutex_unlock(&host->vm_alloc_mutex);
@@ -21,6 +21,8 @@
 
 #include <linux/kref.h>
 
+#include "nvhost_pin_cache.h"
+
 struct platform_device;
 struct nvhost_vm_pin;
 struct dma_buf;
@@ -44,6 +46,9 @@ struct nvhost_vm {
 
 	/* marks if hardware isolation is enabled */
 	bool enable_hw;
+
+	/* buffers kept pinned across jobs using this vm */
+	struct nvhost_pin_cache pin_cache;
 };
 
 struct nvhost_vm_static_buffer {
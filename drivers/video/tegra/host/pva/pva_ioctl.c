@@ -21,6 +21,7 @@
 #include <linux/uaccess.h>
 #include <linux/slab.h>
 #include <linux/nospec.h>
+#include <linux/mutex.h>
 
 #include <asm/ioctls.h>
 #include <asm/barrier.h>
@@ -39,11 +40,20 @@
  * pdev		Pointer the pva device
  * queue	Pointer the struct nvhost_queue
  * buffer	Pointer to the struct nvhost_buffer
+ * templates	Registered task templates, indexed by id - 1
+ * perf_counters	Stream VPU performance data of new tasks to eventlib
+ * poll_us	Completion polling budget set on the queue syncpoint
  */
 struct pva_private {
 	struct pva *pva;
 	struct nvhost_queue *queue;
 	struct nvhost_buffers *buffers;
+
+	struct mutex templates_lock;
+	struct pva_task_template *templates[PVA_MAX_TEMPLATES];
+
+	bool perf_counters;
+	u32 poll_us;
 };
 
 /**
@@ -145,6 +155,62 @@ err_out:
 	return err;
 }
 
+/**
+ * @brief	Allocate a task and append it to the task list
+ *
+ * The task memory comes from the queue pool and is cleared. Only the
+ * fields that tie the task to this file are filled in.
+ *
+ * @param priv		PVA Private data
+ * @param tasks_header	Task list that receives the new task
+ * @return		0 on Success or negative error code
+ *
+ */
+static int pva_alloc_task(struct pva_private *priv,
+			  struct pva_submit_tasks *tasks_header)
+{
+	struct nvhost_queue_task_mem_info task_mem_info;
+	struct pva_submit_task *task;
+	int err;
+
+	/* Allocate memory for the task and dma */
+	err = nvhost_queue_alloc_task_memory(priv->queue, &task_mem_info);
+	task = task_mem_info.kmem_addr;
+	if ((err < 0) || !task)
+		return err < 0 ? err : -ENOMEM;
+
+	task->pva = priv->pva;
+	task->queue = priv->queue;
+	task->buffers = priv->buffers;
+	task->perf_counters = READ_ONCE(priv->perf_counters);
+
+	task->dma_addr = task_mem_info.dma_addr;
+	task->va = task_mem_info.va;
+	task->pool_index = task_mem_info.pool_index;
+
+	tasks_header->tasks[tasks_header->num_tasks++] = task;
+
+	return 0;
+}
+
+/* Release the tasks that the queue did not take over */
+static void pva_free_unsubmitted(struct pva_submit_tasks *tasks_header)
+{
+	struct pva_submit_task *task;
+	int i;
+
+	/* submitted tasks are released when they complete */
+	for (i = tasks_header->num_submitted; i < tasks_header->num_tasks;
+	     i++) {
+		task = tasks_header->tasks[i];
+		if (task->tmpl)
+			pva_task_template_put(task->tmpl);
+
+		/* Release memory that was allocated for the task */
+		nvhost_queue_free_task_memory(task->queue, task->pool_index);
+	}
+}
+
 /**
  * @brief	Submit a task to PVA
  *
@@ -205,29 +271,14 @@ static int pva_submit(struct pva_private *priv, void *arg)
 	/* Go through the tasks and make a KMD representation of them */
 	for (i = 0; i < ioctl_tasks_header->num_tasks; i++) {
 
-		struct nvhost_queue_task_mem_info task_mem_info;
-
-		/* Allocate memory for the task and dma */
-		err = nvhost_queue_alloc_task_memory(priv->queue,
-							&task_mem_info);
-		task = task_mem_info.kmem_addr;
-		if ((err < 0) || !task)
+		err = pva_alloc_task(priv, &tasks_header);
+		if (err < 0)
 			goto err_get_task_buffer;
 
+		task = tasks_header.tasks[i];
 		err = pva_copy_task(ioctl_tasks + i, task);
 		if (err < 0)
 			goto err_copy_tasks;
-
-		task->pva = priv->pva;
-		task->queue = priv->queue;
-		task->buffers = priv->buffers;
-
-		task->dma_addr = task_mem_info.dma_addr;
-		task->va = task_mem_info.va;
-		task->pool_index = task_mem_info.pool_index;
-
-		tasks_header.tasks[i] = task;
-		tasks_header.num_tasks += 1;
 	}
 
 	/* Populate header structure */
@@ -262,11 +313,7 @@ static int pva_submit(struct pva_private *priv, void *arg)
 err_submit_task:
 err_get_task_buffer:
 err_copy_tasks:
-	for (i = 0; i < tasks_header.num_tasks; i++) {
-		task = tasks_header.tasks[i];
-		/* Release memory that was allocated for the task */
-		nvhost_queue_free_task_memory(task->queue, task->pool_index);
-	}
+	pva_free_unsubmitted(&tasks_header);
 err_alloc_task_mem:
 	kfree(ioctl_tasks);
 err_check_version:
@@ -274,6 +321,303 @@ err_check_num_tasks:
 	return err;
 }
 
+static struct pva_task_template *pva_get_template(struct pva_private *priv,
+						   u32 id)
+{
+	struct pva_task_template *tmpl;
+
+	if (id == 0 || id > PVA_MAX_TEMPLATES)
+		return NULL;
+
+	id = array_index_nospec(id - 1, PVA_MAX_TEMPLATES);
+
+	mutex_lock(&priv->templates_lock);
+	tmpl = priv->templates[id];
+	if (tmpl)
+		kref_get(&tmpl->ref);
+	mutex_unlock(&priv->templates_lock);
+
+	return tmpl;
+}
+
+/**
+ * @brief	Register a task template
+ *
+ * The template task is copied and validated like a regular task. Its
+ * parameters are pinned and its opaque data rendered by the queue code.
+ *
+ * @param priv	PVA Private data
+ * @param arg	ioctl data
+ * @return	0 on Success or negative error code
+ *
+ */
+static int pva_register_template(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_template_args *args = arg;
+	struct pva_ioctl_submit_task ioctl_task;
+	struct pva_task_template *tmpl;
+	int err;
+	u32 i;
+
+	if (copy_from_user(&ioctl_task, (void __user *)args->task,
+			   sizeof(ioctl_task)))
+		return -EFAULT;
+
+	tmpl = kzalloc(sizeof(*tmpl), GFP_KERNEL);
+	if (!tmpl)
+		return -ENOMEM;
+
+	err = pva_copy_task(&ioctl_task, &tmpl->task);
+	if (err < 0)
+		goto err_copy_task;
+
+	/* Fences are given on each submit */
+	tmpl->task.num_prefences = 0;
+	tmpl->task.num_postfences = 0;
+
+	tmpl->task.pva = priv->pva;
+	tmpl->task.queue = priv->queue;
+	tmpl->task.buffers = priv->buffers;
+
+	err = pva_task_template_init(tmpl);
+	if (err < 0)
+		goto err_copy_task;
+
+	mutex_lock(&priv->templates_lock);
+	for (i = 0; i < PVA_MAX_TEMPLATES; i++) {
+		if (!priv->templates[i]) {
+			priv->templates[i] = tmpl;
+			break;
+		}
+	}
+	mutex_unlock(&priv->templates_lock);
+
+	if (i == PVA_MAX_TEMPLATES) {
+		pva_task_template_put(tmpl);
+		return -EBUSY;
+	}
+
+	args->id = i + 1;
+
+	return 0;
+
+err_copy_task:
+	kfree(tmpl);
+	return err;
+}
+
+static int pva_unregister_template(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_template_args *args = arg;
+	struct pva_task_template *tmpl;
+	u32 id = args->id;
+
+	if (id == 0 || id > PVA_MAX_TEMPLATES)
+		return -EINVAL;
+
+	id = array_index_nospec(id - 1, PVA_MAX_TEMPLATES);
+
+	mutex_lock(&priv->templates_lock);
+	tmpl = priv->templates[id];
+	priv->templates[id] = NULL;
+	mutex_unlock(&priv->templates_lock);
+
+	if (!tmpl)
+		return -EINVAL;
+
+	/* tasks still in flight hold their own references */
+	pva_task_template_put(tmpl);
+
+	return 0;
+}
+
+static int pva_copy_template_surfaces(struct pva_surface *surfaces,
+				      u64 user_surfaces, unsigned int num)
+{
+	struct pva_template_surface handles[PVA_MAX_INPUT_SURFACES];
+	unsigned int i;
+
+	BUILD_BUG_ON(PVA_MAX_OUTPUT_SURFACES > PVA_MAX_INPUT_SURFACES);
+
+	if (num == 0)
+		return 0;
+
+	if (copy_from_user(handles, (void __user *)user_surfaces,
+			   num * sizeof(*handles)))
+		return -EFAULT;
+
+	for (i = 0; i < num; i++) {
+		surfaces[i].surface_handle = handles[i].surface_handle;
+		surfaces[i].surface_offset = handles[i].surface_offset;
+		surfaces[i].roi_handle = handles[i].roi_handle;
+		surfaces[i].roi_offset = handles[i].roi_offset;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief	Create a task from a template
+ *
+ * Everything but the surface buffers and the fences comes from the
+ * template, including the already pinned parameters. The primary
+ * payload and the pointers are not copied at all; the pre-rendered
+ * opaque data of the template is used when the task is written.
+ *
+ * @param tmpl		Template to create the task from
+ * @param ioctl_task	Per-submit data from userspace
+ * @param task		Pointer to a task that should be created
+ * @return		0 on Success or negative error code
+ *
+ */
+static int pva_copy_template_task(struct pva_task_template *tmpl,
+				  struct pva_ioctl_template_task *ioctl_task,
+				  struct pva_submit_task *task)
+{
+	struct pva_submit_task *tmpl_task = &tmpl->task;
+	int err;
+
+	if (ioctl_task->num_prefences > PVA_MAX_PREFENCES ||
+	    ioctl_task->num_postfences > PVA_MAX_POSTFENCES ||
+	    ioctl_task->num_input_surfaces != tmpl_task->num_input_surfaces ||
+	    ioctl_task->num_output_surfaces != tmpl_task->num_output_surfaces)
+		return -EINVAL;
+
+	task->operation			= tmpl_task->operation;
+	task->num_prefences		= ioctl_task->num_prefences;
+	task->num_postfences		= ioctl_task->num_postfences;
+	task->num_input_task_status	= tmpl_task->num_input_task_status;
+	task->num_output_task_status	= tmpl_task->num_output_task_status;
+	task->num_input_surfaces	= tmpl_task->num_input_surfaces;
+	task->num_output_surfaces	= tmpl_task->num_output_surfaces;
+	task->num_pointers		= tmpl_task->num_pointers;
+	task->primary_payload_size	= tmpl_task->primary_payload_size;
+	task->input_scalars		= tmpl_task->input_scalars;
+	task->input_scalars_ext		= tmpl_task->input_scalars_ext;
+	task->output_scalars		= tmpl_task->output_scalars;
+	task->output_scalars_ext	= tmpl_task->output_scalars_ext;
+	task->timeout			= tmpl_task->timeout;
+
+	memcpy(task->input_task_status, tmpl_task->input_task_status,
+	       task->num_input_task_status * sizeof(struct pva_status_handle));
+	memcpy(task->input_task_status_ext, tmpl_task->input_task_status_ext,
+	       task->num_input_task_status * sizeof(struct pva_parameter_ext));
+	memcpy(task->output_task_status, tmpl_task->output_task_status,
+	       task->num_output_task_status * sizeof(struct pva_status_handle));
+	memcpy(task->output_task_status_ext, tmpl_task->output_task_status_ext,
+	       task->num_output_task_status * sizeof(struct pva_parameter_ext));
+
+	/* Surface layout from the template, buffers from userspace */
+	memcpy(task->input_surfaces, tmpl_task->input_surfaces,
+	       task->num_input_surfaces * sizeof(struct pva_surface));
+	memcpy(task->output_surfaces, tmpl_task->output_surfaces,
+	       task->num_output_surfaces * sizeof(struct pva_surface));
+
+	err = pva_copy_template_surfaces(task->input_surfaces,
+					 ioctl_task->input_surfaces,
+					 task->num_input_surfaces);
+	if (err < 0)
+		return err;
+
+	err = pva_copy_template_surfaces(task->output_surfaces,
+					 ioctl_task->output_surfaces,
+					 task->num_output_surfaces);
+	if (err < 0)
+		return err;
+
+	if (task->num_prefences &&
+	    copy_from_user(task->prefences,
+			   (void __user *)ioctl_task->prefences,
+			   task->num_prefences * sizeof(struct pva_fence)))
+		return -EFAULT;
+
+	if (task->num_postfences &&
+	    copy_from_user(task->postfences,
+			   (void __user *)ioctl_task->postfences,
+			   task->num_postfences * sizeof(struct pva_fence)))
+		return -EFAULT;
+
+	return 0;
+}
+
+/**
+ * @brief	Submit tasks created from templates
+ *
+ * Works like pva_submit() with struct pva_ioctl_template_task as the
+ * per-task input.
+ *
+ * @param priv	PVA Private data
+ * @param arg	ioctl data
+ * @return	0 on Success or negative error code
+ *
+ */
+static int pva_submit_template(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_submit_template_args *args = arg;
+	struct pva_ioctl_template_task ioctl_tasks[PVA_MAX_TASKS];
+	struct pva_submit_tasks tasks_header;
+	struct pva_task_template *tmpl;
+	struct pva_submit_task *task;
+	unsigned int num_tasks;
+	int err = 0;
+	int i;
+
+	memset(&tasks_header, 0, sizeof(tasks_header));
+
+	if (args->num_tasks > PVA_MAX_TASKS)
+		return -EINVAL;
+
+	num_tasks = array_index_nospec(args->num_tasks, PVA_MAX_TASKS + 1);
+
+	if (copy_from_user(ioctl_tasks, (void __user *)args->tasks,
+			   num_tasks * sizeof(*ioctl_tasks)))
+		return -EFAULT;
+
+	for (i = 0; i < num_tasks; i++) {
+		tmpl = pva_get_template(priv, ioctl_tasks[i].template_id);
+		if (!tmpl) {
+			err = -EINVAL;
+			goto err_copy_tasks;
+		}
+
+		err = pva_alloc_task(priv, &tasks_header);
+		if (err < 0) {
+			pva_task_template_put(tmpl);
+			goto err_copy_tasks;
+		}
+
+		task = tasks_header.tasks[i];
+		task->tmpl = tmpl;
+
+		err = pva_copy_template_task(tmpl, ioctl_tasks + i, task);
+		if (err < 0)
+			goto err_copy_tasks;
+	}
+
+	tasks_header.flags = args->flags;
+
+	err = nvhost_queue_submit(priv->queue, &tasks_header);
+	if (err < 0)
+		goto err_copy_tasks;
+
+	/* Copy post-fences back to userspace */
+	for (i = 0; i < num_tasks; i++) {
+		task = tasks_header.tasks[i];
+		if (copy_to_user((void __user *)ioctl_tasks[i].postfences,
+				 task->postfences,
+				 sizeof(struct pva_fence) *
+				 task->num_postfences))
+			nvhost_warn(&priv->pva->pdev->dev,
+				    "Failed to copy fences to userspace");
+	}
+
+	return 0;
+
+err_copy_tasks:
+	pva_free_unsubmitted(&tasks_header);
+	return err;
+}
+
 /**
  * pva_queue_set_attr() - Set attribute to the queue
  *
@@ -426,6 +770,59 @@ pva_buffer_cpy_err:
 	return err;
 }
 
+static int pva_register_buffer(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_buffer_args *args = arg;
+	struct dma_buf *dmabuf;
+	int err;
+
+	dmabuf = dma_buf_get(args->handle);
+	if (IS_ERR_OR_NULL(dmabuf))
+		return -EFAULT;
+
+	err = nvhost_buffer_register(priv->buffers, dmabuf, &args->id);
+
+	dma_buf_put(dmabuf);
+
+	return err;
+}
+
+static int pva_unregister_buffer(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_buffer_args *args = arg;
+
+	return nvhost_buffer_unregister(priv->buffers, args->id);
+}
+
+static int pva_set_perf_counters(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_perf_counters *args = arg;
+
+	if (args->reserved)
+		return -EINVAL;
+
+	WRITE_ONCE(priv->perf_counters, !!args->enable);
+
+	return 0;
+}
+
+static int pva_set_completion_poll(struct pva_private *priv, void *arg)
+{
+	struct pva_ioctl_completion_poll *args = arg;
+	int err;
+
+	if (args->reserved)
+		return -EINVAL;
+
+	err = nvhost_syncpt_set_poll_us(priv->pva->pdev,
+					priv->queue->syncpt_id,
+					args->poll_us);
+	if (!err)
+		priv->poll_us = args->poll_us;
+
+	return err;
+}
+
 static int pva_get_characteristics(struct pva_private *priv,
 		void *arg)
 {
@@ -658,6 +1055,41 @@ static long pva_ioctl(struct file *file, unsigned int cmd,
 		err = pva_get_rate(priv, buf);
 		break;
 	}
+	case PVA_IOCTL_REGISTER_TEMPLATE:
+	{
+		err = pva_register_template(priv, buf);
+		break;
+	}
+	case PVA_IOCTL_UNREGISTER_TEMPLATE:
+	{
+		err = pva_unregister_template(priv, buf);
+		break;
+	}
+	case PVA_IOCTL_SUBMIT_TEMPLATE:
+	{
+		err = pva_submit_template(priv, buf);
+		break;
+	}
+	case PVA_IOCTL_REGISTER_BUFFER:
+	{
+		err = pva_register_buffer(priv, buf);
+		break;
+	}
+	case PVA_IOCTL_UNREGISTER_BUFFER:
+	{
+		err = pva_unregister_buffer(priv, buf);
+		break;
+	}
+	case PVA_IOCTL_SET_PERF_COUNTERS:
+	{
+		err = pva_set_perf_counters(priv, buf);
+		break;
+	}
+	case PVA_IOCTL_SET_COMPLETION_POLL:
+	{
+		err = pva_set_completion_poll(priv, buf);
+		break;
+	}
 	default:
 		return -ENOIOCTLCMD;
 	}
@@ -740,6 +1172,7 @@ static int pva_open(struct inode *inode, struct file *file)
 
 	file->private_data = priv;
 	priv->pva = pva;
+	mutex_init(&priv->templates_lock);
 
 	/* add the pva client to nvhost */
 	err = nvhost_module_add_client(pdev, priv);
@@ -787,6 +1220,18 @@ err_alloc_priv:
 static int pva_release(struct inode *inode, struct file *file)
 {
 	struct pva_private *priv = file->private_data;
+	unsigned int i;
+
+	/* Tasks still in flight keep their templates alive */
+	for (i = 0; i < PVA_MAX_TEMPLATES; i++) {
+		if (priv->templates[i])
+			pva_task_template_put(priv->templates[i]);
+	}
+
+	/* Next user of the queue gets interrupt driven completion */
+	if (priv->poll_us)
+		nvhost_syncpt_set_poll_us(priv->pva->pdev,
+					  priv->queue->syncpt_id, 0);
 
 	/*
 	 * Queue attributes are referenced from the queue
@@ -102,6 +102,7 @@ struct pva_hw_task {
 
 static void pva_task_dump(struct pva_submit_task *task)
 {
+	struct pva_submit_task *params = task->tmpl ? &task->tmpl->task : task;
 	int i;
 
 	nvhost_dbg_info("task=%p, "
@@ -115,7 +116,7 @@ static void pva_task_dump(struct pva_submit_task *task)
 			task->input_surfaces,
 			task->output_scalars.handle, task->output_scalars.offset,
 			task->output_surfaces,
-			task->primary_payload, task->primary_payload_size);
+			params->primary_payload, task->primary_payload_size);
 
 	for (i = 0; i < task->num_prefences; i++)
 		nvhost_dbg_info("prefence %d: type=%u, "
@@ -181,8 +182,8 @@ static void pva_task_dump(struct pva_submit_task *task)
 
 	for (i = 0; i < task->num_pointers; i++)
 		nvhost_dbg_info("pointer %d: handle=%u, offset=%u",
-				i, task->pointers[i].handle,
-				task->pointers[i].offset);
+				i, params->pointers[i].handle,
+				params->pointers[i].offset);
 
 	for (i = 0; i < task->num_input_task_status; i++)
 		nvhost_dbg_info("input task status %d: handle=%u, offset=%u",
@@ -202,20 +203,96 @@ static void pva_task_get_memsize(size_t *dma_size, size_t *kmem_size)
 	*kmem_size = sizeof(struct pva_submit_task);
 }
 
-static void pva_task_unpin_mem(struct pva_submit_task *task)
-{
-	int i;
-
 #define UNPIN_MEMORY(dst_name)						\
 	do {								\
-		if ((((dst_name).dmabuf) != NULL) &&			\
-				((dst_name).dma_addr != 0)) {		\
-			nvhost_buffer_submit_unpin(task->buffers,	\
-				&((dst_name).dmabuf), 1);		\
-			dma_buf_put((dst_name).dmabuf);			\
+		if ((((dst_name).dmabuf) == NULL) ||			\
+				((dst_name).dma_addr == 0)) {		\
+			break;						\
+		}							\
+									\
+		if ((dst_name).registered) {				\
+			nvhost_buffer_submit_unpin_registered(		\
+				task->buffers, (dst_name).dmabuf);	\
+			break;						\
+		}							\
+									\
+		nvhost_buffer_submit_unpin(task->buffers,		\
+			&((dst_name).dmabuf), 1);			\
+		dma_buf_put((dst_name).dmabuf);				\
+	} while (0)
+
+/*
+ * Registered buffers are already mapped for the life of the queue and are
+ * pinned by id, without resolving the memory handle.
+ */
+#define PIN_MEMORY(dst_name, dmabuf_fd)					\
+	do {								\
+		if (!(dmabuf_fd)) {					\
+			err = -EFAULT;					\
+			goto err_map_handle;				\
+		}							\
+									\
+		if ((dmabuf_fd) & PVA_REGISTERED_HANDLE_FLAG) {		\
+			err = nvhost_buffer_submit_pin_registered(	\
+				task->buffers,				\
+				(dmabuf_fd) & ~PVA_REGISTERED_HANDLE_FLAG, \
+				&(dst_name).dmabuf,			\
+				&(dst_name).dma_addr,			\
+				&(dst_name).size,			\
+				&(dst_name).heap);			\
+			if (err < 0)					\
+				goto err_map_handle;			\
+			(dst_name).registered = true;			\
+			break;						\
+		}							\
+									\
+		((dst_name).dmabuf) = dma_buf_get(dmabuf_fd);		\
+		if (IS_ERR_OR_NULL((dst_name).dmabuf)) {		\
+			(dst_name).dmabuf = NULL;			\
+			err = -EFAULT;					\
+			goto err_map_handle;				\
 		}							\
+									\
+		err = nvhost_buffer_submit_pin(task->buffers,		\
+				&(dst_name).dmabuf, 1,			\
+				&(dst_name).dma_addr,			\
+				&(dst_name).size,			\
+				&(dst_name).heap);			\
+		if (err < 0)						\
+			goto err_map_handle;				\
 	} while (0)
 
+/* Unpin the buffers that do not change between submits of a template */
+static void pva_task_unpin_params(struct pva_submit_task *task)
+{
+	int i;
+
+	for (i = 0; i < task->num_input_task_status; i++) {
+		if (task->input_task_status[i].handle) {
+			UNPIN_MEMORY(task->input_task_status_ext[i]);
+		}
+	}
+
+	for (i = 0; i < task->num_output_task_status; i++) {
+		if (task->output_task_status[i].handle) {
+			UNPIN_MEMORY(task->output_task_status_ext[i]);
+		}
+	}
+
+	for (i = 0; i < task->num_pointers; i++) {
+		if (task->pointers[i].handle) {
+			UNPIN_MEMORY(task->pointers_ext[i]);
+		}
+	}
+
+	UNPIN_MEMORY(task->input_scalars_ext);
+	UNPIN_MEMORY(task->output_scalars_ext);
+}
+
+static void pva_task_unpin_mem(struct pva_submit_task *task)
+{
+	int i;
+
 	for (i = 0; i < task->num_input_surfaces; i++) {
 		UNPIN_MEMORY(task->input_surfaces_ext[i]);
 		UNPIN_MEMORY(task->input_surface_rois_ext[i]);
@@ -239,28 +316,53 @@ static void pva_task_unpin_mem(struct pva_submit_task *task)
 			UNPIN_MEMORY(task->postfences_sema_ext[i]);
 	}
 
+	/* The template keeps its own pins */
+	if (!task->tmpl)
+		pva_task_unpin_params(task);
+}
+
+static int pva_task_pin_params(struct pva_submit_task *task)
+{
+	int err;
+	int i;
+
+	/* Pin the input and output action status */
 	for (i = 0; i < task->num_input_task_status; i++) {
 		if (task->input_task_status[i].handle) {
-			UNPIN_MEMORY(task->input_task_status_ext[i]);
+			PIN_MEMORY(task->input_task_status_ext[i],
+				task->input_task_status[i].handle);
 		}
 	}
 
 	for (i = 0; i < task->num_output_task_status; i++) {
 		if (task->output_task_status[i].handle) {
-			UNPIN_MEMORY(task->output_task_status_ext[i]);
+			PIN_MEMORY(task->output_task_status_ext[i],
+				task->output_task_status[i].handle);
 		}
 	}
 
+	/* Pin task pointers */
 	for (i = 0; i < task->num_pointers; i++) {
 		if (task->pointers[i].handle) {
-			UNPIN_MEMORY(task->pointers_ext[i]);
+			PIN_MEMORY(task->pointers_ext[i],
+				   task->pointers[i].handle);
 		}
 	}
 
-	UNPIN_MEMORY(task->input_scalars_ext);
-	UNPIN_MEMORY(task->output_scalars_ext);
+	/* Pin rest */
+	if (task->input_scalars.handle)
+		PIN_MEMORY(task->input_scalars_ext,
+			task->input_scalars.handle);
 
-#undef UNPIN_MEMORY
+	if (task->output_scalars.handle)
+		PIN_MEMORY(task->output_scalars_ext,
+			task->output_scalars.handle);
+
+	return 0;
+
+err_map_handle:
+	pva_task_unpin_params(task);
+	return err;
 }
 
 static int pva_task_pin_mem(struct pva_submit_task *task)
@@ -270,28 +372,12 @@ static int pva_task_pin_mem(struct pva_submit_task *task)
 	int err;
 	int i;
 
-#define PIN_MEMORY(dst_name, dmabuf_fd)					\
-	do {								\
-		if (!(dmabuf_fd)) {					\
-			err = -EFAULT;					\
-			goto err_map_handle;				\
-		}							\
-									\
-		((dst_name).dmabuf) = dma_buf_get(dmabuf_fd);		\
-		if (IS_ERR_OR_NULL((dst_name).dmabuf)) {		\
-			(dst_name).dmabuf = NULL;			\
-			err = -EFAULT;					\
-			goto err_map_handle;				\
-		}							\
-									\
-		err = nvhost_buffer_submit_pin(task->buffers,		\
-				&(dst_name).dmabuf, 1,			\
-				&(dst_name).dma_addr,			\
-				&(dst_name).size,			\
-				&(dst_name).heap);			\
-		if (err < 0)						\
-			goto err_map_handle;				\
-	} while (0)
+	/* Template tasks reuse the pins of the template */
+	if (!task->tmpl) {
+		err = pva_task_pin_params(task);
+		if (err < 0)
+			return err;
+	}
 
 	/* Pin input surfaces */
 	for (i = 0; i < task->num_input_surfaces; i++) {
@@ -363,38 +449,6 @@ static int pva_task_pin_mem(struct pva_submit_task *task)
 		}
 	}
 
-	/* Pin the input and output action status */
-	for (i = 0; i < task->num_input_task_status; i++) {
-		if (task->input_task_status[i].handle) {
-			PIN_MEMORY(task->input_task_status_ext[i],
-				task->input_task_status[i].handle);
-		}
-	}
-
-	for (i = 0; i < task->num_output_task_status; i++) {
-		if (task->output_task_status[i].handle) {
-			PIN_MEMORY(task->output_task_status_ext[i],
-				task->output_task_status[i].handle);
-		}
-	}
-
-	/* Pin task pointers */
-	for (i = 0; i < task->num_pointers; i++) {
-		if (task->pointers[i].handle) {
-			PIN_MEMORY(task->pointers_ext[i],
-				   task->pointers[i].handle);
-		}
-	}
-
-	/* Pin rest */
-	if (task->input_scalars.handle)
-		PIN_MEMORY(task->input_scalars_ext,
-			task->input_scalars.handle);
-
-	if (task->output_scalars.handle)
-		PIN_MEMORY(task->output_scalars_ext,
-			task->output_scalars.handle);
-
 #undef PIN_MEMORY
 
 	return 0;
@@ -404,6 +458,8 @@ err_map_handle:
 	return err;
 }
 
+#undef UNPIN_MEMORY
+
 static void pva_task_write_surfaces(struct pva_task_surface *hw_surface,
 		struct pva_surface *surface,
 		struct pva_parameter_ext *surface_ext,
@@ -509,6 +565,8 @@ static inline int pva_task_write_ptr_op(u8 *base, u8 action, u64 addr, u32 val)
 static int pva_task_write_preactions(struct pva_submit_task *task,
 				     struct pva_hw_task *hw_task)
 {
+	struct nvhost_master *host = nvhost_get_host(task->pva->pdev);
+	struct nvhost_syncpt *sp = &host->syncpt;
 	u8 *hw_preactions = hw_task->preactions;
 	int i = 0, j = 0, ptr = 0;
 
@@ -518,13 +576,22 @@ static int pva_task_write_preactions(struct pva_submit_task *task,
 
 		switch (fence->type) {
 		case PVA_FENCE_TYPE_SYNCPT: {
-			dma_addr_t syncpt_addr = nvhost_syncpt_gos_address(
+			dma_addr_t syncpt_addr;
+			u32 id = fence->syncpoint_index;
+
+			/* the fence may come from any engine, e.g. DLA */
+			if (!nvhost_syncpt_is_valid_hw_pt_nospec(sp, &id))
+				return -EINVAL;
+
+			/* nothing to wait for, keep the engine from polling */
+			if (nvhost_syncpt_is_expired(sp, id,
+						fence->syncpoint_value))
+				break;
+
+			syncpt_addr = nvhost_syncpt_wait_address(
 							task->pva->pdev,
-							fence->syncpoint_index);
-			if (!syncpt_addr)
-				syncpt_addr = nvhost_syncpt_address(
 							task->queue->vm_pdev,
-							fence->syncpoint_index);
+							id);
 
 			ptr += pva_task_write_ptr_op(&hw_preactions[ptr],
 				TASK_ACT_PTR_BLK_GTREQL, syncpt_addr,
@@ -545,9 +612,6 @@ static int pva_task_write_preactions(struct pva_submit_task *task,
 			dma_addr_t syncpt_addr;
 			struct sync_fence *syncfd_fence;
 			struct sync_pt *pt;
-			struct nvhost_master *host = nvhost_get_host(
-							task->pva->pdev);
-			struct nvhost_syncpt *sp = &host->syncpt;
 
 			if (!fence->sync_fd)
 				break;
@@ -576,11 +640,10 @@ static int pva_task_write_preactions(struct pva_submit_task *task,
 							id, thresh))
 					continue;
 
-				syncpt_addr = nvhost_syncpt_gos_address(
-							task->pva->pdev, id);
-				if (!syncpt_addr)
-					syncpt_addr = nvhost_syncpt_address(
-							task->queue->vm_pdev, id);
+				syncpt_addr = nvhost_syncpt_wait_address(
+							task->pva->pdev,
+							task->queue->vm_pdev,
+							id);
 
 				ptr += pva_task_write_ptr_op(
 						&hw_preactions[ptr],
@@ -673,14 +736,18 @@ static void pva_task_write_postactions(struct pva_submit_task *task,
 	}
 
 	/* Make a syncpoint increment */
-	if (syncpt_gos_addr) {
-		thresh = nvhost_syncpt_read_maxval(host1x_pdev,
-				task->queue->syncpt_id) + 1;
+	if (!task->no_syncpt_incr) {
+		if (syncpt_gos_addr) {
+			thresh = nvhost_syncpt_read_maxval(host1x_pdev,
+					task->queue->syncpt_id) +
+				 task->batch_incrs_before + 1;
+			ptr += pva_task_write_ptr_op(&hw_postactions[ptr],
+				TASK_ACT_PTR_WRITE_VAL, syncpt_gos_addr,
+				thresh);
+		}
 		ptr += pva_task_write_ptr_op(&hw_postactions[ptr],
-			TASK_ACT_PTR_WRITE_VAL, syncpt_gos_addr, thresh);
+			TASK_ACT_PTR_WRITE_VAL, syncpt_addr, 1);
 	}
-	ptr += pva_task_write_ptr_op(&hw_postactions[ptr],
-		TASK_ACT_PTR_WRITE_VAL, syncpt_addr, 1);
 
 	output_status_addr = task->dma_addr +
 			     offsetof(struct pva_hw_task, statistics);
@@ -689,7 +756,7 @@ static void pva_task_write_postactions(struct pva_submit_task *task,
 				TASK_ACT_PVA_STATISTICS,
 				output_status_addr, 1);
 
-	if (task->pva->vpu_perf_counters_enable) {
+	if (task->pva->vpu_perf_counters_enable || task->perf_counters) {
 		ptr += pva_task_write_struct_ptr_op(
 				&hw_postactions[ptr],
 				TASK_ACT_PVA_VPU_PERF_COUNTERS,
@@ -808,10 +875,14 @@ static void pva_task_write_non_surfaces(struct pva_submit_task *task,
 #undef COPY_PARAMETER
 }
 
-static int pva_task_write_opaque_data(struct pva_submit_task *task,
-				      struct pva_hw_task *hw_task)
+/*
+ * Write the opaque data descriptor, the primary payload and the pointer
+ * list. None of it depends on where the task itself lives, which lets a
+ * template render it once.
+ */
+static int pva_task_render_opaque_data(struct pva_submit_task *task,
+				       u8 *opaque_data, u32 *opaque_size)
 {
-	struct pva_task_parameter_array *opaque_parameter;
 	struct pva_task_opaque_data_desc *opaque_desc;
 	struct pva_parameter_ext *handle_ext;
 	unsigned int primary_payload_offset;
@@ -823,9 +894,6 @@ static int pva_task_write_opaque_data(struct pva_submit_task *task,
 	u64 aux, size, flags;
 	unsigned int i;
 
-	if (task->num_pointers == 0 && task->primary_payload_size == 0)
-		return 0;
-
 	/* Calculate size of the opaque data */
 	num_bytes = sizeof(struct pva_task_opaque_data_desc);
 	num_bytes += task->primary_payload_size;
@@ -834,29 +902,17 @@ static int pva_task_write_opaque_data(struct pva_submit_task *task,
 	if (num_bytes > PVA_MAX_PRIMARY_PAYLOAD_SIZE)
 		return -ENOMEM;
 
-	/* Opaque parameter resides always in the input parameter block */
-	opaque_parameter = hw_task->input_parameter_array +
-			   hw_task->task.num_input_parameters;
-
-	/* Write parameter descriptor */
-	opaque_parameter->address = task->dma_addr +
-				     offsetof(struct pva_hw_task,
-					      opaque_data);
-	opaque_parameter->type = PVA_PARAM_OPAQUE_DATA;
-	opaque_parameter->size = num_bytes;
-	hw_task->task.num_input_parameters++;
-
 	/* Determine offset to the primary_payload start */
 	primary_payload_offset = sizeof(struct pva_task_opaque_data_desc);
-	primary_payload = hw_task->opaque_data + primary_payload_offset;
+	primary_payload = opaque_data + primary_payload_offset;
 
 	/* Determine offset to the start of the pointer list */
 	pointer_list_offset = primary_payload_offset +
 		task->primary_payload_size;
-	pointers = hw_task->opaque_data + pointer_list_offset;
+	pointers = opaque_data + pointer_list_offset;
 
 	/* Initialize the opaque data descriptor */
-	opaque_desc = (void *)hw_task->opaque_data;
+	opaque_desc = (void *)opaque_data;
 	opaque_desc->primary_payload_size = task->primary_payload_size;
 
 	/* Copy the primary_payload */
@@ -889,6 +945,44 @@ static int pva_task_write_opaque_data(struct pva_submit_task *task,
 		pointers += sizeof(pointer);
 	}
 
+	*opaque_size = num_bytes;
+
+	return 0;
+}
+
+static int pva_task_write_opaque_data(struct pva_submit_task *task,
+				      struct pva_hw_task *hw_task)
+{
+	struct pva_task_template *tmpl = task->tmpl;
+	struct pva_task_parameter_array *opaque_parameter;
+	u32 num_bytes;
+	int err;
+
+	if (task->num_pointers == 0 && task->primary_payload_size == 0)
+		return 0;
+
+	if (tmpl) {
+		num_bytes = tmpl->opaque_size;
+		memcpy(hw_task->opaque_data, tmpl->opaque_data, num_bytes);
+	} else {
+		err = pva_task_render_opaque_data(task, hw_task->opaque_data,
+						  &num_bytes);
+		if (err < 0)
+			return err;
+	}
+
+	/* Opaque parameter resides always in the input parameter block */
+	opaque_parameter = hw_task->input_parameter_array +
+			   hw_task->task.num_input_parameters;
+
+	/* Write parameter descriptor */
+	opaque_parameter->address = task->dma_addr +
+				     offsetof(struct pva_hw_task,
+					      opaque_data);
+	opaque_parameter->type = PVA_PARAM_OPAQUE_DATA;
+	opaque_parameter->size = num_bytes;
+	hw_task->task.num_input_parameters++;
+
 	return 0;
 }
 
@@ -927,6 +1021,7 @@ static int pva_task_write(struct pva_submit_task *task, bool atomic)
 						  input_parameter_array);
 	hw_task->task.output_parameters = offsetof(struct pva_hw_task,
 						  output_parameter_array);
+	hw_task->task.gen_task.next = 0;
 	hw_task->task.gen_task.versionid = TASK_VERSION_ID;
 	hw_task->task.gen_task.engineid = PVA_ENGINE_ID;
 	hw_task->task.gen_task.sequence = 0;
@@ -980,6 +1075,42 @@ static int pva_task_write(struct pva_submit_task *task, bool atomic)
 	return 0;
 }
 
+int pva_task_template_init(struct pva_task_template *tmpl)
+{
+	struct pva_submit_task *task = &tmpl->task;
+	int err;
+
+	kref_init(&tmpl->ref);
+
+	err = pva_task_pin_params(task);
+	if (err < 0)
+		return err;
+
+	if (task->num_pointers == 0 && task->primary_payload_size == 0)
+		return 0;
+
+	err = pva_task_render_opaque_data(task, tmpl->opaque_data,
+					  &tmpl->opaque_size);
+	if (err < 0)
+		pva_task_unpin_params(task);
+
+	return err;
+}
+
+static void pva_task_template_release(struct kref *ref)
+{
+	struct pva_task_template *tmpl =
+		container_of(ref, struct pva_task_template, ref);
+
+	pva_task_unpin_params(&tmpl->task);
+	kfree(tmpl);
+}
+
+void pva_task_template_put(struct pva_task_template *tmpl)
+{
+	kref_put(&tmpl->ref, pva_task_template_release);
+}
+
 #ifdef CONFIG_EVENTLIB
 static void pva_eventlib_record_perf_counter(struct platform_device *pdev,
 				      u32 operation,
@@ -994,7 +1125,9 @@ static void pva_eventlib_record_perf_counter(struct platform_device *pdev,
 	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
 	struct nvhost_vpu_perf_counter perf_counter;
 
-	if (!pdata->eventlib_id)
+	if (!pdata->eventlib_id ||
+	    !keventlib_type_enabled(pdata->eventlib_id,
+				    NVHOST_VPU_PERF_COUNTER))
 		return;
 
 	perf_counter.operation = operation;
@@ -1013,6 +1146,47 @@ static void pva_eventlib_record_perf_counter(struct platform_device *pdev,
 			NVHOST_VPU_PERF_COUNTER,
 			timestamp);
 }
+
+static u64 pva_stats_delta(u64 start, u64 end)
+{
+	return end > start ? end - start : 0;
+}
+
+static void pva_eventlib_record_task_perf(struct platform_device *pdev,
+					  struct pva_submit_task *task,
+					  struct pva_task_statistics *stats)
+{
+	struct nvhost_device_data *pdata = platform_get_drvdata(pdev);
+	struct nvhost_pva_task_perf task_perf;
+
+	if (!pdata->eventlib_id ||
+	    !keventlib_type_enabled(pdata->eventlib_id, NVHOST_PVA_TASK_PERF))
+		return;
+
+	task_perf.class_id = pdata->class;
+	task_perf.syncpt_id = task->queue->syncpt_id;
+	task_perf.syncpt_thresh = task->syncpt_thresh;
+	task_perf.operation = task->operation;
+	task_perf.vpu = stats->vpu_assigned;
+	task_perf.queue_wait = pva_stats_delta(stats->queued_time,
+					       stats->head_time);
+	task_perf.input_actions = pva_stats_delta(stats->head_time,
+					stats->input_actions_complete);
+	task_perf.vpu_wait = pva_stats_delta(stats->input_actions_complete,
+					     stats->vpu_assigned_time);
+	task_perf.vpu_setup = pva_stats_delta(stats->vpu_assigned_time,
+					      stats->vpu_start_time);
+	task_perf.vpu_run = pva_stats_delta(stats->vpu_start_time,
+					    stats->vpu_complete_time);
+	task_perf.output_actions = pva_stats_delta(stats->vpu_complete_time,
+						   stats->complete_time);
+
+	keventlib_write(pdata->eventlib_id,
+			&task_perf,
+			sizeof(task_perf),
+			NVHOST_PVA_TASK_PERF,
+			stats->complete_time);
+}
 #else
 static void pva_eventlib_record_perf_counter(struct platform_device *pdev,
 				      u32 operation,
@@ -1025,6 +1199,12 @@ static void pva_eventlib_record_perf_counter(struct platform_device *pdev,
 				      u64 timestamp)
 {
 }
+
+static void pva_eventlib_record_task_perf(struct platform_device *pdev,
+					  struct pva_submit_task *task,
+					  struct pva_task_statistics *stats)
+{
+}
 #endif
 
 static void pva_task_update(struct pva_submit_task *task)
@@ -1077,7 +1257,10 @@ static void pva_task_update(struct pva_submit_task *task)
 			stats->complete_time,
 			stats->vpu_assigned);
 
-	if (task->pva->vpu_perf_counters_enable) {
+	if (task->perf_counters)
+		pva_eventlib_record_task_perf(pdev, task, stats);
+
+	if (task->pva->vpu_perf_counters_enable || task->perf_counters) {
 		for (idx = 0; idx < PVA_TASK_VPU_NUM_PERF_COUNTERS; idx++) {
 			perf = &hw_task->vpu_perf_counters[idx];
 			if (perf->count != 0) {
@@ -1096,6 +1279,8 @@ static void pva_task_update(struct pva_submit_task *task)
 
 	/* Unpin job memory. PVA shouldn't be using it anymore */
 	pva_task_unpin_mem(task);
+	if (task->tmpl)
+		pva_task_template_put(task->tmpl);
 
 	/* Drop PM runtime reference of PVA */
 	nvhost_module_idle(task->pva->pdev);
@@ -1168,31 +1353,41 @@ static void pva_queue_dump(struct nvhost_queue *queue, struct seq_file *s)
 	mutex_unlock(&queue->list_lock);
 }
 
-static int pva_task_submit_channel_ccq(struct pva_submit_task *task,
-				       u32 *thresh)
+/*
+ * Submit a chain of tasks starting at tasks[0]. The channel waits for the
+ * pre-fences of every task in the chain before ringing the doorbell.
+ */
+static int pva_task_submit_channel_ccq(struct pva_submit_task **tasks,
+				       unsigned int num_tasks,
+				       u32 num_incrs, u32 *thresh)
 {
+	struct pva_submit_task *task = tasks[0];
 	struct nvhost_queue *queue = task->queue;
 	u64 fifo_flags = PVA_FIFO_INT_ON_ERR;
 	u64 fifo_cmd = pva_fifo_submit(queue->id,
 				       task->dma_addr,
 				       fifo_flags);
-	u32 syncpt_wait_ids[PVA_MAX_PREFENCES];
-	u32 syncpt_wait_thresh[PVA_MAX_PREFENCES];
-	unsigned int i;
+	u32 syncpt_wait_ids[PVA_MAX_PREFENCES * PVA_MAX_TASKS];
+	u32 syncpt_wait_thresh[PVA_MAX_PREFENCES * PVA_MAX_TASKS];
+	unsigned int i, j, num_waits = 0;
 	u32 cmdbuf[4];
 	int err = 0;
 
 	/* Pick up fences... */
-	for (i = 0; i < task->num_prefences; i++) {
-		/* ..and ensure that we have only syncpoints present */
-		if (task->prefences[i].type != PVA_FENCE_TYPE_SYNCPT)
-			return -EINVAL;
-
-		/* Put fences into a separate array */
-		syncpt_wait_ids[i] =
-			task->prefences[i].syncpoint_index;
-		syncpt_wait_thresh[i] =
-			task->prefences[i].syncpoint_value;
+	for (j = 0; j < num_tasks; j++) {
+		task = tasks[j];
+
+		for (i = 0; i < task->num_prefences; i++) {
+			/* ..and ensure that we have only syncpoints present */
+			if (task->prefences[i].type != PVA_FENCE_TYPE_SYNCPT)
+				return -EINVAL;
+
+			/* Put fences into a separate array */
+			syncpt_wait_ids[num_waits] =
+				task->prefences[i].syncpoint_index;
+			syncpt_wait_thresh[num_waits++] =
+				task->prefences[i].syncpoint_value;
+		}
 	}
 
 	/* A simple command buffer: Write two words into the ccq
@@ -1207,16 +1402,16 @@ static int pva_task_submit_channel_ccq(struct pva_submit_task *task,
 	err = nvhost_queue_submit_to_host1x(queue,
 					    cmdbuf,
 					    ARRAY_SIZE(cmdbuf),
-					    1,
+					    num_incrs,
 					    syncpt_wait_ids,
 					    syncpt_wait_thresh,
-					    task->num_prefences,
+					    num_waits,
 					    thresh);
 	return err;
 }
 
 static int pva_task_submit_mmio_ccq(struct pva_submit_task *task,
-				    u32 *thresh)
+				    u32 num_incrs, u32 *thresh)
 {
 	struct platform_device *host1x_pdev =
 			to_platform_device(task->pva->pdev->dev.parent);
@@ -1232,7 +1427,7 @@ static int pva_task_submit_mmio_ccq(struct pva_submit_task *task,
 	old_maxval = nvhost_syncpt_read_maxval(host1x_pdev, queue->syncpt_id);
 	new_maxval = nvhost_syncpt_incr_max_ext(host1x_pdev,
 						queue->syncpt_id,
-						1);
+						num_incrs);
 
 	err = pva_ccq_send(task->pva, fifo_cmd);
 	if (err < 0)
@@ -1297,28 +1492,87 @@ err_submit:
 	return err;
 }
 
-static int pva_task_submit(struct pva_submit_task *task)
+static int pva_task_return_postfences(struct pva_submit_task *task,
+				      struct platform_device *host1x_pdev)
+{
+	struct nvhost_queue *queue = task->queue;
+	unsigned int i;
+	int err = 0;
+
+	for (i = 0; i < task->num_postfences; i++) {
+		struct pva_fence *fence = task->postfences + i;
+
+		switch (fence->type) {
+		case PVA_FENCE_TYPE_SYNCPT: {
+			fence->syncpoint_index = queue->syncpt_id;
+			fence->syncpoint_value = task->syncpt_thresh;
+			break;
+		}
+		case PVA_FENCE_TYPE_SYNC_FD: {
+			struct nvhost_ctrl_sync_fence_info pts;
+
+			/* Fail if any previous sync_create_fence_fd failed */
+			if (err < 0)
+				break;
+
+			pts.id = queue->syncpt_id;
+			pts.thresh = task->syncpt_thresh;
+
+			err = nvhost_sync_create_fence_fd(host1x_pdev,
+					&pts, 1, "fence_pva", &fence->sync_fd);
+
+			break;
+		}
+		case PVA_FENCE_TYPE_SEMAPHORE:
+			break;
+		default:
+			return -ENOSYS;
+		}
+	}
+
+	return err;
+}
+
+/*
+ * Submit tasks[0..num_tasks), already written and chained, with a single
+ * doorbell. With @batch_fence only the last task increments the syncpoint
+ * and all tasks complete together. @queued tells whether the tasks made it
+ * to the hardware, in which case they are released on completion even if
+ * an error is returned.
+ */
+static int pva_task_submit(struct pva_submit_task **tasks,
+			   unsigned int num_tasks, bool batch_fence,
+			   bool *queued)
 {
+	struct pva_submit_task *task = tasks[0];
 	struct platform_device *host1x_pdev =
 			to_platform_device(task->pva->pdev->dev.parent);
 	struct nvhost_queue *queue = task->queue;
+	u32 num_incrs = batch_fence ? 1 : num_tasks;
 	unsigned int i;
 	u32 thresh = 0;
 	u64 timestamp;
-	int err = 0;
+	int err = 0, fence_err;
 
-	nvhost_dbg_info("Submitting task %p (0x%llx)", task,
-			(u64)task->dma_addr);
+	*queued = false;
 
-	/* Get a reference of the queue to avoid it being reused. It
-	 * gets freed in the callback...
-	 */
-	nvhost_queue_get(queue);
+	nvhost_dbg_info("Submitting %u task(s) from %p (0x%llx)", num_tasks,
+			task, (u64)task->dma_addr);
 
-	/* Turn on the hardware */
-	err = nvhost_module_busy(task->pva->pdev);
-	if (err)
-		goto err_module_busy;
+	/* Get a reference of the queue and the hardware for each task to
+	 * avoid them being released early. They get dropped in the
+	 * completion callback...
+	 */
+	for (i = 0; i < num_tasks; i++) {
+		nvhost_queue_get(queue);
+
+		/* Turn on the hardware */
+		err = nvhost_module_busy(task->pva->pdev);
+		if (err) {
+			nvhost_queue_put(queue);
+			goto err_module_busy;
+		}
+	}
 
 	/*
 	 * TSC timestamp is same as CNTVCT. Task statistics are being
@@ -1333,68 +1587,47 @@ static int pva_task_submit(struct pva_submit_task *task)
 		break;
 
 	case PVA_SUBMIT_MODE_MMIO_CCQ:
-		err = pva_task_submit_mmio_ccq(task, &thresh);
+		err = pva_task_submit_mmio_ccq(task, num_incrs, &thresh);
 		break;
 
 	case PVA_SUBMIT_MODE_CHANNEL_CCQ:
-		err = pva_task_submit_channel_ccq(task, &thresh);
+		err = pva_task_submit_channel_ccq(tasks, num_tasks, num_incrs,
+						  &thresh);
 		break;
 	}
 
 	if (err < 0)
 		goto err_submit;
 
-	nvhost_eventlib_log_submit(task->pva->pdev,
-				   queue->syncpt_id,
-				   thresh,
-				   timestamp);
-
-	task->syncpt_thresh = thresh;
+	*queued = true;
 
-	nvhost_dbg_info("Postfence id=%u, value=%u",
-			queue->syncpt_id, thresh);
+	for (i = 0; i < num_tasks; i++) {
+		task = tasks[i];
+		task->syncpt_thresh = batch_fence ? thresh :
+				      thresh - (num_tasks - 1 - i);
 
-	/* Return post-fences */
-	for (i = 0; i < task->num_postfences; i++) {
-		struct pva_fence *fence = task->postfences + i;
+		nvhost_eventlib_log_submit(task->pva->pdev,
+					   queue->syncpt_id,
+					   task->syncpt_thresh,
+					   timestamp);
 
-		switch (fence->type) {
-		case PVA_FENCE_TYPE_SYNCPT: {
-			fence->syncpoint_index = queue->syncpt_id;
-			fence->syncpoint_value = thresh;
-			break;
-		}
-		case PVA_FENCE_TYPE_SYNC_FD: {
-			struct nvhost_ctrl_sync_fence_info pts;
-
-			/* Fail if any previous sync_create_fence_fd failed */
-			if (err < 0)
-				break;
-
-			pts.id = queue->syncpt_id;
-			pts.thresh = thresh;
+		nvhost_dbg_info("Postfence id=%u, value=%u",
+				queue->syncpt_id, task->syncpt_thresh);
 
-			err = nvhost_sync_create_fence_fd(host1x_pdev,
-					&pts, 1, "fence_pva", &fence->sync_fd);
-
-			break;
-		}
-		case PVA_FENCE_TYPE_SEMAPHORE:
-			break;
-		default:
-			err = -ENOSYS;
-			goto err_write_fences;
-		}
+		/* Return post-fences */
+		fence_err = pva_task_return_postfences(task, host1x_pdev);
+		if (fence_err < 0 && !err)
+			err = fence_err;
 	}
 
-err_write_fences:
 	/*
 	 * Tasks in the queue list can be modified by the interrupt handler.
 	 * Adding the task into the list must be the last step before
 	 * registering the interrupt handler.
 	 */
 	mutex_lock(&queue->list_lock);
-	list_add_tail(&task->node, &queue->tasklist);
+	for (i = 0; i < num_tasks; i++)
+		list_add_tail(&tasks[i]->node, &queue->tasklist);
 	mutex_unlock(&queue->list_lock);
 
 	/*
@@ -1402,25 +1635,94 @@ err_write_fences:
 	 * the tasks into the queue since otherwise we may miss the completion
 	 * event.
 	 */
-	WARN_ON(nvhost_intr_register_notifier(host1x_pdev,
-					      queue->syncpt_id, thresh,
-					      pva_queue_update, queue));
+	for (i = batch_fence ? num_tasks - 1 : 0; i < num_tasks; i++)
+		WARN_ON(nvhost_intr_register_notifier(host1x_pdev,
+					queue->syncpt_id,
+					tasks[i]->syncpt_thresh,
+					pva_queue_update, queue));
 
 	return err;
 
 err_submit:
-	nvhost_module_idle(task->pva->pdev);
 err_module_busy:
-	nvhost_queue_put(queue);
+	while (i--) {
+		nvhost_module_idle(task->pva->pdev);
+		nvhost_queue_put(queue);
+	}
+	return err;
+}
+
+/*
+ * Pin and write all tasks of a batch, chain them through gen_task.next and
+ * submit them together.
+ */
+static int pva_queue_submit_batch(struct pva_submit_tasks *task_header)
+{
+	bool batch_fence = task_header->flags & PVA_SUBMIT_FLAG_BATCH_FENCE;
+	unsigned int num_tasks = task_header->num_tasks;
+	struct pva_submit_task **tasks = task_header->tasks;
+	unsigned int i;
+	bool queued;
+	int err = 0;
+
+	for (i = 0; i < num_tasks; i++) {
+		struct pva_submit_task *task = tasks[i];
+
+		pva_task_dump(task);
+
+		err = pva_task_pin_mem(task);
+		if (err < 0)
+			goto err_unpin;
+
+		task->no_syncpt_incr = batch_fence && i != num_tasks - 1;
+		task->batch_incrs_before = batch_fence ? 0 : i;
+
+		err = pva_task_write(task, false);
+		if (err < 0) {
+			pva_task_unpin_mem(task);
+			goto err_unpin;
+		}
+	}
+
+	for (i = 0; i + 1 < num_tasks; i++) {
+		struct pva_hw_task *hw_task = tasks[i]->va;
+
+		hw_task->task.gen_task.next = tasks[i + 1]->dma_addr;
+	}
+
+	/* make the chain visible before the firmware is notified */
+	wmb();
+
+	err = pva_task_submit(tasks, num_tasks, batch_fence, &queued);
+	if (!queued) {
+		i = num_tasks;
+		goto err_unpin;
+	}
+
+	task_header->num_submitted = num_tasks;
+
+	return err;
+
+err_unpin:
+	while (i--)
+		pva_task_unpin_mem(tasks[i]);
+
 	return err;
 }
 
 static int pva_queue_submit(struct nvhost_queue *queue, void *args)
 {
 	struct pva_submit_tasks *task_header = args;
+	bool queued;
 	int err = 0;
 	int i;
 
+	if ((task_header->flags & PVA_SUBMIT_FLAG_BATCH) &&
+	    task_header->num_tasks > 1 &&
+	    task_header->tasks[0]->pva->submit_mode !=
+			PVA_SUBMIT_MODE_MAILBOX)
+		return pva_queue_submit_batch(task_header);
+
 	for (i = 0; i < task_header->num_tasks; i++) {
 		struct pva_submit_task *task = task_header->tasks[i];
 
@@ -1435,7 +1737,13 @@ static int pva_queue_submit(struct nvhost_queue *queue, void *args)
 		/* Write the task data */
 		pva_task_write(task, false);
 
-		err = pva_task_submit(task);
+		err = pva_task_submit(&task, 1, false, &queued);
+		if (!queued) {
+			pva_task_unpin_mem(task);
+			break;
+		}
+
+		task_header->num_submitted++;
 		if (err < 0)
 			break;
 	}
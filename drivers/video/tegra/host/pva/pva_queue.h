@@ -19,6 +19,7 @@
 #ifndef PVA_QUEUE_H
 #define PVA_QUEUE_H
 
+#include <linux/kref.h>
 #include <uapi/linux/nvhost_pva_ioctl.h>
 
 #include "nvhost_queue.h"
@@ -27,6 +28,7 @@
 #include "pva-interface.h"
 
 struct dma_buf;
+struct pva_task_template;
 
 extern struct nvhost_queue_ops pva_queue_ops;
 
@@ -35,6 +37,7 @@ struct pva_parameter_ext {
 	size_t size;
 	struct dma_buf *dmabuf;
 	enum nvhost_buffers_heap heap;
+	bool registered;	/* pinned by registered buffer id */
 };
 
 /**
@@ -57,6 +60,13 @@ struct pva_parameter_ext {
  * num_input_task_status	Number of input task status structures
  * num_output_task_status	Number of output task status structures
  * operation			task operation
+ * batch_incrs_before		Syncpoint increments done by earlier tasks of
+ *				the same batch
+ * no_syncpt_incr		A later task of the batch signals completion
+ * tmpl				Template the task was created from, holds the
+ *				pins of scalars, task status and pointers
+ * perf_counters		Collect VPU performance counters and stream
+ *				them to eventlib
  * timeout			Latest Unix time when the task must complete or
  *				0 if disabled.
  * prefences			Pre-fence structures
@@ -93,6 +103,14 @@ struct pva_submit_task {
 	bool invalid;
 	u32 syncpt_thresh;
 
+	/* Position in a batch: earlier syncpoint increments in the batch,
+	 * and whether a later task increments on behalf of this one */
+	u8 batch_incrs_before;
+	bool no_syncpt_incr;
+
+	struct pva_task_template *tmpl;
+	bool perf_counters;
+
 	/* Data provided by userspace "as is" */
 	struct pva_fence prefences[PVA_MAX_PREFENCES];
 	struct pva_fence postfences[PVA_MAX_POSTFENCES];
@@ -123,10 +141,31 @@ struct pva_submit_task {
 	struct pva_parameter_ext pointers_ext[PVA_MAX_POINTERS];
 };
 
+/**
+ * @brief	Task layout that is registered once and submitted many times
+ *
+ * ref				Tasks created from the template hold a
+ *				reference
+ * task				Validated task. Its scalars, task status and
+ *				pointers stay pinned until the last reference
+ *				is dropped.
+ * opaque_size			Size of the pre-rendered opaque data
+ * opaque_data			Opaque data descriptor, primary payload and
+ *				pointer list with the addresses resolved
+ *
+ */
+struct pva_task_template {
+	struct kref ref;
+	struct pva_submit_task task;
+	u32 opaque_size;
+	u8 opaque_data[PVA_MAX_PRIMARY_PAYLOAD_SIZE];
+};
+
 struct pva_submit_tasks {
 	struct pva_submit_task *tasks[PVA_MAX_TASKS];
 	u16 flags;
 	u16 num_tasks;
+	u16 num_submitted;	/* set by the queue, tasks now owned by it */
 };
 
 struct pva_queue_attribute {
@@ -141,4 +180,12 @@ struct pva_queue_set_attribute {
 };
 
 void pva_task_remove(struct pva_submit_task *task);
+
+/*
+ * Pin the parameters of a filled-in template task and render its opaque
+ * data. The template must come from kmalloc; it is freed when the last
+ * reference is put, or by the caller if initialization fails.
+ */
+int pva_task_template_init(struct pva_task_template *tmpl);
+void pva_task_template_put(struct pva_task_template *tmpl);
 #endif
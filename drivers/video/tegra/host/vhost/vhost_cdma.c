@@ -17,6 +17,7 @@
  */
 
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 #include "vhost.h"
 #include "../host1x/host1x.h"
 #include "../nvhost_cdma.h"
@@ -43,62 +44,201 @@ static int vhost_pb_sendrecv(struct tegra_vhost_cmd_msg *msg, size_t size_in,
 	return err;
 }
 
-static int vhost_channel_submit(u64 handle, struct nvhost_job *job,
-		u32 *pb_base, u32 start, u32 end, u32 job_id)
+/*
+ * Size of one push buffer queue element, see TEGRA_VHOST_QUEUE_SIZES. Jobs
+ * are packed into a submit message until it is full.
+ */
+#define VHOST_PB_MSG_SIZE	4096
+
+/* Distinct syncpoints tracked in one submit message */
+#define VHOST_SUBMIT_MAX_SYNCPTS	16
+
+struct vhost_submit_syncpt {
+	u32 id;
+	u32 fence;
+};
+
+/*
+ * Merge the syncpoints of @job into @syncpts. Jobs are visited in submit
+ * order, so the last fence seen for a syncpoint is the one to wait for.
+ * Returns the new number of syncpoints, or -1 if they do not fit.
+ */
+static int vhost_submit_merge_syncpts(struct vhost_submit_syncpt *syncpts,
+		int num_syncpts, struct nvhost_job *job)
+{
+	int i, j;
+
+	for (i = 0; i < job->num_syncpts; i++) {
+		struct nvhost_job_syncpt *sp = job->sp + i;
+
+		for (j = 0; j < num_syncpts; j++)
+			if (syncpts[j].id == sp->id)
+				break;
+
+		if (j == num_syncpts) {
+			if (num_syncpts == VHOST_SUBMIT_MAX_SYNCPTS)
+				return -1;
+			syncpts[num_syncpts++].id = sp->id;
+		}
+		syncpts[j].fence = sp->fence;
+	}
+
+	return num_syncpts;
+}
+
+/* Copy the push buffer slots of @job, handling the wrap around */
+static char *vhost_submit_copy_job(char *ptr, u32 *pb_base,
+		struct nvhost_job *job)
 {
+	u32 start = job->first_get;
+	u32 len = job->num_slots * 8;
+
+	if (start + len <= PUSH_BUFFER_SIZE) {
+		memcpy(ptr, (u8 *)pb_base + start, len);
+	} else {
+		memcpy(ptr, (u8 *)pb_base + start, PUSH_BUFFER_SIZE - start);
+		memcpy(ptr + PUSH_BUFFER_SIZE - start, pb_base,
+		       len - (PUSH_BUFFER_SIZE - start));
+	}
+
+	return ptr + len;
+}
+
+/*
+ * Send all the jobs of the sync queue that have not reached the server yet,
+ * packing as many of them into one message as fit. The server identifies
+ * the message by the push buffer offset of its first job.
+ *
+ * Returns the number of jobs sent.
+ */
+static int vhost_channel_submit(struct nvhost_cdma *cdma, u64 handle)
+{
+	struct vhost_submit_syncpt syncpts[VHOST_SUBMIT_MAX_SYNCPTS];
+	struct nvhost_job *job, *first = NULL, *last = NULL;
 	struct tegra_vhost_cmd_msg *msg;
 	struct tegra_vhost_channel_submit_params *p;
-	u32 num_entries, i;
-	size_t size;
-	char *ptr;
+	u32 num_entries = 0;
+	int num_syncpts = 0;
+	int num_jobs = 0;
+	size_t size = 0;
 	u32 *ptr32;
-	int err;
+	char *ptr;
+	int i, err;
+
+	mutex_lock(&cdma->sync_queue_lock);
+	list_for_each_entry(job, &cdma->sync_queue, list) {
+		struct vhost_submit_syncpt merged[VHOST_SUBMIT_MAX_SYNCPTS];
+		int num_merged;
+		size_t job_size;
+
+		if (job->virt_submitted)
+			continue;
+
+		memcpy(merged, syncpts, sizeof(merged));
+		num_merged = vhost_submit_merge_syncpts(merged, num_syncpts,
+							job);
+		job_size = sizeof(*msg) +
+			8 * (num_entries + job->num_slots + max(num_merged, 0));
+
+		/*
+		 * Timeout and client are per message. Always send at least
+		 * one job, even if it doesn't fit.
+		 */
+		if (first && (num_merged < 0 || job_size > VHOST_PB_MSG_SIZE ||
+			      job->clientid != first->clientid ||
+			      job->timeout != first->timeout))
+			break;
+
+		if (!first)
+			first = job;
+		last = job;
+
+		memcpy(syncpts, merged, sizeof(syncpts));
+		num_syncpts = max(num_merged, 0);
+		num_entries += job->num_slots;
+		size = job_size;
+		num_jobs++;
 
-	/* number of opcode/data pairs (8 bytes each) */
-	num_entries = ((end - start) & (PUSH_BUFFER_SIZE - 1)) / 8;
+		job->virt_submitted = true;
+		job->virt_submit_id = first->first_get;
+	}
+	mutex_unlock(&cdma->sync_queue_lock);
+
+	if (!first)
+		return 0;
 
-	size = sizeof(*msg) + 8 * (num_entries + job->num_syncpts);
 	msg = kmalloc(size, GFP_KERNEL);
-	if (!msg)
-		return -1;
+	if (!msg) {
+		/* leave the jobs for the next kick */
+		mutex_lock(&cdma->sync_queue_lock);
+		job = first;
+		for (i = 0; i < num_jobs; i++) {
+			job->virt_submitted = false;
+			job = list_next_entry(job, list);
+		}
+		mutex_unlock(&cdma->sync_queue_lock);
+		return -ENOMEM;
+	}
 
 	msg->cmd = TEGRA_VHOST_CMD_HOST1X_CDMA_SUBMIT;
 	msg->handle = handle;
 	msg->ret = 0;
 	p = &msg->params.cdma_submit;
-	p->clientid = job->clientid;
-	p->job_id = job_id;
-	p->timeout = job->timeout;
+	p->clientid = first->clientid;
+	p->job_id = first->first_get;
+	p->timeout = first->timeout;
 	p->num_entries = num_entries;
-	p->num_syncpts = job->num_syncpts;
+	p->num_syncpts = num_syncpts;
 
+	/*
+	 * Copy pushbuffer contents first. The jobs' slots stay in place
+	 * until the jobs retire, which cannot happen before they are sent,
+	 * and jobs are only removed from the head of the queue.
+	 */
 	ptr = (char *)msg + sizeof(*msg);
-
-	/* Copy pushbuffer contents first */
-	if ((start < end) || (end == 0)) {
-		memcpy(ptr, (u8 *)pb_base + start, 8 * num_entries);
-		ptr += 8 * num_entries;
-	}
-	else {
-		memcpy(ptr, (u8 *)pb_base + start, PUSH_BUFFER_SIZE - start);
-		ptr += PUSH_BUFFER_SIZE - start;
-		memcpy(ptr, pb_base, end);
-		ptr += end;
+	job = first;
+	for (i = 0; i < num_jobs; i++) {
+		ptr = vhost_submit_copy_job(ptr, cdma->push_buffer.mapped, job);
+		job = list_next_entry(job, list);
 	}
 
 	/* Now update syncpt information */
 	ptr32 = (u32 *)ptr;
-	for (i = 0; i < p->num_syncpts; i++) {
-		struct nvhost_job_syncpt *sp = job->sp + i;
-		*ptr32++ = sp->id;
-		*ptr32++ = sp->fence;
+	for (i = 0; i < num_syncpts; i++) {
+		*ptr32++ = syncpts[i].id;
+		*ptr32++ = syncpts[i].fence;
 	}
 
 	err = vhost_pb_sendrecv(msg, size, sizeof(*msg));
+	if (err || msg->ret)
+		pr_err("%s: error return from host1x_cdma_kick\n", __func__);
 
-	err = (err || msg->ret) ? -1 : 0;
 	kfree(msg);
-	return err;
+	return num_jobs;
+}
+
+/*
+ * Submits happen from a work item, so that the submitting thread does not
+ * wait for the server round trip. Jobs queued while a message is in flight
+ * are sent together in the next one. Completion is signalled by the server
+ * through the syncpoint interrupt queue as before.
+ */
+static void vhost_cdma_submit_work(struct work_struct *work)
+{
+	struct nvhost_cdma *cdma = container_of(work, struct nvhost_cdma,
+						virt_submit_work);
+	struct nvhost_channel *ch = cdma_to_channel(cdma);
+	struct nvhost_virt_ctx *virt_ctx;
+
+	if (!ch || !ch->dev) {
+		pr_warn("%s: un-mapped channel\n", __func__);
+		return;
+	}
+
+	virt_ctx = nvhost_get_virt_data(ch->dev);
+
+	while (vhost_channel_submit(cdma, virt_ctx->handle) > 0)
+		;
 }
 
 static void vhost_cdma_start(struct nvhost_cdma *cdma)
@@ -114,6 +254,7 @@ static void vhost_cdma_start(struct nvhost_cdma *cdma)
 	}
 
 	cdma->last_put = nvhost_push_buffer_putptr(&cdma->push_buffer);
+	INIT_WORK(&cdma->virt_submit_work, vhost_cdma_submit_work);
 	cdma->running = true;
 }
 
@@ -129,44 +270,21 @@ static void vhost_cdma_stop(struct nvhost_cdma *cdma)
 	down_read(&cdma->lock);
 	if (cdma->running) {
 		nvhost_cdma_wait_locked(cdma, CDMA_EVENT_SYNC_QUEUE_EMPTY);
+		flush_work(&cdma->virt_submit_work);
 		cdma->running = false;
 	}
 	up_read(&cdma->lock);
 }
 
 /**
- * Kick channel DMA into action by writing its PUT offset (if it has changed)
+ * Kick channel DMA into action by handing the new jobs to the submit worker
  */
 static void vhost_cdma_kick(struct nvhost_cdma *cdma)
 {
-	struct nvhost_job *job;
-	u32 put;
-	int err;
-
-	mutex_lock(&cdma->sync_queue_lock);
-	job = list_entry(cdma->sync_queue.prev, struct nvhost_job, list);
-	mutex_unlock(&cdma->sync_queue_lock);
-
-	put = nvhost_push_buffer_putptr(&cdma->push_buffer);
+	u32 put = nvhost_push_buffer_putptr(&cdma->push_buffer);
 
 	if (put != cdma->last_put) {
-		u32 start = cdma->last_put - cdma->push_buffer.dma_addr;
-		u32 end = put - cdma->push_buffer.dma_addr;
-		struct nvhost_channel *ch = cdma_to_channel(cdma);
-		struct nvhost_virt_ctx *virt_ctx =
-						nvhost_get_virt_data(ch->dev);
-
-		/* Don't hold the lock while we're waiting
-		 * for this to complete
-		 */
-		up_read(&cdma->lock);
-		err = vhost_channel_submit(virt_ctx->handle, job,
-					cdma->push_buffer.mapped,
-					start, end, cdma->last_put);
-		down_read(&cdma->lock);
-		if (err)
-			pr_err("%s: error return from host1x_cdma_kick\n",
-				__func__);
+		queue_work(system_unbound_wq, &cdma->virt_submit_work);
 		cdma->last_put = put;
 	}
 }
@@ -237,19 +355,24 @@ void vhost_cdma_timeout(struct nvhost_master *dev,
 	cdma = &chan->cdma;
 	down_write(&cdma->lock);
 
-	/* whether all timeout jobs have been unpinned */
+	/*
+	 * whether all timeout jobs have been unpinned. The job ids name
+	 * submit messages, which may carry several jobs each.
+	 */
 	mutex_lock(&cdma->sync_queue_lock);
 	list_for_each_entry(job, &cdma->sync_queue, list) {
-		if (job->first_get == info->job_id_start)
+		if (!job->virt_submitted)
+			break;
+		if (!start_job && job->virt_submit_id == info->job_id_start)
 			start_job = job;
-		if (job->first_get == info->job_id_end) {
+		if (job->virt_submit_id == info->job_id_end)
 			end_job = job;
+		else if (end_job)
 			break;
-		}
 	}
 	mutex_unlock(&cdma->sync_queue_lock);
 
-	if (!end_job)
+	if (!start_job || !end_job)
 		goto out;
 
 	job = start_job;
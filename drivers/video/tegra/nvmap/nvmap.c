@@ -65,6 +65,9 @@ void *__nvmap_kmap(struct nvmap_handle *h, unsigned int pagenum)
 	if (pagenum >= h->size >> PAGE_SHIFT)
 		goto out;
 
+	if (nvmap_handle_populate(h, pagenum, 1))
+		goto out;
+
 	if (h->vaddr) {
 		kaddr = (unsigned long)h->vaddr + pagenum * PAGE_SIZE;
 	} else {
@@ -161,6 +164,9 @@ void *__nvmap_mmap(struct nvmap_handle *h)
 	prot = nvmap_pgprot(h, PG_PROT_KERNEL);
 
 	if (h->heap_pgalloc) {
+		if (nvmap_handle_populate_all(h))
+			goto out;
+
 		pages = nvmap_pages(h->pgalloc.pages, h->size >> PAGE_SHIFT);
 		if (!pages)
 			goto out;
@@ -273,6 +279,11 @@ struct sg_table *__nvmap_sg_table(struct nvmap_client *client,
 
 		sg_set_page(sgt->sgl, page, h->size, offset_in_page(paddr));
 	} else {
+		/* A device may touch any page of the handle. */
+		err = nvmap_handle_populate_all(h);
+		if (err)
+			goto err;
+
 		pages = nvmap_pages(h->pgalloc.pages, npages);
 		if (!pages) {
 			err = -ENOMEM;
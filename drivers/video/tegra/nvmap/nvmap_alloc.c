@@ -19,6 +19,7 @@
 
 #include <linux/moduleparam.h>
 #include <linux/random.h>
+#include <linux/bitops.h>
 #include <soc/tegra/chip-id.h>
 #include <trace/events/nvmap.h>
 
@@ -29,6 +30,7 @@ bool nvmap_convert_iovmm_to_carveout;
 
 u32 nvmap_max_handle_count;
 u64 nvmap_big_page_allocs;
+u64 nvmap_huge_page_allocs;
 u64 nvmap_total_page_allocs;
 
 /* handles may be arbitrarily large (16+MiB), and any handle allocated from
@@ -80,375 +82,197 @@ module_param_named(nr_colors, s_nr_colors, uint, 0644);
 
 #define NVMAP_MAX_COLORS 16
 
-struct color_list {
-	u32 *counts;
-	u32 *heads;
-	u32 *list;
-	struct page **pages;
-	u32 page_count;
-	u32 length;
+/*
+ * Zeroed, cache clean pages kept sorted by color between allocations. Colored
+ * allocations pop from these in the order the handle's tiles want and only
+ * go back to the page pool to top the bins up, instead of building and
+ * smoothing a fresh histogram every time. Whatever is left over stays binned
+ * for the next allocation, up to NVMAP_COLOR_BIN_MAX pages per color.
+ */
+#define NVMAP_COLOR_BIN_MAX	32
+#define NVMAP_COLOR_REFILL	64
+
+struct nvmap_color_bins {
+	struct mutex lock;
+	struct list_head bins[NVMAP_MAX_COLORS];
+	u32 counts[NVMAP_MAX_COLORS];
+	u32 total;
 };
 
-static struct color_list *alloc_color_list(u32 nr_pages, u32 nr_colors)
-{
-	struct color_list *list;
-	u32 *temp = NULL;
-	u32 nr_u32;
-
-	list = kzalloc(sizeof(struct color_list), GFP_KERNEL);
-	if (!list)
-		return NULL;
-
-	list->pages = vmalloc(nr_pages * sizeof(struct page *));
-	if (!list->pages) {
-		kfree(list);
-		return NULL;
-	}
-
-	/* Allocate counts, heads, and list with a single allocation */
-	nr_u32 = nr_pages + 2 * nr_colors;
-	temp = vmalloc(nr_u32 * sizeof(u32));
-	if (!temp)
-		goto fail;
-
-	memset(&temp[0], 0, 2 * nr_colors *  sizeof(u32));
-	list->counts = &temp[0];
-	list->heads = &temp[nr_colors];
-	list->list = &temp[2 * nr_colors];
-
-	list->page_count = nr_pages;
-
-	return list;
-fail:
-	if (list->pages)
-		vfree(list->pages);
-	kfree(list);
-	return NULL;
-}
-
-static void free_color_list(struct color_list *list)
-{
-	vfree(list->pages);
-	vfree(list->counts);	/* Frees counts, heads, and list */
-	kfree(list);
-}
-
-static struct page *list_pop_page(struct color_list *list, u32 color, char *who)
-{
-	u32 i;
-
-	/* Debug check */
-	if ((list->counts[color] == 0) || (list->counts[color] > 1 << 31)) {
-		pr_err("list_pop_page: OVER FREE!\n");
-		pr_err(" called from: %s\n", who);
-		for (i = 0; i < s_nr_colors; i++)
-			pr_err(" color = %d: %d\n", i, list->counts[i]);
-		BUG();
-	}
-	i = list->heads[color];
-	list->heads[color] = list->list[i];
-	list->counts[color]--;
-	return list->pages[i];
-}
-
-struct nvmap_alloc_state {
-	u32 nr_colors;
-	u32 (*addr_to_color)(uintptr_t phys);
-	u32 tile;
-	u32 output_count;
-	u32 nr_pages;
-	u32 max_color_per_tile;
-	struct color_list *list;
+static struct nvmap_color_bins color_bins = {
+	.lock = __MUTEX_INITIALIZER(color_bins.lock),
 };
 
 #define CHANNEL_MASK_0 0x27af5200
 #define CHANNEL_MASK_1 0x563ca400
 #define CHANNEL_MASK_2 0x3f264800
 #define CHANNEL_MASK_3 0xe2443000
-#define BANK_MASK_0 0x5ca78400
-#define BANK_MASK_1 0xe5724800
-#define BANK_MASK_2 0x973bb000
-
-#define BIT_N(a, n) \
-	(((a) >> (n)) & 1)
 
+/* Parity of address bits 9 to 31 selected by mask. */
 #define BITS_XOR_9_TO_31(a) \
-	(BIT_N((a), 9) ^ BIT_N((a), 10) ^ BIT_N((a), 11) ^ BIT_N((a), 12)  ^ \
-	BIT_N((a), 13) ^ BIT_N((a), 14) ^ BIT_N((a), 15) ^ BIT_N((a), 16) ^ \
-	BIT_N((a), 17) ^ BIT_N((a), 18) ^ BIT_N((a), 19) ^ BIT_N((a), 20) ^ \
-	BIT_N((a), 21) ^ BIT_N((a), 22) ^ BIT_N((a), 23) ^ BIT_N((a), 24) ^ \
-	BIT_N((a), 25) ^ BIT_N((a), 26) ^ BIT_N((a), 27) ^ BIT_N((a), 28) ^ \
-	BIT_N((a), 29) ^ BIT_N((a), 30) ^ BIT_N((a), 31))
-
-#define BITS_XOR_10_TO_31(a) \
-	(BIT_N((a), 10) ^ BIT_N((a), 11) ^ BIT_N((a), 12) ^ \
-	BIT_N((a), 13) ^ BIT_N((a), 14) ^ BIT_N((a), 15) ^ BIT_N((a), 16) ^ \
-	BIT_N((a), 17) ^ BIT_N((a), 18) ^ BIT_N((a), 19) ^ BIT_N((a), 20) ^ \
-	BIT_N((a), 21) ^ BIT_N((a), 22) ^ BIT_N((a), 23) ^ BIT_N((a), 24) ^ \
-	BIT_N((a), 25) ^ BIT_N((a), 26) ^ BIT_N((a), 27) ^ BIT_N((a), 28) ^ \
-	BIT_N((a), 29) ^ BIT_N((a), 30) ^ BIT_N((a), 31))
+	(hweight32((a) & ~0x1ffU) & 1)
 
 static u32 addr_to_color_t19x(uintptr_t phys)
 {
-	int color, chan, bank;
+	int chan;
 	u32 addr = (u32)phys;
-	u32 xaddr = (u32)(phys >> 4);
-
 
 	chan =  (BITS_XOR_9_TO_31(addr & CHANNEL_MASK_0) << 0);
 	chan |= (BITS_XOR_9_TO_31(addr & CHANNEL_MASK_1) << 1);
 	chan |= (BITS_XOR_9_TO_31(addr & CHANNEL_MASK_2) << 2);
 	chan |= (BITS_XOR_9_TO_31(addr & CHANNEL_MASK_3) << 3);
 
-	bank = (BITS_XOR_10_TO_31(xaddr & BANK_MASK_0) << 0);
-	bank |= (BITS_XOR_10_TO_31(xaddr & BANK_MASK_1) << 1);
-	bank |= (BITS_XOR_10_TO_31(xaddr & BANK_MASK_2) << 2);
-
-	WARN_ON(chan > 15);
-	WARN_ON(bank > 7);
 	/* It is preferable to color pages based on even/odd banks
 	 * as well. To limit the number of colors to 16, bank info
 	 * is not used in page coloring.
 	 */
-	color = chan;
-
-	return color;
+	return chan;
 }
 
-static struct color_list *init_color_list(struct nvmap_page_pool *pool,
-					  struct nvmap_alloc_state *state,
-					  u32 nr_pages)
+static void color_bins_init_locked(struct nvmap_color_bins *cb)
 {
-	struct color_list *list;
-	u32 color, i, page_index = 0;
-	gfp_t gfp = GFP_NVMAP | __GFP_ZERO;
-
-	list = alloc_color_list(nr_pages, state->nr_colors);
-	if (!list)
-		return NULL;
+	int i;
 
-#ifdef CONFIG_NVMAP_PAGE_POOLS
-	/* Allocated page from nvmap page pool if possible */
-	page_index = nvmap_page_pool_alloc_lots(pool, list->pages, nr_pages);
-#endif
-	/* Fall back to general page allocator */
-	for (i = page_index; i < nr_pages; i++) {
-		list->pages[i] = nvmap_alloc_pages_exact(gfp, PAGE_SIZE);
-		if (!list->pages[i])
-			goto fail;
-	}
-	/* Clean the cache for any page that didn't come from the page pool */
-	if (page_index < nr_pages)
-		nvmap_clean_cache(&list->pages[page_index],
-				  nr_pages - page_index);
+	if (cb->bins[0].next)
+		return;
 
-	/* Create linked list of colors and compute the histogram */
-	for (i = 0; i < nr_pages; i++) {
-		color = state->addr_to_color((uintptr_t)
-					     page_to_phys(list->pages[i]));
-		list->list[i] = list->heads[color];
-		list->heads[color] = i;
-		list->counts[color]++;
-	}
-	return list;
-fail:
-	while (i--)
-		__free_page(list->pages[i]);
-	free_color_list(list);
-	return NULL;
+	for (i = 0; i < NVMAP_MAX_COLORS; i++)
+		INIT_LIST_HEAD(&cb->bins[i]);
 }
 
-static void smooth_pages(struct color_list *list, u32 nr_extra, u32 nr_colors)
+static void color_bin_push(struct nvmap_color_bins *cb, struct page *page)
 {
-	u32 i, j, color, max;
-	u32 counts[NVMAP_MAX_COLORS] = {0};
+	u32 color = addr_to_color_t19x((uintptr_t)page_to_phys(page));
 
-	if (nr_extra == 0)
-		return;
+	list_add(&page->lru, &cb->bins[color]);
+	cb->counts[color]++;
+	cb->total++;
+}
 
-	/* Determine which colors need to be freed */
-	for (i = 0; i < nr_extra; i++) {
-		/* Find the max */
-		max = 0;
-		color = 0;
-		for (j = 0; j < nr_colors; j++) {
-			if (list->counts[j] - counts[j] > max) {
-				color = j;
-				max = list->counts[j] - counts[j];
-			}
-		}
-		counts[color]++;
-	}
+static struct page *color_bin_pop(struct nvmap_color_bins *cb, u32 color)
+{
+	struct page *page;
 
-	/* Iterate through 0...nr_extra-1 in psuedorandom order */
-	do {
-		/* Pop the max off and free it */
-		for (color = 0; color < nr_colors; color++) {
-			while (counts[color]) {
-				__free_page(list_pop_page(list,
-						color, "smooth_pages"));
-				counts[color]--;
-				nr_extra--;
-			}
-		}
-	} while (nr_extra > 0);
+	if (!cb->counts[color])
+		return NULL;
+
+	page = list_first_entry(&cb->bins[color], struct page, lru);
+	list_del(&page->lru);
+	cb->counts[color]--;
+	cb->total--;
+	return page;
 }
 
-static void add_perfect(struct nvmap_alloc_state *state, u32 nr_pages,
-			struct page **out_pages)
+/* Pop from the color with the most pages left, to keep the bins balanced. */
+static struct page *color_bin_pop_any(struct nvmap_color_bins *cb)
 {
-	u32 i;
-	u32 color;
-	struct page *page;
-	uintptr_t virt_addr;
+	u32 i, color = 0;
 
+	for (i = 1; i < NVMAP_MAX_COLORS; i++)
+		if (cb->counts[i] > cb->counts[color])
+			color = i;
+	return color_bin_pop(cb, color);
+}
+
+/* Add up to nr pages to the bins, pool pages first. */
+static u32 color_bins_refill(struct nvmap_page_pool *pool,
+			     struct nvmap_color_bins *cb, u32 nr)
+{
+	struct page *pages[NVMAP_COLOR_REFILL];
+	gfp_t gfp = GFP_NVMAP | __GFP_ZERO;
+	u32 i, n, page_index = 0;
 
-	/* create a perfect tile */
-	for (i = 0;
-	     i < state->nr_colors && state->output_count < nr_pages;
-	     i++) {
-		virt_addr = (i + (state->tile * state->nr_colors)) * PAGE_SIZE;
-		color = state->addr_to_color(virt_addr);
-		page = list_pop_page(state->list, color, "perfect");
-		out_pages[state->output_count++] = page;
+	n = min_t(u32, nr, NVMAP_COLOR_REFILL);
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+	page_index = nvmap_page_pool_alloc_lots(pool, pages, n);
+#endif
+	for (i = page_index; i < n; i++) {
+		pages[i] = nvmap_alloc_pages_exact(gfp, PAGE_SIZE);
+		if (!pages[i])
+			break;
 	}
+	n = i;
+	/* Clean the cache for any page that didn't come from the page pool */
+	if (page_index < n)
+		nvmap_clean_cache(&pages[page_index], n - page_index);
+
+	for (i = 0; i < n; i++)
+		color_bin_push(cb, pages[i]);
+	return n;
 }
 
-static void add_imperfect(struct nvmap_alloc_state *state, u32 nr_pages,
-			  struct page **out_pages)
+/* Give pages beyond each bin's cap back to the pool. */
+static void color_bins_trim(struct nvmap_page_pool *pool,
+			    struct nvmap_color_bins *cb)
 {
-	u32 i, j;
-	u32 max_count;
-	u32 color;
-	struct page *page;
-	uintptr_t virt_addr;
-	u32 counts[NVMAP_MAX_COLORS] = {0};
-
-	/* Determine which colors will go into the tile */
-	for (i = 0; i < state->nr_colors; i++) {
-		max_count = 0;
-		color = 0;
-		for (j = 0; j < state->nr_colors; j++) {
-			u32 left = state->list->counts[j] - counts[j];
-
-			if (left > max_count &&
-			    counts[j] < state->max_color_per_tile) {
-				max_count = left;
-				color = j;
-			}
+	struct page *pages[NVMAP_COLOR_REFILL];
+	u32 color, n = 0, filled = 0;
+
+	for (color = 0; color < NVMAP_MAX_COLORS; color++) {
+		while (cb->counts[color] > NVMAP_COLOR_BIN_MAX) {
+			pages[n++] = color_bin_pop(cb, color);
+			if (n < NVMAP_COLOR_REFILL)
+				continue;
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+			filled = nvmap_page_pool_fill_lots(pool, pages, n);
+#endif
+			while (n > filled)
+				__free_page(pages[--n]);
+			n = 0;
 		}
-		counts[color]++;
 	}
 
-	/* Arrange the colors into the tile */
-	for (i = 0;
-	     i < state->nr_colors && state->output_count < nr_pages;
-	     i++) {
-		virt_addr = (i + (i * state->nr_colors)) * PAGE_SIZE;
-		color = state->addr_to_color(virt_addr);
-		/* Find a substitute color */
-		if (counts[color] == 0) {
-			/* Find the color used the most in the tile */
-			max_count = 0;
-			for (j = 0; j < state->nr_colors; j++) {
-				if (counts[j] > max_count) {
-					max_count = counts[j];
-					color = j;
-				}
-			}
-		}
-		page = list_pop_page(state->list, color, "imperfect");
-		out_pages[state->output_count++] = page;
-		counts[color]--;
+	if (n) {
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+		filled = nvmap_page_pool_fill_lots(pool, pages, n);
+#endif
+		while (n > filled)
+			__free_page(pages[--n]);
 	}
 }
 
 static int alloc_colored(struct nvmap_page_pool *pool, u32 nr_pages,
 			 struct page **out_pages, u32 chipid)
 {
-	struct nvmap_alloc_state state;
-	u32 nr_alloc, max_count, min_count;
-	u32 nr_tiles, nr_perfect, nr_imperfect;
-	int dither_state;
-	u32 i;
-
-	state.nr_colors = s_nr_colors;
-	state.addr_to_color = addr_to_color_t19x;
-
-	/* Allocate pages for full 32-page tiles */
-	nr_tiles = (nr_pages + state.nr_colors - 1) / state.nr_colors;
-	/* Overallocate pages by 1/16th */
-	nr_alloc  = state.nr_colors * nr_tiles;
-	nr_alloc += nr_alloc >> 4;
-
-	/* Create lists of each page color */
-	state.list = init_color_list(pool, &state, nr_alloc);
-	if (!state.list)
-		return -ENOMEM;
+	struct nvmap_color_bins *cb = &color_bins;
+	struct page *page;
+	u32 i, color;
 
-	/* Smooth out the histogram by freeing over allocated pages */
-	smooth_pages(state.list, nr_alloc - state.nr_colors * nr_tiles,
-		     state.nr_colors);
-
-	max_count = 0;
-	min_count = state.list->counts[0];
-	for (i = 0; i < state.nr_colors; i++) {
-		if (state.list->counts[i] > max_count)
-			max_count = state.list->counts[i];
-		if (state.list->counts[i] < min_count)
-			min_count = state.list->counts[i];
-	}
+	if (s_nr_colors > NVMAP_MAX_COLORS)
+		s_nr_colors = NVMAP_MAX_COLORS;
 
-	/* Compute the number of perfect / imperfect tiles and the maximum
-	 * number of pages with the same color can be in a tile
-	 */
-	if (max_count / nr_tiles >= 3) {
-		/* It is not possible to create perfect tiles with
-		 * max_color_per_tile <= 3
+	mutex_lock(&cb->lock);
+	color_bins_init_locked(cb);
+
+	for (i = 0; i < nr_pages; i++) {
+		/*
+		 * Each page goes where its offset into the handle wants it, so
+		 * every run of nr_colors pages forms a perfect tile whenever the
+		 * bins allow. Overfetch by 1/16th on refill so that a missing
+		 * color can usually still be found.
 		 */
-		nr_perfect = 0;
-		state.max_color_per_tile = (max_count + nr_tiles - 1)
-					   / nr_tiles;
-	} else if (nr_tiles * 2 == max_count) {
-		/* All of the tiles can be perfect */
-		nr_perfect = nr_tiles;
-		state.max_color_per_tile = 2;
-	} else {
-		/* Some of the tiles can be perfect */
-		nr_perfect = nr_tiles - (max_count % nr_tiles);
-		state.max_color_per_tile = 3;
-	}
-	/* Check if the number of perfect tiles is bound by the color with the
-	 * minimum count
-	 */
-	if (nr_perfect * 2 > min_count)
-		nr_perfect = min_count / 2;
-
-	nr_imperfect = nr_tiles - nr_perfect;
-
-	/* Output tiles */
-	dither_state = nr_perfect - nr_imperfect;
-	state.output_count = 0;
-	for (state.tile = 0; state.tile < nr_tiles; state.tile++) {
-		if (dither_state > 0) {
-			add_perfect(&state, nr_pages, out_pages);
-			dither_state -= nr_imperfect;
-		} else {
-			add_imperfect(&state, nr_pages, out_pages);
-			dither_state += nr_perfect;
-		}
+		color = addr_to_color_t19x(i * PAGE_SIZE);
+		page = color_bin_pop(cb, color);
+		if (!page && color_bins_refill(pool, cb,
+				nr_pages - i + ((nr_pages - i) >> 4)))
+			page = color_bin_pop(cb, color);
+		if (!page)
+			page = color_bin_pop_any(cb);
+		if (!page)
+			goto fail;
+		out_pages[i] = page;
 	}
 
-	/* Free extra pages created when the buffer does not
-	 * fill the last tile
-	 */
-	for (i = 0; i < state.nr_colors; i++)
-		while (state.list->counts[i] > 0)
-			__free_page(list_pop_page(state.list, i, "free"));
-
-	free_color_list(state.list);
-
+	color_bins_trim(pool, cb);
+	mutex_unlock(&cb->lock);
 	return 0;
+
+fail:
+	while (i--)
+		color_bin_push(cb, out_pages[i]);
+	color_bins_trim(pool, cb);
+	mutex_unlock(&cb->lock);
+	return -ENOMEM;
 }
 
 static int handle_page_alloc(struct nvmap_client *client,
@@ -485,9 +309,18 @@ static int handle_page_alloc(struct nvmap_client *client,
 
 	} else {
 #ifdef CONFIG_NVMAP_PAGE_POOLS
-		/* Get as many big pages from the pool as possible. */
-		page_index = nvmap_page_pool_alloc_lots_bp(&nvmap_dev->pool, pages,
+		/*
+		 * Get as many huge pages from the pool as possible. They are
+		 * taken first so that every huge page lands at a huge page
+		 * aligned offset into the handle.
+		 */
+		page_index = nvmap_page_pool_alloc_lots_hp(&nvmap_dev->pool, pages,
 								 nr_page);
+		nvmap_huge_page_allocs += page_index;
+
+		/* Get as many big pages from the pool as possible. */
+		page_index += nvmap_page_pool_alloc_lots_bp(&nvmap_dev->pool,
+				&pages[page_index], nr_page - page_index);
 		pages_per_big_pg = nvmap_dev->pool.pages_per_big_pg;
 #endif
 		/* Try to allocate big pages from page allocator */
@@ -559,6 +392,79 @@ fail:
 	return -ENOMEM;
 }
 
+/*
+ * Reserve the page array of a lazily allocated handle without backing it.
+ * Pages are filled in by nvmap_handle_populate_locked() when the CPU or a
+ * device first touches them.
+ */
+static int handle_page_alloc_lazy(struct nvmap_client *client,
+				  struct nvmap_handle *h)
+{
+	int nr_page = h->size >> PAGE_SHIFT;
+	struct page **pages;
+
+	pages = nvmap_altalloc(nr_page * sizeof(*pages));
+	if (!pages)
+		return -ENOMEM;
+	memset(pages, 0, nr_page * sizeof(*pages));
+
+	h->pgalloc.pages = pages;
+	h->pgalloc.contig = false;
+	h->pgalloc.lazy = true;
+	h->pgalloc.nr_populated = 0;
+	atomic_set(&h->pgalloc.ndirty, 0);
+	return 0;
+}
+
+/*
+ * Back the holes in [start, start + nr) of a lazy handle. Each run of missing
+ * pages is taken from the page pool in one go, with the page allocator
+ * covering whatever the pool can't. Pages that are already present are left
+ * alone, so a failure part way through leaves the handle consistent.
+ */
+int nvmap_handle_populate_locked(struct nvmap_handle *h, u32 start, u32 nr)
+{
+	u32 nr_page = h->size >> PAGE_SHIFT;
+	struct page **pages = h->pgalloc.pages;
+	u32 i, end, run, got;
+
+	lockdep_assert_held(&h->lock);
+
+	if (nvmap_handle_populated(h))
+		return 0;
+
+	end = min(start + nr, nr_page);
+	for (i = start; i < end; i += run) {
+		if (pages[i]) {
+			run = 1;
+			continue;
+		}
+
+		for (run = 1; i + run < end && !pages[i + run]; run++)
+			;
+
+		got = 0;
+#ifdef CONFIG_NVMAP_PAGE_POOLS
+		got = nvmap_page_pool_alloc_lots(&nvmap_dev->pool, &pages[i],
+						 run);
+#endif
+		for (; got < run; got++) {
+			pages[i + got] = nvmap_alloc_pages_exact(
+					GFP_NVMAP | __GFP_ZERO, PAGE_SIZE);
+			if (!pages[i + got])
+				break;
+			nvmap_clean_cache(&pages[i + got], 1);
+		}
+
+		nvmap_total_page_allocs += got;
+		smp_store_release(&h->pgalloc.nr_populated,
+				  h->pgalloc.nr_populated + got);
+		if (got < run)
+			return -ENOMEM;
+	}
+	return 0;
+}
+
 static struct device *nvmap_heap_pgalloc_dev(unsigned long type)
 {
 	int ret = -EINVAL;
@@ -674,8 +580,12 @@ static void alloc_handle(struct nvmap_client *client,
 		mb();
 		h->alloc = true;
 	} else if (type & iovmm_mask) {
-		ret = handle_page_alloc(client, h,
-			h->userflags & NVMAP_HANDLE_PHYS_CONTIG);
+		if ((h->userflags & NVMAP_HANDLE_LAZY_ALLOC) &&
+		    !(h->userflags & NVMAP_HANDLE_PHYS_CONTIG))
+			ret = handle_page_alloc_lazy(client, h);
+		else
+			ret = handle_page_alloc(client, h,
+				h->userflags & NVMAP_HANDLE_PHYS_CONTIG);
 		if (ret)
 			return;
 		h->heap_type = NVMAP_HEAP_IOVMM;
@@ -752,6 +662,7 @@ int nvmap_alloc_handle(struct nvmap_client *client,
 	int err = -ENOMEM;
 	int tag, i;
 	bool alloc_from_excl = false;
+	u64 lat_start = nvmap_stats_lat_start();
 
 	h = nvmap_handle_get(h);
 
@@ -845,6 +756,8 @@ out:
 			nvmap_stats_inc(NS_KALLOC, h->size);
 		else
 			nvmap_stats_inc(NS_UALLOC, h->size);
+		nvmap_stats_tag_alloc(tag, h->size);
+		nvmap_stats_lat_end(NL_ALLOC, h->heap_type, tag, lat_start);
 		NVMAP_TAG_TRACE(trace_nvmap_alloc_handle_done,
 			NVMAP_TP_ARGS_CHR(client, h, NULL));
 		err = 0;
@@ -863,6 +776,7 @@ int nvmap_alloc_handle_from_va(struct nvmap_client *client,
 {
 	int err = -ENOMEM;
 	int tag;
+	u64 lat_start = nvmap_stats_lat_start();
 
 	h = nvmap_handle_get(h);
 	if (!h)
@@ -893,6 +807,8 @@ int nvmap_alloc_handle_from_va(struct nvmap_client *client,
 	(void)alloc_handle_from_va(client, h, addr);
 
 	if (h->alloc) {
+		nvmap_stats_tag_alloc(tag, h->size);
+		nvmap_stats_lat_end(NL_ALLOC, h->heap_type, tag, lat_start);
 		NVMAP_TAG_TRACE(trace_nvmap_alloc_handle_done,
 			NVMAP_TP_ARGS_CHR(client, h, NULL));
 		err = 0;
@@ -903,8 +819,9 @@ int nvmap_alloc_handle_from_va(struct nvmap_client *client,
 
 void _nvmap_handle_free(struct nvmap_handle *h)
 {
-	unsigned int i, nr_page, page_index = 0;
+	unsigned int i, nr_page, nr_alloc, page_index = 0;
 	struct nvmap_handle_dmabuf_priv *curr, *next;
+	u64 lat_start = nvmap_stats_lat_start();
 
 	list_for_each_entry_safe(curr, next, &h->dmabuf_priv, list) {
 		curr->priv_release(curr->priv);
@@ -920,6 +837,7 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 
 	nvmap_stats_inc(NS_RELEASE, h->size);
 	nvmap_stats_dec(NS_TOTAL, h->size);
+	nvmap_stats_tag_free(h->userflags >> 16, h->size);
 	if (!h->heap_pgalloc) {
 		if (h->vaddr) {
 			struct vm_struct *vm;
@@ -953,16 +871,21 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 		h->vaddr = NULL;
 	}
 
-	for (i = 0; i < nr_page; i++)
-		h->pgalloc.pages[i] = nvmap_to_page(h->pgalloc.pages[i]);
+	/* Squeeze out the holes a lazy handle may still have. */
+	for (i = 0, nr_alloc = 0; i < nr_page; i++) {
+		if (!h->pgalloc.pages[i])
+			continue;
+		h->pgalloc.pages[nr_alloc++] =
+			nvmap_to_page(h->pgalloc.pages[i]);
+	}
 
 #ifdef CONFIG_NVMAP_PAGE_POOLS
 	if (!h->from_va)
 		page_index = nvmap_page_pool_fill_lots(&nvmap_dev->pool,
-					h->pgalloc.pages, nr_page);
+					h->pgalloc.pages, nr_alloc);
 #endif
 
-	for (i = page_index; i < nr_page; i++) {
+	for (i = page_index; i < nr_alloc; i++) {
 		if (h->from_va)
 			put_page(h->pgalloc.pages[i]);
 		else
@@ -972,6 +895,9 @@ void _nvmap_handle_free(struct nvmap_handle *h)
 	nvmap_altfree(h->pgalloc.pages, nr_page * sizeof(struct page *));
 
 out:
+	if (h->alloc)
+		nvmap_stats_lat_end(NL_FREE, h->heap_type, h->userflags >> 16,
+				    lat_start);
 	NVMAP_TAG_TRACE(trace_nvmap_destroy_handle,
 		NULL, get_current()->pid, 0, NVMAP_TP_ARGS_H(h));
 	kfree(h);
@@ -1003,6 +929,7 @@ void nvmap_free_handle(struct nvmap_client *client,
 
 	smp_rmb();
 	rb_erase(&ref->node, &client->handle_refs);
+	hash_del_rcu(&ref->hash_node);
 	client->handle_count--;
 	atomic_dec(&ref->handle->share_count);
 
@@ -1014,7 +941,7 @@ void nvmap_free_handle(struct nvmap_client *client,
 	dma_buf_put(ref->handle->dmabuf);
 	NVMAP_TAG_TRACE(trace_nvmap_free_handle,
 		NVMAP_TP_ARGS_CHR(client, h, ref));
-	kfree(ref);
+	kfree_rcu(ref, rcu);
 
 out:
 	BUG_ON(!atomic_read(&h->ref));
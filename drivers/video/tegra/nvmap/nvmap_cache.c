@@ -36,6 +36,8 @@ size_t cache_maint_inner_threshold = 8 * SZ_2M;
 
 static struct static_key nvmap_disable_vaddr_for_cache_maint;
 
+bool nvmap_cpu_dirty_tracking = true;
+
 inline static void nvmap_flush_dcache_all(void *dummy)
 {
 #if defined(CONFIG_DENVER_CPU)
@@ -210,6 +212,11 @@ per_page_cache_maint:
 
 		page = nvmap_to_page(h->pgalloc.pages[start >> PAGE_SHIFT]);
 		next = min(((start + PAGE_SIZE) & PAGE_MASK), end);
+		/* Not yet populated, nothing can be cached for it. */
+		if (!page) {
+			start = next;
+			continue;
+		}
 		off = start & ~PAGE_MASK;
 		size = next - start;
 		paddr = page_to_phys(page) + off;
@@ -254,6 +261,102 @@ static bool fast_cache_maint(struct nvmap_handle *h,
 	return true;
 }
 
+/*
+ * Returns true if the handle offset is mapped into a writable user VMA, where
+ * the CPU can dirty the page again without faulting.
+ *
+ * Must be called with h->lock held.
+ */
+static bool nvmap_handle_user_writable(struct nvmap_handle *h,
+				       unsigned long offs)
+{
+	struct nvmap_vma_list *vma_list;
+
+	list_for_each_entry(vma_list, &h->vmas, list) {
+		struct vm_area_struct *vma = vma_list->vma;
+		struct nvmap_vma_priv *priv = vma->vm_private_data;
+		unsigned long vstart;
+
+		if (!(vma->vm_flags & VM_WRITE) || !priv)
+			continue;
+
+		vstart = priv->offs + (vma->vm_pgoff << PAGE_SHIFT);
+		if (offs >= vstart && offs - vstart < vma->vm_end - vma->vm_start)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Drop the CPU dirty marks of pages [pg, end_pg) that can't be dirtied again
+ * without nvmap noticing. Returns the number of pages that were marked.
+ *
+ * Must be called with h->lock held.
+ */
+static unsigned long nvmap_handle_cpuclean_locked(struct nvmap_handle *h,
+		unsigned long pg, unsigned long end_pg)
+{
+	unsigned long nr = 0;
+
+	for (; pg < end_pg; pg++) {
+		if (!nvmap_page_cpu_dirty(h->pgalloc.pages[pg]))
+			continue;
+		nr++;
+		if (!nvmap_handle_user_writable(h, pg << PAGE_SHIFT))
+			nvmap_page_mkcpuclean(&h->pgalloc.pages[pg]);
+	}
+
+	return nr;
+}
+
+/*
+ * Write back only those pages of [start, end) the CPU may have dirtied since
+ * they were last cleaned. Contiguous runs of such pages are cleaned in one
+ * go, and if they add up to more than the inner threshold the whole cache is
+ * cleaned instead.
+ */
+static void nvmap_cache_wb_cpu_dirty(struct nvmap_handle *h,
+		unsigned long start, unsigned long end, bool outer)
+{
+	unsigned long pg = start >> PAGE_SHIFT;
+	unsigned long end_pg = PAGE_ALIGN(end) >> PAGE_SHIFT;
+	unsigned long nr_dirty = 0;
+	unsigned long i;
+
+	mutex_lock(&h->lock);
+	for (i = pg; i < end_pg; i++)
+		nr_dirty += nvmap_page_cpu_dirty(h->pgalloc.pages[i]);
+	if (nr_dirty && can_fast_cache_maint(0, nr_dirty << PAGE_SHIFT,
+					     NVMAP_CACHE_OP_WB)) {
+		nvmap_handle_cpuclean_locked(h, pg, end_pg);
+		mutex_unlock(&h->lock);
+		inner_clean_cache_all();
+		return;
+	}
+	mutex_unlock(&h->lock);
+
+	while (nr_dirty && pg < end_pg) {
+		unsigned long run;
+
+		mutex_lock(&h->lock);
+		while (pg < end_pg && !nvmap_page_cpu_dirty(h->pgalloc.pages[pg]))
+			pg++;
+		run = pg;
+		while (pg < end_pg && nvmap_page_cpu_dirty(h->pgalloc.pages[pg]))
+			pg++;
+		nvmap_handle_cpuclean_locked(h, run, pg);
+		mutex_unlock(&h->lock);
+
+		if (run == pg)
+			break;
+
+		heap_page_cache_maint(h, max(start, run << PAGE_SHIFT),
+				      min(end, pg << PAGE_SHIFT),
+				      NVMAP_CACHE_OP_WB, true, outer, false);
+	}
+}
+
 struct cache_maint_op {
 	phys_addr_t start;
 	phys_addr_t end;
@@ -329,6 +432,12 @@ static int do_cache_maint(struct cache_maint_op *cache_work)
 		goto out;
 	}
 
+	if (op == NVMAP_CACHE_OP_WB && nvmap_handle_track_cpu_dirty(h)) {
+		nvmap_cache_wb_cpu_dirty(h, pstart, pend,
+			h->flags != NVMAP_HANDLE_INNER_CACHEABLE);
+		goto out;
+	}
+
 	if (fast_cache_maint(h, pstart, pend, op, cache_work->clean_only_dirty))
 		goto out;
 
@@ -377,6 +486,7 @@ int __nvmap_do_cache_maint(struct nvmap_client *client,
 {
 	int err;
 	struct cache_maint_op cache_op;
+	u64 lat_start = nvmap_stats_lat_start();
 
 	h = nvmap_handle_get(h);
 	if (!h)
@@ -413,6 +523,8 @@ int __nvmap_do_cache_maint(struct nvmap_client *client,
 
 	nvmap_stats_inc(NS_CFLUSH_RQ, end - start);
 	err = do_cache_maint(&cache_op);
+	nvmap_stats_lat_end(NL_CACHE_MAINT, h->heap_type, h->userflags >> 16,
+			    lat_start);
 	nvmap_kmaps_dec(h);
 	nvmap_handle_put(h);
 	return err;
@@ -654,6 +766,9 @@ int nvmap_cache_debugfs_init(struct dentry *nvmap_root)
 			    &cache_inner_threshold_fops);
 	}
 
+	debugfs_create_bool("cpu_dirty_tracking", S_IRUSR | S_IWUSR,
+			    cache_root, &nvmap_cpu_dirty_tracking);
+
 	debugfs_create_atomic_t("nvmap_disable_vaddr_for_cache_maint",
 				S_IRUSR | S_IWUSR,
 				cache_root,
@@ -0,0 +1,432 @@
+/*
+ * drivers/video/tegra/nvmap/nvmap_cache_async.c
+ *
+ * Asynchronous, batched cache maintenance for nvmap
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#define pr_fmt(fmt)	"nvmap: %s() " fmt, __func__
+
+#include <linux/cpumask.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/topology.h>
+#include <linux/uaccess.h>
+
+#include "../drivers/staging/android/sw_sync.h"
+
+#include "nvmap_priv.h"
+
+#define NVMAP_CACHE_ASYNC_MAX_CLUSTERS	8
+#define NVMAP_CACHE_ASYNC_MAX_HANDLES	4096
+
+/*
+ * One queued NVMAP_IOC_CACHE_LIST_ASYNC request. The request owns a
+ * reference on each of its handles until the worker is done with it.
+ */
+struct nvmap_cache_async_req {
+	struct list_head node;
+	int op;
+	u32 nr;
+	struct nvmap_cache_async_range {
+		struct nvmap_handle *h;
+		u64 start;
+		u64 end;
+	} ranges[];
+};
+
+/*
+ * A worker is bound to the CPUs of one cluster. Requests are queued to the
+ * worker of the submitting CPU's cluster and signal the worker's timeline in
+ * submission order.
+ */
+struct nvmap_cache_async_worker {
+	struct kthread_worker *kworker;
+	struct kthread_work work;
+	struct mutex lock;		/* protects pending and next_value */
+	struct list_head pending;
+	struct sw_sync_timeline *timeline;
+	u32 next_value;
+	int cluster;
+	struct cpumask cpus;
+};
+
+static struct nvmap_cache_async_worker *cache_async_workers;
+static int cache_async_nr_workers;
+
+static int nvmap_cache_async_range_cmp(const void *a, const void *b)
+{
+	const struct nvmap_cache_async_range *ra = a, *rb = b;
+
+	if (ra->h != rb->h)
+		return ra->h < rb->h ? -1 : 1;
+	if (ra->start != rb->start)
+		return ra->start < rb->start ? -1 : 1;
+	return 0;
+}
+
+/*
+ * Do the cache maintenance for all ranges of the passed requests that use
+ * op. Ranges are sorted and overlapping or adjacent ranges of the same
+ * handle are merged so that each byte is maintained at most once. The merged
+ * list goes through nvmap_do_cache_maint_list(), which switches to a full
+ * inner cache flush once the total size passes the inner threshold.
+ */
+static void nvmap_cache_async_do_op(struct list_head *reqs, int op)
+{
+	struct nvmap_cache_async_req *req;
+	struct nvmap_cache_async_range *ranges;
+	struct nvmap_handle **handles;
+	u64 *offsets, *sizes;
+	size_t bytes;
+	u32 nr = 0, merged = 0, i;
+
+	list_for_each_entry(req, reqs, node)
+		if (req->op == op)
+			nr += req->nr;
+	if (!nr)
+		return;
+
+	bytes = nr * (sizeof(*ranges) + sizeof(*handles) + 2 * sizeof(u64));
+	ranges = nvmap_altalloc(bytes);
+	if (!ranges) {
+		/* Fall back to maintaining each range on its own */
+		list_for_each_entry(req, reqs, node) {
+			if (req->op != op)
+				continue;
+			for (i = 0; i < req->nr; i++) {
+				u64 offset = req->ranges[i].start;
+				u64 size = req->ranges[i].end - offset;
+
+				nvmap_do_cache_maint_list(&req->ranges[i].h,
+					&offset, &size, op, 1, false);
+			}
+		}
+		return;
+	}
+	handles = (struct nvmap_handle **)(ranges + nr);
+	offsets = (u64 *)(handles + nr);
+	sizes = offsets + nr;
+
+	nr = 0;
+	list_for_each_entry(req, reqs, node) {
+		if (req->op != op)
+			continue;
+		memcpy(&ranges[nr], req->ranges, req->nr * sizeof(*ranges));
+		nr += req->nr;
+	}
+
+	sort(ranges, nr, sizeof(*ranges), nvmap_cache_async_range_cmp, NULL);
+
+	for (i = 0; i < nr; i++) {
+		if (merged && handles[merged - 1] == ranges[i].h &&
+		    offsets[merged - 1] + sizes[merged - 1] >= ranges[i].start) {
+			u64 end = max(offsets[merged - 1] + sizes[merged - 1],
+				      ranges[i].end);
+
+			sizes[merged - 1] = end - offsets[merged - 1];
+			continue;
+		}
+		handles[merged] = ranges[i].h;
+		offsets[merged] = ranges[i].start;
+		sizes[merged] = ranges[i].end - ranges[i].start;
+		merged++;
+	}
+
+	if (nvmap_do_cache_maint_list(handles, offsets, sizes, op, merged,
+				      false))
+		pr_err("async cache maint failed, op %d\n", op);
+
+	nvmap_altfree(ranges, bytes);
+}
+
+static void nvmap_cache_async_free_req(struct nvmap_cache_async_req *req)
+{
+	u32 i;
+
+	for (i = 0; i < req->nr; i++)
+		nvmap_handle_put(req->ranges[i].h);
+	kfree(req);
+}
+
+static void nvmap_cache_async_work(struct kthread_work *work)
+{
+	struct nvmap_cache_async_worker *w =
+		container_of(work, struct nvmap_cache_async_worker, work);
+	struct nvmap_cache_async_req *req, *tmp;
+	LIST_HEAD(reqs);
+	u32 count = 0;
+
+	mutex_lock(&w->lock);
+	list_splice_init(&w->pending, &reqs);
+	mutex_unlock(&w->lock);
+
+	if (list_empty(&reqs))
+		return;
+
+	nvmap_cache_async_do_op(&reqs, NVMAP_CACHE_OP_WB);
+	nvmap_cache_async_do_op(&reqs, NVMAP_CACHE_OP_WB_INV);
+
+	list_for_each_entry_safe(req, tmp, &reqs, node) {
+		list_del(&req->node);
+		nvmap_cache_async_free_req(req);
+		count++;
+	}
+
+	/* Requests were spliced in order, so this signals all their fences */
+	sw_sync_timeline_inc(w->timeline, count);
+}
+
+static struct nvmap_cache_async_worker *nvmap_cache_async_this_worker(void)
+{
+	int cpu = get_cpu();
+	int i;
+
+	for (i = 0; i < cache_async_nr_workers; i++)
+		if (cpumask_test_cpu(cpu, &cache_async_workers[i].cpus))
+			break;
+	put_cpu();
+
+	return &cache_async_workers[i < cache_async_nr_workers ? i : 0];
+}
+
+static int nvmap_cache_async_queue(struct nvmap_cache_async_req *req,
+				   int *fence_fd)
+{
+	struct nvmap_cache_async_worker *w = nvmap_cache_async_this_worker();
+	struct sync_fence *fence;
+	struct sync_pt *pt;
+	int fd;
+
+	fd = get_unused_fd_flags(O_CLOEXEC);
+	if (fd < 0)
+		return fd;
+
+	mutex_lock(&w->lock);
+
+	pt = sw_sync_pt_create(w->timeline, w->next_value + 1);
+	if (!pt)
+		goto fail;
+
+	fence = sync_fence_create("nvmap-cache-maint", pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		goto fail;
+	}
+
+	w->next_value++;
+	list_add_tail(&req->node, &w->pending);
+	mutex_unlock(&w->lock);
+
+	kthread_queue_work(w->kworker, &w->work);
+
+	sync_fence_install(fence, fd);
+	*fence_fd = fd;
+
+	return 0;
+
+fail:
+	mutex_unlock(&w->lock);
+	put_unused_fd(fd);
+	return -ENOMEM;
+}
+
+int nvmap_ioctl_cache_maint_list_async(struct file *filp, void __user *arg)
+{
+	struct nvmap_cache_op_list_async op;
+	struct nvmap_cache_async_req *req;
+	u32 *handle_ptr = NULL;
+	u64 *offset_ptr = NULL;
+	u64 *size_ptr = NULL;
+	u32 i, n_unmarshal_handles = 0;
+	int err = 0;
+
+	if (!cache_async_nr_workers)
+		return -ENODEV;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!op.nr || op.nr > NVMAP_CACHE_ASYNC_MAX_HANDLES)
+		return -EINVAL;
+
+	if (op.op < NVMAP_CACHE_OP_WB || op.op > NVMAP_CACHE_OP_WB_INV)
+		return -EINVAL;
+
+	if (!op.handles || !op.offsets || !op.sizes)
+		return -EINVAL;
+
+	req = kzalloc(sizeof(*req) + op.nr * sizeof(req->ranges[0]),
+		      GFP_KERNEL);
+	handle_ptr = kmalloc_array(op.nr, sizeof(u32), GFP_KERNEL);
+	offset_ptr = kmalloc_array(op.nr, sizeof(u64), GFP_KERNEL);
+	size_ptr = kmalloc_array(op.nr, sizeof(u64), GFP_KERNEL);
+	if (!req || !handle_ptr || !offset_ptr || !size_ptr) {
+		err = -ENOMEM;
+		goto free_mem;
+	}
+
+	if (copy_from_user(handle_ptr, (void __user *)(uintptr_t)op.handles,
+			   op.nr * sizeof(u32)) ||
+	    copy_from_user(offset_ptr, (void __user *)(uintptr_t)op.offsets,
+			   op.nr * sizeof(u64)) ||
+	    copy_from_user(size_ptr, (void __user *)(uintptr_t)op.sizes,
+			   op.nr * sizeof(u64))) {
+		err = -EFAULT;
+		goto free_mem;
+	}
+
+	/* INV is always promoted to WB_INV, see __nvmap_do_cache_maint() */
+	req->op = (op.op == NVMAP_CACHE_OP_WB) ?
+		  NVMAP_CACHE_OP_WB : NVMAP_CACHE_OP_WB_INV;
+
+	for (i = 0; i < op.nr; i++) {
+		struct nvmap_handle *h;
+		u64 size = size_ptr[i];
+
+		h = nvmap_handle_get_from_fd(handle_ptr[i]);
+		if (!h) {
+			pr_err("invalid handle_ptr[%d] = %u\n",
+				i, handle_ptr[i]);
+			err = -EINVAL;
+			goto free_mem;
+		}
+		req->ranges[i].h = h;
+		n_unmarshal_handles++;
+
+		if (!(h->heap_type & nvmap_dev->cpu_access_mask)) {
+			pr_err("heap %x can't be accessed from cpu\n",
+				h->heap_type);
+			err = -EPERM;
+			goto free_mem;
+		}
+
+		if (!size) {
+			req->ranges[i].start = 0;
+			req->ranges[i].end = h->size;
+		} else if (offset_ptr[i] >= h->size ||
+			   size > h->size - offset_ptr[i]) {
+			err = -EINVAL;
+			goto free_mem;
+		} else {
+			req->ranges[i].start = offset_ptr[i];
+			req->ranges[i].end = offset_ptr[i] + size;
+		}
+	}
+	req->nr = op.nr;
+
+	err = nvmap_cache_async_queue(req, &op.fence_fd);
+	if (err)
+		goto free_mem;
+	req = NULL;
+
+	if (copy_to_user(arg, &op, sizeof(op))) {
+		/* The request is queued and the fd installed; nothing to undo */
+		err = -EFAULT;
+	}
+
+free_mem:
+	if (req) {
+		req->nr = n_unmarshal_handles;
+		nvmap_cache_async_free_req(req);
+	}
+	kfree(handle_ptr);
+	kfree(offset_ptr);
+	kfree(size_ptr);
+	return err;
+}
+
+int nvmap_cache_async_init(void)
+{
+	int cpu, i, nr = 0;
+
+	cache_async_workers = kcalloc(NVMAP_CACHE_ASYNC_MAX_CLUSTERS,
+				      sizeof(*cache_async_workers),
+				      GFP_KERNEL);
+	if (!cache_async_workers)
+		return -ENOMEM;
+
+	/* One worker per CPU cluster; clusters beyond the max share the last */
+	for_each_possible_cpu(cpu) {
+		int cluster = topology_physical_package_id(cpu);
+
+		for (i = 0; i < nr; i++)
+			if (cache_async_workers[i].cluster == cluster)
+				break;
+		if (i == nr) {
+			if (nr == NVMAP_CACHE_ASYNC_MAX_CLUSTERS) {
+				i = nr - 1;
+			} else {
+				cache_async_workers[i].cluster = cluster;
+				nr++;
+			}
+		}
+		cpumask_set_cpu(cpu, &cache_async_workers[i].cpus);
+	}
+
+	for (i = 0; i < nr; i++) {
+		struct nvmap_cache_async_worker *w = &cache_async_workers[i];
+		char name[16];
+
+		snprintf(name, sizeof(name), "nvmap-cm%d", i);
+		mutex_init(&w->lock);
+		INIT_LIST_HEAD(&w->pending);
+		kthread_init_work(&w->work, nvmap_cache_async_work);
+
+		w->timeline = sw_sync_timeline_create(name);
+		if (!w->timeline)
+			goto fail;
+
+		w->kworker = kthread_create_worker(0, "%s", name);
+		if (IS_ERR(w->kworker)) {
+			w->kworker = NULL;
+			goto fail;
+		}
+		set_cpus_allowed_ptr(w->kworker->task, &w->cpus);
+		cache_async_nr_workers = i + 1;
+	}
+
+	pr_info("%d async cache maint workers\n", cache_async_nr_workers);
+	return 0;
+
+fail:
+	nvmap_cache_async_fini();
+	return -ENOMEM;
+}
+
+void nvmap_cache_async_fini(void)
+{
+	int i;
+
+	if (!cache_async_workers)
+		return;
+
+	for (i = 0; i < NVMAP_CACHE_ASYNC_MAX_CLUSTERS; i++) {
+		struct nvmap_cache_async_worker *w = &cache_async_workers[i];
+
+		if (w->kworker) {
+			kthread_flush_work(&w->work);
+			kthread_destroy_worker(w->kworker);
+		}
+		if (w->timeline)
+			sync_timeline_destroy(&w->timeline->obj);
+	}
+
+	cache_async_nr_workers = 0;
+	kfree(cache_async_workers);
+	cache_async_workers = NULL;
+}
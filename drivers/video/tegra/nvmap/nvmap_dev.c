@@ -191,6 +191,7 @@ struct nvmap_client *__nvmap_create_client(struct nvmap_device *dev,
 	client->name = name;
 	client->kernel_client = true;
 	client->handle_refs = RB_ROOT;
+	hash_init(client->handle_refs_hash);
 
 	get_task_struct(current->group_leader);
 	task_lock(current->group_leader);
@@ -415,6 +416,14 @@ static long nvmap_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 						   cmd == NVMAP_IOC_RESERVE);
 		break;
 
+	case NVMAP_IOC_CACHE_LIST_ASYNC:
+		err = nvmap_ioctl_cache_maint_list_async(filp, uarg);
+		break;
+
+	case NVMAP_IOC_ALLOC_BATCH:
+		err = nvmap_ioctl_alloc_batch(filp, uarg);
+		break;
+
 	case NVMAP_IOC_GUP_TEST:
 		err = nvmap_ioctl_gup_test(filp, uarg);
 		break;
@@ -527,7 +536,8 @@ static void allocations_stringify(struct nvmap_client *client,
 
 next_page:
 			if ((heap_type == NVMAP_HEAP_CARVEOUT_VPR) && handle->heap_pgalloc) {
-				base = page_to_phys(handle->pgalloc.pages[i++]);
+				base = page_to_phys(nvmap_to_page(
+					handle->pgalloc.pages[i++]));
 				size = K(PAGE_SIZE);
 			}
 
@@ -612,7 +622,8 @@ static void maps_stringify(struct nvmap_client *client,
 
 next_page:
 			if ((heap_type == NVMAP_HEAP_CARVEOUT_VPR) && handle->heap_pgalloc) {
-				base = page_to_phys(handle->pgalloc.pages[i++]);
+				base = page_to_phys(nvmap_to_page(
+					handle->pgalloc.pages[i++]));
 				size = K(PAGE_SIZE);
 			}
 
@@ -702,7 +713,7 @@ static void nvmap_get_total_mss(u64 *pss, u64 *total, u32 heap_type)
 		for (i = 0; i < h->size >> PAGE_SHIFT; i++) {
 			struct page *page = nvmap_to_page(h->pgalloc.pages[i]);
 
-			if (page_mapcount(page) > 0)
+			if (page && page_mapcount(page) > 0)
 				*pss += PAGE_SIZE;
 		}
 	}
@@ -763,7 +774,8 @@ static int nvmap_debug_all_allocations_show(struct seq_file *s, void *unused)
 
 next_page:
 			if ((heap_type == NVMAP_HEAP_CARVEOUT_VPR) && handle->heap_pgalloc) {
-				base = page_to_phys(handle->pgalloc.pages[i++]);
+				base = page_to_phys(nvmap_to_page(
+					handle->pgalloc.pages[i++]));
 				size = K(PAGE_SIZE);
 			}
 
@@ -819,7 +831,8 @@ static int nvmap_debug_orphan_handles_show(struct seq_file *s, void *unused)
 
 next_page:
 			if ((heap_type == NVMAP_HEAP_CARVEOUT_VPR) && handle->heap_pgalloc) {
-				base = page_to_phys(handle->pgalloc.pages[i++]);
+				base = page_to_phys(nvmap_to_page(
+					handle->pgalloc.pages[i++]));
 				size = K(PAGE_SIZE);
 			}
 
@@ -933,7 +946,8 @@ static int nvmap_debug_handles_by_pid_show_client(struct seq_file *s,
 
 next_page:
 		if ((handle->heap_type == NVMAP_HEAP_CARVEOUT_VPR) && handle->heap_pgalloc) {
-			entry.base = page_to_phys(handle->pgalloc.pages[i++]);
+			entry.base = page_to_phys(nvmap_to_page(
+					handle->pgalloc.pages[i++]));
 			entry.size = K(PAGE_SIZE);
 		}
 
@@ -1262,6 +1276,8 @@ int __init nvmap_probe(struct platform_device *pdev)
 	nvmap_page_pool_debugfs_init(nvmap_dev->debug_root);
 #endif
 	nvmap_cache_debugfs_init(nvmap_dev->debug_root);
+	if (nvmap_cache_async_init())
+		dev_warn(&pdev->dev, "async cache maintenance unavailable\n");
 	nvmap_dev->handles_by_pid = debugfs_create_dir("handles_by_pid",
 							nvmap_debug_root);
 #if defined(CONFIG_DEBUG_FS)
@@ -19,6 +19,7 @@
 #include <linux/slab.h>
 #include <linux/uaccess.h>
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <linux/nvmap.h>
 #include <linux/dma-buf.h>
 #include <linux/spinlock.h>
@@ -37,6 +38,33 @@
 #include "nvmap_priv.h"
 #include "nvmap_ioctl.h"
 
+/**
+ * Per device stash of unused dma_buf maps. Maps whose last user went away are
+ * kept on an LRU list so that a device re-mapping the same buffer can reuse
+ * the IOVA mapping instead of going through dma_map_sg() again.
+ *
+ * @dev The device whose maps are kept on this stash.
+ * @lru Stashed maps, most recently used first.
+ * @stash_node Entry on the global list of stashes.
+ * @count Number of maps currently on @lru.
+ * @max Number of maps above which the least recently used ones are freed.
+ * @keep_mapped Never evict maps on capacity - only when the dma_buf goes away.
+ * @hits Maps retrieved from the stash.
+ * @misses Maps that had to be created from scratch.
+ * @evictions Maps freed to respect @max.
+ */
+struct nvmap_dmabuf_stash {
+	struct device *dev;
+	struct list_head lru;
+	struct list_head stash_node;
+	u32 count;
+	u32 max;
+	bool keep_mapped;
+	u64 hits;
+	u64 misses;
+	u64 evictions;
+};
+
 /**
  * List node for maps of nvmap handles via the dma_buf API. These store the
  * necessary info for stashing mappings.
@@ -44,6 +72,7 @@
  * @iommu_domain Domain for which this SGT is valid - for supporting multi-asid.
  * @dir DMA direction.
  * @sgt The scatter gather table to stash.
+ * @stash The stash of the device this SGT was mapped for.
  * @refs Reference counting.
  * @maps_entry Entry on a given attachment's list of maps.
  * @stash_entry Entry on the stash list.
@@ -54,6 +83,7 @@ struct nvmap_handle_sgt {
 	enum dma_data_direction dir;
 	struct sg_table *sgt;
 	struct device *dev;
+	struct nvmap_dmabuf_stash *stash;
 
 	atomic_t refs;
 
@@ -63,10 +93,37 @@ struct nvmap_handle_sgt {
 	struct nvmap_handle_info *owner;
 } ____cacheline_aligned_in_smp;
 
+/*
+ * Lock ordering: an owner's maps_lock is taken before the stash lock. The
+ * eviction path only ever trylocks another owner's maps_lock while holding the
+ * stash lock.
+ */
 static DEFINE_MUTEX(nvmap_stashed_maps_lock);
-static LIST_HEAD(nvmap_stashed_maps);
+static LIST_HEAD(nvmap_dmabuf_stashes);
 static struct kmem_cache *handle_sgt_cache;
 static struct dma_buf_ops nvmap_dma_buf_ops;
+static struct dentry *nvmap_stash_debug_root;
+
+static u32 nvmap_stash_max = 32;
+module_param_named(stash_max, nvmap_stash_max, uint, 0644);
+
+/*
+ * Capture, ISP and decode engines map the same set of buffers every frame for
+ * as long as the stream runs. Keep those mapped rather than letting them age
+ * out of the stash. Any other device can opt in from DT.
+ */
+static const struct of_device_id nvmap_stash_keep_mapped_ids[] = {
+	{ .compatible = "nvidia,tegra210-vi" },
+	{ .compatible = "nvidia,tegra186-vi" },
+	{ .compatible = "nvidia,tegra194-vi" },
+	{ .compatible = "nvidia,tegra210-isp" },
+	{ .compatible = "nvidia,tegra186-isp" },
+	{ .compatible = "nvidia,tegra194-isp" },
+	{ .compatible = "nvidia,tegra210-nvdec" },
+	{ .compatible = "nvidia,tegra186-nvdec" },
+	{ .compatible = "nvidia,tegra194-nvdec" },
+	{ },
+};
 
 static bool nvmap_attach_handle_same_asid(struct dma_buf_attachment *attach,
 					struct nvmap_handle_sgt *nvmap_sgt)
@@ -75,18 +132,38 @@ static bool nvmap_attach_handle_same_asid(struct dma_buf_attachment *attach,
 
 }
 
+static void nvmap_dmabuf_stash_debugfs_add(struct nvmap_dmabuf_stash *stash);
+
 /*
- * Initialize a kmem cache for allocating nvmap_handle_sgt's.
+ * Find the stash for @dev, creating it on first use. Devices are never
+ * removed from the stash list so the returned pointer remains valid. Requires
+ * the stash lock.
  */
-int nvmap_dmabuf_stash_init(void)
+static struct nvmap_dmabuf_stash *nvmap_dmabuf_stash_get_locked(
+				struct device *dev)
 {
-	handle_sgt_cache = KMEM_CACHE(nvmap_handle_sgt, 0);
-	if (IS_ERR_OR_NULL(handle_sgt_cache)) {
-		pr_err("Failed to make kmem cache for nvmap_handle_sgt.\n");
-		return -ENOMEM;
-	}
+	struct nvmap_dmabuf_stash *stash;
 
-	return 0;
+	list_for_each_entry(stash, &nvmap_dmabuf_stashes, stash_node)
+		if (stash->dev == dev)
+			return stash;
+
+	stash = kzalloc(sizeof(*stash), GFP_KERNEL);
+	if (!stash)
+		return NULL;
+
+	stash->dev = dev;
+	stash->max = nvmap_stash_max;
+	INIT_LIST_HEAD(&stash->lru);
+	if (dev->of_node)
+		stash->keep_mapped =
+			of_match_node(nvmap_stash_keep_mapped_ids,
+				      dev->of_node) ||
+			of_property_read_bool(dev->of_node,
+					      "nvidia,nvmap-keep-mapped");
+	list_add_tail(&stash->stash_node, &nvmap_dmabuf_stashes);
+	nvmap_dmabuf_stash_debugfs_add(stash);
+	return stash;
 }
 
 static int nvmap_dmabuf_attach(struct dma_buf *dmabuf, struct device *dev,
@@ -124,6 +201,8 @@ static void __nvmap_dmabuf_del_stash(struct nvmap_handle_sgt *nvmap_sgt)
 
 	pr_debug("Removing map from stash.\n");
 	list_del_init(&nvmap_sgt->stash_entry);
+	nvmap_sgt->stash->count--;
+	nvmap_sgt->stash->hits++;
 	mutex_unlock(&nvmap_stashed_maps_lock);
 }
 
@@ -179,8 +258,10 @@ static void __nvmap_dmabuf_free_sgt_locked(struct nvmap_handle_sgt *nvmap_sgt)
 static void __nvmap_dmabuf_evict_stash_locked(
 			struct nvmap_handle_sgt *nvmap_sgt)
 {
-	if (!list_empty(&nvmap_sgt->stash_entry))
+	if (!list_empty(&nvmap_sgt->stash_entry)) {
 		list_del_init(&nvmap_sgt->stash_entry);
+		nvmap_sgt->stash->count--;
+	}
 }
 
 /*
@@ -193,6 +274,39 @@ static void __nvmap_dmabuf_evict_stash(struct nvmap_handle_sgt *nvmap_sgt)
 	mutex_unlock(&nvmap_stashed_maps_lock);
 }
 
+/*
+ * Free least recently used maps until @stash is back under its capacity.
+ * @locked is the owner whose maps_lock the caller already holds, if any. Maps
+ * belonging to owners that are busy are skipped; they get another chance the
+ * next time this stash is trimmed. Requires the stash lock.
+ */
+static void nvmap_dmabuf_stash_trim_locked(struct nvmap_dmabuf_stash *stash,
+					   struct nvmap_handle_info *locked)
+{
+	struct nvmap_handle_sgt *nvmap_sgt, *tmp;
+	struct nvmap_handle_info *owner;
+
+	if (stash->keep_mapped)
+		return;
+
+	list_for_each_entry_safe_reverse(nvmap_sgt, tmp, &stash->lru,
+					 stash_entry) {
+		if (stash->count <= stash->max)
+			break;
+
+		owner = nvmap_sgt->owner;
+		if (owner != locked && !mutex_trylock(&owner->maps_lock))
+			continue;
+
+		__nvmap_dmabuf_evict_stash_locked(nvmap_sgt);
+		__nvmap_dmabuf_free_sgt_locked(nvmap_sgt);
+		stash->evictions++;
+
+		if (owner != locked)
+			mutex_unlock(&owner->maps_lock);
+	}
+}
+
 /*
  * Prepare an SGT for potential stashing later on.
  */
@@ -218,6 +332,12 @@ static int __nvmap_dmabuf_prep_sgt_locked(struct dma_buf_attachment *attach,
 	INIT_LIST_HEAD(&nvmap_sgt->stash_entry);
 	atomic_set(&nvmap_sgt->refs, 1);
 	list_add(&nvmap_sgt->maps_entry, &info->maps);
+
+	mutex_lock(&nvmap_stashed_maps_lock);
+	nvmap_sgt->stash = nvmap_dmabuf_stash_get_locked(attach->dev);
+	if (nvmap_sgt->stash)
+		nvmap_sgt->stash->misses++;
+	mutex_unlock(&nvmap_stashed_maps_lock);
 	return 0;
 }
 
@@ -231,6 +351,7 @@ static void __nvmap_dmabuf_stash_sgt_locked(struct dma_buf_attachment *attach,
 {
 	struct nvmap_handle_sgt *nvmap_sgt;
 	struct nvmap_handle_info *info = attach->dmabuf->priv;
+	struct nvmap_dmabuf_stash *stash;
 
 	pr_debug("Stashing SGT - if necessary.\n");
 	list_for_each_entry(nvmap_sgt, &info->maps, maps_entry) {
@@ -238,7 +359,17 @@ static void __nvmap_dmabuf_stash_sgt_locked(struct dma_buf_attachment *attach,
 			if (!atomic_sub_and_test(1, &nvmap_sgt->refs))
 				goto done;
 
-			__nvmap_dmabuf_free_sgt_locked(nvmap_sgt);
+			stash = nvmap_sgt->stash;
+			if (!stash || (!stash->max && !stash->keep_mapped)) {
+				__nvmap_dmabuf_free_sgt_locked(nvmap_sgt);
+				goto done;
+			}
+
+			mutex_lock(&nvmap_stashed_maps_lock);
+			list_add(&nvmap_sgt->stash_entry, &stash->lru);
+			stash->count++;
+			nvmap_dmabuf_stash_trim_locked(stash, info);
+			mutex_unlock(&nvmap_stashed_maps_lock);
 			goto done;
 		}
 	}
@@ -247,6 +378,75 @@ done:
 	return;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int nvmap_stash_max_get(void *data, u64 *val)
+{
+	struct nvmap_dmabuf_stash *stash = data;
+
+	*val = stash->max;
+	return 0;
+}
+
+/*
+ * Shrinking the capacity takes effect immediately so that writing 0 flushes
+ * every evictable map for the device.
+ */
+static int nvmap_stash_max_set(void *data, u64 val)
+{
+	struct nvmap_dmabuf_stash *stash = data;
+
+	mutex_lock(&nvmap_stashed_maps_lock);
+	stash->max = min_t(u64, val, U32_MAX);
+	nvmap_dmabuf_stash_trim_locked(stash, NULL);
+	mutex_unlock(&nvmap_stashed_maps_lock);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(nvmap_stash_max_fops, nvmap_stash_max_get,
+			nvmap_stash_max_set, "%llu\n");
+
+static void nvmap_dmabuf_stash_debugfs_add(struct nvmap_dmabuf_stash *stash)
+{
+	struct dentry *dir;
+
+	if (IS_ERR_OR_NULL(nvmap_stash_debug_root))
+		return;
+
+	dir = debugfs_create_dir(dev_name(stash->dev), nvmap_stash_debug_root);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	debugfs_create_file("max", S_IRUGO | S_IWUSR, dir, stash,
+			    &nvmap_stash_max_fops);
+	debugfs_create_bool("keep_mapped", S_IRUGO | S_IWUSR, dir,
+			    &stash->keep_mapped);
+	debugfs_create_u32("count", S_IRUGO, dir, &stash->count);
+	debugfs_create_u64("hits", S_IRUGO, dir, &stash->hits);
+	debugfs_create_u64("misses", S_IRUGO, dir, &stash->misses);
+	debugfs_create_u64("evictions", S_IRUGO, dir, &stash->evictions);
+}
+#else
+static void nvmap_dmabuf_stash_debugfs_add(struct nvmap_dmabuf_stash *stash)
+{
+}
+#endif
+
+/*
+ * Initialize a kmem cache for allocating nvmap_handle_sgt's.
+ */
+int nvmap_dmabuf_stash_init(void)
+{
+	handle_sgt_cache = KMEM_CACHE(nvmap_handle_sgt, 0);
+	if (IS_ERR_OR_NULL(handle_sgt_cache)) {
+		pr_err("Failed to make kmem cache for nvmap_handle_sgt.\n");
+		return -ENOMEM;
+	}
+
+	if (!IS_ERR_OR_NULL(nvmap_dev->debug_root))
+		nvmap_stash_debug_root = debugfs_create_dir("stash",
+						nvmap_dev->debug_root);
+	return 0;
+}
+
 /*
  * Checks if there is already a map for this attachment. If so increment the
  * ref count on said map and return the associated sg_table. Otherwise return
@@ -421,6 +621,9 @@ static void nvmap_dmabuf_end_cpu_access(struct dma_buf *dmabuf,
 	struct nvmap_handle_info *info = dmabuf->priv;
 
 	trace_nvmap_dmabuf_end_cpu_access(dmabuf, start, len);
+	/* A read only CPU access leaves nothing new to write back */
+	if (dir != DMA_FROM_DEVICE)
+		nvmap_handle_mkcpudirty(info->handle, start, len);
 	__nvmap_do_cache_maint(NULL, info->handle,
 				   start, start + len,
 				   NVMAP_CACHE_OP_WB, false);
@@ -453,6 +656,7 @@ static void *nvmap_dmabuf_kmap_atomic(struct dma_buf *dmabuf,
 int __nvmap_map(struct nvmap_handle *h, struct vm_area_struct *vma)
 {
 	struct nvmap_vma_priv *priv;
+	u64 lat_start = nvmap_stats_lat_start();
 
 	h = nvmap_handle_get(h);
 	if (!h)
@@ -482,12 +686,16 @@ int __nvmap_map(struct nvmap_handle *h, struct vm_area_struct *vma)
 
 	vma->vm_flags |= VM_SHARED | VM_DONTEXPAND |
 			  VM_DONTDUMP | VM_DONTCOPY |
-			  (h->heap_pgalloc ? 0 : VM_PFNMAP);
+			  (h->heap_pgalloc ? VM_MIXEDMAP : VM_PFNMAP);
 	vma->vm_ops = &nvmap_vma_ops;
 	BUG_ON(vma->vm_private_data != NULL);
 	vma->vm_private_data = priv;
 	vma->vm_page_prot = nvmap_pgprot(h, vma->vm_page_prot);
 	nvmap_vma_open(vma);
+	if (h->userflags & NVMAP_HANDLE_PREFAULT)
+		nvmap_vma_prefault(vma);
+	nvmap_stats_lat_end(NL_MMAP, h->heap_type, h->userflags >> 16,
+			    lat_start);
 	return 0;
 }
 
@@ -505,6 +713,8 @@ static void *nvmap_dmabuf_vmap(struct dma_buf *dmabuf)
 	struct nvmap_handle_info *info = dmabuf->priv;
 
 	trace_nvmap_dmabuf_vmap(dmabuf);
+	/* Writes through the kernel mapping can't be tracked */
+	info->handle->cpu_dirty_untracked = true;
 	return __nvmap_mmap(info->handle);
 }
 
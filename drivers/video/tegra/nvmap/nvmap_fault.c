@@ -17,6 +17,8 @@
 
 #include <trace/events/nvmap.h>
 #include <linux/highmem.h>
+#include <linux/log2.h>
+#include <linux/moduleparam.h>
 
 #include "nvmap_priv.h"
 
@@ -36,6 +38,20 @@ struct vm_operations_struct nvmap_vma_ops = {
 	.fixup_prot	= nvmap_fixup_prot,
 };
 
+/*
+ * Number of pages mapped in one go around a faulting address. Rounded down to
+ * a power of 2, 0 or 1 disables fault-around.
+ */
+static unsigned int nvmap_fault_around_pages = 16;
+module_param_named(fault_around_pages, nvmap_fault_around_pages, uint, 0644);
+
+/*
+ * Number of pages populated at once when a lazily allocated handle takes a
+ * fault on a hole. Rounded down to a power of 2.
+ */
+static unsigned int nvmap_lazy_chunk_pages = 16;
+module_param_named(lazy_chunk_pages, nvmap_lazy_chunk_pages, uint, 0644);
+
 int is_nvmap_vma(struct vm_area_struct *vma)
 {
 	return vma->vm_ops == &nvmap_vma_ops;
@@ -66,7 +82,8 @@ void nvmap_vma_open(struct vm_area_struct *vma)
 
 	mutex_lock(&h->lock);
 	vma_open_count = atomic_inc_return(&priv->count);
-	if (vma_open_count == 1 && h->heap_pgalloc) {
+	/* Lazy handles grow under the VMA, so they skip the mapcount trick. */
+	if (vma_open_count == 1 && h->heap_pgalloc && !h->pgalloc.lazy) {
 		nr_page = h->size >> PAGE_SHIFT;
 		for (i = 0; i < nr_page; i++) {
 			struct page *page = nvmap_to_page(h->pgalloc.pages[i]);
@@ -157,7 +174,7 @@ static void nvmap_vma_close(struct vm_area_struct *vma)
 	nvmap_umaps_dec(h);
 
 	if (__atomic_add_unless(&priv->count, -1, 0) == 1) {
-		if (h->heap_pgalloc) {
+		if (h->heap_pgalloc && !h->pgalloc.lazy) {
 			for (i = 0; i < nr_page; i++) {
 				struct page *page;
 				page = nvmap_to_page(h->pgalloc.pages[i]);
@@ -174,6 +191,93 @@ static void nvmap_vma_close(struct vm_area_struct *vma)
 	}
 }
 
+/*
+ * Pages can only be mapped ahead of the CPU touching them when nothing has to
+ * be done per page on first access - handles that track dirty pages for cache
+ * sync need to see every fault.
+ */
+static bool nvmap_handle_can_map_ahead(struct nvmap_handle *h)
+{
+	return h->alloc && h->heap_pgalloc &&
+		!atomic_read(&h->pgalloc.reserved) &&
+		!nvmap_handle_track_dirty(h);
+}
+
+/*
+ * Insert the handle pages backing [start, end) of the VMA, except for the one
+ * at @skip which the fault handler hands back to the core. Pages that are
+ * already mapped are left alone.
+ */
+static void nvmap_vma_insert_pages(struct vm_area_struct *vma,
+		struct nvmap_handle *h, unsigned long start, unsigned long end,
+		unsigned long skip)
+{
+	struct nvmap_vma_priv *priv = vma->vm_private_data;
+	bool mkdirty = (vma->vm_flags & VM_WRITE) &&
+			nvmap_handle_track_cpu_dirty(h);
+	unsigned long addr, offs;
+	struct page *page;
+
+	if (mkdirty)
+		mutex_lock(&h->lock);
+
+	for (addr = start; addr < end; addr += PAGE_SIZE) {
+		if (addr == skip)
+			continue;
+
+		offs = addr - vma->vm_start + priv->offs +
+			(vma->vm_pgoff << PAGE_SHIFT);
+		if (offs >= h->size)
+			break;
+
+		offs >>= PAGE_SHIFT;
+		page = nvmap_to_page(h->pgalloc.pages[offs]);
+		/* Don't populate lazy handles ahead of use */
+		if (!page || vm_insert_page(vma, addr, page))
+			continue;
+
+		/* Writes through this mapping won't fault */
+		if (mkdirty)
+			nvmap_page_mkcpudirty(&h->pgalloc.pages[offs]);
+	}
+
+	if (mkdirty)
+		mutex_unlock(&h->lock);
+}
+
+static void nvmap_vma_fault_around(struct vm_area_struct *vma,
+		struct nvmap_handle *h, unsigned long address)
+{
+	unsigned long nr = READ_ONCE(nvmap_fault_around_pages);
+	unsigned long start, end;
+
+	if (nr <= 1)
+		return;
+
+	nr = rounddown_pow_of_two(nr) << PAGE_SHIFT;
+	start = address & ~(nr - 1);
+	end = min(start + nr, vma->vm_end);
+	start = max(start, vma->vm_start);
+	nvmap_vma_insert_pages(vma, h, start, end, address & PAGE_MASK);
+}
+
+/*
+ * Map the whole VMA up front for handles allocated with NVMAP_HANDLE_PREFAULT
+ * so that a CPU pass over the buffer doesn't take a fault per window. Called
+ * from mmap with the mmap_sem held for write.
+ */
+void nvmap_vma_prefault(struct vm_area_struct *vma)
+{
+	struct nvmap_vma_priv *priv = vma->vm_private_data;
+
+	if (!priv || !priv->handle ||
+	    !nvmap_handle_can_map_ahead(priv->handle))
+		return;
+
+	nvmap_vma_insert_pages(vma, priv->handle, vma->vm_start, vma->vm_end,
+			       0);
+}
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
 static int nvmap_vma_fault(struct vm_fault *vmf)
 #else
@@ -220,10 +324,29 @@ static int nvmap_vma_fault(struct vm_area_struct *vma, struct vm_fault *vmf)
 		offs >>= PAGE_SHIFT;
 		if (atomic_read(&priv->handle->pgalloc.reserved))
 			return VM_FAULT_SIGBUS;
+		if (!nvmap_handle_populated(priv->handle)) {
+			u32 chunk = max(1U, READ_ONCE(nvmap_lazy_chunk_pages));
+
+			chunk = rounddown_pow_of_two(chunk);
+			if (nvmap_handle_populate(priv->handle,
+					round_down(offs, chunk), chunk))
+				return VM_FAULT_OOM;
+		}
 		page = nvmap_to_page(priv->handle->pgalloc.pages[offs]);
 
-		if (!nvmap_handle_track_dirty(priv->handle))
+		/* Writes through this mapping won't fault again */
+		if ((vma->vm_flags & VM_WRITE) &&
+		    nvmap_handle_track_cpu_dirty(priv->handle)) {
+			mutex_lock(&priv->handle->lock);
+			nvmap_page_mkcpudirty(&priv->handle->pgalloc.pages[offs]);
+			mutex_unlock(&priv->handle->lock);
+		}
+
+		if (!nvmap_handle_track_dirty(priv->handle)) {
+			nvmap_vma_fault_around(vma, priv->handle,
+					       (unsigned long)vmf_address);
 			goto finish;
+		}
 
 		mutex_lock(&priv->handle->lock);
 		if (nvmap_page_dirty(priv->handle->pgalloc.pages[offs])) {
@@ -278,7 +401,8 @@ static bool nvmap_fixup_prot(struct vm_area_struct *vma,
 
 	mutex_lock(&priv->handle->lock);
 	offs >>= PAGE_SHIFT;
-	if (nvmap_page_dirty(priv->handle->pgalloc.pages[offs]))
+	if (!priv->handle->pgalloc.pages[offs] ||
+	    nvmap_page_dirty(priv->handle->pgalloc.pages[offs]))
 		goto unlock;
 
 	page = nvmap_to_page(priv->handle->pgalloc.pages[offs]);
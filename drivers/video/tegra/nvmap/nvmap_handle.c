@@ -36,29 +36,37 @@
 #include "nvmap_ioctl.h"
 
 /*
- * Verifies that the passed ID is a valid handle ID. Then the passed client's
- * reference to the handle is returned.
+ * Returns the passed client's reference to the handle, if there is one.
  *
- * Note: to call this function make sure you own the client ref lock.
+ * Note: to call this function hold either the client ref lock or the RCU read
+ * lock. Without the ref lock the returned ref may be on its way out; only
+ * trust it after taking a dupe with atomic_inc_not_zero().
  */
-struct nvmap_handle_ref *__nvmap_validate_locked(struct nvmap_client *c,
-						 struct nvmap_handle *h)
+struct nvmap_handle_ref *__nvmap_validate_rcu(struct nvmap_client *c,
+					      struct nvmap_handle *h)
 {
-	struct rb_node *n = c->handle_refs.rb_node;
+	struct nvmap_handle_ref *ref;
 
-	while (n) {
-		struct nvmap_handle_ref *ref;
-		ref = rb_entry(n, struct nvmap_handle_ref, node);
+	hash_for_each_possible_rcu(c->handle_refs_hash, ref, hash_node,
+				   (unsigned long)h)
 		if (ref->handle == h)
 			return ref;
-		else if ((uintptr_t)h > (uintptr_t)ref->handle)
-			n = n->rb_right;
-		else
-			n = n->rb_left;
-	}
 
 	return NULL;
 }
+
+/*
+ * Verifies that the passed ID is a valid handle ID. Then the passed client's
+ * reference to the handle is returned.
+ *
+ * Note: to call this function make sure you own the client ref lock.
+ */
+struct nvmap_handle_ref *__nvmap_validate_locked(struct nvmap_client *c,
+						 struct nvmap_handle *h)
+{
+	lockdep_assert_held(&c->ref_lock);
+	return __nvmap_validate_rcu(c, h);
+}
 /* adds a newly-created handle to the device master tree */
 void nvmap_handle_add(struct nvmap_device *dev, struct nvmap_handle *h)
 {
@@ -151,6 +159,8 @@ static void add_handle_ref(struct nvmap_client *client,
 	}
 	rb_link_node(&ref->node, parent, p);
 	rb_insert_color(&ref->node, &client->handle_refs);
+	hash_add_rcu(client->handle_refs_hash, &ref->hash_node,
+		     (unsigned long)ref->handle);
 	client->handle_count++;
 	if (client->handle_count > nvmap_max_handle_count)
 		nvmap_max_handle_count = client->handle_count;
@@ -340,6 +350,20 @@ struct nvmap_handle_ref *nvmap_duplicate_handle(struct nvmap_client *client,
 		return ERR_PTR(-EINVAL);
 	}
 
+	/*
+	 * Fast path for handles the client already has: take another dupe
+	 * without serializing against the client's other threads. A ref
+	 * whose dupes already hit zero is being freed; fall back to the
+	 * locked path which will create a new one.
+	 */
+	rcu_read_lock();
+	ref = __nvmap_validate_rcu(client, h);
+	if (ref && atomic_inc_not_zero(&ref->dupes)) {
+		rcu_read_unlock();
+		goto out;
+	}
+	rcu_read_unlock();
+
 	nvmap_ref_lock(client);
 	ref = __nvmap_validate_locked(client, h);
 
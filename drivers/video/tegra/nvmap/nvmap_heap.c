@@ -30,6 +30,10 @@
 #include <linux/sizes.h>
 #include <linux/io.h>
 #include <linux/version.h>
+#include <linux/rbtree.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
+#include <linux/moduleparam.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
 #include <linux/sched/clock.h>
@@ -80,6 +84,256 @@ struct nvmap_heap {
 	int peer; /* Used only if is_ivm == true */
 	int vm_id; /* Used only if is_ivm == true */
 	struct nvmap_pm_ops pm_ops;
+	struct nvmap_buddy *buddy; /* NULL when the DMA API allocates */
+};
+
+/*
+ * Carveouts that nvmap declares for itself are handed out by a buddy
+ * allocator rather than the DMA coherent bitmap so that allocation cost
+ * doesn't grow with fragmentation. Blocks are naturally aligned on physical
+ * addresses which gives alignment for free. Allocations are rounded up to a
+ * power of 2 and the unused tail is immediately returned, so no memory is
+ * lost to rounding.
+ */
+#define NVMAP_BUDDY_NR_ORDERS	21	/* up to 4GB blocks with 4K pages */
+
+struct nvmap_buddy_block {
+	struct rb_node node;
+	phys_addr_t addr;
+};
+
+struct nvmap_buddy {
+	struct rb_root free[NVMAP_BUDDY_NR_ORDERS];
+	unsigned long nr_free[NVMAP_BUDDY_NR_ORDERS];
+	size_t free_bytes;
+	u64 alloc_fails;
+};
+
+static struct kmem_cache *buddy_block_cache;
+static bool nvmap_carveout_buddy = true;
+module_param_named(carveout_buddy, nvmap_carveout_buddy, bool, 0444);
+
+static inline size_t buddy_order_size(unsigned int order)
+{
+	return PAGE_SIZE << order;
+}
+
+static struct nvmap_buddy_block *buddy_find(struct nvmap_buddy *buddy,
+					    phys_addr_t addr,
+					    unsigned int order)
+{
+	struct rb_node *n = buddy->free[order].rb_node;
+
+	while (n) {
+		struct nvmap_buddy_block *b;
+
+		b = rb_entry(n, struct nvmap_buddy_block, node);
+		if (addr == b->addr)
+			return b;
+		if (addr > b->addr)
+			n = n->rb_right;
+		else
+			n = n->rb_left;
+	}
+	return NULL;
+}
+
+static void buddy_insert(struct nvmap_buddy *buddy,
+			 struct nvmap_buddy_block *block, unsigned int order)
+{
+	struct rb_node **p = &buddy->free[order].rb_node;
+	struct rb_node *parent = NULL;
+
+	while (*p) {
+		struct nvmap_buddy_block *b;
+
+		parent = *p;
+		b = rb_entry(parent, struct nvmap_buddy_block, node);
+		if (block->addr > b->addr)
+			p = &parent->rb_right;
+		else
+			p = &parent->rb_left;
+	}
+	rb_link_node(&block->node, parent, p);
+	rb_insert_color(&block->node, &buddy->free[order]);
+	buddy->nr_free[order]++;
+}
+
+static void buddy_erase(struct nvmap_buddy *buddy,
+			struct nvmap_buddy_block *block, unsigned int order)
+{
+	rb_erase(&block->node, &buddy->free[order]);
+	buddy->nr_free[order]--;
+}
+
+/*
+ * Free one naturally aligned block, merging it with its buddy as long as the
+ * buddy is free too. Block descriptors are tiny and freeing must not fail.
+ */
+static void buddy_free_block(struct nvmap_buddy *buddy, phys_addr_t addr,
+			     unsigned int order)
+{
+	struct nvmap_buddy_block *block, *b;
+
+	buddy->free_bytes += buddy_order_size(order);
+
+	block = NULL;
+	while (order < NVMAP_BUDDY_NR_ORDERS - 1) {
+		b = buddy_find(buddy, addr ^ buddy_order_size(order), order);
+		if (!b)
+			break;
+
+		buddy_erase(buddy, b, order);
+		addr = min(addr, b->addr);
+		if (block)
+			kmem_cache_free(buddy_block_cache, block);
+		block = b;
+		order++;
+	}
+
+	if (!block)
+		block = kmem_cache_alloc(buddy_block_cache,
+					 GFP_KERNEL | __GFP_NOFAIL);
+	block->addr = addr;
+	buddy_insert(buddy, block, order);
+}
+
+/* Free [addr, addr + len) by splitting it into naturally aligned blocks. */
+static void buddy_free_range(struct nvmap_buddy *buddy, phys_addr_t addr,
+			     size_t len)
+{
+	unsigned int order;
+
+	while (len) {
+		order = NVMAP_BUDDY_NR_ORDERS - 1;
+		if (addr)
+			order = min_t(unsigned int, __ffs64(addr) - PAGE_SHIFT,
+				      order);
+		while (buddy_order_size(order) > len)
+			order--;
+
+		buddy_free_block(buddy, addr, order);
+		addr += buddy_order_size(order);
+		len -= buddy_order_size(order);
+	}
+}
+
+static phys_addr_t buddy_alloc(struct nvmap_buddy *buddy, size_t len,
+			       size_t align)
+{
+	unsigned int order, o;
+	struct nvmap_buddy_block *block;
+	struct rb_node *n;
+	phys_addr_t addr;
+
+	len = PAGE_ALIGN(len);
+	order = order_base_2(len >> PAGE_SHIFT);
+	if (align > PAGE_SIZE)
+		order = max_t(unsigned int, order,
+			      order_base_2(align >> PAGE_SHIFT));
+
+	for (o = order; o < NVMAP_BUDDY_NR_ORDERS; o++)
+		if (buddy->nr_free[o])
+			break;
+
+	if (o >= NVMAP_BUDDY_NR_ORDERS) {
+		buddy->alloc_fails++;
+		return DMA_ERROR_CODE;
+	}
+
+	/* Lowest address first to keep the top of the carveout free. */
+	n = rb_first(&buddy->free[o]);
+	block = rb_entry(n, struct nvmap_buddy_block, node);
+	buddy_erase(buddy, block, o);
+	addr = block->addr;
+	kmem_cache_free(buddy_block_cache, block);
+	buddy->free_bytes -= buddy_order_size(o);
+
+	if (buddy_order_size(o) > len)
+		buddy_free_range(buddy, addr + len,
+				 buddy_order_size(o) - len);
+	return addr;
+}
+
+static void buddy_free(struct nvmap_buddy *buddy, phys_addr_t addr,
+		       size_t len)
+{
+	buddy_free_range(buddy, addr, PAGE_ALIGN(len));
+}
+
+static struct nvmap_buddy *buddy_create(phys_addr_t base, size_t len)
+{
+	struct nvmap_buddy *buddy;
+	phys_addr_t start = PAGE_ALIGN(base);
+	phys_addr_t end = (base + len) & PAGE_MASK;
+	unsigned int i;
+
+	if (end <= start)
+		return NULL;
+
+	buddy = kzalloc(sizeof(*buddy), GFP_KERNEL);
+	if (!buddy)
+		return NULL;
+
+	for (i = 0; i < NVMAP_BUDDY_NR_ORDERS; i++)
+		buddy->free[i] = RB_ROOT;
+	buddy_free_range(buddy, start, end - start);
+	return buddy;
+}
+
+static void buddy_destroy(struct nvmap_buddy *buddy)
+{
+	struct nvmap_buddy_block *block;
+	struct rb_node *n;
+	unsigned int i;
+
+	for (i = 0; i < NVMAP_BUDDY_NR_ORDERS; i++) {
+		while ((n = rb_first(&buddy->free[i]))) {
+			block = rb_entry(n, struct nvmap_buddy_block, node);
+			buddy_erase(buddy, block, i);
+			kmem_cache_free(buddy_block_cache, block);
+		}
+	}
+	kfree(buddy);
+}
+
+static int heap_fragmentation_show(struct seq_file *s, void *unused)
+{
+	struct nvmap_heap *heap = s->private;
+	struct nvmap_buddy *buddy = heap->buddy;
+	size_t largest = 0;
+	unsigned int i;
+
+	mutex_lock(&heap->lock);
+	seq_printf(s, "%-6s %10s %12s\n", "order", "block", "free blocks");
+	for (i = 0; i < NVMAP_BUDDY_NR_ORDERS; i++) {
+		if (!buddy->nr_free[i])
+			continue;
+		largest = buddy_order_size(i);
+		seq_printf(s, "%-6u %9zuK %12lu\n", i,
+			   buddy_order_size(i) >> 10, buddy->nr_free[i]);
+	}
+	seq_printf(s, "free: %zuK largest: %zuK\n",
+		   buddy->free_bytes >> 10, largest >> 10);
+	/* 0 when all free memory is one block, approaching 1000 when shredded */
+	seq_printf(s, "fragmentation: %zu/1000\n", buddy->free_bytes ?
+		   1000 - div64_u64((u64)largest * 1000, buddy->free_bytes) :
+		   0);
+	seq_printf(s, "failed allocations: %llu\n", buddy->alloc_fails);
+	mutex_unlock(&heap->lock);
+	return 0;
+}
+
+static int heap_fragmentation_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, heap_fragmentation_show, inode->i_private);
+}
+
+static const struct file_operations heap_fragmentation_fops = {
+	.open = heap_fragmentation_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
 };
 
 struct device *dma_dev_from_handle(unsigned long type)
@@ -128,15 +382,21 @@ void nvmap_heap_debugfs_init(struct dentry *heap_root, struct nvmap_heap *heap)
 	else
 		debugfs_create_x32("size", S_IRUGO,
 			heap_root, (u32 *)&heap->len);
+	if (heap->buddy)
+		debugfs_create_file("fragmentation", S_IRUGO, heap_root,
+				    heap, &heap_fragmentation_fops);
 }
 
 static phys_addr_t nvmap_alloc_mem(struct nvmap_heap *h, size_t len,
-				   phys_addr_t *start)
+				   size_t align, phys_addr_t *start)
 {
 	phys_addr_t pa;
 	DEFINE_DMA_ATTRS(attrs);
 	struct device *dev = h->dma_dev;
 
+	if (h->buddy)
+		return buddy_alloc(h->buddy, len, align);
+
 	dma_set_attr(DMA_ATTR_ALLOC_EXACT_SIZE, __DMA_ATTR(attrs));
 
 #ifdef CONFIG_TEGRA_VIRTUALIZATION
@@ -187,6 +447,10 @@ static void nvmap_free_mem(struct nvmap_heap *h, phys_addr_t base,
 
 	dma_set_attr(DMA_ATTR_ALLOC_EXACT_SIZE, __DMA_ATTR(attrs));
 	dev_dbg(dev, "Free base (%pa) size (%zu)\n", &base, len);
+	if (h->buddy) {
+		buddy_free(h->buddy, base, len);
+		return;
+	}
 #ifdef CONFIG_TEGRA_VIRTUALIZATION
 	if (h->is_ivm && !h->can_alloc) {
 		dma_mark_declared_memory_unoccupied(dev, base, len, __DMA_ATTR(attrs));
@@ -234,11 +498,13 @@ static struct nvmap_heap_block *do_heap_alloc(struct nvmap_heap *heap,
 		goto fail_heap_block_alloc;
 	}
 
-	dev_base = nvmap_alloc_mem(heap, len, start);
+	dev_base = nvmap_alloc_mem(heap, len, align, start);
 	if (dma_mapping_error(dev, dev_base)) {
 		dev_err(dev, "failed to alloc mem of size (%zu)\n",
 			len);
-		if (dma_is_coherent_dev(dev)) {
+		if (heap->buddy) {
+			dev_err(dev, "free:%zu\n", heap->buddy->free_bytes);
+		} else if (dma_is_coherent_dev(dev)) {
 			struct dma_coherent_stats stats;
 
 			dma_get_coherent_stats(dev, &stats);
@@ -452,6 +718,16 @@ struct nvmap_heap *nvmap_heap_create(struct device *parent,
 
 	INIT_LIST_HEAD(&h->all_list);
 	mutex_init(&h->lock);
+	/*
+	 * Only take over carveouts nvmap declared itself; CMA backed and IVM
+	 * heaps keep going through the DMA API.
+	 */
+	if (nvmap_carveout_buddy && !h->cma_dev && !h->is_ivm) {
+		h->buddy = buddy_create(base, len);
+		if (!h->buddy)
+			dev_warn(parent, "%s: no buddy allocator, using DMA API\n",
+				 co->name);
+	}
 	if (!co->no_cpu_access &&
 		nvmap_cache_maint_phys_range(NVMAP_CACHE_OP_WB_INV,
 				base, base + len, true, true)) {
@@ -485,6 +761,8 @@ void nvmap_heap_destroy(struct nvmap_heap *heap)
 		list_del(&l->all_list);
 		kmem_cache_free(heap_block_cache, l);
 	}
+	if (heap->buddy)
+		buddy_destroy(heap->buddy);
 	kfree(heap);
 }
 
@@ -497,6 +775,13 @@ int nvmap_heap_init(void)
 		pr_err("%s: unable to create heap block cache\n", __func__);
 		return -ENOMEM;
 	}
+	buddy_block_cache = KMEM_CACHE(nvmap_buddy_block, 0);
+	if (!buddy_block_cache) {
+		pr_err("%s: unable to create buddy block cache\n", __func__);
+		kmem_cache_destroy(heap_block_cache);
+		heap_block_cache = NULL;
+		return -ENOMEM;
+	}
 	pr_info("%s: created heap block cache\n", __func__);
 	nvmap_init_time += sched_clock() - start_time;
 	return 0;
@@ -508,6 +793,11 @@ void nvmap_heap_deinit(void)
 		kmem_cache_destroy(heap_block_cache);
 
 	heap_block_cache = NULL;
+
+	if (buddy_block_cache)
+		kmem_cache_destroy(buddy_block_cache);
+
+	buddy_block_cache = NULL;
 }
 
 /*
@@ -273,6 +273,123 @@ int nvmap_ioctl_create_from_va(struct file *filp, void __user *arg)
 			arg, &op, sizeof(op), 1,  ref->handle->dmabuf);
 }
 
+#define NVMAP_ALLOC_BATCH_MAX	1024
+
+struct nvmap_alloc_batch_slot {
+	struct nvmap_handle *handle;
+	int fd;
+};
+
+/*
+ * Create, allocate and export up to NVMAP_ALLOC_BATCH_MAX handles in one
+ * call. The entry array is copied in and out once and none of the fds are
+ * installed until every entry has succeeded, so the batch either completes
+ * as a whole or leaves nothing behind in the caller's fd table.
+ */
+int nvmap_ioctl_alloc_batch(struct file *filp, void __user *arg)
+{
+	struct nvmap_client *client = filp->private_data;
+	struct nvmap_alloc_batch_entry *entries;
+	struct nvmap_alloc_batch_slot *slots;
+	struct nvmap_alloc_batch op;
+	struct nvmap_handle_ref *ref;
+	size_t entries_size;
+	u32 i, done = 0;
+	int err = 0;
+
+	if (copy_from_user(&op, arg, sizeof(op)))
+		return -EFAULT;
+
+	if (!client)
+		return -ENODEV;
+
+	if (!op.nr || op.nr > NVMAP_ALLOC_BATCH_MAX || op.reserved)
+		return -EINVAL;
+
+	entries_size = sizeof(*entries) * op.nr;
+	entries = nvmap_altalloc(entries_size);
+	if (!entries)
+		return -ENOMEM;
+
+	slots = nvmap_altalloc(sizeof(*slots) * op.nr);
+	if (!slots) {
+		err = -ENOMEM;
+		goto free_entries;
+	}
+
+	if (copy_from_user(entries, (void __user *)(uintptr_t)op.entries,
+			   entries_size)) {
+		err = -EFAULT;
+		goto free_slots;
+	}
+
+	for (i = 0; i < op.nr; i++) {
+		if (!entries[i].size ||
+		    (entries[i].align & (entries[i].align - 1))) {
+			err = -EINVAL;
+			goto free_slots;
+		}
+	}
+
+	for (done = 0; done < op.nr; done++) {
+		struct nvmap_alloc_batch_entry *e = &entries[done];
+
+		ref = nvmap_create_handle(client, e->size);
+		if (IS_ERR(ref)) {
+			err = PTR_ERR(ref);
+			goto unwind;
+		}
+		ref->handle->orig_size = e->size;
+		slots[done].handle = ref->handle;
+		slots[done].fd = -1;
+
+		/* user-space handles are aligned to page boundaries, to
+		 * prevent data leakage. */
+		err = nvmap_alloc_handle(client, ref->handle, e->heap_mask,
+				max_t(size_t, e->align, PAGE_SIZE),
+				0, /* no kind */
+				e->flags & (~NVMAP_HANDLE_KIND_SPECIFIED),
+				NVMAP_IVM_INVALID_PEER);
+		if (err)
+			goto unwind_one;
+
+		slots[done].fd = nvmap_get_dmabuf_fd(client, ref->handle);
+		if (IS_ERR_VALUE((uintptr_t)slots[done].fd)) {
+			err = slots[done].fd;
+			slots[done].fd = -1;
+			goto unwind_one;
+		}
+		e->fd = slots[done].fd;
+	}
+
+	if (copy_to_user((void __user *)(uintptr_t)op.entries, entries,
+			 entries_size)) {
+		err = -EFAULT;
+		goto unwind;
+	}
+
+	for (i = 0; i < op.nr; i++)
+		fd_install(slots[i].fd, slots[i].handle->dmabuf->file);
+	goto free_slots;
+
+unwind_one:
+	/* Include the partially set up entry in the unwind below. */
+	done++;
+unwind:
+	for (i = 0; i < done; i++) {
+		if (slots[i].fd >= 0) {
+			put_unused_fd(slots[i].fd);
+			dma_buf_put(slots[i].handle->dmabuf);
+		}
+		nvmap_free_handle(client, slots[i].handle);
+	}
+free_slots:
+	nvmap_altfree(slots, sizeof(*slots) * op.nr);
+free_entries:
+	nvmap_altfree(entries, entries_size);
+	return err;
+}
+
 static int set_vpr_fail_data(void *user_addr, ulong user_stride,
 		       ulong elem_size, ulong count)
 {
@@ -43,6 +43,8 @@ int nvmap_ioctl_create(struct file *filp, unsigned int cmd, void __user *arg);
 
 int nvmap_ioctl_create_from_va(struct file *filp, void __user *arg);
 
+int nvmap_ioctl_alloc_batch(struct file *filp, void __user *arg);
+
 int nvmap_ioctl_create_from_ivc(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_get_ivc_heap(struct file *filp, void __user *arg);
@@ -57,6 +59,16 @@ int nvmap_ioctl_rw_handle(struct file *filp, int is_read, void __user *arg,
 int nvmap_ioctl_cache_maint_list(struct file *filp, void __user *arg,
 	bool is_rsrv_op);
 
+#ifdef CONFIG_NVMAP_CACHE_MAINT_ASYNC
+int nvmap_ioctl_cache_maint_list_async(struct file *filp, void __user *arg);
+#else
+static inline int nvmap_ioctl_cache_maint_list_async(struct file *filp,
+						     void __user *arg)
+{
+	return -ENOTTY;
+}
+#endif
+
 int nvmap_ioctl_gup_test(struct file *filp, void __user *arg);
 
 int nvmap_ioctl_set_tag_label(struct file *filp, void __user *arg);
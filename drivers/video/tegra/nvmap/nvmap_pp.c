@@ -26,6 +26,9 @@
 #include <linux/debugfs.h>
 #include <linux/freezer.h>
 #include <linux/highmem.h>
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/completion.h>
 #include <linux/version.h>
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
@@ -113,11 +116,347 @@ static inline struct page *get_page_list_page_bp(struct nvmap_page_pool *pool)
 	return page;
 }
 
+/*
+ * Take up to nr zeroed pages from this CPU's magazine. Only the CPU-local
+ * magazine lock is taken, so this never contends on the global pool lock.
+ */
+static u32 nvmap_pp_mag_alloc(struct nvmap_page_pool *pool,
+			      struct page **pages, u32 nr)
+{
+	struct nvmap_pp_magazine *mag;
+	u32 ind = 0;
+
+	if (!pool->mags)
+		return 0;
+
+	mag = get_cpu_ptr(pool->mags);
+	spin_lock(&mag->lock);
+	while (ind < nr && mag->nr_zeroed)
+		pages[ind++] = mag->zeroed[--mag->nr_zeroed];
+	spin_unlock(&mag->lock);
+	put_cpu_ptr(pool->mags);
+
+	return ind;
+}
+
+/*
+ * Stash a batch of zeroed pages, taken from the global pool, in this CPU's
+ * magazine. Returns the number of pages that did not fit; those are left at
+ * the start of the passed array.
+ */
+static u32 nvmap_pp_mag_refill(struct nvmap_page_pool *pool,
+			       struct page **pages, u32 nr)
+{
+	struct nvmap_pp_magazine *mag;
+
+	mag = get_cpu_ptr(pool->mags);
+	spin_lock(&mag->lock);
+	while (nr && mag->nr_zeroed < NVMAP_PP_MAG_SIZE)
+		mag->zeroed[mag->nr_zeroed++] = pages[--nr];
+	spin_unlock(&mag->lock);
+	put_cpu_ptr(pool->mags);
+
+	return nr;
+}
+
+/*
+ * Park freed pages in this CPU's magazine. Once the magazine is full, a batch
+ * of its pages is moved to flush[] so the caller can hand them to the zero
+ * list in one go. Returns the number of pages consumed from the passed array.
+ */
+static u32 nvmap_pp_mag_free(struct nvmap_page_pool *pool,
+			     struct page **pages, u32 nr,
+			     struct page **flush, u32 *nr_flush)
+{
+	struct nvmap_pp_magazine *mag;
+	u32 ind = 0;
+
+	*nr_flush = 0;
+	if (!pool->mags)
+		return 0;
+
+	mag = get_cpu_ptr(pool->mags);
+	spin_lock(&mag->lock);
+	while (ind < nr && mag->nr_dirty < NVMAP_PP_MAG_SIZE) {
+		/* See nvmap_page_pool_fill_lots() */
+		if (page_count(pages[ind]) > 1)
+			__free_page(pages[ind]);
+		else
+			mag->dirty[mag->nr_dirty++] = pages[ind];
+		ind++;
+	}
+	if (mag->nr_dirty == NVMAP_PP_MAG_SIZE) {
+		while (*nr_flush < NVMAP_PP_MAG_BATCH)
+			flush[(*nr_flush)++] = mag->dirty[--mag->nr_dirty];
+	}
+	spin_unlock(&mag->lock);
+	put_cpu_ptr(pool->mags);
+
+	return ind;
+}
+
+static ulong nvmap_pp_mag_count(struct nvmap_page_pool *pool)
+{
+	ulong total = 0;
+	int cpu;
+
+	if (!pool->mags)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct nvmap_pp_magazine *mag = per_cpu_ptr(pool->mags, cpu);
+
+		total += READ_ONCE(mag->nr_zeroed) + READ_ONCE(mag->nr_dirty);
+	}
+
+	return total;
+}
+
+static inline bool nvmap_pp_has_room(struct nvmap_page_pool *pool)
+{
+	return pool->count + pool->to_zero + pool->under_zero < pool->max;
+}
+
+/*
+ * Empty all per-CPU magazines back into the global pool: zeroed pages onto
+ * the page list and dirty pages onto the zero list, so that the regular
+ * accounting and release paths see them. Pages that no longer fit are freed.
+ *
+ * You must lock the page pool before using this.
+ */
+static void nvmap_pp_mag_drain_locked(struct nvmap_page_pool *pool)
+{
+	struct page *page;
+	int cpu;
+
+	if (!pool->mags)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct nvmap_pp_magazine *mag = per_cpu_ptr(pool->mags, cpu);
+
+		spin_lock(&mag->lock);
+		while (mag->nr_zeroed) {
+			page = mag->zeroed[--mag->nr_zeroed];
+			if (nvmap_pp_has_room(pool)) {
+				list_add_tail(&page->lru, &pool->page_list);
+				pool->count++;
+			} else {
+				__free_page(page);
+			}
+		}
+		while (mag->nr_dirty) {
+			page = mag->dirty[--mag->nr_dirty];
+			if (nvmap_pp_has_room(pool)) {
+				list_add_tail(&page->lru, &pool->zero_list);
+				pool->to_zero++;
+			} else {
+				__free_page(page);
+			}
+		}
+		spin_unlock(&mag->lock);
+	}
+
+	if (pool->to_zero)
+		wake_up_interruptible(&nvmap_bg_wait);
+}
+
+static inline struct page *get_page_list_page_hp(struct nvmap_page_pool *pool)
+{
+	struct page *page;
+
+	if (list_empty(&pool->page_list_hp))
+		return NULL;
+
+	page = list_first_entry(&pool->page_list_hp, struct page, lru);
+	list_del(&page->lru);
+
+	pool->huge_count -= pool->pages_per_huge_pg;
+
+	return page;
+}
+
+static inline struct page *get_zero_list_page_hp(struct nvmap_page_pool *pool)
+{
+	struct page *page;
+
+	if (list_empty(&pool->zero_list_hp))
+		return NULL;
+
+	page = list_first_entry(&pool->zero_list_hp, struct page, lru);
+	list_del(&page->lru);
+
+	pool->huge_to_zero -= pool->pages_per_huge_pg;
+
+	return page;
+}
+
+static inline bool nvmap_pp_huge_has_room(struct nvmap_page_pool *pool)
+{
+	return pool->huge_count + pool->huge_to_zero + pool->huge_under_zero +
+		pool->pages_per_huge_pg <= pool->huge_max;
+}
+
+static inline bool nvmap_pp_huge_needs_fill(struct nvmap_page_pool *pool)
+{
+	return enable_pp && !pool->huge_fill_paused &&
+		nvmap_pp_huge_has_room(pool);
+}
+
 static inline bool nvmap_bg_should_run(struct nvmap_page_pool *pool)
 {
-	return !list_empty(&pool->zero_list);
+	return !list_empty(&pool->zero_list) ||
+		!list_empty(&pool->zero_list_hp) ||
+		nvmap_pp_huge_needs_fill(pool);
+}
+
+#ifdef CONFIG_NVMAP_PP_DMA_ZERO
+/*
+ * Optionally hand page zeroing to a memset capable DMA engine (GPC DMA on
+ * T186/T194) so that refilling the pool doesn't cost CPU time and doesn't
+ * drag the pages through the CPU caches. Only the background thread uses the
+ * channel; if none can be had, or a job fails, the CPU zeroes the pages.
+ */
+#define NVMAP_PP_DMA_ZERO_TIMEOUT_MS	1000
+
+static bool pp_dma_zero;
+module_param_named(dma_zero, pp_dma_zero, bool, 0644);
+
+static struct dma_chan *pp_dma_chan;
+static unsigned long pp_dma_chan_retry;
+static dma_addr_t pp_dma_addrs[PENDING_PAGES_SIZE];
+static u64 pp_dma_zeroed, pp_dma_fallbacks;
+
+static struct dma_chan *nvmap_pp_dma_zero_chan(void)
+{
+	dma_cap_mask_t mask;
+	struct dma_chan *chan;
+
+	if (!pp_dma_zero) {
+		if (pp_dma_chan) {
+			dma_release_channel(pp_dma_chan);
+			pp_dma_chan = NULL;
+		}
+		return NULL;
+	}
+
+	if (pp_dma_chan)
+		return pp_dma_chan;
+
+	/* Channels are shared with everybody else; don't keep asking. */
+	if (time_before(jiffies, pp_dma_chan_retry))
+		return NULL;
+
+	dma_cap_zero(mask);
+	dma_cap_set(DMA_MEMSET, mask);
+	chan = dma_request_chan_by_mask(&mask);
+	if (IS_ERR(chan)) {
+		pp_dma_chan_retry = jiffies + HZ;
+		return NULL;
+	}
+
+	pp_dma_chan = chan;
+	return chan;
+}
+
+static void nvmap_pp_dma_zero_done(void *arg)
+{
+	complete(arg);
 }
 
+/*
+ * Zero nr chunks of size bytes each, one per page in pages, and leave them
+ * clean in the CPU caches. Physically adjacent chunks go out as one memset.
+ * Returns false, having done nothing useful, if the CPU has to do it.
+ */
+static bool nvmap_pp_dma_zero_pages(struct page **pages, int nr, size_t size)
+{
+	DECLARE_COMPLETION_ONSTACK(done);
+	struct dma_async_tx_descriptor *tx;
+	struct dma_chan *chan;
+	struct device *dev;
+	int i, j, mapped = 0;
+	bool ok = false;
+
+	if (!nr)
+		return true;
+
+	chan = nvmap_pp_dma_zero_chan();
+	if (!chan)
+		return false;
+	dev = chan->device->dev;
+
+	/*
+	 * Mapping for DMA_FROM_DEVICE invalidates whatever the previous owner
+	 * left in the caches and unmapping does so again after the engine is
+	 * done, which is as clean as the CPU path leaves things.
+	 */
+	for (i = 0; i < nr; i++) {
+		pp_dma_addrs[i] = dma_map_page(dev, pages[i], 0, size,
+					       DMA_FROM_DEVICE);
+		if (dma_mapping_error(dev, pp_dma_addrs[i]))
+			goto unmap;
+		mapped++;
+	}
+
+	for (i = 0; i < nr; i = j) {
+		size_t len = size;
+
+		for (j = i + 1; j < nr &&
+		     pp_dma_addrs[j] == pp_dma_addrs[i] + len; j++)
+			len += size;
+
+		tx = dmaengine_prep_dma_memset(chan, pp_dma_addrs[i], 0, len,
+					       DMA_PREP_INTERRUPT |
+					       DMA_CTRL_ACK);
+		if (!tx)
+			goto terminate;
+		if (j == nr) {
+			tx->callback = nvmap_pp_dma_zero_done;
+			tx->callback_param = &done;
+		}
+		if (dma_submit_error(dmaengine_submit(tx)))
+			goto terminate;
+	}
+
+	dma_async_issue_pending(chan);
+	ok = wait_for_completion_timeout(&done,
+			msecs_to_jiffies(NVMAP_PP_DMA_ZERO_TIMEOUT_MS));
+
+terminate:
+	if (!ok)
+		dmaengine_terminate_all(chan);
+unmap:
+	for (i = 0; i < mapped; i++)
+		dma_unmap_page(dev, pp_dma_addrs[i], size, DMA_FROM_DEVICE);
+
+	if (ok) {
+		pp_dma_zeroed += nr * (size >> PAGE_SHIFT);
+		trace_nvmap_pp_zero_pages(nr * (size >> PAGE_SHIFT));
+	} else {
+		pp_dma_fallbacks++;
+	}
+	return ok;
+}
+
+static void nvmap_pp_dma_zero_fini(void)
+{
+	if (pp_dma_chan)
+		dma_release_channel(pp_dma_chan);
+	pp_dma_chan = NULL;
+}
+#else
+static inline bool nvmap_pp_dma_zero_pages(struct page **pages, int nr,
+					   size_t size)
+{
+	return false;
+}
+
+static inline void nvmap_pp_dma_zero_fini(void)
+{
+}
+#endif
+
 static void nvmap_pp_zero_pages(struct page **pages, int nr)
 {
 	int i;
@@ -151,7 +490,8 @@ static void nvmap_pp_do_background_zero_pages(struct nvmap_page_pool *pool)
 	}
 	rt_mutex_unlock(&pool->lock);
 
-	nvmap_pp_zero_pages(pending_zero_pages, i);
+	if (!nvmap_pp_dma_zero_pages(pending_zero_pages, i, PAGE_SIZE))
+		nvmap_pp_zero_pages(pending_zero_pages, i);
 
 	rt_mutex_lock(&pool->lock);
 	ret = __nvmap_page_pool_fill_lots_locked(pool, pending_zero_pages, i);
@@ -164,6 +504,81 @@ static void nvmap_pp_do_background_zero_pages(struct nvmap_page_pool *pool)
 		__free_page(pending_zero_pages[ret]);
 }
 
+static struct page *nvmap_pp_alloc_huge_page(struct nvmap_page_pool *pool)
+{
+	/*
+	 * Huge pages are opportunistic; don't reclaim or dip into emergency
+	 * reserves for them.
+	 */
+	gfp_t gfp = (GFP_NVMAP | __GFP_NOMEMALLOC | __GFP_NORETRY) &
+		    ~__GFP_RECLAIM;
+	unsigned int order = get_order(pool->huge_pg_sz);
+	struct page *page;
+
+	page = alloc_pages(gfp, order);
+	if (!page)
+		return NULL;
+
+	split_page(page, order);
+	return page;
+}
+
+static void nvmap_pp_zero_huge_page(struct nvmap_page_pool *pool,
+				    struct page *page)
+{
+	int i;
+
+	if (nvmap_pp_dma_zero_pages(&page, 1, pool->huge_pg_sz))
+		return;
+
+	for (i = 0; i < pool->pages_per_huge_pg; i++) {
+		clear_highpage(nth_page(page, i));
+		nvmap_clean_cache_page(nth_page(page, i));
+	}
+
+	trace_nvmap_pp_zero_pages(pool->pages_per_huge_pg);
+}
+
+/*
+ * Zero one huge page off the huge page zero list or, if there is none and
+ * the huge page tier is below its target, allocate a fresh one.
+ */
+static void nvmap_pp_do_background_huge_pages(struct nvmap_page_pool *pool)
+{
+	struct page *page;
+	bool fill;
+	int i;
+
+	rt_mutex_lock(&pool->lock);
+	page = get_zero_list_page_hp(pool);
+	fill = !page && nvmap_pp_huge_needs_fill(pool);
+	pool->huge_under_zero += pool->pages_per_huge_pg;
+	rt_mutex_unlock(&pool->lock);
+
+	if (fill)
+		page = nvmap_pp_alloc_huge_page(pool);
+	if (page)
+		nvmap_pp_zero_huge_page(pool, page);
+
+	rt_mutex_lock(&pool->lock);
+	pool->huge_under_zero -= pool->pages_per_huge_pg;
+	if (!page) {
+		/* Memory is too fragmented; retry once huge pages get used */
+		if (fill)
+			pool->huge_fill_paused = true;
+	} else if (enable_pp && nvmap_pp_huge_has_room(pool)) {
+		list_add_tail(&page->lru, &pool->page_list_hp);
+		pool->huge_count += pool->pages_per_huge_pg;
+		page = NULL;
+	}
+	rt_mutex_unlock(&pool->lock);
+
+	if (page) {
+		for (i = 0; i < pool->pages_per_huge_pg; i++)
+			__free_page(nth_page(page, i));
+	}
+}
+
 /*
  * This thread fills the page pools with zeroed pages. We avoid releasing the
  * pages directly back into the page pools since we would then have to zero
@@ -183,8 +598,12 @@ static int nvmap_background_zero_thread(void *arg)
 	sched_setscheduler(current, SCHED_IDLE, &param);
 
 	while (!kthread_should_stop()) {
-		while (nvmap_bg_should_run(pool))
-			nvmap_pp_do_background_zero_pages(pool);
+		while (nvmap_bg_should_run(pool)) {
+			if (!list_empty(&pool->zero_list))
+				nvmap_pp_do_background_zero_pages(pool);
+			else
+				nvmap_pp_do_background_huge_pages(pool);
+		}
 
 		wait_event_freezable(nvmap_bg_wait,
 				nvmap_bg_should_run(pool) ||
@@ -206,6 +625,33 @@ static void nvmap_pgcount(struct page *page, bool incr)
 #endif
 }
 
+/*
+ * Free the passed number of pages from the huge page tier. Once the tier has
+ * been shrunk, background refill is paused until huge pages get used again.
+ */
+static ulong nvmap_pp_free_huge_pages_locked(struct nvmap_page_pool *pool,
+					     ulong nr_pages)
+{
+	struct page *page;
+	int i;
+
+	while (nr_pages) {
+		page = get_zero_list_page_hp(pool);
+		if (!page)
+			page = get_page_list_page_hp(pool);
+		if (!page)
+			break;
+
+		for (i = 0; i < pool->pages_per_huge_pg; i++)
+			__free_page(nth_page(page, i));
+		pr_debug("released %d pages\n", pool->pages_per_huge_pg);
+		nr_pages -= min_t(ulong, nr_pages, pool->pages_per_huge_pg);
+		pool->huge_fill_paused = true;
+	}
+
+	return nr_pages;
+}
+
 /*
  * Free the passed number of pages from the page pool. This happens regardless
  * of whether the page pools are enabled. This lets one disable the page pools
@@ -258,6 +704,8 @@ static ulong nvmap_page_pool_free_pages_locked(struct nvmap_page_pool *pool,
 		}
 	}
 
+	nr_pages = nvmap_pp_free_huge_pages_locked(pool, nr_pages);
+
 	pr_debug("remaining pages to release=%ld\n", nr_pages);
 	return nr_pages;
 }
@@ -270,6 +718,8 @@ static ulong nvmap_page_pool_free_pages_locked(struct nvmap_page_pool *pool,
 int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 				struct page **pages, u32 nr)
 {
+	struct page *refill[NVMAP_PP_MAG_BATCH];
+	u32 nr_refill = 0;
 	u32 ind = 0;
 	u32 non_zero_idx;
 	u32 non_zero_cnt = 0;
@@ -277,6 +727,18 @@ int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 	if (!enable_pp || !nr)
 		return 0;
 
+	ind = nvmap_pp_mag_alloc(pool, pages, nr);
+	if (IS_ENABLED(CONFIG_NVMAP_PAGE_POOL_DEBUG)) {
+		u32 i;
+
+		for (i = 0; i < ind; i++) {
+			nvmap_pgcount(pages[i], false);
+			BUG_ON(page_count(pages[i]) != 1);
+		}
+	}
+	if (ind == nr)
+		goto out;
+
 	rt_mutex_lock(&pool->lock);
 
 	while (ind < nr) {
@@ -301,12 +763,41 @@ int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 		}
 	}
 
+	/*
+	 * This CPU's magazine ran dry. Grab a batch of zeroed pages for it
+	 * while the pool lock is held anyway.
+	 */
+	if (ind == nr && pool->mags) {
+		while (nr_refill < NVMAP_PP_MAG_BATCH) {
+			struct page *page = get_page_list_page(pool);
+
+			if (!page)
+				break;
+			refill[nr_refill++] = page;
+		}
+	}
+
 	rt_mutex_unlock(&pool->lock);
 
+	if (nr_refill) {
+		nr_refill = nvmap_pp_mag_refill(pool, refill, nr_refill);
+		if (nr_refill) {
+			/* Lost a race against another refill; give them back */
+			rt_mutex_lock(&pool->lock);
+			while (nr_refill) {
+				list_add(&refill[--nr_refill]->lru,
+					 &pool->page_list);
+				pool->count++;
+			}
+			rt_mutex_unlock(&pool->lock);
+		}
+	}
+
 	/* Zero non-zeroed pages, if any */
 	if (non_zero_cnt)
 		nvmap_pp_zero_pages(&pages[non_zero_idx], non_zero_cnt);
 
+out:
 	pp_alloc_add(pool, ind);
 	pp_hit_add(pool, ind);
 	pp_miss_add(pool, nr - ind);
@@ -345,6 +836,100 @@ int nvmap_page_pool_alloc_lots_bp(struct nvmap_page_pool *pool,
 	return ind;
 }
 
+int nvmap_page_pool_alloc_lots_hp(struct nvmap_page_pool *pool,
+				struct page **pages, u32 nr)
+{
+	u32 ind = 0;
+	struct page *page;
+
+	if (!enable_pp || !pool->huge_max || nr < pool->pages_per_huge_pg)
+		return 0;
+
+	rt_mutex_lock(&pool->lock);
+
+	while (nr - ind >= pool->pages_per_huge_pg) {
+		int i;
+
+		page = get_page_list_page_hp(pool);
+		if (!page)
+			break;
+
+		for (i = 0; i < pool->pages_per_huge_pg; i++)
+			pages[ind + i] = nth_page(page, i);
+
+		ind += pool->pages_per_huge_pg;
+	}
+
+	if (ind) {
+		pool->huge_fill_paused = false;
+		wake_up_interruptible(&nvmap_bg_wait);
+	}
+
+	rt_mutex_unlock(&pool->lock);
+	return ind;
+}
+
+static bool nvmap_is_huge_page(struct nvmap_page_pool *pool,
+			       struct page **pages, u32 idx, u32 nr)
+{
+	int i;
+	struct page *page = pages[idx];
+
+	if (nr - idx < pool->pages_per_huge_pg)
+		return false;
+
+	if (page_to_phys(page) & (pool->huge_pg_sz - 1))
+		return false;
+
+	/* See nvmap_page_pool_fill_lots() for why shared pages are skipped */
+	for (i = 0; i < pool->pages_per_huge_pg; i++)
+		if (pages[idx + i] != nth_page(page, i) ||
+		    page_count(pages[idx + i]) > 1)
+			break;
+
+	return i == pool->pages_per_huge_pg;
+}
+
+/*
+ * Move every huge page aligned, physically contiguous run of pages in the
+ * passed array onto the huge page zero list. The runs taken are swapped to
+ * the start of the array; returns the number of pages taken.
+ */
+static u32 nvmap_pp_fill_huge(struct nvmap_page_pool *pool,
+			      struct page **pages, u32 nr)
+{
+	u32 n = pool->pages_per_huge_pg;
+	u32 taken = 0;
+	u32 i = 0, k;
+
+	if (!enable_pp || !pool->huge_max || nr < n)
+		return 0;
+
+	rt_mutex_lock(&pool->lock);
+
+	while (i + n <= nr && nvmap_pp_huge_has_room(pool)) {
+		if (!nvmap_is_huge_page(pool, pages, i, nr)) {
+			i++;
+			continue;
+		}
+
+		for (k = 0; k < n; k++)
+			swap(pages[taken + k], pages[i + k]);
+
+		list_add_tail(&pages[taken]->lru, &pool->zero_list_hp);
+		pool->huge_to_zero += n;
+		taken += n;
+		i += n;
+	}
+
+	if (taken)
+		wake_up_interruptible(&nvmap_bg_wait);
+
+	rt_mutex_unlock(&pool->lock);
+
+	return taken;
+}
+
 static bool nvmap_is_big_page(struct nvmap_page_pool *pool,
 			      struct page **pages, int idx, int nr)
 {
@@ -413,16 +998,20 @@ static int __nvmap_page_pool_fill_lots_locked(struct nvmap_page_pool *pool,
 	return ind;
 }
 
-int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
-				       struct page **pages, u32 nr)
+/*
+ * Add freed pages to the zero list for the background thread to zero. Returns
+ * the number of pages consumed from the passed array.
+ *
+ * You must lock the page pool before using this.
+ */
+static int __nvmap_page_pool_fill_zero_locked(struct nvmap_page_pool *pool,
+					      struct page **pages, u32 nr)
 {
-	int ret = 0;
+	int ret;
 	int i;
-	u32 save_to_zero;
 
-	rt_mutex_lock(&pool->lock);
-
-	save_to_zero = pool->to_zero;
+	if (!nvmap_pp_has_room(pool))
+		return 0;
 
 	ret = min(nr, pool->max - pool->count - pool->to_zero - pool->under_zero);
 
@@ -440,9 +1029,40 @@ int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
 		}
 	}
 
+	return i;
+}
+
+static int __nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
+				       struct page **pages, u32 nr)
+{
+	struct page *flush[NVMAP_PP_MAG_BATCH];
+	u32 nr_flush = 0;
+	u32 ind = 0;
+	int ret = 0;
+	u32 save_to_zero;
+
+	if (enable_pp) {
+		ind = nvmap_pp_mag_free(pool, pages, nr, flush, &nr_flush);
+		if (ind == nr && !nr_flush)
+			return nr;
+	}
+
+	rt_mutex_lock(&pool->lock);
+
+	save_to_zero = pool->to_zero;
+
+	if (nr_flush) {
+		ret = __nvmap_page_pool_fill_zero_locked(pool, flush,
+							 nr_flush);
+		for (; ret < nr_flush; ret++)
+			__free_page(flush[ret]);
+	}
+
+	ret = __nvmap_page_pool_fill_zero_locked(pool, &pages[ind], nr - ind);
+
 	if (pool->to_zero)
 		wake_up_interruptible(&nvmap_bg_wait);
-	ret = i;
+	ret += ind;
 
 	trace_nvmap_pp_fill_zero_lots(save_to_zero, pool->to_zero,
 			ret, nr);
@@ -452,6 +1072,18 @@ int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
 	return ret;
 }
 
+int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
+				       struct page **pages, u32 nr)
+{
+	u32 huge;
+
+	/* Huge pages go back to their own tier as a whole */
+	huge = nvmap_pp_fill_huge(pool, pages, nr);
+
+	return huge + __nvmap_page_pool_fill_lots(pool, &pages[huge],
+						  nr - huge);
+}
+
 ulong nvmap_page_pool_get_unused_pages(void)
 {
 	int total = 0;
@@ -459,7 +1091,9 @@ ulong nvmap_page_pool_get_unused_pages(void)
 	if (!nvmap_dev)
 		return 0;
 
-	total = nvmap_dev->pool.count + nvmap_dev->pool.to_zero;
+	total = nvmap_dev->pool.count + nvmap_dev->pool.to_zero +
+		nvmap_dev->pool.huge_count + nvmap_dev->pool.huge_to_zero +
+		nvmap_pp_mag_count(&nvmap_dev->pool);
 
 	return total;
 }
@@ -474,10 +1108,14 @@ int nvmap_page_pool_clear(void)
 
 	rt_mutex_lock(&pool->lock);
 
-	(void)nvmap_page_pool_free_pages_locked(pool, pool->count + pool->to_zero);
+	nvmap_pp_mag_drain_locked(pool);
+	(void)nvmap_page_pool_free_pages_locked(pool, pool->count +
+			pool->to_zero + pool->huge_count + pool->huge_to_zero);
 
 	/* For some reason, if an error occured... */
-	if (!list_empty(&pool->page_list) || !list_empty(&pool->zero_list)) {
+	if (!list_empty(&pool->page_list) || !list_empty(&pool->zero_list) ||
+	    !list_empty(&pool->page_list_hp) ||
+	    !list_empty(&pool->zero_list_hp)) {
 		rt_mutex_unlock(&pool->lock);
 		return -ENOMEM;
 	}
@@ -498,7 +1136,9 @@ static void nvmap_page_pool_resize(struct nvmap_page_pool *pool, u32 size)
 
 	rt_mutex_lock(&pool->lock);
 
-	curr = nvmap_page_pool_get_unused_pages();
+	nvmap_pp_mag_drain_locked(pool);
+	/* The huge page tier is sized separately, see huge_pool_size */
+	curr = pool->count + pool->to_zero;
 	if (curr > size)
 		(void)nvmap_page_pool_free_pages_locked(pool, curr - size);
 
@@ -522,6 +1162,7 @@ static unsigned long nvmap_page_pool_scan_objects(struct shrinker *shrinker,
 	pr_debug("sh_pages=%lu", sc->nr_to_scan);
 
 	rt_mutex_lock(&nvmap_dev->pool.lock);
+	nvmap_pp_mag_drain_locked(&nvmap_dev->pool);
 	remaining = nvmap_page_pool_free_pages_locked(
 			&nvmap_dev->pool, sc->nr_to_scan);
 	rt_mutex_unlock(&nvmap_dev->pool.lock);
@@ -633,6 +1274,46 @@ static struct kernel_param_ops pool_size_ops = {
 
 module_param_cb(pool_size, &pool_size_ops, &pool_size, 0644);
 
+static u32 huge_pool_size;
+
+static int huge_pool_size_set(const char *arg, const struct kernel_param *kp)
+{
+	struct nvmap_page_pool *pool = &nvmap_dev->pool;
+	u32 curr;
+	int ret;
+
+	ret = param_set_uint(arg, kp);
+	if (ret)
+		return ret;
+
+	rt_mutex_lock(&pool->lock);
+	curr = pool->huge_count + pool->huge_to_zero;
+	if (curr > huge_pool_size)
+		(void)nvmap_pp_free_huge_pages_locked(pool,
+						      curr - huge_pool_size);
+	pr_debug("huge page pool resized to %d from %d pages\n",
+		 huge_pool_size, pool->huge_max);
+	pool->huge_max = huge_pool_size;
+	pool->huge_fill_paused = false;
+	rt_mutex_unlock(&pool->lock);
+
+	wake_up_interruptible(&nvmap_bg_wait);
+
+	return 0;
+}
+
+static int huge_pool_size_get(char *buff, const struct kernel_param *kp)
+{
+	return param_get_uint(buff, kp);
+}
+
+static struct kernel_param_ops huge_pool_size_ops = {
+	.get = huge_pool_size_get,
+	.set = huge_pool_size_set,
+};
+
+module_param_cb(huge_pool_size, &huge_pool_size_ops, &huge_pool_size, 0644);
+
 int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root)
 {
 	struct dentry *pp_root;
@@ -656,12 +1337,32 @@ int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root)
 	debugfs_create_u32("page_pool_big_page_size",
 			   S_IRUGO, pp_root,
 			   &nvmap_dev->pool.big_pg_sz);
+	debugfs_create_u32("page_pool_available_huge_pages",
+			   S_IRUGO, pp_root,
+			   &nvmap_dev->pool.huge_count);
+	debugfs_create_u32("page_pool_huge_pages_to_zero",
+			   S_IRUGO, pp_root,
+			   &nvmap_dev->pool.huge_to_zero);
+	debugfs_create_u32("page_pool_huge_page_size",
+			   S_IRUGO, pp_root,
+			   &nvmap_dev->pool.huge_pg_sz);
+	debugfs_create_u64("total_huge_page_allocs",
+			   S_IRUGO, pp_root,
+			   &nvmap_huge_page_allocs);
 	debugfs_create_u64("total_big_page_allocs",
 			   S_IRUGO, pp_root,
 			   &nvmap_big_page_allocs);
 	debugfs_create_u64("total_page_allocs",
 			   S_IRUGO, pp_root,
 			   &nvmap_total_page_allocs);
+#ifdef CONFIG_NVMAP_PP_DMA_ZERO
+	debugfs_create_u64("dma_zeroed_pages",
+			   S_IRUGO, pp_root,
+			   &pp_dma_zeroed);
+	debugfs_create_u64("dma_zero_fallbacks",
+			   S_IRUGO, pp_root,
+			   &pp_dma_fallbacks);
+#endif
 
 #ifdef CONFIG_NVMAP_PAGE_POOL_DEBUG
 	debugfs_create_u64("page_pool_allocs",
@@ -685,15 +1386,29 @@ int nvmap_page_pool_init(struct nvmap_device *dev)
 {
 	struct sysinfo info;
 	struct nvmap_page_pool *pool = &dev->pool;
+	int cpu;
 
 	memset(pool, 0x0, sizeof(*pool));
 	rt_mutex_init(&pool->lock);
 	INIT_LIST_HEAD(&pool->page_list);
 	INIT_LIST_HEAD(&pool->zero_list);
 	INIT_LIST_HEAD(&pool->page_list_bp);
+	INIT_LIST_HEAD(&pool->page_list_hp);
+	INIT_LIST_HEAD(&pool->zero_list_hp);
+
+	/* Without magazines every request simply goes to the global pool */
+	pool->mags = alloc_percpu(struct nvmap_pp_magazine);
+	if (pool->mags) {
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(pool->mags, cpu)->lock);
+	} else {
+		pr_warn("per-CPU page pool magazines unavailable\n");
+	}
 
 	pool->big_pg_sz = NVMAP_PP_BIG_PAGE_SIZE;
 	pool->pages_per_big_pg = NVMAP_PP_BIG_PAGE_SIZE >> PAGE_SHIFT;
+	pool->huge_pg_sz = NVMAP_PP_HUGE_PAGE_SIZE;
+	pool->pages_per_huge_pg = NVMAP_PP_HUGE_PAGE_SIZE >> PAGE_SHIFT;
 
 	si_meminfo(&info);
 	pr_info("Total RAM pages: %lu\n", info.totalram);
@@ -709,6 +1424,10 @@ int nvmap_page_pool_init(struct nvmap_device *dev)
 		goto fail;
 	pool_size = pool->max;
 
+	pool->huge_max = rounddown((pool->max * NVMAP_PP_HUGE_POOL_SIZE) >> 10,
+				   pool->pages_per_huge_pg);
+	huge_pool_size = pool->huge_max;
+
 	pr_info("nvmap page pool size: %u pages (%u MB)\n", pool->max,
 		(pool->max * info.mem_unit) >> 20);
 
@@ -738,6 +1457,15 @@ int nvmap_page_pool_fini(struct nvmap_device *dev)
 		unregister_shrinker(&nvmap_page_pool_shrinker);
 		kthread_stop(background_allocator);
 	}
+	nvmap_pp_dma_zero_fini();
+
+	if (pool->mags) {
+		rt_mutex_lock(&pool->lock);
+		nvmap_pp_mag_drain_locked(pool);
+		rt_mutex_unlock(&pool->lock);
+		free_percpu(pool->mags);
+		pool->mags = NULL;
+	}
 
 	WARN_ON(!list_empty(&pool->page_list));
 
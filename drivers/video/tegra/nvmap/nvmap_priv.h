@@ -23,6 +23,8 @@
 #include <linux/mutex.h>
 #include <linux/rtmutex.h>
 #include <linux/rbtree.h>
+#include <linux/hashtable.h>
+#include <linux/rcupdate.h>
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/atomic.h>
@@ -86,6 +88,7 @@ void _nvmap_handle_free(struct nvmap_handle *h);
 /* holds max number of handles allocted per process at any time */
 extern u32 nvmap_max_handle_count;
 extern u64 nvmap_big_page_allocs;
+extern u64 nvmap_huge_page_allocs;
 extern u64 nvmap_total_page_allocs;
 
 extern bool nvmap_convert_iovmm_to_carveout;
@@ -131,6 +134,8 @@ struct nvmap_pgalloc {
 	bool contig;			/* contiguous system memory */
 	atomic_t reserved;
 	atomic_t ndirty;	/* count number of dirty pages */
+	bool lazy;		/* pages are populated on first touch */
+	u32 nr_populated;	/* populated pages of a lazy handle */
 };
 
 /* bit 31-29: IVM peer
@@ -172,6 +177,7 @@ struct nvmap_handle {
 	bool heap_pgalloc;	/* handle is page allocated (sysmem / iovmm) */
 	bool alloc;		/* handle has memory allocated */
 	bool from_va;		/* handle memory is from VA */
+	bool cpu_dirty_untracked; /* kernel mapping may dirty any page */
 	u32 heap_type;		/* handle heap is allocated from */
 	u32 userflags;		/* flags passed from userspace */
 	void *vaddr;		/* mapping used inside kernel */
@@ -205,6 +211,8 @@ struct nvmap_tag_entry {
 struct nvmap_handle_ref {
 	struct nvmap_handle *handle;
 	struct rb_node	node;
+	struct hlist_node hash_node;	/* client's RCU lookup index */
+	struct rcu_head	rcu;
 	atomic_t	dupes;	/* number of times to free on file close */
 };
 
@@ -219,6 +227,31 @@ struct nvmap_handle_ref {
 
 #define NVMAP_PP_BIG_PAGE_SIZE           (0x10000)
 
+/*
+ * PMD sized pages kept in their own tier. NVMAP_PP_HUGE_POOL_SIZE is the
+ * default size of that tier as a ratio of the 4K pool, in the same pages per
+ * 1K pages units as NVMAP_PP_POOL_SIZE.
+ */
+#define NVMAP_PP_HUGE_PAGE_SIZE          (SZ_2M)
+#define NVMAP_PP_HUGE_POOL_SIZE          (64)
+
+/*
+ * Per-CPU magazines sit in front of the global pool so that the common
+ * alloc/free path only takes an uncontended, CPU-local lock. They are
+ * refilled from and drained to the global pool NVMAP_PP_MAG_BATCH pages
+ * at a time.
+ */
+#define NVMAP_PP_MAG_SIZE                (64)
+#define NVMAP_PP_MAG_BATCH               (NVMAP_PP_MAG_SIZE / 2)
+
+struct nvmap_pp_magazine {
+	spinlock_t lock;
+	u32 nr_zeroed;  /* Number of zeroed pages ready for allocation */
+	u32 nr_dirty;   /* Number of freed pages waiting to be zeroed */
+	struct page *zeroed[NVMAP_PP_MAG_SIZE];
+	struct page *dirty[NVMAP_PP_MAG_SIZE];
+};
+
 struct nvmap_page_pool {
 	struct rt_mutex lock;
 	u32 count;      /* Number of pages in the page & dirty list. */
@@ -228,9 +261,19 @@ struct nvmap_page_pool {
 	u32 big_pg_sz;  /* big page size supported(64k, etc.) */
 	u32 big_page_count;   /* Number of zeroed big pages avaialble */
 	u32 pages_per_big_pg; /* Number of pages in big page */
+	u32 huge_pg_sz;       /* Huge page size (2M) */
+	u32 pages_per_huge_pg; /* Number of pages in huge page */
+	u32 huge_max;         /* Max no. of pages in the huge page tier */
+	u32 huge_count;       /* Number of zeroed pages in huge pages */
+	u32 huge_to_zero;     /* Number of pages in huge pages to be zeroed */
+	u32 huge_under_zero;  /* Number of pages in huge pages being zeroed */
+	bool huge_fill_paused; /* Background huge page fill paused */
 	struct list_head page_list;
 	struct list_head zero_list;
 	struct list_head page_list_bp;
+	struct list_head page_list_hp;
+	struct list_head zero_list_hp;
+	struct nvmap_pp_magazine __percpu *mags;
 
 #ifdef CONFIG_NVMAP_PAGE_POOL_DEBUG
 	u64 allocs;
@@ -247,6 +290,8 @@ int nvmap_page_pool_alloc_lots(struct nvmap_page_pool *pool,
 					struct page **pages, u32 nr);
 int nvmap_page_pool_alloc_lots_bp(struct nvmap_page_pool *pool,
 					struct page **pages, u32 nr);
+int nvmap_page_pool_alloc_lots_hp(struct nvmap_page_pool *pool,
+					struct page **pages, u32 nr);
 int nvmap_page_pool_fill_lots(struct nvmap_page_pool *pool,
 				       struct page **pages, u32 nr);
 int nvmap_page_pool_clear(void);
@@ -255,9 +300,16 @@ int nvmap_page_pool_debugfs_init(struct dentry *nvmap_root);
 
 #define NVMAP_IVM_INVALID_PEER		(-1)
 
+/*
+ * Refs are kept both in an rb tree, for ordered walks, and in a hash table
+ * that can be searched under RCU without taking the ref lock.
+ */
+#define NVMAP_CLIENT_REF_HASH_BITS	8
+
 struct nvmap_client {
 	const char			*name;
 	struct rb_root			handle_refs;
+	DECLARE_HASHTABLE(handle_refs_hash, NVMAP_CLIENT_REF_HASH_BITS);
 	struct mutex			ref_lock;
 	bool				kernel_client;
 	atomic_t			count;
@@ -375,6 +427,8 @@ struct nvmap_carveout_node;
 
 void nvmap_handle_put(struct nvmap_handle *h);
 
+struct nvmap_handle_ref *__nvmap_validate_rcu(struct nvmap_client *priv,
+					      struct nvmap_handle *h);
 struct nvmap_handle_ref *__nvmap_validate_locked(struct nvmap_client *priv,
 						 struct nvmap_handle *h);
 
@@ -464,6 +518,20 @@ int __nvmap_cache_maint(struct nvmap_client *client,
 			       struct nvmap_cache_op_64 *op);
 int nvmap_cache_debugfs_init(struct dentry *nvmap_root);
 
+#ifdef CONFIG_NVMAP_CACHE_MAINT_ASYNC
+int nvmap_cache_async_init(void);
+void nvmap_cache_async_fini(void);
+#else
+static inline int nvmap_cache_async_init(void)
+{
+	return 0;
+}
+
+static inline void nvmap_cache_async_fini(void)
+{
+}
+#endif
+
 /* Internal API to support dmabuf */
 struct dma_buf *__nvmap_dmabuf_export(struct nvmap_client *client,
 				 struct nvmap_handle *handle);
@@ -520,6 +588,33 @@ static inline bool nvmap_page_mkclean(struct page **page)
 	return true;
 }
 
+/*
+ * Bit 1 of a page pointer marks a page the CPU may have dirtied since its
+ * last clean, i.e. it was faulted into a writable user mapping or written
+ * through a dma-buf CPU access. Write back of a tracked handle only touches
+ * these pages. See nvmap_handle_track_cpu_dirty().
+ */
+static inline bool nvmap_page_cpu_dirty(struct page *page)
+{
+	return (unsigned long)page & 2UL;
+}
+
+static inline bool nvmap_page_mkcpudirty(struct page **page)
+{
+	if (nvmap_page_cpu_dirty(*page))
+		return false;
+	*page = (struct page *)((unsigned long)*page | 2UL);
+	return true;
+}
+
+static inline bool nvmap_page_mkcpuclean(struct page **page)
+{
+	if (!nvmap_page_cpu_dirty(*page))
+		return false;
+	*page = (struct page *)((unsigned long)*page & ~2UL);
+	return true;
+}
+
 /*
  * FIXME: assume user space requests for reserve operations
  * are page aligned
@@ -539,8 +634,11 @@ static inline int nvmap_handle_mk(struct nvmap_handle *h,
 		(offset < h->size) &&
 		(size <= h->size) &&
 		(offset <= (h->size - size))) {
-		for (i = start_page; i < end_page; i++)
+		for (i = start_page; i < end_page; i++) {
+			if (!h->pgalloc.pages[i])
+				continue;
 			nchanged += fn(&h->pgalloc.pages[i]) ? 1 : 0;
+		}
 	}
 	if (!locked)
 		mutex_unlock(&h->lock);
@@ -591,9 +689,40 @@ static inline struct page **nvmap_pages(struct page **pg_pages, u32 nr_pages)
 	return pages;
 }
 
+/* Lazily allocated handles may have holes in their page array until every
+ * page has been touched once. */
+static inline bool nvmap_handle_populated(struct nvmap_handle *h)
+{
+	return !h->heap_pgalloc || !h->pgalloc.lazy ||
+		smp_load_acquire(&h->pgalloc.nr_populated) ==
+			(h->size >> PAGE_SHIFT);
+}
+
+int nvmap_handle_populate_locked(struct nvmap_handle *h, u32 start, u32 nr);
+
+static inline int nvmap_handle_populate(struct nvmap_handle *h,
+					u32 start, u32 nr)
+{
+	int err;
+
+	if (nvmap_handle_populated(h))
+		return 0;
+
+	mutex_lock(&h->lock);
+	err = nvmap_handle_populate_locked(h, start, nr);
+	mutex_unlock(&h->lock);
+	return err;
+}
+
+static inline int nvmap_handle_populate_all(struct nvmap_handle *h)
+{
+	return nvmap_handle_populate(h, 0, h->size >> PAGE_SHIFT);
+}
+
 void nvmap_zap_handle(struct nvmap_handle *handle, u64 offset, u64 size);
 
 void nvmap_vma_open(struct vm_area_struct *vma);
+void nvmap_vma_prefault(struct vm_area_struct *vma);
 
 int nvmap_reserve_pages(struct nvmap_handle **handles, u64 *offsets,
 			u64 *sizes, u32 nr, u32 op, bool is_32);
@@ -661,6 +790,34 @@ static inline bool nvmap_handle_track_dirty(struct nvmap_handle *h)
 			       NVMAP_HANDLE_CACHE_SYNC_AT_RESERVE);
 }
 
+extern bool nvmap_cpu_dirty_tracking;
+
+/*
+ * CPU dirty tracking covers cacheable page allocated handles, except those
+ * that already track dirty pages by zapping user mappings (CACHE_SYNC) and
+ * those that have been vmap'ed by another kernel driver.
+ */
+static inline bool nvmap_handle_track_cpu_dirty(struct nvmap_handle *h)
+{
+	if (!nvmap_cpu_dirty_tracking || !h->heap_pgalloc || h->from_va ||
+	    h->cpu_dirty_untracked || nvmap_handle_track_dirty(h))
+		return false;
+
+	return h->flags == NVMAP_HANDLE_CACHEABLE ||
+	       h->flags == NVMAP_HANDLE_INNER_CACHEABLE;
+}
+
+static inline void nvmap_handle_mkcpudirty(struct nvmap_handle *h,
+					   u32 offset, u32 size)
+{
+	if (!nvmap_handle_track_cpu_dirty(h))
+		return;
+	if (size == 0)
+		size = h->size;
+
+	nvmap_handle_mk(h, offset, size, nvmap_page_mkcpudirty, false);
+}
+
 struct nvmap_tag_entry *nvmap_search_tag_entry(struct rb_root *root, u32 tag);
 
 int nvmap_define_tag(struct nvmap_device *dev, u32 tag,
@@ -16,15 +16,234 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/hashtable.h>
+#include <linux/seq_file.h>
+#include <linux/version.h>
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
+#include <linux/sched/clock.h>
+#endif
 
 #include "nvmap_priv.h"
 
 struct nvmap_stats nvmap_stats;
 
-static int nvmap_stats_reset(void *data, u64 val)
+/*
+ * Per tag accounting. Entries are created on the first allocation with a
+ * given tag and live until the driver goes away; there are only ever a few
+ * dozen tags in use.
+ */
+#define NVMAP_TAG_STATS_BITS	6
+
+struct nvmap_tag_stats {
+	struct hlist_node node;
+	u32 tag;
+	atomic64_t cur;
+	atomic64_t peak;
+	struct nvmap_lat_hist lat[NL_NUM];
+};
+
+static DEFINE_HASHTABLE(nvmap_tag_stats, NVMAP_TAG_STATS_BITS);
+static DEFINE_SPINLOCK(nvmap_tag_stats_lock);
+
+static const char * const nvmap_lat_names[NL_NUM] = {
+	[NL_ALLOC]	 = "alloc",
+	[NL_FREE]	 = "free",
+	[NL_MMAP]	 = "mmap",
+	[NL_CACHE_MAINT] = "cache_maint",
+};
+
+static struct nvmap_tag_stats *nvmap_tag_stats_find(u32 tag)
+{
+	struct nvmap_tag_stats *ts;
+
+	hash_for_each_possible_rcu(nvmap_tag_stats, ts, node, tag)
+		if (ts->tag == tag)
+			return ts;
+	return NULL;
+}
+
+static struct nvmap_tag_stats *nvmap_tag_stats_get(u32 tag)
+{
+	struct nvmap_tag_stats *ts, *new;
+
+	rcu_read_lock();
+	ts = nvmap_tag_stats_find(tag);
+	rcu_read_unlock();
+	if (ts)
+		return ts;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return NULL;
+	new->tag = tag;
+
+	spin_lock(&nvmap_tag_stats_lock);
+	ts = nvmap_tag_stats_find(tag);
+	if (!ts) {
+		hash_add_rcu(nvmap_tag_stats, &new->node, tag);
+		ts = new;
+		new = NULL;
+	}
+	spin_unlock(&nvmap_tag_stats_lock);
+	kfree(new);
+	return ts;
+}
+
+static void nvmap_lat_hist_add(struct nvmap_lat_hist *hist, u64 ns)
+{
+	int b = fls64(ns >> NVMAP_LAT_MIN_SHIFT);
+
+	atomic64_inc(&hist->buckets[min(b, NVMAP_LAT_BUCKETS - 1)]);
+}
+
+static void nvmap_lat_hist_reset(struct nvmap_lat_hist *hist)
+{
+	int i;
+
+	for (i = 0; i < NVMAP_LAT_BUCKETS; i++)
+		atomic64_set(&hist->buckets[i], 0);
+}
+
+/* Upper bound in us of the bucket holding the pct'th percentile sample. */
+static u64 nvmap_lat_hist_pct(struct nvmap_lat_hist *hist, u64 count,
+			      unsigned int pct)
+{
+	u64 seen = 0, want = div64_u64(count * pct + 99, 100);
+	int i;
+
+	for (i = 0; i < NVMAP_LAT_BUCKETS; i++) {
+		seen += atomic64_read(&hist->buckets[i]);
+		if (seen >= want)
+			break;
+	}
+	return (1ULL << (i + NVMAP_LAT_MIN_SHIFT)) / NSEC_PER_USEC;
+}
+
+static u64 nvmap_lat_hist_count(struct nvmap_lat_hist *hist)
+{
+	u64 count = 0;
+	int i;
+
+	for (i = 0; i < NVMAP_LAT_BUCKETS; i++)
+		count += atomic64_read(&hist->buckets[i]);
+	return count;
+}
+
+static void nvmap_lat_hist_show(struct seq_file *s, const char *name,
+				struct nvmap_lat_hist *hist)
 {
+	u64 count = nvmap_lat_hist_count(hist);
 	int i;
 
+	if (!count)
+		return;
+
+	seq_printf(s, "  %-12s n=%llu p50<%lluus p99<%lluus |", name, count,
+		   nvmap_lat_hist_pct(hist, count, 50),
+		   nvmap_lat_hist_pct(hist, count, 99));
+	for (i = 0; i < NVMAP_LAT_BUCKETS; i++)
+		seq_printf(s, " %lld",
+			   (long long)atomic64_read(&hist->buckets[i]));
+	seq_puts(s, "\n");
+}
+
+static const char *nvmap_heap_bit_name(unsigned int bit)
+{
+	switch (1ul << bit) {
+	case NVMAP_HEAP_IOVMM:
+		return "iovmm";
+	case NVMAP_HEAP_CARVEOUT_IRAM:
+		return "iram";
+	case NVMAP_HEAP_CARVEOUT_VPR:
+		return "vpr";
+	case NVMAP_HEAP_CARVEOUT_TSEC:
+		return "tsec";
+	case NVMAP_HEAP_CARVEOUT_VIDMEM:
+		return "vidmem";
+	case NVMAP_HEAP_CARVEOUT_IVM:
+		return "ivm";
+	case NVMAP_HEAP_CARVEOUT_GENERIC:
+		return "generic";
+	default:
+		return "carveout";
+	}
+}
+
+static int nvmap_stats_latency_show(struct seq_file *s, void *unused)
+{
+	int heap, op;
+
+	seq_printf(s, "buckets: <=%lluus doubling per column\n",
+		   (1ULL << NVMAP_LAT_MIN_SHIFT) / NSEC_PER_USEC);
+	for (heap = 0; heap < NVMAP_LAT_HEAPS; heap++) {
+		bool used = false;
+
+		for (op = 0; op < NL_NUM; op++)
+			used |= !!nvmap_lat_hist_count(
+					&nvmap_stats.heap_lat[heap][op]);
+		if (!used)
+			continue;
+
+		seq_printf(s, "heap %s (bit %d)\n", nvmap_heap_bit_name(heap),
+			   heap);
+		for (op = 0; op < NL_NUM; op++)
+			nvmap_lat_hist_show(s, nvmap_lat_names[op],
+					    &nvmap_stats.heap_lat[heap][op]);
+	}
+	return 0;
+}
+
+static int nvmap_stats_tags_show(struct seq_file *s, void *unused)
+{
+	struct nvmap_tag_stats *ts;
+	int bkt, op;
+
+	mutex_lock(&nvmap_dev->tags_lock);
+	rcu_read_lock();
+	hash_for_each_rcu(nvmap_tag_stats, bkt, ts, node) {
+		seq_printf(s, "tag 0x%04x %-24s cur %lldK peak %lldK\n",
+			   ts->tag, __nvmap_tag_name(nvmap_dev, ts->tag),
+			   (long long)atomic64_read(&ts->cur) >> 10,
+			   (long long)atomic64_read(&ts->peak) >> 10);
+		for (op = 0; op < NL_NUM; op++)
+			nvmap_lat_hist_show(s, nvmap_lat_names[op],
+					    &ts->lat[op]);
+	}
+	rcu_read_unlock();
+	mutex_unlock(&nvmap_dev->tags_lock);
+	return 0;
+}
+
+static int nvmap_stats_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_stats_latency_show, inode->i_private);
+}
+
+static int nvmap_stats_tags_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvmap_stats_tags_show, inode->i_private);
+}
+
+static const struct file_operations latency_fops = {
+	.open = nvmap_stats_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static const struct file_operations tags_fops = {
+	.open = nvmap_stats_tags_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int nvmap_stats_reset(void *data, u64 val)
+{
+	struct nvmap_tag_stats *ts;
+	int i, j;
+
 	if (val) {
 		atomic64_set(&nvmap_stats.collect, 0);
 		for (i = 0; i < NS_NUM; i++) {
@@ -32,6 +251,18 @@ static int nvmap_stats_reset(void *data, u64 val)
 				continue;
 			atomic64_set(&nvmap_stats.stats[i], 0);
 		}
+		for (i = 0; i < NVMAP_LAT_HEAPS; i++)
+			for (j = 0; j < NL_NUM; j++)
+				nvmap_lat_hist_reset(
+					&nvmap_stats.heap_lat[i][j]);
+
+		rcu_read_lock();
+		hash_for_each_rcu(nvmap_tag_stats, i, ts, node) {
+			atomic64_set(&ts->peak, atomic64_read(&ts->cur));
+			for (j = 0; j < NL_NUM; j++)
+				nvmap_lat_hist_reset(&ts->lat[j]);
+		}
+		rcu_read_unlock();
 	}
 	return 0;
 }
@@ -82,6 +313,10 @@ void nvmap_stats_init(struct dentry *nvmap_debug_root)
 			stats_root, &nvmap_stats.collect, &stats_fops);
 		debugfs_create_file("reset", S_IWUSR,
 			stats_root, NULL, &reset_stats_fops);
+		debugfs_create_file("latency", S_IRUGO,
+			stats_root, NULL, &latency_fops);
+		debugfs_create_file("tags", S_IRUGO,
+			stats_root, NULL, &tags_fops);
 	}
 
 #undef CREATE_DF
@@ -104,3 +339,63 @@ u64 nvmap_stats_read(enum nvmap_stats_t stat)
 	return atomic64_read(&nvmap_stats.stats[stat]);
 }
 
+
+u64 nvmap_stats_lat_start(void)
+{
+	if (!atomic64_read(&nvmap_stats.collect))
+		return 0;
+	return sched_clock();
+}
+
+void nvmap_stats_lat_end(enum nvmap_lat_t op, u32 heap_type, u32 tag,
+			 u64 start)
+{
+	struct nvmap_tag_stats *ts;
+	u64 ns;
+
+	if (!start || !heap_type)
+		return;
+
+	ns = sched_clock() - start;
+	nvmap_lat_hist_add(&nvmap_stats.heap_lat[__ffs(heap_type)][op], ns);
+
+	rcu_read_lock();
+	ts = nvmap_tag_stats_find(tag);
+	if (ts)
+		nvmap_lat_hist_add(&ts->lat[op], ns);
+	rcu_read_unlock();
+}
+
+/*
+ * Current and peak bytes are tracked whether or not collection is enabled so
+ * that they stay consistent over toggling it.
+ */
+void nvmap_stats_tag_alloc(u32 tag, size_t size)
+{
+	struct nvmap_tag_stats *ts = nvmap_tag_stats_get(tag);
+	s64 cur, peak;
+
+	if (!ts)
+		return;
+
+	cur = atomic64_add_return(size, &ts->cur);
+	peak = atomic64_read(&ts->peak);
+	while (cur > peak) {
+		s64 old = atomic64_cmpxchg(&ts->peak, peak, cur);
+
+		if (old == peak)
+			break;
+		peak = old;
+	}
+}
+
+void nvmap_stats_tag_free(u32 tag, size_t size)
+{
+	struct nvmap_tag_stats *ts;
+
+	rcu_read_lock();
+	ts = nvmap_tag_stats_find(tag);
+	if (ts)
+		atomic64_sub(size, &ts->cur);
+	rcu_read_unlock();
+}
@@ -31,9 +31,31 @@ enum nvmap_stats_t {
 	NS_NUM,
 };
 
+/* Operations whose latency is recorded per heap and per tag. */
+enum nvmap_lat_t {
+	NL_ALLOC = 0,
+	NL_FREE,
+	NL_MMAP,
+	NL_CACHE_MAINT,
+	NL_NUM,
+};
+
+/*
+ * Latency histogram buckets are powers of 2 of nanoseconds, the first one
+ * holding everything up to 1us and the last everything above ~4s.
+ */
+#define NVMAP_LAT_MIN_SHIFT	10
+#define NVMAP_LAT_BUCKETS	23
+#define NVMAP_LAT_HEAPS		32	/* one per heap bit */
+
+struct nvmap_lat_hist {
+	atomic64_t buckets[NVMAP_LAT_BUCKETS];
+};
+
 struct nvmap_stats {
 	atomic64_t stats[NS_NUM];
 	atomic64_t collect;
+	struct nvmap_lat_hist heap_lat[NVMAP_LAT_HEAPS][NL_NUM];
 };
 
 extern struct nvmap_stats nvmap_stats;
@@ -42,4 +64,14 @@ void nvmap_stats_init(struct dentry *nvmap_debug_root);
 void nvmap_stats_inc(enum nvmap_stats_t, size_t size);
 void nvmap_stats_dec(enum nvmap_stats_t, size_t size);
 u64 nvmap_stats_read(enum nvmap_stats_t);
+
+/*
+ * nvmap_stats_lat_start() returns 0 when stats collection is off, in which
+ * case nvmap_stats_lat_end() does nothing.
+ */
+u64 nvmap_stats_lat_start(void);
+void nvmap_stats_lat_end(enum nvmap_lat_t op, u32 heap_type, u32 tag,
+			 u64 start);
+void nvmap_stats_tag_alloc(u32 tag, size_t size);
+void nvmap_stats_tag_free(u32 tag, size_t size);
 #endif /* __VIDEO_TEGRA_NVMAP_STATS_H */
@@ -20,6 +20,9 @@
 #include <linux/interrupt.h>
 #include <linux/cdev.h>
 #include <linux/poll.h>
+#include <linux/bitmap.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 #include <linux/tegra-ivc.h>
 #include <linux/tegra-ivc-instance.h>
@@ -33,6 +36,20 @@
 #define DRV_NAME	"tegra_hv_pm_ctl"
 #define CHAR_DEV_COUNT	1
 
+/* Batched guest suspend/resume completion polling */
+#define BATCH_POLL_MS		10
+#define BATCH_TIMEOUT_MS	10000
+
+struct tegra_hv_pm_ctl_guest_op {
+	bool valid;
+	bool pending;
+	bool suspend;
+	int result;
+	ktime_t start;
+	s64 trigger_us;		/* hypercall issue latency */
+	s64 complete_us;	/* trigger until the guest reached the state */
+};
+
 struct tegra_hv_pm_ctl {
 	struct device *dev;
 
@@ -46,6 +63,11 @@ struct tegra_hv_pm_ctl {
 
 	struct mutex mutex_lock;
 	wait_queue_head_t wq;
+
+	struct tegra_hv_pm_ctl_guest_op ops[NGUESTS_MAX];
+	struct delayed_work batch_work;
+	unsigned long batch_deadline;
+	bool batch_busy;
 };
 
 int (*tegra_hv_pm_ctl_prepare_shutdown)(void);
@@ -492,6 +514,168 @@ static ssize_t guest_state_store(struct device *dev,
 	return count;
 }
 
+static bool guest_op_done(struct tegra_hv_pm_ctl_guest_op *op, u32 vmid)
+{
+	u32 state;
+
+	if (hyp_read_guest_state(vmid, &state) < 0)
+		return false;
+
+	if (op->suspend)
+		return state == VM_STATE_SUSPEND;
+
+	return state != VM_STATE_SUSPEND;
+}
+
+static void tegra_hv_pm_ctl_batch_work(struct work_struct *work)
+{
+	struct tegra_hv_pm_ctl *data = container_of(to_delayed_work(work),
+					struct tegra_hv_pm_ctl, batch_work);
+	bool timed_out = time_after(jiffies, data->batch_deadline);
+	bool pending = false;
+	u32 vmid;
+
+	mutex_lock(&data->mutex_lock);
+	for (vmid = 0; vmid < NGUESTS_MAX; vmid++) {
+		struct tegra_hv_pm_ctl_guest_op *op = &data->ops[vmid];
+
+		if (!op->pending)
+			continue;
+
+		if (guest_op_done(op, vmid)) {
+			op->complete_us = ktime_us_delta(ktime_get(),
+							 op->start);
+			op->pending = false;
+		} else if (timed_out) {
+			op->result = -ETIMEDOUT;
+			op->pending = false;
+		} else {
+			pending = true;
+		}
+	}
+
+	if (pending)
+		schedule_delayed_work(&data->batch_work,
+				      msecs_to_jiffies(BATCH_POLL_MS));
+	else
+		data->batch_busy = false;
+	mutex_unlock(&data->mutex_lock);
+
+	if (!pending)
+		sysfs_notify(&data->dev->kobj, NULL, "guests_batch_status");
+}
+
+/*
+ * Fire the suspend or resume hypercall at every guest in the list
+ * without waiting in between, then poll their states from a work item.
+ * guests_batch_status is notified once all are done or timed out.
+ */
+static int tegra_hv_pm_ctl_batch(struct tegra_hv_pm_ctl *data,
+				 const char *buf, bool suspend)
+{
+	DECLARE_BITMAP(vmids, NGUESTS_MAX);
+	struct tegra_hv_pm_ctl_guest_op *op;
+	u32 vmid;
+	int ret;
+
+	ret = bitmap_parselist(buf, vmids, NGUESTS_MAX);
+	if (ret) {
+		dev_err(data->dev, "%s: Failed to parse guest list\n",
+			__func__);
+		return ret;
+	}
+
+	if (bitmap_empty(vmids, NGUESTS_MAX))
+		return -EINVAL;
+
+	mutex_lock(&data->mutex_lock);
+	if (data->batch_busy) {
+		mutex_unlock(&data->mutex_lock);
+		return -EBUSY;
+	}
+
+	memset(data->ops, 0, sizeof(data->ops));
+	for_each_set_bit(vmid, vmids, NGUESTS_MAX) {
+		op = &data->ops[vmid];
+		op->valid = true;
+		op->suspend = suspend;
+		op->start = ktime_get();
+
+		if (suspend)
+			ret = tegra_hv_pm_ctl_trigger_guest_suspend(vmid);
+		else
+			ret = tegra_hv_pm_ctl_trigger_guest_resume(vmid);
+
+		op->result = ret;
+
+		op->trigger_us = ktime_us_delta(ktime_get(), op->start);
+		op->pending = !op->result;
+	}
+
+	data->batch_busy = true;
+	data->batch_deadline = jiffies + msecs_to_jiffies(BATCH_TIMEOUT_MS);
+	schedule_delayed_work(&data->batch_work, 0);
+	mutex_unlock(&data->mutex_lock);
+
+	return 0;
+}
+
+static ssize_t trigger_guests_suspend_store(struct device *dev,
+					    struct device_attribute *attr,
+					    const char *buf, size_t count)
+{
+	struct tegra_hv_pm_ctl *data = dev_get_drvdata(dev);
+	int ret;
+
+	ret = tegra_hv_pm_ctl_batch(data, buf, true);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static ssize_t trigger_guests_resume_store(struct device *dev,
+					   struct device_attribute *attr,
+					   const char *buf, size_t count)
+{
+	struct tegra_hv_pm_ctl *data = dev_get_drvdata(dev);
+	int ret;
+
+	ret = tegra_hv_pm_ctl_batch(data, buf, false);
+	if (ret < 0)
+		return ret;
+
+	return count;
+}
+
+static ssize_t guests_batch_status_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct tegra_hv_pm_ctl *data = dev_get_drvdata(dev);
+	struct tegra_hv_pm_ctl_guest_op *op;
+	ssize_t len;
+	u32 vmid;
+
+	mutex_lock(&data->mutex_lock);
+	len = snprintf(buf, PAGE_SIZE, "%s\n",
+		       data->batch_busy ? "busy" : "idle");
+	for (vmid = 0; vmid < NGUESTS_MAX; vmid++) {
+		op = &data->ops[vmid];
+		if (!op->valid)
+			continue;
+
+		len += snprintf(buf + len, PAGE_SIZE - len,
+				"guest%u: %s %s %d trigger_us=%lld complete_us=%lld\n",
+				vmid, op->suspend ? "suspend" : "resume",
+				op->pending ? "pending" : "done", op->result,
+				op->trigger_us, op->complete_us);
+	}
+	mutex_unlock(&data->mutex_lock);
+
+	return len;
+}
+
 static DEVICE_ATTR_RO(ivc_id);
 static DEVICE_ATTR_RO(ivc_frame_size);
 static DEVICE_ATTR_RO(ivc_nframes);
@@ -502,6 +686,9 @@ static DEVICE_ATTR_WO(trigger_sys_reboot);
 static DEVICE_ATTR_WO(trigger_guest_suspend);
 static DEVICE_ATTR_WO(trigger_guest_resume);
 static DEVICE_ATTR_RW(guest_state);
+static DEVICE_ATTR_WO(trigger_guests_suspend);
+static DEVICE_ATTR_WO(trigger_guests_resume);
+static DEVICE_ATTR_RO(guests_batch_status);
 
 static struct attribute *tegra_hv_pm_ctl_attributes[] = {
 	&dev_attr_ivc_id.attr,
@@ -514,6 +701,9 @@ static struct attribute *tegra_hv_pm_ctl_attributes[] = {
 	&dev_attr_trigger_guest_suspend.attr,
 	&dev_attr_trigger_guest_resume.attr,
 	&dev_attr_guest_state.attr,
+	&dev_attr_trigger_guests_suspend.attr,
+	&dev_attr_trigger_guests_resume.attr,
+	&dev_attr_guests_batch_status.attr,
 	NULL
 };
 
@@ -640,6 +830,7 @@ static int tegra_hv_pm_ctl_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, data);
 	mutex_init(&data->mutex_lock);
 	init_waitqueue_head(&data->wq);
+	INIT_DELAYED_WORK(&data->batch_work, tegra_hv_pm_ctl_batch_work);
 
 	ret = tegra_hv_pm_ctl_parse_dt(data);
 	if (ret < 0) {
@@ -687,6 +878,7 @@ static int tegra_hv_pm_ctl_remove(struct platform_device *pdev)
 
 	tegra_hv_pm_ctl_cleanup(data);
 	sysfs_remove_group(&pdev->dev.kobj, &tegra_hv_pm_ctl_attr_group);
+	cancel_delayed_work_sync(&data->batch_work);
 	class_destroy(data->class);
 
 	return 0;
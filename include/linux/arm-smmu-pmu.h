@@ -0,0 +1,30 @@
+/*
+ * Copyright (c) 2018 NVIDIA Corporation.  All rights reserved.
+ *
+ * NVIDIA Corporation and its licensors retain all intellectual property
+ * and proprietary rights in and to this software and related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA Corporation is strictly prohibited.
+ */
+
+#ifndef _ARM_SMMU_PMU_H
+#define _ARM_SMMU_PMU_H
+
+struct device;
+
+#ifdef CONFIG_ARM_SMMU_PMU
+int arm_smmu_pmu_init(struct device *dev, void __iomem **smmu_base,
+		      int num_smmus, unsigned long smmu_pgshift);
+void arm_smmu_pmu_exit(void);
+#else
+static inline int arm_smmu_pmu_init(struct device *dev,
+				    void __iomem **smmu_base, int num_smmus,
+				    unsigned long smmu_pgshift)
+{
+	return 0;
+}
+static inline void arm_smmu_pmu_exit(void) {}
+#endif
+
+#endif
@@ -20,9 +20,22 @@
 #ifndef __LINUX_CVNAS_H
 #define __LINUX_CVNAS_H
 
+#include <linux/types.h>
+
+struct device;
+struct nvcvnas_scratch;
+
 int nvcvnas_busy(void);
 int nvcvnas_idle(void);
 phys_addr_t nvcvnas_get_cvsram_base(void);
 size_t nvcvnas_get_cvsram_size(void);
 
+/* CV SRAM scratch buffers, placed by queue priority and reuse */
+struct nvcvnas_scratch *nvcvnas_scratch_alloc(struct device *dev,
+					      size_t size, u32 prio);
+void nvcvnas_scratch_free(struct nvcvnas_scratch *buf);
+int nvcvnas_scratch_get(struct nvcvnas_scratch *buf, dma_addr_t *addr,
+			bool *in_sram);
+void nvcvnas_scratch_put(struct nvcvnas_scratch *buf);
+
 #endif
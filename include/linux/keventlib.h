@@ -18,6 +18,26 @@
 #define __KEVENTLIB_H
 
 #include <linux/types.h>
+#include <linux/jump_label.h>
+
+/* Only event types below this can be filtered, others are always written */
+#define KEVENTLIB_MAX_FILTER_TYPES	64
+
+DECLARE_STATIC_KEY_FALSE(keventlib_filtering);
+
+bool __keventlib_type_enabled(int id, uint32_t type);
+
+/*
+ * Cheap check for callers to skip building an event nobody wants. Costs a
+ * patched-out branch unless some provider has event types filtered out.
+ */
+static inline bool keventlib_type_enabled(int id, uint32_t type)
+{
+	if (!static_branch_unlikely(&keventlib_filtering))
+		return true;
+
+	return __keventlib_type_enabled(id, type);
+}
 
 int
 keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts);
@@ -59,6 +59,7 @@ struct sync_pt;
 #define NVHOST_NAME_SIZE			24
 #define NVSYNCPT_INVALID			(-1)
 #define NVHOST_MODULE_MAX_FREQS			8
+#define NVHOST_MODULE_IDLE_GAPS			32
 
 #define NVSYNCPT_AVP_0			(10)	/* t20, t30, t114, t148 */
 #define NVSYNCPT_3D			(22)	/* t20, t30, t114, t148 */
@@ -195,6 +196,15 @@ struct nvhost_device_data {
 	bool		engine_can_cg;	/* True if CG is enabled */
 	bool		can_powergate;	/* True if module can be power gated */
 	int		autosuspend_delay;/* Delay before power gated */
+
+	/*
+	 * Adapt the delay to the recent gaps between busy periods, within
+	 * [autosuspend_delay_min, autosuspend_delay_max] ms. Zero bounds pick
+	 * the ACM defaults.
+	 */
+	bool		autosuspend_adaptive;
+	int		autosuspend_delay_min;
+	int		autosuspend_delay_max;
 	struct nvhost_clock clocks[NVHOST_MODULE_MAX_CLOCKS];/* Clock names */
 
 	/* Clock gating registers */
@@ -232,6 +242,19 @@ struct nvhost_device_data {
 
 	u32 nvhost_timeout_default;
 
+	/* upper bound for spinning on syncpt waits in usecs, 0 = host default */
+	u32 syncpt_spin_us;
+
+	/* High priority jobs in flight, low priority submits wait on these */
+	atomic_t high_prio_jobs;
+	wait_queue_head_t high_prio_wq;
+
+	/* Engine time accounting per client, see nvhost_channel.c */
+	spinlock_t client_usage_lock;
+	struct list_head client_usage_list;
+	ktime_t last_job_done;
+	u64 busy_ns;			/* engine time of all clients */
+
 	/* Data for devfreq usage */
 	struct devfreq			*power_manager;
 	/* Private device profile data */
@@ -266,6 +289,21 @@ struct nvhost_device_data {
 	struct rw_semaphore busy_lock;
 	bool forced_idle;
 
+	/* Idle gap history and gating statistics, see nvhost_acm.c */
+	spinlock_t idle_lock;
+	ktime_t idle_start;		/* last went idle, 0 while busy */
+	u32 idle_gaps[NVHOST_MODULE_IDLE_GAPS];	/* recent gaps, ms */
+	u32 num_idle_gaps;		/* total gaps seen */
+	int autosuspend_delay_cur;	/* delay currently programmed */
+	struct nvhost_acm_stats {
+		u64 powergates;
+		u64 unpowergates;
+		u64 unpowergate_us_total;
+		u64 unpowergate_us_max;
+		u64 gaps_bridged;	/* woke up before the delay expired */
+		u64 delay_updates;
+	} acm_stats;
+
 	/* Finalize power on. Can be used for context restore. */
 	int (*finalize_poweron)(struct platform_device *dev);
 
@@ -749,6 +787,8 @@ u32 nvhost_syncpt_read_minval(struct platform_device *dev, u32 id);
 u32 nvhost_syncpt_read_maxval(struct platform_device *dev, u32 id);
 void nvhost_syncpt_set_minval(struct platform_device *dev, u32 id, u32 val);
 void nvhost_syncpt_set_maxval(struct platform_device *dev, u32 id, u32 val);
+int nvhost_syncpt_set_poll_us(struct platform_device *dev, u32 id,
+			      u32 poll_us);
 
 void nvhost_eventlib_log_task(struct platform_device *pdev,
 			      u32 syncpt_id,
@@ -794,6 +834,7 @@ nvhost_client_request_firmware(struct platform_device *dev,
 #endif
 
 #ifdef CONFIG_TEGRA_GRHOST_SYNC
+/* Points on the same syncpoint are merged into the one that triggers last */
 struct sync_fence *nvhost_sync_create_fence(
 		struct platform_device *pdev,
 		struct nvhost_ctrl_sync_fence_info *pts,
@@ -159,6 +159,12 @@ struct nvhost_set_priority_args {
 	__u32 priority;
 } __packed;
 
+struct nvhost_client_usage_args {
+	__u64 busy_ns;		/* engine time used by this channel fd */
+	__u64 num_jobs;		/* jobs completed for this channel fd */
+	__u64 device_busy_ns;	/* engine time used by all clients */
+} __packed;
+
 struct nvhost_set_error_notifier {
 	__u64 offset;
 	__u64 size;
@@ -206,6 +212,9 @@ struct nvhost32_submit_args {
 } __packed;
 
 #define NVHOST_SUBMIT_FLAG_SYNC_FENCE_FD	0
+/* Reloc words were not touched since the command buffers were last
+ * submitted on this channel; patching is skipped if the addresses match */
+#define NVHOST_SUBMIT_FLAG_RELOCS_UNCHANGED	1
 #define NVHOST_SUBMIT_MAX_NUM_SYNCPT_INCRS	10
 
 struct nvhost_submit_args {
@@ -235,6 +244,19 @@ struct nvhost_submit_args {
 	__u64 fences;
 };
 
+/* Several jobs for one channel in one call, each array entry being filled
+ * in exactly as for NVHOST_IOCTL_CHANNEL_SUBMIT. Per job fences are
+ * returned in the entries. */
+#define NVHOST_SUBMIT_BATCH_MAX			64
+#define NVHOST_SUBMIT_BATCH_FLAG_SYNC_FENCE_FD	0
+struct nvhost_submit_batch_args {
+	__u64 submits;		/* Ptr to struct nvhost_submit_args array */
+	__u32 num_submits;
+	__u32 flags;
+	__u32 fence;		/* Return value: fence fd for the whole batch */
+	__u32 num_submitted;	/* Return value */
+};
+
 struct nvhost_set_ctxswitch_args {
 	__u32 num_cmdbufs_save;
 	__u32 num_save_incrs;
@@ -324,6 +346,10 @@ struct nvhost_channel_map_buffer_args {
 
 #define NVHOST_IOCTL_CHANNEL_SET_SYNCPOINT_NAME	\
 	_IOW(NVHOST_IOCTL_MAGIC, 30, struct nvhost_set_syncpt_name_args)
+#define NVHOST_IOCTL_CHANNEL_SUBMIT_BATCH	\
+	_IOWR(NVHOST_IOCTL_MAGIC, 31, struct nvhost_submit_batch_args)
+#define NVHOST_IOCTL_CHANNEL_GET_CLIENT_USAGE	\
+	_IOR(NVHOST_IOCTL_MAGIC, 32, struct nvhost_client_usage_args)
 
 #define NVHOST_IOCTL_CHANNEL_SET_ERROR_NOTIFIER  \
 	_IOWR(NVHOST_IOCTL_MAGIC, 111, struct nvhost_set_error_notifier)
@@ -417,6 +443,8 @@ struct nvhost_characteristics {
 #define NVHOST_CHARACTERISTICS_GFILTER (1 << 0)
 #define NVHOST_CHARACTERISTICS_RESOURCE_PER_CHANNEL_INSTANCE (1 << 1)
 #define NVHOST_CHARACTERISTICS_SUPPORT_PREFENCES (1 << 2)
+/* syncpoint min values can be read from a page mmap()ed from nvhost-ctrl */
+#define NVHOST_CHARACTERISTICS_SYNCPT_SHADOW (1 << 3)
 	__u64 flags;
 
 	__u32 num_mlocks;
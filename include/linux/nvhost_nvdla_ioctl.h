@@ -75,12 +75,17 @@ struct nvdla_pin_unpin_args {
  * @flags		flags for task submit, like atomic
  * @version		version of task structure
  *
+ * With NVDLA_SUBMIT_FLAGS_DESC_BUFFER, @tasks and all the pointers in the
+ * tasks are byte offsets into the buffer registered with
+ * NVDLA_IOCTL_SET_DESC_BUFFER, and post-fences are written back there.
+ *
  */
 struct nvdla_submit_args {
 	__u64 tasks;
 	__u16 num_tasks;
 #define MAX_TASKS_PER_SUBMIT		24
 #define NVDLA_SUBMIT_FLAGS_ATOMIC	(1 << 0)
+#define NVDLA_SUBMIT_FLAGS_DESC_BUFFER	(1 << 1)
 	__u16 flags;
 	__u32 version;
 };
@@ -208,6 +213,71 @@ struct nvdla_status_notify {
 	__u32 status;
 };
 
+/**
+ * struct nvdla_desc_buffer_args structure to register a descriptor buffer
+ *
+ * @handle		handle of the buffer, 0 to drop the current one
+ * @reserved		reserved for future use
+ *
+ * User space writes task descriptors into this buffer and submits them
+ * with NVDLA_SUBMIT_FLAGS_DESC_BUFFER instead of passing pointers.
+ *
+ */
+struct nvdla_desc_buffer_args {
+	__u32 handle;
+	__u32 reserved;
+};
+
+/**
+ * struct nvdla_queue_attr_args structure to set a queue attribute
+ *
+ * @id			attribute, one of NVDLA_QUEUE_ATTR_*
+ * @value		new value of the attribute
+ *
+ * NVDLA_QUEUE_ATTR_PRIORITY takes one of NVDLA_QUEUE_PRIORITY_*. A task
+ * from a higher priority queue preempts a running task at its next layer
+ * boundary. Raising a queue above NVDLA_QUEUE_PRIORITY_NORMAL requires
+ * CAP_SYS_NICE.
+ *
+ * NVDLA_QUEUE_ATTR_POLL_US puts the queue in polling completion mode: a
+ * wait on the queue syncpoint polls it for up to @value usecs before
+ * sleeping on the interrupt, trading CPU time for wake-up latency on
+ * short tasks. 0 returns to interrupt driven completion. The budget is
+ * capped at NVDLA_QUEUE_MAX_POLL_US.
+ *
+ */
+struct nvdla_queue_attr_args {
+#define NVDLA_QUEUE_ATTR_PRIORITY	1
+#define NVDLA_QUEUE_ATTR_POLL_US	2
+	__u32 id;
+#define NVDLA_QUEUE_PRIORITY_LOW	0
+#define NVDLA_QUEUE_PRIORITY_NORMAL	1
+#define NVDLA_QUEUE_PRIORITY_HIGH	2
+#define NVDLA_QUEUE_PRIORITY_MAX	NVDLA_QUEUE_PRIORITY_HIGH
+#define NVDLA_QUEUE_MAX_POLL_US		2000
+	__u32 value;
+};
+
+/**
+ * struct nvdla_buffer_args structure to register a buffer
+ *
+ * @handle		handle of the buffer to register
+ * @id			buffer id, returned on register and given on unregister
+ *
+ * A registered buffer stays mapped at the same address until it is
+ * unregistered or the file is closed. The address list of a task refers
+ * to it with NVDLA_REGISTERED_HANDLE(id) in place of a memory handle,
+ * which skips resolving and pinning the handle on every submit.
+ *
+ */
+struct nvdla_buffer_args {
+	__u32 handle;
+	__u32 id;
+};
+
+#define NVDLA_REGISTERED_HANDLE_FLAG	(1U << 31)
+#define NVDLA_REGISTERED_HANDLE(id)	(NVDLA_REGISTERED_HANDLE_FLAG | (id))
+
 #define NVHOST_NVDLA_IOCTL_MAGIC 'D'
 
 #define NVDLA_IOCTL_PING		\
@@ -226,8 +296,16 @@ struct nvdla_status_notify {
 	_IOWR(NVHOST_NVDLA_IOCTL_MAGIC, 7, struct nvdla_get_q_status_args)
 #define NVDLA_IOCTL_EMU_TASK_SUBMIT \
 	_IOWR(NVHOST_NVDLA_IOCTL_MAGIC, 8, struct nvdla_submit_args)
+#define NVDLA_IOCTL_SET_DESC_BUFFER \
+	_IOW(NVHOST_NVDLA_IOCTL_MAGIC, 9, struct nvdla_desc_buffer_args)
+#define NVDLA_IOCTL_SET_QUEUE_ATTR \
+	_IOW(NVHOST_NVDLA_IOCTL_MAGIC, 10, struct nvdla_queue_attr_args)
+#define NVDLA_IOCTL_REGISTER_BUFFER \
+	_IOWR(NVHOST_NVDLA_IOCTL_MAGIC, 11, struct nvdla_buffer_args)
+#define NVDLA_IOCTL_UNREGISTER_BUFFER \
+	_IOW(NVHOST_NVDLA_IOCTL_MAGIC, 12, struct nvdla_buffer_args)
 #define NVDLA_IOCTL_LAST		\
-		_IOC_NR(NVDLA_IOCTL_EMU_TASK_SUBMIT)
+		_IOC_NR(NVDLA_IOCTL_UNREGISTER_BUFFER)
 
 #define NVDLA_IOCTL_MAX_ARG_SIZE  \
 		sizeof(struct nvdla_pin_unpin_args)
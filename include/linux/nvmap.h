@@ -53,6 +53,8 @@
 #define NVMAP_HANDLE_PHYS_CONTIG     (0x1ul << 6)
 #define NVMAP_HANDLE_CACHE_SYNC      (0x1ul << 7)
 #define NVMAP_HANDLE_CACHE_SYNC_AT_RESERVE      (0x1ul << 8)
+#define NVMAP_HANDLE_PREFAULT        (0x1ul << 9)
+#define NVMAP_HANDLE_LAZY_ALLOC      (0x1ul << 10)
 
 #if defined(__KERNEL__)
 
@@ -326,6 +328,33 @@ struct nvmap_cache_op_list {
 	__s32 op;		/* wb/wb_inv/inv */
 };
 
+struct nvmap_alloc_batch_entry {
+	__u64 size;		/* in: handle size in bytes */
+	__u32 heap_mask;	/* in: heaps to allocate from */
+	__u32 flags;		/* in: wb/wc/uc/iwb, tag etc. */
+	__u32 align;		/* in: min alignment necessary */
+	__s32 fd;		/* out: dma-buf fd of the new handle */
+};
+
+struct nvmap_alloc_batch {
+	__u64 entries;		/* Ptr to nvmap_alloc_batch_entry array */
+	__u32 nr;		/* Number of entries */
+	__u32 reserved;
+};
+
+struct nvmap_cache_op_list_async {
+	__u64 handles;		/* Ptr to u32 type array, holding handles */
+	__u64 offsets;		/* Ptr to u64 type array, holding offsets
+				 * into handle mem */
+	__u64 sizes;		/* Ptr to u64 type array, holding sizes of memory
+				 * regions within each handle, 0 for whole
+				 * handle */
+	__u32 nr;		/* Number of handles */
+	__s32 op;		/* wb/wb_inv/inv */
+	__s32 fence_fd;		/* out: sync fence fd, signalled when done */
+	__u32 reserved;
+};
+
 struct nvmap_debugfs_handles_header {
 	__u8 version;
 };
@@ -452,6 +481,14 @@ struct nvmap_heap_size {
 #define NVMAP_IOC_GET_HEAP_SIZE \
 	_IOR(NVMAP_IOC_MAGIC, 26, struct nvmap_heap_size)
 
+/* Queue cache maintenance on a list of handles and return a sync fence. */
+#define NVMAP_IOC_CACHE_LIST_ASYNC \
+	_IOWR(NVMAP_IOC_MAGIC, 27, struct nvmap_cache_op_list_async)
+
+/* Create and allocate a batch of handles, returning an fd per entry. */
+#define NVMAP_IOC_ALLOC_BATCH \
+	_IOWR(NVMAP_IOC_MAGIC, 28, struct nvmap_alloc_batch)
+
 /* START of T124 IOCTLS */
 /* Actually allocates memory for the specified handle, with kind */
 #define NVMAP_IOC_ALLOC_KIND _IOW(NVMAP_IOC_MAGIC, 100, struct nvmap_alloc_kind_handle)
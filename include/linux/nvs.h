@@ -132,6 +132,52 @@ struct nvs_float {
 	int fval;
 };
 
+#define NVS_RING_MAGIC			(0x4E565352) /* "NVSR" */
+#define NVS_RING_VERSION		(1)
+#define NVS_RING_SZ_MAX			(4 * 1024 * 1024)
+
+/* Header page of the nvs_ring mmap of an NVS IIO device.  The elements
+ * start at data_off and each one holds a single IIO scan (the same layout
+ * read() returns, timestamp included) in scan_sz of its elem_sz bytes.
+ * The kernel advances head, the reader advances tail.  Both are free
+ * running and the slot is the index & (elem_n - 1).  A poll() on the
+ * nvs_ring file returns POLLPRI once wm elements (1 if 0) are queued or
+ * a flush was queued.  Scans that don't fit are dropped and counted in
+ * overruns.
+ */
+struct nvs_ring_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 data_off;
+	__u32 elem_sz;
+	__u32 elem_n;
+	__u32 scan_sz;
+	__u32 wm;			/* reader: poll threshold */
+	__u32 overruns;
+	__u32 head;			/* kernel: scans written */
+	__u32 tail;			/* reader: scans consumed */
+};
+
+#define NVS_TS_SHIFT_DEF		(3)
+
+/* Timestamp model for samples read in batches from a FIFO.  The period is
+ * fitted from the reference time (e.g. the watermark IRQ) and the number
+ * of samples since the last batch, and tracks the drift of the sensor
+ * clock through a low pass filter of 1 / (1 << shift).  nvs_ts_next then
+ * hands out monotonic timestamps for each sample of the current batch
+ * that never go past the reference time.
+ */
+struct nvs_ts {
+	s64 period_nom;			/* nominal period (ns) */
+	s64 period;			/* fitted period (ns) */
+	s64 step;			/* period used for the current batch */
+	s64 end;			/* last sample of the batch */
+	s64 next;			/* timestamp of the next sample */
+	unsigned int shift;		/* filter weight */
+	unsigned int resync_n;		/* number of resyncs */
+	bool reset;
+};
+
 struct sensor_cfg {
 	const char *name;		/* sensor name */
 	int snsr_id;			/* sensor ID */
@@ -496,6 +542,10 @@ int nvs_vregs_init(struct device *dev, struct regulator_bulk_data *vregs,
 		   unsigned int vregs_n, char **vregs_name);
 int nvs_vregs_sts(struct regulator_bulk_data *vregs, unsigned int vregs_n);
 s64 nvs_timestamp(void);
+void nvs_ts_reset(struct nvs_ts *ts, s64 period_ns);
+s64 nvs_ts_fit(struct nvs_ts *ts, s64 ts_ref, unsigned int n);
+s64 nvs_ts_next(struct nvs_ts *ts);
+int nvs_ts_drift_ppm(struct nvs_ts *ts);
 int nvs_dsm_relay(int dev_id, bool connect, int snsr_id, unsigned char *uuid);
 int nvs_dsm_iio(int dev_id, bool connect, int snsr_id, unsigned char *uuid);
 int nvs_dsm_input(int dev_id, bool connect, int snsr_id, unsigned char *uuid);
@@ -14,6 +14,7 @@
 #ifndef ACTMON_COMMON_H
 
 #include <asm/io.h>
+#include <linux/workqueue.h>
 
 /* START: These device register offsets have common value across socs */
 #define ACTMON_CMN_DEV_CTRL				0x00
@@ -44,6 +45,13 @@
 #define FREQ_SAMPLER 1
 #define LOAD_SAMPLER 0
 #define DEFAULT_ACTMON_TYPE	FREQ_SAMPLER
+
+/* Predictive governor defaults */
+#define ACTMON_PREDICT_HIST		8
+#define DEFAULT_PREDICT_PERIOD_MS	20
+#define DEFAULT_PREDICT_LOOKAHEAD_MS	40
+#define DEFAULT_PREDICT_UP_RESPONSE_MS	0
+#define DEFAULT_PREDICT_DOWN_RESPONSE_MS	200
 /* Maximum frequency EMC is running at when sourced from PLLP. This is
  * really a short-cut, but it is true for all Tegra3  platforms
  */
@@ -67,6 +75,29 @@ enum actmon_state {
 };
 struct actmon_dev;
 struct actmon_drv_data;
+
+/*
+ * Predictive governor state. Kept apart from actmon_dev so that a trace
+ * can be replayed through the same code without touching the device.
+ */
+struct actmon_predict_state {
+	unsigned long hist[ACTMON_PREDICT_HIST];
+	unsigned int nr_hist;
+	unsigned long predicted;
+	unsigned long target;
+};
+
+struct actmon_predict {
+	bool enable;
+	u32 period_ms;
+	u32 lookahead_ms;
+	u32 up_response_ms;
+	u32 down_response_ms;
+	struct actmon_predict_state state;
+	struct delayed_work work;
+	char *replay_out;
+	size_t replay_len;
+};
 struct dev_reg_ops {
 	void (*set_init_avg)(u32 value, void __iomem *base);
 	void (*set_avg_up_wm)(u32 value, void __iomem *base);
@@ -135,10 +166,13 @@ struct actmon_dev {
 	unsigned long (*actmon_dev_get_rate)(struct actmon_dev *);
 	unsigned long (*actmon_dev_post_change_rate)(struct actmon_dev *,
 			void *v);
+	/* rate in kHz the clock is held at by other clients, optional */
+	unsigned long (*actmon_dev_get_floor)(struct actmon_dev *);
 	void (*actmon_dev_clk_enable)(struct actmon_dev *);
 	spinlock_t lock;
 	struct notifier_block rate_change_nb;
 	struct kobj_attribute avgact_attr;
+	struct actmon_predict predict;
 };
 
 struct actmon_reg_ops {
@@ -190,6 +224,8 @@ static inline void actmon_dev_writel(void __iomem *base, u32
 #if defined(CONFIG_TEGRA_CENTRAL_ACTMON)
 int tegra_actmon_register(struct actmon_drv_data *actmon);
 int tegra_actmon_remove(struct platform_device *pdev);
+int tegra_actmon_get_load(enum actmon_devices index,
+		unsigned long *avg_khz, unsigned long *cur_khz);
 #else
 static inline int tegra_actmon_register(struct actmon_drv_data *actmon)
 {
@@ -200,5 +236,11 @@ static inline int tegra_actmon_remove(struct platform_device *pdev)
 {
 	return -EINVAL;
 }
+
+static inline int tegra_actmon_get_load(enum actmon_devices index,
+		unsigned long *avg_khz, unsigned long *cur_khz)
+{
+	return -ENODEV;
+}
 #endif
 #endif /* ACTMON_COMMON_H */
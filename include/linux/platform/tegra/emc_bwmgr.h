@@ -227,6 +227,29 @@ int tegra_bwmgr_get_client_info(struct tegra_bwmgr_client *handle,
 		unsigned long *out_val,
 		enum tegra_bwmgr_request_type req);
 
+/**
+ * tegra_bwmgr_get_client_demand - get the bandwidth a client currently asks
+ *			for, i.e. the larger of its floor and its shared
+ *			(iso and non-iso) bandwidth requests.
+ *
+ * @id		client id, need not be registered by the caller
+ *
+ * Returns the demand in MB/s, 0 if the client has no request.
+ */
+unsigned long tegra_bwmgr_get_client_demand(enum tegra_bwmgr_client_id id);
+
+/**
+ * tegra_bwmgr_get_floor_rate - get the EMC rate that is kept no matter what
+ *			@handle requests: the highest floor of the other
+ *			clients and the lowest rate that serves the iso
+ *			bandwidth.
+ *
+ * @handle	handle acquired during tegra_bwmgr_register
+ *
+ * Returns the rate in Hz.
+ */
+unsigned long tegra_bwmgr_get_floor_rate(struct tegra_bwmgr_client *handle);
+
 /**
  * tegra_bwmgr_notifier_register - register a notifier callback when
  *		emc rate changes. Must be called from non-atomic
@@ -379,6 +402,18 @@ static inline int tegra_bwmgr_get_client_info(struct tegra_bwmgr_client *handle,
 	return 0;
 }
 
+static inline unsigned long tegra_bwmgr_get_client_demand(
+		enum tegra_bwmgr_client_id id)
+{
+	return 0;
+}
+
+static inline unsigned long tegra_bwmgr_get_floor_rate(
+		struct tegra_bwmgr_client *handle)
+{
+	return 0;
+}
+
 static inline int tegra_bwmgr_notifier_register(struct notifier_block *nb)
 {
 	return 0;
@@ -51,6 +51,7 @@ struct isomgr_client {
 	s32 rsvd_mf;            /* reserved minimum freq in support of LT */
 	s32 real_mf;            /* realized minimum freq in support of LT */
 	s32 real_mf_rq;         /* real_mf requested */
+	s32 acct_mf;            /* max(rsvd_mf, real_mf) in isomgr.mf_sum */
 	tegra_isomgr_renegotiate renegotiate;   /* ask client to renegotiate */
 	bool realize;           /* bw realization in progress */
 	s32 sleep_bw;           /* sleeping for realize */
@@ -83,6 +84,26 @@ struct isomgr_client {
 #endif /* CONFIG_TEGRA_ISOMGR_SYSFS */
 };
 
+/* ISO clients are grouped this way when working out the EMC freq */
+enum isomgr_mf_class {
+	ISOMGR_MF_NVDIS,
+	ISOMGR_MF_VI,
+	ISOMGR_MF_OTHER,
+	ISOMGR_MF_CLASS_COUNT,
+};
+
+static inline enum isomgr_mf_class isomgr_mf_class(
+		enum tegra_iso_client client)
+{
+	if (client == TEGRA_ISO_CLIENT_DISP_0 ||
+	    client == TEGRA_ISO_CLIENT_DISP_1 ||
+	    client == TEGRA_ISO_CLIENT_DISP_2)
+		return ISOMGR_MF_NVDIS;
+	if (client == TEGRA_ISO_CLIENT_TEGRA_CAMERA)
+		return ISOMGR_MF_VI;
+	return ISOMGR_MF_OTHER;
+}
+
 struct isomgr {
 	struct mutex lock;              /* to lock ALL isomgr state */
 	struct task_struct *task;       /* check reentrant/mismatched locks */
@@ -99,6 +120,8 @@ struct isomgr {
 	s32 dedi_bw;                    /* total BW 'dedicated' to clients */
 	s32 sleep_bw;                   /* pending bw requirement */
 	u32 max_iso_bw;                 /* max ISO BW MC can accommodate */
+	u32 mf_sum[ISOMGR_MF_CLASS_COUNT]; /* sum of client acct_mf (KHz) */
+	bool camera_floor_rq;           /* camera max floor requested */
 	struct kobject *kobj;           /* for sysfs linkage */
 	struct isomgr_ops *ops;         /* ops structure for isomgr*/
 };
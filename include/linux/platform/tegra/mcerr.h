@@ -54,6 +54,7 @@
 struct platform_device;
 int tegra_mcerr_init(struct dentry *mc_paren, struct platform_device *pdev);
 irqreturn_t tegra_mc_handle_general_fault(int src_chan, int intstatus);
+bool mcerr_report(const char *fmt, ...) __printf(1, 2);
 
 /*
  * This describes errors that can be generated by the MC. One is defined for
@@ -150,11 +151,16 @@ struct mcerr_ops {
 	  .stat_reg = _stat_reg, .addr_reg = _addr_reg, \
 	  .addr_hi_reg = _addr_hi_reg}
 
+/*
+ * From the MC error interrupt thread the message only goes into the report
+ * being collected, which is printed later from a rate limited worker.
+ */
 #define mcerr_pr(fmt, ...)					\
 	do {							\
 		if (!mcerr_silenced) {				\
 			trace_printk(fmt, ##__VA_ARGS__);	\
-			pr_err(fmt, ##__VA_ARGS__);		\
+			if (!mcerr_report(fmt, ##__VA_ARGS__))	\
+				pr_err(fmt, ##__VA_ARGS__);	\
 		}						\
 	} while (0)
 
@@ -38,6 +38,13 @@ int tegra_hwtime_notifier_call_chain(unsigned int val, void *v);
  */
 int get_ptp_hwtime(u64 *ns);
 
+/*
+ * Convert a TSC timestamp in ns to PTP time, using a TSC to PTP
+ * correlation that is refreshed every 100 ms.
+ * If HW time source is not registered, returns -EINVAL
+ */
+int get_ptp_hwtime_from_tsc(u64 tsc_ns, u64 *ns);
+
 #else /* CONFIG_TEGRA_PTP_NOTIFIER */
 
 /* register / unregister HW time source */
@@ -77,6 +84,11 @@ static inline int get_ptp_hwtime(u64 *ns)
 	return -EINVAL;
 }
 
+static inline int get_ptp_hwtime_from_tsc(u64 tsc_ns, u64 *ns)
+{
+	return -EINVAL;
+}
+
 #endif /* CONFIG_TEGRA_PTP_NOTIFIER */
 
 #endif /* __PTP_NOTIFIER_H */
@@ -138,6 +138,8 @@ struct tegra_cbb_errlog_record {
 	bool		is_ax2apb_bridge_connected;
 	u64		*axi2abp_bases;
 	int		apb_bridge_cnt;
+	/* AXI2APB status captured at interrupt time, NULL to read it live */
+	u32		*apb_status;
 };
 
 struct tegra_cbb_noc_data {
@@ -113,4 +113,14 @@ int tegra_capture_ivc_unregister_control_cb(uint32_t id);
  */
 int tegra_capture_ivc_unregister_capture_cb(uint32_t chan_id);
 
+/*
+ * Select the CPU capture status callbacks of a channel are delivered on.
+ * Status for different channels is delivered in parallel, status for the
+ * same channel in order.
+ *
+ * @param[in] chan_id: client's channel id.
+ * @param[in] cpu: online CPU to run the callbacks on, or -1 for any CPU.
+ */
+int tegra_capture_ivc_capture_set_cpu(uint32_t chan_id, int cpu);
+
 #endif /* INCLUDE_CAPTURE_IVC_H */
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINUX_TEGRA_GPIO_H
+#define _LINUX_TEGRA_GPIO_H
+
+#include <linux/errno.h>
+#include <linux/types.h>
+
+#ifdef CONFIG_GPIO_TEGRA186
+/*
+ * TSC value sampled when the GPIO controller's interrupt for @irq was
+ * taken, i.e. before any handler of the line ran. Meant to be called from
+ * the line's hard IRQ handler; a threaded handler may already see the
+ * time of a later edge.
+ */
+int tegra_gpio_get_irq_tsc(unsigned int irq, u64 *tsc);
+#else
+static inline int tegra_gpio_get_irq_tsc(unsigned int irq, u64 *tsc)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif /* _LINUX_TEGRA_GPIO_H */
@@ -97,4 +97,14 @@ void tegra_hsp_sm_pair_free(struct tegra_hsp_sm_pair *);
 void tegra_hsp_sm_pair_write(struct tegra_hsp_sm_pair *, u32 value);
 bool tegra_hsp_sm_pair_is_empty(const struct tegra_hsp_sm_pair *);
 
+struct tegra_hsp_sm_chan;
+
+typedef void (*tegra_hsp_sm_chan_fn)(void *, u32);
+
+struct tegra_hsp_sm_chan *of_tegra_hsp_sm_chan_by_name(
+	struct device_node *np, char const *name, u8 tag,
+	tegra_hsp_sm_chan_fn, void *);
+void tegra_hsp_sm_chan_free(struct tegra_hsp_sm_chan *);
+int tegra_hsp_sm_chan_write(struct tegra_hsp_sm_chan *, u32 value);
+
 #endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINUX_TEGRA_PCIE_EDMA_H
+#define _LINUX_TEGRA_PCIE_EDMA_H
+
+#include <linux/dmaengine.h>
+#include <linux/err.h>
+
+struct device;
+struct tegra_pcie_edma;
+
+/*
+ * dmaengine provider for the DesignWare embedded DMA of the Tegra PCIe
+ * controllers, shared by the root port and endpoint drivers.
+ *
+ * Write channels move data from local memory to PCIe (DMA_MEM_TO_DEV),
+ * read channels from PCIe to local memory (DMA_DEV_TO_MEM). For slave
+ * transfers the PCIe side address comes from dma_slave_config and advances
+ * with each sg entry; memcpy takes both addresses as they are.
+ *
+ * The controller driver owns the registers and the interrupt: it calls
+ * tegra_pcie_edma_irq() when the eDMA interrupt is pending, and brackets
+ * any period where the controller is powered down with offline/online.
+ */
+#if IS_ENABLED(CONFIG_TEGRA_PCIE_EDMA)
+struct tegra_pcie_edma *tegra_pcie_edma_register(struct device *dev,
+						 void __iomem *regs);
+void tegra_pcie_edma_unregister(struct tegra_pcie_edma *edma);
+void tegra_pcie_edma_irq(struct tegra_pcie_edma *edma);
+void tegra_pcie_edma_online(struct tegra_pcie_edma *edma);
+void tegra_pcie_edma_offline(struct tegra_pcie_edma *edma);
+
+/* Request a free channel of the eDMA belonging to controller @dev */
+struct dma_chan *tegra_pcie_edma_request_chan(struct device *dev,
+					enum dma_transfer_direction dir);
+int tegra_pcie_edma_set_remote_irq(struct dma_chan *dc, u64 addr, u16 data);
+#else
+static inline struct tegra_pcie_edma *tegra_pcie_edma_register(
+		struct device *dev, void __iomem *regs)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline void tegra_pcie_edma_unregister(struct tegra_pcie_edma *edma)
+{
+}
+
+static inline void tegra_pcie_edma_irq(struct tegra_pcie_edma *edma)
+{
+}
+
+static inline void tegra_pcie_edma_online(struct tegra_pcie_edma *edma)
+{
+}
+
+static inline void tegra_pcie_edma_offline(struct tegra_pcie_edma *edma)
+{
+}
+
+static inline struct dma_chan *tegra_pcie_edma_request_chan(
+		struct device *dev, enum dma_transfer_direction dir)
+{
+	return NULL;
+}
+
+static inline int tegra_pcie_edma_set_remote_irq(struct dma_chan *dc,
+						 u64 addr, u16 data)
+{
+	return -ENODEV;
+}
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2018, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINUX_TEGRA_VNET_H
+#define _LINUX_TEGRA_VNET_H
+
+#include <linux/err.h>
+#include <linux/types.h>
+
+struct device;
+struct tegra_vnet_ep;
+
+/* What the PCIe endpoint controller hands to the virtual Ethernet function */
+struct tegra_vnet_ep_info {
+	struct device *dev;		/* controller, owner of the eDMA */
+	void *bar_virt;			/* memory behind BAR0 */
+	size_t bar_size;
+	void __iomem *dbi_base;		/* own config space, for the MSI */
+};
+
+#if IS_ENABLED(CONFIG_TEGRA_VNET_EP)
+struct tegra_vnet_ep *tegra_vnet_ep_register(
+		const struct tegra_vnet_ep_info *info);
+void tegra_vnet_ep_unregister(struct tegra_vnet_ep *vep);
+#else
+static inline struct tegra_vnet_ep *tegra_vnet_ep_register(
+		const struct tegra_vnet_ep_info *info)
+{
+	return ERR_PTR(-ENODEV);
+}
+
+static inline void tegra_vnet_ep_unregister(struct tegra_vnet_ep *vep)
+{
+}
+#endif
+
+#endif
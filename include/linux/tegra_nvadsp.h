@@ -66,6 +66,10 @@ status_t nvadsp_arb_sema_release(nvadsp_arb_sema_t *);
 
 /*
  * Mailbox Queue
+ *
+ * Single producer (the mailbox interrupt) and single consumer (the
+ * nvadsp_mbox_recv() caller), so no lock is taken. head and tail are
+ * free running, the slot is the index masked by the queue size.
  */
 #define NVADSP_MBOX_QUEUE_SIZE		32
 #define NVADSP_MBOX_QUEUE_SIZE_MASK	(NVADSP_MBOX_QUEUE_SIZE - 1)
@@ -73,9 +77,7 @@ struct nvadsp_mbox_queue {
 	uint32_t array[NVADSP_MBOX_QUEUE_SIZE];
 	uint16_t head;
 	uint16_t tail;
-	uint16_t count;
-	struct completion comp;
-	spinlock_t lock;
+	wait_queue_head_t wait;
 };
 
 status_t nvadsp_mboxq_enqueue(struct nvadsp_mbox_queue *, uint32_t);
@@ -109,6 +111,12 @@ status_t nvadsp_mbox_send(struct nvadsp_mbox *mbox, uint32_t data,
 			  uint32_t flags, bool block, unsigned int timeout);
 status_t nvadsp_mbox_recv(struct nvadsp_mbox *mbox, uint32_t *data, bool block,
 			  unsigned int timeout);
+/* Batched variants, return the number of words moved or an error */
+int nvadsp_mbox_send_vec(struct nvadsp_mbox *mbox, const uint32_t *data,
+			 unsigned int count, uint32_t flags, bool block,
+			 unsigned int timeout);
+int nvadsp_mbox_recv_vec(struct nvadsp_mbox *mbox, uint32_t *data,
+			 unsigned int count, bool block, unsigned int timeout);
 status_t nvadsp_mbox_close(struct nvadsp_mbox *mbox);
 
 #ifdef CONFIG_MBOX_ACK_HANDLER
@@ -294,6 +302,7 @@ typedef struct nvadsp_app_info {
 	struct work_struct complete_work;
 	enum adsp_app_status_msg status_msg;
 	void *priv;
+	uint32_t cycle_budget; /* in KHz, see nvadsp_app_set_cycle_budget */
 } nvadsp_app_info_t;
 
 nvadsp_app_handle_t __must_check nvadsp_app_load(const char *, const char *);
@@ -303,8 +312,10 @@ void nvadsp_app_unload(nvadsp_app_handle_t);
 int __must_check nvadsp_app_start(nvadsp_app_info_t *);
 int nvadsp_app_stop(nvadsp_app_info_t *);
 int nvadsp_app_deinit(nvadsp_app_info_t *);
+int nvadsp_app_set_cycle_budget(nvadsp_app_info_t *, uint32_t);
 void *nvadsp_alloc_coherent(size_t, dma_addr_t *, gfp_t);
 void nvadsp_free_coherent(size_t, void *, dma_addr_t);
+int nvadsp_mmap_coherent(struct vm_area_struct *, void *, dma_addr_t, size_t);
 nvadsp_app_info_t __must_check *nvadsp_run_app(nvadsp_os_handle_t, const char *,
 	nvadsp_app_args_t *, app_complete_status_notifier, uint32_t, bool);
 void nvadsp_exit_app(nvadsp_app_info_t *app, bool terminate);
@@ -375,6 +386,16 @@ void adsp_update_dfs_min_rate(unsigned long freq);
 
 /* Enable / disable dynamic freq scaling */
 void adsp_update_dfs(bool enable);
+
+/*
+ * Governor hints, see adsp_dfs.c
+ * adsp_dfs_set_budget: an app cycle budget changed, in KHz
+ * adsp_dfs_report_fill: level in percent of a buffer the ADSP must feed
+ * adsp_dfs_report_underrun: a deadline was missed
+ */
+void adsp_dfs_set_budget(unsigned long old_khz, unsigned long new_khz);
+void adsp_dfs_report_fill(unsigned int fill_pct);
+void adsp_dfs_report_underrun(void);
 #else
 static inline unsigned long adsp_override_freq(unsigned long freq)
 {
@@ -390,6 +411,19 @@ static inline void adsp_update_dfs(bool enable)
 {
 	return;
 }
+
+static inline void adsp_dfs_set_budget(unsigned long old_khz,
+				       unsigned long new_khz)
+{
+}
+
+static inline void adsp_dfs_report_fill(unsigned int fill_pct)
+{
+}
+
+static inline void adsp_dfs_report_underrun(void)
+{
+}
 #endif
 
 void *nvadsp_aram_request(const char *name, size_t size);
@@ -19,8 +19,8 @@
 
 #include <linux/ioctl.h>
 
-#define QUADD_SAMPLES_VERSION	43
-#define QUADD_IO_VERSION	25
+#define QUADD_SAMPLES_VERSION	44
+#define QUADD_IO_VERSION	26
 
 #define QUADD_IO_VERSION_DYNAMIC_RB		5
 #define QUADD_IO_VERSION_RB_MAX_FILL_COUNT	6
@@ -43,6 +43,7 @@
 #define QUADD_IO_VERSION_SAMPLING_MODE		23
 #define QUADD_IO_VERSION_FORCE_ARCH_TIMER	24
 #define QUADD_IO_VERSION_SAMPLE_ALL_TASKS	25
+#define QUADD_IO_VERSION_AGGREGATION		26
 
 #define QUADD_SAMPLE_VERSION_THUMB_MODE_FLAG		17
 #define QUADD_SAMPLE_VERSION_GROUP_SAMPLES		18
@@ -176,6 +177,7 @@ enum quadd_record_type {
 	QUADD_RECORD_TYPE_ADDITIONAL_SAMPLE,
 	QUADD_RECORD_TYPE_SCHED,
 	QUADD_RECORD_TYPE_HOTPLUG,
+	QUADD_RECORD_TYPE_AGGR_SAMPLE,
 };
 
 enum quadd_event_source {
@@ -293,6 +295,27 @@ struct quadd_hotplug_data {
 	    reserved:31;
 };
 
+/*
+ * Summary of identical samples seen on one CPU during one aggregation
+ * interval, followed by callchain_nr u32 or u64 (is_ip64) addresses.
+ */
+struct quadd_aggr_sample_data {
+	u64 ip;
+	u32 pid;
+	u32 tgid;
+	u64 time;
+
+	u32 count;
+
+	u16	cpu:6,
+		user_mode:1,
+		thumb_mode:1,
+		is_ip64:1,
+		reserved:7;
+
+	u8 callchain_nr;
+};
+
 struct quadd_additional_sample {
 	u8 type;
 
@@ -365,6 +388,7 @@ struct quadd_debug_data {
 #define QUADD_HDR_MODE_SAMPLE_ALL	(1 << 10)
 #define QUADD_HDR_MODE_SAMPLE_TREE	(1 << 11)
 #define QUADD_HDR_MODE_TRACE_TREE	(1 << 12)
+#define QUADD_HDR_AGGREGATION		(1 << 13)
 
 struct quadd_header_data {
 	u16 magic;
@@ -401,6 +425,7 @@ struct quadd_record_data {
 		struct quadd_hotplug_data	hotplug;
 		struct quadd_sched_data		sched;
 		struct quadd_additional_sample	additional_sample;
+		struct quadd_aggr_sample_data	aggr_sample;
 	};
 } __aligned(4);
 
@@ -412,6 +437,7 @@ enum {
 	QUADD_PARAM_IDX_SIZE_OF_RB	= 0,
 	QUADD_PARAM_IDX_EXTRA		= 1,
 	QUADD_PARAM_IDX_BT_LOWER_BOUND	= 2,
+	QUADD_PARAM_IDX_AGGR_INTERVAL	= 3,	/* ms, 0: default */
 };
 
 #define QUADD_PARAM_EXTRA_GET_MMAP		(1 << 0)
@@ -429,6 +455,7 @@ enum {
 #define QUADD_PARAM_EXTRA_SAMPLE_TREE		(1 << 12)
 #define QUADD_PARAM_EXTRA_TRACING		(1 << 13)
 #define QUADD_PARAM_EXTRA_TRACE_TREE		(1 << 14)
+#define QUADD_PARAM_EXTRA_AGGREGATION		(1 << 15)
 
 enum {
 	QUADD_EVENT_TYPE_RAW		= 0,
@@ -508,6 +535,7 @@ enum {
 #define QUADD_COMM_CAP_EXTRA_RB_MMAP_OP		(1 << 9)
 #define QUADD_COMM_CAP_EXTRA_CPU_MASK		(1 << 10)
 #define QUADD_COMM_CAP_EXTRA_ARCH_TIMER_USR	(1 << 11)
+#define QUADD_COMM_CAP_EXTRA_AGGREGATION	(1 << 12)
 
 struct quadd_comm_cap {
 	u32	pmu:1,
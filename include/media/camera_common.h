@@ -105,6 +105,12 @@ regmap_util_write_table_8(struct regmap *regmap,
 			  int num_override_regs,
 			  u16 wait_ms_addr, u16 end_addr);
 
+int
+regmap_util_write_table_8_delta(struct regmap *regmap,
+				const struct reg_8 cur[],
+				const struct reg_8 next[],
+				u16 wait_ms_addr, u16 end_addr);
+
 int
 regmap_util_write_table_16_as_8(struct regmap *regmap,
 				const struct reg_16 table[],
@@ -225,6 +231,8 @@ struct camera_common_data {
 	int	sensor_mode_id;
 	bool	use_sensor_mode_id;
 	bool	override_enable;
+	/* mode_prop_idx last written to the sensor, -1 if unknown */
+	int	programmed_mode_idx;
 };
 
 struct camera_common_focuser_data;
@@ -324,6 +332,11 @@ int camera_common_get_framesync(struct v4l2_subdev *sd,
 int camera_common_initialize(struct camera_common_data *s_data,
 		const char *dev_name);
 void camera_common_cleanup(struct camera_common_data *s_data);
+bool camera_common_mode_switch_is_delta(struct camera_common_data *s_data,
+		int from_idx, int to_idx);
+int camera_common_write_mode_table_8(struct camera_common_data *s_data,
+		struct reg_8 *const mode_table[], int common_mode,
+		u16 wait_ms_addr, u16 end_addr);
 
 /* Focuser */
 int camera_common_focuser_init(struct camera_common_focuser_data *s_data);
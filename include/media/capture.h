@@ -29,12 +29,14 @@
 #define __VI_CAPTURE_ALIGN __aligned(8)
 
 struct tegra_vi_channel;
+struct vi_capture_gang;
 
 struct vi_capture {
 	uint16_t channel_id;
 	struct device *rtcpu_dev;
 	struct tegra_vi_channel *vi_channel;
 	struct capture_common_buf requests;
+	struct capture_common_buf_pool buffer_pool;
 	size_t request_buf_size;
 	uint32_t queue_depth;
 	uint32_t request_size;
@@ -51,6 +53,10 @@ struct vi_capture {
 	struct syncpoint_info embdata_sp;
 	struct syncpoint_info linetimer_sp;
 
+	/* channels in the same non-zero gang share progress_sp */
+	uint32_t gang_id;
+	struct vi_capture_gang *gang;
+
 	struct completion control_resp;
 	struct completion capture_resp;
 	struct mutex control_msg_lock;
@@ -58,6 +64,10 @@ struct vi_capture {
 
 	struct mutex unpins_list_lock;
 	struct capture_common_unpins **unpins_list;
+
+	/* called after each capture status, from the IVC worker */
+	void (*status_notify)(void *data, uint32_t buffer_index);
+	void *status_notify_data;
 };
 
 struct vi_capture_setup {
@@ -120,6 +130,8 @@ int vi_capture_setup(struct tegra_vi_channel *chan,
 		struct vi_capture_setup *setup);
 int vi_capture_reset(struct tegra_vi_channel *chan,
 		uint32_t reset_flags);
+int vi_capture_recover(struct tegra_vi_channel *chan,
+		uint32_t buffer_index);
 int vi_capture_release(struct tegra_vi_channel *chan,
 		uint32_t reset_flags);
 int vi_capture_get_info(struct tegra_vi_channel *chan,
@@ -130,6 +142,11 @@ int vi_capture_request(struct tegra_vi_channel *chan,
 		struct vi_capture_req *req);
 int vi_capture_status(struct tegra_vi_channel *chan,
 		int32_t timeout_ms);
+void vi_capture_set_status_notify(struct tegra_vi_channel *chan,
+		void (*notify)(void *data, uint32_t buffer_index), void *data);
+int vi_capture_set_buffer_pool(struct tegra_vi_channel *chan,
+		struct capture_buffer_pool_req *req);
+int vi_capture_set_gang(struct tegra_vi_channel *chan, uint32_t gang_id);
 int vi_capture_set_compand(struct tegra_vi_channel *chan,
 		struct vi_capture_compand *compand);
 long vi_capture_ioctl(struct file *file, void *fh,
@@ -26,6 +26,27 @@ struct capture_common_unpins {
 	struct capture_common_buf data[];
 };
 
+/*
+ * Buffers pinned once, before the channel is set up, and kept mapped until
+ * the pool is released. A surface whose mem handle has
+ * CAPTURE_BUFFER_POOL_SLOT set refers to a pool slot rather than to a
+ * dma-buf fd, and is relocated without pinning anything.
+ */
+#define CAPTURE_BUFFER_POOL_SLOT (1U << 31)
+#define CAPTURE_BUFFER_POOL_MAX_SLOTS 64
+
+struct capture_common_buf_pool {
+	uint32_t num_slots;
+	struct capture_common_buf *slots;
+};
+
+/* userspace description of a buffer pool, num_buffers 0 releases it */
+struct capture_buffer_pool_req {
+	uint64_t mems;		/* user pointer to num_buffers mem handles */
+	uint32_t num_buffers;
+	uint32_t __pad;
+} __aligned(8);
+
 struct capture_common_pin_req {
 	struct device *dev;
 	struct device *rtcpu_dev;
@@ -37,6 +58,7 @@ struct capture_common_pin_req {
 	uint32_t requests_mem;
 	uint32_t num_relocs;
 	uint32_t __user *reloc_user;
+	struct capture_common_buf_pool *pool;
 };
 
 int capture_common_pin_memory(struct device *dev,
@@ -45,3 +67,9 @@ int capture_common_pin_memory(struct device *dev,
 void capture_common_unpin_memory(struct capture_common_buf *unpin_data);
 
 int capture_common_request_pin_and_reloc(struct capture_common_pin_req *req);
+
+int capture_common_buf_pool_setup(struct device *dev,
+		struct capture_common_buf_pool *pool,
+		const struct capture_buffer_pool_req *req);
+
+void capture_common_buf_pool_release(struct capture_common_buf_pool *pool);
@@ -80,6 +80,8 @@ struct isp_capture_req_ex {
 	uint32_t __pad[4];
 } __ISP_CAPTURE_ALIGN;
 
+struct capture_buffer_pool_req;
+
 int isp_capture_init(struct tegra_isp_channel *chan);
 void isp_capture_shutdown(struct tegra_isp_channel *chan);
 int isp_capture_setup(struct tegra_isp_channel *chan,
@@ -99,4 +101,6 @@ int isp_capture_program_request(struct tegra_isp_channel *chan,
 int isp_capture_program_status(struct tegra_isp_channel *chan);
 int isp_capture_request_ex(struct tegra_isp_channel *chan,
 		struct isp_capture_req_ex *capture_req_ex);
+int isp_capture_set_buffer_pool(struct tegra_isp_channel *chan,
+		struct capture_buffer_pool_req *req);
 #endif
@@ -52,6 +52,23 @@ enum channel_capture_state {
 	CAPTURE_ERROR,
 };
 
+/* log2 buckets of microseconds, the last one takes everything above */
+#define TEGRA_CHANNEL_LATENCY_BUCKETS	20
+
+enum tegra_channel_latency_stage {
+	TEGRA_CHANNEL_LATENCY_SOF_EOF = 0,
+	TEGRA_CHANNEL_LATENCY_EOF_STATUS,
+	TEGRA_CHANNEL_LATENCY_STATUS_DONE,
+	TEGRA_CHANNEL_LATENCY_STAGES,
+};
+
+struct tegra_channel_latency {
+	u32 buckets[TEGRA_CHANNEL_LATENCY_BUCKETS];
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
 enum tegra_vi_pg_mode {
 	TEGRA_VI_PG_DISABLED = 0,
 	TEGRA_VI_PG_DIRECT,
@@ -182,8 +199,11 @@ struct tegra_channel {
 	struct task_struct *kthread_release;
 	wait_queue_head_t start_wait;
 	wait_queue_head_t release_wait;
-	struct task_struct *kthread_capture_dequeue;
 	wait_queue_head_t dequeue_wait;
+	struct list_head capture_engine_entry;
+	unsigned long capture_deadline;
+	int capture_err;
+	bool capture_stopping;
 	struct vb2_queue queue;
 	void *alloc_ctx;
 	bool init_done;
@@ -224,6 +244,7 @@ struct tegra_channel {
 	bool bypass;
 	bool write_ispformat;
 	bool low_latency;
+	bool ptp_timestamp;
 	enum tegra_vi_pg_mode pg_mode;
 	bool bfirst_fstart;
 	enum channel_capture_state capture_state;
@@ -246,6 +267,11 @@ struct tegra_channel {
 	struct tegra_vi_channel *tegra_vi_channel;
 	struct capture_descriptor *request;
 	bool is_slvsec;
+
+	/* TSC time each capture status arrived, per request slot */
+	u64 capture_status_ts[CAPTURE_QUEUE_DEPTH];
+	struct tegra_channel_latency latency[TEGRA_CHANNEL_LATENCY_STAGES];
+	struct dentry *debugdir;
 };
 
 #define to_tegra_channel(vdev) \
@@ -365,6 +391,10 @@ void release_buffer(struct tegra_channel *chan,
 			struct tegra_channel_buffer *buf);
 void set_timestamp(struct tegra_channel_buffer *buf,
 			const struct timespec *ts);
+void set_ptp_timestamp(struct tegra_channel_buffer *buf, u64 tsc_ns);
+void tegra_channel_latency_record(struct tegra_channel *chan,
+			enum tegra_channel_latency_stage stage,
+			u64 start_ns, u64 end_ns);
 void enqueue_inflight(struct tegra_channel *chan,
 			struct tegra_channel_buffer *buf);
 struct tegra_channel_buffer *dequeue_inflight(struct tegra_channel *chan);
@@ -380,6 +410,7 @@ struct tegra_vi_fops {
 	long (*vi_default_ioctl)(struct file *file, void *fh,
 			bool use_prio, unsigned int cmd, void *arg);
 	int (*vi_mfi_work)(struct tegra_mc_vi *vi, int port);
+	void (*vi_buffer_queued)(struct tegra_channel *chan);
 };
 
 struct tegra_csi_fops {
@@ -197,6 +197,20 @@ int tegra_ivc_rpc_call(
 	struct tegra_ivc_channel *chan,
 	const struct tegra_ivc_rpc_call_param *param);
 
+/*
+ * Batched remote procedure call
+ *
+ * Sends all independent requests in params without waiting for each
+ * response, then blocks until every one of them has been answered or has
+ * timed out. The callback field of each entry must be NULL. Per-call
+ * results are stored in rets when it is not NULL. Returns 0 when all
+ * calls succeeded, otherwise the first error in params order.
+ */
+int tegra_ivc_rpc_call_batch(
+	struct tegra_ivc_channel *chan,
+	const struct tegra_ivc_rpc_call_param *params,
+	int *rets, unsigned int count);
+
 static inline int tegra_ivc_rpc_call_pl(
 	struct tegra_ivc_channel *chan,
 	uint32_t request_id, uint32_t request_len, void *request,
@@ -0,0 +1,63 @@
+/*
+ * Central actmon event logging to ftrace.
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM actmon
+
+#if !defined(_TRACE_ACTMON_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_ACTMON_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(tegra_actmon_predict,
+	TP_PROTO(
+		const char *dev,
+		unsigned long avg,
+		unsigned long floor,
+		unsigned long predicted,
+		unsigned long target
+	),
+
+	TP_ARGS(dev, avg, floor, predicted, target),
+
+	TP_STRUCT__entry(
+		__field(const char *, dev)
+		__field(unsigned long, avg)
+		__field(unsigned long, floor)
+		__field(unsigned long, predicted)
+		__field(unsigned long, target)
+	),
+
+	TP_fast_assign(
+		__entry->dev = dev;
+		__entry->avg = avg;
+		__entry->floor = floor;
+		__entry->predicted = predicted;
+		__entry->target = target;
+	),
+
+	TP_printk("%s: avg=%lu floor=%lu predicted=%lu target=%lu (kHz)",
+		__entry->dev,
+		__entry->avg,
+		__entry->floor,
+		__entry->predicted,
+		__entry->target
+	)
+);
+
+#endif /* _TRACE_ACTMON_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
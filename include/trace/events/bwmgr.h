@@ -74,6 +74,66 @@ TRACE_EVENT(tegra_bwmgr_update_efficiency,
 	)
 );
 
+TRACE_EVENT(tegra_bwmgr_update_clk,
+	TP_PROTO(
+		unsigned long rate,
+		unsigned long prev_rate,
+		const char *reason,
+		const char *client
+	),
+
+	TP_ARGS(rate, prev_rate, reason, client),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, rate)
+		__field(unsigned long, prev_rate)
+		__field(const char *, reason)
+		__field(const char *, client)
+	),
+
+	TP_fast_assign(
+		__entry->rate = rate;
+		__entry->prev_rate = prev_rate;
+		__entry->reason = reason;
+		__entry->client = client;
+	),
+
+	TP_printk("emc rate %lu -> %lu, reason=%s, client=%s",
+		__entry->prev_rate,
+		__entry->rate,
+		__entry->reason,
+		__entry->client
+	)
+);
+
+TRACE_EVENT(tegra_bwmgr_dominant,
+	TP_PROTO(
+		const char *client,
+		unsigned long demand,
+		unsigned long rate
+	),
+
+	TP_ARGS(client, demand, rate),
+
+	TP_STRUCT__entry(
+		__field(const char *, client)
+		__field(unsigned long, demand)
+		__field(unsigned long, rate)
+	),
+
+	TP_fast_assign(
+		__entry->client = client;
+		__entry->demand = demand;
+		__entry->rate = rate;
+	),
+
+	TP_printk("dominant client=%s, demand=%lu, emc rate=%lu",
+		__entry->client,
+		__entry->demand,
+		__entry->rate
+	)
+);
+
 #endif /* _TRACE_BWMGR_H */
 
 /* This part must be outside protection */
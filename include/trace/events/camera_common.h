@@ -136,6 +136,23 @@ DEFINE_EVENT(frame, tegra_channel_capture_done,
 	TP_PROTO(const char *str, struct timespec ts),
 	TP_ARGS(str, ts)
 );
+
+TRACE_EVENT(tegra_channel_capture_recover,
+	TP_PROTO(unsigned int index, u32 status, s64 duration_ns),
+	TP_ARGS(index, status, duration_ns),
+	TP_STRUCT__entry(
+		__field(unsigned int,	index)
+		__field(u32,		status)
+		__field(s64,		duration_ns)
+	),
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->status = status;
+		__entry->duration_ns = duration_ns;
+	),
+	TP_printk("slot %u status %u recovered in %lld ns",
+		  __entry->index, __entry->status, __entry->duration_ns)
+);
 #endif
 
 /* This part must be outside protection */
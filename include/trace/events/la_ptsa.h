@@ -0,0 +1,67 @@
+/*
+ * LA/PTSA event logging to ftrace.
+ *
+ * Copyright (c) 2018, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM la_ptsa
+
+#if !defined(_TRACE_LA_PTSA_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LA_PTSA_H
+
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(tegra_la_niso_ptsa,
+	TP_PROTO(
+		const char *dda,
+		const char *group,
+		unsigned int base,
+		unsigned int prev_rate,
+		unsigned int rate,
+		unsigned int load
+	),
+
+	TP_ARGS(dda, group, base, prev_rate, rate, load),
+
+	TP_STRUCT__entry(
+		__field(const char *, dda)
+		__field(const char *, group)
+		__field(unsigned int, base)
+		__field(unsigned int, prev_rate)
+		__field(unsigned int, rate)
+		__field(unsigned int, load)
+	),
+
+	TP_fast_assign(
+		__entry->dda = dda;
+		__entry->group = group;
+		__entry->base = base;
+		__entry->prev_rate = prev_rate;
+		__entry->rate = rate;
+		__entry->load = load;
+	),
+
+	TP_printk("%s (%s): ptsa rate 0x%x -> 0x%x, base=0x%x, mc load=%u%%",
+		__entry->dda,
+		__entry->group,
+		__entry->prev_rate,
+		__entry->rate,
+		__entry->base,
+		__entry->load
+	)
+);
+
+#endif /* _TRACE_LA_PTSA_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -77,6 +77,69 @@ struct nvhost_vpu_perf_counter {
 	u32 maximum;
 } __packed;
 
+/* Retired job with the time it reached each stage of the submit path */
+struct nvhost_job_stages {
+	/* Engine class ID */
+	u32 class_id;
+
+	/* Syncpoint ID */
+	u32 syncpt_id;
+
+	/* Threshold for task completion */
+	u32 syncpt_thresh;
+
+	/* Submit ioctl started processing the job */
+	u64 submit;
+
+	/* Job memory pinned */
+	u64 pinned;
+
+	/* Job pushed to CDMA */
+	u64 pushed;
+
+	/* Engine started the job, 0 if engine timestamps are not enabled */
+	u64 hw_start;
+
+	/* Syncpoint threshold interrupt handled */
+	u64 syncpt_done;
+} __packed;
+
+/* Completed PVA task with the time spent in each stage, in TSC ticks */
+struct nvhost_pva_task_perf {
+	/* Engine class ID */
+	u32 class_id;
+
+	/* Syncpoint ID */
+	u32 syncpt_id;
+
+	/* Threshold for task completion */
+	u32 syncpt_thresh;
+
+	/* VPU Operation ID */
+	u32 operation;
+
+	/* VPU the task ran on */
+	u32 vpu;
+
+	/* Waiting behind earlier tasks of the queue */
+	u64 queue_wait;
+
+	/* Running input actions, including pre-fence waits */
+	u64 input_actions;
+
+	/* Waiting for a VPU to become available */
+	u64 vpu_wait;
+
+	/* Between VPU assignment and the start of execution */
+	u64 vpu_setup;
+
+	/* VPU execution */
+	u64 vpu_run;
+
+	/* Running output actions */
+	u64 output_actions;
+} __packed;
+
 enum {
 	/* struct nvhost_task_submit */
 	NVHOST_TASK_SUBMIT = 0,
@@ -90,7 +153,13 @@ enum {
 	/* struct nvhost_vpu_perf_counter */
 	NVHOST_VPU_PERF_COUNTER = 3,
 
-	NVHOST_NUM_EVENT_TYPES = 4
+	/* struct nvhost_job_stages */
+	NVHOST_JOB_STAGES = 4,
+
+	/* struct nvhost_pva_task_perf */
+	NVHOST_PVA_TASK_PERF = 5,
+
+	NVHOST_NUM_EVENT_TYPES = 6
 };
 
 enum {
@@ -186,7 +186,7 @@ struct pva_fence {
 	__u32 semaphore_value;
 };
 
-#define PVA_MAX_TASKS			1
+#define PVA_MAX_TASKS			8
 #define PVA_MAX_PREFENCES		8
 #define PVA_MAX_POSTFENCES		8
 #define PVA_MAX_INPUT_STATUS		8
@@ -264,6 +264,150 @@ struct pva_ioctl_submit_args {
 	__u32 version;
 };
 
+/*
+ * Chain the tasks in DMA memory and notify the firmware once for all of
+ * them. Without PVA_SUBMIT_FLAG_BATCH_FENCE every task still completes,
+ * and gets its post-fences, on its own; with it the whole batch completes
+ * at once and all tasks get the fences of the last one. Only supported in
+ * the CCQ submit modes, otherwise the tasks are submitted one by one.
+ */
+#define PVA_SUBMIT_FLAG_BATCH		(1 << 0)
+#define PVA_SUBMIT_FLAG_BATCH_FENCE	(1 << 1)
+
+/**
+ * struct pva_ioctl_buffer_args - register or unregister a buffer
+ *
+ * @handle: Memory handle of the buffer to register
+ * @id: Buffer id, returned on register and given on unregister
+ *
+ * A registered buffer stays mapped with the same address until it is
+ * unregistered or the file is closed. Tasks refer to it with
+ * PVA_REGISTERED_HANDLE(id) in place of a memory handle, which skips
+ * resolving and pinning the handle on each submit.
+ *
+ */
+struct pva_ioctl_buffer_args {
+	__u32 handle;
+	__u32 id;
+};
+
+#define PVA_REGISTERED_HANDLE_FLAG	(1U << 31)
+#define PVA_REGISTERED_HANDLE(id)	(PVA_REGISTERED_HANDLE_FLAG | (id))
+
+#define PVA_MAX_TEMPLATES		16
+
+/**
+ * struct pva_ioctl_template_args - register or unregister a task template
+ *
+ * @task: Pointer to a struct pva_ioctl_submit_task describing the template
+ * @id: Template id, returned on register and given on unregister
+ * @reserved: Reserved for future usage. Must be 0.
+ *
+ * A template fixes everything about a task except its surface buffers and
+ * fences. The scalars, task status and pointers of the template are pinned
+ * once at registration and the opaque data is rendered once. The fences and
+ * the surface handles of the template task are ignored.
+ *
+ */
+struct pva_ioctl_template_args {
+	__u64 task;
+	__u32 id;
+	__u32 reserved;
+};
+
+/**
+ * struct pva_template_surface - per-submit buffer of a template surface
+ *
+ * @surface_handle: Memory handle of the surface
+ * @surface_offset: Offset of the surface in the buffer
+ * @roi_handle: Memory handle of the ROI or 0
+ * @roi_offset: Offset of the ROI in the buffer
+ *
+ * The surface layout is taken from the template.
+ */
+struct pva_template_surface {
+	__u32 surface_handle;
+	__u32 surface_offset;
+	__u32 roi_handle;
+	__u32 roi_offset;
+};
+
+/**
+ * struct pva_ioctl_template_task - a task created from a template
+ *
+ * @template_id: Id of a registered template
+ * @num_prefences: Number of pre-fences in this task
+ * @num_postfences: Number of post-fences in this task
+ * @num_input_surfaces: Number of input surfaces, must match the template
+ * @num_output_surfaces: Number of output surfaces, must match the template
+ * @prefences: Pointer to pre-fence structures
+ * @postfences: Pointer to post-fence structures, updated on submit
+ * @input_surfaces: Pointer to struct pva_template_surface for each input
+ * @output_surfaces: Pointer to struct pva_template_surface for each output
+ *
+ */
+struct pva_ioctl_template_task {
+	__u32 template_id;
+	__u8 num_prefences;
+	__u8 num_postfences;
+	__u8 num_input_surfaces;
+	__u8 num_output_surfaces;
+	__u64 prefences;
+	__u64 postfences;
+	__u64 input_surfaces;
+	__u64 output_surfaces;
+};
+
+/**
+ * struct pva_ioctl_submit_template_args - submit tasks created from templates
+ *
+ * @tasks: Pointer to a list of struct pva_ioctl_template_task
+ * @flags: Flags for the given tasks, as in struct pva_ioctl_submit_args
+ * @num_tasks: Number of tasks in the list
+ * @reserved: Reserved for future usage. Must be 0.
+ *
+ */
+struct pva_ioctl_submit_template_args {
+	__u64 tasks;
+	__u16 flags;
+	__u16 num_tasks;
+	__u32 reserved;
+};
+
+/**
+ * struct pva_ioctl_perf_counters - stream VPU performance data
+ *
+ * @enable: Non-zero to collect performance data for tasks submitted
+ *          from now on through this file
+ * @reserved: Reserved for future usage. Must be 0.
+ *
+ * Each completed task then emits a pva_task_perf event with its stage
+ * timings and the non-empty VPU performance counters as vpu_perf_counter
+ * events into the eventlib ring of the device.
+ *
+ */
+struct pva_ioctl_perf_counters {
+	__u32 enable;
+	__u32 reserved;
+};
+
+/**
+ * struct pva_ioctl_completion_poll - select how task completion is waited on
+ *
+ * @poll_us: Polling budget in usecs, 0 for interrupt driven completion
+ * @reserved: Reserved for future usage. Must be 0.
+ *
+ * With a non-zero budget a wait on the queue syncpoint polls it for up to
+ * @poll_us before sleeping on the interrupt, trading CPU time for wake-up
+ * latency on short tasks. The budget is capped at PVA_MAX_POLL_US.
+ *
+ */
+struct pva_ioctl_completion_poll {
+#define PVA_MAX_POLL_US	2000
+	__u32 poll_us;
+	__u32 reserved;
+};
+
 /**
  * struct pva_ioctl_queue_attr - set queue attributes
  *
@@ -343,9 +487,23 @@ struct pva_ioctl_rate {
 	_IOWR(NVHOST_PVA_IOCTL_MAGIC, 7, struct pva_ioctl_rate)
 #define PVA_IOCTL_GET_RATE	\
 	_IOWR(NVHOST_PVA_IOCTL_MAGIC, 8, struct pva_ioctl_rate)
+#define PVA_IOCTL_REGISTER_TEMPLATE	\
+	_IOWR(NVHOST_PVA_IOCTL_MAGIC, 9, struct pva_ioctl_template_args)
+#define PVA_IOCTL_UNREGISTER_TEMPLATE	\
+	_IOW(NVHOST_PVA_IOCTL_MAGIC, 10, struct pva_ioctl_template_args)
+#define PVA_IOCTL_SUBMIT_TEMPLATE	\
+	_IOW(NVHOST_PVA_IOCTL_MAGIC, 11, struct pva_ioctl_submit_template_args)
+#define PVA_IOCTL_REGISTER_BUFFER	\
+	_IOWR(NVHOST_PVA_IOCTL_MAGIC, 12, struct pva_ioctl_buffer_args)
+#define PVA_IOCTL_UNREGISTER_BUFFER	\
+	_IOW(NVHOST_PVA_IOCTL_MAGIC, 13, struct pva_ioctl_buffer_args)
+#define PVA_IOCTL_SET_PERF_COUNTERS	\
+	_IOW(NVHOST_PVA_IOCTL_MAGIC, 14, struct pva_ioctl_perf_counters)
+#define PVA_IOCTL_SET_COMPLETION_POLL	\
+	_IOW(NVHOST_PVA_IOCTL_MAGIC, 15, struct pva_ioctl_completion_poll)
 
 
-#define NVHOST_PVA_IOCTL_LAST _IOC_NR(PVA_IOCTL_GET_RATE)
+#define NVHOST_PVA_IOCTL_LAST _IOC_NR(PVA_IOCTL_SET_COMPLETION_POLL)
 #define NVHOST_PVA_IOCTL_MAX_ARG_SIZE sizeof(struct pva_characteristics_req)
 
 #endif /* __LINUX_NVHOST_PVA_IOCTL_H */
@@ -172,6 +172,8 @@
 #define TEGRA_DC_EXT_FLIP_HEAD_FLAG_VRR_MODE	(1 << 1)
 /* Flag to notify attr v2 struct is being used */
 #define TEGRA_DC_EXT_FLIP_HEAD_FLAG_V2_ATTR	(1 << 2)
+/* Drop this flip if a later mailbox flip on the same windows is ready first */
+#define TEGRA_DC_EXT_FLIP_HEAD_FLAG_MAILBOX	(1 << 3)
 /* Flag for HDR_DATA handling */
 #define TEGRA_DC_EXT_FLIP_FLAG_HDR_ENABLE	(1 << 0)
 #define TEGRA_DC_EXT_FLIP_FLAG_HDR_DATA_UPDATED (1 << 1)
@@ -421,6 +423,7 @@ enum tegra_dc_ext_flip_data_type {
 	TEGRA_DC_EXT_FLIP_USER_DATA_OUTPUT_CSC,
 	TEGRA_DC_EXT_FLIP_USER_DATA_GET_FLIP_INFO,
 	TEGRA_DC_EXT_FLIP_USER_DATA_BACKGROUND_COLOR,
+	TEGRA_DC_EXT_FLIP_USER_DATA_LUT_BUF,
 };
 
 /*
@@ -636,6 +639,32 @@ struct tegra_dc_ext_udata_nvdisp_cmu {
 	__u8 reserved[18];
 } __attribute__((__packed__));
 
+/*
+ * This struct is a flip user data type (TEGRA_DC_EXT_FLIP_USER_DATA_LUT_BUF)
+ * that points an input or the output LUT straight at a userspace buffer, so
+ * that changing a LUT costs no more than a flip.
+ *
+ * buff_id is a dma-buf fd holding the LUT at offset, in the same layout the
+ * hardware reads: 257 64-bit entries for a window input LUT, or
+ * TEGRA_DC_EXT_LUT_SIZE_1025 + 1 entries for the output LUT, as in
+ * tegra_dc_ext_nvdisp_cmu.rgb. A buff_id of 0 switches back to the LUT kept
+ * by the driver. win_index selects the window, which must be part of the
+ * same flip, or TEGRA_DC_EXT_LUT_BUF_OUTPUT for the output LUT. Selecting a
+ * buffer for the output LUT also enables it.
+ *
+ * The buffer is in use until a later flip replaces it and completes, so
+ * userspace is expected to alternate between (at least) two buffers and only
+ * rewrite the one that is not on display.
+ */
+#define TEGRA_DC_EXT_LUT_BUF_OUTPUT	0xff
+
+struct tegra_dc_ext_udata_lut_buf {
+	__s32 buff_id;
+	__u32 offset;
+	__u8 win_index;
+	__u8 reserved[17]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
 struct tegra_dc_ext_udata_output_csc {
 	__u32 output_colorspace;
 	/* Valid values for output colorspace:
@@ -686,6 +715,7 @@ struct tegra_dc_ext_flip_user_data {
 		struct tegra_dc_ext_udata_output_csc output_csc;
 		struct tegra_dc_ext_flip_info flip_info;
 		struct tegra_dc_ext_udata_background_color background_color;
+		struct tegra_dc_ext_udata_lut_buf lut_buf;
 	};
 } __attribute__((__packed__));
 
@@ -1251,6 +1281,42 @@ struct tegra_dc_ext_scrncapt_dup_fbuf  {
 	__u32 reserved[16];
 };
 
+/* To export the buffers of a window, or of the cursor, that are currently
+ * on display without pausing the display or copying them.
+ *
+ * Each plane in use is returned as a new dma-buf fd holding its own
+ * reference to the buffer, -1 for planes not available. The plane offsets
+ * give the start of each plane within its dma-buf. 'attr' returns the
+ * window configuration the buffers were taken with, in the same layout as
+ * TEGRA_DC_EXT_SCRNCAPT_GET_INFO_TYPE_WINS with 'buff_id' holding the byte
+ * size of the Y plane. For the cursor only out_x, out_y, out_w and out_h
+ * are filled in.
+ *
+ * 'release_fence_fd' returns a sync fence fd that signals once the exported
+ * buffers have been replaced on display and the producer may reuse them, -1
+ * if there is none (disabled window, cursor). The content must be consumed
+ * before it signals, as it may have been rewritten afterwards.
+ *
+ * The caller must close every returned fd. No display pause is needed.
+ */
+#define TEGRA_DC_EXT_SCRNCAPT_EXPORT_CURSOR  (0xffffffff) /* as 'win' */
+
+struct tegra_dc_ext_scrncapt_export_fbuf {
+	__u32 ver;      /* set to TEGRA_DC_EXT_SCRNCAPT_VER_2
+			 * returns TEGRA_DC_EXT_SCRNCAPT_VER_2 */
+	__u32 head;     /* head ID */
+	__u32 win;      /* window ID, or TEGRA_DC_EXT_SCRNCAPT_EXPORT_CURSOR */
+	__u32 flags;    /* reserved, set to 0 */
+	/* returns dma-buf fd of each plane, -1 for plane not available */
+	__s32 plane_fds[TEGRA_DC_SCRNCAPT_DUP_FBUF_IDX_NUM];
+	/* returns offset of each plane within its dma-buf */
+	__u32 plane_offsets[TEGRA_DC_SCRNCAPT_DUP_FBUF_IDX_NUM];
+	__s32 release_fence_fd; /* returns reuse fence fd, or -1 */
+	__u32 reserved0;
+	struct tegra_dc_ext_flip_windowattr_v2 attr; /* returns window config */
+	__u32 reserved[8];
+};
+
 /* Scanline sync ioctl */
 #define TEGRA_DC_EXT_SCANLINE_FLAG_ENABLE (1U << 0)
 #define TEGRA_DC_EXT_SCANLINE_FLAG_DISABLE (0U << 0)
@@ -1438,6 +1504,28 @@ struct tegra_dc_ext_scanline_info {
 #define TEGRA_DC_EXT_CRC_GET \
 	_IOWR('D', 0x28, struct tegra_dc_ext_crc_arg)
 
+#define TEGRA_DC_EXT_SCRNCAPT_EXPORT_FBUF \
+	_IOWR('D', 0x29, struct tegra_dc_ext_scrncapt_export_fbuf)
+
+/* Retrieve, without blocking, the CRCs of every frame generated since a
+ * specific flip. arg.frames is filled oldest first with one entry for each
+ * frame whose matched flips include or follow arg.flip_id, up to
+ * arg.max_frames entries, and arg.num_frames returns the number of entries
+ * filled. At most TEGRA_DC_EXT_CRC_BULK_MAX_FRAMES entries are returned per
+ * call. Frames not generated yet are simply not returned, so the client
+ * can poll with the flip ID following the last one it has seen.
+ *
+ * Returns
+ * -EINVAL   if arg.magic is wrongly programmed
+ * -ENODEV   Same conditions as mentioned for TEGRA_DC_EXT_CRC_ENABLE
+ * -EPERM    Same conditions as mentioned for TEGRA_DC_EXT_CRC_DISABLE
+ * -ENOTSUPP if arg.version is wrongly programmed
+ * -ENODATA  if CRCs of frames following arg.flip_id have already been
+ *           dropped from the kernel CRC buffer
+ */
+#define TEGRA_DC_EXT_CRC_GET_BULK \
+	_IOWR('D', 0x2A, struct tegra_dc_ext_crc_bulk_arg)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -1576,6 +1664,41 @@ struct tegra_dc_ext_control_frm_lck_params {
 	__u64 valid_heads;
 };
 
+/**
+ * struct tegra_dc_ext_control_flip_head - One head of a multi-head flip.
+ */
+struct tegra_dc_ext_control_flip_head {
+	/**
+	 * @fd: Open tegra_dc_ext device of the head. The windows named in
+	 * @flip must be owned through this fd (TEGRA_DC_EXT_GET_WINDOW).
+	 */
+	__s32 fd;
+	__u32 reserved;
+	/**
+	 * @flip: Pointer to the struct tegra_dc_ext_flip_4 of the head. It is
+	 * filled in on return exactly as TEGRA_DC_EXT_FLIP4 would.
+	 */
+	__u64 __user flip;
+};
+
+/**
+ * struct tegra_dc_ext_control_flip_multi - Flips several frame-locked heads
+ * in a single call. The heads must be exactly the frame-lock valid_heads
+ * and frame lock must be enabled, so that all of them latch on the same
+ * frame.
+ */
+struct tegra_dc_ext_control_flip_multi {
+	/** @nr_heads: Number of entries in @heads. */
+	__u32 nr_heads;
+	/**
+	 * @failed_head: On error, index of the head whose flip could not be
+	 * queued. Flips of the heads before it remain queued.
+	 */
+	__u32 failed_head;
+	/** @heads: Pointer to struct tegra_dc_ext_control_flip_head[]. */
+	__u64 __user heads;
+};
+
 enum tegra_dc_ext_crc_arg_version {
 	TEGRA_DC_CRC_ARG_VERSION_0, /* Current version */
 	TEGRA_DC_CRC_ARG_VERSION_MAX,
@@ -1724,6 +1847,46 @@ struct tegra_dc_ext_crc_arg {
 	__u8 reserved[32]; /* unused - must be 0 */
 } __attribute__((__packed__));
 
+/*
+ * tegra_dc_ext_crc_frame - CRCs generated at one frame end
+ * @flip_id   - The most recent flip matched with the frame
+ * @rg        - RG CRC
+ * @comp      - COMP CRC, nvdisplay only
+ * @out       - OR CRC
+ * @regional  - RG regional CRCs, nvdisplay only
+ *              The valid field of each CRC is only set if it was collected
+ */
+struct tegra_dc_ext_crc_frame {
+	__u64 flip_id;
+	struct tegra_dc_ext_crc rg;
+	struct tegra_dc_ext_crc comp;
+	struct tegra_dc_ext_crc out;
+	struct tegra_dc_ext_crc regional[TEGRA_DC_EXT_MAX_REGIONS];
+	__u8 reserved[16];
+} __attribute__((__packed__));
+
+/*
+ * tegra_dc_ext_crc_bulk_arg - The argument to TEGRA_DC_EXT_CRC_GET_BULK
+ * @magic      - Magic bytes 'TCRC'
+ * @version    - In case the structure needs to change in future
+ * @flip_id    - Return the frames matched with this and later flips
+ * @max_frames - Number of entries in @frames
+ * @num_frames - Returns the number of entries filled in @frames
+ * @frames     - Pointer to an array of tegra_dc_ext_crc_frame
+ * @reserved   - Easier way to extend the data structure
+ */
+#define TEGRA_DC_EXT_CRC_BULK_MAX_FRAMES 128
+
+struct tegra_dc_ext_crc_bulk_arg {
+	__u8 magic[4];
+	enum tegra_dc_ext_crc_arg_version version;
+	__u64 flip_id;
+	__u32 max_frames;
+	__u32 num_frames;
+	__u64 __user frames;
+	__u8 reserved[32]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
 #define TEGRA_DC_EXT_CONTROL_GET_NUM_OUTPUTS \
 	_IOR('C', 0x00, __u32)
 #define TEGRA_DC_EXT_CONTROL_GET_OUTPUT_PROPERTIES \
@@ -1744,5 +1907,7 @@ struct tegra_dc_ext_crc_arg {
 	_IOW('C', 0x08, struct tegra_dc_ext_control_scrncapt_resume)
 #define TEGRA_DC_EXT_CONTROL_GET_CAP_INFO \
 	_IOWR('C', 0x09, struct tegra_dc_ext_get_cap_info)
+#define TEGRA_DC_EXT_CONTROL_FLIP_MULTI \
+	_IOWR('C', 0x0A, struct tegra_dc_ext_control_flip_multi)
 
 #endif /* __TEGRA_DC_EXT_H */
@@ -149,6 +149,8 @@ struct tegra_dc_win {
 	unsigned		new_bandwidth;
 	struct tegra_dc_lut	lut;
 	struct tegra_dc_nvdisp_lut	nvdisp_lut;
+	/* userspace input LUT buffer replacing nvdisp_lut, 0 if none */
+	dma_addr_t		lut_buf_addr;
 	u8	block_height_log2;
 	struct {
 		dma_addr_t cde_addr;
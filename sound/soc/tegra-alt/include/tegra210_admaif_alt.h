@@ -66,6 +66,13 @@
 #define TEGRA_ADMAIF_CHAN_ACIF_CTRL_PACK16_EN			\
 			(1 << TEGRA_ADMAIF_CHAN_ACIF_CTRL_PACK16_EN_SHIFT)
 
+#define TEGRA_ADMAIF_TX_FIFO_THRESHOLD_SHIFT	20
+#define TEGRA_ADMAIF_TX_FIFO_THRESHOLD_MASK		\
+			(0x3ff << TEGRA_ADMAIF_TX_FIFO_THRESHOLD_SHIFT)
+
+/* TX FIFO threshold in words for low latency channels */
+#define TEGRA_ADMAIF_LL_TX_FIFO_THRESHOLD	4
+
 #define TEGRA_ADMAIF_XBAR_TX_ENABLE_SHIFT	0
 #define TEGRA_ADMAIF_XBAR_TX_EN			\
 			(1 << TEGRA_ADMAIF_XBAR_TX_ENABLE_SHIFT)
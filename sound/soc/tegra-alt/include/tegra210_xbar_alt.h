@@ -264,6 +264,21 @@ struct tegra_xbar_soc_data {
 	int (*xbar_registration)(struct platform_device *pdev);
 };
 
+/* One "<mux control>", "<source>" pair of a route preset */
+struct tegra_xbar_route {
+	const char *mux;
+	const char *src;
+	/* resolved while a preset is applied */
+	struct snd_kcontrol *kctl;
+	unsigned int item;
+};
+
+struct tegra_xbar_preset {
+	const char *name;
+	struct tegra_xbar_route *routes;
+	unsigned int num_routes;
+};
+
 struct tegra_xbar {
 	struct clk *clk;
 	struct clk *clk_parent;
@@ -272,6 +287,12 @@ struct tegra_xbar {
 	struct regmap *regmap;
 	const struct tegra_xbar_soc_data *soc_data;
 	bool is_shutdown;
+	/* named route presets from DT, applied through one control */
+	struct tegra_xbar_preset *presets;
+	unsigned int num_presets;
+	const char **preset_texts;
+	struct soc_enum preset_enum;
+	unsigned int active_preset;
 };
 
 /* Extension of soc_bytes structure defined in sound/soc.h */
@@ -31,8 +31,15 @@
 #ifndef __TEGRA_PCM_ALT_H__
 #define __TEGRA_PCM_ALT_H__
 
+#include <linux/ktime.h>
+
 #define MAX_DMA_REQ_COUNT 2
 
+/* Sub-millisecond periods for low latency streams */
+#define TEGRA_ALT_PCM_LL_PERIOD_BYTES_MIN	32
+#define TEGRA_ALT_PCM_LL_PERIODS_MAX		32
+#define TEGRA_ALT_PCM_LL_MAXBURST		2
+
 struct tegra_alt_pcm_dma_params {
 	unsigned long addr;
 	unsigned long wrap;
@@ -40,6 +47,11 @@ struct tegra_alt_pcm_dma_params {
 	unsigned long req_sel;
 	const char *chan_name;
 	size_t buffer_size;
+	/* small periods and DMA bursts, set by the CPU DAI */
+	bool low_latency;
+	/* trigger to first transfer seen by the pointer, low latency only */
+	ktime_t start;
+	unsigned int latency_us;
 };
 
 int tegra_alt_pcm_platform_register(struct device *dev);
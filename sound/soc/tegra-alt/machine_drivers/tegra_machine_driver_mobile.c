@@ -1158,6 +1158,7 @@ static struct platform_driver tegra_asoc_machine_driver = {
 		.name = DRV_NAME,
 		.owner = THIS_MODULE,
 		.pm = &tegra_asoc_machine_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = tegra_machine_of_match,
 	},
 	.probe = tegra_machine_driver_probe,
@@ -665,6 +665,7 @@ static struct platform_driver tegra_maui_driver = {
 		.name = DRV_NAME,
 		.owner = THIS_MODULE,
 		.pm = &snd_soc_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = tegra_maui_of_match,
 	},
 	.probe = tegra_maui_driver_probe,
@@ -640,6 +640,7 @@ static struct platform_driver tegra186_m3420_driver = {
 		.name = DRV_NAME,
 		.owner = THIS_MODULE,
 		.pm = &snd_soc_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = tegra186_m3420_of_match,
 	},
 	.probe = tegra186_m3420_driver_probe,
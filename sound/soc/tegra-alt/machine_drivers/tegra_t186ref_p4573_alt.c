@@ -506,6 +506,7 @@ static struct platform_driver tegra186_driver = {
 		.name = DRV_NAME,
 		.owner = THIS_MODULE,
 		.pm = &snd_soc_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = tegra186_of_match,
 	},
 	.probe = tegra186_driver_probe,
@@ -1040,6 +1040,7 @@ static struct platform_driver tegra_t210ref_driver = {
 		.name = DRV_NAME,
 		.owner = THIS_MODULE,
 		.pm = &snd_soc_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = tegra_t210ref_of_match,
 	},
 	.probe = tegra_t210ref_driver_probe,
@@ -705,6 +705,7 @@ static struct platform_driver tegra_t210ref_p2382_driver = {
 		.name = DRV_NAME,
 		.owner = THIS_MODULE,
 		.pm = &snd_soc_pm_ops,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = tegra_t210ref_p2382_of_match,
 	},
 	.probe = tegra_t210ref_p2382_driver_probe,
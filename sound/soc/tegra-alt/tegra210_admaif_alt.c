@@ -415,6 +415,22 @@ static int tegra_admaif_hw_params(struct snd_pcm_substream *substream,
 	tegra_admaif_set_pack_mode(admaif->regmap, reg, valid_bit);
 	admaif->soc_data->set_audio_cif(admaif->regmap, reg, &cif_conf);
 
+	/*
+	 * Low latency playback starts draining the FIFO after a few words
+	 * instead of the default fill level. Capture relies on the short
+	 * DMA bursts set up by the PCM layer.
+	 */
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK &&
+	    admaif->playback_dma_data[dai->id].low_latency) {
+		reg = admaif->soc_data->reg_offsets.tx_enable +
+			TEGRA_ADMAIF_XBAR_TX_FIFO_CTRL +
+			(dai->id * TEGRA_ADMAIF_CHANNEL_REG_STRIDE);
+		regmap_update_bits(admaif->regmap, reg,
+			TEGRA_ADMAIF_TX_FIFO_THRESHOLD_MASK,
+			TEGRA_ADMAIF_LL_TX_FIFO_THRESHOLD <<
+			TEGRA_ADMAIF_TX_FIFO_THRESHOLD_SHIFT);
+	}
+
 	return 0;
 }
 
@@ -664,6 +680,22 @@ static int tegra210_ape_dump_reg_put(struct snd_kcontrol *kcontrol,
 	return 0;
 }
 
+/* Playback plus capture fill time of a low latency channel, in us */
+static int tegra_admaif_get_latency(struct snd_kcontrol *kcontrol,
+					struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_codec *codec = snd_soc_kcontrol_codec(kcontrol);
+	struct soc_mixer_control *mc =
+		(struct soc_mixer_control *)kcontrol->private_value;
+	struct tegra_admaif *admaif = snd_soc_codec_get_drvdata(codec);
+
+	ucontrol->value.integer.value[0] =
+		admaif->playback_dma_data[mc->reg].latency_us +
+		admaif->capture_dma_data[mc->reg].latency_us;
+
+	return 0;
+}
+
 static int tegra_admaif_dai_probe(struct snd_soc_dai *dai)
 {
 	struct tegra_admaif *admaif = snd_soc_dai_get_drvdata(dai);
@@ -937,6 +969,15 @@ static const struct soc_enum tegra_admaif_stereo_conv_enum =
 		 tegra_admaif_stereo_conv_enum, tegra_admaif_get_format, \
 		 tegra_admaif_put_format)
 
+#define TEGRA_ADMAIF_LATENCY_CTRL(reg) \
+{	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, \
+	.name = "ADMAIF" #reg " Latency", \
+	.access = SNDRV_CTL_ELEM_ACCESS_READ | \
+		SNDRV_CTL_ELEM_ACCESS_VOLATILE, \
+	.info = snd_soc_info_volsw, \
+	.get = tegra_admaif_get_latency, \
+	.private_value = SOC_SINGLE_VALUE(reg - 1, 0, INT_MAX, 0, 0) }
+
 static struct snd_kcontrol_new tegra210_admaif_controls[] = {
 	TEGRA_ADMAIF_CHANNEL_CTRL(1),
 	TEGRA_ADMAIF_CHANNEL_CTRL(2),
@@ -968,6 +1009,16 @@ static struct snd_kcontrol_new tegra210_admaif_controls[] = {
 	TEGRA_ADMAIF_TX_CIF_CTRL(8),
 	TEGRA_ADMAIF_TX_CIF_CTRL(9),
 	TEGRA_ADMAIF_TX_CIF_CTRL(10),
+	TEGRA_ADMAIF_LATENCY_CTRL(1),
+	TEGRA_ADMAIF_LATENCY_CTRL(2),
+	TEGRA_ADMAIF_LATENCY_CTRL(3),
+	TEGRA_ADMAIF_LATENCY_CTRL(4),
+	TEGRA_ADMAIF_LATENCY_CTRL(5),
+	TEGRA_ADMAIF_LATENCY_CTRL(6),
+	TEGRA_ADMAIF_LATENCY_CTRL(7),
+	TEGRA_ADMAIF_LATENCY_CTRL(8),
+	TEGRA_ADMAIF_LATENCY_CTRL(9),
+	TEGRA_ADMAIF_LATENCY_CTRL(10),
 	SOC_SINGLE_EXT("APE Reg Dump", SND_SOC_NOPM, 0, 1, 0,
 		tegra210_ape_dump_reg_get, tegra210_ape_dump_reg_put),
 };
@@ -1033,6 +1084,26 @@ static struct snd_kcontrol_new tegra186_admaif_controls[] = {
 	TEGRA_ADMAIF_TX_CIF_CTRL(18),
 	TEGRA_ADMAIF_TX_CIF_CTRL(19),
 	TEGRA_ADMAIF_TX_CIF_CTRL(20),
+	TEGRA_ADMAIF_LATENCY_CTRL(1),
+	TEGRA_ADMAIF_LATENCY_CTRL(2),
+	TEGRA_ADMAIF_LATENCY_CTRL(3),
+	TEGRA_ADMAIF_LATENCY_CTRL(4),
+	TEGRA_ADMAIF_LATENCY_CTRL(5),
+	TEGRA_ADMAIF_LATENCY_CTRL(6),
+	TEGRA_ADMAIF_LATENCY_CTRL(7),
+	TEGRA_ADMAIF_LATENCY_CTRL(8),
+	TEGRA_ADMAIF_LATENCY_CTRL(9),
+	TEGRA_ADMAIF_LATENCY_CTRL(10),
+	TEGRA_ADMAIF_LATENCY_CTRL(11),
+	TEGRA_ADMAIF_LATENCY_CTRL(12),
+	TEGRA_ADMAIF_LATENCY_CTRL(13),
+	TEGRA_ADMAIF_LATENCY_CTRL(14),
+	TEGRA_ADMAIF_LATENCY_CTRL(15),
+	TEGRA_ADMAIF_LATENCY_CTRL(16),
+	TEGRA_ADMAIF_LATENCY_CTRL(17),
+	TEGRA_ADMAIF_LATENCY_CTRL(18),
+	TEGRA_ADMAIF_LATENCY_CTRL(19),
+	TEGRA_ADMAIF_LATENCY_CTRL(20),
 	SOC_SINGLE_EXT("APE Reg Dump", SND_SOC_NOPM, 0, 1, 0,
 		tegra210_ape_dump_reg_get, tegra210_ape_dump_reg_put),
 };
@@ -1119,6 +1190,8 @@ static int tegra_admaif_probe(struct platform_device *pdev)
 	struct resource *res;
 	const struct of_device_id *match;
 	unsigned int buffer_size;
+	u32 ll_ch[TEGRA186_ADMAIF_CHANNEL_COUNT];
+	int num_ll;
 
 	match = of_match_device(tegra_admaif_of_match, &pdev->dev);
 	if (!match) {
@@ -1275,6 +1348,35 @@ static int tegra_admaif_probe(struct platform_device *pdev)
 		admaif->capture_dma_data[i].buffer_size = buffer_size;
 	}
 
+	/*
+	 * ADMAIF channels, numbered from 1, run with small periods. Each
+	 * already owns its ADMA channel through dma-names, so the rest of
+	 * the xbar graph is not affected.
+	 */
+	num_ll = of_property_count_u32_elems(pdev->dev.of_node,
+					     "nvidia,low-latency-admaif");
+	if (num_ll > 0) {
+		if (num_ll > admaif->soc_data->num_ch)
+			num_ll = admaif->soc_data->num_ch;
+		of_property_read_u32_array(pdev->dev.of_node,
+					   "nvidia,low-latency-admaif",
+					   ll_ch, num_ll);
+		for (i = 0; i < num_ll; i++) {
+			if (!ll_ch[i] || ll_ch[i] > admaif->soc_data->num_ch) {
+				dev_err(&pdev->dev,
+					"Invalid low latency ADMAIF%u\n",
+					ll_ch[i]);
+				continue;
+			}
+			admaif->playback_dma_data[ll_ch[i] - 1].low_latency =
+				true;
+			admaif->capture_dma_data[ll_ch[i] - 1].low_latency =
+				true;
+			dev_info(&pdev->dev, "ADMAIF%u in low latency mode\n",
+				 ll_ch[i]);
+		}
+	}
+
 	ret = snd_soc_register_component(&pdev->dev,
 					&tegra_admaif_dai_driver,
 					tegra_admaif_dais,
@@ -1250,6 +1250,8 @@ static int tegra210_adsp_pcm_msg_handler(struct tegra210_adsp_app *app,
 			return 0;
 		runtime = prtd->substream->runtime;
 		snd_pcm_period_elapsed(prtd->substream);
+		if (runtime->status->state == SNDRV_PCM_STATE_XRUN)
+			adsp_dfs_report_underrun();
 		if ((IS_MMAP_ACCESS(runtime->access))) {
 			if (prtd->prev_appl_ptr !=
 				runtime->control->appl_ptr) {
@@ -1783,6 +1785,21 @@ static int tegra210_adsp_pcm_hw_free(struct snd_pcm_substream *substream)
 	return 0;
 }
 
+/*
+ * The PCM buffer is already ADSP shared memory handed to the FE APM by
+ * address, so mapping it lets user space write or read periods in place.
+ * Position updates keep flowing through msgq via ack and the APM
+ * position message.
+ */
+static int tegra210_adsp_pcm_mmap(struct snd_pcm_substream *substream,
+				struct vm_area_struct *vma)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+
+	return nvadsp_mmap_coherent(vma, runtime->dma_area,
+				runtime->dma_addr, runtime->dma_bytes);
+}
+
 #ifdef CONFIG_SND_SOC_TEGRA_VIRT_IVC_COMM
 static int32_t tegra_adsp_get_admaif_id(
 					struct tegra210_adsp *adsp,
@@ -2186,6 +2203,7 @@ static struct snd_pcm_ops tegra210_adsp_pcm_ops = {
 	.trigger	= tegra210_adsp_pcm_trigger,
 	.pointer	= tegra210_adsp_pcm_pointer,
 	.ack		= tegra210_adsp_pcm_ack,
+	.mmap		= tegra210_adsp_pcm_mmap,
 };
 
 static int tegra210_adsp_pcm_new(struct snd_soc_pcm_runtime *rtd)
@@ -3189,7 +3207,8 @@ static int tegra210_adsp_widget_event(struct snd_soc_dapm_widget *w,
 				return ret;
 			}
 			if (app->min_adsp_clock)
-				adsp_update_dfs_min_rate(app->min_adsp_clock * 1000);
+				nvadsp_app_set_cycle_budget(app->info,
+					app->min_adsp_clock * 1000);
 			ret = tegra210_adsp_send_state_msg(app, nvfx_state_active,
 				TEGRA210_ADSP_MSG_FLAG_SEND);
 			if (ret < 0)
@@ -3228,8 +3247,7 @@ static int tegra210_adsp_widget_event(struct snd_soc_dapm_widget *w,
 				TEGRA210_ADSP_MSG_FLAG_NEED_ACK));
 			if (ret < 0)
 				dev_err(adsp->dev, "Failed to reset.");
-			if (app->min_adsp_clock)
-				adsp_update_dfs_min_rate(0);
+			nvadsp_app_set_cycle_budget(app->info, 0);
 			pm_runtime_put(adsp->dev);
 		}
 	}
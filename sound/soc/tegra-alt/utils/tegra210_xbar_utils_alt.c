@@ -177,11 +177,13 @@ int tegra_xbar_put_value_enum(struct snd_kcontrol *kcontrol,
 				snd_soc_dapm_kcontrol_dapm(kcontrol);
 	struct soc_enum *e = (struct soc_enum *)kcontrol->private_value;
 	unsigned int *item = ucontrol->value.enumerated.item;
-	unsigned int change = 0, reg_idx = 0, value, *mask, bit_pos = 0;
-	unsigned int i, reg_count, reg_val = 0, update_idx = 0;
-	unsigned int reg[TEGRA_XBAR_UPDATE_MAX_REG];
+	unsigned int reg_idx = 0, value, *mask, bit_pos = 0;
+	unsigned int i, reg_count, reg_val = 0, update_idx = 0, val;
+	unsigned int reg;
 	struct snd_soc_dapm_update update[TEGRA_XBAR_UPDATE_MAX_REG] = {
 				{ NULL } };
+	struct snd_soc_dapm_update set = { NULL };
+	bool set_changed = false;
 
 	/* initialize the reg_count and mask from soc_data */
 	reg_count = xbar->soc_data->reg_count;
@@ -199,38 +201,46 @@ int tegra_xbar_put_value_enum(struct snd_kcontrol *kcontrol,
 		reg_val = BIT(bit_pos);
 	}
 
+	/*
+	 * Only registers whose bits actually move are written, clears
+	 * first and the selected register last so two sources are never
+	 * routed at once.
+	 */
 	for (i = 0; i < reg_count; i++) {
-		reg[i] = e->reg + xbar->soc_data->reg_offset * i;
+		reg = e->reg + xbar->soc_data->reg_offset * i;
+		val = (i == reg_idx) ? reg_val : 0;
+
+		if (!snd_soc_test_bits(codec, reg, mask[i], val))
+			continue;
+
 		if (i == reg_idx) {
-			change |= snd_soc_test_bits(codec, reg[i],
-							mask[i], reg_val);
-			/* set the selected register */
-			update[reg_count - 1].reg = reg[reg_idx];
-			update[reg_count - 1].mask = mask[reg_idx];
-			update[reg_count - 1].val = reg_val;
+			set.reg = reg;
+			set.mask = mask[i];
+			set.val = val;
+			set_changed = true;
 		} else {
-			/* accumulate the change to update the DAPM path
-			    when none is selected */
-			change |= snd_soc_test_bits(codec, reg[i],
-							mask[i], 0);
-
-			/* clear the register when not selected */
-			update[update_idx].reg = reg[i];
+			update[update_idx].reg = reg;
 			update[update_idx].mask = mask[i];
 			update[update_idx++].val = 0;
 		}
 	}
 
-	/* power the widgets */
-	if (change) {
-		for (i = 0; i < reg_count; i++) {
-			update[i].kcontrol = kcontrol;
-			snd_soc_dapm_mux_update_power(dapm,
-				kcontrol, item[0], e, &update[i]);
-		}
-	}
+	if (set_changed)
+		update[update_idx++] = set;
+
+	if (!update_idx)
+		return 0;
+
+	/* the path is re-powered once, with the last write as the update */
+	for (i = 0; i < update_idx - 1; i++)
+		snd_soc_update_bits(codec, update[i].reg, update[i].mask,
+				    update[i].val);
 
-	return change;
+	update[update_idx - 1].kcontrol = kcontrol;
+	snd_soc_dapm_mux_update_power(dapm, kcontrol, item[0], e,
+				      &update[update_idx - 1]);
+
+	return 1;
 }
 EXPORT_SYMBOL_GPL(tegra_xbar_put_value_enum);
 
@@ -333,11 +343,179 @@ int tegra_xbar_remove(struct platform_device *pdev)
 }
 EXPORT_SYMBOL_GPL(tegra_xbar_remove);
 
+/*
+ * Resolve every route of a preset before touching anything, so a typo in
+ * DT leaves the current routing alone, then switch only the muxes that
+ * are not already on the requested source.
+ */
+static int tegra_xbar_apply_preset(struct snd_soc_card *card,
+				   struct tegra_xbar_preset *preset)
+{
+	struct snd_ctl_elem_value *ucontrol;
+	struct tegra_xbar_route *route;
+	struct soc_enum *e;
+	unsigned int i, j;
+	int ret = 0;
+
+	for (i = 0; i < preset->num_routes; i++) {
+		route = &preset->routes[i];
+		route->kctl = snd_soc_card_get_kcontrol(card, route->mux);
+		if (!route->kctl) {
+			dev_err(card->dev, "preset %s: no control %s\n",
+				preset->name, route->mux);
+			return -EINVAL;
+		}
+
+		e = (struct soc_enum *)route->kctl->private_value;
+		for (j = 0; j < e->items; j++)
+			if (!strcmp(e->texts[j], route->src))
+				break;
+		if (j == e->items) {
+			dev_err(card->dev, "preset %s: %s can't select %s\n",
+				preset->name, route->mux, route->src);
+			return -EINVAL;
+		}
+		route->item = j;
+	}
+
+	ucontrol = kzalloc(sizeof(*ucontrol), GFP_KERNEL);
+	if (!ucontrol)
+		return -ENOMEM;
+
+	for (i = 0; i < preset->num_routes; i++) {
+		route = &preset->routes[i];
+
+		route->kctl->get(route->kctl, ucontrol);
+		if (ucontrol->value.enumerated.item[0] == route->item)
+			continue;
+
+		ucontrol->value.enumerated.item[0] = route->item;
+		ret = route->kctl->put(route->kctl, ucontrol);
+		if (ret < 0) {
+			dev_err(card->dev, "preset %s: %s failed %d\n",
+				preset->name, route->mux, ret);
+			break;
+		}
+		if (ret > 0)
+			snd_ctl_notify(card->snd_card,
+				       SNDRV_CTL_EVENT_MASK_VALUE,
+				       &route->kctl->id);
+	}
+
+	kfree(ucontrol);
+	return ret < 0 ? ret : 0;
+}
+
+static int tegra_xbar_get_preset(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	ucontrol->value.enumerated.item[0] = xbar->active_preset;
+
+	return 0;
+}
+
+static int tegra_xbar_put_preset(struct snd_kcontrol *kcontrol,
+				 struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_codec *codec = snd_soc_kcontrol_codec(kcontrol);
+	unsigned int item = ucontrol->value.enumerated.item[0];
+	int ret;
+
+	if (item > xbar->num_presets)
+		return -EINVAL;
+
+	/* "None" only forgets the active preset, routes stay as they are */
+	if (item) {
+		ret = tegra_xbar_apply_preset(codec->component.card,
+					      &xbar->presets[item - 1]);
+		if (ret < 0)
+			return ret;
+	}
+
+	if (xbar->active_preset == item)
+		return 0;
+
+	xbar->active_preset = item;
+	return 1;
+}
+
+/* Each child of route-presets is a preset with a "routes" string list */
+static int tegra_xbar_parse_presets(struct device *dev)
+{
+	struct device_node *np, *child;
+	struct tegra_xbar_preset *preset;
+	unsigned int i = 0, j;
+	int count;
+
+	np = of_get_child_by_name(dev->of_node, "route-presets");
+	if (!np)
+		return 0;
+
+	count = of_get_child_count(np);
+	xbar->presets = devm_kcalloc(dev, count, sizeof(*xbar->presets),
+				     GFP_KERNEL);
+	xbar->preset_texts = devm_kcalloc(dev, count + 1, sizeof(char *),
+					  GFP_KERNEL);
+	if (!xbar->presets || !xbar->preset_texts) {
+		of_node_put(np);
+		return -ENOMEM;
+	}
+	xbar->preset_texts[0] = "None";
+
+	for_each_child_of_node(np, child) {
+		count = of_property_count_strings(child, "routes");
+		if (count <= 0 || count % 2) {
+			dev_err(dev, "Invalid routes in preset %s\n",
+				child->name);
+			continue;
+		}
+
+		preset = &xbar->presets[i];
+		preset->routes = devm_kcalloc(dev, count / 2,
+					      sizeof(*preset->routes),
+					      GFP_KERNEL);
+		if (!preset->routes) {
+			of_node_put(child);
+			of_node_put(np);
+			return -ENOMEM;
+		}
+
+		for (j = 0; j < count / 2; j++) {
+			of_property_read_string_index(child, "routes", 2 * j,
+						      &preset->routes[j].mux);
+			of_property_read_string_index(child, "routes",
+						      2 * j + 1,
+						      &preset->routes[j].src);
+		}
+		preset->num_routes = count / 2;
+		preset->name = child->name;
+		xbar->preset_texts[++i] = preset->name;
+	}
+	of_node_put(np);
+
+	xbar->num_presets = i;
+	if (i)
+		dev_info(dev, "%u route presets\n", i);
+
+	return 0;
+}
+
 int tegra_xbar_codec_probe(struct snd_soc_codec *codec)
 {
+	struct snd_kcontrol_new preset_ctrl =
+		SOC_ENUM_EXT("XBAR Route Preset", xbar->preset_enum,
+			     tegra_xbar_get_preset, tegra_xbar_put_preset);
+
 	codec->control_data = xbar->regmap;
 
-	return 0;
+	if (!xbar->num_presets)
+		return 0;
+
+	xbar->preset_enum.reg = SND_SOC_NOPM;
+	xbar->preset_enum.items = xbar->num_presets + 1;
+	xbar->preset_enum.texts = xbar->preset_texts;
+
+	return snd_soc_add_codec_controls(codec, &preset_ctrl, 1);
 }
 EXPORT_SYMBOL_GPL(tegra_xbar_codec_probe);
 
@@ -362,6 +540,10 @@ int tegra_xbar_probe(struct platform_device *pdev,
 
 	platform_set_drvdata(pdev, xbar);
 
+	ret = tegra_xbar_parse_presets(&pdev->dev);
+	if (ret)
+		goto err;
+
 	if (!(tegra_platform_is_unit_fpga() || tegra_platform_is_fpga())) {
 		xbar->clk = devm_clk_get(&pdev->dev, "ahub");
 		if (IS_ERR(xbar->clk)) {
@@ -19,6 +19,8 @@
 #include <linux/module.h>
 #include <linux/dma-mapping.h>
 #include <linux/of.h>
+#include <linux/slab.h>
+#include <linux/mutex.h>
 #include <linux/version.h>
 #include <sound/jack.h>
 #include <sound/soc.h>
@@ -35,6 +37,25 @@ static unsigned int *tx_mask;
 static unsigned int *rx_mask;
 static unsigned int num_dai_links;
 
+/*
+ * DT codec links are parsed once per card node and kept across deferred
+ * probes, so a card waiting on its codecs does not parse them again on
+ * every retry. The memory is not devm managed for that reason.
+ */
+struct tegra_machine_codec_cache {
+	struct device_node *np;
+	struct snd_soc_dai_link *links;
+	struct snd_soc_codec_conf *conf;
+	unsigned int num_links;
+	unsigned int num_conf;
+	unsigned int *bclk_ratio;
+	unsigned int *rx_mask;
+	unsigned int *tx_mask;
+};
+
+static struct tegra_machine_codec_cache codec_cache;
+static DEFINE_MUTEX(codec_cache_lock);
+
 /* used by only t18x specific APIs */
 static int num_links = TEGRA186_XBAR_DAI_LINKS;
 
@@ -2820,7 +2841,11 @@ int tegra_machine_append_dai_link(struct snd_soc_dai_link *link,
 
 	if (!tegra_asoc_machine_links) {
 		if (link) {
-			tegra_asoc_machine_links = link;
+			/* copy, the caller's links may be cached */
+			tegra_asoc_machine_links = kmemdup(link, size2 *
+				sizeof(struct snd_soc_dai_link), GFP_KERNEL);
+			if (!tegra_asoc_machine_links)
+				return 0;
 			num_dai_links = size2;
 			return size2;
 		} else {
@@ -2927,7 +2952,10 @@ int tegra_machine_append_codec_conf(struct snd_soc_codec_conf *conf,
 
 	if (!tegra_asoc_codec_conf) {
 		if (conf) {
-			tegra_asoc_codec_conf = conf;
+			tegra_asoc_codec_conf = kmemdup(conf, size2 *
+				sizeof(struct snd_soc_codec_conf), GFP_KERNEL);
+			if (!tegra_asoc_codec_conf)
+				return 0;
 			return size2;
 		} else {
 			return 0;
@@ -2963,6 +2991,25 @@ static int tegra_machine_get_format(u64 *p_formats, char *fmt)
 }
 EXPORT_SYMBOL_GPL(tegra_machine_get_format);
 
+/* Called with codec_cache_lock held */
+static void tegra_machine_free_codec_cache(void)
+{
+	unsigned int i, n = codec_cache.num_links;
+
+	if (codec_cache.links) {
+		for (i = 0; i < n; i++) {
+			kfree(codec_cache.links[i].params);
+			kfree(codec_cache.links[n + i].name);
+		}
+	}
+	kfree(codec_cache.links);
+	kfree(codec_cache.conf);
+	kfree(codec_cache.bclk_ratio);
+	kfree(codec_cache.rx_mask);
+	kfree(codec_cache.tx_mask);
+	memset(&codec_cache, 0, sizeof(codec_cache));
+}
+
 struct snd_soc_dai_link *tegra_machine_new_codec_links(
 	struct platform_device *pdev,
 	struct snd_soc_dai_link *tegra_codec_links,
@@ -2982,46 +3029,42 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 	if (!np)
 		goto err;
 
+	mutex_lock(&codec_cache_lock);
+	if (codec_cache.np == np && codec_cache.links) {
+		bclk_ratio = codec_cache.bclk_ratio;
+		rx_mask = codec_cache.rx_mask;
+		tx_mask = codec_cache.tx_mask;
+		*pnum_codec_links = codec_cache.num_links;
+		mutex_unlock(&codec_cache_lock);
+		return codec_cache.links;
+	}
+	tegra_machine_free_codec_cache();
+
 	if (of_property_read_u32(np,
 		"nvidia,num-codec-link", (u32 *)&num_codec_links)) {
 		dev_err(&pdev->dev,
 			"Property 'nvidia,num-codec-link' missing or invalid\n");
-		goto err;
+		goto err_unlock;
 	}
 
-	tegra_codec_links = devm_kzalloc(&pdev->dev, 2 * num_codec_links *
+	tegra_codec_links = kcalloc(2 * num_codec_links,
 		sizeof(struct snd_soc_dai_link), GFP_KERNEL);
-	if (!tegra_codec_links) {
+	codec_cache.bclk_ratio = kcalloc(num_codec_links,
+		sizeof(unsigned int), GFP_KERNEL);
+	codec_cache.rx_mask = kcalloc(num_codec_links,
+		sizeof(unsigned int), GFP_KERNEL);
+	codec_cache.tx_mask = kcalloc(num_codec_links,
+		sizeof(unsigned int), GFP_KERNEL);
+	codec_cache.links = tegra_codec_links;
+	codec_cache.num_links = num_codec_links;
+	if (!tegra_codec_links || !codec_cache.bclk_ratio ||
+	    !codec_cache.rx_mask || !codec_cache.tx_mask) {
 		dev_err(&pdev->dev, "Can't allocate tegra_codec_links\n");
-		goto err;
-	}
-
-	if (bclk_ratio == NULL) {
-		bclk_ratio = devm_kzalloc(&pdev->dev, num_codec_links *
-			sizeof(unsigned int), GFP_KERNEL);
-		if (!bclk_ratio) {
-			dev_err(&pdev->dev, "Can't allocate bclk_ratio\n");
-			goto err;
-		}
-	}
-
-	if (rx_mask == NULL) {
-		rx_mask = devm_kzalloc(&pdev->dev, num_codec_links *
-			sizeof(unsigned int), GFP_KERNEL);
-		if (!rx_mask) {
-			dev_err(&pdev->dev, "Can't allocate rx_mask\n");
-			goto err;
-		}
-	}
-
-	if (tx_mask == NULL) {
-		tx_mask = devm_kzalloc(&pdev->dev, num_codec_links *
-			sizeof(unsigned int), GFP_KERNEL);
-		if (!tx_mask) {
-			dev_err(&pdev->dev, "Can't allocate tx_mask\n");
-			goto err;
-		}
+		goto err_free;
 	}
+	bclk_ratio = codec_cache.bclk_ratio;
+	rx_mask = codec_cache.rx_mask;
+	tx_mask = codec_cache.tx_mask;
 	/* variable i is for DAP and j is for CIF */
 	for (i = 0, j = num_codec_links; i < num_codec_links; i++, j++) {
 		memset((void *)dai_link_name, '\0', MAX_STR_SIZE);
@@ -3034,7 +3077,7 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 				dev_err(&pdev->dev,
 					"Property '%s.codec-dai' missing or invalid\n",
 					dai_link_name);
-				goto err;
+				goto err_free;
 			}
 
 			tegra_codec_links[i].cpu_of_node
@@ -3043,7 +3086,7 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 				dev_err(&pdev->dev,
 					"Property '%s.cpu-dai' missing or invalid\n",
 					dai_link_name);
-				goto err;
+				goto err_free;
 			}
 
 			/* DAP configuration */
@@ -3051,14 +3094,14 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 				&prefix)) {
 				dev_err(&pdev->dev,
 					"Property 'name-prefix' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 
 			if (of_property_read_string(subnp, "link-name",
 				&tegra_codec_links[i].name)) {
 				dev_err(&pdev->dev,
 					"Property 'link-name' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 
 			tegra_codec_links[i].stream_name = "Playback";
@@ -3078,32 +3121,35 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 				&tegra_codec_links[i].codec_dai_name)) {
 				dev_err(&pdev->dev,
 					"Property 'codec-dai-name' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 			tegra_codec_links[i].dai_fmt =
 				snd_soc_of_parse_daifmt(subnp, NULL,
 					&bitclkmaster, &framemaster);
 
-			params = devm_kzalloc(&pdev->dev,
-				sizeof(struct snd_soc_pcm_stream), GFP_KERNEL);
+			params = kzalloc(sizeof(struct snd_soc_pcm_stream),
+				GFP_KERNEL);
+			if (!params)
+				goto err_free;
+			tegra_codec_links[i].params = params;
 
 			if (of_property_read_string(subnp,
 				"bit-format", (const char **)&str)) {
 				dev_err(&pdev->dev,
 					"Property 'bit-format' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 			if (tegra_machine_get_format(&params->formats, str)) {
 				dev_err(&pdev->dev,
 					"Wrong codec format\n");
-				goto err;
+				goto err_free;
 			}
 
 			if (of_property_read_u32(subnp,
 				"srate", &params->rate_min)) {
 				dev_err(&pdev->dev,
 					"Property 'srate' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 			params->rate_max = params->rate_min;
 
@@ -3111,10 +3157,9 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 				"num-channel", &params->channels_min)) {
 				dev_err(&pdev->dev,
 					"Property 'num-channel' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 			params->channels_max = params->channels_min;
-			tegra_codec_links[i].params = params;
 
 			of_property_read_u32(subnp,
 				"bclk_ratio", (u32 *)&bclk_ratio[i]);
@@ -3132,7 +3177,7 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 			if (!tegra_codec_links[j].cpu_of_node) {
 				dev_err(&pdev->dev,
 					"Property 'nvidia,xbar' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 
 			if (!strcmp(tegra_codec_links[i].name, "dspk-playback-r"))
@@ -3146,16 +3191,14 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 				&tegra_codec_links[j].cpu_dai_name)) {
 				dev_err(&pdev->dev,
 					"Property 'cpu-dai-name' missing or invalid\n");
-				goto err;
+				goto err_free;
 			}
 
-			str = devm_kzalloc(&pdev->dev,
-				sizeof(tegra_codec_links[j].cpu_dai_name) +
-				1 + sizeof(tegra_codec_links[j].codec_dai_name),
-				GFP_KERNEL);
-			str = strcat(str, tegra_codec_links[j].cpu_dai_name);
-			str = strcat(str, " ");
-			str = strcat(str, tegra_codec_links[j].codec_dai_name);
+			str = kasprintf(GFP_KERNEL, "%s %s",
+				tegra_codec_links[j].cpu_dai_name,
+				tegra_codec_links[j].codec_dai_name);
+			if (!str)
+				goto err_free;
 
 			tegra_codec_links[j].name =
 				tegra_codec_links[j].stream_name = str;
@@ -3167,13 +3210,23 @@ struct snd_soc_dai_link *tegra_machine_new_codec_links(
 			dev_err(&pdev->dev,
 				"Property '%s' missing or invalid\n",
 				dai_link_name);
-			goto err;
+			goto err_free;
 		}
 	}
 
+	codec_cache.np = np;
+	mutex_unlock(&codec_cache_lock);
+
 	*pnum_codec_links = num_codec_links;
 
 	return tegra_codec_links;
+err_free:
+	tegra_machine_free_codec_cache();
+	bclk_ratio = NULL;
+	rx_mask = NULL;
+	tx_mask = NULL;
+err_unlock:
+	mutex_unlock(&codec_cache_lock);
 err:
 	return NULL;
 }
@@ -3189,6 +3242,7 @@ struct snd_soc_codec_conf *tegra_machine_new_codec_conf(
 	struct device_node *np = pdev->dev.of_node, *subnp;
 	struct device_node *of_node;
 	char dai_link_name[MAX_STR_SIZE];
+	bool cache;
 
 	if (tegra_codec_conf)
 		return tegra_codec_conf;
@@ -3196,15 +3250,30 @@ struct snd_soc_codec_conf *tegra_machine_new_codec_conf(
 	if (!np)
 		goto err;
 
+	mutex_lock(&codec_cache_lock);
+	if (codec_cache.np == np && codec_cache.conf) {
+		*pnum_codec_links = codec_cache.num_conf;
+		mutex_unlock(&codec_cache_lock);
+		return codec_cache.conf;
+	}
+
 	if (of_property_read_u32(np,
 		"nvidia,num-codec-link", (u32 *)&num_codec_links)) {
 		dev_err(&pdev->dev,
 			"Property 'nvidia,num-codec-link' missing or invalid\n");
-		goto err;
+		goto err_unlock;
 	}
 
-	tegra_codec_conf =  devm_kzalloc(&pdev->dev, num_codec_links *
-		sizeof(struct snd_soc_codec_conf), GFP_KERNEL);
+	/* only cached alongside the codec links of the same node */
+	cache = codec_cache.np == np;
+	if (cache)
+		tegra_codec_conf = kcalloc(num_codec_links,
+			sizeof(struct snd_soc_codec_conf), GFP_KERNEL);
+	else
+		tegra_codec_conf = devm_kcalloc(&pdev->dev, num_codec_links,
+			sizeof(struct snd_soc_codec_conf), GFP_KERNEL);
+	if (!tegra_codec_conf)
+		goto err_unlock;
 
 	for (i = 0; i < num_codec_links; i++) {
 		memset((void *)dai_link_name, '\0', MAX_STR_SIZE);
@@ -3222,14 +3291,24 @@ struct snd_soc_codec_conf *tegra_machine_new_codec_conf(
 				&tegra_codec_conf[i].name_prefix)) {
 				dev_err(&pdev->dev,
 					"Property 'name-prefix' missing or invalid\n");
-				goto err;
+				if (cache)
+					kfree(tegra_codec_conf);
+				goto err_unlock;
 			}
 		}
 	}
 
+	if (cache) {
+		codec_cache.conf = tegra_codec_conf;
+		codec_cache.num_conf = num_codec_links;
+	}
+	mutex_unlock(&codec_cache_lock);
+
 	*pnum_codec_links = num_codec_links;
 
 	return tegra_codec_conf;
+err_unlock:
+	mutex_unlock(&codec_cache_lock);
 err:
 	return NULL;
 }
@@ -3410,6 +3489,11 @@ int tegra_machine_append_dai_link_t18x(struct snd_soc_dai_link *link,
 
 	if (!tegra_asoc_machine_links_t18x) {
 		if (link) {
+			/* copy, the caller's links may be cached */
+			link = kmemdup(link, size2 *
+				sizeof(struct snd_soc_dai_link), GFP_KERNEL);
+			if (!link)
+				return 0;
 			tegra_machine_set_machine_links(link);
 			tegra_machine_set_num_dai_links(size2);
 			return size2;
@@ -3468,6 +3552,10 @@ int tegra_machine_append_codec_conf_t18x(struct snd_soc_codec_conf *conf,
 
 	if (!tegra_asoc_codec_conf_t18x) {
 		if (conf) {
+			conf = kmemdup(conf, size2 *
+				sizeof(struct snd_soc_codec_conf), GFP_KERNEL);
+			if (!conf)
+				return 0;
 			tegra_machine_set_machine_codec_conf(conf);
 			return size2;
 		} else {
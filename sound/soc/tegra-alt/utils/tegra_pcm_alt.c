@@ -29,6 +29,7 @@
  *
  */
 #include <linux/dma-mapping.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <sound/pcm.h>
 #include <sound/pcm_params.h>
@@ -75,6 +76,14 @@ static int tegra_alt_pcm_open(struct snd_pcm_substream *substream)
 	if (dmap->buffer_size > substream->runtime->hw.buffer_bytes_max)
 		substream->runtime->hw.buffer_bytes_max = dmap->buffer_size;
 
+	if (dmap->low_latency) {
+		substream->runtime->hw.period_bytes_min =
+			TEGRA_ALT_PCM_LL_PERIOD_BYTES_MIN;
+		substream->runtime->hw.periods_min = 2;
+		substream->runtime->hw.periods_max =
+			TEGRA_ALT_PCM_LL_PERIODS_MAX;
+	}
+
 	/* Ensure period size is multiple of 8 */
 	ret = snd_pcm_hw_constraint_step(substream->runtime, 0,
 		SNDRV_PCM_HW_PARAM_PERIOD_BYTES, 0x8);
@@ -131,14 +140,17 @@ static int tegra_alt_pcm_hw_params(struct snd_pcm_substream *substream,
 		return ret;
 	}
 
+	/* Short bursts keep less data in flight between FIFO and memory */
 	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		slave_config.dst_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
 		slave_config.dst_addr = dmap->addr;
-		slave_config.dst_maxburst = 8;
+		slave_config.dst_maxburst = dmap->low_latency ?
+			TEGRA_ALT_PCM_LL_MAXBURST : 8;
 	} else {
 		slave_config.src_addr_width = DMA_SLAVE_BUSWIDTH_4_BYTES;
 		slave_config.src_addr = dmap->addr;
-		slave_config.src_maxburst = 8;
+		slave_config.src_maxburst = dmap->low_latency ?
+			TEGRA_ALT_PCM_LL_MAXBURST : 8;
 	}
 	slave_config.slave_id = dmap->req_sel;
 
@@ -163,6 +175,45 @@ static int tegra_alt_pcm_hw_free(struct snd_pcm_substream *substream)
 	return 0;
 }
 
+static int tegra_alt_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct tegra_alt_pcm_dma_params *dmap;
+
+	dmap = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
+	if (dmap && dmap->low_latency && cmd == SNDRV_PCM_TRIGGER_START) {
+		dmap->start = ktime_get();
+		dmap->latency_us = 0;
+	}
+
+	return snd_dmaengine_pcm_trigger(substream, cmd);
+}
+
+/*
+ * The dmaengine pointer reads the DMA residue on every call, so for low
+ * latency streams it is fine grained enough to be polled by userspace
+ * between period interrupts. The first time it moves after a start is
+ * how long the path took to fill, which is kept for the CPU DAI.
+ */
+static snd_pcm_uframes_t tegra_alt_pcm_pointer(
+				struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct tegra_alt_pcm_dma_params *dmap;
+	snd_pcm_uframes_t pos;
+
+	pos = snd_dmaengine_pcm_pointer(substream);
+
+	dmap = snd_soc_dai_get_dma_data(rtd->cpu_dai, substream);
+	if (dmap && dmap->low_latency && pos &&
+	    ktime_to_ns(dmap->start)) {
+		dmap->latency_us = ktime_us_delta(ktime_get(), dmap->start);
+		dmap->start = ktime_set(0, 0);
+	}
+
+	return pos;
+}
+
 static int tegra_alt_pcm_mmap(struct snd_pcm_substream *substream,
 				struct vm_area_struct *vma)
 {
@@ -184,8 +235,8 @@ static struct snd_pcm_ops tegra_alt_pcm_ops = {
 	.ioctl		= snd_pcm_lib_ioctl,
 	.hw_params	= tegra_alt_pcm_hw_params,
 	.hw_free	= tegra_alt_pcm_hw_free,
-	.trigger	= snd_dmaengine_pcm_trigger,
-	.pointer	= snd_dmaengine_pcm_pointer,
+	.trigger	= tegra_alt_pcm_trigger,
+	.pointer	= tegra_alt_pcm_pointer,
 	.mmap		= tegra_alt_pcm_mmap,
 };
 
@@ -27,8 +27,11 @@
 #include <linux/of_platform.h>
 #include <linux/pm_runtime.h>
 #include <linux/tegra_pm_domains.h>
+#include <linux/slab.h>
+#include <sound/control.h>
 
 
+#include "tegra_virt_alt_ivc.h"
 #include "tegra_asoc_machine_virt_alt.h"
 
 #define CODEC_NAME		NULL
@@ -889,6 +892,106 @@ void tegra_virt_machine_set_adsp_admaif_dai_params(
 }
 EXPORT_SYMBOL(tegra_virt_machine_set_adsp_admaif_dai_params);
 
+static int tegra_virt_machine_put_control(struct snd_kcontrol *kctl,
+		const char *val)
+{
+	struct snd_ctl_elem_info *uinfo;
+	struct snd_ctl_elem_value *ucontrol;
+	unsigned int i;
+	long value;
+	int err;
+
+	uinfo = kzalloc(sizeof(*uinfo), GFP_KERNEL);
+	ucontrol = kzalloc(sizeof(*ucontrol), GFP_KERNEL);
+	if (!uinfo || !ucontrol) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = kctl->info(kctl, uinfo);
+	if (err < 0)
+		goto out;
+
+	switch (uinfo->type) {
+	case SNDRV_CTL_ELEM_TYPE_ENUMERATED:
+		err = -EINVAL;
+		for (i = 0; i < uinfo->value.enumerated.items; i++) {
+			uinfo->value.enumerated.item = i;
+			kctl->info(kctl, uinfo);
+			if (!strcmp(uinfo->value.enumerated.name, val)) {
+				ucontrol->value.enumerated.item[0] = i;
+				err = 0;
+				break;
+			}
+		}
+		break;
+	case SNDRV_CTL_ELEM_TYPE_BOOLEAN:
+	case SNDRV_CTL_ELEM_TYPE_INTEGER:
+		err = kstrtol(val, 0, &value);
+		ucontrol->value.integer.value[0] = value;
+		break;
+	default:
+		err = -EINVAL;
+		break;
+	}
+
+	if (!err)
+		err = kctl->put(kctl, ucontrol);
+out:
+	kfree(ucontrol);
+	kfree(uinfo);
+	return err < 0 ? err : 0;
+}
+
+/*
+ * Apply the "init-controls" name/value string pairs from DT. The control
+ * messages they produce reach the audio server in as few IVC frames as
+ * possible, with one acknowledgement for all of them.
+ */
+int tegra_virt_machine_init_controls(struct snd_soc_card *card)
+{
+	struct device_node *np = card->dev->of_node;
+	struct nvaudio_ivc_ctxt *hivc_client;
+	struct snd_kcontrol *kctl;
+	const char *name, *val;
+	int i, num, err;
+
+	num = of_property_count_strings(np, "init-controls");
+	if (num <= 0)
+		return 0;
+	if (num % 2) {
+		dev_err(card->dev, "init-controls must be name/value pairs\n");
+		return -EINVAL;
+	}
+
+	hivc_client = nvaudio_ivc_alloc_ctxt(card->dev);
+	if (!hivc_client)
+		return -ENODEV;
+
+	err = nvaudio_ivc_batch_begin(hivc_client);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < num; i += 2) {
+		of_property_read_string_index(np, "init-controls", i, &name);
+		of_property_read_string_index(np, "init-controls", i + 1,
+					      &val);
+
+		kctl = snd_soc_card_get_kcontrol(card, name);
+		if (!kctl || !kctl->put) {
+			dev_err(card->dev, "no control %s\n", name);
+			continue;
+		}
+
+		if (tegra_virt_machine_put_control(kctl, val))
+			dev_err(card->dev, "failed to set %s to %s\n",
+				name, val);
+	}
+
+	return nvaudio_ivc_batch_end(hivc_client);
+}
+EXPORT_SYMBOL(tegra_virt_machine_init_controls);
+
 MODULE_AUTHOR("Dipesh Gandhi <dipeshg@nvidia.com>");
 MODULE_DESCRIPTION("Tegra Virt ASoC machine code");
 MODULE_LICENSE("GPL");
@@ -99,4 +99,5 @@ unsigned int tegra_virt_machine_get_num_dai_links(void);
 void tegra_virt_machine_set_num_dai_links(unsigned int val);
 void tegra_virt_machine_set_adsp_admaif_dai_params(
 		uint32_t id, struct snd_soc_pcm_stream *params);
+int tegra_virt_machine_init_controls(struct snd_soc_card *card);
 #endif
@@ -111,7 +111,7 @@ int tegra_virt_t210mixer_set_gain(struct snd_kcontrol *kcontrol,
 		ucontrol->value.integer.value[0];
 	msg.params.amixer_info.is_instant_gain = 0;
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -143,7 +143,7 @@ int tegra_virt_t210mixer_set_gain_instant(struct snd_kcontrol *kcontrol,
 		ucontrol->value.integer.value[0];
 	msg.params.amixer_info.is_instant_gain = 1;
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -213,7 +213,7 @@ int tegra_virt_t210mixer_set_duration(struct snd_kcontrol *kcontrol,
 		ucontrol->value.integer.value[0];
 	msg.params.amixer_info.is_instant_gain = 0;
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -292,7 +292,7 @@ int tegra_virt_t210mixer_set_adder_config(struct snd_kcontrol *kcontrol,
 	msg.params.amixer_info.adder_rx_idx_enable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -358,7 +358,7 @@ int tegra_virt_t210mixer_set_enable(struct snd_kcontrol *kcontrol,
 	msg.params.amixer_info.enable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -426,7 +426,7 @@ int tegra_virt_t210sfc_set_in_freq(struct snd_kcontrol *kcontrol,
 	msg.params.sfc_info.in_freq =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -494,7 +494,7 @@ int tegra_virt_t210sfc_set_out_freq(struct snd_kcontrol *kcontrol,
 	msg.params.sfc_info.out_freq =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -529,7 +529,7 @@ int tegra_virt_t210mvc_set_curve_type(struct snd_kcontrol *kcontrol,
 	msg.params.mvc_info.curve_type =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -566,7 +566,7 @@ int tegra_virt_t210mvc_set_tar_vol(struct snd_kcontrol *kcontrol,
 	msg.params.mvc_info.tar_vol =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -602,7 +602,7 @@ int tegra_virt_t210mvc_set_mute(struct snd_kcontrol *kcontrol,
 	msg.params.mvc_info.mute =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -681,7 +681,7 @@ int tegra186_virt_asrc_set_ratio(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.frac_ratio =
 		(val & 0xffffffffULL);
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -752,7 +752,7 @@ int tegra186_virt_asrc_set_int_ratio(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.int_ratio =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -822,7 +822,7 @@ int tegra186_virt_asrc_set_frac_ratio(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.frac_ratio =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -889,7 +889,7 @@ int tegra186_virt_asrc_set_ratio_source(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.ratio_source =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -960,7 +960,7 @@ int tegra186_virt_asrc_set_stream_enable(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.stream_enable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1031,7 +1031,7 @@ int tegra186_virt_asrc_set_hwcomp_disable(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.hwcomp_disable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1104,7 +1104,7 @@ int tegra186_virt_asrc_set_input_threshold(struct snd_kcontrol *kcontrol,
 	msg.params.asrc_info.input_threshold =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1178,7 +1178,7 @@ int tegra186_virt_asrc_set_output_threshold(
 	msg.params.asrc_info.output_threshold =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1219,7 +1219,7 @@ int tegra_virt_t210_amx_set_input_stream_enable(
 	msg.params.amx_info.amx_stream_enable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1314,7 +1314,7 @@ int tegra186_virt_arad_set_lane_source(
 		msg.params.arad_info.den_source = -1;
 	}
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1402,7 +1402,7 @@ int tegra186_virt_arad_set_lane_prescalar(
 		msg.params.arad_info.den_prescalar = -1;
 	}
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1476,7 +1476,7 @@ int tegra186_virt_arad_set_lane_enable(
 	msg.params.arad_info.lane_enable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1593,7 +1593,7 @@ int tegra_virt_i2s_set_loopback_enable(
 	msg.params.i2s_info.i2s_loopback_enable =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -1665,7 +1665,7 @@ int tegra_virt_i2s_set_rate(
 	msg.params.i2s_info.i2s_rate =
 		ucontrol->value.integer.value[0];
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
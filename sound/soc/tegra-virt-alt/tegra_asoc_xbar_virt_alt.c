@@ -17,6 +17,7 @@
  */
 
 #include <linux/module.h>
+#include <linux/of.h>
 
 #include "tegra_virt_alt_ivc.h"
 #include "tegra_asoc_util_virt_alt.h"
@@ -24,6 +25,26 @@
 
 static const struct soc_enum *tegra_virt_enum_source;
 
+/*
+ * Last route set or read per mux, as item + 1 so zero means unknown.
+ * Lets get skip the IVC round trip and put skip unchanged routes.
+ */
+static unsigned int tegra_virt_route_cache[TEGRA_VIRT_XBAR_MAX_MUX];
+
+static struct tegra_virt_xbar_preset *tegra_virt_presets;
+static unsigned int tegra_virt_num_presets;
+static const char **tegra_virt_preset_texts;
+static struct soc_enum tegra_virt_preset_enum;
+static unsigned int tegra_virt_active_preset;
+
+static inline unsigned int *tegra_virt_route_cached(unsigned int reg)
+{
+	unsigned int idx = reg / TEGRA_XBAR_RX_STRIDE;
+
+	return idx < TEGRA_VIRT_XBAR_MAX_MUX ?
+		&tegra_virt_route_cache[idx] : NULL;
+}
+
 #define DAI(sname)						\
 	{							\
 		.name = #sname " CIF",				\
@@ -821,12 +842,226 @@ static int tegra_virt_xbar_write(struct snd_soc_component *component,
 	return 0;
 }
 
+static int tegra_virt_xbar_send_preset(struct nvaudio_ivc_ctxt *hivc_client,
+				       struct nvaudio_ivc_msg *msg)
+{
+	int err;
+
+	if (!msg->params.xbar_preset.num_routes)
+		return 0;
+
+	err = nvaudio_ivc_send_retry(hivc_client, msg,
+			sizeof(struct nvaudio_ivc_msg));
+	if (err < 0)
+		pr_err("%s: Timedout on ivc_send_retry\n", __func__);
+
+	msg->params.xbar_preset.num_routes = 0;
+
+	return err;
+}
+
+/*
+ * Every route is resolved before anything is sent. Routes already on the
+ * requested source are dropped and the rest go to the server in as few
+ * messages as fit, normally one per preset, before DAPM is told.
+ */
+static int tegra_virt_xbar_apply_preset(struct snd_soc_card *card,
+				struct tegra_virt_xbar_preset *preset)
+{
+	struct nvaudio_ivc_ctxt *hivc_client =
+		nvaudio_ivc_alloc_ctxt(card->dev);
+	struct nvaudio_ivc_xbar_preset *p;
+	struct tegra_virt_xbar_route *route;
+	struct nvaudio_ivc_xbar_route *r;
+	struct nvaudio_ivc_msg msg;
+	unsigned int i, j, *cached;
+	struct soc_enum *e;
+	int err;
+
+	for (i = 0; i < preset->num_routes; i++) {
+		route = &preset->routes[i];
+		route->kctl = snd_soc_card_get_kcontrol(card, route->mux);
+		if (!route->kctl) {
+			dev_err(card->dev, "preset %s: no control %s\n",
+				preset->name, route->mux);
+			return -EINVAL;
+		}
+
+		e = (struct soc_enum *)route->kctl->private_value;
+		for (j = 0; j < e->items; j++)
+			if (!strcmp(e->texts[j], route->src))
+				break;
+		if (j == e->items) {
+			dev_err(card->dev, "preset %s: %s can't select %s\n",
+				preset->name, route->mux, route->src);
+			return -EINVAL;
+		}
+		route->item = j;
+	}
+
+	memset(&msg, 0, sizeof(struct nvaudio_ivc_msg));
+	msg.cmd = NVAUDIO_XBAR_SET_ROUTE_PRESET;
+	p = &msg.params.xbar_preset;
+
+	for (i = 0; i < preset->num_routes; i++) {
+		route = &preset->routes[i];
+		e = (struct soc_enum *)route->kctl->private_value;
+		cached = tegra_virt_route_cached(e->reg);
+		if (!cached) {
+			route->kctl = NULL;
+			continue;
+		}
+		if (*cached == route->item + 1) {
+			route->kctl = NULL;
+			continue;
+		}
+
+		r = &p->routes[p->num_routes++];
+		r->rx_idx = e->reg / TEGRA_XBAR_RX_STRIDE;
+		r->tx_idx = route->item - 1;
+		r->tx_value = e->values[route->item];
+
+		if (p->num_routes == NVAUDIO_XBAR_PRESET_MAX_ROUTES) {
+			err = tegra_virt_xbar_send_preset(hivc_client, &msg);
+			if (err < 0)
+				return err;
+		}
+	}
+
+	err = tegra_virt_xbar_send_preset(hivc_client, &msg);
+	if (err < 0)
+		return err;
+
+	for (i = 0; i < preset->num_routes; i++) {
+		route = &preset->routes[i];
+		if (!route->kctl)
+			continue;
+
+		e = (struct soc_enum *)route->kctl->private_value;
+		*tegra_virt_route_cached(e->reg) = route->item + 1;
+		snd_soc_dapm_mux_update_power(
+			snd_soc_dapm_kcontrol_dapm(route->kctl),
+			route->kctl, route->item, e, NULL);
+		snd_ctl_notify(card->snd_card, SNDRV_CTL_EVENT_MASK_VALUE,
+			       &route->kctl->id);
+	}
+
+	return 0;
+}
+
+static int tegra_virt_xbar_get_preset(struct snd_kcontrol *kcontrol,
+				      struct snd_ctl_elem_value *ucontrol)
+{
+	ucontrol->value.enumerated.item[0] = tegra_virt_active_preset;
+
+	return 0;
+}
+
+static int tegra_virt_xbar_put_preset(struct snd_kcontrol *kcontrol,
+				      struct snd_ctl_elem_value *ucontrol)
+{
+	struct snd_soc_component *component =
+		snd_soc_kcontrol_component(kcontrol);
+	unsigned int item = ucontrol->value.enumerated.item[0];
+	int err;
+
+	if (item > tegra_virt_num_presets)
+		return -EINVAL;
+
+	/* "None" only forgets the active preset, routes stay as they are */
+	if (item) {
+		err = tegra_virt_xbar_apply_preset(component->card,
+				&tegra_virt_presets[item - 1]);
+		if (err < 0)
+			return err;
+	}
+
+	if (tegra_virt_active_preset == item)
+		return 0;
+
+	tegra_virt_active_preset = item;
+	return 1;
+}
+
+/* Each child of route-presets is a preset with a "routes" string list */
+static int tegra_virt_xbar_parse_presets(struct device *dev)
+{
+	struct device_node *np, *child;
+	struct tegra_virt_xbar_preset *preset;
+	unsigned int i = 0, j;
+	int count;
+
+	np = of_get_child_by_name(dev->of_node, "route-presets");
+	if (!np)
+		return 0;
+
+	count = of_get_child_count(np);
+	tegra_virt_presets = devm_kcalloc(dev, count,
+				sizeof(*tegra_virt_presets), GFP_KERNEL);
+	tegra_virt_preset_texts = devm_kcalloc(dev, count + 1,
+				sizeof(char *), GFP_KERNEL);
+	if (!tegra_virt_presets || !tegra_virt_preset_texts) {
+		of_node_put(np);
+		return -ENOMEM;
+	}
+	tegra_virt_preset_texts[0] = "None";
+
+	for_each_child_of_node(np, child) {
+		count = of_property_count_strings(child, "routes");
+		if (count <= 0 || count % 2) {
+			dev_err(dev, "Invalid routes in preset %s\n",
+				child->name);
+			continue;
+		}
+
+		preset = &tegra_virt_presets[i];
+		preset->routes = devm_kcalloc(dev, count / 2,
+				sizeof(*preset->routes), GFP_KERNEL);
+		if (!preset->routes) {
+			of_node_put(child);
+			of_node_put(np);
+			return -ENOMEM;
+		}
+
+		for (j = 0; j < count / 2; j++) {
+			of_property_read_string_index(child, "routes", 2 * j,
+						      &preset->routes[j].mux);
+			of_property_read_string_index(child, "routes",
+						      2 * j + 1,
+						      &preset->routes[j].src);
+		}
+		preset->num_routes = count / 2;
+		preset->name = child->name;
+		tegra_virt_preset_texts[++i] = preset->name;
+	}
+	of_node_put(np);
+
+	tegra_virt_num_presets = i;
+
+	return 0;
+}
+
+static const struct snd_kcontrol_new tegra_virt_xbar_preset_ctrl =
+	SOC_ENUM_EXT("XBAR Route Preset", tegra_virt_preset_enum,
+		     tegra_virt_xbar_get_preset, tegra_virt_xbar_put_preset);
+
 static int tegra_virt_xbar_component_probe(struct snd_soc_component *component)
 {
+	int err;
+
 	component->read = tegra_virt_xbar_read;
 	component->write = tegra_virt_xbar_write;
 
-	return 0;
+	err = tegra_virt_xbar_parse_presets(component->dev);
+	if (err < 0 || !tegra_virt_num_presets)
+		return err;
+
+	tegra_virt_preset_enum.reg = SND_SOC_NOPM;
+	tegra_virt_preset_enum.items = tegra_virt_num_presets + 1;
+	tegra_virt_preset_enum.texts = tegra_virt_preset_texts;
+
+	return snd_soc_add_component_controls(component,
+				&tegra_virt_xbar_preset_ctrl, 1);
 }
 
 static struct snd_soc_codec_driver tegra186_virt_xbar_codec = {
@@ -849,9 +1084,15 @@ int tegra_virt_get_route(struct snd_kcontrol *kcontrol,
 	uint64_t reg = (uint64_t)e->reg;
 	struct nvaudio_ivc_ctxt *hivc_client =
 		nvaudio_ivc_alloc_ctxt(card->dev);
+	unsigned int *cached = tegra_virt_route_cached(e->reg);
 	int err, i = 0;
 	struct nvaudio_ivc_msg msg;
 
+	if (cached && *cached) {
+		ucontrol->value.integer.value[0] = *cached - 1;
+		return 0;
+	}
+
 	memset(&msg, 0, sizeof(struct nvaudio_ivc_msg));
 	msg.cmd = NVAUDIO_XBAR_GET_ROUTE;
 	msg.params.xbar_info.rx_reg = (int) reg;
@@ -885,6 +1126,9 @@ int tegra_virt_get_route(struct snd_kcontrol *kcontrol,
 	if (err < 0)
 		return err;
 
+	if (cached && i < e->items)
+		*cached = i + 1;
+
 	return 0;
 }
 EXPORT_SYMBOL(tegra_virt_get_route);
@@ -898,11 +1142,16 @@ int tegra_virt_put_route(struct snd_kcontrol *kcontrol,
 	uint64_t reg = (uint64_t)e->reg;
 	struct nvaudio_ivc_ctxt *hivc_client =
 		nvaudio_ivc_alloc_ctxt(card->dev);
+	unsigned int *cached = tegra_virt_route_cached(e->reg);
 	int err;
 	struct nvaudio_ivc_msg msg;
 	struct snd_soc_dapm_context *dapm =
 				snd_soc_dapm_kcontrol_dapm(kcontrol);
 
+	/* nothing to send or re-power when the route is unchanged */
+	if (cached && *cached == ucontrol->value.integer.value[0] + 1)
+		return 0;
+
 	memset(&msg, 0, sizeof(struct nvaudio_ivc_msg));
 	msg.cmd = NVAUDIO_XBAR_SET_ROUTE;
 	msg.params.xbar_info.rx_reg = (int) reg;
@@ -912,7 +1161,7 @@ int tegra_virt_put_route(struct snd_kcontrol *kcontrol,
 	msg.params.xbar_info.tx_idx =
 		ucontrol->value.integer.value[0] - 1;
 
-	err = nvaudio_ivc_send_retry(hivc_client,
+	err = nvaudio_ivc_send_ctrl(hivc_client,
 			&msg,
 			sizeof(struct nvaudio_ivc_msg));
 	if (err < 0) {
@@ -920,6 +1169,9 @@ int tegra_virt_put_route(struct snd_kcontrol *kcontrol,
 		return err;
 	}
 
+	if (cached)
+		*cached = ucontrol->value.integer.value[0] + 1;
+
 	snd_soc_dapm_mux_update_power(dapm, kcontrol,
 				ucontrol->value.integer.value[0], e, NULL);
 
@@ -26,6 +26,24 @@
 #define TEGRA_T210_SRC_NUM_MUX	55
 
 #define MUX_REG(id) (TEGRA_XBAR_RX_STRIDE * (id))
+
+/* Mux registers with a cached route, covers every mux of both chips */
+#define TEGRA_VIRT_XBAR_MAX_MUX	0x80
+
+/* One "<mux control>", "<source>" pair of a route preset */
+struct tegra_virt_xbar_route {
+	const char *mux;
+	const char *src;
+	/* resolved while a preset is applied */
+	struct snd_kcontrol *kctl;
+	unsigned int item;
+};
+
+struct tegra_virt_xbar_preset {
+	const char *name;
+	struct tegra_virt_xbar_route *routes;
+	unsigned int num_routes;
+};
 #define SOC_ENUM_EXT_REG(xname, xcount, xenum, xhandler_get, xhandler_put) \
 {	.iface = SNDRV_CTL_ELEM_IFACE_MIXER, .name = xname, \
 	.info = snd_soc_info_enum_double, \
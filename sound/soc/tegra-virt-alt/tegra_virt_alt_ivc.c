@@ -22,6 +22,7 @@
 #include <linux/delay.h>
 #include <linux/tegra-ivc.h>
 #include <linux/spinlock.h>
+#include <linux/slab.h>
 #include <linux/hardirq.h>
 #include <linux/interrupt.h>
 
@@ -33,15 +34,12 @@ static struct nvaudio_ivc_ctxt *saved_ivc_ctxt;
 static void nvaudio_ivc_deinit(struct nvaudio_ivc_ctxt *ictxt);
 static int nvaudio_ivc_init(struct nvaudio_ivc_ctxt *ictxt);
 
-int nvaudio_ivc_send_retry(struct nvaudio_ivc_ctxt *ictxt,
+static int __nvaudio_ivc_send_retry(struct nvaudio_ivc_ctxt *ictxt,
 		struct nvaudio_ivc_msg *msg, int size)
 {
 	int err = 0;
 	int dcnt = 50;
 
-	if (!ictxt || !ictxt->ivck || !msg || !size)
-		return -EINVAL;
-
 	err = nvaudio_ivc_send(ictxt, msg, size);
 
 	while (err < 0 && dcnt--) {
@@ -51,8 +49,192 @@ int nvaudio_ivc_send_retry(struct nvaudio_ivc_ctxt *ictxt,
 	return (dcnt < 0) ? -ETIMEDOUT : err;
 
 }
+
+/*
+ * Send the queued control messages as one frame, behind a batch header.
+ * Called with ictxt->lock held.
+ */
+static int nvaudio_ivc_batch_flush(struct nvaudio_ivc_ctxt *ictxt, bool ack)
+{
+	struct nvaudio_ivc_msg *hdr = &ictxt->batch[0];
+	int size;
+
+	if (!ictxt->batch_count && !ack)
+		return 0;
+
+	memset(hdr, 0, sizeof(struct nvaudio_ivc_msg));
+	hdr->cmd = NVAUDIO_MSG_BATCH;
+	hdr->params.msg_batch.num_msgs = ictxt->batch_count;
+	hdr->params.msg_batch.seq = ictxt->batch_seq;
+	hdr->ack_required = ack;
+
+	size = (ictxt->batch_count + 1) * sizeof(struct nvaudio_ivc_msg);
+	ictxt->batch_count = 0;
+	ictxt->batch_frames++;
+
+	return __nvaudio_ivc_send_retry(ictxt, hdr, size);
+}
+
+int nvaudio_ivc_send_retry(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_msg *msg, int size)
+{
+	unsigned long flags;
+	int err;
+
+	if (!ictxt || !ictxt->ivck || !msg || !size)
+		return -EINVAL;
+
+	/* Anything queued goes out first so reads see earlier writes */
+	if (READ_ONCE(ictxt->batch_count)) {
+		spin_lock_irqsave(&ictxt->lock, flags);
+		err = ictxt->batching ?
+			nvaudio_ivc_batch_flush(ictxt, false) : 0;
+		spin_unlock_irqrestore(&ictxt->lock, flags);
+		if (err < 0)
+			return err;
+	}
+
+	return __nvaudio_ivc_send_retry(ictxt, msg, size);
+}
 EXPORT_SYMBOL_GPL(nvaudio_ivc_send_retry);
 
+/*
+ * Send a message that expects no reply. Between nvaudio_ivc_batch_begin()
+ * and nvaudio_ivc_batch_end() it is queued instead, and goes out packed
+ * with others once the frame is full or the batch ends.
+ */
+int nvaudio_ivc_send_ctrl(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_msg *msg, int size)
+{
+	unsigned long flags;
+	int err = size;
+
+	if (!ictxt || !ictxt->ivck || !msg ||
+	    size != sizeof(struct nvaudio_ivc_msg))
+		return nvaudio_ivc_send_retry(ictxt, msg, size);
+
+	spin_lock_irqsave(&ictxt->lock, flags);
+	if (!ictxt->batching) {
+		spin_unlock_irqrestore(&ictxt->lock, flags);
+		return nvaudio_ivc_send_retry(ictxt, msg, size);
+	}
+
+	if (ictxt->batch_count == ictxt->batch_max) {
+		err = nvaudio_ivc_batch_flush(ictxt, false);
+		if (err < 0)
+			goto out;
+		err = size;
+	}
+
+	msg->ack_required = false;
+	memcpy(&ictxt->batch[1 + ictxt->batch_count], msg, size);
+	ictxt->batch_count++;
+
+out:
+	spin_unlock_irqrestore(&ictxt->lock, flags);
+	return err;
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_send_ctrl);
+
+/*
+ * Start queueing control messages. Nothing is batched, and messages keep
+ * going out one by one, if the IVC frame cannot hold more than one.
+ */
+int nvaudio_ivc_batch_begin(struct nvaudio_ivc_ctxt *ictxt)
+{
+	struct nvaudio_ivc_msg *batch;
+	unsigned long flags;
+	unsigned int max;
+
+	if (!ictxt || !ictxt->ivck)
+		return -EINVAL;
+
+	max = ictxt->ivck->frame_size / sizeof(struct nvaudio_ivc_msg);
+	if (max < 2) {
+		dev_info(ictxt->dev, "IVC frame too small for batching\n");
+		return 0;
+	}
+
+	batch = kcalloc(max, sizeof(struct nvaudio_ivc_msg), GFP_KERNEL);
+	if (!batch)
+		return -ENOMEM;
+
+	spin_lock_irqsave(&ictxt->lock, flags);
+	if (ictxt->batching) {
+		spin_unlock_irqrestore(&ictxt->lock, flags);
+		kfree(batch);
+		return -EBUSY;
+	}
+	ictxt->batch = batch;
+	ictxt->batch_max = max - 1;
+	ictxt->batch_count = 0;
+	ictxt->batch_frames = 0;
+	ictxt->batching = true;
+	spin_unlock_irqrestore(&ictxt->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_batch_begin);
+
+/*
+ * Send what is left with an acknowledgement request and wait for the one
+ * reply covering the whole batch.
+ */
+int nvaudio_ivc_batch_end(struct nvaudio_ivc_ctxt *ictxt)
+{
+	struct nvaudio_ivc_msg *batch, msg;
+	unsigned long flags;
+	bool ack = false;
+	uint32_t seq;
+	int err = 0;
+
+	if (!ictxt)
+		return -EINVAL;
+
+	spin_lock_irqsave(&ictxt->lock, flags);
+	if (!ictxt->batching) {
+		spin_unlock_irqrestore(&ictxt->lock, flags);
+		return 0;
+	}
+
+	seq = ictxt->batch_seq;
+	if (ictxt->batch_count || ictxt->batch_frames) {
+		err = nvaudio_ivc_batch_flush(ictxt, true);
+		ack = err >= 0;
+	}
+	ictxt->batch_seq++;
+	ictxt->batching = false;
+	batch = ictxt->batch;
+	ictxt->batch = NULL;
+	spin_unlock_irqrestore(&ictxt->lock, flags);
+
+	kfree(batch);
+
+	if (err < 0) {
+		dev_err(ictxt->dev, "control batch %u send failed (%d)\n",
+			seq, err);
+		return err;
+	}
+	if (!ack)
+		return 0;
+
+	memset(&msg, 0, sizeof(struct nvaudio_ivc_msg));
+	if (nvaudio_ivc_receive_cmd(ictxt, &msg, sizeof(msg),
+				    NVAUDIO_MSG_BATCH)) {
+		dev_err(ictxt->dev, "no ack for control batch %u\n", seq);
+		return -EIO;
+	}
+
+	if (msg.err) {
+		dev_err(ictxt->dev, "control batch %u failed (%d)\n",
+			msg.params.msg_batch.seq, msg.err);
+		return -EIO;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_batch_end);
+
 int nvaudio_ivc_send(struct nvaudio_ivc_ctxt *ictxt,
 		struct nvaudio_ivc_msg *msg, int size)
 {
@@ -94,29 +276,21 @@ fail:
 }
 EXPORT_SYMBOL_GPL(nvaudio_ivc_send);
 
-int nvaudio_ivc_receive_cmd(struct nvaudio_ivc_ctxt *ictxt,
-			struct nvaudio_ivc_msg *rx_msg,
-			int size, enum nvaudio_ivc_cmd_t  cmd)
-{
-	int err = -1;
-
-	while (size == nvaudio_ivc_receive(ictxt, rx_msg, size)) {
-		if (rx_msg->cmd == cmd) {
-			err = 0;
-			break;
-		}
-	}
-	return err;
-
-}
-EXPORT_SYMBOL_GPL(nvaudio_ivc_receive_cmd);
-
-int nvaudio_ivc_receive(struct nvaudio_ivc_ctxt *ictxt,
-			struct nvaudio_ivc_msg *rx_msg, int size)
+/*
+ * Receive the next message, parsing it in place in the IVC frame. Only a
+ * message matching @cmd, or any message if @cmd is negative, is copied
+ * out to @rx_msg; others are dropped without a copy. Returns the message
+ * size for every message consumed, 0 or negative on failure.
+ */
+static int nvaudio_ivc_receive_match(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size, int cmd,
+			bool *matched)
 {
+	const struct nvaudio_ivc_msg *frame;
 	unsigned long flags;
 	int err = 0;
-	u32 len = 0;
+
+	*matched = false;
 
 	while (!tegra_hv_ivc_can_read(ictxt->ivck)) {
 		wait_event_timeout(ictxt->wait,
@@ -129,25 +303,51 @@ int nvaudio_ivc_receive(struct nvaudio_ivc_ctxt *ictxt,
 		return 0;
 	}
 
+	if (ictxt->ivck->frame_size < sizeof(struct nvaudio_ivc_msg)) {
+		dev_err(ictxt->dev, "IVC read failure (msg size error)\n");
+		return -1;
+	}
+
 	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
-	if (tegra_hv_ivc_can_read(ictxt->ivck)) {
+	frame = tegra_hv_ivc_read_get_next_frame(ictxt->ivck);
+	if (!IS_ERR_OR_NULL(frame)) {
 		/* Message available */
-		memset(rx_msg, 0, sizeof(struct nvaudio_ivc_msg));
 		ictxt->rx_state = RX_DONE;
-		len = tegra_hv_ivc_read(ictxt->ivck,
-					rx_msg,
-					sizeof(struct nvaudio_ivc_msg));
-		if (len != sizeof(struct nvaudio_ivc_msg)) {
-			dev_err(ictxt->dev, "IVC read failure (msg size error)\n");
-			err = -1;
-			goto fail;
+		if (cmd < 0 || frame->cmd == cmd) {
+			memcpy(rx_msg, frame, sizeof(struct nvaudio_ivc_msg));
+			*matched = true;
 		}
+		tegra_hv_ivc_read_advance(ictxt->ivck);
+		err = sizeof(struct nvaudio_ivc_msg);
 	}
-	err = len;
-fail:
 	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+
 	return err;
 }
+
+int nvaudio_ivc_receive_cmd(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg,
+			int size, enum nvaudio_ivc_cmd_t  cmd)
+{
+	bool matched;
+
+	while (size == nvaudio_ivc_receive_match(ictxt, rx_msg, size,
+						 cmd, &matched)) {
+		if (matched)
+			return 0;
+	}
+	return -1;
+
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_receive_cmd);
+
+int nvaudio_ivc_receive(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size)
+{
+	bool matched;
+
+	return nvaudio_ivc_receive_match(ictxt, rx_msg, size, -1, &matched);
+}
 EXPORT_SYMBOL_GPL(nvaudio_ivc_receive);
 
 static irqreturn_t nvaudio_ivc_isr(int irq, void *pvt)
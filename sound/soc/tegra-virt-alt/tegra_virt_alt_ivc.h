@@ -32,6 +32,14 @@ struct nvaudio_ivc_ctxt {
 	spinlock_t			ivck_rx_lock;
 	spinlock_t			ivck_tx_lock;
 	spinlock_t			lock;
+
+	/* control batching, protected by lock */
+	struct nvaudio_ivc_msg		*batch;
+	unsigned int			batch_max;
+	unsigned int			batch_count;
+	unsigned int			batch_frames;
+	uint32_t			batch_seq;
+	bool				batching;
 };
 
 void nvaudio_ivc_rx(struct tegra_hv_ivc_cookie *ivck);
@@ -49,6 +57,14 @@ int nvaudio_ivc_send_retry(struct nvaudio_ivc_ctxt *ictxt,
 				struct nvaudio_ivc_msg *msg,
 				int size);
 
+int nvaudio_ivc_send_ctrl(struct nvaudio_ivc_ctxt *ictxt,
+				struct nvaudio_ivc_msg *msg,
+				int size);
+
+int nvaudio_ivc_batch_begin(struct nvaudio_ivc_ctxt *ictxt);
+
+int nvaudio_ivc_batch_end(struct nvaudio_ivc_ctxt *ictxt);
+
 int nvaudio_ivc_receive_cmd(struct nvaudio_ivc_ctxt *ictxt,
 				struct nvaudio_ivc_msg *msg,
 				int size,
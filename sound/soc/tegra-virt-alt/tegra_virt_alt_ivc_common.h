@@ -150,6 +150,8 @@ enum nvaudio_ivc_cmd_t {
 	NVAUDIO_AMIXER_SET_RX_DURATION,
 	NVAUDIO_AMIXER_GET_RX_DURATION,
 	NVAUDIO_AHUB_BLOCK_REGDUMP,
+	NVAUDIO_XBAR_SET_ROUTE_PRESET,
+	NVAUDIO_MSG_BATCH,
 	NVAUDIO_CMD_MAX,
 };
 
@@ -221,6 +223,36 @@ struct nvaudio_ivc_xbar_link {
 	uint32_t	bit_pos;
 };
 
+/*
+ * Several mux settings in one message. rx_idx is rx_reg divided by the
+ * xbar stride and tx_idx is the source index minus one, 0xff for none.
+ * Sized so the union does not grow.
+ */
+#define NVAUDIO_XBAR_PRESET_MAX_ROUTES	8
+
+struct nvaudio_ivc_xbar_route {
+	uint8_t		rx_idx;
+	uint8_t		tx_idx;
+	uint16_t	tx_value;
+};
+
+struct nvaudio_ivc_xbar_preset {
+	uint32_t			num_routes;
+	struct nvaudio_ivc_xbar_route routes[NVAUDIO_XBAR_PRESET_MAX_ROUTES];
+};
+
+/*
+ * Header of a batch frame: num_msgs complete struct nvaudio_ivc_msg
+ * follow this one in the same IVC frame and are handled in order. Only
+ * the frame that has ack_required set is answered, with the sequence
+ * number echoed back and err holding the first failure since the last
+ * acknowledged batch.
+ */
+struct nvaudio_ivc_msg_batch {
+	uint32_t	num_msgs;
+	uint32_t	seq;
+};
+
 struct nvaudio_ivc_dmaif_info {
 	int32_t	id;
 	int32_t	value;
@@ -245,6 +277,8 @@ struct nvaudio_ivc_msg {
 		struct nvaudio_ivc_t210_amx_info	amx_info;
 		struct nvaudio_ivc_t210_i2s_info	i2s_info;
 		struct nvaudio_ivc_xbar_link		xbar_info;
+		struct nvaudio_ivc_xbar_preset		xbar_preset;
+		struct nvaudio_ivc_msg_batch		msg_batch;
 		struct nvaudio_ivc_ahub_block		ahub_block_info;
 	} params;
 	bool			ack_required;
@@ -268,6 +268,9 @@ static int tegra_virt_machine_driver_probe(struct platform_device *pdev)
 		codec_drv->capture.rate_max = 192000;
 	}
 #endif
+	if (tegra_virt_machine_init_controls(card))
+		dev_err(&pdev->dev, "init-controls were not all applied\n");
+
 	tegra_metadata_setup(pdev, &meta, card);
 	tegra_pd_add_device(&pdev->dev);
 	pm_runtime_forbid(&pdev->dev);